@@ -0,0 +1,634 @@
+/// \file
+/// DSP micro-benchmarks of the engines
+///
+/// Runs each engine headless, driven by canned midi scenarios, for each combination of the
+/// given sample rates and buffer sizes, and prints the results as JSON:
+///
+/// ```sh
+/// bench --engines OTTO.FM,Chorus --buffer-sizes 64,256 --samplerates 48000 --seconds 10 --output bench.json
+/// ```
+///
+/// With `--ui`, it instead renders every screen registered with
+/// `UIManager::register_screen_selector` offscreen, with the software renderer, and prints the
+/// time, draw calls and vertices per frame of each. `--engines` then selects screens by name,
+/// like `synth,envelope`. Compare with the GLES renderer on the device, where the debug overlay
+/// of the EGL board shows the cost of the current screen.
+///
+/// With `--kernels`, it times the buffer kernels of `util/audio.hpp` against the equivalent
+/// loops over `util::zip` they replaced, for each of the given buffer sizes, and the kernels of
+/// the table dispatched at runtime, see `util::audio::kernels`. Set `OTTO_KERNELS` to compare
+/// the tables, like `OTTO_KERNELS=sse2 bench --kernels`.
+///
+/// With `--math`, it times the approximations of `util::math::fast`, scalar and over buffers,
+/// against the functions of `<cmath>`, for each of the given buffer sizes.
+///
+/// With `--signals`, it times emitting a `util::Signal` to 1 to 240 handlers, against the
+/// `std::forward_list` of double wrapped `std::function`s that property signals used to be.
+///
+/// Built with `OTTO_RT_CHECKS`, the engine results also have `rt_allocations`,
+/// `rt_deallocations` and `rt_locks`, the calls made by `process` after the warmup. They
+/// should all be 0.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <forward_list>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define OTTO_BENCH_HAS_CYCLES 1
+#else
+#define OTTO_BENCH_HAS_CYCLES 0
+#endif
+
+#include <Gamma/Domain.h>
+#include <json.hpp>
+
+#include "core/audio/midi.hpp"
+#include "core/audio/processor.hpp"
+#include "core/ui/draw_stats.hpp"
+#include "core/ui/soft_renderer.hpp"
+#include "core/ui/vector_graphics.hpp"
+
+#include "services/asset_loader.hpp"
+#include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
+#include "services/controller.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "services/preset_manager.hpp"
+#include "services/state_manager.hpp"
+#include "services/ui_manager.hpp"
+
+#include "util/audio.hpp"
+#include "util/iterator.hpp"
+#include "util/math.hpp"
+#include "util/rt_check.hpp"
+#include "util/signals.hpp"
+
+#include "services/engine_dispatchers.hpp"
+
+#include "engines/misc/master/master.hpp"
+#include "engines/synths/gammasampler/gammasampler.hpp"
+
+using namespace otto;
+using namespace otto::services;
+
+namespace otto::bench {
+
+  namespace midi = core::midi;
+  namespace audio = core::audio;
+
+  /// An audio manager without a device, configured by the benchmark
+  struct BenchAudioManager final : AudioManager {
+    void configure(int samplerate, int buffer_size)
+    {
+      _samplerate = samplerate;
+      _buffer_size = buffer_size;
+      buffer_pool().set_buffer_size(buffer_size);
+      buffer_pool().set_capacity(32);
+      gam::sampleRate(samplerate);
+    }
+  };
+
+  struct BenchUIManager final : UIManager {
+    void main_ui_loop() override {}
+  };
+
+  /// Processes one buffer of an engine
+  using Processor = std::function<void(audio::ProcessData<1>)>;
+
+  struct Subject {
+    std::string name;
+    /// Synths are driven by the scenarios, the others process a test signal
+    bool is_synth;
+    /// Constructs a new instance of the engine
+    std::function<Processor()> make;
+  };
+
+  template<typename Engine>
+  Subject synth(std::string name)
+  {
+    return {std::move(name), true, [] {
+              auto engine = std::make_shared<Engine>();
+              // Measure with the samples and wavetables loaded
+              AssetLoader::current().flush();
+              return [engine](audio::ProcessData<1> data) { engine->process(data); };
+            }};
+  }
+
+  /// The subject of an engine of a dispatcher, see `EngineDispatcher::registry`
+  template<typename Info>
+  Subject from_registry(const Info& info, bool is_synth)
+  {
+    return {std::string(info.name), is_synth, [&info, is_synth] {
+              std::shared_ptr engine = info.make();
+              if (is_synth) AssetLoader::current().flush(); // As in `synth`
+              return [engine](audio::ProcessData<1> data) { engine->process(data); };
+            }};
+  }
+
+  Subject master()
+  {
+    return {"Master", false, [] {
+              auto engine = std::make_shared<engines::Master>();
+              return [engine](audio::ProcessData<1> data) {
+                auto right = data.context->pool().allocate();
+                std::copy(data.audio.begin(), data.audio.end(), right.begin());
+                engine->process({{data.audio, right}, data.midi, data.nframes, data.context});
+              };
+            }};
+  }
+
+  std::vector<Subject> subjects()
+  {
+    std::vector<Subject> res;
+    for (auto& info : SynthDispatcher::registry) res.push_back(from_registry(info, true));
+    res.push_back(synth<engines::Sampler>("Sampler"));
+    for (auto& info : EffectsDispatcher::registry) res.push_back(from_registry(info, false));
+    res.push_back(master());
+    return res;
+  }
+
+  /// A canned stream of midi events
+  struct Scenario {
+    std::string name;
+    /// The number of voices sounding, used to normalize the cost
+    int voices;
+    /// Add the events of buffer number `buffer`
+    std::function<void(int buffer, midi::MidiBuffer&)> events;
+  };
+
+  std::vector<Scenario> scenarios()
+  {
+    return {
+      {"single_note", 1,
+       [](int buffer, midi::MidiBuffer& midi) {
+         if (buffer == 0) midi.push_back(midi::NoteOnEvent(60));
+       }},
+      {"chord", 6,
+       [](int buffer, midi::MidiBuffer& midi) {
+         if (buffer != 0) return;
+         for (int note : {48, 52, 55, 60, 64, 67}) midi.push_back(midi::NoteOnEvent(note));
+       }},
+      {"repeated_notes", 1,
+       [](int buffer, midi::MidiBuffer& midi) {
+         constexpr std::array<int, 5> notes = {60, 62, 64, 67, 69};
+         if (buffer % 8 != 0) return;
+         int step = buffer / 8;
+         if (step > 0) midi.push_back(midi::NoteOffEvent(notes[(step - 1) % notes.size()]));
+         midi.push_back(midi::NoteOnEvent(notes[step % notes.size()], 1, 0, buffer % 3));
+       }},
+      {"dense_cc", 6,
+       [](int buffer, midi::MidiBuffer& midi) {
+         if (buffer == 0) {
+           for (int note : {48, 52, 55, 60, 64, 67}) midi.push_back(midi::NoteOnEvent(note));
+         }
+         for (int i = 0; i < 16; i++) {
+           midi::ControlChangeEvent cc = {1, (buffer + i) % 128};
+           cc.time = i;
+           midi.push_back(cc);
+         }
+       }},
+    };
+  }
+
+  struct Config {
+    std::vector<std::string> engines;
+    std::vector<int> buffer_sizes = {64, 256};
+    std::vector<int> samplerates = {48000};
+    /// Seconds of audio to process per run
+    double seconds = 5;
+    /// Seconds of audio to process before measuring
+    double warmup = 0.5;
+    std::string output;
+    /// Frames to render per screen, with `--ui`
+    int frames = 200;
+  };
+
+  std::uint64_t cycles() noexcept
+  {
+#if OTTO_BENCH_HAS_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  nlohmann::json run(const Subject& subject,
+                     const Scenario& scenario,
+                     int samplerate,
+                     int buffer_size,
+                     const Config& config)
+  {
+    using clock = std::chrono::steady_clock;
+    auto& pool = AudioManager::current().buffer_pool();
+    auto context = AudioManager::current().make_context();
+    auto process = subject.make();
+    midi::MidiBuffer midi;
+
+    int warmup_buffers = std::ceil(config.warmup * samplerate / buffer_size);
+    int buffers = std::ceil(config.seconds * samplerate / buffer_size);
+    std::chrono::nanoseconds total{0};
+    std::chrono::nanoseconds worst{0};
+    std::uint64_t total_cycles = 0;
+    float phase = 0;
+    util::RealtimeViolations violations_before;
+
+    for (int b = 0; b < warmup_buffers + buffers; b++) {
+      midi.clear();
+      if (subject.is_synth) scenario.events(b, midi);
+      auto in = pool.allocate_clear();
+      if (!subject.is_synth) {
+        // A 440 Hz test tone
+        for (auto& frm : in) {
+          frm = 0.5f * std::sin(phase);
+          phase = std::fmod(phase + 2 * M_PI * 440 / samplerate, 2 * M_PI);
+        }
+      }
+
+      // Allocations during the warmup, like growing buffers on the first notes, are allowed
+      if (b == warmup_buffers) violations_before = util::realtime_violations();
+      auto c0 = cycles();
+      auto t0 = clock::now();
+      {
+        util::RealtimeScope realtime;
+        process({in, midi, buffer_size, &context});
+      }
+      auto t1 = clock::now();
+      auto c1 = cycles();
+
+      if (b < warmup_buffers) continue;
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0);
+      total += elapsed;
+      worst = std::max(worst, elapsed);
+      total_cycles += c1 - c0;
+    }
+
+    double frames = double(buffers) * buffer_size;
+    double ns = total.count();
+    int voices = subject.is_synth ? scenario.voices : 1;
+    nlohmann::json res = {
+      {"engine", subject.name},
+      {"scenario", subject.is_synth ? scenario.name : "test_tone"},
+      {"samplerate", samplerate},
+      {"buffer_size", buffer_size},
+      {"ns_per_sample", ns / frames},
+      {"worst_buffer_us", worst.count() / 1000.0},
+      {"realtime_factor", (frames / samplerate) / (ns / 1e9)},
+    };
+    if (util::realtime_checks_enabled) {
+      auto violations = util::realtime_violations();
+      res["rt_allocations"] = violations.allocations - violations_before.allocations;
+      res["rt_deallocations"] = violations.deallocations - violations_before.deallocations;
+      res["rt_locks"] = violations.locks - violations_before.locks;
+    }
+    if (OTTO_BENCH_HAS_CYCLES) {
+      res["cycles_per_voice_sample"] = total_cycles / (frames * voices);
+    } else {
+      res["cycles_per_voice_sample"] = nullptr;
+    }
+    return res;
+  }
+
+  /// Render `screen` with the software renderer, `config.frames` times
+  nlohmann::json run_screen(const std::string& name,
+                            core::ui::Screen& screen,
+                            core::ui::vg::SoftRenderer& renderer,
+                            core::ui::vg::Canvas& canvas,
+                            const Config& config)
+  {
+    namespace vg = core::ui::vg;
+    using clock = std::chrono::steady_clock;
+    screen.on_show();
+
+    std::chrono::nanoseconds total{0};
+    std::chrono::nanoseconds worst{0};
+    vg::DrawStats drawn;
+    for (int f = 0; f < config.frames; f++) {
+      const vg::DrawStats before = vg::draw_stats(canvas.nvg());
+      auto t0 = clock::now();
+      renderer.clear(vg::Colours::Black);
+      canvas.begineFrame(vg::width, vg::height);
+      screen.draw(canvas);
+      canvas.endFrame();
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0);
+      drawn = vg::draw_stats(canvas.nvg()) - before;
+      total += elapsed;
+      worst = std::max(worst, elapsed);
+    }
+    screen.on_hide();
+
+    return {
+      {"screen", name},
+      {"renderer", "soft"},
+      {"ms_per_frame", total.count() / 1e6 / config.frames},
+      {"worst_frame_ms", worst.count() / 1e6},
+      {"draw_calls", drawn.draw_calls()},
+      {"fills", drawn.fills},
+      {"strokes", drawn.strokes},
+      {"text", drawn.triangles},
+      {"vertices", drawn.vertices},
+    };
+  }
+
+  /// Keep the compiler from optimizing away, or merging, the repeated kernel calls
+  inline void clobber_memory() noexcept
+  {
+    asm volatile("" : : : "memory");
+  }
+
+  /// Call `f` for `config.seconds` of 48 kHz audio in buffers of `buffer_size`
+  ///
+  /// \returns the time per sample in nanoseconds
+  template<typename F>
+  double time_kernel(F&& f, int buffer_size, const Config& config)
+  {
+    using clock = std::chrono::steady_clock;
+    int buffers = std::ceil(config.seconds * 48000 / buffer_size);
+    auto t0 = clock::now();
+    for (int b = 0; b < buffers; b++) {
+      f();
+      clobber_memory();
+    }
+    auto t1 = clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / (double(buffers) * buffer_size);
+  }
+
+  /// Time the buffer kernels against the `util::zip` loops they replaced
+  nlohmann::json run_kernels(int buffer_size, const Config& config)
+  {
+    namespace ua = util::audio;
+    const int n = buffer_size;
+    std::vector<float> a(n), b(n), g(n), pan(n), out(n);
+    for (int i = 0; i < n; i++) {
+      a[i] = std::sin(0.1f * i);
+      b[i] = std::cos(0.1f * i);
+      g[i] = 0.5f + 0.001f * i / n;
+      pan[i] = 0.25f;
+    }
+
+    nlohmann::json res = nlohmann::json::array();
+    const auto& table = ua::kernels();
+    auto add_result = [&](const char* kernel, double zip_ns, double kernel_ns, double dispatched_ns) {
+      res.push_back({{"kernel", kernel},
+                     {"buffer_size", buffer_size},
+                     {"zip_ns_per_sample", zip_ns},
+                     {"kernel_ns_per_sample", kernel_ns},
+                     {"speedup", zip_ns / kernel_ns},
+                     {"dispatched_kernels", table.name},
+                     {"dispatched_ns_per_sample", dispatched_ns}});
+    };
+
+    add_result(
+      "gain",
+      time_kernel([&] { for (auto&& [s, vol] : util::zip(out, g)) s *= vol; }, n, config),
+      time_kernel([&] { ua::gain(out.data(), g.data(), n); }, n, config),
+      time_kernel([&] { table.gain(out.data(), g.data(), n); }, n, config));
+    add_result(
+      "multiply",
+      time_kernel([&] { for (auto&& [s, o, vol] : util::zip(a, out, g)) o = s * vol; }, n, config),
+      time_kernel([&] { ua::multiply(a.data(), g.data(), out.data(), n); }, n, config),
+      time_kernel([&] { table.multiply(a.data(), g.data(), out.data(), n); }, n, config));
+    add_result(
+      "add",
+      time_kernel([&] { for (auto&& [s, o] : util::zip(a, out)) o += s; }, n, config),
+      time_kernel([&] { ua::add(a.data(), out.data(), n); }, n, config),
+      time_kernel([&] { table.add(a.data(), out.data(), n); }, n, config));
+    add_result("mix_pan",
+               time_kernel(
+                 [&] {
+                   for (auto&& [s, l, r, vol, p] : util::zip(a, b, out, g, pan)) {
+                     r = s * vol * (1 + p);
+                     l = s * vol * (1 - p);
+                   }
+                 },
+                 n, config),
+               time_kernel([&] { ua::mix_pan(a.data(), g.data(), pan.data(), b.data(), out.data(), n); }, n, config),
+               time_kernel([&] { table.mix_pan(a.data(), g.data(), pan.data(), b.data(), out.data(), n); }, n, config));
+    return res;
+  }
+
+  /// Time the approximations of `util::math::fast` against `<cmath>`
+  nlohmann::json run_math(int buffer_size, const Config& config)
+  {
+    namespace fast = util::math::fast;
+    const int n = buffer_size;
+    std::vector<float> in(n), positive(n), out(n);
+    for (int i = 0; i < n; i++) {
+      in[i] = 4 * std::sin(0.1f * i);
+      positive[i] = 1.5f + std::sin(0.1f * i);
+    }
+
+    nlohmann::json res = nlohmann::json::array();
+    auto add_result = [&](const char* function, auto&& exact, auto&& approx, auto&& batch,
+                          const std::vector<float>& src) {
+      double std_ns = time_kernel([&] { for (int i = 0; i < n; i++) out[i] = exact(src[i]); }, n, config);
+      double fast_ns = time_kernel([&] { for (int i = 0; i < n; i++) out[i] = approx(src[i]); }, n, config);
+      double batch_ns = time_kernel([&] { batch(src.data(), out.data(), n); }, n, config);
+      res.push_back({{"function", function},
+                     {"buffer_size", buffer_size},
+                     {"std_ns_per_sample", std_ns},
+                     {"fast_ns_per_sample", fast_ns},
+                     {"buffer_ns_per_sample", batch_ns},
+                     {"speedup", std_ns / batch_ns}});
+    };
+
+    add_result(
+      "exp2", [](float x) { return std::exp2(x); }, [](float x) { return fast::exp2(x); },
+      [](auto... a) { fast::exp2(a...); }, in);
+    add_result(
+      "log2", [](float x) { return std::log2(x); }, [](float x) { return fast::log2(x); },
+      [](auto... a) { fast::log2(a...); }, positive);
+    add_result(
+      "tanh", [](float x) { return std::tanh(x); }, [](float x) { return fast::tanh(x); },
+      [](auto... a) { fast::tanh(a...); }, in);
+    add_result(
+      "sin", [](float x) { return std::sin(x); }, [](float x) { return fast::sin(x); },
+      [](auto... a) { fast::sin(a...); }, in);
+    add_result(
+      "db_to_gain", [](float x) { return std::pow(10.f, x / 20); }, [](float x) { return fast::db_to_gain(x); },
+      [](auto... a) { fast::db_to_gain(a...); }, in);
+    return res;
+  }
+
+  /// Time emitting a signal to `count` handlers
+  nlohmann::json run_signals(int count, const Config& config)
+  {
+    using clock = std::chrono::steady_clock;
+    float acc = 0;
+    util::Signal<float, float> signal;
+    // The previous layout: a list node per handler, each wrapping the user function in another
+    std::forward_list<std::function<void(float, float)>> list;
+    for (int i = 0; i < count; i++) {
+      signal.connect([&acc, i](float v, float) { acc += v * i; });
+      list.emplace_front([f = std::function<void(float)>([&acc, i](float v) { acc += v * i; })](
+                           float v, float) { f(v); });
+    }
+
+    auto time = [&](auto&& emit) {
+      int emits = std::max(1, int(config.seconds * 1e8 / count));
+      auto t0 = clock::now();
+      for (int e = 0; e < emits; e++) {
+        emit(float(e));
+        clobber_memory();
+      }
+      auto t1 = clock::now();
+      return std::chrono::duration<double, std::nano>(t1 - t0).count() / emits;
+    };
+    double list_ns = time([&](float v) {
+      for (auto& f : list) f(v, v);
+    });
+    double signal_ns = time([&](float v) { signal.emit(v, v); });
+    return {{"handlers", count},
+            {"list_ns_per_emit", list_ns},
+            {"signal_ns_per_emit", signal_ns},
+            {"speedup", list_ns / signal_ns},
+            {"checksum", acc}};
+  }
+
+  std::vector<std::string> split(const std::string& list)
+  {
+    std::vector<std::string> res;
+    std::stringstream ss(list);
+    for (std::string item; std::getline(ss, item, ',');) {
+      if (!item.empty()) res.push_back(item);
+    }
+    return res;
+  }
+
+  std::vector<int> split_ints(const std::string& list)
+  {
+    std::vector<int> res;
+    for (auto& item : split(list)) res.push_back(std::stoi(item));
+    return res;
+  }
+
+  void usage()
+  {
+    std::cerr << "Usage: bench [--engines a,b] [--buffer-sizes 64,256] [--samplerates 48000]\n"
+                 "             [--seconds 5] [--output file.json] [--list]\n"
+                 "       bench --ui [--engines synth,envelope] [--frames 200] [--output file.json]\n"
+                 "       bench --kernels [--buffer-sizes 64,256] [--seconds 5] [--output file.json]\n"
+                 "       bench --math [--buffer-sizes 64,256] [--seconds 5] [--output file.json]\n"
+                 "       bench --signals [--seconds 5] [--output file.json]\n";
+  }
+
+} // namespace otto::bench
+
+int main(int argc, char* argv[])
+{
+  using namespace otto::bench;
+
+  Config config;
+  bool list = false;
+  bool ui = false;
+  bool kernels = false;
+  bool math = false;
+  bool signals = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        usage();
+        std::exit(1);
+      }
+      return argv[++i];
+    };
+    if (arg == "--engines") config.engines = split(value());
+    else if (arg == "--buffer-sizes") config.buffer_sizes = split_ints(value());
+    else if (arg == "--samplerates") config.samplerates = split_ints(value());
+    else if (arg == "--seconds") config.seconds = std::stod(value());
+    else if (arg == "--output") config.output = value();
+    else if (arg == "--list") list = true;
+    else if (arg == "--ui") ui = true;
+    else if (arg == "--kernels") kernels = true;
+    else if (arg == "--math") math = true;
+    else if (arg == "--signals") signals = true;
+    else if (arg == "--frames") config.frames = std::stoi(value());
+    else {
+      usage();
+      return 1;
+    }
+  }
+
+  auto all = subjects();
+  if (list) {
+    for (auto& s : all) std::cout << s.name << "\n";
+    return 0;
+  }
+
+  // Keep the log out of the results on stdout
+  Application app{[&] { return std::make_unique<LogManager>(argc, argv, false); },
+                  StateManager::create_default,
+                  std::make_unique<PresetManager>,
+                  std::make_unique<BenchAudioManager>,
+                  ClockManager::create_default,
+                  std::make_unique<AssetLoader>,
+                  std::make_unique<BenchUIManager>,
+                  Controller::make_dummy,
+                  // The engine manager registers the screens
+                  [ui] { return ui ? EngineManager::create_default() : std::unique_ptr<EngineManager>(); }};
+  auto& audio_manager = static_cast<BenchAudioManager&>(*app.audio_manager);
+
+  auto selected = [&](const std::string& name) {
+    return config.engines.empty() ||
+           std::find(config.engines.begin(), config.engines.end(), name) != config.engines.end();
+  };
+
+  nlohmann::json results = nlohmann::json::array();
+  if (signals) {
+    for (int count : {1, 8, 30, 240}) results.push_back(run_signals(count, config));
+  } else if (kernels) {
+    for (int buffer_size : config.buffer_sizes) {
+      for (auto& result : run_kernels(buffer_size, config)) results.push_back(result);
+    }
+  } else if (math) {
+    for (int buffer_size : config.buffer_sizes) {
+      for (auto& result : run_math(buffer_size, config)) results.push_back(result);
+    }
+  } else if (ui) {
+    namespace vg = core::ui::vg;
+    audio_manager.configure(48000, 256);
+    vg::SoftRenderer renderer(vg::width, vg::height);
+    vg::Canvas canvas(renderer.context(), vg::width, vg::height);
+    vg::initUtils(canvas);
+    for (auto se : ScreenEnum::_values()) {
+      auto selector = app.ui_manager->screen_selector(se);
+      if (!selector || !selected(se._to_string())) continue;
+      results.push_back(run_screen(se._to_string(), selector(), renderer, canvas, config));
+    }
+  } else {
+    for (auto& subject : all) {
+      if (!selected(subject.name)) continue;
+      for (int samplerate : config.samplerates) {
+        for (int buffer_size : config.buffer_sizes) {
+          audio_manager.configure(samplerate, buffer_size);
+          if (subject.is_synth) {
+            for (auto& scenario : scenarios()) {
+              results.push_back(run(subject, scenario, samplerate, buffer_size, config));
+            }
+          } else {
+            results.push_back(run(subject, scenarios().front(), samplerate, buffer_size, config));
+          }
+        }
+      }
+    }
+  }
+
+  nlohmann::json doc = {{"results", results}};
+  if (config.output.empty()) {
+    std::cout << doc.dump(2) << std::endl;
+  } else {
+    std::ofstream(config.output) << doc.dump(2) << std::endl;
+  }
+  return 0;
+}
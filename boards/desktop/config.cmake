@@ -1,4 +1,17 @@
-otto_include_board(parts/audio/rtaudio)
+if (OTTO_JACK)
+  otto_include_board(parts/audio/jack)
+else()
+  otto_include_board(parts/audio/rtaudio)
+endif()
 otto_include_board(parts/ui/glfw)
 otto_include_board(parts/controller/emulator)
 otto_include_board(parts/controller/protto1-serial)
+
+# Desktops have the cpu for more polyphony than the Pi
+target_compile_definitions(otto PUBLIC OTTO_VOICE_COUNT=16)
+
+# The cpu of the build machine. Portable builds set OTTO_CPU_FLAGS=-march=x86-64, and still use
+# AVX2 for the buffer kernels where the cpu has it, see util::audio::kernels
+if (CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64|i.86")
+  otto_cpu_flags(-march=native)
+endif()
@@ -2,6 +2,7 @@
 
 #include "core/audio/midi.hpp"
 
+#include "services/asset_loader.hpp"
 #include "services/audio_manager.hpp"
 #include "services/engine_manager.hpp"
 #include "services/log_manager.hpp"
@@ -18,6 +19,12 @@
 using namespace otto;
 using namespace otto::services;
 
+#if OTTO_JACK
+using BoardAudioManager = JackAudioManager;
+#else
+using BoardAudioManager = RTAudioAudioManager;
+#endif
+
 int handle_exception(const char* e);
 int handle_exception(std::exception& e);
 int handle_exception();
@@ -29,8 +36,9 @@ int main(int argc, char* argv[])
       [&] { return std::make_unique<LogManager>(argc, argv); },
       StateManager::create_default,
       std::make_unique<PresetManager>,
-      std::make_unique<RTAudioAudioManager>,
+      std::make_unique<BoardAudioManager>,
       ClockManager::create_default,
+      std::make_unique<AssetLoader>,
       std::make_unique<GLFWUIManager>,
       PrOTTO1SerialController::make_or_emulator,
       EngineManager::create_default
@@ -42,7 +50,9 @@ int main(int argc, char* argv[])
     std::signal(SIGINT, Application::handle_signal);
 
     app.audio_manager->start();
+    app.startup_phase("audio");
     app.engine_manager->start();
+    app.startup_phase("engines");
     app.ui_manager->main_ui_loop();
 
   } catch (const char* e) {
@@ -1 +1,16 @@
+# Without a gpu, the UI can still be rendered on the cpu. Otherwise the dummy board is headless,
+# for rack mounted units controlled over midi and OSC
+if (OTTO_SOFT_UI)
+  otto_include_board(parts/ui/soft)
+else()
+  set(OTTO_HEADLESS ON)
+  otto_include_board(parts/ui/headless)
+endif()
 
+if (OTTO_JACK)
+  otto_include_board(parts/audio/jack)
+elseif (OTTO_ALSA)
+  otto_include_board(parts/audio/alsa)
+else()
+  otto_include_board(parts/audio/rtaudio)
+endif()
@@ -1,14 +1,25 @@
 #include <csignal>
+#include <cstdlib>
 
 #include "core/audio/midi.hpp"
 
+#include "services/asset_loader.hpp"
 #include "services/audio_manager.hpp"
 #include "services/engine_manager.hpp"
 #include "services/log_manager.hpp"
+#include "services/osc_server.hpp"
 #include "services/preset_manager.hpp"
 #include "services/state_manager.hpp"
 #include "services/ui_manager.hpp"
 #include "services/clock_manager.hpp"
+#include "services/controller.hpp"
+
+#include "board/audio_driver.hpp"
+#if OTTO_SOFT_UI
+#include "board/ui/soft_ui_manager.hpp"
+#else
+#include "board/ui/headless_ui_manager.hpp"
+#endif
 
 using namespace otto;
 using namespace otto::services;
@@ -17,11 +28,19 @@ int handle_exception(const char* e);
 int handle_exception(std::exception& e);
 int handle_exception();
 
-struct DummyUIManager final : UIManager {
-  DummyUIManager() = default;
+#if OTTO_JACK
+using BoardAudioManager = JackAudioManager;
+#elif OTTO_ALSA
+using BoardAudioManager = AlsaAudioManager;
+#else
+using BoardAudioManager = RTAudioAudioManager;
+#endif
 
-  void main_ui_loop() override {}
-};
+#if OTTO_SOFT_UI
+using DummyUIManager = SoftUIManager;
+#else
+using DummyUIManager = HeadlessUIManager;
+#endif
 
 int main(int argc, char* argv[])
 {
@@ -29,9 +48,11 @@ int main(int argc, char* argv[])
     Application app{[&] { return std::make_unique<LogManager>(argc, argv); },
                     StateManager::create_default,
                     std::make_unique<PresetManager>,
-                    std::make_unique<AudioManager>,
+                    std::make_unique<BoardAudioManager>,
                     ClockManager::create_default,
+                    std::make_unique<AssetLoader>,
                     std::make_unique<DummyUIManager>,
+                    Controller::make_dummy,
                     EngineManager::create_default};
 
     // Overwrite the logger signal handlers
@@ -39,8 +60,14 @@ int main(int argc, char* argv[])
     std::signal(SIGTERM, Application::handle_signal);
     std::signal(SIGINT, Application::handle_signal);
 
+    // Without keys and encoders, the unit is played over midi and controlled over OSC
+    const char* port = std::getenv("OTTO_OSC_PORT");
+    OscServer osc{*app.engine_manager->parameter_queue(), port ? std::atoi(port) : OscServer::default_port};
+
     app.engine_manager->start();
+    app.startup_phase("engines");
     app.audio_manager->start();
+    app.startup_phase("audio");
     app.ui_manager->main_ui_loop();
 
   } catch (const char* e) {
@@ -0,0 +1,163 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <optional>
+
+#include "core/audio/input_recording.hpp"
+#include "core/audio/midi_sequence.hpp"
+
+#include "services/asset_loader.hpp"
+#include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
+#include "services/controller.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "services/preset_manager.hpp"
+#include "services/state_manager.hpp"
+#include "services/ui_manager.hpp"
+
+#include "board/audio_driver.hpp"
+#include "board/render_batch.hpp"
+
+using namespace otto;
+using namespace otto::services;
+
+int handle_exception(const char* e);
+int handle_exception(std::exception& e);
+int handle_exception();
+
+struct DummyUIManager final : UIManager {
+  DummyUIManager() = default;
+
+  void main_ui_loop() override {}
+};
+
+void usage()
+{
+  std::cerr << "Usage: otto <input.mid|script.txt|recording.ottorec> <output.wav> [--samplerate 48000]\n"
+               "            [--buffer-size 256] [--tail 2] [--bit-depth 24]\n"
+               "A recording made with OTTO_RECORD_INPUT is replayed with its own sample rate and\n"
+               "buffer size, from the state saved next to it.\n"
+               "       otto --batch <jobs.txt> [--jobs 0] [options]\n"
+               "Renders each line of jobs.txt, like 'input.mid output.wav --tail 4', in a process\n"
+               "of its own, --jobs at a time, or one per core. The options apply to all jobs.\n";
+}
+
+int main(int argc, char* argv[])
+{
+  OfflineAudioManager::Config config;
+  std::vector<std::string> files;
+  std::string batch;
+  int jobs = 0;
+  // The options passed on to the renders of a batch
+  std::vector<std::string> options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.size() > 2 && arg.substr(0, 2) == "--") {
+      if (i + 1 >= argc) {
+        usage();
+        return 1;
+      }
+      std::string value = argv[++i];
+      if (arg == "--batch") batch = value;
+      else if (arg == "--jobs") jobs = std::stoi(value);
+      else if (arg == "--samplerate") config.samplerate = std::stoi(value);
+      else if (arg == "--buffer-size") config.buffer_size = std::stoi(value);
+      else if (arg == "--tail") config.tail = std::stod(value);
+      else if (arg == "--bit-depth") config.bit_depth = std::stoi(value);
+      else {
+        usage();
+        return 1;
+      }
+      if (arg != "--batch" && arg != "--jobs") options.insert(options.end(), {arg, value});
+    } else if (arg[0] != '-') {
+      files.push_back(arg);
+    }
+  }
+  if (!batch.empty() && files.empty()) {
+    try {
+      RenderBatch renders{argv[0], options, RenderBatch::load(batch)};
+      return renders.run(jobs) == 0 ? 0 : 1;
+    } catch (std::exception& e) {
+      return handle_exception(e);
+    }
+  }
+  if (files.size() != 2) {
+    usage();
+    return 1;
+  }
+
+  try {
+    fs::path input = files[0];
+    std::optional<core::midi::MidiSequence> sequence;
+    std::optional<core::audio::InputRecording> recording;
+    if (input.extension() == ".ottorec") {
+      recording = core::audio::InputRecording::load(input);
+      config.samplerate = recording->samplerate;
+      config.buffer_size = recording->buffer_size;
+    } else {
+      sequence = core::midi::MidiSequence::load(input);
+    }
+
+    Application app{[&] { return std::make_unique<LogManager>(argc, argv); },
+                    StateManager::create_default,
+                    std::make_unique<PresetManager>,
+                    [&] { return std::make_unique<OfflineAudioManager>(config); },
+                    ClockManager::create_default,
+                    std::make_unique<AssetLoader>,
+                    std::make_unique<DummyUIManager>,
+                    Controller::make_dummy,
+                    EngineManager::create_default};
+
+    // Overwrite the logger signal handlers
+    std::signal(SIGABRT, Application::handle_signal);
+    std::signal(SIGTERM, Application::handle_signal);
+    std::signal(SIGINT, Application::handle_signal);
+
+    app.engine_manager->start();
+    if (recording) {
+      auto state = input;
+      state += ".state.json";
+      if (fs::exists(state)) app.state_manager->import_json(state);
+      else LOGW("No state saved with the recording at {}, replaying from the default state", state.c_str());
+    }
+    // There is no UI to pick up the samples and wavetables as they are loaded
+    app.asset_loader->flush();
+    app.audio_manager->start();
+    auto& audio = static_cast<OfflineAudioManager&>(*app.audio_manager);
+    auto frames = recording ? audio.render(*recording, files[1]) : audio.render(*sequence, files[1]);
+    LOGI("Wrote {} frames to {}", frames, files[1]);
+
+  } catch (const char* e) {
+    return handle_exception(e);
+  } catch (std::exception& e) {
+    return handle_exception(e);
+  } catch (...) {
+    return handle_exception();
+  }
+
+  LOG_F(INFO, "Exiting");
+  return 0;
+}
+
+int handle_exception(const char* e)
+{
+  LOGE(e);
+  LOGE("Exception thrown, exitting!");
+  return 1;
+}
+
+int handle_exception(std::exception& e)
+{
+  LOGE(e.what());
+  LOGE("Exception thrown, exitting!");
+  return 1;
+}
+
+int handle_exception()
+{
+  LOGE("Unknown exception thrown, exitting!");
+  return 1;
+}
@@ -0,0 +1 @@
+target_link_libraries(otto PUBLIC asound)
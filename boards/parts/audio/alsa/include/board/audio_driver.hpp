@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <alsa/asoundlib.h>
+
+#include "services/audio_manager.hpp"
+
+namespace otto::services {
+
+  /// Audio straight through an ALSA hardware device, without RtAudio
+  ///
+  /// The device is opened in its native sample format, and the engines write into its mmap
+  /// ring buffer, one period per callback. The audio thread is pinned to
+  /// AudioManager::audio_core, and runs with `SCHED_FIFO` where permitted. The achieved
+  /// latency is logged at startup, and available from @ref latency_frames.
+  ///
+  /// There is no midi, the device only provides audio.
+  struct AlsaAudioManager final : AudioManager {
+    struct Config {
+      /// A hardware device. Plugin devices like `default` or `plughw` would convert samples
+      /// in their own buffer.
+      std::string device = "hw:0,0";
+      /// The number of frames processed in each callback
+      int period_size = 128;
+      /// The number of periods in the ring buffer of the device
+      int periods = 2;
+      int samplerate = 48000;
+      /// The `SCHED_FIFO` priority of the audio thread
+      int priority = 80;
+    };
+
+    AlsaAudioManager();
+    AlsaAudioManager(Config config);
+    ~AlsaAudioManager() noexcept;
+
+    /// The delay from the engines to the DAC, in frames
+    ///
+    /// The size of the ring buffer of the device, as negotiated with it.
+    int latency_frames() const noexcept
+    {
+      return _latency_frames;
+    }
+
+  private:
+    /// An open pcm, and the format it was negotiated to
+    struct Pcm {
+      snd_pcm_t* handle = nullptr;
+      snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
+      unsigned channels = 0;
+    };
+
+    /// Open the device with @ref _config, and start the audio thread
+    ///
+    /// \throws Application::exception with ErrorCode::audio_error
+    void open();
+
+    /// Stop the audio thread, and close the device
+    void close() noexcept;
+
+    void restart(int samplerate, int buffer_size) override;
+
+    /// Open `_config.device` in `stream` direction, and negotiate the format
+    ///
+    /// \throws Application::exception with ErrorCode::audio_error
+    Pcm open_pcm(snd_pcm_stream_t stream);
+
+    /// Fill the playback buffer with silence, and start the device
+    void prepare_and_start();
+
+    /// Restart the devices after the error `err`, usually an xrun
+    void recover(int err) noexcept;
+
+    void audio_main() noexcept;
+
+    /// Read a period from the capture pcm into @ref _input, or fill it with silence
+    void read_input() noexcept;
+
+    /// Write a period of `left` and `right` into the mmap buffer of the playback pcm
+    ///
+    /// Writes silence if `left` is null.
+    /// \returns a negative error code on failure
+    int write_output(const float* left, const float* right) noexcept;
+
+    /// Process a period, and write it to the playback pcm
+    ///
+    /// \returns a negative error code on failure
+    int process() noexcept;
+
+    Config _config;
+    Pcm _playback;
+    /// Not opened if the device has no input
+    Pcm _capture;
+    /// The input of the engines, one channel
+    std::vector<float> _input;
+    std::atomic_int _latency_frames = 0;
+    std::atomic_bool _should_run = true;
+    std::thread _thread;
+  };
+
+} // namespace otto::services
+
+// kak: other_file=../../src/audio_driver.cpp
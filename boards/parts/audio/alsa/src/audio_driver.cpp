@@ -0,0 +1,396 @@
+#include "board/audio_driver.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "core/audio/processor.hpp"
+#include "core/props/props.hpp"
+
+#include "services/clock_manager.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "util/audio.hpp"
+#include "util/realtime.hpp"
+#include "util/rt_check.hpp"
+#include "util/timer.hpp"
+
+
+namespace otto::services {
+
+  namespace {
+
+    /// The formats tried when opening a device, in order of preference
+    constexpr std::array<snd_pcm_format_t, 4> formats = {
+      SND_PCM_FORMAT_S32_LE,
+      SND_PCM_FORMAT_S24_LE,
+      SND_PCM_FORMAT_S16_LE,
+      SND_PCM_FORMAT_FLOAT_LE,
+    };
+
+    /// The first sample of `area` at frame `offset`
+    inline char* sample_ptr(const snd_pcm_channel_area_t& area, snd_pcm_uframes_t offset) noexcept
+    {
+      return static_cast<char*>(area.addr) + (area.first + offset * area.step) / 8;
+    }
+
+    /// Convert `n` samples of `src` to `format`, and store them in `area` from frame `offset`
+    template<typename Store>
+    void store_samples(const snd_pcm_channel_area_t& area,
+                       snd_pcm_uframes_t offset,
+                       const float* src,
+                       int n,
+                       Store&& store) noexcept
+    {
+      char* dst = sample_ptr(area, offset);
+      const int step = area.step / 8;
+      for (int i = 0; i < n; i++, dst += step) store(dst, std::clamp(src[i], -1.f, 1.f));
+    }
+
+    void write_samples(snd_pcm_format_t format,
+                       const snd_pcm_channel_area_t& area,
+                       snd_pcm_uframes_t offset,
+                       const float* src,
+                       int n) noexcept
+    {
+      // Floats have 24 bits of precision, so 32 bit samples are scaled as 24 bit ones
+      switch (format) {
+        case SND_PCM_FORMAT_S32_LE:
+          return store_samples(area, offset, src, n, [](char* dst, float v) {
+            std::int32_t s = std::int32_t(v * 8388607.f) * 256;
+            std::memcpy(dst, &s, sizeof(s));
+          });
+        case SND_PCM_FORMAT_S24_LE:
+          return store_samples(area, offset, src, n, [](char* dst, float v) {
+            std::int32_t s = std::int32_t(v * 8388607.f);
+            std::memcpy(dst, &s, sizeof(s));
+          });
+        case SND_PCM_FORMAT_S16_LE:
+          return store_samples(area, offset, src, n, [](char* dst, float v) {
+            std::int16_t s = std::int16_t(v * 32767.f);
+            std::memcpy(dst, &s, sizeof(s));
+          });
+        default:
+          return store_samples(area, offset, src, n, [](char* dst, float v) { std::memcpy(dst, &v, sizeof(v)); });
+      }
+    }
+
+    void read_samples(snd_pcm_format_t format,
+                      const snd_pcm_channel_area_t& area,
+                      snd_pcm_uframes_t offset,
+                      float* dst,
+                      int n) noexcept
+    {
+      const char* src = sample_ptr(area, offset);
+      const int step = area.step / 8;
+      for (int i = 0; i < n; i++, src += step) {
+        switch (format) {
+          case SND_PCM_FORMAT_S32_LE: {
+            std::int32_t s;
+            std::memcpy(&s, src, sizeof(s));
+            dst[i] = s / 2147483648.f;
+          } break;
+          case SND_PCM_FORMAT_S24_LE: {
+            std::int32_t s;
+            std::memcpy(&s, src, sizeof(s));
+            // Sign extend the low 24 bits
+            dst[i] = ((s << 8) >> 8) / 8388608.f;
+          } break;
+          case SND_PCM_FORMAT_S16_LE: {
+            std::int16_t s;
+            std::memcpy(&s, src, sizeof(s));
+            dst[i] = s / 32768.f;
+          } break;
+          default: std::memcpy(&dst[i], src, sizeof(float));
+        }
+      }
+    }
+
+  } // namespace
+
+  AlsaAudioManager::AlsaAudioManager() : AlsaAudioManager(Config{}) {}
+
+  AlsaAudioManager::AlsaAudioManager(Config config) : _config(std::move(config))
+  {
+    open();
+  }
+
+  AlsaAudioManager::~AlsaAudioManager() noexcept
+  {
+    close();
+  }
+
+  void AlsaAudioManager::open()
+  {
+    _playback = open_pcm(SND_PCM_STREAM_PLAYBACK);
+    try {
+      _capture = open_pcm(SND_PCM_STREAM_CAPTURE);
+    } catch (Application::exception& e) {
+      LOGW("No audio input: {}", e.what());
+    }
+    // Linked pcms are prepared, started and stopped together
+    if (_capture.handle && snd_pcm_link(_capture.handle, _playback.handle) < 0) {
+      LOGW("Could not link the ALSA capture and playback devices");
+      snd_pcm_close(_capture.handle);
+      _capture = {};
+    }
+
+    _input.assign(_config.period_size, 0.f);
+    apply_settings(_config.samplerate, _config.period_size);
+
+    LOGI("ALSA: {} at {} Hz in {}, {} periods of {} frames. Latency {:.2f} ms", _config.device,
+         samplerate(), snd_pcm_format_name(_playback.format), _config.periods, _config.period_size,
+         1000.f * latency_frames() / samplerate());
+
+    _should_run = true;
+    _thread = std::thread([this] { audio_main(); });
+  }
+
+  void AlsaAudioManager::close() noexcept
+  {
+    _should_run = false;
+    if (_thread.joinable()) _thread.join();
+    if (_capture.handle) {
+      snd_pcm_unlink(_capture.handle);
+      snd_pcm_close(_capture.handle);
+      _capture = {};
+    }
+    if (_playback.handle) snd_pcm_close(_playback.handle);
+    _playback = {};
+  }
+
+  void AlsaAudioManager::restart(int samplerate, int buffer_size)
+  {
+    close();
+    Config old = _config;
+    _config.samplerate = samplerate;
+    _config.period_size = buffer_size;
+    try {
+      open();
+    } catch (Application::exception& e) {
+      LOGE("{}. Going back to {} Hz, {} frames", e.what(), old.samplerate, old.period_size);
+      _config = old;
+      open();
+    }
+  }
+
+  AlsaAudioManager::Pcm AlsaAudioManager::open_pcm(snd_pcm_stream_t stream)
+  {
+    const char* direction = stream == SND_PCM_STREAM_PLAYBACK ? "playback" : "capture";
+    Pcm pcm;
+    int err = snd_pcm_open(&pcm.handle, _config.device.c_str(), stream, 0);
+    if (err < 0) {
+      throw Application::exception(Application::ErrorCode::audio_error, "Could not open ALSA {} device {}: {}",
+                                   direction, _config.device, snd_strerror(err));
+    }
+    auto check = [&](int err, const char* what) {
+      if (err >= 0) return;
+      snd_pcm_close(pcm.handle);
+      throw Application::exception(Application::ErrorCode::audio_error, "Could not set the {} of ALSA {} device {}: {}",
+                                   what, direction, _config.device, snd_strerror(err));
+    };
+
+    snd_pcm_hw_params_t* hw;
+    snd_pcm_hw_params_alloca(&hw);
+    check(snd_pcm_hw_params_any(pcm.handle, hw), "parameters");
+
+    snd_pcm_access_mask_t* access;
+    snd_pcm_access_mask_alloca(&access);
+    snd_pcm_access_mask_none(access);
+    snd_pcm_access_mask_set(access, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+    snd_pcm_access_mask_set(access, SND_PCM_ACCESS_MMAP_NONINTERLEAVED);
+    check(snd_pcm_hw_params_set_access_mask(pcm.handle, hw, access), "mmap access");
+
+    auto format = std::find_if(formats.begin(), formats.end(), [&](snd_pcm_format_t f) {
+      return snd_pcm_hw_params_test_format(pcm.handle, hw, f) == 0;
+    });
+    check(format == formats.end() ? -EINVAL : 0, "sample format");
+    pcm.format = *format;
+    check(snd_pcm_hw_params_set_format(pcm.handle, hw, pcm.format), "sample format");
+
+    pcm.channels = stream == SND_PCM_STREAM_PLAYBACK ? 2 : 1;
+    check(snd_pcm_hw_params_set_channels_near(pcm.handle, hw, &pcm.channels), "channels");
+    if (stream == SND_PCM_STREAM_PLAYBACK && pcm.channels < 2) check(-EINVAL, "channels");
+
+    // Capture has to run at the exact rate and period size of playback
+    unsigned rate = _config.samplerate;
+    check(snd_pcm_hw_params_set_rate_near(pcm.handle, hw, &rate, nullptr), "sample rate");
+    snd_pcm_uframes_t period = _config.period_size;
+    check(snd_pcm_hw_params_set_period_size_near(pcm.handle, hw, &period, nullptr), "period size");
+    unsigned periods = _config.periods;
+    check(snd_pcm_hw_params_set_periods_near(pcm.handle, hw, &periods, nullptr), "number of periods");
+    check(snd_pcm_hw_params(pcm.handle, hw), "parameters");
+    if (stream == SND_PCM_STREAM_CAPTURE && (int(rate) != _config.samplerate || int(period) != _config.period_size)) {
+      check(-EINVAL, "sample rate and period size");
+    }
+    _config.samplerate = rate;
+    _config.period_size = period;
+    _config.periods = periods;
+
+    snd_pcm_uframes_t buffer_size;
+    snd_pcm_hw_params_get_buffer_size(hw, &buffer_size);
+    if (stream == SND_PCM_STREAM_PLAYBACK) _latency_frames = buffer_size;
+
+    // The device is started by hand, once the buffer is filled
+    snd_pcm_sw_params_t* sw;
+    snd_pcm_sw_params_alloca(&sw);
+    check(snd_pcm_sw_params_current(pcm.handle, sw), "software parameters");
+    check(snd_pcm_sw_params_set_start_threshold(pcm.handle, sw, buffer_size * 2), "start threshold");
+    check(snd_pcm_sw_params_set_avail_min(pcm.handle, sw, period), "minimum available frames");
+    check(snd_pcm_sw_params(pcm.handle, sw), "software parameters");
+
+    return pcm;
+  }
+
+  void AlsaAudioManager::prepare_and_start()
+  {
+    snd_pcm_prepare(_playback.handle);
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(_playback.handle);
+    while (avail > 0) {
+      const snd_pcm_channel_area_t* areas;
+      snd_pcm_uframes_t offset;
+      snd_pcm_uframes_t frames = avail;
+      if (snd_pcm_mmap_begin(_playback.handle, &areas, &offset, &frames) < 0) break;
+      snd_pcm_areas_silence(areas, offset, _playback.channels, frames, _playback.format);
+      snd_pcm_mmap_commit(_playback.handle, offset, frames);
+      avail -= frames;
+    }
+    int err = snd_pcm_start(_playback.handle);
+    RTLOGE_IF(err < 0, "Could not start ALSA device: {}", snd_strerror(err));
+  }
+
+  void AlsaAudioManager::recover(int err) noexcept
+  {
+    if (err == -EPIPE) {
+      _callback_stats.output_underflows++;
+    } else {
+      RTLOGE("ALSA error: {}", snd_strerror(err));
+    }
+    // Stops the capture device too, since they are linked
+    snd_pcm_drop(_playback.handle);
+    prepare_and_start();
+  }
+
+  void AlsaAudioManager::audio_main() noexcept
+  {
+    prepare_audio_thread();
+    if (!util::set_fifo_priority(util::current_thread(), _config.priority)) {
+      RTLOGW("Could not give the audio thread real-time priority");
+    }
+    prepare_and_start();
+    while (_should_run) {
+      int err = snd_pcm_wait(_playback.handle, 100);
+      if (err < 0) {
+        recover(err);
+        continue;
+      }
+      snd_pcm_sframes_t avail = snd_pcm_avail_update(_playback.handle);
+      if (avail < 0) {
+        recover(avail);
+        continue;
+      }
+      for (; avail >= _config.period_size; avail -= _config.period_size) {
+        read_input();
+        err = process();
+        if (err < 0) {
+          recover(err);
+          break;
+        }
+      }
+    }
+    snd_pcm_drop(_playback.handle);
+  }
+
+  void AlsaAudioManager::read_input() noexcept
+  {
+    if (!_capture.handle) return;
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(_capture.handle);
+    if (avail < _config.period_size) {
+      // The devices are linked, so playback recovers them both when capture overruns
+      if (avail == -EPIPE) _callback_stats.input_overflows++;
+      std::fill(_input.begin(), _input.end(), 0.f);
+      return;
+    }
+    for (int done = 0; done < _config.period_size;) {
+      const snd_pcm_channel_area_t* areas;
+      snd_pcm_uframes_t offset;
+      snd_pcm_uframes_t frames = _config.period_size - done;
+      if (snd_pcm_mmap_begin(_capture.handle, &areas, &offset, &frames) < 0) {
+        std::fill(_input.begin() + done, _input.end(), 0.f);
+        return;
+      }
+      read_samples(_capture.format, areas[0], offset, _input.data() + done, frames);
+      snd_pcm_mmap_commit(_capture.handle, offset, frames);
+      done += frames;
+    }
+  }
+
+  int AlsaAudioManager::write_output(const float* left, const float* right) noexcept
+  {
+    for (int done = 0; done < _config.period_size;) {
+      const snd_pcm_channel_area_t* areas;
+      snd_pcm_uframes_t offset;
+      snd_pcm_uframes_t frames = _config.period_size - done;
+      if (int err = snd_pcm_mmap_begin(_playback.handle, &areas, &offset, &frames); err < 0) return err;
+      if (left) {
+        write_samples(_playback.format, areas[0], offset, left + done, frames);
+        write_samples(_playback.format, areas[1], offset, right + done, frames);
+        for (unsigned ch = 2; ch < _playback.channels; ch++) {
+          snd_pcm_area_silence(&areas[ch], offset, frames, _playback.format);
+        }
+      } else {
+        snd_pcm_areas_silence(areas, offset, _playback.channels, frames, _playback.format);
+      }
+      snd_pcm_sframes_t committed = snd_pcm_mmap_commit(_playback.handle, offset, frames);
+      if (committed < 0) return committed;
+      done += frames;
+    }
+    return 0;
+  }
+
+  int AlsaAudioManager::process() noexcept
+  {
+    TIME_SCOPE("Audio callback");
+    util::RealtimeScope realtime;
+    util::audio::FlushDenormals flush_denormals;
+    const int nframes = _config.period_size;
+    if (!running() || !Application::current().running()) {
+      finish_buffer();
+      return write_output(nullptr, nullptr);
+    }
+
+    clock::time_point t0 = clock::now();
+
+    core::props::AudioThreadQueue::get().process_changes();
+    auto& clock_manager = ClockManager::current();
+    clock_manager.process(nframes, _samplerate);
+
+    core::audio::AudioBufferRefCount ref_count;
+    core::audio::AudioBufferHandle in_buf(_input.data(), nframes, ref_count);
+    auto& midi_in = collect_midi();
+    auto context = make_context();
+    clock::time_point engines_t0 = clock::now();
+    auto out = Application::current().engine_manager->process({std::move(in_buf), midi_in, nframes, &context});
+    clock::time_point engines_t1 = clock::now();
+
+    RTLOGW_IF(out.nframes != nframes, "Frames went missing!");
+
+    int err = write_output(out.audio[0].data(), out.audio[1].data());
+
+    _midi_overflow_count += midi_in.overflow_count();
+    out.audio[0].release();
+    out.audio[1].release();
+    buffer_pool().check_leaks();
+
+    clock::time_point t1 = clock::now();
+
+    record_cpu_time(t1 - t0, engines_t1 - engines_t0);
+    record_callback(t0, t1, nframes, false, false);
+    finish_buffer();
+    return err;
+  }
+
+} // namespace otto::services
+
+// kak: other_file=../include/board/audio_driver.hpp
@@ -6,69 +6,69 @@
 
 #include <jack/jack.h>
 #include <jack/midiport.h>
+
 #include "core/audio/midi.hpp"
+#include "core/audio/midi_parser.hpp"
 #include "core/audio/processor.hpp"
-#include "util/locked.hpp"
-
-#include "util/locked.hpp"
 
-namespace otto::service::audio {
-  struct JackAudioDriver {
-    static JackAudioDriver& get() noexcept;
+#include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
 
-    void init();
-    void shutdown();
+namespace otto::services {
 
-    std::atomic_int samplerate;
+  /// Audio and midi through a JACK client
+  ///
+  /// The engines read the input straight from the port buffer of JACK, and midi is read and
+  /// written sample accurately with the buffers of the midi ports. JACK runs the callback on
+  /// its own realtime thread.
+  struct JackAudioManager final : AudioManager {
+    JackAudioManager();
+    ~JackAudioManager() noexcept;
 
-    void send_midi_event(core::midi::AnyMidiEvent) noexcept;
+  protected:
+    enum struct PortType { audio, midi };
 
-    core::audio::AudioBufferPool& buffer_pool();
+    int process(jack_nframes_t nframes);
 
-  private:
-    JackAudioDriver() = default;
-    ~JackAudioDriver() noexcept = default;
+    void init_client();
+    void init_ports();
 
-    using AudioSample = jack_default_audio_sample_t;
-    static constexpr const size_t sampleSize = sizeof(AudioSample);
-    static constexpr const char* const clientName = "OTTO";
-
-    struct {
-      jack_port_t *outL;
-      jack_port_t *outR;
-      jack_port_t *input;
-      jack_port_t *midiIn;
-      jack_port_t *midiOut;
-    } ports;
+    /// Changes the buffer size of the JACK server. Its sample rate can not be changed by a client.
+    void restart(int samplerate, int buffer_size) override;
 
-    std::size_t bufferSize;
+    /// The names of the ports of other clients matching `flags`
+    std::vector<std::string> find_ports(unsigned long flags, PortType type = PortType::audio);
 
-    jack_client_t* client;
-    jack_status_t jackStatus;
+    /// Connect the port named `from` to the one named `to`
+    bool connect_ports(const std::string& from, const std::string& to);
 
-    util::atomic_swap<core::midi::shared_vector<core::midi::AnyMidiEvent>> midi_bufs = {{}, {}};
+    /// Add the events of the midi input port to `buf`, at their offsets into the buffer
+    void read_midi_input(core::midi::MidiBuffer& buf, jack_nframes_t nframes);
 
-    enum class PortType {
-      Audio,
-      Midi
-    };
+    /// Write midi clock messages for the ticks of the current buffer, at their offsets
+    void send_midi_clock(ClockManager&, void* midi_out_buf);
 
-    void setupPorts();
-    std::vector<std::string> findPorts(int criteria, PortType type = PortType::Audio);
+    jack_client_t* client = nullptr;
 
-    // Helper function for connections
-    bool connectPorts(const std::string& src, const std::string& dest);
-    void samplerateCallback(unsigned srate);
-    void buffersizeCallback(unsigned buffsize);
-    void new_port_callback(jack_port_id_t id);
-    void gatherMidiInput(int nFrames);
-    void process(int nframes);
+    struct {
+      jack_port_t* input = nullptr;
+      jack_port_t* out_left = nullptr;
+      jack_port_t* out_right = nullptr;
+      jack_port_t* midi_in = nullptr;
+      jack_port_t* midi_out = nullptr;
+    } ports;
 
-    /// Jack cannot connect to a port from the notification thread, so we just add them here, and process them from the main one instead.
-    std::vector<jack_port_id_t> new_ports;
+    /// Set by the xrun callback of JACK, and recorded by the next process call
+    std::atomic_bool xrun = false;
 
-    std::unique_ptr<core::audio::AudioBufferPool> _buffer_pool;
+    /// Only used on the audio thread
+    core::midi::MidiParser midi_parser;
+    /// Created on the first real-time message. Only used on the audio thread.
+    tl::optional<MidiClockInput> midi_clock_in = tl::nullopt;
+    /// Whether a midi start has been sent since the last stop
+    bool midi_clock_out_running = false;
   };
 
-  using AudioDriver = JackAudioDriver;
-} // otto::audio
+} // namespace otto::services
+
+// kak: other_file=../../src/jack.cpp
@@ -1,325 +1,278 @@
 #include "board/audio_driver.hpp"
 
+#include <algorithm>
+#include <cerrno>
 #include <string>
 #include <vector>
 
 #include <fmt/format.h>
-#include <jack/jack.h>
-#include <jack/midiport.h>
 
-#include "util/algorithm.hpp"
+#include "core/audio/processor.hpp"
+#include "core/props/props.hpp"
+
+#include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "util/audio.hpp"
+#include "util/rt_check.hpp"
 #include "util/timer.hpp"
 
-#include "core/audio/processor.hpp"
-#include "core/globals.hpp"
 
-#include "services/audio.hpp"
-#include "services/engines.hpp"
-#include "services/logger.hpp"
+namespace otto::services {
 
-namespace otto::service::audio {
   namespace {
-    void jackError(const char* s)
+    void jack_error(const char* s)
     {
       LOGE("JACK: {}", s);
     }
 
-    void jackLogInfo(const char* s)
+    void jack_info(const char* s)
     {
       LOGI("JACK: {}", s);
     }
-
-    void jackShutdown(void* arg)
-    {
-      LOGI("JACK shut down, exiting");
-    }
   } // namespace
 
-  JackAudioDriver& JackAudioDriver::get() noexcept
+  JackAudioManager::JackAudioManager()
   {
-    static JackAudioDriver instance{};
-    return instance;
+    init_client();
+    init_ports();
   }
 
-  core::audio::AudioBufferPool& JackAudioDriver::buffer_pool()
+  JackAudioManager::~JackAudioManager() noexcept
   {
-    return *_buffer_pool;
+    if (client == nullptr) return;
+    jack_deactivate(client);
+    jack_client_close(client);
   }
 
-  void JackAudioDriver::init()
+  void JackAudioManager::init_client()
   {
-    jack_set_error_function(jackError);
-    jack_set_info_function(jackLogInfo);
-
-    client = jack_client_open(clientName, JackNullOption, &jackStatus);
-
-    if ((!jackStatus) & JackServerStarted) {
-      throw global::exception(global::ErrorCode::audio_error, "Failed to start jack server");
+    jack_set_error_function(jack_error);
+    jack_set_info_function(jack_info);
+
+    jack_status_t status;
+    client = jack_client_open("OTTO", JackNullOption, &status);
+    if (client == nullptr) {
+      throw Application::exception(Application::ErrorCode::audio_error,
+                                   "Could not open a JACK client, status {:#x}", int(status));
     }
 
-    LOGI("Jack server started");
-    LOGI("Jack client status: {}", jackStatus);
-
-    jack_set_process_callback(client,
-                              [](jack_nframes_t nframes, void* arg) {
-                                (static_cast<JackAudioDriver*>(arg))->process(nframes);
-                                return 0;
-                              },
-                              this);
+    jack_set_process_callback(
+      client,
+      [](jack_nframes_t nframes, void* self) { return static_cast<JackAudioManager*>(self)->process(nframes); },
+      this);
 
-    jack_set_sample_rate_callback(
+    // JACK stops processing while these are called, so the buffer pool can be resized
+    jack_set_buffer_size_callback(
       client,
-      [](jack_nframes_t nframes, void* arg) {
-        (static_cast<JackAudioDriver*>(arg))->samplerateCallback(nframes);
+      [](jack_nframes_t nframes, void* _self) {
+        auto& self = *static_cast<JackAudioManager*>(_self);
+        LOGI("JACK changed the buffer size to {}", nframes);
+        self.apply_settings(self._samplerate, nframes);
         return 0;
       },
       this);
 
-    jack_set_buffer_size_callback(
+    jack_set_sample_rate_callback(
       client,
-      [](jack_nframes_t nframes, void* arg) {
-        (static_cast<JackAudioDriver*>(arg))->buffersizeCallback(nframes);
+      [](jack_nframes_t srate, void* _self) {
+        auto& self = *static_cast<JackAudioManager*>(_self);
+        LOGI("JACK changed the sample rate to {}", srate);
+        self.apply_settings(srate, self._buffer_size);
         return 0;
       },
       this);
 
-    jack_set_port_registration_callback(
+    jack_set_xrun_callback(
       client,
-      [](jack_port_id_t id, int is_register, void* data) {
-        if (is_register) (static_cast<JackAudioDriver*>(data))->new_ports.push_back(id);
+      [](void* self) {
+        static_cast<JackAudioManager*>(self)->xrun = true;
+        return 0;
       },
       this);
 
-    jack_on_shutdown(client, jackShutdown, nullptr);
-
-    bufferSize = jack_get_buffer_size(client);
-
-    if (jack_activate(client)) {
-      throw global::exception(global::ErrorCode::audio_error, "Cannot activate jack client");
-    }
-
-    setupPorts();
+    jack_on_shutdown(
+      client, [](void*) { Application::current().exit(Application::ErrorCode::audio_error); }, nullptr);
 
-    LOG_F(INFO, "Initialized JackAudio");
+    apply_settings(jack_get_sample_rate(client), jack_get_buffer_size(client));
+    LOGI("Opened JACK client at {} Hz, {} frames", samplerate(), buffer_size());
   }
 
-  void JackAudioDriver::shutdown()
+  void JackAudioManager::restart(int samplerate, int buffer_size)
   {
-    LOG_F(INFO, "Closing Jack client");
-    jack_client_close(client);
-  }
-
-  void JackAudioDriver::send_midi_event(core::midi::AnyMidiEvent evt) noexcept
-  {
-    midi_bufs.outer().emplace_back(std::move(evt));
+    // The buffer size callback applies the new size
+    if (buffer_size != int(_buffer_size) && jack_set_buffer_size(client, buffer_size) != 0) {
+      LOGE("JACK could not change the buffer size to {}", buffer_size);
+    }
+    LOGW_IF(samplerate != _samplerate, "The sample rate is set by the JACK server, and stays at {} Hz", _samplerate);
   }
 
-  void JackAudioDriver::setupPorts()
+  void JackAudioManager::init_ports()
   {
-    // Audio ports
-    ports.input = jack_port_register(client, "input", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
-
-    if (ports.input == NULL) {
-      throw global::exception(global::ErrorCode::audio_error, "Couldn't register input port");
+    ports.input = jack_port_register(client, "in", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+    ports.out_left = jack_port_register(client, "out_left", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    ports.out_right = jack_port_register(client, "out_right", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    ports.midi_in = jack_port_register(client, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    ports.midi_out = jack_port_register(client, "midi_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+    if (!ports.input || !ports.out_left || !ports.out_right || !ports.midi_in || !ports.midi_out) {
+      throw Application::exception(Application::ErrorCode::audio_error, "Could not register the JACK ports");
     }
 
-    ports.outL =
-      jack_port_register(client, "outLeft", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
-    ports.outR =
-      jack_port_register(client, "outRight", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
-
-    auto inputs = findPorts(JackPortIsPhysical | JackPortIsOutput);
-    auto outputs = findPorts(JackPortIsPhysical | JackPortIsInput);
-
-    if (outputs.empty()) {
-      throw global::exception(global::ErrorCode::audio_error,
-                              "Couldn't find physical output ports");
-    }
-
-    bool s;
-
-    for (auto& p : inputs) {
-      s = connectPorts(jack_port_name(ports.input), p);
-      if (!s) {
-        global::exit(global::ErrorCode::audio_error);
-        return;
-      }
-    }
-
-    s = connectPorts(outputs[0 % outputs.size()], jack_port_name(ports.outL));
-    if (!s) {
-      global::exit(global::ErrorCode::audio_error);
-      return;
+    // Ports can only be connected once the client is active
+    if (jack_activate(client)) {
+      throw Application::exception(Application::ErrorCode::audio_error, "Could not activate the JACK client");
     }
 
-    s = connectPorts(outputs[1 % outputs.size()], jack_port_name(ports.outR));
-    if (!s) {
-      global::exit(global::ErrorCode::audio_error);
-      return;
+    auto playback = find_ports(JackPortIsPhysical | JackPortIsInput);
+    if (playback.empty()) {
+      throw Application::exception(Application::ErrorCode::audio_error, "Found no physical JACK playback ports");
     }
+    connect_ports(jack_port_name(ports.out_left), playback[0]);
+    connect_ports(jack_port_name(ports.out_right), playback[1 % playback.size()]);
 
-    // Midi ports
-    ports.midiIn = jack_port_register(client, "midiIn", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    auto capture = find_ports(JackPortIsPhysical | JackPortIsOutput);
+    if (!capture.empty()) connect_ports(capture[0], jack_port_name(ports.input));
 
-    if (ports.midiIn == NULL) {
-      throw global::exception(global::ErrorCode::audio_error, "Couldn't register midi_in port");
+    for (auto& port : find_ports(JackPortIsPhysical | JackPortIsOutput, PortType::midi)) {
+      connect_ports(port, jack_port_name(ports.midi_in));
     }
-
-    ports.midiOut =
-      jack_port_register(client, "midiOut", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
-
-    auto midiIn = findPorts(JackPortIsPhysical | JackPortIsOutput, PortType::Midi);
-    auto midiOut = findPorts(JackPortIsPhysical | JackPortIsInput, PortType::Midi);
-
-    if (midiIn.empty()) {
-      LOGE("Couldn't find physical midi input port");
-      return;
-    }
-    if (midiOut.empty()) {
-      LOGE("Couldn't find physical midi output port");
-      return;
-    }
-
-    s = connectPorts(jack_port_name(ports.midiIn), midiIn[0]);
-    LOGE_IF(!s, "Couldn't connect midi input");
-
-    s = connectPorts(midiOut[0], jack_port_name(ports.midiOut));
-    LOGE_IF(!s, "Couldn't connect midi output");
-  }
-
-  std::vector<std::string> JackAudioDriver::findPorts(int criteria, PortType type)
-  {
-    const char** ports =
-      jack_get_ports(client, nullptr, (type == PortType::Audio) ? "audio" : "midi", criteria);
-    std::vector<std::string> ret;
-    if (ports == nullptr) return ret;
-    for (int i = 0; ports[i] != nullptr; i++) {
-      ret.emplace_back(ports[i]);
+    for (auto& port : find_ports(JackPortIsPhysical | JackPortIsInput, PortType::midi)) {
+      connect_ports(jack_port_name(ports.midi_out), port);
     }
-    jack_free(ports);
-    return ret;
   }
 
-  /// Helper function for connections
-  bool JackAudioDriver::connectPorts(const std::string& src, const std::string& dest)
+  std::vector<std::string> JackAudioManager::find_ports(unsigned long flags, PortType type)
   {
-    return !jack_connect(client, dest.c_str(), src.c_str());
+    const char** names =
+      jack_get_ports(client, nullptr, type == PortType::audio ? JACK_DEFAULT_AUDIO_TYPE : JACK_DEFAULT_MIDI_TYPE, flags);
+    std::vector<std::string> res;
+    if (names == nullptr) return res;
+    for (int i = 0; names[i] != nullptr; i++) res.emplace_back(names[i]);
+    jack_free(names);
+    return res;
   }
 
-  void JackAudioDriver::samplerateCallback(unsigned srate)
+  bool JackAudioManager::connect_ports(const std::string& from, const std::string& to)
   {
-    LOG_F(INFO, "Jack changed the sample rate to {}", srate);
-    samplerate = srate;
-    audio::events::samplerate_change().fire(srate);
-  }
-
-  void JackAudioDriver::buffersizeCallback(unsigned buffsize)
-  {
-    LOG_F(INFO, "Jack changed the buffer size to {}", buffsize);
-    bufferSize = buffsize;
-    audio::events::buffersize_change().fire(buffsize);
-    _buffer_pool = std::make_unique<AudioBufferPool>(bufferSize);
+    int err = jack_connect(client, from.c_str(), to.c_str());
+    if (err != 0 && err != EEXIST) {
+      LOGE("Could not connect JACK port {} to {}", from, to);
+      return false;
+    }
+    DLOGI("Connected JACK port {} to {}", from, to);
+    return true;
   }
 
-  void JackAudioDriver::new_port_callback(jack_port_id_t id)
+  void JackAudioManager::read_midi_input(core::midi::MidiBuffer& buf, jack_nframes_t nframes)
   {
-    DLOGI("New port");
-    auto* port = jack_port_by_id(client, id);
-    auto flags = jack_port_flags(port);
-    auto type = jack_port_type(port);
-    if (type != nullptr && strcmp(type, JACK_DEFAULT_MIDI_TYPE) == 0) {
-      if (flags & JackPortIsInput) {
-        auto portname = jack_port_name(port);
-        auto port2name = jack_port_name(ports.midiOut);
-        if (portname && port2name) connectPorts(portname, port2name);
-      } else if (flags & JackPortIsOutput) {
-        auto portname = jack_port_name(port);
-        auto port2name = jack_port_name(ports.midiIn);
-        if (portname && port2name) connectPorts(port2name, portname);
-      }
+    void* port_buf = jack_port_get_buffer(ports.midi_in, nframes);
+    jack_nframes_t count = jack_midi_get_event_count(port_buf);
+    for (jack_nframes_t i = 0; i < count; i++) {
+      jack_midi_event_t event;
+      if (jack_midi_event_get(&event, port_buf, i) != 0) continue;
+      using Kind = core::midi::MidiParser::Kind;
+      midi_parser.parse({event.buffer, std::ptrdiff_t(event.size)}, [&](const core::midi::MidiParser::Message& msg) {
+        if (msg.kind == Kind::channel) {
+          auto evt = msg.event;
+          evt.time = event.time;
+          // Full buffers count the overflow themselves
+          buf.push_back(evt);
+        } else if (msg.kind == Kind::realtime) {
+          if (!midi_clock_in) midi_clock_in = MidiClockInput::create(ClockManager::current());
+          if (midi_clock_in) {
+            midi_clock_in->receive(msg.status, double(jack_last_frame_time(client) + event.time) / _samplerate);
+          }
+        }
+      });
     }
   }
 
-  void JackAudioDriver::gatherMidiInput(int nframes)
+  void JackAudioManager::send_midi_clock(ClockManager& clock_manager, void* midi_out_buf)
   {
-    midi_bufs.swap();
-
-    // Get new midi events
-    void* midiBuf = jack_port_get_buffer(ports.midiIn, nframes);
-    int nevents = jack_midi_get_event_count(midiBuf);
-
-    jack_midi_event_t event;
-    for (int i = 0; i < nevents; i++) {
-      using namespace core::midi;
-
-      jack_midi_event_get(&event, midiBuf, i);
-      MidiEvent mEvent;
-
-      mEvent.channel = event.buffer[0] & 0b00001111;
-      std::copy_n(event.buffer + 1, std::min(event.size - 1, mEvent.max_data_size),
-                  mEvent.data.begin());
-      mEvent.time = event.time;
-
-      auto type = MidiEvent::Type(event.buffer[0] >> 4);
-      switch (type) {
-      case MidiEvent::Type::NoteOff:
-        mEvent.type = MidiEvent::Type::NoteOff;
-        midi_bufs.inner().emplace_back(NoteOffEvent(mEvent));
-        break;
-      case MidiEvent::Type::NoteOn:
-        mEvent.type = MidiEvent::Type::NoteOn;
-        midi_bufs.inner().emplace_back(NoteOnEvent(mEvent));
-        break;
-      case MidiEvent::Type::ControlChange:
-        mEvent.type = MidiEvent::Type::ControlChange;
-        midi_bufs.inner().emplace_back(ControlChangeEvent(mEvent));
-        break;
-      }
+    // Don't echo an external clock back
+    if (clock_manager.active_source() == ClockManager::Source::midi) return;
+    if (clock_manager.running() != midi_clock_out_running) {
+      midi_clock_out_running = clock_manager.running();
+      jack_midi_data_t msg = midi_clock_out_running ? 0xFA : 0xFC;
+      jack_midi_event_write(midi_out_buf, 0, &msg, 1);
+    }
+    for (auto& tick : clock_manager.ticks()) {
+      jack_midi_data_t msg = 0xF8;
+      jack_midi_event_write(midi_out_buf, tick.frame, &msg, 1);
     }
   }
 
-  void JackAudioDriver::process(int nframes)
+  int JackAudioManager::process(jack_nframes_t nframes)
   {
-    auto running = audio::running() && global::running();
-    if (!running) {
-      return;
-    }
-
-    if (!new_ports.empty()) {
-      for (auto port : new_ports) {
-        new_port_callback(port);
-      }
-      new_ports.clear();
+    // JACK sets the priority of its thread, but leaves it free to move between cores
+    prepare_audio_thread();
+    TIME_SCOPE("Audio callback");
+    util::RealtimeScope realtime;
+    util::audio::FlushDenormals flush_denormals;
+    auto* out_left = static_cast<float*>(jack_port_get_buffer(ports.out_left, nframes));
+    auto* out_right = static_cast<float*>(jack_port_get_buffer(ports.out_right, nframes));
+    void* midi_out_buf = jack_port_get_buffer(ports.midi_out, nframes);
+    jack_midi_clear_buffer(midi_out_buf);
+
+    auto running = this->running() && Application::current().running();
+    if (!running || nframes > _buffer_size) {
+      RTLOGE_IF(running, "JACK requested more frames than expected");
+      std::fill_n(out_left, nframes, 0.f);
+      std::fill_n(out_right, nframes, 0.f);
+      finish_buffer();
+      return 0;
     }
 
-    TIME_SCOPE("JackAudio::Process");
+    clock::time_point t0 = clock::now();
 
-    if ((size_t) nframes > bufferSize) {
-      LOGE("Jack requested more frames than expected");
-      return;
-    }
+    core::props::AudioThreadQueue::get().process_changes();
+    auto& clock_manager = ClockManager::current();
+    clock_manager.process(nframes, _samplerate);
+    send_midi_clock(clock_manager, midi_out_buf);
 
-    gatherMidiInput(nframes);
+    // The engines get the port buffer as their input, without a copy
+    core::audio::AudioBufferRefCount ref_count;
+    auto* in_data = static_cast<float*>(jack_port_get_buffer(ports.input, nframes));
+    core::audio::AudioBufferHandle in_buf(in_data, nframes, ref_count);
 
-    float* outLData = (float*) jack_port_get_buffer(ports.outL, nframes);
-    float* outRData = (float*) jack_port_get_buffer(ports.outR, nframes);
-    float* inData = (float*) jack_port_get_buffer(ports.input, nframes);
+    auto& midi_in = collect_midi();
+    read_midi_input(midi_in, nframes);
+    midi_in.sort_by_time();
 
-    int ref_count = 0;
-    auto in_buf = AudioBufferHandle(inData, nframes, ref_count);
-    auto out_data =
-      engines::process({in_buf,
-                        {midi_bufs.inner()},
-                        nframes});
+    auto context = make_context();
+    clock::time_point engines_t0 = clock::now();
+    auto out = Application::current().engine_manager->process({std::move(in_buf), midi_in, nframes, &context});
+    clock::time_point engines_t1 = clock::now();
 
-    audio::process_audio_output(out_data);
+    RTLOGW_IF(out.nframes != long(nframes), "Frames went missing!");
 
-    LOGW_IF(out_data.nframes != nframes, "Frames went missing!");
+    // The ports are not interleaved, so each channel is one contiguous copy
+    std::copy_n(out.audio[0].data(), nframes, out_left);
+    std::copy_n(out.audio[1].data(), nframes, out_right);
 
-    // Separate channels
-    for (int i = 0; i < nframes; i++) {
-      outLData[i] = std::get<0>(out_data.audio[i]);
-      outRData[i] = std::get<1>(out_data.audio[i]);
+    for (auto& ev : out.midi) {
+      auto bytes = ev.to_bytes();
+      auto time = std::clamp(ev.time, 0, int(nframes) - 1);
+      jack_midi_event_write(midi_out_buf, time, bytes.data(), ev.byte_size());
     }
+
+    _midi_overflow_count += midi_in.overflow_count();
+    out.audio[0].release();
+    out.audio[1].release();
+    buffer_pool().check_leaks();
+
+    clock::time_point t1 = clock::now();
+
+    record_cpu_time(t1 - t0, engines_t1 - engines_t0);
+    // JACK does not say which way an xrun went
+    bool had_xrun = xrun.exchange(false, std::memory_order_relaxed);
+    record_callback(t0, t1, nframes, false, had_xrun);
+    finish_buffer();
+
+    return 0;
   }
-} // namespace otto::service::audio
+
+} // namespace otto::services
+
+// kak: other_file=../include/board/audio_driver.hpp
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+
+#include "core/audio/input_recording.hpp"
+#include "core/audio/midi_sequence.hpp"
+#include "util/filesystem.hpp"
+
+#include "services/audio_manager.hpp"
+
+namespace otto::services {
+
+  /// An audio manager without a device, which renders to a file as fast as possible
+  ///
+  /// The engines are driven from a @ref core::midi::MidiSequence instead of a midi input, and
+  /// buffers are processed exactly like in a realtime driver, just without waiting for the
+  /// device. This is used for regression renders, profiling the whole chain, and bouncing.
+  struct OfflineAudioManager final : AudioManager {
+    enum struct ErrorCode {
+      /// The output file could not be written
+      write_failed,
+    };
+
+    using exception = util::as_exception<ErrorCode>;
+
+    struct Config {
+      int samplerate = 48000;
+      int buffer_size = 256;
+      /// Seconds of audio to render after the last event, to let voices and effects ring out
+      double tail = 2;
+      /// The bit depth of the output file. One of 8, 16 or 24
+      int bit_depth = 24;
+    };
+
+    OfflineAudioManager(Config config);
+
+    /// Process the sequence through the engines, and write the output to a wav file
+    ///
+    /// Events are processed at their exact frame offsets. If more events fall into one buffer
+    /// than a midi buffer fits, the rest are delayed to the start of the next buffer. Events
+    /// sent with @ref send_midi_event while rendering are added to the next buffer.
+    ///
+    /// \requires The engine manager has been started
+    /// \returns the number of frames rendered
+    /// \throws `exception` with `ErrorCode::write_failed`
+    long render(const core::midi::MidiSequence& sequence, const filesystem::path& output);
+
+    /// Replay a recording of the midi and property changes of a live performance
+    ///
+    /// Each record goes into the buffer it was recorded in, the midi at its frame in the
+    /// buffer, and the property changes before the buffer, followed by the tail. For the render
+    /// to match the performance, the sample rate and buffer size of the config must be those of
+    /// the recording, and the state must be the one saved with it.
+    ///
+    /// \requires The engine manager has been started
+    /// \returns the number of frames rendered
+    /// \throws `exception` with `ErrorCode::write_failed`
+    long render(const core::audio::InputRecording& recording, const filesystem::path& output);
+
+  private:
+    /// Called before each buffer with its midi, the frame it starts at, and its length
+    using Feed = std::function<void(core::midi::MidiBuffer& midi, long offset, int nframes)>;
+
+    /// Render `total` frames, fed by `feed`, and write them to `output`
+    long render(long total, const Feed& feed, const filesystem::path& output);
+
+    /// The settings come from the command line, so the ones saved in the state are ignored
+    void restart(int samplerate, int buffer_size) override;
+
+    Config _config;
+  };
+
+} // namespace otto::services
+
+// kak: other_file=../../src/audio_driver.cpp
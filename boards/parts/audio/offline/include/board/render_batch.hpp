@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "util/exception.hpp"
+#include "util/filesystem.hpp"
+
+namespace otto::services {
+
+  /// Renders many files at once, like preset previews and regression renders
+  ///
+  /// The engines are services of the one @ref Application of a process, so each render runs in
+  /// a process of its own, with its own engines. A thread per core takes the next job whenever
+  /// its last one finishes, so the renders spread over all cores even when they differ in
+  /// length. Each render runs its routing graph serially, since the batch already uses the
+  /// cores, which is what lets it scale with their number.
+  struct RenderBatch {
+    enum struct ErrorCode {
+      /// The batch file could not be read
+      read_failed,
+    };
+
+    using exception = util::as_exception<ErrorCode>;
+
+    struct Job {
+      /// The command line arguments of the render, like `in.mid out.wav --tail 4`
+      std::vector<std::string> args;
+    };
+
+    /// Read a batch file
+    ///
+    /// Each line is a job, with the arguments of a single render, separated by whitespace.
+    /// Empty lines and lines starting with `#` are skipped.
+    ///
+    /// \throws `exception` with `ErrorCode::read_failed`
+    static std::vector<Job> load(const filesystem::path& path);
+
+    /// `executable` is run for each job, with `common_args` followed by the arguments of the job
+    RenderBatch(std::string executable, std::vector<std::string> common_args, std::vector<Job> jobs);
+
+    /// Run all jobs, `parallel` at a time, or one per core if it is 0
+    ///
+    /// \returns the number of jobs that failed
+    int run(int parallel = 0);
+
+  private:
+    /// Run job `index`, and wait for it
+    ///
+    /// \returns whether it succeeded
+    bool run_job(std::size_t index);
+
+    std::string _executable;
+    std::vector<std::string> _common_args;
+    std::vector<Job> _jobs;
+  };
+
+} // namespace otto::services
+
+// kak: other_file=../../src/render_batch.cpp
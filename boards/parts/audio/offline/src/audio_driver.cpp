@@ -0,0 +1,136 @@
+#include "board/audio_driver.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include <AudioFile.h>
+
+#include "core/props/props.hpp"
+
+#include "services/clock_manager.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "util/audio.hpp"
+
+namespace otto::services {
+
+  OfflineAudioManager::OfflineAudioManager(Config config) : _config(config)
+  {
+    apply_settings(config.samplerate, config.buffer_size);
+  }
+
+  void OfflineAudioManager::restart(int, int)
+  {
+    LOGI("Offline: ignoring the saved audio settings, in favour of the command line");
+  }
+
+  long OfflineAudioManager::render(const core::midi::MidiSequence& sequence,
+                                   const filesystem::path& output)
+  {
+    const int samplerate = _samplerate;
+    auto next = sequence.events.begin();
+    auto frame_of = [&](const core::midi::MidiSequence::Event& evt) {
+      return std::lround(evt.time * samplerate);
+    };
+    auto feed = [&](core::midi::MidiBuffer& midi, long offset, int nframes) {
+      for (; next != sequence.events.end() && frame_of(*next) < offset + nframes; ++next) {
+        if (midi.size() == midi.capacity) break;
+        auto evt = next->event;
+        evt.time = std::max(0l, frame_of(*next) - offset);
+        midi.push_back(evt);
+      }
+    };
+    return render(std::ceil((sequence.length() + _config.tail) * samplerate), feed, output);
+  }
+
+  long OfflineAudioManager::render(const core::audio::InputRecording& recording,
+                                   const filesystem::path& output)
+  {
+    LOGW_IF(recording.samplerate != _samplerate || recording.buffer_size != _buffer_size,
+            "Replaying a recording made at {} Hz with buffers of {}, at {} Hz with buffers of {}",
+            recording.samplerate, recording.buffer_size, _samplerate, _buffer_size);
+    auto& engines = *Application::current().engine_manager;
+    std::vector<core::engine::IEngine*> parts;
+    for (auto& name : recording.parts) {
+      parts.push_back(engines.by_name(name));
+      LOGW_IF(parts.back() == nullptr, "Replay: no engine {}", name);
+    }
+
+    auto next_midi = recording.midi.begin();
+    auto next_property = recording.properties.begin();
+    std::uint32_t buffer = 0;
+    auto feed = [&](core::midi::MidiBuffer& midi, long, int) {
+      // Before the changes are processed, like on the UI thread between two buffers
+      for (; next_property != recording.properties.end() && next_property->buffer <= buffer; ++next_property) {
+        auto* engine = next_property->part < parts.size() ? parts[next_property->part] : nullptr;
+        int index = engine ? engine->find_property(next_property->hash) : -1;
+        if (index >= 0) engine->set_property(index, next_property->value);
+      }
+      for (; next_midi != recording.midi.end() && next_midi->buffer <= buffer; ++next_midi) {
+        if (midi.size() == midi.capacity) break;
+        midi.push_back(next_midi->event);
+      }
+      buffer++;
+    };
+    return render(long(recording.length()) * _buffer_size + std::ceil(_config.tail * _samplerate), feed, output);
+  }
+
+  long OfflineAudioManager::render(long total, const Feed& feed, const filesystem::path& output)
+  {
+    const int samplerate = _samplerate;
+    std::vector<std::vector<float>> samples(2, std::vector<float>(total));
+
+    auto& app = Application::current();
+    auto t0 = clock::now();
+    long offset = 0;
+    for (; offset < total && running() && app.running(); offset += _buffer_size) {
+      int nframes = std::min<long>(_buffer_size, total - offset);
+      auto buffer_t0 = clock::now();
+      // Like the real-time drivers, so the render sounds the same
+      util::audio::FlushDenormals flush_denormals;
+
+      auto& midi = collect_midi();
+      feed(midi, offset, nframes);
+      core::props::AudioThreadQueue::get().process_changes();
+      ClockManager::current().process(nframes, samplerate);
+
+      auto context = make_context();
+      auto engines_t0 = clock::now();
+      auto out = app.engine_manager->process({buffer_pool().allocate_clear(), midi, nframes, &context});
+      auto engines_t1 = clock::now();
+      LOGW_IF(out.nframes != nframes, "Frames went missing!");
+      for (int ch = 0; ch < 2; ch++) {
+        std::copy(out.audio[ch].begin(), out.audio[ch].begin() + nframes,
+                  samples[ch].begin() + offset);
+      }
+
+      _midi_overflow_count += midi.overflow_count();
+      out.audio[0].release();
+      out.audio[1].release();
+      buffer_pool().check_leaks();
+      record_cpu_time(clock::now() - buffer_t0, engines_t1 - engines_t0);
+      finish_buffer();
+    }
+    auto t1 = clock::now();
+
+    double seconds = std::chrono::duration<double>(t1 - t0).count();
+    LOGI("Rendered {:.2f}s of audio in {:.2f}s, {:.1f}x realtime", offset / double(samplerate),
+         seconds, offset / double(samplerate) / seconds);
+
+    // Keep what was rendered if rendering was stopped early
+    for (auto& channel : samples) channel.resize(std::min(offset, total));
+    AudioFile<float> file;
+    file.setSampleRate(samplerate);
+    file.setBitDepth(_config.bit_depth);
+    file.samples = std::move(samples);
+    if (!file.save(output.string())) {
+      throw exception(ErrorCode::write_failed, "Could not write {}", output.string());
+    }
+    return std::min(offset, total);
+  }
+
+} // namespace otto::services
+
+// kak: other_file=../include/board/audio_driver.hpp
@@ -0,0 +1,98 @@
+#include "board/render_batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+extern char** environ;
+
+namespace otto::services {
+
+  std::vector<RenderBatch::Job> RenderBatch::load(const filesystem::path& path)
+  {
+    std::ifstream file(path.string());
+    if (!file) throw exception(ErrorCode::read_failed, "Could not read {}", path.string());
+    std::vector<Job> jobs;
+    std::string line;
+    while (std::getline(file, line)) {
+      std::istringstream words(line);
+      Job job;
+      for (std::string word; words >> word;) job.args.push_back(word);
+      if (job.args.empty() || job.args[0][0] == '#') continue;
+      jobs.push_back(std::move(job));
+    }
+    return jobs;
+  }
+
+  RenderBatch::RenderBatch(std::string executable,
+                           std::vector<std::string> common_args,
+                           std::vector<Job> jobs)
+    : _executable(std::move(executable)), _common_args(std::move(common_args)), _jobs(std::move(jobs))
+  {}
+
+  int RenderBatch::run(int parallel)
+  {
+    if (parallel <= 0) parallel = std::max(1u, std::thread::hardware_concurrency());
+    parallel = std::min<int>(parallel, _jobs.size());
+    LOGI("Rendering {} jobs, {} at a time", _jobs.size(), parallel);
+
+    // The renders inherit this, so they do not compete with each other for the cores
+    ::setenv("OTTO_GRAPH_WORKERS", "0", 1);
+
+    // The jobs are whole processes, so taking the next one from a shared counter balances
+    // the load as well as stealing would
+    std::atomic_size_t next = 0;
+    std::atomic_int failed = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < parallel; i++) {
+      workers.push_back(util::start_thread(util::ThreadClass::io, [&] {
+        for (std::size_t job = next++; job < _jobs.size(); job = next++) {
+          if (!run_job(job)) failed++;
+        }
+      }));
+    }
+    for (auto& worker : workers) worker.join();
+    auto t1 = std::chrono::steady_clock::now();
+
+    LOGI("Rendered {} jobs in {:.2f}s, {} failed", _jobs.size(),
+         std::chrono::duration<double>(t1 - t0).count(), failed.load());
+    return failed;
+  }
+
+  bool RenderBatch::run_job(std::size_t index)
+  {
+    std::vector<std::string> args = {_executable};
+    args.insert(args.end(), _common_args.begin(), _common_args.end());
+    args.insert(args.end(), _jobs[index].args.begin(), _jobs[index].args.end());
+    std::vector<char*> argv;
+    for (auto& arg : args) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    if (int err = ::posix_spawnp(&pid, _executable.c_str(), nullptr, nullptr, argv.data(), environ); err != 0) {
+      LOGE("Job {}: could not start {}: {}", index, _executable, std::strerror(err));
+      return false;
+    }
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) return true;
+    LOGE("Job {} ({}) failed with status {}", index, _jobs[index].args[0], status);
+    return false;
+  }
+
+} // namespace otto::services
+
+// kak: other_file=../include/board/render_batch.hpp
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <gsl/span>
+
+#include "core/audio/midi.hpp"
+
+#include "services/audio_manager.hpp"
+
+namespace otto::services {
+
+  /// An audio manager driven by a plugin host
+  ///
+  /// There is no device and no thread of its own. The host calls @ref process with its buffers,
+  /// on whichever thread it picks, and the settings come from the host instead of the state.
+  struct PluginAudioManager final : AudioManager {
+    /// \param max_buffer_size The most frames the host passes to one call of @ref process
+    PluginAudioManager(int samplerate, int max_buffer_size);
+
+    /// Process one buffer of the host
+    ///
+    /// Buffers longer than @ref buffer_size are processed in chunks. The times of `events` are
+    /// frames from the start of the buffer, and the events have to be sorted by time. `input`
+    /// may be the same buffer as `out_left`, for hosts that process in place.
+    void process(const float* input,
+                 float* out_left,
+                 float* out_right,
+                 int nframes,
+                 gsl::span<const core::midi::AnyMidiEvent> events) noexcept;
+
+  private:
+    /// The settings come from the host, so the ones saved in the state are ignored
+    void restart(int samplerate, int buffer_size) override;
+
+    /// Process at most @ref buffer_size frames, starting `offset` frames into the buffer of the
+    /// host
+    void process_chunk(const float* input,
+                       float* out_left,
+                       float* out_right,
+                       int nframes,
+                       int offset,
+                       gsl::span<const core::midi::AnyMidiEvent> events) noexcept;
+  };
+
+} // namespace otto::services
+
+// kak: other_file=../../src/audio_driver.cpp
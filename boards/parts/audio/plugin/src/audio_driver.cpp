@@ -0,0 +1,99 @@
+#include "board/audio_driver.hpp"
+
+#include <algorithm>
+
+#include "core/props/props.hpp"
+
+#include "services/clock_manager.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "util/audio.hpp"
+
+namespace otto::services {
+
+  PluginAudioManager::PluginAudioManager(int samplerate, int max_buffer_size)
+  {
+    apply_settings(samplerate, max_buffer_size);
+  }
+
+  void PluginAudioManager::restart(int, int)
+  {
+    LOGI("Plugin: ignoring the saved audio settings, in favour of the host");
+  }
+
+  void PluginAudioManager::process(const float* input,
+                                   float* out_left,
+                                   float* out_right,
+                                   int nframes,
+                                   gsl::span<const core::midi::AnyMidiEvent> events) noexcept
+  {
+    // The host owns the thread, so it is neither pinned nor prefaulted like in the real-time
+    // drivers
+    util::audio::FlushDenormals flush_denormals;
+    const int chunk = _buffer_size;
+    for (int offset = 0; offset < nframes; offset += chunk) {
+      int n = std::min(chunk, nframes - offset);
+      // Events past the end of the buffer go into the last chunk, so none are lost
+      bool is_last = offset + n == nframes;
+      auto first = std::find_if(events.begin(), events.end(), [&](auto& evt) { return evt.time >= offset; });
+      auto last = is_last ? events.end() : std::find_if(first, events.end(), [&](auto& evt) {
+        return evt.time >= offset + n;
+      });
+      process_chunk(input + offset, out_left + offset, out_right + offset, n, offset,
+                    events.subspan(first - events.begin(), last - first));
+    }
+  }
+
+  void PluginAudioManager::process_chunk(const float* input,
+                                         float* out_left,
+                                         float* out_right,
+                                         int nframes,
+                                         int offset,
+                                         gsl::span<const core::midi::AnyMidiEvent> events) noexcept
+  {
+    auto& app = Application::current();
+    if (!running() || !app.running()) {
+      std::fill_n(out_left, nframes, 0.f);
+      std::fill_n(out_right, nframes, 0.f);
+      finish_buffer();
+      return;
+    }
+    auto t0 = clock::now();
+
+    // Each instance has its own queue of property changes, in its application
+    app.audio_thread_queue->process_changes();
+    ClockManager::current().process(nframes, _samplerate);
+
+    auto& midi_in = collect_midi();
+    for (auto evt : events) {
+      evt.time = std::min(evt.time - offset, nframes - 1);
+      midi_in.push_back(evt);
+    }
+    midi_in.sort_by_time();
+
+    // The engines get the output buffer of the host as their input, which they may write to,
+    // unlike the input of the host
+    if (input != out_left) std::copy_n(input, nframes, out_left);
+    core::audio::AudioBufferRefCount ref_count;
+    core::audio::AudioBufferHandle in_buf(out_left, nframes, ref_count);
+
+    auto context = make_context();
+    auto engines_t0 = clock::now();
+    auto out = app.engine_manager->process({std::move(in_buf), midi_in, nframes, &context});
+    auto engines_t1 = clock::now();
+    RTLOGW_IF(out.nframes != nframes, "Frames went missing!");
+
+    if (out.audio[0].data() != out_left) std::copy_n(out.audio[0].data(), nframes, out_left);
+    if (out.audio[1].data() != out_right) std::copy_n(out.audio[1].data(), nframes, out_right);
+
+    _midi_overflow_count += midi_in.overflow_count();
+    out.audio[0].release();
+    out.audio[1].release();
+    buffer_pool().check_leaks();
+    record_cpu_time(clock::now() - t0, engines_t1 - engines_t0);
+    finish_buffer();
+  }
+
+} // namespace otto::services
+
+// kak: other_file=../include/board/audio_driver.hpp
@@ -6,6 +6,8 @@
 #include <optional>
 
 #include "core/audio/midi.hpp"
+#include "core/audio/midi_parser.hpp"
+#include "core/audio/midi_sender.hpp"
 #include "core/audio/processor.hpp"
 #include "util/locked.hpp"
 
@@ -13,6 +15,7 @@
 #include <RtMidi.h>
 
 #include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
 
 namespace otto::services {
 
@@ -27,14 +30,41 @@ namespace otto::services {
                  double stream_time,
                  RtAudioStreamStatus stream_status);
 
+    /// Open and start the stream with @ref _samplerate and @ref _buffer_size
     void init_audio();
     void init_midi();
 
+    void restart(int samplerate, int buffer_size) override;
+
+    /// Send midi clock messages for the ticks of the current buffer
+    ///
+    /// \param due The time the first frame of the buffer is due at the output
+    void send_midi_clock(ClockManager&, clock::time_point due);
+
+    /// The duration of `frames` at the current sample rate
+    clock::duration frames_to_duration(int frames) const noexcept
+    {
+      return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(double(frames) / _samplerate));
+    }
+
     RtAudio client;
     // optional is used to delay construction to the init phaase, where errros can be handled
     std::optional<RtMidiIn> midi_in = std::nullopt;
     std::optional<RtMidiOut> midi_out = std::nullopt;
+    /// Sends to `midi_out`, so the audio callback makes no system calls for the midi output
+    std::optional<core::midi::MidiSender> midi_sender = std::nullopt;
     bool enable_input = true;
+    /// The input of the engines when @ref enable_input is false
+    std::vector<float> silence;
+
+    /// Only used on the midi thread
+    core::midi::MidiParser midi_parser;
+    /// The sum of midi input timestamps. Only used on the midi thread.
+    double midi_in_time = 0;
+    /// Created on the first real-time message. Only used on the midi thread.
+    tl::optional<MidiClockInput> midi_clock_in = tl::nullopt;
+    /// Whether a midi start has been sent since the last stop
+    bool midi_clock_out_running = false;
   };
 
 } // namespace otto::service::audio
@@ -7,15 +7,18 @@
 #include <fmt/format.h>
 
 #include "util/algorithm.hpp"
+#include "util/audio.hpp"
+#include "util/rt_check.hpp"
+#include "util/timer.hpp"
 
 #include "core/audio/processor.hpp"
+#include "core/props/props.hpp"
 
 #include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
 #include "services/engine_manager.hpp"
 #include "services/log_manager.hpp"
 
-#include <Gamma/Domain.h>
-
 namespace otto::services {
 
   RTAudioAudioManager::RTAudioAudioManager()
@@ -63,10 +66,9 @@ namespace otto::services {
                           return self->process((float*) out, (float*) in , nframes, time, status);
                         },
                         this, &options);
-      _buffer_size = buf_siz;
-      buffer_pool().set_buffer_size(buf_siz);
+      apply_settings(_samplerate, buf_siz);
+      silence.assign(buf_siz, 0.f);
       client.startStream();
-      gam::sampleRate(samplerate());
     } catch (RtAudioError& e) {
       e.printMessage();
       if (enable_input) {
@@ -79,6 +81,26 @@ namespace otto::services {
     }
   }
 
+  void RTAudioAudioManager::restart(int samplerate, int buffer_size)
+  {
+    if (client.isStreamOpen()) client.closeStream();
+    int old_samplerate = _samplerate;
+    int old_buffer_size = _buffer_size;
+    _samplerate = samplerate;
+    _buffer_size = buffer_size;
+    enable_input = true;
+    try {
+      init_audio();
+    } catch (RtAudioError& e) {
+      LOGE("Could not open the stream at {} Hz, {} frames. Going back to {} Hz, {} frames",
+           samplerate, buffer_size, old_samplerate, old_buffer_size);
+      _samplerate = old_samplerate;
+      _buffer_size = old_buffer_size;
+      enable_input = true;
+      init_audio();
+    }
+  }
+
   void RTAudioAudioManager::init_midi()
   {
     midi_out.emplace(RtMidi::Api::UNSPECIFIED, "OTTO");
@@ -92,6 +114,13 @@ namespace otto::services {
         DLOGI("Connected OTTO:out to midi port {}", port);
       }
     }
+    midi_sender.emplace([this](const unsigned char* bytes, std::size_t size) {
+      try {
+        midi_out->sendMessage(bytes, size);
+      } catch (const RtMidiError& error) {
+        LOGE("Midi error: {}", error.getMessage());
+      }
+    });
 
     for (unsigned i = 0; i < midi_in->getPortCount(); i++) {
       auto port = midi_in->getPortName(i);
@@ -102,19 +131,40 @@ namespace otto::services {
       }
     }
 
+    // Receive midi clock, but keep ignoring sysex and active sensing
+    midi_in->ignoreTypes(true, false, true);
     midi_in->setCallback(
       [](double timeStamp, std::vector<unsigned char>* message, void* userData) {
         auto& self = *static_cast<RTAudioAudioManager*>(userData);
-        try {
-          self.send_midi_event(core::midi::from_bytes(*message));
-        } catch (util::exception& e) {
-          LOGE("Error parsing midi: {}", e.what());
-        }
+        // timeStamp is the time since the last message, as measured by the midi api
+        self.midi_in_time += timeStamp;
+        using Kind = core::midi::MidiParser::Kind;
+        self.midi_parser.parse(*message, [&](const core::midi::MidiParser::Message& msg) {
+          if (msg.kind == Kind::channel) {
+            self.send_midi_event(msg.event);
+          } else if (msg.kind == Kind::realtime) {
+            if (!self.midi_clock_in) self.midi_clock_in = MidiClockInput::create(ClockManager::current());
+            if (self.midi_clock_in) self.midi_clock_in->receive(msg.status, self.midi_in_time);
+          }
+        });
       },
       this);
   }
 
-  using clock = std::chrono::high_resolution_clock;
+  void RTAudioAudioManager::send_midi_clock(ClockManager& clock_manager, clock::time_point due)
+  {
+    // Don't echo an external clock back
+    if (!midi_sender || clock_manager.active_source() == ClockManager::Source::midi) return;
+    if (clock_manager.running() != midi_clock_out_running) {
+      midi_clock_out_running = clock_manager.running();
+      unsigned char msg = midi_clock_out_running ? 0xFA : 0xFC;
+      midi_sender->push(&msg, 1, due);
+    }
+    for (auto& tick : clock_manager.ticks()) {
+      unsigned char msg = 0xF8;
+      midi_sender->push(&msg, 1, due + frames_to_duration(tick.frame));
+    }
+  }
 
   int RTAudioAudioManager::process(float* out_data,
                                    float* in_data,
@@ -122,52 +172,65 @@ namespace otto::services {
                                    double stream_time,
                                    RtAudioStreamStatus stream_status)
   {
-    _buffer_number++;
+    prepare_audio_thread();
+    TIME_SCOPE("Audio callback");
+    util::RealtimeScope realtime;
+    util::audio::FlushDenormals flush_denormals;
     auto running = this->running() && Application::current().running();
     if (!running) {
+      finish_buffer();
       return 0;
     }
 
     if ((unsigned) nframes > _buffer_size) {
-      LOGE("RTAudio requested more frames than expected");
+      RTLOGE("RTAudio requested more frames than expected");
+      finish_buffer();
       return 0;
     }
 
     clock::time_point t0 = clock::now();
-
-    midi_bufs.swap();
-
-    int ref_count = 0;
-    auto in_buf = enable_input ? core::audio::AudioBufferHandle(in_data, nframes, ref_count) : Application::current().audio_manager->buffer_pool().allocate_clear();
-    // steal the inner midi buffer
+    // The output plays one buffer after the callback, so midi is scheduled to line up with it
+    clock::time_point due = t0 + frames_to_duration(nframes);
+
+    core::props::AudioThreadQueue::get().process_changes();
+    auto& clock_manager = ClockManager::current();
+    clock_manager.process(nframes, _samplerate);
+    send_midi_clock(clock_manager, due);
+
+    core::audio::AudioBufferRefCount ref_count;
+    core::audio::AudioBufferHandle in_buf(enable_input ? in_data : silence.data(), nframes, ref_count);
+    // Engines add their midi to the same buffer
+    auto& midi_in = collect_midi();
+    auto context = make_context();
+    clock::time_point engines_t0 = clock::now();
     auto out = Application::current().engine_manager->process(
-      {in_buf, {std::move(midi_bufs.inner())}, nframes});
+      {std::move(in_buf), midi_in, nframes, &context});
+    clock::time_point engines_t1 = clock::now();
 
     // process_audio_output(out);
 
-    LOGW_IF(out.nframes != nframes, "Frames went missing!");
+    RTLOGW_IF(out.nframes != nframes, "Frames went missing!");
 
-    // Separate channels
-    for (int i = 0; i < nframes; i++) {
-      out_data[i * 2] = out.audio[0][i];
-      out_data[i * 2 + 1] = out.audio[1][i];
-    }
+    util::audio::interleave(out.audio[0].data(), out.audio[1].data(), out_data, nframes);
 
-    if (midi_out) {
+    if (midi_sender) {
       for (auto& ev : out.midi) {
-        util::match(ev, [this](auto& ev) {
-          auto bytes = ev.to_bytes();
-          midi_out->sendMessage(bytes.data(), bytes.size());
-        });
+        auto bytes = ev.to_bytes();
+        midi_sender->push(bytes.data(), ev.byte_size(), due + frames_to_duration(ev.time));
       }
     }
 
-    // return the midi buffer
-    midi_bufs.inner() = out.midi.move_vector_out();
+    _midi_overflow_count += midi_in.overflow_count();
+    out.audio[0].release();
+    out.audio[1].release();
+    buffer_pool().check_leaks();
 
     clock::time_point t1 = clock::now();
 
-    _cpu_time.add(std::chrono::nanoseconds(t1 - t0).count() / (1e9 / float(_samplerate) * nframes));
+    record_cpu_time(t1 - t0, engines_t1 - engines_t0);
+    record_callback(t0, t1, nframes, stream_status & RTAUDIO_INPUT_OVERFLOW,
+                    stream_status & RTAUDIO_OUTPUT_UNDERFLOW);
+    finish_buffer();
 
     return 0;
   }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <deque>
+
 #include "util/enum.hpp"
 
 #include "core/ui/canvas.hpp"
@@ -17,7 +19,6 @@ namespace otto::board {
     void draw(core::ui::vg::Canvas& ctx) override;
 
     void set_color(services::LED, services::LEDColor) override;
-    void flush_leds() override;
     void clear_leds() override;
 
     void handle_click(core::ui::vg::Point p, ClickAction);
@@ -26,21 +27,47 @@ namespace otto::board {
     constexpr static core::ui::vg::Size size = {1115, 352};
 
   private:
+    /// A button, recorded once as paths, and cached in a layer of its own
+    struct Button {
+      /// The colours of the body of the function and channel keys, or of the sequencer keys
+      enum struct Kind { dark, light };
+
+      Button(services::Key key, Kind kind, core::ui::vg::Path led, core::ui::vg::Path body);
+
+      void draw(core::ui::vg::Canvas& ctx, services::LEDColor color, bool pressed) const;
+
+      services::Key key;
+      Kind kind;
+      core::ui::vg::Path led;
+      core::ui::vg::Path body;
+      /// The area of the board the layer covers
+      core::ui::vg::Box bounds;
+      core::ui::vg::Layer layer;
+
+    private:
+      static core::ui::vg::Box bounds_of(const core::ui::vg::Path& led, const core::ui::vg::Path& body);
+    };
 
     template<typename LEDFunc, typename BTNFunc>
-    void draw_btn(core::ui::vg::Canvas& ctx, services::Key key, LEDFunc&& lf, BTNFunc&& bf);
+    void add_btn(core::ui::vg::Path& ctx, services::Key key, LEDFunc&& lf, BTNFunc&& bf);
 
     template<typename BTNFunc, typename LEDFunc>
-    void draw_s_btn(core::ui::vg::Canvas& ctx, services::Key key, BTNFunc&& bf, LEDFunc&& lf);
+    void add_s_btn(core::ui::vg::Path& ctx, services::Key key, BTNFunc&& bf, LEDFunc&& lf);
 
     template<typename BTNFunc, typename LEDFunc>
-    void draw_c_btn(core::ui::vg::Canvas& ctx, services::Key key, BTNFunc&& bf, LEDFunc&& lf);
+    void add_c_btn(core::ui::vg::Path& ctx, services::Key key, BTNFunc&& bf, LEDFunc&& lf);
 
-    void draw_func_btns(core::ui::vg::Canvas& ctx);
-    void draw_sc_btns(core::ui::vg::Canvas& ctx);
+    /// Draw everything but the buttons
+    void draw_board(core::ui::vg::Canvas& ctx);
     void draw_encoders(core::ui::vg::Canvas& ctx);
-
-    util::enum_map<services::Key, services::LEDColor> _led_colors = {};
+    /// Record the paths of the buttons, the first time the board is drawn
+    void add_func_btns(core::ui::vg::Path& ctx);
+    void add_sc_btns(core::ui::vg::Path& ctx);
+
+    services::LEDBuffer _leds;
+    core::ui::vg::Layer _layer{size};
+    /// A deque, since layers can not be moved
+    std::deque<Button> _buttons;
   };
 
 }
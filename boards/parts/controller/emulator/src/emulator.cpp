@@ -1,5 +1,9 @@
 #include "board/emulator.hpp"
 
+#include <utility>
+
+#include "services/ui_manager.hpp"
+
 namespace otto::board {
 
   using namespace core::ui::vg;
@@ -8,63 +12,109 @@ namespace otto::board {
 
   void Emulator::set_color(LED led, LEDColor color)
   {
-    _led_colors[led.key] = color;
+    // The UI only redraws when something changed
+    if (_leds.set(led, color)) UIManager::current().request_redraw();
   }
-  void Emulator::flush_leds()
+  void Emulator::clear_leds()
   {
-    // NOOP
+    _leds.clear();
+    UIManager::current().request_redraw();
   }
-  void Emulator::clear_leds()
+
+  Emulator::Button::Button(Key key, Kind kind, Path led, Path body)
+    : key(key),
+      kind(kind),
+      led(std::move(led)),
+      body(std::move(body)),
+      bounds(bounds_of(this->led, this->body)),
+      layer(bounds.size())
+  {}
+
+  Box Emulator::Button::bounds_of(const Path& led, const Path& body)
+  {
+    auto a = led.bounds();
+    auto b = body.bounds();
+    // Leave room for the stroke and the antialiasing around it
+    float x0 = std::min(a.x, b.x) - 2;
+    float y0 = std::min(a.y, b.y) - 2;
+    float x1 = std::max(a.x + a.width, b.x + b.width) + 2;
+    float y1 = std::max(a.y + a.height, b.y + b.height) + 2;
+    return {Point(x0, y0), Point(x1, y1)};
+  }
+
+  void Emulator::Button::draw(Canvas& ctx, LEDColor color, bool pressed) const
   {
-    for (auto& col : _led_colors) {
-      col = LEDColor::Black;
+    ctx.lineJoin(Canvas::LineJoin::ROUND);
+    ctx.lineCap(Canvas::LineCap::ROUND);
+    ctx.miterLimit(4);
+    ctx.beginPath();
+    led.add_to(ctx);
+    ctx.fill(Colour::bytes(color.r, color.g, color.b));
+
+    ctx.lineWidth(1);
+    ctx.beginPath();
+    body.add_to(ctx);
+    if (kind == Kind::light) {
+      ctx.fill(pressed ? Colour::bytes(108, 108, 108) : Colour::bytes(255, 255, 255));
+      ctx.stroke(Colour::bytes(179, 179, 179));
+    } else {
+      ctx.fill(pressed ? Colour::bytes(128, 128, 128) : Colour::bytes(26, 26, 26));
+      ctx.stroke(Colour::bytes(0, 0, 0));
     }
   }
 
   template<typename LEDFunc, typename BTNFunc>
-  void Emulator::draw_btn(core::ui::vg::Canvas& ctx, Key key, LEDFunc&& lf, BTNFunc&& bf)
+  void Emulator::add_btn(Path& ctx, Key key, LEDFunc&& lf, BTNFunc&& bf)
   {
-    auto c = _led_colors[key];
     lf();
-    ctx.fill(Colour::bytes(c.r, c.g, c.b));
-
-    auto fill = is_pressed(key) ? Colour::bytes(128, 128, 128) : Colour::bytes(26, 26, 26);
-    ctx.lineWidth(1);
+    auto led = std::exchange(ctx, {});
     ctx.beginPath();
     bf();
-    ctx.fill(fill);
-    ctx.stroke(Colour::bytes(0, 0, 0));
+    _buttons.emplace_back(key, Button::Kind::dark, std::move(led), std::exchange(ctx, {}));
   }
 
   template<typename BTNFunc, typename LEDFunc>
-  void Emulator::draw_c_btn(core::ui::vg::Canvas& ctx, Key key, BTNFunc&& bf, LEDFunc&& lf)
+  void Emulator::add_c_btn(Path& ctx, Key key, BTNFunc&& bf, LEDFunc&& lf)
   {
-    auto c = _led_colors[key];
     lf();
-    ctx.fill(Colour::bytes(c.r, c.g, c.b));
-
-    auto fill = is_pressed(key) ? Colour::bytes(128, 128, 128) : Colour::bytes(26, 26, 26);
-    ctx.lineWidth(1);
+    auto led = std::exchange(ctx, {});
     bf();
-    ctx.fill(fill);
-    ctx.stroke(Colour::bytes(0, 0, 0));
+    _buttons.emplace_back(key, Button::Kind::dark, std::move(led), std::exchange(ctx, {}));
   }
 
   template<typename BTNFunc, typename LEDFunc>
-  void Emulator::draw_s_btn(core::ui::vg::Canvas& ctx, Key key, BTNFunc&& bf, LEDFunc&& lf)
+  void Emulator::add_s_btn(Path& ctx, Key key, BTNFunc&& bf, LEDFunc&& lf)
   {
-    auto c = _led_colors[key];
     lf();
-    ctx.fill(Colour::bytes(c.r, c.g, c.b));
-
-    auto fill = is_pressed(key) ? Colour::bytes(108, 108, 108) : Colour::bytes(255, 255, 255);
-    ctx.lineWidth(1);
+    auto led = std::exchange(ctx, {});
     bf();
-    ctx.fill(fill);
-    ctx.stroke(Colour::bytes(179, 179, 179));
+    _buttons.emplace_back(key, Button::Kind::light, std::move(led), std::exchange(ctx, {}));
   }
 
   void Emulator::draw(Canvas& ctx)
+  {
+    if (_buttons.empty()) {
+      Path path;
+      add_func_btns(path);
+      add_sc_btns(path);
+    }
+    // The rest of the board never changes
+    _layer.draw(ctx, 0, [this](Canvas& ctx) { draw_board(ctx); });
+    // Each button is only rendered again when its own LED or state changes
+    for (auto& btn : _buttons) {
+      auto c = _leds.get(btn.key);
+      bool pressed = is_pressed(btn.key);
+      ctx.save();
+      ctx.translate(btn.bounds.x, btn.bounds.y);
+      btn.layer.draw(ctx, Layer::key(c.r, c.g, c.b, pressed), [&btn, c, pressed](Canvas& ctx) {
+        ctx.translate(-btn.bounds.x, -btn.bounds.y);
+        btn.draw(ctx, c, pressed);
+      });
+      ctx.restore();
+    }
+  }
+
+  void Emulator::draw_board(Canvas& ctx)
   {
     // #BKGRND
     ctx.lineJoin(Canvas::LineJoin::ROUND);
@@ -78,9 +128,7 @@ namespace otto::board {
 
     // #layer1
 
-    draw_func_btns(ctx);
     draw_encoders(ctx);
-    draw_sc_btns(ctx);
 
     // #rect1819
     ctx.lineJoin(Canvas::LineJoin::ROUND);
@@ -104,10 +152,10 @@ namespace otto::board {
     ctx.stroke();
   }
 
-  void Emulator::draw_sc_btns(Canvas& ctx)
+  void Emulator::add_sc_btns(Path& ctx)
   {
     // #S0
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S0,
       [&] {
         ctx.beginPath();
@@ -128,7 +176,7 @@ namespace otto::board {
       });
 
     // #S1
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S1,
       [&] {
         ctx.beginPath();
@@ -149,7 +197,7 @@ namespace otto::board {
       });
 
     // #S2
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S2,
       [&] {
         ctx.beginPath();
@@ -170,7 +218,7 @@ namespace otto::board {
       });
 
     // #S3
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S3,
       [&] {
         ctx.beginPath();
@@ -191,7 +239,7 @@ namespace otto::board {
       });
 
     // #S4
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S4,
       [&] {
         ctx.beginPath();
@@ -212,7 +260,7 @@ namespace otto::board {
       });
 
     // #S5
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S5,
       [&] {
         ctx.beginPath();
@@ -233,7 +281,7 @@ namespace otto::board {
       });
 
     // #S6
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S6,
       [&] {
         ctx.beginPath();
@@ -254,7 +302,7 @@ namespace otto::board {
       });
 
     // #S7
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S7,
       [&] {
         ctx.beginPath();
@@ -275,7 +323,7 @@ namespace otto::board {
       });
 
     // #S8
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S8,
       [&] {
         ctx.beginPath();
@@ -296,7 +344,7 @@ namespace otto::board {
       });
 
     // #S9
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S9,
       [&] {
         ctx.beginPath();
@@ -317,7 +365,7 @@ namespace otto::board {
       });
 
     // #S10
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S10,
       [&] {
         ctx.beginPath();
@@ -338,7 +386,7 @@ namespace otto::board {
       });
 
     // #S11
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S11,
       [&] {
         ctx.beginPath();
@@ -359,7 +407,7 @@ namespace otto::board {
       });
 
     // #S12
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S12,
       [&] {
         ctx.beginPath();
@@ -380,7 +428,7 @@ namespace otto::board {
       });
 
     // #S13
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S13,
       [&] {
         ctx.beginPath();
@@ -401,7 +449,7 @@ namespace otto::board {
       });
 
     // #S14
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S14,
       [&] {
         ctx.beginPath();
@@ -422,7 +470,7 @@ namespace otto::board {
       });
 
     // #S15
-    draw_s_btn(
+    add_s_btn(
       ctx, Key::S15,
       [&] {
         ctx.beginPath();
@@ -443,7 +491,7 @@ namespace otto::board {
       });
 
     // #C8
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C8,
       [&] {
         ctx.beginPath();
@@ -464,7 +512,7 @@ namespace otto::board {
       });
 
     // #C9
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C9,
       [&] {
         ctx.beginPath();
@@ -485,7 +533,7 @@ namespace otto::board {
       });
 
     // #C7
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C7,
       [&] {
         ctx.beginPath();
@@ -506,7 +554,7 @@ namespace otto::board {
       });
 
     // #C6
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C6,
       [&] {
         ctx.beginPath();
@@ -527,7 +575,7 @@ namespace otto::board {
       });
 
     // #C5
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C5,
       [&] {
         ctx.beginPath();
@@ -548,7 +596,7 @@ namespace otto::board {
       });
 
     // #C4
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C4,
       [&] {
         ctx.beginPath();
@@ -569,7 +617,7 @@ namespace otto::board {
       });
 
     // #C3
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C3,
       [&] {
         ctx.beginPath();
@@ -590,7 +638,7 @@ namespace otto::board {
       });
 
     // #C2
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C2,
       [&] {
         ctx.beginPath();
@@ -611,7 +659,7 @@ namespace otto::board {
       });
 
     // #C1
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C1,
       [&] {
         ctx.beginPath();
@@ -632,7 +680,7 @@ namespace otto::board {
       });
 
     // #C0
-    draw_c_btn(
+    add_c_btn(
       ctx, Key::C0,
       [&] {
         ctx.beginPath();
@@ -654,10 +702,10 @@ namespace otto::board {
   }
 
 
-  void Emulator::draw_func_btns(Canvas& ctx)
+  void Emulator::add_func_btns(Path& ctx)
   {
     // #SHIFT
-    draw_btn(
+    add_btn(
       ctx, Key::shift,
       [&] {
         // #path843
@@ -762,7 +810,7 @@ namespace otto::board {
       });
 
     // #PLUS
-    draw_btn(
+    add_btn(
       ctx, Key::plus,
       [&] {
         // #path919
@@ -848,7 +896,7 @@ namespace otto::board {
       });
 
     // #MINUS
-    draw_btn(
+    add_btn(
       ctx, Key::minus,
       [&] {
         // #path937
@@ -894,7 +942,7 @@ namespace otto::board {
       });
 
     // #SENDS
-    draw_btn(
+    add_btn(
       ctx, Key::sends,
       [&] {
         // #path851
@@ -1132,7 +1180,7 @@ namespace otto::board {
       });
 
     // #LOOPER
-    draw_btn(
+    add_btn(
       ctx, Key::looper,
       [&] {
         // #path825
@@ -1374,7 +1422,7 @@ namespace otto::board {
       });
 
     // #SEQ
-    draw_btn(
+    add_btn(
       ctx, Key::sequencer,
       [&] {
         // #path829
@@ -1733,7 +1781,7 @@ namespace otto::board {
       });
 
     // #ROUTING
-    draw_btn(
+    add_btn(
       ctx, Key::routing,
       [&] {
         // #path899
@@ -1899,7 +1947,7 @@ namespace otto::board {
       });
 
     // #FX1
-    draw_btn(
+    add_btn(
       ctx, Key::fx1,
       [&] {
         // #path1599
@@ -2088,7 +2136,7 @@ namespace otto::board {
       });
 
     // #FX2
-    draw_btn(
+    add_btn(
       ctx, Key::fx2,
       [&] {
         // #path875
@@ -2332,7 +2380,7 @@ namespace otto::board {
       });
 
     // #ARP
-    draw_btn(
+    add_btn(
       ctx, Key::arp,
       [&] {
         // #path877
@@ -2543,7 +2591,7 @@ namespace otto::board {
       });
 
     // #SAMPLER
-    draw_btn(
+    add_btn(
       ctx, Key::sampler,
       [&] {
         // #path897
@@ -2633,7 +2681,7 @@ namespace otto::board {
       });
 
     // #REC
-    draw_btn(
+    add_btn(
       ctx, Key::rec,
       [&] {
         // #path951
@@ -2742,7 +2790,7 @@ namespace otto::board {
       });
 
     // #PLAY
-    draw_btn(
+    add_btn(
       ctx, Key::play,
       [&] {
         // #path949
@@ -2807,7 +2855,7 @@ namespace otto::board {
       });
 
     // #MASTER
-    draw_btn(
+    add_btn(
       ctx, Key::master,
       [&] {
         // #path941
@@ -2985,7 +3033,7 @@ namespace otto::board {
       });
 
     // #SLOTS
-    draw_btn(
+    add_btn(
       ctx, Key::slots,
       [&] {
         // #path927
@@ -3154,7 +3202,7 @@ namespace otto::board {
       });
 
     // #SYNTH
-    draw_btn(
+    add_btn(
       ctx, Key::synth,
       [&] {
         // #path845
@@ -3302,7 +3350,7 @@ namespace otto::board {
       });
 
     // #SETTINGS
-    draw_btn(
+    add_btn(
       ctx, Key::settings,
       [&] {
         // #path853
@@ -3701,7 +3749,7 @@ namespace otto::board {
       });
 
     // #ENVELOPE
-    draw_btn(
+    add_btn(
       ctx, Key::envelope,
       [&] {
         // #path887
@@ -3827,7 +3875,7 @@ namespace otto::board {
       });
 
     // #EXTERNAL
-    draw_btn(
+    add_btn(
       ctx, Key::external,
       [&] {
         // #path873
@@ -4117,7 +4165,7 @@ namespace otto::board {
       });
 
     // #TWIST2
-    draw_btn(
+    add_btn(
       ctx, Key::twist2,
       [&] {
         // #path923
@@ -4449,7 +4497,7 @@ namespace otto::board {
       });
 
     // #TWIST1
-    draw_btn(
+    add_btn(
       ctx, Key::twist1,
       [&] {
         // #path925
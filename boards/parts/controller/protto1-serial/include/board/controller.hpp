@@ -1,11 +1,16 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <mutex>
+
 #include <gsl/span>
 
 #include "util/locked.hpp"
 #include "util/thread.hpp"
 
 #include "services/controller.hpp"
+#include "util/cobs.hpp"
 #include "util/serial.hpp"
 
 namespace otto::services {
@@ -66,29 +71,97 @@ namespace otto::services {
    * 
    * # Encoding of Key dump
    * ???
+   *
+   * # Framing
+   *
+   * Each message is encoded with COBS (see @ref util::cobs), and followed by a `0x00`, so
+   * arguments can hold any byte, and a receiver that starts in the middle of a message skips to
+   * the next one.
+   *
+   * # I/O
+   *
+   * All I/O is done by @ref io_thread, which waits on the nonblocking port and an `eventfd`
+   * with `epoll`. Reads are handled as soon as they arrive, whatever their size.
+   *
+   * Nothing is written from the calling thread. @ref set_color and @ref clear_leds only update
+   * the wanted LED colours in a lock-free @ref LEDBuffer, and wake @ref io_thread, which takes
+   * the LEDs changed since its last write, and writes those that differ from the colours it
+   * sent last, along with the queued messages, at once. Changes made within
+   * @ref write_interval of a write are batched into the next one.
    */
   struct PrOTTO1SerialController final : Controller {
     PrOTTO1SerialController();
 
     void set_color(LED, LEDColor) override;
-    void flush_leds() override;
     void clear_leds() override;
 
     static std::unique_ptr<Controller> make_or_dummy();
     static std::unique_ptr<Controller> make_or_emulator();
 
   private:
+    /// Closes the file descriptor when destroyed
+    struct FileDescriptor {
+      explicit FileDescriptor(int fd);
+      ~FileDescriptor() noexcept;
+      FileDescriptor(const FileDescriptor&) = delete;
+      FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+      const int fd;
+    };
+
     void handle_message(BytesView);
+    /// Queue a message to be written with the next batch
     void queue_message(BytesView);
+    /// Wake @ref io_thread to write the queued changes
+    void wake();
+
+    /// Make the port nonblocking, and create the `epoll` instance that waits on it and @ref wake_
+    int create_epoll();
+
+    // Run on @ref io_thread
+
+    /// Read and handle what the port has received
+    void read_available();
+    /// Encode the LED changes and queued messages into @ref out_
+    void take_writes();
+    /// Write as much of @ref out_ as the port takes, and wait for it to take the rest
+    void write_available();
+
+    /// The minimum time between two writes
+    static constexpr auto write_interval = std::chrono::milliseconds(5);
 
     void insert_key_event(Command cmd, Key key);
     void insert_key_or_midi(Command cmd, BytesView args, bool do_send_midi);
 
-    util::Serial serial = {"/dev/ttyACM0", 10, 1};
+    util::Serial serial = {"/dev/ttyACM0", 0, 0};
     util::double_buffered<EventBag, util::clear_inner> events_;
-    util::double_buffered<std::vector<std::uint8_t>, util::clear_outer> write_buffer_;
-    util::thread read_thread;
     bool send_midi_ = true;
+
+    LEDBuffer leds_;
+    /// Whether the LEDs were cleared since the last write, which is sent as one message
+    std::atomic_bool leds_cleared_ = false;
+    /// Guards @ref messages_
+    std::mutex write_mutex_;
+    /// Encoded messages
+    std::vector<std::uint8_t> messages_;
+
+    // Only used by @ref io_thread
+
+    /// The LED colours last written
+    std::array<LEDColor, Key::_size()> sent_leds_;
+    /// Encoded bytes not yet taken by the port
+    std::vector<std::uint8_t> out_;
+    std::size_t out_pos_ = 0;
+    bool waiting_for_port_ = false;
+    std::chrono::steady_clock::time_point last_write_;
+    /// When the bytes being handled were read, to time the midi events they cause
+    std::chrono::steady_clock::time_point read_time_;
+    util::cobs::Decoder decoder_;
+
+    /// An `eventfd`, written to by @ref wake
+    FileDescriptor wake_;
+    FileDescriptor epoll_;
+    util::thread io_thread;
   };
 
 } // namespace otto::services
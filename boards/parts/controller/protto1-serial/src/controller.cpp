@@ -1,5 +1,12 @@
 #include "board/controller.hpp"
 
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
 #include "util/algorithm.hpp"
 #include "util/exception.hpp"
 #include "util/utility.hpp"
@@ -56,54 +63,42 @@ namespace otto::services {
     }
   }
 
+  /// The note of each key of the keyboard, by the index of the key, or -1 for other keys
+  static const auto key_notes = [] {
+    std::array<std::int8_t, Key::_size()> res;
+    res.fill(-1);
+    const std::pair<Key::_enumerated, std::int8_t> notes[] = {
+      {Key::S0, 47},  {Key::S1, 48},  {Key::C0, 49},  {Key::S2, 50},  {Key::C1, 51},  {Key::S3, 52},
+      {Key::S4, 53},  {Key::C2, 54},  {Key::S5, 55},  {Key::C3, 56},  {Key::S6, 57},  {Key::C4, 58},
+      {Key::S7, 59},  {Key::S8, 60},  {Key::C5, 61},  {Key::S9, 62},  {Key::C6, 63},  {Key::S10, 64},
+      {Key::S11, 65}, {Key::C7, 66},  {Key::S12, 67}, {Key::C8, 68},  {Key::S13, 69}, {Key::C9, 70},
+      {Key::S14, 71}, {Key::S15, 72},
+    };
+    for (auto [key, note] : notes) res[Key(key)._to_index()] = note;
+    return res;
+  }();
+
   void P1SC::insert_key_or_midi(Command cmd, BytesView args, bool do_send_midi)
   {
     OTTO_ASSERT(args.size() > 0, "Requires > 0 args");
-    auto key = Key::_from_integral_unchecked(args.at(0));
-    if (!do_send_midi) {
+    if (!Key::_is_valid(args.at(0))) {
+      LOGE("Unknown key {}", args.at(0));
+      return;
+    }
+    auto key = Key::_from_integral(args.at(0));
+    int note = key_notes[key._to_index()];
+    if (!do_send_midi || note < 0) {
       insert_key_event(cmd, key);
       return;
     }
 
-    auto send_midi = [cmd](int note) {
-      if (cmd == +Command::key_down) {
-        auto evt = core::midi::NoteOnEvent{note};
-        AudioManager::current().send_midi_event(evt);
-        LOGI("Press key {}", evt.key);
-      } else if (cmd == +Command::key_up) {
-        AudioManager::current().send_midi_event(core::midi::NoteOffEvent{note});
-        LOGI("Release key {}", note);
-      }
-    };
-
-    switch (key) {
-      case Key::S0: send_midi(47); break;
-      case Key::S1: send_midi(48); break;
-      case Key::C0: send_midi(49); break;
-      case Key::S2: send_midi(50); break;
-      case Key::C1: send_midi(51); break;
-      case Key::S3: send_midi(52); break;
-      case Key::S4: send_midi(53); break;
-      case Key::C2: send_midi(54); break;
-      case Key::S5: send_midi(55); break;
-      case Key::C3: send_midi(56); break;
-      case Key::S6: send_midi(57); break;
-      case Key::C4: send_midi(58); break;
-      case Key::S7: send_midi(59); break;
-      case Key::S8: send_midi(60); break;
-      case Key::C5: send_midi(61); break;
-      case Key::S9: send_midi(62); break;
-      case Key::C6: send_midi(63); break;
-      case Key::S10: send_midi(64); break;
-      case Key::S11: send_midi(65); break;
-      case Key::C7: send_midi(66); break;
-      case Key::S12: send_midi(67); break;
-      case Key::C8: send_midi(68); break;
-      case Key::S13: send_midi(69); break;
-      case Key::C9: send_midi(70); break;
-      case Key::S14: send_midi(71); break;
-      case Key::S15: send_midi(72); break;
-      default: insert_key_event(cmd, key); break;
+    // Straight into the lock free midi queue, timed by when the key was read
+    if (cmd == +Command::key_down) {
+      AudioManager::current().send_midi_event(core::midi::NoteOnEvent{note}, read_time_);
+      DLOGI("Press key {}", note);
+    } else if (cmd == +Command::key_up) {
+      AudioManager::current().send_midi_event(core::midi::NoteOffEvent{note}, read_time_);
+      DLOGI("Release key {}", note);
     }
   }
 
@@ -112,12 +107,119 @@ namespace otto::services {
     return std::vector<byte>{cmd._to_integral()};
   }
 
+  P1SC::FileDescriptor::FileDescriptor(int fd) : fd(fd)
+  {
+    if (fd < 0) throw util::exception("Couldn't create a file descriptor. ERR {}: {}", errno, strerror(errno));
+  }
+
+  P1SC::FileDescriptor::~FileDescriptor() noexcept
+  {
+    close(fd);
+  }
+
   void P1SC::queue_message(BytesView message)
   {
-    write_buffer_.outer_locked([&](auto& b) {
-      b.reserve(b.size() + message.size());
-      util::copy(message, std::back_inserter(b));
-    });
+    {
+      std::lock_guard lock(write_mutex_);
+      util::cobs::encode(message, messages_);
+    }
+    wake();
+  }
+
+  void P1SC::wake()
+  {
+    std::uint64_t one = 1;
+    // Can only fail if the counter overflows, in which case the thread is awake anyway
+    [[maybe_unused]] auto res = ::write(wake_.fd, &one, sizeof(one));
+  }
+
+  int P1SC::create_epoll()
+  {
+    serial.set_nonblocking(true);
+    int fd = epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0) return fd;
+    for (int watched : {serial.file_descriptor(), wake_.fd}) {
+      epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.fd = watched;
+      if (epoll_ctl(fd, EPOLL_CTL_ADD, watched, &ev) != 0) {
+        close(fd);
+        return -1;
+      }
+    }
+    return fd;
+  }
+
+  void P1SC::read_available()
+  {
+    std::array<std::uint8_t, 256> buffer;
+    while (true) {
+      auto res = serial.read_some(buffer);
+      if (!res) {
+        LOGE("Error reading serial data {}", res.error().what());
+        return;
+      }
+      if (*res == 0) return;
+      read_time_ = std::chrono::steady_clock::now();
+      decoder_.feed({buffer.data(), *res}, [this](BytesView message) { handle_message(message); });
+    }
+  }
+
+  void P1SC::take_writes()
+  {
+    {
+      std::lock_guard lock(write_mutex_);
+      out_.insert(out_.end(), messages_.begin(), messages_.end());
+      messages_.clear();
+    }
+
+    auto changed = leds_.take_changed();
+    if (leds_cleared_.exchange(false, std::memory_order_relaxed)) {
+      auto c = LEDColor::Black;
+      std::array<byte, 4> msg = {(+Command::clear_all_leds)._to_integral(), c.r, c.g, c.b};
+      util::cobs::encode(msg, out_);
+      sent_leds_.fill(c);
+      // LEDs set since the clear may have been sent already, and need to be sent again
+      changed = ~std::uint64_t(0);
+    }
+    for (std::size_t i = 0; i < sent_leds_.size(); i++) {
+      if (((changed >> i) & 1) == 0) continue;
+      auto key = Key::_values()[i];
+      auto c = leds_.get(key);
+      if (c == sent_leds_[i]) continue;
+      std::array<byte, 5> msg = {(+Command::set_led_color)._to_integral(), key._to_integral(), c.r, c.g, c.b};
+      util::cobs::encode(msg, out_);
+      sent_leds_[i] = c;
+    }
+    last_write_ = std::chrono::steady_clock::now();
+  }
+
+  void P1SC::write_available()
+  {
+    while (out_pos_ < out_.size()) {
+      auto res = serial.write_some({out_.data() + out_pos_, out_.size() - out_pos_});
+      if (!res) {
+        LOGE("Error writing serial data {}", res.error().what());
+        out_.clear();
+        out_pos_ = 0;
+        break;
+      }
+      if (*res == 0) break;
+      out_pos_ += *res;
+    }
+    if (out_pos_ == out_.size()) {
+      out_.clear();
+      out_pos_ = 0;
+    }
+    // Wait for the port to take the rest
+    bool waiting = !out_.empty();
+    if (waiting != waiting_for_port_) {
+      epoll_event ev = {};
+      ev.events = EPOLLIN | (waiting ? EPOLLOUT : 0);
+      ev.data.fd = serial.file_descriptor();
+      epoll_ctl(epoll_.fd, EPOLL_CTL_MOD, serial.file_descriptor(), &ev);
+      waiting_for_port_ = waiting;
+    }
   }
 
   int8_t to_int8(uint8_t x)
@@ -158,15 +260,37 @@ namespace otto::services {
   }
 
   P1SC::PrOTTO1SerialController()
-    : read_thread([this](auto should_run) noexcept {
+    : wake_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      epoll_(create_epoll()),
+      io_thread(util::ThreadClass::io, [this](auto should_run) noexcept {
+        bool write_due = false;
         while (should_run()) {
-          serial.read_line()
-            .map([&](auto&& bytes) { handle_message(bytes); })
-            .map_error([&](auto&& error) {
-              if (error.data() != util::Serial::ErrorCode::empty_buffer) {
-                LOGE("Error reading serial data {}", error.what());
-              }
-            });
+          // Wake up now and then to check whether to stop
+          int timeout = 100;
+          if (write_due) {
+            auto wait = last_write_ + write_interval - std::chrono::steady_clock::now();
+            if (wait <= wait.zero()) {
+              take_writes();
+              write_available();
+              write_due = false;
+            } else {
+              timeout = std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+            }
+          }
+
+          std::array<epoll_event, 2> events;
+          int n = epoll_wait(epoll_.fd, events.data(), events.size(), timeout);
+          for (int i = 0; i < n; i++) {
+            auto& ev = events[i];
+            if (ev.data.fd == wake_.fd) {
+              std::uint64_t count;
+              [[maybe_unused]] auto res = ::read(wake_.fd, &count, sizeof(count));
+              write_due = true;
+              continue;
+            }
+            if (ev.events & EPOLLIN) read_available();
+            if (ev.events & EPOLLOUT) write_available();
+          }
         }
       })
   {}
@@ -191,21 +315,14 @@ namespace otto::services {
 
   void P1SC::set_color(LED led, LEDColor color)
   {
-    std::array<std::uint8_t, 6> msg = {0xEC, led.key._to_integral(), color.r, color.g, color.b,
-                                       '\n'};
-    queue_message(msg);
+    if (leds_.set(led, color)) wake();
   }
 
-  void P1SC::flush_leds()
-  {
-    write_buffer_.swap();
-    serial.write(write_buffer_.inner());
-  }
   void P1SC::clear_leds()
   {
-    auto c = LEDColor::Black;
-    std::array<std::uint8_t, 5> msg = {0xE0, c.r, c.g, c.b, '\n'};
-    queue_message(msg);
+    leds_.clear();
+    leds_cleared_.store(true, std::memory_order_relaxed);
+    wake();
   }
 
 } // namespace otto::services
@@ -10,3 +10,4 @@
 #include <NanoCanvas.h>
 #include <nanovg.h>
 #include <nanovg_gl.h>
+#include <nanovg_gl_utils.h>
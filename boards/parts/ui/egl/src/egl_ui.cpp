@@ -9,6 +9,7 @@
 #include "core/ui/canvas.hpp"
 #include "core/ui/vector_graphics.hpp"
 #include "services/ui_manager.hpp"
+#include "util/thread_policy.hpp"
 
 #define NANOVG_GLES2_IMPLEMENTATION
 
@@ -24,12 +25,51 @@ namespace otto::services {
   using namespace core::ui;
   using namespace board::ui;
 
+  /// A layer image in a nanovg framebuffer
+  ///
+  /// Layers can outlive the nanovg context, so the framebuffer is only deleted while `context`
+  /// has not expired.
+  struct FramebufferLayer final : vg::LayerTarget {
+    FramebufferLayer(NVGLUframebuffer* fb, int width, int height, std::weak_ptr<bool> context)
+      : _fb(fb), _width(width), _height(height), _context(std::move(context))
+    {}
+
+    ~FramebufferLayer() override
+    {
+      if (!_context.expired()) nvgluDeleteFramebuffer(_fb);
+    }
+
+    int image() const override
+    {
+      return _fb->image;
+    }
+
+    void bind() override
+    {
+      nvgluBindFramebuffer(_fb);
+      glViewport(0, 0, _width, _height);
+      glClearColor(0, 0, 0, 0);
+      glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
+
+    void unbind() override
+    {
+      nvgluBindFramebuffer(nullptr);
+    }
+
+  private:
+    NVGLUframebuffer* _fb;
+    int _width;
+    int _height;
+    std::weak_ptr<bool> _context;
+  };
+
   void EGLUIManager::main_ui_loop()
   {
     EGLConnection egl;
     egl.init();
 #if OTTO_USE_FBCP
-    auto fbcp = RpiFBCP{egl.eglData};
+    auto fbcp = RpiFBCP{};
     bool use_fbcp = true;
     try {
       fbcp.init();
@@ -50,66 +90,96 @@ namespace otto::services {
 
     vg::Canvas canvas(nvg, vg::width, vg::height);
     vg::initUtils(canvas);
-
-    // I am unable to resize the EGL display, it is fixed at 720x480px, so this
-    // is the temporary fix. Stretch everything to fill the display, and then
-    // scale it down in fbcp. Actually only rendering 320x240 should also help
-    // performance, so it is definately desired at some point
-    float xscale = egl.draw_size.width / float(vg::width);
-    float yscale = egl.draw_size.height / float(vg::height);
-
-    canvas.setSize(egl.draw_size.width, egl.draw_size.height);
-
-    using std::chrono::duration;
-    using std::chrono::nanoseconds;
-    using clock = std::chrono::high_resolution_clock;
-    auto one_second = 1e9f;
+    // The context is alive as long as the factory is
+    canvas.layer_factory = [nvg, alive = std::make_shared<bool>(true)](
+                             int width, int height) -> std::unique_ptr<vg::LayerTarget> {
+      auto* fb = nvgluCreateFramebuffer(nvg, width, height, NVG_IMAGE_FLIPY | NVG_IMAGE_PREMULTIPLIED);
+      if (fb == nullptr) return nullptr;
+      return std::make_unique<FramebufferLayer>(fb, width, height, alive);
+    };
+
+    // The EGL display can not be resized from the 720x480px it is fixed at, so the UI is
+    // rendered to an offscreen framebuffer at its native size, and stretched to fill the
+    // display. FBCP has its own framebuffer, the size of the SPI display.
+    NVGLUframebuffer* fb = nvgluCreateFramebuffer(nvg, vg::width, vg::height, NVG_IMAGE_FLIPY);
+    if (fb == NULL) {
+      LOGF("Could not create the framebuffer.\n");
+      nvgDeleteGLES2(nvg);
+      Application::current().exit(Application::ErrorCode::graphics_error);
+      return;
+    }
 
     auto targetFPS = config["FPS"].get<float>();
-    auto waitTime = nanoseconds(int(one_second / targetFPS));
-    auto t0 = clock::now();
-
     bool showFps = config["Debug"];
-    float fps;
-    duration<double> lastFrameTime;
+    show_screen_cost = show_screen_cost || showFps;
 
-    std::thread kbd_thread = std::thread([this] { read_keyboard(); });
+    std::thread kbd_thread = util::start_thread(util::ThreadClass::ui, [this] { read_keyboard(); });
 
     while (Application::current().running()) {
-      t0 = clock::now();
-
-      flush_events();
-
-      // Update and render
-      egl.beginFrame();
-      canvas.clearColor(vg::Colours::Black);
-      canvas.begineFrame(egl.draw_size.width, egl.draw_size.height);
-      canvas.scale(xscale, yscale);
-      draw_frame(canvas);
-
-      if (showFps) {
-        canvas.beginPath();
-        canvas.font(15);
-        canvas.font(vg::Fonts::Norm);
-        canvas.fillStyle(vg::Colours::White);
-        canvas.textAlign(vg::TextAlign::Left, vg::TextAlign::Baseline);
-        canvas.fillText(fmt::format("{:.2f} FPS", fps), {0, vg::height});
-      }
-
-      canvas.endFrame();
-      egl.endFrame();
+      Controller::current().flush_events();
 
+      // The last frame stays on the display until something changes
+      if (update_frame() || showFps) {
+        canvas.render_layers();
+        vg::Size size = {vg::width, vg::height};
 #if OTTO_USE_FBCP
-      if (use_fbcp) fbcp.copy();
+        if (use_fbcp) {
+          fbcp.bind();
+          size = {float(fbcp.width()), float(fbcp.height())};
+        } else
 #endif
+        {
+          nvgluBindFramebuffer(fb);
+          glViewport(0, 0, vg::width, vg::height);
+        }
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        canvas.begineFrame(size.w, size.h);
+        canvas.scale(size.w / vg::width, size.h / vg::height);
+        draw_frame(canvas);
+
+        if (showFps) {
+          canvas.beginPath();
+          canvas.font(15);
+          canvas.font(vg::Fonts::Norm);
+          canvas.fillStyle(vg::Colours::White);
+          canvas.textAlign(vg::TextAlign::Left, vg::TextAlign::Baseline);
+          auto& times = frame_scheduler.frame_times();
+          canvas.fillText(fmt::format("{:.1f} / {:.1f} ms", 1000 * times.quantile(0.5),
+                                      1000 * times.quantile(0.99)),
+                          {0, vg::height});
+        }
+
+        canvas.endFrame();
 
-      lastFrameTime = clock::now() - t0;
-      std::this_thread::sleep_for(waitTime - lastFrameTime);
+#if OTTO_USE_FBCP
+        if (use_fbcp) {
+          fbcp.copy();
+        } else
+#endif
+        {
+          nvgluBindFramebuffer(NULL);
+          egl.beginFrame();
+          float w = egl.draw_size.width;
+          float h = egl.draw_size.height;
+          nvgBeginFrame(nvg, w, h, 1);
+          nvgBeginPath(nvg);
+          nvgRect(nvg, 0, 0, w, h);
+          nvgFillPaint(nvg, nvgImagePattern(nvg, 0, 0, w, h, 0, fb->image, 1));
+          nvgFill(nvg);
+          nvgEndFrame(nvg);
+          egl.endFrame();
+        }
+      }
 
-      auto ms = std::chrono::duration_cast<nanoseconds>(lastFrameTime).count();
-      fps = one_second / ms;
+      frame_scheduler.wait(util::FrameScheduler::duration(1 / frame_rate(targetFPS)));
     }
 
+#if OTTO_USE_FBCP
+    fbcp.exit();
+#endif
+    canvas.layer_factory = nullptr;
+    nvgluDeleteFramebuffer(fb);
     nvgDeleteGLES2(nvg);
 
     egl.exit();
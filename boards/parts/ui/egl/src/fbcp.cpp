@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <algorithm>
 #include <stdio.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -11,8 +12,6 @@
 
 namespace otto::board::ui {
 
-  RpiFBCP::RpiFBCP(EGLConnection::EGLData& data) : egl_data(data) {}
-
   void RpiFBCP::init()
   {
     bcm_host_init();
@@ -31,37 +30,113 @@ namespace otto::board::ui {
     LOGI("Second display is {} x {} {}bps\n", vinfo.xres, vinfo.yres,
          vinfo.bits_per_pixel);
 
-    uint32_t image_prt;
-    screen_resource = vc_dispmanx_resource_create(VC_IMAGE_RGB565, vinfo.xres,
-                                                  vinfo.yres, &image_prt);
-    if (!screen_resource) {
+    if (vinfo.bits_per_pixel != 16) {
       close(fbfd);
-      throw util::exception("Unable to create screen buffer");
+      fbfd = -1;
+      throw util::exception("Secondary display is {}bps, only 16bps (RGB565) is supported",
+                            vinfo.bits_per_pixel);
     }
 
     fbp = (char*) mmap(0, finfo.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED,
                        fbfd, 0);
-    if (fbp == nullptr) {
+    if (fbp == MAP_FAILED) {
+      fbp = nullptr;
       close(fbfd);
-      vc_dispmanx_resource_delete(screen_resource);
+      fbfd = -1;
       throw util::exception("Unable to create mamory mapping");
     }
 
-    vc_dispmanx_rect_set(&rect1, 0, 0, vinfo.xres, vinfo.yres);
+    int arg = 0;
+    vsync = ioctl(fbfd, FBIO_WAITFORVSYNC, &arg) == 0;
+
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &colour_rbo);
+    glGenRenderbuffers(1, &stencil_rbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, colour_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB565, width(), height());
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour_rbo);
+    // nanovg needs a stencil buffer
+    glBindRenderbuffer(GL_RENDERBUFFER, stencil_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, width(), height());
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, stencil_rbo);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete) {
+      GLint format = 0;
+      GLint type = 0;
+      glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_FORMAT, &format);
+      glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_TYPE, &type);
+      read_rgb565 = format == GL_RGB && type == GL_UNSIGNED_SHORT_5_6_5;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    if (!complete) {
+      exit();
+      throw util::exception("Unable to create the RGB565 framebuffer");
+    }
+    LOGI("FBCP reads back {}{}", read_rgb565 ? "RGB565" : "RGBA",
+         vsync ? ", synced to vsync" : "");
+  }
+
+  void RpiFBCP::bind()
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width(), height());
   }
 
   void RpiFBCP::copy()
   {
-    vc_dispmanx_snapshot(egl_data.display, screen_resource, DISPMANX_NO_ROTATE);
-    vc_dispmanx_resource_read_data(screen_resource, &rect1, fbp,
-                                   vinfo.xres * vinfo.bits_per_pixel / 8);
+    if (fbp == nullptr) return;
+    const int xres = width();
+    const int yres = height();
+    pixels.resize(xres * yres);
+    glPixelStorei(GL_PACK_ALIGNMENT, 2);
+    if (read_rgb565) {
+      glReadPixels(0, 0, xres, yres, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, pixels.data());
+    } else {
+      rgba.resize(xres * yres * 4);
+      glReadPixels(0, 0, xres, yres, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+      for (int i = 0; i < xres * yres; i++) {
+        const std::uint8_t* px = rgba.data() + i * 4;
+        pixels[i] = ((px[0] & 0xF8) << 8) | ((px[1] & 0xFC) << 3) | (px[2] >> 3);
+      }
+    }
+
+    if (vsync) {
+      int arg = 0;
+      ioctl(fbfd, FBIO_WAITFORVSYNC, &arg);
+    }
+
+    // The first frame is written in full
+    bool full = frame.size() != std::size_t(xres * yres);
+    if (full) frame.resize(xres * yres);
+    for (int y = 0; y < yres; y++) {
+      // GL rows start at the bottom
+      const std::uint16_t* row = pixels.data() + (yres - 1 - y) * xres;
+      std::uint16_t* last = frame.data() + y * xres;
+      int first = 0;
+      int end = xres;
+      if (!full) {
+        while (first < end && row[first] == last[first]) first++;
+        while (end > first && row[end - 1] == last[end - 1]) end--;
+        if (first == end) continue;
+      }
+      std::copy(row + first, row + end, last + first);
+      auto* dst = reinterpret_cast<std::uint16_t*>(fbp + y * finfo.line_length);
+      std::copy(row + first, row + end, dst + first);
+    }
   }
 
   void RpiFBCP::exit() noexcept
   {
-    munmap(fbp, finfo.smem_len);
-    close(fbfd);
-    vc_dispmanx_resource_delete(screen_resource);
+    if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+    if (colour_rbo != 0) glDeleteRenderbuffers(1, &colour_rbo);
+    if (stencil_rbo != 0) glDeleteRenderbuffers(1, &stencil_rbo);
+    fbo = colour_rbo = stencil_rbo = 0;
+    if (fbp != nullptr) munmap(fbp, finfo.smem_len);
+    if (fbfd != -1) close(fbfd);
+    fbp = nullptr;
+    fbfd = -1;
   }
 
 } // namespace otto::board::ui
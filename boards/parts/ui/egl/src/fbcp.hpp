@@ -1,37 +1,72 @@
 #pragma once
 
 #include <linux/fb.h>
+#include <cstdint>
+#include <vector>
 
 #include "./egl_connection.hpp"
 
 namespace otto::board::ui {
 
-  /// This class is used to copy from the HDMI framebuffer on the pi, to the
+  /// This class is used to copy the frames rendered with GL to the
   /// framebuffer which is used by fbtft. This is useful when using an SPI
   /// display.
   ///
-  /// At some point in the future, we will probably want to skip some of these
-  /// steps, possibly by including the spi driver directly and writing the main
-  /// framebuffer to that on each frame.
+  /// The UI is rendered to an RGB565 framebuffer object the size of `/dev/fb1`,
+  /// see @ref bind, and read back once per frame in the pixel format of the
+  /// display, so the HDMI display is not involved, and no conversion is needed.
+  /// Drivers that can not read back RGB565 get RGBA, which is converted.
   struct RpiFBCP {
-    RpiFBCP(EGLConnection::EGLData& data);
+    RpiFBCP() = default;
 
     ~RpiFBCP() noexcept
     {
       this->exit();
     }
 
+    /// Open `/dev/fb1`, and create the render target
+    ///
+    /// Requires a current GL context.
     void init();
+
+    /// Render the next frame to the framebuffer object, and set the viewport to it
+    void bind();
+
+    /// The size of the render target, which is that of the display
+    int width() const noexcept
+    {
+      return vinfo.xres;
+    }
+
+    int height() const noexcept
+    {
+      return vinfo.yres;
+    }
+
+    /// Copy the frame rendered since @ref bind to `/dev/fb1`
+    ///
+    /// Only the changed part of each row is written, so fbtft, which tracks the written pages
+    /// of the framebuffer, only transfers the damaged rows to the display. If the driver
+    /// supports it, the writes wait for the vertical sync, to avoid tearing.
     void copy();
     void exit() noexcept;
 
   private:
-    EGLConnection::EGLData& egl_data;
+    int fbfd = -1;
+    char* fbp = nullptr;
+    bool vsync = false;
+
+    GLuint fbo = 0;
+    GLuint colour_rbo = 0;
+    GLuint stencil_rbo = 0;
+    /// Whether GL reads the render target as RGB565
+    bool read_rgb565 = false;
 
-    DISPMANX_RESOURCE_HANDLE_T screen_resource;
-    VC_RECT_T rect1;
-    int fbfd = 0;
-    char* fbp = 0;
+    /// The pixels read from GL, bottom row first
+    std::vector<std::uint16_t> pixels;
+    std::vector<std::uint8_t> rgba;
+    /// The frame last written to `/dev/fb1`, to find the damaged parts of the next one
+    std::vector<std::uint16_t> frame;
 
     struct fb_fix_screeninfo finfo;
     struct fb_var_screeninfo vinfo;
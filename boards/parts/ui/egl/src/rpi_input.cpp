@@ -8,6 +8,7 @@
 #include "services/log_manager.hpp"
 #include "services/ui_manager.hpp"
 #include "util/filesystem.hpp"
+#include "util/thread_policy.hpp"
 
 #include "board/ui/keys.hpp"
 #include "board/ui/egl_ui_manager.hpp"
@@ -152,7 +153,7 @@ namespace otto::services {
       if (dev < 0) dev = open_device("event-kbd", true);
       return dev;
     }();
-    std::thread encoder_thread = std::thread{[this] { read_encoders(); }};
+    std::thread encoder_thread = util::start_thread(util::ThreadClass::ui, [this] { read_encoders(); });
 
     if (keyboard == -1) {
       throw Application::exception(Application::ErrorCode::input_error, "Could not find a keyboard!");
@@ -36,11 +36,16 @@ namespace otto::glfw {
     vg::Point cursor_pos();
     std::pair<int, int> window_size();
     std::pair<int, int> framebuffer_size();
+    /// The pixels of the framebuffer per unit of the window, which is more than one on HiDPI
+    /// displays
+    float pixel_ratio();
 
     std::function<void(Button, Action, Modifiers)> mouse_button_callback = nullptr;
     std::function<void(Action, Modifiers, Key)> key_callback = nullptr;
     std::function<void(char)> char_callback = nullptr;
     std::function<void(double x, double y)> scroll_callback = nullptr;
+    /// Called when the contents of the window are damaged, or its framebuffer is resized
+    std::function<void()> refresh_callback = nullptr;
 
   private:
     GLFWwindow* _glfw_win;
@@ -52,7 +57,11 @@ namespace otto::glfw {
 
     vg::Canvas& canvas();
 
+    /// Make the context current, and begin a frame of the size of the window
+    ///
+    /// Makes the canvas again if the window moved to a display with another pixel ratio.
     void begin_frame();
+    /// End the frame, and swap it in on the next vertical blank
     void end_frame();
 
   private:
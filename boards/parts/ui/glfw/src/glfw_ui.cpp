@@ -21,11 +21,51 @@
 #include <GL/gl3w.h>
 #include <GLFW/glfw3.h>
 #include <nanovg_gl.h>
+#include <nanovg_gl_utils.h>
 
 #include "board/emulator.hpp"
 
 namespace otto::glfw {
 
+  /// A layer image in a nanovg framebuffer
+  ///
+  /// Layers can outlive the nanovg context, so the framebuffer is only deleted while `context`
+  /// has not expired.
+  struct FramebufferLayer final : vg::LayerTarget {
+    FramebufferLayer(NVGLUframebuffer* fb, int width, int height, std::weak_ptr<bool> context)
+      : _fb(fb), _width(width), _height(height), _context(std::move(context))
+    {}
+
+    ~FramebufferLayer() override
+    {
+      if (!_context.expired()) nvgluDeleteFramebuffer(_fb);
+    }
+
+    int image() const override
+    {
+      return _fb->image;
+    }
+
+    void bind() override
+    {
+      nvgluBindFramebuffer(_fb);
+      glViewport(0, 0, _width, _height);
+      glClearColor(0, 0, 0, 0);
+      glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
+
+    void unbind() override
+    {
+      nvgluBindFramebuffer(nullptr);
+    }
+
+  private:
+    NVGLUframebuffer* _fb;
+    int _width;
+    int _height;
+    std::weak_ptr<bool> _context;
+  };
+
   Window::Window(int width, int height, const std::string& name)
   {
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -51,6 +91,18 @@ namespace otto::glfw {
       }
     });
 
+    glfwSetWindowRefreshCallback(_glfw_win, [](GLFWwindow* window) {
+      if (auto* win = get_for(window); win && win->refresh_callback) {
+        win->refresh_callback();
+      }
+    });
+
+    glfwSetFramebufferSizeCallback(_glfw_win, [](GLFWwindow* window, int, int) {
+      if (auto* win = get_for(window); win && win->refresh_callback) {
+        win->refresh_callback();
+      }
+    });
+
 #if false
     glfwSetKeyboardCallback(_glfw_win, [](GLFWwindow* window, int key, int scancode, int action,
                                           int mods, const char* str, int) {
@@ -150,15 +202,34 @@ namespace otto::glfw {
     return {x, y};
   }
 
+  float Window::pixel_ratio()
+  {
+    auto [win_width, win_height] = window_size();
+    auto [fb_width, fb_height] = framebuffer_size();
+    if (win_width <= 0) return 1;
+    return float(fb_width) / float(win_width);
+  }
+
 
   NVGWindow::NVGWindow(int width, int height, const std::string& name)
     : Window(width, height, name),
       _vg(OTTO_NVG_CREATE(NVG_ANTIALIAS | NVG_STENCIL_STROKES | NVG_DEBUG)),
-      _canvas(_vg, width, height)
-  {}
+      _canvas(_vg, width, height, pixel_ratio())
+  {
+    // Swap on the vertical blank, so the loop never outpaces the display
+    glfwSwapInterval(1);
+    // The context is alive as long as the factory is
+    _canvas.layer_factory = [nvg = _vg, alive = std::make_shared<bool>(true)](
+                              int width, int height) -> std::unique_ptr<vg::LayerTarget> {
+      auto* fb = nvgluCreateFramebuffer(nvg, width, height, NVG_IMAGE_FLIPY | NVG_IMAGE_PREMULTIPLIED);
+      if (fb == nullptr) return nullptr;
+      return std::make_unique<FramebufferLayer>(fb, width, height, alive);
+    };
+  }
 
   NVGWindow::~NVGWindow() noexcept
   {
+    _canvas.layer_factory = nullptr;
     OTTO_NVG_DELETE(_vg);
   }
 
@@ -173,6 +244,13 @@ namespace otto::glfw {
     auto [winWidth, winHeight] = window_size();
     auto [fbWidth, fbHeight] = framebuffer_size();
 
+    _canvas.render_layers();
+    // The pixel ratio is fixed for a canvas. Layers render at the new one once drawn again.
+    if (float ratio = pixel_ratio(); ratio != _canvas.pixel_ratio()) {
+      auto factory = std::move(_canvas.layer_factory);
+      _canvas = vg::Canvas(_vg, winWidth, winHeight, ratio);
+      _canvas.layer_factory = std::move(factory);
+    }
     _canvas.setSize(winWidth, winHeight);
 
     // Update and render
@@ -246,33 +324,36 @@ namespace otto::services {
 
     glfwSetTime(0);
 
-    double t, spent;
+    // Redraw when the window is uncovered or resized
+    main_win.refresh_callback = [this] { request_redraw(); };
+
     while (!main_win.should_close() && Application::current().running()) {
+      Controller::current().flush_events();
 
-      t = glfwGetTime();
+      // The last frame stays in the window until something changes
+      if (update_frame()) {
+        auto [winWidth, winHeight] = main_win.window_size();
 
-      auto [winWidth, winHeight] = main_win.window_size();
-      // Calculate pixel ration for hi-dpi devices.
+        main_win.begin_frame();
+        scale = std::min((float) winWidth / (float) canvas_size.w, (float) winHeight / (float) canvas_size.h);
+        main_win.canvas().scale(scale, scale);
 
-      main_win.begin_frame();
-      scale = std::min((float) winWidth / (float) canvas_size.w, (float) winHeight / (float) canvas_size.h);
-      main_win.canvas().scale(scale, scale);
+        if (emulator) {
+          emulator->draw(main_win.canvas());
+          main_win.canvas().translate(518, 28);
+          main_win.canvas().scale(215.f / 320.f, 161.f / 240.f);
+        }
+        draw_frame(main_win.canvas());
 
-      if (emulator) {
-        emulator->draw(main_win.canvas());
-        main_win.canvas().translate(518, 28);
-        main_win.canvas().scale(215.f / 320.f, 161.f / 240.f);
+        main_win.end_frame();
       }
-      draw_frame(main_win.canvas());
 
-      main_win.end_frame();
-
-      glfwPollEvents();
-      Controller::current().flush_events();
-
-      spent = glfwGetTime() - t;
-
-      std::this_thread::sleep_for(std::chrono::milliseconds(int(1000 / 60 - spent * 1000)));
+      // Sleep until the next frame is due, handling input as it arrives
+      using clock = util::FrameScheduler::clock;
+      auto deadline = frame_scheduler.advance(clock::now(), util::FrameScheduler::duration(1 / frame_rate(60)));
+      for (auto now = clock::now(); now < deadline && !main_win.should_close(); now = clock::now()) {
+        glfwWaitEventsTimeout(util::FrameScheduler::duration(deadline - now).count());
+      }
     }
   }
 } // namespace otto::services
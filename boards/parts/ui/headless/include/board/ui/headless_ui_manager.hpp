@@ -0,0 +1,23 @@
+#pragma once
+
+#include "services/ui_manager.hpp"
+
+namespace otto::services {
+
+  /// Runs the work of the UI without drawing anything, for units without a display
+  ///
+  /// Used with `OTTO_HEADLESS`, which leaves out the screens. The main thread does the work of
+  /// each frame, like the autosave and the finished assets, @ref update_rate times per second,
+  /// and sleeps in between. There is no UI thread.
+  struct HeadlessUIManager final : UIManager {
+    /// Low, since nothing waits for the frames to be drawn
+    static constexpr float update_rate = 10;
+
+    HeadlessUIManager() = default;
+
+    void main_ui_loop() override;
+  };
+
+} // namespace otto::services
+
+// kak: other_file=../../../src/headless_ui.cpp
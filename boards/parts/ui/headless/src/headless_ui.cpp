@@ -0,0 +1,19 @@
+#include "board/ui/headless_ui_manager.hpp"
+
+#include "services/controller.hpp"
+
+namespace otto::services {
+
+  void HeadlessUIManager::main_ui_loop()
+  {
+    while (Application::current().running()) {
+      Controller::current().flush_events();
+      // Whether a frame would be drawn does not matter
+      update_frame();
+      frame_scheduler.wait(util::FrameScheduler::duration(1 / update_rate));
+    }
+  }
+
+} // namespace otto::services
+
+// kak: other_file=../include/board/ui/headless_ui_manager.hpp
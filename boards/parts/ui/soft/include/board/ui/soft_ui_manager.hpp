@@ -0,0 +1,20 @@
+#pragma once
+
+#include "services/ui_manager.hpp"
+
+namespace otto::services {
+
+  /// Renders the UI on the cpu, with @ref core::ui::vg::SoftRenderer
+  ///
+  /// For boards without a gpu. Frames are written straight to the RGB565 framebuffer of the
+  /// display, `/dev/fb1`, or `/dev/fb0` if there is no secondary display. Input is left to the
+  /// controller.
+  struct SoftUIManager final : UIManager {
+    SoftUIManager() = default;
+
+    void main_ui_loop() override;
+  };
+
+} // namespace otto::services
+
+// kak: other_file=../../../src/soft_ui.cpp
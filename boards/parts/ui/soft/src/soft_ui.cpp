@@ -0,0 +1,119 @@
+#include "board/ui/soft_ui_manager.hpp"
+
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include "core/ui/soft_renderer.hpp"
+#include "core/ui/vector_graphics.hpp"
+#include "services/controller.hpp"
+#include "services/log_manager.hpp"
+#include "util/exception.hpp"
+
+namespace otto::services {
+
+  using namespace core::ui;
+
+  namespace {
+    /// The memory mapped framebuffer of the display
+    struct Framebuffer {
+      Framebuffer()
+      {
+        for (auto* path : {"/dev/fb1", "/dev/fb0"}) {
+          fd = open(path, O_RDWR);
+          if (fd != -1) break;
+        }
+        if (fd == -1) throw util::exception("Unable to open the display framebuffer");
+        if (ioctl(fd, FBIOGET_FSCREENINFO, &finfo) || ioctl(fd, FBIOGET_VSCREENINFO, &vinfo)) {
+          close(fd);
+          throw util::exception("Unable to get the display information");
+        }
+        if (vinfo.bits_per_pixel != 16) {
+          close(fd);
+          throw util::exception("The display is {}bps, only 16bps (RGB565) is supported", vinfo.bits_per_pixel);
+        }
+        data = (char*) mmap(0, finfo.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+          close(fd);
+          throw util::exception("Unable to create memory mapping");
+        }
+        LOGI("Soft UI renders to a {} x {} display", vinfo.xres, vinfo.yres);
+      }
+
+      ~Framebuffer() noexcept
+      {
+        munmap(data, finfo.smem_len);
+        close(fd);
+      }
+
+      /// Copy `pixels`, `width` by `height`, to the top left of the display
+      ///
+      /// Like @ref board::ui::RpiFBCP::copy, only the changed part of each row is written.
+      void copy(gsl::span<const std::uint16_t> pixels, int width, int height)
+      {
+        const int w = std::min<int>(width, vinfo.xres);
+        const int h = std::min<int>(height, vinfo.yres);
+        bool full = last.size() != pixels.size();
+        if (full) last.assign(pixels.begin(), pixels.end());
+        for (int y = 0; y < h; y++) {
+          const std::uint16_t* row = pixels.data() + y * width;
+          std::uint16_t* prev = last.data() + y * width;
+          int first = 0;
+          int end = w;
+          if (!full) {
+            while (first < end && row[first] == prev[first]) first++;
+            while (end > first && row[end - 1] == prev[end - 1]) end--;
+            if (first == end) continue;
+          }
+          std::copy(row + first, row + end, prev + first);
+          auto* dst = reinterpret_cast<std::uint16_t*>(data + y * finfo.line_length);
+          std::copy(row + first, row + end, dst + first);
+        }
+      }
+
+      int fd = -1;
+      char* data = nullptr;
+      std::vector<std::uint16_t> last;
+      struct fb_fix_screeninfo finfo;
+      struct fb_var_screeninfo vinfo;
+    };
+  } // namespace
+
+  void SoftUIManager::main_ui_loop()
+  {
+    vg::SoftRenderer renderer(vg::width, vg::height);
+    vg::Canvas canvas(renderer.context(), vg::width, vg::height);
+    vg::initUtils(canvas);
+
+    std::unique_ptr<Framebuffer> fb;
+    try {
+      fb = std::make_unique<Framebuffer>();
+    } catch (util::exception& e) {
+      LOGE("Soft UI: {}", e.what());
+      Application::current().exit(Application::ErrorCode::graphics_error);
+      return;
+    }
+
+    while (Application::current().running()) {
+      Controller::current().flush_events();
+
+      // The last frame stays on the display until something changes
+      if (update_frame()) {
+        renderer.clear(vg::Colours::Black);
+        canvas.begineFrame(vg::width, vg::height);
+        draw_frame(canvas);
+        canvas.endFrame();
+        fb->copy(renderer.pixels(), renderer.width(), renderer.height());
+      }
+
+      frame_scheduler.wait(util::FrameScheduler::duration(1 / frame_rate(30)));
+    }
+  }
+
+} // namespace otto::services
+
+// kak: other_file=../include/board/ui/soft_ui_manager.hpp
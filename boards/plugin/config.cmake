@@ -0,0 +1,12 @@
+otto_include_board(parts/audio/plugin)
+
+# The library the wrappers of the plugin formats link to. The executable runs instances side by
+# side, like a host, to measure how many fit.
+add_library(otto_plugin SHARED
+  ${OTTO_SOURCE_DIR}/boards/plugin/src/plugin_instance.cpp
+  ${OTTO_SOURCE_DIR}/boards/parts/audio/plugin/src/audio_driver.cpp)
+target_include_directories(otto_plugin PUBLIC
+  ${OTTO_SOURCE_DIR}/boards/plugin/include
+  ${OTTO_SOURCE_DIR}/boards/parts/audio/plugin/include)
+target_link_libraries(otto_plugin PUBLIC otto)
+otto_add_definitions(otto_plugin)
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+
+#include <gsl/span>
+
+#include "core/audio/midi.hpp"
+
+#include "services/application.hpp"
+
+namespace otto::services {
+
+  struct PluginAudioManager;
+
+  /// One instance of OTTO in a plugin host
+  ///
+  /// Owns an @ref Application of its own, with the engine graph, the clock and the state of
+  /// the instance, so a host can run several instances side by side, each on its own thread.
+  /// Every call enters the application of the instance, see @ref Application::Scope.
+  ///
+  /// This is the interface the wrappers of the plugin formats call into. The wrappers translate
+  /// the buffers and events of the host, and call @ref process from its audio threads.
+  struct PluginInstance {
+    struct Config {
+      int samplerate = 48000;
+      /// The most frames the host passes to one call of @ref process
+      int max_buffer_size = 512;
+    };
+
+    /// Construct the services of the instance, and start its engines
+    PluginInstance(Config config);
+    ~PluginInstance();
+
+    PluginInstance(const PluginInstance&) = delete;
+    PluginInstance& operator=(const PluginInstance&) = delete;
+
+    /// Process one buffer of the host. See @ref PluginAudioManager::process.
+    ///
+    /// May be called from any thread, but not from two threads at once.
+    void process(const float* input,
+                 float* out_left,
+                 float* out_right,
+                 int nframes,
+                 gsl::span<const core::midi::AnyMidiEvent> events) noexcept;
+
+    /// Do the work of the UI thread, like the UI loop of a standalone OTTO would
+    ///
+    /// To be called regularly from the main thread of the host.
+    void idle();
+
+    Application& application() noexcept
+    {
+      return *_app;
+    }
+
+  private:
+    std::unique_ptr<Application> _app;
+    PluginAudioManager* _audio;
+  };
+
+} // namespace otto::services
+
+// kak: other_file=../../src/plugin_instance.cpp
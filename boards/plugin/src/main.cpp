@@ -0,0 +1,112 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/audio/midi.hpp"
+
+#include "services/log_manager.hpp"
+
+#include "board/plugin_instance.hpp"
+
+using namespace otto;
+using namespace otto::services;
+
+int handle_exception(const char* e);
+int handle_exception(std::exception& e);
+int handle_exception();
+
+void usage()
+{
+  std::cerr << "Usage: otto [--instances 4] [--seconds 10] [--buffer-size 256]\n"
+               "Runs instances of the plugin side by side, each on its own thread, like a plugin\n"
+               "host does, and reports how much faster than realtime each of them renders.\n";
+}
+
+/// Render `seconds` of a chord held by `instance`, in buffers of `buffer_size`
+///
+/// \returns the time it took, in seconds
+double render(PluginInstance& instance, double seconds, int buffer_size, int samplerate)
+{
+  std::vector<float> input(buffer_size), left(buffer_size), right(buffer_size);
+  std::vector<core::midi::AnyMidiEvent> chord = {core::midi::NoteOnEvent(60), core::midi::NoteOnEvent(64),
+                                                 core::midi::NoteOnEvent(67)};
+  long total = seconds * samplerate;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long offset = 0; offset < total; offset += buffer_size) {
+    auto events = offset == 0 ? gsl::span<const core::midi::AnyMidiEvent>(chord)
+                              : gsl::span<const core::midi::AnyMidiEvent>();
+    instance.process(input.data(), left.data(), right.data(), buffer_size, events);
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[])
+{
+  int instance_count = 4;
+  double seconds = 10;
+  PluginInstance::Config config;
+  config.max_buffer_size = 256;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (arg == "--instances") instance_count = std::stoi(value);
+    else if (arg == "--seconds") seconds = std::stod(value);
+    else if (arg == "--buffer-size") config.max_buffer_size = std::stoi(value);
+    else {
+      usage();
+      return 1;
+    }
+  }
+
+  try {
+    std::vector<std::unique_ptr<PluginInstance>> instances;
+    for (int i = 0; i < instance_count; i++) instances.push_back(std::make_unique<PluginInstance>(config));
+
+    std::vector<double> times(instance_count);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < instance_count; i++) {
+      threads.emplace_back([&, i] { times[i] = render(*instances[i], seconds, config.max_buffer_size, config.samplerate); });
+    }
+    for (auto& thread : threads) thread.join();
+
+    for (int i = 0; i < instance_count; i++) {
+      LOGI("Instance {}: rendered {:.2f}s of audio in {:.2f}s, {:.1f}x realtime", i, seconds, times[i],
+           seconds / times[i]);
+    }
+  } catch (const char* e) {
+    return handle_exception(e);
+  } catch (std::exception& e) {
+    return handle_exception(e);
+  } catch (...) {
+    return handle_exception();
+  }
+
+  LOG_F(INFO, "Exiting");
+  return 0;
+}
+
+int handle_exception(const char* e)
+{
+  LOGE(e);
+  LOGE("Exception thrown, exitting!");
+  return 1;
+}
+
+int handle_exception(std::exception& e)
+{
+  LOGE(e.what());
+  LOGE("Exception thrown, exitting!");
+  return 1;
+}
+
+int handle_exception()
+{
+  LOGE("Unknown exception thrown, exitting!");
+  return 1;
+}
@@ -0,0 +1,87 @@
+#include "board/plugin_instance.hpp"
+
+#include <mutex>
+
+#include "services/asset_loader.hpp"
+#include "services/clock_manager.hpp"
+#include "services/controller.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "services/preset_manager.hpp"
+#include "services/state_manager.hpp"
+#include "services/ui_manager.hpp"
+
+#include "board/audio_driver.hpp"
+
+namespace otto::services {
+
+  namespace {
+    /// The host shows the UI of the plugin, if any
+    struct PluginUIManager final : UIManager {
+      PluginUIManager() = default;
+
+      void main_ui_loop() override {}
+    };
+
+    /// The logger is process wide, so the first instance starts it, and it lives until the
+    /// plugin is unloaded. The instances get no log manager of their own.
+    std::unique_ptr<LogManager> start_logging()
+    {
+      static std::once_flag started;
+      std::call_once(started, [] {
+        static char name[] = "otto_plugin";
+        static char* argv[] = {name, nullptr};
+        static LogManager log_manager{1, argv, false};
+      });
+      return nullptr;
+    }
+  } // namespace
+
+  PluginInstance::PluginInstance(Config config)
+  {
+    _app = std::make_unique<Application>(start_logging,
+                                         StateManager::create_in_memory,
+                                         std::make_unique<PresetManager>,
+                                         [&] {
+                                           return std::make_unique<PluginAudioManager>(
+                                             config.samplerate, config.max_buffer_size);
+                                         },
+                                         ClockManager::create_default,
+                                         std::make_unique<AssetLoader>,
+                                         std::make_unique<PluginUIManager>,
+                                         Controller::make_dummy,
+                                         EngineManager::create_hosted);
+    _audio = &static_cast<PluginAudioManager&>(*_app->audio_manager);
+
+    Application::Scope scope{*_app};
+    _app->engine_manager->start();
+    // The first buffers should not wait for the samples and wavetables
+    _app->asset_loader->flush();
+    _app->audio_manager->start();
+  }
+
+  PluginInstance::~PluginInstance()
+  {
+    Application::Scope scope{*_app};
+    _app.reset();
+  }
+
+  void PluginInstance::process(const float* input,
+                               float* out_left,
+                               float* out_right,
+                               int nframes,
+                               gsl::span<const core::midi::AnyMidiEvent> events) noexcept
+  {
+    Application::Scope scope{*_app};
+    _audio->process(input, out_left, out_right, nframes, events);
+  }
+
+  void PluginInstance::idle()
+  {
+    Application::Scope scope{*_app};
+    _app->engine_manager->update();
+  }
+
+} // namespace otto::services
+
+// kak: other_file=../include/board/plugin_instance.hpp
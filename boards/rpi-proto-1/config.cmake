@@ -1,4 +1,19 @@
 otto_include_board(parts/ui/egl)
-otto_include_board(parts/audio/rtaudio)
+if (OTTO_JACK)
+  otto_include_board(parts/audio/jack)
+elseif (OTTO_ALSA)
+  otto_include_board(parts/audio/alsa)
+else()
+  otto_include_board(parts/audio/rtaudio)
+endif()
 set(OTTO_USE_FBCP ON)
-set(CMAKE_LINKER_FLAGS_RELEASE "${CMAKE_LINKER_FLAGS_RELEASE} -ffast-math -funsafe-math-optimizations -mfpu=neon-vfpv4")
+
+# The Cortex-A53 of the Pi 3. 32 bit builds also need the NEON fpu enabled for the SIMD kernels
+if (CMAKE_SYSTEM_PROCESSOR MATCHES "aarch64|arm64")
+  otto_cpu_flags(-mcpu=cortex-a53)
+elseif (CMAKE_SYSTEM_PROCESSOR MATCHES "^arm")
+  otto_cpu_flags(-mcpu=cortex-a53 -mfpu=neon-fp-armv8)
+endif()
+
+# Cubic interpolation of the sample players costs too much on the Pi
+target_compile_definitions(otto PUBLIC OTTO_INTERPOLATION=linear)
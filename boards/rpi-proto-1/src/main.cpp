@@ -1,10 +1,19 @@
 #include <csignal>
+#include <cstdlib>
+#include <optional>
+#include <thread>
+#include <vector>
 
 #include "core/audio/midi.hpp"
 
+#include "services/asset_loader.hpp"
 #include "services/audio_manager.hpp"
 #include "services/engine_manager.hpp"
+#include "services/latency_tuner.hpp"
 #include "services/log_manager.hpp"
+#include "services/metrics_server.hpp"
+#include "services/network_clock.hpp"
+#include "services/osc_server.hpp"
 #include "services/preset_manager.hpp"
 #include "services/state_manager.hpp"
 #include "services/ui_manager.hpp"
@@ -13,35 +22,102 @@
 #include "board/audio_driver.hpp"
 #include "board/ui/egl_ui_manager.hpp"
 
+#include "util/realtime.hpp"
+#include "util/thread_policy.hpp"
+
 using namespace otto;
 using namespace otto::services;
 
+#if OTTO_JACK
+using BoardAudioManager = JackAudioManager;
+#elif OTTO_ALSA
+using BoardAudioManager = AlsaAudioManager;
+#else
+using BoardAudioManager = RTAudioAudioManager;
+#endif
+
 int handle_exception(const char* e);
 int handle_exception(std::exception& e);
 int handle_exception();
 
+/// Keep the other threads off the cores of the audio thread and the graph worker
+///
+/// The ui, midi, io and background threads get the other cores. The main thread runs the ui
+/// loop, so it enters the ui class. Threads started by libraries, like the midi input of
+/// RtMidi, inherit its cores.
+/// \returns false if there are no other cores, or they could not be set
+static bool configure_threads()
+{
+  int cores = std::thread::hardware_concurrency();
+  std::vector<int> ui_cores;
+  for (int i = 0; i < cores; i++) {
+    if (i != AudioManager::audio_core && i != AudioManager::audio_core + 1) ui_cores.push_back(i);
+  }
+  if (ui_cores.empty()) return false;
+  for (auto cls : {util::ThreadClass::ui, util::ThreadClass::midi, util::ThreadClass::io, util::ThreadClass::background}) {
+    auto policy = util::thread_policy(cls);
+    policy.cores = ui_cores;
+    util::set_thread_policy(cls, std::move(policy));
+  }
+  return util::enter_thread_class(util::ThreadClass::ui);
+}
+
 int main(int argc, char* argv[])
 {
   int result = 0;
+  // Before any threads are started
+  bool pinned = configure_threads();
   try {
     Application app {
       [&] { return std::make_unique<LogManager>(argc, argv); },
       StateManager::create_default,
       std::make_unique<PresetManager>,
-      std::make_unique<RTAudioAudioManager>,
+      std::make_unique<BoardAudioManager>,
       ClockManager::create_default,
+      std::make_unique<AssetLoader>,
       std::make_unique<EGLUIManager>,
       EngineManager::create_default
     };
 
+    LOGW_IF(!pinned, "Could not keep the ui threads off the audio cores");
+    // The engines are constructed, so this faults in all of their memory
+    if (util::lock_memory()) {
+      LOGI("Locked memory");
+    } else {
+      LOGW("Could not lock memory, the audio thread may page fault. Run with CAP_IPC_LOCK, or raise RLIMIT_MEMLOCK");
+    }
+    app.startup_phase("lock memory");
+
     // Overwrite the logger signal handlers
     std::signal(SIGABRT, Application::handle_signal);
     std::signal(SIGTERM, Application::handle_signal);
     std::signal(SIGINT, Application::handle_signal);
     std::signal(SIGKILL, Application::handle_signal);
 
+    // For the units in installations, which nobody watches the screen of
+    MetricsServer metrics;
+    // Keeps the units of an installation in phase, without midi cables
+    std::optional<NetworkClock> network_clock;
+    if (const char* enabled = std::getenv("OTTO_NETWORK_CLOCK"); enabled && enabled == std::string("1")) {
+      network_clock.emplace(*app.clock_manager);
+    }
+    // Remote control from show control systems
+    std::optional<OscServer> osc;
+    if (const char* port = std::getenv("OTTO_OSC_PORT"); port && app.engine_manager->parameter_queue()) {
+      osc.emplace(*app.engine_manager->parameter_queue(), std::atoi(port));
+    }
+
     app.engine_manager->start();
+    app.startup_phase("engines");
     app.audio_manager->start();
+    app.startup_phase("audio");
+    // Finds the lowest safe latency of this unit, with the patch it starts with
+    std::optional<LatencyTuner> latency_tuner;
+    if (const char* enabled = std::getenv("OTTO_TUNE_LATENCY"); enabled && enabled == std::string("1")) {
+      LatencyTuner::Settings settings;
+      if (const char* margin = std::getenv("OTTO_TUNE_LATENCY_MARGIN")) settings.margin_steps = std::atoi(margin);
+      latency_tuner.emplace(*app.audio_manager, settings);
+    }
     app.ui_manager->main_ui_loop();
 
     if (app.error() == Application::ErrorCode::ui_closed) {
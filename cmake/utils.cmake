@@ -44,6 +44,22 @@ function(otto_debug_definitions)
     message("\n")
 endfunction(otto_debug_definitions)
 
+# Tune the code for the cpu of the board, unless OTTO_CPU_FLAGS is set
+#
+# Called from the config.cmake of the boards. OTTO_CPU_FLAGS=none disables the tuning.
+macro(otto_cpu_flags)
+    if ("${OTTO_CPU_FLAGS}" STREQUAL "none")
+        message("Cpu flags: none")
+    elseif (NOT "${OTTO_CPU_FLAGS}" STREQUAL "")
+        separate_arguments(OTTO_CPU_FLAGS_LIST UNIX_COMMAND "${OTTO_CPU_FLAGS}")
+        target_compile_options(otto PUBLIC ${OTTO_CPU_FLAGS_LIST})
+        message("Cpu flags: ${OTTO_CPU_FLAGS}")
+    else()
+        target_compile_options(otto PUBLIC ${ARGN})
+        message("Cpu flags: ${ARGN}")
+    endif()
+endmacro(otto_cpu_flags)
+
 macro(otto_include_board BOARD)
 
     set(BOARD_DIR "${OTTO_SOURCE_DIR}/boards/${BOARD}/")
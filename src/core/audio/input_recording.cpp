@@ -0,0 +1,178 @@
+#include "input_recording.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+
+namespace otto::core::audio {
+
+  namespace {
+
+    using exception = InputRecording::exception;
+    using ErrorCode = InputRecording::ErrorCode;
+
+    constexpr char magic[] = {'O', 'T', 'T', 'O', 'R', 'E', 'C'};
+
+    template<typename T>
+    void put(std::ostream& out, T value)
+    {
+      static_assert(std::is_unsigned_v<T>);
+      for (std::size_t i = 0; i < sizeof(T); i++) out.put(char((value >> (8 * i)) & 0xFF));
+    }
+
+    void put(std::ostream& out, double value)
+    {
+      std::uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      put(out, bits);
+    }
+
+    /// Reads the little endian fields of a recording. Reading past the end sets `failed`.
+    struct Reader {
+      const std::vector<unsigned char>& data;
+      std::size_t pos = 0;
+      bool failed = false;
+
+      bool done() const noexcept
+      {
+        return pos >= data.size();
+      }
+
+      template<typename T>
+      T get() noexcept
+      {
+        if (pos + sizeof(T) > data.size()) {
+          failed = true;
+          pos = data.size();
+          return 0;
+        }
+        std::uint64_t res = 0;
+        for (std::size_t i = 0; i < sizeof(T); i++) res |= std::uint64_t(data[pos++]) << (8 * i);
+        if constexpr (std::is_same_v<T, double>) {
+          double d;
+          std::memcpy(&d, &res, sizeof(d));
+          return d;
+        } else {
+          return T(res);
+        }
+      }
+
+      std::string string()
+      {
+        auto size = get<std::uint8_t>();
+        if (pos + size > data.size()) {
+          failed = true;
+          return {};
+        }
+        std::string res(data.begin() + pos, data.begin() + pos + size);
+        pos += size;
+        return res;
+      }
+    };
+
+  } // namespace
+
+  void InputRecording::write_header(std::ostream& out) const
+  {
+    out.write(magic, sizeof(magic));
+    put(out, version);
+    put(out, std::uint32_t(samplerate));
+    put(out, std::uint32_t(buffer_size));
+    put(out, std::uint8_t(parts.size()));
+    for (auto& part : parts) {
+      put(out, std::uint8_t(part.size()));
+      out.write(part.data(), std::uint8_t(part.size()));
+    }
+  }
+
+  void InputRecording::write(std::ostream& out, const MidiRecord& record)
+  {
+    out.put('M');
+    put(out, record.buffer);
+    put(out, record.event.status);
+    put(out, record.event.data[0]);
+    put(out, record.event.data[1]);
+    put(out, std::uint16_t(record.event.time));
+  }
+
+  void InputRecording::write(std::ostream& out, const PropertyRecord& record)
+  {
+    out.put('P');
+    put(out, record.buffer);
+    put(out, record.part);
+    put(out, record.hash);
+    put(out, record.value);
+  }
+
+  void InputRecording::save(const fs::path& path) const
+  {
+    std::ofstream out(path.c_str(), std::ios::binary);
+    write_header(out);
+    // The records of a buffer do not need to be in order between the two kinds
+    for (auto& record : midi) write(out, record);
+    for (auto& record : properties) write(out, record);
+  }
+
+  InputRecording InputRecording::load(const fs::path& path)
+  {
+    std::ifstream stream(path.c_str(), std::ios::binary);
+    if (!stream) {
+      throw exception(ErrorCode::file_not_found, "Could not open recording {}", path.string());
+    }
+    std::vector<unsigned char> data{std::istreambuf_iterator<char>(stream),
+                                    std::istreambuf_iterator<char>()};
+    if (data.size() < sizeof(magic) || !std::equal(std::begin(magic), std::end(magic), data.begin())) {
+      throw exception(ErrorCode::invalid_file, "{} is not an input recording", path.string());
+    }
+
+    Reader file{data, sizeof(magic)};
+    InputRecording res;
+    if (auto v = file.get<std::uint8_t>(); v > version) {
+      throw exception(ErrorCode::invalid_file, "Input recording version {} is not supported", v);
+    }
+    res.samplerate = file.get<std::uint32_t>();
+    res.buffer_size = file.get<std::uint32_t>();
+    res.parts.resize(file.get<std::uint8_t>());
+    for (auto& part : res.parts) part = file.string();
+    if (file.failed) throw exception(ErrorCode::invalid_file, "The header of {} is cut short", path.string());
+
+    while (!file.done()) {
+      auto tag = file.get<std::uint8_t>();
+      if (tag == 'M') {
+        MidiRecord record;
+        record.buffer = file.get<std::uint32_t>();
+        record.event.status = file.get<std::uint8_t>();
+        record.event.data[0] = file.get<std::uint8_t>();
+        record.event.data[1] = file.get<std::uint8_t>();
+        record.event.time = file.get<std::uint16_t>();
+        if (!file.failed) res.midi.push_back(record);
+      } else if (tag == 'P') {
+        PropertyRecord record;
+        record.buffer = file.get<std::uint32_t>();
+        record.part = file.get<std::uint8_t>();
+        record.hash = file.get<std::uint32_t>();
+        record.value = file.get<double>();
+        if (!file.failed) res.properties.push_back(record);
+      } else {
+        throw exception(ErrorCode::invalid_file, "Unknown record '{}' in {}", char(tag), path.string());
+      }
+    }
+
+    // Records of one kind are written in order, but stay safe against hand made files
+    std::stable_sort(res.midi.begin(), res.midi.end(), [](auto& a, auto& b) { return a.buffer < b.buffer; });
+    std::stable_sort(res.properties.begin(), res.properties.end(),
+                     [](auto& a, auto& b) { return a.buffer < b.buffer; });
+    return res;
+  }
+
+  std::uint32_t InputRecording::length() const noexcept
+  {
+    std::uint32_t res = 0;
+    if (!midi.empty()) res = std::max(res, midi.back().buffer + 1);
+    if (!properties.empty()) res = std::max(res, properties.back().buffer + 1);
+    return res;
+  }
+
+} // namespace otto::core::audio
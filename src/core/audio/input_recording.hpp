@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "core/audio/midi.hpp"
+#include "util/exception.hpp"
+#include "util/filesystem.hpp"
+
+namespace otto::core::audio {
+
+  /// The midi and property changes that went into the engines, by the buffer they went into
+  ///
+  /// Recorded live by @ref services::InputRecorder, and replayed by the offline renderer to
+  /// reproduce a performance, like one that ended in a glitch, with a debugger attached.
+  ///
+  /// The file is a compact binary format, little endian: the magic `OTTOREC`, a version byte,
+  /// the sample rate and buffer size as `u32`, and the part names as a `u8` count followed by
+  /// `u8` length prefixed strings. Then follow the records, each a tag byte followed by
+  /// ```
+  /// 'M'  u32 buffer, u8 status, u8 data[2], u16 frame           // a midi event
+  /// 'P'  u32 buffer, u8 part, u32 property hash, f64 value      // a property change
+  /// ```
+  /// The records are appended as they happen, so a recording that was cut short by a crash
+  /// can still be read up to its last whole record.
+  struct InputRecording {
+    enum struct ErrorCode {
+      /// The file could not be opened
+      file_not_found,
+      /// The file is not a recording, or of a newer version
+      invalid_file,
+    };
+
+    using exception = util::as_exception<ErrorCode>;
+
+    static constexpr std::uint8_t version = 1;
+
+    struct MidiRecord {
+      /// The buffer, counted from the start of the recording
+      std::uint32_t buffer;
+      /// The event, with its time in frames into the buffer
+      midi::AnyMidiEvent event;
+    };
+
+    struct PropertyRecord {
+      /// The buffer, counted from the start of the recording. The change was made before it.
+      std::uint32_t buffer;
+      /// The index of the engine in @ref parts
+      std::uint8_t part;
+      /// The hash of the path of the property, see @ref props::PropertyInfo
+      std::uint32_t hash;
+      double value;
+    };
+
+    /// Write the header to `out`
+    void write_header(std::ostream& out) const;
+    static void write(std::ostream& out, const MidiRecord& record);
+    static void write(std::ostream& out, const PropertyRecord& record);
+
+    /// Write the whole recording to `path`
+    void save(const fs::path& path) const;
+
+    /// Read a recording, up to its last whole record
+    ///
+    /// \throws `exception` with `ErrorCode::file_not_found` or `ErrorCode::invalid_file`
+    static InputRecording load(const fs::path& path);
+
+    /// The number of buffers until the last record
+    std::uint32_t length() const noexcept;
+
+    int samplerate = 48000;
+    int buffer_size = 256;
+    /// The names of the engines the property changes are for, like the slot parts
+    std::vector<std::string> parts;
+    /// Sorted by buffer, in the order they went into it
+    std::vector<MidiRecord> midi;
+    /// Sorted by buffer, in the order they were made
+    std::vector<PropertyRecord> properties;
+  };
+
+} // namespace otto::core::audio
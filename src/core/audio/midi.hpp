@@ -1,11 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdint>
+#include <type_traits>
 #include <gsl/gsl>
 
 #include "util/algorithm.hpp"
 #include "util/exception.hpp"
+#include "util/local_vector.hpp"
+#include "util/math.hpp"
 #include "util/variant.hpp"
 
 #include "services/log_manager.hpp"
@@ -13,9 +18,33 @@
 
 namespace otto::core::midi {
 
+  /// The frequency of each key, in Hz, with one entry past the last key, so fractional notes up
+  /// to 127 can interpolate
+  using FreqTable = std::array<float, 129>;
+
   namespace detail {
 
-    inline double freq_table[128];
+    /// Equal temperament with A4 at `tuning` Hz
+    constexpr FreqTable equal_temperament(double tuning = 440)
+    {
+      FreqTable res = {};
+      for (int i = 0; i < 129; i++) {
+        res[i] = float(tuning * util::math::exp2((i - 69) / 12.0));
+      }
+      return res;
+    }
+
+    /// Constant initialized, so it is valid before any code runs
+    inline FreqTable freq_table = equal_temperament();
+
+    /// `2^(i/128 - 1)`, the frequency ratios over the bend range of one octave, every 64 steps
+    constexpr std::array<float, 257> pitch_bend_ratios = [] {
+      std::array<float, 257> res = {};
+      for (int i = 0; i < 257; i++) {
+        res[i] = float(util::math::exp2(i / 128.0 - 1));
+      }
+      return res;
+    }();
 
     constexpr std::array<const char*, 128> note_names = {
       {"C-2", "C#-2", "D-2", "D#-2", "E-2", "F-2", "F#-2", "G-2", "G#-2", "A-2", "A#-2", "B-2",
@@ -69,8 +98,9 @@ namespace otto::core::midi {
 
     Type type;
 
-    int channel;
-    int time;
+    int channel = 0;
+    /// The offset in frames from the start of the buffer the event is processed in
+    int time = 0;
   };
 
   struct NoteEvent : MidiEvent {
@@ -145,7 +175,9 @@ namespace otto::core::midi {
     int controler = 0;
     int value = 0;
 
-    ControlChangeEvent(int controler, int value) : controler(controler), value(value) {}
+    ControlChangeEvent(int controler, int value)
+      : MidiEvent{Type::ControlChange}, controler(controler), value(value)
+    {}
     ControlChangeEvent(const MidiEvent& event) : MidiEvent(event) {}
 
     std::array<byte, 3> to_bytes()
@@ -165,7 +197,7 @@ namespace otto::core::midi {
   struct PitchBendEvent : public MidiEvent {
     int value = 0;
 
-    PitchBendEvent(int value) : value(value) {}
+    PitchBendEvent(int value) : MidiEvent{Type::PitchBend}, value(value) {}
     PitchBendEvent(const MidiEvent& event) : MidiEvent(event){};
 
     static PitchBendEvent from_bytes(gsl::span<byte> bytes, int time = 0)
@@ -178,8 +210,185 @@ namespace otto::core::midi {
     }
   };
 
-  using AnyMidiEvent =
-    mpark::variant<MidiEvent, NoteOnEvent, NoteOffEvent, ControlChangeEvent, PitchBendEvent>;
+  /// A packed midi event of 8 bytes
+  ///
+  /// Stores the raw status and data bytes, and the frame offset, so buffers of events are
+  /// small and cheap to copy. The typed events above are views of it: @ref visit, and thereby
+  /// `util::match`, dispatches on the status byte with a switch, and passes a decoded copy of
+  /// the event to the matching handler.
+  ///
+  /// ```cpp
+  /// util::match(event, [](midi::NoteOnEvent& evt) { ... }, [](auto&&) {});
+  /// ```
+  struct AnyMidiEvent {
+    using byte = MidiEvent::byte;
+
+    AnyMidiEvent() noexcept = default;
+
+    AnyMidiEvent(const MidiEvent& evt) noexcept : status(status_of(evt)), time(evt.time) {}
+
+    AnyMidiEvent(const NoteOnEvent& evt) noexcept
+      : status(status_of(evt)), data{evt.key, evt.velocity}, time(evt.time)
+    {}
+
+    AnyMidiEvent(const NoteOffEvent& evt) noexcept
+      : status(status_of(evt)), data{evt.key, evt.velocity}, time(evt.time)
+    {}
+
+    AnyMidiEvent(const ControlChangeEvent& evt) noexcept
+      : status(status_of(evt)), data{byte(evt.controler), byte(evt.value)}, time(evt.time)
+    {}
+
+    AnyMidiEvent(const PitchBendEvent& evt) noexcept
+      : status(status_of(evt)),
+        data{byte(evt.value & 0x7F), byte((evt.value >> 7) & 0x7F)},
+        time(evt.time)
+    {}
+
+    MidiEvent::Type type() const noexcept
+    {
+      return MidiEvent::Type(status >> 4);
+    }
+
+    int channel() const noexcept
+    {
+      return status & 0b1111;
+    }
+
+    /// The event as a plain @ref MidiEvent
+    MidiEvent event() const noexcept
+    {
+      return {type(), channel(), time};
+    }
+
+    /// The event as a @ref NoteOnEvent
+    ///
+    /// \requires `type() == MidiEvent::Type::NoteOn`
+    NoteOnEvent note_on() const noexcept
+    {
+      NoteOnEvent res = event();
+      res.key = data[0];
+      res.velocity = data[1];
+      return res;
+    }
+
+    /// The event as a @ref NoteOffEvent
+    ///
+    /// \requires `type() == MidiEvent::Type::NoteOff`
+    NoteOffEvent note_off() const noexcept
+    {
+      NoteOffEvent res = event();
+      res.key = data[0];
+      res.velocity = data[1];
+      return res;
+    }
+
+    /// The event as a @ref ControlChangeEvent
+    ///
+    /// \requires `type() == MidiEvent::Type::ControlChange`
+    ControlChangeEvent control_change() const noexcept
+    {
+      ControlChangeEvent res = event();
+      res.controler = data[0];
+      res.value = data[1];
+      return res;
+    }
+
+    /// The event as a @ref PitchBendEvent
+    ///
+    /// \requires `type() == MidiEvent::Type::PitchBend`
+    PitchBendEvent pitch_bend() const noexcept
+    {
+      PitchBendEvent res = event();
+      res.value = data[0] | (data[1] << 7);
+      return res;
+    }
+
+    /// The raw midi bytes. Only the first @ref byte_size are used.
+    std::array<byte, 3> to_bytes() const noexcept
+    {
+      return {status, data[0], data[1]};
+    }
+
+    /// The number of bytes of the raw midi message
+    ///
+    /// Channel messages of types without a struct of their own, like program change, are
+    /// counted too, so they can be passed through.
+    std::size_t byte_size() const noexcept
+    {
+      switch (status >> 4) {
+      case 0xC: [[fallthrough]];
+      case 0xD: return 2;
+      case 0x8: [[fallthrough]];
+      case 0x9: [[fallthrough]];
+      case 0xA: [[fallthrough]];
+      case 0xB: [[fallthrough]];
+      case 0xE: return 3;
+      default: return 1;
+      }
+    }
+
+    /// The status byte, i.e. the type in the high nibble and the channel in the low one
+    byte status = 0;
+    std::array<byte, 2> data = {};
+    /// The offset in frames from the start of the buffer the event is processed in
+    std::int32_t time = 0;
+
+  private:
+    static byte status_of(const MidiEvent& evt) noexcept
+    {
+      return byte((byte(evt.type) << 4) | (evt.channel & 0b1111));
+    }
+  };
+
+  static_assert(sizeof(AnyMidiEvent) == 8);
+  static_assert(std::is_trivially_copyable_v<AnyMidiEvent>);
+
+  namespace detail {
+    template<typename F>
+    decltype(auto) visit_event(F&& f, const AnyMidiEvent& event)
+    {
+      switch (event.type()) {
+      case MidiEvent::Type::NoteOn: {
+        auto evt = event.note_on();
+        return f(evt);
+      }
+      case MidiEvent::Type::NoteOff: {
+        auto evt = event.note_off();
+        return f(evt);
+      }
+      case MidiEvent::Type::ControlChange: {
+        auto evt = event.control_change();
+        return f(evt);
+      }
+      case MidiEvent::Type::PitchBend: {
+        auto evt = event.pitch_bend();
+        return f(evt);
+      }
+      default: {
+        auto evt = event.event();
+        return f(evt);
+      }
+      }
+    }
+  } // namespace detail
+
+  /// Call `f` with the typed event
+  ///
+  /// Found by ADL from `util::match`. The typed event is a decoded copy, so changes to it do not
+  /// affect `event`.
+  template<typename F>
+  decltype(auto) visit(F&& f, const AnyMidiEvent& event)
+  {
+    return detail::visit_event(std::forward<F>(f), event);
+  }
+
+  /// \see visit(F&&, const AnyMidiEvent&)
+  template<typename F>
+  decltype(auto) visit(F&& f, AnyMidiEvent& event)
+  {
+    return detail::visit_event(std::forward<F>(f), event);
+  }
 
   inline AnyMidiEvent from_bytes(gsl::span<unsigned char> bytes, int time = 0)
   {
@@ -201,11 +410,21 @@ namespace otto::core::midi {
     }
   }
 
+  /// Use equal temperament with A4 at `tuning` Hz by default. It starts out at 440 Hz.
+  ///
+  /// Not synchronized with the audio thread, which may see a mix of both tunings for a buffer.
   inline void generateFreqTable(double tuning = 440)
   {
-    for (int i = 0; i < 128; i++) {
-      detail::freq_table[i] = tuning * std::pow(2.0, double(i - 69) / double(12));
-    }
+    detail::freq_table = detail::equal_temperament(tuning);
+  }
+
+  /// Use a custom tuning by default, for synths with no tuning of their own
+  ///
+  /// \param freqs The frequency of each key, in Hz. Must be increasing.
+  inline void set_tuning(const std::array<float, 128>& freqs)
+  {
+    std::copy(freqs.begin(), freqs.end(), detail::freq_table.begin());
+    detail::freq_table[128] = freqs[127] * (freqs[127] / freqs[126]);
   }
 
   constexpr const char* note_name(int key) noexcept
@@ -218,114 +437,246 @@ namespace otto::core::midi {
     return detail::freq_table[key];
   }
 
-  template<typename T, typename Allocator = std::allocator<T>>
-  struct shared_vector {
-    using value_type = T;
-    using vector_type = std::vector<T, Allocator>;
-    using allocator_type = Allocator;
-    using iterator = typename vector_type::iterator;
+  /// The frequency of a fractional note in `table`, interpolated between the keys around it
+  ///
+  /// The interpolation is linear in frequency, which is within a cent of the exact pitch for
+  /// equal temperament. `note` is clamped to `[0, 127]`.
+  inline float note_freq(const FreqTable& table, float note) noexcept
+  {
+    note = std::clamp(note, 0.f, 127.f);
+    int key = static_cast<int>(note);
+    float frac = note - key;
+    return table[key] + frac * (table[key + 1] - table[key]);
+  }
 
-    shared_vector() = default;
+  /// The frequency of a fractional note, interpolated between the keys around it
+  inline float note_freq(float note) noexcept
+  {
+    return note_freq(detail::freq_table, note);
+  }
 
-    shared_vector(vector_type&& other) : _data(std::make_shared<vector_type>(std::move(other))) {}
+  /// The frequency ratio of a pitch bend, with a range of one octave up or down
+  ///
+  /// \param value The 14 bit value of a @ref PitchBendEvent, with 8192 as the center
+  inline float pitch_bend_ratio(int value) noexcept
+  {
+    value = std::clamp(value, 0, 16383);
+    int i = value >> 6;
+    float frac = (value & 63) / 64.f;
+    return detail::pitch_bend_ratios[i] + frac * (detail::pitch_bend_ratios[i + 1] - detail::pitch_bend_ratios[i]);
+  }
 
-    shared_vector(const vector_type& other) : _data(std::make_shared<vector_type>(other)) {}
+  /// The kinds of events a processor reads, as flags, to hand it only those
+  enum struct EventMask : std::uint8_t {
+    none = 0,
+    /// Note on and off, and polyphonic aftertouch
+    notes = 1 << 0,
+    controllers = 1 << 1,
+    pitch_bend = 1 << 2,
+    /// Program change, channel pressure and system messages
+    other = 1 << 3,
+    all = notes | controllers | pitch_bend | other,
+  };
 
-    shared_vector(const allocator_type& alloc) : _data(std::make_shared<vector_type>(alloc)) {}
+  constexpr EventMask operator|(EventMask lhs, EventMask rhs) noexcept
+  {
+    return EventMask(std::uint8_t(lhs) | std::uint8_t(rhs));
+  }
 
-    bool empty() const {
-      return _data->empty();
+  constexpr EventMask operator&(EventMask lhs, EventMask rhs) noexcept
+  {
+    return EventMask(std::uint8_t(lhs) & std::uint8_t(rhs));
+  }
+
+  /// The kind of `event`, as a mask with one flag set
+  constexpr EventMask mask_of(const AnyMidiEvent& event) noexcept
+  {
+    switch (event.status >> 4) {
+    case 0x8: [[fallthrough]];
+    case 0x9: [[fallthrough]];
+    case 0xA: return EventMask::notes;
+    case 0xB: return EventMask::controllers;
+    case 0xE: return EventMask::pitch_bend;
+    default: return EventMask::other;
     }
+  }
 
-    auto begin()
+  /// A fixed-capacity buffer of midi events
+  ///
+  /// All storage is inline, so the buffer never allocates. Events added while the buffer is
+  /// full are dropped and counted, see @ref overflow_count.
+  struct MidiBuffer {
+    static constexpr std::size_t capacity = 256;
+
+    using value_type = AnyMidiEvent;
+    using storage_type = util::local_vector<AnyMidiEvent, capacity>;
+    using iterator = typename storage_type::iterator;
+    using const_iterator = typename storage_type::const_iterator;
+
+    bool empty() const noexcept
     {
-      return _data->begin();
+      return _events.empty();
     }
-    auto end()
+
+    std::size_t size() const noexcept
     {
-      return _data->end();
+      return _events.size();
     }
-    auto begin() const
+
+    iterator begin() noexcept
     {
-      return _data->begin();
+      return _events.begin();
     }
-    auto end() const
+    iterator end() noexcept
     {
-      return _data->end();
+      return _events.end();
     }
-    auto cbegin() const
+    const_iterator begin() const noexcept
     {
-      return _data->cbegin();
+      return _events.begin();
     }
-    auto cend() const
+    const_iterator end() const noexcept
     {
-      return _data->cend();
+      return _events.end();
     }
 
-    auto&& front()
+    AnyMidiEvent& operator[](std::size_t i) noexcept
     {
-      return _data->front();
+      return _events[i];
     }
-    auto&& back()
+
+    /// Add an event
+    ///
+    /// \returns `false` if the buffer was full, and the event was dropped
+    bool push_back(const AnyMidiEvent& event) noexcept
+    {
+      if (_events.size() == capacity) {
+        _overflow_count++;
+        return false;
+      }
+      _events.push_back(event);
+      return true;
+    }
+
+    /// Sort the events by their time, keeping the order of events with equal times
+    ///
+    /// This is an insertion sort, which does not allocate, and is linear for the usual case of
+    /// an already sorted buffer.
+    void sort_by_time() noexcept
     {
-      return _data->back();
+      for (std::size_t i = 1; i < _events.size(); i++) {
+        auto event = _events[i];
+        std::size_t j = i;
+        for (; j > 0 && _events[j - 1].time > event.time; j--) {
+          _events[j] = _events[j - 1];
+        }
+        _events[j] = event;
+      }
     }
-    auto&& front() const
+
+    /// Remove all events, and reset the overflow count
+    void clear() noexcept
     {
-      return _data->front();
+      _events.clear();
+      _overflow_count = 0;
     }
-    auto&& back() const
+
+    /// The number of events dropped since the last call to `clear()`
+    int overflow_count() const noexcept
     {
-      return _data->back();
+      return _overflow_count;
     }
 
-    auto& operator*()
+  private:
+    storage_type _events;
+    int _overflow_count = 0;
+  };
+
+  /// A non-owning reference to a @ref MidiBuffer
+  ///
+  /// This is how midi is passed through @ref audio::ProcessData. Copies refer to the same
+  /// buffer, and copying one is just copying a pointer, so no heap allocation or atomic
+  /// reference count is involved.
+  ///
+  /// A default constructed reference refers to no buffer. It is always empty, and events
+  /// added to it are dropped.
+  struct MidiBufferRef {
+    using value_type = AnyMidiEvent;
+    using iterator = MidiBuffer::iterator;
+
+    MidiBufferRef() noexcept = default;
+    MidiBufferRef(MidiBuffer& buffer) noexcept : _buffer(&buffer) {}
+
+    bool empty() const noexcept
     {
-      return *_data;
+      return _buffer == nullptr || _buffer->empty();
     }
-    auto& operator*() const
+
+    std::size_t size() const noexcept
     {
-      return *_data;
+      return _buffer == nullptr ? 0 : _buffer->size();
     }
 
-    auto& operator-> ()
+    iterator begin() const noexcept
     {
-      return &*_data;
+      return _buffer == nullptr ? iterator{} : _buffer->begin();
     }
-    auto& operator-> () const
+    iterator end() const noexcept
     {
-      return &*_data;
+      return _buffer == nullptr ? iterator{} : _buffer->end();
     }
 
-    auto& operator[](std::size_t i)
+    AnyMidiEvent& operator[](std::size_t i) const noexcept
     {
-      return (_data)[i];
+      return (*_buffer)[i];
     }
 
-    auto clear()
+    /// \returns `false` if the event was dropped
+    bool push_back(const AnyMidiEvent& event) const noexcept
     {
-      _data->clear();
+      return _buffer != nullptr && _buffer->push_back(event);
     }
 
-    auto push_back(const value_type& el)
+    void clear() const noexcept
     {
-      _data->push_back(el);
+      if (_buffer != nullptr) _buffer->clear();
     }
 
-    template<typename... Ref>
-    auto&& emplace_back(Ref&&... args)
+    /// \see MidiBuffer::sort_by_time
+    void sort_by_time() const noexcept
     {
-      return _data->emplace_back(std::forward<Ref>(args)...);
+      if (_buffer != nullptr) _buffer->sort_by_time();
     }
 
-    auto&& move_vector_out()
+    /// The referenced buffer, or `nullptr`
+    MidiBuffer* buffer() const noexcept
     {
-      return std::move(*_data);
+      return _buffer;
     }
 
   private:
-    std::shared_ptr<vector_type> _data = std::make_shared<vector_type>();
+    MidiBuffer* _buffer = nullptr;
   };
 
+  /// Add the events of `src` on `channel` to `dst`, or all of them if `channel` is negative
+  ///
+  /// For parts listening to one midi channel of a shared buffer.
+  inline void copy_channel(const MidiBufferRef& src, MidiBuffer& dst, int channel) noexcept
+  {
+    for (auto& event : src) {
+      if (channel < 0 || event.channel() == channel) dst.push_back(event);
+    }
+  }
+
+  /// Add the events of `src` of the kinds in `mask` to `dst`, keeping their order
+  ///
+  /// For processors reading only some kinds of events of a shared buffer.
+  inline void copy_matching(const MidiBufferRef& src, MidiBuffer& dst, EventMask mask) noexcept
+  {
+    for (auto& event : src) {
+      if ((mask_of(event) & mask) != EventMask::none) dst.push_back(event);
+    }
+  }
+
 
 } // namespace otto::core::midi
@@ -0,0 +1,86 @@
+#include "midi_parser.hpp"
+
+namespace otto::core::midi {
+
+  MidiParser::Message MidiParser::feed(byte b) noexcept
+  {
+    // Realtime bytes may come anywhere, and leave the message in progress alone
+    if (b >= 0xF8) {
+      if (b == 0xF9 || b == 0xFD) {
+        _dropped_bytes++;
+        return {};
+      }
+      return {Kind::realtime, b};
+    }
+
+    if (_in_sysex) {
+      if (b < 0x80) {
+        _sysex[_sysex_size++] = b;
+        if (_sysex_size < _sysex.size()) return {};
+        _sysex_chunk_size = _sysex_size;
+        _sysex_size = 0;
+        return {Kind::sysex_chunk, 0xF0};
+      }
+      // Any status byte ends a system exclusive message, not only 0xF7. The new status still
+      // starts its message, but a tune request, which needs no data, is lost.
+      _in_sysex = false;
+      _sysex_chunk_size = _sysex_size;
+      _sysex_size = 0;
+      if (b != 0xF7) feed(b);
+      return {Kind::sysex_end, 0xF7};
+    }
+
+    if (b >= 0x80) {
+      // A new status abandons the message in progress
+      _dropped_bytes += _data_count;
+      _data_count = 0;
+      if (b == 0xF0) {
+        _in_sysex = true;
+        _status = 0;
+        return {};
+      }
+      int size = data_size(b);
+      if (size < 0) {
+        _status = 0;
+        _dropped_bytes++;
+        return {};
+      }
+      _status = b;
+      return size == 0 ? complete() : Message{};
+    }
+
+    if (_status == 0) {
+      _dropped_bytes++;
+      return {};
+    }
+    _data[_data_count++] = b;
+    return _data_count == data_size(_status) ? complete() : Message{};
+  }
+
+  MidiParser::Message MidiParser::complete() noexcept
+  {
+    Message res = {Kind::channel, _status};
+    res.event.status = _status;
+    res.event.data = {_data_count > 0 ? _data[0] : byte(0), _data_count > 1 ? _data[1] : byte(0)};
+    if (_status >= 0xF0) {
+      res.kind = Kind::system;
+      // System common messages cancel running status
+      _status = 0;
+    } else if ((_status & 0xF0) == 0x90 && res.event.data[1] == 0) {
+      // Per the midi specification, a note on with velocity 0 is a note off
+      res.event.status = 0x80 | (_status & 0x0F);
+    }
+    _data_count = 0;
+    return res;
+  }
+
+  void MidiParser::reset() noexcept
+  {
+    _status = 0;
+    _data_count = 0;
+    _in_sysex = false;
+    _sysex_size = 0;
+    _sysex_chunk_size = 0;
+  }
+
+} // namespace otto::core::midi
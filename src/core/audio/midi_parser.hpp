@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <gsl/span>
+
+#include "core/audio/midi.hpp"
+
+namespace otto::core::midi {
+
+  /// Parses a stream of raw midi bytes, one byte at a time
+  ///
+  /// A state machine that never throws or allocates, so it is safe on the audio thread and in
+  /// the callbacks of midi libraries. It handles
+  ///  - Channel messages of any length, including the two byte program change and channel
+  ///    pressure. A note on with velocity 0 is turned into a note off, like @ref from_bytes.
+  ///  - Running status, where the status byte is left out for repeated channel messages.
+  ///  - Realtime bytes, like the midi clock, which may come in the middle of other messages.
+  ///  - System exclusive messages, collected in a fixed buffer, and handed out in chunks of
+  ///    @ref sysex_capacity bytes if they are longer.
+  ///  - System common messages, which cancel running status.
+  ///
+  /// Data bytes without a status, and undefined status bytes, are dropped and counted.
+  ///
+  /// ```cpp
+  /// MidiParser parser;
+  /// parser.parse(bytes, [&](const MidiParser::Message& msg) {
+  ///   if (msg.kind == MidiParser::Kind::channel) send_midi_event(msg.event);
+  /// });
+  /// ```
+  struct MidiParser {
+    using byte = unsigned char;
+
+    /// The largest chunk of a system exclusive message
+    static constexpr std::size_t sysex_capacity = 256;
+
+    enum struct Kind {
+      /// The byte did not complete a message
+      none,
+      /// A channel message, in `event`
+      channel,
+      /// A realtime message, like the midi clock, in `status`
+      realtime,
+      /// A system common message, like the song position, in `event`
+      system,
+      /// Part of a system exclusive message, which continues. See @ref sysex.
+      sysex_chunk,
+      /// The end of a system exclusive message. See @ref sysex.
+      sysex_end,
+    };
+
+    struct Message {
+      Kind kind = Kind::none;
+      /// The status byte
+      byte status = 0;
+      /// The message, for `channel` and `system`. The data bytes a message does not have are 0.
+      AnyMidiEvent event;
+    };
+
+    /// Feed one byte
+    ///
+    /// \returns The message completed by the byte, or a message of kind `none`
+    Message feed(byte b) noexcept;
+
+    /// Feed `bytes`, and call `f` with each message they complete
+    template<typename F>
+    void parse(gsl::span<const byte> bytes, F&& f)
+    {
+      for (byte b : bytes) {
+        if (auto msg = feed(b); msg.kind != Kind::none) f(msg);
+      }
+    }
+
+    /// The data of the last system exclusive chunk, without the `0xF0` and `0xF7` bytes
+    ///
+    /// Valid after a message of kind `sysex_chunk` or `sysex_end`, until the next @ref feed.
+    gsl::span<const byte> sysex() const noexcept
+    {
+      return {_sysex.data(), static_cast<std::ptrdiff_t>(_sysex_chunk_size)};
+    }
+
+    /// The number of bytes dropped, because they did not fit a message
+    int dropped_bytes() const noexcept
+    {
+      return _dropped_bytes;
+    }
+
+    /// Forget the message in progress and the running status, like after a reconnect
+    void reset() noexcept;
+
+    /// The number of data bytes of the channel or system common message with `status`, or -1
+    /// for the status bytes that do not start such a message
+    static constexpr int data_size(byte status) noexcept
+    {
+      if (status < 0x80) return -1;
+      if (status < 0xF0) return (status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0 ? 1 : 2;
+      switch (status) {
+        case 0xF1: [[fallthrough]];
+        case 0xF3: return 1;
+        case 0xF2: return 2;
+        case 0xF6: return 0;
+        default: return -1;
+      }
+    }
+
+  private:
+    /// The channel or system common message in `_status` is complete
+    Message complete() noexcept;
+
+    /// The status of the message in progress, or 0. Kept between channel messages for running
+    /// status.
+    byte _status = 0;
+    std::array<byte, 2> _data = {};
+    int _data_count = 0;
+    bool _in_sysex = false;
+    std::array<byte, sysex_capacity> _sysex = {};
+    std::size_t _sysex_size = 0;
+    /// The size of the chunk handed out last
+    std::size_t _sysex_chunk_size = 0;
+    int _dropped_bytes = 0;
+  };
+
+} // namespace otto::core::midi
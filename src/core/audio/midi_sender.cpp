@@ -0,0 +1,72 @@
+#include "midi_sender.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "util/thread_policy.hpp"
+
+namespace otto::core::midi {
+
+  namespace {
+    /// How long the thread sleeps when nothing is pushed, before checking if it should quit
+    constexpr auto idle_timeout = std::chrono::milliseconds(100);
+  } // namespace
+
+  MidiSender::MidiSender(Send send) : _send(std::move(send))
+  {
+    _thread = util::start_thread(util::ThreadClass::midi, [this] { run(); });
+  }
+
+  MidiSender::~MidiSender()
+  {
+    _quit = true;
+    _pushed.increment();
+    _thread.join();
+  }
+
+  void MidiSender::push(const unsigned char* bytes, std::size_t size, clock::time_point due) noexcept
+  {
+    Message msg = {{}, std::uint8_t(std::min<std::size_t>(size, 3)), due};
+    std::copy(bytes, bytes + msg.size, msg.bytes.begin());
+    if (!_ring->push(msg)) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    _pushed.increment();
+  }
+
+  void MidiSender::run()
+  {
+    // The messages taken from the ring, sorted by due time. Messages due at the same time stay
+    // in the order they were pushed.
+    std::vector<Message> pending;
+    pending.reserve(ring_size);
+    std::size_t next = 0;
+    while (true) {
+      // Read first, so everything pushed before the destructor was called is sent
+      bool quit = _quit;
+      auto seen = _pushed.value();
+      for (Message msg; _ring->pop(msg);) {
+        auto pos = std::upper_bound(pending.begin() + next, pending.end(), msg,
+                                    [](auto& a, auto& b) { return a.due < b.due; });
+        pending.insert(pos, msg);
+      }
+
+      auto now = clock::now();
+      for (; next < pending.size() && (quit || pending[next].due <= now); next++) {
+        _send(pending[next].bytes.data(), pending[next].size);
+        _last_lateness.store((clock::now() - pending[next].due).count(), std::memory_order_relaxed);
+      }
+      if (next == pending.size()) {
+        pending.clear();
+        next = 0;
+      }
+      if (quit) break;
+
+      clock::duration timeout = idle_timeout;
+      if (next < pending.size()) timeout = std::max(clock::duration(0), pending[next].due - now);
+      _pushed.wait_past(seen, timeout);
+    }
+  }
+
+} // namespace otto::core::midi
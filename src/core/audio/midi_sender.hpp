@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "util/spsc_ring.hpp"
+#include "util/wait_counter.hpp"
+
+namespace otto::core::midi {
+
+  /// Sends midi to an output from its own thread, at the time each message is due
+  ///
+  /// Midi output libraries like RtMidi make a system call for every message, which has no
+  /// place in the audio callback. The audio thread instead hands each message to @ref push
+  /// with the time it is due, which copies it into a lock-free ring and returns. The sender
+  /// thread sleeps until the next message is due, or a new one is pushed, and calls `send`.
+  ///
+  /// The thread is of `util::ThreadClass::midi`, which runs with a `SCHED_FIFO` priority below
+  /// the audio thread by default, so the messages go out close to their time even while the UI
+  /// is busy.
+  struct MidiSender {
+    using clock = std::chrono::steady_clock;
+    using Send = std::function<void(const unsigned char* bytes, std::size_t size)>;
+
+    struct Message {
+      std::array<unsigned char, 3> bytes;
+      std::uint8_t size;
+      clock::time_point due;
+    };
+
+    /// The messages that may wait for the sender thread
+    static constexpr std::size_t ring_size = 512;
+
+    /// \param send Called on the sender thread with each message
+    MidiSender(Send send);
+
+    /// Sends the messages that are left, without waiting for them to be due
+    ~MidiSender();
+
+    MidiSender(const MidiSender&) = delete;
+    MidiSender& operator=(const MidiSender&) = delete;
+
+    /// Send `size` bytes of `bytes`, at most 3, once `due` has come
+    ///
+    /// Only to be called from one thread at a time, usually the audio thread. Never blocks, and
+    /// makes no system call unless the sender thread is waiting. Messages should be pushed in
+    /// the order they are due. When the ring is full, the message is dropped and counted.
+    void push(const unsigned char* bytes, std::size_t size, clock::time_point due) noexcept;
+
+    /// The number of messages dropped because the ring was full
+    int dropped() const noexcept
+    {
+      return _dropped.load(std::memory_order_relaxed);
+    }
+
+    /// How late the latest message was sent, relative to its due time
+    clock::duration last_lateness() const noexcept
+    {
+      return clock::duration(_last_lateness.load(std::memory_order_relaxed));
+    }
+
+  private:
+    void run();
+
+    Send _send;
+    std::unique_ptr<util::SPSCRing<Message, ring_size>> _ring = std::make_unique<util::SPSCRing<Message, ring_size>>();
+    util::WaitCounter _pushed;
+    std::atomic_int _dropped = 0;
+    std::atomic<clock::rep> _last_lateness = 0;
+    std::atomic_bool _quit = false;
+    std::thread _thread;
+  };
+
+} // namespace otto::core::midi
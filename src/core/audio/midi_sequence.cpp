@@ -0,0 +1,313 @@
+#include "midi_sequence.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace otto::core::midi {
+
+  namespace {
+
+    using exception = MidiSequence::exception;
+    using ErrorCode = MidiSequence::ErrorCode;
+
+    /// Reads the big endian fields of a midi file, checking bounds
+    struct Reader {
+      gsl::span<const unsigned char> data;
+      std::ptrdiff_t pos = 0;
+
+      bool done() const noexcept
+      {
+        return pos >= data.size();
+      }
+
+      unsigned char peek() const
+      {
+        if (done()) throw exception(ErrorCode::invalid_midi_file, "Unexpected end of midi file");
+        return data[pos];
+      }
+
+      unsigned char byte()
+      {
+        auto res = peek();
+        pos++;
+        return res;
+      }
+
+      std::uint32_t uint(int bytes)
+      {
+        std::uint32_t res = 0;
+        for (int i = 0; i < bytes; i++) res = (res << 8) | byte();
+        return res;
+      }
+
+      /// A variable length quantity, 7 bits per byte
+      std::uint32_t var_len()
+      {
+        std::uint32_t res = 0;
+        for (int i = 0; i < 4; i++) {
+          auto b = byte();
+          res = (res << 7) | (b & 0x7F);
+          if ((b & 0x80) == 0) return res;
+        }
+        throw exception(ErrorCode::invalid_midi_file, "Variable length quantity too long");
+      }
+
+      std::string tag()
+      {
+        std::string res;
+        for (int i = 0; i < 4; i++) res += char(byte());
+        return res;
+      }
+
+      Reader sub(std::uint32_t length)
+      {
+        if (pos + length > data.size()) {
+          throw exception(ErrorCode::invalid_midi_file, "Chunk exceeds the end of the file");
+        }
+        Reader res{data.subspan(pos, length)};
+        pos += length;
+        return res;
+      }
+    };
+
+    struct TickEvent {
+      std::uint64_t tick;
+      AnyMidiEvent event;
+    };
+
+    struct TempoChange {
+      std::uint64_t tick;
+      /// Microseconds per quarter note
+      std::uint32_t tempo;
+    };
+
+    void read_track(Reader track, std::vector<TickEvent>& events, std::vector<TempoChange>& tempos)
+    {
+      std::uint64_t tick = 0;
+      unsigned char running_status = 0;
+      while (!track.done()) {
+        tick += track.var_len();
+        unsigned char status = track.peek();
+        if (status < 0x80) {
+          // Running status: the status byte is left out, and this is the first data byte
+          if (running_status == 0) {
+            throw exception(ErrorCode::invalid_midi_file, "Data byte without a status");
+          }
+          status = running_status;
+        } else {
+          track.byte();
+        }
+
+        if (status == 0xFF) {
+          auto type = track.byte();
+          auto meta = track.sub(track.var_len());
+          if (type == 0x51 && meta.data.size() == 3) tempos.push_back({tick, meta.uint(3)});
+          // End of track
+          if (type == 0x2F) return;
+          continue;
+        }
+        if (status == 0xF0 || status == 0xF7) {
+          // Sysex
+          track.sub(track.var_len());
+          continue;
+        }
+
+        running_status = status;
+        auto type = status >> 4;
+        if (type == 0xC || type == 0xD) {
+          // Program change and channel pressure have only one data byte, and are not supported
+          track.byte();
+          continue;
+        }
+        std::array<unsigned char, 3> bytes = {status, track.byte(), track.byte()};
+        events.push_back({tick, from_bytes(bytes)});
+      }
+    }
+
+    int parse_int(std::istringstream& line, const std::string& what, int min, int max)
+    {
+      int res;
+      if (!(line >> res) || res < min || res > max) {
+        throw exception(ErrorCode::invalid_script, "Expected {} in [{}, {}]", what, min, max);
+      }
+      return res;
+    }
+
+    int parse_note(std::istringstream& line)
+    {
+      std::string word;
+      if (!(line >> word)) throw exception(ErrorCode::invalid_script, "Expected a note");
+      if (std::isdigit(word[0])) {
+        int res = std::stoi(word);
+        if (res >= 0 && res < 128) return res;
+      } else if (int res = note_number(word); res >= 0) {
+        return res;
+      }
+      throw exception(ErrorCode::invalid_script, "Invalid note '{}'", word);
+    }
+
+    /// The channel is optional, and the last argument
+    int parse_channel(std::istringstream& line)
+    {
+      line >> std::ws;
+      if (line.eof()) return 0;
+      return parse_int(line, "a channel", 0, 15);
+    }
+
+    AnyMidiEvent parse_event(std::istringstream& line)
+    {
+      std::string name;
+      line >> name;
+      if (name == "note_on") {
+        int note = parse_note(line);
+        int velocity = parse_int(line, "a velocity", 1, 127);
+        std::array<unsigned char, 3> bytes = {
+          (unsigned char) (0x90 | parse_channel(line)), (unsigned char) note,
+          (unsigned char) velocity};
+        return from_bytes(bytes);
+      }
+      if (name == "note_off") {
+        int note = parse_note(line);
+        std::array<unsigned char, 3> bytes = {(unsigned char) (0x80 | parse_channel(line)),
+                                              (unsigned char) note, 0};
+        return from_bytes(bytes);
+      }
+      if (name == "cc") {
+        int controller = parse_int(line, "a controller", 0, 127);
+        int value = parse_int(line, "a value", 0, 127);
+        std::array<unsigned char, 3> bytes = {(unsigned char) (0xB0 | parse_channel(line)),
+                                              (unsigned char) controller, (unsigned char) value};
+        return from_bytes(bytes);
+      }
+      if (name == "pitch_bend") {
+        int value = parse_int(line, "a value", 0, 16383);
+        std::array<unsigned char, 3> bytes = {(unsigned char) (0xE0 | parse_channel(line)),
+                                              (unsigned char) (value & 0x7F),
+                                              (unsigned char) (value >> 7)};
+        return from_bytes(bytes);
+      }
+      throw exception(ErrorCode::invalid_script, "Unknown event '{}'", name);
+    }
+
+  } // namespace
+
+  MidiSequence MidiSequence::from_midi_file(gsl::span<const unsigned char> data)
+  {
+    Reader file{data};
+    if (file.tag() != "MThd") {
+      throw exception(ErrorCode::invalid_midi_file, "Missing midi file header");
+    }
+    auto header = file.sub(file.uint(4));
+    auto format = header.uint(2);
+    auto ntracks = header.uint(2);
+    auto division = header.uint(2);
+    if (format > 1) {
+      throw exception(ErrorCode::invalid_midi_file, "Midi file format {} is not supported",
+                      format);
+    }
+
+    std::vector<TickEvent> events;
+    std::vector<TempoChange> tempos;
+    for (std::uint32_t i = 0; i < ntracks && !file.done();) {
+      auto tag = file.tag();
+      auto chunk = file.sub(file.uint(4));
+      // Unknown chunks are to be skipped
+      if (tag != "MTrk") continue;
+      read_track(chunk, events, tempos);
+      i++;
+    }
+
+    // Merge all tracks in time, keeping the order of events at the same tick
+    std::stable_sort(events.begin(), events.end(),
+                     [](auto& a, auto& b) { return a.tick < b.tick; });
+    std::stable_sort(tempos.begin(), tempos.end(),
+                     [](auto& a, auto& b) { return a.tick < b.tick; });
+
+    // The seconds per tick, and the point they start from
+    double tick_time;
+    double segment_time = 0;
+    std::uint64_t segment_tick = 0;
+    bool smpte = division & 0x8000;
+    if (smpte) {
+      // Frames per second as a negative byte, and ticks per frame
+      int fps = -static_cast<signed char>(division >> 8);
+      tick_time = 1.0 / (fps * (division & 0xFF));
+    } else {
+      // 120 bpm until the first tempo change
+      tick_time = 0.5 / division;
+    }
+    if (tick_time <= 0 || !std::isfinite(tick_time)) {
+      throw exception(ErrorCode::invalid_midi_file, "Invalid time division {}", division);
+    }
+
+    MidiSequence res;
+    res.events.reserve(events.size());
+    auto tempo = tempos.begin();
+    for (auto& evt : events) {
+      // SMPTE time ignores the tempo
+      for (; !smpte && tempo != tempos.end() && tempo->tick <= evt.tick; ++tempo) {
+        segment_time += (tempo->tick - segment_tick) * tick_time;
+        segment_tick = tempo->tick;
+        tick_time = tempo->tempo / 1e6 / division;
+      }
+      res.events.push_back({segment_time + (evt.tick - segment_tick) * tick_time, evt.event});
+    }
+    return res;
+  }
+
+  MidiSequence MidiSequence::load_midi_file(const filesystem::path& path)
+  {
+    std::ifstream stream(path.c_str(), std::ios::binary);
+    if (!stream) {
+      throw exception(ErrorCode::file_not_found, "Could not open midi file {}", path.string());
+    }
+    std::vector<unsigned char> data{std::istreambuf_iterator<char>(stream),
+                                    std::istreambuf_iterator<char>()};
+    return from_midi_file(data);
+  }
+
+  MidiSequence MidiSequence::from_script(std::istream& script)
+  {
+    MidiSequence res;
+    int line_number = 0;
+    for (std::string text; std::getline(script, text);) {
+      line_number++;
+      text = text.substr(0, text.find('#'));
+      std::istringstream line(text);
+      double time;
+      if (!(line >> time)) {
+        line.clear();
+        if ((line >> std::ws).eof()) continue;
+        throw exception(ErrorCode::invalid_script, "Line {}: Expected a time", line_number);
+      }
+      try {
+        res.events.push_back({time, parse_event(line)});
+      } catch (exception& e) {
+        throw exception(ErrorCode::invalid_script, "Line {}: {}", line_number, e.what());
+      }
+      if (!(line >> std::ws).eof()) {
+        throw exception(ErrorCode::invalid_script, "Line {}: Unexpected arguments", line_number);
+      }
+    }
+    std::stable_sort(res.events.begin(), res.events.end(),
+                     [](auto& a, auto& b) { return a.time < b.time; });
+    return res;
+  }
+
+  MidiSequence MidiSequence::load(const filesystem::path& path)
+  {
+    auto ext = path.extension().string();
+    if (ext == ".mid" || ext == ".midi") return load_midi_file(path);
+    std::ifstream stream(path.c_str());
+    if (!stream) {
+      throw exception(ErrorCode::file_not_found, "Could not open event script {}", path.string());
+    }
+    return from_script(stream);
+  }
+
+} // namespace otto::core::midi
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <istream>
+#include <vector>
+
+#include <gsl/span>
+
+#include "core/audio/midi.hpp"
+#include "util/exception.hpp"
+#include "util/filesystem.hpp"
+
+namespace otto::core::midi {
+
+  /// A list of midi events with timestamps in seconds, e.g. read from a midi file
+  ///
+  /// Used to drive the engines without a live midi input, like when rendering offline.
+  struct MidiSequence {
+    enum struct ErrorCode {
+      /// The file could not be opened
+      file_not_found,
+      /// The data is not a valid standard midi file
+      invalid_midi_file,
+      /// A line of an event script could not be parsed
+      invalid_script,
+    };
+
+    using exception = util::as_exception<ErrorCode>;
+
+    struct Event {
+      /// The time of the event, in seconds from the start of the sequence
+      double time;
+      AnyMidiEvent event;
+    };
+
+    /// Parse a standard midi file of format 0 or 1
+    ///
+    /// All tracks are merged, and tick times are converted to seconds following the tempo
+    /// changes of the file. Only note, polyphonic aftertouch, control change and pitch bend
+    /// events are kept.
+    ///
+    /// \throws `exception` with `ErrorCode::invalid_midi_file`
+    static MidiSequence from_midi_file(gsl::span<const unsigned char> data);
+
+    /// Read a standard midi file from disk
+    ///
+    /// \throws `exception` with `ErrorCode::file_not_found` or `ErrorCode::invalid_midi_file`
+    static MidiSequence load_midi_file(const filesystem::path& path);
+
+    /// Parse an event script
+    ///
+    /// A script is a text file with one event per line, starting with its time in seconds.
+    /// Notes are given as numbers or names, velocities and values are raw midi values, and the
+    /// channel is optional. Everything after a `#` is a comment.
+    ///
+    /// ```
+    /// # time  event       arguments
+    /// 0       note_on     C3 100
+    /// 0.5     note_off    60
+    /// 0.5     cc          1 64 [channel]
+    /// 1       pitch_bend  8192
+    /// ```
+    ///
+    /// \throws `exception` with `ErrorCode::invalid_script`
+    static MidiSequence from_script(std::istream& script);
+
+    /// Read a standard midi file if the extension is `.mid` or `.midi`, otherwise an event script
+    static MidiSequence load(const filesystem::path& path);
+
+    /// The time of the last event
+    double length() const noexcept
+    {
+      return events.empty() ? 0 : events.back().time;
+    }
+
+    /// The events, sorted by time
+    std::vector<Event> events;
+  };
+
+} // namespace otto::core::midi
@@ -17,9 +17,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <gsl/span>
+#include <memory>
+#include <new>
 
 #include "core/audio/midi.hpp"
 
@@ -41,41 +46,106 @@ namespace otto::core::audio {
     static constexpr auto value = N;
   };
 
+  struct AudioBufferPool;
+
+  /// The assumed size of a cache line
+  constexpr std::size_t cache_line_size = 64;
+
+  /// The most frames of an audio callback, which @ref EngineBuffers are sized for
+  constexpr std::size_t max_buffer_size = 1024;
+
+  /// The reference count of an audio buffer.
+  ///
+  /// Padded to a cache line, so handles to different buffers used on different threads
+  /// do not contend for the same line.
+  struct alignas(cache_line_size) AudioBufferRefCount {
+    std::atomic_int value = 0;
+  };
+
+  namespace detail {
+    /// Frees the buffers of an @ref AudioBufferPool
+    struct AlignedDelete {
+      void operator()(float* p) const noexcept
+      {
+        ::operator delete[](p, std::align_val_t(cache_line_size));
+      }
+    };
+  } // namespace detail
+
   /// A handle to an audio buffer
+  ///
+  /// Handles are reference counted. When the last handle to a buffer from an
+  /// @ref AudioBufferPool is destroyed or released, the buffer is returned to the pool.
+  ///
+  /// A producer that knows its output is all zeros, like a synth that is switched off, can say
+  /// so with @ref mark_silent, so the nodes down the line can skip their work without scanning
+  /// the buffer. The mark is kept by copies of the handle, and is only a promise of whoever set
+  /// it: code that writes into a buffer it was handed, and passes it on, must update the mark,
+  /// and code unaware of it should be given unmarked handles.
+  ///
+  /// A handle may also be a view, see @ref view, which does not own the buffer. Views pass a
+  /// buffer on without touching the reference count, for as long as an owning handle holds it.
   struct AudioBufferHandle {
     using iterator = float*;
     using pointer = float*;
     using const_iterator = const float*;
 
-    AudioBufferHandle(float* data, std::size_t length, int& reference_count) noexcept
+    /// Construct a handle to an external buffer, which is not owned by any pool
+    AudioBufferHandle(float* data, std::size_t length, AudioBufferRefCount& reference_count) noexcept
       : _data(data), _length(length), _reference_count(&reference_count)
     {
-      (*_reference_count)++;
+      acquire();
+    }
+
+    /// Construct a handle to buffer number `index` of `pool`
+    AudioBufferHandle(float* data,
+                      std::size_t length,
+                      AudioBufferRefCount& reference_count,
+                      AudioBufferPool& pool,
+                      int index) noexcept
+      : _data(data), _length(length), _reference_count(&reference_count), _pool(&pool), _index(index)
+    {
+      acquire();
     }
 
     ~AudioBufferHandle() noexcept
     {
-      if (_reference_count) (*_reference_count)--;
+      if (_reference_count) release();
     };
 
     AudioBufferHandle(AudioBufferHandle&& rhs) noexcept
-      : _data(rhs._data), _length(rhs._length), _reference_count(rhs._reference_count)
+      : _data(rhs._data),
+        _length(rhs._length),
+        _reference_count(rhs._reference_count),
+        _pool(rhs._pool),
+        _index(rhs._index),
+        _silent(rhs._silent)
     {
       rhs._data = nullptr;
       rhs._reference_count = nullptr;
     }
 
     AudioBufferHandle(const AudioBufferHandle& rhs) noexcept
-      : _data(rhs._data), _length(rhs._length), _reference_count(rhs._reference_count)
+      : _data(rhs._data),
+        _length(rhs._length),
+        _reference_count(rhs._reference_count),
+        _pool(rhs._pool),
+        _index(rhs._index),
+        _silent(rhs._silent)
     {
-      (*_reference_count)++;
+      if (_reference_count) acquire();
     }
 
     AudioBufferHandle& operator=(AudioBufferHandle&& rhs) noexcept
     {
+      if (this == &rhs) return *this;
+      if (_reference_count) release();
       _data = rhs._data;
       _length = rhs._length;
       _reference_count = rhs._reference_count;
+      _pool = rhs._pool;
+      _index = rhs._index;
+      _silent = rhs._silent;
       rhs._data = nullptr;
       rhs._reference_count = nullptr;
       return *this;
@@ -83,16 +153,39 @@ namespace otto::core::audio {
 
     AudioBufferHandle& operator=(const AudioBufferHandle& rhs) noexcept
     {
+      if (this == &rhs) return *this;
+      if (rhs._reference_count) rhs.acquire();
+      if (_reference_count) release();
       _data = rhs._data;
       _length = rhs._length;
       _reference_count = rhs._reference_count;
-      (*_reference_count)++;
+      _pool = rhs._pool;
+      _index = rhs._index;
+      _silent = rhs._silent;
       return *this;
     }
 
+    /// The number of owning handles to the buffer, or 0 for a view
     int reference_count() const
     {
-      return *_reference_count;
+      if (!_reference_count) return 0;
+      return _reference_count->value.load(std::memory_order_relaxed);
+    }
+
+    /// Whether this handle holds the buffer, as opposed to being a view
+    bool owning() const noexcept
+    {
+      return _reference_count != nullptr;
+    }
+
+    /// A handle to the same data that does not own it
+    ///
+    /// Copies of a view are views, and releasing one does nothing. The buffer may be returned to
+    /// its pool while views of it exist, so they must not outlive the owning handles, like a
+    /// span.
+    AudioBufferHandle view() const noexcept
+    {
+      return {*this, 0, _length};
     }
 
     float* data() const
@@ -105,6 +198,33 @@ namespace otto::core::audio {
       return _length;
     }
 
+    /// The data, which the compiler may assume is aligned to a cache line
+    ///
+    /// \requires this is a whole buffer from an @ref AudioBufferPool, not a slice or an
+    /// external buffer
+    float* assume_aligned() const noexcept
+    {
+#if OTTO_DEBUG_BUFFERS
+      if (reinterpret_cast<std::uintptr_t>(_data) % cache_line_size != 0) {
+        RTLOGE("Audio buffer {} is not aligned", _index);
+        return _data;
+      }
+#endif
+      return static_cast<float*>(__builtin_assume_aligned(_data, cache_line_size));
+    }
+
+    /// The size, rounded up to a whole number of SIMD vectors
+    ///
+    /// Buffers from an @ref AudioBufferPool are padded to this size, so the buffer kernels of
+    /// `util/audio.hpp` can process this many frames without a scalar tail. The samples past
+    /// @ref size are not meaningful.
+    ///
+    /// \requires this is a whole buffer from an @ref AudioBufferPool
+    std::size_t padded_size() const noexcept
+    {
+      return util::audio::padded_size(_length);
+    }
+
     iterator begin()
     {
       return _data;
@@ -132,29 +252,38 @@ namespace otto::core::audio {
       return _data[i];
     }
 
-    void release()
+    /// Whether the producer of the data promised it is all zeros. `false` if unknown.
+    bool is_silent() const noexcept
     {
-      (*_reference_count)--;
-      _reference_count = nullptr;
-      _data = nullptr;
+      return _silent;
     }
 
+    /// Promise that the data is all zeros, or take the promise back
+    void mark_silent(bool silent = true) noexcept
+    {
+      _silent = silent;
+    }
+
+    /// Release this handle
+    ///
+    /// If this was the last handle to a pool buffer, the buffer is returned to the pool.
+    void release() noexcept;
+
     void clear()
     {
       std::fill(begin(), end(), 0);
     }
 
-    /// Get only a slice of the audio.
+    /// Get only a slice of the audio, as a view
     ///
     /// \param idx The index to start from
     /// \param length The number of frames to keep in the slice
     ///   If `length` is negative, `nframes - idx` will be used
     /// \requires parameter `idx` shall be in the range `[0, _length)`, and
     /// `length` shall be in range `[0, nframes - idx]`
-    AudioBufferHandle slice(int idx, int length = -1)
+    AudioBufferHandle slice(int idx, int length = -1) const noexcept
     {
-      length = length < 0 ? _length - idx : length;
-      return {_data + idx, std::size_t(length), *_reference_count};
+      return {*this, idx, length < 0 ? _length - idx : std::size_t(length)};
     }
 
     float* data()
@@ -168,36 +297,67 @@ namespace otto::core::audio {
     }
 
   private:
+    /// A view of `length` frames of `of`, from `idx`
+    AudioBufferHandle(const AudioBufferHandle& of, int idx, std::size_t length) noexcept
+      : _data(of._data + idx),
+        _length(length),
+        _reference_count(nullptr),
+        _pool(of._pool),
+        _index(of._index),
+        _silent(of._silent)
+    {}
+
+    void acquire() const noexcept
+    {
+      // A new reference can only be made from an existing one, so no ordering is required
+      _reference_count->value.fetch_add(1, std::memory_order_relaxed);
+    }
+
     float* _data;
     std::size_t _length;
-    int* _reference_count;
+    AudioBufferRefCount* _reference_count;
+    AudioBufferPool* _pool = nullptr;
+    int _index = -1;
+    bool _silent = false;
   };
 
+  /// A pool of audio buffers
+  ///
+  /// Allocation and release are O(1) and lock-free, using a free-list of buffer indices.
+  ///
+  /// Each buffer starts on a cache line, and is padded to a whole number of cache lines, so
+  /// buffers used by different threads never share a line, and SIMD loads of whole buffers
+  /// are aligned. See @ref AudioBufferHandle::assume_aligned.
+  ///
+  /// If all buffers are in use, allocation falls back to a reserved emergency buffer, which
+  /// is shared by all overflowing allocations, and counts the overflow. The audio will be
+  /// garbled, but the process keeps running. Use @ref overflow_count and @ref high_water_mark
+  /// from the UI thread to detect this, and @ref set_capacity to size the pool.
   struct AudioBufferPool {
+    /// The default number of buffers
     static constexpr int number_of_buffers = 8;
-    AudioBufferPool(std::size_t buffer_size) : buffer_size(buffer_size)
+
+    AudioBufferPool(std::size_t buffer_size, std::size_t capacity = number_of_buffers)
+      : buffer_size(buffer_size), _capacity(capacity)
     {
-      // For now this is hardcoded, which is nice, cause we notice if we suddenly are using too many
-      // buffers
-      reserve(number_of_buffers);
+      reserve(_capacity);
     }
 
     AudioBufferHandle allocate() noexcept
     {
-      for (std::size_t i = 0; i < reference_counts.size(); i++) {
-        if (reference_counts[i] < 1) {
-          if (i > _max_val) {
-            LOGI("Using {} buffers", i + 1);
-            _max_val = i;
-          }
-          reference_counts[i] = 0;
-          int index = i * buffer_size;
-          return {data.get() + index, buffer_size, reference_counts[i]};
-        }
+      int index = pop_free();
+      if (index < 0) {
+        _overflow_count.fetch_add(1, std::memory_order_relaxed);
+        index = _capacity;
+      } else {
+        auto in_use = _in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+        auto hwm = _high_water_mark.load(std::memory_order_relaxed);
+        while (in_use > hwm &&
+               !_high_water_mark.compare_exchange_weak(hwm, in_use, std::memory_order_relaxed))
+          ;
       }
-      // TODO: handle this reasonably
-      LOGF("No free audio buffers found. This shouldn't happen");
-      std::terminate();
+      reference_counts[index].value.store(0, std::memory_order_relaxed);
+      return {data.get() + index * _stride, buffer_size, reference_counts[index], *this, index};
     }
 
     AudioBufferHandle allocate_clear()
@@ -219,42 +379,272 @@ namespace otto::core::audio {
       return util::generate_array<NN>([this](int) { return allocate_clear(); });
     }
 
+    /// Set the size of each buffer
+    ///
+    /// Reallocates the buffers. Not to be called while any buffers are in use.
     void set_buffer_size(std::size_t bs) noexcept
     {
       buffer_size = bs;
-      reserve(number_of_buffers);
+      reserve(_capacity);
+    }
+
+    /// Set the number of buffers
+    ///
+    /// Reallocates the buffers. Not to be called while any buffers are in use.
+    void set_capacity(std::size_t capacity) noexcept
+    {
+      _capacity = capacity;
+      reserve(_capacity);
+    }
+
+    /// The distance between the starts of two buffers, in floats
+    ///
+    /// The buffer size rounded up to a whole number of cache lines.
+    std::size_t stride() const noexcept
+    {
+      return _stride;
+    }
+
+    /// The number of buffers, not including the emergency buffer
+    std::size_t capacity() const noexcept
+    {
+      return _capacity;
+    }
+
+    /// The maximum number of buffers that have been in use at the same time
+    int high_water_mark() const noexcept
+    {
+      return _high_water_mark.load(std::memory_order_relaxed);
+    }
+
+    /// The number of allocations that did not find a free buffer since construction.
+    ///
+    /// While this is non-zero, audio has been garbled.
+    int overflow_count() const noexcept
+    {
+      return _overflow_count.load(std::memory_order_relaxed);
+    }
+
+    /// Check that no buffers are in use. Call at the end of each audio callback.
+    ///
+    /// Only does anything when built with `OTTO_DEBUG_BUFFERS`, in which case leaked buffers
+    /// are logged, and returned to the pool
+    ///
+    /// \returns the number of leaked buffers
+    int check_leaks() noexcept
+    {
+#if OTTO_DEBUG_BUFFERS
+      int leaks = 0;
+      for (int i = 0; i < int(_capacity); i++) {
+        if (reference_counts[i].value.load(std::memory_order_acquire) > 0) {
+          RTLOGE("Audio buffer {} leaked, with {} references", i, reference_counts[i].value.load());
+          reference_counts[i].value.store(0, std::memory_order_relaxed);
+          release(i);
+          leaks++;
+        }
+      }
+      return leaks;
+#else
+      return 0;
+#endif
     }
 
   private:
+    friend struct AudioBufferHandle;
+
+    /// Return buffer `index` to the free-list
+    void release(int index) noexcept
+    {
+      // The emergency buffer is never put on the free-list
+      if (index >= int(_capacity)) return;
+      _in_use.fetch_sub(1, std::memory_order_relaxed);
+      push_free(index);
+    }
+
+    // The free-list is a lock-free stack of buffer indices. The head packs the index of the
+    // top element (plus one, so zero means empty) with a tag, which is incremented on each
+    // change to avoid the ABA problem.
+
+    static constexpr std::uint64_t pack(int index, std::uint64_t tag) noexcept
+    {
+      return (tag << 32) | std::uint64_t(index + 1);
+    }
+
+    static constexpr int unpack_index(std::uint64_t head) noexcept
+    {
+      return int(head & 0xFFFFFFFF) - 1;
+    }
+
+    static constexpr std::uint64_t unpack_tag(std::uint64_t head) noexcept
+    {
+      return head >> 32;
+    }
+
+    void push_free(int index) noexcept
+    {
+      auto head = _free_head.load(std::memory_order_relaxed);
+      do {
+        _next_free[index].store(unpack_index(head), std::memory_order_relaxed);
+      } while (!_free_head.compare_exchange_weak(head, pack(index, unpack_tag(head) + 1),
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    }
+
+    int pop_free() noexcept
+    {
+      auto head = _free_head.load(std::memory_order_acquire);
+      int index;
+      do {
+        index = unpack_index(head);
+        if (index < 0) return -1;
+      } while (!_free_head.compare_exchange_weak(
+        head, pack(_next_free[index].load(std::memory_order_relaxed), unpack_tag(head) + 1),
+        std::memory_order_acquire, std::memory_order_acquire));
+      return index;
+    }
+
     void reserve(std::size_t n) noexcept
     {
-      data = std::make_unique<float[]>(n * buffer_size);
-      _avaliable_buffers = n;
-      reference_counts.resize(_avaliable_buffers, 0);
+      constexpr std::size_t line = cache_line_size / sizeof(float);
+      static_assert(line % util::audio::vector_width == 0);
+      _stride = (buffer_size + line - 1) / line * line;
+      // One extra buffer is reserved for overflowing allocations
+      const std::size_t size = (n + 1) * _stride;
+      data.reset(static_cast<float*>(::operator new[](size * sizeof(float), std::align_val_t(cache_line_size))));
+      std::fill(data.get(), data.get() + size, 0.f);
+      reference_counts = std::make_unique<AudioBufferRefCount[]>(n + 1);
+      _next_free = std::make_unique<std::atomic_int[]>(n);
+      _free_head = pack(-1, 0);
+      for (int i = n - 1; i >= 0; i--) push_free(i);
+      _in_use = 0;
     }
 
     std::size_t buffer_size;
-    std::vector<int> reference_counts;
-    std::size_t _avaliable_buffers = 0;
-    std::unique_ptr<float[]> data;
-    std::size_t _max_val = -1;
+    std::size_t _stride = 0;
+    std::size_t _capacity;
+    std::unique_ptr<AudioBufferRefCount[]> reference_counts;
+    std::unique_ptr<float[], detail::AlignedDelete> data;
+    std::unique_ptr<std::atomic_int[]> _next_free;
+    std::atomic<std::uint64_t> _free_head = 0;
+    std::atomic_int _in_use = 0;
+    std::atomic_int _high_water_mark = 0;
+    std::atomic_int _overflow_count = 0;
+  };
+
+  inline void AudioBufferHandle::release() noexcept
+  {
+    if (_reference_count == nullptr) {
+#if OTTO_DEBUG_BUFFERS
+      if (_data == nullptr) RTLOGE("Audio buffer handle released twice");
+#endif
+      // A view, which owns nothing
+      _data = nullptr;
+      return;
+    }
+    auto count = _reference_count->value.fetch_sub(1, std::memory_order_acq_rel) - 1;
+#if OTTO_DEBUG_BUFFERS
+    if (count < 0) {
+      RTLOGE("Audio buffer {} released more times than it was acquired", _index);
+    }
+#endif
+    if (count == 0 && _pool != nullptr) {
+      _pool->release(_index);
+    }
+    _reference_count = nullptr;
+    _data = nullptr;
+  }
+
+  /// What the processors of one audio callback need to know about it
+  ///
+  /// Filled in by the audio manager at the start of each callback, and passed down with
+  /// @ref ProcessData, so processors do not look up services, or read state owned by the UI
+  /// thread, from the audio thread. Tests and tools make their own to run engines on their own.
+  struct AudioContext {
+    /// The pool to allocate temporary buffers from
+    AudioBufferPool* buffer_pool = nullptr;
+    int samplerate = 48000;
+    /// The octave offset of the keyboard, as it was at the start of the callback
+    int octave = 0;
+    /// Whether the clock was running at the start of the callback
+    bool playing = false;
+    /// The tempo of the clock at the start of the callback
+    float bpm = 120;
+
+    AudioBufferPool& pool() const noexcept
+    {
+      return *buffer_pool;
+    }
+  };
+
+  /// Buffers an engine keeps for its outputs and scratch, instead of allocating them from the
+  /// pool in each callback
+  ///
+  /// Allocated once, aligned and padded like the buffers of the pool, for @ref max_buffer_size
+  /// frames, so a change of the buffer size needs no reallocation. The handles of @ref acquire
+  /// are counted by these buffers, not the pool, so an engine in its steady state makes no pool
+  /// operations, and writes to the same memory in every callback.
+  ///
+  /// Like pool buffers, the handles are released by the end of the callback, which the routing
+  /// graph does. If a buffer is still held when it is acquired again, or the callback is longer
+  /// than the buffers, `acquire` falls back to the pool.
+  template<int N>
+  struct EngineBuffers {
+    EngineBuffers()
+    {
+      const std::size_t size = N * stride;
+      _data.reset(static_cast<float*>(::operator new[](size * sizeof(float), std::align_val_t(cache_line_size))));
+      std::fill(_data.get(), _data.get() + size, 0.f);
+    }
+
+    /// Handles to the first `M` buffers, of `nframes` each
+    template<int M = N>
+    std::array<AudioBufferHandle, M> acquire(const AudioContext& context, long nframes) noexcept
+    {
+      static_assert(M <= N);
+      bool held = nframes > long(max_buffer_size);
+      for (int i = 0; i < M && !held; i++) held = _reference_counts[i].value.load(std::memory_order_acquire) != 0;
+      if (held) return context.pool().template allocate_multi<M>();
+      return util::generate_array<M>(
+        [&](int i) { return AudioBufferHandle(data(i), nframes, _reference_counts[i]); });
+    }
+
+    /// Buffer `i`, for scratch that never leaves the engine
+    float* data(int i) const noexcept
+    {
+      return _data.get() + i * stride;
+    }
+
+  private:
+    static constexpr std::size_t stride = util::audio::padded_size(max_buffer_size);
+
+    std::unique_ptr<float[], detail::AlignedDelete> _data;
+    std::array<AudioBufferRefCount, N> _reference_counts;
   };
 
-  /// Non-owning package of data passed to audio processors
+  /// Package of data passed to audio processors
+  ///
+  /// The midi buffer is a reference. The audio handles are moved in and out of the processors
+  /// where they can be. The routing graph passes views of the buffers it holds (see
+  /// @ref AudioBufferHandle::view), and @ref slice and the slices of @ref split_by_midi are
+  /// views too, so passing the data on does not touch reference counts. A processor that
+  /// processes in place may return the view it was given, and the graph holds the buffer.
   template<int N>
   struct ProcessData {
     static constexpr int channels = N;
 
     std::array<AudioBufferHandle, channels> audio;
-    midi::shared_vector<midi::AnyMidiEvent> midi;
+    midi::MidiBufferRef midi;
     long nframes;
+    /// The callback this is processed in. Carried over to the data derived from this one.
+    const AudioContext* context = nullptr;
 
     ProcessData(std::array<AudioBufferHandle, channels> audio,
-                midi::shared_vector<midi::AnyMidiEvent> midi,
-                long nframes) noexcept;
+                midi::MidiBufferRef midi,
+                long nframes,
+                const AudioContext* context = nullptr) noexcept;
 
     ProcessData(std::array<AudioBufferHandle, channels> audio,
-                midi::shared_vector<midi::AnyMidiEvent> midi) noexcept;
+                midi::MidiBufferRef midi) noexcept;
 
     ProcessData(std::array<AudioBufferHandle, channels> audio) noexcept;
 
@@ -263,11 +653,11 @@ namespace otto::core::audio {
     ProcessData audio_only();
 
     template<std::size_t NN>
-    ProcessData<NN> redirect(const std::array<AudioBufferHandle, NN>& buf);
+    ProcessData<NN> redirect(std::array<AudioBufferHandle, NN> buf);
 
-    ProcessData<1> redirect(const AudioBufferHandle& buf);
+    ProcessData<1> redirect(AudioBufferHandle buf);
 
-    /// Get only a slice of the audio.
+    /// Get only a slice of the audio, as views of the buffers
     ///
     /// \param idx The index to start from
     /// \param length The number of frames to keep in the slice
@@ -281,46 +671,52 @@ namespace otto::core::audio {
 
   using TestType = std::vector<struct Tag>;
 
-  /// Non-owning package of data passed to audio processors
+  /// Package of data passed to audio processors
   template<>
   struct ProcessData<0> {
     static constexpr int channels = 0;
 
-    midi::shared_vector<midi::AnyMidiEvent> midi;
+    midi::MidiBufferRef midi;
     long nframes;
+    /// The callback this is processed in. Carried over to the data derived from this one.
+    const AudioContext* context = nullptr;
 
-    ProcessData(midi::shared_vector<midi::AnyMidiEvent> midi, long nframes) noexcept;
+    ProcessData(midi::MidiBufferRef midi, long nframes, const AudioContext* context = nullptr) noexcept;
 
     template<std::size_t NN>
-    ProcessData<NN> redirect(const std::array<AudioBufferHandle, NN>& buf);
-    ProcessData<1> redirect(const AudioBufferHandle& buf);
+    ProcessData<NN> redirect(std::array<AudioBufferHandle, NN> buf);
+    ProcessData<1> redirect(AudioBufferHandle buf);
 
     std::array<float*, 0> raw_audio_buffers();
   };
 
-  /// Non-owning package of data passed to audio processors
+  /// Package of data passed to audio processors
   template<>
   struct ProcessData<1> {
     static constexpr int channels = 1;
 
     AudioBufferHandle audio;
-    midi::shared_vector<midi::AnyMidiEvent> midi;
+    midi::MidiBufferRef midi;
     long nframes;
+    /// The callback this is processed in. Carried over to the data derived from this one.
+    const AudioContext* context = nullptr;
 
     ProcessData(std::array<AudioBufferHandle, channels> audio,
-                midi::shared_vector<midi::AnyMidiEvent> midi,
-                long nframes) noexcept;
+                midi::MidiBufferRef midi,
+                long nframes,
+                const AudioContext* context = nullptr) noexcept;
 
     ProcessData(std::array<AudioBufferHandle, channels> audio,
-                midi::shared_vector<midi::AnyMidiEvent> midi) noexcept;
+                midi::MidiBufferRef midi) noexcept;
 
     ProcessData(std::array<AudioBufferHandle, channels> audio) noexcept;
 
     ProcessData(AudioBufferHandle audio,
-                midi::shared_vector<midi::AnyMidiEvent> midi,
-                long nframes) noexcept;
+                midi::MidiBufferRef midi,
+                long nframes,
+                const AudioContext* context = nullptr) noexcept;
 
-    ProcessData(AudioBufferHandle audio, midi::shared_vector<midi::AnyMidiEvent> midi) noexcept;
+    ProcessData(AudioBufferHandle audio, midi::MidiBufferRef midi) noexcept;
 
     ProcessData(AudioBufferHandle audio) noexcept;
 
@@ -328,10 +724,10 @@ namespace otto::core::audio {
     ProcessData audio_only();
 
     template<std::size_t NN>
-    ProcessData<NN> redirect(const std::array<AudioBufferHandle, NN>& buf);
-    ProcessData<1> redirect(const AudioBufferHandle& buf);
+    ProcessData<NN> redirect(std::array<AudioBufferHandle, NN> buf);
+    ProcessData<1> redirect(AudioBufferHandle buf);
 
-    /// Get only a slice of the audio.
+    /// Get only a slice of the audio, as views of the buffers
     ///
     /// \param idx The index to start from
     /// \param length The number of frames to keep in the slice
@@ -343,6 +739,22 @@ namespace otto::core::audio {
     std::array<float*, channels> raw_audio_buffers();
   };
 
+  /// Process `data` in slices split at the times of its midi events
+  ///
+  /// The midi buffer is sorted by time, and each event is passed to `on_event` right before
+  /// the slice starting at its time is passed to `process`, so notes start on the right frame.
+  /// Event times are clamped to `[0, nframes)`. The slices still carry the midi of the whole
+  /// buffer, which `process` should not handle again.
+  ///
+  /// ```cpp
+  /// audio::split_by_midi(data, [&](midi::AnyMidiEvent& evt) { handle(evt); },
+  ///                      [&](audio::ProcessData<1> slice) { render(slice.audio); });
+  /// ```
+  ///
+  /// \param on_event Invocable as `on_event(midi::AnyMidiEvent&)`
+  /// \param process Invocable as `process(ProcessData<1>)`
+  template<typename OnEvent, typename Process>
+  void split_by_midi(ProcessData<1> data, OnEvent&& on_event, Process&& process);
 
 } // namespace otto::core::audio
 
@@ -5,45 +5,46 @@ namespace otto::core::audio {
 
   template<int N>
   ProcessData<N>::ProcessData(std::array<AudioBufferHandle, channels> audio,
-                              midi::shared_vector<midi::AnyMidiEvent> midi,
-                              long nframes) noexcept
-    : audio(audio), midi(midi), nframes(nframes)
+                              midi::MidiBufferRef midi,
+                              long nframes,
+                              const AudioContext* context) noexcept
+    : audio(std::move(audio)), midi(midi), nframes(nframes), context(context)
   {}
 
   template<int N>
   ProcessData<N>::ProcessData(std::array<AudioBufferHandle, channels> audio,
-                              midi::shared_vector<midi::AnyMidiEvent> midi) noexcept
-    : audio(audio), midi(midi), nframes(audio[0].size())
+                              midi::MidiBufferRef midi) noexcept
+    : audio(std::move(audio)), midi(midi), nframes(this->audio[0].size())
   {}
 
   template<int N>
   ProcessData<N>::ProcessData(std::array<AudioBufferHandle, channels> audio) noexcept
-    : audio(audio), midi(), nframes(audio[0].size())
+    : audio(std::move(audio)), midi(), nframes(this->audio[0].size())
   {}
 
   template<int N>
   ProcessData<0> ProcessData<N>::midi_only()
   {
-    return {midi, nframes};
+    return {midi, nframes, context};
   }
 
   template<int N>
   ProcessData<N> ProcessData<N>::audio_only()
   {
-    return {audio, {}, nframes};
+    return {audio, {}, nframes, context};
   }
 
   template<int N>
   template<std::size_t NN>
-  ProcessData<NN> ProcessData<N>::redirect(const std::array<AudioBufferHandle, NN>& buf)
+  ProcessData<NN> ProcessData<N>::redirect(std::array<AudioBufferHandle, NN> buf)
   {
-    return ProcessData<NN>{buf, midi, nframes};
+    return ProcessData<NN>{std::move(buf), midi, nframes, context};
   }
 
   template<int N>
-  ProcessData<1> ProcessData<N>::redirect(const AudioBufferHandle& buf)
+  ProcessData<1> ProcessData<N>::redirect(AudioBufferHandle buf)
   {
-    return ProcessData<1>{buf, midi, nframes};
+    return ProcessData<1>{std::move(buf), midi, nframes, context};
   }
 
   /// Get only a slice of the audio.
@@ -56,11 +57,9 @@ namespace otto::core::audio {
   template<int N>
   ProcessData<N> ProcessData<N>::slice(int idx, int length)
   {
-    auto res = *this;
     length = length < 0 ? nframes - idx : length;
-    res.nframes = length;
-    res.audio = audio.slice(idx, length);
-    return res;
+    return {util::generate_array<channels>([&](int n) { return audio[n].slice(idx, length); }), midi, length,
+            context};
   }
 
   template<int N>
@@ -71,20 +70,21 @@ namespace otto::core::audio {
 
   // ProcessData<0> //
 
-  inline ProcessData<0>::ProcessData(midi::shared_vector<midi::AnyMidiEvent> midi,
-                                     long nframes) noexcept
-    : midi(midi), nframes(nframes)
+  inline ProcessData<0>::ProcessData(midi::MidiBufferRef midi,
+                                     long nframes,
+                                     const AudioContext* context) noexcept
+    : midi(midi), nframes(nframes), context(context)
   {}
 
   template<std::size_t NN>
-  ProcessData<NN> ProcessData<0>::redirect(const std::array<AudioBufferHandle, NN>& buf)
+  ProcessData<NN> ProcessData<0>::redirect(std::array<AudioBufferHandle, NN> buf)
   {
-    return ProcessData<NN>{buf, midi, nframes};
+    return ProcessData<NN>{std::move(buf), midi, nframes, context};
   }
 
-  inline ProcessData<1> ProcessData<0>::redirect(const AudioBufferHandle& buf)
+  inline ProcessData<1> ProcessData<0>::redirect(AudioBufferHandle buf)
   {
-    return ProcessData<1>{buf, midi, nframes};
+    return ProcessData<1>{std::move(buf), midi, nframes, context};
   }
 
   inline std::array<float*, 0> ProcessData<0>::raw_audio_buffers()
@@ -95,55 +95,57 @@ namespace otto::core::audio {
   // ProcessDaata<1> //
 
   inline ProcessData<1>::ProcessData(AudioBufferHandle audio,
-                                     midi::shared_vector<midi::AnyMidiEvent> midi,
-                                     long nframes) noexcept
-    : audio(audio), midi(midi), nframes(nframes)
+                                     midi::MidiBufferRef midi,
+                                     long nframes,
+                                     const AudioContext* context) noexcept
+    : audio(std::move(audio)), midi(midi), nframes(nframes), context(context)
   {}
 
   inline ProcessData<1>::ProcessData(AudioBufferHandle audio,
-                                     midi::shared_vector<midi::AnyMidiEvent> midi) noexcept
-    : audio(audio), midi(midi), nframes(audio.size())
+                                     midi::MidiBufferRef midi) noexcept
+    : audio(std::move(audio)), midi(midi), nframes(this->audio.size())
   {}
 
   inline ProcessData<1>::ProcessData(AudioBufferHandle audio) noexcept
-    : audio(audio), midi(), nframes(audio.size())
+    : audio(std::move(audio)), midi(), nframes(this->audio.size())
   {}
 
   inline ProcessData<1>::ProcessData(std::array<AudioBufferHandle, channels> audio,
-                                     midi::shared_vector<midi::AnyMidiEvent> midi,
-                                     long nframes) noexcept
-    : audio(audio[0]), midi(midi), nframes(nframes)
+                                     midi::MidiBufferRef midi,
+                                     long nframes,
+                                     const AudioContext* context) noexcept
+    : audio(std::move(audio[0])), midi(midi), nframes(nframes), context(context)
   {}
 
   inline ProcessData<1>::ProcessData(std::array<AudioBufferHandle, channels> audio,
-                                     midi::shared_vector<midi::AnyMidiEvent> midi) noexcept
-    : audio(audio[0]), midi(midi), nframes(audio[0].size())
+                                     midi::MidiBufferRef midi) noexcept
+    : audio(std::move(audio[0])), midi(midi), nframes(this->audio.size())
   {}
 
   inline ProcessData<1>::ProcessData(std::array<AudioBufferHandle, channels> audio) noexcept
-    : audio(audio[0]), midi(), nframes(audio[0].size())
+    : audio(std::move(audio[0])), midi(), nframes(this->audio.size())
   {}
 
 
   inline ProcessData<0> ProcessData<1>::midi_only()
   {
-    return {midi, nframes};
+    return {midi, nframes, context};
   }
 
   inline ProcessData<1> ProcessData<1>::audio_only()
   {
-    return {audio, {}, nframes};
+    return {audio, {}, nframes, context};
   }
 
   template<std::size_t NN>
-  inline ProcessData<NN> ProcessData<1>::redirect(const std::array<AudioBufferHandle, NN>& buf)
+  inline ProcessData<NN> ProcessData<1>::redirect(std::array<AudioBufferHandle, NN> buf)
   {
-    return ProcessData<NN>{buf, midi, nframes};
+    return ProcessData<NN>{std::move(buf), midi, nframes, context};
   }
 
-  inline ProcessData<1> ProcessData<1>::redirect(const AudioBufferHandle& buf)
+  inline ProcessData<1> ProcessData<1>::redirect(AudioBufferHandle buf)
   {
-    return ProcessData<1>{buf, midi, nframes};
+    return ProcessData<1>{std::move(buf), midi, nframes, context};
   }
 
   /// Get only a slice of the audio.
@@ -155,11 +157,8 @@ namespace otto::core::audio {
   /// `length` shall be in range `[0, nframes - idx]`
   inline ProcessData<1> ProcessData<1>::slice(int idx, int length)
   {
-    auto res = *this;
     length = length < 0 ? nframes - idx : length;
-    res.nframes = length;
-    res.audio = audio.slice(idx, length);
-    return res;
+    return {audio.slice(idx, length), midi, length, context};
   }
 
   inline std::array<float*, 1> ProcessData<1>::raw_audio_buffers()
@@ -167,6 +166,27 @@ namespace otto::core::audio {
     return {audio.data()};
   }
 
+  // split_by_midi //
+
+  template<typename OnEvent, typename Process>
+  void split_by_midi(ProcessData<1> data, OnEvent&& on_event, Process&& process)
+  {
+    data.midi.sort_by_time();
+    auto frame_of = [&](const midi::AnyMidiEvent& evt) {
+      return std::clamp<long>(evt.time, 0, std::max(0l, data.nframes - 1));
+    };
+    auto evt = data.midi.begin();
+    auto end = data.midi.end();
+    long pos = 0;
+    while (pos < data.nframes) {
+      for (; evt != end && frame_of(*evt) <= pos; ++evt) on_event(*evt);
+      long next = evt == end ? data.nframes : frame_of(*evt);
+      process(data.slice(pos, next - pos));
+      pos = next;
+    }
+    for (; evt != end; ++evt) on_event(*evt);
+  }
+
 } // namespace otto::core::audio
 
 // kak: other_file=processor.hpp
@@ -0,0 +1,261 @@
+#include "sample_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <new>
+
+#include <fmt/format.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace otto::core::audio {
+
+  namespace {
+    /// The header of a file of samples saved by `SampleCache::save`, followed by the key and
+    /// the samples
+    struct PersistedHeader {
+      char magic[4] = {'O', 'T', 'S', 'C'};
+      std::uint32_t version = 1;
+      std::int64_t mtime = 0;
+      std::uint64_t count = 0;
+      std::uint64_t key_size = 0;
+    };
+
+    /// A hash that is the same in every build, since it names the files
+    std::uint64_t fnv1a(const std::string& str) noexcept
+    {
+      std::uint64_t hash = 14695981039346656037ull;
+      for (char c : str) hash = (hash ^ std::uint8_t(c)) * 1099511628211ull;
+      return hash;
+    }
+  } // namespace
+
+  SampleCache::SampleCache(std::size_t budget) : _budget(budget) {}
+
+  SampleCache::~SampleCache()
+  {
+    _tag.remove(_size);
+  }
+
+  std::shared_ptr<const SampleCache::Samples> SampleCache::get(const filesystem::path& path,
+                                                               const std::string& kind,
+                                                               const Decoder& decode)
+  {
+    std::string key = kind + ':' + path.string();
+    std::error_code ec;
+    // A file that cant be stat'ed is decoded anyway, so `decode` reports the error
+    auto mtime = filesystem::last_write_time(path, ec);
+
+    // The lock is held while decoding, so a file requested from two threads is decoded once
+    std::unique_lock lock(_mutex);
+    if (auto found = _index.find(key); found != _index.end()) {
+      auto entry = found->second;
+      if (!ec && entry->mtime == mtime) {
+        _hits++;
+        _entries.splice(_entries.begin(), _entries, entry);
+        return entry->samples;
+      }
+      _size -= entry->bytes;
+      _tag.remove(entry->bytes);
+      _entries.erase(entry);
+      _index.erase(found);
+    }
+
+    std::shared_ptr<const Samples> samples;
+    if (!ec && !_persist_dir.empty()) samples = read_persisted(key, mtime);
+    const bool persisted = samples != nullptr;
+    if (persisted) {
+      _hits++;
+    } else {
+      _misses++;
+      samples = std::make_shared<const Samples>(decode());
+    }
+    std::size_t bytes = samples->size() * sizeof(float);
+    _entries.push_front({key, mtime, samples, bytes, persisted});
+    _index[key] = _entries.begin();
+    _size += bytes;
+    _tag.add(bytes);
+    trim();
+    return samples;
+  }
+
+  void SampleCache::clear()
+  {
+    std::unique_lock lock(_mutex);
+    _entries.clear();
+    _index.clear();
+    _tag.remove(_size);
+    _size = 0;
+  }
+
+  void SampleCache::persist_to(filesystem::path dir)
+  {
+    std::unique_lock lock(_mutex);
+    _persist_dir = std::move(dir);
+    for (auto& entry : _entries) entry.persisted = false;
+  }
+
+  void SampleCache::save()
+  {
+    std::unique_lock lock(_mutex);
+    if (_persist_dir.empty()) return;
+    std::error_code ec;
+    filesystem::create_directories(_persist_dir, ec);
+    std::vector<filesystem::path> keep;
+    for (auto& entry : _entries) {
+      if (!entry.persisted) entry.persisted = write_persisted(entry);
+      if (entry.persisted) keep.push_back(persisted_path(entry.key));
+    }
+    std::vector<filesystem::path> stale;
+    for (auto& file : filesystem::directory_iterator(_persist_dir, ec)) {
+      if (std::find(keep.begin(), keep.end(), file.path()) == keep.end()) stale.push_back(file.path());
+    }
+    for (auto& path : stale) filesystem::remove(path, ec);
+  }
+
+  filesystem::path SampleCache::persisted_path(const std::string& key) const
+  {
+    return _persist_dir / fmt::format("{:016x}.samples", fnv1a(key));
+  }
+
+  auto SampleCache::read_persisted(const std::string& key, filesystem::file_time_type mtime) const
+    -> std::shared_ptr<const Samples>
+  {
+    std::ifstream file(persisted_path(key).c_str(), std::ios::binary | std::ios::ate);
+    auto end = file.tellg();
+    if (!file || end < 0) return nullptr;
+    std::uint64_t size = end;
+    file.seekg(0);
+    PersistedHeader header;
+    const PersistedHeader expected;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return nullptr;
+    if (std::memcmp(header.magic, expected.magic, 4) != 0 || header.version != expected.version ||
+        header.mtime != mtime.time_since_epoch().count() || header.key_size != key.size())
+      return nullptr;
+    // The count is checked against the size of the file before allocating, so a truncated or
+    // corrupt file is a miss, not a huge allocation
+    std::uint64_t data_size = size - sizeof(header) - key.size();
+    if (size < sizeof(header) + key.size() || data_size % sizeof(float) != 0 ||
+        header.count != data_size / sizeof(float))
+      return nullptr;
+    // Files of different keys may share a hash
+    std::string file_key(key.size(), '\0');
+    if (!file.read(file_key.data(), file_key.size()) || file_key != key) return nullptr;
+    std::shared_ptr<Samples> samples;
+    try {
+      samples = std::make_shared<Samples>(header.count);
+    } catch (std::bad_alloc&) {
+      return nullptr;
+    }
+    if (!file.read(reinterpret_cast<char*>(samples->data()), data_size)) return nullptr;
+    return samples;
+  }
+
+  bool SampleCache::write_persisted(const Entry& entry) const
+  {
+    auto path = persisted_path(entry.key);
+    auto temp = filesystem::path(path.string() + ".tmp");
+    PersistedHeader header;
+    header.mtime = entry.mtime.time_since_epoch().count();
+    header.count = entry.samples->size();
+    header.key_size = entry.key.size();
+    const std::array<std::pair<const void*, std::size_t>, 3> parts = {{
+      {&header, sizeof(header)},
+      {entry.key.data(), entry.key.size()},
+      {entry.samples->data(), entry.samples->size() * sizeof(float)},
+    }};
+    // Like `util::JsonFile`, the file is on disk before it is renamed over the old one, so a
+    // power cut leaves either file, and never one that is cut short
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    for (auto [data, size] : parts) {
+      for (std::size_t done = 0; done < size;) {
+        auto res = ::write(fd, static_cast<const char*>(data) + done, size - done);
+        if (res < 0 && errno == EINTR) continue;
+        if (res < 0) {
+          ::close(fd);
+          return false;
+        }
+        done += res;
+      }
+    }
+    if (::fsync(fd) != 0 || ::close(fd) != 0) return false;
+#else
+    {
+      std::ofstream file(temp.c_str(), std::ios::binary | std::ios::trunc);
+      for (auto [data, size] : parts) file.write(static_cast<const char*>(data), size);
+      if (!file.flush()) return false;
+    }
+#endif
+    std::error_code ec;
+    filesystem::rename(temp, path, ec);
+    if (ec) return false;
+#if defined(__unix__) || defined(__APPLE__)
+    // Make the rename itself durable
+    if (int dir_fd = ::open(_persist_dir.c_str(), O_RDONLY); dir_fd >= 0) {
+      ::fsync(dir_fd);
+      ::close(dir_fd);
+    }
+#endif
+    return true;
+  }
+
+  void SampleCache::set_budget(std::size_t bytes)
+  {
+    std::unique_lock lock(_mutex);
+    _budget = bytes;
+    trim();
+  }
+
+  std::size_t SampleCache::budget() const
+  {
+    std::unique_lock lock(_mutex);
+    return _budget;
+  }
+
+  std::size_t SampleCache::size() const
+  {
+    std::unique_lock lock(_mutex);
+    return _size;
+  }
+
+  int SampleCache::count() const
+  {
+    std::unique_lock lock(_mutex);
+    return _entries.size();
+  }
+
+  int SampleCache::hits() const
+  {
+    std::unique_lock lock(_mutex);
+    return _hits;
+  }
+
+  int SampleCache::misses() const
+  {
+    std::unique_lock lock(_mutex);
+    return _misses;
+  }
+
+  void SampleCache::trim()
+  {
+    for (auto entry = _entries.end(); _size > _budget && entry != _entries.begin();) {
+      --entry;
+      // In use elsewhere, so evicting it would not free anything
+      if (entry->samples.use_count() > 1) continue;
+      _size -= entry->bytes;
+      _tag.remove(entry->bytes);
+      _index.erase(entry->key);
+      entry = _entries.erase(entry);
+    }
+  }
+
+} // namespace otto::core::audio
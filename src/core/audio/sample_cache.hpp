@@ -0,0 +1,121 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "util/filesystem.hpp"
+#include "util/memory_tags.hpp"
+
+namespace otto::core::audio {
+
+  /// A cache of decoded sample data, shared between all engines
+  ///
+  /// Entries are keyed by the path and modification time of the file, and by a `kind`, for
+  /// files decoded in different ways, like a full wavetable or the head of a streamed sample.
+  /// The samples are immutable and handed out as shared pointers, so a file used in several
+  /// places is only decoded and stored once.
+  ///
+  /// When the cache grows beyond its budget, the least recently used entries that are not in use
+  /// anywhere else are evicted. Entries in use are never evicted, so the cache may exceed its
+  /// budget by the size of those.
+  ///
+  /// The cached samples are accounted to the memory tag `Sample cache`.
+  ///
+  /// With @ref persist_to, the decoded samples are also kept on disk between runs, so a boot
+  /// reads the samples of the last run as they are, instead of decoding their files again.
+  ///
+  /// Thread safe, but decodes files, so not to be used from the audio thread.
+  struct SampleCache {
+    using Samples = std::vector<float>;
+    using Decoder = std::function<Samples()>;
+
+    static constexpr std::size_t default_budget = 64 << 20;
+
+    /// \param budget The size in bytes the cache is trimmed to
+    SampleCache(std::size_t budget = default_budget);
+    ~SampleCache();
+
+    SampleCache(const SampleCache&) = delete;
+    SampleCache& operator=(const SampleCache&) = delete;
+
+    /// Get the samples of `path`, decoding them with `decode` if they are not cached, or if the
+    /// file changed since they were decoded
+    ///
+    /// \throws What `decode` throws. Nothing is cached in that case.
+    std::shared_ptr<const Samples> get(const filesystem::path& path,
+                                       const std::string& kind,
+                                       const Decoder& decode);
+
+    /// Remove all entries
+    void clear();
+
+    /// Keep the decoded samples in files in `dir` between runs
+    ///
+    /// A miss reads the samples saved in `dir`, if the file they were decoded from has not
+    /// changed since, instead of decoding it. Those reads count as hits. @ref save writes the
+    /// entries. An empty path stops using the directory.
+    void persist_to(filesystem::path dir);
+
+    /// Write the entries that are not in the directory of @ref persist_to yet, and remove the
+    /// files of entries that are no longer cached, so it holds what this run used
+    ///
+    /// Call at shutdown. Each file is written, then renamed into place, and one cut short by a
+    /// power loss fails its checks when it is read, so its samples are decoded again.
+    void save();
+
+    /// Set the budget, and evict entries until the cache fits it
+    void set_budget(std::size_t bytes);
+
+    std::size_t budget() const;
+
+    /// The total size of the cached samples, in bytes
+    std::size_t size() const;
+
+    /// The number of entries
+    int count() const;
+
+    /// The number of calls to @ref get that did not need to decode
+    int hits() const;
+
+    /// The number of calls to @ref get that decoded the file
+    int misses() const;
+
+  private:
+    struct Entry {
+      std::string key;
+      filesystem::file_time_type mtime;
+      std::shared_ptr<const Samples> samples;
+      std::size_t bytes;
+      /// Whether the samples are in the directory of @ref persist_to
+      bool persisted = false;
+    };
+
+    /// The file of the entry `key` in the directory of @ref persist_to
+    filesystem::path persisted_path(const std::string& key) const;
+    /// Read the samples of `key` saved with the modification time `mtime`, if there are any
+    std::shared_ptr<const Samples> read_persisted(const std::string& key, filesystem::file_time_type mtime) const;
+    /// Write the samples of `entry`, and return whether they were written
+    bool write_persisted(const Entry& entry) const;
+
+    /// Evict unused entries until the cache fits the budget. Expects `_mutex` to be locked.
+    void trim();
+
+    mutable std::mutex _mutex;
+    util::MemoryTag& _tag = util::memory_tag("Sample cache");
+    std::size_t _budget;
+    std::size_t _size = 0;
+    int _hits = 0;
+    int _misses = 0;
+    /// The directory of @ref persist_to, or empty
+    filesystem::path _persist_dir;
+    /// Most recently used first
+    std::list<Entry> _entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+  };
+
+} // namespace otto::core::audio
@@ -0,0 +1,277 @@
+#include "sample_stream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "util/thread_policy.hpp"
+
+namespace otto::core::audio {
+
+  namespace {
+
+    std::uint32_t read_le(const unsigned char* data, int bytes) noexcept
+    {
+      std::uint32_t res = 0;
+      for (int i = bytes - 1; i >= 0; i--) res = (res << 8) | data[i];
+      return res;
+    }
+
+    /// Decode one sample of `bits` bits
+    float decode_sample(const unsigned char* data, int bits, bool is_float) noexcept
+    {
+      if (is_float) {
+        float res;
+        std::uint32_t raw = read_le(data, 4);
+        std::memcpy(&res, &raw, 4);
+        return res;
+      }
+      switch (bits) {
+      case 8: return (data[0] - 128) / 128.f;
+      case 16: return std::int16_t(read_le(data, 2)) / 32768.f;
+      // Shift the sign bit of the 24 bit value into place
+      case 24: return std::int32_t(read_le(data, 3) << 8) / 2147483648.f;
+      case 32: return std::int32_t(read_le(data, 4)) / 2147483648.f;
+      }
+      return 0;
+    }
+
+    /// How often the loader checks the play position
+    constexpr auto loader_interval = std::chrono::milliseconds(5);
+
+  } // namespace
+
+  SampleStream::SampleStream(const filesystem::path& path, SampleCache* cache, int samplerate)
+    : _file(path.c_str(), std::ios::binary)
+  {
+    if (!_file) {
+      throw exception(ErrorCode::file_not_found, "Could not open sample {}", path.string());
+    }
+
+    auto invalid = [&](const char* why) {
+      return exception(ErrorCode::invalid_format, "{}: {}", path.string(), why);
+    };
+
+    unsigned char header[12];
+    if (!_file.read((char*) header, 12) || std::memcmp(header, "RIFF", 4) != 0 ||
+        std::memcmp(header + 8, "WAVE", 4) != 0) {
+      throw invalid("Not a wav file");
+    }
+
+    bool has_format = false;
+    long data_size = -1;
+    unsigned char chunk[8];
+    while (_file.read((char*) chunk, 8)) {
+      long size = read_le(chunk + 4, 4);
+      if (std::memcmp(chunk, "fmt ", 4) == 0) {
+        std::vector<unsigned char> fmt(std::max(size, 16l));
+        if (!_file.read((char*) fmt.data(), size)) throw invalid("Truncated format chunk");
+        int tag = read_le(fmt.data(), 2);
+        // WAVE_FORMAT_EXTENSIBLE stores the real format tag in the sub format
+        if (tag == 0xFFFE && size >= 26) tag = read_le(fmt.data() + 24, 2);
+        _channels = read_le(fmt.data() + 2, 2);
+        _samplerate = read_le(fmt.data() + 4, 4);
+        _bits = read_le(fmt.data() + 14, 2);
+        _float = tag == 3;
+        bool valid = (tag == 1 && (_bits == 8 || _bits == 16 || _bits == 24 || _bits == 32)) ||
+                     (tag == 3 && _bits == 32);
+        if (!valid) throw invalid("Unsupported sample format");
+        if (_channels < 1 || _samplerate < 1) throw invalid("Invalid format chunk");
+        has_format = true;
+      } else if (std::memcmp(chunk, "data", 4) == 0) {
+        _data_offset = _file.tellg();
+        data_size = size;
+        break;
+      } else {
+        _file.seekg(size, std::ios::cur);
+      }
+      // Chunks are padded to an even size
+      if (size % 2 == 1) _file.seekg(1, std::ios::cur);
+    }
+    if (!has_format || data_size < 0) throw invalid("Missing format or data chunk");
+
+    // The size may be wrong in files that were not closed properly
+    _file.clear();
+    _file.seekg(0, std::ios::end);
+    long available = long(_file.tellg()) - _data_offset;
+    long frame_bytes = _channels * _bits / 8;
+    _file_frames = std::min(data_size, available) / frame_bytes;
+    _file_samplerate = _samplerate;
+    _frames = _file_frames;
+    if (samplerate > 0 && samplerate != _file_samplerate) {
+      _resampler.emplace(_file_samplerate, samplerate);
+      _samplerate = samplerate;
+      _frames = _resampler->output_frames(_file_frames);
+    }
+    _decode_buf.resize(block_size);
+
+    auto decode_head = [this] {
+      std::vector<float> head(std::min<long>(_frames, head_blocks * block_size));
+      for (long frame = 0; frame < long(head.size()); frame += block_size) {
+        decode(frame, std::min<long>(block_size, head.size() - frame), head.data() + frame);
+      }
+      return head;
+    };
+    if (cache != nullptr) {
+      _head = cache->get(path, fmt::format("sample_head@{}", _samplerate), decode_head);
+    } else {
+      _head = std::make_shared<const std::vector<float>>(decode_head());
+    }
+    _head_frames = _head->size();
+
+    if (_frames > _head_frames) {
+      _cache = std::make_unique<Block[]>(cache_blocks);
+      for (int i = 0; i < cache_blocks; i++) {
+        _cache[i].data = std::make_unique<std::atomic<float>[]>(block_size);
+      }
+      _loader = util::start_thread(util::ThreadClass::io, [this] { loader_loop(); });
+    }
+  }
+
+  SampleStream::~SampleStream() noexcept
+  {
+    if (!_loader.joinable()) return;
+    {
+      std::unique_lock lock(_mutex);
+      _stop = true;
+    }
+    _cv.notify_one();
+    _loader.join();
+  }
+
+  float SampleStream::read(long frame) noexcept
+  {
+    if (frame < 0 || frame >= _frames) return 0;
+    if (frame < _head_frames) return (*_head)[frame];
+
+    long index = frame / block_size;
+    auto& block = _cache[index % cache_blocks];
+    if (block.index.load(std::memory_order_acquire) == index) {
+      float res = block.data[frame % block_size].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      // If the loader started refilling the block while we read it, the value is not valid
+      if (block.index.load(std::memory_order_relaxed) == index) return res;
+    }
+    _underruns.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+  }
+
+  void SampleStream::prefetch(long frame, bool forward) noexcept
+  {
+    _position.store(frame, std::memory_order_relaxed);
+    _forward.store(forward, std::memory_order_relaxed);
+  }
+
+  /// The range of blocks the loader keeps around `position`
+  ///
+  /// Three quarters of the cache are ahead of the position, the rest behind it, so a loop or a
+  /// change of direction does not run dry right away.
+  static std::pair<long, long> window_of(long position, bool forward, long cache_blocks) noexcept
+  {
+    long block = position / SampleStream::block_size;
+    long ahead = cache_blocks * 3 / 4;
+    long first = forward ? block - (cache_blocks - ahead) : block - ahead + 1;
+    return {first, first + cache_blocks};
+  }
+
+  bool SampleStream::is_loaded(long frame) const noexcept
+  {
+    if (!_cache) return true;
+    auto [first, last] = window_of(frame, _forward, cache_blocks);
+    long head_end = _head_frames / block_size;
+    long file_end = (_frames + block_size - 1) / block_size;
+    for (long i = std::max(first, head_end); i < std::min(last, file_end); i++) {
+      if (_cache[i % cache_blocks].index.load(std::memory_order_acquire) != i) return false;
+    }
+    return true;
+  }
+
+  void SampleStream::read_file(long frame, int count, float* out)
+  {
+    int sample_bytes = _bits / 8;
+    long frame_bytes = _channels * sample_bytes;
+    _read_buf.resize(std::max<std::size_t>(_read_buf.size(), count * frame_bytes));
+    _file.clear();
+    _file.seekg(_data_offset + frame * frame_bytes);
+    _file.read((char*) _read_buf.data(), count * frame_bytes);
+    // Frames that could not be read are silent
+    long read = _file.gcount() / frame_bytes;
+    for (long i = 0; i < count; i++) {
+      float sum = 0;
+      if (i < read) {
+        for (int ch = 0; ch < _channels; ch++) {
+          sum += decode_sample(&_read_buf[i * frame_bytes + ch * sample_bytes], _bits, _float);
+        }
+      }
+      out[i] = sum / _channels;
+    }
+  }
+
+  void SampleStream::decode(long frame, int count, float* out)
+  {
+    if (!_resampler) return read_file(frame, count, out);
+    // The frames of the file the resampler needs around the range
+    double position = frame * _resampler->ratio();
+    long first = std::max<long>(std::floor(position) - _resampler->radius(), 0);
+    long last = std::min<long>(std::ceil(position + count * _resampler->ratio()) + _resampler->radius(), _file_frames);
+    _resample_buf.resize(std::max(last - first, 0l));
+    read_file(first, _resample_buf.size(), _resample_buf.data());
+    _resampler->process(_resample_buf, position - first, {out, count});
+  }
+
+  void SampleStream::load_block(long index)
+  {
+    auto& decoded = _decode_buf;
+    long frame = index * block_size;
+    int count = std::min<long>(block_size, _frames - frame);
+    decode(frame, count, decoded.data());
+
+    auto& block = _cache[index % cache_blocks];
+    block.index.store(-1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < block_size; i++) {
+      block.data[i].store(i < count ? decoded[i] : 0.f, std::memory_order_relaxed);
+    }
+    block.index.store(index, std::memory_order_release);
+  }
+
+  void SampleStream::fill()
+  {
+    long position = _position.load(std::memory_order_relaxed);
+    bool forward = _forward.load(std::memory_order_relaxed);
+    auto [first, last] = window_of(position, forward, cache_blocks);
+    long head_end = _head_frames / block_size;
+    long file_end = (_frames + block_size - 1) / block_size;
+    long block = position / block_size;
+
+    // Load the blocks closest to the position in the direction of playback first. Every block
+    // in the window has its own slot, so only blocks outside of it are replaced.
+    for (long n = 0; n < cache_blocks; n++) {
+      long i = forward ? block + n : block - n;
+      // Wrap around to the blocks behind the position
+      if (i >= last) i -= cache_blocks;
+      if (i < first) i += cache_blocks;
+      if (i < head_end || i >= file_end) continue;
+      if (_cache[i % cache_blocks].index.load(std::memory_order_relaxed) == i) continue;
+      load_block(i);
+      // Start over if the position moved outside the window while loading
+      auto [new_first, new_last] = window_of(_position.load(std::memory_order_relaxed),
+                                             _forward.load(std::memory_order_relaxed),
+                                             cache_blocks);
+      if (new_first != first) return;
+    }
+  }
+
+  void SampleStream::loader_loop()
+  {
+    std::unique_lock lock(_mutex);
+    while (!_stop) {
+      lock.unlock();
+      fill();
+      lock.lock();
+      _cv.wait_for(lock, loader_interval, [this] { return _stop; });
+    }
+  }
+
+} // namespace otto::core::audio
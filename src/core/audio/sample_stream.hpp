@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "core/audio/sample_cache.hpp"
+#include "util/dsp/resampler.hpp"
+#include "util/exception.hpp"
+#include "util/filesystem.hpp"
+
+namespace otto::core::audio {
+
+  /// A mono sample file, streamed from disk
+  ///
+  /// The head of the file is decoded when the stream is opened, and the rest is read in blocks
+  /// by a background thread into a fixed cache around the play position. Reading a frame never
+  /// blocks: a frame that is not loaded yet reads as silence, and is counted in
+  /// @ref underrun_count.
+  ///
+  /// The audio thread tells the loader where it is going with @ref prefetch, once per buffer.
+  /// The loader keeps most of the cache ahead of that position, in the direction of playback.
+  ///
+  /// Supports 8, 16, 24 and 32 bit integer and 32 bit float wav files. Multichannel files are
+  /// mixed down to mono.
+  ///
+  /// Files can be resampled to another samplerate as they are decoded, with a
+  /// `dsp::Resampler`, so they play back at the samplerate of the device without interpolation.
+  struct SampleStream {
+    enum struct ErrorCode {
+      /// The file could not be opened
+      file_not_found,
+      /// Not a wav file in a supported format
+      invalid_format,
+    };
+
+    using exception = util::as_exception<ErrorCode>;
+
+    /// The number of frames in a block read by the loader
+    static constexpr int block_size = 4096;
+    /// The number of blocks in the cache. About 2.7 seconds at 48 kHz.
+    static constexpr int cache_blocks = 32;
+    /// The number of blocks decoded when opening the file, covering the time the loader needs to
+    /// start. About 1.4 seconds at 48 kHz.
+    static constexpr int head_blocks = 16;
+
+    /// Open a file, and decode its head
+    ///
+    /// Blocks on I/O, so not to be called from the audio thread.
+    ///
+    /// \param cache If given, the head is shared with other streams of the same file through it
+    /// \param samplerate The samplerate to resample the file to. `0` keeps the samplerate of the
+    ///                   file.
+    ///
+    /// \throws `exception` with `ErrorCode::file_not_found` or `ErrorCode::invalid_format`
+    SampleStream(const filesystem::path& path, SampleCache* cache = nullptr, int samplerate = 0);
+
+    /// Stops the loader
+    ~SampleStream() noexcept;
+
+    SampleStream(const SampleStream&) = delete;
+    SampleStream& operator=(const SampleStream&) = delete;
+
+    /// The length of the sample in frames, at @ref samplerate
+    long frames() const noexcept
+    {
+      return _frames;
+    }
+
+    /// The samplerate of the frames read, which is the one given to the constructor, if any
+    int samplerate() const noexcept
+    {
+      return _samplerate;
+    }
+
+    /// The samplerate of the file
+    int file_samplerate() const noexcept
+    {
+      return _file_samplerate;
+    }
+
+    /// Get a frame. Never blocks.
+    ///
+    /// \returns `0` if `frame` is out of bounds, or not loaded yet
+    float read(long frame) noexcept;
+
+    /// Tell the loader the current play position and direction
+    ///
+    /// Never blocks, call it from the audio thread once per buffer.
+    void prefetch(long frame, bool forward = true) noexcept;
+
+    /// The number of reads of frames that were not loaded yet
+    int underrun_count() const noexcept
+    {
+      return _underruns;
+    }
+
+    /// Check if the frames around `frame` are loaded, in the direction set by @ref prefetch
+    bool is_loaded(long frame) const noexcept;
+
+  private:
+    struct Block {
+      /// The index of the block held, or -1 while empty or loading. A seqlock for `data`.
+      std::atomic<long> index = -1;
+      /// Atomic, so a slot being refilled while read is not a data race
+      std::unique_ptr<std::atomic<float>[]> data;
+    };
+
+    /// Read `count` frames from `frame` of the file, and mix them down into `out`
+    void read_file(long frame, int count, float* out);
+    /// Decode `count` frames from `frame`, at @ref samplerate, into `out`
+    void decode(long frame, int count, float* out);
+    void load_block(long index);
+    void loader_loop();
+    /// Load all missing blocks around the prefetch position
+    void fill();
+
+    std::ifstream _file;
+    long _data_offset = 0;
+    int _channels = 0;
+    int _bits = 0;
+    bool _float = false;
+    long _frames = 0;
+    long _file_frames = 0;
+    int _samplerate = 0;
+    int _file_samplerate = 0;
+    /// Only when resampling
+    std::optional<dsp::Resampler> _resampler;
+    /// Buffers used while decoding. Only used by the thread decoding.
+    std::vector<unsigned char> _read_buf;
+    std::vector<float> _decode_buf;
+    std::vector<float> _resample_buf;
+
+    std::shared_ptr<const std::vector<float>> _head;
+    /// The size of `_head`, read on every call to @ref read
+    long _head_frames = 0;
+    std::unique_ptr<Block[]> _cache;
+
+    std::atomic<long> _position = 0;
+    std::atomic_bool _forward = true;
+    std::atomic_int _underruns = 0;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _stop = false;
+    std::thread _loader;
+  };
+
+} // namespace otto::core::audio
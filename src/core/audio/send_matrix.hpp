@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+
+#include "util/audio.hpp"
+
+namespace otto::core::audio {
+
+  /// Mixes `Sources` signals into `Buses` buses through a matrix of gains
+  ///
+  /// Each source has a row of gains, one per bus, set with @ref set once per buffer. The gains
+  /// ramp linearly from the ones of the previous buffer, so a change never clicks, and the whole
+  /// matrix is mixed by one call to @ref util::audio::KernelTable::mix_matrix, so adding a source
+  /// or a bus costs a few multiply-adds per frame, and not another pass over the buffers.
+  template<int Sources, int Buses>
+  struct SendMatrix {
+    static_assert(Sources <= util::audio::max_matrix_sources);
+
+    static constexpr int sources = Sources;
+    static constexpr int buses = Buses;
+
+    /// Set the gains of `source` to each bus, reached at the end of the next buffer
+    void set(int source, const std::array<float, Buses>& gains) noexcept
+    {
+      for (int b = 0; b < Buses; b++) _to[source * Buses + b] = gains[b];
+    }
+
+    /// The gain of `source` to `bus` at the end of the next buffer
+    float gain(int source, int bus) const noexcept
+    {
+      return _to[source * Buses + bus];
+    }
+
+    /// Mix `srcs` into `dsts`, which must not be any of the sources
+    ///
+    /// A source that is `nullptr`, like a silent one, is skipped.
+    ///
+    /// \returns Whether each bus is silent, as nothing was sent to it
+    std::array<bool, Buses> process(const std::array<const float*, Sources>& srcs,
+                                    const std::array<float*, Buses>& dsts,
+                                    int nframes) noexcept
+    {
+      std::array<bool, Buses> silent;
+      for (int b = 0; b < Buses; b++) {
+        silent[b] = true;
+        for (int s = 0; s < Sources; s++) {
+          int i = s * Buses + b;
+          if (srcs[s] != nullptr && (_from[i] != 0 || _to[i] != 0)) silent[b] = false;
+        }
+      }
+      util::audio::kernels().mix_matrix(srcs.data(), Sources, _from.data(), _to.data(), dsts.data(), Buses, nframes);
+      _from = _to;
+      return silent;
+    }
+
+  private:
+    /// The gains at the start of the next buffer, indexed by `source * Buses + bus`
+    std::array<float, Sources * Buses> _from = {};
+    /// The gains at the end of the next buffer
+    std::array<float, Sources * Buses> _to = {};
+  };
+
+} // namespace otto::core::audio
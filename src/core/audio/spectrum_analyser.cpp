@@ -0,0 +1,225 @@
+#include "spectrum_analyser.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <fmt/format.h>
+
+#include "core/ui/vector_graphics.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::core::audio {
+
+  struct SpectrumAnalyser::Screen : ui::Screen {
+    Screen(SpectrumAnalyser& analyser) : analyser(analyser) {}
+
+    void on_show() override
+    {
+      analyser.active(true);
+    }
+
+    void on_hide() override
+    {
+      analyser.active(false);
+    }
+
+    bool animating() override
+    {
+      return true;
+    }
+
+    void draw(ui::vg::Canvas& ctx) override;
+
+    SpectrumAnalyser& analyser;
+  };
+
+  SpectrumAnalyser::SpectrumAnalyser(int samplerate)
+    : _samplerate(samplerate), _screen(ui::make_screen<Screen>(*this))
+  {
+    _decimator.factor(low_factor);
+    _levels.fill(floor_db);
+    _published.publish(_levels);
+    _thread = util::start_thread(util::ThreadClass::background, [this] { run(); });
+  }
+
+  SpectrumAnalyser::~SpectrumAnalyser()
+  {
+    {
+      std::unique_lock lock(_mutex);
+      _quit = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+  }
+
+  void SpectrumAnalyser::write(gsl::span<const float> left, gsl::span<const float> right) noexcept
+  {
+    if (!_active.load(std::memory_order_relaxed)) return;
+    const std::size_t nframes = left.size();
+    if (_ring->write_available() < 1 + 2 * nframes) return;
+    float header = nframes;
+    _ring->write(&header, 1);
+    _ring->write(left.data(), nframes);
+    _ring->write(right.data(), nframes);
+  }
+
+  void SpectrumAnalyser::active(bool active) noexcept
+  {
+    _active = active;
+  }
+
+  bool SpectrumAnalyser::active() const noexcept
+  {
+    return _active;
+  }
+
+  void SpectrumAnalyser::samplerate(int samplerate) noexcept
+  {
+    _samplerate = samplerate;
+  }
+
+  void SpectrumAnalyser::request() noexcept
+  {
+    {
+      std::unique_lock lock(_mutex);
+      _requested = true;
+    }
+    _cv.notify_one();
+  }
+
+  const SpectrumAnalyser::Spectrum& SpectrumAnalyser::read() noexcept
+  {
+    return _published.read();
+  }
+
+  float SpectrumAnalyser::band_frequency(int band) noexcept
+  {
+    return min_freq * std::pow(max_freq / min_freq, (band + 0.5f) / bands);
+  }
+
+  ui::Screen& SpectrumAnalyser::screen() noexcept
+  {
+    return *_screen;
+  }
+
+  void SpectrumAnalyser::run()
+  {
+    std::unique_lock lock(_mutex);
+    while (true) {
+      _cv.wait(lock, [this] { return _requested || _quit; });
+      if (_quit) return;
+      _requested = false;
+      lock.unlock();
+      update();
+      lock.lock();
+    }
+  }
+
+  void SpectrumAnalyser::append(gsl::span<const float> frames)
+  {
+    for (float frm : frames) {
+      _history[_history_pos] = frm;
+      _history_pos = (_history_pos + 1) % fft_size;
+      _undecimated[_undecimated_count++] = frm;
+      if (_undecimated_count == low_factor) {
+        _decimator.process(_undecimated, {&_low_history[_low_pos], 1});
+        _low_pos = (_low_pos + 1) % fft_size;
+        _undecimated_count = 0;
+      }
+    }
+  }
+
+  void SpectrumAnalyser::update()
+  {
+    std::vector<float> block;
+    std::vector<float> mono;
+    float header;
+    // The producer writes whole buffers, and checks for space first, so once the frame count
+    // of a buffer is in the ring, its channels are about to be too
+    while (_ring->pop(header)) {
+      const std::size_t nframes = header;
+      block.resize(2 * nframes);
+      for (std::size_t read = 0; read < block.size();) {
+        read += _ring->read(block.data() + read, block.size() - read);
+      }
+      mono.resize(nframes);
+      for (std::size_t i = 0; i < nframes; i++) mono[i] = 0.5f * (block[i] + block[nframes + i]);
+      append(mono);
+    }
+
+    transform(_history, _history_pos, _power);
+    transform(_low_history, _low_pos, _low_power);
+
+    const float samplerate = _samplerate.load();
+    // The decimated signal is flat up to about a sixteenth of the samplerate
+    const float low_limit = samplerate / 16;
+    // A full scale sine has a magnitude of `fft_size / 2` with the normalized window
+    const float scale = 4.f / (float(fft_size) * fft_size);
+    const float ratio = std::pow(max_freq / min_freq, 1.f / bands);
+    for (int b = 0; b < bands; b++) {
+      float lo = min_freq * std::pow(ratio, b);
+      float hi = lo * ratio;
+      bool low = hi <= low_limit;
+      auto& power = low ? _low_power : _power;
+      float bin_width = (low ? samplerate / low_factor : samplerate) / fft_size;
+      int first = std::ceil(lo / bin_width);
+      int last = std::min<int>(hi / bin_width, fft_size / 2);
+      float max = 0;
+      if (first > last) {
+        // Narrower than a bin
+        max = power[std::min<int>(std::lround(band_frequency(b) / bin_width), fft_size / 2)];
+      } else {
+        for (int k = first; k <= last; k++) max = std::max(max, power[k]);
+      }
+      float db = max > 0 ? 10 * std::log10(max * scale) : floor_db;
+      _levels[b] = std::max({db, _levels[b] - falloff_db, floor_db});
+    }
+    _published.publish(_levels);
+  }
+
+  void SpectrumAnalyser::transform(const std::vector<float>& history, std::size_t pos, std::vector<float>& power)
+  {
+    // Oldest frame first
+    for (int i = 0; i < fft_size; i++) _frame[i] = history[(pos + i) % fft_size];
+    _window.apply_to(_frame);
+    std::copy(_frame.begin(), _frame.end(), _input.begin());
+    _fft.forward(_input, _re, _im);
+    for (std::size_t k = 0; k < power.size(); k++) power[k] = _re[k] * _re[k] + _im[k] * _im[k];
+  }
+
+  // Screen //
+
+  void SpectrumAnalyser::Screen::draw(ui::vg::Canvas& ctx)
+  {
+    using namespace ui::vg;
+
+    // Computed in the background, and shown on the next frame
+    analyser.request();
+    auto& levels = analyser.read();
+
+    constexpr float x_pad = 20;
+    constexpr float top = 20;
+    constexpr float bottom = height - 40;
+    constexpr float bar_width = (width - 2 * x_pad) / bands;
+
+    ctx.beginPath();
+    for (int b = 0; b < bands; b++) {
+      float level = std::clamp((levels[b] - floor_db) / -floor_db, 0.f, 1.f);
+      float x = x_pad + b * bar_width;
+      float y = bottom - level * (bottom - top);
+      ctx.rect({x, y}, {bar_width - 1, bottom - y});
+    }
+    ctx.fill(Colours::Blue);
+
+    // The frequency axis
+    ctx.font(Fonts::Norm, 20);
+    ctx.fillStyle(Colours::Gray50);
+    ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+    const float octaves = std::log2(max_freq / min_freq);
+    for (int freq : {100, 1000, 10000}) {
+      float x = x_pad + std::log2(freq / min_freq) / octaves * (width - 2 * x_pad);
+      ctx.fillText(freq < 1000 ? fmt::format("{}", freq) : fmt::format("{}k", freq / 1000), {x, bottom + 20});
+    }
+  }
+
+} // namespace otto::core::audio
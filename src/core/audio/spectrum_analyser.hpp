@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gsl/span>
+
+#include "core/ui/screen.hpp"
+#include "util/dsp/decimator.hpp"
+#include "util/dsp/fft.hpp"
+#include "util/dsp/window.hpp"
+#include "util/spsc_ring.hpp"
+#include "util/triple_buffer.hpp"
+
+namespace otto::core::audio {
+
+  /// Shows the spectrum of the master bus
+  ///
+  /// The audio thread hands each buffer to @ref write, which only copies it into a lock-free
+  /// ring, and only while the screen is shown. The screen calls @ref request on each frame it
+  /// draws, which wakes a worker thread with the idle priority. The worker drains the ring, runs
+  /// the windowed FFTs of the latest frames, and publishes the levels of @ref bands bands with a
+  /// `util::TripleBuffer`, which the screen draws on its next frame. So the spectrum is computed
+  /// at the frame rate of the UI, whatever the buffer size.
+  ///
+  /// The bands are spaced logarithmically from @ref min_freq to @ref max_freq. The bands below a
+  /// sixteenth of the samplerate are taken from a second FFT of the signal decimated by
+  /// @ref low_factor, which covers a window that many times longer, for the resolution the low
+  /// bands need.
+  struct SpectrumAnalyser {
+    static constexpr int fft_size = 2048;
+    static constexpr int low_factor = 4;
+    static constexpr int bands = 64;
+    static constexpr float min_freq = 20.f;
+    static constexpr float max_freq = 20000.f;
+    /// The lowest level shown, in dBFS
+    static constexpr float floor_db = -90.f;
+    /// The most a band falls per update, in dB
+    static constexpr float falloff_db = 1.5f;
+
+    /// The samples that may wait for the worker, about 0.17 seconds of stereo audio
+    static constexpr std::size_t ring_size = 1 << 14;
+
+    /// The level of each band, in dBFS
+    using Spectrum = std::array<float, bands>;
+
+    SpectrumAnalyser(int samplerate);
+    ~SpectrumAnalyser();
+
+    SpectrumAnalyser(const SpectrumAnalyser&) = delete;
+    SpectrumAnalyser& operator=(const SpectrumAnalyser&) = delete;
+
+    /// Hand over a stereo buffer. Does nothing unless the analyser is @ref active.
+    ///
+    /// Only to be called from the audio thread. Copies the buffer into the ring, and never
+    /// blocks. Buffers that do not fit are dropped.
+    void write(gsl::span<const float> left, gsl::span<const float> right) noexcept;
+
+    /// Start or stop taking buffers in @ref write. Set by the screen when it is shown and hidden.
+    void active(bool active) noexcept;
+    bool active() const noexcept;
+
+    void samplerate(int samplerate) noexcept;
+
+    /// Wake the worker to compute a new spectrum. Does not wait for it.
+    void request() noexcept;
+
+    /// Drain the ring, and publish the spectrum of the latest frames
+    ///
+    /// Called by the worker after @ref request. Not to be called from more than one thread
+    /// at a time.
+    void update();
+
+    /// The latest spectrum. Only to be called from one thread, usually the UI thread.
+    const Spectrum& read() noexcept;
+
+    /// The centre frequency of band `band`, in Hz
+    static float band_frequency(int band) noexcept;
+
+    ui::Screen& screen() noexcept;
+
+  private:
+    struct Screen;
+
+    void run();
+    /// Add the mono sum of a buffer from the ring to the histories
+    void append(gsl::span<const float> frames);
+    /// The spectrum of `history`, the newest frame at `pos`, into `power`
+    void transform(const std::vector<float>& history, std::size_t pos, std::vector<float>& power);
+
+    std::atomic_int _samplerate;
+    std::atomic_bool _active = false;
+
+    /// Each buffer is its frame count, followed by the left and the right channel
+    std::unique_ptr<util::SPSCRing<float, ring_size>> _ring =
+      std::make_unique<util::SPSCRing<float, ring_size>>();
+
+    // Only used by the worker //
+
+    /// The last `fft_size` frames, in a ring
+    std::vector<float> _history = std::vector<float>(fft_size);
+    std::size_t _history_pos = 0;
+    /// The last `fft_size` frames decimated by `low_factor`, in a ring
+    std::vector<float> _low_history = std::vector<float>(fft_size);
+    std::size_t _low_pos = 0;
+    dsp::Decimator _decimator;
+    /// The frames not yet decimated, less than `low_factor`
+    std::array<float, low_factor> _undecimated = {};
+    int _undecimated_count = 0;
+    util::dsp::Window _window{fft_size, util::dsp::Window::blackman_harris};
+    dsp::FFT _fft{fft_size};
+    std::vector<double> _frame = std::vector<double>(fft_size);
+    std::vector<float> _input = std::vector<float>(fft_size);
+    std::vector<float> _re = std::vector<float>(fft_size / 2 + 1);
+    std::vector<float> _im = std::vector<float>(fft_size / 2 + 1);
+    /// The power of each bin, of the full rate and the decimated spectrum
+    std::vector<float> _power = std::vector<float>(fft_size / 2 + 1);
+    std::vector<float> _low_power = std::vector<float>(fft_size / 2 + 1);
+    Spectrum _levels;
+
+    util::TripleBuffer<Spectrum> _published;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    /// Guarded by `_mutex`
+    bool _requested = false;
+    bool _quit = false;
+    std::thread _thread;
+
+    std::unique_ptr<ui::Screen> _screen;
+  };
+
+} // namespace otto::core::audio
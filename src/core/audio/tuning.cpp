@@ -0,0 +1,201 @@
+#include "tuning.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace otto::core::midi {
+
+  namespace {
+
+    using exception = Scale::exception;
+    using ErrorCode = Scale::ErrorCode;
+
+    /// Reads the lines of a Scala file, skipping `!` comments
+    struct LineReader {
+      std::istream& stream;
+
+      /// The next line that is not a comment, or `false` at the end
+      bool next(std::string& line)
+      {
+        while (std::getline(stream, line)) {
+          if (!line.empty() && line.back() == '\r') line.pop_back();
+          auto first = line.find_first_not_of(" \t");
+          if (first != std::string::npos && line[first] == '!') continue;
+          return true;
+        }
+        return false;
+      }
+
+      /// The first word of the next line that is neither a comment nor blank
+      std::string word(ErrorCode ec, const char* what)
+      {
+        std::string line;
+        while (next(line)) {
+          std::istringstream words(line);
+          std::string res;
+          if (words >> res) return res;
+        }
+        throw exception(ec, "Missing {}", what);
+      }
+    };
+
+    int parse_int(const std::string& word, ErrorCode ec)
+    {
+      std::size_t end = 0;
+      try {
+        int res = std::stoi(word, &end);
+        if (end == word.size()) return res;
+      } catch (std::exception&) {
+      }
+      throw exception(ec, "Expected a whole number, got '{}'", word);
+    }
+
+    double parse_pitch(const std::string& word)
+    {
+      try {
+        if (word.find('.') != std::string::npos) {
+          return std::exp2(std::stod(word) / 1200.0);
+        }
+        auto slash = word.find('/');
+        double num = parse_int(word.substr(0, slash), ErrorCode::invalid_scale);
+        double den = slash == std::string::npos ? 1 : parse_int(word.substr(slash + 1), ErrorCode::invalid_scale);
+        if (num > 0 && den > 0) return num / den;
+      } catch (std::exception&) {
+      }
+      throw exception(ErrorCode::invalid_scale, "Invalid pitch '{}'", word);
+    }
+
+    /// `floor(a / b)`, for negative `a` too
+    int floor_div(int a, int b) noexcept
+    {
+      return a / b - (a % b != 0 && a < 0);
+    }
+
+  } // namespace
+
+  Scale Scale::from_scl(std::istream& scl)
+  {
+    LineReader reader{scl};
+    Scale res;
+    if (!reader.next(res.description)) {
+      throw exception(ErrorCode::invalid_scale, "Missing the description");
+    }
+    int count = parse_int(reader.word(ErrorCode::invalid_scale, "the number of notes"), ErrorCode::invalid_scale);
+    if (count < 1) throw exception(ErrorCode::invalid_scale, "A scale needs at least one note");
+    res.ratios.reserve(count);
+    for (int i = 0; i < count; i++) {
+      res.ratios.push_back(parse_pitch(reader.word(ErrorCode::invalid_scale, "notes")));
+    }
+    return res;
+  }
+
+  Scale Scale::load(const filesystem::path& path)
+  {
+    std::ifstream stream(path.c_str());
+    if (!stream) {
+      throw exception(ErrorCode::file_not_found, "Could not open scale {}", path.string());
+    }
+    return from_scl(stream);
+  }
+
+  double Scale::ratio(int degree) const noexcept
+  {
+    int size = ratios.size();
+    int period = floor_div(degree, size);
+    int step = degree - period * size;
+    double res = step == 0 ? 1 : ratios[step - 1];
+    return res * std::pow(ratios.back(), period);
+  }
+
+  KeyboardMapping KeyboardMapping::from_kbm(std::istream& kbm)
+  {
+    LineReader reader{kbm};
+    auto next_int = [&](const char* what) {
+      return parse_int(reader.word(ErrorCode::invalid_mapping, what), ErrorCode::invalid_mapping);
+    };
+    KeyboardMapping res;
+    int size = next_int("the map size");
+    res.first_key = next_int("the first key");
+    res.last_key = next_int("the last key");
+    res.middle_key = next_int("the middle key");
+    res.reference_key = next_int("the reference key");
+    try {
+      res.reference_freq = std::stod(reader.word(ErrorCode::invalid_mapping, "the reference frequency"));
+    } catch (std::invalid_argument&) {
+      throw exception(ErrorCode::invalid_mapping, "Invalid reference frequency");
+    }
+    res.octave_degree = next_int("the octave degree");
+    if (size < 0 || res.reference_freq <= 0) {
+      throw exception(ErrorCode::invalid_mapping, "Invalid map size or reference frequency");
+    }
+    // Missing entries at the end are not mapped
+    res.map.assign(size, -1);
+    std::string line;
+    for (int i = 0; i < size && reader.next(line); i++) {
+      std::istringstream words(line);
+      std::string word;
+      if (!(words >> word)) {
+        i--;
+        continue;
+      }
+      if (word != "x") res.map[i] = parse_int(word, ErrorCode::invalid_mapping);
+    }
+    return res;
+  }
+
+  KeyboardMapping KeyboardMapping::load(const filesystem::path& path)
+  {
+    std::ifstream stream(path.c_str());
+    if (!stream) {
+      throw exception(ErrorCode::file_not_found, "Could not open keyboard mapping {}", path.string());
+    }
+    return from_kbm(stream);
+  }
+
+  FreqTable make_freq_table(const Scale& scale, const KeyboardMapping& mapping)
+  {
+    if (!mapping.map.empty() && mapping.octave_degree <= 0) {
+      throw exception(ErrorCode::invalid_mapping, "The octave degree must be positive");
+    }
+    /// The frequency ratio of `key` to the root, or 0 if it is not mapped
+    auto ratio = [&](int key) -> double {
+      if (key < mapping.first_key || key > mapping.last_key) return 0;
+      int offset = key - mapping.middle_key;
+      if (mapping.map.empty()) return scale.ratio(offset);
+      int size = mapping.map.size();
+      int octave = floor_div(offset, size);
+      int degree = mapping.map[offset - octave * size];
+      if (degree < 0) return 0;
+      return scale.ratio(degree) * std::pow(scale.ratio(mapping.octave_degree), octave);
+    };
+
+    double reference = ratio(mapping.reference_key);
+    if (reference == 0) throw exception(ErrorCode::invalid_mapping, "The reference key is not mapped");
+
+    FreqTable res = {};
+    float last = 0;
+    for (int key = 0; key < 128; key++) {
+      double r = ratio(key);
+      if (r != 0) last = float(mapping.reference_freq * r / reference);
+      res[key] = last;
+    }
+    // Keys below the first mapped key
+    auto first = std::find_if(res.begin(), res.begin() + 128, [](float f) { return f != 0; });
+    if (first == res.begin() + 128) throw exception(ErrorCode::invalid_mapping, "No keys are mapped");
+    std::fill(res.begin(), first, *first);
+    res[128] = res[127] * (res[127] / res[126]);
+    return res;
+  }
+
+  std::unique_ptr<FreqTable> load_tuning(const filesystem::path& path)
+  {
+    auto scale = Scale::load(path);
+    auto kbm = path;
+    kbm.replace_extension(".kbm");
+    auto mapping = filesystem::exists(kbm) ? KeyboardMapping::load(kbm) : KeyboardMapping{};
+    return std::make_unique<FreqTable>(make_freq_table(scale, mapping));
+  }
+
+} // namespace otto::core::midi
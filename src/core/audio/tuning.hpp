@@ -0,0 +1,93 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/audio/midi.hpp"
+#include "util/exception.hpp"
+#include "util/filesystem.hpp"
+
+namespace otto::core::midi {
+
+  /// A musical scale, as read from a Scala `.scl` file
+  struct Scale {
+    enum struct ErrorCode {
+      /// The file could not be opened
+      file_not_found,
+      /// The `.scl` data could not be parsed
+      invalid_scale,
+      /// The `.kbm` data could not be parsed, or does not fit the scale
+      invalid_mapping,
+    };
+
+    using exception = util::as_exception<ErrorCode>;
+
+    /// Parse the contents of a `.scl` file
+    ///
+    /// Pitches are read as cents if they contain a `.`, and as ratios like `3/2` or `2`
+    /// otherwise. Lines starting with `!` are comments.
+    ///
+    /// \throws `exception` with `ErrorCode::invalid_scale`
+    static Scale from_scl(std::istream& scl);
+
+    /// \throws `exception` with `ErrorCode::file_not_found` or `ErrorCode::invalid_scale`
+    static Scale load(const filesystem::path& path);
+
+    /// The frequency ratio of `degree` to the root, for any degree, repeating every period
+    double ratio(int degree) const noexcept;
+
+    std::string description;
+    /// The frequency ratio to the root of each degree after it. The last one is the period,
+    /// usually `2`.
+    std::vector<double> ratios;
+  };
+
+  /// How a @ref Scale is laid out on the keys, as read from a Scala `.kbm` file
+  ///
+  /// The default maps consecutive keys to consecutive degrees, with the root on key 60, and
+  /// key 69 at 440 Hz.
+  struct KeyboardMapping {
+    /// Parse the contents of a `.kbm` file
+    ///
+    /// \throws `Scale::exception` with `ErrorCode::invalid_mapping`
+    static KeyboardMapping from_kbm(std::istream& kbm);
+
+    /// \throws `Scale::exception` with `ErrorCode::file_not_found` or
+    /// `ErrorCode::invalid_mapping`
+    static KeyboardMapping load(const filesystem::path& path);
+
+    /// The range of keys that are mapped
+    int first_key = 0;
+    int last_key = 127;
+    /// The key the root of the scale is mapped to
+    int middle_key = 60;
+    /// The key tuned to `reference_freq`
+    int reference_key = 69;
+    double reference_freq = 440;
+    /// The degree that `map` repeats at. Only used when `map` is not empty.
+    int octave_degree = 0;
+    /// The degree of each key from `middle_key` on, repeating, and `-1` for keys that are not
+    /// mapped. When empty, consecutive keys are mapped to consecutive degrees.
+    std::vector<int> map;
+  };
+
+  /// The frequency of each key, for `scale` laid out by `mapping`
+  ///
+  /// Keys that are not mapped get the frequency of the nearest mapped key below them, or
+  /// above them for the lowest keys.
+  ///
+  /// \throws `Scale::exception` with `ErrorCode::invalid_mapping` if the reference key is not
+  /// mapped, or the map uses degrees the scale does not have
+  FreqTable make_freq_table(const Scale& scale, const KeyboardMapping& mapping = {});
+
+  /// Load the tuning of the `.scl` file at `path`, laid out by the `.kbm` file of the same name
+  /// if there is one
+  ///
+  /// Reads files, so call it from a loader thread, like in a @ref services::AssetLoader request.
+  ///
+  /// \throws `Scale::exception`
+  std::unique_ptr<FreqTable> load_tuning(const filesystem::path& path);
+
+} // namespace otto::core::midi
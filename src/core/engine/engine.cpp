@@ -6,18 +6,18 @@ namespace otto::core::engine {
 
   // IEngine ////////////////////////////////////////////////////////////////
 
-  IEngine::IEngine(std::unique_ptr<ui::Screen> screen)
+  IEngine::IEngine(ui::LazyScreen screen)
     : _screen(std::move(screen))
   {}
 
-  ui::Screen& IEngine::screen() noexcept
+  ui::Screen& IEngine::screen()
   {
     return *_screen;
   }
 
-  ui::Screen const& IEngine::screen() const noexcept
+  void IEngine::drop_screen() noexcept
   {
-    return *_screen;
+    _screen.reset();
   }
 
   int IEngine::current_preset() const noexcept
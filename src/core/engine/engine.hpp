@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -10,9 +13,13 @@
 #include "util/exception.hpp"
 #include "util/jsonfile.hpp"
 #include "util/serialize.hpp"
+#include "util/triple_buffer.hpp"
 
 #include "core/audio/processor.hpp"
+#include "core/props/morph.hpp"
+#include "core/props/property_table.hpp"
 #include "core/props/props.hpp"
+#include "core/props/snapshot.hpp"
 #include "core/ui/screen.hpp"
 #include "core/voices/voice_manager.hpp"
 
@@ -34,11 +41,19 @@ namespace otto::core::engine {
     misc
   };
 
+  /// What the audio thread of an engine shows on its screen, like levels and phases
+  ///
+  /// An engine declares a small `MeterValues` struct, and a `Meters<MeterValues> meters`
+  /// member. The audio thread publishes a snapshot once per buffer, or whenever it changes, and
+  /// the screen draws only from `meters.read()`, never from state the audio thread writes to.
+  template<typename T>
+  using Meters = util::TripleBuffer<T>;
+
   /// Abstract base class for Engines
   ///
   /// Use this when refering to a generic engine
   struct IEngine {
-    IEngine(std::unique_ptr<ui::Screen> screen);
+    IEngine(ui::LazyScreen screen);
 
     virtual ~IEngine() = default;
 
@@ -47,9 +62,15 @@ namespace otto::core::engine {
     /// The name of this module.
     virtual util::string_ref name() const noexcept = 0;
 
-    ui::Screen& screen() noexcept;
+    /// The screen of this engine, constructed the first time it is asked for
+    ///
+    /// Only to be called from the UI thread.
+    ui::Screen& screen();
 
-    const ui::Screen& screen() const noexcept;
+    /// Destroy the screen, if it is constructed, to construct it again when it is next shown
+    ///
+    /// For engines kept around while they are not selected. The screen must not be displayed.
+    void drop_screen() noexcept;
 
     /// The currently selected preset
     ///
@@ -62,6 +83,29 @@ namespace otto::core::engine {
     /// \returns new_val
     int current_preset(int new_val) noexcept;
 
+    /* Quality */
+
+    /// The number of quality tiers of this engine
+    ///
+    /// Tier 0 is full quality, and each tier above it is cheaper. Engines without cheaper
+    /// modes have one tier.
+    virtual int quality_tiers() const noexcept
+    {
+      return 1;
+    }
+
+    /// Switch to quality tier `tier`, below @ref quality_tiers()
+    ///
+    /// Called by the engine manager on the audio thread before each buffer, with the tier
+    /// picked by the cpu governor, so it should be cheap when the tier is unchanged.
+    virtual void quality_tier(int tier) noexcept {}
+
+    /// Recompute what depends on the sample rate, after it changed to `samplerate`
+    ///
+    /// Called by the engine manager while the audio stream is stopped. Gamma objects follow
+    /// `gam::sampleRate` by themselves, so only values computed from it need updating.
+    virtual void samplerate_changed(int samplerate) {}
+
     /* Serialization */
 
     /// Serialize the engine
@@ -94,8 +138,60 @@ namespace otto::core::engine {
     /// [nlohmann::json::exception](), see it for details.
     virtual void from_json(const nlohmann::json& j) = 0;
 
+    /// Parse `j`, as returned by @ref to_json, into a snapshot of the properties of this engine
+    ///
+    /// Applying the snapshot sets the properties without parsing any json. It refers to this
+    /// engine, so it must not outlive it.
+    ///
+    /// \throws same as @ref from_json
+    virtual props::Snapshot snapshot(const nlohmann::json& j) = 0;
+
+    /// Copy the current properties of this engine into a snapshot, to @ref restore later
+    ///
+    /// Unlike @ref to_json, nothing is serialized, and numbers, bools and enums are not
+    /// allocated. The snapshot can be restored to any engine of the same type.
+    ///
+    /// \throws `util::exception` if the engine has reflected members outside itself
+    virtual props::Snapshot take_snapshot() = 0;
+
+    /// Set the properties to those of `snapshot`, as taken of an engine of the same type
+    ///
+    /// Only the properties whose values differ are set, so only their signals are emitted.
+    ///
+    /// \throws `util::exception` if the snapshot was taken of another type of engine
+    virtual void restore(const props::Snapshot& snapshot) = 0;
+
+    /// Parse `from` and `to`, as returned by @ref to_json, into a morph between them
+    ///
+    /// Like a snapshot, the morph refers to this engine, so it must not outlive it.
+    ///
+    /// \throws same as @ref from_json
+    virtual props::Morph morph(const nlohmann::json& from, const nlohmann::json& to) = 0;
+
+    /* Property access */
+
+    /// The number of numeric properties, see props::PropertyTable
+    virtual int property_count() const noexcept = 0;
+
+    /// Information on numeric property `index`
+    ///
+    /// The path of each property starts with `props/`.
+    virtual const props::PropertyInfo& property_info(int index) const noexcept = 0;
+
+    /// The index of the numeric property whose path hashes to `hash`, or -1
+    virtual int find_property(std::uint32_t hash) const noexcept = 0;
+
+    /// The index of the numeric property at `property`, or -1 if it is not one of this engine
+    virtual int find_property(const void* property) const noexcept = 0;
+
+    /// The value of numeric property `index`
+    virtual double get_property(int index) const noexcept = 0;
+
+    /// Set numeric property `index` to `value`, rounding it if it is not a float
+    virtual void set_property(int index, double value) = 0;
+
   private:
-    std::unique_ptr<ui::Screen> _screen;
+    ui::LazyScreen _screen;
     int _current_preset = -1;
   };
 
@@ -109,6 +205,20 @@ namespace otto::core::engine {
   struct ITypedEngine<EngineType::synth> : IEngine {
     using IEngine::IEngine;
     virtual audio::ProcessData<1> process(audio::ProcessData<1>) = 0;
+
+    /// Process in stereo, with the voices spread by the `spread` of the voice settings
+    ///
+    /// Synths with a voice manager override this with @ref voices::VoiceManager::process_stereo.
+    /// By default, the mono output plays on both sides.
+    virtual audio::ProcessData<2> process_stereo(audio::ProcessData<1> data)
+    {
+      auto out = process(std::move(data));
+      auto right = out.context->pool().allocate();
+      std::copy_n(out.audio.begin(), out.nframes, right.begin());
+      right.mark_silent(out.audio.is_silent());
+      return out.redirect(std::array{std::move(out.audio), std::move(right)});
+    }
+
     virtual voices::IVoiceManager& voice_mgr() = 0;
     virtual ui::Screen& envelope_screen()
     {
@@ -118,6 +228,18 @@ namespace otto::core::engine {
     {
       return voice_mgr().settings_screen();
     }
+
+    /// The cheaper tiers limit the voices to two thirds and one third
+    int quality_tiers() const noexcept override
+    {
+      return 3;
+    }
+
+    void quality_tier(int tier) noexcept override
+    {
+      auto& vm = voice_mgr();
+      vm.max_active_voices(std::max(1, vm.voice_count() * (3 - tier) / 3));
+    }
   };
 
   template<>
@@ -152,6 +274,14 @@ namespace otto::core::engine {
   template<typename Engine>
   constexpr util::string_ref name_of_engine_v = name_of_engine<Engine>::value;
 
+  /// The 32 bit FNV-1a hash of the name of an engine, to compare names as integers
+  constexpr std::uint32_t engine_name_hash(util::string_ref name) noexcept
+  {
+    std::uint32_t hash = 2166136261u;
+    for (char c : name) hash = (hash ^ std::uint8_t(c)) * 16777619u;
+    return hash;
+  }
+
   // Engine class /////////////////////////////////////////////////////////////
 
   namespace detail {
@@ -167,8 +297,55 @@ namespace otto::core::engine {
       }
       void from_json(const nlohmann::json& j) override
       {
+        props::BulkUpdate bulk;
         util::deserialize(this->derived(), j);
       }
+      props::Snapshot snapshot(const nlohmann::json& j) override
+      {
+        return props::Snapshot::capture(this->derived(), j);
+      }
+      props::Snapshot take_snapshot() override
+      {
+        return props::Snapshot::take(this->derived());
+      }
+      void restore(const props::Snapshot& snapshot) override
+      {
+        snapshot.restore(this->derived());
+      }
+      props::Morph morph(const nlohmann::json& from, const nlohmann::json& to) override
+      {
+        return props::Morph::between(this->derived(), from, to);
+      }
+
+      int property_count() const noexcept override
+      {
+        return table().size();
+      }
+      const props::PropertyInfo& property_info(int index) const noexcept override
+      {
+        return table()[index];
+      }
+      int find_property(std::uint32_t hash) const noexcept override
+      {
+        return table().find(hash);
+      }
+      int find_property(const void* property) const noexcept override
+      {
+        auto offset =
+          static_cast<const char*>(property) - reinterpret_cast<const char*>(&this->derived());
+        for (int i = 0; i < property_count(); i++) {
+          if (table()[i].offset == offset) return i;
+        }
+        return -1;
+      }
+      double get_property(int index) const noexcept override
+      {
+        return table().get(this->derived(), index);
+      }
+      void set_property(int index, double value) override
+      {
+        table().set(this->derived(), index, value);
+      }
 
       static constexpr auto reflect_name()
       {
@@ -184,6 +361,12 @@ namespace otto::core::engine {
     protected:
       using ITypedEngine<ET>::ITypedEngine;
       using util::crtp<Derived, EngineImpl<ET, Derived>>::derived;
+
+    private:
+      const props::PropertyTable<Derived>& table() const
+      {
+        return props::PropertyTable<Derived>::of(this->derived());
+      }
     };
   } // namespace detail
 
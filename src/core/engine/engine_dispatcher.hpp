@@ -1,9 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <tuple>
+
 #include <foonathan/array/flat_map.hpp>
 #include "core/engine/engine.hpp"
 #include "core/engine/nullengine.hpp"
 
+#include "util/handoff.hpp"
 #include "util/variant_w_base.hpp"
 
 namespace otto::core::engine {
@@ -16,9 +21,27 @@ namespace otto::core::engine {
     virtual int current_idx() const = 0;
     virtual IEngine& select(util::string_ref name) = 0;
     virtual IEngine& select(int index) = 0;
+    /// Construct the current engine again, with the same properties
+    ///
+    /// Clears the state of its processing, like after it has produced NaNs.
+    virtual IEngine& reset() = 0;
 
     virtual std::vector<util::string_ref> make_name_list() const = 0;
 
+    /// Morph the current engine with `morph`, made by `current().morph(...)`
+    ///
+    /// The audio thread applies the morph at the position set by @ref morph_position at the
+    /// start of each buffer, until @ref stop_morph, or another engine is selected.
+    virtual void morph(props::Morph morph) = 0;
+    /// Set the position of the morph, from 0 to 1. Safe to call from any thread.
+    virtual void morph_position(float position) noexcept = 0;
+    /// Stop morphing, leaving the properties where the morph last put them
+    virtual void stop_morph() = 0;
+    /// Call `IEngine::samplerate_changed` on every constructed engine
+    ///
+    /// Only to be called while the audio stream is stopped.
+    virtual void samplerate_changed(int samplerate) = 0;
+
     virtual ~IEngineDispatcher() = default;
 
     /// Is the engine allowed to be in an "OFF" state?
@@ -34,8 +57,47 @@ namespace otto::core::engine {
 
     static constexpr const EngineType engine_type = ET;
     using ITypedEngine = engine::ITypedEngine<ET>;
-    using variant = util::variant_w_base<ITypedEngine, Engines...>;
+    using variant = util::variant_w_base<ITypedEngine, util::monostate, Engines...>;
     using DataMap = foonathan::array::flat_map<util::string_ref, nlohmann::json>;
+    using SnapshotMap = foonathan::array::flat_map<util::string_ref, props::Snapshot>;
+
+    /// The length of the crossfade from the previous engine after @ref select
+    static constexpr int crossfade_frames = 256;
+
+    /// What is known of an engine of the dispatcher without constructing it
+    struct EngineInfo {
+      util::string_ref name;
+      /// The @ref engine_name_hash of `name`
+      std::uint32_t name_hash;
+      /// The size of the engine object itself
+      std::size_t object_size;
+      /// Construct the engine on its own, outside the dispatcher, for tools like the benchmarks
+      std::unique_ptr<ITypedEngine> (*make)();
+    };
+
+  private:
+    template<typename Engine>
+    static std::unique_ptr<ITypedEngine> make_engine()
+    {
+      return std::make_unique<Engine>();
+    }
+
+  public:
+    /// The engines, in the order of their indices
+    static constexpr std::array<EngineInfo, sizeof...(Engines)> registry = {EngineInfo{
+      name_of_engine_v<Engines>, engine_name_hash(name_of_engine_v<Engines>), sizeof(Engines), &make_engine<Engines>}...};
+
+    /// The memory used by one engine, see @ref memory_usage
+    struct EngineMemory {
+      util::string_ref name;
+      /// The size of the engine object itself
+      std::size_t object_size = 0;
+      /// The heap allocated by its constructor, the last time it was constructed, or 0
+      ///
+      /// Assets loaded in the background by the `AssetLoader` are not included.
+      std::size_t heap_size = 0;
+      bool warm = false;
+    };
 
     // Initialization
     EngineDispatcher(bool allow_off);
@@ -57,30 +119,153 @@ namespace otto::core::engine {
     ITypedEngine& select(util::string_ref name) override;
 
     /// Select engine by index
-    /// 
+    ///
+    /// The engine is constructed on the calling thread, in the storage slot the audio thread
+    /// is not using, and handed to @ref process, which switches to it at the start of the next
+    /// buffer. If the previous switch has not finished, this sleeps until it has, see
+    /// `AudioManager::wait_one`.
+    ///
     /// If `index` is < 0, and `allow_off`, select the null engine.
     /// @throws `util::exception` when `index` is out of bounds
     ITypedEngine& select(int index) override;
 
+    /// Construct the current engine again, with the same properties
+    ///
+    /// Like selecting it again, except that a warm engine is constructed again as well. The
+    /// old engine is destroyed once the audio thread has switched to the new one, which this
+    /// waits for.
+    ITypedEngine& reset() override;
+
+    /// Keep engine `index` constructed while other engines are selected
+    ///
+    /// Selecting a warm engine only restores its saved state, instead of running its
+    /// constructor again. It is constructed right away, unless it is the current engine, in
+    /// which case it is kept from the next time it is selected. An engine that is no longer
+    /// kept warm is destroyed by the first @ref select after it stops being current.
+    ///
+    /// @throws `util::exception` when `index` is out of bounds
+    void keep_warm(int index, bool warm = true);
+
+    /// Keep the engine named `name` constructed while other engines are selected
+    ///
+    /// @throws `util::exception` when no matching engine was found
+    void keep_warm(util::string_ref name, bool warm = true);
+
+    /// The memory used by each engine, to choose which ones to keep warm
+    std::vector<EngineMemory> memory_usage() const;
+
+    /// Process a buffer with the playing engine
+    ///
+    /// To be called from the audio thread, instead of `current().process(data)`. After a
+    /// switch, synths and effects are crossfaded from the previous engine over
+    /// @ref crossfade_frames frames. The previous engine gets a copy of the input, and no midi.
+    /// If the position of a morph has changed, it is applied before processing.
+    template<typename Data>
+    auto process(Data data) noexcept;
+
+    /// Process a buffer with the playing synth in stereo, see
+    /// `ITypedEngine<EngineType::synth>::process_stereo`, like @ref process
+    audio::ProcessData<2> process_stereo(audio::ProcessData<1> data) noexcept;
+
+    /// Whether a switch of engines still needs the audio thread to process a buffer
+    ///
+    /// A routing node that sleeps while silent stays awake until the switch is done, as
+    /// `select` waits for it.
+    bool switching() const noexcept
+    {
+      return _pending.load(std::memory_order_acquire) != nullptr ||
+             _fading.load(std::memory_order_acquire) != nullptr;
+    }
+
     std::vector<util::string_ref> make_name_list() const override;
 
+    void morph(props::Morph morph) override;
+    void morph_position(float position) noexcept override;
+    void stop_morph() override;
+    void samplerate_changed(int samplerate) override;
+
     /// Access the screen used to select engines/presets
     ///
-    /// The returned screen has the dynamic type [EngineSelectorScreen]()
-    /// \preconditions [init]() has previously been called
-    ui::Screen& selector_screen() noexcept;
+    /// The returned screen has the dynamic type [EngineSelectorScreen](), and is constructed
+    /// the first time it is asked for.
+    ui::Screen& selector_screen();
+
+    /// Destroy the screen of the previous engine when another is selected
+    ///
+    /// Saves the memory of the screens of warm engines, at the cost of constructing the screen
+    /// again when the engine is next shown. The screens of other engines are destroyed with
+    /// them anyway.
+    bool drop_inactive_screens = false;
 
-    const DataMap& data_of_engines() const noexcept;
+    /// The saved state of each engine that is not current, as json
+    ///
+    /// Serializes the snapshots of the engines that were switched away from.
+    DataMap data_of_engines() const;
 
     nlohmann::json to_json() const;
     void from_json(const nlohmann::json&);
 
   private:
+    /// Find the index of the engine named `name`, or -1
+    int index_of(util::string_ref name) const noexcept;
+    /// Call `f` with the `meta::one` of the type of engine `index`
+    template<typename F>
+    void visit_index(int index, F&& f) const;
+    /// Construct an engine with `construct`, and log and record the heap it allocates
+    template<typename F>
+    void measure(int index, F&& construct);
+    /// Destroy the warm engines that are no longer kept warm, and not current
+    void collect_cold();
+    /// Sleep until the audio thread has finished the last switch
+    void wait_for_switch();
+    /// Make `engine` the current engine, and hand it to the audio thread
+    void publish(ITypedEngine* engine);
+    /// Process with `render(engine, data)`, crossfading after a switch
+    template<typename Data, typename Render>
+    auto process_with(Data data, Render&& render) noexcept;
+    /// Keep the properties of `engine`, to restore when it is selected again
+    void save_state(ITypedEngine& engine);
+    /// Give `engine` the properties it had last, if any
+    void restore_state(ITypedEngine& engine);
+
+    /// The state of engines loaded from json, and not selected since
     DataMap _engine_data;
+    /// The state of engines that were switched away from
+    ///
+    /// Saved and restored without json, which makes switching back and forth cheap.
+    SnapshotMap _engine_snapshots;
     NullEngine<ET> _null_engine;
-    variant _engine_storage = util::in_place_index_t<0>();
-    ITypedEngine* _current = &_null_engine;
-    std::unique_ptr<ui::Screen> _selector_screen = nullptr;
+    /// Two slots, so the next engine can be constructed while the audio thread plays the other
+    std::array<variant, 2> _engine_storage;
+    /// The slot of the most recently selected engine
+    int _slot = 0;
+    /// The engines kept warm, which never live in `_engine_storage`
+    std::tuple<std::unique_ptr<Engines>...> _warm;
+    std::array<bool, sizeof...(Engines)> _keep_warm = {};
+    std::array<std::size_t, sizeof...(Engines)> _heap_size = {};
+    int _current_idx = -1;
+    std::atomic<ITypedEngine*> _current = &_null_engine;
+    /// The engine processed by the audio thread
+    ITypedEngine* _playing = &_null_engine;
+    /// Set by @ref publish, and taken by the audio thread at the start of a buffer
+    std::atomic<ITypedEngine*> _pending = nullptr;
+    /// The engine being faded out, until the crossfade is done
+    std::atomic<ITypedEngine*> _fading = nullptr;
+    int _fade_pos = 0;
+
+    struct ActiveMorph {
+      /// The engine the morph was made for
+      ITypedEngine* engine;
+      props::Morph morph;
+      int id;
+    };
+    util::Handoff<ActiveMorph> _morph;
+    std::atomic<float> _morph_position = 0;
+    int _morph_count = 0;
+    /// The id and position of the morph the audio thread applied last
+    int _applied_morph = -1;
+    float _applied_position = 0;
+    ui::LazyScreen _selector_screen;
   };
 } // namespace otto::core::engine
 
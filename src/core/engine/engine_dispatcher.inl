@@ -6,106 +6,334 @@
 #include "services/audio_manager.hpp"
 #include "services/engine_manager.hpp"
 #include "services/preset_manager.hpp"
+#include "util/memory_usage.hpp"
 #include "util/meta.hpp"
 #include "util/string_conversions.hpp"
 
-#include <thread>
+#include <algorithm>
+#include <chrono>
 
 namespace otto::core::engine {
 
   // EngineDispatcher Implementations /////////////////////////////////////////
   template<EngineType ET, typename... Egs>
   EngineDispatcher<ET, Egs...>::EngineDispatcher(bool allow_off)
-    : IEngineDispatcher(allow_off), _selector_screen(std::make_unique<EngineSelectorScreen>(*this))
+    : IEngineDispatcher(allow_off), _selector_screen(ui::lazy_screen<EngineSelectorScreen>(*this))
   {}
 
   template<EngineType ET, typename... Egs>
   ITypedEngine<ET>& EngineDispatcher<ET, Egs...>::current() noexcept
   {
-    return *_current;
+    return *_current.load();
   }
 
   template<EngineType ET, typename... Egs>
   int EngineDispatcher<ET, Egs...>::current_idx() const noexcept
   {
-    if (_current == &_null_engine) return -1;
-    return _engine_storage.index();
+    return _current_idx;
   }
 
   template<EngineType ET, typename... Egs>
   const ITypedEngine<ET>& EngineDispatcher<ET, Egs...>::current() const noexcept
   {
-    return *_current;
+    return *_current.load();
   }
 
 
   template<EngineType ET, typename... Egs>
   ITypedEngine<ET>* EngineDispatcher<ET, Egs...>::operator->() noexcept
   {
-    return _current;
+    return _current.load();
   }
 
   template<EngineType ET, typename... Egs>
   const ITypedEngine<ET>* EngineDispatcher<ET, Egs...>::operator->() const noexcept
   {
-    return _current;
+    return _current.load();
+  }
+
+  template<EngineType ET, typename... Egs>
+  int EngineDispatcher<ET, Egs...>::index_of(util::string_ref name) const noexcept
+  {
+    const auto hash = engine_name_hash(name);
+    for (int i = 0; i < int(registry.size()); i++) {
+      if (registry[i].name_hash == hash && registry[i].name == name) return i;
+    }
+    return -1;
+  }
+
+  template<EngineType ET, typename... Egs>
+  template<typename F>
+  void EngineDispatcher<ET, Egs...>::visit_index(int index, F&& f) const
+  {
+    meta::for_each<meta::list<Egs...>>([&, idx = 0](auto m_type) mutable {
+      if (idx++ == index) f(m_type);
+    });
+  }
+
+  template<EngineType ET, typename... Egs>
+  template<typename F>
+  void EngineDispatcher<ET, Egs...>::measure(int index, F&& construct)
+  {
+    auto before = util::heap_usage();
+    ITypedEngine& engine = construct();
+    auto after = util::heap_usage();
+    _heap_size[index] = after > before ? after - before : 0;
+    visit_index(index, [&](auto m_type) {
+      using type = decltype(m_type._t());
+      LOGI("Constructed engine '{}': {} kB object, {} kB heap{}", engine.name(),
+           sizeof(type) / 1024, _heap_size[index] / 1024, _keep_warm[index] ? ", kept warm" : "");
+    });
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::collect_cold()
+  {
+    meta::for_each<meta::list<Egs...>>([&, idx = 0](auto m_type) mutable {
+      using type = decltype(m_type._t());
+      auto& warm = std::get<std::unique_ptr<type>>(_warm);
+      if (!_keep_warm[idx] && warm && warm.get() != _current.load()) warm.reset();
+      idx++;
+    });
   }
 
   template<EngineType ET, typename... Egs>
   ITypedEngine<ET>& EngineDispatcher<ET, Egs...>::select(util::string_ref name)
   {
-    _engine_data.insert_or_replace(_current->name(), _current->to_json());
-    _current = &_null_engine;
-    if (!allow_off || util::to_lowercase(name) != "off") {
-      Application::current().audio_manager->wait_one();
-      bool done = false;
-      try {
-        meta::for_each<meta::list<Egs...>>([&](auto m_type) -> void {
-          using type = decltype(m_type._t());
-          if (!done && name_of_engine_v<type> == name) {
-            _engine_storage.template emplace<type>();
-            if (auto found = _engine_data.try_lookup(_engine_storage->name()); found)
-              _engine_storage.base()->from_json(*found);
-            done = true;
-          }
-        });
-      } catch (std::exception& e) {
-        LOGE("Error loading engine: {}", e.what());
-        done = true;
+    if (allow_off && util::to_lowercase(name) == "off") return select(-1);
+    int index = index_of(name);
+    if (index < 0) throw util::exception("Engine '{}' not found", name);
+    return select(index);
+  }
+
+  template<EngineType ET, typename... Egs>
+  ITypedEngine<ET>& EngineDispatcher<ET, Egs...>::select(int index)
+  {
+    if ((!allow_off || index >= 0) && (index < 0 || index >= int(sizeof...(Egs))))
+      throw util::exception("EngineDispatcher::select(): Idx {} out of bounds", index);
+    ITypedEngine& previous = current();
+    save_state(previous);
+    // The morph refers to the current engine. The audio thread drops it at the start of the
+    // next buffer, which `wait_for_switch` waits for before the engine could be destroyed.
+    stop_morph();
+    // Neither slot may be replaced while the audio thread is still fading out of it
+    wait_for_switch();
+    collect_cold();
+    _current_idx = -1;
+    if (index < 0) {
+      publish(&_null_engine);
+      return _null_engine;
+    }
+    // Warm engines live outside the two slots, so they are never replaced
+    const int slot = 1 - _slot;
+    auto& storage = _engine_storage[slot];
+    ITypedEngine* engine = nullptr;
+    try {
+      visit_index(index, [&](auto m_type) {
+        using type = decltype(m_type._t());
+        auto& warm = std::get<std::unique_ptr<type>>(_warm);
+        if (warm) {
+          engine = warm.get();
+        } else if (_keep_warm[index]) {
+          measure(index, [&]() -> ITypedEngine& { return *(warm = std::make_unique<type>()); });
+          engine = warm.get();
+        } else {
+          measure(index, [&]() -> ITypedEngine& { return storage.template emplace<type>(); });
+          engine = storage.base();
+          _slot = slot;
+        }
+      });
+    } catch (std::exception& e) {
+      LOGE("Error loading engine: {}", e.what());
+      storage.template emplace<util::monostate>();
+      publish(&_null_engine);
+      return _null_engine;
+    }
+    restore_state(*engine);
+    _current_idx = index;
+    publish(engine);
+    if (drop_inactive_screens && &previous != engine) previous.drop_screen();
+    return *engine;
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::save_state(ITypedEngine& engine)
+  {
+    if (&engine == &_null_engine) return;
+    try {
+      _engine_snapshots.insert_or_replace(engine.name(), engine.take_snapshot());
+      _engine_data.erase_all(engine.name());
+    } catch (std::exception& e) {
+      LOGW("Saving engine '{}' as json: {}", engine.name(), e.what());
+      _engine_snapshots.erase_all(engine.name());
+      _engine_data.insert_or_replace(engine.name(), engine.to_json());
+    }
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::restore_state(ITypedEngine& engine)
+  {
+    try {
+      if (auto found = _engine_snapshots.try_lookup(engine.name()); found) {
+        engine.restore(*found);
+      } else if (auto data = _engine_data.try_lookup(engine.name()); data) {
+        engine.from_json(*data);
       }
-      _current = _engine_storage.base();
-      if (!done) throw util::exception("Engine '{}' not found", name);
+    } catch (std::exception& e) {
+      LOGE("Error loading engine: {}", e.what());
     }
-    return *_current;
   }
 
   template<EngineType ET, typename... Egs>
-  ITypedEngine<ET>& EngineDispatcher<ET, Egs...>::select(int index)
+  ITypedEngine<ET>& EngineDispatcher<ET, Egs...>::reset()
   {
-    _engine_data.insert_or_replace(_current->name(), _current->to_json());
-    _current = &_null_engine;
-    if (!allow_off || index >= 0) {
-      Application::current().audio_manager->wait_one();
-      bool done = false;
-      try {
-        meta::for_each<meta::list<Egs...>>([&, idx = 0](auto m_type) mutable {
-          using type = decltype(m_type._t());
-          if (!done && idx == index) {
-            _engine_storage.template emplace<type>();
-            if (auto found = _engine_data.try_lookup(_engine_storage->name()); found)
-              _engine_storage.base()->from_json(*found);
-            done = true;
-          }
-          idx++;
-        });
-      } catch (std::exception& e) {
-        LOGE("Error loading engine: {}", e.what());
-        done = true;
+    const int index = _current_idx;
+    if (index < 0) return current();
+    // Taken out, so it is not selected again as it is, but kept until the audio thread is done
+    std::unique_ptr<ITypedEngine> stale;
+    visit_index(index, [&](auto m_type) {
+      using type = decltype(m_type._t());
+      stale = std::move(std::get<std::unique_ptr<type>>(_warm));
+    });
+    auto& engine = select(index);
+    wait_for_switch();
+    return engine;
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::keep_warm(int index, bool warm)
+  {
+    if (index < 0 || index >= int(sizeof...(Egs)))
+      throw util::exception("EngineDispatcher::keep_warm(): Idx {} out of bounds", index);
+    _keep_warm[index] = warm;
+    wait_for_switch();
+    collect_cold();
+    if (!warm || index == _current_idx) return;
+    try {
+      visit_index(index, [&](auto m_type) {
+        using type = decltype(m_type._t());
+        auto& ptr = std::get<std::unique_ptr<type>>(_warm);
+        if (!ptr) measure(index, [&]() -> ITypedEngine& { return *(ptr = std::make_unique<type>()); });
+      });
+    } catch (std::exception& e) {
+      LOGE("Error loading engine: {}", e.what());
+    }
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::keep_warm(util::string_ref name, bool warm)
+  {
+    int index = index_of(name);
+    if (index < 0) throw util::exception("Engine '{}' not found", name);
+    keep_warm(index, warm);
+  }
+
+  template<EngineType ET, typename... Egs>
+  auto EngineDispatcher<ET, Egs...>::memory_usage() const -> std::vector<EngineMemory>
+  {
+    std::vector<EngineMemory> res;
+    res.reserve(sizeof...(Egs));
+    for (int i = 0; i < int(registry.size()); i++) {
+      res.push_back({registry[i].name, registry[i].object_size, _heap_size[i], _keep_warm[i]});
+    }
+    return res;
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::wait_for_switch()
+  {
+    auto& audio = *Application::current().audio_manager;
+    while (_pending.load(std::memory_order_acquire) != nullptr ||
+           _fading.load(std::memory_order_acquire) != nullptr) {
+      if (!audio.running()) {
+        // The audio thread is not processing, so the switch can be finished here
+        if (auto* next = _pending.exchange(nullptr)) _playing = next;
+        _fading = nullptr;
+        return;
+      }
+      if (!audio.wait_one(std::chrono::milliseconds(100))) {
+        LOGW("Audio thread has not finished a buffer in 100ms");
       }
-      _current = _engine_storage.base();
-      if (!done) throw util::exception("EngineDispatcher::select(): Idx {} out of bounds", index);
     }
-    return *_current;
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::publish(ITypedEngine* engine)
+  {
+    _current = engine;
+    if (!Application::current().audio_manager->running()) {
+      // Nothing is playing yet, so there is nothing to fade from
+      _playing = engine;
+      _fading = nullptr;
+      return;
+    }
+    _pending.store(engine, std::memory_order_release);
+  }
+
+  template<EngineType ET, typename... Egs>
+  template<typename Data>
+  auto EngineDispatcher<ET, Egs...>::process(Data data) noexcept
+  {
+    return process_with(std::move(data),
+                        [](ITypedEngine* engine, auto data) { return engine->process(std::move(data)); });
+  }
+
+  template<EngineType ET, typename... Egs>
+  audio::ProcessData<2> EngineDispatcher<ET, Egs...>::process_stereo(audio::ProcessData<1> data) noexcept
+  {
+    static_assert(ET == EngineType::synth, "Only synths have a stereo variant of process");
+    return process_with(std::move(data),
+                        [](ITypedEngine* engine, auto data) { return engine->process_stereo(std::move(data)); });
+  }
+
+  template<EngineType ET, typename... Egs>
+  template<typename Data, typename Render>
+  auto EngineDispatcher<ET, Egs...>::process_with(Data data, Render&& render) noexcept
+  {
+    constexpr bool crossfade = ET == EngineType::synth || ET == EngineType::effect;
+    if (auto* next = _pending.load(std::memory_order_acquire); next != nullptr) {
+      // Set `_fading` before clearing `_pending`, so `select` never sees neither
+      if (crossfade && next != _playing) {
+        _fading.store(_playing, std::memory_order_relaxed);
+        _fade_pos = 0;
+      }
+      _playing = next;
+      _pending.store(nullptr, std::memory_order_release);
+    }
+    if (auto* morph = _morph.acquire(); morph != nullptr && morph->engine == _playing) {
+      float position = _morph_position.load(std::memory_order_relaxed);
+      if (morph->id != _applied_morph || position != _applied_position) {
+        morph->morph.apply(position);
+        _applied_morph = morph->id;
+        _applied_position = position;
+      }
+    }
+    if constexpr (crossfade) {
+      ITypedEngine* fading = _fading.load(std::memory_order_relaxed);
+      if (fading == nullptr) return render(_playing, std::move(data));
+
+      auto input = data.context->pool().allocate();
+      std::copy_n(data.audio.begin(), data.nframes, input.begin());
+      auto old = render(fading, audio::ProcessData<1>{input, {}, data.nframes, data.context});
+      auto res = render(_playing, std::move(data));
+
+      auto mix = [&](auto& to, const auto& from) {
+        for (int i = 0; i < res.nframes; i++) {
+          float gain = std::min(1.f, float(_fade_pos + i) / crossfade_frames);
+          to[i] = from[i] + gain * (to[i] - from[i]);
+        }
+      };
+      if constexpr (decltype(res)::channels == 1) {
+        mix(res.audio, old.audio);
+      } else {
+        for (int ch = 0; ch < 2; ch++) mix(res.audio[ch], old.audio[ch]);
+      }
+      _fade_pos += res.nframes;
+      if (_fade_pos >= crossfade_frames) _fading.store(nullptr, std::memory_order_release);
+      return res;
+    } else {
+      return render(_playing, std::move(data));
+    }
   }
 
   template<EngineType ET, typename... Egs>
@@ -113,24 +341,57 @@ namespace otto::core::engine {
   {
     std::vector<util::string_ref> res;
     res.reserve(sizeof...(Egs));
-    meta::for_each<meta::list<Egs...>>([&](auto m_type) {
-      using type = decltype(m_type._t());
-      res.emplace_back(name_of_engine_v<type>);
-    });
+    for (auto& info : registry) res.emplace_back(info.name);
     return res;
   }
 
   template<EngineType ET, typename... Egs>
-  ui::Screen& EngineDispatcher<ET, Egs...>::selector_screen() noexcept
+  void EngineDispatcher<ET, Egs...>::morph(props::Morph morph)
+  {
+    _morph.publish(
+      std::make_unique<ActiveMorph>(ActiveMorph{&current(), std::move(morph), _morph_count++}));
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::morph_position(float position) noexcept
+  {
+    _morph_position.store(std::clamp(position, 0.f, 1.f), std::memory_order_relaxed);
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::stop_morph()
+  {
+    _morph.publish(nullptr);
+  }
+
+  template<EngineType ET, typename... Egs>
+  void EngineDispatcher<ET, Egs...>::samplerate_changed(int samplerate)
+  {
+    // The engine of the other slot may still be faded out from
+    for (auto& storage : _engine_storage) {
+      if (auto* engine = storage.base(); engine) engine->samplerate_changed(samplerate);
+    }
+    std::apply([&](auto&... warm) { ((warm ? warm->samplerate_changed(samplerate) : void()), ...); }, _warm);
+  }
+
+  template<EngineType ET, typename... Egs>
+  ui::Screen& EngineDispatcher<ET, Egs...>::selector_screen()
   {
     return *_selector_screen;
   }
 
   template<EngineType ET, typename... Egs>
-  const foonathan::array::flat_map<util::string_ref, nlohmann::json>& EngineDispatcher<ET, Egs...>::data_of_engines()
-    const noexcept
+  auto EngineDispatcher<ET, Egs...>::data_of_engines() const -> DataMap
   {
-    return _engine_data;
+    DataMap res;
+    for (auto&& [key, val] : _engine_data) res.insert_or_replace(key, val);
+    for (auto&& [key, snapshot] : _engine_snapshots) {
+      visit_index(index_of(key), [&](auto m_type) {
+        using type = decltype(m_type._t());
+        res.insert_or_replace(key, snapshot.template to_json<type>());
+      });
+    }
+    return res;
   }
 
   template<EngineType ET, typename... Egs>
@@ -142,8 +403,19 @@ namespace otto::core::engine {
     for (auto&& [key, val] : _engine_data) {
       engines[std::string(key)] = val;
     }
-    if (_current != &_null_engine) engines[std::string(_current->name())] = _current->to_json();
+    for (auto&& [key, snapshot] : _engine_snapshots) {
+      visit_index(index_of(key), [&](auto m_type) {
+        using type = decltype(m_type._t());
+        engines[std::string(key)] = snapshot.template to_json<type>();
+      });
+    }
+    if (&current() != &_null_engine) engines[std::string(current().name())] = current().to_json();
     j["engines"] = engines;
+    auto warm = nlohmann::json::array();
+    for (auto& engine : memory_usage()) {
+      if (engine.warm) warm.push_back(std::string(engine.name));
+    }
+    j["keep_warm"] = warm;
     return j;
   }
 
@@ -153,7 +425,25 @@ namespace otto::core::engine {
     auto engines = j.find("engines");
     if (engines != j.end() && engines->is_object()) {
       for (auto&& [key, val] : (*engines).items()) {
-        _engine_data.insert_or_replace(key, val);
+        // Keyed by the name of the engine itself, which outlives the json
+        int index = index_of(key);
+        if (index < 0) continue;
+        visit_index(index, [&](auto m_type) {
+          using type = decltype(m_type._t());
+          _engine_snapshots.erase_all(name_of_engine_v<type>);
+          _engine_data.insert_or_replace(name_of_engine_v<type>, val);
+        });
+      }
+    }
+    auto warm = j.find("keep_warm");
+    if (warm != j.end() && warm->is_array()) {
+      for (int i = 0; i < int(sizeof...(Egs)); i++) _keep_warm[i] = false;
+      for (auto& name : *warm) {
+        try {
+          keep_warm(name.get<std::string>());
+        } catch (std::exception& e) {
+          LOGW("Could not keep engine warm: {}", e.what());
+        }
       }
     }
     select(j["current_engine"].get<std::string>());
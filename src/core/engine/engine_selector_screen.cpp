@@ -1,7 +1,12 @@
 #include "engine_selector_screen.hpp"
 
+#include <algorithm>
+
+#include <fmt/format.h>
+
 #include "core/ui/vector_graphics.hpp"
 #include "services/preset_manager.hpp"
+#include "util/algorithm.hpp"
 
 namespace otto::core::engine {
 
@@ -25,11 +30,9 @@ namespace otto::core::engine {
   {
     SelectorWidget::Options opts;
     opts.on_select = [this, sl = std::move(select_eg)](int idx) {
-      auto& eg = sl(idx);
-      try {
-        preset_wid.items(Application::current().preset_manager->preset_names(eg.name()));
-      } catch (services::PresetManager::exception& e) {
-      }
+      stop_morph();
+      sl(idx);
+      refresh_presets();
     };
     opts.item_colour = Colours::Gray50;
     opts.size = {120, 200};
@@ -40,9 +43,10 @@ namespace otto::core::engine {
     std::function<IEngine&()>&& cur_eg) noexcept
   {
     SelectorWidget::Options opts;
-    opts.on_select = [cur_eg = std::move(cur_eg)](int idx) {
+    opts.on_select = [this, cur_eg = std::move(cur_eg)](int idx) {
+      stop_morph();
       try {
-      Application::current().preset_manager->apply_preset(cur_eg(), idx);
+        Application::current().preset_manager->apply_preset_async(cur_eg(), idx);
       } catch (util::exception& e) {
         LOGE(e.what());
       }
@@ -53,15 +57,72 @@ namespace otto::core::engine {
     return opts;
   }
 
+  void EngineSelectorScreen::refresh_presets()
+  {
+    auto& preset_manager = *Application::current().preset_manager;
+    auto engine_name = _engine_dispatcher.current().name();
+    bool same_engine = engine_name == _presets_engine;
+    if (same_engine && preset_manager.revision() == _presets_revision) return;
+
+    std::string selected;
+    if (same_engine && preset_wid.selected_item() < preset_wid.nitems()) {
+      selected = preset_names[preset_wid.selected_item()];
+    }
+    try {
+      preset_names = preset_manager.preset_names(engine_name);
+    } catch (services::PresetManager::exception& e) {
+      preset_names.clear();
+    }
+    _presets_engine = std::string(engine_name);
+    _presets_revision = preset_manager.revision();
+    preset_wid.items(preset_names);
+    if (auto found = util::find(preset_names, selected); !selected.empty() && found != preset_names.end()) {
+      preset_wid.select(found - preset_names.begin(), true);
+    }
+  }
+
   void EngineSelectorScreen::encoder(EncoderEvent e)
   {
     switch (e.encoder) {
     case Encoder::blue: engine_wid.prev(e.steps); break;
     case Encoder::green: preset_wid.prev(e.steps); break;
+    case Encoder::yellow: morph(e.steps); break;
     default:;
     }
   }
 
+  void EngineSelectorScreen::morph(int steps)
+  {
+    auto& engine = _engine_dispatcher.current();
+    if (_morph_to < 0) {
+      auto& preset_manager = *Application::current().preset_manager;
+      int from = engine.current_preset();
+      refresh_presets();
+      auto& names = preset_names;
+      int count = names.size();
+      if (from < 0 || from >= count || count < 2) return;
+      int to = (from + 1) % count;
+      try {
+        _engine_dispatcher.morph(preset_manager.make_morph(engine, from, to));
+      } catch (util::exception& e) {
+        LOGE(e.what());
+        return;
+      }
+      _morph_to = to;
+      _morph_name = names[to];
+      _morph_position = 0;
+    }
+    _morph_position = std::clamp(_morph_position + steps * morph_step, 0.f, 1.f);
+    _engine_dispatcher.morph_position(_morph_position);
+  }
+
+  void EngineSelectorScreen::stop_morph()
+  {
+    if (_morph_to < 0) return;
+    _engine_dispatcher.stop_morph();
+    _morph_to = -1;
+  }
+
   bool EngineSelectorScreen::keypress(Key key)
   {
     switch (key) {
@@ -72,7 +133,7 @@ namespace otto::core::engine {
       std::string name = "Preset" + std::to_string(preset_wid.nitems() + 1);
       Application::current().preset_manager->create_preset(
         _engine_dispatcher.current().name(), name, _engine_dispatcher.current().to_json());
-      preset_wid.items(Application::current().preset_manager->preset_names(_engine_dispatcher.current().name()));
+      refresh_presets();
       preset_wid.select(preset_wid.nitems() - 1, true);
       break;
     }
@@ -83,8 +144,19 @@ namespace otto::core::engine {
 
   void EngineSelectorScreen::draw(vg::Canvas& ctx)
   {
+    // Picks up presets that were reloaded from disk
+    refresh_presets();
     ctx.drawAt({10, 0}, engine_wid);
     ctx.drawAt({160, 0}, preset_wid);
+    if (_morph_to >= 0) {
+      ctx.group([&] {
+        ctx.font(Fonts::Norm, 20);
+        ctx.fillStyle(Colours::Yellow);
+        ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+        ctx.fillText(fmt::format("morph to {}: {:.0f}%", _morph_name, _morph_position * 100),
+                     {160, 225});
+      });
+    }
   }
 
   void EngineSelectorScreen::on_show()
@@ -92,6 +164,9 @@ namespace otto::core::engine {
     if (_on_show) _on_show();
   }
 
-  void EngineSelectorScreen::on_hide() {}
+  void EngineSelectorScreen::on_hide()
+  {
+    stop_morph();
+  }
 
 } // namespace otto::core::engine
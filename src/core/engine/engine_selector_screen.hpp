@@ -22,12 +22,32 @@ namespace otto::core::engine {
 
   private:
     std::vector<std::string> engine_names;
+    /// A copy of the preset names of the current engine, so the preset widget does not point
+    /// into the preset manager, whose lists move when presets of another engine are added
     std::vector<std::string> preset_names;
+    /// The engine and `PresetManager::revision` that `preset_names` were copied for
+    std::string _presets_engine;
+    std::uint64_t _presets_revision = 0;
+    /// Copy the preset names again if the engine or the presets changed
+    ///
+    /// The selected preset stays selected if the engine is the same.
+    void refresh_presets();
+
     ui::SelectorWidget engine_wid;
     ui::SelectorWidget preset_wid;
 
     std::function<void()> _on_show = nullptr;
 
+    /// The position of the morph changed by one step of the yellow encoder
+    static constexpr float morph_step = 0.02;
+    /// Morph from the current preset towards the next one, or start doing so
+    void morph(int steps);
+    void stop_morph();
+    /// The preset being morphed to, or -1
+    int _morph_to = -1;
+    std::string _morph_name;
+    float _morph_position = 0;
+
     ///Owner
     IEngineDispatcher& _engine_dispatcher;
 
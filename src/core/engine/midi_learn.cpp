@@ -0,0 +1,213 @@
+#include "midi_learn.hpp"
+
+#include <cmath>
+
+#include "services/log_manager.hpp"
+#include "util/algorithm.hpp"
+
+namespace otto::core::engine {
+
+  MidiLearn::MidiLearn(std::vector<std::string> parts) : parts(std::move(parts))
+  {
+    publish();
+  }
+
+  void MidiLearn::map(int channel, int cc, int part, std::string path)
+  {
+    if (channel < 0 || channel >= channel_count || cc < 0 || cc >= controller_count)
+      throw util::exception("MidiLearn::map(): No controller {} on channel {}", cc, channel);
+    if (part < 0 || part >= int(parts.size()))
+      throw util::exception("MidiLearn::map(): Part {} out of bounds", part);
+    // A property follows one controller at a time
+    for (auto& mapping : _table) {
+      if (mapping.part == part && mapping.path == path) mapping = {};
+    }
+    auto hash = props::hash_path(path);
+    _table[channel * controller_count + cc] = {part, hash, std::move(path)};
+    publish();
+  }
+
+  void MidiLearn::unmap(int channel, int cc)
+  {
+    if (channel < 0 || channel >= channel_count || cc < 0 || cc >= controller_count) return;
+    _table[channel * controller_count + cc] = {};
+    publish();
+  }
+
+  void MidiLearn::clear()
+  {
+    _table.fill({});
+    publish();
+  }
+
+  const MidiLearn::Mapping& MidiLearn::mapping(int channel, int cc) const noexcept
+  {
+    return _table[channel * controller_count + cc];
+  }
+
+  void MidiLearn::learn(int part, std::string path)
+  {
+    _last_controller.store(-1, std::memory_order_relaxed);
+    _learning = {part, props::hash_path(path), std::move(path)};
+  }
+
+  void MidiLearn::cancel_learn() noexcept
+  {
+    _learning.part = -1;
+  }
+
+  bool MidiLearn::learning() const noexcept
+  {
+    return _learning.part >= 0;
+  }
+
+  bool MidiLearn::update()
+  {
+    _published.collect();
+    if (!learning()) return false;
+    int controller = _last_controller.exchange(-1, std::memory_order_relaxed);
+    if (controller < 0) return false;
+    int channel = controller / controller_count;
+    int cc = controller % controller_count;
+    LOGI("Mapped controller {} on channel {} to {} of {}", cc, channel, _learning.path,
+         parts[_learning.part]);
+    map(channel, cc, _learning.part, std::move(_learning.path));
+    cancel_learn();
+    return true;
+  }
+
+  nlohmann::json MidiLearn::to_json() const
+  {
+    auto res = nlohmann::json::array();
+    for (int i = 0; i < int(_table.size()); i++) {
+      auto& mapping = _table[i];
+      if (mapping.part < 0) continue;
+      res.push_back({{"channel", i / controller_count},
+                     {"cc", i % controller_count},
+                     {"part", parts[mapping.part]},
+                     {"property", mapping.path}});
+    }
+    return res;
+  }
+
+  void MidiLearn::from_json(const nlohmann::json& j)
+  {
+    _table.fill({});
+    if (j.is_array()) {
+      for (auto& entry : j) {
+        auto part = util::find(parts, entry.value("part", std::string()));
+        int channel = entry.value("channel", -1);
+        int cc = entry.value("cc", -1);
+        if (part == parts.end() || channel < 0 || channel >= channel_count || cc < 0 ||
+            cc >= controller_count) {
+          LOGW("Ignoring invalid midi mapping: {}", entry);
+          continue;
+        }
+        auto path = entry.value("property", std::string());
+        _table[channel * controller_count + cc] = {int(part - parts.begin()),
+                                                   props::hash_path(path), path};
+      }
+    }
+    publish();
+  }
+
+  void MidiLearn::publish()
+  {
+    _published.publish(std::make_unique<Table>(_table));
+  }
+
+  bool MidiLearn::resolve(Target& target, IEngine* engine, const Mapping& mapping) noexcept
+  {
+    if (engine == nullptr) return false;
+    // The engine may have been replaced by another one at the same address, so the hash of
+    // the cached index is checked too
+    if (target.engine != engine || target.index < 0 ||
+        target.index >= engine->property_count() ||
+        engine->property_info(target.index).hash != mapping.hash) {
+      target.engine = engine;
+      target.index = engine->find_property(mapping.hash);
+    }
+    return target.index >= 0;
+  }
+
+  void MidiLearn::process(midi::MidiBufferRef midi,
+                          gsl::span<IEngine* const> engines,
+                          int nframes,
+                          int samplerate) noexcept
+  {
+    Table* table = _published.acquire();
+    if (table == nullptr) return;
+
+    for (auto& event : midi) {
+      if (event.type() != midi::MidiEvent::Type::ControlChange) continue;
+      auto cc = event.control_change();
+      if (cc.controler < 0 || cc.controler >= controller_count) continue;
+      int idx = event.channel() * controller_count + cc.controler;
+      _last_controller.store(idx, std::memory_order_relaxed);
+
+      auto& mapping = (*table)[idx];
+      if (mapping.part < 0 || mapping.part >= int(engines.size())) continue;
+      auto& target = _targets[idx];
+      IEngine* engine = engines[mapping.part];
+      if (!resolve(target, engine, mapping)) continue;
+
+      auto& info = engine->property_info(target.index);
+      double pos = cc.value / double(controller_count - 1);
+      double min = info.min;
+      double max = info.max;
+      // Properties without sensible limits are mapped to 0 - 1, or to the raw value for
+      // integers
+      if (max - min > 1e6) {
+        min = 0;
+        max = info.kind == props::PropertyKind::floating ? 1 : controller_count - 1;
+      }
+      double value = min + pos * (max - min);
+      if (!info.values.empty()) {
+        // Not every integer in the limits of an enum is one of its values, so the controller
+        // is spread over the values instead
+        value = info.values[std::lround(pos * (info.values.size() - 1))];
+      }
+      if (info.kind != props::PropertyKind::floating) {
+        engine->set_property(target.index, info.nearest(value));
+        continue;
+      }
+      target.target = value;
+      target.range = max - min;
+      if (util::find(_smoothing, idx) != _smoothing.end()) continue;
+      if (_smoothing.size() == _smoothing.capacity()) {
+        engine->set_property(target.index, value);
+        continue;
+      }
+      target.value = engine->get_property(target.index);
+      _smoothing.push_back(idx);
+    }
+
+    if (_smoothing.empty()) return;
+    const double coefficient = 1 - std::exp(-nframes / (smoothing_time * samplerate));
+    for (std::size_t i = 0; i < _smoothing.size();) {
+      int idx = _smoothing[i];
+      auto& target = _targets[idx];
+      auto& mapping = (*table)[idx];
+      IEngine* engine = mapping.part >= 0 && mapping.part < int(engines.size())
+                          ? engines[mapping.part]
+                          : nullptr;
+      bool done = !resolve(target, engine, mapping);
+      if (!done) {
+        target.value += (target.target - target.value) * coefficient;
+        // Stop at a thousandth of the range
+        if (std::abs(target.target - target.value) * 1000 <= target.range) {
+          target.value = target.target;
+          done = true;
+        }
+        engine->set_property(target.index, target.value);
+      }
+      if (done) {
+        _smoothing[i] = _smoothing.back();
+        _smoothing.pop_back();
+      } else {
+        i++;
+      }
+    }
+  }
+
+} // namespace otto::core::engine
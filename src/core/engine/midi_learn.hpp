@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gsl/span>
+#include <json.hpp>
+
+#include "core/audio/midi.hpp"
+#include "core/engine/engine.hpp"
+#include "util/handoff.hpp"
+#include "util/local_vector.hpp"
+
+namespace otto::core::engine {
+
+  /// Maps midi control changes to numeric properties of engines
+  ///
+  /// Each of the 16 channels has a table of 128 mappings, indexed by controller number, so
+  /// looking one up in @ref process is a single array access. A mapping names a part, i.e. one
+  /// of the engines passed to @ref process, and the hash of the path of a property in its
+  /// `props::PropertyTable`, so it keeps working when another engine with the same property
+  /// is selected.
+  ///
+  /// The mappings are edited on the UI thread, and handed to the audio thread with a
+  /// `util::Handoff`. Float properties glide to the values of the controller over
+  /// @ref smoothing_time, others are set right away.
+  struct MidiLearn {
+    static constexpr int channel_count = 16;
+    static constexpr int controller_count = 128;
+    /// The time constant of the smoothing of float properties, in seconds
+    static constexpr float smoothing_time = 0.02;
+    /// The maximum number of properties gliding at the same time. Further ones are set
+    /// right away.
+    static constexpr std::size_t max_smoothed = 32;
+
+    struct Mapping {
+      /// The index of the engine in @ref parts, or -1 if unmapped
+      int part = -1;
+      std::uint32_t hash = 0;
+      /// The path of the property, to store in the state
+      std::string path;
+    };
+
+    /// `parts` are the names of the engines passed to @ref process, in that order
+    MidiLearn(std::vector<std::string> parts);
+
+    /// Map controller `cc` on `channel` to the property at `path` of part `part`
+    void map(int channel, int cc, int part, std::string path);
+    void unmap(int channel, int cc);
+    void clear();
+
+    const Mapping& mapping(int channel, int cc) const noexcept;
+
+    /// Map the next controller that changes to the property at `path` of part `part`
+    void learn(int part, std::string path);
+    void cancel_learn() noexcept;
+    bool learning() const noexcept;
+
+    /// Finish learning, if a controller has changed since @ref learn
+    ///
+    /// To be called regularly from the UI thread.
+    /// \returns whether a mapping was made
+    bool update();
+
+    /// `[{"channel": 0, "cc": 0, "part": "<name>", "property": "<path>"}, ...]`
+    nlohmann::json to_json() const;
+    void from_json(const nlohmann::json& j);
+
+    /// Apply the control changes in `midi` to `engines`, and glide the smoothed properties
+    ///
+    /// To be called from the audio thread for every buffer. `engines` are the current engines
+    /// of each part.
+    void process(midi::MidiBufferRef midi,
+                 gsl::span<IEngine* const> engines,
+                 int nframes,
+                 int samplerate) noexcept;
+
+    const std::vector<std::string> parts;
+
+  private:
+    using Table = std::array<Mapping, channel_count * controller_count>;
+
+    struct Target {
+      IEngine* engine = nullptr;
+      int index = -1;
+      double value = 0;
+      double target = 0;
+      /// The range the controller is mapped to
+      double range = 1;
+    };
+
+    /// Resolve `mapping` to the property of `engine`, using the cache in `target`
+    static bool resolve(Target& target, IEngine* engine, const Mapping& mapping) noexcept;
+    void publish();
+
+    /// The mappings, as edited on the UI thread
+    Table _table;
+    util::Handoff<Table> _published;
+    Mapping _learning;
+    /// The channel and controller of the control change seen last by the audio thread, or -1
+    std::atomic<int> _last_controller = -1;
+
+    // Only used by the audio thread
+    std::array<Target, channel_count * controller_count> _targets;
+    util::local_vector<int, max_smoothed> _smoothing;
+  };
+
+} // namespace otto::core::engine
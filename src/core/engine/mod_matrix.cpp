@@ -0,0 +1,146 @@
+#include "mod_matrix.hpp"
+
+#include <algorithm>
+
+#include "services/log_manager.hpp"
+#include "util/algorithm.hpp"
+
+namespace otto::core::engine {
+
+  ModMatrix::ModMatrix(IEngine& engine, std::vector<std::string> sources)
+    : sources(std::move(sources)), _engine(engine), _values(this->sources.size(), 0.f)
+  {
+    publish();
+  }
+
+  void ModMatrix::route(int source, std::string path, float depth)
+  {
+    if (source < 0 || source >= int(sources.size()))
+      throw util::exception("ModMatrix::route(): Source {} out of bounds", source);
+    auto iter = std::find_if(_routes.begin(), _routes.end(),
+                             [&](auto& r) { return r.source == source && r.path == path; });
+    if (depth == 0) {
+      if (iter != _routes.end()) _routes.erase(iter);
+    } else if (iter != _routes.end()) {
+      iter->depth = depth;
+    } else {
+      if (_routes.size() == max_routes)
+        throw util::exception("ModMatrix::route(): No more than {} routes", max_routes);
+      auto hash = props::hash_path(path);
+      _routes.push_back({source, hash, std::move(path), depth});
+    }
+    publish();
+  }
+
+  void ModMatrix::clear()
+  {
+    _routes.clear();
+    publish();
+  }
+
+  auto ModMatrix::routes() const noexcept -> const std::vector<Route>&
+  {
+    return _routes;
+  }
+
+  nlohmann::json ModMatrix::to_json() const
+  {
+    auto res = nlohmann::json::array();
+    for (auto& route : _routes) {
+      res.push_back(
+        {{"source", sources[route.source]}, {"property", route.path}, {"depth", route.depth}});
+    }
+    return res;
+  }
+
+  void ModMatrix::from_json(const nlohmann::json& j)
+  {
+    _routes.clear();
+    if (j.is_array()) {
+      for (auto& entry : j) {
+        auto source = util::find(sources, entry.value("source", std::string()));
+        float depth = entry.value("depth", 0.f);
+        if (source == sources.end() || depth == 0 || _routes.size() == max_routes) {
+          LOGW("Ignoring invalid modulation route: {}", entry);
+          continue;
+        }
+        auto path = entry.value("property", std::string());
+        _routes.push_back({int(source - sources.begin()), props::hash_path(path), path, depth});
+      }
+    }
+    publish();
+  }
+
+  void ModMatrix::publish()
+  {
+    _published.collect();
+    _published.publish(std::make_unique<std::vector<Route>>(_routes));
+  }
+
+  void ModMatrix::source(int index, float value) noexcept
+  {
+    _values[index] = value;
+  }
+
+  void ModMatrix::retarget(const std::vector<Route>& routes) noexcept
+  {
+    // Leave the properties that are no longer routed at their centre
+    for (auto& target : _targets) {
+      bool routed = std::any_of(routes.begin(), routes.end(), [&](auto& r) {
+        return _engine.find_property(r.hash) == target.index;
+      });
+      if (!routed && _engine.get_property(target.index) == target.written) {
+        _engine.set_property(target.index, target.centre);
+      }
+    }
+
+    util::local_vector<Target, max_routes> targets;
+    for (std::size_t i = 0; i < routes.size(); i++) {
+      _route_targets[i] = -1;
+      int index = _engine.find_property(routes[i].hash);
+      if (index < 0 || _engine.property_info(index).kind != props::PropertyKind::floating) continue;
+      auto same = [&](auto& t) { return t.index == index; };
+      auto iter = std::find_if(targets.begin(), targets.end(), same);
+      if (iter == targets.end()) {
+        // Keep the centre of properties that were routed before
+        auto old = std::find_if(_targets.begin(), _targets.end(), same);
+        if (old != _targets.end()) {
+          targets.push_back(*old);
+        } else {
+          double value = _engine.get_property(index);
+          targets.push_back({index, value, value});
+        }
+        iter = targets.end() - 1;
+      }
+      _route_targets[i] = iter - targets.begin();
+    }
+    _targets = targets;
+  }
+
+  void ModMatrix::apply() noexcept
+  {
+    auto* previous = _published.get();
+    auto* routes = _published.acquire();
+    if (routes == nullptr) return;
+    if (routes != previous) retarget(*routes);
+
+    for (auto& target : _targets) target.offset = 0;
+    for (std::size_t i = 0; i < routes->size(); i++) {
+      auto& route = (*routes)[i];
+      if (_route_targets[i] < 0) continue;
+      _targets[_route_targets[i]].offset += route.depth * _values[route.source];
+    }
+    for (auto& target : _targets) {
+      // Changed by someone else since the last period
+      double current = _engine.get_property(target.index);
+      if (current != target.written) target.centre = current;
+      auto& info = _engine.property_info(target.index);
+      // Properties without sensible limits are modulated by the range 0 - 1, like in MidiLearn
+      double range = info.max - info.min > 1e6 ? 1 : info.max - info.min;
+      double value = target.centre + target.offset * range;
+      _engine.set_property(target.index, std::clamp(value, info.min, info.max));
+      target.written = _engine.get_property(target.index);
+    }
+  }
+
+} // namespace otto::core::engine
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "core/engine/engine.hpp"
+#include "util/handoff.hpp"
+#include "util/local_vector.hpp"
+
+namespace otto::core::engine {
+
+  /// Routes the modulation sources of an engine, like its LFOs, to its float properties
+  ///
+  /// The engine sets the value of each source, from -1 to 1, with @ref source, and calls
+  /// @ref apply once per control period, see `dsp::control_period`. A route moves its property
+  /// away from its centre by `depth` times the source, in the range of the property. The
+  /// centre is the value the property had when it was routed, and follows changes made by
+  /// others, like the encoders or midi learn. Several routes to the same property add up.
+  ///
+  /// Like in @ref MidiLearn, a route names the property by the hash of its path, and the
+  /// routes are edited on the UI thread, and handed to the audio thread with a
+  /// `util::Handoff`.
+  struct ModMatrix {
+    /// The most routes
+    static constexpr std::size_t max_routes = 16;
+
+    struct Route {
+      /// The index of the source in @ref sources
+      int source = 0;
+      std::uint32_t hash = 0;
+      /// The path of the property, to store in the state
+      std::string path;
+      /// The part of the range of the property the source moves it, either way
+      float depth = 0;
+    };
+
+    /// `sources` are the names of the sources of `engine`, in the order of their indices
+    ModMatrix(IEngine& engine, std::vector<std::string> sources);
+
+    /// Route source `source` to the property at `path`, replacing the route between them if
+    /// there is one. A depth of 0 removes the route.
+    ///
+    /// \throws `util::exception` if there is no source `source`, or already @ref max_routes
+    void route(int source, std::string path, float depth);
+    void clear();
+
+    const std::vector<Route>& routes() const noexcept;
+
+    /// `[{"source": "<name>", "property": "<path>", "depth": 0.5}, ...]`
+    nlohmann::json to_json() const;
+    void from_json(const nlohmann::json& j);
+
+    /// Set the value of source `index`, from -1 to 1
+    ///
+    /// Only to be called from the audio thread.
+    void source(int index, float value) noexcept;
+
+    /// Set the routed properties from the sources
+    ///
+    /// To be called from the audio thread, once per control period. The UI thread may set the
+    /// routed properties meanwhile, which moves their centre.
+    void apply() noexcept;
+
+    const std::vector<std::string> sources;
+
+  private:
+    struct Target {
+      /// The index of the property in the engine
+      int index = -1;
+      /// The value of the property without modulation
+      double centre = 0;
+      /// The value last set by @ref apply, to notice changes made by others
+      double written = 0;
+      double offset = 0;
+    };
+
+    void publish();
+    /// Resolve the properties of newly published `routes`, and set the ones no longer routed
+    /// to their centre
+    void retarget(const std::vector<Route>& routes) noexcept;
+
+    IEngine& _engine;
+
+    /// The routes, as edited on the UI thread
+    std::vector<Route> _routes;
+    util::Handoff<std::vector<Route>> _published;
+
+    // Only used by the audio thread
+    std::vector<float> _values;
+    util::local_vector<Target, max_routes> _targets;
+    /// The index in `_targets` of each route, or -1 if its property was not found
+    std::array<int, max_routes> _route_targets = {};
+  };
+
+} // namespace otto::core::engine
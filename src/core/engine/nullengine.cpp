@@ -10,17 +10,17 @@ namespace otto::core::engine {
   };
 
   NullEngine<EngineType::effect>::NullEngine()
-    : EffectEngine<NullEngine<EngineType::effect>>(std::make_unique<OffScreen>())
+    : EffectEngine<NullEngine<EngineType::effect>>(ui::lazy_screen<OffScreen>())
   {}
 
   audio::ProcessData<2> NullEngine<EngineType::effect>::process(audio::ProcessData<1> data) noexcept
   {
-    auto out = Application::current().audio_manager->buffer_pool().allocate_multi_clear<2>();
-    return data.redirect(out);
+    auto out = data.context->pool().allocate_multi_clear<2>();
+    return data.redirect(std::move(out));
   }
 
   NullEngine<EngineType::arpeggiator>::NullEngine()
-    : ArpeggiatorEngine<NullEngine<EngineType::arpeggiator>>(std::make_unique<OffScreen>())
+    : ArpeggiatorEngine<NullEngine<EngineType::arpeggiator>>(ui::lazy_screen<OffScreen>())
   {}
 
   audio::ProcessData<0> NullEngine<EngineType::arpeggiator>::process(
@@ -30,12 +30,12 @@ namespace otto::core::engine {
   }
 
   NullEngine<EngineType::synth>::NullEngine()
-    : SynthEngine<NullEngine<EngineType::synth>>(std::make_unique<OffScreen>())
+    : SynthEngine<NullEngine<EngineType::synth>>(ui::lazy_screen<OffScreen>())
   {}
 
   audio::ProcessData<1> NullEngine<EngineType::synth>::process(audio::ProcessData<1> data) noexcept
   {
-    return Application::current().audio_manager->buffer_pool().allocate_clear();
+    return data.redirect(data.context->pool().allocate_clear());
   }
 
   void OffScreen::draw(ui::vg::Canvas& ctx)
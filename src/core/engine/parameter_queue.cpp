@@ -0,0 +1,56 @@
+#include "parameter_queue.hpp"
+
+#include <algorithm>
+
+#include "core/engine/engine.hpp"
+
+namespace otto::core::engine {
+
+  ParameterQueue::ParameterQueue(std::vector<std::string> parts) : parts(std::move(parts)) {}
+
+  int ParameterQueue::find_part(std::string_view name) const noexcept
+  {
+    auto found = std::find(parts.begin(), parts.end(), name);
+    return found == parts.end() ? -1 : found - parts.begin();
+  }
+
+  bool ParameterQueue::push(gsl::span<const Change> changes) noexcept
+  {
+    _batch.clear();
+    for (auto& change : changes) {
+      auto same = std::find_if(_batch.begin(), _batch.end(), [&](const Change& c) {
+        return c.part == change.part && c.hash == change.hash;
+      });
+      if (same != _batch.end()) {
+        same->value = change.value;
+      } else if (_batch.size() < _batch.capacity()) {
+        _batch.push_back(change);
+      }
+    }
+    // All or nothing, so a batch is never applied in part
+    if (_queue.write_available() < _batch.size()) {
+      _dropped++;
+      return false;
+    }
+    _queue.write(&*_batch.begin(), _batch.size());
+    return true;
+  }
+
+  void ParameterQueue::process(gsl::span<IEngine* const> engines) noexcept
+  {
+    auto n = _queue.read(_taken.data(), _taken.size());
+    for (std::size_t i = 0; i < n; i++) {
+      auto& change = _taken[i];
+      // Only the last value sent in this buffer is set
+      bool replaced = std::any_of(_taken.begin() + i + 1, _taken.begin() + n, [&](const Change& c) {
+        return c.part == change.part && c.hash == change.hash;
+      });
+      if (replaced || change.part < 0 || change.part >= int(engines.size())) continue;
+      auto* engine = engines[change.part];
+      int index = engine->find_property(change.hash);
+      if (index < 0) continue;
+      engine->set_property(index, engine->property_info(index).nearest(change.value));
+    }
+  }
+
+} // namespace otto::core::engine
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/span>
+
+#include "util/local_vector.hpp"
+#include "util/spsc_ring.hpp"
+
+namespace otto::core::engine {
+
+  struct IEngine;
+
+  /// Hands changes of numeric properties of engines from another thread to the audio thread
+  ///
+  /// For remote control, like @ref services::OscServer. Like in @ref MidiLearn, a change names
+  /// a part, i.e. one of the engines passed to @ref process, and the hash of the path of a
+  /// property in its `props::PropertyTable`.
+  ///
+  /// The producer pushes the changes of a message or bundle as one batch, in which each property
+  /// appears once, with a single write to the ring. The audio thread applies everything queued
+  /// at the start of each buffer, setting each property once, to the last value it was sent,
+  /// however many batches changed it. There may be only one producer thread.
+  struct ParameterQueue {
+    struct Change {
+      int part = -1;
+      std::uint32_t hash = 0;
+      double value = 0;
+    };
+
+    static constexpr std::size_t capacity = 1024;
+    /// The most changes taken from the queue in one buffer. Further ones wait for the next.
+    static constexpr std::size_t max_changes_per_buffer = 256;
+
+    /// `parts` are the names of the engines passed to @ref process, in that order
+    ParameterQueue(std::vector<std::string> parts);
+
+    /// The index of the part named `name`, or -1
+    int find_part(std::string_view name) const noexcept;
+
+    /// Queue `changes` as one batch
+    ///
+    /// Later changes of a property in `changes` replace earlier ones. Only to be called from
+    /// the producer thread.
+    /// \returns `false` if the queue is full, and the batch was dropped
+    bool push(gsl::span<const Change> changes) noexcept;
+
+    /// Apply the queued changes to `engines`, the current engines of each part
+    ///
+    /// Values are set to the nearest value each property can have, see
+    /// `props::PropertyInfo::nearest`. Changes of properties the current engine of their part
+    /// does not have are ignored. To be called from the audio thread for every buffer, while
+    /// the UI thread may set the same properties.
+    void process(gsl::span<IEngine* const> engines) noexcept;
+
+    /// The number of batches dropped because the queue was full. May be read from any thread.
+    int dropped_count() const noexcept
+    {
+      return _dropped;
+    }
+
+    const std::vector<std::string> parts;
+
+  private:
+    util::SPSCRing<Change, capacity> _queue;
+    std::atomic_int _dropped = 0;
+    /// Only used by the producer
+    util::local_vector<Change, capacity> _batch;
+    /// Only used by the audio thread
+    std::array<Change, max_changes_per_buffer> _taken;
+  };
+
+} // namespace otto::core::engine
@@ -0,0 +1,445 @@
+#include "routing_graph.hpp"
+
+#include <algorithm>
+
+#include "services/log_manager.hpp"
+#include "util/audio.hpp"
+
+namespace otto::core::engine {
+
+  // Plan /////////////////////////////////////////////////////////////////////
+
+  /// The compiled graph. Steps are the nodes in topological order, with all edges resolved to
+  /// step indices.
+  struct RoutingGraph::Plan {
+    /// An output channel of a step
+    struct Source {
+      int step;
+      int channel;
+    };
+
+    struct Step {
+      const Node* node = nullptr;
+      /// The sources of each input channel
+      std::array<std::vector<Source>, max_channels> inputs;
+      /// The number of inputs reading each output channel
+      std::array<int, max_channels> consumers = {};
+      /// The number of inputs that have not yet read each output channel in this buffer
+      std::array<std::atomic_int, max_channels> remaining;
+      /// The events the node reads, if it does not read all or none of them
+      std::unique_ptr<midi::MidiBuffer> midi;
+      midi::MidiBufferRef midi_ref;
+      NodeData data;
+    };
+
+    Plan(audio::AudioBufferPool& pool, int size, const RoutingGraph& graph)
+      : pool(pool), steps(size), graph(graph)
+    {}
+
+    /// Gather the inputs of a step, and process it unless it is asleep
+    void run_step(int index) noexcept;
+
+    audio::AudioBufferPool& pool;
+    std::vector<Step> steps;
+    const RoutingGraph& graph;
+    util::TaskGraph tasks;
+    /// The next plan in the list of retired plans
+    Plan* next_retired = nullptr;
+
+  private:
+    /// Run the processor of `step` on its gathered inputs, and check its outputs
+    void process_node(Step& step) noexcept;
+
+    /// Fault `node`, unless it already is
+    static void fault(const Node& node, Fault fault) noexcept
+    {
+      auto none = Fault::none;
+      node.fault.compare_exchange_strong(none, fault, std::memory_order_acq_rel);
+    }
+
+    std::optional<audio::AudioBufferHandle>& output_of(Source src) noexcept
+    {
+      return steps[src.step].data.outputs[src.channel];
+    }
+
+    /// Called by each input after reading `src`. The last one releases the buffer.
+    void release(Source src) noexcept
+    {
+      if (steps[src.step].remaining[src.channel].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        output_of(src).reset();
+      }
+    }
+  };
+
+  void RoutingGraph::Plan::run_step(int index) noexcept
+  {
+    auto& step = steps[index];
+    auto& data = step.data;
+    auto& node = *step.node;
+    for (int ch = 0; ch < node.inputs; ch++) {
+      auto& sources = step.inputs[ch];
+      if (sources.size() == 1 && steps[sources[0].step].consumers[sources[0].channel] == 1 &&
+          output_of(sources[0])) {
+        // The only reader of a single source can take the buffer as is
+        data.inputs[ch] = std::move(output_of(sources[0]));
+        output_of(sources[0]).reset();
+        continue;
+      }
+      auto& input = data.inputs[ch].emplace(pool.allocate_clear());
+      bool silent = true;
+      for (auto& src : sources) {
+        // Empty and silent outputs add nothing
+        if (auto& output = output_of(src); output && !output->is_silent()) {
+          util::audio::kernels().add(output->data(), input.data(), data.nframes);
+          silent = false;
+        }
+        release(src);
+      }
+      input.mark_silent(silent);
+    }
+
+    // A sleeping node is not processed at all, and leaves its outputs empty
+    bool sleeping = false;
+    bool quiet_input = false;
+    if (node.sleep_after > 0) {
+      quiet_input = true;
+      for (int ch = 0; ch < node.inputs && quiet_input; ch++) {
+        auto& input = *data.inputs[ch];
+        quiet_input = input.is_silent() || util::audio::kernels().peak(input.data(), data.nframes) < silence_threshold;
+      }
+      sleeping = quiet_input && node.quiet_frames >= node.sleep_after && !(node.keep_awake && node.keep_awake());
+    }
+    node.asleep.store(sleeping, std::memory_order_relaxed);
+    if (!sleeping) process_node(step);
+
+    if (node.sleep_after > 0 && !sleeping) {
+      bool quiet = quiet_input;
+      for (int ch = 0; ch < node.outputs && quiet; ch++) {
+        if (auto& output = data.outputs[ch]; output && !output->is_silent()) {
+          quiet = util::audio::kernels().peak(output->data(), data.nframes) < silence_threshold;
+        }
+      }
+      node.quiet_frames = quiet ? std::min<int>(node.quiet_frames + data.nframes, node.sleep_after) : 0;
+    }
+
+    for (auto& input : data.inputs) input.reset();
+    for (int ch = 0; ch < max_channels; ch++) {
+      step.remaining[ch].store(step.consumers[ch], std::memory_order_relaxed);
+      if (step.consumers[ch] == 0) data.outputs[ch].reset();
+    }
+  }
+
+  void RoutingGraph::Plan::process_node(Step& step) noexcept
+  {
+    auto& data = step.data;
+    auto& node = *step.node;
+    if (step.midi) {
+      step.midi->clear();
+      midi::copy_matching(graph._external_in->midi, *step.midi, node.midi);
+    }
+    // A faulted node still runs, so its engine can be switched, but each output is replaced by
+    // a copy of the input of the same channel, taken first as the node may process in place
+    std::array<std::optional<audio::AudioBufferHandle>, max_channels> dry;
+    if (node.fault.load(std::memory_order_acquire) != Fault::none) {
+      for (int ch = 0; ch < std::min(node.inputs, node.outputs); ch++) {
+        if (!data.inputs[ch]) continue;
+        auto& copy = dry[ch].emplace(pool.allocate());
+        std::copy_n(data.inputs[ch]->data(), data.nframes, copy.data());
+        copy.mark_silent(data.inputs[ch]->is_silent());
+      }
+    }
+
+    {
+      // The step may run on a worker thread, which the audio callback has not set up
+      util::audio::FlushDenormals flush_denormals;
+      auto timer = node.cpu.measure();
+      auto start = std::chrono::steady_clock::now().time_since_epoch();
+      node.started_ns.store(start.count(), std::memory_order_relaxed);
+      node.processor(data);
+      auto end = std::chrono::steady_clock::now().time_since_epoch();
+      node.started_ns.store(0, std::memory_order_relaxed);
+      auto limit = graph.overrun_limit.load(std::memory_order_relaxed);
+      if (limit.count() > 0 && end - start > limit) fault(node, Fault::overrun);
+    }
+
+    bool finite = true;
+    for (int ch = 0; ch < node.outputs && finite; ch++) {
+      if (data.outputs[ch]) finite = util::audio::all_finite(data.outputs[ch]->data(), data.nframes);
+    }
+    if (!finite) fault(node, Fault::non_finite);
+    if (node.fault.load(std::memory_order_acquire) != Fault::none) {
+      // Outputs without an input of their channel are silent
+      for (int ch = 0; ch < node.outputs; ch++) {
+        if (dry[ch]) data.outputs[ch] = std::move(*dry[ch]);
+        else data.outputs[ch].emplace(pool.allocate_clear()).mark_silent();
+      }
+    }
+
+#if OTTO_DEBUG_DENORMALS
+    for (int ch = 0; ch < node.outputs; ch++) {
+      if (!data.outputs[ch]) continue;
+      int count = util::audio::count_denormals(data.outputs[ch]->data(), data.nframes);
+      if (count > 0) node.denormals.fetch_add(count, std::memory_order_relaxed);
+    }
+#endif
+
+    if (auto* capture = node.capture.load(std::memory_order_acquire)) {
+      std::array<const float*, max_channels> channels = {};
+      for (int ch = 0; ch < node.outputs; ch++) {
+        if (data.outputs[ch]) channels[ch] = data.outputs[ch]->data();
+      }
+      capture->write({channels.data(), node.outputs}, data.nframes);
+    }
+  }
+
+  // NodeData /////////////////////////////////////////////////////////////////
+
+  void RoutingGraph::NodeData::output(int ch, audio::AudioBufferHandle out) noexcept
+  {
+    if (!out.owning()) {
+      for (auto& input : inputs) {
+        if (!input || input->data() != out.data()) continue;
+        bool silent = out.is_silent();
+        out = *input;
+        out.mark_silent(silent);
+        break;
+      }
+    }
+    outputs[ch] = std::move(out);
+  }
+
+  // RoutingGraph /////////////////////////////////////////////////////////////
+
+  RoutingGraph::RoutingGraph(audio::AudioBufferPool& pool) : _pool(pool)
+  {
+    add_node("Input", 0, 1, [this](NodeData& data) { data.outputs[0] = _external_in->audio; });
+    add_node("Output", 2, 0, [this](NodeData& data) {
+      _result[0] = std::move(data.inputs[0]);
+      _result[1] = std::move(data.inputs[1]);
+    });
+  }
+
+  RoutingGraph::~RoutingGraph() noexcept
+  {
+    delete _plan;
+    delete _pending.exchange(nullptr);
+    delete_retired();
+  }
+
+  void RoutingGraph::delete_retired() noexcept
+  {
+    auto* plan = _retired.exchange(nullptr);
+    while (plan != nullptr) {
+      delete std::exchange(plan, plan->next_retired);
+    }
+  }
+
+  RoutingGraph::NodeId RoutingGraph::add_node(std::string name,
+                                              int inputs,
+                                              int outputs,
+                                              Processor processor,
+                                              midi::EventMask midi)
+  {
+    OTTO_ASSERT(inputs <= max_channels && outputs <= max_channels);
+    // Not make_unique, as the meter makes Node immovable
+    _nodes.emplace_back(new Node{std::move(name), inputs, outputs, std::move(processor), midi, {}});
+    return _nodes.size() - 1;
+  }
+
+  RoutingGraph::NodeId RoutingGraph::add_synth(
+    std::string name,
+    std::function<audio::ProcessData<2>(audio::ProcessData<1>)> process)
+  {
+    return add_node(std::move(name), 1, 2, [process = std::move(process)](NodeData& data) {
+      // Engines don't keep the silence mark up to date when processing in place
+      data.inputs[0]->mark_silent(false);
+      auto out = process({data.view(0), *data.midi, data.nframes, data.context});
+      data.output(0, std::move(out.audio[0]));
+      data.output(1, std::move(out.audio[1]));
+    });
+  }
+
+  RoutingGraph::NodeId RoutingGraph::add_effect(
+    std::string name,
+    std::function<audio::ProcessData<2>(audio::ProcessData<1>)> process)
+  {
+    return add_node(
+      std::move(name), 1, 2,
+      [process = std::move(process)](NodeData& data) {
+        data.inputs[0]->mark_silent(false);
+        auto out = process({data.view(0), *data.midi, data.nframes, data.context});
+        data.output(0, std::move(out.audio[0]));
+        data.output(1, std::move(out.audio[1]));
+      },
+      midi::EventMask::none);
+  }
+
+  RoutingGraph::NodeId RoutingGraph::add_arpeggiator(
+    std::string name,
+    std::function<audio::ProcessData<0>(audio::ProcessData<0>)> process)
+  {
+    return add_node(std::move(name), 0, 0, [process = std::move(process)](NodeData& data) {
+      *data.midi = process({*data.midi, data.nframes, data.context}).midi;
+    });
+  }
+
+  void RoutingGraph::sleep_when_silent(NodeId node, int frames, std::function<bool()> keep_awake)
+  {
+    auto& n = *_nodes.at(node);
+    n.sleep_after = std::max(frames, 0);
+    n.keep_awake = std::move(keep_awake);
+    n.quiet_frames = 0;
+  }
+
+  void RoutingGraph::check_channel(NodeId node, int channel, bool output) const
+  {
+    if (node < 0 || node >= size()) {
+      throw exception(ErrorCode::invalid_connection, "No routing node with id {}", node);
+    }
+    auto& n = *_nodes[node];
+    if (channel < 0 || channel >= (output ? n.outputs : n.inputs)) {
+      throw exception(ErrorCode::invalid_connection, "Node '{}' has no {} channel {}", n.name,
+                      output ? "output" : "input", channel);
+    }
+  }
+
+  void RoutingGraph::connect(NodeId from, int from_channel, NodeId to, int to_channel)
+  {
+    check_channel(from, from_channel, true);
+    check_channel(to, to_channel, false);
+    _edges.push_back({from, from_channel, to, to_channel});
+  }
+
+  bool RoutingGraph::disconnect(NodeId from, int from_channel, NodeId to, int to_channel)
+  {
+    auto found = std::find_if(_edges.begin(), _edges.end(), [&](const Edge& e) {
+      return e.from == from && e.from_channel == from_channel && e.to == to &&
+             e.to_channel == to_channel;
+    });
+    if (found == _edges.end()) return false;
+    _edges.erase(found);
+    return true;
+  }
+
+  void RoutingGraph::add_dependency(NodeId before, NodeId after)
+  {
+    if (before < 0 || before >= size() || after < 0 || after >= size()) {
+      throw exception(ErrorCode::invalid_connection, "No routing nodes with ids {} and {}", before,
+                      after);
+    }
+    _dependencies.emplace_back(before, after);
+  }
+
+  std::chrono::nanoseconds RoutingGraph::running_time(NodeId node) const noexcept
+  {
+    auto started = _nodes.at(node)->started_ns.load(std::memory_order_relaxed);
+    if (started == 0) return std::chrono::nanoseconds(0);
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::max(now - std::chrono::nanoseconds(started), std::chrono::nanoseconds(0));
+  }
+
+  void RoutingGraph::compile()
+  {
+    int n = size();
+
+    // All predecessors of each node, from both edges and dependencies
+    std::vector<std::vector<NodeId>> preds(n);
+    for (auto& e : _edges) preds[e.to].push_back(e.from);
+    for (auto& [before, after] : _dependencies) preds[after].push_back(before);
+    for (auto& p : preds) {
+      std::sort(p.begin(), p.end());
+      p.erase(std::unique(p.begin(), p.end()), p.end());
+    }
+
+    // Kahn's algorithm, picking the lowest id first to keep the order stable
+    std::vector<int> missing(n);
+    std::vector<std::vector<NodeId>> succs(n);
+    for (NodeId i = 0; i < n; i++) {
+      missing[i] = preds[i].size();
+      for (auto p : preds[i]) succs[p].push_back(i);
+    }
+    std::vector<NodeId> order;
+    std::vector<int> step_of(n, -1);
+    order.reserve(n);
+    while (int(order.size()) < n) {
+      auto next = std::find_if(missing.begin(), missing.end(), [](int m) { return m == 0; });
+      if (next == missing.end()) {
+        throw exception(ErrorCode::cycle, "The routing graph contains a cycle");
+      }
+      NodeId node = next - missing.begin();
+      *next = -1;
+      step_of[node] = order.size();
+      order.push_back(node);
+      for (auto s : succs[node]) missing[s]--;
+    }
+
+    auto plan = std::make_unique<Plan>(_pool, n, *this);
+    for (int i = 0; i < n; i++) {
+      auto& step = plan->steps[i];
+      step.node = _nodes[order[i]].get();
+      auto mask = step.node->midi;
+      if (mask != midi::EventMask::all && mask != midi::EventMask::none) {
+        step.midi = std::make_unique<midi::MidiBuffer>();
+        step.midi_ref = *step.midi;
+      }
+    }
+    for (auto& e : _edges) {
+      auto src = Plan::Source{step_of[e.from], e.from_channel};
+      plan->steps[step_of[e.to]].inputs[e.to_channel].push_back(src);
+      plan->steps[src.step].consumers[src.channel]++;
+    }
+    for (int i = 0; i < n; i++) {
+      std::vector<util::TaskGraph::TaskId> deps;
+      for (auto p : preds[order[i]]) deps.push_back(step_of[p]);
+      plan->tasks.add([plan = plan.get(), i] { plan->run_step(i); }, std::move(deps));
+    }
+
+    delete_retired();
+    delete _pending.exchange(plan.release());
+    LOGI("Compiled routing graph with {} nodes and {} edges", n, _edges.size());
+  }
+
+  void RoutingGraph::swap_plan() noexcept
+  {
+    auto* plan = _pending.exchange(nullptr);
+    if (plan == nullptr) return;
+    auto* old = std::exchange(_plan, plan);
+    if (old == nullptr) return;
+    // Push the old plan onto the retired list, to be deleted off the audio thread
+    old->next_retired = _retired.load(std::memory_order_relaxed);
+    while (!_retired.compare_exchange_weak(old->next_retired, old, std::memory_order_release,
+                                           std::memory_order_relaxed))
+      ;
+  }
+
+  audio::ProcessData<2> RoutingGraph::process(audio::ProcessData<1> external_in,
+                                              util::WorkerPool& workers)
+  {
+    swap_plan();
+    auto nframes = external_in.nframes;
+    if (_plan == nullptr) {
+      return {_pool.allocate_multi_clear<2>(), external_in.midi, nframes, external_in.context};
+    }
+
+    _external_in.emplace(std::move(external_in));
+    _external_in->midi.sort_by_time();
+    for (auto& step : _plan->steps) {
+      // The reference of a node reading none of the events stays empty
+      step.data.midi = step.node->midi == midi::EventMask::all ? &_external_in->midi : &step.midi_ref;
+      step.data.nframes = nframes;
+      step.data.context = _external_in->context;
+    }
+
+    workers.run(_plan->tasks);
+
+    audio::ProcessData<2> res = {{std::move(*_result[0]), std::move(*_result[1])},
+                                 _external_in->midi,
+                                 nframes,
+                                 _external_in->context};
+    _result[0].reset();
+    _result[1].reset();
+    _external_in.reset();
+    return res;
+  }
+
+} // namespace otto::core::engine
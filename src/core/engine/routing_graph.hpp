@@ -0,0 +1,347 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "core/audio/processor.hpp"
+#include "core/engine/engine.hpp"
+#include "util/audio_capture.hpp"
+#include "util/cpu_meter.hpp"
+#include "util/exception.hpp"
+#include "util/task_graph.hpp"
+
+namespace otto::core::engine {
+
+  /// A data-driven audio graph of engines
+  ///
+  /// Nodes have up to @ref max_channels audio inputs and outputs, and a processor, which is
+  /// usually a wrapper around an engine. Edges connect an output channel of one node to an
+  /// input channel of another. Each input of a node is the sum of the edges connected to it.
+  /// Dependencies order nodes without carrying audio, e.g. to run an arpeggiator before the
+  /// synth reading its midi.
+  ///
+  /// The graph is edited on a non-audio thread. @ref compile sorts the nodes topologically and
+  /// resolves every edge into a flat execution plan, which @ref process picks up at the start of
+  /// the next buffer. Changes have no effect until `compile` is called.
+  ///
+  /// Nodes that do not depend on each other are run in parallel when processing with a
+  /// @ref util::WorkerPool.
+  ///
+  /// A node can be set to sleep while it is silent, with @ref sleep_when_silent.
+  ///
+  /// A node whose outputs contain a NaN or infinity, or which runs for longer than
+  /// @ref overrun_limit, is faulted: its outputs are muted for that buffer, and from then on it
+  /// is bypassed, passing each input on to the output of the same channel, and silence to
+  /// outputs without one, until @ref clear_fault. It keeps being processed, so an engine
+  /// dispatcher in it can still switch engines.
+  struct RoutingGraph {
+    using NodeId = int;
+
+    /// The maximum number of input or output channels of a node, like the buses of the sends
+    static constexpr int max_channels = 4;
+
+    enum struct ErrorCode {
+      /// The routing contains a cycle
+      cycle,
+      /// No such node or channel
+      invalid_connection,
+    };
+
+    using exception = util::as_exception<ErrorCode>;
+
+    /// Why a node is bypassed
+    enum struct Fault {
+      none,
+      /// Its outputs contained a NaN or infinity
+      non_finite,
+      /// It ran for longer than @ref overrun_limit
+      overrun,
+      /// It was stuck, as reported by a watchdog through @ref set_fault
+      stalled,
+    };
+
+    /// The audio and midi a node processes
+    ///
+    /// A node owns its input buffers, so it may process them in place, and pass them on as
+    /// outputs. An input is marked silent (see `audio::AudioBufferHandle::mark_silent`) when all
+    /// the outputs summed into it are silent or empty, and otherwise keeps the mark of the
+    /// single output it was taken from. A processor passing an input on after writing into it
+    /// must update its mark. Synth and effect nodes hand their engines unmarked inputs.
+    ///
+    /// Engines are handed views of the inputs, see @ref view, so the node holds the buffers
+    /// while they run, and passing them in and out does not touch reference counts.
+    struct NodeData {
+      /// Input buffers, one for each input channel of the node
+      std::array<std::optional<audio::AudioBufferHandle>, max_channels> inputs;
+      /// Output buffers, to be set by the processor for each output channel
+      std::array<std::optional<audio::AudioBufferHandle>, max_channels> outputs;
+      /// The midi of the buffer, sorted by time. Shared by the nodes reading all events, which
+      /// may change it for the nodes after them, and a filtered copy for the others.
+      midi::MidiBufferRef* midi = nullptr;
+      long nframes = 0;
+      /// The context of the external input
+      const audio::AudioContext* context = nullptr;
+
+      /// A view of input `ch`, to hand to an engine
+      audio::AudioBufferHandle view(int ch) const noexcept
+      {
+        return inputs[ch]->view();
+      }
+
+      /// Set output `ch` to `out`, as returned by an engine that was handed views
+      ///
+      /// An engine that processed in place returns the view of an input, and the output then
+      /// holds that input.
+      void output(int ch, audio::AudioBufferHandle out) noexcept;
+    };
+
+    using Processor = std::function<void(NodeData&)>;
+
+    /// \param pool The pool to allocate the summed inputs of nodes from
+    RoutingGraph(audio::AudioBufferPool& pool);
+    ~RoutingGraph() noexcept;
+
+    RoutingGraph(const RoutingGraph&) = delete;
+    RoutingGraph& operator=(const RoutingGraph&) = delete;
+
+    /// The node producing the external input. One output channel.
+    NodeId input() const noexcept
+    {
+      return 0;
+    }
+
+    /// The node consuming the final output. Two input channels.
+    NodeId output() const noexcept
+    {
+      return 1;
+    }
+
+    /// Add a node
+    ///
+    /// \param name Used for the routing screen and log messages
+    /// \param midi The kinds of events the processor reads. Reading all events costs nothing,
+    ///             and none hands it an empty buffer. Otherwise, the events are copied into a
+    ///             buffer of the node's own, so the processor only loops over the ones it reads.
+    NodeId add_node(std::string name,
+                    int inputs,
+                    int outputs,
+                    Processor processor,
+                    midi::EventMask midi = midi::EventMask::all);
+
+    /// Add a node running a synth engine with one input and two output channels, left and right
+    ///
+    /// `process` is called each buffer, usually with an `EngineDispatcher`, so the engine can
+    /// be switched at runtime.
+    NodeId add_synth(std::string name,
+                     std::function<audio::ProcessData<2>(audio::ProcessData<1>)> process);
+
+    /// Add a node running an effect engine with one input and two output channels, reading no
+    /// midi
+    ///
+    /// `process` is called each buffer, usually with an `EngineDispatcher`, so the engine can
+    /// be switched at runtime.
+    NodeId add_effect(std::string name,
+                      std::function<audio::ProcessData<2>(audio::ProcessData<1>)> process);
+
+    /// Add a node running an arpeggiator, with no audio channels
+    ///
+    /// Use @ref add_dependency to run it before the nodes reading its midi.
+    /// `process` is called each buffer, usually with an `EngineDispatcher`, so the engine can
+    /// be switched at runtime.
+    NodeId add_arpeggiator(std::string name,
+                           std::function<audio::ProcessData<0>(audio::ProcessData<0>)> process);
+
+    /// Skip the processor of `node` once its inputs and outputs have been silent for `frames`
+    ///
+    /// Meant for effects, whose tails die out after their input goes quiet. While asleep, the
+    /// outputs of the node are left empty, which the nodes reading them take as silence. It
+    /// wakes up in the first buffer its input is above @ref silence_threshold again, or
+    /// `keep_awake` returns `true`. That is called on the audio thread every buffer the node
+    /// would sleep, e.g. to let an engine dispatcher finish a switch. `frames` should be longer
+    /// than the longest gap within a tail, like a predelay. 0 never sleeps.
+    ///
+    /// Like @ref connect, not to be called while the graph is processing.
+    void sleep_when_silent(NodeId node, int frames, std::function<bool()> keep_awake = nullptr);
+
+    /// Whether the processor of `node` was skipped in the last buffer. Safe to call from any
+    /// thread.
+    bool asleep(NodeId node) const noexcept
+    {
+      return _nodes.at(node)->asleep.load(std::memory_order_relaxed);
+    }
+
+    /// The peak level below which a node set to @ref sleep_when_silent is silent, about
+    /// -100dBFS
+    static constexpr float silence_threshold = 1e-5f;
+
+    /// Connect output channel `from_channel` of `from` to input channel `to_channel` of `to`
+    ///
+    /// \throws exception with ErrorCode::invalid_connection if there is no such node or channel
+    void connect(NodeId from, int from_channel, NodeId to, int to_channel);
+
+    /// Remove a connection made with @ref connect
+    ///
+    /// \returns `false` if there was no such connection
+    bool disconnect(NodeId from, int from_channel, NodeId to, int to_channel);
+
+    /// Make `after` run after `before`, without connecting any audio
+    void add_dependency(NodeId before, NodeId after);
+
+    /// Compile the graph, and hand the result over to the audio thread.
+    ///
+    /// Not to be called from the audio thread.
+    ///
+    /// \throws exception with ErrorCode::cycle if the graph is not a DAG.
+    void compile();
+
+    /// Process a buffer with the last compiled plan
+    ///
+    /// Sorts the midi of `external_in` by time, once for all nodes. Only to be called from the
+    /// audio thread. Before the first call to @ref compile, the
+    /// output is silent.
+    audio::ProcessData<2> process(audio::ProcessData<1> external_in, util::WorkerPool& workers);
+
+    /// The number of nodes
+    int size() const noexcept
+    {
+      return _nodes.size();
+    }
+
+    const std::string& name_of(NodeId node) const
+    {
+      return _nodes.at(node)->name;
+    }
+
+    /// The number of output channels of `node`
+    int outputs_of(NodeId node) const
+    {
+      return _nodes.at(node)->outputs;
+    }
+
+    /// Take the timing statistics of the processor of `node` since the last call
+    ///
+    /// Safe to call while the audio thread is processing.
+    util::CpuMeter::Stats take_cpu_stats(NodeId node)
+    {
+      return _nodes.at(node)->cpu.take();
+    }
+
+    /// Take the number of denormals in the outputs of `node` since the last call
+    ///
+    /// Only counted when built with `OTTO_DEBUG_DENORMALS`, otherwise always 0. Safe to call
+    /// while the audio thread is processing.
+    int take_denormal_count(NodeId node)
+    {
+      return _nodes.at(node)->denormals.exchange(0, std::memory_order_relaxed);
+    }
+
+    /// Hand the outputs of `node` to `capture` after each buffer, or stop with `nullptr`
+    ///
+    /// Costs a copy of the outputs per buffer. `capture` should have as many channels as the
+    /// node has outputs. It must outlive the graph, or the next buffer after it is removed.
+    void set_capture(NodeId node, util::AudioCapture* capture) noexcept
+    {
+      _nodes.at(node)->capture.store(capture, std::memory_order_release);
+    }
+
+    /// Why `node` is bypassed, or `Fault::none`. Safe to call from any thread.
+    Fault fault_of(NodeId node) const noexcept
+    {
+      return _nodes.at(node)->fault.load(std::memory_order_acquire);
+    }
+
+    /// Bypass `node` from its next buffer on, unless it is already faulted
+    ///
+    /// Safe to call from any thread.
+    void set_fault(NodeId node, Fault fault) noexcept
+    {
+      auto none = Fault::none;
+      _nodes.at(node)->fault.compare_exchange_strong(none, fault, std::memory_order_acq_rel);
+    }
+
+    /// Stop bypassing `node`, like once its engine has been reset. Safe to call from any thread.
+    void clear_fault(NodeId node) noexcept
+    {
+      _nodes.at(node)->fault.store(Fault::none, std::memory_order_release);
+    }
+
+    /// How long the processor of `node` has been running in the current buffer, or 0
+    ///
+    /// For a watchdog, to find the node the audio thread is stuck in. Safe to call from any
+    /// thread.
+    std::chrono::nanoseconds running_time(NodeId node) const noexcept;
+
+    /// Fault the nodes whose processor runs for longer than this, or never if it is 0
+    ///
+    /// A node that runs for several buffers has either gone wrong, or is so slow that the
+    /// audio is unusable. May be set from any thread.
+    std::atomic<std::chrono::nanoseconds> overrun_limit = std::chrono::nanoseconds(0);
+
+  private:
+    struct Node {
+      std::string name;
+      int inputs;
+      int outputs;
+      Processor processor;
+      midi::EventMask midi;
+      /// Written by whichever thread runs the node
+      mutable util::CpuMeter cpu;
+      /// Written by whichever thread runs the node
+      std::atomic_int denormals = 0;
+      std::atomic<util::AudioCapture*> capture = nullptr;
+      /// Written by whichever thread runs the node, and by @ref set_fault
+      mutable std::atomic<Fault> fault = Fault::none;
+      /// When the processor started, in nanoseconds of `std::chrono::steady_clock`, or 0 when
+      /// it is not running
+      mutable std::atomic<std::int64_t> started_ns = 0;
+      /// See @ref sleep_when_silent
+      int sleep_after = 0;
+      std::function<bool()> keep_awake;
+      /// The number of frames the inputs and outputs have been silent for. Written by whichever
+      /// thread runs the node.
+      mutable int quiet_frames = 0;
+      mutable std::atomic_bool asleep = false;
+    };
+
+    struct Edge {
+      NodeId from;
+      int from_channel;
+      NodeId to;
+      int to_channel;
+    };
+
+    struct Plan;
+
+    void check_channel(NodeId node, int channel, bool output) const;
+
+    /// Pick up a newly compiled plan. Called from the audio thread.
+    void swap_plan() noexcept;
+
+    /// Delete all retired plans. Not called from the audio thread.
+    void delete_retired() noexcept;
+
+    audio::AudioBufferPool& _pool;
+    std::vector<std::unique_ptr<Node>> _nodes;
+    std::vector<Edge> _edges;
+    std::vector<std::pair<NodeId, NodeId>> _dependencies;
+
+    /// The plan in use by the audio thread
+    Plan* _plan = nullptr;
+    /// Compiled, but not yet picked up by the audio thread
+    std::atomic<Plan*> _pending = nullptr;
+    /// A list of plans replaced by the audio thread, to be deleted by the next call to `compile`
+    std::atomic<Plan*> _retired = nullptr;
+
+    /// The external input of the current buffer
+    std::optional<audio::ProcessData<1>> _external_in;
+    /// The output of the current buffer
+    std::array<std::optional<audio::AudioBufferHandle>, 2> _result;
+  };
+
+} // namespace otto::core::engine
@@ -0,0 +1,98 @@
+#include "undo_history.hpp"
+
+#include "core/engine/engine.hpp"
+#include "core/props/mixins/signal.hpp"
+#include "util/exception.hpp"
+
+namespace otto::core::engine {
+
+  UndoHistory::UndoHistory(std::vector<std::string> parts, EngineOf engine_of)
+    : parts(std::move(parts)), _engine_of(std::move(engine_of))
+  {
+    UndoHistory* expected = nullptr;
+    if (!_current.compare_exchange_strong(expected, this)) {
+      throw util::exception("UndoHistory: only one history may exist at a time");
+    }
+  }
+
+  UndoHistory::~UndoHistory()
+  {
+    props::edit_observer = nullptr;
+    _current = nullptr;
+  }
+
+  void UndoHistory::start()
+  {
+    if (_thread != std::thread::id()) return;
+    _thread = std::this_thread::get_id();
+    props::edit_observer = observe;
+  }
+
+  void UndoHistory::record(const Edit& edit)
+  {
+    if (_cursor > 0) {
+      auto& last = at(_cursor - 1);
+      if (_cursor == _size && last.part == edit.part && last.hash == edit.hash &&
+          last.engine == edit.engine && edit.time - last.time < merge_window) {
+        last.new_value = edit.new_value;
+        last.time = edit.time;
+        return;
+      }
+    }
+    // A new edit replaces the ones that were undone
+    _size = _cursor;
+    if (_size == capacity) {
+      _begin = (_begin + 1) % capacity;
+      _size--;
+    }
+    at(_size) = edit;
+    _size++;
+    _cursor = _size;
+  }
+
+  bool UndoHistory::undo()
+  {
+    if (_cursor == 0) return false;
+    _cursor--;
+    auto& edit = at(_cursor);
+    apply(edit, edit.old_value);
+    return true;
+  }
+
+  bool UndoHistory::redo()
+  {
+    if (_cursor == _size) return false;
+    auto& edit = at(_cursor);
+    _cursor++;
+    apply(edit, edit.new_value);
+    return true;
+  }
+
+  void UndoHistory::apply(const Edit& edit, double value)
+  {
+    auto* engine = _engine_of(edit.part);
+    if (engine == nullptr || engine->name() != edit.engine) return;
+    int index = engine->find_property(edit.hash);
+    if (index < 0) return;
+    props::BulkUpdate bulk;
+    engine->set_property(index, value);
+  }
+
+  void UndoHistory::observe(const void* property, double old_value)
+  {
+    auto* self = _current.load(std::memory_order_relaxed);
+    if (self == nullptr || std::this_thread::get_id() != self->_thread) return;
+    // Presets, slot recalls and undoing itself are not edits
+    if (props::BulkUpdate::active()) return;
+    for (int part = 0; part < int(self->parts.size()); part++) {
+      auto* engine = self->_engine_of(part);
+      if (engine == nullptr) continue;
+      int index = engine->find_property(property);
+      if (index < 0) continue;
+      self->record({std::uint8_t(part), engine->property_info(index).hash, engine->name(), old_value,
+                    engine->get_property(index), clock::now()});
+      return;
+    }
+  }
+
+} // namespace otto::core::engine
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/string_ref.hpp"
+
+namespace otto::core::engine {
+
+  struct IEngine;
+
+  /// The recent edits of numeric properties of engines, to undo and redo them
+  ///
+  /// Like in @ref MidiLearn, an edit names a part, i.e. one of the engines found by `engine_of`,
+  /// and the hash of the path of a property in its `props::PropertyTable`, along with the
+  /// values before and after. Edits are picked up through `props::edit_observer` on the thread
+  /// that calls @ref start, which is the UI thread, so changes made by midi on the audio
+  /// thread are not recorded.
+  ///
+  /// The edits are kept in a ring of @ref capacity entries, which drops the oldest ones. Edits
+  /// of the same property within @ref merge_window of each other, like the steps of one turn
+  /// of an encoder, are merged into one. Changes made in a `props::BulkUpdate`, like loading a
+  /// preset, are not edits, and undoing and redoing sets the property in one too.
+  ///
+  /// Only one history may exist at a time.
+  struct UndoHistory {
+    using clock = std::chrono::steady_clock;
+    using EngineOf = std::function<IEngine*(int part)>;
+
+    struct Edit {
+      std::uint8_t part = 0;
+      std::uint32_t hash = 0;
+      /// The name of the engine that was edited, which must still be in `part` to undo the edit
+      util::string_ref engine;
+      double old_value = 0;
+      double new_value = 0;
+      /// When the property was last changed by the edit
+      clock::time_point time;
+    };
+
+    static constexpr std::size_t capacity = 256;
+    static constexpr auto merge_window = std::chrono::milliseconds(1000);
+
+    /// \param parts The names of the engines whose property edits are recorded
+    /// \param engine_of The engine currently at the index of a name in `parts`
+    UndoHistory(std::vector<std::string> parts, EngineOf engine_of);
+
+    /// Stops observing
+    ~UndoHistory();
+
+    /// Start recording the edits made on the calling thread, if not started yet
+    void start();
+
+    UndoHistory(const UndoHistory&) = delete;
+    UndoHistory& operator=(const UndoHistory&) = delete;
+
+    /// Record an edit, merging it with the last one if it is of the same property within
+    /// @ref merge_window. Drops the edits that were undone.
+    void record(const Edit& edit);
+
+    /// Set the property of the last edit back to its old value
+    ///
+    /// An edit of an engine that has since been switched away from is skipped.
+    /// \returns `false` if there was nothing to undo
+    bool undo();
+
+    /// Set the property of the last undone edit to its new value again
+    ///
+    /// \returns `false` if there was nothing to redo
+    bool redo();
+
+    /// The number of edits that can be undone
+    std::size_t undo_count() const noexcept
+    {
+      return _cursor;
+    }
+
+    /// The number of edits that can be redone
+    std::size_t redo_count() const noexcept
+    {
+      return _size - _cursor;
+    }
+
+    const std::vector<std::string> parts;
+
+  private:
+    static void observe(const void* property, double old_value);
+    /// Set the property of `edit` to `value`, if the engine of its part is still the same
+    void apply(const Edit& edit, double value);
+    Edit& at(std::size_t index) noexcept
+    {
+      return _edits[(_begin + index) % capacity];
+    }
+
+    static inline std::atomic<UndoHistory*> _current = nullptr;
+
+    EngineOf _engine_of;
+    /// The thread edits are recorded on, once started
+    std::thread::id _thread;
+
+    std::array<Edit, capacity> _edits;
+    /// The index of the oldest edit in `_edits`
+    std::size_t _begin = 0;
+    std::size_t _size = 0;
+    /// The number of edits that are not undone
+    std::size_t _cursor = 0;
+  };
+
+} // namespace otto::core::engine
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <type_traits>
+
 #include "../internal/mixin_macros.hpp"
 #include "base.hpp"
 #include "tag_list.hpp"
@@ -14,6 +16,10 @@ namespace otto::core::props {
       /// Fired after the value has been changed. At this point the value can be read
       /// using .value(), and the old value can be read
       struct after_set : mixin::hook<mixin::value_type> {};
+      /// Fired once the property and all its mixins are constructed, with the initial value
+      struct after_init : mixin::hook<mixin::value_type> {};
+      /// Fired when the property is destroyed, before any of its mixins are
+      struct before_destroy : mixin::hook<mixin::value_type> {};
     };
   };
 
@@ -65,6 +71,17 @@ namespace otto::core::props {
       } else {
         static_cast<inherits_from_mixins_t<T, tag_list>&>(*this) = {std::forward<Args>(args)...};
       }
+      run_hook<common::hooks::after_init>(value_);
+    }
+
+    PropertyImpl(const PropertyImpl&) = default;
+    PropertyImpl(PropertyImpl&&) = default;
+    PropertyImpl& operator=(const PropertyImpl&) = default;
+    PropertyImpl& operator=(PropertyImpl&&) = default;
+
+    ~PropertyImpl() noexcept
+    {
+      run_hook<common::hooks::before_destroy>(value_);
     }
 
     template<typename Tag>
@@ -118,8 +135,8 @@ namespace otto::core::props {
 
     void set(const value_type& v)
     {
-      auto oldval = value_;
-      value_ = run_hook<common::hooks::on_set>(v);
+      auto oldval = load_value();
+      store_value(run_hook<common::hooks::on_set>(v));
       run_hook<common::hooks::after_set>(oldval);
     }
 
@@ -134,9 +151,45 @@ namespace otto::core::props {
       return get();
     }
 
+    /// The value, read atomically if it is written atomically
+    ///
+    /// For mixins that read the value while another thread may set it.
+    value_type load_value() const noexcept(atomic_value)
+    {
+      if constexpr (atomic_value) {
+        value_type res;
+        __atomic_load(&value_, &res, __ATOMIC_RELAXED);
+        return res;
+      } else {
+        return value_;
+      }
+    }
+
     DECL_REFLECTION(PropertyImpl, ("value", &PropertyImpl::get, &PropertyImpl::set))
   protected:
     value_type value_;
+
+  private:
+    /// Whether the value is written with relaxed atomic operations
+    ///
+    /// Besides the UI thread, midi learn, modulation and morphs set properties from the audio
+    /// thread, so two threads may set a property at once. Numeric values are small enough to
+    /// be written atomically, so the last one wins, instead of a torn value.
+    static constexpr bool atomic_value = std::is_trivially_copyable_v<value_type> &&
+                                         std::is_default_constructible_v<value_type> &&
+                                         alignof(value_type) >= sizeof(value_type) &&
+                                         __atomic_always_lock_free(sizeof(value_type), 0);
+
+    template<typename TRef>
+    void store_value(TRef&& v)
+    {
+      if constexpr (atomic_value) {
+        value_type tmp = v;
+        __atomic_store(&value_, &tmp, __ATOMIC_RELAXED);
+      } else {
+        value_ = std::forward<TRef>(v);
+      }
+    }
   };
 
 } // namespace otto::core::props
@@ -5,3 +5,6 @@
 #include "wrap.hpp"
 #include "pow2.hpp"
 #include "signal.hpp"
+#include "audio_thread.hpp"
+#include "atomic.hpp"
+#include "smoothed.hpp"
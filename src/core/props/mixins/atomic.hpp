@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <type_traits>
+
+#include "../internal/mixin_macros.hpp"
+#include "../internal/property.hpp"
+
+namespace otto::core::props {
+
+  /// Lets the audio thread read the value while the UI thread sets it
+  ///
+  /// The property keeps a lock-free atomic copy of its value, stored after every set, and on
+  /// construction. The audio thread reads it with @ref load, which is a relaxed atomic load, so
+  /// it never sees a torn value, and the UI thread never locks. Hooks and signals still run
+  /// on the setting thread. Use @ref audio_thread when a handler must run on the audio thread.
+  ///
+  /// ```cpp
+  /// Property<bool, atomic> bypass = false;
+  ///
+  /// // In process()
+  /// if (props.bypass.load()) return data;
+  /// ```
+  ///
+  /// Required by @ref smoothed, which reads its target this way.
+  OTTO_PROPS_MIXIN(atomic);
+
+  OTTO_PROPS_MIXIN_LEAF (atomic) {
+    OTTO_PROPS_MIXIN_DECLS(atomic);
+
+    static_assert(std::is_trivially_copyable_v<value_type>,
+                  "The 'atomic' mixin requires a trivially copyable type");
+    static_assert(std::atomic<value_type>::is_always_lock_free,
+                  "The 'atomic' mixin requires a type that is lock free when atomic");
+
+    leaf() = default;
+
+    leaf(const leaf& rhs) noexcept : value_(rhs.load()) {}
+
+    leaf& operator=(const leaf& rhs) noexcept
+    {
+      value_.store(rhs.load(), std::memory_order_relaxed);
+      return *this;
+    }
+
+    /// The value, safe to read from any thread
+    value_type load() const noexcept
+    {
+      return value_.load(std::memory_order_relaxed);
+    }
+
+    void on_hook(hook<common::hooks::after_init, HookOrder::Before> & hook) noexcept
+    {
+      value_.store(as_prop().load_value(), std::memory_order_relaxed);
+    }
+
+    /// Stored before the signals are emitted, so handlers see the new value too
+    void on_hook(hook<common::hooks::after_set, HookOrder::Before> & hook) noexcept
+    {
+      value_.store(as_prop().load_value(), std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<value_type> value_{value_type{}};
+  };
+
+} // namespace otto::core::props
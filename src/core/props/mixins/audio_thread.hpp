@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <type_traits>
+
+#include "../internal/mixin_macros.hpp"
+#include "../internal/property.hpp"
+
+#include "services/application.hpp"
+#include "services/log_manager.hpp"
+
+#include "signal.hpp"
+
+namespace otto::core::props {
+
+  /// A lock-free multi-producer, single consumer queue of deferred property changes.
+  ///
+  /// Properties with the @ref audio_thread mixin push themselves onto this queue when they are
+  /// set, and the audio thread calls @ref process_changes at the start of each buffer, which
+  /// emits their `on_change` signals. A property is queued at most once between two calls to
+  /// `process_changes`, so intermediate values are coalesced.
+  ///
+  /// Properties are set from the UI thread, but also from the audio thread itself, by midi
+  /// learn, modulation and morphs, so any thread may push. The slots carry sequence numbers,
+  /// like in @ref util::MPSCQueue, and the target of a slot is atomic, so @ref cancel can clear
+  /// it in place.
+  ///
+  /// There is one queue per application, as there is one audio thread per application, and a
+  /// property uses the queue of the application it is constructed in.
+  struct AudioThreadQueue {
+    using ApplyFunc = void (*)(void*) noexcept;
+
+    static constexpr std::size_t capacity = 1024;
+
+    /// The queue of the current application, see `services::Application::audio_thread_queue`
+    ///
+    /// Or a process wide one when there is no application, like in most tests.
+    static AudioThreadQueue& get() noexcept
+    {
+      if (services::Application::has_current()) {
+        return *services::Application::current().audio_thread_queue;
+      }
+      static AudioThreadQueue queue;
+      return queue;
+    }
+
+    AudioThreadQueue() noexcept
+    {
+      for (std::size_t i = 0; i < capacity; i++) {
+        entries_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    AudioThreadQueue(const AudioThreadQueue&) = delete;
+    AudioThreadQueue& operator=(const AudioThreadQueue&) = delete;
+
+    /// Queue a change. Safe to call from any thread.
+    ///
+    /// \returns `false` if the queue is full.
+    bool push(void* target, ApplyFunc apply) noexcept
+    {
+      auto pos = tail_.load(std::memory_order_relaxed);
+      while (true) {
+        auto& entry = entries_[pos & mask];
+        auto seq = entry.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+        if (diff == 0) {
+          if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            entry.apply = apply;
+            entry.target.store(target, std::memory_order_relaxed);
+            entry.sequence.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = tail_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    /// Remove any pending changes for `target`. Safe to call from any thread.
+    ///
+    /// Used when a property is destroyed. If the audio thread is applying a change of `target`,
+    /// this waits until it is done, so `target` may be freed when it returns.
+    void cancel(void* target) noexcept
+    {
+      for (auto& entry : entries_) {
+        if (entry.target.load(std::memory_order_relaxed) != target) continue;
+        void* expected = target;
+        entry.target.compare_exchange_strong(expected, nullptr);
+      }
+      // The audio thread announces a target before taking it from its slot, so either the
+      // exchange above won, or this sees it until it is applied
+      while (applying_.load() == target) std::this_thread::yield();
+    }
+
+    /// Apply the changes queued before the call. Called from the audio thread.
+    ///
+    /// Changes queued by the handlers wait for the next call.
+    void process_changes() noexcept
+    {
+      auto end = tail_.load(std::memory_order_acquire);
+      for (; head_ != end; head_++) {
+        auto& entry = entries_[head_ & mask];
+        // Still being written by a producer
+        if (entry.sequence.load(std::memory_order_acquire) != head_ + 1) break;
+        if (void* target = entry.target.load(std::memory_order_relaxed); target != nullptr) {
+          applying_.store(target);
+          if (entry.target.compare_exchange_strong(target, nullptr)) entry.apply(target);
+          applying_.store(nullptr, std::memory_order_release);
+        }
+        entry.sequence.store(head_ + capacity, std::memory_order_release);
+      }
+    }
+
+  private:
+    static constexpr std::size_t mask = capacity - 1;
+
+    struct Entry {
+      std::atomic<std::size_t> sequence;
+      std::atomic<void*> target = nullptr;
+      ApplyFunc apply = nullptr;
+    };
+
+    std::array<Entry, capacity> entries_;
+    /// The next position to push to, shared by all producers
+    std::atomic<std::size_t> tail_ = 0;
+    /// The next position to apply, only touched by the audio thread
+    std::size_t head_ = 0;
+    /// The target the audio thread is applying a change of, for @ref cancel
+    std::atomic<void*> applying_ = nullptr;
+  };
+
+  /// Emit the `on_change` signal on the audio thread.
+  ///
+  /// The value is still stored immediately, but the signal is emitted when the audio thread
+  /// calls @ref AudioThreadQueue::process_changes at the start of the next buffer. Use this for
+  /// properties whose handlers modify state the audio thread reads, like envelopes and filter
+  /// coefficients.
+  OTTO_PROPS_MIXIN(audio_thread, REQUIRES(signal));
+
+  OTTO_PROPS_MIXIN_LEAF (audio_thread) {
+    OTTO_PROPS_MIXIN_DECLS(audio_thread);
+
+    static_assert(std::is_trivially_copyable_v<value_type>,
+                  "The 'audio_thread' mixin requires a trivially copyable type");
+
+    leaf() = default;
+
+    /// Copies do not inherit pending changes
+    leaf(const leaf&) noexcept {}
+
+    leaf& operator=(const leaf&) noexcept
+    {
+      return *this;
+    }
+
+    /// Before the other mixins are destroyed, as the `signal` mixin holds the handlers. Also
+    /// when no change is queued, as the last one may still be being applied.
+    void on_hook(hook<common::hooks::before_destroy> & hook) noexcept
+    {
+      queue_->cancel(this);
+    }
+
+    /// Queue the change. Called by the `signal` mixin instead of emitting directly.
+    void defer_change(value_type old_value) noexcept
+    {
+      value_.store(as_prop().load_value(), std::memory_order_relaxed);
+      if (!queued_.exchange(true, std::memory_order_acq_rel)) {
+        old_value_.store(old_value, std::memory_order_relaxed);
+        if (!queue_->push(this, &apply_change)) {
+          queued_ = false;
+          LOGE("The audio thread property queue is full. Dropping change");
+        }
+      }
+    }
+
+  private:
+    static void apply_change(void* self) noexcept
+    {
+      static_cast<self_type*>(self)->emit_change();
+    }
+
+    void emit_change() noexcept
+    {
+      // Synchronizes with `defer_change`, so a value stored while this was queued is seen
+      queued_.exchange(false, std::memory_order_acq_rel);
+      auto new_value = value_.load(std::memory_order_acquire);
+      auto old_value = old_value_.load(std::memory_order_relaxed);
+      as<signal>().on_change().emit(new_value, old_value);
+    }
+
+    std::atomic<value_type> value_;
+    std::atomic<value_type> old_value_;
+    std::atomic_bool queued_ = false;
+    /// The queue of the application the property was constructed in
+    AudioThreadQueue* queue_ = &AudioThreadQueue::get();
+  };
+
+} // namespace otto::core::props
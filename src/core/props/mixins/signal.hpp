@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "util/utility.hpp"
@@ -11,11 +16,124 @@
 #include "util/algorithm.hpp"
 
 #include "util/signals.hpp"
+#include "util/type_traits.hpp"
 
 namespace otto::core::props {
 
+  /// The number of changes to properties with a signal since startup
+  ///
+  /// Lets the state manager skip saving when no property has changed.
+  inline std::atomic<std::uint64_t> change_count = 0;
+
+  /// The property with a signal that was changed most recently
+  ///
+  /// Lets midi learn bind to the property the user last turned. Only compared, never read
+  /// through, since the property may be gone.
+  inline std::atomic<const void*> last_changed = nullptr;
+
+  /// Called with each property with a signal after it has changed, on the thread that changed it
+  ///
+  /// Lets the input recorder log the changes of a performance. `nullptr` when nothing observes.
+  inline std::atomic<void (*)(const void* property)> change_observer = nullptr;
+
+  /// Called with each numeric property with a signal after it has changed, and its old value
+  ///
+  /// Lets the undo history record edits. `nullptr` when nothing observes.
+  inline std::atomic<void (*)(const void* property, double old_value)> edit_observer = nullptr;
+
+  /// Holds back the signals of the properties changed on this thread, while it is alive
+  ///
+  /// For bulk changes, like applying a preset or a snapshot. When the outermost bulk update on
+  /// the thread ends, each changed property emits its signal once, with the value it had
+  /// before the first change, and then each function passed to @ref coalesce runs once. So
+  /// handlers that recompute the same thing from several properties can do it once per bulk
+  /// update, instead of once per property.
+  ///
+  /// Properties that defer their changes to the audio thread are not held back. The changed
+  /// properties must outlive the bulk update.
+  struct BulkUpdate {
+    BulkUpdate() noexcept
+    {
+      state().depth++;
+    }
+
+    ~BulkUpdate()
+    {
+      auto& st = state();
+      if (st.depth > 1) {
+        st.depth--;
+        return;
+      }
+      // Still active, so the changes and coalesced calls made by handlers are collected too
+      while (!st.signals.empty() || !st.coalesced.empty()) {
+        auto signals = std::move(st.signals);
+        st.signals.clear();
+        for (auto& [property, emit] : signals) emit();
+        auto coalesced = std::move(st.coalesced);
+        st.coalesced.clear();
+        for (auto& [key, call] : coalesced) call();
+      }
+      st.depth = 0;
+    }
+
+    BulkUpdate(const BulkUpdate&) = delete;
+    BulkUpdate& operator=(const BulkUpdate&) = delete;
+
+    /// Whether a bulk update is alive on this thread
+    static bool active() noexcept
+    {
+      return state().depth > 0;
+    }
+
+    /// Hold back `emit`, the signal of `property`, unless it is already held back
+    template<typename F>
+    static void defer(const void* property, F&& emit)
+    {
+      auto& signals = state().signals;
+      for (auto& entry : signals) {
+        if (entry.first == property) return;
+      }
+      signals.emplace_back(property, std::forward<F>(emit));
+    }
+
+  private:
+    template<typename F>
+    friend void coalesce(const void* key, F&& f);
+
+    struct State {
+      int depth = 0;
+      std::vector<std::pair<const void*, std::function<void()>>> signals;
+      std::vector<std::pair<const void*, std::function<void()>>> coalesced;
+    };
+
+    static State& state() noexcept
+    {
+      static thread_local State st;
+      return st;
+    }
+  };
+
+  /// Call `f` now, or at the end of the bulk update alive on this thread
+  ///
+  /// Calls with the same `key` during a bulk update run only the first `f`, once.
+  template<typename F>
+  void coalesce(const void* key, F&& f)
+  {
+    if (!BulkUpdate::active()) {
+      f();
+      return;
+    }
+    auto& coalesced = BulkUpdate::state().coalesced;
+    for (auto& entry : coalesced) {
+      if (entry.first == key) return;
+    }
+    coalesced.emplace_back(key, std::forward<F>(f));
+  }
+
   OTTO_PROPS_MIXIN(signal);
 
+  struct audio_thread;
+
   OTTO_PROPS_MIXIN_LEAF (signal) {
     OTTO_PROPS_MIXIN_DECLS(signal);
 
@@ -43,15 +161,22 @@ namespace otto::core::props {
 
       Signal(self_type& owner) : owner(owner) {}
 
-      using Super::connect;
-      SlotRef connect(std::function<void(value_type)> f)
-      {
-        return {connect([f = std::move(f)](value_type new_val, value_type old_val) { return f(new_val); }), *this};
-      }
-
-      SlotRef connect(std::function<void()> f)
+      /// Connect `f`, taking the new and old values, only the new value, or nothing
+      ///
+      /// `f` is stored directly in the slot, without wrapping it in another function object.
+      template<typename F>
+      SlotRef connect(F&& f)
       {
-        return {connect([f = std::move(f)](value_type new_val, value_type old_val) { return f(); }), *this};
+        using Fn = std::decay_t<F>;
+        if constexpr (std::is_invocable_v<Fn&, value_type, value_type>) {
+          return {Super::connect(std::forward<F>(f)), *this};
+        } else if constexpr (std::is_invocable_v<Fn&, value_type>) {
+          return {Super::connect([f = Fn(std::forward<F>(f))](value_type new_val, value_type) mutable { f(new_val); }),
+                  *this};
+        } else {
+          static_assert(std::is_invocable_v<Fn&>, "Signal handlers take the new and old values, the new value, or nothing");
+          return {Super::connect([f = Fn(std::forward<F>(f))](value_type, value_type) mutable { f(); }), *this};
+        }
       }
 
       self_type& owner;
@@ -59,7 +184,21 @@ namespace otto::core::props {
 
     void on_hook(hook<common::hooks::after_set, HookOrder::After> & hook)
     {
-      _on_change.emit(as_prop().get(), hook.value());
+      change_count.fetch_add(1, std::memory_order_relaxed);
+      last_changed.store(&as_prop(), std::memory_order_relaxed);
+      if (auto* observer = change_observer.load(std::memory_order_relaxed)) observer(&as_prop());
+      if constexpr (std::is_arithmetic_v<value_type> || util::is_number_or_enum_v<value_type>) {
+        if (auto* observer = edit_observer.load(std::memory_order_relaxed)) {
+          observer(&as_prop(), static_cast<double>(util::underlying(hook.value())));
+        }
+      }
+      if constexpr (is<audio_thread>()) {
+        as<audio_thread>().defer_change(hook.value());
+      } else if (BulkUpdate::active()) {
+        BulkUpdate::defer(&as_prop(), [this, old = hook.value()] { _on_change.emit(as_prop().get(), old); });
+      } else {
+        _on_change.emit(as_prop().get(), hook.value());
+      }
     }
 
     Signal& on_change()
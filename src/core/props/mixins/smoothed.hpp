@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+
+#include <gsl/span>
+
+#include "../internal/mixin_macros.hpp"
+#include "../internal/property.hpp"
+
+#include "services/log_manager.hpp"
+
+#include "atomic.hpp"
+
+namespace otto::core::props {
+
+  /// Linear parameter smoothing for audio-rate properties
+  ///
+  /// The property value is used as the ramp target. Once per buffer, the audio thread calls
+  /// `smoothed_block(nframes)` to get a span of values ramping from the last smoothed value
+  /// towards the target over `ramp_frames`, so engines can read a precomputed block instead of
+  /// filtering the value or recomputing coefficients per sample. The target is read through the
+  /// required @ref atomic mixin, so the UI thread may set it at any time.
+  ///
+  /// ```cpp
+  /// Property<float, smoothed> volume = {0.5, limits(0, 1), smoothed::init(480)};
+  ///
+  /// auto vol = props.volume.smoothed_block(data.nframes);
+  /// for (int i = 0; i < data.nframes; i++) out[i] *= vol[i];
+  /// ```
+  OTTO_PROPS_MIXIN(smoothed, REQUIRES(atomic));
+
+  OTTO_PROPS_MIXIN_LEAF (smoothed) {
+    OTTO_PROPS_MIXIN_DECLS(smoothed);
+
+    static_assert(std::is_floating_point_v<value_type>,
+                  "The 'smoothed' mixin requires a floating point type");
+
+    /// The maximum number of frames in a block
+    static constexpr int max_block_size = 1024;
+
+    /// \param frames The number of frames a ramp to a new value takes
+    void init(int frames = 480)
+    {
+      ramp_frames = std::max(1, frames);
+    }
+
+    /// Get the smoothed values for the next `nframes` frames
+    ///
+    /// Only to be called from the audio thread, once per buffer.
+    ///
+    /// \requires `nframes <= max_block_size`
+    gsl::span<const value_type> smoothed_block(int nframes) noexcept
+    {
+      OTTO_ASSERT(nframes <= max_block_size);
+      value_type target = as<atomic>().load();
+      if (!initialized_) {
+        current_ = ramp_target_ = target;
+        initialized_ = true;
+      }
+      if (target != ramp_target_) {
+        ramp_target_ = target;
+        step_ = (target - current_) / ramp_frames;
+        remaining_ = ramp_frames;
+      }
+      if (remaining_ == 0) {
+        std::fill_n(block_.begin(), nframes, current_);
+      } else {
+        for (int i = 0; i < nframes; i++) {
+          if (remaining_ > 0) {
+            current_ += step_;
+            if (--remaining_ == 0) current_ = ramp_target_;
+          }
+          block_[i] = current_;
+        }
+      }
+      return {block_.data(), nframes};
+    }
+
+    /// Is a ramp in progress?
+    ///
+    /// If not, all values of the last block are equal to the property value.
+    bool is_ramping() const noexcept
+    {
+      return remaining_ > 0;
+    }
+
+    /// The current smoothed value, i.e. the last value of the last block
+    value_type smoothed_value() const noexcept
+    {
+      return current_;
+    }
+
+    int ramp_frames = 480;
+
+  private:
+    std::array<value_type, max_block_size> block_;
+    value_type current_ = 0;
+    value_type ramp_target_ = 0;
+    value_type step_ = 0;
+    int remaining_ = 0;
+    bool initialized_ = false;
+  };
+
+} // namespace otto::core::props
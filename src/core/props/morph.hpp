@@ -0,0 +1,148 @@
+#pragma once
+
+#include <type_traits>
+#include <vector>
+
+#include <json.hpp>
+
+#include "core/props/props.hpp"
+#include "core/props/snapshot.hpp"
+#include "util/exception.hpp"
+#include "util/reflection.hpp"
+#include "util/serialize.hpp"
+
+namespace otto::core::props {
+
+  /// An interpolation between two sets of property values, parsed ahead of time
+  ///
+  /// @ref between parses two serialized states of an object, in the format of
+  /// `util::serialize`, into a flat list of its numeric properties with both of their values.
+  /// @ref apply then sets each property to a position between them, without parsing or
+  /// allocating, so it can be called from the audio thread for every buffer.
+  ///
+  /// Floating point properties are interpolated linearly. Integers, bools and enums switch
+  /// from the first value to the second at the midpoint. Properties of other types, and
+  /// properties with the same value in both states, are left out.
+  ///
+  /// Like a @ref Snapshot, the morph refers to the properties of the object it was made for,
+  /// so it is only valid as long as that object is alive.
+  struct Morph {
+    Morph() = default;
+
+    /// Parse `from` and `to`, both serialized from `obj`, into a morph of the properties of `obj`
+    ///
+    /// Members missing from either of them are left out of the morph.
+    ///
+    /// \throws `util::exception` or `nlohmann::json::exception` if the json does not match `obj`
+    template<typename Class>
+    static Morph between(Class& obj, const nlohmann::json& from, const nlohmann::json& to)
+    {
+      Morph res;
+      res.collect(obj, from, to);
+      return res;
+    }
+
+    /// Set each property to `position` between its two values
+    ///
+    /// `0` is the first state, and `1` is the second. Properties are only set if their value
+    /// changes, so their signals are not emitted for every call. The UI thread may set the same
+    /// properties meanwhile, see @ref AudioThreadQueue.
+    void apply(float position) const
+    {
+      for (auto& entry : _entries) entry.apply(entry, position);
+    }
+
+    /// The number of properties in the morph
+    std::size_t size() const noexcept
+    {
+      return _entries.size();
+    }
+
+    bool empty() const noexcept
+    {
+      return _entries.empty();
+    }
+
+  private:
+    struct Entry {
+      void* property;
+      void (*apply)(const Entry&, float);
+      double from;
+      double to;
+    };
+
+    template<typename Value>
+    static constexpr bool is_morphable = std::is_arithmetic_v<Value> || std::is_enum_v<Value>;
+
+    template<typename Value>
+    static double to_number(Value v) noexcept
+    {
+      if constexpr (std::is_enum_v<Value>) {
+        return static_cast<double>(static_cast<std::underlying_type_t<Value>>(v));
+      } else {
+        return static_cast<double>(v);
+      }
+    }
+
+    template<typename Value>
+    static Value from_number(double d) noexcept
+    {
+      if constexpr (std::is_enum_v<Value>) {
+        return static_cast<Value>(static_cast<std::underlying_type_t<Value>>(d));
+      } else if constexpr (std::is_same_v<Value, bool>) {
+        return d != 0;
+      } else {
+        return static_cast<Value>(d);
+      }
+    }
+
+    template<typename Class>
+    void collect(Class& obj, const nlohmann::json& from, const nlohmann::json& to)
+    {
+      if constexpr (is_property<Class>::value) {
+        using Value = typename Class::value_type;
+        if constexpr (is_morphable<Value>) {
+          using ::otto::util::deserialize;
+          Value a{};
+          Value b{};
+          deserialize(a, from);
+          deserialize(b, to);
+          if (a == b) return;
+          Entry entry;
+          entry.property = &obj;
+          entry.from = to_number(a);
+          entry.to = to_number(b);
+          entry.apply = [](const Entry& e, float pos) {
+            auto& prop = *static_cast<Class*>(e.property);
+            Value value;
+            if constexpr (std::is_floating_point_v<Value>) {
+              value = static_cast<Value>(e.from + (e.to - e.from) * pos);
+            } else {
+              value = from_number<Value>(pos < 0.5f ? e.from : e.to);
+            }
+            if (prop.get() != value) prop.set(value);
+          };
+          _entries.push_back(entry);
+        }
+      } else if constexpr (reflect::is_registered<Class>()) {
+        if (!from.is_object() || !to.is_object()) {
+          throw util::exception("Can't make a morph of {} from json: {} to {}",
+                                reflect::get_name<Class>(), from, to);
+        }
+        reflect::for_all_members<Class>([&](auto& member) {
+          auto name = std::string(member.get_name());
+          auto a = from.find(name);
+          auto b = to.find(name);
+          if (a == from.end() || a->is_null() || b == to.end() || b->is_null()) return;
+          if constexpr (std::decay_t<decltype(member)>::can_get_ref()) {
+            collect(member.get_ref(obj), *a, *b);
+          }
+        });
+      }
+      // Anything else is not a property, and not part of the morph
+    }
+
+    std::vector<Entry> _entries;
+  };
+
+} // namespace otto::core::props
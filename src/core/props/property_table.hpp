@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/span>
+
+#include "core/props/props.hpp"
+#include "core/props/snapshot.hpp"
+#include "util/exception.hpp"
+#include "util/reflection.hpp"
+#include "util/type_traits.hpp"
+
+namespace otto::core::props {
+
+  /// 32 bit FNV-1a hash, used for the ids of properties in a @ref PropertyTable
+  constexpr std::uint32_t hash_path(std::string_view path) noexcept
+  {
+    std::uint32_t hash = 2166136261u;
+    for (char c : path) {
+      hash ^= static_cast<std::uint8_t>(c);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  /// The kind of value of a property in a @ref PropertyTable
+  enum struct PropertyKind { floating, integer, boolean, enumeration };
+
+  /// A numeric property of a @ref PropertyTable
+  struct PropertyInfo {
+    /// The names of the members leading to the property, separated by `/`
+    std::string path;
+    /// `hash_path(path)`, which stays the same when properties are added or reordered
+    std::uint32_t hash;
+    /// The offset of the property from the start of the object the table is for
+    std::ptrdiff_t offset;
+    PropertyKind kind;
+    /// The limits of the property, or the limits of its type if it has none
+    double min;
+    double max;
+    /// The step size of the `steppable` property, or 0 if it is not steppable
+    ///
+    /// Properties with the `pow2` mixin are stepped by multiplying with the step size instead.
+    double step;
+    /// The values of an enum with named values, in its limits and in order, or empty
+    ///
+    /// Not every integer in the limits of such an enum is one of its values.
+    std::vector<double> values;
+    /// Get the value of the property at `property`, as a number
+    double (*get)(const void* property);
+    /// Set the value of the property at `property` from a number, rounding it if needed
+    void (*set)(void* property, double value);
+
+    /// The value the property can be set to closest to `value`
+    ///
+    /// Clamped to the limits, rounded for properties that are not floating point, and for
+    /// enums with named values, the closest of @ref values. Setting a property to it never
+    /// throws.
+    double nearest(double value) const noexcept
+    {
+      value = std::clamp(value, min, max);
+      if (kind == PropertyKind::floating) return value;
+      if (values.empty()) return std::round(value);
+      auto iter = std::lower_bound(values.begin(), values.end(), value);
+      if (iter == values.end() || (iter != values.begin() && value - iter[-1] < *iter - value)) {
+        iter--;
+      }
+      return *iter;
+    }
+  };
+
+  /// A flat table of the numeric properties of `Class`, to access them by index or hash
+  ///
+  /// The table is built once per type, by walking the reflected members of `Class` like
+  /// `util::serialize` does, and records the offset of each property. Accessing a property by
+  /// its index is then a pointer offset and a function call, with no string lookups, which
+  /// suits midi learn, automation and morphing. The hash of the path of a property is a
+  /// stable id, to store in files, see @ref to_binary.
+  ///
+  /// Properties of other types, like strings, are not in the table.
+  template<typename Class>
+  struct PropertyTable {
+    /// The table of `Class`, built from `obj` the first time it is called
+    ///
+    /// The offsets are the same for every object of the type, but the limits are those of
+    /// the first one.
+    static const PropertyTable& of(const Class& obj)
+    {
+      static const PropertyTable table(obj);
+      return table;
+    }
+
+    std::size_t size() const noexcept
+    {
+      return _entries.size();
+    }
+
+    const PropertyInfo& operator[](int index) const noexcept
+    {
+      return _entries[index];
+    }
+
+    auto begin() const noexcept
+    {
+      return _entries.begin();
+    }
+
+    auto end() const noexcept
+    {
+      return _entries.end();
+    }
+
+    /// The index of the property with hash `hash`, or -1
+    int find(std::uint32_t hash) const noexcept
+    {
+      auto iter = std::lower_bound(_by_hash.begin(), _by_hash.end(), hash,
+                                   [](auto& pair, std::uint32_t h) { return pair.first < h; });
+      if (iter == _by_hash.end() || iter->first != hash) return -1;
+      return iter->second;
+    }
+
+    /// The index of the property named `path`, like `"envelope/attack"`, or -1
+    int find(std::string_view path) const noexcept
+    {
+      int index = find(hash_path(path));
+      if (index < 0 || _entries[index].path != path) return -1;
+      return index;
+    }
+
+    /// The value of property `index` of `obj`
+    ///
+    /// Safe while another thread sets the property, like modulation on the audio thread.
+    double get(const Class& obj, int index) const noexcept
+    {
+      auto& entry = _entries[index];
+      return entry.get(reinterpret_cast<const char*>(&obj) + entry.offset);
+    }
+
+    /// Set property `index` of `obj` to `value`
+    void set(Class& obj, int index, double value) const
+    {
+      auto& entry = _entries[index];
+      entry.set(reinterpret_cast<char*>(&obj) + entry.offset, value);
+    }
+
+    /// The numeric properties of `obj`, as pairs of 32 bit hashes and 64 bit floats
+    ///
+    /// In native byte order, preceded by the 32 bit number of pairs.
+    std::vector<std::uint8_t> to_binary(const Class& obj) const
+    {
+      std::vector<std::uint8_t> res(sizeof(std::uint32_t) + _entries.size() * pair_size);
+      auto* out = res.data();
+      write(out, static_cast<std::uint32_t>(_entries.size()));
+      for (int i = 0; i < int(_entries.size()); i++) {
+        write(out, _entries[i].hash);
+        write(out, get(obj, i));
+      }
+      return res;
+    }
+
+    /// Set the properties of `obj` from the output of @ref to_binary
+    ///
+    /// Hashes of properties that no longer exist are ignored.
+    ///
+    /// \throws `util::exception` if `bytes` is truncated
+    void from_binary(Class& obj, gsl::span<const std::uint8_t> bytes) const
+    {
+      const auto* in = bytes.data();
+      const auto* end = in + bytes.size();
+      if (end - in < std::ptrdiff_t(sizeof(std::uint32_t)))
+        throw util::exception("Truncated binary properties");
+      auto count = read<std::uint32_t>(in);
+      if (std::size_t(end - in) < count * pair_size)
+        throw util::exception("Truncated binary properties");
+      for (std::uint32_t i = 0; i < count; i++) {
+        auto hash = read<std::uint32_t>(in);
+        auto value = read<double>(in);
+        if (int index = find(hash); index >= 0) set(obj, index, value);
+      }
+    }
+
+  private:
+    static constexpr std::size_t pair_size = sizeof(std::uint32_t) + sizeof(double);
+
+    PropertyTable(const Class& obj)
+    {
+      collect(obj, obj, "");
+      _by_hash.reserve(_entries.size());
+      for (int i = 0; i < int(_entries.size()); i++) _by_hash.emplace_back(_entries[i].hash, i);
+      std::sort(_by_hash.begin(), _by_hash.end());
+      auto dup = std::adjacent_find(_by_hash.begin(), _by_hash.end(),
+                                    [](auto& a, auto& b) { return a.first == b.first; });
+      if (dup != _by_hash.end()) {
+        throw util::exception("Properties '{}' and '{}' have the same hash",
+                              _entries[dup->second].path, _entries[(dup + 1)->second].path);
+      }
+    }
+
+    template<typename T>
+    static void write(std::uint8_t*& out, T value) noexcept
+    {
+      std::memcpy(out, &value, sizeof(T));
+      out += sizeof(T);
+    }
+
+    template<typename T>
+    static T read(const std::uint8_t*& in) noexcept
+    {
+      T value;
+      std::memcpy(&value, in, sizeof(T));
+      in += sizeof(T);
+      return value;
+    }
+
+    template<typename Value>
+    static constexpr PropertyKind kind_of() noexcept
+    {
+      if constexpr (std::is_same_v<Value, bool>) {
+        return PropertyKind::boolean;
+      } else if constexpr (std::is_floating_point_v<Value>) {
+        return PropertyKind::floating;
+      } else if constexpr (std::is_integral_v<Value>) {
+        return PropertyKind::integer;
+      } else {
+        return PropertyKind::enumeration;
+      }
+    }
+
+    template<typename Value>
+    static Value from_number(double d)
+    {
+      if constexpr (std::is_same_v<Value, bool>) {
+        return d >= 0.5;
+      } else if constexpr (std::is_floating_point_v<Value>) {
+        return static_cast<Value>(d);
+      } else if constexpr (util::BetterEnum::is<Value>) {
+        return Value::_from_integral(static_cast<util::enum_decay_t<Value>>(std::lround(d)));
+      } else {
+        return static_cast<Value>(static_cast<util::enum_decay_t<Value>>(std::lround(d)));
+      }
+    }
+
+    template<typename T>
+    void collect(const Class& root, const T& obj, const std::string& path)
+    {
+      if constexpr (is_property<T>::value) {
+        using Value = typename T::value_type;
+        if constexpr (std::is_arithmetic_v<Value> || util::is_number_or_enum_v<Value>) {
+          PropertyInfo info;
+          info.path = path;
+          info.hash = hash_path(path);
+          info.offset = reinterpret_cast<const char*>(&obj) - reinterpret_cast<const char*>(&root);
+          info.kind = kind_of<Value>();
+          if constexpr (T::template is<has_limits>) {
+            info.min = static_cast<double>(obj.template as<has_limits>().min);
+            info.max = static_cast<double>(obj.template as<has_limits>().max);
+          } else if constexpr (std::is_same_v<Value, bool>) {
+            info.min = 0;
+            info.max = 1;
+          } else {
+            using Limits = std::numeric_limits<util::enum_decay_t<Value>>;
+            info.min = static_cast<double>(Limits::lowest());
+            info.max = static_cast<double>(Limits::max());
+          }
+          if constexpr (util::BetterEnum::is<Value>) {
+            for (Value v : Value::_values()) {
+              auto d = static_cast<double>(v._to_integral());
+              if (d >= info.min && d <= info.max) info.values.push_back(d);
+            }
+            std::sort(info.values.begin(), info.values.end());
+          }
+          if constexpr (T::template is<steppable>) {
+            info.step = static_cast<double>(obj.template as<steppable>().step_size);
+          } else {
+            info.step = 0;
+          }
+          info.get = [](const void* p) -> double {
+            return static_cast<double>(util::underlying(static_cast<const T*>(p)->load_value()));
+          };
+          info.set = [](void* p, double value) {
+            static_cast<T*>(p)->set(from_number<Value>(value));
+          };
+          _entries.push_back(std::move(info));
+        }
+      } else if constexpr (reflect::is_registered<T>()) {
+        reflect::for_all_members<T>([&](auto& member) {
+          // Only members accessed by reference have an offset
+          if constexpr (std::decay_t<decltype(member)>::can_get_ref()) {
+            auto name = std::string(member.get_name());
+            collect(root, member.get(obj), path.empty() ? name : path + "/" + name);
+          }
+        });
+      }
+      // Anything else is not a property, and not part of the table
+    }
+
+    std::vector<PropertyInfo> _entries;
+    /// Pairs of hashes and indices, sorted by hash
+    std::vector<std::pair<std::uint32_t, int>> _by_hash;
+  };
+
+} // namespace otto::core::props
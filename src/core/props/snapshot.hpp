@@ -0,0 +1,301 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <json.hpp>
+
+#include "core/props/props.hpp"
+#include "util/exception.hpp"
+#include "util/reflection.hpp"
+#include "util/serialize.hpp"
+#include "util/type_traits.hpp"
+
+namespace otto::core::props {
+
+  template<typename T>
+  struct is_property : std::false_type {};
+
+  template<typename ValueType, typename TagList>
+  struct is_property<PropertyImpl<ValueType, TagList>> : std::true_type {};
+
+  /// The values of a set of properties, parsed ahead of time, ready to be set
+  ///
+  /// @ref capture parses serialized state, in the format of `util::serialize`, into a flat
+  /// list of properties of an object and their values. @ref apply then sets them, without
+  /// parsing anything, or allocating for properties of trivially copyable types up to
+  /// @ref inline_size bytes, which covers numbers, bools and enums. Larger values are
+  /// allocated once by @ref capture, and copied on each apply.
+  ///
+  /// The snapshot refers to the properties of the object it was captured for, so it is only
+  /// valid as long as that object is alive. A snapshot made with @ref take can also be
+  /// restored to, and serialized for, another object of the same type.
+  struct Snapshot {
+    static constexpr std::size_t inline_size = 16;
+
+    Snapshot() = default;
+
+    /// Parse `json`, as serialized from `obj`, into a snapshot of the properties of `obj`
+    ///
+    /// Members missing from `json` are left out of the snapshot.
+    ///
+    /// \throws `util::exception` or `nlohmann::json::exception` if `json` does not match `obj`
+    template<typename Class>
+    static Snapshot capture(Class& obj, const nlohmann::json& json)
+    {
+      Snapshot res;
+      res.collect(obj, json);
+      return res;
+    }
+
+    /// Copy the current values of the properties of `obj`, and of its other reflected members
+    ///
+    /// Covers everything `util::serialize(obj)` would, except members reached through a
+    /// setter, but holds the values themselves, so neither taking nor restoring the snapshot
+    /// parses anything, or allocates for values that fit inline.
+    ///
+    /// \throws `util::exception` if a member is not stored inside `obj`, since it could not be
+    /// found in another object of the type
+    template<typename Class>
+    static Snapshot take(Class& obj)
+    {
+      Snapshot res;
+      res._object = &obj;
+      res._type = &type_tag<Class>;
+      res.save(obj);
+      for (auto& entry : res._entries) {
+        auto offset = static_cast<char*>(entry.property) - reinterpret_cast<char*>(&obj);
+        if (offset < 0 || offset >= std::ptrdiff_t(sizeof(Class))) {
+          throw util::exception("Can't take a snapshot of {}, which has members outside it",
+                                reflect::get_name<Class>());
+        }
+      }
+      return res;
+    }
+
+    /// Set each property to its value in the snapshot
+    ///
+    /// In a @ref BulkUpdate, so each signal is emitted once all properties are set.
+    void apply() const
+    {
+      BulkUpdate bulk;
+      for (auto& entry : _entries) entry.apply(entry, entry.property, false);
+    }
+
+    /// Set the properties of `obj` to their values in a snapshot made with @ref take
+    ///
+    /// `obj` may be another object of the type the snapshot was taken of. Only the values that
+    /// differ from those of `obj` are set, so the signals of properties that are already right
+    /// are not emitted. Like @ref apply, in a @ref BulkUpdate.
+    ///
+    /// \throws `util::exception` if the snapshot was not taken of a `Class`
+    template<typename Class>
+    void restore(Class& obj) const
+    {
+      check_type<Class>();
+      BulkUpdate bulk;
+      for (auto& entry : _entries) entry.apply(entry, relocate(entry, &obj), true);
+    }
+
+    /// Serialize a snapshot made with @ref take, as `util::serialize` would have serialized
+    /// the object when it was taken
+    ///
+    /// \throws `util::exception` if the snapshot was not taken of a `Class`
+    template<typename Class>
+    nlohmann::json to_json() const
+    {
+      check_type<Class>();
+      nlohmann::json res;
+      auto iter = _entries.begin();
+      emit<Class>(res, iter);
+      return res;
+    }
+
+    /// The number of properties in the snapshot
+    std::size_t size() const noexcept
+    {
+      return _entries.size();
+    }
+
+    bool empty() const noexcept
+    {
+      return _entries.empty();
+    }
+
+  private:
+    struct Entry {
+      void* property;
+      /// Set the property at `property` to the value, if it differs or `if_changed` is false
+      void (*apply)(const Entry&, void* property, bool if_changed);
+      /// Serialize the value. Only set by @ref take.
+      nlohmann::json (*serialize)(const Entry&);
+      alignas(std::max_align_t) std::array<std::byte, inline_size> storage;
+      /// Holds the value if it does not fit in `storage`
+      std::shared_ptr<const void> owned;
+
+      const void* value() const noexcept
+      {
+        return owned ? owned.get() : storage.data();
+      }
+    };
+
+    template<typename T>
+    static inline const char type_tag = 0;
+
+    template<typename T>
+    struct is_std_array : std::false_type {};
+
+    template<typename T, std::size_t N>
+    struct is_std_array<std::array<T, N>> : std::true_type {};
+
+    template<typename Class>
+    void check_type() const
+    {
+      if (_type != &type_tag<Class>) {
+        throw util::exception("Snapshot was not taken of a {}", reflect::get_name<Class>());
+      }
+    }
+
+    /// The address in `obj` of the property of `entry`
+    void* relocate(const Entry& entry, void* obj) const noexcept
+    {
+      return static_cast<char*>(obj) + (static_cast<char*>(entry.property) - static_cast<const char*>(_object));
+    }
+
+    /// Store `value` in `entry`
+    template<typename Value>
+    static void store(Entry& entry, Value&& value)
+    {
+      using V = std::decay_t<Value>;
+      if constexpr (fits_inline<V>) {
+        new (entry.storage.data()) V(std::forward<Value>(value));
+      } else {
+        entry.owned = std::make_shared<const V>(std::forward<Value>(value));
+      }
+    }
+
+    /// Whether the value of `entry` is equal to `current`
+    template<typename Value>
+    static bool unchanged(const Entry& entry, const Value& current)
+    {
+      if constexpr (util::is_equal_comparable_v<Value>) {
+        return *static_cast<const Value*>(entry.value()) == current;
+      } else {
+        return false;
+      }
+    }
+
+    /// Add the values of `obj` to the snapshot, in the order @ref emit serializes them
+    template<typename T>
+    void save(T& obj)
+    {
+      Entry entry;
+      entry.property = &obj;
+      if constexpr (is_property<T>::value) {
+        using Value = typename T::value_type;
+        entry.apply = [](const Entry& e, void* property, bool if_changed) {
+          auto& prop = *static_cast<T*>(property);
+          if (if_changed && unchanged(e, prop.get())) return;
+          prop.set(*static_cast<const Value*>(e.value()));
+        };
+        entry.serialize = [](const Entry& e) {
+          using ::otto::util::serialize;
+          return serialize(*static_cast<const Value*>(e.value()));
+        };
+        store(entry, obj.get());
+        _entries.push_back(std::move(entry));
+      } else if constexpr (reflect::is_registered<T>()) {
+        reflect::for_all_members<T>([&](auto& member) {
+          if constexpr (std::decay_t<decltype(member)>::can_get_ref()) {
+            save(member.get_ref(obj));
+          }
+        });
+      } else if constexpr (is_std_array<T>::value) {
+        for (auto& elem : obj) save(elem);
+      } else {
+        // Any other member is copied as a whole
+        entry.apply = [](const Entry& e, void* member, bool if_changed) {
+          auto& m = *static_cast<T*>(member);
+          if (if_changed && unchanged(e, m)) return;
+          m = *static_cast<const T*>(e.value());
+        };
+        entry.serialize = [](const Entry& e) {
+          using ::otto::util::serialize;
+          return serialize(*static_cast<const T*>(e.value()));
+        };
+        store(entry, obj);
+        _entries.push_back(std::move(entry));
+      }
+    }
+
+    /// Serialize the entries from `iter` as the members of a `T`, walking them like @ref save
+    template<typename T>
+    static void emit(nlohmann::json& json, std::vector<Entry>::const_iterator& iter)
+    {
+      if constexpr (is_property<T>::value || !(reflect::is_registered<T>() || is_std_array<T>::value)) {
+        json = iter->serialize(*iter);
+        ++iter;
+      } else if constexpr (reflect::is_registered<T>()) {
+        reflect::for_all_members<T>([&](auto& member) {
+          if constexpr (std::decay_t<decltype(member)>::can_get_ref()) {
+            using MemberT = reflect::get_member_type<decltype(member)>;
+            emit<MemberT>(json[std::string(member.get_name())], iter);
+          }
+        });
+      } else {
+        for (std::size_t i = 0; i < std::tuple_size_v<T>; i++) {
+          emit<typename T::value_type>(json[i], iter);
+        }
+      }
+    }
+
+    template<typename Value>
+    static constexpr bool fits_inline =
+      std::is_trivially_copyable_v<Value> && sizeof(Value) <= inline_size &&
+      alignof(Value) <= alignof(std::max_align_t);
+
+    template<typename Class>
+    void collect(Class& obj, const nlohmann::json& json)
+    {
+      if constexpr (is_property<Class>::value) {
+        using Value = typename Class::value_type;
+        using ::otto::util::deserialize;
+        Value value{};
+        deserialize(value, json);
+        Entry entry;
+        entry.property = &obj;
+        entry.apply = [](const Entry& e, void* property, bool if_changed) {
+          auto& prop = *static_cast<Class*>(property);
+          if (if_changed && unchanged(e, prop.get())) return;
+          prop.set(*static_cast<const Value*>(e.value()));
+        };
+        entry.serialize = nullptr;
+        store(entry, std::move(value));
+        _entries.push_back(std::move(entry));
+      } else if constexpr (reflect::is_registered<Class>()) {
+        if (!json.is_object()) {
+          throw util::exception("Can't make a snapshot of {} from json: {}",
+                                reflect::get_name<Class>(), json);
+        }
+        reflect::for_all_members<Class>([&](auto& member) {
+          auto iter = json.find(std::string(member.get_name()));
+          if (iter == json.end() || iter->is_null()) return;
+          if constexpr (std::decay_t<decltype(member)>::can_get_ref()) {
+            collect(member.get_ref(obj), *iter);
+          }
+        });
+      }
+      // Anything else is not a property, and not part of the snapshot
+    }
+
+    std::vector<Entry> _entries;
+    /// The object the snapshot was made for
+    const void* _object = nullptr;
+    /// `&type_tag<Class>` of the class of `_object`
+    const void* _type = nullptr;
+  };
+
+} // namespace otto::core::props
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <type_traits>
 #include <valarray>
+#include <vector>
 
 #pragma GCC diagnostic push 
 #pragma GCC diagnostic ignored "-Wpedantic"
@@ -11,6 +17,7 @@
 #include <NanoCanvas.h>
 #pragma GCC diagnostic pop
 
+#include "util/algorithm.hpp"
 #include "util/math.hpp"
 #include "util/iterator.hpp"
 
@@ -229,6 +236,29 @@ namespace otto::core::ui::vg {
   };
 
   struct Canvas; // FWDCL
+  struct Layer; // FWDCL
+
+  /// An offscreen image that a @ref Layer is rendered into
+  ///
+  /// Rendering to an image depends on the graphics backend, so these are made by the board,
+  /// through @ref Canvas::layer_factory.
+  struct LayerTarget {
+    virtual ~LayerTarget() = default;
+
+    /// The nanovg image of the target
+    virtual int image() const = 0;
+
+    /// Render to the target, cleared to transparent, until @ref unbind
+    ///
+    /// Sets the viewport to the size of the target.
+    virtual void bind() = 0;
+
+    /// Render to whatever was bound before @ref bind again
+    virtual void unbind() = 0;
+  };
+
+  /// Makes a @ref LayerTarget of `width` x `height` pixels, or returns `nullptr`
+  using LayerFactory = std::function<std::unique_ptr<LayerTarget>(int width, int height)>;
 
   /// Anything that can be drawn on screen.
   ///
@@ -262,7 +292,7 @@ namespace otto::core::ui::vg {
       Canvas(ctx, size.w, size.h, scaleRatio) {}
 
     Canvas(NVGcontext* ctx, float width, float height, float scaleRatio = 1.0f) :
-      Super(ctx, width, height, scaleRatio) {}
+      Super(ctx, width, height, scaleRatio), _nvg(ctx), _pixel_ratio(scaleRatio) {}
 
     /// Canvas is non-copyable
     Canvas(const Canvas&) = delete;
@@ -279,6 +309,27 @@ namespace otto::core::ui::vg {
       return {m_width, m_height};
     }
 
+    /// The nanovg context drawn to
+    NVGcontext* nvg() const noexcept {
+      return _nvg;
+    }
+
+    /// The pixels of the framebuffer per unit of the canvas, which is more than one on HiDPI
+    /// displays
+    float pixel_ratio() const noexcept {
+      return _pixel_ratio;
+    }
+
+    /// Creates the images that layers are cached in. Set by the board.
+    ///
+    /// Without it, layers are drawn directly every frame.
+    LayerFactory layer_factory;
+
+    /// Render the layers that changed since the last frame into their images
+    ///
+    /// To be called by the board before each frame, outside of `begineFrame` and `endFrame`.
+    void render_layers();
+
     using Super::moveTo;
     Canvas& moveTo(Point p) {
       Super::moveTo(p.x, p.y);
@@ -559,6 +610,256 @@ namespace otto::core::ui::vg {
       fill(c);
       return *this;
     }
+
+  private:
+    friend Layer;
+
+    NVGcontext* _nvg;
+    float _pixel_ratio;
+    /// The layers to render in @ref render_layers
+    std::vector<Layer*> _pending_layers;
   };
 
+  /// A path that is recorded once, and added to a canvas with a single call
+  ///
+  /// Records the path calls of @ref Canvas, with the same names, so code written against a
+  /// canvas can build a path instead. Since a path knows its bounds, fixed geometry can be
+  /// cached in a @ref Layer of just that size, and only rendered again when its colours change.
+  ///
+  /// Like on a canvas, @ref beginPath discards what was recorded before.
+  struct Path {
+    Path& beginPath()
+    {
+      _commands.clear();
+      _bounded = false;
+      return *this;
+    }
+
+    Path& moveTo(float x, float y)
+    {
+      return add(Op::move, {x, y}, x, y, x, y);
+    }
+
+    Path& lineTo(float x, float y)
+    {
+      return add(Op::line, {x, y}, x, y, x, y);
+    }
+
+    Path& bezierCurveTo(float cp1x, float cp1y, float cp2x, float cp2y, float x, float y)
+    {
+      // The curve lies within the hull of its control points
+      return add(Op::bezier, {cp1x, cp1y, cp2x, cp2y, x, y}, std::min({cp1x, cp2x, x}),
+                 std::min({cp1y, cp2y, y}), std::max({cp1x, cp2x, x}), std::max({cp1y, cp2y, y}));
+    }
+
+    Path& arc(float x, float y, float r, float sAngle, float eAngle, bool counterclockwise = false)
+    {
+      return add(counterclockwise ? Op::arc_ccw : Op::arc, {x, y, r, sAngle, eAngle}, x - r, y - r,
+                 x + r, y + r);
+    }
+
+    Path& rect(float x, float y, float w, float h)
+    {
+      return add(Op::rect, {x, y, w, h}, x, y, x + w, y + h);
+    }
+
+    Path& closePath()
+    {
+      _commands.push_back({Op::close, {}});
+      return *this;
+    }
+
+    Path& pathWinding(Winding dir)
+    {
+      _commands.push_back({Op::winding, {float(static_cast<int>(dir))}});
+      return *this;
+    }
+
+    bool empty() const noexcept
+    {
+      return _commands.empty();
+    }
+
+    /// The smallest box around every point of the path, and the control points of its curves
+    Box bounds() const noexcept
+    {
+      if (!_bounded) return {};
+      return {Point(_min_x, _min_y), Point(_max_x, _max_y)};
+    }
+
+    /// Add the recorded calls to the current path of `ctx`
+    void add_to(Canvas& ctx) const
+    {
+      for (auto& [op, a] : _commands) {
+        switch (op) {
+          case Op::move: ctx.moveTo(a[0], a[1]); break;
+          case Op::line: ctx.lineTo(a[0], a[1]); break;
+          case Op::bezier: ctx.bezierCurveTo(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+          case Op::arc: ctx.arc(a[0], a[1], a[2], a[3], a[4], false); break;
+          case Op::arc_ccw: ctx.arc(a[0], a[1], a[2], a[3], a[4], true); break;
+          case Op::rect: ctx.rect(a[0], a[1], a[2], a[3]); break;
+          case Op::close: ctx.closePath(); break;
+          case Op::winding: ctx.pathWinding(static_cast<Winding>(int(a[0]))); break;
+        }
+      }
+    }
+
+  private:
+    enum struct Op : std::uint8_t { move, line, bezier, arc, arc_ccw, rect, close, winding };
+
+    struct Command {
+      Op op;
+      std::array<float, 6> args;
+    };
+
+    Path& add(Op op, std::array<float, 6> args, float x0, float y0, float x1, float y1)
+    {
+      if (!_bounded) {
+        _min_x = x0, _min_y = y0, _max_x = x1, _max_y = y1;
+        _bounded = true;
+      } else {
+        _min_x = std::min(_min_x, x0);
+        _min_y = std::min(_min_y, y0);
+        _max_x = std::max(_max_x, x1);
+        _max_y = std::max(_max_y, y1);
+      }
+      _commands.push_back({op, args});
+      return *this;
+    }
+
+    std::vector<Command> _commands;
+    bool _bounded = false;
+    float _min_x = 0, _min_y = 0, _max_x = 0, _max_y = 0;
+  };
+
+  /// A drawing that is cached in an image, for the static parts of screens
+  ///
+  /// The first time a layer is drawn, and whenever its key changes, the drawing function draws
+  /// directly to the canvas, and the layer is rendered into its image before the next frame.
+  /// After that, drawing the layer fills a rectangle with the image, instead of tessellating
+  /// all the paths again. The key should combine everything the drawing depends on, like the
+  /// properties it shows, see @ref key. Anything that changes every frame should be drawn on
+  /// top, outside the layer.
+  ///
+  /// The drawing function is kept until the layer is rendered, after the frame has ended, so it
+  /// must not capture locals by reference.
+  ///
+  /// ```cpp
+  /// float shimmer = props.shimmer.normalize();
+  /// stars.draw(ctx, Layer::key(shimmer), [this, shimmer](Canvas& ctx) { draw_stars(ctx, shimmer); });
+  /// ```
+  struct Layer {
+    using DrawFunc = std::function<void(Canvas&)>;
+
+    /// `size` is the area the layer covers, from the origin of the current transform
+    explicit Layer(Size size) : _size(size) {}
+
+    Layer(const Layer&) = delete;
+    Layer& operator=(const Layer&) = delete;
+
+    ~Layer()
+    {
+      if (_pending_in != nullptr) util::erase(_pending_in->_pending_layers, this);
+    }
+
+    /// Draw the layer, from its image if `key` is the key it was rendered with
+    void draw(Canvas& ctx, std::size_t key, DrawFunc func)
+    {
+      NVGcontext* vg = ctx.nvg();
+      float xform[6];
+      nvgCurrentTransform(vg, xform);
+      // Render at the resolution it is shown at, in pixels of the framebuffer
+      float scale = std::sqrt(xform[0] * xform[0] + xform[1] * xform[1]) * ctx.pixel_ratio();
+      if (_target != nullptr && _rendered && key == _key && scale == _scale) {
+        nvgSave(vg);
+        nvgBeginPath(vg);
+        nvgRect(vg, 0, 0, _size.w, _size.h);
+        nvgFillPaint(vg, nvgImagePattern(vg, 0, 0, _size.w, _size.h, 0, _target->image(), 1));
+        nvgFill(vg);
+        nvgRestore(vg);
+        return;
+      }
+      ctx.group([&] { func(ctx); });
+      if (!ctx.layer_factory) return;
+      _key = key;
+      _scale = scale;
+      _rendered = false;
+      _func = std::move(func);
+      if (_pending_in == nullptr) {
+        _pending_in = &ctx;
+        ctx._pending_layers.push_back(this);
+      }
+    }
+
+    /// Render the layer again, even if the key is unchanged
+    void invalidate() noexcept
+    {
+      _rendered = false;
+    }
+
+    /// Combine the hashes of `args` into a key
+    template<typename... Args>
+    static std::size_t key(const Args&... args)
+    {
+      std::size_t seed = 0;
+      (combine(seed, std::hash<Args>()(args)), ...);
+      return seed;
+    }
+
+    /// Combine `hash` into `seed`, like `boost::hash_combine`
+    static void combine(std::size_t& seed, std::size_t hash) noexcept
+    {
+      seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+  private:
+    friend Canvas;
+
+    /// Render the function into the image. Called by @ref Canvas::render_layers
+    void render(Canvas& ctx)
+    {
+      _pending_in = nullptr;
+      int width = std::ceil(_size.w * _scale);
+      int height = std::ceil(_size.h * _scale);
+      if (_target == nullptr || _target_width != width || _target_height != height) {
+        _target = ctx.layer_factory(width, height);
+        _target_width = width;
+        _target_height = height;
+      }
+      if (_target == nullptr) return;
+      NVGcontext* vg = ctx.nvg();
+      _target->bind();
+      nvgBeginFrame(vg, width, height, 1);
+      nvgScale(vg, _scale, _scale);
+      func_group(ctx);
+      nvgEndFrame(vg);
+      _target->unbind();
+      _rendered = true;
+      _func = nullptr;
+    }
+
+    void func_group(Canvas& ctx)
+    {
+      ctx.group([&] { _func(ctx); });
+    }
+
+    Size _size;
+    std::size_t _key = 0;
+    float _scale = 1;
+    bool _rendered = false;
+    DrawFunc _func;
+    std::unique_ptr<LayerTarget> _target;
+    int _target_width = 0;
+    int _target_height = 0;
+    /// The canvas the layer is waiting to be rendered on, if any
+    Canvas* _pending_in = nullptr;
+  };
+
+  inline void Canvas::render_layers()
+  {
+    auto layers = std::move(_pending_layers);
+    _pending_layers.clear();
+    for (Layer* layer : layers) layer->render(*this);
+  }
+
 } // otto::ui::drawing
@@ -0,0 +1,104 @@
+#include "draw_stats.hpp"
+
+#include <memory>
+#include <vector>
+
+#include "services/log_manager.hpp"
+#include "util/algorithm.hpp"
+
+namespace otto::core::ui::vg {
+
+  namespace {
+
+    /// A context that is being counted, and the render callbacks it had before
+    struct Counted {
+      NVGcontext* ctx;
+      void* user;
+      DrawStats stats;
+      decltype(NVGparams::renderFill) fill;
+      decltype(NVGparams::renderStroke) stroke;
+      decltype(NVGparams::renderTriangles) triangles;
+      decltype(NVGparams::renderDelete) render_delete;
+    };
+
+    /// The backends call back with their own user pointer, which identifies the context
+    std::vector<std::unique_ptr<Counted>> counted;
+
+    Counted& find(void* user)
+    {
+      for (auto& c : counted) {
+        if (c->user == user) return *c;
+      }
+      OTTO_UNREACHABLE;
+    }
+
+    void fill(void* user,
+              NVGpaint* paint,
+              NVGcompositeOperationState op,
+              NVGscissor* scissor,
+              float fringe,
+              const float* bounds,
+              const NVGpath* paths,
+              int npaths)
+    {
+      auto& c = find(user);
+      c.stats.fills++;
+      // Including the antialiasing fringes
+      for (int i = 0; i < npaths; i++) c.stats.vertices += paths[i].nfill + paths[i].nstroke;
+      c.fill(user, paint, op, scissor, fringe, bounds, paths, npaths);
+    }
+
+    void stroke(void* user,
+                NVGpaint* paint,
+                NVGcompositeOperationState op,
+                NVGscissor* scissor,
+                float fringe,
+                float stroke_width,
+                const NVGpath* paths,
+                int npaths)
+    {
+      auto& c = find(user);
+      c.stats.strokes++;
+      for (int i = 0; i < npaths; i++) c.stats.vertices += paths[i].nstroke;
+      c.stroke(user, paint, op, scissor, fringe, stroke_width, paths, npaths);
+    }
+
+    void triangles(void* user,
+                   NVGpaint* paint,
+                   NVGcompositeOperationState op,
+                   NVGscissor* scissor,
+                   const NVGvertex* verts,
+                   int nverts)
+    {
+      auto& c = find(user);
+      c.stats.triangles++;
+      c.stats.vertices += nverts;
+      c.triangles(user, paint, op, scissor, verts, nverts);
+    }
+
+    void render_delete(void* user)
+    {
+      auto render_delete = find(user).render_delete;
+      util::erase_if(counted, [user](auto& c) { return c->user == user; });
+      render_delete(user);
+    }
+
+  } // namespace
+
+  const DrawStats& draw_stats(NVGcontext* ctx)
+  {
+    for (auto& c : counted) {
+      if (c->ctx == ctx) return c->stats;
+    }
+    NVGparams* params = nvgInternalParams(ctx);
+    auto& c = *counted.emplace_back(std::make_unique<Counted>(Counted{
+      ctx, params->userPtr, {}, params->renderFill, params->renderStroke, params->renderTriangles,
+      params->renderDelete}));
+    params->renderFill = fill;
+    params->renderStroke = stroke;
+    params->renderTriangles = triangles;
+    params->renderDelete = render_delete;
+    return c.stats;
+  }
+
+} // namespace otto::core::ui::vg
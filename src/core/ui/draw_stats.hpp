@@ -0,0 +1,37 @@
+#pragma once
+
+#include "core/ui/canvas.hpp"
+
+namespace otto::core::ui::vg {
+
+  /// The number of draw calls and vertices a nanovg context has rendered
+  ///
+  /// Counted in the render backend, so it works the same for GLES2, GL3 and the
+  /// @ref SoftRenderer. Take the difference of two snapshots to get the cost of what was drawn
+  /// in between.
+  struct DrawStats {
+    int fills = 0;
+    int strokes = 0;
+    /// Text, which nanovg renders as textured triangles
+    int triangles = 0;
+    int vertices = 0;
+
+    int draw_calls() const noexcept
+    {
+      return fills + strokes + triangles;
+    }
+
+    DrawStats operator-(const DrawStats& rhs) const noexcept
+    {
+      return {fills - rhs.fills, strokes - rhs.strokes, triangles - rhs.triangles, vertices - rhs.vertices};
+    }
+  };
+
+  /// The draw calls `ctx` has rendered so far
+  ///
+  /// The first call starts counting, by wrapping the render callbacks of `ctx`, and returns
+  /// zeroes. Counting stops when the context is deleted. Only call this from the thread that
+  /// draws.
+  const DrawStats& draw_stats(NVGcontext* ctx);
+
+} // namespace otto::core::ui::vg
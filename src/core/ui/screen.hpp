@@ -1,5 +1,9 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <tuple>
+
 #include "core/ui/canvas.hpp"
 #include "services/controller.hpp"
 
@@ -56,6 +60,95 @@ namespace otto::core::ui {
 
     /// Run by MainUI when switching to another screen
     virtual void on_hide() {}
+
+    /// Whether the screen changes by itself, without input or changes to properties
+    ///
+    /// The screen is only redrawn when something changes, see
+    /// `services::UIManager::update_frame`. Screens that show the playback position, or values
+    /// written by the audio thread without a property, return true while those change, to be
+    /// redrawn every frame.
+    virtual bool animating()
+    {
+      return false;
+    }
+  };
+
+  /// A screen that shows nothing, and takes no input
+  struct NullScreen final : Screen {
+    void draw(vg::Canvas&) override {}
   };
 
+  /// Construct a screen of type `S`, or a @ref NullScreen in headless builds
+  ///
+  /// Engines and services make their screens with this, so boards without a display, built
+  /// with `OTTO_HEADLESS`, skip constructing them. Nothing may rely on the dynamic type of a
+  /// screen made this way in headless builds.
+  template<typename S, typename... Args>
+  std::unique_ptr<Screen> make_screen(Args&&... args)
+  {
+#if OTTO_HEADLESS
+    return std::make_unique<NullScreen>();
+#else
+    return std::make_unique<S>(std::forward<Args>(args)...);
+#endif
+  }
+
+  /// Owns a screen, which is constructed the first time it is used
+  ///
+  /// Engines are constructed on every switch, most of them never to be shown, so they hold
+  /// their screens like this, see @ref lazy_screen. Only to be used from the UI thread.
+  struct LazyScreen {
+    using Factory = std::function<std::unique_ptr<Screen>()>;
+
+    /// Without a screen. Only for engines that are never shown, like in tests.
+    LazyScreen(std::nullptr_t = nullptr) noexcept {}
+    LazyScreen(Factory factory) noexcept : _factory(std::move(factory)) {}
+
+    /// The screen, constructed if it has not been
+    Screen& get()
+    {
+      if (!_screen) _screen = _factory();
+      return *_screen;
+    }
+
+    Screen& operator*()
+    {
+      return get();
+    }
+
+    Screen* operator->()
+    {
+      return &get();
+    }
+
+    /// Whether the screen is constructed
+    bool constructed() const noexcept
+    {
+      return _screen != nullptr;
+    }
+
+    /// Destroy the screen, to be constructed again when it is next used
+    ///
+    /// It must not be displayed.
+    void reset() noexcept
+    {
+      _screen.reset();
+    }
+
+  private:
+    Factory _factory;
+    std::unique_ptr<Screen> _screen;
+  };
+
+  /// A @ref LazyScreen of type `S`, which is constructed from `args` with @ref make_screen
+  ///
+  /// `args` are stored until then, by reference if they are lvalues.
+  template<typename S, typename... Args>
+  LazyScreen lazy_screen(Args&&... args)
+  {
+    return LazyScreen([args = std::tuple<Args...>(std::forward<Args>(args)...)] {
+      return std::apply([](auto&&... a) { return make_screen<S>(a...); }, args);
+    });
+  }
+
 } // namespace otto::core::ui
@@ -0,0 +1,583 @@
+#include "soft_renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OTTO_SOFT_RENDERER_NEON 1
+#else
+#define OTTO_SOFT_RENDERER_NEON 0
+#endif
+
+#include "util/exception.hpp"
+
+namespace otto::core::ui::vg {
+
+  namespace soft {
+    /// Straight (not premultiplied) colour, from 0 to 1
+    struct Rgba {
+      float r = 0, g = 0, b = 0, a = 0;
+    };
+  } // namespace soft
+
+  using soft::Rgba;
+
+  namespace {
+
+    /// `x / 255`, rounded, for `x` up to `255 * 255`
+    inline int div255(int x) noexcept
+    {
+      x += 128;
+      return (x + (x >> 8)) >> 8;
+    }
+
+    /// Blend the colour `r, g, b`, in 5, 6 and 5 bits, into `dst` by `alpha`
+    inline std::uint16_t blend565(std::uint16_t dst, int r, int g, int b, int alpha) noexcept
+    {
+      int ia = 255 - alpha;
+      int dr = div255((dst >> 11) * ia + r * alpha);
+      int dg = div255(((dst >> 5) & 0x3F) * ia + g * alpha);
+      int db = div255((dst & 0x1F) * ia + b * alpha);
+      return std::uint16_t((dr << 11) | (dg << 5) | db);
+    }
+
+    /// Blend a solid colour into a row of `dst`, by the alpha of each pixel
+    void blend_span(std::uint16_t* dst, const std::uint8_t* alpha, int n, int r, int g, int b) noexcept
+    {
+      int i = 0;
+#if OTTO_SOFT_RENDERER_NEON
+      const uint16x8_t vr = vdupq_n_u16(r);
+      const uint16x8_t vg = vdupq_n_u16(g);
+      const uint16x8_t vb = vdupq_n_u16(b);
+      const uint16x8_t v255 = vdupq_n_u16(255);
+      const uint16x8_t v128 = vdupq_n_u16(128);
+      auto div = [&](uint16x8_t x) {
+        x = vaddq_u16(x, v128);
+        return vshrq_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+      };
+      for (; i + 8 <= n; i += 8) {
+        uint16x8_t a = vmovl_u8(vld1_u8(alpha + i));
+        uint16x8_t ia = vsubq_u16(v255, a);
+        uint16x8_t d = vld1q_u16(dst + i);
+        uint16x8_t dr = vshrq_n_u16(d, 11);
+        uint16x8_t dg = vandq_u16(vshrq_n_u16(d, 5), vdupq_n_u16(0x3F));
+        uint16x8_t db = vandq_u16(d, vdupq_n_u16(0x1F));
+        dr = div(vmlaq_u16(vmulq_u16(dr, ia), vr, a));
+        dg = div(vmlaq_u16(vmulq_u16(dg, ia), vg, a));
+        db = div(vmlaq_u16(vmulq_u16(db, ia), vb, a));
+        vst1q_u16(dst + i, vorrq_u16(vorrq_u16(vshlq_n_u16(dr, 11), vshlq_n_u16(dg, 5)), db));
+      }
+#endif
+      const std::uint16_t solid = std::uint16_t((r << 11) | (g << 5) | b);
+      for (; i < n; i++) {
+        if (alpha[i] == 255) dst[i] = solid;
+        else if (alpha[i] != 0) dst[i] = blend565(dst[i], r, g, b, alpha[i]);
+      }
+    }
+
+    inline Rgba to_rgba(const NVGcolor& c) noexcept
+    {
+      return {c.r, c.g, c.b, c.a};
+    }
+
+    inline float clamp01(float f) noexcept
+    {
+      return std::min(1.f, std::max(0.f, f));
+    }
+
+    inline void transform(const float* t, float x, float y, float& ox, float& oy) noexcept
+    {
+      ox = x * t[0] + y * t[2] + t[4];
+      oy = x * t[1] + y * t[3] + t[5];
+    }
+
+    /// Signed distance from `x, y` to a rounded rectangle centered on the origin
+    inline float sdroundrect(float x, float y, float ex, float ey, float rad) noexcept
+    {
+      float dx = std::abs(x) - (ex - rad);
+      float dy = std::abs(y) - (ey - rad);
+      float ox = std::max(dx, 0.f);
+      float oy = std::max(dy, 0.f);
+      return std::min(std::max(dx, dy), 0.f) + std::sqrt(ox * ox + oy * oy) - rad;
+    }
+
+  } // namespace
+
+  /// The paint and scissor of a call, evaluated per pixel like the nanovg GL shaders
+  struct SoftRenderer::Paint {
+    Paint(const SoftRenderer& r, const NVGpaint& paint, const NVGscissor& scissor, float fringe)
+    {
+      inner = to_rgba(paint.innerColor);
+      outer = to_rgba(paint.outerColor);
+      nvgTransformInverse(paint_inv, const_cast<float*>(paint.xform));
+      extent[0] = paint.extent[0];
+      extent[1] = paint.extent[1];
+      radius = paint.radius;
+      feather = std::max(paint.feather, 1e-3f);
+      if (paint.image != 0) texture = const_cast<SoftRenderer&>(r).find_texture(paint.image);
+
+      has_scissor = scissor.extent[0] >= -0.5f && scissor.extent[1] >= -0.5f;
+      if (has_scissor) {
+        nvgTransformInverse(scissor_inv, const_cast<float*>(scissor.xform));
+        scissor_extent[0] = scissor.extent[0];
+        scissor_extent[1] = scissor.extent[1];
+        fringe = std::max(fringe, 1e-3f);
+        scissor_scale[0] = std::sqrt(scissor.xform[0] * scissor.xform[0] + scissor.xform[2] * scissor.xform[2]) / fringe;
+        scissor_scale[1] = std::sqrt(scissor.xform[1] * scissor.xform[1] + scissor.xform[3] * scissor.xform[3]) / fringe;
+      }
+
+      solid = texture == nullptr && std::memcmp(&inner, &outer, sizeof(Rgba)) == 0;
+      if (solid) {
+        r5 = int(clamp01(inner.r) * 31 + 0.5f);
+        g6 = int(clamp01(inner.g) * 63 + 0.5f);
+        b5 = int(clamp01(inner.b) * 31 + 0.5f);
+      }
+    }
+
+    /// The scissor coverage of the pixel at `x, y`
+    float scissor(float x, float y) const noexcept
+    {
+      if (!has_scissor) return 1;
+      float sx, sy;
+      transform(scissor_inv, x, y, sx, sy);
+      sx = 0.5f - (std::abs(sx) - scissor_extent[0]) * scissor_scale[0];
+      sy = 0.5f - (std::abs(sy) - scissor_extent[1]) * scissor_scale[1];
+      return clamp01(sx) * clamp01(sy);
+    }
+
+    /// The colour of the paint at `x, y`
+    Rgba colour(float x, float y) const noexcept
+    {
+      if (solid) return inner;
+      float px, py;
+      transform(paint_inv, x, y, px, py);
+      if (texture != nullptr) {
+        Rgba t = sample(px / extent[0], py / extent[1]);
+        return {t.r * inner.r, t.g * inner.g, t.b * inner.b, t.a * inner.a};
+      }
+      float d = clamp01((sdroundrect(px, py, extent[0], extent[1], radius) + feather * 0.5f) / feather);
+      return {inner.r + (outer.r - inner.r) * d, inner.g + (outer.g - inner.g) * d,
+              inner.b + (outer.b - inner.b) * d, inner.a + (outer.a - inner.a) * d};
+    }
+
+    /// Sample the texture at `u, v`, from 0 to 1
+    Rgba sample(float u, float v) const noexcept
+    {
+      const Texture& t = *texture;
+      if (t.flags & NVG_IMAGE_FLIPY) v = 1 - v;
+      float fx = u * t.width - 0.5f;
+      float fy = v * t.height - 0.5f;
+      auto wrap = [](int i, int size, bool repeat) {
+        if (repeat) return ((i % size) + size) % size;
+        return std::min(size - 1, std::max(0, i));
+      };
+      bool rx = t.flags & NVG_IMAGE_REPEATX;
+      bool ry = t.flags & NVG_IMAGE_REPEATY;
+      auto texel = [&](int x, int y) {
+        x = wrap(x, t.width, rx);
+        y = wrap(y, t.height, ry);
+        if (t.type == NVG_TEXTURE_ALPHA) {
+          float a = t.data[y * t.width + x] / 255.f;
+          return Rgba{1, 1, 1, a};
+        }
+        const std::uint8_t* p = &t.data[(y * t.width + x) * 4];
+        Rgba c = {p[0] / 255.f, p[1] / 255.f, p[2] / 255.f, p[3] / 255.f};
+        if ((t.flags & NVG_IMAGE_PREMULTIPLIED) && c.a > 0) {
+          c.r /= c.a;
+          c.g /= c.a;
+          c.b /= c.a;
+        }
+        return c;
+      };
+      if (t.flags & NVG_IMAGE_NEAREST) return texel(int(std::floor(fx + 0.5f)), int(std::floor(fy + 0.5f)));
+      int x0 = int(std::floor(fx));
+      int y0 = int(std::floor(fy));
+      float ax = fx - x0;
+      float ay = fy - y0;
+      Rgba c00 = texel(x0, y0), c10 = texel(x0 + 1, y0);
+      Rgba c01 = texel(x0, y0 + 1), c11 = texel(x0 + 1, y0 + 1);
+      auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+      auto mix = [&](auto field) {
+        return lerp(lerp(c00.*field, c10.*field, ax), lerp(c01.*field, c11.*field, ax), ay);
+      };
+      return {mix(&Rgba::r), mix(&Rgba::g), mix(&Rgba::b), mix(&Rgba::a)};
+    }
+
+    Rgba inner, outer;
+    float paint_inv[6];
+    float extent[2];
+    float radius;
+    float feather;
+    const Texture* texture = nullptr;
+
+    bool has_scissor = false;
+    float scissor_inv[6];
+    float scissor_extent[2];
+    float scissor_scale[2];
+
+    /// Whether the paint is one colour, which is blended a span at a time
+    bool solid = false;
+    int r5 = 0, g6 = 0, b5 = 0;
+  };
+
+  SoftRenderer::SoftRenderer(int width, int height)
+    : _width(width), _height(height), _pixels(width * height, 0)
+  {
+    NVGparams params = {};
+    params.userPtr = this;
+    // The coverage is exact, so nanovg does not need to add antialiasing fringes
+    params.edgeAntiAlias = 0;
+    params.renderCreate = render_create;
+    params.renderCreateTexture = create_texture;
+    params.renderDeleteTexture = delete_texture;
+    params.renderUpdateTexture = update_texture;
+    params.renderGetTextureSize = get_texture_size;
+    params.renderViewport = viewport;
+    params.renderCancel = cancel;
+    params.renderFlush = flush;
+    params.renderFill = fill;
+    params.renderStroke = stroke;
+    params.renderTriangles = triangles;
+    params.renderDelete = render_delete;
+    _nvg = nvgCreateInternal(&params);
+    if (_nvg == nullptr) throw util::exception("Could not create the software nanovg context");
+  }
+
+  SoftRenderer::~SoftRenderer() noexcept
+  {
+    nvgDeleteInternal(_nvg);
+  }
+
+  void SoftRenderer::clear(Colour colour) noexcept
+  {
+    std::uint16_t px = std::uint16_t(((colour.r >> 3) << 11) | ((colour.g >> 2) << 5) | (colour.b >> 3));
+    std::fill(_pixels.begin(), _pixels.end(), px);
+  }
+
+  // Backend //////////////////////////////////////////////////////////////////
+
+  int SoftRenderer::render_create(void*)
+  {
+    return 1;
+  }
+
+  int SoftRenderer::create_texture(void* self, int type, int w, int h, int flags, const unsigned char* data)
+  {
+    auto& r = *static_cast<SoftRenderer*>(self);
+    Texture t;
+    t.id = r._next_texture++;
+    t.type = type;
+    t.width = w;
+    t.height = h;
+    t.flags = flags;
+    int bpp = type == NVG_TEXTURE_ALPHA ? 1 : 4;
+    t.data.resize(w * h * bpp);
+    if (data != nullptr) std::copy(data, data + t.data.size(), t.data.begin());
+    r._textures.push_back(std::move(t));
+    return r._textures.back().id;
+  }
+
+  int SoftRenderer::delete_texture(void* self, int image)
+  {
+    auto& r = *static_cast<SoftRenderer*>(self);
+    auto found = std::find_if(r._textures.begin(), r._textures.end(), [&](auto& t) { return t.id == image; });
+    if (found == r._textures.end()) return 0;
+    r._textures.erase(found);
+    return 1;
+  }
+
+  int SoftRenderer::update_texture(void* self, int image, int x, int y, int w, int h, const unsigned char* data)
+  {
+    auto* t = static_cast<SoftRenderer*>(self)->find_texture(image);
+    if (t == nullptr) return 0;
+    // Like the GL backends, `data` is the whole image
+    int bpp = t->type == NVG_TEXTURE_ALPHA ? 1 : 4;
+    for (int row = y; row < y + h; row++) {
+      auto offset = (row * t->width + x) * bpp;
+      std::copy(data + offset, data + offset + w * bpp, t->data.begin() + offset);
+    }
+    return 1;
+  }
+
+  int SoftRenderer::get_texture_size(void* self, int image, int* w, int* h)
+  {
+    auto* t = static_cast<SoftRenderer*>(self)->find_texture(image);
+    if (t == nullptr) return 0;
+    *w = t->width;
+    *h = t->height;
+    return 1;
+  }
+
+  void SoftRenderer::viewport(void*, float, float, float) {}
+
+  void SoftRenderer::cancel(void*) {}
+
+  // Everything is rendered as soon as it is drawn
+  void SoftRenderer::flush(void*) {}
+
+  void SoftRenderer::fill(void* self,
+                          NVGpaint* paint,
+                          NVGcompositeOperationState,
+                          NVGscissor* scissor,
+                          float fringe,
+                          const float* bounds,
+                          const NVGpath* paths,
+                          int npaths)
+  {
+    auto& r = *static_cast<SoftRenderer*>(self);
+    Area area = r.clip(bounds[0], bounds[1], bounds[2], bounds[3]);
+    if (area.x0 >= area.x1 || area.y0 >= area.y1) return;
+    r._edges.clear();
+    for (int p = 0; p < npaths; p++) {
+      const NVGpath& path = paths[p];
+      for (int i = 0; i < path.nfill; i++) {
+        r.add_edge(path.fill[i], path.fill[(i + 1) % path.nfill], area);
+      }
+    }
+    r.rasterise(area, Paint(r, *paint, *scissor, fringe));
+  }
+
+  void SoftRenderer::stroke(void* self,
+                            NVGpaint* paint,
+                            NVGcompositeOperationState,
+                            NVGscissor* scissor,
+                            float fringe,
+                            float,
+                            const NVGpath* paths,
+                            int npaths)
+  {
+    auto& r = *static_cast<SoftRenderer*>(self);
+    float x0 = 1e6f, y0 = 1e6f, x1 = -1e6f, y1 = -1e6f;
+    for (int p = 0; p < npaths; p++) {
+      for (int i = 0; i < paths[p].nstroke; i++) {
+        auto& v = paths[p].stroke[i];
+        x0 = std::min(x0, v.x);
+        y0 = std::min(y0, v.y);
+        x1 = std::max(x1, v.x);
+        y1 = std::max(y1, v.y);
+      }
+    }
+    Area area = r.clip(x0, y0, x1, y1);
+    if (area.x0 >= area.x1 || area.y0 >= area.y1) return;
+    r._edges.clear();
+    // Strokes are triangle strips. Overlapping triangles add up, and the coverage is clamped.
+    for (int p = 0; p < npaths; p++) {
+      const NVGpath& path = paths[p];
+      for (int i = 2; i < path.nstroke; i++) {
+        r.add_triangle(path.stroke[i - 2], path.stroke[i - 1], path.stroke[i], area);
+      }
+    }
+    r.rasterise(area, Paint(r, *paint, *scissor, fringe));
+  }
+
+  void SoftRenderer::triangles(void* self,
+                               NVGpaint* paint,
+                               NVGcompositeOperationState,
+                               NVGscissor* scissor,
+                               const NVGvertex* verts,
+                               int nverts)
+  {
+    // Used for text. Each glyph is a quad of two triangles, textured with the font atlas, which
+    // is antialiased already, so pixels are sampled at their centers.
+    auto& r = *static_cast<SoftRenderer*>(self);
+    Paint pt(r, *paint, *scissor, 1);
+    for (int i = 0; i + 2 < nverts; i += 3) {
+      const NVGvertex& a = verts[i];
+      const NVGvertex& b = verts[i + 1];
+      const NVGvertex& c = verts[i + 2];
+      float area2 = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+      if (std::abs(area2) < 1e-6f) continue;
+      Area box = r.clip(std::min({a.x, b.x, c.x}), std::min({a.y, b.y, c.y}),
+                        std::max({a.x, b.x, c.x}), std::max({a.y, b.y, c.y}));
+      for (int y = box.y0; y < box.y1; y++) {
+        std::uint16_t* row = &r._pixels[y * r._width];
+        float py = y + 0.5f;
+        for (int x = box.x0; x < box.x1; x++) {
+          float px = x + 0.5f;
+          float w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / area2;
+          float w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / area2;
+          float w2 = 1 - w0 - w1;
+          if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+          Rgba col = pt.inner;
+          if (pt.texture != nullptr) {
+            Rgba t = pt.sample(w0 * a.u + w1 * b.u + w2 * c.u, w0 * a.v + w1 * b.v + w2 * c.v);
+            col = {t.r * col.r, t.g * col.g, t.b * col.b, t.a * col.a};
+          }
+          int alpha = int(clamp01(col.a * pt.scissor(px, py)) * 255 + 0.5f);
+          if (alpha == 0) continue;
+          row[x] = blend565(row[x], int(clamp01(col.r) * 31 + 0.5f), int(clamp01(col.g) * 63 + 0.5f),
+                            int(clamp01(col.b) * 31 + 0.5f), alpha);
+        }
+      }
+    }
+  }
+
+  void SoftRenderer::render_delete(void*) {}
+
+  // Rasteriser ///////////////////////////////////////////////////////////////
+
+  auto SoftRenderer::find_texture(int id) noexcept -> Texture*
+  {
+    for (auto& t : _textures) {
+      if (t.id == id) return &t;
+    }
+    return nullptr;
+  }
+
+  auto SoftRenderer::clip(float x0, float y0, float x1, float y1) const noexcept -> Area
+  {
+    return {std::max(0, int(std::floor(x0))), std::max(0, int(std::floor(y0))),
+            std::min(_width, int(std::ceil(x1))), std::min(_height, int(std::ceil(y1)))};
+  }
+
+  void SoftRenderer::add_edge(const NVGvertex& a, const NVGvertex& b, const Area& area)
+  {
+    add_edge(a.x, a.y, b.x, b.y, area);
+  }
+
+  void SoftRenderer::add_edge(float x0, float y0, float x1, float y1, const Area& area)
+  {
+    if (y0 == y1) return;
+    // Split the edge where it crosses the sides of the area. Clamping the parts outside to the
+    // sides then keeps the coverage inside unchanged.
+    for (float side : {float(area.x0), float(area.x1)}) {
+      if ((x0 - side) * (x1 - side) < 0) {
+        float y = y0 + (side - x0) / (x1 - x0) * (y1 - y0);
+        add_edge(x0, y0, side, y, area);
+        add_edge(side, y, x1, y1, area);
+        return;
+      }
+    }
+    auto clamp = [&](float x) {
+      return std::min(float(area.x1), std::max(float(area.x0), x)) - area.x0;
+    };
+    _edges.push_back({clamp(x0), y0, clamp(x1), y1});
+  }
+
+  void SoftRenderer::add_triangle(const NVGvertex& a, const NVGvertex& b, const NVGvertex& c, const Area& area)
+  {
+    float area2 = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (area2 == 0) return;
+    if (area2 > 0) {
+      add_edge(a, b, area);
+      add_edge(b, c, area);
+      add_edge(c, a, area);
+    } else {
+      add_edge(a, c, area);
+      add_edge(c, b, area);
+      add_edge(b, a, area);
+    }
+  }
+
+  void SoftRenderer::accumulate(const Edge& edge, int tile_y, int tile_width, int rows)
+  {
+    // Based on the accumulation rasteriser of font-rs. The signed area each edge covers is
+    // added to the cells it passes through, and to the cell right of them, so the prefix sum
+    // of a row is the coverage of each pixel.
+    float dir = 1;
+    float x0 = edge.x0, y0 = edge.y0 - tile_y, x1 = edge.x1, y1 = edge.y1 - tile_y;
+    if (y0 > y1) {
+      std::swap(x0, x1);
+      std::swap(y0, y1);
+      dir = -1;
+    }
+    if (y1 <= 0 || y0 >= rows) return;
+    float dxdy = (x1 - x0) / (y1 - y0);
+    float x = x0;
+    if (y0 < 0) {
+      x -= y0 * dxdy;
+      y0 = 0;
+    }
+    y1 = std::min(y1, float(rows));
+    const int stride = tile_width + 2;
+    int y_end = int(std::ceil(y1));
+    for (int y = int(y0); y < y_end; y++) {
+      float* line = &_coverage[y * stride];
+      float dy = std::min(float(y + 1), y1) - std::max(float(y), y0);
+      float xnext = x + dxdy * dy;
+      float d = dy * dir;
+      float xa = std::min(x, xnext);
+      float xb = std::max(x, xnext);
+      float xa_floor = std::floor(xa);
+      int xai = int(xa_floor);
+      float xb_ceil = std::ceil(xb);
+      int xbi = int(xb_ceil);
+      if (xbi <= xai + 1) {
+        float xmf = 0.5f * (x + xnext) - xa_floor;
+        line[xai] += d - d * xmf;
+        line[xai + 1] += d * xmf;
+      } else {
+        float s = 1 / (xb - xa);
+        float xaf = xa - xa_floor;
+        float a0 = 0.5f * s * (1 - xaf) * (1 - xaf);
+        float xbf = xb - xb_ceil + 1;
+        float am = 0.5f * s * xbf * xbf;
+        line[xai] += d * a0;
+        if (xbi == xai + 2) {
+          line[xai + 1] += d * (1 - a0 - am);
+        } else {
+          float a1 = s * (1.5f - xaf);
+          line[xai + 1] += d * (a1 - a0);
+          for (int xi = xai + 2; xi < xbi - 1; xi++) line[xi] += d * s;
+          float a2 = a1 + (xbi - xai - 3) * s;
+          line[xbi - 1] += d * (1 - a2 - am);
+        }
+        line[xbi] += d * am;
+      }
+      x = xnext;
+    }
+  }
+
+  void SoftRenderer::rasterise(const Area& area, const Paint& paint)
+  {
+    if (_edges.empty()) return;
+    const int tile_width = area.x1 - area.x0;
+    const int stride = tile_width + 2;
+    _coverage.resize(stride * tile_rows);
+    _alpha.resize(tile_width);
+
+    for (int tile_y = area.y0; tile_y < area.y1; tile_y += tile_rows) {
+      const int rows = std::min(tile_rows, area.y1 - tile_y);
+      std::fill(_coverage.begin(), _coverage.begin() + stride * rows, 0.f);
+      bool any = false;
+      for (auto& edge : _edges) {
+        if (std::max(edge.y0, edge.y1) <= tile_y || std::min(edge.y0, edge.y1) >= tile_y + rows) continue;
+        accumulate(edge, tile_y, tile_width, rows);
+        any = true;
+      }
+      if (!any) continue;
+
+      for (int row = 0; row < rows; row++) {
+        const int y = tile_y + row;
+        const float* line = &_coverage[row * stride];
+        std::uint16_t* dst = &_pixels[y * _width + area.x0];
+        const float py = y + 0.5f;
+        float sum = 0;
+        if (paint.solid) {
+          const float alpha = paint.inner.a * 255;
+          for (int i = 0; i < tile_width; i++) {
+            sum += line[i];
+            float cov = std::min(std::abs(sum), 1.f) * paint.scissor(area.x0 + i + 0.5f, py);
+            _alpha[i] = std::uint8_t(cov * alpha + 0.5f);
+          }
+          blend_span(dst, _alpha.data(), tile_width, paint.r5, paint.g6, paint.b5);
+        } else {
+          for (int i = 0; i < tile_width; i++) {
+            sum += line[i];
+            float cov = std::min(std::abs(sum), 1.f);
+            if (cov <= 0) continue;
+            const float px = area.x0 + i + 0.5f;
+            Rgba col = paint.colour(px, py);
+            int alpha = int(clamp01(col.a * cov * paint.scissor(px, py)) * 255 + 0.5f);
+            if (alpha == 0) continue;
+            dst[i] = blend565(dst[i], int(clamp01(col.r) * 31 + 0.5f), int(clamp01(col.g) * 63 + 0.5f),
+                              int(clamp01(col.b) * 31 + 0.5f), alpha);
+          }
+        }
+      }
+    }
+  }
+
+} // namespace otto::core::ui::vg
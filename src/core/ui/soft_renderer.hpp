@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <gsl/span>
+
+#include "core/ui/canvas.hpp"
+
+namespace otto::core::ui::vg {
+
+  /// Renders nanovg on the cpu, into an RGB565 framebuffer
+  ///
+  /// For boards without a gpu, and for rendering headless. It implements the nanovg render
+  /// backend, so a @ref Canvas drawn on @ref context works like it does on GLES2 or GL3.
+  ///
+  /// Fills and strokes are rasterised with exact area coverage, which is also their
+  /// antialiasing. The bounding box of each is processed in tiles of @ref tile_rows rows, so
+  /// the coverage of a tile stays in the cache. Only the source-over composite operation is
+  /// supported. The blending is vectorised with NEON on ARM.
+  struct SoftRenderer {
+    /// The number of rows in a tile
+    static constexpr int tile_rows = 16;
+
+    SoftRenderer(int width, int height);
+    ~SoftRenderer() noexcept;
+
+    SoftRenderer(const SoftRenderer&) = delete;
+    SoftRenderer& operator=(const SoftRenderer&) = delete;
+
+    /// The nanovg context that renders to @ref pixels
+    NVGcontext* context() const noexcept
+    {
+      return _nvg;
+    }
+
+    int width() const noexcept
+    {
+      return _width;
+    }
+
+    int height() const noexcept
+    {
+      return _height;
+    }
+
+    /// The rendered frame, row by row from the top
+    gsl::span<const std::uint16_t> pixels() const noexcept
+    {
+      return _pixels;
+    }
+
+    /// Fill the frame with `colour`. Alpha is ignored.
+    void clear(Colour colour) noexcept;
+
+  private:
+    /// An edge of a polygon, relative to the left of the area being rasterised
+    struct Edge {
+      float x0, y0, x1, y1;
+    };
+
+    struct Texture {
+      int id = 0;
+      int type = 0;
+      int width = 0;
+      int height = 0;
+      int flags = 0;
+      std::vector<std::uint8_t> data;
+    };
+
+    /// The pixel area that is rasterised, clipped to the frame
+    struct Area {
+      int x0, y0, x1, y1;
+    };
+
+    struct Paint;
+
+    // The nanovg render backend
+    static int render_create(void* self);
+    static int create_texture(void* self, int type, int w, int h, int flags, const unsigned char* data);
+    static int delete_texture(void* self, int image);
+    static int update_texture(void* self, int image, int x, int y, int w, int h, const unsigned char* data);
+    static int get_texture_size(void* self, int image, int* w, int* h);
+    static void viewport(void* self, float width, float height, float pixel_ratio);
+    static void cancel(void* self);
+    static void flush(void* self);
+    static void fill(void* self,
+                     NVGpaint* paint,
+                     NVGcompositeOperationState op,
+                     NVGscissor* scissor,
+                     float fringe,
+                     const float* bounds,
+                     const NVGpath* paths,
+                     int npaths);
+    static void stroke(void* self,
+                       NVGpaint* paint,
+                       NVGcompositeOperationState op,
+                       NVGscissor* scissor,
+                       float fringe,
+                       float stroke_width,
+                       const NVGpath* paths,
+                       int npaths);
+    static void triangles(void* self,
+                          NVGpaint* paint,
+                          NVGcompositeOperationState op,
+                          NVGscissor* scissor,
+                          const NVGvertex* verts,
+                          int nverts);
+    static void render_delete(void* self);
+
+    Texture* find_texture(int id) noexcept;
+
+    /// Clip `x0, y0, x1, y1` to the frame
+    Area clip(float x0, float y0, float x1, float y1) const noexcept;
+
+    /// Add an edge from `a` to `b` to @ref _edges, clipped horizontally to `area`
+    void add_edge(const NVGvertex& a, const NVGvertex& b, const Area& area);
+    void add_edge(float x0, float y0, float x1, float y1, const Area& area);
+
+    /// Add the edges of a triangle, wound so that its coverage is positive
+    void add_triangle(const NVGvertex& a, const NVGvertex& b, const NVGvertex& c, const Area& area);
+
+    /// Rasterise @ref _edges tile by tile, and blend `paint` into the frame by their coverage
+    void rasterise(const Area& area, const Paint& paint);
+
+    /// Accumulate the coverage of `edge`, clipped to the tile at `tile_y`
+    void accumulate(const Edge& edge, int tile_y, int tile_width, int rows);
+
+    int _width;
+    int _height;
+    std::vector<std::uint16_t> _pixels;
+    std::vector<Texture> _textures;
+    int _next_texture = 1;
+
+    std::vector<Edge> _edges;
+    /// Signed area of the current tile. Rows are two longer than the tile, for the right edge.
+    std::vector<float> _coverage;
+    std::vector<std::uint8_t> _alpha;
+
+    NVGcontext* _nvg = nullptr;
+  };
+
+} // namespace otto::core::ui::vg
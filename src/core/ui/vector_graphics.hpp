@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+#include <tuple>
 #include <fmt/format.h>
 #include "core/ui/canvas.hpp"
 #include "services/log_manager.hpp"
@@ -46,6 +48,40 @@ namespace otto::core::ui::vg {
     }
   } // namespace Fonts
 
+  /// A string formatted from values, which is only formatted again when they change
+  ///
+  /// For labels that are drawn every frame. nanovg keeps the rendered glyphs in its font atlas,
+  /// so this saves the formatting, and the heap allocations it makes, on the UI thread.
+  ///
+  /// ```cpp
+  /// FormattedText<float> volume_text = {"{:1}"};
+  /// ctx.fillText(volume_text(props.volume), {x, y});
+  /// ```
+  template<typename... Args>
+  struct FormattedText {
+    FormattedText(const char* format) : _format(format) {}
+
+    /// The text formatted from `args`
+    const std::string& operator()(const Args&... args)
+    {
+      if (!_valid || _args != std::tie(args...)) {
+        _args = {args...};
+        fmt::memory_buffer buf;
+        fmt::format_to(buf, _format, args...);
+        // Reuses the capacity of the string
+        _text.assign(buf.data(), buf.size());
+        _valid = true;
+      }
+      return _text;
+    }
+
+  private:
+    const char* _format;
+    std::tuple<Args...> _args;
+    std::string _text;
+    bool _valid = false;
+  };
+
   inline void initUtils(Canvas& ctx)
   {
     Fonts::loadFont(ctx, Fonts::Light, "Roboto-Light");
@@ -5,10 +5,14 @@
 #include "util/audio.hpp"
 #include "util/cache.hpp"
 #include "util/algorithm.hpp"
+#include "util/dsp/peak_pyramid.hpp"
 
 namespace otto::core::ui::widgets {
 
   /// Draws a waveform from data.
+  ///
+  /// The points are found from a @ref dsp::PeakPyramid of the container, so zooming and
+  /// scrolling cost the same at any zoom. The pyramid follows the container as it grows.
   template<typename Container>
   struct Waveform : Widget {
     using Range = util::audio::Section<int>;
@@ -73,6 +77,19 @@ namespace otto::core::ui::widgets {
       }
     }
 
+    /// Redraw after samples were appended to the container
+    void update()
+    {
+      point_cache.invalidate();
+    }
+
+    /// Redraw after samples of the container were changed or removed
+    void reset()
+    {
+      peaks.clear();
+      point_cache.invalidate();
+    }
+
     float top_val() const {
       return _top_val;
     }
@@ -138,6 +155,9 @@ namespace otto::core::ui::widgets {
       /// Clamp value to container size
       std::size_t clamp(std::size_t) const;
 
+      /// The average absolute value of the samples in `[first, last)`
+      float average_abs(int first, int last) const;
+
     } point_cache {this};
 
 
@@ -151,6 +171,12 @@ namespace otto::core::ui::widgets {
 
     const Container& container;
 
+    /// Append the samples added to the container since the last refresh to the peaks
+    void sync_peaks() const;
+
+    /// Kept in step with the container when the cache is refreshed
+    mutable dsp::PeakPyramid peaks;
+
   };
 
   // Implementation ///////////////////////////////////////////////////////////
@@ -221,35 +247,23 @@ namespace otto::core::ui::widgets {
       return;
     }
 
+    wf.sync_peaks();
+
     sp2r = 2 * radius * smpl_pr_px;
     double error = 0.f;
-    auto first = std::begin(wf.container);
-    auto fidx = clamp(std::floor(wf._range.in / sp2r) * sp2r);
-    auto lidx = clamp(std::ceil(wf._range.out / sp2r) * sp2r);
-    auto iter = first + fidx;
-    auto last = first + lidx;
-    float start_x = (int(fidx) - int(wf._range.in)) / smpl_pr_px;
-    for (int i = 0; iter != last; i++, iter++) {
+    int fidx = clamp(std::floor(wf._range.in / sp2r) * sp2r);
+    int lidx = clamp(std::ceil(wf._range.out / sp2r) * sp2r);
+    float start_x = (fidx - wf._range.in) / smpl_pr_px;
+    for (int i = 0, pos = fidx; pos < lidx; i++) {
       double intprt = 0;
       error = std::modf(error + sp2r, &intprt);
-
-      // Average:
-      float sum = 0.f;
-      for (int j = 0; (j < intprt) && (iter != last); j++, iter++) {
-        sum += std::abs(*iter);
-      }
-      float val = sum / intprt;
-      // Max
-      // float val = 0;
-      // for (int j = 0; (j < intprt) && (iter != last); j++, iter++) {
-      //   val = std::max(std::abs(*iter), val);
-      // }
+      int next = std::min(pos + std::max(1, int(intprt)), lidx);
+      float val = average_abs(pos, next);
+      pos = next;
 
       points.emplace_back(
         start_x + i * 2 * radius,
         (1 - std::min(val / wf._top_val, 1.f)) * wf.size.h);
-      // Required, as iter might otherwise be incremented twice with no check
-      if (iter == last) break;
     }
 
     // Align points if they are too close
@@ -272,4 +286,31 @@ namespace otto::core::ui::widgets {
   inline std::size_t Waveform<C>::PointCache::clamp(std::size_t val) const {
     return std::clamp(val, std::size_t{0}, wf.container.size());
   }
+
+  template<typename C>
+  inline float Waveform<C>::PointCache::average_abs(int first, int last) const
+  {
+    // Below a block of the pyramid, the samples are fewer than its blocks would round to
+    if (last - first >= dsp::PeakPyramid::base_block) {
+      return wf.peaks.peak(first, last).average_abs();
+    }
+    float sum = 0.f;
+    auto iter = std::begin(wf.container) + first;
+    for (int i = first; i < last; i++, iter++) sum += std::abs(*iter);
+    return sum / (last - first);
+  }
+
+  template<typename C>
+  inline void Waveform<C>::sync_peaks() const
+  {
+    if (container.size() < peaks.size()) peaks.clear();
+    std::array<float, 256> chunk;
+    auto iter = std::begin(container) + peaks.size();
+    for (int i = peaks.size(); i < container.size();) {
+      int n = std::min<int>(chunk.size(), container.size() - i);
+      for (int j = 0; j < n; j++, iter++) chunk[j] = *iter;
+      peaks.append({chunk.data(), n});
+      i += n;
+    }
+  }
 }
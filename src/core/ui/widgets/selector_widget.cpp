@@ -14,7 +14,7 @@ namespace otto::core::ui {
   {
     using namespace vg;
 
-    _selected_item = std::clamp(_selected_item, 0, nitems());
+    _selected_item = std::clamp(_selected_item, 0, std::max(0, nitems() - 1));
     int vitems =
       std::min(nitems(), (int) std::ceil(size.h / options.item_height));
     _top_item =
@@ -22,20 +22,13 @@ namespace otto::core::ui {
 
     vitems = std::min(vitems, nitems() - _top_item);
 
+    // Only the visible rows are drawn, so long lists cost no more than short ones
+    ctx.textAlign(TextAlign::Left, TextAlign::Middle);
+    ctx.font(Fonts::Norm, options.font_size);
     for (int i = 0; i < vitems; i++) {
       const int idx = _top_item + i;
-
-      if (idx == _selected_item) {
-        ctx.beginPath();
-        ctx.rect({0, i * options.item_height}, {size.w, options.item_height});
-        // ctx.fill(Colours::Black); - in case you want the background back
-        ctx.fillStyle(options.selected_item_colour);
-      } else {
-        ctx.fillStyle(options.item_colour);
-      }
+      ctx.fillStyle(idx == _selected_item ? options.selected_item_colour : options.item_colour);
       ctx.beginPath();
-      ctx.textAlign(TextAlign::Left, TextAlign::Middle);
-      ctx.font(Fonts::Norm, options.font_size);
       ctx.fillText((*_items)[idx], {5.f, (i + 1.f) * options.item_height},
                    size.w - 10.f);
     }
@@ -16,7 +16,7 @@ namespace otto::core::voices {
   namespace details {
     std::unique_ptr<ui::Screen> make_envelope_screen(EnvelopeProps& props)
     {
-      return std::make_unique<EnvelopeScreen>(props);
+      return ui::make_screen<EnvelopeScreen>(props);
     }
   } // namespace details
 
@@ -18,7 +18,7 @@ namespace otto::core::voices {
   namespace details {
     std::unique_ptr<ui::Screen> make_settings_screen(SettingsProps& props)
     {
-      return std::make_unique<SettingsScreen>(props);
+      return ui::make_screen<SettingsScreen>(props);
     }
   } // namespace details
 
@@ -27,7 +27,14 @@ namespace otto::core::voices {
 
   bool SettingsScreen::keypress(ui::Key key)
   {
-    return false;
+    switch (key) {
+    case ui::Key::blue_click: props.steal_mode.step(1); return true;
+    case ui::Key::green_click: props.legato = !props.legato; return true;
+    case ui::Key::red_click: props.mpe = !props.mpe; return true;
+    // The spread goes round in quarters
+    case ui::Key::yellow_click: props.spread = props.spread >= 1 ? 0.f : props.spread + 0.25f; return true;
+    default: return false;
+    }
   }
 
   void SettingsScreen::encoder(ui::EncoderEvent ev)
@@ -35,6 +42,7 @@ namespace otto::core::voices {
     switch (ev.encoder) {
     case Encoder::blue: props.play_mode.step(ev.steps); break;
     case Encoder::green: props.portamento.step(ev.steps); break;
+    case Encoder::yellow: props.detune.step(ev.steps); break;
     case Encoder::red: props.transpose.step(ev.steps); break;
     default: break;
     }
@@ -44,11 +52,11 @@ namespace otto::core::voices {
   {
     using namespace ui::vg;
 
-    ctx.font(Fonts::Norm, 35);
+    ctx.font(Fonts::Norm, 30);
 
     constexpr float x_pad = 30;
     constexpr float y_pad = 50;
-    constexpr float space = (height - 2.f * y_pad) / 3.f;
+    constexpr float space = (height - 2.f * y_pad) / 4.f;
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Blue);
@@ -60,25 +68,66 @@ namespace otto::core::voices {
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
     ctx.fillText(util::to_string(props.play_mode.get()).data(), {width - x_pad, y_pad});
 
+    ctx.beginPath();
+    ctx.fillStyle(Colours::Blue);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText("stealing", {x_pad, y_pad + space});
+
+    ctx.beginPath();
+    ctx.fillStyle(Colours::Blue);
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText(util::to_string(props.steal_mode.get()).data(), {width - x_pad, y_pad + space});
+
     ctx.beginPath();
     ctx.fillStyle(Colours::Green);
     ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
-    ctx.fillText("portamento", {x_pad, y_pad + space});
+    ctx.fillText("portamento", {x_pad, y_pad + 2 * space});
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Green);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:3.2}", props.portamento), {width - x_pad, y_pad + space});
+    ctx.fillText(fmt::format("{:3.2}", props.portamento), {width - x_pad, y_pad + 2 * space});
+
+    if (props.legato) {
+      ctx.beginPath();
+      ctx.fillStyle(Colours::Green);
+      ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+      ctx.fillText("legato", {width / 2, y_pad + 2 * space});
+    }
+
+    ctx.beginPath();
+    ctx.fillStyle(Colours::Yellow);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText("detune", {x_pad, y_pad + 3 * space});
+
+    ctx.beginPath();
+    ctx.fillStyle(Colours::Yellow);
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText(fmt::format("{:3.2}", props.detune), {width - x_pad, y_pad + 3 * space});
+
+    if (props.spread > 0) {
+      ctx.beginPath();
+      ctx.fillStyle(Colours::Yellow);
+      ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+      ctx.fillText(fmt::format("spread {:3.2}", props.spread), {width / 2, y_pad + 3 * space});
+    }
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Red);
     ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
-    ctx.fillText("transpose", {x_pad, y_pad + 3 * space});
+    ctx.fillText("transpose", {x_pad, y_pad + 4 * space});
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Red);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:+}", props.transpose), {width - x_pad, y_pad + 2 * space});
+    ctx.fillText(fmt::format("{:+}", props.transpose), {width - x_pad, y_pad + 4 * space});
+
+    if (props.mpe) {
+      ctx.beginPath();
+      ctx.fillStyle(Colours::Red);
+      ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+      ctx.fillText("mpe", {width / 2, y_pad + 4 * space});
+    }
   }
 
 } // namespace otto::core::voices
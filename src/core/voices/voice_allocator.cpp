@@ -0,0 +1,160 @@
+#include "voice_allocator.hpp"
+
+namespace otto::core::voices {
+
+  VoiceAllocator::VoiceAllocator() noexcept
+  {
+    clear();
+  }
+
+  void VoiceAllocator::clear() noexcept
+  {
+    _notes.fill({});
+    _sounding = {};
+    _waiting = {};
+    _last_voice.fill(-1);
+    _free.fill({});
+    _first_free = _last_free = -1;
+  }
+
+  void VoiceAllocator::free_voice(int voice) noexcept
+  {
+    auto& free = _free[voice];
+    if (free.free) return;
+    free = {true, _last_free, -1};
+    if (_last_free < 0) {
+      _first_free = voice;
+    } else {
+      _free[_last_free].next = voice;
+    }
+    _last_free = voice;
+  }
+
+  void VoiceAllocator::take_free(int voice) noexcept
+  {
+    auto& free = _free[voice];
+    if (free.prev < 0) {
+      _first_free = free.next;
+    } else {
+      _free[free.prev].next = free.next;
+    }
+    if (free.next < 0) {
+      _last_free = free.prev;
+    } else {
+      _free[free.next].prev = free.prev;
+    }
+    free = {};
+  }
+
+  int VoiceAllocator::disable_voice(int voice) noexcept
+  {
+    if (_free[voice].free) {
+      take_free(voice);
+      return -1;
+    }
+    for (int key = _sounding.first; key >= 0; key = _notes[key].next) {
+      if (_notes[key].voice != voice) continue;
+      _notes[key].voice = -1;
+      remove(_sounding, key);
+      push_back(_waiting, key);
+      return key;
+    }
+    return -1;
+  }
+
+  auto VoiceAllocator::note_on(int key, int steal_key, bool same_voice) noexcept -> Allocation
+  {
+    auto& note = _notes[key];
+    note.held = true;
+    note.sustained = false;
+    Allocation res;
+    const int last = _last_voice[key];
+    if (same_voice && last >= 0 && _free[last].free) {
+      res.voice = last;
+      take_free(last);
+    } else if (_first_free >= 0) {
+      res.voice = _first_free;
+      take_free(_first_free);
+    } else if (_sounding.first >= 0) {
+      if (steal_key < 0 || !_notes[steal_key].held || _notes[steal_key].voice < 0) {
+        steal_key = _sounding.first;
+      }
+      res.stolen_key = steal_key;
+      auto& stolen = _notes[res.stolen_key];
+      res.voice = stolen.voice;
+      stolen.voice = -1;
+      remove(_sounding, res.stolen_key);
+      push_back(_waiting, res.stolen_key);
+    }
+    note.voice = res.voice;
+    if (res.voice >= 0) _last_voice[key] = res.voice;
+    push_back(res.voice >= 0 ? _sounding : _waiting, key);
+    return res;
+  }
+
+  auto VoiceAllocator::note_off(int key) noexcept -> Release
+  {
+    auto& note = _notes[key];
+    if (!note.held) return {};
+    Release res = {note.voice, -1};
+    remove(note.voice >= 0 ? _sounding : _waiting, key);
+    note = {};
+    if (res.voice < 0) return res;
+    if (_waiting.last >= 0) {
+      res.next_key = _waiting.last;
+      remove(_waiting, res.next_key);
+      _notes[res.next_key].voice = res.voice;
+      _last_voice[res.next_key] = res.voice;
+      push_back(_sounding, res.next_key);
+    } else {
+      free_voice(res.voice);
+    }
+    return res;
+  }
+
+  void VoiceAllocator::sustain(int key) noexcept
+  {
+    if (_notes[key].held) _notes[key].sustained = true;
+  }
+
+  util::local_vector<int, VoiceAllocator::note_count> VoiceAllocator::sustained() const noexcept
+  {
+    util::local_vector<int, note_count> res;
+    for (auto list : {_sounding, _waiting}) {
+      for (int key = list.first; key >= 0; key = _notes[key].next) {
+        if (_notes[key].sustained) res.push_back(key);
+      }
+    }
+    return res;
+  }
+
+  void VoiceAllocator::push_back(List& list, int key) noexcept
+  {
+    auto& note = _notes[key];
+    note.prev = list.last;
+    note.next = -1;
+    if (list.last < 0) {
+      list.first = key;
+    } else {
+      _notes[list.last].next = key;
+    }
+    list.last = key;
+  }
+
+  void VoiceAllocator::remove(List& list, int key) noexcept
+  {
+    auto& note = _notes[key];
+    if (note.prev < 0) {
+      list.first = note.next;
+    } else {
+      _notes[note.prev].next = note.next;
+    }
+    if (note.next < 0) {
+      list.last = note.prev;
+    } else {
+      _notes[note.next].prev = note.prev;
+    }
+    note.prev = note.next = -1;
+  }
+
+} // namespace otto::core::voices
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+
+#include "util/local_vector.hpp"
+
+namespace otto::core::voices {
+
+  /// Tracks which voice plays which MIDI note, in fixed size, index based tables
+  ///
+  /// Held notes are in one of two intrusive lists threaded through a table indexed by key: the
+  /// notes that have a voice, oldest first, which is the order voices are stolen in, and the
+  /// notes whose voice was stolen, which get a voice back, newest first, when one is freed.
+  /// Free voices are an intrusive queue, so a released voice is the last to be reused, unless
+  /// the note it last played asks for it back.
+  ///
+  /// Every operation is constant time, and nothing allocates, however many notes arrive.
+  struct VoiceAllocator {
+    static constexpr int note_count = 128;
+    static constexpr int max_voices = 32;
+
+    /// The result of @ref note_on
+    struct Allocation {
+      /// The voice to play the note, or -1 if there are no voices at all
+      int voice = -1;
+      /// The key that had `voice` before, or -1 if it was free
+      int stolen_key = -1;
+    };
+
+    /// The result of @ref note_off
+    struct Release {
+      /// The voice the note had, or -1 if it had none
+      int voice = -1;
+      /// The earlier held key that should now play on `voice`, or -1 if `voice` is now free
+      int next_key = -1;
+    };
+
+    VoiceAllocator() noexcept;
+
+    /// Forget all notes and free voices
+    void clear() noexcept;
+
+    /// Add `voice` to the back of the free voices
+    void free_voice(int voice) noexcept;
+
+    /// Stop using `voice`, until it is freed again
+    ///
+    /// If a note is playing on it, the note keeps waiting for a voice, like a stolen note.
+    ///
+    /// \returns The key that was playing on `voice`, or -1
+    int disable_voice(int voice) noexcept;
+
+    /// Hold `key`, and give it the first free voice, or steal one
+    ///
+    /// `key` must not already be held.
+    ///
+    /// @param steal_key The sounding key to steal from if no voice is free. If it is -1, or
+    ///                  not sounding, the oldest sounding note is stolen.
+    /// @param same_voice Prefer the voice that last played `key`, if it is free.
+    Allocation note_on(int key, int steal_key = -1, bool same_voice = false) noexcept;
+
+    /// Stop holding `key`, passing its voice to the newest note without one
+    Release note_off(int key) noexcept;
+
+    /// Mark `key` to be released when the sustain pedal is lifted
+    void sustain(int key) noexcept;
+
+    /// The held keys marked by @ref sustain
+    util::local_vector<int, note_count> sustained() const noexcept;
+
+    bool held(int key) const noexcept
+    {
+      return _notes[key].held;
+    }
+
+    /// The voice of `key`, or -1 if it has none
+    int voice(int key) const noexcept
+    {
+      return _notes[key].voice;
+    }
+
+    /// The oldest held key with a voice, or -1
+    int first_sounding() const noexcept
+    {
+      return _sounding.first;
+    }
+
+    /// The next newer held key with a voice after the sounding key `key`, or -1
+    int next_sounding(int key) const noexcept
+    {
+      return _notes[key].next;
+    }
+
+  private:
+    struct Note {
+      int voice = -1;
+      int prev = -1;
+      int next = -1;
+      bool held = false;
+      bool sustained = false;
+    };
+
+    /// An intrusive list of notes, linked through `Note::prev` and `Note::next`
+    struct List {
+      int first = -1;
+      int last = -1;
+    };
+
+    void push_back(List& list, int key) noexcept;
+    void remove(List& list, int key) noexcept;
+
+    /// Take `voice` out of the free voices
+    void take_free(int voice) noexcept;
+
+    std::array<Note, note_count> _notes;
+    /// Held notes with a voice, oldest first
+    List _sounding;
+    /// Held notes without a voice, oldest first
+    List _waiting;
+
+    /// The voice each key last played on, or -1
+    std::array<int, note_count> _last_voice;
+
+    struct FreeVoice {
+      bool free = false;
+      int prev = -1;
+      int next = -1;
+    };
+    std::array<FreeVoice, max_voices> _free;
+    int _first_free = -1;
+    int _last_free = -1;
+  };
+
+} // namespace otto::core::voices
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+
+#include <gsl/span>
+
+namespace otto::core::voices {
+
+  /// A fixed number of voices, chosen at runtime, in one cache line aligned allocation
+  ///
+  /// Voices are neither copyable nor movable, so they are constructed in place, all with the
+  /// same arguments, and live as long as the arena.
+  template<typename T>
+  struct VoiceArena {
+    static constexpr std::size_t alignment = std::max<std::size_t>(alignof(T), 64);
+
+    template<typename... Args>
+    VoiceArena(int size, Args&... args)
+      : _data(static_cast<T*>(::operator new(sizeof(T) * size, std::align_val_t{alignment}))),
+        _size(size)
+    {
+      for (int i = 0; i < size; i++) new (_data + i) T{args...};
+    }
+
+    VoiceArena(const VoiceArena&) = delete;
+    VoiceArena& operator=(const VoiceArena&) = delete;
+
+    ~VoiceArena()
+    {
+      for (int i = 0; i < _size; i++) _data[i].~T();
+      ::operator delete(_data, std::align_val_t{alignment});
+    }
+
+    int size() const noexcept
+    {
+      return _size;
+    }
+
+    T& operator[](int i) noexcept
+    {
+      return _data[i];
+    }
+
+    T* begin() noexcept
+    {
+      return _data;
+    }
+
+    T* end() noexcept
+    {
+      return _data + _size;
+    }
+
+    gsl::span<T> span() noexcept
+    {
+      return {_data, _size};
+    }
+
+  private:
+    T* _data;
+    int _size;
+  };
+
+} // namespace otto::core::voices
@@ -0,0 +1,14 @@
+#include "voice_manager.hpp"
+
+#include <thread>
+
+namespace otto::core::voices::details {
+
+  util::WorkerPool& voice_workers()
+  {
+    static const int cores = std::thread::hardware_concurrency();
+    static util::WorkerPool pool{cores > 2 ? 1 : 0, cores - 1};
+    return pool;
+  }
+
+} // namespace otto::core::voices::details
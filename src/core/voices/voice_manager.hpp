@@ -1,25 +1,124 @@
 #pragma once
 
-#include <deque>
+#include <atomic>
+#include <cmath>
+#include <optional>
 #include <type_traits>
 #include <vector>
 
+#include <gsl/span>
+
 #include <Gamma/Envelope.h>
 #include "util/dsp/SegExpBypass.hpp"
+#include "util/dsp/envelope.hpp"
+#include "util/dsp/glide.hpp"
 
 #include "core/props/props.hpp"
 #include "core/ui/screen.hpp"
 
 #include "core/audio/processor.hpp"
+#include "core/voices/voice_allocator.hpp"
+#include "core/voices/voice_arena.hpp"
 
 #include "util/crtp.hpp"
 #include "util/algorithm.hpp"
+#include "util/handoff.hpp"
+#include "util/task_graph.hpp"
+
+#ifndef OTTO_VOICE_COUNT
+/// The number of voices of each synth, unless the board config defines it
+#define OTTO_VOICE_COUNT 6
+#endif
 
 namespace otto::core::voices {
 
-  template<typename PostT, int NumberOfVoices>
+  template<typename PostT, int MaxVoices>
   struct VoiceManager;
 
+  namespace details {
+    /// Check if `T` has a member `void process_block(gsl::span<float>)`
+    template<typename T, typename Enable = void>
+    struct has_process_block : std::false_type {};
+
+    template<typename T>
+    struct has_process_block<
+      T,
+      std::void_t<decltype(std::declval<T&>().process_block(std::declval<gsl::span<float>>()))>>
+      : std::true_type {};
+
+    template<typename T>
+    constexpr bool has_process_block_v = has_process_block<T>::value;
+
+    /// Check if `T` has a member `void process_block(gsl::span<float>, gsl::span<float>)`
+    template<typename T, typename Enable = void>
+    struct has_stereo_process_block : std::false_type {};
+
+    template<typename T>
+    struct has_stereo_process_block<T,
+                                    std::void_t<decltype(std::declval<T&>().process_block(
+                                      std::declval<gsl::span<float>>(),
+                                      std::declval<gsl::span<float>>()))>> : std::true_type {};
+
+    template<typename T>
+    constexpr bool has_stereo_process_block_v = has_stereo_process_block<T>::value;
+
+    /// The expression of a note, from polyphonic aftertouch or an MPE controller
+    struct Expression {
+      /// Frequency multiplier of the pitch bend of the note itself
+      float bend = 1.f;
+      /// From 0 to 1
+      float pressure = 0.f;
+      /// CC 74, from 0 to 1. Starts in the middle, like MPE controllers at rest.
+      float timbre = 0.5f;
+
+      /// Move each value towards `target` by `amount`, from 0 to 1
+      void approach(const Expression& target, float amount) noexcept
+      {
+        bend += (target.bend - bend) * amount;
+        pressure += (target.pressure - pressure) * amount;
+        timbre += (target.timbre - timbre) * amount;
+      }
+    };
+
+    /// The state of a voice that the voice manager updates for each active voice, every block
+    /// or every frame
+    ///
+    /// Kept apart from the voices, in one array in the voice manager, so its passes over the
+    /// active voices read a few adjacent cache lines, instead of the start of each voice, which
+    /// the oscillators and tables of the engines spread out over kilobytes.
+    struct VoiceState {
+      dsp::Envelope env;
+      dsp::Glide glide;
+      /// The expression of the note as last received, and the smoothed value the voice plays
+      Expression expression_target;
+      Expression expression;
+      /// The global pitch bend, the bend of the note, and `detune`, multiplied once per block
+      float pitch_ratio = 1.f;
+      /// Frequency multiplier of this voice within a unison group
+      float detune = 1.f;
+      /// The gains of the voice to the left and right, from its place in the stereo field
+      float gain_left = 1.f;
+      float gain_right = 1.f;
+      /// Frames left of the fade in after the voice was taken while still sounding
+      int fade_in = 0;
+    };
+  } // namespace details
+
+  /// Base class for the preprocessor
+  ///
+  /// The preprocessor is called once per sample, before the voices. It may instead implement
+  ///
+  /// ```cpp
+  /// void process_block(gsl::span<float> buffer) noexcept;
+  /// ```
+  ///
+  /// in which case it is called once per buffer, before any voice is processed. `buffer` is the
+  /// (zeroed) output buffer, and is only passed to give the block length.
+  ///
+  /// This is the place for values that only depend on the props or on the state of the
+  /// preprocessor, like tables of frequency ratios or a modulation shared by all notes. Compute
+  /// them once per buffer in `process_block`, and have the voices read them, instead of each
+  /// voice following the props and computing them itself.
   template<typename DerivedT, typename PropsT>
   struct PreBase : util::crtp<DerivedT, PreBase<DerivedT, PropsT>> {
     using Props = PropsT;
@@ -50,6 +149,18 @@ namespace otto::core::voices {
   /// It also lets the user implement handlers for note_on and note_off events, along with
   /// the main process call {@ref operator()}, which processes one sample at a time.
   ///
+  /// Voices may additionally implement
+  ///
+  /// ```cpp
+  /// void process_block(gsl::span<float> output) noexcept;
+  /// ```
+  ///
+  /// which should write one block of the raw voice signal to `output`. The envelope is applied
+  /// by the voice manager afterwards. In that case {@ref frequency()} is only updated once per
+  /// block, and is constant over the block unless the voice is gliding. Voices that only
+  /// implement `operator()` are run through a per-sample adapter, so engines can be migrated
+  /// one at a time.
+  ///
   /// @tparam Derived the derived voice type
   /// @tparam Props the Props type of the engine.
   template<typename DerivedT, typename PreT>
@@ -73,7 +184,7 @@ namespace otto::core::voices {
 
     /// Get the current frequency this voice should play
     ///
-    /// Needs to be applied separately for each sample to handle for example glide.
+    /// Updated for each sample while the voice glides, for voices without `process_block`.
     float frequency() noexcept;
     /// Change the current frequency
     void frequency(float) noexcept;
@@ -82,8 +193,16 @@ namespace otto::core::voices {
     float velocity() noexcept;
 
     /// Get the aftertouch value
+    ///
+    /// The polyphonic aftertouch of the note, or the channel pressure. Smoothed, and updated
+    /// once per block.
     float aftertouch() noexcept;
 
+    /// The timbre of the note, from CC 74
+    ///
+    /// Smoothed, and updated once per block.
+    float timbre() noexcept;
+
     /// Is this voice currently triggered?
     ///
     /// Not to be confused with whether it should play. It is not triggered in the
@@ -93,6 +212,15 @@ namespace otto::core::voices {
     /// The current envelope value
     float envelope() noexcept;
 
+    /// The gain of the raw voice signal, for retiring inaudible voices
+    ///
+    /// Multiplied with the envelope and compared to @ref VoiceManager::silence_floor. Voices
+    /// whose own envelope or level decays may hide this with its value.
+    float level() noexcept
+    {
+      return 1.f;
+    }
+
     Pre& pre;
     Props& props;
 
@@ -100,18 +228,38 @@ namespace otto::core::voices {
     template<typename T, int N>
     friend struct VoiceManager;
 
-    void trigger(int midi_note, float velocity) noexcept;
+    /// \param frequency The frequency of `midi_note` in the tuning of the voice manager
+    void trigger(int midi_note, float frequency, float velocity) noexcept;
+    /// Glide to `midi_note` without retriggering, for a legato note in mono mode
+    void legato(int midi_note, float frequency) noexcept;
     void release() noexcept;
 
     float frequency_ = 440.f;
     float velocity_ = 1.f;
-    float aftertouch_ = 0.f;
     int midi_note_ = 0;
-
-    gam::ADSR<> env_;
-    gam::SegExp<> glide_{0.f};
+    /// The midi channel of the note, which its MPE expression comes on
+    int channel_ = 0;
+    /// The envelope, glide and expression of the voice, kept by the voice manager, which sets
+    /// this when it is constructed. See @ref details::VoiceState.
+    details::VoiceState* state_ = nullptr;
   };
 
+  /// Base class for the postprocessor
+  ///
+  /// Called with the sum of all voices, once per sample. It may instead implement
+  ///
+  /// ```cpp
+  /// void process_block(gsl::span<float> buffer) noexcept;
+  /// ```
+  ///
+  /// which should process the summed voices in `buffer` in place. For the stereo rendering of
+  /// @ref VoiceManager::process_stereo, it implements
+  ///
+  /// ```cpp
+  /// void process_block(gsl::span<float> left, gsl::span<float> right) noexcept;
+  /// ```
+  ///
+  /// unless it keeps the default call operator, which passes the signal through.
   template<typename DerivedT, typename VoiceT>
   struct PostBase : util::crtp<DerivedT, PostBase<DerivedT, VoiceT>> {
     using Voice = VoiceT;
@@ -142,10 +290,22 @@ namespace otto::core::voices {
       poly,
       /// Only a single voice in use, allways playing the latest note
       mono,
-      /// All voices in use, all playing the latest note (posibly with detune)
+      /// Groups of voices each playing a note, with detune
       unison
     );
 
+    /// Which voice a note takes when all voices are playing
+    BETTER_ENUM(StealMode,
+      char,
+      /// The voice of the oldest note
+      oldest,
+      /// The voice with the lowest envelope value
+      quietest,
+      /// The voice of the oldest note, but a note takes the voice it last played on if that
+      /// is free, so repeated notes don't use up the voices still ringing out
+      same_note
+    );
+
     struct EnvelopeProps {
       props::Property<float> attack = {0, props::limits(0, 1), props::step_size(0.02)};
       props::Property<float> decay = {0, props::limits(0, 1), props::step_size(0.02)};
@@ -158,35 +318,96 @@ namespace otto::core::voices {
     struct SettingsProps {
       props::Property<PlayMode, props::wrap> play_mode = {
         PlayMode::poly, props::limits(PlayMode::poly, PlayMode::unison)};
+      /// The time of a glide to a new note, in seconds
       props::Property<float> portamento = {0, props::limits(0, 1),
                                                              props::step_size(0.01)};
+      /// In mono mode, a note played while another is held glides to it without retriggering
+      /// the envelope, and so does the held note when the new one is released
+      props::Property<bool, props::no_signal> legato = false;
       props::Property<int, props::no_signal> transpose = {0, props::limits(-12, 12)};
-
-      DECL_REFLECTION(SettingsProps, play_mode, portamento, transpose);
+      /// The spread of a unison group, where 1 is half a semitone either way
+      props::Property<float> detune = {0.2, props::limits(0, 1), props::step_size(0.01)};
+      /// The width of the voices in the stereo field, when rendered in stereo. The voices of a
+      /// unison group are spread like the detune, and in poly mode, each voice gets a place
+      /// of its own. At 1, the outermost voices are panned hard.
+      props::Property<float> spread = {0, props::limits(0, 1), props::step_size(0.05)};
+      props::Property<StealMode, props::wrap, props::no_signal> steal_mode = {
+        StealMode::oldest, props::limits(StealMode::oldest, StealMode::same_note)};
+      /// The name of a Scala scale in `data/tunings`, without the `.scl`. Empty for the
+      /// default tuning, see @ref midi::generateFreqTable.
+      props::Property<std::string> tuning = "";
+      /// Route pitch bend, pressure and CC 74 per channel, to the notes played on it, like MPE
+      /// controllers send them. The pitch bend of channel 1, the master channel, applies to all
+      /// notes.
+      props::Property<bool, props::no_signal> mpe = false;
+
+      DECL_REFLECTION(SettingsProps,
+                      play_mode,
+                      portamento,
+                      legato,
+                      transpose,
+                      detune,
+                      spread,
+                      steal_mode,
+                      tuning,
+                      mpe);
     };
 
     std::unique_ptr<ui::Screen> make_envelope_screen(EnvelopeProps& props);
     std::unique_ptr<ui::Screen> make_settings_screen(SettingsProps& props);
 
+    /// The worker shared by the voice managers that render their voices in parallel
+    ///
+    /// One worker, pinned to the last core, away from the workers of the routing graph. None
+    /// on boards with two cores or fewer, where the voices are rendered serially.
+    util::WorkerPool& voice_workers();
+
   } // namespace details
 
   // -- VOICE MANAGER INTERFACE -- //
 
   struct IVoiceManager {
     using PlayMode = details::PlayMode;
+    using StealMode = details::StealMode;
     using EnvelopeProps = details::EnvelopeProps;
     using SettingsProps = details::SettingsProps;
 
+    /// The number of voices a voice manager allocates when it is constructed
+    ///
+    /// Defaults to `OTTO_VOICE_COUNT`, from the board config. Set it at startup, before the
+    /// engines are constructed, to change it. Engines may allow fewer voices.
+    static inline int startup_voice_count = OTTO_VOICE_COUNT;
+
     virtual ~IVoiceManager() = default;
+
+    /// The number of voices allocated
     virtual int voice_count() noexcept = 0;
 
+    /// The most voices that play notes at once
+    virtual int max_active_voices() noexcept = 0;
+
+    /// Lower or raise the most voices that play notes at once, within @ref voice_count()
+    ///
+    /// Safe to call from any thread. Takes effect at the next buffer, where the notes on the
+    /// voices above the limit are stolen, like when more notes are played than there are voices.
+    virtual void max_active_voices(int) noexcept = 0;
+
+    /// The number of voices rendered in the last buffer, including ones in their release
+    ///
+    /// Written at the end of each `process`, and may be read from any thread.
+    virtual int sounding_voices() const noexcept = 0;
+
     virtual ui::Screen& envelope_screen() noexcept = 0;
     virtual ui::Screen& settings_screen() noexcept = 0;
   };
 
   // -- VOICE MANAGER -- //
 
-  template<typename PostT, int NumberOfVoices>
+  /// Manages the voices of a synth
+  ///
+  /// @tparam MaxVoices the most voices the engine supports. The voice count is
+  ///         @ref IVoiceManager::startup_voice_count, up to this.
+  template<typename PostT, int MaxVoices = VoiceAllocator::max_voices>
   struct VoiceManager : IVoiceManager {
     /// PostProcessor
     using Post = PostT;
@@ -200,12 +421,57 @@ namespace otto::core::voices {
     using Props = typename Post::PostBase::Props;
     using Pre = typename Post::PostBase::Pre;
 
-    /// The number of voices
-    static constexpr int voice_count_v = NumberOfVoices;
+    /// The most voices
+    static constexpr int max_voices_v = MaxVoices;
+
+    static_assert(max_voices_v <= VoiceAllocator::max_voices,
+                  "VoiceManager<Voice, N>: N is more than VoiceAllocator::max_voices");
 
     int voice_count() noexcept override
     {
-      return NumberOfVoices;
+      return voices_.size();
+    }
+
+    int max_active_voices() noexcept override
+    {
+      return max_active_voices_;
+    }
+
+    void max_active_voices(int) noexcept override;
+
+    int sounding_voices() const noexcept override
+    {
+      return sounding_voices_.load(std::memory_order_relaxed);
+    }
+
+    /// The default of @ref silence_floor, in dB
+    static constexpr float default_silence_floor = -90.f;
+
+    /// Retire released voices once their level is below `db`
+    ///
+    /// The level is the envelope, times @ref VoiceBase::level, times the gain of the unison
+    /// group. The release of the envelope takes long to reach zero, and the voices would be
+    /// rendered long after they are inaudible. Call from the constructor of the engine.
+    void silence_floor(float db) noexcept
+    {
+      silence_floor_ = std::pow(10.f, db / 20);
+    }
+
+    /// The level below which released voices are retired, in dB
+    float silence_floor() const noexcept
+    {
+      return 20 * std::log10(silence_floor_);
+    }
+
+    /// The number of voices playing each note in unison mode
+    ///
+    /// Half the voices, but at most 4. A group is adjacent voices in @ref voices(), so a note
+    /// never renders more than @ref voice_count() voices in total, and the voices of a group
+    /// sit next to each other in memory. Notes past the number of groups steal a group like in
+    /// poly mode.
+    int unison_voices() const noexcept
+    {
+      return std::clamp(voices_.size() / 2, 1, 4);
     }
 
     // Assert requirements met
@@ -213,11 +479,27 @@ namespace otto::core::voices {
                   "VoiceManager<Voice, N>: Voice must derive from VoiceBase<Voice, Pre>");
 
     using PlayMode = details::PlayMode;
+    using StealMode = details::StealMode;
     using EnvelopeProps = details::EnvelopeProps;
     using SettingsProps = details::SettingsProps;
 
+    /// The length of the crossfade when a voice is taken while it is still sounding
+    static constexpr int steal_fade_frames = 64;
+
+    /// The time constant, in seconds, of the smoothing of the note expression
+    static constexpr float expression_smoothing = 0.005f;
+
+    /// The pitch bend range of the notes on the MPE member channels, in octaves either way.
+    /// 48 semitones, the default of the MPE specification.
+    static constexpr int mpe_bend_octaves = 4;
+
     /// Constructor
-    VoiceManager(Props& props) noexcept;
+    ///
+    /// Allocates the voices
+    VoiceManager(Props& props);
+
+    /// Cancels loading a tuning
+    ~VoiceManager();
 
     ui::Screen& envelope_screen() noexcept override;
     ui::Screen& settings_screen() noexcept override;
@@ -225,57 +507,226 @@ namespace otto::core::voices {
     /// Process audio, applying Preprocessing, each voice and then postprocessing
     float operator()() noexcept;
 
+    /// Process one block of audio into `output`
+    ///
+    /// Only called from within @ref process, which sets the context. At most
+    /// @ref audio::max_buffer_size frames.
+    ///
+    /// Uses `process_block` on the preprocessor, the voices and the postprocessor where they
+    /// implement it, and falls back to the per-sample call operators where they don't. If none
+    /// of them implement it, this is equivalent to calling {@ref operator()} for each frame.
+    void process_block(gsl::span<float> output) noexcept;
+
+    /// Process one block of audio into `left` and `right`, with the voices panned by
+    /// @ref details::SettingsProps::spread
+    ///
+    /// Each voice is rendered once, and added to both sides with its two gains in the same pass,
+    /// so the stereo field costs a multiply-add per voice and frame, instead of a widener after
+    /// the mono sum. The tails of stolen voices play in the center. Requires the postprocessor
+    /// to have a stereo `process_block`, or none, see @ref PostBase.
+    void process_block(gsl::span<float> left, gsl::span<float> right) noexcept;
+
+    /// Above this many active voices, voices are rendered in parallel, if enabled
+    static constexpr int parallel_voice_threshold = 4;
+
+    /// Render the voices in two halves, one of them on @ref details::voice_workers
+    ///
+    /// Only for voices with a `process_block`, which are expensive enough to be worth the
+    /// handover. The voices are split by their place in @ref voices(), so each voice stays in
+    /// the same half, and the halves are summed before the postprocessor. If the worker is busy
+    /// with another voice manager, both halves are rendered on the calling thread.
+    ///
+    /// Call from the constructor of the engine, before it is processed.
+    void enable_parallel_voices();
+
     Voice& handle_midi_on(const midi::NoteOnEvent&) noexcept;
     Voice* handle_midi_off(const midi::NoteOffEvent&) noexcept;
     void handle_pitch_bend(const midi::PitchBendEvent&) noexcept;
     void handle_control_change(const midi::ControlChangeEvent&) noexcept;
 
+    /// Handle polyphonic aftertouch, channel pressure and CC 74, and with MPE, the pitch bend
+    /// of the member channels
+    ///
+    /// \returns whether `evt` was one of these
+    bool handle_expression(const midi::AnyMidiEvent& evt) noexcept;
+
     /// Process audio, applying Preprocessing, each voice and then postprocessing
     audio::ProcessData<1> process(audio::ProcessData<1> data) noexcept;
 
+    /// Process audio in stereo, like @ref process, with @ref process_block for two channels
+    audio::ProcessData<2> process_stereo(audio::ProcessData<1> data) noexcept;
+
     /// Return list of voices
-    std::array<Voice, voice_count_v>& voices();
+    gsl::span<Voice> voices() noexcept;
+
+    /// The preprocessor, shared by all voices
+    Pre& preprocessor() noexcept;
 
     DECL_REFLECTION(VoiceManager,
                     ("envelope", &VoiceManager::envelope_props),
                     ("voice_settings", &VoiceManager::settings_props));
 
   private:
+    /// The key of a note event, with octave and transpose applied, clamped to the MIDI range
+    int key_of(int key) noexcept;
+
     Voice& get_voice(int key) noexcept;
     Voice* stop_voice(int key) noexcept;
 
-    struct NoteVoicePair {
-      int note = 0;
-      Voice* voice = nullptr;
-      /// Whether a physical key is not holding this note down
-      /// 
-      /// When using a sustain pedal, this will be set to false on note off
-      bool should_release = false;
+    /// Whether a note that takes the voice of a held note in mono mode should glide to it, see
+    /// @ref details::SettingsProps::legato
+    bool legato() const noexcept;
 
-      bool has_voice() const noexcept
-      {
-        return voice != nullptr;
-      }
-    };
+    /// Trigger `voice`, and add it to the active voices
+    ///
+    /// In unison mode, `voice` is the first of a group, and the whole group is triggered.
+    void trigger_voice(Voice& voice, int key, float velocity, int channel) noexcept;
+
+    /// Release `voice`, or in unison mode, the group it is the first voice of
+    void release_voice(Voice& voice) noexcept;
+
+    /// Move `voice` to `key` without retriggering it, in mono mode
+    void legato_voice(Voice& voice, int key, int channel) noexcept;
+
+    /// Render the next @ref steal_fade_frames of `voice` (or its group) fading out into the
+    /// steal tail, and make it fade in when it is next rendered
+    ///
+    /// Called before a sounding voice is retriggered, so the old note fades out while the new
+    /// one fades in, instead of the waveform jumping.
+    void fade_out_voice(Voice& voice) noexcept;
+
+    /// Add the pending steal tail to the start of `output`, and of `right` if it is not empty
+    void mix_steal_tail(gsl::span<float> output, gsl::span<float> right = {}) noexcept;
+
+    /// Set up the voices for a buffer of `context`, at the start of @ref process
+    void begin_buffer(const audio::AudioContext* context) noexcept;
+
+    /// Handle a midi event, in the order of the frames
+    void handle_event(midi::AnyMidiEvent& evt) noexcept;
+
+    /// The gain of the fade in of a voice for its next frame
+    float fade_in(details::VoiceState& state) noexcept;
+
+    /// The state of `voice` in `states_`, found without reading the voice itself
+    details::VoiceState& state(Voice& voice) noexcept
+    {
+      return states_[&voice - voices_.begin()];
+    }
+
+    /// The sounding key whose voice has the lowest envelope value, or -1
+    int quietest_key() noexcept;
+
+    /// The number of voices triggered by each note
+    int group_size() const noexcept;
+
+    /// Load the tuning `settings_props.tuning` on the asset loader, and publish it to `tuning_`
+    void load_tuning(const std::string& name);
+
+    /// Give all voices within the active limit to the allocator, releasing all notes
+    void reset_voices() noexcept;
+
+    /// Take voices from or give voices to the allocator to match @ref max_active_voices()
+    void apply_voice_limit() noexcept;
+
+    /// Set the detune and the pan of each voice from its place in its unison group, or with
+    /// a spread in poly mode, from its place among the voices
+    void update_spread() noexcept;
+
+    /// The expression notes started on `channel` begin with
+    details::Expression& channel_expression(int channel) noexcept;
+
+    /// Call `set` with the expression of `channel`, and the expression of the held notes on it
+    ///
+    /// Without MPE, all channels are one, and `set` is called for all held notes.
+    template<typename F>
+    void set_expression(int channel, F&& set) noexcept;
+
+    /// Move the expression of the active voices towards their targets, for a block of
+    /// `nframes`, and update their pitch ratio
+    void update_expression(int nframes) noexcept;
+
+    /// Call `f` for each active voice, and retire the voices whose envelope has finished, or
+    /// whose release is below @ref silence_floor
+    template<typename F>
+    void for_each_active_voice(F&& f) noexcept;
+
+    /// Render a block of `voice` into `left`, and if it is not empty, `right`, using
+    /// `voice_out` and `env_out` as scratch
+    ///
+    /// For voices with a `process_block`
+    void render_voice(Voice& voice,
+                      gsl::span<float> left,
+                      gsl::span<float> right,
+                      float* voice_out,
+                      float* env_out) noexcept;
+
+    /// Render the active voices of half `half` into `parallel_out_[half]`, and in stereo,
+    /// `parallel_right_[half]`, without retiring any
+    void render_half(int half) noexcept;
+
+    /// Render the active voices into `left`, and if it is not empty, `right`, after the
+    /// preprocessor
+    void render_voices(gsl::span<float> left, gsl::span<float> right) noexcept;
 
     float pitch_bend_ = 1;
+    /// The last expression received on each channel. Only the first is used without MPE.
+    std::array<details::Expression, 16> channel_expression_ = {};
+    /// The tuning of the preset, if it has one
+    util::Handoff<midi::FreqTable> tuning_;
+    /// The tuning in use, acquired from `tuning_` at the start of each buffer
+    const midi::FreqTable* freq_table_ = &midi::detail::freq_table;
+    /// The context of the buffer being processed, set at the start of @ref process
+    const audio::AudioContext* context_ = nullptr;
+    /// Scales the sum of the voices, so a unison group is about as loud as one voice
+    float voice_gain_ = 1;
+    /// The linear level of @ref silence_floor
+    float silence_floor_ = std::pow(10.f, default_silence_floor / 20);
+
+    /// The output of @ref process and @ref process_stereo, kept across callbacks
+    audio::EngineBuffers<2> output_;
+    /// The voice and envelope scratch of each half of the voices, and the two sides of the
+    /// output of the second half when rendered in parallel
+    audio::EngineBuffers<6> scratch_;
+
+    /// The faded out tails of voices that were taken while sounding, from `steal_tail_pos_`
+    /// to `steal_tail_end_`
+    std::array<float, steal_fade_frames> steal_tail_ = {};
+    int steal_tail_pos_ = 0;
+    int steal_tail_end_ = 0;
 
     props::Property<bool> sustain_ = {false};
 
-    std::deque<Voice*> free_voices;
-    std::vector<NoteVoicePair> note_stack;
+    /// Which voice, or in unison mode which group, plays each held note
+    VoiceAllocator allocator_;
+
+    /// The voices whose envelope is not done. Only these are rendered.
+    std::array<Voice*, max_voices_v> active_voices_ = {};
+    int active_voice_count_ = 0;
+    /// `active_voice_count_` at the end of the last buffer, for @ref sounding_voices
+    std::atomic<int> sounding_voices_ = 0;
+
+    /// The requested limit of voices, and the one the allocator has
+    std::atomic<int> max_active_voices_;
+    int applied_voice_limit_;
 
     Props& props;
     Pre pre = {props};
-    std::array<Voice, voice_count_v> voices_ =
-      util::generate_array<voice_count_v>([this](auto) { return Voice{pre}; });
+    VoiceArena<Voice> voices_ = {std::min(startup_voice_count, max_voices_v), pre};
+    /// The state of each voice that is updated for all active voices, in the order of `voices_`
+    VoiceArena<details::VoiceState> states_ = {voices_.size()};
     Post post = {pre};
 
+    /// Renders each half of the voices, if @ref enable_parallel_voices was called
+    std::unique_ptr<util::TaskGraph> parallel_graph_;
+    /// The output of each half during @ref process_block, and of the right side in stereo
+    std::array<gsl::span<float>, 2> parallel_out_;
+    std::array<gsl::span<float>, 2> parallel_right_;
+
     EnvelopeProps envelope_props;
     SettingsProps settings_props;
 
-    std::unique_ptr<ui::Screen> envelope_screen_ = details::make_envelope_screen(envelope_props);
-    std::unique_ptr<ui::Screen> settings_screen_ = details::make_settings_screen(settings_props);
+    ui::LazyScreen envelope_screen_ = {[this] { return details::make_envelope_screen(envelope_props); }};
+    ui::LazyScreen settings_screen_ = {[this] { return details::make_settings_screen(settings_props); }};
     PlayMode play_mode = PlayMode::mono;
 
   }; // namespace otto::core::voices
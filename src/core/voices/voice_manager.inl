@@ -1,7 +1,8 @@
 #pragma once
 
+#include "core/audio/tuning.hpp"
+#include "services/asset_loader.hpp"
 #include "services/audio_manager.hpp"
-#include "services/ui_manager.hpp"
 #include "voice_manager.hpp"
 
 namespace otto::core::voices {
@@ -16,10 +17,7 @@ namespace otto::core::voices {
 
   template<typename D, typename P>
   VoiceBase<D, P>::VoiceBase(Pre& pre) noexcept : pre(pre), props(pre.props)
-  {
-    glide_ = frequency();
-    env_.finish();
-  }
+  {}
 
   template<typename D, typename P>
   void VoiceBase<D, P>::on_note_on() noexcept
@@ -50,38 +48,50 @@ namespace otto::core::voices {
   template<typename D, typename P>
   float VoiceBase<D, P>::aftertouch() noexcept
   {
-    return aftertouch_;
+    return state_->expression.pressure;
+  }
+
+  template<typename D, typename P>
+  float VoiceBase<D, P>::timbre() noexcept
+  {
+    return state_->expression.timbre;
   }
 
   template<typename D, typename P>
   bool VoiceBase<D, P>::is_triggered() noexcept
   {
-    return !env_.released();
+    return !state_->env.released();
   }
 
   template<typename D, typename P>
   float VoiceBase<D, P>::envelope() noexcept
   {
-    return env_.value();
+    return state_->env.value();
   }
 
   template<typename D, typename P>
-  void VoiceBase<D, P>::trigger(int midi_note, float velocity) noexcept
+  void VoiceBase<D, P>::trigger(int midi_note, float frequency, float velocity) noexcept
   {
     midi_note_ = midi_note;
-    //Sets target value of portamento to new note
-    glide_ = midi::note_freq(midi_note);
-    frequency_ = glide_();
+    state_->glide.target(frequency);
+    frequency_ = state_->glide.value();
     velocity_ = velocity;
     on_note_on();
-    env_.resetSoft();
+    state_->env.trigger();
+  }
+
+  template<typename D, typename P>
+  void VoiceBase<D, P>::legato(int midi_note, float frequency) noexcept
+  {
+    midi_note_ = midi_note;
+    state_->glide.target(frequency);
   }
 
   template<typename D, typename P>
   void VoiceBase<D, P>::release() noexcept
   {
     if (is_triggered()) {
-      env_.release();
+      state_->env.release();
       on_note_off();
     }
   }
@@ -95,54 +105,73 @@ namespace otto::core::voices {
   // VOICE MANAGER //
 
   template<typename V, int N>
-  VoiceManager<V, N>::VoiceManager(Props& props) noexcept : props(props)
+  VoiceManager<V, N>::VoiceManager(Props& props) : props(props)
   {
-    for (int i = 0; i < voice_count_v; ++i) {
+    max_active_voices_ = applied_voice_limit_ = voices_.size();
+    for (int i = 0; i < voices_.size(); ++i) {
       auto& voice = voices_[i];
+      auto& state = states_[i];
+      voice.state_ = &state;
+      state.glide.jump(voice.frequency());
+      state.env.finish();
       envelope_props.attack.on_change().connect(
-        [&voice](float attack) { voice.env_.attack(8 * attack * attack + 0.02); });
-      envelope_props.decay.on_change().connect([&voice](float decay) { voice.env_.decay(decay + 0.02); });
+        [&state](float attack) { state.env.attack(8 * attack * attack + 0.02); });
+      envelope_props.decay.on_change().connect([&state](float decay) { state.env.decay(decay + 0.02); });
       envelope_props.sustain.on_change().connect(
-        [&voice](float sustain) { voice.env_.sustain(sustain); });
+        [&state](float sustain) { state.env.sustain(sustain); });
       envelope_props.release.on_change().connect(
-        [&voice](float release) { voice.env_.release(4 * release * release + 0.02); });
+        [&state](float release) { state.env.release(4 * release * release + 0.02); });
 
       settings_props.portamento.on_change()
-        .connect([&voice](float p) {
-          voice.glide_.period(p);
+        .connect([&state](float p) {
+          state.glide.time(p);
         }).call_now(settings_props.portamento);
     }
 
     settings_props.play_mode.on_change()
       .connect([this](PlayMode mode) {
-        util::for_each(voices_, &Voice::release);
-        note_stack.clear();
-        free_voices.clear();
-
-        switch (mode) {
-        case PlayMode::unison:
-          // TODO: Can not be implemented this way
-          [[fallthrough]];
-        case PlayMode::mono: free_voices.push_back(&voices_[0]); break;
-        case PlayMode::poly:
-          for (auto& voice : voices_) free_voices.push_back(&voice);
-        }
+        play_mode = mode;
+        reset_voices();
+        voice_gain_ = 1.f / std::sqrt(float(group_size()));
+        update_spread();
       })
       .call_now(settings_props.play_mode);
 
+    settings_props.detune.on_change().connect([this](float) { update_spread(); });
+    settings_props.spread.on_change().connect([this](float) { update_spread(); });
+    settings_props.tuning.on_change().connect([this](const std::string& name) { load_tuning(name); });
+
     sustain_.on_change().connect([this](bool val) {
       if (!val) {
-        auto copy = note_stack;
-        for (auto&& nvp : copy) {
-          if (nvp.should_release) {
-            stop_voice(nvp.note);
-            DLOGI("Released note {}", nvp.note);
-          }
+        for (int key : allocator_.sustained()) {
+          stop_voice(key);
+          DRTLOGI("Released note {}", key);
         }
       }
     });
   }
 
+  template<typename V, int N>
+  VoiceManager<V, N>::~VoiceManager()
+  {
+    services::AssetLoader::current().cancel(&tuning_);
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::load_tuning(const std::string& name)
+  {
+    auto& loader = services::AssetLoader::current();
+    if (name.empty()) {
+      loader.cancel(&tuning_);
+      tuning_.publish(nullptr);
+      return;
+    }
+    auto path = Application::current().data_dir / "tunings" / (name + ".scl");
+    loader.load(
+      &tuning_, [path] { return midi::load_tuning(path); },
+      [this](std::unique_ptr<midi::FreqTable> table) { tuning_.publish(std::move(table)); });
+  }
+
   template<typename V, int N>
   ui::Screen& VoiceManager<V, N>::envelope_screen() noexcept
   {
@@ -159,37 +188,221 @@ namespace otto::core::voices {
   float VoiceManager<V, N>::operator()() noexcept
   {
     pre();
+    update_expression(1);
     float voice_sum = 0.f;
-    for (auto& voice : voices_) {
-      ///Change frequency if applicable
-      //voice.frequency(midi::note_freq(voice.midi_note_) * pitch_bend_);
-      voice.frequency(voice.glide_() * pitch_bend_);
+    for_each_active_voice([&](Voice& voice) {
+      auto& st = state(voice);
+      voice.frequency(st.glide() * st.pitch_ratio);
       ///Get next sample
-      voice_sum += voice.env_() * voice();
+      voice_sum += st.env() * voice() * fade_in(st);
+    });
+    mix_steal_tail({&voice_sum, 1});
+    return post(voice_sum * voice_gain_);
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::process_block(gsl::span<float> output) noexcept
+  {
+    constexpr bool block_pre = details::has_process_block_v<Pre>;
+    constexpr bool block_voice = details::has_process_block_v<Voice>;
+    constexpr bool block_post = details::has_process_block_v<Post>;
+
+    std::fill(output.begin(), output.end(), 0.f);
+    update_expression(output.size());
+
+    if constexpr (block_pre || block_voice) {
+      if constexpr (block_pre) {
+        pre.process_block(output);
+      } else {
+        for (int i = 0; i < output.size(); i++) pre();
+      }
+      render_voices(output, {});
+    } else {
+      for (auto& frm : output) {
+        pre();
+        for_each_active_voice([&](Voice& voice) {
+          auto& st = state(voice);
+          voice.frequency(st.glide() * st.pitch_ratio);
+          frm += st.env() * voice() * fade_in(st);
+        });
+      }
+    }
+
+    mix_steal_tail(output);
+
+    if (voice_gain_ != 1.f) {
+      for (auto& frm : output) frm *= voice_gain_;
+    }
+
+    if constexpr (block_post) {
+      post.process_block(output);
+    } else {
+      for (auto& frm : output) frm = post(frm);
+    }
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::process_block(gsl::span<float> left, gsl::span<float> right) noexcept
+  {
+    constexpr bool block_pre = details::has_process_block_v<Pre>;
+    constexpr bool block_voice = details::has_process_block_v<Voice>;
+    constexpr bool stereo_post = details::has_stereo_process_block_v<Post>;
+    static_assert(stereo_post || std::is_same_v<decltype(&Post::operator()),
+                                                 decltype(&PostBase<Post, Voice>::operator())>,
+                  "Rendering in stereo needs a stereo `process_block` on a postprocessor that "
+                  "has a call operator");
+
+    std::fill(left.begin(), left.end(), 0.f);
+    std::fill(right.begin(), right.end(), 0.f);
+    update_expression(left.size());
+
+    if constexpr (block_pre || block_voice) {
+      if constexpr (block_pre) {
+        pre.process_block(left);
+      } else {
+        for (int i = 0; i < left.size(); i++) pre();
+      }
+      render_voices(left, right);
+    } else {
+      for (int i = 0; i < left.size(); i++) {
+        pre();
+        for_each_active_voice([&](Voice& voice) {
+          auto& st = state(voice);
+          voice.frequency(st.glide() * st.pitch_ratio);
+          float frm = st.env() * voice() * fade_in(st);
+          left[i] += frm * st.gain_left;
+          right[i] += frm * st.gain_right;
+        });
+      }
+    }
+
+    mix_steal_tail(left, right);
+
+    if (voice_gain_ != 1.f) {
+      util::audio::kernels().scale(left.data(), voice_gain_, left.size());
+      util::audio::kernels().scale(right.data(), voice_gain_, right.size());
+    }
+
+    if constexpr (stereo_post) post.process_block(left, right);
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::render_voices(gsl::span<float> left, gsl::span<float> right) noexcept
+  {
+    const bool stereo = !right.empty();
+    if constexpr (details::has_process_block_v<Voice>) {
+      if (parallel_graph_ && active_voice_count_ > parallel_voice_threshold) {
+        float* second = scratch_.data(4);
+        float* second_right = scratch_.data(5);
+        std::fill_n(second, left.size(), 0.f);
+        if (stereo) std::fill_n(second_right, right.size(), 0.f);
+        parallel_out_ = {left, {second, left.size()}};
+        parallel_right_ = {right, {}};
+        if (stereo) parallel_right_[1] = {second_right, right.size()};
+        if (!details::voice_workers().try_run(*parallel_graph_)) parallel_graph_->run();
+        auto& kernels = util::audio::kernels();
+        kernels.add(second, left.data(), left.size());
+        if (stereo) kernels.add(second_right, right.data(), right.size());
+        // Retire the finished voices, now that no other thread is rendering them
+        for_each_active_voice([](Voice&) {});
+      } else {
+        for_each_active_voice(
+          [&](Voice& voice) { render_voice(voice, left, right, scratch_.data(0), scratch_.data(1)); });
+      }
+    } else {
+      for_each_active_voice([&](Voice& voice) {
+        auto& st = state(voice);
+        // The frequency only changes per frame while the voice glides
+        const bool gliding = st.glide.gliding();
+        voice.frequency(st.glide.value() * st.pitch_ratio);
+        for (int i = 0; i < left.size(); i++) {
+          if (gliding) voice.frequency(st.glide() * st.pitch_ratio);
+          float frm = st.env() * voice() * fade_in(st);
+          if (stereo) {
+            left[i] += frm * st.gain_left;
+            right[i] += frm * st.gain_right;
+          } else {
+            left[i] += frm;
+          }
+        }
+      });
+    }
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::enable_parallel_voices()
+  {
+    if (parallel_graph_) return;
+    details::voice_workers();
+    parallel_graph_ = std::make_unique<util::TaskGraph>();
+    parallel_graph_->add([this] { render_half(0); });
+    parallel_graph_->add([this] { render_half(1); });
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::render_voice(Voice& voice,
+                                        gsl::span<float> left,
+                                        gsl::span<float> right,
+                                        float* voice_out,
+                                        float* env_out) noexcept
+  {
+    const int nframes = left.size();
+    auto& st = state(voice);
+    voice.frequency(st.glide.advance(nframes) * st.pitch_ratio);
+    voice.process_block({voice_out, nframes});
+    st.env.process({env_out, nframes});
+    if (st.fade_in > 0) {
+      for (int i = 0; i < nframes; i++) env_out[i] *= fade_in(st);
+    }
+    if (right.empty()) {
+      for (int i = 0; i < nframes; i++) {
+        left[i] += env_out[i] * voice_out[i];
+      }
+      return;
+    }
+    // Both sides in one pass
+    const float gain_left = st.gain_left;
+    const float gain_right = st.gain_right;
+    for (int i = 0; i < nframes; i++) {
+      float frm = env_out[i] * voice_out[i];
+      left[i] += frm * gain_left;
+      right[i] += frm * gain_right;
+    }
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::render_half(int half) noexcept
+  {
+    float* scratch = scratch_.data(2 * half);
+    float* env_scratch = scratch_.data(2 * half + 1);
+    for (int i = 0; i < active_voice_count_; i++) {
+      Voice& voice = *active_voices_[i];
+      if ((&voice - voices_.begin()) % 2 != half) continue;
+      render_voice(voice, parallel_out_[half], parallel_right_[half], scratch, env_scratch);
     }
-    return post(voice_sum);
   }
 
   template<typename V, int N>
   auto VoiceManager<V, N>::handle_midi_on(const midi::NoteOnEvent& evt) noexcept -> Voice&
   {
-    auto key = evt.key + services::UIManager::current().state.octave * 12 + settings_props.transpose;
+    auto key = key_of(evt.key);
     stop_voice(key);
     Voice& voice = get_voice(key);
-    note_stack.push_back({key, &voice});
-    voice.trigger(key, evt.velocity / 127.f);
+    // A legato note keeps the voice of the held note, still triggered
+    if (legato() && voice.is_triggered()) {
+      legato_voice(voice, key, evt.channel);
+    } else {
+      trigger_voice(voice, key, evt.velocity / 127.f, evt.channel);
+    }
     return voice;
   }
 
   template<typename V, int N>
   auto VoiceManager<V, N>::handle_midi_off(const midi::NoteOffEvent& evt) noexcept -> Voice*
   {
-    auto key = evt.key + services::UIManager::current().state.octave * 12 + settings_props.transpose;
+    auto key = key_of(evt.key);
     if (sustain_) {
-      auto found = util::find_if(note_stack, [&] (auto& nvp) { return nvp.note == key; });
-      if (found != note_stack.end()) {
-        found->should_release = true;
-      }
+      allocator_.sustain(key);
       return nullptr;
     } else {
       return stop_voice(key);
@@ -200,7 +413,7 @@ namespace otto::core::voices {
   template<typename V, int N>
   void VoiceManager<V, N>::handle_pitch_bend(const midi::PitchBendEvent& evt) noexcept
   {
-    pitch_bend_ = powf(2.f, ((float)evt.value / 8192.f) - 1.f);
+    pitch_bend_ = midi::pitch_bend_ratio(evt.value);
   }
 
   template<typename V, int N>
@@ -213,80 +426,367 @@ namespace otto::core::voices {
   }
 
   template<typename V, int N>
-  audio::ProcessData<1> VoiceManager<V, N>::process(audio::ProcessData<1> data) noexcept
+  bool VoiceManager<V, N>::handle_expression(const midi::AnyMidiEvent& evt) noexcept
   {
-    for (auto& evt : data.midi) {
-      util::match(evt, [&](midi::NoteOnEvent& evt) { handle_midi_on(evt); },
-                  [&](midi::NoteOffEvent& evt) { handle_midi_off(evt); },
-                  [&](midi::ControlChangeEvent& evt) { handle_control_change(evt); },
-                  [&](midi::PitchBendEvent& evt) { handle_pitch_bend(evt); },
-                  [](auto&) {});
+    const int channel = evt.status & 0x0F;
+    switch (evt.status >> 4) {
+    case 0xA: {
+      // Polyphonic aftertouch, for the voices of one key
+      int voice = allocator_.voice(key_of(evt.data[0]));
+      if (voice < 0) return true;
+      for (auto v = &states_[voice]; v != &states_[voice] + group_size(); v++) {
+        v->expression_target.pressure = evt.data[1] / 127.f;
+      }
+      return true;
+    }
+    case 0xD:
+      set_expression(channel, [p = evt.data[0] / 127.f](auto& e) { e.pressure = p; });
+      return true;
+    case 0xB:
+      if (evt.data[0] != 74) return false;
+      set_expression(channel, [t = evt.data[1] / 127.f](auto& e) { e.timbre = t; });
+      return true;
+    case 0xE: {
+      // The master channel bends all notes, like pitch bend without MPE
+      if (!settings_props.mpe || channel == 0) return false;
+      float bend = std::pow(midi::pitch_bend_ratio(evt.pitch_bend().value), float(mpe_bend_octaves));
+      set_expression(channel, [bend](auto& e) { e.bend = bend; });
+      return true;
     }
-    auto buf = Application::current().audio_manager->buffer_pool().allocate();
-    for (auto& frm : buf) {
-      frm = (*this)();
+    default: return false;
     }
-    return data.redirect(buf);
+  }
+
+  template<typename V, int N>
+  details::Expression& VoiceManager<V, N>::channel_expression(int channel) noexcept
+  {
+    return channel_expression_[settings_props.mpe ? channel : 0];
+  }
+
+  template<typename V, int N>
+  template<typename F>
+  void VoiceManager<V, N>::set_expression(int channel, F&& set) noexcept
+  {
+    const bool mpe = settings_props.mpe;
+    set(channel_expression(channel));
+    for (int i = 0; i < active_voice_count_; i++) {
+      Voice& v = *active_voices_[i];
+      if (v.is_triggered() && (!mpe || v.channel_ == channel)) set(state(v).expression_target);
+    }
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::update_expression(int nframes) noexcept
+  {
+    const float amount = std::min(1.f, nframes / float(expression_smoothing * gam::sampleRate()));
+    for (int i = 0; i < active_voice_count_; i++) {
+      auto& st = state(*active_voices_[i]);
+      st.expression.approach(st.expression_target, amount);
+      st.pitch_ratio = pitch_bend_ * st.expression.bend * st.detune;
+    }
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::begin_buffer(const audio::AudioContext* context) noexcept
+  {
+    apply_voice_limit();
+    auto* tuning = tuning_.acquire();
+    freq_table_ = tuning ? tuning : &midi::detail::freq_table;
+    context_ = context;
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::handle_event(midi::AnyMidiEvent& evt) noexcept
+  {
+    if (handle_expression(evt)) return;
+    util::match(evt, [&](midi::NoteOnEvent& evt) { handle_midi_on(evt); },
+                [&](midi::NoteOffEvent& evt) { handle_midi_off(evt); },
+                [&](midi::ControlChangeEvent& evt) { handle_control_change(evt); },
+                [&](midi::PitchBendEvent& evt) { handle_pitch_bend(evt); }, [](auto&) {});
+  }
+
+  template<typename V, int N>
+  audio::ProcessData<1> VoiceManager<V, N>::process(audio::ProcessData<1> data) noexcept
+  {
+    begin_buffer(data.context);
+    auto [buf] = output_.acquire<1>(*context_, data.nframes);
+    audio::split_by_midi(data.redirect(buf.view()), [&](midi::AnyMidiEvent& evt) { handle_event(evt); },
+                         [&](audio::ProcessData<1> slice) {
+                           process_block({slice.audio.data(), slice.nframes});
+                         });
+    sounding_voices_.store(active_voice_count_, std::memory_order_relaxed);
+    return data.redirect(std::move(buf));
+  }
+
+  template<typename V, int N>
+  audio::ProcessData<2> VoiceManager<V, N>::process_stereo(audio::ProcessData<1> data) noexcept
+  {
+    begin_buffer(data.context);
+    auto buf = output_.acquire(*context_, data.nframes);
+    float* left = buf[0].data();
+    float* right = buf[1].data();
+    // The slices are of the left side, and the right side is sliced alongside
+    audio::split_by_midi(data.redirect(buf[0].view()), [&](midi::AnyMidiEvent& evt) { handle_event(evt); },
+                         [&](audio::ProcessData<1> slice) {
+                           auto offset = slice.audio.data() - left;
+                           process_block({slice.audio.data(), slice.nframes}, {right + offset, slice.nframes});
+                         });
+    sounding_voices_.store(active_voice_count_, std::memory_order_relaxed);
+    return data.redirect(std::move(buf));
+  }
+
+  template<typename V, int N>
+  int VoiceManager<V, N>::key_of(int key) noexcept
+  {
+    key += context_->octave * 12 + settings_props.transpose;
+    return std::clamp(key, 0, VoiceAllocator::note_count - 1);
   }
 
   template<typename V, int N>
   auto VoiceManager<V, N>::get_voice(int key) noexcept -> Voice&
   {
-    if (free_voices.size() > 0) {
-      auto it = util::find_if(note_stack, [key](NoteVoicePair& nvp) { return nvp.note == key; });
-      auto fvit = it == note_stack.end() ? free_voices.begin() : util::find(free_voices, it->voice);
-      auto& v = **fvit;
-      free_voices.erase(fvit);
-      return v;
+    const StealMode mode = settings_props.steal_mode;
+    const int steal_key = mode == +StealMode::quietest ? quietest_key() : -1;
+    auto allocation = allocator_.note_on(key, steal_key, mode == +StealMode::same_note);
+    if (allocation.voice < 0) {
+      DRTLOGE("No voice found. Using voice 0");
+      return voices_[0];
+    }
+    Voice& v = voices_[allocation.voice];
+    // The held note glides on to the new one
+    if (allocation.stolen_key >= 0 && legato()) return v;
+    // Fade out what the voice is still playing, be it a stolen note or a release
+    if (!state(v).env.done()) fade_out_voice(v);
+    if (allocation.stolen_key >= 0) {
+      DRTLOGI("Stealing voice {} from key {}", allocation.voice, allocation.stolen_key);
+      release_voice(v);
+    }
+    return v;
+  }
+
+  template<typename V, int N>
+  auto VoiceManager<V, N>::stop_voice(int key) noexcept -> Voice*
+  {
+    auto released = allocator_.note_off(key);
+    if (released.voice < 0) return nullptr;
+    Voice& v = voices_[released.voice];
+    if (released.next_key >= 0 && legato()) {
+      legato_voice(v, released.next_key, v.channel_);
+    } else if (released.next_key >= 0) {
+      fade_out_voice(v);
+      // TODO: Restore original velocity
+      trigger_voice(v, released.next_key, v.velocity_, v.channel_);
     } else {
-      auto found = util::find_if(note_stack, [](NoteVoicePair& nvp) { return nvp.has_voice(); });
-      if (found != note_stack.end()) {
-        DLOGI("Stealing voice {} from key {}", (found->voice - voices_.data()), found->note);
-        Voice& v = *found->voice;
-        v.release();
-        found->voice = nullptr;
-        return v;
-      } else {
-        DLOGE("No voice found. Using voice 0");
-        return voices_[0];
+      release_voice(v);
+    }
+    return &v;
+  }
+
+  template<typename V, int N>
+  bool VoiceManager<V, N>::legato() const noexcept
+  {
+    return play_mode == +PlayMode::mono && settings_props.legato;
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::legato_voice(Voice& voice, int key, int channel) noexcept
+  {
+    voice.channel_ = channel;
+    state(voice).expression_target = channel_expression(channel);
+    voice.legato(key, (*freq_table_)[key]);
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::trigger_voice(Voice& voice, int key, float velocity, int channel) noexcept
+  {
+    auto first = &voice;
+    for (auto v = first; v != first + group_size(); v++) {
+      v->channel_ = channel;
+      auto& st = state(*v);
+      st.expression = st.expression_target = channel_expression(channel);
+      v->trigger(key, (*freq_table_)[key], velocity);
+      auto last = active_voices_.begin() + active_voice_count_;
+      if (std::find(active_voices_.begin(), last, v) == last) {
+        active_voices_[active_voice_count_++] = v;
       }
     }
   }
 
   template<typename V, int N>
-  auto VoiceManager<V, N>::stop_voice(int key) noexcept -> Voice*
+  void VoiceManager<V, N>::release_voice(Voice& voice) noexcept
   {
-    auto free_voice = [this](Voice& v) {
-      auto found = std::find_if(note_stack.rbegin(), note_stack.rend(),
-                                [](auto nvp) { return !nvp.has_voice(); });
-      if (found != note_stack.rend()) {
-        found->voice = &v;
-        // TODO: Restore original velocity
-        v.trigger(found->note, v.velocity_);
+    auto first = &voice;
+    for (auto v = first; v != first + group_size(); v++) v->release();
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::fade_out_voice(Voice& voice) noexcept
+  {
+    // Move the pending tail to the front, and extend it to a full fade
+    std::copy(steal_tail_.begin() + steal_tail_pos_, steal_tail_.begin() + steal_tail_end_,
+              steal_tail_.begin());
+    std::fill(steal_tail_.begin() + (steal_tail_end_ - steal_tail_pos_), steal_tail_.end(), 0.f);
+    steal_tail_pos_ = 0;
+    steal_tail_end_ = steal_fade_frames;
+
+    std::array<float, steal_fade_frames> rendered;
+    std::array<float, steal_fade_frames> env;
+    auto first = &voice;
+    for (auto v = first; v != first + group_size(); v++) {
+      auto& st = state(*v);
+      if (st.env.done()) continue;
+      v->frequency(st.glide.value() * st.pitch_ratio);
+      if constexpr (details::has_process_block_v<Voice>) {
+        v->process_block(rendered);
       } else {
-        v.release();
-        free_voices.push_back(&v);
+        for (auto& f : rendered) f = (*v)();
       }
-    };
-    Voice* res = nullptr;
-    auto it = util::remove_if(note_stack, [&](auto nvp) {
-      if (nvp.note == key) {
-        if (nvp.has_voice()) {
-          free_voice(*nvp.voice);
-          res = nvp.voice;
-        }
-        return true;
+      st.env.process(env);
+      for (int i = 0; i < steal_fade_frames; i++) {
+        float fade = 1.f - float(i + 1) / steal_fade_frames;
+        steal_tail_[i] += env[i] * fade_in(st) * rendered[i] * fade;
       }
-      return false;
-    });
-    note_stack.erase(it, note_stack.end());
+      st.fade_in = steal_fade_frames;
+    }
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::mix_steal_tail(gsl::span<float> output, gsl::span<float> right) noexcept
+  {
+    int n = std::min<int>(output.size(), steal_tail_end_ - steal_tail_pos_);
+    for (int i = 0; i < n; i++) output[i] += steal_tail_[steal_tail_pos_ + i];
+    if (!right.empty()) {
+      for (int i = 0; i < n; i++) right[i] += steal_tail_[steal_tail_pos_ + i];
+    }
+    steal_tail_pos_ += n;
+  }
+
+  template<typename V, int N>
+  float VoiceManager<V, N>::fade_in(details::VoiceState& state) noexcept
+  {
+    if (state.fade_in == 0) return 1.f;
+    return 1.f - float(state.fade_in--) / steal_fade_frames;
+  }
+
+  template<typename V, int N>
+  int VoiceManager<V, N>::quietest_key() noexcept
+  {
+    int res = -1;
+    float quietest = 0;
+    for (int key = allocator_.first_sounding(); key >= 0; key = allocator_.next_sounding(key)) {
+      float env = states_[allocator_.voice(key)].env.value();
+      if (res < 0 || env < quietest) {
+        res = key;
+        quietest = env;
+      }
+    }
     return res;
   }
 
   template<typename V, int N>
-  auto VoiceManager<V, N>::voices() -> std::array<Voice, voice_count_v>&
+  int VoiceManager<V, N>::group_size() const noexcept
+  {
+    return play_mode == +PlayMode::unison ? unison_voices() : 1;
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::reset_voices() noexcept
+  {
+    util::for_each(voices_, &Voice::release);
+    allocator_.clear();
+    if (play_mode == +PlayMode::mono) {
+      allocator_.free_voice(0);
+      return;
+    }
+    const int size = group_size();
+    for (int i = 0; i + size <= applied_voice_limit_; i += size) allocator_.free_voice(i);
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::max_active_voices(int count) noexcept
+  {
+    max_active_voices_ = std::clamp(count, 1, voice_count());
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::apply_voice_limit() noexcept
+  {
+    const int limit = max_active_voices_;
+    if (limit == applied_voice_limit_) return;
+    const int old_limit = applied_voice_limit_;
+    applied_voice_limit_ = limit;
+    // Mono only uses the first voice
+    if (play_mode == +PlayMode::mono) return;
+    const int size = group_size();
+    // Voices (or groups) that fit below the limit
+    auto count = [size](int limit) { return limit / size * size; };
+    for (int i = count(limit); i < count(old_limit); i += size) {
+      if (allocator_.disable_voice(i) >= 0) release_voice(voices_[i]);
+    }
+    for (int i = count(old_limit); i < count(limit); i += size) {
+      allocator_.free_voice(i);
+    }
+  }
+
+  template<typename V, int N>
+  void VoiceManager<V, N>::update_spread() noexcept
+  {
+    const int size = group_size();
+    const int count = voices_.size();
+    for (int i = 0; i < count; i++) {
+      auto& st = states_[i];
+      // The place of the voice from -1 to 1, in its group, or among the voices in poly mode
+      float place = 0;
+      if (size > 1) {
+        place = 2.f * float(i % size) / float(size - 1) - 1.f;
+        // Spread the group evenly over [-detune, detune] half semitones
+        st.detune = std::pow(2.f, place * settings_props.detune / 24.f);
+      } else {
+        st.detune = 1.f;
+        if (play_mode == +PlayMode::poly && count > 1) place = 2.f * float(i) / float(count - 1) - 1.f;
+      }
+      // Constant power, and 1 on both sides in the center, like the mono voice
+      float pan = place * settings_props.spread;
+      if (pan == 0) {
+        st.gain_left = st.gain_right = 1.f;
+      } else {
+        float angle = (1 + pan) * float(M_PI) / 4;
+        st.gain_left = std::sqrt(2.f) * std::cos(angle);
+        st.gain_right = std::sqrt(2.f) * std::sin(angle);
+      }
+    }
+  }
+
+  template<typename V, int N>
+  template<typename F>
+  void VoiceManager<V, N>::for_each_active_voice(F&& f) noexcept
+  {
+    for (int i = 0; i < active_voice_count_;) {
+      Voice& voice = *active_voices_[i];
+      f(voice);
+      auto& env = state(voice).env;
+      if (env.released() && !env.done() && env.value() * voice.level() * voice_gain_ < silence_floor_) {
+        env.finish();
+      }
+      if (env.done()) {
+        // Retire the voice by swapping in the last active one
+        active_voices_[i] = active_voices_[--active_voice_count_];
+      } else {
+        i++;
+      }
+    }
+  }
+
+  template<typename V, int N>
+  auto VoiceManager<V, N>::voices() noexcept -> gsl::span<Voice>
+  {
+    return voices_.span();
+  }
+
+  template<typename V, int N>
+  auto VoiceManager<V, N>::preprocessor() noexcept -> Pre&
   {
-    return voices_;
+    return pre;
   }
 
 } // namespace otto::core::voices
@@ -1,5 +1,8 @@
 #include "chorus.hpp"
 
+#include <Gamma/Envelope.h>
+#include <Gamma/scl.h>
+
 #include "core/ui/vector_graphics.hpp"
 
 #include "util/iterator.hpp"
@@ -14,6 +17,11 @@ namespace otto::engines {
     void draw(Canvas& ctx) override;
     bool keypress(Key key) override;
     void encoder(EncoderEvent e) override;
+    /// The heads follow the phase of the chorus
+    bool animating() override
+    {
+      return true;
+    }
 
     void draw_front_head(Canvas&, Point, Colour, float);
     void draw_background_head(Canvas&, Point, Colour, float);
@@ -39,44 +47,28 @@ namespace otto::engines {
     using EngineScreen<Chorus>::EngineScreen;
   };
 
-  Chorus::Chorus() : EffectEngine<Chorus>(std::make_unique<ChorusScreen>(this))
+  Chorus::Chorus() : EffectEngine<Chorus>(ui::lazy_screen<ChorusScreen>(this))
   {
-    // Initialize LPF for param smoothening
-    lpf.type(gam::SMOOTHING);
-    lpf.freq(1000);
-
-    // Set proper size of phase accumulator for graphics
-    phase.radius(1);
-
     props.delay.on_change().connect([this](float delay) { chorus.delay(delay); });
-
-    props.rate.on_change().connect([this](float rate) {
-      chorus.freq(rate);
-      phase.freq(rate * 0.5f);
-    });
-
-    props.feedback.on_change().connect([this](float fbk) { chorus.fbk(fbk); });
-
-    props.depth.on_change().connect([this](float depth) {
-      chorus.depth(depth);
-    });
+    props.rate.on_change().connect([this](float rate) { chorus.freq(rate); });
+    props.feedback.on_change().connect([this](float fbk) { chorus.feedback(fbk); });
+    props.taps.on_change().connect([this](int taps) { chorus.taps(taps); });
+    chorus.delay(props.delay);
+    chorus.freq(props.rate);
+    chorus.feedback(props.feedback);
+    chorus.taps(props.taps);
   }
 
   audio::ProcessData<2> Chorus::process(audio::ProcessData<1> data)
   {
-    // Allocate two audio buffers (left and right channels)
-    auto buf = Application::current().audio_manager->buffer_pool().allocate_multi<2>();
-    // Fill buffers with processed samples
-    for (auto&& [dat, bufL, bufR] : util::zip(data.audio, buf[0], buf[1])) {
-      // Apply smoothening filter to depth param to reduce cracks in sound
-      chorus.depth(lpf(props.depth));
-      // Get one sample from chorus effect
-      chorus(dat, bufL, bufR);
-      // Update phase value for graphics
-      props.phase_value = phase.nextPhase();
-    }
-    // Reassign (redirect) processed data to original data
-    return data.redirect(buf);
+    auto buf = output.acquire(*data.context, data.nframes);
+    // The depth is smoothed to reduce cracks in sound
+    auto depth = props.depth.smoothed_block(data.nframes);
+    chorus.hold(props.hold.load());
+    chorus.process({data.audio.data(), data.nframes}, depth, {buf[0].data(), data.nframes},
+                   {buf[1].data(), data.nframes});
+    meters.publish({float(2 * chorus.phase() - 1)});
+    return data.redirect(std::move(buf));
   }
 
   // SCREEN //
@@ -110,7 +102,14 @@ namespace otto::engines {
 
   bool ChorusScreen::keypress(ui::Key key)
   {
-    return false;
+    auto& props = engine.props;
+    switch (key) {
+    case ui::Key::red_click:
+      props.taps = props.taps >= 6 ? 2 : props.taps + 2;
+      return true;
+    case ui::Key::blue_click: props.hold = !props.hold; return true;
+    default: return false;
+    }
   }
 
   void ChorusScreen::draw(ui::vg::Canvas& ctx)
@@ -172,6 +171,23 @@ namespace otto::engines {
     ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
     ctx.fillText(fmt::format("{}", std::round(10000 * props.delay)), x_pad, y_pad + number_shift);
 
+    if (props.taps > 2) {
+      ctx.group([&] {
+        ctx.font(Fonts::Norm, 20);
+        ctx.fillStyle(Colours::Red);
+        ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+        ctx.fillText(fmt::format("{} TAPS", props.taps.get()), width / 2, y_bottom);
+      });
+    }
+    if (props.hold) {
+      ctx.group([&] {
+        ctx.font(Fonts::Norm, 20);
+        ctx.fillStyle(Colours::Blue);
+        ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+        ctx.fillText("HOLD", width / 2, y_pad);
+      });
+    }
+
 
     //Heads
     constexpr float spacing_constant = 1000;
@@ -180,11 +196,12 @@ namespace otto::engines {
     float spacing = spacing_constant * props.delay + 10;
     Point start = {120 - props.delay * 5000, 165};
 
+    float phase = engine.meters.read().phase;
     for (int i=num_heads; i>=1; i--) {
-      float head_height = wave_height * gam::scl::sinP9(gam::scl::wrap(props.phase_value - 0.2f*(float)i, 1.f, -1.f));
+      float head_height = wave_height * gam::scl::sinP9(gam::scl::wrap(phase - 0.2f*(float)i, 1.f, -1.f));
       draw_background_head(ctx, {start.x + i*spacing, start.y + head_height}, colour_list[i], 1 - i*0.07);
     }
-    draw_front_head(ctx, {start.x, start.y + wave_height * gam::scl::sinP9(props.phase_value)}, Colours::Blue, 1);
+    draw_front_head(ctx, {start.x, start.y + wave_height * gam::scl::sinP9(phase)}, Colours::Blue, 1);
 
 
 
@@ -2,9 +2,8 @@
 
 #include "core/engine/engine.hpp"
 
-#include <Gamma/Effects.h>
-#include <Gamma/Filter.h>
 #include "core/voices/voice_manager.hpp"
+#include "util/dsp/modulated_delay.hpp"
 
 namespace otto::engines {
 
@@ -17,26 +16,32 @@ namespace otto::engines {
 
     struct Props {
       Property<float> delay = {0.0001, limits(0.0001, 0.0086), step_size(0.0001)};
-      Property<float> depth = {0.0001, limits(0.0001, 0.008), step_size(0.0001)};
+      Property<float, smoothed> depth = {0.0001, limits(0.0001, 0.008), step_size(0.0001)};
       Property<float> feedback = {0.1, limits(0, 0.9), step_size(0.01)};
       Property<float> rate = {0, limits(0, 2), step_size(0.1)};
+      /// The number of modulated taps. More than two makes an ensemble.
+      Property<int> taps = {2, limits(2, 6), step_size(2)};
+      /// Stop taking input, so the taps keep playing what is in the delay line in a loop
+      Property<bool, atomic> hold = false;
 
-      float phase_value = 0;
-
-      DECL_REFLECTION(Props, delay, depth, feedback, rate);
+      DECL_REFLECTION(Props, delay, depth, feedback, rate, taps, hold);
     } props;
 
+    struct MeterValues {
+      /// The LFO phase, from -1 to 1
+      float phase = 0;
+    };
+
+    Meters<MeterValues> meters;
+
     Chorus();
 
     audio::ProcessData<2> process(audio::ProcessData<1>) override;
 
   private:
-    gam::Chorus<> chorus;
-    gam::OnePole<> lpf;
-    gam::AccumPhase<> phase;
-
-
-
+    /// The output, kept across callbacks
+    audio::EngineBuffers<2> output;
+    dsp::ModulatedDelay chorus;
   };
 
 } // namespace otto::engines
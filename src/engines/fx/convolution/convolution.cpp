@@ -0,0 +1,229 @@
+#include "convolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// WAV parser by Adam Stark: https://github.com/adamstark/AudioFile
+#include <AudioFile.h>
+
+#include "core/ui/vector_graphics.hpp"
+
+#include "services/application.hpp"
+#include "services/asset_loader.hpp"
+#include "services/audio_manager.hpp"
+
+#include "util/algorithm.hpp"
+#include "util/dsp/resampler.hpp"
+#include "util/filesystem.hpp"
+
+namespace otto::engines {
+
+  using namespace ui;
+  using namespace ui::vg;
+
+  struct ConvolutionScreen : EngineScreen<Convolution> {
+    void draw(Canvas& ctx) override;
+    void encoder(EncoderEvent e) override;
+
+    using EngineScreen<Convolution>::EngineScreen;
+  };
+
+  namespace {
+    /// Channel `channel` of the wav file at `path`, at `samplerate`, and at most
+    /// `Convolution::max_length` long. Empty if the file has fewer channels.
+    std::vector<float> decode_impulse(const fs::path& path, int channel, int samplerate)
+    {
+      AudioFile<float> file;
+      if (!file.load(path.string()) || file.getNumSamplesPerChannel() == 0) {
+        throw AssetLoader::exception(AssetLoader::ErrorCode::load_failed, "Could not load impulse response {}",
+                                     path.string());
+      }
+      if (channel >= file.getNumChannels()) return {};
+      auto& samples = file.samples[channel];
+
+      // Cut before resampling, keeping the frames the filter of the resampler needs past the end
+      long length = Convolution::max_length * samplerate;
+      dsp::Resampler resampler(file.getSampleRate(), samplerate);
+      long cut = std::ceil(Convolution::max_length * file.getSampleRate()) + resampler.radius();
+      if (long(samples.size()) > cut) samples.resize(cut);
+      auto res = dsp::Resampler::resample(samples, file.getSampleRate(), samplerate);
+
+      // Fade out cut files over 10 ms
+      if (long(res.size()) > length) {
+        res.resize(length);
+        int fade = std::min<int>(length, samplerate / 100);
+        for (int i = 0; i < fade; i++) res[length - 1 - i] *= float(i) / fade;
+      }
+      return res;
+    }
+  } // namespace
+
+  Convolution::Convolution() : EffectEngine<Convolution>(ui::lazy_screen<ConvolutionScreen>(this))
+  {
+    auto dir = Application::current().data_dir / "impulses";
+    if (fs::exists(dir)) {
+      for (const auto& entry : filesystem::directory_iterator(dir)) {
+        filenames.push_back(entry.path().filename());
+      }
+    }
+    util::sort(filenames);
+
+    _tone.type(gam::LOW_PASS);
+    samplerate_changed(gam::sampleRate());
+
+    props.file.on_change().connect([this](const std::string& file) { load_file(file); });
+    props.predelay.on_change().connect([this](float delay) { _predelay.delay(delay); }).call_now(props.predelay);
+    props.tone.on_change().connect([this](float tone) { _tone.freq(500 + tone * tone * 19500); }).call_now(props.tone);
+  }
+
+  Convolution::~Convolution()
+  {
+    AssetLoader::current().cancel(&_impulse);
+  }
+
+  void Convolution::samplerate_changed(int samplerate)
+  {
+    _predelay.maxDelay(max_predelay);
+    _predelay.delay(props.predelay);
+    // The impulse response is resampled when loaded
+    load_file(props.file);
+  }
+
+  void Convolution::load_file(const std::string& file)
+  {
+    auto& loader = AssetLoader::current();
+    if (file.empty()) {
+      loader.cancel(&_impulse);
+      _impulse.publish(nullptr);
+      return;
+    }
+    auto path = Application::current().data_dir / "impulses" / file;
+    int samplerate = Application::current().audio_manager->samplerate();
+    auto* cache = &loader.cache();
+    loader.load(
+      &_impulse,
+      [path, samplerate, cache] {
+        std::array<std::shared_ptr<const std::vector<float>>, 2> channels;
+        for (int ch = 0; ch < 2; ch++) {
+          channels[ch] = cache->get(path, fmt::format("impulse{}@{}", ch, samplerate),
+                                    [&] { return decode_impulse(path, ch, samplerate); });
+        }
+        // Normalize the energy of the channels, so the reverb is about as loud as its input,
+        // whatever the length of the room
+        double energy = 0;
+        int count = channels[1]->empty() ? 1 : 2;
+        for (int ch = 0; ch < count; ch++) {
+          for (float frm : *channels[ch]) energy += frm * frm;
+        }
+        float gain = energy > 0 ? std::sqrt(count / energy) : 0;
+
+        auto res = std::make_unique<Impulse>();
+        for (int ch = 0; ch < count; ch++) {
+          std::vector<float> scaled = *channels[ch];
+          for (auto& frm : scaled) frm *= gain;
+          (ch == 0 ? res->left : res->right) = std::make_unique<dsp::Convolver>(scaled);
+        }
+        return res;
+      },
+      [this](std::unique_ptr<Impulse> impulse) { _impulse.publish(std::move(impulse)); });
+  }
+
+  audio::ProcessData<2> Convolution::process(audio::ProcessData<1> data)
+  {
+    auto buf = _output.acquire(*data.context, data.nframes);
+    auto* impulse = _impulse.acquire();
+    gsl::span<float> left = {buf[0].data(), data.nframes};
+    gsl::span<float> right = {buf[1].data(), data.nframes};
+    if (impulse == nullptr) {
+      std::fill(left.begin(), left.end(), 0.f);
+      std::fill(right.begin(), right.end(), 0.f);
+      return data.redirect(std::move(buf));
+    }
+
+    for (auto&& [in, out] : util::zip(data.audio, left)) out = _tone(_predelay(in));
+    if (impulse->right) {
+      std::copy(left.begin(), left.end(), right.begin());
+      impulse->right->process(right, right);
+    }
+    impulse->left->process(left, left);
+    if (!impulse->right) {
+      std::copy(left.begin(), left.end(), right.begin());
+      return data.redirect(std::move(buf));
+    }
+
+    // Mid-side
+    float width = props.width;
+    for (auto&& [l, r] : util::zip(left, right)) {
+      float mid = 0.5f * (l + r);
+      float side = 0.5f * (l - r) * width;
+      l = mid + side;
+      r = mid - side;
+    }
+    return data.redirect(std::move(buf));
+  }
+
+  // SCREEN //
+
+  void ConvolutionScreen::encoder(ui::EncoderEvent ev)
+  {
+    auto& props = engine.props;
+    switch (ev.encoder) {
+    case Encoder::blue: {
+      auto& files = engine.filenames;
+      if (files.empty()) break;
+      auto iter = util::find(files, props.file.get());
+      int index = iter == files.end() ? 0 : std::clamp<int>(iter - files.begin() + ev.steps, 0, files.size() - 1);
+      props.file = files[index];
+      break;
+    }
+    case Encoder::green: props.predelay.step(ev.steps); break;
+    case Encoder::yellow: props.tone.step(ev.steps); break;
+    case Encoder::red: props.width.step(ev.steps); break;
+    }
+  }
+
+  void ConvolutionScreen::draw(ui::vg::Canvas& ctx)
+  {
+    auto& props = engine.props;
+
+    constexpr float x_pad = 30;
+    constexpr float y_pad = 50;
+    constexpr float space = (height - 2.f * y_pad) / 3.f;
+
+    ctx.font(Fonts::Norm, 35);
+
+    ctx.beginPath();
+    ctx.fillStyle(Colours::Blue);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText("room", {x_pad, y_pad});
+    ctx.beginPath();
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    auto file = fs::path(props.file.get()).stem().string();
+    ctx.fillText(file.empty() ? "none" : file, {width - x_pad, y_pad});
+
+    ctx.beginPath();
+    ctx.fillStyle(Colours::Green);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText("predelay", {x_pad, y_pad + space});
+    ctx.beginPath();
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText(fmt::format("{}ms", std::round(props.predelay * 1000)), {width - x_pad, y_pad + space});
+
+    ctx.beginPath();
+    ctx.fillStyle(Colours::Yellow);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText("tone", {x_pad, y_pad + 2 * space});
+    ctx.beginPath();
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText(fmt::format("{}", std::round(props.tone * 100)), {width - x_pad, y_pad + 2 * space});
+
+    ctx.beginPath();
+    ctx.fillStyle(Colours::Red);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText("width", {x_pad, y_pad + 3 * space});
+    ctx.beginPath();
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText(fmt::format("{}", std::round(props.width * 100)), {width - x_pad, y_pad + 3 * space});
+  }
+
+} // namespace otto::engines
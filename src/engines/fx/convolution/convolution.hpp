@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Gamma/Delay.h>
+#include <Gamma/Filter.h>
+
+#include "core/engine/engine.hpp"
+
+#include "util/dsp/convolver.hpp"
+#include "util/handoff.hpp"
+
+namespace otto::engines {
+
+  using namespace core;
+  using namespace core::engine;
+  using namespace props;
+
+  /// Reverb by convolution with the impulse response of a room
+  ///
+  /// The impulse responses are the wav files in `data/impulses`, loaded with the
+  /// `AssetLoader`, and convolved with a `dsp::Convolver` per channel. Mono files are played on
+  /// both channels.
+  struct Convolution : EffectEngine<Convolution> {
+    static constexpr util::string_ref name = "Convolution";
+
+    /// The longest impulse response, in seconds. Longer files are cut, with a short fade.
+    static constexpr float max_length = 4.f;
+    /// The longest predelay, in seconds
+    static constexpr float max_predelay = 0.2f;
+
+    struct Props {
+      /// The impulse response, in `data/impulses`
+      Property<std::string> file = "hall.wav";
+      /// The delay of the input, in seconds
+      Property<float> predelay = {0, limits(0, max_predelay), step_size(0.005)};
+      Property<float> tone = {1, limits(0, 1), step_size(0.01)};
+      /// The stereo width of the output. 0 is mono.
+      Property<float> width = {1, limits(0, 1), step_size(0.01)};
+
+      DECL_REFLECTION(Props, file, predelay, tone, width);
+    } props;
+
+    /// The files in `data/impulses`, sorted
+    std::vector<std::string> filenames;
+
+    Convolution();
+    ~Convolution();
+
+    audio::ProcessData<2> process(audio::ProcessData<1>) override;
+
+    void samplerate_changed(int samplerate) override;
+
+  private:
+    /// The output, kept across callbacks
+    audio::EngineBuffers<2> _output;
+    /// The convolvers of an impulse response
+    struct Impulse {
+      std::unique_ptr<dsp::Convolver> left;
+      /// Only for stereo files
+      std::unique_ptr<dsp::Convolver> right;
+    };
+
+    /// Load `file` from `data/impulses`, at the current samplerate
+    void load_file(const std::string& file);
+
+    util::Handoff<Impulse> _impulse;
+    gam::Delay<> _predelay;
+    gam::Biquad<> _tone;
+  };
+
+} // namespace otto::engines
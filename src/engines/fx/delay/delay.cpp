@@ -0,0 +1,126 @@
+#include "delay.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+#include "core/ui/vector_graphics.hpp"
+
+#include "services/clock_manager.hpp"
+
+namespace otto::engines {
+
+  using namespace ui;
+  using namespace ui::vg;
+
+  namespace {
+    struct Division {
+      util::string_ref name;
+      float beats;
+    };
+
+    constexpr std::array<Division, Delay::division_count> divisions = {{
+      {"1/32", 1 / 8.f},
+      {"1/16T", 1 / 6.f},
+      {"1/16", 1 / 4.f},
+      {"1/8T", 1 / 3.f},
+      {"1/16.", 3 / 8.f},
+      {"1/8", 1 / 2.f},
+      {"1/4T", 2 / 3.f},
+      {"1/8.", 3 / 4.f},
+      {"1/4", 1.f},
+      {"1/2T", 4 / 3.f},
+      {"1/4.", 3 / 2.f},
+      {"1/2", 2.f},
+    }};
+  } // namespace
+
+  struct DelayScreen : EngineScreen<Delay> {
+    void draw(Canvas& ctx) override;
+    bool keypress(Key key) override;
+    void encoder(EncoderEvent e) override;
+
+    using EngineScreen<Delay>::EngineScreen;
+  };
+
+  Delay::Delay() : EffectEngine<Delay>(ui::lazy_screen<DelayScreen>(this))
+  {
+    props.feedback.on_change().connect([this](float fbk) { line.feedback(fbk); }).call_now(props.feedback);
+    props.damping.on_change().connect([this](float damp) { line.damping(damp); }).call_now(props.damping);
+  }
+
+  float Delay::beats(int division) noexcept
+  {
+    return divisions[std::clamp(division, 0, division_count - 1)].beats;
+  }
+
+  util::string_ref Delay::division_name(int division) noexcept
+  {
+    return divisions[std::clamp(division, 0, division_count - 1)].name;
+  }
+
+  audio::ProcessData<2> Delay::process(audio::ProcessData<1> data)
+  {
+    auto buf = output.acquire(*data.context, data.nframes);
+    // Follows the tempo of the clock, also while it is stopped. A change of tempo or division
+    // crossfades to the new delay.
+    float bpm = std::max(services::ClockManager::current().bpm(), 1.f);
+    line.delay(beats(props.division) * 60.f / bpm * gam::sampleRate());
+    line.ping_pong(props.ping_pong.load());
+    line.process({data.audio.data(), data.nframes}, {buf[0].data(), data.nframes}, {buf[1].data(), data.nframes});
+    return data.redirect(std::move(buf));
+  }
+
+  // SCREEN //
+
+  void DelayScreen::encoder(EncoderEvent e)
+  {
+    switch (e.encoder) {
+    case Encoder::blue: engine.props.division.step(e.steps); break;
+    case Encoder::green: engine.props.feedback.step(e.steps); break;
+    case Encoder::yellow: engine.props.damping.step(e.steps); break;
+    default: break;
+    }
+  }
+
+  bool DelayScreen::keypress(Key key)
+  {
+    switch (key) {
+    case Key::red_click: engine.props.ping_pong = !engine.props.ping_pong; return true;
+    default: return false;
+    }
+  }
+
+  void DelayScreen::draw(Canvas& ctx)
+  {
+    auto& props = engine.props;
+
+    constexpr float x_pad = 20;
+    constexpr float y_pad = 20;
+    constexpr float space = (height - 2.f * y_pad) / 3.f;
+
+    ctx.font(Fonts::Norm, 25);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillStyle(Colours::Blue);
+    ctx.fillText("time", x_pad, y_pad);
+    ctx.fillStyle(Colours::Green);
+    ctx.fillText("feedback", x_pad, y_pad + space);
+    ctx.fillStyle(Colours::Yellow);
+    ctx.fillText("damping", x_pad, y_pad + 2 * space);
+    ctx.fillStyle(Colours::Red);
+    ctx.fillText("ping-pong", x_pad, y_pad + 3 * space);
+
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillStyle(Colours::Blue);
+    ctx.fillText(Delay::division_name(props.division).c_str(), width - x_pad, y_pad);
+    ctx.fillStyle(Colours::Green);
+    ctx.fillText(fmt::format("{}", std::round(props.feedback * 100)), width - x_pad, y_pad + space);
+    ctx.fillStyle(Colours::Yellow);
+    ctx.fillText(fmt::format("{}", std::round(props.damping * 100)), width - x_pad, y_pad + 2 * space);
+    ctx.fillStyle(Colours::Red);
+    ctx.fillText(props.ping_pong ? "ON" : "OFF", width - x_pad, y_pad + 3 * space);
+  }
+
+} // namespace otto::engines
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "core/engine/engine.hpp"
+
+#include "util/arena.hpp"
+#include "util/dsp/stereo_delay.hpp"
+
+namespace otto::engines {
+
+  using namespace core;
+  using namespace core::engine;
+  using namespace props;
+
+  /// A stereo or ping-pong delay, in note lengths at the tempo of the clock
+  struct Delay : EffectEngine<Delay> {
+    static constexpr util::string_ref name = "Delay";
+
+    /// The number of note lengths the delay can be set to
+    static constexpr int division_count = 12;
+
+    struct Props {
+      /// The delay, as a note length from 1/32 to 1/2, with the triplets and dotted ones
+      Property<int> division = {5, limits(0, division_count - 1), step_size(1)};
+      Property<float> feedback = {0.4, limits(0, 0.95), step_size(0.01)};
+      Property<float> damping = {0.3, limits(0, 0.99), step_size(0.01)};
+      /// Bounce the echoes between the sides
+      Property<bool, atomic> ping_pong = true;
+
+      DECL_REFLECTION(Props, division, feedback, damping, ping_pong);
+    } props;
+
+    Delay();
+
+    audio::ProcessData<2> process(audio::ProcessData<1>) override;
+
+    /// The length of `division` in beats
+    static float beats(int division) noexcept;
+    /// The name of `division`, like `1/8T`
+    static util::string_ref division_name(int division) noexcept;
+
+  private:
+    /// The output, kept across callbacks
+    audio::EngineBuffers<2> output;
+    /// Holds the two lines, allocated once at their full length, so a change of tempo never
+    /// reallocates. On a huge page, as the heads read from far apart.
+    util::Arena arena{dsp::StereoDelay::memory_size + util::Arena::block_alignment,
+                      &util::memory_tag(name.c_str()),
+                      true};
+    dsp::StereoDelay line{&arena};
+  };
+
+} // namespace otto::engines
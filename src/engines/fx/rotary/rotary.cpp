@@ -0,0 +1,112 @@
+#include "rotary.hpp"
+
+#include "core/ui/vector_graphics.hpp"
+
+namespace otto::engines {
+
+  using namespace ui;
+  using namespace ui::vg;
+
+  struct RotaryScreen : EngineScreen<Rotary> {
+    void draw(Canvas& ctx) override;
+    bool keypress(Key key) override;
+    void encoder(EncoderEvent e) override;
+    /// The rotors turn with the audio
+    bool animating() override
+    {
+      return true;
+    }
+
+    using EngineScreen<Rotary>::EngineScreen;
+  };
+
+  Rotary::Rotary() : EffectEngine<Rotary>(ui::lazy_screen<RotaryScreen>(this))
+  {
+    props.depth.on_change().connect([this](float depth) { speaker.depth(depth); }).call_now(props.depth);
+    props.balance.on_change().connect([this](float balance) { speaker.balance(balance); }).call_now(props.balance);
+  }
+
+  audio::ProcessData<2> Rotary::process(audio::ProcessData<1> data)
+  {
+    auto buf = output.acquire(*data.context, data.nframes);
+    speaker.fast(props.fast.load());
+    speaker.process({data.audio.data(), data.nframes}, {buf[0].data(), data.nframes},
+                    {buf[1].data(), data.nframes});
+    meters.publish({float(speaker.horn_phase()), float(speaker.drum_phase())});
+    return data.redirect(std::move(buf));
+  }
+
+  // SCREEN //
+
+  void RotaryScreen::encoder(EncoderEvent e)
+  {
+    switch (e.encoder) {
+    case Encoder::blue: engine.props.depth.step(e.steps); break;
+    case Encoder::green: engine.props.balance.step(e.steps); break;
+    default: break;
+    }
+  }
+
+  bool RotaryScreen::keypress(Key key)
+  {
+    switch (key) {
+    case Key::blue_click: [[fallthrough]];
+    case Key::green_click: engine.props.fast = !engine.props.fast; return true;
+    default: return false;
+    }
+  }
+
+  void RotaryScreen::draw(Canvas& ctx)
+  {
+    auto& props = engine.props;
+    auto rotors = engine.meters.read();
+
+    constexpr float x_pad = 20;
+    constexpr float y_pad = 20;
+    constexpr Point center = {width / 2, height / 2};
+
+    ctx.font(Fonts::Norm, 25);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillStyle(Colours::Blue);
+    ctx.fillText("depth", x_pad, y_pad);
+    ctx.fillStyle(Colours::Green);
+    ctx.fillText("balance", x_pad, height - y_pad);
+
+    ctx.font(Fonts::Norm, 40);
+    ctx.fillStyle(Colours::Blue);
+    ctx.fillText(fmt::format("{}", std::round(props.depth * 100)), x_pad, y_pad + 30);
+    ctx.fillStyle(Colours::Green);
+    ctx.fillText(fmt::format("{}", std::round(props.balance * 100)), x_pad, height - y_pad - 30);
+
+    ctx.font(Fonts::Norm, 20);
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillStyle(Colours::Yellow);
+    ctx.fillText(props.fast ? "FAST" : "SLOW", width - x_pad, y_pad);
+
+    ctx.lineWidth(6.0);
+    ctx.lineCap(Canvas::LineCap::ROUND);
+
+    // The drum, with the size of its share of the sound
+    ctx.group([&] {
+      ctx.rotateAround(2 * M_PI * rotors.drum, center);
+      ctx.beginPath();
+      ctx.arc(center.x, center.y, 80, -M_PI / 4, M_PI / 4, false);
+      ctx.strokeStyle(Colours::Green.dim(0.5 * props.balance));
+      ctx.stroke();
+    });
+
+    // The horn, pointing both ways
+    ctx.group([&] {
+      ctx.rotateAround(2 * M_PI * rotors.horn, center);
+      ctx.beginPath();
+      ctx.moveTo(center.x - 55, center.y);
+      ctx.lineTo(center.x + 55, center.y);
+      ctx.strokeStyle(Colours::Blue.dim(0.5 * (1 - props.balance)));
+      ctx.stroke();
+      ctx.beginPath();
+      ctx.circle({center.x + 55, center.y}, 12.5);
+      ctx.stroke();
+    });
+  }
+
+} // namespace otto::engines
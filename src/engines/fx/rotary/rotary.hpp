@@ -0,0 +1,45 @@
+#pragma once
+
+#include "core/engine/engine.hpp"
+
+#include "util/dsp/rotary_speaker.hpp"
+
+namespace otto::engines {
+
+  using namespace core;
+  using namespace core::engine;
+  using namespace props;
+
+  /// A rotating speaker, for the organ of Goss and any other synth
+  struct Rotary : EffectEngine<Rotary> {
+    static constexpr util::string_ref name = "Rotary";
+
+    struct Props {
+      /// Spin the rotors at the fast (tremolo) speed instead of the slow (chorale) one
+      Property<bool, atomic> fast = false;
+      Property<float> depth = {0.7, limits(0, 1), step_size(0.01)};
+      /// The level of the horn relative to the drum
+      Property<float> balance = {0.5, limits(0, 1), step_size(0.01)};
+
+      DECL_REFLECTION(Props, fast, depth, balance);
+    } props;
+
+    struct MeterValues {
+      /// The phases of the rotors, from 0 to 1
+      float horn = 0;
+      float drum = 0;
+    };
+
+    Meters<MeterValues> meters;
+
+    Rotary();
+
+    audio::ProcessData<2> process(audio::ProcessData<1>) override;
+
+  private:
+    /// The output, kept across callbacks
+    audio::EngineBuffers<2> output;
+    dsp::RotarySpeaker speaker;
+  };
+
+} // namespace otto::engines
@@ -17,10 +17,17 @@ namespace otto::engines {
     void encoder(EncoderEvent e) override;
 
     using EngineScreen<Wormhole>::EngineScreen;
+
+  private:
+    void draw_stars(Canvas& ctx, float shimmer);
+
+    Layer stars{{vg::width, vg::height}};
   };
 
   Wormhole::Wormhole()
-    : EffectEngine<Wormhole>(std::make_unique<WormholeScreen>(this))
+    : EffectEngine<Wormhole>(ui::lazy_screen<WormholeScreen>(this)),
+      fdn(&arena),
+      grain_shifter(dsp::GrainPitchShift::default_grain, &arena)
   {
     // reverb.resize({1307, 1637, 1811, 1931}, {1051, 337, 113});
     reverb.resize(gam::JCREVERB);
@@ -30,28 +37,118 @@ namespace otto::engines {
 
     pre_filter.type(gam::LOW_PASS);
 
-    output_delay[0].maxDelay(211.f / gam::sampleRate());
-    output_delay[1].maxDelay(179.f / gam::sampleRate());
+    samplerate_changed(gam::sampleRate());
 
     props.filter.on_change().connect(
       [this](float flt) { pre_filter.freq(3000 + flt * flt * 17000); }).call_now(props.filter);
     props.shimmer.on_change().connect([this](float sh) { shimmer_amount = sh * 0.03; }).call_now(props.shimmer);
-    props.length.on_change().connect([this](float len) { reverb.decay(3.f * len); }).call_now(props.length);
-    props.damping.on_change().connect([this](float damp) { reverb.damping(damp); }).call_now(props.damping);
+    props.length.on_change().connect([this](float len) {
+      // A frozen JC reverb gets the decay when it is unfrozen
+      if (!was_frozen) reverb.decay(3.f * len);
+      fdn.decay(3.f * len);
+    }).call_now(props.length);
+    props.damping.on_change().connect([this](float damp) {
+      if (!was_frozen) reverb.damping(damp);
+      fdn.damping(damp);
+    }).call_now(props.damping);
   }
 
+  void Wormhole::freeze_reverb(bool frozen)
+  {
+    // A decay this long makes the feedback of the combs unity, to float precision
+    reverb.decay(frozen ? 1e6f : 3.f * props.length);
+    reverb.damping(frozen ? 0.f : props.damping.get());
+  }
+
+  void Wormhole::samplerate_changed(int samplerate)
+  {
+    // The output delays decorrelate the channels by a fixed number of samples
+    output_delay[0].maxDelay(211.f / samplerate);
+    output_delay[1].maxDelay(179.f / samplerate);
+  }
 
   audio::ProcessData<2> Wormhole::process(audio::ProcessData<1> data)
   {
-    auto buf = Application::current().audio_manager->buffer_pool().allocate_multi<2>();
+    auto buf = output.acquire(*data.context, data.nframes);
+    bool frozen = props.freeze.load();
+    if (frozen != was_frozen) {
+      fdn.freeze(frozen);
+      freeze_reverb(frozen);
+      was_frozen = frozen;
+    }
+    if (frozen) {
+      process_frozen(data, buf);
+      return data.redirect(std::move(buf));
+    }
+    if (props.fdn.load() && quality < 2) {
+      process_fdn(data, buf);
+      return data.redirect(std::move(buf));
+    }
+    was_fdn = false;
+    bool grains = props.grains.load() && quality < 1;
     for (auto&& [dat, bufL, bufR] : util::zip(data.audio, buf[0], buf[1])) {
       auto frm = reverb(pre_filter(dat) + last_sample * shimmer_amount);
-      last_sample = dc_block(shimmer_filter(pitchshifter(frm)));
+      last_sample = dc_block(shimmer_filter(grains ? grain_shifter(frm) : pitchshifter(frm)));
 
       bufL = output_delay[0](frm);
       bufR = output_delay[1](frm);
     }
-    return data.redirect(buf);
+    return data.redirect(std::move(buf));
+  }
+
+  void Wormhole::process_fdn(audio::ProcessData<1> data, std::array<audio::AudioBufferHandle, 2>& out)
+  {
+    // Don't play the old tail when switching back
+    if (!was_fdn) {
+      fdn.zero();
+      shimmer_delay.fill(0);
+    }
+    was_fdn = true;
+
+    // The fdn runs a chunk at a time, so the shimmer is fed back with a delay of one chunk
+    const int chunk = shimmer_delay.size();
+    bool grains = props.grains.load() && quality < 1;
+    for (int i = 0; i < data.nframes; i += chunk) {
+      int n = std::min<int>(chunk, data.nframes - i);
+      float* in = data.audio.data() + i;
+      float* wet = out[0].data() + i;
+      for (int f = 0; f < n; f++) {
+        wet[f] = pre_filter(in[f]) + shimmer_delay[(shimmer_pos + f) % chunk] * shimmer_amount;
+      }
+      fdn.process({wet, n}, {wet, n});
+      decltype(shimmer_delay) shifted;
+      if (grains) {
+        grain_shifter.process({wet, n}, {shifted.data(), n});
+      } else {
+        for (int f = 0; f < n; f++) shifted[f] = pitchshifter(wet[f]);
+      }
+      for (int f = 0; f < n; f++) {
+        shimmer_delay[(shimmer_pos + f) % chunk] = dc_block(shimmer_filter(shifted[f]));
+        out[1][i + f] = output_delay[1](wet[f]);
+        wet[f] = output_delay[0](wet[f]);
+      }
+      shimmer_pos = (shimmer_pos + n) % chunk;
+    }
+  }
+
+  void Wormhole::process_frozen(audio::ProcessData<1> data, std::array<audio::AudioBufferHandle, 2>& out)
+  {
+    // The reverb that was playing when frozen keeps playing, so the tail doesn't cut out when
+    // the fdn is toggled or the quality tier changes
+    if (was_fdn) {
+      float* wet = out[0].data();
+      fdn.process({wet, data.nframes}, {wet, data.nframes});
+      for (int f = 0; f < data.nframes; f++) {
+        out[1][f] = output_delay[1](wet[f]);
+        wet[f] = output_delay[0](wet[f]);
+      }
+      return;
+    }
+    for (auto&& [bufL, bufR] : util::zip(out[0], out[1])) {
+      auto frm = reverb(0.f);
+      bufL = output_delay[0](frm);
+      bufR = output_delay[1](frm);
+    }
   }
 
   // SCREEN //
@@ -69,221 +166,236 @@ namespace otto::engines {
 
   bool WormholeScreen::keypress(ui::Key key)
   {
-    return false;
+    switch (key) {
+    case ui::Key::green_click: engine.props.fdn = !engine.props.fdn; return true;
+    case ui::Key::yellow_click: engine.props.grains = !engine.props.grains; return true;
+    case ui::Key::blue_click: engine.props.freeze = !engine.props.freeze; return true;
+    default: return false;
+    }
   }
 
-  void WormholeScreen::draw(ui::vg::Canvas& ctx)
+  void WormholeScreen::draw_stars(ui::vg::Canvas& ctx, float shimmer)
   {
-    {
-      using namespace ui::vg;
-      using util::math::vec;
+    using namespace ui::vg;
 
-      auto& props = engine.props;
+    // declaration of star radius of first group of stars
+    float starradius = 3;
 
-      // declaration of star radius of first group of stars
-      float starradius = 3;
-      vec direction = vec{3, -2} * (engine.props.length.normalize() * 3 + 0.6);
-      float minscale = 0.55;
-      float frontscale =
-        std::min(1.f, (minscale + engine.props.damping.normalize() * (1 - minscale) * 2));
-      float backscale =
-        std::min(1.f, (minscale + (1 - engine.props.damping.normalize()) * (1 - minscale) * 2));
+    // 1st group of stars.
+    ctx.group([&] {
+      ctx.beginPath();
+      ctx.circle({126.6, 75.2}, starradius);
+      ctx.fillStyle(Colours::Yellow.dim(1 - shimmer));
+      ctx.fill();
 
-      // 1st group of stars.
-      ctx.group([&] {
-        ctx.beginPath();
-        ctx.circle({126.6, 75.2}, starradius);
-        ctx.fillStyle(Colours::Yellow.dim(1 - engine.props.shimmer.normalize()));
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({228.8, 162.3}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({228.8, 162.3}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({186.8, 81.3}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({186.8, 81.3}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({259.0, 28.3}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({259.0, 28.3}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({207.6, 192.4}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({207.6, 192.4}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({154.8, 93.3}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({154.8, 93.3}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({144.3, 26.3}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({144.3, 26.3}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({257.8, 193.0}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({257.8, 193.0}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({223.5, 128.3}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({223.5, 128.3}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({294.1, 181.6}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({294.1, 181.6}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({52.7, 190.3}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({52.7, 190.3}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({106.6, 42.2}, starradius);
+      ctx.fill();
+    });
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({106.6, 42.2}, starradius);
-        ctx.fill();
-      });
+    // declaration of star radius of second group of stars
+    float secondstarradius = 2;
 
-      // declaration of star radius of second group of stars
-      float secondstarradius = 2;
+    ctx.group([&] {
+      // 2nd group of stars.
+      ctx.beginPath();
+      ctx.circle({255.3, 168.8}, secondstarradius);
+      ctx.fillStyle(Colours::Yellow.dim(1 - shimmer));
 
-      ctx.group([&] {
-        // 2nd group of stars.
-        ctx.beginPath();
-        ctx.circle({255.3, 168.8}, secondstarradius);
-        ctx.fillStyle(Colours::Yellow.dim(1 - engine.props.shimmer.normalize()));
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({149.5, 60.6}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({149.5, 60.6}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({200.6, 164.6}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({200.6, 164.6}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({77.6, 164.7}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({77.6, 164.7}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({175.2, 48.8}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({175.2, 48.8}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({228.0, 147.9}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({228.0, 147.9}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({228.6, 206.1}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({228.6, 206.1}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({294.0, 106.1}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({294.0, 106.1}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({159.3, 112.0}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({159.3, 112.0}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({289.7, 202.0}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({289.7, 202.0}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({45.9, 164.4}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({45.9, 164.4}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({100.4, 212.8}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({100.4, 212.8}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({100.5, 65.7}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({100.5, 65.7}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({213.7, 83.2}, secondstarradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({213.7, 83.2}, secondstarradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({213.0, 91.9}, secondstarradius);
+      ctx.fill();
+    });
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({213.0, 91.9}, secondstarradius);
-        ctx.fill();
-      });
+    // 3rd group of stars. for tobias.
+    ctx.group([&] {
+      ctx.beginPath();
+      ctx.circle({273, 68}, starradius);
+      ctx.fillStyle(Colours::Yellow.dim(1 - shimmer));
+      ctx.fill();
 
-      // 3rd group of stars. for tobias.
-      ctx.group([&] {
-        ctx.beginPath();
-        ctx.circle({273, 68}, starradius);
-        ctx.fillStyle(Colours::Yellow.dim(1 - engine.props.shimmer.normalize()));
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({255, 118}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({255, 118}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({220, 57}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({220, 57}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({200, 87}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({200, 87}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({203, 142}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({203, 142}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({113, 123}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({113, 123}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({106, 176}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({106, 176}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({159, 164}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({159, 164}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({154, 190}, starradius);
+      ctx.fill();
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({154, 190}, starradius);
-        ctx.fill();
+      // (stars)
+      ctx.beginPath();
+      ctx.circle({182, 185}, starradius);
+      ctx.fill();
+    });
+  }
 
-        // (stars)
-        ctx.beginPath();
-        ctx.circle({182, 185}, starradius);
-        ctx.fill();
-      });
+  void WormholeScreen::draw(ui::vg::Canvas& ctx)
+  {
+    {
+      using namespace ui::vg;
+      using util::math::vec;
+
+      auto& props = engine.props;
+
+      vec direction = vec{3, -2} * (engine.props.length.normalize() * 3 + 0.6);
+      float minscale = 0.55;
+      float frontscale =
+        std::min(1.f, (minscale + engine.props.damping.normalize() * (1 - minscale) * 2));
+      float backscale =
+        std::min(1.f, (minscale + (1 - engine.props.damping.normalize()) * (1 - minscale) * 2));
+
+      // The stars only change with the shimmer, so they are cached in a layer
+      float shimmer = props.shimmer.normalize();
+      stars.draw(ctx, Layer::key(shimmer), [this, shimmer](Canvas& ctx) { draw_stars(ctx, shimmer); });
 
       // mass value
       ctx.save();
@@ -513,6 +625,25 @@ namespace otto::engines {
       ctx.lineWidth(6.0);
       ctx.strokeStyle(Colours::Green);
       ctx.stroke();
+
+      if (props.fdn) {
+        ctx.font(Fonts::Norm, 20);
+        ctx.fillStyle(Colours::Green);
+        ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+        ctx.fillText("FDN", {20, 220});
+      }
+      if (props.grains) {
+        ctx.font(Fonts::Norm, 20);
+        ctx.fillStyle(Colours::Yellow);
+        ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+        ctx.fillText("GRAINS", {300, 220});
+      }
+      if (props.freeze) {
+        ctx.font(Fonts::Norm, 20);
+        ctx.fillStyle(Colours::Blue);
+        ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+        ctx.fillText("FREEZE", {160, 220});
+      }
     }
   }
 
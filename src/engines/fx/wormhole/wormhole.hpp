@@ -3,7 +3,10 @@
 #include "core/engine/engine.hpp"
 #include "core/voices/voice_manager.hpp"
 
+#include "util/dsp/fdn_reverb.hpp"
+#include "util/dsp/pitch_shift.hpp"
 #include "util/dsp/transpose.hpp"
+#include "util/arena.hpp"
 
 constexpr unsigned num_taps = 4;
 
@@ -21,19 +24,69 @@ namespace otto::engines {
       Property<float> shimmer = {0, limits(0, 1), step_size(0.01)};
       Property<float> length = {0.5, limits(0, 1), step_size(0.01)};
       Property<float> damping = {0.4, limits(0, 0.99), step_size(0.01)};
+      /// Use the feedback delay network reverb instead of the JC reverb
+      Property<bool, atomic> fdn = false;
+      /// Shift the shimmer with overlapping grains instead of the crossfaded delays
+      Property<bool, atomic> grains = false;
+      /// Hold the tail without taking input, while playing on top of it
+      Property<bool, atomic> freeze = false;
 
-      DECL_REFLECTION(Props, filter, shimmer, length, damping);
+      DECL_REFLECTION(Props, filter, shimmer, length, damping, fdn, grains, freeze);
     } props;
 
     Wormhole();
 
     audio::ProcessData<2> process(audio::ProcessData<1>) override;
 
+    /// Tier 1 shifts the shimmer with the delays instead of grains, and tier 2 also uses
+    /// the JC reverb instead of the fdn
+    int quality_tiers() const noexcept override
+    {
+      return 3;
+    }
+
+    void quality_tier(int tier) noexcept override
+    {
+      quality = tier;
+    }
+
+    void samplerate_changed(int samplerate) override;
+
   private:
+    /// The output, kept across callbacks
+    audio::EngineBuffers<2> output;
+    /// Process with the feedback delay network, into `out`
+    void process_fdn(audio::ProcessData<1> data, std::array<audio::AudioBufferHandle, 2>& out);
+    /// Play the held tail of the reverb that was in use, into `out`
+    ///
+    /// The input, the pre filter and the shimmer are skipped.
+    void process_frozen(audio::ProcessData<1> data, std::array<audio::AudioBufferHandle, 2>& out);
+    /// Make the JC reverb hold its tail, or decay by the props again
+    void freeze_reverb(bool frozen);
+
+    /// Holds the delay lines of `fdn` and `grain_shifter`, so they are contiguous, and freed at
+    /// once. On huge pages, as the delay lines span over a hundred normal pages, which the FDN
+    /// reads from all at once. The gamma objects allocate on their own.
+    util::Arena arena{dsp::FDNReverb::memory_size +
+                      dsp::GrainPitchShift::memory_size(dsp::GrainPitchShift::default_grain) +
+                      2 * util::Arena::block_alignment,
+                      &util::memory_tag(name.c_str()),
+                      true};
+
+    int quality = 0;
     float last_sample = 0;
     float shimmer_amount = 0;
     gam::ReverbMS<> reverb;
+    dsp::FDNReverb fdn;
+    /// Whether the last buffer was processed by `fdn`
+    bool was_fdn = false;
+    /// Whether the last buffer played the held tail
+    bool was_frozen = false;
+    /// The shimmer of the last `shimmer_delay.size()` frames, fed back into the fdn
+    std::array<float, 64> shimmer_delay = {};
+    int shimmer_pos = 0;
     dsp::SimplePitchShift pitchshifter;
+    dsp::GrainPitchShift grain_shifter;
     std::array<gam::Delay<>, 2> output_delay;
     gam::Biquad<> shimmer_filter;
     gam::BlockDC<> dc_block;
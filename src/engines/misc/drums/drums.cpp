@@ -0,0 +1,241 @@
+#include "drums.hpp"
+
+#include <algorithm>
+
+// WAV parser by Adam Stark: https://github.com/adamstark/AudioFile
+#include <AudioFile.h>
+
+#include "core/ui/vector_graphics.hpp"
+
+#include "util/audio.hpp"
+#include "util/dsp/resampler.hpp"
+#include "util/utility.hpp"
+
+#include "services/asset_loader.hpp"
+#include "services/audio_manager.hpp"
+#include "services/log_manager.hpp"
+
+namespace otto::engines {
+
+  using namespace ui;
+  using namespace ui::vg;
+
+  struct DrumsScreen : EngineScreen<Drums> {
+    void draw(Canvas& ctx) override;
+    bool keypress(Key key) override;
+    void encoder(EncoderEvent e) override;
+    /// The audio thread publishes the playing step and channels when they change
+    bool animating() override
+    {
+      return engine.meters.has_new();
+    }
+
+    using EngineScreen<Drums>::EngineScreen;
+  };
+
+  Drums::Drums() : MiscEngine<Drums>(ui::lazy_screen<DrumsScreen>(this))
+  {
+    load_kits();
+  }
+
+  Drums::~Drums()
+  {
+    AssetLoader::current().cancel(&_kits);
+  }
+
+  void Drums::load_kits()
+  {
+    auto dir = Application::current().data_dir / "drums";
+    int samplerate = Application::current().audio_manager->samplerate();
+    AssetLoader::current().load(
+      &_kits,
+      [dir, samplerate] {
+        auto kits = std::make_unique<Kits>();
+        if (!fs::is_directory(dir)) return kits;
+        std::vector<fs::path> kit_dirs;
+        for (auto& entry : fs::directory_iterator(dir)) {
+          if (entry.is_directory()) kit_dirs.push_back(entry.path());
+        }
+        std::sort(kit_dirs.begin(), kit_dirs.end());
+
+        for (auto& kit_dir : kit_dirs) {
+          std::vector<fs::path> files;
+          for (auto& entry : fs::directory_iterator(kit_dir)) {
+            if (entry.path().extension() == ".wav") files.push_back(entry.path());
+          }
+          std::sort(files.begin(), files.end());
+          files.resize(std::min<std::size_t>(files.size(), channel_count));
+
+          std::array<int, channel_count> regions;
+          regions.fill(-1);
+          for (std::size_t i = 0; i < files.size(); i++) {
+            AudioFile<float> file;
+            if (!file.load(files[i].string()) || file.getNumSamplesPerChannel() == 0) {
+              LOGE("Could not load drum sample {}", files[i].string());
+              continue;
+            }
+            auto samples = dsp::Resampler::resample(file.samples[0], file.getSampleRate(), samplerate);
+            regions[i] = kits->arena.add(samples, samplerate);
+          }
+          kits->regions.push_back(regions);
+          kits->names.push_back(kit_dir.filename().string());
+        }
+        return kits;
+      },
+      [this](std::unique_ptr<Kits> kits) {
+        _kit_names = kits->names;
+        _kits.publish(std::move(kits));
+      });
+  }
+
+  void Drums::samplerate_changed(int samplerate)
+  {
+    load_kits();
+  }
+
+  void Drums::audition(int channel) noexcept
+  {
+    _auditions.push(channel);
+  }
+
+  audio::ProcessData<1> Drums::process(audio::ProcessData<0> data)
+  {
+    auto* old_kits = _kits.get();
+    auto* kits = _kits.acquire();
+    // The voices may be reading the old arena
+    if (kits != old_kits) _voices.stop_all();
+
+    int kit = props.kit;
+    auto trigger = [&](int channel) {
+      if (kits == nullptr || kit >= kits->regions.size()) return;
+      int region = kits->regions[kit][channel];
+      if (region >= 0) _voices.trigger(kits->arena, region, channel, 1);
+    };
+
+    _auditions.consume([&](int channel) {
+      trigger(channel);
+      return true;
+    });
+
+    bool running = _running;
+    if (running && !_was_running) _step = -1;
+    _was_running = running;
+
+    auto [buf] = _output.acquire<1>(*data.context, data.nframes);
+    buf.clear();
+    float samplerate = data.context->samplerate;
+    int frame = 0;
+    auto render = [&](int until) {
+      if (until > frame) _voices.process({buf.data() + frame, until - frame}, samplerate);
+      frame = until;
+    };
+
+    for (auto& tick : services::ClockManager::current().ticks()) {
+      if (!running || tick.count % ticks_per_step != 0) continue;
+      // Render up to the step, so samples start on the right frame
+      render(tick.frame);
+      _step = (_step + 1) % step_count;
+      for (int c = 0; c < channel_count; c++) {
+        if (_channels[c].steps[_step]) trigger(c);
+      }
+    }
+    render(data.nframes);
+
+    auto volume = props.volume.smoothed_block(data.nframes);
+    util::audio::kernels().gain(buf.data(), volume.data(), data.nframes);
+
+    MeterValues values = {running ? _step : -1, 0};
+    for (int c = 0; c < channel_count; c++) {
+      if (_voices.playing(c)) values.playing_channels |= 1 << c;
+    }
+    if (!(values == _published)) {
+      meters.publish(values);
+      _published = values;
+    }
+
+    return data.redirect(std::move(buf));
+  }
+
+  // SCREEN //
+
+  bool DrumsScreen::keypress(ui::Key key)
+  {
+    if (key == +ui::Key::play) {
+      engine._running = !engine._running;
+      return true;
+    }
+    if (key >= +ui::Key::S0 && key <= +ui::Key::S15) {
+      auto& channel = engine._channels[engine._current_channel];
+      auto& step = channel.steps[key._to_integral() - ui::Key::S0];
+      step = !step;
+      return true;
+    }
+    if (key >= +ui::Key::C0 && key <= +ui::Key::C9) {
+      int channel = key._to_integral() - ui::Key::C0;
+      engine._current_channel = channel;
+      engine.audition(channel);
+      return true;
+    }
+    return false;
+  }
+
+  void DrumsScreen::encoder(ui::EncoderEvent ev)
+  {
+    auto& props = engine.props;
+    switch (ev.encoder) {
+    case Encoder::blue: props.kit.step(ev.steps); break;
+    case Encoder::red: props.volume.step(ev.steps); break;
+    default: break;
+    }
+  }
+
+  void DrumsScreen::draw(ui::vg::Canvas& ctx)
+  {
+    using namespace ui::vg;
+
+    constexpr float pad = 20;
+    constexpr float top = 50;
+    constexpr float x_sp = (width - 2 * pad) / Drums::step_count;
+    constexpr float y_sp = (height - top - pad) / Drums::channel_count;
+
+    auto& props = engine.props;
+    int kit = props.kit;
+
+    ctx.font(Fonts::Norm, 25);
+    ctx.fillStyle(Colours::Blue);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText(kit < engine._kit_names.size() ? engine._kit_names[kit] : "no kit", pad, pad);
+
+    ctx.fillStyle(Colours::Red);
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText(fmt::format("{}", std::round(props.volume * 100)), width - pad, pad);
+
+    int current = engine._current_channel;
+    auto& meters = engine.meters.read();
+    int step = meters.step;
+    int playing = meters.playing_channels;
+    for (int c = 0; c < Drums::channel_count; c++) {
+      float y = top + (c + 0.5f) * y_sp;
+      for (int s = 0; s < Drums::step_count; s++) {
+        float x = pad + (s + 0.5f) * x_sp;
+        bool on = engine._channels[c].steps[s];
+        ctx.beginPath();
+        ctx.circle(x, y, s == step ? 6 : 5);
+        if (on && c == current)
+          ctx.fill(Colours::Blue);
+        else if (on)
+          ctx.fill(Colours::Pink);
+        else if (c == current)
+          ctx.fill(Colours::Gray70);
+        else
+          ctx.fill(Colours::Gray50);
+      }
+      if (playing & (1 << c)) {
+        ctx.beginPath();
+        ctx.circle(pad / 2, y, 3);
+        ctx.fill(Colours::Green);
+      }
+    }
+  }
+
+} // namespace otto::engines
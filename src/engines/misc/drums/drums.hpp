@@ -0,0 +1,101 @@
+#pragma once
+
+#include "core/engine/engine.hpp"
+
+#include "services/clock_manager.hpp"
+#include "util/dsp/drum_voices.hpp"
+#include "util/handoff.hpp"
+#include "util/mpsc_queue.hpp"
+
+namespace otto::engines {
+
+  using namespace core;
+  using namespace core::engine;
+  using namespace props;
+
+  /// A ten channel drum sampler, with a sixteen step pattern for each channel
+  ///
+  /// All the kits in `data_dir/drums` are loaded at once into one @ref dsp::SampleArena, with
+  /// the first ten samples of each kit directory as its channels, so switching kits costs
+  /// nothing. The samples are resampled to the audio samplerate when loaded, so they play
+  /// without interpolation. The channels share a small pool of voices, which bounds the cost of the engine
+  /// however busy the pattern is.
+  struct Drums : MiscEngine<Drums> {
+    static constexpr util::string_ref name = "Drums";
+    static constexpr int channel_count = 10;
+    static constexpr int step_count = 16;
+
+    struct Props {
+      Property<int> kit = {0, limits(0, 15), step_size(1)};
+      Property<float, smoothed> volume = {1, limits(0, 1), step_size(0.01)};
+
+      DECL_REFLECTION(Props, kit, volume);
+    } props;
+
+    Drums();
+    ~Drums();
+
+    audio::ProcessData<1> process(audio::ProcessData<0>);
+
+    /// Reload the kits at the new samplerate
+    void samplerate_changed(int samplerate) override;
+
+    /// Play `channel` at the start of the next buffer. Safe to call from any thread.
+    void audition(int channel) noexcept;
+
+  private:
+    friend struct DrumsScreen;
+
+    /// The output, kept across callbacks
+    audio::EngineBuffers<1> _output;
+
+    /// The samples of all kits
+    struct Kits {
+      dsp::SampleArena arena;
+      /// The region of each channel of each kit, or -1 for none
+      std::vector<std::array<int, channel_count>> regions;
+      std::vector<std::string> names;
+    };
+
+    struct Channel {
+      std::array<std::atomic<bool>, step_count> steps = {};
+    };
+
+    struct MeterValues {
+      /// The playing step, or -1 when stopped
+      int step = -1;
+      /// A bit for each channel with a voice playing
+      int playing_channels = 0;
+
+      bool operator==(const MeterValues& rhs) const noexcept
+      {
+        return step == rhs.step && playing_channels == rhs.playing_channels;
+      }
+    };
+
+    /// Load all kits on the @ref services::AssetLoader, at the audio samplerate
+    void load_kits();
+
+    /// Steps are sixteenth notes
+    static constexpr int ticks_per_step = services::ClockManager::ticks_per_beat / 4;
+
+    std::array<Channel, channel_count> _channels;
+    std::atomic<int> _current_channel = 0;
+    std::atomic<bool> _running = false;
+
+    util::Handoff<Kits> _kits;
+    /// The kit names, for the UI thread
+    std::vector<std::string> _kit_names;
+    dsp::DrumVoices _voices;
+    util::MPSCQueue<int, 16> _auditions;
+
+    // Only used by the audio thread
+    bool _was_running = false;
+    int _step = -1;
+    /// The last values published to @ref meters
+    MeterValues _published;
+
+    Meters<MeterValues> meters;
+  };
+
+} // namespace otto::engines
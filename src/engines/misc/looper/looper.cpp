@@ -0,0 +1,163 @@
+#include "looper.hpp"
+
+#include "core/ui/vector_graphics.hpp"
+
+#include "util/iterator.hpp"
+#include "util/utility.hpp"
+
+#include "services/clock_manager.hpp"
+
+namespace otto::engines {
+
+  using namespace ui;
+  using namespace ui::vg;
+
+  struct LooperScreen : EngineScreen<Looper> {
+    void draw(Canvas& ctx) override;
+    bool keypress(Key key) override;
+    void encoder(EncoderEvent e) override;
+    bool animating() override;
+
+    using EngineScreen<Looper>::EngineScreen;
+  };
+
+  Looper::Looper() : MiscEngine<Looper>(ui::lazy_screen<LooperScreen>(this)) {}
+
+  audio::ProcessData<2> Looper::process(audio::ProcessData<2> data)
+  {
+    constexpr int chunk = 64;
+    std::array<float, chunk> left;
+    std::array<float, chunk> right;
+    float bpm = services::ClockManager::current().bpm();
+    tape.speed(props.follow_tempo && _loop_bpm > 0 ? bpm / _loop_bpm : 1);
+    auto level = props.level.smoothed_block(data.nframes);
+    for (int i = 0; i < data.nframes; i += chunk) {
+      int n = std::min<int>(chunk, data.nframes - i);
+      float* in_l = data.audio[0].data() + i;
+      float* in_r = data.audio[1].data() + i;
+      tape.process({in_l, n}, {in_r, n}, {left.data(), n}, {right.data(), n});
+      for (int f = 0; f < n; f++) {
+        in_l[f] += level[i + f] * left[f];
+        in_r[f] += level[i + f] * right[f];
+      }
+    }
+    // The tape is only heard while it plays. Commands are applied at the start of a buffer, so
+    // the state at the end covers all of it.
+    auto state = tape.state();
+    if (state == dsp::LoopTape::State::recording) _loop_bpm = bpm;
+    bool tape_silent = state != dsp::LoopTape::State::playing && state != dsp::LoopTape::State::overdubbing;
+    bool silent = tape_silent && data.audio[0].is_silent() && data.audio[1].is_silent();
+    for (auto& channel : data.audio) channel.mark_silent(silent);
+    return data;
+  }
+
+  // SCREEN //
+
+  void LooperScreen::encoder(ui::EncoderEvent ev)
+  {
+    if (ev.encoder == Encoder::red) engine.props.level.step(ev.steps);
+  }
+
+  bool LooperScreen::keypress(ui::Key key)
+  {
+    switch (key) {
+    case ui::Key::rec: engine.tape.record(); return true;
+    case ui::Key::play: engine.tape.play(); return true;
+    case ui::Key::yellow_click: engine.tape.undo(); return true;
+    case ui::Key::green_click: engine.props.follow_tempo = !engine.props.follow_tempo; return true;
+    case ui::Key::red_click: engine.tape.clear(); return true;
+    default: return false;
+    }
+  }
+
+  bool LooperScreen::animating()
+  {
+    // The audio thread records into the waveform, and may change the state
+    auto state = engine.tape.state();
+    return state != dsp::LoopTape::State::empty && state != dsp::LoopTape::State::stopped;
+  }
+
+  void LooperScreen::draw(ui::vg::Canvas& ctx)
+  {
+    using namespace ui::vg;
+    using State = dsp::LoopTape::State;
+
+    auto& tape = engine.tape;
+
+    constexpr float x_pad = 20;
+    constexpr float y_pad = 20;
+    constexpr float x_right = width - x_pad;
+    constexpr float y_bottom = height - y_pad;
+    constexpr float mid = height / 2;
+    constexpr float wave_height = 70;
+
+    auto state = tape.state();
+    auto [label, colour] = [&]() -> std::pair<const char*, Colour> {
+      switch (state) {
+      case State::empty: return {"EMPTY", Colours::Gray50};
+      case State::recording: return {"REC", Colours::Red};
+      case State::playing: return {"PLAY", Colours::Green};
+      case State::overdubbing: return {"OVERDUB", Colours::Red};
+      case State::stopped: return {"STOP", Colours::Blue};
+      }
+      OTTO_UNREACHABLE;
+    }();
+
+    ctx.font(Fonts::Norm, 25);
+    ctx.fillStyle(colour);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText(label, x_pad, y_pad);
+
+    if (tape.can_undo()) {
+      ctx.fillStyle(Colours::Yellow);
+      ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+      ctx.fillText("undo", x_right, y_pad);
+    }
+
+    if (engine.props.follow_tempo) {
+      ctx.fillStyle(Colours::Green);
+      ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+      ctx.fillText("follow", x_pad, y_bottom);
+    }
+
+    ctx.fillStyle(Colours::Red);
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText(fmt::format("level {}", std::round(engine.props.level * 100)), x_right, y_bottom);
+
+    // The waveform, one column of the summary per pixel. While recording, the loop so far
+    // fills the screen.
+    int bins = tape.summary_size();
+    if (bins == 0) return;
+    int length = tape.loop().size();
+    constexpr int columns = x_right - x_pad;
+    ctx.beginPath();
+    for (int c = 0; c < columns; c++) {
+      int first = c * bins / columns;
+      int last = std::max(first + 1, (c + 1) * bins / columns);
+      dsp::LoopTape::Peak peak = tape.summary(first);
+      for (int b = first + 1; b < last; b++) {
+        auto p = tape.summary(b);
+        peak.min = std::min(peak.min, p.min);
+        peak.max = std::max(peak.max, p.max);
+      }
+      float x = x_pad + c;
+      ctx.moveTo(x, mid - wave_height * std::clamp(peak.max, -1.f, 1.f));
+      ctx.lineTo(x, mid - wave_height * std::clamp(peak.min, -1.f, 1.f) + 1);
+    }
+    ctx.lineWidth(1);
+    ctx.strokeStyle(colour);
+    ctx.stroke();
+
+    // Play head
+    if (state != State::recording) {
+      float x = x_pad + columns * float(tape.position()) / length;
+      ctx.beginPath();
+      ctx.moveTo(x, mid - wave_height - 10);
+      ctx.lineTo(x, mid + wave_height + 10);
+      ctx.lineWidth(2);
+      ctx.strokeStyle(Colours::White);
+      ctx.stroke();
+    }
+  }
+
+} // namespace otto::engines
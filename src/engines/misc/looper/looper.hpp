@@ -0,0 +1,57 @@
+#pragma once
+
+#include "core/engine/engine.hpp"
+
+#include "util/arena.hpp"
+#include "util/dsp/loop_tape.hpp"
+
+namespace otto::engines {
+
+  using namespace core;
+  using namespace core::engine;
+  using namespace props;
+
+  /// A loop station, recording and overdubbing the mix before the master
+  ///
+  /// The loop follows the tempo of the clock, time stretched from the tempo it was recorded at.
+  struct Looper : MiscEngine<Looper> {
+    static constexpr util::string_ref name = "Looper";
+
+    /// The longest loop, in frames at 48kHz
+    static constexpr int max_frames = 30 * 48000;
+
+    struct Props {
+      Property<float, smoothed> level = {1, limits(0, 1), step_size(0.01)};
+      /// Play the loop at the tempo of the clock, instead of the tempo it was recorded at
+      Property<bool, atomic> follow_tempo = true;
+
+      DECL_REFLECTION(Props, level, follow_tempo);
+    } props;
+
+    Looper();
+
+    /// Add the loop to the mix, and record it when recording
+    audio::ProcessData<2> process(audio::ProcessData<2>);
+
+    /// Tier 1 stretches with a coarser search, and tier 2 without one
+    int quality_tiers() const noexcept override
+    {
+      return 3;
+    }
+
+    void quality_tier(int tier) noexcept override
+    {
+      tape.stretch_quality(static_cast<dsp::TimeStretch::Quality>(tier));
+    }
+
+    /// Holds the buffers of the time stretcher of the tape
+    util::Arena arena{dsp::TimeStretch::memory_size + 2 * util::Arena::block_alignment,
+                      &util::memory_tag(name.c_str())};
+    dsp::LoopTape tape{max_frames, true, &arena};
+
+  private:
+    /// The tempo at the end of the recording of the first layer
+    float _loop_bpm = 0;
+  };
+
+} // namespace otto::engines
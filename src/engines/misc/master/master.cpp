@@ -2,7 +2,8 @@
 
 #include "core/ui/vector_graphics.hpp"
 
-#include "util/iterator.hpp"
+#include "services/audio_manager.hpp"
+#include "util/audio.hpp"
 #include "util/utility.hpp"
 
 namespace otto::engines {
@@ -18,18 +19,29 @@ namespace otto::engines {
   };
 
   Master::Master()
-    : MiscEngine<Master>(std::make_unique<MasterScreen>(this))
+    : MiscEngine<Master>(ui::lazy_screen<MasterScreen>(this))
   {}
 
 
   audio::ProcessData<2> Master::process(audio::ProcessData<2> data)
   {
-    for (auto&& l : data.audio[0]) {
-      l *= props.volume * props.volume * 0.80;
-    }
-    for (auto&& r : data.audio[1]) {
-      r *= props.volume * props.volume * 0.80;
+    auto volume = props.volume.smoothed_block(data.nframes);
+    // Silence stays silent, once the lookahead delay has played out and the gain has recovered
+    if (data.audio[0].is_silent() && data.audio[1].is_silent()) {
+      if (_silent_frames >= dsp::Dynamics::lookahead && dynamics.gain_reduction() < 0.01f) return data;
+      dynamics.process({data.audio[0].data(), data.nframes}, {data.audio[1].data(), data.nframes});
+      _silent_frames = std::min(_silent_frames + int(data.nframes), dsp::Dynamics::lookahead);
+      data.audio[0].mark_silent(false);
+      data.audio[1].mark_silent(false);
+      return data;
     }
+    _silent_frames = 0;
+    float* gain = _gain.data(0);
+    util::audio::kernels().multiply(volume.data(), volume.data(), gain, data.nframes);
+    util::audio::kernels().scale(gain, 0.80f, data.nframes);
+    util::audio::kernels().gain(data.audio[0].data(), gain, data.nframes);
+    util::audio::kernels().gain(data.audio[1].data(), gain, data.nframes);
+    dynamics.process({data.audio[0].data(), data.nframes}, {data.audio[1].data(), data.nframes});
     return data;
   }
 
@@ -50,6 +62,17 @@ namespace otto::engines {
     ctx.fillStyle(Colour::bytes(255, 255, 255));
     ctx.fillText("master volume", 86.6, 189.9);
 
+    // Gain reduction
+    float reduction = engine.dynamics.gain_reduction();
+    if (reduction > 0.1) {
+      ctx.group([&] {
+        ctx.font(Fonts::Norm, 20);
+        ctx.fillStyle(Colours::Red);
+        ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+        ctx.fillText(fmt::format("-{:.1f} dB", reduction), {160, 215});
+      });
+    }
+
     // Dot
     ctx.save();
     ctx.beginPath();
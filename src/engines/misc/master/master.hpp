@@ -2,6 +2,8 @@
 
 #include "core/engine/engine.hpp"
 
+#include "util/dsp/dynamics.hpp"
+
 namespace otto::engines {
 
   using namespace core;
@@ -12,7 +14,7 @@ namespace otto::engines {
     static constexpr util::string_ref name = "Master";
 
     struct Props {
-      Property<float> volume = {0.5, limits(0, 1), step_size(0.01)};
+      Property<float, smoothed> volume = {0.5, limits(0, 1), step_size(0.01)};
 
       DECL_REFLECTION(Props, volume);
     } props;
@@ -20,6 +22,16 @@ namespace otto::engines {
     Master();
 
     audio::ProcessData<2> process(audio::ProcessData<2>);
+
+    /// Compresses and limits the mix, after the volume. Delays it by
+    /// `dsp::Dynamics::lookahead` frames.
+    dsp::Dynamics dynamics;
+
+  private:
+    /// The number of frames the input has been marked silent for
+    int _silent_frames = 0;
+    /// The gain of each frame
+    audio::EngineBuffers<1> _gain;
   };
 
 } // namespace otto::engines
@@ -2,6 +2,8 @@
 
 #include "core/ui/vector_graphics.hpp"
 
+#include "util/audio.hpp"
+
 #include "services/controller.hpp"
 
 namespace otto::engines {
@@ -13,9 +15,33 @@ namespace otto::engines {
 
     void draw(core::ui::vg::Canvas& ctx) override;
     void encoder(core::ui::EncoderEvent e) override;
+    bool animating() override
+    {
+      return engine.metered && (engine.meters.has_new() || level > 0);
+    }
+
+    void draw_input_meter(core::ui::vg::Canvas& ctx);
+
+    /// The level drawn, which falls back slowly from the peaks
+    float level = 0;
   };
 
-  Sends::Sends() : MiscEngine<Sends>(std::make_unique<SendsScreen>(this)) {
+  Sends::Sends(bool metered) : MiscEngine<Sends>(ui::lazy_screen<SendsScreen>(this)), metered(metered) {}
+
+  std::array<float, Sends::bus_count> Sends::gains(Input input) const noexcept
+  {
+    float dry = props.dry;
+    float pan = props.dry_pan;
+    switch (input) {
+    case Input::left: return {0.5f * props.to_FX1, 0.5f * props.to_FX2, dry * (1 - pan), 0};
+    case Input::right: return {0.5f * props.to_FX1, 0.5f * props.to_FX2, 0, dry * (1 + pan)};
+    default: return {props.to_FX1, props.to_FX2, dry * (1 - pan), dry * (1 + pan)};
+    }
+  }
+
+  void Sends::meter_input(const float* data, int nframes) noexcept
+  {
+    meters.publish({util::audio::kernels().peak(data, nframes)});
   }
 
   LED led_for(ChannelEnum ce) {
@@ -341,6 +367,35 @@ namespace otto::engines {
     ctx.lineJoin(Canvas::LineJoin::ROUND);
     ctx.stroke();
     ctx.restore();
+
+    if (engine.metered) draw_input_meter(ctx);
+  }
+
+  void SendsScreen::draw_input_meter(core::ui::vg::Canvas& ctx)
+  {
+    using namespace core::ui::vg;
+    float peak = engine.meters.read().input_peak;
+    level = std::max(peak, level * 0.85f);
+    if (level < 0.001f) level = 0;
+
+    // A bar left of the icon, red when the input clips
+    constexpr float x = 10, top = 60, bottom = 180;
+    ctx.save();
+    ctx.lineWidth(6.0);
+    ctx.lineCap(Canvas::LineCap::ROUND);
+    ctx.beginPath();
+    ctx.moveTo(x, bottom);
+    ctx.lineTo(x, top);
+    ctx.strokeStyle(Colours::Gray50);
+    ctx.stroke();
+    if (level > 0) {
+      ctx.beginPath();
+      ctx.moveTo(x, bottom);
+      ctx.lineTo(x, bottom - (bottom - top) * std::min(level, 1.f));
+      ctx.strokeStyle(peak >= 1 ? Colours::Red : Colours::White);
+      ctx.stroke();
+    }
+    ctx.restore();
   }
 
   void SendsScreen::encoder(core::ui::EncoderEvent e)
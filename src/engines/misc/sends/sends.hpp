@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 #include "core/engine/engine.hpp"
 
 namespace otto::engines {
@@ -9,6 +11,12 @@ namespace otto::engines {
 
   struct Sends : MiscEngine<Sends> {
     static constexpr util::string_ref name = "Sends";
+
+    /// The buses a source is sent to, the columns of the send matrix
+    enum Bus { fx1, fx2, dry_left, dry_right };
+    static constexpr int bus_count = 4;
+
+    /// The gains are ramped over each buffer by the send matrix, so they are not smoothed here
     struct Props {
       props::Property<float> to_FX1 = {0, props::limits(0, 1), props::step_size(0.01)};
       props::Property<float> to_FX2 = {0, props::limits(0, 1), props::step_size(0.01)};
@@ -18,6 +26,28 @@ namespace otto::engines {
       DECL_REFLECTION(Props, to_FX1, to_FX2, dry, dry_pan);
     } props;
 
-    Sends();
+    struct MeterValues {
+      /// The peak of the input in the last buffer
+      float input_peak = 0;
+    };
+
+    Meters<MeterValues> meters;
+
+    /// @param metered Whether the screen shows the level of the input, like for the line input
+    Sends(bool metered = false);
+
+    /// A channel of the source, the rows of the send matrix
+    enum struct Input { mono, left, right };
+
+    /// The gain from `input` to each bus, indexed by @ref Bus
+    ///
+    /// A side of a stereo source sends half to the effects, and only to its own side of the dry
+    /// mix, where the pan balances it.
+    std::array<float, bus_count> gains(Input input = Input::mono) const noexcept;
+
+    /// Publish the peak of the input to `meters`. Called on the audio thread.
+    void meter_input(const float* data, int nframes) noexcept;
+
+    const bool metered;
   };
 } // namespace otto::engines
@@ -0,0 +1,118 @@
+#include "sidechain.hpp"
+
+#include "core/ui/vector_graphics.hpp"
+
+namespace otto::engines {
+
+  using namespace ui;
+  using namespace ui::vg;
+
+  struct SidechainScreen : EngineScreen<Sidechain> {
+    void draw(Canvas& ctx) override;
+    bool keypress(Key key) override;
+    void encoder(EncoderEvent e) override;
+    /// The gain reduction follows the key
+    bool animating() override
+    {
+      return engine.props.depth > 0;
+    }
+
+    using EngineScreen<Sidechain>::EngineScreen;
+  };
+
+  Sidechain::Sidechain() : MiscEngine<Sidechain>(ui::lazy_screen<SidechainScreen>(this)) {}
+
+  void Sidechain::process(gsl::span<const float> key, gsl::span<float> signal) noexcept
+  {
+    process(key, signal, {});
+  }
+
+  void Sidechain::process(gsl::span<const float> key, gsl::span<float> left, gsl::span<float> right) noexcept
+  {
+    if (props.depth <= 0) return;
+    ducker.threshold(props.threshold);
+    ducker.ratio(props.ratio);
+    ducker.release(props.release);
+    ducker.depth(props.depth);
+    ducker.process(key, left, right);
+  }
+
+  // SCREEN //
+
+  bool SidechainScreen::keypress(Key key)
+  {
+    auto& props = engine.props;
+    switch (key) {
+    case Key::red_click: props.source = (props.source + 1) % 3; return true;
+    default: return false;
+    }
+  }
+
+  void SidechainScreen::encoder(EncoderEvent e)
+  {
+    auto& props = engine.props;
+    switch (e.encoder) {
+    case Encoder::blue: props.threshold.step(e.steps); break;
+    case Encoder::green: props.ratio.step(e.steps); break;
+    case Encoder::yellow: props.release.step(e.steps); break;
+    case Encoder::red: props.depth.step(e.steps); break;
+    }
+  }
+
+  void SidechainScreen::draw(Canvas& ctx)
+  {
+    auto& props = engine.props;
+
+    constexpr float x_pad = 20;
+    constexpr float y_pad = 20;
+    constexpr float x_right = width - x_pad;
+    constexpr float y_bottom = height - y_pad;
+    constexpr float number_shift = 30;
+
+    // Text
+    ctx.font(Fonts::Norm, 25);
+    ctx.fillStyle(Colours::Blue);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText("threshold", x_pad, y_pad);
+
+    ctx.fillStyle(Colours::Green);
+    ctx.fillText("ratio", x_pad, y_bottom);
+
+    ctx.fillStyle(Colours::Yellow);
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText("release", x_right, y_pad);
+
+    ctx.fillStyle(Colours::Red);
+    ctx.fillText("depth", x_right, y_bottom);
+
+    // Numbers
+    ctx.font(Fonts::Norm, 40);
+    ctx.fillStyle(Colours::Blue);
+    ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+    ctx.fillText(fmt::format("{}", std::round(props.threshold)), x_pad, y_pad + number_shift);
+
+    ctx.fillStyle(Colours::Green);
+    ctx.fillText(fmt::format("{:.1f}", props.ratio.get()), x_pad, y_bottom - number_shift);
+
+    ctx.fillStyle(Colours::Yellow);
+    ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+    ctx.fillText(fmt::format("{}", std::round(props.release * 1000)), x_right, y_pad + number_shift);
+
+    ctx.fillStyle(Colours::Red);
+    ctx.fillText(fmt::format("{}", std::round(props.depth)), x_right, y_bottom - number_shift);
+
+    // The key, and the gain reduction
+    constexpr std::array<const char*, 3> sources = {"DRUMS", "LINE IN", "DRUMS + LINE IN"};
+    ctx.group([&] {
+      ctx.font(Fonts::Norm, 25);
+      ctx.fillStyle(Colours::White);
+      ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+      ctx.fillText(sources[props.source], {width / 2, height / 2 - 15});
+      float reduction = props.depth > 0 ? engine.ducker.gain_reduction() : 0;
+      ctx.font(Fonts::Norm, 20);
+      ctx.fillStyle(reduction > 0.1 ? Colours::Red : Colours::Gray50);
+      ctx.fillText(fmt::format("-{:.1f} dB", reduction), {width / 2, height / 2 + 20});
+    });
+  }
+
+} // namespace otto::engines
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core/engine/engine.hpp"
+
+#include "util/dsp/ducker.hpp"
+
+namespace otto::engines {
+
+  using namespace core;
+  using namespace core::engine;
+  using namespace props;
+
+  /// Ducks the synth bus by the level of the drums or the line input
+  struct Sidechain : MiscEngine<Sidechain> {
+    static constexpr util::string_ref name = "Sidechain";
+
+    /// The busses the detector can listen to
+    enum struct Source { drums, line_in, both };
+
+    struct Props {
+      /// A @ref Source
+      Property<int> source = {0, limits(0, 2)};
+      Property<float> threshold = {-24, limits(-48, 0), step_size(1)};
+      Property<float> ratio = {4, limits(1, 20), step_size(0.5)};
+      Property<float> release = {0.2, limits(0.02, 1), step_size(0.01)};
+      /// The largest reduction in dB. No ducking at 0.
+      Property<float> depth = {0, limits(0, 48), step_size(1)};
+
+      DECL_REFLECTION(Props, source, threshold, ratio, release, depth);
+    } props;
+
+    Sidechain();
+
+    /// Duck `signal` in place by `key`. Called on the audio thread.
+    void process(gsl::span<const float> key, gsl::span<float> signal) noexcept;
+    /// Duck `left` and `right` in place by `key`, with the same gain
+    void process(gsl::span<const float> key, gsl::span<float> left, gsl::span<float> right) noexcept;
+
+    dsp::Ducker ducker;
+  };
+
+} // namespace otto::engines
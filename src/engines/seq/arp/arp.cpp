@@ -2,6 +2,9 @@
 
 #include "core/ui/vector_graphics.hpp"
 #include <algorithm>
+#include <cmath>
+
+#include "services/clock_manager.hpp"
 
 namespace otto::engines {
 
@@ -47,7 +50,12 @@ namespace otto::engines {
     void encoder(ui::EncoderEvent e) override;
     void draw(Canvas& ctx) override;
 
-    void calculate_dots(std::vector<Point>&);
+    void calculate_dots(const Arp::Steps&, std::vector<Point>&);
+    /// Redrawn when the audio thread publishes new steps
+    bool animating() override
+    {
+      return engine.meters.has_new();
+    }
 
     using EngineScreen::EngineScreen;
   };
@@ -59,15 +67,19 @@ namespace otto::engines {
     for (auto& event : data.midi) {
       util::match(event,
                   [&](midi::NoteOnEvent& ev) {
-                    // Add notes to stack
-                    held_notes_.push_back(ev);
+                    // Add notes to stack. Keys already held, and notes past the capacity, are
+                    // ignored
+                    if (held_notes_.size() == held_notes_.capacity()) return;
+                    if (util::any_of(held_notes_, [&](auto& n) { return n.key == ev.key; })) return;
+                    held_notes_.push_back({ev.key, ev.velocity});
                     has_changed_ = true;
-                    // Remove from data struct
                   },
                   [&](midi::NoteOffEvent& ev) {
-                    // Remove all corresponding notes from the stack
-                    util::erase_if(held_notes_,
-                                   [ev](midi::NoteOnEvent& noe) { return ev.key == noe.key; });
+                    // Remove the corresponding note from the stack, keeping the order
+                    auto found = util::find_if(held_notes_, [&](auto& n) { return n.key == ev.key; });
+                    if (found == held_notes_.end()) return;
+                    std::move(found + 1, held_notes_.end(), found);
+                    held_notes_.pop_back();
                     has_changed_ = true;
                   },
                   [](auto&&) {});
@@ -75,178 +87,160 @@ namespace otto::engines {
 
     data.midi.clear();
 
+    auto& steps = props.output_stack_;
+
     // If the held_notes_ stack has changed, re-sort and reset.
     if (has_changed_) {
-      //Flag to recalculate on the graphics thread
-      props.graphics_outdated = true;
       // If stack is now empty, stop the arpeggiator
       if (held_notes_.empty()) {
         running_ = false;
-        for (auto&& ev : *iter) {
-          data.midi.push_back(midi::NoteOffEvent(ev.key));
+        if (step_ >= 0 && step_ < steps.size()) {
+          for (auto& note : steps[step_]) {
+            data.midi.push_back(midi::NoteOffEvent(note.key));
+          }
         }
         //Necessary to clear the output_stack and the dots on the screen
         sort_notes();
-        iter = util::view::circular(props.output_stack_).begin();
-        props.graphics_outdated = true;
-      } else if (!running_) { // If it wasn't running and should start now
+        step_ = -1;
+        has_changed_ = false;
+      } else if (!running_) { // If it wasn't running and should start now. Starts on the next step.
         running_ = true;
-        _counter = 0;
       }
     }
 
-    // Check for beat. will be obsolete with master clock
-    auto next_beat = (_samples_per_beat - _counter) % _samples_per_beat;
+    if (!running_) return data;
+
+    auto& clock = services::ClockManager::current();
+    int ticks_per_step = services::ClockManager::ticks_per_beat / props.subdivision;
+    float note_length = props.note_length;
 
-    // If we are running, at a note-off point, and the output stack is not empty send note-off
-    // events
-    if (next_beat <= _samples_per_beat - note_off_frames && running_ && !props.output_stack_.empty()) {
-      for (auto ev : *iter) {
-        data.midi.push_back(midi::NoteOffEvent(ev.key));
+    // Send note-off events for the current step, if its note-off point is in this buffer
+    auto note_off = [&](double step_start) {
+      if (step_ < 0 || step_ >= steps.size()) return;
+      auto frame = clock.frame_of(step_start + note_length * ticks_per_step);
+      if (!frame) return;
+      for (auto& note : steps[step_]) {
+        data.midi.push_back(midi::NoteOffEvent(note.key, 1, 0, *frame));
       }
-    }
+    };
 
-    // If we are running, and at a new beat, do stuff.
-    if (next_beat <= data.nframes && running_) {
+    note_off(std::floor(clock.position() / ticks_per_step) * ticks_per_step);
+
+    for (auto& tick : clock.ticks()) {
+      if (tick.count % ticks_per_step != 0) continue;
       // Resort notes. Wait until this point to make sure that off events have been sent
       if (has_changed_) {
         sort_notes();
-        iter = util::view::circular(props.output_stack_).begin();
+        step_ = -1;
         has_changed_ = false;
       }
-      // Go to next value in the output_stack
-      // increment in output stack (wrapping) and push new notes
-      iter++;
-      for (auto ev : *iter) {
-        data.midi.push_back(ev);
+      if (steps.empty()) continue;
+      // Go to the next step, wrapping, and push its notes
+      step_ = (step_ + 1) % steps.size();
+      for (auto& note : steps[step_]) {
+        data.midi.push_back(midi::NoteOnEvent(note.key, note.velocity, 0, tick.frame));
       }
+      note_off(tick.count);
     }
 
-    // Increment counter. will be obsolete with master clock
-    _counter += data.nframes;
-    _counter %= _samples_per_beat;
-
     return data;
   }
 
-  Arp::Arp() : ArpeggiatorEngine<Arp>(std::make_unique<ArpScreen>(this))
-  {
-    // Set on_change handlers
-    props.note_length.on_change().connect(
-      [this](float len) { note_off_frames = (int)(len * (float)_samples_per_beat); });
-    props.subdivision.on_change().connect(
-            [this](int mod) {
-              _samples_per_beat = _samples_per_quarternote / mod;
-              note_off_frames = (int)(props.note_length * (float)_samples_per_beat);
-            });
-  }
+  Arp::Arp() : ArpeggiatorEngine<Arp>(ui::lazy_screen<ArpScreen>(this)) {}
 
   // Sorting  for the arpeggiator. This is where the magic happens.
   void Arp::sort_notes()
   {
-    auto& res = props.output_stack_;
-    res.clear();
-    // Sanitize input (remove duplicates)
-    //Maybe only needed for development. Let's leave it for now
-
-    // Add new notes depending on octavemode. Most octavemodes add new vectors to the output
-    // (separate steps), but unison modes add new notes to the same steps. To keep things
-    // "simple", an octavemode cannot do both.
+    // Add new notes depending on octavemode. Most octavemodes add new steps to the output,
+    // but unison modes add new notes to the same steps. To keep things "simple", an
+    // octavemode cannot do both.
+    Steps added;
     switch (props.octavemode.get()) {
     case OctaveMode::octaveup: {
-      for (auto ev : held_notes_) {
-        NoteArray orig;
-        orig.push_back(ev);
-        NoteArray oct;
-        oct.push_back(transpose_note(ev, 12));
-        res.push_back(orig);
-        res.push_back(oct);
+      for (auto note : held_notes_) {
+        added.add_step(note);
+        added.add_step(transpose_note(note, 12));
       }
       break;
     }
     case OctaveMode::octaveupunison: {
-      for (auto ev : held_notes_) {
-        NoteArray new_step;
-        new_step.push_back(ev);
-        new_step.push_back(transpose_note(ev, 12));
-        res.push_back(new_step);
+      for (auto note : held_notes_) {
+        added.add_step(note);
+        added.add_note(transpose_note(note, 12));
       }
       break;
     }
     case OctaveMode::fifthunison: {
-      for (auto ev : held_notes_) {
-        NoteArray new_step;
-        new_step.push_back(ev);
-        new_step.push_back(transpose_note(ev, 7));
-        res.push_back(new_step);
+      for (auto note : held_notes_) {
+        added.add_step(note);
+        added.add_note(transpose_note(note, 7));
       }
       break;
     }
     case OctaveMode::octaveupdown: {
-      for (auto ev : held_notes_) {
-        NoteArray up;
-        up.push_back(transpose_note(ev, 12));
-        NoteArray down;
-        down.push_back(transpose_note(ev, -12));
-        res.push_back(up);
-        res.push_back(down);
+      for (auto note : held_notes_) {
+        added.add_step(transpose_note(note, 12));
+        added.add_step(transpose_note(note, -12));
       }
       break;
     }
     case OctaveMode::standard: [[fallthrough]];
     default: {
-      for (auto ev : held_notes_) {
-        NoteArray new_step;
-        new_step.push_back(ev);
-        res.push_back(new_step);
+      for (auto note : held_notes_) {
+        added.add_step(note);
       }
       break;
     }
     }
 
-    // Sort vectors (steps) according to the playmode. A mode like updown adds extra steps.
-    // The chord mode gathers all vectors into one.
+    // Order the steps by their first key, in a fixed size array of indices
+    util::local_vector<int, Steps::max_steps> order;
+    for (int i = 0; i < added.size(); i++) order.push_back(i);
+    auto sort_order = [&](auto&& cmp) {
+      std::sort(order.begin(), order.end(),
+                [&](int a, int b) { return cmp(added[a][0].key, added[b][0].key); });
+    };
+
+    // Sort steps according to the playmode. A mode like updown adds extra steps.
+    // The chord mode gathers all steps into one.
     switch (props.playmode.get()) {
-    case Playmode::up: {
-      util::sort(res, [](auto& a, auto& b) { return a.front().key < b.front().key; });
-    } break;
-    case Playmode::down: {
-      util::sort(res, [](auto& a, auto& b) { return a.front().key > b.front().key; });
-    } break;
-    case Playmode::updown: {
-      util::sort(res, [](auto& a, auto& b) { return a.front().key < b.front().key; });
-      if (res.size() > 2)
-        std::reverse_copy(res.begin() + 1, res.end() - 1, std::back_inserter(res));
-    } break;
+    case Playmode::up: [[fallthrough]];
+    case Playmode::updown: [[fallthrough]];
+    case Playmode::updowninc: sort_order(std::less<>()); break;
+    case Playmode::down: [[fallthrough]];
+    case Playmode::downup: [[fallthrough]];
+    case Playmode::downupinc: sort_order(std::greater<>()); break;
+    default: break;
+    }
+
+    auto& res = props.output_stack_;
+    res.clear();
+    for (int i : order) {
+      res.add_step();
+      for (auto& note : added[i]) res.add_note(note);
+    }
+
+    switch (props.playmode.get()) {
+    case Playmode::updown: [[fallthrough]];
     case Playmode::downup: {
-      util::sort(res, [](auto& a, auto& b) { return a.front().key > b.front().key; });
-      if (res.size() > 2)
-        std::reverse_copy(res.begin() + 1, res.end() - 1, std::back_inserter(res));
-    } break;
-    case Playmode::updowninc: {
-      util::sort(res, [](auto& a, auto& b) { return a.front().key < b.front().key; });
-      std::reverse_copy(res.begin(), res.end(), std::back_inserter(res));
+      if (res.size() > 2) res.append_reversed(1, res.size() - 1);
     } break;
+    case Playmode::updowninc: [[fallthrough]];
     case Playmode::downupinc: {
-      util::sort(res, [](auto& a, auto& b) { return a.front().key > b.front().key; });
-      std::reverse_copy(res.begin(), res.end(), std::back_inserter(res));
+      res.append_reversed(0, res.size());
     } break;
-    case Playmode::manual: break;
     case Playmode::chord: {
-      NoteArray chord;
-      for (auto& na : res) {
-        chord.append(na);
-      }
-      res.clear();
-      res.push_back(std::move(chord));
+      res.merge();
     } break;
     default: {}
     }
+
+    meters.publish({res});
   }
 
-  midi::NoteOnEvent Arp::transpose_note(midi::NoteOnEvent orig, int t)
+  Arp::Note Arp::transpose_note(Note orig, int t)
   {
-    midi::NoteOnEvent transposed = orig;
+    Note transposed = orig;
     transposed.key += t;
     return transposed;
   }
@@ -301,10 +295,9 @@ namespace otto::engines {
     ctx.restore();
 
     //Dots
-    //If dots are outdated, recalculate.
-    if (props.graphics_outdated) {
-      calculate_dots(dots);
-      props.graphics_outdated = false;
+    //If the steps were sorted again, recalculate.
+    if (engine.meters.has_new()) {
+      calculate_dots(engine.meters.read().steps, dots);
     }
     //Draw dots
     for (auto& p : dots) {
@@ -315,7 +308,7 @@ namespace otto::engines {
 
   }
 
-   void ArpScreen::calculate_dots(std::vector<Point>& dots)
+   void ArpScreen::calculate_dots(const Arp::Steps& steps, std::vector<Point>& dots)
   {
     //Graphics options
     float y_bot = 190;
@@ -327,8 +320,9 @@ namespace otto::engines {
     int min = 88;
     int max = 0;
     //Find minimum and maximum key values
-    for (auto& v : engine.props.output_stack_)
+    for (int i = 0; i < steps.size(); i++)
     {
+      auto v = steps[i];
       num_steps += v.size();
 
       auto current_min = util::min_element(v, [](auto& a, auto& b){return a.key < b.key; });
@@ -338,9 +332,9 @@ namespace otto::engines {
     }
     //Calculate new dot values
     dots.clear();
-    for (int i=0; i<engine.props.output_stack_.size(); i++)
+    for (int i = 0; i < steps.size(); i++)
     {
-      for (auto& note : engine.props.output_stack_[i])
+      for (auto& note : steps[i])
       {
         Point p;
         p.x = width/2.f + (2 * i + 1 - num_steps) * x_step_width / 2.f;
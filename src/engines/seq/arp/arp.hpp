@@ -1,9 +1,11 @@
 #pragma once
 
-#include <foonathan/array/small_array.hpp>
-
 #include "core/engine/engine.hpp"
 
+#include <gsl/span>
+
+#include "util/local_vector.hpp"
+
 namespace otto::engines {
 
   using namespace core;
@@ -38,7 +40,90 @@ namespace otto::engines {
 
     using Playmode = detail::ArpPlaymode;
     using OctaveMode = detail::ArpOctaveMode;
-    using NoteArray = foonathan::array::small_array<midi::NoteOnEvent, 6>;
+
+    /// The most notes held at once. Further notes are ignored.
+    static constexpr int max_held = 16;
+
+    /// A held or played note
+    struct Note {
+      int key = 0;
+      float velocity = 1;
+    };
+
+    /// The steps of the arpeggio, each a group of notes played together
+    ///
+    /// The notes of all steps are stored back to back, with the index of the first note of
+    /// each step, so a full arpeggio fits in a fixed size. An octave mode at most doubles the
+    /// steps or the notes of the held notes, and a play mode at most doubles the steps.
+    struct Steps {
+      static constexpr int max_notes = 4 * max_held;
+      static constexpr int max_steps = 4 * max_held;
+
+      int size() const noexcept
+      {
+        return _starts.empty() ? 0 : _starts.size() - 1;
+      }
+
+      bool empty() const noexcept
+      {
+        return size() == 0;
+      }
+
+      /// The notes of step `step`
+      gsl::span<const Note> operator[](int step) const noexcept
+      {
+        return {_notes.begin() + _starts[step], _notes.begin() + _starts[step + 1]};
+      }
+
+      void clear() noexcept
+      {
+        _notes.clear();
+        _starts.clear();
+      }
+
+      /// Add a step of one note
+      void add_step(Note note) noexcept
+      {
+        add_step();
+        add_note(note);
+      }
+
+      /// Add an empty step
+      void add_step() noexcept
+      {
+        if (_starts.empty()) _starts.push_back(0);
+        _starts.push_back(_notes.size());
+      }
+
+      /// Add a note to the last step
+      void add_note(Note note) noexcept
+      {
+        _notes.push_back(note);
+        _starts.back()++;
+      }
+
+      /// Add copies of the steps `[first, last)`, in reverse order
+      void append_reversed(int first, int last) noexcept
+      {
+        for (int s = last - 1; s >= first; s--) {
+          add_step();
+          for (int n = _starts[s]; n < _starts[s + 1]; n++) add_note(_notes[n]);
+        }
+      }
+
+      /// Merge all steps into one
+      void merge() noexcept
+      {
+        if (empty()) return;
+        _starts.clear();
+        _starts.push_back(0);
+        _starts.push_back(_notes.size());
+      }
+
+    private:
+      util::local_vector<Note, max_notes> _notes;
+      util::local_vector<int, max_steps + 1> _starts;
+    };
 
     struct Props {
       Property<Playmode, wrap> playmode = {Playmode::up};
@@ -46,31 +131,38 @@ namespace otto::engines {
       Property<float> note_length = {0.2f, limits(0.01f, 0.97f), step_size(0.01)};
       Property<int, wrap> subdivision = {1, limits(1, 4)};
 
-      std::vector<NoteArray> output_stack_;
-      bool graphics_outdated = false;
+      Steps output_stack_;
 
       DECL_REFLECTION(Props, playmode, octavemode, note_length);
     } props;
 
+    struct MeterValues {
+      /// The steps being played, published whenever they are sorted again
+      Steps steps;
+    };
+
+    Meters<MeterValues> meters;
+
     Arp();
 
     audio::ProcessData<0> process(audio::ProcessData<0> data);
 
+    /// Rebuild the steps from the held notes, and publish them to @ref meters
+    ///
+    /// Allocates nothing, so the audio thread can call it on every note.
     void sort_notes();
 
-    midi::NoteOnEvent transpose_note(midi::NoteOnEvent, int);
+    Note transpose_note(Note, int);
 
 
   private:
-    int _samples_per_quarternote = 22050;
-    int _samples_per_beat = 22050;
-    int _counter = _samples_per_beat;
     bool has_changed_ = false;
-    int note_off_frames = 1000;
     bool running_ = false;
 
-    std::vector<midi::NoteOnEvent> held_notes_;
-    decltype(util::view::circular(props.output_stack_).begin()) iter = util::view::circular(props.output_stack_).begin();
+    /// In the order they were pressed
+    util::local_vector<Note, max_held> held_notes_;
+    /// The step playing, or -1 before the first
+    int step_ = -1;
   };
 
 
@@ -1,11 +1,14 @@
 #include "euclid.hpp"
 
+#include <cmath>
+
 #include "core/ui/vector_graphics.hpp"
 
 #include "util/cache.hpp"
 #include "util/iterator.hpp"
 #include "util/utility.hpp"
 
+#include "services/clock_manager.hpp"
 #include "services/log_manager.hpp"
 #include "services/state_manager.hpp"
 
@@ -17,11 +20,24 @@ namespace otto::engines {
   using Channel = Euclid::Channel;
 
   struct EuclidScreen : EngineScreen<Euclid> {
-    using EngineScreen<Euclid>::EngineScreen;
+    EuclidScreen(Euclid* engine) : EngineScreen<Euclid>(engine)
+    {
+      refresh_state();
+    }
 
     void draw(Canvas& ctx) override;
     bool keypress(Key key) override;
     void encoder(EncoderEvent e) override;
+    /// The hit follows the clock while running, and the recorded notes are picked up while
+    /// recording
+    bool animating() override
+    {
+      return engine.running || recording || engine._record_request != Euclid::no_request;
+    }
+
+    /// Read the meters of the engine, and set the property of the recorded channel to the notes
+    /// recorded since the last frame
+    void read_meters();
 
     void draw_normal(Canvas& ctx);
     void draw_recording(Canvas& ctx);
@@ -49,105 +65,171 @@ namespace otto::engines {
     void refresh_state();
 
     void draw_channel(ui::vg::Canvas& ctx, State::ChannelState& chan);
+
+    bool recording = false;
+    Euclid::Notes recorded = Euclid::no_notes;
+    int recorded_version = 0;
   };
 
-  Euclid::Euclid() : ArpeggiatorEngine<Euclid>(std::make_unique<EuclidScreen>(this))
+  Euclid::Euclid() : ArpeggiatorEngine<Euclid>(ui::lazy_screen<EuclidScreen>(this))
+  {
+    for (auto& c : props.channels) {
+      c.length.on_change().connect([&c](int) { c.update_pattern(); });
+      c.hits.on_change().connect([&c](int) { c.update_pattern(); });
+      c.rotation.on_change().connect([&c](int) { c.update_pattern(); });
+      c.notes.on_change().connect([this](Notes) { publish_notes(); });
+      c.update_pattern();
+    }
+    publish_notes();
+  }
+
+  void Euclid::publish_notes()
   {
-    for (auto& c : props.channels) c.update_notes();
-    static_cast<EuclidScreen*>(&screen())->refresh_state();
+    std::array<Notes, 4> notes;
+    for (int i = 0; i < 4; i++) notes[i] = props.channels[i].notes.get();
+    _notes.publish(notes);
+  }
+
+  void Euclid::record(bool on) noexcept
+  {
+    _record_request = on ? props.channel.get() : -1;
   }
 
   audio::ProcessData<0> Euclid::process(audio::ProcessData<0> data)
   {
-    auto& current = current_channel();
-    // Copy for thread safety
-    if (auto recording = this->recording; recording) {
+    const auto* published = _notes.read();
+    // After recording, the recorded notes are played until the screen has set the property to
+    // them, which publishes a new version, unless it had them already
+    if (!_recording && _recorded_channel >= 0 &&
+        (published != _published_at_stop || (*published)[_recorded_channel] == _recorded)) {
+      _recorded_channel = -1;
+    }
+    if (int request = _record_request.exchange(no_request); request != no_request) {
+      if (_recording && request < 0) _published_at_stop = published;
+      _recording = request >= 0;
+      if (_recording) {
+        _recorded_channel = request;
+        _recorded = (*published)[request];
+        _held = no_notes;
+        _has_pressed_keys = false;
+      }
+      meters.publish({_recording, _recorded_channel, _recorded, _recorded_version});
+    }
+    auto notes_of = [&](int channel) -> const Notes& {
+      return channel == _recorded_channel ? _recorded : (*published)[channel];
+    };
+
+    if (_recording) {
       for (auto& event : data.midi) {
         util::match(event,
                     [&](midi::NoteOnEvent& ev) {
                       if (!_has_pressed_keys) {
-                        util::fill(recording.value(), -1);
-                        current.notes.set(recording.value());
+                        util::fill(_held, -1);
                         _has_pressed_keys = true;
                       }
-                      for (auto& note : recording.value()) {
+                      for (auto& note : _held) {
                         if (note >= 0) continue;
                         note = ev.key;
                         break;
                       }
-                      util::unique(recording.value(), std::equal_to<char>());
-                      current.notes = recording.value();
+                      util::unique(_held, std::equal_to<char>());
+                      _recorded = _held;
+                      _recorded_version++;
                     },
                     [&](midi::NoteOffEvent& ev) {
-                      for (auto& note : recording.value()) {
+                      for (auto& note : _held) {
                         if (note != ev.key) continue;
                         note = -1;
                       }
-                      if (util::all_of(recording.value(), [](int note) { return note < 0; })) {
-                        recording = tl::nullopt;
+                      if (util::all_of(_held, [](int note) { return note < 0; })) {
+                        _recording = false;
+                        _published_at_stop = published;
                       }
                     },
                     [](auto&&) {});
-        this->recording = recording;
-        if (!recording) break;
-        ;
+        if (!_recording) break;
       }
+      meters.publish({_recording, _recorded_channel, _recorded, _recorded_version});
     }
     if (_should_run) running = true;
     if (!running) return data;
 
     if (!_should_run && running) {
-      for (auto& channel : props.channels) {
-        for (auto&& note : channel.notes.get()) {
+      for (int i = 0; i < 4; i++) {
+        for (auto note : notes_of(i)) {
           if (note >= 0) data.midi.push_back(midi::NoteOffEvent(note));
         }
       }
-      _counter = _samples_per_beat;
       running = false;
       return data;
     }
 
-    auto next_beat = _samples_per_beat - _counter;
-
-    if (next_beat <= data.nframes) {
-      for (auto& channel : props.channels) {
-        if (channel.length > 0) {
-          channel._beat_counter++;
-          channel._beat_counter %= channel.length;
-          for (auto& note : channel.notes.get()) {
-            if (note >= 0) data.midi.push_back(midi::NoteOffEvent(note));
-          }
-          if (running && channel._hits_enabled.at(channel._beat_counter)) {
-            for (auto note : channel.notes.get()) {
-              if (note >= 0) {
-                data.midi.push_back(midi::NoteOnEvent(note));
-              }
-            }
+    // The steps starting in this buffer are consecutive, so the hits of each channel for all of
+    // them are read at once, and tested with a shift for each step
+    std::array<int, max_steps_per_buffer> frames;
+    int steps = 0;
+    long first_step = 0;
+    for (auto& tick : services::ClockManager::current().ticks()) {
+      if (tick.count % ticks_per_step != 0) continue;
+      if (steps == 0) first_step = tick.count / ticks_per_step;
+      frames[steps++] = tick.frame;
+    }
+    if (steps == 0) return data;
+    std::array<std::uint64_t, 4> hits;
+    for (int i = 0; i < 4; i++) hits[i] = props.channels[i].hits_from(first_step, steps);
+
+    for (int s = 0; s < steps; s++) {
+      for (int i = 0; i < 4; i++) {
+        if (props.channels[i].length == 0) continue;
+        auto& notes = notes_of(i);
+        for (auto note : notes) {
+          if (note >= 0) data.midi.push_back(midi::NoteOffEvent(note, 1, 0, frames[s]));
+        }
+        if ((hits[i] >> s) & 1) {
+          for (auto note : notes) {
+            if (note >= 0) data.midi.push_back(midi::NoteOnEvent(note, 1, 0, frames[s]));
           }
         }
       }
     }
+    for (auto& channel : props.channels) {
+      if (channel.length > 0) channel._beat_counter = (first_step + steps - 1) % channel.length;
+    }
 
-    _counter += data.nframes;
-    _counter %= _samples_per_beat;
     return data;
   }
 
-  void Euclid::Channel::update_notes()
+  void Euclid::Channel::update_pattern()
   {
-    util::fill(_hits_enabled, false);
-    if (hits == 0 || length == 0) return;
-    for (float i = 0; i < length; i += length / float(hits)) {
-      int idx = int(std::round(i) + rotation) % length;
-      _hits_enabled.at(idx) = true;
+    // Hit k of the maximally even pattern is on step round(k * length / hits), computed in
+    // integers so no hits are lost to rounding
+    std::uint64_t pattern = 0;
+    for (int k = 0; k < hits && length > 0; k++) {
+      int idx = ((2 * k * length + hits) / (2 * hits) + rotation) % length;
+      pattern |= std::uint64_t(1) << idx;
     }
+    std::uint64_t steps = 0;
+    for (int i = 0; i < 64 && length > 0; i += length) steps |= pattern << i;
+    _steps = steps;
   }
 
   // SCREEN //
 
+  void EuclidScreen::read_meters()
+  {
+    auto& meters = engine.meters.read();
+    recording = meters.recording;
+    recorded = meters.notes;
+    if (meters.version != recorded_version && meters.channel >= 0) {
+      recorded_version = meters.version;
+      engine.props.channels.at(meters.channel).notes = meters.notes;
+    }
+  }
+
   void EuclidScreen::encoder(ui::EncoderEvent ev)
   {
-    if (engine.recording) return;
+    read_meters();
+    if (recording) return;
 
     auto& props = engine.props;
     auto& current = props.channels.at(props.channel);
@@ -158,7 +240,6 @@ namespace otto::engines {
     case Encoder::yellow: current.hits.step(ev.steps); break;
     case Encoder::red: current.rotation.step(ev.steps); break;
     }
-    current.update_notes();
     refresh_state();
   }
 
@@ -169,12 +250,8 @@ namespace otto::engines {
     case ui::Key::green_click: [[fallthrough]];
     case ui::Key::yellow_click: [[fallthrough]];
     case ui::Key::red_click:
-      if (engine.recording) {
-        engine.recording = tl::nullopt;
-      } else {
-        engine._has_pressed_keys = false;
-        engine.recording = engine.current_channel().notes;
-      }
+      read_meters();
+      engine.record(!recording);
       break;
     case ui::Key::play: engine._should_run = !engine._should_run; break;
     default: return false; ;
@@ -184,7 +261,8 @@ namespace otto::engines {
 
   void EuclidScreen::draw(ui::vg::Canvas& ctx)
   {
-    if (engine.recording)
+    read_meters();
+    if (recording)
       draw_recording(ctx);
     else
       draw_normal(ctx);
@@ -194,8 +272,6 @@ namespace otto::engines {
   {
     using namespace ui::vg;
 
-    auto& current = engine.current_channel();
-
     ctx.font(Fonts::Norm, 40);
 
     ctx.beginPath();
@@ -206,7 +282,7 @@ namespace otto::engines {
     ctx.beginPath();
     ctx.fillText(util::join_strings(
                    util::view::transform(
-                     util::view::filter(current.notes.get(), [](int note) { return note >= 0; }),
+                     util::view::filter(recorded, [](int note) { return note >= 0; }),
                      [](int note) { return midi::note_name(note); }),
                    " "),
                  {160, 120});
@@ -297,7 +373,8 @@ namespace otto::engines {
       ctx.beginPath();
       float r = 3;
       if (engine.running) {
-        float x = engine._counter / float(engine._samples_per_beat);
+        auto beats = static_cast<float>(services::ClockManager::current().current_time());
+        float x = std::fmod(beats * services::ClockManager::ticks_per_beat / Euclid::ticks_per_step, 1.f);
         ctx.rotateAround(x * M_PI * 2 / float(state.max_length), state.center);
       }
       ctx.circle(hit.point, r);
@@ -329,7 +406,7 @@ namespace otto::engines {
         auto& hs = cs.hits.at(i);
         float angle = 2.0 * M_PI * (i / float(state.max_length) - 0.25);
         hs.point = state.center + Point{cs.radius * std::cos(angle), cs.radius * std::sin(angle)};
-        hs.active = chan._hits_enabled.at(i);
+        hs.active = chan.hit(i);
       }
     }
   }
@@ -3,7 +3,11 @@
 #include "core/engine/engine.hpp"
 
 #include <array>
-#include <tl/optional.hpp>
+#include <atomic>
+#include <cstdint>
+
+#include "services/clock_manager.hpp"
+#include "util/rcu.hpp"
 
 namespace otto::engines {
 
@@ -15,17 +19,46 @@ namespace otto::engines {
     static constexpr util::string_ref name = "Euclid";
     static constexpr int max_length = 16;
 
+    /// The notes of a channel, -1 for none
+    using Notes = std::array<int, 6>;
+    static constexpr Notes no_notes = {{-1, -1, -1, -1, -1, -1}};
+
     struct Channel {
       Property<int> length = {max_length, limits(0, max_length), step_size(1)};
       Property<int> hits = {0, limits(0, max_length), step_size(1)};
       Property<int> rotation = {0, limits(0, max_length), step_size(1)};
 
-      Property<std::array<int, 6>> notes = {std::array<int, 6>{{-1, -1, -1, -1, -1, -1}}};
-
-      void update_notes();
-
+      Property<Notes> notes = {no_notes};
+
+      /// Recompute the pattern from the length, hits and rotation
+      ///
+      /// Called when they change, so the audio thread only indexes the pattern.
+      void update_pattern();
+
+      /// Whether there is a hit on step `step`, less than the length
+      bool hit(int step) const noexcept
+      {
+        return (_steps.load(std::memory_order_relaxed) >> step) & 1;
+      }
+
+      /// The hits of the `count` steps from step `step`, a bit for each from bit 0
+      ///
+      /// The steps wrap around at the length. `count` is at most @ref max_run.
+      std::uint64_t hits_from(long step, int count) const noexcept
+      {
+        if (length == 0) return 0;
+        auto steps = _steps.load(std::memory_order_relaxed) >> (step % length);
+        return count >= 64 ? steps : steps & ((std::uint64_t(1) << count) - 1);
+      }
+
+      /// The most steps @ref hits_from reads at once
+      static constexpr int max_run = 64 - max_length;
+
+      /// The last step played
       int _beat_counter = 0;
-      std::array<bool, max_length> _hits_enabled;
+      /// A bit for each step with a hit, with the pattern repeated to fill all 64 bits, so a run
+      /// of steps from any step is one shift
+      std::atomic<std::uint64_t> _steps = 0;
 
       DECL_REFLECTION(Channel, length, hits, rotation, notes);
     };
@@ -45,15 +78,60 @@ namespace otto::engines {
       return props.channels.at(props.channel);
     }
 
-    tl::optional<std::array<int, 6>> recording = tl::nullopt;
+    /// Start recording the notes of the current channel from the keys, or stop
+    ///
+    /// Recording stops by itself when all keys are released. Called from the UI thread. The
+    /// audio thread records, and shows the notes in @ref meters, which the screen then sets the
+    /// property of the channel to.
+    void record(bool on) noexcept;
+
+    struct MeterValues {
+      bool recording = false;
+      /// The channel recorded to, and the notes recorded so far
+      int channel = 0;
+      Notes notes = no_notes;
+      /// Counts the changes to `notes`, so the screen sets the property once for each
+      int version = 0;
+    };
+
+    Meters<MeterValues> meters;
 
     bool running = false;
 
   private:
     friend struct EuclidScreen;
 
-    int _samples_per_beat = 22050 / 4;
-    int _counter = _samples_per_beat;
+    /// Publish the notes of all channels to the audio thread. Called when they change.
+    void publish_notes();
+
+    /// The notes of each channel, as the audio thread plays them
+    ///
+    /// The property of a channel is set on the UI thread, by the screen, presets and undo, while
+    /// the audio thread plays the notes, so it plays from a version published on each change.
+    util::Rcu<std::array<Notes, 4>> _notes;
+
+    /// The value of @ref _record_request when there is none
+    static constexpr int no_request = -2;
+    /// The channel to start recording, -1 to stop, or @ref no_request
+    std::atomic<int> _record_request = no_request;
+
+    // Only used by the audio thread
+    bool _recording = false;
+    /// The keys held while recording
+    Notes _held = no_notes;
+    /// The recorded notes, played instead of the published notes of @ref _recorded_channel
+    /// until the screen has set the property to them
+    Notes _recorded = no_notes;
+    int _recorded_channel = -1;
+    int _recorded_version = 0;
+    /// The version of @ref _notes when recording stopped
+    const std::array<Notes, 4>* _published_at_stop = nullptr;
+
+    /// Steps are sixteenth notes
+    static constexpr int ticks_per_step = services::ClockManager::ticks_per_beat / 4;
+    /// The most steps starting in one buffer
+    static constexpr int max_steps_per_buffer = services::ClockManager::max_ticks / ticks_per_step + 1;
+    static_assert(max_steps_per_buffer <= Channel::max_run);
     // Used to make sure NoteOff events are sent when stopped
     bool _should_run = false;
 
@@ -115,119 +115,181 @@ namespace otto::engines {
    * Declarations
    */
 
-  float OTTOFMSynth::Voice::algos(int alg)
+  namespace {
+    /// One sample of algorithm `Alg`
+    template<int Alg>
+    float algorithm_sample(OTTOFMSynth::OperatorBank& ops) noexcept
+    {
+      static_assert(Alg >= 0 && Alg < 11, "Invalid algorithm");
+      if constexpr (Alg == 0) {
+        return ops(0, ops(1, ops(2, ops(3, 0))));
+      } else if constexpr (Alg == 1) {
+        return ops(0, ops(1, ops(2, 0) + ops(3, 0)));
+      } else if constexpr (Alg == 2) {
+        return ops(0, ops(1, ops(2, 0)) + ops(3, 0));
+      } else if constexpr (Alg == 3) {
+        float aux = ops(3, 0);
+        return ops(0, ops(1, aux) + ops(2, aux));
+      } else if constexpr (Alg == 4) {
+        float aux = ops(2, ops(3, 0));
+        return ops(0, aux) + ops(1, aux);
+      } else if constexpr (Alg == 5) {
+        return ops(0, 0) + ops(1, ops(2, ops(3, 0)));
+      } else if constexpr (Alg == 6) {
+        return ops(0, ops(1, 0) + ops(2, 0) + ops(3, 0));
+      } else if constexpr (Alg == 7) {
+        return ops(0, ops(1, 0)) + ops(2, ops(3, 0));
+      } else if constexpr (Alg == 8) {
+        float aux = ops(3, 0);
+        return ops(0, aux) + ops(1, aux) + ops(2, aux);
+      } else if constexpr (Alg == 9) {
+        return ops(0, 0) + ops(1, 0) + ops(2, ops(3, 0));
+      } else {
+        return ops(0, 0) + ops(1, 0) + ops(2, 0) + ops(3, 0);
+      }
+    }
+  } // namespace
+
+  template<int Alg, int Factor>
+  void OTTOFMSynth::algorithm_kernel(OperatorBank& ops, gsl::span<float> output) noexcept
   {
-    switch (alg) {
-    case 0: return operators[0](operators[1](operators[2](operators[3](0))));
-    case 1: return operators[0](operators[1](operators[2](0) + operators[3](0)));
-    case 2: return operators[0](operators[1](operators[2](0)) + operators[3](0));
-    case 3: {
-      float aux = operators[3](0);
-      return operators[0](operators[1](aux) + operators[2](aux));
+    constexpr int chunk = OperatorBank::chunk_size * Factor;
+    for (int start = 0; start < output.size(); start += chunk) {
+      int n = std::min<int>(chunk, output.size() - start);
+      ops.update_envelopes(n / Factor);
+      for (int i = 0; i < n; i++) {
+        ops.update_amps(i / Factor);
+        output[start + i] = algorithm_sample<Alg>(ops);
+        ops.advance_phases();
+      }
     }
-    case 4: {
-      float aux = operators[2](operators[3](0));
-      return operators[0](aux) + operators[1](aux);
+  }
+
+  namespace {
+    template<int Factor, std::size_t... Alg>
+    constexpr std::array<OTTOFMSynth::AlgorithmKernel, 11> kernels(std::index_sequence<Alg...>)
+    {
+      return {{&OTTOFMSynth::algorithm_kernel<Alg, Factor>...}};
     }
-    case 5: return operators[0](0) + operators[1](operators[2](operators[3](0)));
-    case 6: return operators[0](operators[1](0) + operators[2](0) + operators[3](0));
-    case 7: return operators[0](operators[1](0)) + operators[2](operators[3](0));
-    case 8: {
-      float aux = operators[3](0);
-      return operators[0](aux) + operators[1](aux) + operators[2](aux);
+  } // namespace
+
+  const std::array<std::array<OTTOFMSynth::AlgorithmKernel, 11>, 3> OTTOFMSynth::algorithm_kernels =
+    {{kernels<1>(std::make_index_sequence<11>()), kernels<2>(std::make_index_sequence<11>()),
+      kernels<4>(std::make_index_sequence<11>())}};
+
+  // Operator bank
+
+  void OTTOFMSynth::OperatorBank::set_frequencies(float base) noexcept
+  {
+    for (int i = 0; i < size; i++) {
+      phase_inc[i] = base * ratio_inc[i] + detune_inc[i];
     }
-    case 9: return operators[0](0) + operators[1](0) + operators[2](operators[3](0));
-    case 10: return operators[0](0) + operators[1](0) + operators[2](0) + operators[3](0);
-    default: return 0.f;
+  }
+
+  void OTTOFMSynth::OperatorBank::update_envelopes(int nframes) noexcept
+  {
+    for (int i = 0; i < size; i++) {
+      if (modulator[i]) env[i].process({env_values[i].data(), nframes});
     }
   }
 
-  float OTTOFMSynth::FMOperator::FMSine::operator()(float phsOffset = 0) noexcept
+  void OTTOFMSynth::OperatorBank::update_amps(int frame) noexcept
   {
-    return gam::scl::sinP9(gam::scl::wrap(this->nextPhase() + phsOffset, 1.f, -1.f));
+    for (int i = 0; i < size; i++) {
+      amp[i] = modulator[i] ? env_values[i][frame] * outlevel[i] * fm_amount : outlevel[i];
+    }
   }
 
-  float OTTOFMSynth::FMOperator::operator()(float phaseMod = 0)
+  void OTTOFMSynth::OperatorBank::advance_phases() noexcept
   {
-    if (modulator)
-      return env() * sine(phaseMod) * outlevel * fm_amount;
-    else {
-      previous_value = sine(phaseMod + feedback * previous_value) * outlevel;
-      return previous_value;
+    for (int i = 0; i < size; i++) {
+      phase[i] += phase_inc[i];
+      phase[i] -= 2.f * (phase[i] >= 1.f);
     }
   }
 
-  void OTTOFMSynth::FMOperator::freq(float frq)
+  float OTTOFMSynth::OperatorBank::operator()(int op, float phase_mod) noexcept
   {
-    sine.freq(frq);
+    if (!modulator[op]) phase_mod += feedback[op] * previous_value[op];
+    float res = gam::scl::sinP9(gam::scl::wrap(phase[op] + phase_mod, 1.f, -1.f)) * amp[op];
+    previous_value[op] = res;
+    return res;
   }
 
-  float OTTOFMSynth::FMOperator::level()
+  float OTTOFMSynth::OperatorBank::level(int op) noexcept
   {
-    return env.value() * outlevel;
+    return env[op].value() * outlevel[op];
   }
 
   void OTTOFMSynth::Voice::reset_envelopes()
   {
-    for (int i = 0; i < 4; i++) {
-      operators[i].env.resetSoft();
+    for (auto& env : operators.env) {
+      env.trigger();
     }
   }
 
   void OTTOFMSynth::Voice::release_envelopes()
   {
-    for (int i = 0; i < 4; i++) {
-      operators[i].env.release();
+    for (auto& env : operators.env) {
+      env.release();
     }
   }
 
   // Voice
   float OTTOFMSynth::Voice::operator()() noexcept
   {
-    set_frequencies();
-    return algos(props.algN);
+    float res = 0.f;
+    process_block({&res, 1});
+    return res;
   }
 
-  OTTOFMSynth::Voice::Voice(Pre& pre) noexcept : VoiceBase(pre)
+  void OTTOFMSynth::Voice::process_block(gsl::span<float> output) noexcept
   {
-    for (int i = 0; i < 4; i++) {
-      operators[i].env.finish();
+    if (pre.oversampling != oversampling || pre.algorithm != algorithm_index) {
+      if (pre.oversampling != oversampling) decimator.factor(1 << pre.oversampling);
+      oversampling = pre.oversampling;
+      algorithm_index = pre.algorithm;
+      algorithm = algorithm_kernels[oversampling][algorithm_index];
     }
-    /// Connect appropriate voice properties
-    props.algN.on_change().connect([this](int algo) {
-      // Change modulator flags
-      for (int i = 0; i < 4; i++) {
-        operators[i].modulator = algorithms[algo].modulator_flags[i];
-      }
-    });
-    props.fmAmount.on_change().connect([this](float fm) {
-      // Change modulator flags
-      for (int i = 0; i < 4; i++) {
-        operators[i].fm_amount = fm;
-      }
-    });
+    static_cast<OperatorParams&>(operators) = pre.params;
+    operators.set_frequencies(frequency());
+    if (oversampling == 0) {
+      algorithm(operators, output);
+      return;
+    }
+    // Render at the higher rate a chunk at a time, and decimate
+    const int factor = 1 << oversampling;
+    std::array<float, 256> fast;
+    const int chunk = fast.size() / factor;
+    for (int start = 0; start < output.size(); start += chunk) {
+      int n = std::min<int>(chunk, output.size() - start);
+      algorithm(operators, {fast.data(), n * factor});
+      decimator.process({fast.data(), n * factor}, {output.data() + start, n});
+    }
+  }
 
-    // Connect properties for individual operators
+  OTTOFMSynth::Voice::Voice(Pre& pre) noexcept : VoiceBase(pre)
+  {
+    for (auto& env : operators.env) {
+      env.finish();
+    }
+    // The envelopes are per voice. The other operator properties are followed by the
+    // preprocessor.
     for (int i = 0; i < 4; i++) {
-      props.operators[i].outLev.on_change().connect(
-        [this, i](float level) { operators[i].outlevel = level; });
-      props.operators[i].detune.on_change().connect(
-        [this, i](float detune) { operators[i].detune_amount = detune * 25; });
-      props.operators[i].ratio_idx.on_change().connect(
-        [this, i](int idx) { operators[i].freq_ratio = (float) fractions[idx]; });
       props.operators[i].mAtt.on_change().connect(
-        [this, i](float att) { operators[i].env.attack(3 * att); });
-      props.operators[i].mDecrel.on_change().connect([this, i](float decrel) {
-        operators[i].env.decay(3 * decrel * (1 - props.operators[i].mSuspos));
-        operators[i].env.release(3 * decrel * props.operators[i].mSuspos);
-      });
-      props.operators[i].mSuspos.on_change().connect([this, i](float suspos) {
-        operators[i].env.decay(3 * props.operators[i].mDecrel * (1 - suspos));
-        operators[i].env.release(3 * props.operators[i].mDecrel * suspos);
-        operators[i].env.sustain(suspos);
-      });
-      props.operators[i].feedback.on_change().connect(
-        [this, i](float fb) { operators[i].feedback = fb; });
+        [this, i](float att) { operators.env[i].attack(3 * att); });
+      // Depends on both properties, so a preset changing both recomputes it once
+      auto update_envelope = [this, i] {
+        props::coalesce(&operators.env[i], [this, i] {
+          float decrel = props.operators[i].mDecrel;
+          float suspos = props.operators[i].mSuspos;
+          operators.env[i].decay(3 * decrel * (1 - suspos));
+          operators.env[i].release(3 * decrel * suspos);
+          operators.env[i].sustain(suspos);
+        });
+      };
+      props.operators[i].mDecrel.on_change().connect(update_envelope);
+      props.operators[i].mSuspos.on_change().connect(update_envelope);
     }
   }
 
@@ -242,40 +304,91 @@ namespace otto::engines {
     release_envelopes();
   }
 
-  void OTTOFMSynth::Voice::set_frequencies()
+  // Preprocessor
+  OTTOFMSynth::Pre::Pre(Props& props) noexcept : PreBase(props)
   {
+    props.algN.on_change()
+      .connect([this](int algo) {
+        algorithm = algo;
+        params.modulator = algorithms[algo].modulator_flags;
+      })
+      .call_now(props.algN);
+    props.fmAmount.on_change()
+      .connect([this](float fm) { params.fm_amount = fm; })
+      .call_now(props.fmAmount);
     for (int i = 0; i < 4; i++) {
-      operators[i].freq(frequency() * operators[i].freq_ratio + operators[i].detune_amount);
+      auto& op = props.operators[i];
+      op.outLev.on_change()
+        .connect([this, i](float level) { params.outlevel[i] = level; })
+        .call_now(op.outLev);
+      op.detune.on_change()
+        .connect([this, i](float detune) { detune_hz[i] = detune * 25; })
+        .call_now(op.detune);
+      op.ratio_idx.on_change()
+        .connect([this, i](int idx) { freq_ratio[i] = (float) fractions[idx]; })
+        .call_now(op.ratio_idx);
+      op.feedback.on_change()
+        .connect([this, i](float fb) { params.feedback[i] = fb; })
+        .call_now(op.feedback);
     }
   }
-  // Preprocessor
-  OTTOFMSynth::Pre::Pre(Props& props) noexcept : PreBase(props) {}
 
   void OTTOFMSynth::Pre::operator()() noexcept {}
 
+  void OTTOFMSynth::Pre::process_block(gsl::span<float>) noexcept
+  {
+    const float two_over_sr = 2.f / (gam::sampleRate() * (1 << oversampling));
+    for (int i = 0; i < OperatorParams::size; i++) {
+      params.ratio_inc[i] = freq_ratio[i] * two_over_sr;
+      params.detune_inc[i] = detune_hz[i] * two_over_sr;
+    }
+  }
+
   // Postprocessor
   /// Constructor. Takes care of linking appropriate variables to props
   OTTOFMSynth::Post::Post(Pre& pre) noexcept : PostBase(pre) {}
 
-  float OTTOFMSynth::Post::operator()(float in) noexcept
+  // OTTOFMSynth ////////////////////////////////////////////////////////////////
+
+  void OTTOFMSynth::quality_tier(int tier) noexcept
   {
-    if (pre.last_voice) {
-      for (int i = 0; i < 4; i++) {
-        if (pre.last_voice->operators[i].modulator)
-          props.operators[i].current_level = pre.last_voice->operators[i].level();
-        else
-          props.operators[i].current_level =
-            pre.last_voice->envelope() * pre.last_voice->operators[i].outlevel;
-      }
-    }
-    return in;
+    SynthEngine<OTTOFMSynth>::quality_tier(tier);
+    quality_tier_ = tier;
   }
 
-  // OTTOFMSynth ////////////////////////////////////////////////////////////////
+  void OTTOFMSynth::update_oversampling() noexcept
+  {
+    voice_mgr_.preprocessor().oversampling = quality_tier_ == 0 ? props.oversampling : 0;
+  }
+
+  void OTTOFMSynth::publish_meters() noexcept
+  {
+    Voice* voice = voice_mgr_.preprocessor().last_voice;
+    if (!voice) return;
+    MeterValues values;
+    for (int i = 0; i < 4; i++) {
+      if (voice->operators.modulator[i])
+        values.levels[i] = voice->operators.level(i);
+      else
+        values.levels[i] = voice->envelope() * voice->operators.outlevel[i];
+    }
+    meters.publish(values);
+  }
 
   audio::ProcessData<1> OTTOFMSynth::process(audio::ProcessData<1> data)
   {
-    return voice_mgr_.process(data);
+    update_oversampling();
+    auto out = voice_mgr_.process(data);
+    publish_meters();
+    return out;
+  }
+
+  audio::ProcessData<2> OTTOFMSynth::process_stereo(audio::ProcessData<1> data)
+  {
+    update_oversampling();
+    auto out = voice_mgr_.process_stereo(data);
+    publish_meters();
+    return out;
   }
 
   /*
@@ -290,16 +403,32 @@ namespace otto::engines {
     void draw_envelope(Canvas& ctx);
     bool keypress(Key key) override;
     void encoder(EncoderEvent e) override;
+    bool animating() override;
 
     bool shift = false;
     int cur_op = 0;
+    /// The activity levels of the operators when they were last drawn
+    std::array<float, 4> drawn_levels = {};
 
     using EngineScreen<OTTOFMSynth>::EngineScreen;
   };
 
   OTTOFMSynth::OTTOFMSynth()
-    : SynthEngine<OTTOFMSynth>(std::make_unique<OTTOFMSynthScreen>(this)), voice_mgr_(props)
-  {}
+    : SynthEngine<OTTOFMSynth>(ui::lazy_screen<OTTOFMSynthScreen>(this)), voice_mgr_(props)
+  {
+    // Four operators, possibly oversampled, make the voices heavy enough to split across cores
+    voice_mgr_.enable_parallel_voices();
+  }
+
+  bool OTTOFMSynthScreen::animating()
+  {
+    // The activity levels are published by the audio thread while notes play
+    auto& levels = engine.meters.read().levels;
+    for (int i = 0; i < 4; i++) {
+      if (levels[i] != drawn_levels[i]) return true;
+    }
+    return false;
+  }
 
   bool OTTOFMSynthScreen::keypress(Key key)
   {
@@ -720,7 +849,8 @@ namespace otto::engines {
       }
 
       // Draw activity levels
-      float op_level = engine.props.operators[i].current_level;
+      float op_level = engine.meters.read().levels[i];
+      drawn_levels[i] = op_level;
       ctx.beginPath();
       if (algorithms[engine.props.algN].modulator_flags[i]) {
         ctx.rect(
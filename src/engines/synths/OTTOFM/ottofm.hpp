@@ -6,6 +6,9 @@
 #include <Gamma/Envelope.h>
 #include <Gamma/Oscillator.h>
 
+#include "util/dsp/decimator.hpp"
+#include "util/dsp/envelope.hpp"
+
 namespace otto::engines {
 
   using namespace core;
@@ -16,63 +19,119 @@ namespace otto::engines {
     static constexpr util::string_ref name = "OTTO.FM";
     struct OperatorProps {
       // Envelopes
-      Property<float> feedback = {0, limits(0, 0.4), step_size(0.01)};
-      Property<float> mAtt = {0.2, limits(0, 1), step_size(0.01)};
-      Property<float> mDecrel = {0.5, limits(0, 1), step_size(0.01)};
-      Property<float> mSuspos = {0.5, limits(0, 1), step_size(0.01)};
+      Property<float, audio_thread> feedback = {0, limits(0, 0.4), step_size(0.01)};
+      Property<float, audio_thread> mAtt = {0.2, limits(0, 1), step_size(0.01)};
+      Property<float, audio_thread> mDecrel = {0.5, limits(0, 1), step_size(0.01)};
+      Property<float, audio_thread> mSuspos = {0.5, limits(0, 1), step_size(0.01)};
       // Oscillator
-      Property<float> detune = {0, limits(-1, 1), step_size(0.01)};
-      Property<int> ratio_idx = {0, limits(0, 19), step_size(1)};
+      Property<float, audio_thread> detune = {0, limits(-1, 1), step_size(0.01)};
+      Property<int, audio_thread> ratio_idx = {0, limits(0, 19), step_size(1)};
       // Amp
-      Property<float> outLev = {1, limits(0, 1), step_size(0.01)};
-      float current_level = 0;
+      Property<float, audio_thread> outLev = {1, limits(0, 1), step_size(0.01)};
 
       DECL_REFLECTION(OperatorProps, feedback, mAtt, mDecrel, mSuspos, detune, ratio_idx, outLev);
     };
 
     struct Props {
-      Property<int> algN = {0, limits(0, 10), step_size(1)};
-      Property<float> fmAmount = {1, limits(0, 1), step_size(0.01)};
+      Property<int, audio_thread> algN = {0, limits(0, 10), step_size(1)};
+      Property<float, audio_thread> fmAmount = {1, limits(0, 1), step_size(0.01)};
 
       std::array<OperatorProps, 4> operators;
+      /// The voices are rendered at `2^oversampling` times the samplerate, so the feedback
+      /// does not alias. Only in the best quality tier.
+      Property<int, audio_thread> oversampling = {0, limits(0, 2), step_size(1)};
 
-      DECL_REFLECTION(Props, algN, fmAmount, operators);
+      DECL_REFLECTION(Props, algN, fmAmount, operators, oversampling);
     } props;
 
-    struct FMOperator {
-      // Custom version of the 'Sine' in Gamma. We need to call it with a phase offset
-      // instead of a frequency offset. (Phase modulation, not frequency modulation)
-      struct FMSine : public gam::AccumPhase<> {
-        FMSine(float frq = 440, float phs = 0) : AccumPhase<>(frq, phs, 1) {}
-        /// Generate next sample with phase offset
-        float operator()(float) noexcept;
-      };
-
-      FMOperator(float frq = 440, float outlevel = 1, bool modulator = false) {}
-
-      FMSine sine;
-      gam::ADSR<> env;
+    struct MeterValues {
+      /// The activity level of each operator of the last voice played
+      std::array<float, 4> levels = {};
+    };
 
-      bool modulator = false; /// If it is a modulator, use the envelope.
-      float outlevel = 1;
-      float feedback = 0; /// TODO:Implement in call operator
+    Meters<MeterValues> meters;
+
+    /// The parameters of the four operators that only depend on the props
+    ///
+    /// Computed once per block by the preprocessor, and copied by each voice, instead of each
+    /// voice following the props and converting them itself.
+    struct OperatorParams {
+      static constexpr int size = 4;
+
+      template<typename T>
+      using lanes = std::array<T, size>;
+
+      /// The phase increment per sample of each operator, per Hz of the voice
+      lanes<float> ratio_inc = {};
+      /// The phase increment per sample of the detune of each operator
+      lanes<float> detune_inc = {};
+      lanes<float> outlevel = {1, 1, 1, 1};
+      lanes<float> feedback = {};
+      /// If it is a modulator, use the envelope.
+      lanes<bool> modulator = {};
       float fm_amount = 1;
+    };
 
-      float freq_ratio = 1;
-      float detune_amount = 0;
-
-      float previous_value = 0;
+    /// The four operators of a voice, stored as a structure of arrays
+    ///
+    /// Phases, envelopes and amplitudes of all operators are advanced together in
+    /// contiguous arrays, which lets the compiler vectorise the per-operator work. Only
+    /// the modulation chain itself (see `algorithm_kernel`) is evaluated operator by operator.
+    struct OperatorBank : OperatorParams {
+      /// The envelopes are computed this many frames at a time, ahead of the operators
+      static constexpr int chunk_size = 32;
+
+      /// Phase of each operator, in [-1, 1)
+      lanes<float> phase = {};
+      /// Phase increment per sample
+      lanes<float> phase_inc = {};
+      lanes<float> previous_value = {};
+      /// The amplitude of each operator for the current sample
+      lanes<float> amp = {};
+      lanes<dsp::Envelope> env;
+      /// The envelope values of the modulators for the current chunk
+      lanes<std::array<float, chunk_size>> env_values = {};
+
+      /// Set the operator frequencies from the base frequency of the voice
+      void set_frequencies(float base) noexcept;
+
+      /// Compute the next `nframes` values of the modulator envelopes, up to `chunk_size`
+      void update_envelopes(int nframes) noexcept;
+
+      /// Compute `amp` for frame `frame` of the current chunk
+      void update_amps(int frame) noexcept;
+
+      /// Advance all phases by one sample
+      void advance_phases() noexcept;
+
+      /// Generate the current sample of operator `op`, with phase modulation `phase_mod`
+      float operator()(int op, float phase_mod) noexcept;
+
+      /// Get current level of operator `op`
+      float level(int op) noexcept;
+    };
 
-      float operator()(float);
+    /// An FM algorithm, compiled for a fixed operator topology.
+    ///
+    /// Renders `output.size()` samples of the operator bank.
+    using AlgorithmKernel = void (*)(OperatorBank&, gsl::span<float> output) noexcept;
 
-      void freq(float); /// Set frequency
+    /// The kernel for algorithm `Alg`, rendering at `Factor` times the samplerate
+    ///
+    /// The envelopes still run at the samplerate, and each value is held for `Factor` frames.
+    template<int Alg, int Factor>
+    static void algorithm_kernel(OperatorBank&, gsl::span<float> output) noexcept;
 
-      float level(); /// Get current level
-    };
+    /// The kernels of all algorithms, indexed by `Props::oversampling` and `Props::algN`
+    static const std::array<std::array<AlgorithmKernel, 11>, 3> algorithm_kernels;
 
     OTTOFMSynth();
 
     audio::ProcessData<1> process(audio::ProcessData<1>) override;
+    audio::ProcessData<2> process_stereo(audio::ProcessData<1>) override;
+
+    /// The cheaper tiers also turn oversampling off
+    void quality_tier(int tier) noexcept override;
 
     voices::IVoiceManager& voice_mgr() override
     {
@@ -84,28 +143,51 @@ namespace otto::engines {
   private:
     struct Voice;
 
+    /// Set the oversampling of the voices from the props and the quality tier
+    void update_oversampling() noexcept;
+    /// Publish the operator levels of the last voice to the screen
+    void publish_meters() noexcept;
+
     struct Pre : voices::PreBase<Pre, Props> {
       Pre(Props&) noexcept;
 
       void operator()() noexcept;
+      /// Compute `params` for the block
+      void process_block(gsl::span<float>) noexcept;
 
       Voice* last_voice = nullptr;
+      /// The oversampling of the voices, from the props and the quality tier
+      int oversampling = 0;
+      /// The algorithm of the voices, from `Props::algN`
+      int algorithm = 0;
+      /// The operator parameters of all voices, for the current block
+      OperatorParams params;
+
+    private:
+      /// The frequency ratio and the detune in Hz of each operator
+      OperatorParams::lanes<float> freq_ratio = {1, 1, 1, 1};
+      OperatorParams::lanes<float> detune_hz = {};
     };
 
     struct Voice : voices::VoiceBase<Voice, Pre> {
-      // The workhorse. Implements the FM algorithms.
-      float algos(int);
+      OperatorBank operators;
 
-      std::array<FMOperator, 4> operators;
+      /// The workhorse. Implements the current FM algorithm.
+      ///
+      /// Swapped when `Props::algN` or the oversampling changes.
+      AlgorithmKernel algorithm = algorithm_kernels[0][0];
+      /// The algorithm and oversampling `algorithm` and `decimator` are set up for
+      int algorithm_index = 0;
+      int oversampling = 0;
+      dsp::Decimator decimator;
 
       void reset_envelopes();
       void release_envelopes();
 
-      void set_frequencies();
-
       Voice(Pre&) noexcept;
 
       float operator()() noexcept;
+      void process_block(gsl::span<float> output) noexcept;
       void on_note_on() noexcept;
       void on_note_off() noexcept;
 
@@ -115,10 +197,9 @@ namespace otto::engines {
 
     struct Post : voices::PostBase<Post, Voice> {
       Post(Pre&) noexcept;
-
-      float operator()(float) noexcept;
     };
 
-    voices::VoiceManager<Post, 6> voice_mgr_;
+    voices::VoiceManager<Post> voice_mgr_;
+    std::atomic<int> quality_tier_ = 0;
   };
 } // namespace otto::engines
@@ -1,10 +1,14 @@
 #include "gammasampler.hpp"
 
+#include <array>
+#include <cmath>
+
 #include "core/ui/vector_graphics.hpp"
 
 #include "util/iterator.hpp"
 #include "util/utility.hpp"
 
+#include "services/asset_loader.hpp"
 #include "services/audio_manager.hpp"
 
 namespace otto::engines {
@@ -17,40 +21,39 @@ namespace otto::engines {
     void encoder(EncoderEvent e) override;
 
     using EngineScreen<Sampler>::EngineScreen;
+
+  private:
+    FormattedText<float> volume_text = {"{:1}"};
+    FormattedText<float> filter_text = {"{:2.2}"};
+    FormattedText<float> speed_text = {"{:1.2}"};
   };
 
   struct SamplerEnvelopeScreen : EngineScreen<Sampler> {
     void draw(Canvas& ctx) override;
     void encoder(EncoderEvent e) override;
 
-    AudioFile<float> waveform;
-
     using EngineScreen<Sampler>::EngineScreen;
+
+  private:
+    FormattedText<float> startpoint_text = {"{:1.2}"};
+    FormattedText<float> endpoint_text = {"{:1.2}"};
+    FormattedText<float> fadein_text = {"{:1.2}"};
+    FormattedText<float> fadeout_text = {"{:1.2}"};
   };
 
   Sampler::Sampler()
-    : SynthEngine<Sampler>(std::make_unique<SamplerScreen>(this)),
-      _envelope_screen(std::make_unique<SamplerEnvelopeScreen>(this))
+    : SynthEngine<Sampler>(ui::lazy_screen<SamplerScreen>(this)),
+      _envelope_screen(ui::lazy_screen<SamplerEnvelopeScreen>(this))
   {
-    samplefile.load((Application::current().data_dir / "samples" / "sample.wav").c_str());
-    samplecontainer.source(&samplefile.samples[0][0], samplefile.getNumSamplesPerChannel(), true);
-    sample.buffer(samplecontainer, (double) samplefile.getSampleRate(),
-                  samplefile.getNumChannels());
-    finish();
-    frames = sample.frames();
-
     _lo_filter.type(gam::LOW_PASS);
     _lo_filter.freq(20);
     _hi_filter.type(gam::HIGH_PASS);
     _hi_filter.freq(20000);
 
     // On_change handlers
-    props.startpoint.on_change().connect([this](float pt) { sample.min(pt * frames); });
-    props.endpoint.on_change().connect([this](float pt) { sample.max(pt * frames); });
-    props.fadein.on_change().connect(
-      [this](float fd) { sample.fade((int) fd * 1000, (int) props.fadeout * 1000); });
-    props.fadeout.on_change().connect(
-      [this](float fd) { sample.fade((int) props.fadein * 1000, (int) fd * 1000); });
+    props.file.on_change().connect([this](std::string file) {
+      if (!file.empty()) load_file(file);
+    });
     props.filter.on_change().connect([this](float freq) {
       if (freq > 10) {
         _lo_filter.freq(20000);
@@ -60,51 +63,150 @@ namespace otto::engines {
         _hi_filter.freq(20);
       }
     });
-    props.speed.on_change().connect([this](float spd) { sample.rate(spd); });
+
+    load_file("sample.wav");
+  }
+
+  Sampler::~Sampler()
+  {
+    AssetLoader::current().cancel(&_stream);
   }
 
   void Sampler::restart()
   {
-    sample.reset();
+    auto* stream = _stream.get();
+    if (stream == nullptr) return;
+    // On whole frames, so the sample plays without interpolation at unity speed
+    if (props.speed >= 0) {
+      _position = std::floor(props.startpoint * stream->frames());
+    } else {
+      _position = std::floor(props.endpoint * stream->frames()) - 1;
+    }
+    _playing = true;
   }
 
   void Sampler::finish()
   {
-    sample.finish();
+    _playing = false;
+  }
+
+  void Sampler::quality_tier(int tier) noexcept
+  {
+    SynthEngine<Sampler>::quality_tier(tier);
+    _interpolation = dsp::Interpolation(std::max(int(interpolation) - tier, 0));
   }
 
   float Sampler::operator()() noexcept
   {
-    if (props.loop) sample.loop();
-    return sample();
+    return dsp::dispatch_interpolation(_interpolation, [this](auto ipl) { return next<ipl>(); });
+  }
+
+  template<dsp::Interpolation I>
+  float Sampler::next() noexcept
+  {
+    auto* stream = _stream.get();
+    if (!_playing || stream == nullptr) return 0;
+
+    double start = std::floor(props.startpoint * stream->frames());
+    double end = std::max<double>(start, std::floor(props.endpoint * stream->frames()));
+    double length = end - start;
+    bool forward = props.speed >= 0;
+    if (_position < start || _position >= end) {
+      if (!props.loop || !note_on || length < 1) {
+        _playing = false;
+        return 0;
+      }
+      _position = forward ? start : end - 1;
+    }
+
+    // The sample is at the audio samplerate, so at unity speed the position stays on whole
+    // frames, and is read as is. The frames outside of the region repeat its edges.
+    long frame = _position;
+    float frac = _position - frame;
+    float res = stream->read(frame);
+    if (I != dsp::Interpolation::none && frac != 0) {
+      std::array<float, 4> frames;
+      frames[1] = res;
+      frames[0] = frame > start ? stream->read(frame - 1) : res;
+      frames[2] = frame + 1 < end ? stream->read(frame + 1) : res;
+      frames[3] = frame + 2 < end ? stream->read(frame + 2) : frames[2];
+      res = dsp::interpolate<I>(frames.data() + 1, frac);
+    }
+
+    // The fades are fractions of the region played, in the direction of playback
+    float progress = (forward ? _position - start : end - _position) / length;
+    if (progress < props.fadein) res *= progress / props.fadein;
+    if (1 - progress < props.fadeout) res *= (1 - progress) / props.fadeout;
+
+    _position += props.speed * _rate;
+    return res;
   }
 
-  void Sampler::load_file(fs::path path)
+  void Sampler::load_file(const fs::path& path)
   {
-    samplefile.load((Application::current().data_dir / "samples" / "sample.wav").c_str());
-    samplecontainer.source(&samplefile.samples[0][0], samplefile.getNumSamplesPerChannel());
-    sample.buffer(samplecontainer, (double) samplefile.getSampleRate(),
-                  samplefile.getNumChannels());
+    _file = path;
+    auto full_path = Application::current().data_dir / "samples" / path;
+    auto* cache = &AssetLoader::current().cache();
+    int samplerate = Application::current().audio_manager->samplerate();
+    AssetLoader::current().load(
+      &_stream,
+      [full_path, cache, samplerate] {
+        return std::make_unique<audio::SampleStream>(full_path, cache, samplerate);
+      },
+      [this](std::unique_ptr<audio::SampleStream> stream) { _stream.publish(std::move(stream)); });
   }
 
-  audio::ProcessData<1> Sampler::process(audio::ProcessData<1> data)
+  void Sampler::update_stream(int samplerate) noexcept
   {
-    for (auto& ev : data.midi) {
-      util::match(ev,
-                  [this](midi::NoteOnEvent& ev) {
-                    note_on = true;
-                    restart();
-                  },
-                  [this](midi::NoteOffEvent& ev) {
-                    note_on = false;
-                    if (props.cut) finish();
-                  },
-                  [](auto&&) {});
+    auto* stream = _stream.acquire();
+    if (stream != nullptr) {
+      _rate = stream->samplerate() / double(samplerate);
     }
-    for (auto&& frm : data.audio) {
-      frm = _hi_filter(_lo_filter(sample())) * props.volume;
-      if (props.loop && note_on && sample.done()) restart();
+  }
+
+  void Sampler::samplerate_changed(int samplerate)
+  {
+    if (!_file.empty()) load_file(_file);
+  }
+
+  void Sampler::prefetch() noexcept
+  {
+    auto* stream = _stream.get();
+    if (stream == nullptr) return;
+    // Keep the loader ahead of the next buffer, or at the start of the region while stopped
+    bool forward = props.speed >= 0;
+    if (_playing) {
+      stream->prefetch(_position, forward);
+    } else {
+      auto point = forward ? props.startpoint : props.endpoint;
+      stream->prefetch(point * stream->frames(), forward);
     }
+  }
+
+  audio::ProcessData<1> Sampler::process(audio::ProcessData<1> data)
+  {
+    update_stream(data.context->samplerate);
+    audio::split_by_midi(data,
+                         [this](midi::AnyMidiEvent& ev) {
+                           util::match(ev,
+                                       [this](midi::NoteOnEvent& ev) {
+                                         note_on = true;
+                                         restart();
+                                       },
+                                       [this](midi::NoteOffEvent& ev) {
+                                         note_on = false;
+                                         if (props.cut) finish();
+                                       },
+                                       [](auto&&) {});
+                         },
+                         [this](audio::ProcessData<1> slice) {
+                           dsp::dispatch_interpolation(_interpolation, [&](auto ipl) {
+                             for (auto&& frm : slice.audio) {
+                               frm = _hi_filter(_lo_filter(next<ipl>())) * props.volume;
+                             }
+                           });
+                         });
+    prefetch();
     return data;
   }
 
@@ -164,7 +266,7 @@ namespace otto::engines {
     ctx.beginPath();
     ctx.fillStyle(Colours::Blue);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:1}", engine.props.volume), {width - x_pad, y_pad});
+    ctx.fillText(volume_text(engine.props.volume), {width - x_pad, y_pad});
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Green);
@@ -174,7 +276,7 @@ namespace otto::engines {
     ctx.beginPath();
     ctx.fillStyle(Colours::Green);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:2.2}", engine.props.filter), {width - x_pad, y_pad + space});
+    ctx.fillText(filter_text(engine.props.filter), {width - x_pad, y_pad + space});
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Yellow);
@@ -184,7 +286,7 @@ namespace otto::engines {
     ctx.beginPath();
     ctx.fillStyle(Colours::Yellow);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:1.2}", engine.props.speed), {width - x_pad, y_pad + 2 * space});
+    ctx.fillText(speed_text(engine.props.speed), {width - x_pad, y_pad + 2 * space});
 
     if (props.cut) ctx.fillText("CUT", {100, 170});
     if (props.loop) ctx.fillText("LOOP", {100, 195});
@@ -224,7 +326,7 @@ namespace otto::engines {
     ctx.beginPath();
     ctx.fillStyle(Colours::Blue);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:1.2}", engine.props.startpoint), {width - x_pad, y_pad});
+    ctx.fillText(startpoint_text(engine.props.startpoint), {width - x_pad, y_pad});
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Green);
@@ -234,7 +336,7 @@ namespace otto::engines {
     ctx.beginPath();
     ctx.fillStyle(Colours::Green);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:1.2}", engine.props.endpoint), {width - x_pad, y_pad + space});
+    ctx.fillText(endpoint_text(engine.props.endpoint), {width - x_pad, y_pad + space});
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Yellow);
@@ -244,7 +346,7 @@ namespace otto::engines {
     ctx.beginPath();
     ctx.fillStyle(Colours::Yellow);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:1.2}", engine.props.fadein), {width - x_pad, y_pad + 2 * space});
+    ctx.fillText(fadein_text(engine.props.fadein), {width - x_pad, y_pad + 2 * space});
 
     ctx.beginPath();
     ctx.fillStyle(Colours::Red);
@@ -254,7 +356,7 @@ namespace otto::engines {
     ctx.beginPath();
     ctx.fillStyle(Colours::Red);
     ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
-    ctx.fillText(fmt::format("{:1.2}", engine.props.fadeout), {width - x_pad, y_pad + 3 * space});
+    ctx.fillText(fadeout_text(engine.props.fadeout), {width - x_pad, y_pad + 3 * space});
     /*
     if (engine.sample.size() <= 0) return;
 
@@ -1,12 +1,13 @@
 #pragma once
 
+#include "core/audio/sample_stream.hpp"
 #include "core/engine/engine.hpp"
 
+#include "util/dsp/interpolation.hpp"
+#include "util/handoff.hpp"
 #include "util/iterator.hpp"
 
-#include <AudioFile.h>
 #include <Gamma/Filter.h>
-#include <Gamma/SamplePlayer.h>
 
 namespace otto::engines {
 
@@ -34,14 +35,40 @@ namespace otto::engines {
     } props;
 
     Sampler();
+    ~Sampler();
 
     void restart();
     void finish();
 
+    /// The next frame, with the interpolation of the current quality tier
     float operator()() noexcept;
 
+    static constexpr dsp::Interpolation interpolation = dsp::default_interpolation;
+
+    /// Besides limiting the voices, each tier interpolates the sample one step cheaper than
+    /// the one before, from @ref interpolation down to none
+    int quality_tiers() const noexcept override
+    {
+      return std::max(SynthEngine<Sampler>::quality_tiers(), int(interpolation) + 1);
+    }
+
+    void quality_tier(int tier) noexcept override;
+
+    /// Pick up a newly loaded sample. Call at the start of each buffer when not using
+    /// @ref process.
+    ///
+    /// \param samplerate The samplerate of the buffer, from its @ref audio::AudioContext
+    void update_stream(int samplerate) noexcept;
+
+    /// Tell the sample stream where playback is going. Call at the end of each buffer when not
+    /// using @ref process.
+    void prefetch() noexcept;
+
     audio::ProcessData<1> process(audio::ProcessData<1>) override;
 
+    /// Reload the sample at the new samplerate
+    void samplerate_changed(int samplerate) override;
+
     voices::IVoiceManager& voice_mgr() noexcept override
     {
       return _voice_mgr;
@@ -53,11 +80,31 @@ namespace otto::engines {
     friend struct SamplerScreen;
     friend struct SamplerEnvelopeScreen;
 
-    void load_file(fs::path path);
-    gam::SamplePlayer<> sample;
-    gam::Array<float> samplecontainer;
-    AudioFile<float> samplefile;
-    int frames;
+    /// Open a sample in `data_dir/samples` on the @ref services::AssetLoader, and hand it over
+    /// to the audio thread
+    ///
+    /// The sample is resampled to the audio samplerate. The current sample keeps playing until
+    /// the new one is opened. Logs an error, and keeps the current sample, if the file can not be
+    /// opened.
+    void load_file(const fs::path& path);
+
+    /// The next frame, with the interpolation `I`
+    template<dsp::Interpolation I>
+    float next() noexcept;
+
+    /// The file of the sample, in `data_dir/samples`
+    fs::path _file;
+    /// The sample being played. Streamed from disk, so any length of sample can be played.
+    /// Resampled to the audio samplerate as it is read from the file.
+    util::Handoff<audio::SampleStream> _stream;
+    /// The play position in frames of the sample
+    double _position = 0;
+    /// The samplerate of the sample relative to the audio samplerate. Only differs from 1
+    /// until a sample loaded at a new samplerate is picked up.
+    double _rate = 1;
+    /// Used between whole frames, when pitched
+    dsp::Interpolation _interpolation = interpolation;
+    bool _playing = false;
     bool note_on = false;
 
     gam::Biquad<> _lo_filter;
@@ -75,10 +122,10 @@ namespace otto::engines {
     };
 
     struct Post : voices::PostBase<Post, Voice> {};
-    using VoiceManager = voices::VoiceManager<Post, 6>;
+    using VoiceManager = voices::VoiceManager<Post>;
     VoiceManager _voice_mgr = {props};
 
-    std::unique_ptr<ui::Screen> _envelope_screen;
+    ui::LazyScreen _envelope_screen;
   };
 
 } // namespace otto::engines
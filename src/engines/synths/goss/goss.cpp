@@ -15,47 +15,67 @@ namespace otto::engines {
     void draw(Canvas& ctx) override;
     bool keypress(Key key) override;
     void encoder(EncoderEvent e) override;
-
     using EngineScreen<GossSynth>::EngineScreen;
   };
 
   // GossSynth ////////////////////////////////////////////////////////////////
 
   GossSynth::GossSynth()
-    : SynthEngine<GossSynth>(std::make_unique<GossSynthScreen>(this)), voice_mgr_(props)
+    : SynthEngine<GossSynth>(ui::lazy_screen<GossSynthScreen>(this)), voice_mgr_(props)
   {}
 
+  namespace {
+    struct Tap {
+      /// The distance from the key to the wheel, in semitones
+      int offset;
+      float weight;
+    };
+
+    /// The wheels of each drawbar, relative to the key
+    ///
+    /// The sub-octave, the fifth and the unison are always on.
+    constexpr std::array<Tap, 3> base_taps = {{{-12, 1}, {0, 1}, {7, 1}}};
+    constexpr std::array<Tap, 2> drawbar1_taps = {{{12, 1}, {36, 0.3}}};
+    constexpr std::array<Tap, 5> drawbar2_taps = {{{19, 0.5}, {24, 1}, {28, 0.5}, {31, 1}, {36, 0.5}}};
+    constexpr std::array<Tap, 2> percussion_taps = {{{24, 0.5}, {31, 1}}};
+  } // namespace
+
   float GossSynth::Voice::operator()() noexcept
   {
-    float fundamental = frequency() * (1 + 0.015 * props.leslie * pre.pitch_modulation_hi.cos()) * 0.5;
-    pipes[0].freq(fundamental);
-    pipes[1].freq(fundamental);
-    pipes[2].freq(fundamental);
-    percussion.freq(frequency());
-    return pipes[0]() + pipes[1]() * props.drawbar1 + pipes[2]() * props.drawbar2 + percussion() * perc_env();
+    float res = 0.f;
+    process_block({&res, 1});
+    return res;
   }
 
-  GossSynth::Voice::Voice(Pre& pre) noexcept : VoiceBase(pre) {
-    pipes[0].resize(1024);
-    pipes[0].addSine(1, 1, 0);
-    pipes[0].addSine(3, 1, 0);
-    pipes[0].addSine(2, 1, 0);
-
-    pipes[1].resize(1024);
-    pipes[1].addSine(4, 1, 0);
-    pipes[1].addSine(16, 0.3, 0);
-
-    pipes[2].resize(1024);
-    pipes[2].addSine(6, 0.5, 0);
-    pipes[2].addSine(8, 1, 0);
-    pipes[2].addSine(10, 0.5, 0);
-    pipes[2].addSine(12, 1, 0);
-    pipes[2].addSine(16, 0.5, 0);
-
-    percussion.resize(1024);
-    percussion.addSine(4, 0.5, 0);
-    percussion.addSine(6, 1.0, 0);
+  void GossSynth::Voice::process_block(gsl::span<float> output) noexcept
+  {
+    using Bank = dsp::TonewheelBank;
+    int key = Bank::wheel_for(frequency());
+    struct Wheel {
+      int index;
+      float weight;
+    };
+    std::array<Wheel, base_taps.size() + drawbar1_taps.size() + drawbar2_taps.size()> wheels;
+    auto out = wheels.begin();
+    for (auto& tap : base_taps) *out++ = {Bank::fold(key + tap.offset), tap.weight};
+    for (auto& tap : drawbar1_taps) *out++ = {Bank::fold(key + tap.offset), tap.weight * props.drawbar1};
+    for (auto& tap : drawbar2_taps) *out++ = {Bank::fold(key + tap.offset), tap.weight * props.drawbar2};
+    std::array<Wheel, percussion_taps.size()> perc;
+    for (int i = 0; i < perc.size(); i++) {
+      perc[i] = {Bank::fold(key + percussion_taps[i].offset), percussion_taps[i].weight};
+    }
 
+    for (int f = 0; f < output.size(); f++) {
+      const float* frame = pre.tonewheels.frame(f);
+      float sum = 0;
+      for (auto& w : wheels) sum += frame[w.index] * w.weight;
+      float click = 0;
+      for (auto& w : perc) click += frame[w.index] * w.weight;
+      output[f] = sum + click * perc_env();
+    }
+  }
+
+  GossSynth::Voice::Voice(Pre& pre) noexcept : VoiceBase(pre) {
     perc_env.decay(0.5);
     perc_env.finish();
   }
@@ -66,48 +86,32 @@ namespace otto::engines {
 
   GossSynth::Pre::Pre(Props& props) noexcept : PreBase(props)
   {
-    leslie_filter_hi.phase(0.5);
-    leslie_filter_lo.phase(0.5);
-    props.leslie.on_change().connect([this](float leslie) {
-      leslie_speed_lo = leslie * 10;
-      leslie_speed_hi = leslie * 3;
-      leslie_filter_hi.freq(leslie_speed_hi);
-      leslie_filter_lo.freq(leslie_speed_lo);
-      leslie_amount_hi = leslie * 0.3;
-      leslie_amount_lo = leslie * 0.5;
-      pitch_modulation_lo.freq(leslie_speed_hi);
-      pitch_modulation_hi.freq(leslie);
-      rotation.freq(leslie_speed_hi/4.f);
-    }).call_now(props.leslie);
+    tonewheels.reserve(Application::current().audio_manager->buffer_size());
   }
 
-  void GossSynth::Pre::operator()() noexcept {
-    props.rotation_value = rotation.nextPhase();
-  }
-
-  /// Constructor. Takes care of linking appropriate variables to props
-  GossSynth::Post::Post(Pre& pre) noexcept : PostBase(pre)
+  void GossSynth::Pre::operator()() noexcept
   {
-    lpf.type(gam::LOW_PASS);
-    lpf.freq(1800);
-    lpf.res(1);
-    hpf.type(gam::HIGH_PASS);
-    hpf.freq(1800);
-    hpf.res(1);
+    float frame = 0.f;
+    process_block({&frame, 1});
   }
 
-  float GossSynth::Post::operator()(float in) noexcept
+  void GossSynth::Pre::process_block(gsl::span<float> output) noexcept
   {
-    float s_lo = lpf(in) * (1 + pre.leslie_amount_lo * pre.leslie_filter_lo.cos());
-    float s_hi = hpf(in) * (1 + pre.leslie_amount_hi * pre.leslie_filter_hi.cos());
-    return s_lo + s_hi;
+    tonewheels.render(output.size());
   }
 
+  GossSynth::Post::Post(Pre& pre) noexcept : PostBase(pre) {}
+
   audio::ProcessData<1> GossSynth::process(audio::ProcessData<1> data)
   {
     return voice_mgr_.process(data);
   }
 
+  audio::ProcessData<2> GossSynth::process_stereo(audio::ProcessData<1> data)
+  {
+    return voice_mgr_.process_stereo(data);
+  }
+
   /*
    * GossSynthScreen
    */
@@ -123,7 +127,7 @@ namespace otto::engines {
     case Encoder::blue: engine.props.drawbar1.step(e.steps); break;
     case Encoder::green: engine.props.drawbar2.step(e.steps); break;
     case Encoder::yellow: engine.props.click.step(e.steps); break;
-    case Encoder::red: engine.props.leslie.step(e.steps); break;
+    default: break;
     }
   }
 
@@ -179,21 +183,5 @@ namespace otto::engines {
       ctx.strokeStyle(Colours::Blue);
       ctx.stroke();
     });
-
-    // middle red ring
-    ctx.group([&] {
-      // Ring Base
-      ctx.beginPath();
-      ctx.lineWidth(6.0);
-      ctx.strokeStyle(Colours::Red);
-
-      ctx.rotateAround(engine.props.rotation_value, {160, 120});
-      ctx.circle({160, height/2 + engine.props.leslie*25}, 12.5);
-      ctx.stroke();
-
-      ctx.circle({160, height / 2 + engine.props.leslie * 25}, 12.5);
-      ctx.stroke();
-    });
-    ///
   }
 } // namespace otto::engines
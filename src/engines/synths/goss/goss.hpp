@@ -4,9 +4,9 @@
 
 #include "core/voices/voice_manager.hpp"
 
-#include <Gamma/Filter.h>
-#include <Gamma/Oscillator.h>
+#include <Gamma/Envelope.h>
 
+#include "util/dsp/tonewheel.hpp"
 #include "util/reflection.hpp"
 
 namespace otto::engines {
@@ -22,16 +22,14 @@ namespace otto::engines {
       Property<float> drawbar1 = {1, limits(0, 1), step_size(0.01)};
       Property<float> drawbar2 = {0.5, limits(0, 1), step_size(0.01)};
       Property<float> click = {0.5, limits(0, 1), step_size(0.01)};
-      Property<float> leslie = {0.3, limits(0, 1), step_size(0.01)};
 
-      float rotation_value;
-
-      DECL_REFLECTION(Props, drawbar1, drawbar2, click, leslie);
+      DECL_REFLECTION(Props, drawbar1, drawbar2, click);
     } props;
 
     GossSynth();
 
     audio::ProcessData<1> process(audio::ProcessData<1>) override;
+    audio::ProcessData<2> process_stereo(audio::ProcessData<1>) override;
 
     voices::IVoiceManager& voice_mgr() override
     {
@@ -42,45 +40,33 @@ namespace otto::engines {
 
   private:
     struct Pre : voices::PreBase<Pre, Props> {
-      float leslie_speed_hi = 0.f;
-      float leslie_speed_lo = 0.f;
-      float leslie_amount_hi = 0.f;
-      float leslie_amount_lo = 0.f;
-
-      gam::LFO<> leslie_filter_hi;
-      gam::LFO<> leslie_filter_lo;
-      gam::LFO<> pitch_modulation_lo;
-      gam::LFO<> pitch_modulation_hi;
-
-      gam::AccumPhase<> rotation;
+      /// The wheels played by all voices
+      dsp::TonewheelBank tonewheels;
 
       Pre(Props&) noexcept;
 
       void operator()() noexcept;
+      /// Render the tonewheels for the block
+      void process_block(gsl::span<float>) noexcept;
     };
 
     struct Voice : voices::VoiceBase<Voice, Pre> {
-      std::array<gam::Osc<>, 4> pipes;
-      gam::Osc<> percussion;
       gam::Decay<> perc_env;
 
       Voice(Pre&) noexcept;
 
       float operator()() noexcept;
+      /// Mix the drawbar-weighted taps of the tonewheels
+      void process_block(gsl::span<float>) noexcept;
 
       void on_note_on() noexcept;
     };
 
     struct Post : voices::PostBase<Post, Voice> {
-      gam::Biquad<> lpf;
-      gam::Biquad<> hpf;
-
       Post(Pre&) noexcept;
-
-      float operator()(float) noexcept;
     };
 
-    voices::VoiceManager<Post, 6> voice_mgr_;
+    voices::VoiceManager<Post> voice_mgr_;
   };
 
 } // namespace otto::engines
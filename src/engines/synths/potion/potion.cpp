@@ -1,8 +1,12 @@
 #include "potion.hpp"
 #include "services/application.hpp"
+#include "services/asset_loader.hpp"
 #include "services/ui_manager.hpp"
 #include <iterator>
 
+// WAV parser by Adam Stark: https://github.com/adamstark/AudioFile
+#include <AudioFile.h>
+
 #include "core/ui/vector_graphics.hpp"
 
 namespace otto::engines {
@@ -29,8 +33,12 @@ namespace otto::engines {
 
     bool keypress(Key key) override;
     void encoder(EncoderEvent e) override;
+    bool animating() override;
 
     int cur_wave = 0;
+    /// The pan positions of the lfo and the curve when they were last drawn
+    float drawn_lfo_pan = 0;
+    float drawn_curve_pan = 0;
 
     using EngineScreen<PotionSynth>::EngineScreen;
   };
@@ -38,8 +46,13 @@ namespace otto::engines {
   // PotionSynth ////////////////////////////////////////////////////////////////
 
   PotionSynth::PotionSynth()
-    : SynthEngine<PotionSynth>(std::make_unique<PotionSynthScreen>(this)), voice_mgr_(props)
+    : SynthEngine<PotionSynth>(ui::lazy_screen<PotionSynthScreen>(this)), voice_mgr_(props)
   {
+    _silence.samples[1] = _silence.samples[0];
+    for (int i = 0; i < 4; i++) props.wavetables[i] = _silence.samples[0];
+    for (int osc = 0; osc < 2; osc++) use_morph(osc, _silence);
+    quality_tier(0);
+
     /// Load filenames into vector
     std::string path = Application::current().data_dir / "wavetables";
     for (const auto& entry : filesystem::directory_iterator(path)) {
@@ -90,39 +103,78 @@ namespace otto::engines {
     props.curve_osc.wave2.file.set(props.filenames[3]);
   }
 
+  PotionSynth::~PotionSynth()
+  {
+    for (auto& morph : _morphs) AssetLoader::current().cancel(&morph);
+  }
+
+  PotionSynth::WaveProps& PotionSynth::wave_props(int wt_number) noexcept
+  {
+    switch (wt_number) {
+    case 0: return props.lfo_osc.wave1;
+    case 1: return props.lfo_osc.wave2;
+    case 2: return props.curve_osc.wave1;
+    default: return props.curve_osc.wave2;
+    }
+  }
+
   void PotionSynth::load_wavetable(int wt_number, std::string filename)
   {
-    AudioFile<float> aux;
-    bool loaded = aux.load(Application::current().data_dir / "wavetables" / filename);
-    int num_samples = 1;
-    if (loaded) {
-      props.wavetables[wt_number].resize(aux.getNumSamplesPerChannel());
-      props.samplerates[wt_number] = aux.getSampleRate();
-      util::copy(aux.samples[0], props.wavetables[wt_number].elems());
-      num_samples = aux.getNumSamplesPerChannel();
-    } else {
-      props.wavetables[wt_number].resize(1);
-      props.samplerates[wt_number] = 1;
-      props.wavetables[wt_number][0] = 0;
+    int osc = wt_number / 2;
+    std::array<std::string, 2> files = {wave_props(2 * osc).file, wave_props(2 * osc + 1).file};
+    files[wt_number % 2] = std::move(filename);
+    auto dir = Application::current().data_dir / "wavetables";
+    auto* cache = &AssetLoader::current().cache();
+    AssetLoader::current().load(
+      &_morphs[osc],
+      [dir, files, cache, silence = _silence.samples[0]] {
+        auto morph = std::make_unique<Morph>();
+        std::array<dsp::MipMappedWavetable, 2> tables;
+        for (int i = 0; i < 2; i++) {
+          // The other wavetable of a new oscillator may not be chosen yet
+          if (files[i].empty()) {
+            morph->samples[i] = silence;
+            continue;
+          }
+          auto path = dir / files[i];
+          morph->samples[i] = cache->get(path, "wavetable", [&] {
+            AudioFile<float> file;
+            if (!file.load(path.string()) || file.getNumSamplesPerChannel() == 0) {
+              throw AssetLoader::exception(AssetLoader::ErrorCode::load_failed,
+                                           "Could not load wavetable {}", path.string());
+            }
+            return std::move(file.samples[0]);
+          });
+          auto levels = cache->get(path, "wavetable_levels",
+                                   [&] { return dsp::MipMappedWavetable::build(*morph->samples[i]); });
+          tables[i] = dsp::MipMappedWavetable(std::move(levels));
+        }
+        morph->table = dsp::MorphWavetable::build(tables[0], tables[1], morph_frames);
+        return morph;
+      },
+      [this, osc](std::unique_ptr<Morph> morph) {
+        props.wavetables[2 * osc] = morph->samples[0];
+        props.wavetables[2 * osc + 1] = morph->samples[1];
+        _morphs[osc].publish(std::move(morph));
+      });
+  }
+
+  void PotionSynth::use_morph(int osc, Morph& morph)
+  {
+    for (auto&& v : voice_mgr_.voices()) {
+      (osc == 0 ? v.lfo_osc : v.curve_osc).osc.table(morph.table);
     }
+  }
+
+  void PotionSynth::quality_tier(int tier) noexcept
+  {
+    SynthEngine<PotionSynth>::quality_tier(tier);
+    auto mode = dsp::Interpolation(std::max(int(interpolation) - tier, 0));
+    if (mode == _interpolation) return;
+    _interpolation = mode;
     for (auto&& v : voice_mgr_.voices()) {
-      switch (wt_number) {
-      case 0:
-        v.lfo_osc.waves[0].buffer(props.wavetables[0], num_samples, 1);
-        break;
-      case 1:
-        v.lfo_osc.waves[1].buffer(props.wavetables[1], num_samples, 1);
-        break;
-      case 2:
-        v.curve_osc.waves[0].buffer(props.wavetables[2], num_samples, 1);
-        break;
-      case 3:
-        v.curve_osc.waves[1].buffer(props.wavetables[3], num_samples, 1);
-        break;
-      default: break;
-      }
+      for (auto* player : {&v.lfo_osc, &v.curve_osc}) player->osc.interpolation(mode);
     }
-    DLOGI("arraysize: {}", props.wavetables[wt_number].size());
   }
 
   PotionSynth::Pre::Pre(Props& props) noexcept : PreBase(props) {}
@@ -131,22 +183,52 @@ namespace otto::engines {
 
   PotionSynth::Post::Post(Pre& pre) noexcept : PostBase(pre) {}
 
-  float PotionSynth::Post::operator()(float in) noexcept
+  void PotionSynth::Post::update_display() noexcept
   {
     if (pre.last_voice) {
       props.lfo_osc.pan_position = pre.last_voice->lfo_pan;
       props.curve_osc.pan_position = pre.last_voice->curve.value() + 1;
     }
+  }
+
+  float PotionSynth::Post::operator()(float in) noexcept
+  {
+    update_display();
     return in;
   }
 
+  void PotionSynth::Post::process_block(gsl::span<float>, gsl::span<float>) noexcept
+  {
+    update_display();
+  }
+
+  void PotionSynth::acquire_wavetables()
+  {
+    for (int osc = 0; osc < 2; osc++) {
+      auto* morph = _morphs[osc].acquire();
+      if (morph != nullptr && morph != _playing[osc]) {
+        _playing[osc] = morph;
+        use_morph(osc, *morph);
+      }
+    }
+  }
+
   audio::ProcessData<1> PotionSynth::process(audio::ProcessData<1> data)
   {
+    acquire_wavetables();
     return voice_mgr_.process(data);
   }
 
+  audio::ProcessData<2> PotionSynth::process_stereo(audio::ProcessData<1> data)
+  {
+    acquire_wavetables();
+    return voice_mgr_.process_stereo(data);
+  }
+
   PotionSynth::Voice::Voice(Pre& pre) noexcept : VoiceBase(pre)
   {
+    lfo.domain(dsp::control_domain());
+    curve.domain(dsp::control_domain());
     /// On_change handlers for the lfo and curve/envelope
     props.lfo_osc.lfo_speed.on_change().connect([this](float speed) { lfo.freq(speed * 3); });
     props.curve_osc.curve_length.on_change().connect(
@@ -164,27 +246,42 @@ namespace otto::engines {
   {
     lfo.phase(0.f);
     curve.reset(-2);
+    lfo_kr.reset(lfo.tri());
+    curve_kr.reset(curve());
+    morph_countdown = 0;
     pre.last_voice = this;
   }
 
   float PotionSynth::Voice::operator()() noexcept
   {
-    for (int osc = 0; osc < 2; osc++) {
-      lfo_osc.waves[osc].freq(frequency());
-      curve_osc.waves[osc].freq(frequency());
-    }
+    lfo_osc.osc.freq(frequency());
+    curve_osc.osc.freq(frequency());
     /// Set panning positions
-    lfo_pan = lfo.tri();
-    lfo_osc.pan.pos(lfo_pan);
-    curve_osc.pan.pos(curve() + 1);
+    lfo_pan = lfo_kr([this] { return lfo.tri(); });
+    float curve_pan = curve_kr([this] { return curve(); }) + 1;
+    // The morphs ramp over a control period themselves
+    if (morph_countdown-- == 0) {
+      morph_countdown = dsp::control_period - 1;
+      lfo_osc.pan_to(lfo_pan);
+      curve_osc.pan_to(curve_pan);
+    }
     /// Get next sample from wavetables
     float result = lfo_osc() + curve_osc();
     return result;
   }
 
+  void PotionSynth::DualWavePlayer::pan_to(float position) noexcept
+  {
+    pan.pos(position);
+    // The pan weighs the tables, which is the morph between them times the sum of the weights.
+    // With differing volumes, a weight may be negative, which the morph extrapolates.
+    float gain = pan.weight1() + pan.weight2();
+    osc.morph(gain != 0 ? pan.weight2() / gain : 0, gain, dsp::control_period);
+  }
+
   float PotionSynth::DualWavePlayer::operator()() noexcept
   {
-    return pan(waves[0](), waves[1]());
+    return osc();
   }
 
   /*
@@ -293,6 +390,13 @@ namespace otto::engines {
 
   using namespace ui::vg;
 
+  bool PotionSynthScreen::animating()
+  {
+    // The pan positions are written by the audio thread while notes play
+    return engine.props.lfo_osc.pan_position != drawn_lfo_pan ||
+           engine.props.curve_osc.pan_position != drawn_curve_pan;
+  }
+
   void PotionSynthScreen::draw(Canvas& ctx)
   {
     using namespace ui::vg;
@@ -325,6 +429,8 @@ namespace otto::engines {
     ctx.arc(center_x - dist - sq_size/2, center_y, dist, -M_PI_2, M_PI_2, true);
     ctx.stroke(Colours::White);
 
+    drawn_lfo_pan = engine.props.lfo_osc.pan_position;
+    drawn_curve_pan = engine.props.curve_osc.pan_position;
     float rotation = - engine.props.lfo_osc.pan_position * M_PI_2;
 
     ctx.save();
@@ -410,8 +516,9 @@ namespace otto::engines {
 
     ctx.beginPath();
     ctx.moveTo(start.x, start.y);
-    float * val = engine.props.wavetables[wt].begin();
-    int step = engine.props.wavetables[wt].size() / steps;
+    auto& wavetable = *engine.props.wavetables[wt];
+    const float * val = wavetable.data();
+    int step = wavetable.size() / steps;
     //Draw only some of the values. Number of samples must be smaller
     //than number of steps.
     for (int i = 0; i < steps - 1; i++) {
@@ -420,7 +527,7 @@ namespace otto::engines {
       ctx.lineTo(start.x, start.y - (*val) * scale.h);
     }
     start.x += scale.w;
-    val = engine.props.wavetables[wt].end() - 1;
+    val = wavetable.data() + wavetable.size() - 1;
     ctx.lineTo(start.x, start.y - (*val) * scale.h);
     ctx.stroke(cl);
   }
@@ -4,19 +4,17 @@
 
 #include "core/voices/voice_manager.hpp"
 
-#include <AudioFile.h>
 #include <Gamma/Effects.h>
 #include <Gamma/Envelope.h>
 #include <Gamma/Oscillator.h>
 #include <Gamma/SoundFile.h>
 
+#include "util/dsp/control_rate.hpp"
 #include "util/dsp/pan.hpp"
-
-// WAV parser by Adam Stark: https://github.com/adamstark/AudioFile
-#include <AudioFile.h>
-#include <Gamma/SamplePlayer.h>
+#include "util/dsp/wavetable.hpp"
 
 #include "util/filesystem.hpp"
+#include "util/handoff.hpp"
 
 namespace otto::engines {
 
@@ -56,8 +54,8 @@ namespace otto::engines {
       CurveOscProps curve_osc;
       LFOOscProps lfo_osc;
 
-      std::array<gam::Array<float>, 4> wavetables;
-      std::array<float, 4> samplerates;
+      /// The loaded wavetables, for the screen
+      std::array<std::shared_ptr<const std::vector<float>>, 4> wavetables;
       std::vector<std::string> filenames;
       std::array<std::vector<std::string>::iterator, 4> file_it = {
         {filenames.begin(), filenames.begin(), filenames.begin(), filenames.begin()}};
@@ -66,27 +64,74 @@ namespace otto::engines {
     } props;
 
     PotionSynth();
+    ~PotionSynth();
 
     audio::ProcessData<1> process(audio::ProcessData<1>) override;
+    audio::ProcessData<2> process_stereo(audio::ProcessData<1>) override;
+
+    static constexpr dsp::Interpolation interpolation = dsp::default_interpolation;
+
+    /// Besides limiting the voices, each tier interpolates the wavetables one step cheaper than
+    /// the one before, from @ref interpolation down to none
+    int quality_tiers() const noexcept override
+    {
+      return std::max(SynthEngine<PotionSynth>::quality_tiers(), int(interpolation) + 1);
+    }
+
+    void quality_tier(int tier) noexcept override;
 
     voices::IVoiceManager& voice_mgr() override
     {
       return voice_mgr_;
     }
 
+    /// The number of frames of the morph between two wavetables. The morph is a linear
+    /// crossfade, which the two tables themselves are enough for, see @ref dsp::MorphWavetable.
+    static constexpr int morph_frames = 2;
+
     struct DualWavePlayer {
-      /// These should be external wavetables (in Pre)
-      std::array<gam::SamplePlayer<float, gam::ipl::Linear, gam::phsInc::Loop>, 2> waves;
+      /// Plays the morph between the two band-limited tables of the engine, shared by all voices
+      dsp::MorphWavetableOsc osc;
+      /// The weights of the two tables, from the pan position and their volumes
       PanSM pan;
 
-      /// Call operator takes play position and pan value
+      /// Set the pan position, and ramp the morph to it over a control period
+      void pan_to(float position) noexcept;
       float operator()() noexcept;
     };
 
     DECL_REFLECTION(PotionSynth, props, ("voice_manager", &PotionSynth::voice_mgr_));
 
   private:
-    void load_wavetable(int, std::string);
+    /// The two wavetables of an oscillator, and the morph between them
+    struct Morph {
+      /// The samples of the files. Shared with the @ref core::audio::SampleCache and the screen
+      std::array<std::shared_ptr<const std::vector<float>>, 2> samples;
+      /// The frames of the morph between their band-limited levels
+      dsp::MorphWavetable table;
+    };
+
+    /// The properties of wavetable `wt_number`, as numbered in `Props::wavetables`
+    WaveProps& wave_props(int wt_number) noexcept;
+    /// Load a wavetable on the @ref services::AssetLoader, and hand the morph of its oscillator
+    /// over to the audio thread
+    ///
+    /// The morph is built on the loader thread, from the levels of both wavetables of the
+    /// oscillator, which are cached. The current morph keeps playing until the new one is built.
+    void load_wavetable(int wt_number, std::string filename);
+    /// Point the oscillators of all voices to a morph. Called from the audio thread.
+    void use_morph(int osc, Morph&);
+    /// Switch to the morphs built since the last buffer. Called from the audio thread.
+    void acquire_wavetables();
+
+    /// The morphs of the lfo and the curve oscillator
+    std::array<util::Handoff<Morph>, 2> _morphs;
+    /// The morphs the voices are playing. Owned by `_morphs`, or `_silence`.
+    std::array<Morph*, 2> _playing = {};
+    /// Played until the first wavetables are loaded
+    Morph _silence = {{std::make_shared<const std::vector<float>>(1, 0.f), nullptr}, {}};
+    /// The interpolation of the oscillators of all voices
+    dsp::Interpolation _interpolation = dsp::Interpolation::linear;
 
     struct Voice;
 
@@ -98,12 +143,17 @@ namespace otto::engines {
     };
 
     struct Voice : voices::VoiceBase<Voice, Pre> {
+      /// The pan modulators, in the control domain
       gam::LFO<> lfo;
       gam::Decay<> curve;
+      dsp::ControlRate<> lfo_kr;
+      dsp::ControlRate<> curve_kr;
 
       DualWavePlayer curve_osc;
       DualWavePlayer lfo_osc;
       float lfo_pan;
+      /// The frames until the morphs are next updated
+      int morph_countdown = 0;
 
       Voice(Pre&) noexcept;
       float operator()() noexcept;
@@ -114,9 +164,14 @@ namespace otto::engines {
       Post(Pre&) noexcept;
 
       float operator()(float) noexcept;
+      void process_block(gsl::span<float> left, gsl::span<float> right) noexcept;
+
+    private:
+      /// Show the pan of the last voice on the screen
+      void update_display() noexcept;
     };
 
-    voices::VoiceManager<Post, 6> voice_mgr_;
+    voices::VoiceManager<Post> voice_mgr_;
     friend struct PotionSynthScreen;
   };
 } // namespace otto::engines
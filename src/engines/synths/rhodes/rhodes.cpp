@@ -22,41 +22,27 @@ namespace otto::engines {
   // RhodesSynth ////////////////////////////////////////////////////////////////
 
   RhodesSynth::RhodesSynth()
-    : SynthEngine<RhodesSynth>(std::make_unique<RhodesSynthScreen>(this)), voice_mgr_(props)
+    : SynthEngine<RhodesSynth>(ui::lazy_screen<RhodesSynthScreen>(this)), voice_mgr_(props)
   {}
 
   //Voice
   float RhodesSynth::Voice::operator()() noexcept
   {
-    reson.freq(frequency());
-    overtones.freq(frequency());
-    float excitation = lpf(exciter() * (1 + noise()));
-    float harmonics = env() * overtones();
-    float orig_note = reson(excitation*hammer_strength);
-    float aux = util::math::fasttanh3(0.3f*orig_note + props.asymmetry);
-    return amp * pickup_hpf(powf(2, 10*aux)) + harmonics;
+    float res = 0.f;
+    process_block({&res, 1});
+    return res;
   }
 
-  RhodesSynth::Voice::Voice(Pre& pre) noexcept : VoiceBase(pre) {
-    reson.type(gam::RESONANT);
-    reson.res(1500);
-    reson.zero();
-
-    exciter.attack(0.001);
-    exciter.decay(1.f/frequency());
-    exciter.curve(0);
-    exciter.finish();
-
-    noise.seed(123);
-
-    lpf.type(gam::LOW_PASS);
-    lpf.freq(powf(20,2));
-    lpf.zero();
-
-    pickup_hpf.type(gam::HIGH_PASS);
-    pickup_hpf.freq(440.f);
-    pickup_hpf.zero();
+  void RhodesSynth::Voice::process_block(gsl::span<float> output) noexcept
+  {
+    pre.play(channel, frequency());
+    overtones.freq(frequency());
+    for (int f = 0; f < output.size(); f++) {
+      output[f] = amp * pre.output(channel, f) + env() * overtones();
+    }
+  }
 
+  RhodesSynth::Voice::Voice(Pre& pre) noexcept : VoiceBase(pre), channel(pre.add_voice()) {
     overtones.resize(1024);
     overtones.addSine(7, 1, 0);
     overtones.addSine(20, 0.5, 0);
@@ -65,36 +51,103 @@ namespace otto::engines {
   }
 
   void RhodesSynth::Voice::on_note_on() noexcept {
-    reson.zero();
+    pre.strike(channel, frequency(), velocity());
+    env.reset(1.7);
+  }
 
-    exciter.decay(1.f/frequency());
-    exciter.reset();
+  //Preprocessor
+  RhodesSynth::Pre::Pre(Props& props) noexcept : PreBase(props)
+  {
+    for (int c = 0; c < voice_count; c++) {
+      exciter[c].attack(0.001);
+      exciter[c].decay(1.f / 440.f);
+      exciter[c].curve(0);
+      exciter[c].finish();
+      noise[c].seed(123);
+      hammer_strength[c] = 2;
+      _frequency[c] = 0;
+      _used[c] = false;
+      lpf.coefficients(c, dsp::BiquadCoefficients::low_pass(powf(20, 2)));
+      pickup_hpf.coefficients(c, dsp::BiquadCoefficients::high_pass(440.f));
+      tune(c, 440.f);
+    }
+    _out.resize(Application::current().audio_manager->buffer_size() * voice_count);
+  }
+
+  void RhodesSynth::Pre::strike(int c, float frequency, float velocity) noexcept
+  {
+    // Redesign the resonator even at the same frequency, in case the samplerate changed
+    _frequency[c] = 0;
+    tune(c, frequency);
+    reson.zero(c);
 
-    hammer_strength = powf(2.f, (1.f + 3.0f * props.aggro * velocity()));
+    exciter[c].decay(1.f / frequency);
+    exciter[c].reset();
 
-    noise.seed(123);
+    hammer_strength[c] = powf(2.f, (1.f + 3.0f * props.aggro * velocity));
 
-    lpf.freq(powf(velocity()*90*props.aggro + 20,2));
-    lpf.zero();
+    noise[c].seed(123);
 
-    pickup_hpf.freq(frequency());
-    pickup_hpf.zero();
+    lpf.coefficients(c, dsp::BiquadCoefficients::low_pass(powf(velocity * 90 * props.aggro + 20, 2)));
+    lpf.zero(c);
 
-    env.reset(1.7);
+    pickup_hpf.coefficients(c, dsp::BiquadCoefficients::high_pass(frequency));
+    pickup_hpf.zero(c);
+
+    _used[c] = true;
   }
 
-  //Preprocessor
-  RhodesSynth::Pre::Pre(Props& props) noexcept : PreBase(props)
+  void RhodesSynth::Pre::play(int c, float frequency) noexcept
   {
+    tune(c, frequency);
+    _used[c] = true;
+  }
 
+  void RhodesSynth::Pre::tune(int c, float frequency) noexcept
+  {
+    if (frequency == _frequency[c]) return;
+    _frequency[c] = frequency;
+    reson.coefficients(c, dsp::BiquadCoefficients::resonant(frequency, 1500));
   }
 
-  void RhodesSynth::Pre::operator()() noexcept {}
+  void RhodesSynth::Pre::operator()() noexcept
+  {
+    float frame = 0.f;
+    process_block({&frame, 1});
+  }
+
+  void RhodesSynth::Pre::process_block(gsl::span<float> output) noexcept
+  {
+    for (int c = 0; c < voice_count; c++) {
+      if (!_used[c]) {
+        lpf.zero(c);
+        reson.zero(c);
+        pickup_hpf.zero(c);
+      }
+      _used[c] = false;
+    }
+    if (_out.size() < output.size() * voice_count) _out.resize(output.size() * voice_count);
+
+    float asymmetry = props.asymmetry;
+    for (int f = 0; f < output.size(); f++) {
+      Frame x;
+      for (int c = 0; c < voice_count; c++) x[c] = exciter[c]() * (1 + noise[c]());
+      lpf(x);
+      for (int c = 0; c < voice_count; c++) x[c] *= hammer_strength[c];
+      reson(x);
+      for (int c = 0; c < voice_count; c++) {
+        x[c] = util::math::fast::exp2(10 * util::math::fasttanh3(0.3f * x[c] + asymmetry));
+      }
+      pickup_hpf(x);
+      std::copy(x.begin(), x.end(), _out.begin() + f * voice_count);
+    }
+  }
 
   //Postprocessor
   /// Constructor. Takes care of linking appropriate variables to props
   RhodesSynth::Post::Post(Pre& pre) noexcept : PostBase(pre)
   {
+    lfo.domain(dsp::control_domain());
 
     props.lfo_depth.on_change().connect([this](float depth) {
         lfo_amount = depth*0.6;
@@ -106,7 +159,16 @@ namespace otto::engines {
 
   float RhodesSynth::Post::operator()(float in) noexcept
   {
-    return 0.01f*in*(1 + lfo_amount*lfo.tri());
+    return 0.01f*in*(1 + lfo_amount*lfo_kr([this] { return lfo.tri(); }));
+  }
+
+  void RhodesSynth::Post::process_block(gsl::span<float> left, gsl::span<float> right) noexcept
+  {
+    for (int i = 0; i < left.size(); i++) {
+      float gain = 0.01f * (1 + lfo_amount * lfo_kr([this] { return lfo.tri(); }));
+      left[i] *= gain;
+      right[i] *= gain;
+    }
   }
 
   audio::ProcessData<1> RhodesSynth::process(audio::ProcessData<1> data)
@@ -114,6 +176,11 @@ namespace otto::engines {
     return voice_mgr_.process(data);
   }
 
+  audio::ProcessData<2> RhodesSynth::process_stereo(audio::ProcessData<1> data)
+  {
+    return voice_mgr_.process_stereo(data);
+  }
+
   /*
    * RhodesSynthScreen
    */
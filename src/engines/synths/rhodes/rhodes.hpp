@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "core/engine/engine.hpp"
 #include "core/voices/voice_manager.hpp"
 
@@ -8,6 +10,8 @@
 #include <Gamma/Oscillator.h>
 #include <Gamma/scl.h>
 
+#include "util/dsp/biquad_bank.hpp"
+#include "util/dsp/control_rate.hpp"
 #include "util/math.hpp"
 
 
@@ -31,6 +35,7 @@ namespace otto::engines {
     RhodesSynth();
 
     audio::ProcessData<1> process(audio::ProcessData<1>) override;
+    audio::ProcessData<2> process_stereo(audio::ProcessData<1>) override;
 
     voices::IVoiceManager& voice_mgr() override
     {
@@ -40,41 +45,85 @@ namespace otto::engines {
     DECL_REFLECTION(RhodesSynth, props, ("voice_manager", &RhodesSynth::voice_mgr_));
 
   private:
+    static constexpr int voice_count = 6;
+
+    /// Renders the tines of all voices
+    ///
+    /// Each voice has a channel in the filter banks, so the filters of all voices are run in one
+    /// pass. The voices mix their channel with their overtones.
     struct Pre : voices::PreBase<Pre, Props> {
+      using Frame = dsp::BiquadBank<voice_count>::Frame;
+
+      std::array<gam::AD<>, voice_count> exciter;
+      std::array<gam::NoiseWhite<>, voice_count> noise;
+      Frame hammer_strength;
+
+      dsp::BiquadBank<voice_count> lpf;
+      dsp::BiquadBank<voice_count> reson;
+      dsp::BiquadBank<voice_count> pickup_hpf;
+
       Pre(Props&) noexcept;
 
+      /// Give a channel to a new voice
+      int add_voice() noexcept
+      {
+        return _channels++;
+      }
+
+      /// Strike the tine of channel `c`
+      void strike(int c, float frequency, float velocity) noexcept;
+      /// Keep channel `c` playing in the next block, at `frequency`
+      void play(int c, float frequency) noexcept;
+
+      /// The output of channel `c` at `frame` of the last block
+      float output(int c, int frame) const noexcept
+      {
+        return _out[frame * voice_count + c];
+      }
+
       void operator()() noexcept;
+      void process_block(gsl::span<float>) noexcept;
+
+    private:
+      void tune(int c, float frequency) noexcept;
+
+      std::vector<float> _out;
+      Frame _frequency;
+      /// The channels whose voice played in the last block. The others are cleared, so
+      /// the filters don't ring down into denormals.
+      std::array<bool, voice_count> _used;
+      /// The next channel to give to a voice
+      int _channels = 0;
     };
 
     struct Voice : voices::VoiceBase<Voice, Pre> {
-      gam::Biquad<> reson;
-      gam::AD<> exciter;
-      gam::NoiseWhite<> noise;
-
-      gam::Biquad<> lpf;
-      gam::Biquad<> pickup_hpf;
+      /// The channel of this voice in the preprocessor
+      int channel;
 
       gam::Osc<> overtones;
       gam::Decay<> env;
 
-      float hammer_strength = 2;
       float amp = 1;
 
       Voice(Pre&) noexcept;
 
       float operator()() noexcept;
+      void process_block(gsl::span<float>) noexcept;
       void on_note_on() noexcept;
     };
 
     struct Post : voices::PostBase<Post, Voice> {
+      /// The tremolo, in the control domain
       gam::LFO<> lfo;
+      dsp::ControlRate<> lfo_kr;
       float lfo_amount;
 
       Post(Pre&) noexcept;
 
       float operator()(float) noexcept;
+      void process_block(gsl::span<float> left, gsl::span<float> right) noexcept;
     };
 
-    voices::VoiceManager<Post, 6> voice_mgr_;
+    voices::VoiceManager<Post, voice_count> voice_mgr_;
   };
 } // namespace otto::engines
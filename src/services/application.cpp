@@ -2,6 +2,8 @@
 #include <condition_variable>
 #include "application.hpp"
 
+#include "core/props/mixins/audio_thread.hpp"
+#include "services/asset_loader.hpp"
 #include "services/audio_manager.hpp"
 #include "services/engine_manager.hpp"
 #include "services/log_manager.hpp"
@@ -10,6 +12,8 @@
 #include "services/ui_manager.hpp"
 #include "services/clock_manager.hpp"
 #include "services/controller.hpp"
+#include "util/memory_tags.hpp"
+#include "util/timer.hpp"
 
 namespace otto::services {
 
@@ -18,25 +22,50 @@ namespace otto::services {
                            ServiceStorage<PresetManager>::Factory preset_fact,
                            ServiceStorage<AudioManager>::Factory audio_fact,
                            ServiceStorage<ClockManager>::Factory clock_fact,
+                           ServiceStorage<AssetLoader>::Factory asset_fact,
                            ServiceStorage<UIManager>::Factory ui_fact,
                            ServiceStorage<Controller>::Factory controller,
                            ServiceStorage<EngineManager>::Factory engine_fact)
-    : log_manager(std::move(log_fact)),
+    : audio_thread_queue(std::make_unique<core::props::AudioThreadQueue>()),
+      log_manager(std::move(log_fact)),
       state_manager(std::move(state_fact)),
       preset_manager(std::move(preset_fact)),
       audio_manager(std::move(audio_fact)),
       clock_manager(std::move(clock_fact)),
+      asset_loader(std::move(asset_fact)),
       ui_manager(std::move(ui_fact)),
       controller(std::move(controller)),
       engine_manager(std::move(engine_fact))
   {
-    _current = this;
+    auto log_service = [&](const char* name, auto& service) {
+      LOGI("Startup: {} constructed in {:.1f} ms", name,
+           std::chrono::duration<double, std::milli>(service.construction_time).count());
+    };
+    log_service("LogManager", log_manager);
+    log_service("StateManager", state_manager);
+    log_service("PresetManager", preset_manager);
+    log_service("AudioManager", audio_manager);
+    log_service("ClockManager", clock_manager);
+    log_service("AssetLoader", asset_loader);
+    log_service("UIManager", ui_manager);
+    log_service("Controller", controller);
+    log_service("EngineManager", engine_manager);
+    startup_phase("services");
     events.post_init.fire();
+    startup_phase("post_init");
+    LOGI("Startup: memory by tag\n{}", util::memory_report());
+    // Leave the application entered while constructing. The first application stays current.
+    if (_entered == this) _entered = _outer;
   }
 
   Application::~Application()
   {
+    // The peaks of the whole session, before the services free their memory
+    LOGI("Exit: memory by tag\n{}", util::memory_report());
     events.pre_exit.fire();
+#if OTTO_ENABLE_TIMERS
+    util::timer::dump(data_dir / "trace.json");
+#endif
   }
 
   void Application::exit(ErrorCode ec) noexcept
@@ -62,8 +91,18 @@ namespace otto::services {
     Application::current()._error_code = ErrorCode::signal_recieved;
   }
 
+  void Application::startup_phase(const char* name)
+  {
+    using ms = std::chrono::duration<double, std::milli>;
+    auto now = std::chrono::steady_clock::now();
+    LOGI("Startup: {} done in {:.1f} ms, {:.1f} ms since start", name, ms(now - _phase_end).count(),
+         ms(now - start_time).count());
+    TIME_EVENT(name);
+    _phase_end = now;
+  }
+
   Application& Application::current() noexcept
   {
-    return static_cast<Application&>(*_current);
+    return static_cast<Application&>(_entered != nullptr ? *_entered : *_current);
   }
 } // namespace otto::services
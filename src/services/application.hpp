@@ -1,15 +1,22 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <utility>
 
 #include "util/event.hpp"
 #include "util/exception.hpp"
 #include "util/filesystem.hpp"
 
+namespace otto::core::props {
+  struct AudioThreadQueue;
+}
+
 namespace otto::services {
 
+  struct AssetLoader;
   struct AudioManager;
   struct EngineManager;
   struct LogManager;
@@ -25,7 +32,7 @@ namespace otto::services {
   struct ServiceStorage {
     using Factory = std::function<std::unique_ptr<Service>()>;
 
-    ServiceStorage(Factory f) : _storage(f()) {}
+    ServiceStorage(Factory f) : _storage(timed(f, construction_time)) {}
 
     Service* operator->() noexcept
     {
@@ -42,19 +49,45 @@ namespace otto::services {
       return *_storage;
     }
 
+    /// Whether the factory made a service. Some may not, like the engine manager in tests.
+    explicit operator bool() const noexcept
+    {
+      return _storage != nullptr;
+    }
+
+    /// How long the factory took, for the startup log
+    std::chrono::steady_clock::duration construction_time{};
     const std::unique_ptr<Service> _storage;
+
+  private:
+    static std::unique_ptr<Service> timed(Factory& f, std::chrono::steady_clock::duration& time)
+    {
+      auto t0 = std::chrono::steady_clock::now();
+      auto res = f();
+      time = std::chrono::steady_clock::now() - t0;
+      return res;
+    }
   };
 
   struct ApplicationHandler {
+    /// The first application of the process, current on threads that have not entered another
     static inline ApplicationHandler* _current = nullptr;
+    /// The application entered on this thread, if any. See @ref Application::Scope.
+    static inline thread_local ApplicationHandler* _entered = nullptr;
 
-    ApplicationHandler() {
-      _current = this;
+    /// Enters the application on the constructing thread, so the services it constructs find
+    /// it, even if another application is current
+    ApplicationHandler() : _outer(std::exchange(_entered, this)) {
+      if (_current == nullptr) _current = this;
     }
 
     ~ApplicationHandler() {
-      _current = nullptr;
+      if (_entered == this) _entered = _outer;
+      if (_current == this) _current = nullptr;
     }
+
+    /// The application entered on the constructing thread before this one
+    ApplicationHandler* _outer;
   };
 
   struct Application : private ApplicationHandler {
@@ -70,20 +103,51 @@ namespace otto::services {
 
     using exception = util::as_exception<ErrorCode>;
     const filesystem::path data_dir{"data"};
+    /// When the application started constructing the services
+    const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
 
     /// The current Application.
     ///
-    /// When an Application is constructed, this function will be pointed to it. The one who
-    /// constructs the application still has to destruct it when done with it.
+    /// The application entered on the calling thread with a @ref Scope, or else the first
+    /// application constructed in the process. The one who constructs the application still has
+    /// to destruct it when done with it.
     ///
-    /// There should obviously only ever be one Application instance in the process.
+    /// Usually there is one Application in the process. Plugin hosts run one per instance.
     static Application& current() noexcept;
 
+    /// Whether there is a current application, which there is not in most tests
+    static bool has_current() noexcept
+    {
+      return _entered != nullptr || _current != nullptr;
+    }
+
+    /// Makes `app` the current application on the calling thread, until the scope ends
+    ///
+    /// For processes with several applications, like plugin instances. Each call into an
+    /// instance enters its application, so the services it finds are its own, whichever thread
+    /// of the host the call is made on. Scopes nest.
+    struct Scope {
+      Scope(Application& app) noexcept
+        : _outer(std::exchange(_entered, static_cast<ApplicationHandler*>(&app)))
+      {}
+      ~Scope() noexcept
+      {
+        _entered = _outer;
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+
+    private:
+      ApplicationHandler* _outer;
+    };
+
     Application(ServiceStorage<LogManager>::Factory log_factory,
                 ServiceStorage<StateManager>::Factory state_factory,
                 ServiceStorage<PresetManager>::Factory preset_factory,
                 ServiceStorage<AudioManager>::Factory audio_factory,
                 ServiceStorage<ClockManager>::Factory clock_factory,
+                ServiceStorage<AssetLoader>::Factory asset_factory,
                 ServiceStorage<UIManager>::Factory ui_factory,
                 ServiceStorage<Controller>::Factory controller,
                 ServiceStorage<EngineManager>::Factory engine_factory);
@@ -98,16 +162,32 @@ namespace otto::services {
 
     static void handle_signal(int signal) noexcept;
 
+    /// Log that the startup phase `name` is done, with its duration and the time since start
+    ///
+    /// The constructor logs the construction of each service and `post_init`. The boards log
+    /// the start of the engines and the audio, and the UI logs its first frame, so a slow cold
+    /// start shows where the time goes. Phases are also recorded as timer events, so `name`
+    /// must be a string literal.
+    void startup_phase(const char* name);
+
     struct Events {
       util::Event<> post_init;
       util::Event<> pre_exit;
     } events;
 
+    /// The changes of `audio_thread` properties, applied by the audio thread of this application
+    ///
+    /// Each application has its own, so plugin instances apply the changes of their own
+    /// properties on their own audio thread. Constructed before, and destroyed after, the
+    /// services. See `core::props::AudioThreadQueue::get`.
+    const std::unique_ptr<core::props::AudioThreadQueue> audio_thread_queue;
+
     ServiceStorage<LogManager> log_manager;
     ServiceStorage<StateManager> state_manager;
     ServiceStorage<PresetManager> preset_manager;
     ServiceStorage<AudioManager> audio_manager;
     ServiceStorage<ClockManager> clock_manager;
+    ServiceStorage<AssetLoader> asset_loader;
     ServiceStorage<UIManager> ui_manager;
     ServiceStorage<Controller> controller;
     ServiceStorage<EngineManager> engine_manager;
@@ -115,6 +195,8 @@ namespace otto::services {
   private:
     std::atomic_bool _is_running{true};
     std::atomic<ErrorCode> _error_code;
+    /// The end of the last startup phase
+    std::chrono::steady_clock::time_point _phase_end = start_time;
   };
 
 } // namespace otto::services
@@ -0,0 +1,148 @@
+#include "asset_loader.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::services {
+
+  AssetLoader::AssetLoader(std::size_t cache_budget)
+    : _cache(cache_budget), _worker(util::start_thread(util::ThreadClass::background, [this] { worker_loop(); }))
+  {
+    if (const char* fast = std::getenv("OTTO_FAST_BOOT"); fast && fast == std::string("1")) {
+      _cache.persist_to(Application::current().data_dir / "sample_cache");
+      Application::current().events.pre_exit.subscribe([this] { _cache.save(); });
+    }
+  }
+
+  AssetLoader::~AssetLoader() noexcept
+  {
+    {
+      std::unique_lock lock(_mutex);
+      _stop = true;
+    }
+    _requested.notify_one();
+    _worker.join();
+  }
+
+  void AssetLoader::enqueue(Request request)
+  {
+    {
+      std::unique_lock lock(_mutex);
+      auto key = request.key;
+      _requests.erase(std::remove_if(_requests.begin(), _requests.end(),
+                                     [key](auto& r) { return r.key == key; }),
+                      _requests.end());
+      _requests.push_back(std::move(request));
+    }
+    _requested.notify_one();
+  }
+
+  void AssetLoader::when(const void* key,
+                         std::function<bool()> ready,
+                         std::function<void()> step,
+                         util::CancelToken token)
+  {
+    std::unique_lock lock(_mutex);
+    _waiting.erase(std::remove_if(_waiting.begin(), _waiting.end(),
+                                  [key](auto& w) { return w.key == key; }),
+                   _waiting.end());
+    _waiting.push_back({key, std::move(ready), std::move(step), std::move(token)});
+  }
+
+  bool AssetLoader::process_completions()
+  {
+    decltype(_completions) completions;
+    decltype(_waiting) waiting;
+    {
+      std::unique_lock lock(_mutex);
+      std::swap(completions, _completions);
+      std::swap(waiting, _waiting);
+    }
+    for (auto& [key, completion] : completions) completion();
+
+    // Steps may wait for more, or be replaced, while they are checked
+    bool called = !completions.empty();
+    decltype(_waiting) still_waiting;
+    for (auto& w : waiting) {
+      if (w.token.cancelled()) continue;
+      if (w.ready()) {
+        w.step();
+        called = true;
+      } else {
+        still_waiting.push_back(std::move(w));
+      }
+    }
+    if (!still_waiting.empty()) {
+      std::unique_lock lock(_mutex);
+      for (auto& w : still_waiting) {
+        bool replaced = std::any_of(_waiting.begin(), _waiting.end(),
+                                    [&](auto& other) { return other.key == w.key; });
+        if (!replaced) _waiting.push_back(std::move(w));
+      }
+    }
+    return called;
+  }
+
+  void AssetLoader::flush()
+  {
+    // Completion handlers may request more assets
+    while (true) {
+      {
+        std::unique_lock lock(_mutex);
+        _finished.wait(lock, [this] { return _requests.empty() && _running == nullptr; });
+        if (_completions.empty()) return;
+      }
+      process_completions();
+    }
+  }
+
+  void AssetLoader::cancel(const void* key)
+  {
+    // Destroy the dropped assets outside the lock
+    decltype(_completions) dropped;
+    std::unique_lock lock(_mutex);
+    _requests.erase(std::remove_if(_requests.begin(), _requests.end(),
+                                   [key](auto& r) { return r.key == key; }),
+                    _requests.end());
+    _finished.wait(lock, [this, key] { return _running != key; });
+    auto split = std::stable_partition(_completions.begin(), _completions.end(),
+                                       [key](auto& c) { return c.first != key; });
+    std::move(split, _completions.end(), std::back_inserter(dropped));
+    _completions.erase(split, _completions.end());
+    _waiting.erase(std::remove_if(_waiting.begin(), _waiting.end(),
+                                  [key](auto& w) { return w.key == key; }),
+                   _waiting.end());
+    lock.unlock();
+  }
+
+  void AssetLoader::worker_loop()
+  {
+    loguru::set_thread_name("asset_loader");
+    std::unique_lock lock(_mutex);
+    while (true) {
+      _requested.wait(lock, [this] { return _stop || !_requests.empty(); });
+      if (_stop) return;
+      auto request = std::move(_requests.front());
+      _requests.pop_front();
+      _running = request.key;
+      lock.unlock();
+
+      Completion completion;
+      try {
+        if (!request.token.cancelled()) completion = request.run();
+      } catch (std::exception& e) {
+        LOGE("Could not load asset: {}", e.what());
+      }
+
+      lock.lock();
+      if (completion) _completions.emplace_back(request.key, std::move(completion));
+      _running = nullptr;
+      _finished.notify_all();
+    }
+  }
+
+} // namespace otto::services
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "core/audio/sample_cache.hpp"
+#include "core/service.hpp"
+#include "services/application.hpp"
+#include "util/cancel_token.hpp"
+#include "util/exception.hpp"
+
+namespace otto::services {
+
+  /// Loads assets, like samples and wavetables, on a background thread
+  ///
+  /// Decoding a file can take much longer than a buffer, so engines request it here instead of
+  /// loading it in an `on_change` handler. The load function runs on the loader thread, and the
+  /// completion handler runs on the UI thread, in @ref process_completions. The completion
+  /// handler typically publishes the asset to the audio thread through a @ref util::Handoff, so
+  /// the engine keeps playing the old asset until the new one is ready.
+  ///
+  /// Requests are identified by a key, usually the address of what the asset is loaded into. A
+  /// new request replaces a request with the same key that has not started yet, so browsing
+  /// through files only loads the last one.
+  ///
+  /// Load functions should decode files through @ref cache, so files used by several engines,
+  /// or recalled by presets, are decoded once.
+  ///
+  /// Longer flows, like applying a preset, are chains of requests: each completion handler makes
+  /// the next request, or waits for a condition with @ref when. Passing them all the same
+  /// @ref util::CancelToken stops the flow at whichever step it has reached when it is
+  /// cancelled.
+  struct AssetLoader : core::Service {
+    enum struct ErrorCode {
+      /// Thrown by load functions, when the asset could not be loaded
+      load_failed,
+    };
+
+    using exception = util::as_exception<ErrorCode>;
+
+    /// Start the loader thread
+    ///
+    /// With `OTTO_FAST_BOOT=1`, the decoded samples are saved to `data/sample_cache` at exit,
+    /// and read from there at the next boot instead of being decoded again, see
+    /// @ref core::audio::SampleCache::persist_to.
+    ///
+    /// \param cache_budget The size in bytes of the sample cache
+    AssetLoader(std::size_t cache_budget = core::audio::SampleCache::default_budget);
+
+    /// Stop the loader thread. Pending requests are dropped.
+    ~AssetLoader() noexcept;
+
+    /// Request an asset
+    ///
+    /// `load` is called on the loader thread, and returns a `std::unique_ptr` to the asset. If
+    /// it throws, the error is logged, and `done` is not called. Otherwise, `done` is called with
+    /// the asset from @ref process_completions.
+    ///
+    /// If `token` is cancelled before `load` starts, or before `done` is called, they are not.
+    template<typename Load, typename Done>
+    void load(const void* key, Load&& load, Done&& done, util::CancelToken token = {});
+
+    /// Call `step` from @ref process_completions, once `ready` returns true
+    ///
+    /// For the steps of a flow that wait for something on the UI thread, like the start of a
+    /// bar. `ready` is called once per frame until then. A new call with the same key replaces
+    /// the waiting step, and neither is called once `token` is cancelled. @ref flush does not
+    /// wait for these.
+    void when(const void* key,
+              std::function<bool()> ready,
+              std::function<void()> step,
+              util::CancelToken token = {});
+
+    /// Call the completion handlers of finished requests
+    ///
+    /// Called by the @ref UIManager once per frame.
+    /// \returns whether any completion handler was called
+    bool process_completions();
+
+    /// Wait for all requests to finish, and call their completion handlers
+    ///
+    /// For boards without a UI, to have the assets before processing audio.
+    void flush();
+
+    /// Drop all requests, completions and waiting steps with `key`
+    ///
+    /// Waits for the request if it is being loaded. Call this before destroying the target of a
+    /// request.
+    void cancel(const void* key);
+
+    /// The sample cache shared by all engines
+    core::audio::SampleCache& cache() noexcept
+    {
+      return _cache;
+    }
+
+    static AssetLoader& current() noexcept
+    {
+      return Application::current().asset_loader;
+    }
+
+  private:
+    using Completion = std::function<void()>;
+
+    struct Request {
+      const void* key;
+      /// Loads the asset, and returns the completion handler
+      std::function<Completion()> run;
+      util::CancelToken token;
+    };
+
+    struct WaitingStep {
+      const void* key;
+      std::function<bool()> ready;
+      Completion step;
+      util::CancelToken token;
+    };
+
+    void enqueue(Request request);
+    void worker_loop();
+
+    core::audio::SampleCache _cache;
+
+    std::mutex _mutex;
+    /// Notified when a request is added, or on stop
+    std::condition_variable _requested;
+    /// Notified when a request is finished
+    std::condition_variable _finished;
+    std::deque<Request> _requests;
+    std::deque<std::pair<const void*, Completion>> _completions;
+    std::deque<WaitingStep> _waiting;
+    /// The key of the request being loaded
+    const void* _running = nullptr;
+    bool _stop = false;
+    std::thread _worker;
+  };
+
+  template<typename Load, typename Done>
+  void AssetLoader::load(const void* key, Load&& load, Done&& done, util::CancelToken token)
+  {
+    using Asset = typename std::invoke_result_t<Load>::element_type;
+    enqueue({key,
+             [load = std::forward<Load>(load), done = std::forward<Done>(done), token]() {
+               // std::function needs a copyable handler
+               auto asset = std::make_shared<std::unique_ptr<Asset>>(load());
+               return Completion([done, asset, token] {
+                 if (!token.cancelled()) done(std::move(*asset));
+               });
+             },
+             token});
+  }
+
+} // namespace otto::services
@@ -1,13 +1,123 @@
 #include "audio_manager.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
 #include <Gamma/Domain.h>
+#include <fmt/format.h>
+
+#include "core/ui/screen.hpp"
+#include "core/ui/vector_graphics.hpp"
+
+#include "services/clock_manager.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "services/state_manager.hpp"
+#include "util/realtime.hpp"
+#include "util/rt_check.hpp"
+#include "util/thread_policy.hpp"
+#include "util/timer.hpp"
 
 namespace otto::services {
 
+  struct AudioManager::SettingsScreen : core::ui::Screen {
+    SettingsScreen(AudioManager& am) : am(am) {}
+
+    void on_show() override
+    {
+      samplerate_idx = index_of(samplerates, am.samplerate());
+      buffer_size_idx = index_of(buffer_sizes, am.buffer_size());
+    }
+
+    void on_hide() override
+    {
+      am.change_settings(samplerates[samplerate_idx], buffer_sizes[buffer_size_idx]);
+    }
+
+    void encoder(core::ui::EncoderEvent e) override
+    {
+      switch (e.encoder) {
+        case core::ui::Encoder::blue:
+          samplerate_idx = std::clamp(samplerate_idx + e.steps, 0, int(samplerates.size()) - 1);
+          break;
+        case core::ui::Encoder::green:
+          buffer_size_idx = std::clamp(buffer_size_idx + e.steps, 0, int(buffer_sizes.size()) - 1);
+          break;
+        default: break;
+      }
+    }
+
+    void draw(core::ui::vg::Canvas& ctx) override
+    {
+      using namespace core::ui::vg;
+      int samplerate = samplerates[samplerate_idx];
+      int buffer_size = buffer_sizes[buffer_size_idx];
+
+      ctx.font(Fonts::Norm, 35);
+      ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+      ctx.fillStyle(Colours::Blue);
+      ctx.fillText("Rate", {30, 60});
+      ctx.fillStyle(Colours::Green);
+      ctx.fillText("Buffer", {30, 120});
+
+      ctx.fillStyle(Colours::White);
+      ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+      ctx.fillText(fmt::format("{} Hz", samplerate), {290, 60});
+      ctx.fillText(fmt::format("{}", buffer_size), {290, 120});
+
+      ctx.font(Fonts::Norm, 20);
+      ctx.fillStyle(Colours::Gray50);
+      ctx.fillText(fmt::format("{:.1f} ms", 1000.f * buffer_size / samplerate), {290, 160});
+      ctx.textAlign(HorizontalAlign::Center, VerticalAlign::Middle);
+      ctx.fillText("applied when leaving", {160, 215});
+    }
+
+  private:
+    /// The index of the option closest to `value`
+    template<std::size_t N>
+    static int index_of(const std::array<int, N>& options, int value)
+    {
+      auto closest = std::min_element(options.begin(), options.end(), [value](int a, int b) {
+        return std::abs(a - value) < std::abs(b - value);
+      });
+      return closest - options.begin();
+    }
+
+    AudioManager& am;
+    int samplerate_idx = 0;
+    int buffer_size_idx = 0;
+  };
+
+  static std::int64_t to_ns(std::chrono::steady_clock::time_point t) noexcept
+  {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(t.time_since_epoch()).count();
+  }
+
+  static std::int64_t now_ns() noexcept
+  {
+    return to_ns(std::chrono::steady_clock::now());
+  }
+
   AudioManager::AudioManager()
   {
     events.pre_init.fire();
-    core::midi::generateFreqTable(440);
+
+    auto load = [this](nlohmann::json& data) {
+      if (!data.is_object()) return;
+      change_settings(data.value("samplerate", samplerate()), data.value("buffer_size", buffer_size()));
+    };
+    auto save = [this] { return nlohmann::json({{"samplerate", samplerate()}, {"buffer_size", buffer_size()}}); };
+    Application::current().state_manager->attach("Audio", load, save);
+    _settings_screen = core::ui::make_screen<SettingsScreen>(*this);
+  }
+
+  AudioManager::~AudioManager() = default;
+
+  core::ui::Screen& AudioManager::settings_screen() noexcept
+  {
+    return *_settings_screen;
   }
 
   core::audio::AudioBufferPool& AudioManager::buffer_pool() noexcept
@@ -15,6 +125,35 @@ namespace otto::services {
     return _buffer_pool;
   }
 
+  core::audio::AudioContext AudioManager::make_context() noexcept
+  {
+    auto& clock = ClockManager::current();
+    return {&_buffer_pool, _samplerate, _octave.load(std::memory_order_relaxed), clock.running(), clock.bpm()};
+  }
+
+  void AudioManager::change_settings(int samplerate, int buffer_size)
+  {
+    if (samplerate == _samplerate && buffer_size == int(_buffer_size)) return;
+    LOGI("Audio: changing to {} Hz, {} frames", samplerate, buffer_size);
+    restart(samplerate, buffer_size);
+    Application::current().state_manager->mark_dirty("Audio");
+  }
+
+  void AudioManager::restart(int samplerate, int buffer_size)
+  {
+    apply_settings(samplerate, buffer_size);
+  }
+
+  void AudioManager::apply_settings(int samplerate, int buffer_size)
+  {
+    _samplerate = samplerate;
+    _buffer_size = buffer_size;
+    _buffer_pool.set_buffer_size(buffer_size);
+    if (gam::sampleRate() == samplerate) return;
+    gam::sampleRate(samplerate);
+    events.samplerate_change.fire(samplerate);
+  }
+
   void AudioManager::start() noexcept
   {
     _running = true;
@@ -25,22 +164,135 @@ namespace otto::services {
     return _running;
   }
 
-  void AudioManager::wait_one() const noexcept
+  bool AudioManager::wait_past(unsigned buffer, std::chrono::nanoseconds timeout) const noexcept
   {
-    auto last = buffer_number();
-    if (last == 0) return;
-    while (last >= (buffer_number() - 1));
+    if (!_running) return false;
+    return _buffer_number.wait_past(buffer, timeout);
+  }
+
+  bool AudioManager::wait_one(std::chrono::nanoseconds timeout) const noexcept
+  {
+    // Whichever callback is running now finishes after the current buffer number
+    return wait_past(buffer_number(), timeout);
   }
 
   void AudioManager::send_midi_event(core::midi::AnyMidiEvent evt) noexcept
   {
-    midi_bufs.outer().emplace_back(std::move(evt));
+    send_midi_event(std::move(evt), std::chrono::steady_clock::now());
+  }
+
+  void AudioManager::send_midi_event(core::midi::AnyMidiEvent evt, std::chrono::steady_clock::time_point arrival) noexcept
+  {
+    auto elapsed = to_ns(arrival) - _buffer_start_ns.load(std::memory_order_relaxed);
+    auto offset = elapsed * _samplerate / 1'000'000'000;
+    evt.time = std::clamp<std::int64_t>(offset, 0, _buffer_size - 1);
+    _midi_event_count.fetch_add(1, std::memory_order_relaxed);
+    if (!_midi_queue.push(evt)) _midi_overflow_count++;
+  }
+
+  core::midi::MidiBuffer& AudioManager::collect_midi() noexcept
+  {
+    _midi_buf.clear();
+    _buffer_start_ns.store(now_ns(), std::memory_order_relaxed);
+    _midi_queue.consume([this](const core::midi::AnyMidiEvent& evt) {
+      if (_midi_buf.size() == core::midi::MidiBuffer::capacity) return false;
+      _midi_buf.push_back(evt);
+      return true;
+    });
+    return _midi_buf;
+  }
+
+  void AudioManager::prepare_audio_thread() noexcept
+  {
+    if (std::this_thread::get_id() == _audio_thread) return;
+    _audio_thread = std::this_thread::get_id();
+    {
+      // Only once per thread
+      util::AllowBlocking allow;
+      RTLOGW_IF(!util::enter_thread_class(util::ThreadClass::audio),
+                "Could not apply the scheduling of the audio thread");
+    }
+    util::prefault_stack();
+    _last_page_faults = util::thread_page_faults();
+    _last_core = util::current_core();
+  }
+
+  void AudioManager::record_callback(clock::time_point start,
+                                     clock::time_point end,
+                                     int nframes,
+                                     bool input_overflow,
+                                     bool output_underflow) noexcept
+  {
+    auto& stats = _callback_stats;
+    if (input_overflow) stats.input_overflows++;
+    if (output_underflow) stats.output_underflows++;
+    if (input_overflow || output_underflow) TIME_EVENT("Xrun");
+    double buffer_ns = 1e9 * nframes / _samplerate;
+    double load = std::chrono::nanoseconds(end - start).count() / buffer_ns;
+    stats.load.add(load);
+    _load_history.push(float(load));
+    if (load > 1) stats.deadline_misses++;
+    _governor.add(load);
+    if (_last_callback_start != clock::time_point()) {
+      stats.interval.add(std::chrono::nanoseconds(start - _last_callback_start).count() / buffer_ns);
+    }
+    _last_callback_start = start;
+
+    if (std::this_thread::get_id() != _audio_thread) return;
+    auto faults = util::thread_page_faults();
+    stats.page_faults += int(faults.total() - _last_page_faults.total());
+    _last_page_faults = faults;
+    int core = util::current_core();
+    if (core != _last_core) stats.migrations++;
+    _last_core = core;
+  }
+
+  void AudioManager::log_callback_stats()
+  {
+    if (int level = quality_level(); level != _logged_quality_level) {
+      LOGI("Audio: quality level {} -> {}", _logged_quality_level, level);
+      _logged_quality_level = level;
+    }
+    auto& stats = _callback_stats;
+    int faults = stats.page_faults;
+    int migrations = stats.migrations;
+    if (faults != _logged_page_faults || migrations != _logged_migrations) {
+      LOGW("Audio: {} page faults and {} migrations of the audio thread. Total {} page faults, {} migrations",
+           faults - _logged_page_faults, migrations - _logged_migrations, faults, migrations);
+      _logged_page_faults = faults;
+      _logged_migrations = migrations;
+    }
+    int overflows = stats.input_overflows;
+    int underflows = stats.output_underflows;
+    int xruns = overflows + underflows;
+    int misses = stats.deadline_misses;
+    if (xruns == _logged_xruns && misses == _logged_deadline_misses) return;
+    // If the callbacks are on time, xruns come from the driver or kernel, not the dsp load
+    LOGW("Audio: {} xruns and {} missed deadlines. Total {} input overflows, {} output "
+         "underflows, {} missed deadlines. Load p50 {:.0f}% p99 {:.0f}%, "
+         "callback interval p1 {:.2f} p99 {:.2f} buffers",
+         xruns - _logged_xruns, misses - _logged_deadline_misses, overflows, underflows, misses, 100 * stats.load.quantile(0.5),
+         100 * stats.load.quantile(0.99), stats.interval.quantile(0.01),
+         stats.interval.quantile(0.99));
+    _logged_xruns = xruns;
+    _logged_deadline_misses = misses;
+  }
+
+  void AudioManager::record_cpu_time(std::chrono::nanoseconds total,
+                                     std::chrono::nanoseconds engines) noexcept
+  {
+    _total_cpu.add(total);
+    _driver_cpu.add(total - engines);
   }
 
-  float AudioManager::cpu_time() noexcept
+  std::vector<util::CpuUsage> AudioManager::take_cpu_usage()
   {
-    float res = _cpu_time;
-    _cpu_time.clear();
+    std::vector<util::CpuUsage> res;
+    res.push_back({"Total", _total_cpu.take()});
+    res.push_back({"Driver", _driver_cpu.take()});
+    if (auto* engine_manager = Application::current().engine_manager.operator->()) {
+      engine_manager->take_cpu_usage(res);
+    }
     return res;
   }
 
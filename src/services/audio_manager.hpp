@@ -1,15 +1,31 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "core/audio/processor.hpp"
 #include "core/service.hpp"
 #include "services/debug_ui.hpp"
+#include "util/cpu_governor.hpp"
+#include "util/cpu_meter.hpp"
 #include "util/event.hpp"
+#include "util/histogram.hpp"
 #include "util/locked.hpp"
+#include "util/mpsc_queue.hpp"
+#include "util/realtime.hpp"
+#include "util/spsc_ring.hpp"
+#include "util/wait_counter.hpp"
 
 #include "services/application.hpp"
 
+namespace otto::core::ui {
+  struct Screen;
+}
+
 namespace otto::services {
 
   struct AudioManager : core::Service {
@@ -20,31 +36,108 @@ namespace otto::services {
     /// with a buffer size of 1. The subclass needs to change this using
     /// AudioBufferPool::set_buffer_size as soon as possible
     AudioManager();
+    ~AudioManager();
 
-    /// Use this to get audio buffers. There are currently a maximum of 4 avaliable, so make sure to
+    /// Use this to get audio buffers. The pool is sized by the engine manager, so make sure to
     /// release them when you're done with them!
+    ///
+    /// If the pool runs out, it hands out a shared emergency buffer and counts the overflow,
+    /// see @ref core::audio::AudioBufferPool::overflow_count
     core::audio::AudioBufferPool& buffer_pool() noexcept;
 
+    /// The context of a callback, for @ref core::audio::ProcessData::context
+    ///
+    /// Takes a snapshot of the clock and the octave. Called by the driver at the start of each
+    /// callback, and kept alive until its end.
+    core::audio::AudioContext make_context() noexcept;
+
+    /// Set the octave offset passed to the engines by @ref make_context
+    ///
+    /// Called by the UI manager when the octave changes.
+    void octave(int octave) noexcept
+    {
+      _octave.store(octave, std::memory_order_relaxed);
+    }
+
     /// Send a midi event into the system.
     ///
     /// The `core::midi` namespace has some nice utils for constructing events.
+    ///
+    /// Safe to call from any thread. Never locks, so it will not block the audio thread.
+    /// If the queue is full, the event is dropped, and counted in @ref midi_overflow_count.
+    ///
+    /// The event time is set to the frame offset of its arrival into the current buffer, and
+    /// the event is processed at that offset into the next buffer. This gives a constant
+    /// latency of one buffer instead of a jitter of up to one buffer.
     void send_midi_event(core::midi::AnyMidiEvent) noexcept;
 
+    /// Send a midi event that arrived at `arrival`
+    ///
+    /// Like @ref send_midi_event(core::midi::AnyMidiEvent), but the frame offset is that of
+    /// `arrival`, like the time the bytes of a key press were read, so the time spent decoding
+    /// and dispatching the event does not add to its latency.
+    void send_midi_event(core::midi::AnyMidiEvent, std::chrono::steady_clock::time_point arrival) noexcept;
+
+    /// The number of midi events sent with @ref send_midi_event since startup
+    std::uint64_t midi_event_count() const noexcept
+    {
+      return _midi_event_count.load(std::memory_order_relaxed);
+    }
+
+    /// The number of midi events dropped because the midi queue or a midi buffer was full
+    int midi_overflow_count() const noexcept
+    {
+      return _midi_overflow_count;
+    }
+
     /// Get the samplerate
     int samplerate() const noexcept { return _samplerate; }
 
     /// Get the buffer size
     int buffer_size() const noexcept { return _buffer_size; }
 
+    /// The sample rates offered by the settings screen
+    static constexpr std::array<int, 3> samplerates = {44100, 48000, 96000};
+    /// The buffer sizes offered by the settings screen
+    static constexpr std::array<int, 6> buffer_sizes = {32, 64, 128, 256, 512, 1024};
+    static_assert(buffer_sizes.back() <= int(core::audio::max_buffer_size),
+                  "The engines keep buffers of core::audio::max_buffer_size frames");
+
+    /// Restart the stream with a new sample rate and buffer size
+    ///
+    /// The driver may pick the nearest settings the device supports, see @ref samplerate and
+    /// @ref buffer_size. If the device does not support them at all, it goes back to the
+    /// previous settings. Returns when the stream is running again. The settings are saved
+    /// in the state, and restored at startup.
+    ///
+    /// Not to be called from the audio thread.
+    void change_settings(int samplerate, int buffer_size);
+
+    /// Selects the sample rate and buffer size, shown with the settings key
+    ///
+    /// The blue encoder selects the sample rate, and the green encoder the buffer size. They
+    /// are applied when the screen is left.
+    core::ui::Screen& settings_screen() noexcept;
+
     /// Get the current buffer number
-    /// 
-    /// i.e. number of {@ref buffer_size()} chunks of samples since the start
-    /// 
-    /// Can be used to wait until the current process call is over
-    unsigned buffer_number() const noexcept { return _buffer_number; }
+    ///
+    /// i.e. number of audio callbacks that have finished since the start
+    ///
+    /// Can be passed to @ref wait_past to wait until the current process call is over
+    unsigned buffer_number() const noexcept { return _buffer_number.value(); }
+
+    /// Sleep until the audio callback has finished buffer number `buffer`
+    ///
+    /// Uses a futex on Linux, so the waiting thread takes no cpu time from the audio thread.
+    /// Safe to call from any thread but the audio thread.
+    ///
+    /// \returns `false` if `timeout` elapsed first, or right away if audio is not running
+    bool wait_past(unsigned buffer, std::chrono::nanoseconds timeout) const noexcept;
 
     /// Wait at least until the current process call is done
-    void wait_one() const noexcept;
+    ///
+    /// \returns `false` if `timeout` elapsed first, or right away if audio is not running
+    bool wait_one(std::chrono::nanoseconds timeout = std::chrono::milliseconds(100)) const noexcept;
 
     /// Start audio processing
     ///
@@ -56,8 +149,88 @@ namespace otto::services {
     /// \returns `true` if start() has been called
     bool running() noexcept;
 
-    /// The amount of cpu time spent on average since the last call to this function
-    float cpu_time() noexcept;
+    /// Take the timing statistics of the audio chain since the last call
+    ///
+    /// The first entries are `Total`, the whole audio callback, and `Driver`, the callback
+    /// without the engines. They are followed by one entry for each part of the engine chain,
+    /// see @ref EngineManager::take_cpu_usage. Not to be called from the audio thread.
+    std::vector<util::CpuUsage> take_cpu_usage();
+
+    /// The duration of one buffer in nanoseconds, i.e. the time the audio callback has
+    std::int64_t buffer_budget_ns() const noexcept
+    {
+      return std::int64_t(_buffer_size) * 1'000'000'000 / _samplerate;
+    }
+
+    /// The realtime health of the audio callback, since startup
+    ///
+    /// Written by the driver on the audio thread, and may be read from any thread.
+    struct CallbackStats {
+      /// Callbacks where the driver discarded input data
+      std::atomic_int input_overflows = 0;
+      /// Callbacks where the driver ran out of output data, likely causing a gap in the sound
+      std::atomic_int output_underflows = 0;
+      /// Callbacks that took longer than the duration of their buffer
+      std::atomic_int deadline_misses = 0;
+      /// The duration of each callback, relative to the duration of its buffer
+      util::Histogram<40> load{0, 2};
+      /// The time between the starts of two callbacks, relative to the duration of a buffer.
+      ///
+      /// Centered on 1. Its spread is the scheduling jitter of the driver and kernel.
+      util::Histogram<40> interval{0, 2};
+      /// Page faults on the audio thread. Each may stall it for a long time.
+      std::atomic_int page_faults = 0;
+      /// Callbacks that ran on another core than the previous one
+      std::atomic_int migrations = 0;
+    };
+
+    const CallbackStats& callback_stats() const noexcept
+    {
+      return _callback_stats;
+    }
+
+    /// The load of each callback, relative to the duration of its buffer, oldest first
+    using LoadHistory = util::SPSCRing<float, 512>;
+
+    /// The loads of the callbacks since the UI last drained it
+    ///
+    /// Pushed to by @ref record_callback on the audio thread. The UI thread is its only
+    /// consumer, and pops it every frame. When the UI falls behind, the newest loads are
+    /// dropped.
+    LoadHistory& load_history() noexcept
+    {
+      return _load_history;
+    }
+
+    /// The core the audio thread is pinned to, unless the board sets the cores of
+    /// `util::ThreadClass::audio`
+    ///
+    /// The worker of the routing graph runs on the next core. The boards keep the other threads
+    /// off both where they can.
+    static constexpr int audio_core = 0;
+
+    /// Log the xruns, deadline misses, page faults and migrations since the last call, if
+    /// there were any, and changes of the quality level
+    ///
+    /// Not to be called from the audio thread.
+    void log_callback_stats();
+
+    /// Picks the quality level from the load of each callback
+    ///
+    /// Fed by the drivers that run in realtime. The others leave it at full quality. Its
+    /// settings should only be changed before @ref start.
+    util::CpuGovernor& governor() noexcept
+    {
+      return _governor;
+    }
+
+    /// The quality level picked by @ref governor(), from 0 as full quality and up
+    ///
+    /// The engines and the UI lower their cost as it rises. May be read from any thread.
+    int quality_level() const noexcept
+    {
+      return _governor.level();
+    }
 
     /// Get the current instance of this service
     /// 
@@ -68,15 +241,102 @@ namespace otto::services {
 
     struct Events {
       util::Event<> pre_init;
+      /// Fired with the new sample rate when it changes, while the stream is stopped
+      ///
+      /// Handlers run on the thread that changed the settings, or the thread of the driver.
+      /// The engine manager passes it on to the engines.
+      util::Event<int> samplerate_change;
     } events;
 
   protected:
-    util::double_buffered<core::midi::shared_vector<core::midi::AnyMidiEvent>> midi_bufs = {{}, {}};
+    /// Stop the stream, and start it again with `samplerate` and `buffer_size`
+    ///
+    /// Drivers call @ref apply_settings while the stream is stopped. Without a stream, the
+    /// settings are applied right away.
+    virtual void restart(int samplerate, int buffer_size);
+
+    /// Take on the settings the stream is opened with
+    ///
+    /// Resizes the buffers of the pool, sets the sample rate of Gamma, and fires
+    /// Events::samplerate_change if it changed. Only to be called while the stream is stopped.
+    void apply_settings(int samplerate, int buffer_size);
+
+    /// The maximum number of midi events waiting for the next buffer
+    static constexpr std::size_t midi_queue_size = 1024;
+
+    /// Move the events sent since the last call into the midi buffer of the next process call.
+    ///
+    /// Only to be called from the audio thread, once per buffer. If the buffer fills up, the
+    /// remaining events are left in the queue for the next buffer.
+    core::midi::MidiBuffer& collect_midi() noexcept;
+
+    using clock = std::chrono::steady_clock;
+
+    /// Signal the end of an audio callback to the threads in @ref wait_past
+    ///
+    /// To be called by the driver at the end of every callback, including the ones that return
+    /// early. Never blocks.
+    void finish_buffer() noexcept
+    {
+      _buffer_number.increment();
+    }
+
+    /// Set up the calling thread as the audio thread
+    ///
+    /// To be called by real-time drivers at the start of every callback. On the first call from
+    /// a thread, it enters `util::ThreadClass::audio`, which pins it to @ref audio_core by
+    /// default, and prefaults its stack. Afterwards, it
+    /// returns right away. Drivers that start their own thread may set its priority as well.
+    void prepare_audio_thread() noexcept;
+
+    /// Record the timing of one audio callback, and the errors the driver reported for it
+    ///
+    /// Also counts the page faults and migrations of the audio thread, once @ref
+    /// prepare_audio_thread has been called. Only to be called from the audio thread.
+    void record_callback(clock::time_point start,
+                         clock::time_point end,
+                         int nframes,
+                         bool input_overflow,
+                         bool output_underflow) noexcept;
+
+    /// Record the time of one audio callback
+    ///
+    /// \param total The time of the whole callback
+    /// \param engines The part of `total` spent in `EngineManager::process`
+    void record_cpu_time(std::chrono::nanoseconds total, std::chrono::nanoseconds engines) noexcept;
+
+    util::MPSCQueue<core::midi::AnyMidiEvent, midi_queue_size> _midi_queue;
+    core::midi::MidiBuffer _midi_buf;
+    /// The time of the last call to `collect_midi`, in nanoseconds of `std::chrono::steady_clock`
+    std::atomic<std::int64_t> _buffer_start_ns = 0;
+    std::atomic_int _midi_overflow_count = 0;
+    std::atomic<std::uint64_t> _midi_event_count = 0;
     std::atomic_int _samplerate = 48000;
     std::atomic_uint _buffer_size = 256;
-    std::atomic_uint _buffer_number = 0;
-    util::audio::Graph _cpu_time;
+    std::atomic_int _octave = 0;
+    CallbackStats _callback_stats;
+    LoadHistory _load_history;
+    /// The start of the previous callback. Only used on the audio thread.
+    clock::time_point _last_callback_start;
+    /// The callback stats at the last call to `log_callback_stats`
+    int _logged_xruns = 0;
+    int _logged_deadline_misses = 0;
+    int _logged_quality_level = 0;
+    int _logged_page_faults = 0;
+    int _logged_migrations = 0;
+    /// The thread @ref prepare_audio_thread was last called from
+    std::thread::id _audio_thread;
+    /// The page faults and core of the audio thread at the last callback. Only used on the
+    /// audio thread.
+    util::PageFaults _last_page_faults;
+    int _last_core = -1;
+    util::CpuGovernor _governor;
+    util::CpuMeter _total_cpu;
+    util::CpuMeter _driver_cpu;
   private:
+    struct SettingsScreen;
+    std::unique_ptr<core::ui::Screen> _settings_screen;
+    util::WaitCounter _buffer_number;
     core::audio::AudioBufferPool _buffer_pool{1};
     std::atomic_bool _running{false};
   };
@@ -0,0 +1,53 @@
+#include "audio_watchdog.hpp"
+
+#include "services/audio_manager.hpp"
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::services {
+
+  AudioWatchdog::AudioWatchdog(AudioManager& audio, OnStall on_stall)
+    : _audio(audio), _on_stall(std::move(on_stall))
+  {
+    _thread = util::start_thread(util::ThreadClass::io, [this] { run(); });
+  }
+
+  AudioWatchdog::~AudioWatchdog() noexcept
+  {
+    {
+      std::unique_lock lock(_mutex);
+      _stop = true;
+    }
+    _stop_cv.notify_all();
+    if (_thread.joinable()) _thread.join();
+  }
+
+  std::chrono::nanoseconds AudioWatchdog::Detector::check(unsigned buffer_number,
+                                                          bool running,
+                                                          clock::time_point now) noexcept
+  {
+    if (!running || buffer_number != _last_buffer) {
+      _last_buffer = buffer_number;
+      _last_progress = now;
+      _reported = false;
+      return std::chrono::nanoseconds(0);
+    }
+    auto stalled_for = now - _last_progress;
+    if (_reported || stalled_for < stall_limit) return std::chrono::nanoseconds(0);
+    _reported = true;
+    return stalled_for;
+  }
+
+  void AudioWatchdog::run()
+  {
+    loguru::set_thread_name("audio_watchdog");
+    std::unique_lock lock(_mutex);
+    while (!_stop_cv.wait_for(lock, interval, [this] { return _stop; })) {
+      auto stalled_for = _detector.check(_audio.buffer_number(), _audio.running(), clock::now());
+      if (stalled_for.count() == 0) continue;
+      _stalls++;
+      _on_stall(stalled_for);
+    }
+  }
+
+} // namespace otto::services
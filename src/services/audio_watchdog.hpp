@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace otto::services {
+
+  struct AudioManager;
+
+  /// Notices from a thread of its own when the audio thread stops finishing buffers
+  ///
+  /// An engine stuck in a loop keeps the audio callback from returning, which no code on the
+  /// audio thread can notice. The watchdog checks @ref AudioManager::buffer_number every
+  /// @ref interval, and once it has not moved for @ref stall_limit while audio is running,
+  /// calls its handler on the watchdog thread, once per stall. The handler can then find the
+  /// node of the routing graph the audio thread is in, and have it bypassed once it returns.
+  struct AudioWatchdog {
+    /// Called with how long the audio thread has not finished a buffer
+    using OnStall = std::function<void(std::chrono::nanoseconds stalled_for)>;
+
+    using clock = std::chrono::steady_clock;
+
+    static constexpr auto interval = std::chrono::milliseconds(50);
+    static constexpr auto stall_limit = std::chrono::milliseconds(500);
+
+    /// Decides when the audio thread is stalled, from the progress of its buffer number
+    struct Detector {
+      /// Take one look at the audio thread, at `now`
+      ///
+      /// \returns how long it has been stalled, the first time it is found stalled for
+      /// @ref stall_limit, otherwise 0
+      std::chrono::nanoseconds check(unsigned buffer_number, bool running, clock::time_point now) noexcept;
+
+    private:
+      unsigned _last_buffer = 0;
+      clock::time_point _last_progress = clock::now();
+      bool _reported = false;
+    };
+
+    /// Start watching `audio`
+    AudioWatchdog(AudioManager& audio, OnStall on_stall);
+    /// Stop the watchdog thread
+    ~AudioWatchdog() noexcept;
+
+    /// The number of stalls since the watchdog was started. May be read from any thread.
+    int stall_count() const noexcept
+    {
+      return _stalls;
+    }
+
+  private:
+    void run();
+
+    AudioManager& _audio;
+    OnStall _on_stall;
+    std::atomic_int _stalls = 0;
+    Detector _detector;
+
+    std::mutex _mutex;
+    std::condition_variable _stop_cv;
+    bool _stop = false;
+    std::thread _thread;
+  };
+
+} // namespace otto::services
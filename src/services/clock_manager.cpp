@@ -1,5 +1,11 @@
 #include "clock_manager.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+#include "util/triple_buffer.hpp"
 #include "util/type_traits.hpp"
 
 namespace otto::services {
@@ -12,7 +18,10 @@ namespace otto::services {
 
   tl::optional<Client> ClockManager::request_client(Source s)
   {
-    return _client_exists[util::underlying(s)] ? tl::nullopt : tl::make_optional(Client(*this, s));
+    auto& exists = _client_exists[util::underlying(s)];
+    if (exists) return tl::nullopt;
+    exists = true;
+    return Client(*this, s);
   }
 
   Source ClockManager::active_source() const noexcept
@@ -24,41 +33,99 @@ namespace otto::services {
 
   void Client::start()
   {
-    _cm._active_source = _source;
-    _cm.start(_source);
+    _cm->_active_source = _source;
+    _cm->start(_source);
   }
 
   void Client::stop()
   {
-    _cm.stop();
+    _cm->stop();
   }
 
-  void Client::set_bpm()
+  void Client::set_bpm(float bpm)
   {
-    _cm.set_bpm();
+    _cm->set_bpm(bpm);
   }
 
   void Client::set_current(Time time)
   {
-    _cm.set_current(time);
+    _cm->set_current(time);
+  }
+
+  void Client::set_timeline(const Timeline& timeline)
+  {
+    _cm->set_timeline(timeline);
   }
 
   ClockManager& Client::clock_manager() noexcept
   {
-    return _cm;
+    return *_cm;
+  }
+
+  // MidiClockInput //
+
+  tl::optional<MidiClockInput> MidiClockInput::create(ClockManager& cm)
+  {
+    return cm.request_client(Source::midi).map([](Client c) { return MidiClockInput(c); });
+  }
+
+  bool MidiClockInput::receive(unsigned char status, double time) noexcept
+  {
+    switch (Message{status}) {
+    case Message::clock:
+      _filter.tick(time);
+      if (_filter.locked()) _client.set_bpm(bpm());
+      return true;
+    case Message::start:
+      _filter.reset();
+      _client.set_current(Time{0});
+      _client.start();
+      return true;
+    case Message::resume: _client.start(); return true;
+    case Message::stop: _client.stop(); return true;
+    default: return false;
+    }
+  }
+
+  float MidiClockInput::bpm() const noexcept
+  {
+    if (!_filter.locked() || _filter.period() <= 0) return 0;
+    return 60.0 / (_filter.period() * ClockManager::ticks_per_beat);
   }
 
   // DefaultClockManager //
 
+  /// The internal clock
+  ///
+  /// Runs from startup at a fixed tempo until stopped.
   struct DefaultClockManager : ClockManager {
     Time current_time() override;
     bool running() override;
+    float bpm() override;
+
+    void process(int nframes, int samplerate) noexcept override;
 
   protected:
     void start(Source) override;
     void stop() override;
-    void set_bpm() override;
+    void set_bpm(float) override;
     void set_current(Time) override;
+    void set_timeline(const Timeline&) override;
+
+  private:
+    /// Ease the position of the current buffer towards `timeline`
+    void follow(const Timeline& timeline) noexcept;
+
+    std::atomic<float> _bpm = 120;
+    std::atomic_bool _running = true;
+    /// The position to jump to at the start of the next buffer, in ticks, or negative
+    std::atomic<double> _seek = -1;
+    /// The start of the current buffer in beats, for other threads
+    std::atomic<float> _current_time = 0;
+    /// The count of the next tick to emit
+    long _next_tick = 0;
+    /// The timeline of the sync source. Read once per buffer while it is active.
+    util::TripleBuffer<Timeline> _timeline;
   };
 
   // ClockManager::create_default //
@@ -72,16 +139,85 @@ namespace otto::services {
 
   Time DefaultClockManager::current_time()
   {
-    return Time{0};
+    return Time{_current_time.load()};
   }
+
   bool DefaultClockManager::running()
   {
-    return false;
+    return _running;
   }
 
-  void DefaultClockManager::start(Source) {}
-  void DefaultClockManager::stop() {}
-  void DefaultClockManager::set_bpm() {}
-  void DefaultClockManager::set_current(Time) {}
+  float DefaultClockManager::bpm()
+  {
+    return _bpm;
+  }
+
+  void DefaultClockManager::process(int nframes, int samplerate) noexcept
+  {
+    // Continue from the end of the last buffer
+    _position += _nframes * _ticks_per_frame;
+    if (auto seek = _seek.exchange(-1); seek >= 0) {
+      _position = seek;
+      _next_tick = static_cast<long>(std::ceil(seek));
+    }
+    if (_active_source == Source::sync) follow(_timeline.read());
+    _ticks.clear();
+    _nframes = nframes;
+    if (!_running || samplerate <= 0) {
+      _ticks_per_frame = 0;
+      _current_time = _position / ticks_per_beat;
+      return;
+    }
+    _ticks_per_frame = _bpm / 60.0 * ticks_per_beat / samplerate;
+    // Counting ticks instead of deriving them from the position makes sure rounding errors
+    // never drop or repeat a tick at a buffer boundary
+    while (_ticks.size() < max_ticks) {
+      auto frame = std::max(0l, std::lround((_next_tick - _position) / _ticks_per_frame));
+      if (frame >= nframes) break;
+      _ticks.push_back({static_cast<int>(frame), _next_tick++});
+    }
+    _current_time = _position / ticks_per_beat;
+  }
+
+  void DefaultClockManager::start(Source)
+  {
+    _running = true;
+  }
+
+  void DefaultClockManager::stop()
+  {
+    _running = false;
+  }
+
+  void DefaultClockManager::set_bpm(float bpm)
+  {
+    if (bpm > 0) _bpm = bpm;
+  }
+
+  void DefaultClockManager::set_current(Time time)
+  {
+    _seek = static_cast<float>(time) * ticks_per_beat;
+  }
+
+  void DefaultClockManager::set_timeline(const Timeline& timeline)
+  {
+    _timeline.publish(timeline);
+  }
+
+  void DefaultClockManager::follow(const Timeline& timeline) noexcept
+  {
+    if (timeline.bpm <= 0 || !_running) return;
+    _bpm = timeline.bpm;
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    double target = timeline.beat_at(std::chrono::nanoseconds(now).count()) * ticks_per_beat;
+    double error = target - _position;
+    if (std::abs(error) > ticks_per_beat) {
+      _position = target;
+      _next_tick = static_cast<long>(std::ceil(target));
+    } else {
+      // Ticks are counted, so moving the position never drops or repeats one
+      _position += error * sync_gain;
+    }
+  }
 
 } // namespace otto::services
@@ -1,12 +1,15 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <memory>
 #include <tl/optional.hpp>
 #include <type_safe/strong_typedef.hpp>
 
 #include "core/service.hpp"
 #include "services/application.hpp"
+#include "util/local_vector.hpp"
+#include "util/time_filter.hpp"
 
 namespace otto::services {
 
@@ -14,16 +17,110 @@ namespace otto::services {
   ///
   /// The clock can be started or stopped by an internal or external source,
   /// and should be used by the sequencer, the looper, and arpeggiators.
+  ///
+  /// The audio driver advances the clock once per buffer with @ref process, before processing
+  /// the engines. The clock then holds a list of the @ref Tick "ticks" that fall inside the
+  /// buffer, with their frame offsets, so sequencing engines only need to look through that
+  /// list instead of keeping their own sample counters:
+  ///
+  /// ```cpp
+  /// for (auto& tick : ClockManager::current().ticks()) {
+  ///   if (tick.count % ticks_per_step == 0) play_step(tick.frame);
+  /// }
+  /// ```
   struct ClockManager : core::Service {
     using Time = type_safe::strong_typedef<struct TimeTag, float>;
 
     /// The source currently controling the clock.
     enum struct Source { internal, midi, sync };
 
-    /// Get the current time
+    /// The resolution of the clock. The same as midi clock.
+    static constexpr int ticks_per_beat = 24;
+
+    /// The maximum number of ticks in one buffer
+    static constexpr std::size_t max_ticks = 64;
+
+    /// A tick of the clock inside the current buffer
+    struct Tick {
+      /// The offset in frames into the buffer
+      int frame;
+      /// The number of ticks since the clock was started
+      long count;
+    };
+
+    using TickList = util::local_vector<Tick, max_ticks>;
+
+    /// A tempo, and the beat it is at at some point in time
+    ///
+    /// The @ref Source::sync client hands the clock the timeline of the session it follows, see
+    /// @ref NetworkClock.
+    struct Timeline {
+      /// The tempo, or 0 for no timeline
+      double bpm = 0;
+      /// The beat at `time_ns`
+      double beat = 0;
+      /// A time of `std::chrono::steady_clock`, in nanoseconds
+      std::int64_t time_ns = 0;
+      /// Whether the clock runs
+      bool running = true;
+
+      /// The beat at `ns`, in nanoseconds of `std::chrono::steady_clock`
+      double beat_at(std::int64_t ns) const noexcept
+      {
+        return beat + (ns - time_ns) * 1e-9 * bpm / 60;
+      }
+    };
+
+    /// How much of the distance to the timeline the clock makes up in one buffer, while it
+    /// follows a @ref Timeline
+    ///
+    /// Buffers start with some jitter, so the clock eases towards the timeline instead of
+    /// jumping to it. It jumps if it is more than a beat off.
+    static constexpr double sync_gain = 0.1;
+
+    /// Get the current time, in beats
+    ///
+    /// This is the position at the start of the current buffer. Safe to call from any thread.
     virtual Time current_time() = 0;
     /// Whether the clock is running
     virtual bool running() = 0;
+    /// The current tempo
+    virtual float bpm() = 0;
+
+    /// Advance the clock by one buffer
+    ///
+    /// Only to be called from the audio thread, at the start of every buffer, before any engine
+    /// is processed.
+    virtual void process(int nframes, int samplerate) noexcept = 0;
+
+    /// The ticks inside the current buffer, in order
+    ///
+    /// Only to be used from the audio thread. Empty while the clock is stopped.
+    const TickList& ticks() const noexcept
+    {
+      return _ticks;
+    }
+
+    /// The position of the first frame of the current buffer, in ticks
+    ///
+    /// Only to be used from the audio thread.
+    double position() const noexcept
+    {
+      return _position;
+    }
+
+    /// The frame offset into the current buffer of a position in ticks
+    ///
+    /// Only to be used from the audio thread.
+    ///
+    /// \returns `tl::nullopt` if `pos` is not inside the current buffer, or the clock is stopped
+    tl::optional<int> frame_of(double pos) const noexcept
+    {
+      if (_ticks_per_frame <= 0 || pos < _position) return tl::nullopt;
+      auto frame = static_cast<int>((pos - _position) / _ticks_per_frame);
+      if (frame >= _nframes) return tl::nullopt;
+      return frame;
+    }
 
     /// A Client managing the clock.
     ///
@@ -62,15 +159,29 @@ namespace otto::services {
     /// Set the bpm, implementation
     /// 
     /// Called by @ref Client::set_bpm
-    virtual void set_bpm() = 0;
+    virtual void set_bpm(float) = 0;
 
     /// Set current time, implementation
     /// 
     /// Called by @ref Client::set_current
     virtual void set_current(Time) = 0;
 
-    std::array<bool, 3> _client_exists;
+    /// Follow a timeline, implementation
+    ///
+    /// Called by @ref Client::set_timeline
+    virtual void set_timeline(const Timeline&) = 0;
+
+    std::array<bool, 3> _client_exists = {};
     Source _active_source = Source::internal;
+
+    /// The ticks of the current buffer. Written by @ref process.
+    TickList _ticks;
+    /// The position of the start of the current buffer, in ticks. Written by @ref process.
+    double _position = 0;
+    /// The tempo of the current buffer. Written by @ref process.
+    double _ticks_per_frame = 0;
+    /// The length of the current buffer. Written by @ref process.
+    int _nframes = 0;
   };
 
   struct ClockManager::Client {
@@ -81,22 +192,62 @@ namespace otto::services {
     void stop();
 
     /// Set the bpm
-    void set_bpm();
+    void set_bpm(float);
 
     /// Set current time
     void set_current(Time);
 
+    /// Follow `timeline` while this client's source is the active one
+    ///
+    /// The audio thread reads the latest timeline once per buffer, without waiting. Only to be
+    /// called from one thread.
+    void set_timeline(const Timeline&);
+
     /// The clock manager this client is attached to.
     ClockManager& clock_manager() noexcept;
   private:
     friend ClockManager;
 
     /// Private constructor so it can only be constructed from @ref ClockManager::request_client
-    Client(ClockManager& cm, Source source) : _cm(cm), _source(source) {}
+    Client(ClockManager& cm, Source source) : _cm(&cm), _source(source) {}
 
-    ClockManager& _cm;
+    ClockManager* _cm;
     Source _source;
   };
 
+  /// Slaves the clock to incoming midi clock
+  ///
+  /// Feed it the system real-time messages from the midi input thread. Clock messages are
+  /// filtered with a @ref util::TimeFilter to estimate the tempo, and start, continue and stop
+  /// messages control the transport, using the @ref ClockManager::Source::midi client.
+  ///
+  /// Only to be used from one thread.
+  struct MidiClockInput {
+    enum struct Message : unsigned char {
+      clock = 0xF8,
+      start = 0xFA,
+      resume = 0xFB,
+      stop = 0xFC,
+    };
+
+    /// \returns `tl::nullopt` if a client for the midi source already exists
+    static tl::optional<MidiClockInput> create(ClockManager& cm);
+
+    /// Handle a midi status byte
+    ///
+    /// \param time The arrival time of the message in seconds, as precise as available.
+    /// \returns `false` if `status` is not a real-time message handled by the clock
+    bool receive(unsigned char status, double time) noexcept;
+
+    /// The current estimate of the external tempo, or 0 if not locked yet
+    float bpm() const noexcept;
+
+  private:
+    MidiClockInput(ClockManager::Client client) : _client(client) {}
+
+    ClockManager::Client _client;
+    util::TimeFilter _filter;
+  };
+
 
 } // namespace otto::services
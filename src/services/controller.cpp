@@ -1,5 +1,7 @@
 #include "controller.hpp"
 
+#include <cmath>
+
 #include "util/iterator.hpp"
 #include "util/utility.hpp"
 
@@ -25,9 +27,9 @@ namespace otto::services {
     events.outer().push_back(KeyReleaseEvent{key});
   }
 
-  bool Controller::is_pressed(Key k) noexcept
+  bool Controller::is_pressed(Key k) const noexcept
   {
-    return keys[k._to_index()];
+    return (keys.load(std::memory_order_relaxed) >> k._to_index()) & 1;
   }
 
   void Controller::register_key_handler(Key k, KeyHandler press_handler, KeyHandler release_handler)
@@ -48,18 +50,59 @@ namespace otto::services {
     return true;
   }
 
+  void Controller::coalesce_encoder_events(EventBag& bag, std::chrono::duration<float> elapsed)
+  {
+    if (bag.empty()) return;
+    // The index in `merged` of the first event of each encoder
+    std::array<int, Encoder::_size()> first;
+    first.fill(-1);
+    EventBag merged;
+    merged.reserve(bag.size());
+    for (auto& event : bag) {
+      if (auto* ev = util::get_if<EncoderEvent>(&event)) {
+        int& idx = first[ev->encoder._to_index()];
+        if (idx >= 0) {
+          util::get<EncoderEvent>(merged[idx]).steps += ev->steps;
+          continue;
+        }
+        idx = merged.size();
+      } else {
+        // Keys like shift change what the encoders do, so turns are not merged across them
+        first.fill(-1);
+      }
+      merged.push_back(std::move(event));
+    }
+    for (auto& event : merged) {
+      if (auto* ev = util::get_if<EncoderEvent>(&event)) ev->steps = accelerated_steps(ev->steps, elapsed);
+    }
+    bag = std::move(merged);
+  }
+
+  int Controller::accelerated_steps(int steps, std::chrono::duration<float> elapsed) noexcept
+  {
+    if (steps == 0 || elapsed.count() <= 0) return steps;
+    float rate = std::abs(steps) / elapsed.count();
+    if (rate <= acceleration_rate) return steps;
+    float factor = std::min(rate / acceleration_rate, max_acceleration);
+    return std::lround(steps * factor);
+  }
+
   void Controller::flush_events()
   {
     events.swap();
+    auto now = std::chrono::steady_clock::now();
+    coalesce_encoder_events(events.inner(), now - _last_flush);
+    _last_flush = now;
+    if (!events.inner().empty()) UIManager::current().request_redraw();
     for (auto& event : events.inner()) {
       util::match(event,
                   [this](KeyPressEvent& ev) {
-                    keys[ev.key._to_index()] = true;
+                    keys.fetch_or(std::uint64_t(1) << ev.key._to_index(), std::memory_order_relaxed);
                     if (handle_global(ev.key)) return;
                     UIManager::current().current_screen().keypress(ev.key);
                   },
                   [this](KeyReleaseEvent& ev) {
-                    keys[ev.key._to_index()] = false;
+                    keys.fetch_and(~(std::uint64_t(1) << ev.key._to_index()), std::memory_order_relaxed);
                     if (handle_global(ev.key, false)) return;
                     UIManager::current().current_screen().keyrelease(ev.key);
                   },
@@ -73,7 +116,6 @@ namespace otto::services {
   // DummyController //
   struct DummyController final : Controller {
     void set_color(LED, LEDColor) override {}
-    void flush_leds() override {}
     void clear_leds() override {}
   };
 
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <better_enum.hpp>
+#include <chrono>
 #include <cstdint>
 #include <foonathan/array/flat_map.hpp>
 #include <vector>
@@ -176,6 +178,15 @@ namespace otto::services {
       return {static_cast<std::uint8_t>(r + o.r), static_cast<std::uint8_t>(g + o.g), static_cast<std::uint8_t>(b + o.b)};
     }
 
+    bool operator==(LEDColor o) const noexcept
+    {
+      return r == o.r && g == o.g && b == o.b;
+    }
+    bool operator!=(LEDColor o) const noexcept
+    {
+      return !(*this == o);
+    }
+
     static const LEDColor Black;
     static const LEDColor White;
     static const LEDColor Blue;
@@ -192,6 +203,60 @@ namespace otto::services {
   inline const LEDColor LEDColor::Yellow = 0x888800;
   inline const LEDColor LEDColor::Red = 0xFF0000;
 
+  /// The colours of the LEDs, set from any thread, and sent to the hardware by one
+  ///
+  /// Each colour is packed into an atomic word, so setting or reading it is a single exchange or
+  /// load, and never locks. A mask of the LEDs changed since the sending thread last took it
+  /// lets that thread send only those.
+  struct LEDBuffer {
+    static_assert(Key::_size() <= 64, "The masks have a bit for each key");
+
+    /// Set the colour of `led`
+    ///
+    /// \returns whether it changed
+    bool set(LED led, LEDColor color) noexcept
+    {
+      const int i = led.key._to_index();
+      if (_colors[i].exchange(pack(color), std::memory_order_relaxed) == pack(color)) return false;
+      _changed.fetch_or(std::uint64_t(1) << i, std::memory_order_release);
+      return true;
+    }
+
+    LEDColor get(Key key) const noexcept
+    {
+      return unpack(_colors[key._to_index()].load(std::memory_order_relaxed));
+    }
+
+    /// Set all LEDs to black
+    void clear() noexcept
+    {
+      for (auto key : Key::_values()) set(LED{key}, LEDColor::Black);
+    }
+
+    /// The LEDs changed since the last call, as a bit for each index of their key
+    ///
+    /// Only to be called by the thread sending the colours. The colours of the LEDs are at least
+    /// as new as the changes.
+    std::uint64_t take_changed() noexcept
+    {
+      return _changed.exchange(0, std::memory_order_acquire);
+    }
+
+  private:
+    static std::uint32_t pack(LEDColor c) noexcept
+    {
+      return (c.r << 16) | (c.g << 8) | c.b;
+    }
+
+    static LEDColor unpack(std::uint32_t rgb) noexcept
+    {
+      return rgb;
+    }
+
+    std::array<std::atomic<std::uint32_t>, Key::_size()> _colors = {};
+    std::atomic<std::uint64_t> _changed = 0;
+  };
+
   struct Controller : core::Service {
     /// Function type for key handlers
     using KeyHandler = std::function<void(Key k)>;
@@ -207,15 +272,42 @@ namespace otto::services {
 
     /// Actually executes the key and encoder events
     ///
+    /// The encoder events since the last call are coalesced, and accelerated, see
+    /// @ref coalesce_encoder_events, so a fast turn steps a property once per frame, not once per
+    /// detent.
+    ///
     /// Should only be called by graphics thread, once per frame
     void flush_events();
 
+    /// Merge the events of each encoder into the first of them, with the sum of their steps
+    ///
+    /// Events are not merged across key events, which stay in place. The steps are then scaled
+    /// by @ref accelerated_steps, for the `elapsed` time the events were collected over.
+    static void coalesce_encoder_events(EventBag& events, std::chrono::duration<float> elapsed);
+
+    /// The steps to apply for an encoder that turned `steps` detents in `elapsed` time
+    ///
+    /// Up to @ref acceleration_rate detents per second, the steps are passed on as they are, to
+    /// keep the precision of single detents. Above, they are multiplied by the rate over
+    /// @ref acceleration_rate, up to @ref max_acceleration times.
+    static int accelerated_steps(int steps, std::chrono::duration<float> elapsed) noexcept;
+
+    /// The turning speed in detents per second above which encoder steps are accelerated
+    static constexpr float acceleration_rate = 50;
+    static constexpr float max_acceleration = 8;
+
+    /// Set the colour of an LED
+    ///
+    /// Does no I/O, so it can be called from the UI thread. Controllers send the changed LEDs
+    /// from their own thread.
     virtual void set_color(LED, LEDColor) = 0;
-    virtual void flush_leds() = 0;
     virtual void clear_leds() = 0;
 
     /// Check if a key is currently pressed.
-    bool is_pressed(Key k) noexcept;
+    ///
+    /// Safe to call from any thread. The keys are updated by @ref flush_events, as their events
+    /// are handled.
+    bool is_pressed(Key k) const noexcept;
 
     /// Register a key handler
     void register_key_handler(Key k, KeyHandler press_handler, KeyHandler release_handler = nullptr);
@@ -248,8 +340,10 @@ namespace otto::services {
     bool handle_global(Key key, bool is_press = true);
 
     foonathan::array::flat_map<Key, std::pair<KeyHandler, KeyHandler>> key_handlers;
-    std::array<bool, Key::_size()> keys;
+    /// A bit for each index of a key, set while it is pressed
+    std::atomic<std::uint64_t> keys = 0;
     util::double_buffered<EventBag> events;
+    std::chrono::steady_clock::time_point _last_flush;
   };
 } // namespace otto::services
 
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "core/engine/engine_dispatcher.hpp"
+
+#include "engines/fx/chorus/chorus.hpp"
+#include "engines/fx/convolution/convolution.hpp"
+#include "engines/fx/delay/delay.hpp"
+#include "engines/fx/rotary/rotary.hpp"
+#include "engines/fx/wormhole/wormhole.hpp"
+#include "engines/seq/arp/arp.hpp"
+#include "engines/seq/euclid/euclid.hpp"
+#include "engines/synths/OTTOFM/ottofm.hpp"
+#include "engines/synths/goss/goss.hpp"
+#include "engines/synths/potion/potion.hpp"
+#include "engines/synths/rhodes/rhodes.hpp"
+
+namespace otto::services {
+
+  /// The engines selectable in the slots of the default engine manager
+  ///
+  /// Also used by the engine tests, so they test every engine the device can play. Include
+  /// `core/engine/engine_dispatcher.inl` to instantiate them.
+  using EffectsDispatcher = core::engine::EngineDispatcher< //
+    core::engine::EngineType::effect,
+    engines::Wormhole,
+    engines::Chorus,
+    engines::Convolution,
+    engines::Rotary,
+    engines::Delay>;
+  using ArpDispatcher = core::engine::EngineDispatcher< //
+    core::engine::EngineType::arpeggiator,
+    engines::Euclid,
+    engines::Arp>;
+  using SynthDispatcher = core::engine::EngineDispatcher< //
+    core::engine::EngineType::synth,
+    engines::GossSynth,
+    engines::RhodesSynth,
+    engines::PotionSynth,
+    engines::OTTOFMSynth>;
+
+} // namespace otto::services
@@ -1,23 +1,36 @@
 #include "engine_manager.hpp"
-#include "core/engine/engine_dispatcher.hpp"
 #include "core/engine/engine_dispatcher.inl"
 
-#include <engines/synths/goss/goss.hpp>
-#include <engines/synths/potion/potion.hpp>
-#include "core/engine/sequencer.hpp"
-#include "engines/fx/chorus/chorus.hpp"
-#include "engines/fx/wormhole/wormhole.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include <fmt/format.h>
+
+#include "engines/misc/drums/drums.hpp"
+#include "engines/misc/looper/looper.hpp"
 #include "engines/misc/master/master.hpp"
 #include "engines/misc/sends/sends.hpp"
-#include "engines/seq/arp/arp.hpp"
-#include "engines/seq/euclid/euclid.hpp"
-#include "engines/synths/OTTOFM/ottofm.hpp"
-#include "engines/synths/potion/potion.hpp"
-#include "engines/synths/rhodes/rhodes.hpp"
+#include "engines/misc/sidechain/sidechain.hpp"
 
 #include "services/application.hpp"
-
+#include "services/audio_watchdog.hpp"
+#include "services/clock_manager.hpp"
+#include "services/engine_dispatchers.hpp"
+#include "services/input_recorder.hpp"
+#include "services/log_manager.hpp"
+
+#include "core/audio/send_matrix.hpp"
+#include "core/audio/spectrum_analyser.hpp"
+#include "core/engine/midi_learn.hpp"
+#include "core/engine/routing_graph.hpp"
+#include "core/engine/undo_history.hpp"
 #include "core/ui/vector_graphics.hpp"
+#include "util/async_file_writer.hpp"
+#include "util/audio.hpp"
+#include "util/dsp/output_guard.hpp"
+#include "util/task_graph.hpp"
+#include "util/timer.hpp"
 
 namespace otto::services {
 
@@ -25,39 +38,256 @@ namespace otto::services {
   using namespace core::engine;
 
   struct DefaultEngineManager final : EngineManager {
-    DefaultEngineManager();
+    DefaultEngineManager(int worker_count = graph_worker_count());
 
     void start() override;
     audio::ProcessData<2> process(audio::ProcessData<1> external_in) override;
     IEngine* by_name(const std::string& name) noexcept override;
+    void take_cpu_usage(std::vector<util::CpuUsage>& out) override;
+    void save_slot(int slot) override;
+    void recall_slot(int slot, bool quantized = true) override;
+    void update() override;
+    ParameterQueue* parameter_queue() noexcept override
+    {
+      return &parameters;
+    }
+    bool undo() override
+    {
+      return undo_history.undo();
+    }
+    bool redo() override
+    {
+      return undo_history.redo();
+    }
 
   private:
-    std::unordered_map<std::string, std::function<IEngine*()>> engineGetters;
-
-    using EffectsDispatcher = EngineDispatcher< //
-      EngineType::effect,
-      engines::Wormhole,
-      engines::Chorus>;
-    using ArpDispatcher = EngineDispatcher< //
-      EngineType::arpeggiator,
-      engines::Euclid,
-      engines::Arp>;
-    using SynthDispatcher = EngineDispatcher< //
-      EngineType::synth,
-      engines::GossSynth,
-      engines::RhodesSynth,
-      engines::PotionSynth,
-      engines::OTTOFMSynth>;
-
-    SynthDispatcher synth{false};
+    /// The number of synths, each listening to a midi channel, and rendered by a node of its
+    /// own, so they can run on separate cores
+    static constexpr int synth_count = 3;
+
+    /// The maximum number of pool buffers in use at the same time during `process`.
+    ///
+    /// Input and its copies for the sends (2), the input copy, stereo output and voice scratch
+    /// of each synth, and the stereo output and scratch of the second half of its voices when
+    /// they are rendered in parallel (8 per synth) and their sum (2), the four buses of the sends
+    /// (4), the stereo outputs of both effects (4) and of the drums (2), the two inputs of the
+    /// sidechain key (2), plus a few spare for the engines' own temporaries, and the input copy
+    /// and stereo output of an effect being crossfaded out after switching engines (3).
+    static constexpr int peak_buffer_count = 21 + 8 * synth_count;
+
+    /// A synth, and the midi channel it listens to
+    struct SynthPart {
+      /// Listens to all channels
+      static constexpr int omni = -1;
+      /// Listens to no channel, and is not processed
+      static constexpr int off = -2;
+
+      SynthDispatcher dispatcher{false};
+      /// The midi channel from 0 to 15, or `omni` or `off`. Set by the UI thread.
+      std::atomic<int> channel = off;
+      /// The channel the audio thread listened to last, to release the held notes when it
+      /// changes
+      int last_channel = off;
+      /// The events of the shared midi buffer on `channel`
+      midi::MidiBuffer midi;
+    };
+
+    std::array<SynthPart, synth_count> synths;
+    /// The part shown by the synth screens
+    int focused_synth = 0;
+
+    /// The synth shown by the synth screens
+    SynthDispatcher& synth() noexcept
+    {
+      return synths[focused_synth].dispatcher;
+    }
+
+    /// Lists the synths, to pick the one the synth screens show, and their midi channels
+    struct SynthPartsScreen;
+    std::unique_ptr<core::ui::Screen> synth_parts_screen;
     ArpDispatcher arpeggiator{true};
     EffectsDispatcher effect1{true};
     EffectsDispatcher effect2{true};
 
     engines::Sends synth_send;
-    engines::Sends line_in_send;
+    engines::Sends line_in_send{true};
+    /// The two sides of the synth and the line input, to the buses of @ref engines::Sends::Bus
+    audio::SendMatrix<3, engines::Sends::bus_count> send_matrix;
+    engines::Sidechain sidechain;
+    engines::Drums drums;
+    engines::Looper looper;
     engines::Master master;
-    // engines::Sequencer sequencer;
+    /// Keeps NaNs, DC and overs from the DAC, after the master
+    dsp::OutputGuard output_guard;
+
+    /// Shows the spectrum of the output of the master, on shift + master
+    audio::SpectrumAnalyser analyser{Application::current().audio_manager->samplerate()};
+
+    /// The number of worker threads for the routing graph.
+    ///
+    /// The synths run in parallel, and so do the two effects, so a worker per synth at most is
+    /// useful. One core is left to the UI, and on a single core, the graph runs serially.
+    /// `OTTO_GRAPH_WORKERS` overrides this, like for the renders of a batch, which each get a
+    /// core.
+    static int graph_worker_count() noexcept
+    {
+      if (const char* workers = std::getenv("OTTO_GRAPH_WORKERS")) {
+        return std::clamp(std::atoi(workers), 0, synth_count);
+      }
+      int cores = std::thread::hardware_concurrency();
+      return cores > 1 ? std::clamp(cores - 2, 1, synth_count) : 0;
+    }
+
+    /// Set up the default routing of the engines
+    void build_routing();
+
+    /// Capture the outputs of the routing nodes named in `OTTO_CAPTURE`
+    ///
+    /// `OTTO_CAPTURE` is a comma separated list of nodes, like `Input,Synth,Master`. The
+    /// captures keep the last `OTTO_CAPTURE_SECONDS` (default 30) seconds, and shift +
+    /// sequencer writes them to `data/captures`. With `OTTO_CAPTURE_STREAM=1`, they write
+    /// everything instead, in chunks of that length. With `OTTO_CAPTURE_RECORD=1`, each writes
+    /// everything to one file, for recording a whole set, like the `Master` and the stems of
+    /// `Sends`, buffering that many seconds for stalls of the disk.
+    void setup_captures();
+
+    /// Record the midi and property changes to the file at `OTTO_RECORD_INPUT`, if it is set
+    ///
+    /// Replay the recording with the offline renderer, like `otto <file> out.wav`.
+    void setup_input_recorder();
+    std::unique_ptr<InputRecorder> input_recorder;
+
+    /// Outlive the routing graph, which writes to them
+    std::vector<std::unique_ptr<util::AudioCapture>> captures;
+    RoutingGraph routing{Application::current().audio_manager->buffer_pool()};
+    util::WorkerPool workers;
+
+    /// A node of the routing graph that processes an engine dispatcher
+    struct GuardedNode {
+      RoutingGraph::NodeId node;
+      IEngineDispatcher* dispatcher;
+      /// The resets in a row, each within @ref reset_window of the previous one
+      int resets = 0;
+      std::chrono::steady_clock::time_point last_reset;
+      /// The engine that kept faulting after @ref max_resets, which stays bypassed until
+      /// another engine is selected
+      const IEngine* given_up = nullptr;
+    };
+    /// The most times an engine is reset in a row, before it is left bypassed
+    static constexpr int max_resets = 3;
+    static constexpr auto reset_window = std::chrono::seconds(10);
+    /// A node taking this long for one buffer is faulted
+    static constexpr auto overrun_limit = std::chrono::milliseconds(100);
+    std::vector<GuardedNode> guarded_nodes;
+    /// Log the faults of the guarded nodes, with the name of their engine, and reset the
+    /// engine to recover. Called by @ref update.
+    void recover_faulted_nodes();
+    /// Bypasses the node the audio thread is stuck in, once it returns
+    std::unique_ptr<AudioWatchdog> watchdog;
+
+    /// The engines stored in a slot, by their name in the state. The synths after the first
+    /// come last, so the indices of the other parts stay the same.
+    static constexpr std::array<const char*, 6 + synth_count> slot_parts = {
+      "Synth", "Effect1", "Effect2", "Arpeggiator", "Master", "Looper", "Drums", "Synth2", "Synth3"};
+    /// The part of the second synth
+    static constexpr int second_synth_part = 7;
+
+    /// The name of synth `index` in the slots, the state and the routing graph
+    static const char* synth_name(int index) noexcept
+    {
+      return slot_parts[index == 0 ? 0 : second_synth_part + index - 1];
+    }
+
+    /// Quantized recalls happen on the first beat of a bar of this many beats
+    static constexpr int beats_per_bar = 4;
+
+    struct Slot {
+      /// `{"<part>": {"engine": "<name>", "state": <engine.to_json()>}, ...}`
+      nlohmann::json data;
+      /// The engine each snapshot was parsed for, or `nullptr` if it has not been parsed
+      std::array<IEngine*, slot_parts.size()> parsed_for = {};
+      std::array<props::Snapshot, slot_parts.size()> snapshots;
+
+      bool empty() const noexcept
+      {
+        return data.is_null();
+      }
+    };
+
+    /// The engine currently in part `part` of the slots
+    IEngine& slot_engine(int part) noexcept;
+    /// The dispatcher of part `part`, or `nullptr` for the engines that are always there
+    IEngineDispatcher* slot_dispatcher(int part) noexcept;
+    /// Parse the snapshots of the parts of `slot` saved from the current engines
+    ///
+    /// \returns whether any part was parsed
+    bool parse_slot(Slot& slot);
+    /// Select the engines of `slot`, and apply its snapshots
+    void apply_slot(Slot& slot);
+    fs::path slot_path(int slot) const;
+    /// Read the slot files. They are parsed one per frame by @ref update, once the audio runs.
+    void load_slots();
+
+    std::array<Slot, slot_count> _slots;
+    /// The slot to recall once the clock reaches `_recall_at`, or -1
+    int _pending_slot = -1;
+    float _recall_at = 0;
+    util::AsyncFileWriter _slot_writer;
+
+    /// Maps midi controllers to the properties of the engines of each slot part
+    MidiLearn midi_learn{std::vector<std::string>(slot_parts.begin(), slot_parts.end())};
+    /// Learn a controller for the property that was changed last, or stop learning
+    void learn_last_changed();
+
+    /// Changes of properties of the slot parts from remote control
+    ParameterQueue parameters{std::vector<std::string>(slot_parts.begin(), slot_parts.end())};
+
+    /// The edits of properties of the slot parts on the UI thread
+    UndoHistory undo_history{std::vector<std::string>(slot_parts.begin(), slot_parts.end()),
+                             [this](int part) { return &slot_engine(part); }};
+  };
+
+  struct DefaultEngineManager::SynthPartsScreen : core::ui::Screen {
+    SynthPartsScreen(DefaultEngineManager& em) : em(em) {}
+
+    void encoder(core::ui::EncoderEvent e) override
+    {
+      switch (e.encoder) {
+        case core::ui::Encoder::blue:
+          em.focused_synth = std::clamp(em.focused_synth + e.steps, 0, synth_count - 1);
+          break;
+        case core::ui::Encoder::green: {
+          auto& channel = em.synths[em.focused_synth].channel;
+          channel = std::clamp(channel + e.steps, int(SynthPart::off), 15);
+          Application::current().state_manager->mark_dirty("Engines");
+          break;
+        }
+        default: break;
+      }
+    }
+
+    void draw(core::ui::vg::Canvas& ctx) override
+    {
+      using namespace core::ui::vg;
+      ctx.font(Fonts::Norm, 30);
+      for (int i = 0; i < synth_count; i++) {
+        auto& part = em.synths[i];
+        float y = 60 + 50 * i;
+        ctx.fillStyle(i == em.focused_synth ? Colours::Blue : Colours::Gray50);
+        ctx.textAlign(HorizontalAlign::Left, VerticalAlign::Middle);
+        ctx.fillText(std::string(part.dispatcher.current().name()), {30, y});
+        int channel = part.channel;
+        ctx.fillStyle(channel == SynthPart::off ? Colours::Gray50 : Colours::Green);
+        ctx.textAlign(HorizontalAlign::Right, VerticalAlign::Middle);
+        ctx.fillText(channel == SynthPart::off ? std::string("off")
+                                               : channel == SynthPart::omni ? std::string("all")
+                                                                            : fmt::format("ch {}", channel + 1),
+                     {290, y});
+      }
+    }
+
+  private:
+    DefaultEngineManager& em;
   };
 
   std::unique_ptr<EngineManager> EngineManager::create_default()
@@ -65,38 +295,44 @@ namespace otto::services {
     return std::make_unique<DefaultEngineManager>();
   }
 
-  DefaultEngineManager::DefaultEngineManager()
+  std::unique_ptr<EngineManager> EngineManager::create_hosted()
+  {
+    return std::make_unique<DefaultEngineManager>(0);
+  }
+
+  DefaultEngineManager::DefaultEngineManager(int worker_count) : workers(worker_count)
   {
     auto& ui_manager = *Application::current().ui_manager;
     auto& state_manager = *Application::current().state_manager;
     auto& controller = *Application::current().controller;
 
-    engineGetters.try_emplace("Synth", [&]() { return &synth.current(); });
-    engineGetters.try_emplace("Effect1", [&]() { return &effect1.current(); });
-    engineGetters.try_emplace("Effect2", [&]() { return &effect2.current(); });
-    engineGetters.try_emplace("Arpeggiator", [&]() { return &arpeggiator.current(); });
+    synths[0].channel = SynthPart::omni;
+    synth_parts_screen = core::ui::make_screen<SynthPartsScreen>(*this);
+
+    Application::current().audio_manager->buffer_pool().set_capacity(peak_buffer_count);
 
     auto reg_ss = [&](auto se, auto&& f) { return ui_manager.register_screen_selector(se, f); };
 
     reg_ss(ScreenEnum::sends, [&]() -> auto& { return synth_send.screen(); });
-    // reg_ss(ScreenEnum::routing, );
+    reg_ss(ScreenEnum::external, [&]() -> auto& { return line_in_send.screen(); });
+    reg_ss(ScreenEnum::routing, [&]() -> auto& { return sidechain.screen(); });
     reg_ss(ScreenEnum::fx1, [&]() -> auto& { return effect1->screen(); });
     reg_ss(ScreenEnum::fx1_selector, [&]() -> auto& { return effect1.selector_screen(); });
     reg_ss(ScreenEnum::fx2, [&]() -> auto& { return effect2->screen(); });
     reg_ss(ScreenEnum::fx2_selector, [&]() -> auto& { return effect2.selector_screen(); });
-    // reg_ss(ScreenEnum::looper,         [&] () -> auto& { return  ; });
+    reg_ss(ScreenEnum::looper, [&]() -> auto& { return looper.screen(); });
     reg_ss(ScreenEnum::arp, [&]() -> auto& { return arpeggiator->screen(); });
     reg_ss(ScreenEnum::arp_selector, [&]() -> auto& { return arpeggiator.selector_screen(); });
-    reg_ss(ScreenEnum::voices, [&]() -> auto& { return synth->voices_screen(); });
+    reg_ss(ScreenEnum::voices, [&]() -> auto& { return synth()->voices_screen(); });
     reg_ss(ScreenEnum::master, [&]() -> auto& { return master.screen(); });
-    // reg_ss(ScreenEnum::sequencer,      [&] () -> auto& { return  ; });
+    reg_ss(ScreenEnum::sequencer, [&]() -> auto& { return drums.screen(); });
     // reg_ss(ScreenEnum::sampler,        [&] () -> auto& { return  ; });
-    reg_ss(ScreenEnum::synth, [&]() -> auto& { return synth->screen(); });
-    reg_ss(ScreenEnum::synth_selector, [&]() -> auto& { return synth.selector_screen(); });
-    reg_ss(ScreenEnum::envelope, [&]() -> auto& { return synth->envelope_screen(); });
-    // reg_ss(ScreenEnum::settings,       [&] () -> auto& { return  ; });
-    // reg_ss(ScreenEnum::external,       [&] () -> auto& { return  ; });
-    // reg_ss(ScreenEnum::twist1,         [&] () -> auto& { return  ; });
+    reg_ss(ScreenEnum::synth, [&]() -> auto& { return synth()->screen(); });
+    reg_ss(ScreenEnum::synth_selector, [&]() -> auto& { return synth().selector_screen(); });
+    reg_ss(ScreenEnum::envelope, [&]() -> auto& { return synth()->envelope_screen(); });
+    reg_ss(ScreenEnum::settings, [&]() -> auto& { return Application::current().audio_manager->settings_screen(); });
+    reg_ss(ScreenEnum::analyser, [&]() -> auto& { return analyser.screen(); });
+    reg_ss(ScreenEnum::twist1, [&]() -> auto& { return *synth_parts_screen; });
     // reg_ss(ScreenEnum::twist2,         [&] () -> auto& { return  ; });
 
     controller.register_key_handler(ui::Key::arp, [&](ui::Key k) {
@@ -139,15 +375,43 @@ namespace otto::services {
       }
     });
 
-    // controller.register_key_handler(ui::Key::sequencer, [&](ui::Key k) {
-    //     ui_manager.display(sequencer.screen());
-    // });
+    controller.register_key_handler(ui::Key::twist1,
+                                    [&](ui::Key k) { ui_manager.display(ScreenEnum::twist1); });
+
+    controller.register_key_handler(ui::Key::routing,
+                                    [&](ui::Key k) { ui_manager.display(ScreenEnum::routing); });
+
+    controller.register_key_handler(ui::Key::looper,
+                                    [&](ui::Key k) { ui_manager.display(ScreenEnum::looper); });
+
+    controller.register_key_handler(ui::Key::sequencer, [&](ui::Key k) {
+      if (controller.is_pressed(ui::Key::shift)) {
+        for (auto& capture : captures) capture->request_dump();
+      } else {
+        ui_manager.display(ScreenEnum::sequencer);
+      }
+    });
+
+    controller.register_key_handler(ui::Key::settings, [&](ui::Key k) {
+      if (controller.is_pressed(ui::Key::shift)) {
+        ui_manager.show_hud = !ui_manager.show_hud;
+        ui_manager.request_redraw();
+      } else {
+        ui_manager.display(ScreenEnum::settings);
+      }
+    });
 
     static ScreenEnum master_last_screen = ScreenEnum::master;
     static ScreenEnum send_last_screen = ScreenEnum::sends;
 
+    // Shift + master shows the analyser, which stays after the key is released
     controller.register_key_handler(ui::Key::master,
                                     [&](ui::Key k) {
+                                      if (controller.is_pressed(ui::Key::shift)) {
+                                        master_last_screen = ScreenEnum::analyser;
+                                        ui_manager.display(ScreenEnum::analyser);
+                                        return;
+                                      }
                                       master_last_screen = ui_manager.state.current_screen;
                                       ui_manager.display(ScreenEnum::master);
                                     },
@@ -156,9 +420,16 @@ namespace otto::services {
                                         ui_manager.display(master_last_screen);
                                     });
 
+    // Shift + sends shows the sends of the line input
     controller.register_key_handler(ui::Key::sends,
                                     [&](ui::Key k) {
                                       send_last_screen = ui_manager.state.current_screen;
+                                      if (controller.is_pressed(ui::Key::shift)) {
+                                        ui_manager.state.active_channel = ChannelEnum::external;
+                                        ui_manager.display(ScreenEnum::external);
+                                        return;
+                                      }
+                                      ui_manager.state.active_channel = ChannelEnum::internal;
                                       ui_manager.display(ScreenEnum::sends);
                                     },
                                     [&](ui::Key k) {
@@ -166,54 +437,371 @@ namespace otto::services {
                                     });
 
     auto load = [&](nlohmann::json& data) {
-      synth.from_json(data["Synth"]);
+      synths[0].dispatcher.from_json(data["Synth"]);
+      for (int i = 1; i < synth_count; i++) {
+        if (data.find(synth_name(i)) != data.end()) synths[i].dispatcher.from_json(data[synth_name(i)]);
+      }
+      if (auto& channels = data["SynthChannels"]; channels.is_array()) {
+        for (int i = 0; i < std::min<int>(synth_count, channels.size()); i++) {
+          synths[i].channel = channels[i].get<int>();
+        }
+      }
       effect1.from_json(data["Effect1"]);
       effect2.from_json(data["Effect2"]);
       master.from_json(data["Master"]);
+      looper.from_json(data["Looper"]);
+      drums.from_json(data["Drums"]);
       arpeggiator.from_json(data["Arpeggiator"]);
+      sidechain.from_json(data["Sidechain"]);
     };
 
     auto save = [&] {
-      return nlohmann::json({{"Synth", synth.to_json()},
-                             {"Effect1", effect1.to_json()},
-                             {"Effect2", effect2.to_json()},
-                             {"Master", master.to_json()},
-                             {"Arpeggiator", arpeggiator.to_json()}});
+      auto res = nlohmann::json({{"Effect1", effect1.to_json()},
+                                 {"Effect2", effect2.to_json()},
+                                 {"Master", master.to_json()},
+                                 {"Looper", looper.to_json()},
+                                 {"Drums", drums.to_json()},
+                                 {"Arpeggiator", arpeggiator.to_json()},
+                                 {"Sidechain", sidechain.to_json()}});
+      auto& channels = res["SynthChannels"] = nlohmann::json::array();
+      for (int i = 0; i < synth_count; i++) {
+        res[synth_name(i)] = synths[i].dispatcher.to_json();
+        channels.push_back(synths[i].channel.load());
+      }
+      return res;
     };
 
     state_manager.attach("Engines", load, save);
+
+    // Slots + C key recalls a slot, and slots + shift + C key saves it. Without the slots
+    // key, the channel keys go to the screen as usual.
+    for (int i = 0; i < slot_count; i++) {
+      controller.register_key_handler(
+        ui::Key::_from_integral(ui::Key::C0 + i),
+        [&, i](ui::Key k) {
+          if (!controller.is_pressed(ui::Key::slots)) {
+            ui_manager.current_screen().keypress(k);
+          } else if (controller.is_pressed(ui::Key::shift)) {
+            save_slot(i);
+          } else {
+            recall_slot(i);
+          }
+        },
+        [&](ui::Key k) {
+          if (!controller.is_pressed(ui::Key::slots)) ui_manager.current_screen().keyrelease(k);
+        });
+    }
+
+    Application::current().events.post_init.subscribe([this] { load_slots(); });
+
+    // External learns a midi controller for the property that was changed last, and
+    // shift + external removes all mappings
+    controller.register_key_handler(ui::Key::external, [&](ui::Key k) {
+      if (controller.is_pressed(ui::Key::shift)) {
+        midi_learn.clear();
+        state_manager.mark_dirty("MidiLearn");
+      } else {
+        learn_last_changed();
+      }
+    });
+
+    state_manager.attach("MidiLearn", [&](nlohmann::json& data) { midi_learn.from_json(data); },
+                         [&] { return midi_learn.to_json(); });
+
+    Application::current().audio_manager->events.samplerate_change.subscribe([this](int samplerate) {
+      for (auto* dispatcher : std::initializer_list<IEngineDispatcher*>{&arpeggiator, &effect1, &effect2}) {
+        dispatcher->samplerate_changed(samplerate);
+      }
+      for (auto& part : synths) part.dispatcher.samplerate_changed(samplerate);
+      for (auto* engine :
+           std::initializer_list<IEngine*>{&synth_send, &line_in_send, &sidechain, &drums, &looper, &master}) {
+        engine->samplerate_changed(samplerate);
+      }
+      analyser.samplerate(samplerate);
+    });
+
+    build_routing();
+    setup_captures();
+    setup_input_recorder();
+  }
+
+  void DefaultEngineManager::build_routing()
+  {
+    auto arp_node = routing.add_arpeggiator(
+      "Arpeggiator", [this](audio::ProcessData<0> data) {
+        TIME_SCOPE("Arpeggiator");
+        return arpeggiator.process(data);
+      });
+    // Each synth gets the events on its channel, in a buffer of its own, so they can run in
+    // parallel
+    std::array<RoutingGraph::NodeId, synth_count> synth_nodes;
+    for (int i = 0; i < synth_count; i++) {
+      auto& part = synths[i];
+      synth_nodes[i] = routing.add_synth(synth_name(i), [&part](audio::ProcessData<1> data) {
+        TIME_SCOPE("Synth");
+        int channel = part.channel.load(std::memory_order_relaxed);
+        part.midi.clear();
+        if (channel != part.last_channel) {
+          // Release the notes held on the previous channel
+          for (int key = 0; key < 128; key++) {
+            part.midi.push_back(midi::NoteOffEvent(key, 1, std::max(part.last_channel, 0)));
+          }
+          part.last_channel = channel;
+        } else if (channel == SynthPart::off) {
+          auto silence = data.context->pool().allocate_multi_clear<2>();
+          for (auto& side : silence) side.mark_silent();
+          return data.redirect(std::move(silence));
+        }
+        if (channel != SynthPart::off) midi::copy_channel(data.midi, part.midi, channel);
+        data.midi = part.midi;
+        return part.dispatcher.process_stereo(std::move(data));
+      });
+      guarded_nodes.push_back({synth_nodes[i], &part.dispatcher});
+    }
+    auto fx1_node = routing.add_effect(
+      "Effect1", [this](audio::ProcessData<1> data) {
+        TIME_SCOPE("Effect1");
+        return effect1.process(std::move(data));
+      });
+    auto fx2_node = routing.add_effect(
+      "Effect2", [this](audio::ProcessData<1> data) {
+        TIME_SCOPE("Effect2");
+        return effect2.process(std::move(data));
+      });
+    // A dry patch leaves the effects without input, and once their tails have died out they
+    // are not processed. Longer than the predelay of the convolution reverb.
+    const int fx_sleep_frames = Application::current().audio_manager->samplerate() / 2;
+    routing.sleep_when_silent(fx1_node, fx_sleep_frames, [this] { return effect1.switching(); });
+    routing.sleep_when_silent(fx2_node, fx_sleep_frames, [this] { return effect2.switching(); });
+    guarded_nodes.push_back({arp_node, &arpeggiator});
+    guarded_nodes.push_back({fx1_node, &effect1});
+    guarded_nodes.push_back({fx2_node, &effect2});
+
+    // Picks the bus the sidechain listens to, from the drums and the line input
+    auto key_node = routing.add_node("Sidechain key", 2, 1, [this](RoutingGraph::NodeData& data) {
+      auto& drums = *data.inputs[0];
+      auto& line_in = *data.inputs[1];
+      switch (engines::Sidechain::Source(sidechain.props.source.get())) {
+      case engines::Sidechain::Source::drums: data.outputs[0] = std::move(drums); break;
+      case engines::Sidechain::Source::line_in: data.outputs[0] = std::move(line_in); break;
+      case engines::Sidechain::Source::both:
+        if (!line_in.is_silent()) {
+          util::audio::kernels().add(line_in.data(), drums.data(), data.nframes);
+          drums.mark_silent(false);
+        }
+        data.outputs[0] = std::move(drums);
+        break;
+      }
+    });
+
+    // Ducks both sides of the synth by the key, before they are split into the sends and the dry
+    // mix
+    auto sidechain_node = routing.add_node("Sidechain", 3, 2, [this](RoutingGraph::NodeData& data) {
+      auto& left = *data.inputs[0];
+      auto& right = *data.inputs[1];
+      sidechain.process({data.inputs[2]->data(), data.nframes}, {left.data(), data.nframes},
+                        {right.data(), data.nframes});
+      data.outputs[0] = std::move(left);
+      data.outputs[1] = std::move(right);
+    });
+
+    // Sends the synth and the line input to the two effect busses, and the dry mix in stereo.
+    // Only the sends that add something are mixed, so a dry patch sends marked silence.
+    constexpr int bus_count = engines::Sends::bus_count;
+    auto sends_node = routing.add_node("Sends", 3, bus_count, [this](RoutingGraph::NodeData& data) {
+      auto& left = *data.inputs[0];
+      auto& right = *data.inputs[1];
+      auto& line_in = *data.inputs[2];
+      line_in_send.meter_input(line_in.data(), data.nframes);
+      auto& pool = data.context->pool();
+      send_matrix.set(0, synth_send.gains(engines::Sends::Input::left));
+      send_matrix.set(1, synth_send.gains(engines::Sends::Input::right));
+      send_matrix.set(2, line_in_send.gains());
+      std::array<float*, bus_count> buses;
+      for (int b = 0; b < bus_count; b++) {
+        buses[b] = data.outputs[b].emplace(pool.allocate()).data();
+      }
+      auto source = [](auto& buf) -> const float* { return buf.is_silent() ? nullptr : buf.data(); };
+      auto silent = send_matrix.process({source(left), source(right), source(line_in)}, buses, data.nframes);
+      for (int b = 0; b < bus_count; b++) data.outputs[b]->mark_silent(silent[b]);
+    });
+
+    // The drums have no inputs, so they run in parallel to the synth and effects. They are
+    // played by the clock, not midi, like the looper and the master, which read none of it.
+    auto drums_node = routing.add_node(
+      "Drums", 0, 2,
+      [this](RoutingGraph::NodeData& data) {
+        auto out = drums.process({*data.midi, data.nframes, data.context});
+        auto& right = data.outputs[1].emplace(data.context->pool().allocate());
+        std::copy(out.audio.begin(), out.audio.end(), right.begin());
+        data.outputs[0] = std::move(out.audio);
+      },
+      midi::EventMask::none);
+
+    // Records and plays the loop over the whole mix
+    auto looper_node = routing.add_node(
+      "Looper", 2, 2,
+      [this](RoutingGraph::NodeData& data) {
+        // The looper adds the tape in place, and keeps the marks of its inputs only while the tape
+        // is silent
+        auto out = looper.process({{data.view(0), data.view(1)}, *data.midi, data.nframes, data.context});
+        data.output(0, std::move(out.audio[0]));
+        data.output(1, std::move(out.audio[1]));
+      },
+      midi::EventMask::none);
+
+    auto master_node = routing.add_node(
+      "Master", 2, 2,
+      [this](RoutingGraph::NodeData& data) {
+        auto out = master.process({{data.view(0), data.view(1)}, *data.midi, data.nframes, data.context});
+        output_guard.process({out.audio[0].data(), data.nframes}, {out.audio[1].data(), data.nframes});
+        // The DC blocker rings on after the signal stops
+        out.audio[0].mark_silent(false);
+        out.audio[1].mark_silent(false);
+        analyser.write({out.audio[0].data(), data.nframes}, {out.audio[1].data(), data.nframes});
+        data.output(0, std::move(out.audio[0]));
+        data.output(1, std::move(out.audio[1]));
+      },
+      midi::EventMask::none);
+
+    for (auto synth_node : synth_nodes) {
+      routing.add_dependency(arp_node, synth_node);
+      routing.connect(routing.input(), 0, synth_node, 0);
+      routing.connect(synth_node, 0, sidechain_node, 0);
+      routing.connect(synth_node, 1, sidechain_node, 1);
+    }
+    routing.connect(key_node, 0, sidechain_node, 2);
+    routing.connect(routing.input(), 0, key_node, 1);
+    routing.connect(sidechain_node, 0, sends_node, 0);
+    routing.connect(sidechain_node, 1, sends_node, 1);
+    // The line input is mixed in the buffer it arrives in, without latency
+    routing.connect(routing.input(), 0, sends_node, 2);
+    routing.connect(sends_node, engines::Sends::fx1, fx1_node, 0);
+    routing.connect(sends_node, engines::Sends::fx2, fx2_node, 0);
+    for (int ch = 0; ch < 2; ch++) {
+      routing.connect(fx1_node, ch, looper_node, ch);
+      routing.connect(fx2_node, ch, looper_node, ch);
+      routing.connect(sends_node, engines::Sends::dry_left + ch, looper_node, ch);
+      routing.connect(drums_node, ch, looper_node, ch);
+      routing.connect(drums_node, ch, key_node, 0);
+      routing.connect(looper_node, ch, master_node, ch);
+      routing.connect(master_node, ch, routing.output(), ch);
+    }
+    routing.compile();
+  }
+
+  void DefaultEngineManager::setup_captures()
+  {
+    const char* names = std::getenv("OTTO_CAPTURE");
+    if (names == nullptr) return;
+    const char* seconds = std::getenv("OTTO_CAPTURE_SECONDS");
+    const char* stream = std::getenv("OTTO_CAPTURE_STREAM");
+    const char* record = std::getenv("OTTO_CAPTURE_RECORD");
+    auto mode = stream && std::string(stream) == "1" ? util::AudioCapture::Mode::stream : util::AudioCapture::Mode::rolling;
+    if (record && std::string(record) == "1") mode = util::AudioCapture::Mode::record;
+    auto& audio_manager = *Application::current().audio_manager;
+
+    std::stringstream list(names);
+    for (std::string name; std::getline(list, name, ',');) {
+      RoutingGraph::NodeId node = 0;
+      while (node < routing.size() && routing.name_of(node) != name) node++;
+      if (node == routing.size() || routing.outputs_of(node) == 0) {
+        LOGW("Capture: no routing node {} with outputs", name);
+        continue;
+      }
+      auto& capture = captures.emplace_back(std::make_unique<util::AudioCapture>(
+        name, Application::current().data_dir / "captures", routing.outputs_of(node), audio_manager.samplerate(),
+        seconds ? std::stof(seconds) : 30.f, mode));
+      routing.set_capture(node, capture.get());
+      LOGI("Capture: capturing {}", name);
+    }
+  }
+
+  void DefaultEngineManager::setup_input_recorder()
+  {
+    const char* path = std::getenv("OTTO_RECORD_INPUT");
+    if (path == nullptr) return;
+    input_recorder = std::make_unique<InputRecorder>(
+      path, std::vector<std::string>(slot_parts.begin(), slot_parts.end()),
+      [this](int part) { return &slot_engine(part); });
   }
 
   void DefaultEngineManager::start()
   {
+    routing.overrun_limit = overrun_limit;
+    watchdog = std::make_unique<AudioWatchdog>(*Application::current().audio_manager, [this](auto stalled_for) {
+      // The node that has been running the longest is the one the audio thread is stuck in
+      RoutingGraph::NodeId stuck = -1;
+      std::chrono::nanoseconds longest{0};
+      for (RoutingGraph::NodeId node = 0; node < routing.size(); node++) {
+        if (auto time = routing.running_time(node); time > longest) {
+          stuck = node;
+          longest = time;
+        }
+      }
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(stalled_for).count();
+      if (stuck < 0) {
+        LOGE("The audio thread has not finished a buffer in {}ms", ms);
+        return;
+      }
+      LOGE("The audio thread has not finished a buffer in {}ms, stuck in {}", ms, routing.name_of(stuck));
+      routing.set_fault(stuck, RoutingGraph::Fault::stalled);
+    });
+  }
+
+  void DefaultEngineManager::recover_faulted_nodes()
+  {
+    auto now = std::chrono::steady_clock::now();
+    for (auto& guarded : guarded_nodes) {
+      auto fault = routing.fault_of(guarded.node);
+      if (fault == RoutingGraph::Fault::none) continue;
+      auto& engine = guarded.dispatcher->current();
+      if (guarded.given_up != nullptr) {
+        if (guarded.given_up == &engine) continue;
+        // Another engine was selected
+        guarded.given_up = nullptr;
+        guarded.resets = 0;
+        routing.clear_fault(guarded.node);
+        continue;
+      }
+      // Resetting waits for the audio thread, which is still in the node
+      if (routing.running_time(guarded.node).count() > 0) continue;
+
+      auto& name = routing.name_of(guarded.node);
+      const char* reason = fault == RoutingGraph::Fault::non_finite ? "output NaN or infinity"
+                           : fault == RoutingGraph::Fault::overrun ? "overran its buffer"
+                                                                   : "stalled the audio thread";
+      if (now - guarded.last_reset > reset_window) guarded.resets = 0;
+      if (guarded.resets >= max_resets) {
+        LOGE("{} ({}) {} again, leaving it bypassed until another engine is selected", name,
+             engine.name(), reason);
+        guarded.given_up = &engine;
+        continue;
+      }
+      LOGE("{} ({}) {}, bypassing it while it is reset", name, engine.name(), reason);
+      guarded.dispatcher->reset();
+      guarded.resets++;
+      guarded.last_reset = now;
+      routing.clear_fault(guarded.node);
+    }
   }
 
   audio::ProcessData<2> DefaultEngineManager::process(audio::ProcessData<1> external_in)
   { // Main processor function
-    auto midi_in = external_in.midi_only();
-    auto arp_out = arpeggiator->process(midi_in);
-    auto synth_out = synth->process({external_in.audio, arp_out.midi, external_in.nframes});
-    // auto seq_out = sequencer.process(midi_in);
-    auto fx1_bus = Application::current().audio_manager->buffer_pool().allocate();
-    auto fx2_bus = Application::current().audio_manager->buffer_pool().allocate();
-    for (auto&& [snth, fx1, fx2] : util::zip(synth_out.audio, fx1_bus, fx2_bus)) {
-      fx1 = snth * synth_send.props.to_FX1;
-      fx2 = snth * synth_send.props.to_FX2;
-    }
-    auto fx1_out = effect1->process(audio::ProcessData<1>(fx1_bus));
-    auto fx2_out = effect2->process(audio::ProcessData<1>(fx2_bus));
-    for (auto&& [snth, fx1L, fx1R, fx2L, fx2R] :
-         util::zip(synth_out.audio, fx1_out.audio[0], fx1_out.audio[1], fx2_out.audio[0],
-                   fx2_out.audio[1])) {
-      fx1L += fx2L + snth * synth_send.props.dry * (1 - synth_send.props.dry_pan);
-      fx1R += fx2R + snth * synth_send.props.dry * (1 + synth_send.props.dry_pan);
-    }
-    synth_out.audio.release();
-    fx2_out.audio[0].release();
-    fx2_out.audio[1].release();
-    fx1_bus.release();
-    fx2_bus.release();
-    return master.process(std::move(fx1_out));
+    TIME_SCOPE("EngineManager::process");
+    // Apply the quality level of the cpu governor
+    int level = Application::current().audio_manager->quality_level();
+    std::array<IEngine*, synth_count + 3> engines = {&effect1.current(), &effect2.current(), &looper};
+    for (int i = 0; i < synth_count; i++) engines[3 + i] = &synths[i].dispatcher.current();
+    for (IEngine* engine : engines) {
+      engine->quality_tier(std::min(level, engine->quality_tiers() - 1));
+    }
+    std::array<IEngine*, slot_parts.size()> parts;
+    for (int part = 0; part < int(parts.size()); part++) parts[part] = &slot_engine(part);
+    if (input_recorder) input_recorder->record_midi(external_in.midi);
+    midi_learn.process(external_in.midi, parts, external_in.nframes, external_in.context->samplerate);
+    parameters.process(parts);
+    return routing.process(std::move(external_in), workers);
     /*
     auto temp = Application::current().audio_manager->buffer_pool().allocate_multi_clear<2>();
     for (auto&& [in, tmp] : util::zip(seq_out, temp)) {
@@ -224,12 +812,184 @@ namespace otto::services {
     */
   }
 
+  void DefaultEngineManager::take_cpu_usage(std::vector<util::CpuUsage>& out)
+  {
+    for (RoutingGraph::NodeId node = 0; node < routing.size(); node++) {
+      if (node == routing.input() || node == routing.output()) continue;
+      auto& name = routing.name_of(node);
+      // Name the engine currently selected in a slot, so the cost of each engine shows
+      auto* engine = by_name(name);
+      out.push_back({engine ? fmt::format("{} ({})", name, engine->name()) : name,
+                     routing.take_cpu_stats(node), routing.take_denormal_count(node)});
+      LOGW_IF(out.back().denormals > 0, "{} output {} denormals", out.back().name, out.back().denormals);
+    }
+    auto scrubbed = output_guard.take_scrubbed();
+    LOGE_IF(scrubbed > 0, "Replaced {} NaN or infinite samples in the output", scrubbed);
+  }
+
   IEngine* DefaultEngineManager::by_name(const std::string& name) noexcept
   {
-    auto getter = engineGetters.find(name);
-    if (getter == engineGetters.end()) return nullptr;
+    auto part = std::find(slot_parts.begin(), slot_parts.end(), std::string_view(name));
+    if (part == slot_parts.end()) return nullptr;
+    return &slot_engine(part - slot_parts.begin());
+  }
+
+  IEngine& DefaultEngineManager::slot_engine(int part) noexcept
+  {
+    if (auto* dispatcher = slot_dispatcher(part)) return dispatcher->current();
+    switch (part) {
+      case 4: return master;
+      case 5: return looper;
+      default: return drums;
+    }
+  }
+
+  IEngineDispatcher* DefaultEngineManager::slot_dispatcher(int part) noexcept
+  {
+    if (part >= second_synth_part) return &synths[part - second_synth_part + 1].dispatcher;
+    switch (part) {
+      case 0: return &synths[0].dispatcher;
+      case 1: return &effect1;
+      case 2: return &effect2;
+      case 3: return &arpeggiator;
+      default: return nullptr;
+    }
+  }
 
-    return getter->second();
+  fs::path DefaultEngineManager::slot_path(int slot) const
+  {
+    return Application::current().data_dir / "slots" / fmt::format("slot{}.bin", slot);
+  }
+
+  void DefaultEngineManager::load_slots()
+  {
+    for (int i = 0; i < slot_count; i++) {
+      auto path = slot_path(i);
+      if (!fs::exists(path)) continue;
+      try {
+        util::JsonFile file(path, util::JsonFile::Format::msgpack);
+        file.read();
+        _slots[i].data = std::move(file.data());
+      } catch (std::exception& e) {
+        LOGE("Could not load slot {}: {}", i, e.what());
+      }
+    }
+  }
+
+  bool DefaultEngineManager::parse_slot(Slot& slot)
+  {
+    bool parsed = false;
+    for (int part = 0; part < int(slot_parts.size()); part++) {
+      auto& engine = slot_engine(part);
+      if (slot.parsed_for[part] == &engine) continue;
+      auto found = slot.data.find(slot_parts[part]);
+      if (found == slot.data.end() || !found->is_object()) continue;
+      if (found->value("engine", std::string()) != std::string(engine.name())) continue;
+      // Failed parts are marked as parsed too, so they are not retried every frame
+      slot.parsed_for[part] = &engine;
+      slot.snapshots[part] = {};
+      parsed = true;
+      try {
+        slot.snapshots[part] = engine.snapshot(found->at("state"));
+      } catch (std::exception& e) {
+        LOGE("Could not parse the {} of a slot: {}", slot_parts[part], e.what());
+      }
+    }
+    return parsed;
+  }
+
+  void DefaultEngineManager::apply_slot(Slot& slot)
+  {
+    for (int part = 0; part < int(slot_parts.size()); part++) {
+      auto* dispatcher = slot_dispatcher(part);
+      auto found = slot.data.find(slot_parts[part]);
+      if (!dispatcher || found == slot.data.end() || !found->is_object()) continue;
+      auto name = found->value("engine", std::string());
+      if (name == std::string(dispatcher->current().name())) continue;
+      // The slow path: the engine is constructed, unless it is kept warm
+      try {
+        dispatcher->select(name);
+      } catch (std::exception& e) {
+        LOGE("Could not select {} for {}: {}", name, slot_parts[part], e.what());
+      }
+    }
+    parse_slot(slot);
+    for (int part = 0; part < int(slot_parts.size()); part++) {
+      if (slot.parsed_for[part] == &slot_engine(part)) slot.snapshots[part].apply();
+    }
+  }
+
+  void DefaultEngineManager::learn_last_changed()
+  {
+    if (midi_learn.learning()) {
+      midi_learn.cancel_learn();
+      LOGI("Stopped midi learn");
+      return;
+    }
+    const void* property = props::last_changed.load(std::memory_order_relaxed);
+    for (int part = 0; part < int(slot_parts.size()); part++) {
+      auto& engine = slot_engine(part);
+      if (int index = engine.find_property(property); index >= 0) {
+        auto& path = engine.property_info(index).path;
+        LOGI("Learning a midi controller for {} of {}", path, slot_parts[part]);
+        midi_learn.learn(part, path);
+        return;
+      }
+    }
+    LOGI("Turn a property of an engine before learning a midi controller for it");
+  }
+
+  void DefaultEngineManager::save_slot(int slot)
+  {
+    if (slot < 0 || slot >= slot_count)
+      throw util::exception("EngineManager::save_slot(): Slot {} out of bounds", slot);
+    auto& s = _slots[slot];
+    s.data = nlohmann::json::object();
+    for (int part = 0; part < int(slot_parts.size()); part++) {
+      auto& engine = slot_engine(part);
+      s.data[slot_parts[part]] = {{"engine", std::string(engine.name())},
+                                  {"state", engine.to_json()}};
+    }
+    s.parsed_for = {};
+    parse_slot(s);
+    _slot_writer.write(slot_path(slot), s.data, util::JsonFile::Format::msgpack);
+    LOGI("Saved slot {}", slot);
+  }
+
+  void DefaultEngineManager::recall_slot(int slot, bool quantized)
+  {
+    if (slot < 0 || slot >= slot_count)
+      throw util::exception("EngineManager::recall_slot(): Slot {} out of bounds", slot);
+    if (_slots[slot].empty()) return;
+    auto& clock = ClockManager::current();
+    if (quantized && clock.running()) {
+      auto beats = static_cast<float>(clock.current_time());
+      _recall_at = (std::floor(beats / beats_per_bar) + 1) * beats_per_bar;
+      _pending_slot = slot;
+      return;
+    }
+    _pending_slot = -1;
+    apply_slot(_slots[slot]);
+  }
+
+  void DefaultEngineManager::update()
+  {
+    if (midi_learn.update()) Application::current().state_manager->mark_dirty("MidiLearn");
+    if (input_recorder) input_recorder->update();
+    undo_history.start();
+    recover_faulted_nodes();
+
+    if (_pending_slot >= 0) {
+      auto& clock = ClockManager::current();
+      if (!clock.running() || static_cast<float>(clock.current_time()) >= _recall_at) {
+        apply_slot(_slots[std::exchange(_pending_slot, -1)]);
+      }
+    }
+    // Parse at most one slot per frame for engines selected since it was saved, so recalling
+    // it later does not have to
+    for (auto& slot : _slots) {
+      if (!slot.empty() && parse_slot(slot)) break;
+    }
   }
 
 } // namespace otto::services
@@ -4,8 +4,10 @@
 
 #include "core/service.hpp"
 #include "core/engine/engine.hpp"
+#include "core/engine/parameter_queue.hpp"
 
 #include "core/audio/processor.hpp"
+#include "util/cpu_meter.hpp"
 
 #include "services/state_manager.hpp"
 #include "services/ui_manager.hpp"
@@ -47,15 +49,72 @@ namespace otto::services {
     /// Process the engine audio chain
     virtual core::audio::ProcessData<2> process(core::audio::ProcessData<1> external_in) = 0;
 
+    /// Append the timing statistics of each part of the engine chain since the last call
+    ///
+    /// Used by @ref AudioManager::take_cpu_usage. Not to be called from the audio thread.
+    virtual void take_cpu_usage(std::vector<util::CpuUsage>& out) {}
+
     /// Get an engine by name
     ///
     /// \returns `nullptr` if no such engine was found
     virtual core::engine::IEngine* by_name(const std::string& name) noexcept = 0;
 
+    /* Slots */
+
+    /// The number of save slots, recalled with the slots key and `C0` to `C7`
+    static constexpr int slot_count = 8;
+
+    /// Save the state of all engines to slot `slot`
+    ///
+    /// The slot is parsed into snapshots right away, and written to disk in the background.
+    virtual void save_slot(int slot) {}
+
+    /// Restore the state of all engines from slot `slot`
+    ///
+    /// If `quantized` and the clock is running, this happens at the start of the next bar.
+    /// Recalling a slot whose engines are selected, or kept warm, sets their properties from
+    /// the parsed snapshots, without parsing json. Empty slots are ignored.
+    virtual void recall_slot(int slot, bool quantized = true) {}
+
+    /// Do the work of the engine manager on the UI thread
+    ///
+    /// Applies a pending quantized recall once its bar has started, and finishes midi learn.
+    /// Called by the @ref UIManager once per frame.
+    virtual void update() {}
+
+    /// The queue to set the properties of the engines through from another thread, like the
+    /// @ref OscServer, or `nullptr` if the engine manager has none
+    virtual core::engine::ParameterQueue* parameter_queue() noexcept
+    {
+      return nullptr;
+    }
+
+    /// Undo the last edit of a property of an engine
+    ///
+    /// \returns `false` if there was nothing to undo
+    virtual bool undo()
+    {
+      return false;
+    }
+
+    /// Redo the last undone edit of a property of an engine
+    ///
+    /// \returns `false` if there was nothing to redo
+    virtual bool redo()
+    {
+      return false;
+    }
+
     /// For now, this is the way to get the default EngineManager implementation
     /// 
     /// This is very likely to be changed in the future
     static std::unique_ptr<EngineManager> create_default();
+
+    /// The default implementation, for a plugin instance
+    ///
+    /// Runs the routing graph on the calling thread of the host, which spreads its instances
+    /// over its own threads.
+    static std::unique_ptr<EngineManager> create_hosted();
   };
 
 } // namespace otto::services
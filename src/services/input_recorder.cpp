@@ -0,0 +1,93 @@
+#include "input_recorder.hpp"
+
+#include "core/props/mixins/signal.hpp"
+
+#include "services/application.hpp"
+#include "services/audio_manager.hpp"
+#include "services/log_manager.hpp"
+#include "services/state_manager.hpp"
+
+namespace otto::services {
+
+  InputRecorder::InputRecorder(fs::path path, std::vector<std::string> parts, EngineOf engine_of)
+    : _path(std::move(path)), _engine_of(std::move(engine_of))
+  {
+    _header.parts = std::move(parts);
+
+    InputRecorder* expected = nullptr;
+    if (!_current.compare_exchange_strong(expected, this)) {
+      throw util::exception("InputRecorder: only one recorder may exist at a time");
+    }
+  }
+
+  InputRecorder::~InputRecorder()
+  {
+    core::props::change_observer = nullptr;
+    _current = nullptr;
+    if (_started) update();
+  }
+
+  void InputRecorder::record_midi(core::midi::MidiBufferRef midi) noexcept
+  {
+    if (!_started.load(std::memory_order_acquire)) return;
+    auto buffer = current_buffer();
+    for (auto& event : midi) {
+      if (!_midi->push({buffer, event})) _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void InputRecorder::update()
+  {
+    if (_failed) return;
+    if (!_started) {
+      auto state_path = _path;
+      state_path += ".state.json";
+      Application::current().state_manager->export_json(state_path);
+      _file.open(_path.c_str(), std::ios::binary);
+      if (!_file) {
+        LOGE("InputRecorder: could not write {}", _path.c_str());
+        _failed = true;
+        return;
+      }
+      // The audio settings are loaded with the state, after the recorder is made
+      auto& audio = *Application::current().audio_manager;
+      _header.samplerate = audio.samplerate();
+      _header.buffer_size = audio.buffer_size();
+      _header.write_header(_file);
+      _start_buffer = audio.buffer_number();
+      _thread = std::this_thread::get_id();
+      core::props::change_observer = observe;
+      _started.store(true, std::memory_order_release);
+      LOGI("InputRecorder: recording to {}", _path.c_str());
+    }
+
+    for (core::audio::InputRecording::MidiRecord record; _midi->pop(record);) {
+      core::audio::InputRecording::write(_file, record);
+    }
+    for (auto& record : _properties) core::audio::InputRecording::write(_file, record);
+    _properties.clear();
+    _file.flush();
+  }
+
+  void InputRecorder::observe(const void* property)
+  {
+    auto* self = _current.load(std::memory_order_relaxed);
+    if (self == nullptr || std::this_thread::get_id() != self->_thread) return;
+    for (int part = 0; part < int(self->_header.parts.size()); part++) {
+      auto* engine = self->_engine_of(part);
+      if (engine == nullptr) continue;
+      int index = engine->find_property(property);
+      if (index < 0) continue;
+      self->_properties.push_back({self->current_buffer(), std::uint8_t(part), engine->property_info(index).hash,
+                                   engine->get_property(index)});
+      return;
+    }
+  }
+
+  std::uint32_t InputRecorder::current_buffer() const noexcept
+  {
+    // Changes made between two buffers apply to the next one, which is the one counted here
+    return Application::current().audio_manager->buffer_number() - _start_buffer;
+  }
+
+} // namespace otto::services
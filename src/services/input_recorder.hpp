@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "core/audio/input_recording.hpp"
+#include "core/audio/midi.hpp"
+#include "core/engine/engine.hpp"
+#include "util/filesystem.hpp"
+#include "util/spsc_ring.hpp"
+
+namespace otto::services {
+
+  /// Records the midi and the property changes going into the engines, for replaying offline
+  ///
+  /// The audio thread hands over the midi of each buffer with @ref record_midi, stamped with
+  /// the buffer number. Property changes are picked up through @ref props::change_observer,
+  /// on the thread that calls @ref update, which is the UI thread. Changes made on other
+  /// threads, like by midi learn on the audio thread, follow from the recorded midi, so
+  /// replaying them again would apply them twice.
+  ///
+  /// @ref update writes the records to the file, and flushes it, so a crash loses at most one
+  /// frame. The first call also exports the state to `<path>.state.json`, which the offline
+  /// renderer loads before replaying.
+  ///
+  /// Only one recorder may exist at a time.
+  struct InputRecorder {
+    using EngineOf = std::function<core::engine::IEngine*(int part)>;
+
+    /// The midi events that may wait for @ref update, about ten seconds of busy playing
+    static constexpr std::size_t ring_size = 1 << 12;
+
+    /// \param parts The names of the engines whose property changes are recorded
+    /// \param engine_of The engine currently at the index of a name in `parts`
+    InputRecorder(fs::path path, std::vector<std::string> parts, EngineOf engine_of);
+
+    /// Writes the remaining records, and stops observing
+    ~InputRecorder();
+
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    /// Record the midi going into the current buffer. Never blocks.
+    ///
+    /// Only to be called from the audio thread, before the buffer is finished.
+    void record_midi(core::midi::MidiBufferRef midi) noexcept;
+
+    /// Write the records since the last call. Always on the same thread.
+    void update();
+
+    /// The number of midi events dropped because the ring was full
+    int dropped() const noexcept
+    {
+      return _dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static void observe(const void* property);
+    /// The buffer the audio thread is in, or about to start, relative to the recording
+    std::uint32_t current_buffer() const noexcept;
+
+    static inline std::atomic<InputRecorder*> _current = nullptr;
+
+    fs::path _path;
+    core::audio::InputRecording _header;
+    EngineOf _engine_of;
+    /// The thread that calls @ref update
+    std::thread::id _thread;
+    std::ofstream _file;
+
+    /// Set by the first @ref update. Nothing is recorded before.
+    std::atomic_bool _started = false;
+    /// Set if the file could not be opened
+    bool _failed = false;
+    unsigned _start_buffer = 0;
+    std::unique_ptr<util::SPSCRing<core::audio::InputRecording::MidiRecord, ring_size>> _midi =
+      std::make_unique<util::SPSCRing<core::audio::InputRecording::MidiRecord, ring_size>>();
+    std::atomic_int _dropped = 0;
+    /// The property changes since the last update. Only used by `_thread`.
+    std::vector<core::audio::InputRecording::PropertyRecord> _properties;
+  };
+
+} // namespace otto::services
@@ -0,0 +1,134 @@
+#include "latency_tuner.hpp"
+
+#include "core/audio/midi.hpp"
+#include "services/audio_manager.hpp"
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::services {
+
+  namespace {
+    /// The notes held while measuring, more than any synth has voices
+    constexpr std::array<int, 12> chord_notes = {36, 41, 46, 51, 56, 61, 66, 71, 76, 81, 86, 91};
+  } // namespace
+
+  bool LatencyTuner::stable(const Trial& trial, const Settings& settings) noexcept
+  {
+    return trial.xruns == 0 && trial.deadline_misses == 0 && trial.load <= settings.max_load &&
+           trial.quality_level == 0;
+  }
+
+  int LatencyTuner::pick(const std::vector<Trial>& trials, const Settings& settings) noexcept
+  {
+    if (trials.empty()) return 0;
+    int smallest = -1;
+    for (int i = 0; i < int(trials.size()) && stable(trials[i], settings); i++) smallest = i;
+    if (smallest < 0) return trials.front().buffer_size;
+    return trials[std::max(smallest - settings.margin_steps, 0)].buffer_size;
+  }
+
+  LatencyTuner::LatencyTuner(AudioManager& audio, Settings settings)
+    : _audio(audio), _settings(settings), _original_size(audio.buffer_size())
+  {
+    _thread = util::start_thread(util::ThreadClass::background, [this] { run(); });
+  }
+
+  LatencyTuner::~LatencyTuner() noexcept
+  {
+    {
+      std::unique_lock lock(_mutex);
+      _stop = true;
+    }
+    _stop_cv.notify_all();
+    if (_thread.joinable()) _thread.join();
+  }
+
+  std::vector<LatencyTuner::Trial> LatencyTuner::trials() const
+  {
+    std::unique_lock lock(_mutex);
+    return _trials;
+  }
+
+  bool LatencyTuner::wait(clock::duration duration)
+  {
+    std::unique_lock lock(_mutex);
+    return !_stop_cv.wait_for(lock, duration, [this] { return _stop; });
+  }
+
+  void LatencyTuner::chord(bool on)
+  {
+    if (!_settings.hold_chord) return;
+    for (int note : chord_notes) {
+      if (on) {
+        _audio.send_midi_event(core::midi::NoteOnEvent(note, 0.8f));
+      } else {
+        _audio.send_midi_event(core::midi::NoteOffEvent(note));
+      }
+    }
+  }
+
+  std::optional<LatencyTuner::Trial> LatencyTuner::measure(int buffer_size)
+  {
+    _audio.change_settings(_audio.samplerate(), buffer_size);
+    chord(true);
+    if (!wait(_settings.settle)) return std::nullopt;
+
+    auto& stats = _audio.callback_stats();
+    auto xruns = [&] { return stats.input_overflows + stats.output_underflows; };
+    int xruns_before = xruns();
+    int misses_before = stats.deadline_misses;
+    auto loads_before = stats.load.counts();
+    bool finished = wait(_settings.trial_length);
+    chord(false);
+    if (!finished) return std::nullopt;
+
+    Trial res;
+    res.buffer_size = _audio.buffer_size();
+    res.xruns = xruns() - xruns_before;
+    res.deadline_misses = stats.deadline_misses - misses_before;
+    res.quality_level = _audio.quality_level();
+    // The quantile of the callbacks of this trial only, from the difference of the counts
+    auto loads = stats.load.counts();
+    int total = 0;
+    for (std::size_t i = 0; i < loads.size(); i++) total += loads[i] - loads_before[i];
+    int sum = 0;
+    for (std::size_t i = 0; i < loads.size(); i++) {
+      sum += loads[i] - loads_before[i];
+      if (sum > 0 && sum >= 0.999 * total) {
+        res.load = stats.load.lower_bound(i + 1);
+        break;
+      }
+    }
+    return res;
+  }
+
+  void LatencyTuner::run()
+  {
+    loguru::set_thread_name("latency_tuner");
+    LOGI("Latency tuner: measuring each buffer size for {} s",
+         std::chrono::duration_cast<std::chrono::seconds>(_settings.trial_length).count());
+    auto& sizes = AudioManager::buffer_sizes;
+    for (auto size = sizes.rbegin(); size != sizes.rend(); ++size) {
+      auto trial = measure(*size);
+      if (!trial) {
+        // Stopped halfway, so leave the stream as it was
+        _audio.change_settings(_audio.samplerate(), _original_size);
+        return;
+      }
+      LOGI("Latency tuner: {} frames, {} xruns, {} missed deadlines, load p99.9 {:.0f}%, quality level {}",
+           trial->buffer_size, trial->xruns, trial->deadline_misses, 100 * trial->load, trial->quality_level);
+      bool is_stable = stable(*trial, _settings);
+      {
+        std::unique_lock lock(_mutex);
+        _trials.push_back(*trial);
+      }
+      if (!is_stable) break;
+    }
+    int size = pick(trials(), _settings);
+    LOGW_IF(!stable(trials().front(), _settings), "Latency tuner: not even {} frames are stable", size);
+    LOGI("Latency tuner: settled on {} frames", size);
+    _audio.change_settings(_audio.samplerate(), size);
+    _done = true;
+  }
+
+} // namespace otto::services
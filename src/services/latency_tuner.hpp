@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace otto::services {
+
+  struct AudioManager;
+
+  /// Finds the smallest buffer size the board plays the current patch at without xruns
+  ///
+  /// From a thread of its own, it runs the stream at each of @ref AudioManager::buffer_sizes,
+  /// from the largest down, for @ref Settings::trial_length each, and counts the xruns, the
+  /// missed deadlines and the load of the callbacks in that time. It stops at the first size
+  /// that is not stable, see @ref stable, and settles on the smallest stable size, raised by
+  /// @ref Settings::margin_steps sizes. That is set with @ref AudioManager::change_settings, so
+  /// it is kept in the state of the board and restored at startup.
+  ///
+  /// The patch is whatever is loaded when it starts. It holds a chord on all voices while
+  /// measuring, so the synths cost what they would when played. Boards start it with the
+  /// `OTTO_TUNE_LATENCY` environment variable, on each unit, as the safe size depends on the
+  /// hardware revision, the kernel and the patch.
+  struct LatencyTuner {
+    using clock = std::chrono::steady_clock;
+
+    struct Settings {
+      /// The time each buffer size is measured for
+      clock::duration trial_length = std::chrono::seconds(20);
+      /// The time after a restart of the stream before measuring, which may xrun while the
+      /// driver starts up
+      clock::duration settle = std::chrono::seconds(1);
+      /// The highest 99.9th percentile of the load a stable size may reach, as a fraction of
+      /// the duration of a buffer. The rest is headroom for what the trial did not play.
+      float max_load = 0.75f;
+      /// The number of sizes above the smallest stable one to settle on
+      int margin_steps = 1;
+      /// Whether to hold a chord while measuring
+      bool hold_chord = true;
+    };
+
+    /// The measurements of one buffer size
+    struct Trial {
+      /// The size the driver ran at, which may be the nearest size the device supports
+      int buffer_size = 0;
+      int xruns = 0;
+      int deadline_misses = 0;
+      /// The 99.9th percentile of the load of the callbacks, relative to the duration of a buffer
+      float load = 0;
+      /// The quality level at the end of the trial. Above 0, the load was only kept down by
+      /// lowering the quality.
+      int quality_level = 0;
+    };
+
+    /// Whether a size measured as `trial` is safe to play at
+    static bool stable(const Trial& trial, const Settings& settings) noexcept;
+
+    /// The buffer size to settle on after `trials`, run from the largest size down
+    ///
+    /// The smallest stable size before the first unstable one, `margin_steps` trials up. If
+    /// even the first size was not stable, that one.
+    static int pick(const std::vector<Trial>& trials, const Settings& settings) noexcept;
+
+    /// Start tuning `audio`, which should be running
+    LatencyTuner(AudioManager& audio, Settings settings);
+    /// Stop tuning. If it was not done, the buffer size it started with is restored.
+    ~LatencyTuner() noexcept;
+
+    /// Whether the tuner has settled on a size
+    bool done() const noexcept
+    {
+      return _done;
+    }
+
+    /// The trials so far
+    std::vector<Trial> trials() const;
+
+  private:
+    void run();
+    /// Run the stream at `buffer_size`, and measure it. Empty if stopped.
+    std::optional<Trial> measure(int buffer_size);
+    /// Hold or release the chord
+    void chord(bool on);
+    /// Sleep for `duration`. `false` if stopped.
+    bool wait(clock::duration duration);
+
+    AudioManager& _audio;
+    Settings _settings;
+    std::atomic_bool _done = false;
+    /// The size the stream ran at before tuning
+    int _original_size = 0;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _stop_cv;
+    bool _stop = false;
+    std::vector<Trial> _trials;
+    std::thread _thread;
+  };
+
+} // namespace otto::services
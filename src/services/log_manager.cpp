@@ -1,5 +1,9 @@
 #include "log_manager.hpp"
+
+#include <chrono>
+
 #include "services/application.hpp"
+#include "util/thread_policy.hpp"
 
 #define LOGURU_IMPLEMENTATION 1
 #include <loguru.hpp>
@@ -26,6 +30,22 @@ namespace otto::services {
     });
 
     LOGI("LOGGING NOW");
+
+    _rt_log_running = true;
+    _rt_log_writer = util::start_thread(util::ThreadClass::io, [this] {
+      loguru::set_thread_name("rt_log");
+      while (_rt_log_running) {
+        rt_log::flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+    });
+  }
+
+  LogManager::~LogManager()
+  {
+    _rt_log_running = false;
+    if (_rt_log_writer.joinable()) _rt_log_writer.join();
+    rt_log::flush();
   }
 
   void LogManager::set_thread_name(const std::string& name)
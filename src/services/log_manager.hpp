@@ -1,6 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+
 #include "util/filesystem.hpp"
+#include "util/macros.hpp"
 
 #include "core/service.hpp"
 
@@ -9,18 +13,27 @@
 #include <loguru.hpp>
 
 #include "services/application.hpp"
+#include "services/rt_log.hpp"
 
 namespace otto::services {
 
   struct LogManager : core::Service {
-    /// Initialize the logger
+    /// Initialize the logger, and start the writer of the real-time log messages
     LogManager(int argc,
                char** argv,
                bool enable_console = true,
                const char* logFilePath = nullptr);
 
+    /// Stop the writer, after writing the remaining real-time log messages
+    ~LogManager();
+
     /// Set how the current thread appears in the log
     void set_thread_name(const std::string& name);
+
+  private:
+    /// Writes the messages of the `RTLOG` macros, see @ref rt_log::flush
+    std::thread _rt_log_writer;
+    std::atomic_bool _rt_log_running = false;
   };
 
 } // namespace otto::services
@@ -0,0 +1,169 @@
+#include "metrics_server.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fmt/format.h>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "services/application.hpp"
+#include "services/audio_manager.hpp"
+#include "services/log_manager.hpp"
+#include "services/state_manager.hpp"
+#include "services/ui_manager.hpp"
+
+#include "util/memory_tags.hpp"
+#include "util/memory_usage.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::services {
+
+  namespace {
+
+    struct MetricsWriter {
+      fmt::memory_buffer buf;
+
+      void header(const char* name, const char* type, const char* help)
+      {
+        fmt::format_to(buf, "# HELP otto_{} {}\n# TYPE otto_{} {}\n", name, help, name, type);
+      }
+
+      template<typename T>
+      void value(const char* name, T value)
+      {
+        fmt::format_to(buf, "otto_{} {}\n", name, value);
+      }
+
+      template<typename T>
+      void metric(const char* name, const char* type, const char* help, T val)
+      {
+        header(name, type, help);
+        value(name, val);
+      }
+
+      /// A summary of `histogram`, with the upper bounds of the buckets of the quantiles
+      template<std::size_t N>
+      void summary(const char* name, const char* help, const util::Histogram<N>& histogram)
+      {
+        header(name, "summary", help);
+        for (double q : {0.5, 0.9, 0.99, 1.0}) {
+          fmt::format_to(buf, "otto_{}{{quantile=\"{}\"}} {}\n", name, q, histogram.quantile(q));
+        }
+        fmt::format_to(buf, "otto_{}_count {}\n", name, histogram.total());
+      }
+    };
+
+  } // namespace
+
+  std::string render_metrics()
+  {
+    auto& app = Application::current();
+    MetricsWriter out;
+
+    if (app.audio_manager) {
+      auto& audio = *app.audio_manager;
+      auto& stats = audio.callback_stats();
+      out.summary("audio_load", "Duration of the audio callbacks, relative to their buffer", stats.load);
+      out.metric("audio_input_overflows_total", "counter", "Callbacks where the driver discarded input",
+                 stats.input_overflows.load());
+      out.metric("audio_output_underflows_total", "counter", "Callbacks where the driver ran out of output",
+                 stats.output_underflows.load());
+      out.metric("audio_deadline_misses_total", "counter", "Callbacks that took longer than their buffer",
+                 stats.deadline_misses.load());
+      out.metric("audio_page_faults_total", "counter", "Page faults on the audio thread", stats.page_faults.load());
+      out.metric("audio_migrations_total", "counter", "Callbacks on another core than the previous one",
+                 stats.migrations.load());
+      out.metric("audio_quality_level", "gauge", "Quality level picked by the governor, 0 is full quality",
+                 audio.quality_level());
+      out.metric("midi_events_total", "counter", "Midi events sent into the system", audio.midi_event_count());
+      out.metric("midi_overflows_total", "counter", "Midi events dropped because a queue was full",
+                 audio.midi_overflow_count());
+      auto& pool = audio.buffer_pool();
+      out.metric("buffer_pool_high_water_mark", "gauge", "Most audio buffers in use at once",
+                 pool.high_water_mark());
+      out.metric("buffer_pool_capacity", "gauge", "Audio buffers in the pool", pool.capacity());
+      out.metric("buffer_pool_overflows_total", "counter", "Allocations that found no free audio buffer",
+                 pool.overflow_count());
+    }
+
+    if (app.ui_manager) {
+      out.metric("ui_frames_total", "counter", "Frames of the UI loop, drawn or not", app.ui_manager->frame_count());
+      out.metric("ui_drawn_frames_total", "counter", "Frames drawn by the UI", app.ui_manager->drawn_frame_count());
+    }
+
+    if (app.state_manager) {
+      out.summary("state_save_seconds", "Time spent saving the state, not counting the write to disk",
+                  app.state_manager->save_durations());
+    }
+
+    out.metric("resident_memory_bytes", "gauge", "Memory of the process resident in RAM", util::resident_memory());
+    auto tags = util::memory_tags();
+    out.header("memory_tag_bytes", "gauge", "Memory accounted to each subsystem");
+    for (auto& tag : tags) {
+      fmt::format_to(out.buf, "otto_memory_tag_bytes{{tag=\"{}\"}} {}\n", tag.name, tag.live);
+    }
+    out.header("memory_tag_peak_bytes", "gauge", "Most memory accounted to each subsystem at once");
+    for (auto& tag : tags) {
+      fmt::format_to(out.buf, "otto_memory_tag_peak_bytes{{tag=\"{}\"}} {}\n", tag.name, tag.peak);
+    }
+
+    return fmt::to_string(out.buf);
+  }
+
+  MetricsServer::MetricsServer(fs::path path, Render render) : _path(std::move(path)), _render(std::move(render))
+  {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (_path.native().size() >= sizeof(addr.sun_path)) {
+      LOGE("Metrics: the socket path {} is too long", _path.c_str());
+      return;
+    }
+    std::strcpy(addr.sun_path, _path.c_str());
+
+    _socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    // A socket file left behind by a crash would make bind fail
+    ::unlink(_path.c_str());
+    if (_socket < 0 || ::bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(_socket, 4) != 0) {
+      LOGE("Metrics: could not listen on {}: {}", _path.c_str(), std::strerror(errno));
+      if (_socket >= 0) ::close(_socket);
+      _socket = -1;
+      return;
+    }
+    _thread = util::start_thread(util::ThreadClass::background, [this] { run(); });
+    LOGI("Metrics: serving on {}", _path.c_str());
+  }
+
+  MetricsServer::~MetricsServer()
+  {
+    _running = false;
+    if (_thread.joinable()) _thread.join();
+    if (_socket >= 0) {
+      ::close(_socket);
+      ::unlink(_path.c_str());
+    }
+  }
+
+  void MetricsServer::run()
+  {
+    while (_running) {
+      // Wake up regularly to see if the server is stopping
+      pollfd fd = {_socket, POLLIN, 0};
+      if (::poll(&fd, 1, 200) <= 0) continue;
+      int client = ::accept4(_socket, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client < 0) continue;
+      auto text = _render();
+      for (std::size_t sent = 0; sent < text.size();) {
+        auto n = ::send(client, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += n;
+      }
+      ::close(client);
+    }
+  }
+
+} // namespace otto::services
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "util/filesystem.hpp"
+
+namespace otto::services {
+
+  /// The health counters of the current application, in the Prometheus text format
+  ///
+  /// The load quantiles, xruns, deadline misses, page faults and migrations of the audio
+  /// callback, the midi events, the buffer pool, the UI frames, the durations of the state
+  /// saves, the resident memory, and the live and peak bytes of each `util::MemoryTag`. The
+  /// rates, like midi events or frames per second, are left to the monitoring, from the
+  /// counters.
+  ///
+  /// Only reads atomic counters, lock-free histograms and the list of memory tags, so it may be
+  /// called from any thread, and never waits for the audio thread. The application must outlive the call.
+  std::string render_metrics();
+
+  /// Serves metrics on a Unix socket, for monitoring units that nobody watches the screen of
+  ///
+  /// Every client that connects is sent the text of `render`, and disconnected. Scrape it with
+  /// ```sh
+  /// socat - UNIX-CONNECT:/tmp/otto-metrics.sock
+  /// ```
+  /// or point the textfile collector of the Prometheus node exporter at the output of that.
+  ///
+  /// The server runs on its own thread with `SCHED_IDLE`, so it never takes the cpu from the
+  /// audio or the UI. Errors are logged, and leave the server stopped.
+  struct MetricsServer {
+    using Render = std::function<std::string()>;
+
+    static constexpr const char* default_path = "/tmp/otto-metrics.sock";
+
+    /// Listen on `path`, replacing a stale socket file there
+    MetricsServer(fs::path path = default_path, Render render = render_metrics);
+
+    /// Stops the thread, and removes the socket file
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    const fs::path& path() const noexcept
+    {
+      return _path;
+    }
+
+  private:
+    void run();
+
+    fs::path _path;
+    Render _render;
+    int _socket = -1;
+    std::atomic_bool _running = true;
+    std::thread _thread;
+  };
+
+} // namespace otto::services
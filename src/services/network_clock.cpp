@@ -0,0 +1,322 @@
+#include "network_clock.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::services {
+
+  using Message = SyncSession::Message;
+  using Timeline = ClockManager::Timeline;
+
+  // SyncSession::Message //
+
+  namespace {
+    constexpr std::array<std::uint8_t, 4> magic = {'O', 'T', 'C', 'K'};
+    constexpr std::uint8_t version = 1;
+
+    void put(std::uint8_t* out, std::uint64_t value) noexcept
+    {
+      for (int i = 0; i < 8; i++) out[i] = value >> (8 * i);
+    }
+
+    std::uint64_t get(const std::uint8_t* in) noexcept
+    {
+      std::uint64_t value = 0;
+      for (int i = 0; i < 8; i++) value |= std::uint64_t(in[i]) << (8 * i);
+      return value;
+    }
+
+    void put_double(std::uint8_t* out, double value) noexcept
+    {
+      std::uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      put(out, bits);
+    }
+
+    double get_double(const std::uint8_t* in) noexcept
+    {
+      std::uint64_t bits = get(in);
+      double value;
+      std::memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+
+    std::int64_t now_ns() noexcept
+    {
+      return std::chrono::nanoseconds(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+  } // namespace
+
+  Message::Bytes Message::encode() const noexcept
+  {
+    Bytes res = {};
+    std::copy(magic.begin(), magic.end(), res.begin());
+    res[4] = version;
+    res[5] = static_cast<std::uint8_t>(kind);
+    put(&res[8], from);
+    put(&res[16], to);
+    put_double(&res[24], timeline.bpm);
+    put_double(&res[32], timeline.beat);
+    put(&res[40], timeline.time_ns);
+    res[48] = timeline.running;
+    put(&res[56], sent_ns);
+    put(&res[64], reply_ns);
+    return res;
+  }
+
+  tl::optional<Message> Message::decode(gsl::span<const std::uint8_t> bytes) noexcept
+  {
+    if (bytes.size() != size || !std::equal(magic.begin(), magic.end(), bytes.begin()) ||
+        bytes[4] != version || bytes[5] > static_cast<std::uint8_t>(Kind::request)) {
+      return tl::nullopt;
+    }
+    Message res;
+    res.kind = static_cast<Kind>(bytes[5]);
+    res.from = get(&bytes[8]);
+    res.to = get(&bytes[16]);
+    res.timeline.bpm = get_double(&bytes[24]);
+    res.timeline.beat = get_double(&bytes[32]);
+    res.timeline.time_ns = get(&bytes[40]);
+    res.timeline.running = bytes[48] != 0;
+    res.sent_ns = get(&bytes[56]);
+    res.reply_ns = get(&bytes[64]);
+    return res;
+  }
+
+  // SyncSession //
+
+  SyncSession::SyncSession(std::uint64_t id, Timeline timeline) : _id(id), _leader(id), _timeline(timeline) {}
+
+  void SyncSession::receive(const Message& msg, std::int64_t now, const Send& send)
+  {
+    if (msg.from == _id) return;
+    auto peer = std::find_if(_peers.begin(), _peers.end(), [&](auto& p) { return p.id == msg.from; });
+    if (peer != _peers.end()) {
+      peer->last_seen = now;
+    } else {
+      _peers.push_back({msg.from, now});
+    }
+    update_leader(now);
+
+    using Kind = Message::Kind;
+    switch (msg.kind) {
+    case Kind::timeline:
+      if (msg.from != _leader) break;
+      _leader_timeline = msg.timeline;
+      if (auto offset = clock_offset()) {
+        _timeline = _leader_timeline;
+        _timeline.time_ns -= *offset;
+      }
+      break;
+    case Kind::ping:
+      if (msg.to != _id || !is_leader()) break;
+      send({Kind::pong, _id, msg.from, {}, msg.sent_ns, now});
+      break;
+    case Kind::pong: {
+      if (msg.to != _id || msg.from != _leader) break;
+      std::int64_t round_trip = now - msg.sent_ns;
+      // The leader replied halfway through the round trip
+      std::int64_t offset = msg.reply_ns - (msg.sent_ns + round_trip / 2);
+      _samples[_sample_count++ % offset_samples] = {round_trip, offset};
+      if (_leader_timeline.bpm > 0) {
+        _timeline = _leader_timeline;
+        _timeline.time_ns -= *clock_offset();
+      }
+      break;
+    }
+    case Kind::request:
+      if (msg.to != _id || !is_leader()) break;
+      change(msg.timeline.bpm, msg.timeline.running, now, send);
+      break;
+    }
+  }
+
+  void SyncSession::poll(std::int64_t now, const Send& send)
+  {
+    update_leader(now);
+    if (is_leader()) {
+      if (now < _next_timeline) return;
+      _next_timeline = now + timeline_interval_ns;
+      send({Message::Kind::timeline, _id, 0, _timeline, 0, 0});
+    } else {
+      if (now < _next_ping) return;
+      _next_ping = now + ping_interval_ns;
+      send({Message::Kind::ping, _id, _leader, {}, now, 0});
+    }
+  }
+
+  void SyncSession::change(double bpm, bool running, std::int64_t now, const Send& send)
+  {
+    if (bpm <= 0) return;
+    Timeline timeline = {bpm, _timeline.beat_at(now), now, running};
+    if (!is_leader()) {
+      send({Message::Kind::request, _id, _leader, timeline, 0, 0});
+      return;
+    }
+    _timeline = timeline;
+    // Right away, instead of at the next poll
+    _next_timeline = now + timeline_interval_ns;
+    send({Message::Kind::timeline, _id, 0, _timeline, 0, 0});
+  }
+
+  Timeline SyncSession::timeline() const noexcept
+  {
+    return _timeline;
+  }
+
+  tl::optional<std::int64_t> SyncSession::clock_offset() const noexcept
+  {
+    if (_sample_count == 0 || is_leader()) return tl::nullopt;
+    // The offsets from the shortest round trips are the least skewed by delays on the way
+    auto last = _samples.begin() + std::min(_sample_count, offset_samples);
+    return std::min_element(_samples.begin(), last, [](auto& a, auto& b) {
+             return a.round_trip < b.round_trip;
+           })->offset;
+  }
+
+  void SyncSession::update_leader(std::int64_t now)
+  {
+    _peers.erase(std::remove_if(_peers.begin(), _peers.end(),
+                                [&](auto& p) { return now - p.last_seen > peer_timeout_ns; }),
+                 _peers.end());
+    auto leader = _id;
+    for (auto& p : _peers) leader = std::min(leader, p.id);
+    if (leader == _leader) return;
+    LOGI("Network clock: {} the session", leader == _id ? "leading" : "following");
+    // The session carries on from the timeline this peer followed
+    _leader = leader;
+    _leader_timeline = {};
+    _sample_count = 0;
+  }
+
+  // NetworkClock //
+
+  NetworkClock::NetworkClock(ClockManager& clock_manager, Config config)
+    : _clock_manager(clock_manager), _client(clock_manager.request_client(ClockManager::Source::sync)), _config(config)
+  {
+    if (!_client) {
+      LOGE("Network clock: the clock already has a sync client");
+      return;
+    }
+    _thread = util::start_thread(util::ThreadClass::io, [this] { run(); });
+  }
+
+  NetworkClock::~NetworkClock()
+  {
+    _running = false;
+    if (_thread.joinable()) _thread.join();
+    if (_socket >= 0) ::close(_socket);
+  }
+
+  void NetworkClock::set_bpm(float bpm) noexcept
+  {
+    _requested_bpm = bpm;
+  }
+
+  bool NetworkClock::connect()
+  {
+    if (_socket < 0) {
+      _socket = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+      int yes = 1;
+      sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      addr.sin_port = htons(_config.port);
+      // Several OTTOs on one machine, like plugin instances, share the port
+      if (_socket < 0 || ::setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) != 0 ||
+          ::setsockopt(_socket, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) != 0 ||
+          ::bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        LOGE("Network clock: could not open port {}: {}", _config.port, std::strerror(errno));
+        if (_socket >= 0) ::close(_socket);
+        _socket = -1;
+        _running = false;
+        return false;
+      }
+      unsigned char ttl = 1;
+      ::setsockopt(_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    }
+    ip_mreq group = {};
+    group.imr_multiaddr.s_addr = ::inet_addr(_config.group);
+    group.imr_interface.s_addr = htonl(INADDR_ANY);
+    // Fails until there is a network with a route for the group
+    return ::setsockopt(_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) == 0;
+  }
+
+  void NetworkClock::run()
+  {
+    bool connected = false;
+    std::int64_t last_attempt = 0;
+    std::random_device random;
+    std::uint64_t id = (std::uint64_t(random()) << 32 | random()) | 1;
+
+    auto now = now_ns();
+    SyncSession session(id, {_clock_manager.bpm(), static_cast<float>(_clock_manager.current_time()), now,
+                             _clock_manager.running()});
+    _client->start();
+    if (!session.timeline().running) _client->stop();
+
+    sockaddr_in group = {};
+    group.sin_family = AF_INET;
+    group.sin_addr.s_addr = ::inet_addr(_config.group);
+    group.sin_port = htons(_config.port);
+    auto send = [&](const Message& msg) {
+      auto bytes = msg.encode();
+      ::sendto(_socket, bytes.data(), bytes.size(), 0, reinterpret_cast<sockaddr*>(&group), sizeof(group));
+    };
+
+    Timeline published;
+    while (_running) {
+      now = now_ns();
+      if (!connected) {
+        if (now - last_attempt < 1'000'000'000) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+          continue;
+        }
+        last_attempt = now;
+        connected = connect();
+        LOGI_IF(connected, "Network clock: joined {}:{}", _config.group, _config.port);
+        continue;
+      }
+
+      pollfd fd = {_socket, POLLIN, 0};
+      if (::poll(&fd, 1, 5) > 0) {
+        std::array<std::uint8_t, Message::size + 1> buf;
+        auto n = ::recv(_socket, buf.data(), buf.size(), 0);
+        // The time it arrived, for the round trips of the pings
+        now = now_ns();
+        if (n > 0) {
+          if (auto msg = Message::decode({buf.data(), n})) session.receive(*msg, now, send);
+        }
+      }
+      now = now_ns();
+      if (float bpm = _requested_bpm.exchange(0); bpm > 0) {
+        session.change(bpm, session.timeline().running, now, send);
+      }
+      session.poll(now, send);
+      _peer_count = session.peer_count();
+
+      auto timeline = session.timeline();
+      if (timeline.bpm != published.bpm || timeline.beat != published.beat ||
+          timeline.time_ns != published.time_ns || timeline.running != published.running) {
+        if (timeline.running != _clock_manager.running()) {
+          timeline.running ? _client->start() : _client->stop();
+        }
+        _client->set_timeline(timeline);
+        published = timeline;
+      }
+    }
+  }
+
+} // namespace otto::services
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <gsl/span>
+#include <tl/optional.hpp>
+
+#include "services/clock_manager.hpp"
+
+namespace otto::services {
+
+  /// The tempo and phase of the OTTOs on a network, without the network
+  ///
+  /// All peers hear all messages. The peer with the lowest id is the leader, and its timeline
+  /// is the timeline of the session. It sends it regularly, on its own clock. The other peers
+  /// ping the leader to estimate the offset between its clock and theirs, like NTP, and follow
+  /// its timeline on their own clock. Peers ask the leader to change the tempo. When the leader
+  /// leaves, the next one carries on from where the session was.
+  ///
+  /// Times are nanoseconds of the local `std::chrono::steady_clock`, passed in by the caller.
+  /// Only to be used from one thread.
+  struct SyncSession {
+    struct Message {
+      enum struct Kind : std::uint8_t {
+        /// The timeline of the leader, on its clock
+        timeline,
+        /// `sent_ns` is the local time of the sender
+        ping,
+        /// Answers a ping. `sent_ns` is that of the ping, `reply_ns` the time of the leader.
+        pong,
+        /// Asks the leader to change the tempo and the transport to those of `timeline`
+        request,
+      };
+
+      /// The size of an encoded message
+      static constexpr std::size_t size = 72;
+      using Bytes = std::array<std::uint8_t, size>;
+
+      Kind kind = Kind::timeline;
+      std::uint64_t from = 0;
+      /// The peer the message is for, or 0 for all
+      std::uint64_t to = 0;
+      ClockManager::Timeline timeline;
+      std::int64_t sent_ns = 0;
+      std::int64_t reply_ns = 0;
+
+      /// The message as little endian bytes, after a magic number and a version
+      Bytes encode() const noexcept;
+
+      /// \returns `tl::nullopt` if `bytes` is not a message of this version
+      static tl::optional<Message> decode(gsl::span<const std::uint8_t> bytes) noexcept;
+    };
+
+    using Send = std::function<void(const Message&)>;
+
+    /// Peers that have not been heard from for this long have left
+    static constexpr std::int64_t peer_timeout_ns = 2'000'000'000;
+    /// How often the leader sends the timeline
+    static constexpr std::int64_t timeline_interval_ns = 100'000'000;
+    /// How often the other peers ping the leader
+    static constexpr std::int64_t ping_interval_ns = 250'000'000;
+    /// The number of pings the clock offset is estimated from
+    static constexpr std::size_t offset_samples = 8;
+
+    /// \param timeline The timeline of the local clock, which the session starts from if this
+    /// peer turns out to lead it
+    SyncSession(std::uint64_t id, ClockManager::Timeline timeline);
+
+    /// Handle a message received at `now`. Messages from this peer are ignored.
+    void receive(const Message& msg, std::int64_t now, const Send& send);
+
+    /// Send the timeline or the pings that are due at `now`. To be called at least every 10 ms.
+    void poll(std::int64_t now, const Send& send);
+
+    /// Change the tempo and the transport of the session
+    ///
+    /// The beat at `now` stays where it was. Other peers ask the leader.
+    void change(double bpm, bool running, std::int64_t now, const Send& send);
+
+    /// The timeline of the session, on the local clock
+    ///
+    /// Until the offset to the clock of the leader is known, the timeline this peer had before.
+    ClockManager::Timeline timeline() const noexcept;
+
+    /// The id of the leader, which may be this peer
+    std::uint64_t leader() const noexcept
+    {
+      return _leader;
+    }
+
+    bool is_leader() const noexcept
+    {
+      return _leader == _id;
+    }
+
+    /// The number of other peers heard from recently
+    std::size_t peer_count() const noexcept
+    {
+      return _peers.size();
+    }
+
+    /// The clock of the leader minus the local clock, in nanoseconds, if known
+    tl::optional<std::int64_t> clock_offset() const noexcept;
+
+  private:
+    struct Peer {
+      std::uint64_t id;
+      std::int64_t last_seen;
+    };
+
+    struct OffsetSample {
+      std::int64_t round_trip;
+      std::int64_t offset;
+    };
+
+    /// Forget the peers that left, and pick the leader
+    void update_leader(std::int64_t now);
+
+    std::uint64_t _id;
+    std::uint64_t _leader;
+    std::vector<Peer> _peers;
+    /// The timeline of the session on the local clock, while this peer leads it
+    ClockManager::Timeline _timeline;
+    /// The last timeline of the leader, on its clock
+    ClockManager::Timeline _leader_timeline;
+    std::array<OffsetSample, offset_samples> _samples = {};
+    std::size_t _sample_count = 0;
+    /// When the next timeline or ping is due
+    std::int64_t _next_timeline = std::numeric_limits<std::int64_t>::min();
+    std::int64_t _next_ping = std::numeric_limits<std::int64_t>::min();
+  };
+
+  /// Keeps the clock in time with the OTTOs on the local network
+  ///
+  /// Runs a @ref SyncSession over UDP multicast on a thread of its own, and hands the timeline
+  /// of the session to the clock with the @ref ClockManager::Source::sync client. The audio
+  /// thread reads it once per buffer, without waiting, and derives the position of the buffer
+  /// from it, so units stay in phase without midi cables. Set `OTTO_NETWORK_CLOCK=1` to enable
+  /// it on the boards that support it.
+  ///
+  /// If the network is not up yet, joining the group is retried every second. Errors are
+  /// logged, and leave the clock running on its own.
+  struct NetworkClock {
+    struct Config {
+      /// An organization local multicast group, so the messages stay in the installation
+      const char* group = "239.255.79.84";
+      int port = 20810;
+    };
+
+    NetworkClock(ClockManager& clock_manager, Config config);
+    NetworkClock(ClockManager& clock_manager) : NetworkClock(clock_manager, Config()) {}
+
+    /// Stops the thread, and leaves the clock at the tempo and position it had
+    ~NetworkClock();
+
+    NetworkClock(const NetworkClock&) = delete;
+    NetworkClock& operator=(const NetworkClock&) = delete;
+
+    /// Change the tempo of the session. May be called from any thread.
+    void set_bpm(float bpm) noexcept;
+
+    /// The number of other units in the session. May be called from any thread.
+    int peer_count() const noexcept
+    {
+      return _peer_count;
+    }
+
+  private:
+    void run();
+    /// Open the socket, and join the group. \returns false if the network is not ready.
+    bool connect();
+
+    ClockManager& _clock_manager;
+    tl::optional<ClockManager::Client> _client;
+    Config _config;
+    int _socket = -1;
+    std::atomic<float> _requested_bpm = 0;
+    std::atomic_int _peer_count = 0;
+    std::atomic_bool _running = true;
+    std::thread _thread;
+  };
+
+} // namespace otto::services
@@ -0,0 +1,180 @@
+#include "osc_server.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "core/props/property_table.hpp"
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::services {
+
+  using Change = core::engine::ParameterQueue::Change;
+
+  namespace {
+    /// Reads the big endian, 4 byte aligned fields of an OSC packet
+    struct Reader {
+      gsl::span<const std::uint8_t> data;
+      std::size_t pos = 0;
+
+      bool at_end() const noexcept
+      {
+        return pos >= std::size_t(data.size());
+      }
+
+      /// A string padded with zeros to a multiple of 4 bytes
+      bool string(std::string_view& out) noexcept
+      {
+        if (at_end()) return false;
+        auto* start = reinterpret_cast<const char*>(data.data()) + pos;
+        auto* end = static_cast<const char*>(std::memchr(start, 0, data.size() - pos));
+        if (end == nullptr) return false;
+        out = {start, std::size_t(end - start)};
+        pos += (out.size() + 4) & ~std::size_t(3);
+        return pos <= std::size_t(data.size());
+      }
+
+      bool u32(std::uint32_t& out) noexcept
+      {
+        if (pos + 4 > std::size_t(data.size())) return false;
+        out = 0;
+        for (int i = 0; i < 4; i++) out = out << 8 | data[pos++];
+        return true;
+      }
+
+      bool u64(std::uint64_t& out) noexcept
+      {
+        std::uint32_t high, low;
+        if (!u32(high) || !u32(low)) return false;
+        out = std::uint64_t(high) << 32 | low;
+        return true;
+      }
+    };
+
+    template<typename T, typename U>
+    T bit_cast(U value) noexcept
+    {
+      static_assert(sizeof(T) == sizeof(U));
+      T res;
+      std::memcpy(&res, &value, sizeof(res));
+      return res;
+    }
+
+    bool parse_message(Reader in, const OscServer::Handler& handler)
+    {
+      std::string_view address, tags;
+      if (!in.string(address) || address.empty() || address[0] != '/') return false;
+      // Messages without arguments may leave out the type tags
+      if (in.at_end()) return true;
+      if (!in.string(tags) || tags.empty() || tags[0] != ',') return false;
+      if (tags.size() < 2) return true;
+      std::uint32_t u32;
+      std::uint64_t u64;
+      switch (tags[1]) {
+      case 'f':
+        if (!in.u32(u32)) return false;
+        handler({address, bit_cast<float>(u32)});
+        return true;
+      case 'd':
+        if (!in.u64(u64)) return false;
+        handler({address, bit_cast<double>(u64)});
+        return true;
+      case 'i':
+        if (!in.u32(u32)) return false;
+        handler({address, double(std::int32_t(u32))});
+        return true;
+      case 'h':
+        if (!in.u64(u64)) return false;
+        handler({address, double(std::int64_t(u64))});
+        return true;
+      case 'T': handler({address, 1}); return true;
+      case 'F': handler({address, 0}); return true;
+      default: return true;
+      }
+    }
+  } // namespace
+
+  bool OscServer::parse(gsl::span<const std::uint8_t> packet, const Handler& handler)
+  {
+    Reader in{packet};
+    std::string_view tag;
+    if (packet.size() < 8 || std::memcmp(packet.data(), "#bundle", 8) != 0) {
+      return parse_message(in, handler);
+    }
+    std::uint64_t time_tag;
+    if (!in.string(tag) || !in.u64(time_tag)) return false;
+    while (!in.at_end()) {
+      std::uint32_t size;
+      if (!in.u32(size) || size % 4 != 0 || in.pos + size > std::size_t(packet.size())) return false;
+      if (!parse(packet.subspan(in.pos, size), handler)) return false;
+      in.pos += size;
+    }
+    return true;
+  }
+
+  tl::optional<Change> OscServer::change_of(const core::engine::ParameterQueue& queue, const Message& msg)
+  {
+    auto address = msg.address.substr(1);
+    auto slash = address.find('/');
+    if (slash == std::string_view::npos) return tl::nullopt;
+    int part = queue.find_part(address.substr(0, slash));
+    if (part < 0) return tl::nullopt;
+    auto path = std::string("props") + std::string(address.substr(slash));
+    return Change{part, core::props::hash_path(path), msg.value};
+  }
+
+  OscServer::OscServer(core::engine::ParameterQueue& queue, int port) : _queue(queue), _port(port)
+  {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(_port);
+    _socket = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (_socket < 0 || ::bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      LOGE("OSC: could not listen on port {}: {}", _port, std::strerror(errno));
+      if (_socket >= 0) ::close(_socket);
+      _socket = -1;
+      return;
+    }
+    _thread = util::start_thread(util::ThreadClass::io, [this] { run(); });
+    LOGI("OSC: listening on port {}", _port);
+  }
+
+  OscServer::~OscServer()
+  {
+    _running = false;
+    if (_thread.joinable()) _thread.join();
+    if (_socket >= 0) ::close(_socket);
+  }
+
+  void OscServer::run()
+  {
+    // The largest UDP payload
+    std::vector<std::uint8_t> buf(65536);
+    std::vector<Change> changes;
+    while (_running) {
+      // Wake up regularly to see if the server is stopping
+      pollfd fd = {_socket, POLLIN, 0};
+      if (::poll(&fd, 1, 200) <= 0) continue;
+      auto n = ::recv(_socket, buf.data(), buf.size(), 0);
+      if (n <= 0) continue;
+      _packet_count++;
+      changes.clear();
+      bool valid = parse({buf.data(), n}, [&](const Message& msg) {
+        if (auto change = change_of(_queue, msg)) changes.push_back(*change);
+      });
+      LOGW_IF(!valid, "OSC: malformed packet of {} bytes", n);
+      if (!changes.empty() && !_queue.push(changes)) {
+        LOGW("OSC: dropped {} changes, the audio thread is not keeping up", changes.size());
+      }
+    }
+  }
+
+} // namespace otto::services
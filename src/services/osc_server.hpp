@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <thread>
+
+#include <gsl/span>
+#include <tl/optional.hpp>
+
+#include "core/engine/parameter_queue.hpp"
+
+namespace otto::services {
+
+  /// Sets the properties of the engines from OSC messages over UDP, for show control systems
+  ///
+  /// The address of a property is the name of its part followed by its path without `props/`,
+  /// like `/Synth/envelope/attack`, the same paths as in the state. A message sets the property
+  /// to its first argument, which may be a float, a double, an int, a long, or true or false.
+  /// Values are in the units of the property, and clamped to its limits.
+  ///
+  /// The changes in a packet, which may be a bundle of many messages, go onto the
+  /// @ref core::engine::ParameterQueue as one batch, and the audio thread sets each property
+  /// once per buffer. Time tags are ignored, bundles take effect at the next buffer.
+  ///
+  /// The server runs on its own thread. Errors are logged, and leave the server stopped.
+  struct OscServer {
+    /// An OSC message with a numeric argument
+    struct Message {
+      std::string_view address;
+      double value;
+    };
+
+    using Handler = std::function<void(const Message&)>;
+
+    static constexpr int default_port = 9000;
+
+    OscServer(core::engine::ParameterQueue& queue, int port = default_port);
+
+    /// Stops the thread
+    ~OscServer();
+
+    OscServer(const OscServer&) = delete;
+    OscServer& operator=(const OscServer&) = delete;
+
+    /// Call `handler` for each message with a numeric first argument in the OSC packet
+    /// `packet`, in order, recursing into bundles
+    ///
+    /// Messages with other arguments are skipped.
+    /// \returns `false` if the packet is malformed. The messages before the error are handled.
+    static bool parse(gsl::span<const std::uint8_t> packet, const Handler& handler);
+
+    /// The change of the property `msg` is addressed to, or `tl::nullopt` if there is no such
+    /// part in `queue`
+    static tl::optional<core::engine::ParameterQueue::Change> change_of(const core::engine::ParameterQueue& queue,
+                                                                      const Message& msg);
+
+    /// The number of packets received, including malformed ones
+    std::uint64_t packet_count() const noexcept
+    {
+      return _packet_count;
+    }
+
+  private:
+    void run();
+
+    core::engine::ParameterQueue& _queue;
+    int _port;
+    int _socket = -1;
+    std::atomic<std::uint64_t> _packet_count = 0;
+    std::atomic_bool _running = true;
+    std::thread _thread;
+  };
+
+} // namespace otto::services
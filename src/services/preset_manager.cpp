@@ -1,16 +1,123 @@
 #include "preset_manager.hpp"
 
+#include <cmath>
+
+#include "services/asset_loader.hpp"
+#include "services/clock_manager.hpp"
 #include "services/debug_ui.hpp"
+#include "util/timer.hpp"
 
 namespace otto::services {
 
   PresetManager::PresetManager()
   {
-    load_preset_files();
+    if (!fs::exists(presets_dir)) {
+      DLOGI("Creating preset directory");
+      fs::create_directories(presets_dir);
+    }
+    // Started before indexing, so no change is missed. Changes seen meanwhile are applied
+    // after it.
+    _watcher = std::make_unique<util::DirectoryWatcher>(presets_dir, [this](const fs::path& path, auto change) {
+      auto filename = path.filename().string();
+      if (filename.empty() || filename[0] == '.') return;
+      FileChange fc{path.string(), change == util::DirectoryWatcher::Change::removed};
+      if (!fc.removed) {
+        try {
+          util::JsonFile jf{path};
+          jf.read();
+          fc.engine = jf.data()["engine"];
+          fc.name = jf.data()["name"];
+          fc.props = std::move(jf.data()["props"]);
+        } catch (std::exception& e) {
+          LOGW("Could not load preset file {}: {}", fc.file, e.what());
+          return;
+        }
+      }
+      std::unique_lock lock(_changes_mutex);
+      _changes.push_back(std::move(fc));
+    });
+    _indexing = std::async(std::launch::async, [this] { index_presets(); });
+  }
+
+  bool PresetManager::update()
+  {
+    if (_indexing.valid() && _indexing.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return false;
+    }
+    std::vector<FileChange> changes;
+    {
+      std::unique_lock lock(_changes_mutex);
+      std::swap(changes, _changes);
+    }
+    bool changed = false;
+    for (auto& change : changes) changed |= apply_change(change);
+    if (changed) _revision++;
+    return changed;
+  }
+
+  bool PresetManager::apply_change(FileChange& change)
+  {
+    if (change.removed) {
+      _preset_bodies.erase(change.file);
+      bool removed = remove_preset_file(change.file);
+      LOGI_IF(removed, "Removed preset file {}", change.file);
+      return removed;
+    }
+    _preset_bodies.insert(change.file, std::move(change.props));
+    // Files that are only rewritten keep their place in the list
+    if (auto found = _preset_data.find(change.engine); found != _preset_data.end()) {
+      auto& pd = found->value;
+      auto file = util::find(pd.files, change.file);
+      if (file != pd.files.end() && pd.names[file - pd.files.begin()] == change.name) return false;
+    }
+    remove_preset_file(change.file);
+    add_preset(change.engine, change.name, change.file);
+    LOGI("Loaded preset '{}' for engine '{}' from {}", change.name, change.engine, change.file);
+    return true;
+  }
+
+  void PresetManager::add_preset(const std::string& engine,
+                                 const std::string& name,
+                                 const std::string& file)
+  {
+    auto& pd = _preset_data.emplace(engine).iter()->value;
+    if (auto found = util::find(pd.names, name); found != pd.names.end()) {
+      pd.files[found - pd.names.begin()] = file;
+      DLOGI("Reloaded preset '{}' for engine '{}", name, engine);
+    } else {
+      pd.names.push_back(name);
+      pd.files.push_back(file);
+      DLOGI("Loaded preset '{}' for engine '{}", name, engine);
+    }
+  }
+
+  bool PresetManager::remove_preset_file(const std::string& file)
+  {
+    bool removed = false;
+    for (auto&& [engine, pd] : _preset_data) {
+      for (std::size_t i = 0; i < pd.files.size();) {
+        if (pd.files[i] != file) {
+          i++;
+          continue;
+        }
+        pd.files.erase(pd.files.begin() + i);
+        pd.names.erase(pd.names.begin() + i);
+        removed = true;
+      }
+    }
+    return removed;
+  }
+
+  void PresetManager::wait_until_indexed()
+  {
+    if (!_indexing.valid()) return;
+    TIME_SCOPE("PresetManager::wait_until_indexed");
+    _indexing.get();
   }
 
   const std::vector<std::string>& PresetManager::preset_names(util::string_ref engine_name)
   {
+    wait_until_indexed();
     auto eg_found = _preset_data.find(engine_name);
     if (eg_found == _preset_data.end()) {
       eg_found = _preset_data.insert(std::string(engine_name), PresetNamesDataPair{}).iter();
@@ -43,6 +150,8 @@ namespace otto::services {
                                    std::string_view name,
                                    bool no_enable_callback)
   {
+    TIME_SCOPE("PresetManager::apply_preset");
+    wait_until_indexed();
     auto pd_iter = _preset_data.find(engine.name());
     if (pd_iter == _preset_data.end()) {
       throw exception(ErrorCode::no_such_engine, "No engine named '{}'", engine.name());
@@ -54,60 +163,186 @@ namespace otto::services {
     }
     DLOGI("Applying preset {} to engine {}", name, engine.name());
     int idx = niter - pd_iter->value.names.begin();
-    engine.from_json(pd_iter->value.data[idx]);
+    engine.from_json(preset_body(pd_iter->value.files[idx]));
     engine.current_preset(idx);
   }
 
   void PresetManager::apply_preset(core::engine::IEngine& engine, int idx, bool no_enable_callback)
   {
+    TIME_SCOPE("PresetManager::apply_preset");
+    wait_until_indexed();
     auto pd_iter = _preset_data.find(engine.name());
     if (pd_iter == _preset_data.end()) {
       throw exception(ErrorCode::no_such_engine, "No engine named '{}'", engine.name());
     }
     auto& pd = pd_iter->value;
-    if (idx < 0 || static_cast<std::size_t>(idx) >= pd.data.size()) {
+    if (idx < 0 || static_cast<std::size_t>(idx) >= pd.names.size()) {
       throw exception(ErrorCode::no_such_preset, "Preset index {} is out range for engine '{}'",
                       idx, engine.name());
     }
     DLOGI("Applying preset {} to engine {}", pd.names[idx], engine.name());
     try {
-      engine.from_json(pd.data[idx]);
+      engine.from_json(preset_body(pd.files[idx]));
     } catch(std::exception& e) {
       throw util::exception("Error applying preset: {}", e.what());
     }
     engine.current_preset(idx);
   }
 
+  void PresetManager::apply_preset_async(core::engine::IEngine& engine, int idx, bool quantized)
+  {
+    wait_until_indexed();
+    auto pd_iter = _preset_data.find(engine.name());
+    if (pd_iter == _preset_data.end()) {
+      throw exception(ErrorCode::no_such_engine, "No engine named '{}'", engine.name());
+    }
+    auto& pd = pd_iter->value;
+    if (idx < 0 || static_cast<std::size_t>(idx) >= pd.names.size()) {
+      throw exception(ErrorCode::no_such_preset, "Preset index {} is out range for engine '{}'",
+                      idx, engine.name());
+    }
+    auto token = _applying[&engine].restart();
+    auto& loader = AssetLoader::current();
+
+    auto apply = [&engine, idx, quantized, token, &loader](const nlohmann::json& body) {
+      // The snapshot is shared, since std::function needs a copyable step
+      std::shared_ptr<core::props::Snapshot> snapshot;
+      try {
+        snapshot = std::make_shared<core::props::Snapshot>(engine.snapshot(body));
+      } catch (std::exception& e) {
+        LOGE("Error applying preset: {}", e.what());
+        return;
+      }
+      auto step = [&engine, idx, snapshot] {
+        snapshot->apply();
+        engine.current_preset(idx);
+      };
+      auto& clock = ClockManager::current();
+      if (!quantized || !clock.running()) return step();
+      auto beats = static_cast<float>(clock.current_time());
+      float at = (std::floor(beats / beats_per_bar) + 1) * beats_per_bar;
+      loader.when(&engine,
+                  [at] {
+                    auto& clock = ClockManager::current();
+                    return !clock.running() || static_cast<float>(clock.current_time()) >= at;
+                  },
+                  step, token);
+    };
+
+    const auto& file = pd.files[idx];
+    if (auto* found = _preset_bodies.find(file)) return apply(*found);
+    loader.load(&engine,
+                [file] {
+                  util::JsonFile jf{fs::path(file)};
+                  jf.read();
+                  return std::make_unique<nlohmann::json>(std::move(jf.data()["props"]));
+                },
+                [this, file, apply](std::unique_ptr<nlohmann::json> body) {
+                  apply(_preset_bodies.insert(file, std::move(*body)));
+                },
+                token);
+  }
+
+  core::props::Morph PresetManager::make_morph(core::engine::IEngine& engine, int from, int to)
+  {
+    wait_until_indexed();
+    auto pd_iter = _preset_data.find(engine.name());
+    if (pd_iter == _preset_data.end()) {
+      throw exception(ErrorCode::no_such_engine, "No engine named '{}'", engine.name());
+    }
+    auto& pd = pd_iter->value;
+    for (int idx : {from, to}) {
+      if (idx < 0 || static_cast<std::size_t>(idx) >= pd.names.size()) {
+        throw exception(ErrorCode::no_such_preset, "Preset index {} is out range for engine '{}'",
+                        idx, engine.name());
+      }
+    }
+    DLOGI("Morphing engine {} from preset {} to {}", engine.name(), pd.names[from], pd.names[to]);
+    // Copied, since getting the second one may evict the first from the cache
+    nlohmann::json from_body = preset_body(pd.files[from]);
+    try {
+      return engine.morph(from_body, preset_body(pd.files[to]));
+    } catch (std::exception& e) {
+      throw util::exception("Error morphing presets: {}", e.what());
+    }
+  }
+
   void PresetManager::load_preset_files()
+  {
+    wait_until_indexed();
+    index_presets();
+  }
+
+  void PresetManager::index_presets()
   {
     LOG_SCOPE_FUNCTION(INFO);
     if (!fs::exists(presets_dir)) {
       DLOGI("Creating preset directory");
       fs::create_directories(presets_dir);
     }
+
+    util::JsonFile index_file{index_path, util::JsonFile::Format::msgpack};
+    if (fs::exists(index_path)) {
+      try {
+        index_file.read();
+      } catch (std::exception& e) {
+        LOGW("Rebuilding the preset index: {}", e.what());
+      }
+    }
+    auto& old_index = index_file.data();
+    if (!old_index.is_object()) old_index = nlohmann::json::object();
+    auto index = nlohmann::json::object();
+    int parsed = 0;
+
     DLOGI("Loading presets");
     for (auto&& de : fs::recursive_directory_iterator(presets_dir)) {
       if (de.is_directory()) continue;
       auto filename = de.path().filename().string();
       if (filename.size() == 0 || filename.c_str()[0] == '.') continue;
-      LOGI_SCOPE("Loading preset file {}", de.path());
-      if (de.is_regular_file() || de.is_symlink()) {
+      if (!de.is_regular_file() && !de.is_symlink()) continue;
+
+      auto file = de.path().string();
+      std::int64_t mtime = de.last_write_time().time_since_epoch().count();
+      std::uint64_t size = de.file_size();
+      nlohmann::json entry;
+      if (auto found = old_index.find(file); found != old_index.end() &&
+                                             found->value("mtime", std::int64_t(0)) == mtime &&
+                                             found->value("size", std::uint64_t(0)) == size) {
+        entry = std::move(*found);
+      } else {
+        LOGI_SCOPE("Loading preset file {}", file);
         util::JsonFile jf{de.path()};
         jf.read();
-        std::string engine = jf.data()["engine"];
-        std::string name = jf.data()["name"];
-        auto pd_iter = _preset_data.emplace(engine).iter();
-        auto& pd = pd_iter->value;
-        if (auto found = util::find(pd.names, name); found != pd.names.end()) {
-          pd.data[found - pd.names.begin()] = std::move(jf.data()["props"]);
-          DLOGI("Reloaded preset '{}' for engine '{}", name, engine);
-        } else {
-          pd.names.push_back(name);
-          pd.data.emplace_back(std::move(jf.data()["props"]));
-          DLOGI("Loaded preset '{}' for engine '{}", name, engine);
-        }
+        entry = {{"engine", jf.data()["engine"]},
+                 {"name", jf.data()["name"]},
+                 {"mtime", mtime},
+                 {"size", size}};
+        // It is parsed already, and likely to be applied soon if it was just saved
+        _preset_bodies.insert(file, std::move(jf.data()["props"]));
+        parsed++;
       }
+
+      add_preset(entry["engine"], entry["name"], file);
+      index[file] = std::move(entry);
     }
+
+    LOGI("Indexed {} presets, parsed {}", index.size(), parsed);
+    if (parsed > 0 || index.size() != old_index.size()) {
+      index_file.data() = std::move(index);
+      try {
+        index_file.write(util::JsonFile::OpenOptions::create);
+      } catch (std::exception& e) {
+        LOGE("Could not write the preset index: {}", e.what());
+      }
+    }
+  }
+
+  const nlohmann::json& PresetManager::preset_body(const std::string& file)
+  {
+    if (auto* found = _preset_bodies.find(file)) return *found;
+    util::JsonFile jf{fs::path(file)};
+    jf.read();
+    return _preset_bodies.insert(file, std::move(jf.data()["props"]));
   }
 
   void PresetManager::create_preset(util::string_ref engine_name,
@@ -124,7 +359,11 @@ namespace otto::services {
 
     jf.write(util::JsonFile::OpenOptions::create);
 
-    load_preset_files();
+    // Right away, so it is listed when this returns. The watcher sees the same change later.
+    wait_until_indexed();
+    FileChange change{jf.path().string(), false, std::string(engine_name), std::string(preset_name),
+                      std::move(jf.data()["props"])};
+    if (apply_change(change)) _revision++;
   }
 
 } // namespace otto::services
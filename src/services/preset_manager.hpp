@@ -1,10 +1,19 @@
 #pragma once
 
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include <foonathan/array/flat_map.hpp>
 
 #include "core/engine/engine.hpp"
 #include "core/service.hpp"
 #include "services/application.hpp"
+#include "util/cache.hpp"
+#include "util/cancel_token.hpp"
+#include "util/directory_watcher.hpp"
 
 namespace otto::services {
 
@@ -20,12 +29,22 @@ namespace otto::services {
 
     /// Initialize preset manager
     ///
-    /// \effects `load_preset_files()`
+    /// \effects Index the preset files on a background thread, so it does not hold up the
+    /// startup. The other member functions wait for it to finish.
     PresetManager();
 
+    /// The number of parsed presets kept in memory
+    static constexpr std::size_t body_cache_size = 32;
+
     /// (Re)load preset files
     ///
-    /// Invoked by @ref init. Call to reload all preset files.
+    /// Invoked in the background by the constructor. Call to reload all preset files. Files
+    /// added, changed or removed while running are picked up by @ref update instead.
+    ///
+    /// Only the engine and name of each preset are loaded. They are kept in an index on disk,
+    /// so only the files which changed since the last time are parsed. The properties of a
+    /// preset are parsed the first time it is applied, and the last @ref body_cache_size of
+    /// them are kept.
     ///
     /// \throws @ref filesystem::filesystem_error
     void load_preset_files();
@@ -44,6 +63,15 @@ namespace otto::services {
     /// that really needs access
     const std::vector<std::string>& preset_names(util::string_ref engine_name);
 
+    /// The number of times presets were added, removed or renamed
+    ///
+    /// Lets screens keep a copy of the names, and only copy them again when this changes. Only
+    /// changes on the UI thread.
+    std::uint64_t revision() const noexcept
+    {
+      return _revision;
+    }
+
     /// Get the name of preset with indx `idx`
     ///
     /// \throws @ref exception with @ref ErrorCode::no_such_preset if no matching
@@ -76,6 +104,43 @@ namespace otto::services {
     /// preset was found.
     void apply_preset(core::engine::IEngine& engine, int idx, bool no_enable_callback = false);
 
+    /// Apply preset `idx` to `engine`, without blocking the calling thread on the preset file
+    ///
+    /// A flow of steps through the @ref AssetLoader: the file is parsed on the loader thread,
+    /// unless it is cached, then it is parsed into a snapshot of the properties of `engine` on
+    /// the UI thread, which is applied right away or, if `quantized` and the clock is running,
+    /// at the start of the next bar. Assets the preset refers to are then requested by the
+    /// engine, as when its properties are set by hand.
+    ///
+    /// A new call for the same engine cancels the last one, at whichever step it is, so when
+    /// scrolling through presets only the last one is applied. Errors are logged.
+    ///
+    /// \throws @ref exception with @ref ErrorCode::no_such_preset if no matching
+    /// preset was found, or @ref ErrorCode::no_such_engine if no matching engine was found
+    void apply_preset_async(core::engine::IEngine& engine, int idx, bool quantized = false);
+
+    /// Quantized presets are applied on the first beat of a bar of this many beats
+    static constexpr int beats_per_bar = 4;
+
+    /// Make a morph of `engine` from preset `from` to preset `to`
+    ///
+    /// To be handed to `IEngineDispatcher::morph`.
+    ///
+    /// \throws @ref exception with @ref ErrorCode::no_such_preset if either preset was not
+    /// found, or @ref ErrorCode::no_such_engine if no matching engine was found
+    core::props::Morph make_morph(core::engine::IEngine& engine, int from, int to);
+
+    /// Apply the changes to preset files seen since the last call
+    ///
+    /// The preset directory is watched on a background thread, which parses changed files, so
+    /// presets copied in while running show up without a rescan. Here, on the UI thread, they
+    /// are added to or removed from the presets of their engine, and their cached properties
+    /// are replaced. Does nothing until the presets are indexed. Called by the @ref UIManager
+    /// once per frame.
+    ///
+    /// \returns whether any preset changed
+    bool update();
+
     void create_preset(util::string_ref engine_name,
                        std::string_view preset_name,
                        const nlohmann::json& preset_data);
@@ -83,15 +148,59 @@ namespace otto::services {
   private:
     struct PresetNamesDataPair {
       std::vector<std::string> names;
-      std::vector<nlohmann::json> data;
+      /// The file each preset was loaded from
+      std::vector<std::string> files;
+    };
+
+    /// A preset file changed on disk, as seen by `_watcher`
+    struct FileChange {
+      std::string file;
+      bool removed = false;
+      std::string engine;
+      std::string name;
+      nlohmann::json props;
     };
 
+    /// Index the preset files, see @ref load_preset_files
+    void index_presets();
+    /// Add the preset `name` of `engine` in `file`, or point the preset with that name to it
+    void add_preset(const std::string& engine, const std::string& name, const std::string& file);
+    /// Remove the presets of all engines in `file`
+    ///
+    /// \returns whether there were any
+    bool remove_preset_file(const std::string& file);
+    /// Update the presets, and the cache, for a changed file
+    ///
+    /// \returns whether any preset changed
+    bool apply_change(FileChange& change);
+    /// Wait for the indexing started by the constructor, and rethrow its errors once
+    void wait_until_indexed();
+
+    /// The props of the preset in `file`, parsed now unless they are in `_preset_bodies`
+    ///
+    /// The reference is valid until the next call.
+    const nlohmann::json& preset_body(const std::string& file);
+
     // Key is engine name.
     // This design is chosen because we want to expose the names vector
     // separately.
     foonathan::array::flat_map<std::string, PresetNamesDataPair> _preset_data;
+    /// The props of the most recently used presets, by file
+    util::lru_cache<std::string, nlohmann::json> _preset_bodies{body_cache_size};
 
     const fs::path presets_dir = Application::current().data_dir / "presets";
+    /// `{"<file>": {"engine": "", "name": "", "mtime": 0, "size": 0}, ...}`
+    const fs::path index_path = Application::current().data_dir / "preset_index.bin";
+    /// The indexing started by the constructor, until it is waited for
+    std::future<void> _indexing;
+    /// Filled by `_watcher`, and emptied by @ref update
+    std::vector<FileChange> _changes;
+    std::mutex _changes_mutex;
+    std::unique_ptr<util::DirectoryWatcher> _watcher;
+    /// See @ref revision
+    std::uint64_t _revision = 0;
+    /// The presets being applied by @ref apply_preset_async, by engine
+    std::unordered_map<const core::engine::IEngine*, util::CancelSource> _applying;
   };
 
 } // namespace otto::services
@@ -0,0 +1,61 @@
+#include "rt_log.hpp"
+
+#include <atomic>
+
+#include "services/log_manager.hpp"
+#include "util/mpsc_queue.hpp"
+
+namespace otto::services::rt_log {
+
+  namespace {
+    util::MPSCQueue<Record, queue_size>& queue() noexcept
+    {
+      static util::MPSCQueue<Record, queue_size> queue;
+      return queue;
+    }
+
+    std::atomic_int dropped = 0;
+    /// The value of `dropped` at the last call to `flush`. Only used by the writer.
+    int reported_dropped = 0;
+  } // namespace
+
+  std::string Record::format_message() const
+  {
+    return fmt::format(format, args[0], args[1], args[2], args[3]);
+  }
+
+  bool push(const Record& record) noexcept
+  {
+    if (queue().push(record)) return true;
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  bool pop(Record& out) noexcept
+  {
+    return queue().pop(out);
+  }
+
+  int dropped_count() noexcept
+  {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+  void flush()
+  {
+    Record record;
+    while (pop(record)) {
+      try {
+        loguru::log(record.verbosity, record.file, record.line, "{}", record.format_message());
+      } catch (std::exception& e) {
+        LOGE("Could not format real-time log message '{}' from {}:{}: {}", record.format, record.file,
+             record.line, e.what());
+      }
+    }
+    if (int count = dropped_count(); count != reported_dropped) {
+      LOGW("Dropped {} real-time log messages, the queue was full", count - reported_dropped);
+      reported_dropped = count;
+    }
+  }
+
+} // namespace otto::services::rt_log
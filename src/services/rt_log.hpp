@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include <fmt/format.h>
+
+// Like in log_manager.hpp, which includes this file
+#define LOGURU_USE_FMTLIB 1
+#include <loguru.hpp>
+
+/// Logging from real-time threads
+///
+/// Loguru formats and writes messages synchronously, taking locks on the way, so the
+/// `LOG` macros may block the audio thread for as long as the disk or terminal takes. The
+/// `RTLOG` macros instead push a fixed size record of the format string and its arguments to
+/// a lock-free queue, which @ref LogManager formats and writes on a background thread.
+/// Pushing never locks or allocates. If the queue is full, the message is dropped, and counted.
+///
+/// The format string, and any string arguments, must live for the rest of the program,
+/// usually as string literals. Only numbers, bools and strings can be passed, and at most
+/// @ref max_args of them.
+namespace otto::services::rt_log {
+
+  /// The maximum number of arguments to a message
+  constexpr int max_args = 4;
+
+  /// The maximum number of messages waiting to be written
+  constexpr std::size_t queue_size = 256;
+
+  /// An argument to a real-time log message
+  struct Arg {
+    enum struct Type : std::uint8_t { none, signed_int, unsigned_int, floating, string, boolean };
+
+    Arg() noexcept : i(0) {}
+    Arg(bool b) noexcept : type(Type::boolean), b(b) {}
+    Arg(const char* s) noexcept : type(Type::string), s(s) {}
+
+    template<typename T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>, int> = 0>
+    Arg(T i) noexcept : type(Type::signed_int), i(i)
+    {}
+
+    template<typename T, std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T>, int> = 0>
+    Arg(T u) noexcept : type(Type::unsigned_int), u(u)
+    {}
+
+    template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+    Arg(T f) noexcept : type(Type::floating), f(f)
+    {}
+
+    Type type = Type::none;
+    union {
+      std::int64_t i;
+      std::uint64_t u;
+      double f;
+      const char* s;
+      bool b;
+    };
+  };
+
+  /// A message waiting to be formatted
+  struct Record {
+    loguru::Verbosity verbosity = loguru::Verbosity_INFO;
+    const char* file = "";
+    unsigned line = 0;
+    const char* format = "";
+    std::array<Arg, max_args> args = {};
+
+    /// Format the message. Allocates, so not for the real-time thread.
+    std::string format_message() const;
+  };
+
+  /// Queue a record to be written
+  ///
+  /// Safe to call from any thread. Never locks or allocates.
+  /// \returns false if the queue was full, and the record was dropped
+  bool push(const Record& record) noexcept;
+
+  /// Take the oldest queued record
+  ///
+  /// Only to be called from one thread at a time, usually the writer thread of @ref LogManager.
+  /// \returns false if there was no record
+  bool pop(Record& out) noexcept;
+
+  /// The number of records dropped because the queue was full, since startup
+  int dropped_count() noexcept;
+
+  /// Format and log all queued records with loguru, and report the records dropped since the
+  /// last call
+  ///
+  /// Called by the writer thread of @ref LogManager.
+  void flush();
+
+  /// Queue a message. Use the `RTLOG` macros instead of calling this directly.
+  template<typename... Args>
+  void log(loguru::Verbosity verbosity, const char* file, unsigned line, const char* format, const Args&... args) noexcept
+  {
+    static_assert(sizeof...(Args) <= max_args, "Too many arguments to a real-time log message");
+    if (verbosity > loguru::current_verbosity_cutoff()) return;
+    push({verbosity, file, line, format, {Arg(args)...}});
+  }
+
+} // namespace otto::services::rt_log
+
+namespace fmt {
+
+  /// Formats the value of an @ref otto::services::rt_log::Arg with the spec it is formatted
+  /// with
+  template<>
+  struct formatter<otto::services::rt_log::Arg> {
+    template<typename ParseContext>
+    auto parse(ParseContext& ctx)
+    {
+      auto end = ctx.begin();
+      while (end != ctx.end() && *end != '}') ++end;
+      spec = "{:" + std::string(ctx.begin(), end) + "}";
+      return end;
+    }
+
+    template<typename FormatContext>
+    auto format(const otto::services::rt_log::Arg& arg, FormatContext& ctx) const
+    {
+      using Type = otto::services::rt_log::Arg::Type;
+      std::string res;
+      switch (arg.type) {
+        case Type::signed_int: res = fmt::format(spec, arg.i); break;
+        case Type::unsigned_int: res = fmt::format(spec, arg.u); break;
+        case Type::floating: res = fmt::format(spec, arg.f); break;
+        case Type::string: res = fmt::format(spec, arg.s); break;
+        case Type::boolean: res = fmt::format(spec, arg.b); break;
+        case Type::none: break;
+      }
+      return std::copy(res.begin(), res.end(), ctx.out());
+    }
+
+    std::string spec = "{}";
+  };
+
+} // namespace fmt
+
+/// Log a message from a real-time thread, like `LOG_F`. See @ref otto::services::rt_log.
+#define RTLOG_F(verbosity_name, ...)                                                               \
+  ::otto::services::rt_log::log(loguru::Verbosity_##verbosity_name, __FILE__, __LINE__, __VA_ARGS__)
+
+/// Like `RTLOG_F`, if `cond` is true
+#define RTLOG_IF_F(verbosity_name, cond, ...) ((cond) ? RTLOG_F(verbosity_name, __VA_ARGS__) : (void) 0)
+
+/// Real-time safe version of LOGI
+#define RTLOGI(...) RTLOG_F(INFO, __VA_ARGS__)
+
+/// Real-time safe version of LOGW
+#define RTLOGW(...) RTLOG_F(WARNING, __VA_ARGS__)
+
+/// Real-time safe version of LOGE
+#define RTLOGE(...) RTLOG_F(ERROR, __VA_ARGS__)
+
+/// Real-time safe version of LOGI_IF
+#define RTLOGI_IF(...) RTLOG_IF_F(INFO, __VA_ARGS__)
+
+/// Real-time safe version of LOGW_IF
+#define RTLOGW_IF(...) RTLOG_IF_F(WARNING, __VA_ARGS__)
+
+/// Real-time safe version of LOGE_IF
+#define RTLOGE_IF(...) RTLOG_IF_F(ERROR, __VA_ARGS__)
+
+#if LOGURU_DEBUG_LOGGING
+/// Real-time safe version of DLOGI
+#define DRTLOGI(...) RTLOGI(__VA_ARGS__)
+/// Real-time safe version of DLOGW
+#define DRTLOGW(...) RTLOGW(__VA_ARGS__)
+/// Real-time safe version of DLOGE
+#define DRTLOGE(...) RTLOGE(__VA_ARGS__)
+#else
+#define DRTLOGI(...)
+#define DRTLOGW(...)
+#define DRTLOGE(...)
+#endif
@@ -1,24 +1,54 @@
 #include "state_manager.hpp"
 
+#include "core/props/props.hpp"
 #include "services/application.hpp"
 #include "services/log_manager.hpp"
 
+#include "util/async_file_writer.hpp"
 #include "util/exception.hpp"
 #include "util/jsonfile.hpp"
+#include "util/timer.hpp"
 
 namespace otto::services {
 
   struct DefaultStateManager : StateManager {
-    DefaultStateManager();
+    DefaultStateManager(bool in_memory = false);
     ~DefaultStateManager();
 
     util::JsonFile data_file;
 
     void load() override;
     void save() override;
+    void autosave() override;
+    void mark_dirty(const std::string& name) override;
+    void export_json(const fs::path& path) override;
+    void import_json(const fs::path& path) override;
     void attach(std::string name, Loader load, Saver save) override;
+    void attach(std::string name, util::JsonTarget target, Saver save) override;
 
     void detach(std::string name) override;
+
+  private:
+    using clock = std::chrono::steady_clock;
+
+    /// Reads the sections of the state file straight into the targets of their clients, and
+    /// into `data_file.data()` for the other sections
+    util::JsonTarget sections();
+    /// Invoke the attached loaders with the data of `data_file`
+    void load_clients();
+    /// Give client `name` its data from `data_file`
+    void load_client(const std::string& name, Client& client);
+    /// Invoke the savers of the dirty clients, and put their state in `data_file`
+    void save_clients();
+    /// Hand a copy of the data of `data_file` to the writer thread
+    void queue_write();
+
+    clock::time_point _last_autosave = clock::now();
+    /// The value of `core::props::change_count` at the last save
+    std::uint64_t _saved_changes = 0;
+    util::AsyncFileWriter _writer;
+    /// Keep the state in `data_file` without ever reading or writing the file
+    bool _in_memory;
   };
 
   std::unique_ptr<StateManager> StateManager::create_default()
@@ -26,8 +56,14 @@ namespace otto::services {
     return std::make_unique<DefaultStateManager>();
   }
 
-  DefaultStateManager::DefaultStateManager()
-    : data_file(Application::current().data_dir / "state.json")
+  std::unique_ptr<StateManager> StateManager::create_in_memory()
+  {
+    return std::make_unique<DefaultStateManager>(true);
+  }
+
+  DefaultStateManager::DefaultStateManager(bool in_memory)
+    : data_file(Application::current().data_dir / "state.bin", util::JsonFile::Format::msgpack),
+      _in_memory(in_memory)
   {
     Application::current().events.post_init.subscribe([this] { load(); });
     Application::current().events.pre_exit.subscribe([this] { save(); });
@@ -37,8 +73,93 @@ namespace otto::services {
 
   void DefaultStateManager::load()
   {
-    data_file.read(util::JsonFile::OpenOptions::create);
+    if (_in_memory) {
+      load_clients();
+      return;
+    }
+    auto json_path = Application::current().data_dir / "state.json";
+    if (!fs::exists(data_file.path()) && fs::exists(json_path)) {
+      LOGI("Importing state from {}", json_path);
+      import_json(json_path);
+      return;
+    }
+
+    // Clients with a target are loaded as the file is parsed
+    data_file.data() = nlohmann::json::object();
+    try {
+      data_file.read_into(sections(), util::JsonFile::OpenOptions::create);
+    } catch (util::JsonFile::exception&) {
+      throw;
+    } catch (std::exception& e) {
+      // Read the file as a whole instead, to load the other clients, and log which client failed
+      LOGW("Could not read state as it was parsed: {}", e.what());
+      data_file.read();
+    }
+    load_clients();
+  }
 
+  void DefaultStateManager::save()
+  {
+    TIME_SCOPE("StateManager::save");
+    if (!_loaded) {
+      return;
+    }
+
+    for (auto&& [name, client] : _clients) client.dirty = true;
+    _saved_changes = core::props::change_count;
+    save_clients();
+    queue_write();
+    _writer.flush();
+  }
+
+  void DefaultStateManager::autosave()
+  {
+    auto now = clock::now();
+    if (!_loaded || now - _last_autosave < autosave_interval) return;
+    _last_autosave = now;
+
+    if (std::uint64_t changes = core::props::change_count; changes != _saved_changes) {
+      _saved_changes = changes;
+      for (auto&& [name, client] : _clients) client.dirty = true;
+    }
+    bool any_dirty = false;
+    for (auto&& [name, client] : _clients) any_dirty |= client.dirty;
+    if (!any_dirty) return;
+
+    save_clients();
+    queue_write();
+  }
+
+  void DefaultStateManager::mark_dirty(const std::string& name)
+  {
+    if (auto found = _clients.find(name); found != _clients.end()) found->value.dirty = true;
+  }
+
+  void DefaultStateManager::queue_write()
+  {
+    if (_in_memory) return;
+    // Copying the json is much faster than encoding and writing it
+    _writer.write(data_file.path(), data_file.data(), data_file.format());
+  }
+
+  void DefaultStateManager::export_json(const fs::path& path)
+  {
+    if (_loaded) save_clients();
+    util::JsonFile file(path);
+    file.data() = data_file.data();
+    file.write(util::JsonFile::OpenOptions::create);
+  }
+
+  void DefaultStateManager::import_json(const fs::path& path)
+  {
+    util::JsonFile file(path);
+    file.read();
+    data_file.data() = std::move(file.data());
+    load_clients();
+  }
+
+  void DefaultStateManager::load_clients()
+  {
     auto& data = data_file.data();
 
     if (data.is_null()) {
@@ -49,9 +170,9 @@ namespace otto::services {
       data = {};
     }
 
-    for (const auto& [name, client] : _clients) {
+    for (auto&& [name, client] : _clients) {
       try {
-        client.load(data[name]);
+        load_client(name, client);
       } catch (std::exception& e) {
         LOGE("Exception while loading state for {}: {}", name, e.what());
       }
@@ -60,21 +181,52 @@ namespace otto::services {
     _loaded = true;
   }
 
-  void DefaultStateManager::save()
+  void DefaultStateManager::load_client(const std::string& name, Client& client)
   {
-    if (!_loaded) {
+    auto& data = data_file.data();
+    if (client.load) {
+      client.load(data[name]);
       return;
     }
+    // Sections read as the file was parsed are not in the data
+    if (auto found = data.find(name); found != data.end() && !found->is_null()) {
+      client.target.read(nlohmann::json(*found));
+    }
+  }
+
+  util::JsonTarget DefaultStateManager::sections()
+  {
+    static const util::JsonTarget::Ops ops = {
+      [](void* self, nlohmann::json&& value) {
+        static_cast<DefaultStateManager*>(self)->data_file.data() = std::move(value);
+      },
+      [](void* self, std::string_view key) {
+        auto& sm = *static_cast<DefaultStateManager*>(self);
+        auto name = std::string(key);
+        if (auto found = sm._clients.find(name); found != sm._clients.end() && !found->value.load) {
+          return found->value.target;
+        }
+        return util::JsonTarget::of(sm.data_file.data()[name]);
+      },
+      nullptr};
+    return {this, ops};
+  }
 
+  void DefaultStateManager::save_clients()
+  {
+    auto start = clock::now();
     auto& data = data_file.data();
 
-    data.clear();
+    if (!data.is_object()) {
+      data = nlohmann::json::object();
+    }
 
-    for (const auto& [name, client] : _clients) {
+    for (auto&& [name, client] : _clients) {
+      if (!client.dirty) continue;
       data[name] = client.save();
+      client.dirty = false;
     }
-
-    data_file.write();
+    _save_durations.add(std::chrono::duration<double>(clock::now() - start).count());
   }
 
   void DefaultStateManager::attach(std::string name, Loader load, Saver save)
@@ -93,6 +245,17 @@ namespace otto::services {
     }
   }
 
+  void DefaultStateManager::attach(std::string name, util::JsonTarget target, Saver save)
+  {
+    if (_clients.find(name) != _clients.end()) {
+      throw util::exception("Tried to attach a state client with the same name as another: " +
+                            name);
+    }
+
+    _clients.insert_or_replace(name, Client{name, {}, std::move(save), true, target});
+    if (_loaded) load_client(name, _clients.find(name)->value);
+  }
+
   void DefaultStateManager::detach(std::string name)
   {
     if (_clients.find(name) == _clients.end()) {
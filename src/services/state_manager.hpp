@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <json.hpp>
 #include <string>
@@ -7,6 +8,9 @@
 
 #include "core/service.hpp"
 #include "services/application.hpp"
+#include "util/filesystem.hpp"
+#include "util/histogram.hpp"
+#include "util/json_reader.hpp"
 
 namespace otto::services {
 
@@ -16,18 +20,55 @@ namespace otto::services {
     /// Encoder
     using Saver = std::function<nlohmann::json()>;
 
-    /// Read `data/state.json` and invoke attached loaders
+    /// Read `data/state.bin` and invoke attached loaders
+    ///
+    /// If there is no `data/state.bin`, but a `data/state.json` from an older version, that is
+    /// imported instead.
     virtual void load() = 0;
 
-    /// Invoke attached savers and write `data/state.json`
+    /// Invoke attached savers and write `data/state.bin`
+    ///
+    /// The state is written as MessagePack, which is much faster to read and write than json.
+    /// Returns when the file is on disk.
     virtual void save() = 0;
 
+    /// Save the dirty clients in the background, if @ref autosave_interval has passed since
+    /// the last autosave
+    ///
+    /// Only the dirty clients are serialized, on the calling thread. The encoding and writing
+    /// happen on a worker thread. A change to any property marks all clients dirty, since
+    /// properties do not know which client they belong to. To be called regularly from the UI
+    /// thread.
+    virtual void autosave() = 0;
+
+    /// Mark the state of client `name` to be saved by the next autosave
+    ///
+    /// For state that is not kept in properties.
+    virtual void mark_dirty(const std::string& name) = 0;
+
+    /// Invoke attached savers and write the state as indented json to `path`
+    virtual void export_json(const fs::path& path) = 0;
+
+    /// Read the state from the json file at `path`, and invoke attached loaders
+    ///
+    /// The state is written to `data/state.bin` at the next @ref save.
+    virtual void import_json(const fs::path& path) = 0;
+
     /// Attach state handler with a name
     ///
     /// \throws [otto::util::exception]() If a handler has already been attached
     /// with the name `name`
     virtual void attach(std::string name, Loader load, Saver save) = 0;
 
+    /// Attach a state handler whose state is read straight into `target` as the file is parsed
+    ///
+    /// For state kept in objects registered for reflection, which then never exists as json
+    /// while loading. See @ref util::JsonTarget for how the state is read.
+    ///
+    /// \throws [otto::util::exception]() If a handler has already been attached
+    /// with the name `name`
+    virtual void attach(std::string name, util::JsonTarget target, Saver save) = 0;
+
     /// Detach a state handler
     ///
     /// \throws [otto::util::exception]() If no such handler is attached
@@ -35,15 +76,36 @@ namespace otto::services {
 
     static std::unique_ptr<StateManager> create_default();
 
+    /// A state manager that never touches `data/state.bin`, for plugin instances, whose state
+    /// is saved by the host
+    static std::unique_ptr<StateManager> create_in_memory();
+
+    /// The minimum time between two autosaves
+    std::chrono::milliseconds autosave_interval = std::chrono::seconds(10);
+
+    /// The time each save and autosave took on the calling thread, in seconds, up to 100 ms
+    ///
+    /// Covers invoking the savers. The file is written in the background. May be read from
+    /// any thread.
+    const util::Histogram<20>& save_durations() const noexcept
+    {
+      return _save_durations;
+    }
+
   protected:
 
     struct Client {
       std::string name;
       Loader load;
       Saver save;
+      /// Whether the state has changed since it was last saved
+      bool dirty = true;
+      /// Where the state is read, for clients without a loader
+      util::JsonTarget target = {};
     };
 
     bool _loaded = false;
+    util::Histogram<20> _save_durations{0, 0.1};
     foonathan::array::flat_map<std::string, Client> _clients;
   };
 
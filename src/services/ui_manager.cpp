@@ -1,11 +1,20 @@
 #include "ui_manager.hpp"
 
+#include <chrono>
+
+#include "services/asset_loader.hpp"
 #include "services/audio_manager.hpp"
 #include "services/engine_manager.hpp"
+#include "services/preset_manager.hpp"
 #include "services/state_manager.hpp"
 
 #include "core/ui/vector_graphics.hpp"
 
+#include "util/event.hpp"
+#include "util/memory_tags.hpp"
+#include "util/memory_usage.hpp"
+#include "util/timer.hpp"
+
 namespace otto::services {
 
   LED led_for_screen(ScreenEnum screen)
@@ -31,6 +40,7 @@ namespace otto::services {
       case ScreenEnum::external: return LED(Key::external);
       case ScreenEnum::twist1: return LED(Key::twist1);
       case ScreenEnum::twist2: return LED(Key::twist2);
+      case ScreenEnum::analyser: return LED(Key::master);
     }
     OTTO_UNREACHABLE;
   }
@@ -51,6 +61,7 @@ namespace otto::services {
     });
 
     state.octave.on_change().connect([&](auto octave) {
+      Application::current().audio_manager->octave(octave);
       LEDColor c = [&] {
         switch (std::abs(octave)) {
           case 1: return LEDColor::Blue;
@@ -65,14 +76,26 @@ namespace otto::services {
     });
 
     Application::current().events.post_init.subscribe([&] {
-      Controller::current().register_key_handler(Key::plus, [&](auto&&) { state.octave.step(1); });
-      Controller::current().register_key_handler(Key::minus, [&](auto&&) { state.octave.step(-1); });
+      // Shift + minus undoes the last edit of an engine, and shift + plus redoes it
+      Controller::current().register_key_handler(Key::plus, [&](auto&&) {
+        if (Controller::current().is_pressed(Key::shift)) {
+          Application::current().engine_manager->redo();
+        } else {
+          state.octave.step(1);
+        }
+      });
+      Controller::current().register_key_handler(Key::minus, [&](auto&&) {
+        if (Controller::current().is_pressed(Key::shift)) {
+          Application::current().engine_manager->undo();
+        } else {
+          state.octave.step(-1);
+        }
+      });
     });
 
-    auto load = [this](const nlohmann::json& j) { util::deserialize(state, j); };
     auto save = [this] { return util::serialize(state); };
 
-    Application::current().state_manager->attach("UI", load, save);
+    Application::current().state_manager->attach("UI", util::JsonTarget::of(state), save);
   }
 
   void UIManager::display(Screen& screen)
@@ -80,6 +103,7 @@ namespace otto::services {
     cur_screen->on_hide();
     cur_screen = &screen;
     cur_screen->on_show();
+    request_redraw();
   }
 
   core::ui::Screen& UIManager::current_screen()
@@ -92,23 +116,213 @@ namespace otto::services {
     screen_selectors_[se] = ss;
   }
 
+  auto UIManager::screen_selector(ScreenEnum screen) const -> ScreenSelector
+  {
+    return screen_selectors_[screen];
+  }
+
+  void UIManager::request_redraw() noexcept
+  {
+    _redraw_requested.store(true, std::memory_order_relaxed);
+  }
+
+  float UIManager::frame_rate(float full_rate) const noexcept
+  {
+    return full_rate / (1 + Application::current().audio_manager->quality_level());
+  }
+
+  bool UIManager::update_frame()
+  {
+    if (AssetLoader::current().process_completions()) request_redraw();
+    if (Application::current().preset_manager->update()) request_redraw();
+    // Events fired from the audio thread with `fire_deferred`
+    if (util::dispatch_deferred_events() > 0) request_redraw();
+#if OTTO_ENABLE_TIMERS
+    util::timer::collect();
+#endif
+    Application::current().engine_manager->update();
+    Application::current().state_manager->autosave();
+
+    auto& audio_manager = *Application::current().audio_manager;
+    if (_frame_count % cpu_usage_frames == 0) {
+      _cpu_usage = audio_manager.take_cpu_usage();
+      audio_manager.log_callback_stats();
+      if (show_hud) {
+        _hud_rss = util::resident_memory();
+        auto tags = util::memory_tags();
+        _hud_top_tag = tags.empty() ? "" : tags.front().name;
+        _hud_top_tag_bytes = tags.empty() ? 0 : tags.front().live;
+      }
+      request_redraw();
+    }
+    _frame_count.fetch_add(1, std::memory_order_relaxed);
+
+    // Drained while the overlay is hidden too, so it starts out with the latest loads
+    float load;
+    bool new_loads = false;
+    while (audio_manager.load_history().pop(load)) {
+      _hud_loads[_hud_loads_pos++ % _hud_loads.size()] = load;
+      new_loads = true;
+    }
+    if (show_hud && new_loads) request_redraw();
+
+    bool redraw = _redraw_requested.exchange(false, std::memory_order_relaxed);
+    auto changes = core::props::change_count.load(std::memory_order_relaxed);
+    if (changes != _drawn_change_count) {
+      _drawn_change_count = changes;
+      redraw = true;
+    }
+    // One more frame is drawn once the screen stops animating, to show where it stopped
+    bool animating = cur_screen->animating();
+    redraw = redraw || animating || _was_animating;
+    _was_animating = animating;
+    return redraw;
+  }
+
   void UIManager::draw_frame(vg::Canvas& ctx)
   {
+    TIME_SCOPE("UIManager::draw_frame");
+    if (_drawn_frame_count.fetch_add(1, std::memory_order_relaxed) == 0) {
+      Application::current().startup_phase("first frame");
+    }
     ctx.lineWidth(6);
     ctx.lineCap(vg::Canvas::LineCap::ROUND);
     ctx.lineJoin(vg::Canvas::Canvas::LineJoin::ROUND);
+
+    using clock = std::chrono::steady_clock;
+    const vg::DrawStats before = vg::draw_stats(ctx.nvg());
+    auto t0 = clock::now();
     ctx.group([&] { cur_screen->draw(ctx); });
+    float ms = std::chrono::duration<float, std::milli>(clock::now() - t0).count();
+    _screen_cost.draw_stats = vg::draw_stats(ctx.nvg()) - before;
+    _screen_cost.ms += 0.1f * (ms - _screen_cost.ms);
 
-    ctx.group([&] {
+    ctx.group([&] { draw_cpu_usage(ctx); });
+    if (show_screen_cost) ctx.group([&] { draw_screen_cost(ctx); });
+    if (show_hud) ctx.group([&] { draw_hud(ctx); });
+  }
+
+  void UIManager::draw_cpu_usage(vg::Canvas& ctx)
+  {
+    auto& audio_manager = *Application::current().audio_manager;
+    if (_cpu_usage.empty()) return;
+
+    // Percent of the time available for one buffer
+    double budget = audio_manager.buffer_budget_ns();
+    auto percent = [budget](double ns) { return int(100 * ns / budget); };
+
+    ctx.beginPath();
+    ctx.fillStyle(vg::Colours::White);
+    ctx.font(vg::Fonts::Norm, 12);
+    ctx.fillText(_cpu_text(percent(_cpu_usage.front().stats.avg)), {290, 230});
+
+    auto& callbacks = audio_manager.callback_stats();
+    int xruns = callbacks.input_overflows + callbacks.output_underflows;
+    int misses = callbacks.deadline_misses;
+    if (xruns > 0 || misses > 0) {
+      // Missed deadlines are caused by the dsp load, xruns without them by the driver
       ctx.beginPath();
+      ctx.fillStyle(vg::Colours::Red);
+      ctx.fillText(_xrun_text(xruns, misses), {230, 230});
       ctx.fillStyle(vg::Colours::White);
-      ctx.font(vg::Fonts::Norm, 12);
-      std::string cpu_time = fmt::format("{}%", int(100 * Application::current().audio_manager->cpu_time()));
-      ctx.fillText(cpu_time, {290, 230});
-    });
+    }
+
+#if OTTO_DEBUG_UI
+    // name: average / max in this window / worst ever
+    float y = 20;
+    for (auto& usage : _cpu_usage) {
+      auto& stats = usage.stats;
+      ctx.fillText(fmt::format("{}: {}% / {}% / {}%{}", usage.name, percent(stats.avg),
+                               percent(stats.max), percent(stats.worst),
+                               usage.denormals > 0 ? fmt::format(", {} denormals", usage.denormals) : ""),
+                   {10, y});
+      y += 14;
+    }
+    ctx.fillText(fmt::format("Load p99: {}%, interval p1-p99: {:.2f}-{:.2f}",
+                             int(100 * callbacks.load.quantile(0.99)),
+                             callbacks.interval.quantile(0.01), callbacks.interval.quantile(0.99)),
+                 {10, y});
+    y += 14;
+    auto& frames = frame_scheduler.frame_times();
+    ctx.fillText(fmt::format("Frame p50: {:.1f} ms, p99: {:.1f} ms, skipped: {}",
+                             1000 * frames.quantile(0.5), 1000 * frames.quantile(0.99),
+                             frame_scheduler.skipped()),
+                 {10, y});
+#endif
+  }
+
+  void UIManager::draw_screen_cost(vg::Canvas& ctx)
+  {
+    auto& stats = _screen_cost.draw_stats;
+    ctx.beginPath();
+    ctx.fillStyle(vg::Colours::White);
+    ctx.font(vg::Fonts::Norm, 12);
+    ctx.textAlign(vg::TextAlign::Left, vg::TextAlign::Top);
+    ctx.fillText(_screen_cost_text(_screen_cost.ms, stats.draw_calls(), stats.vertices), {4, 4});
+  }
+
+  void UIManager::draw_hud(vg::Canvas& ctx)
+  {
+    auto& app = Application::current();
+    auto& audio_manager = *app.audio_manager;
+    constexpr vg::Point origin = {170, 20};
+    constexpr vg::Size graph = {float(std::tuple_size_v<decltype(_hud_loads)>), 40};
+
+    ctx.beginPath();
+    ctx.rect({origin.x - 4, origin.y - 4}, {graph.w + 8, graph.h + 8 + 5 * 14});
+    ctx.fill(vg::Colour::bytes(0, 0, 0, 200));
+
+    // The loads, oldest on the left, up to 150%, with a line at 100%
+    auto y_of = [&](float load) { return origin.y + graph.h * (1 - std::min(load, 1.5f) / 1.5f); };
+    ctx.beginPath();
+    ctx.moveTo(origin.x, y_of(1));
+    ctx.lineTo(origin.x + graph.w, y_of(1));
+    ctx.lineWidth(1);
+    ctx.stroke(vg::Colours::Red);
+    ctx.beginPath();
+    float worst = 0;
+    for (std::size_t i = 0; i < _hud_loads.size(); i++) {
+      float load = _hud_loads[(_hud_loads_pos + i) % _hud_loads.size()];
+      worst = std::max(worst, load);
+      vg::Point p = {origin.x + float(i), y_of(load)};
+      if (i == 0) {
+        ctx.moveTo(p);
+      } else {
+        ctx.lineTo(p);
+      }
+    }
+    ctx.stroke(vg::Colours::Green);
+
+    auto& callbacks = audio_manager.callback_stats();
+    auto& pool = audio_manager.buffer_pool();
+    int voices = 0, max_voices = 0;
+    if (app.engine_manager) {
+      using Synth = core::engine::ITypedEngine<core::engine::EngineType::synth>;
+      if (auto* synth = dynamic_cast<Synth*>(app.engine_manager->by_name("Synth"))) {
+        voices = synth->voice_mgr().sounding_voices();
+        max_voices = synth->voice_mgr().max_active_voices();
+      }
+    }
+    auto& frames = frame_scheduler.frame_times();
 
-    Controller::current().flush_leds();
-    _frame_count++;
+    ctx.beginPath();
+    ctx.fillStyle(vg::Colours::White);
+    ctx.font(vg::Fonts::Norm, 12);
+    ctx.textAlign(vg::TextAlign::Left, vg::TextAlign::Top);
+    float y = origin.y + graph.h + 4;
+    ctx.fillText(fmt::format("Load max {}%, p99 {}%", int(100 * worst), int(100 * callbacks.load.quantile(0.99))),
+                 {origin.x, y});
+    ctx.fillText(fmt::format("Xruns {}, misses {}", callbacks.input_overflows + callbacks.output_underflows,
+                             callbacks.deadline_misses.load()),
+                 {origin.x, y += 14});
+    ctx.fillText(fmt::format("Voices {}/{}, buffers {}/{}", voices, max_voices, pool.high_water_mark(),
+                             pool.capacity()),
+                 {origin.x, y += 14});
+    ctx.fillText(fmt::format("RSS {:.1f} MB, {} {:.1f} MB", _hud_rss / 1e6, _hud_top_tag, _hud_top_tag_bytes / 1e6),
+                 {origin.x, y += 14});
+    ctx.fillText(fmt::format("Frame p50 {:.1f} ms, p99 {:.1f} ms", 1000 * frames.quantile(0.5),
+                             1000 * frames.quantile(0.99)),
+                 {origin.x, y += 14});
   }
 
 } // namespace otto::services
@@ -1,14 +1,21 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <unordered_map>
+#include <vector>
 #include <json.hpp>
 
+#include "util/cpu_meter.hpp"
+#include "util/frame_scheduler.hpp"
 #include "util/locked.hpp"
 #include "util/enum.hpp"
 
 #include "core/service.hpp"
 #include "core/props/props.hpp"
+#include "core/ui/draw_stats.hpp"
 #include "core/ui/screen.hpp"
+#include "core/ui/vector_graphics.hpp"
 #include "services/application.hpp"
 
 namespace otto::services {
@@ -49,7 +56,8 @@ namespace otto::services {
               settings,
               external,
               twist1,
-              twist2)
+              twist2,
+              analyser)
 
   BETTER_ENUM(KeyMode, std::uint8_t, midi, seq);
 
@@ -72,10 +80,11 @@ namespace otto::services {
 
     /// The main ui loop
     ///
-    /// This sets up all the device specific graphics, and calls @ref draw_frame 60 times pr second,
-    /// until @ref Application::running() is false, or the graphics are exitted by the user. It is
-    /// also responsible for listening to keyevents, and calling @ref keypress and @ref keyrelease
-    /// as apropriate.
+    /// This sets up all the device specific graphics, and calls @ref update_frame 60 times pr
+    /// second, until @ref Application::running() is false, or the graphics are exitted by the
+    /// user. Boards that can keep the last frame on screen only call @ref draw_frame when
+    /// @ref update_frame asks for it. It is also responsible for listening to keyevents, and
+    /// calling @ref keypress and @ref keyrelease as apropriate.
     ///
     /// On some platforms (OSX), all OpenGL calls must be made from the main
     /// thread, therefore this function is called from `main()`.
@@ -93,18 +102,98 @@ namespace otto::services {
 
     void register_screen_selector(ScreenEnum, ScreenSelector);
 
+    /// The selector registered for `screen`, or an empty function
+    ScreenSelector screen_selector(ScreenEnum screen) const;
+
+    /// What the last frame of the current screen cost to draw
+    struct ScreenCost {
+      /// The cpu time of `Screen::draw`, averaged over recent frames. On the gpu backends, this
+      /// only covers recording the draw calls.
+      float ms = 0;
+      /// The draw calls of the last frame
+      core::ui::vg::DrawStats draw_stats;
+    };
+
+    const ScreenCost& screen_cost() const noexcept
+    {
+      return _screen_cost;
+    }
+
+    /// Show @ref screen_cost in the top left corner
+    bool show_screen_cost = OTTO_DEBUG_UI;
+
+    /// Show the performance overlay, see @ref draw_hud
+    ///
+    /// Toggled with shift + settings.
+    bool show_hud = false;
+
+    /// The number of frames since startup, drawn or not. May be read from any thread.
+    unsigned frame_count() const noexcept
+    {
+      return _frame_count.load(std::memory_order_relaxed);
+    }
+
+    /// The number of frames drawn since startup. May be read from any thread.
+    unsigned drawn_frame_count() const noexcept
+    {
+      return _drawn_frame_count.load(std::memory_order_relaxed);
+    }
+
+    /// Redraw the screen on the next frame
+    ///
+    /// For changes that are not caught otherwise, see @ref update_frame. Can be called from any
+    /// thread.
+    void request_redraw() noexcept;
+
+    /// The frame rate to draw at, given the full frame rate of the board
+    ///
+    /// Divided by one more than the quality level of the audio manager, to leave the cpu to
+    /// the audio when it is short.
+    float frame_rate(float full_rate) const noexcept;
+
     State state;
 
   protected:
+    /// Do the work of a frame, other than drawing
+    ///
+    /// Processes finished assets, and updates the engine manager and the autosave. To be called
+    /// once per frame, whether it is drawn or not. It does no I/O of its own: the controller
+    /// sends LED changes from its own thread.
+    ///
+    /// \returns whether the screen has to be redrawn, because of a key or encoder event, a
+    /// change to a property, a finished asset, @ref request_redraw, new cpu statistics, or
+    /// because the current screen is `animating()`.
+    bool update_frame();
+
     /// Draws the current screen and overlays.
     void draw_frame(core::ui::vg::Canvas& ctx);
 
+    /// Draw the cpu usage of the audio chain
+    ///
+    /// Shows the total load, and with `OTTO_DEBUG_UI`, the average and worst load of each part
+    /// of the engine chain. The statistics are updated every @ref cpu_usage_frames frames.
+    void draw_cpu_usage(core::ui::vg::Canvas& ctx);
+
+    /// Draw the overlay of @ref screen_cost
+    void draw_screen_cost(core::ui::vg::Canvas& ctx);
+
+    /// Draw the performance overlay
+    ///
+    /// A graph of the load of the recent audio callbacks, the xruns and deadline misses, the
+    /// voices of the synth, the high water mark of the buffer pool, the memory use and the UI
+    /// frame times. It only reads counters written by their owners, so the audio thread does
+    /// no work for it.
+    void draw_hud(core::ui::vg::Canvas& ctx);
+
     /// Display a screen.
     ///
     /// Calls @ref Screen::on_hide for the old screen, and then @ref Screen::on_show
     /// for the new screen
     void display(core::ui::Screen& screen);
 
+    /// Paces the main ui loop, and records its frame times
+    util::FrameScheduler frame_scheduler;
+
   private:
     struct EmptyScreen : core::ui::Screen {
       void draw(core::ui::vg::Canvas& ctx) {}
@@ -114,7 +203,31 @@ namespace otto::services {
 
     util::enum_map<ScreenEnum, ScreenSelector> screen_selectors_;
 
-    unsigned _frame_count = 0;
+    std::atomic<unsigned> _frame_count = 0;
+    std::atomic<unsigned> _drawn_frame_count = 0;
+
+    std::atomic<bool> _redraw_requested = true;
+    /// `props::change_count` when the screen was last drawn
+    std::uint64_t _drawn_change_count = 0;
+    bool _was_animating = false;
+
+    /// The number of frames to accumulate cpu statistics over
+    static constexpr unsigned cpu_usage_frames = 30;
+    std::vector<util::CpuUsage> _cpu_usage;
+    core::ui::vg::FormattedText<int> _cpu_text = {"{}%"};
+    core::ui::vg::FormattedText<int, int> _xrun_text = {"X{} D{}"};
+
+    /// The loads drained from `AudioManager::load_history`, from `_hud_loads_pos` on
+    std::array<float, 128> _hud_loads = {};
+    std::size_t _hud_loads_pos = 0;
+    /// Read with the cpu statistics, since reading it opens a file
+    std::size_t _hud_rss = 0;
+    /// The memory tag with the most live bytes, read with `_hud_rss`
+    std::string _hud_top_tag;
+    std::size_t _hud_top_tag_bytes = 0;
+
+    ScreenCost _screen_cost;
+    core::ui::vg::FormattedText<float, int, int> _screen_cost_text = {"{:.2f} ms, {} calls, {} verts"};
 
     static constexpr const char* initial_engine = "Synth";
   };
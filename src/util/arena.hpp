@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "util/memory_tags.hpp"
+#include "util/page_memory.hpp"
+
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define OTTO_HAS_PMR 1
+#else
+#define OTTO_HAS_PMR 0
+#endif
+
+namespace otto::util {
+
+  /// A monotonic arena, which hands out memory from one block allocated up front
+  ///
+  /// Meant to hold all the DSP state of an engine, allocated at construction. The state is then
+  /// contiguous, so the audio thread walks it with few cache and TLB misses, and freeing the
+  /// engine frees one block. The block is a @ref PageMemory, so the hot DSP state never shares a
+  /// page with the UI state of the engine on the heap, and it can be put on huge pages.
+  /// Deallocating arena memory does nothing. Allocations that do not fit fall back to the heap,
+  /// and are counted in @ref overflow_bytes, so an arena sized too small still works.
+  ///
+  /// With a @ref MemoryTag, the block and the overflow are accounted to it.
+  ///
+  /// Not thread safe. Allocate at construction, not on the audio thread.
+  struct Arena {
+    /// The alignment of the block
+    static constexpr std::size_t block_alignment = 64;
+
+    /// \param huge_pages Whether to try to map the block from huge pages, rounded up to whole
+    ///                   huge pages. Worth it for arenas of hundreds of kilobytes or more,
+    ///                   which then take one or two TLB entries.
+    explicit Arena(std::size_t capacity, MemoryTag* tag = nullptr, bool huge_pages = false)
+      : _capacity(capacity),
+        _memory(capacity, huge_pages),
+        _block(static_cast<std::byte*>(_memory.data())),
+        _tag(tag)
+    {
+      if (_tag) _tag->add(_memory.size());
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() noexcept
+    {
+      if (_tag) _tag->remove(_memory.size() + _overflow_bytes);
+    }
+
+    /// Allocate `bytes` aligned to `alignment`, from the block if they fit
+    void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t))
+    {
+      auto start = (_used + alignment - 1) / alignment * alignment;
+      if (alignment <= block_alignment && start + bytes <= _capacity) {
+        _used = start + bytes;
+        return _block + start;
+      }
+      _overflow_bytes += bytes;
+      if (_tag) _tag->add(bytes);
+      return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    /// Free `p`, if it was allocated on the heap because the block was full
+    void deallocate(void* p, std::size_t, std::size_t alignment = alignof(std::max_align_t)) noexcept
+    {
+      if (!owns(p)) ::operator delete(p, std::align_val_t(alignment));
+    }
+
+    /// Whether `p` points into the block
+    bool owns(const void* p) const noexcept
+    {
+      auto b = reinterpret_cast<std::uintptr_t>(_block);
+      auto ptr = reinterpret_cast<std::uintptr_t>(p);
+      return ptr >= b && ptr < b + _capacity;
+    }
+
+    /// Make the whole block available again
+    ///
+    /// \requires nothing allocated from the arena is still in use
+    void reset() noexcept
+    {
+      _used = 0;
+    }
+
+    std::size_t capacity() const noexcept
+    {
+      return _capacity;
+    }
+
+    /// The number of bytes of the block in use, including alignment padding
+    std::size_t used() const noexcept
+    {
+      return _used;
+    }
+
+    /// The number of bytes allocated on the heap because they did not fit in the block
+    std::size_t overflow_bytes() const noexcept
+    {
+      return _overflow_bytes;
+    }
+
+    /// The pages the block was mapped from
+    PageMemory::Pages pages() const noexcept
+    {
+      return _memory.pages();
+    }
+
+  private:
+    std::size_t _capacity;
+    PageMemory _memory;
+    std::byte* _block;
+    std::size_t _used = 0;
+    std::size_t _overflow_bytes = 0;
+    MemoryTag* _tag;
+  };
+
+  /// A standard allocator using an @ref Arena, or the heap if it has none
+  ///
+  /// Lets containers of DSP classes live in the arena of their engine, while a default
+  /// constructed allocator makes the same classes usable on their own.
+  template<typename T>
+  struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator(Arena* arena = nullptr) noexcept : arena(arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& rhs) noexcept : arena(rhs.arena)
+    {}
+
+    T* allocate(std::size_t n)
+    {
+      if (arena) return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+      return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+      if (arena) return arena->deallocate(p, n * sizeof(T), alignof(T));
+      std::allocator<T>().deallocate(p, n);
+    }
+
+    Arena* arena;
+  };
+
+  template<typename T, typename U>
+  bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) noexcept
+  {
+    return lhs.arena == rhs.arena;
+  }
+
+  template<typename T, typename U>
+  bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) noexcept
+  {
+    return lhs.arena != rhs.arena;
+  }
+
+  /// A vector that allocates from an @ref Arena
+  template<typename T>
+  using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+  /// A pool of fixed size blocks, with O(1) allocation and deallocation
+  ///
+  /// The blocks are carved out of an @ref Arena, or the heap, at construction, and freed blocks
+  /// are kept on an intrusive free-list, so allocating never touches the heap. Not thread safe.
+  struct BlockPool {
+    /// \param block_size The size of each block, rounded up to a multiple of the alignment
+    /// \param count The number of blocks
+    BlockPool(std::size_t block_size, std::size_t count, Arena* arena = nullptr)
+      : _block_size((std::max(block_size, sizeof(void*)) + alignment - 1) / alignment * alignment),
+        _count(count),
+        _storage(_block_size * count, ArenaAllocator<std::byte>(arena))
+    {
+      for (std::size_t i = count; i-- > 0;) push_free(_storage.data() + i * _block_size);
+    }
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    /// A free block, or `nullptr` if all are in use
+    void* allocate() noexcept
+    {
+      if (!_free) return nullptr;
+      auto* block = _free;
+      _free = block->next;
+      _in_use++;
+      return block;
+    }
+
+    /// Return a block from @ref allocate to the pool
+    void deallocate(void* p) noexcept
+    {
+      push_free(p);
+      _in_use--;
+    }
+
+    std::size_t block_size() const noexcept
+    {
+      return _block_size;
+    }
+
+    std::size_t capacity() const noexcept
+    {
+      return _count;
+    }
+
+    std::size_t in_use() const noexcept
+    {
+      return _in_use;
+    }
+
+  private:
+    static constexpr std::size_t alignment = alignof(std::max_align_t);
+
+    struct FreeBlock {
+      FreeBlock* next;
+    };
+
+    void push_free(void* p) noexcept
+    {
+      _free = new (p) FreeBlock{_free};
+    }
+
+    std::size_t _block_size;
+    std::size_t _count;
+    ArenaVector<std::byte> _storage;
+    FreeBlock* _free = nullptr;
+    std::size_t _in_use = 0;
+  };
+
+#if OTTO_HAS_PMR
+  /// An @ref Arena as a `std::pmr::memory_resource`, for `std::pmr` containers
+  struct ArenaResource : std::pmr::memory_resource {
+    ArenaResource(Arena& arena) noexcept : arena(arena) {}
+
+    Arena& arena;
+
+  private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+      return arena.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+      arena.deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+      auto* rhs = dynamic_cast<const ArenaResource*>(&other);
+      return rhs && &rhs->arena == &arena;
+    }
+  };
+#endif
+
+} // namespace otto::util
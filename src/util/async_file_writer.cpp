@@ -0,0 +1,66 @@
+#include "async_file_writer.hpp"
+
+#include <algorithm>
+
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::util {
+
+  AsyncFileWriter::AsyncFileWriter() : _thread(start_thread(ThreadClass::io, [this] { run(); })) {}
+
+  AsyncFileWriter::~AsyncFileWriter()
+  {
+    {
+      std::unique_lock lock(_mutex);
+      _quit = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+  }
+
+  void AsyncFileWriter::write(fs::path path, nlohmann::json data, JsonFile::Format format)
+  {
+    {
+      std::unique_lock lock(_mutex);
+      auto found = std::find_if(_jobs.begin(), _jobs.end(),
+                                [&](const Job& job) { return job.path == path; });
+      if (found != _jobs.end()) {
+        found->data = std::move(data);
+        found->format = format;
+      } else {
+        _jobs.push_back({std::move(path), std::move(data), format});
+      }
+    }
+    _cv.notify_all();
+  }
+
+  void AsyncFileWriter::flush()
+  {
+    std::unique_lock lock(_mutex);
+    _cv.wait(lock, [this] { return _jobs.empty() && !_writing; });
+  }
+
+  void AsyncFileWriter::run()
+  {
+    std::unique_lock lock(_mutex);
+    while (true) {
+      _cv.wait(lock, [this] { return !_jobs.empty() || _quit; });
+      if (_jobs.empty()) return;
+      auto job = std::move(_jobs.front());
+      _jobs.erase(_jobs.begin());
+      _writing = true;
+      lock.unlock();
+      try {
+        JsonFile(job.path, job.format)
+          .write_encoded(JsonFile::encode(job.data, job.format), JsonFile::OpenOptions::create);
+      } catch (std::exception& e) {
+        LOGE("Could not write {}: {}", job.path.c_str(), e.what());
+      }
+      lock.lock();
+      _writing = false;
+      _cv.notify_all();
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <json.hpp>
+
+#include "util/filesystem.hpp"
+#include "util/jsonfile.hpp"
+
+namespace otto::util {
+
+  /// Encodes and writes json files on a background thread
+  ///
+  /// The calling thread only hands over the data, which it should have copied from any live
+  /// state. A write replaces an earlier write to the same path that has not started yet, so a
+  /// slow disk never builds up a backlog. Files are written with `JsonFile::write_encoded`, so
+  /// they are never left half written. Errors are logged.
+  struct AsyncFileWriter {
+    AsyncFileWriter();
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    /// Writes everything queued, and stops the thread
+    ~AsyncFileWriter();
+
+    /// Queue `data` to be written to `path` in `format`
+    void write(fs::path path, nlohmann::json data, JsonFile::Format format);
+
+    /// Wait until everything queued has been written
+    void flush();
+
+  private:
+    struct Job {
+      fs::path path;
+      nlohmann::json data;
+      JsonFile::Format format;
+    };
+
+    void run();
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    /// Guarded by `_mutex`
+    std::vector<Job> _jobs;
+    /// Guarded by `_mutex`
+    bool _writing = false;
+    /// Guarded by `_mutex`
+    bool _quit = false;
+    std::thread _thread;
+  };
+
+} // namespace otto::util
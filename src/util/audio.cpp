@@ -0,0 +1,308 @@
+#include "audio.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OTTO_AUDIO_X86 1
+#else
+#define OTTO_AUDIO_X86 0
+#endif
+
+namespace otto::util::audio {
+
+  namespace {
+
+    constexpr const char* inline_name()
+    {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+      return "neon";
+#elif defined(__SSE__)
+      return "sse2";
+#else
+      return "scalar";
+#endif
+    }
+
+    /// The inline kernels, with the instruction set of the build
+    constexpr KernelTable inline_kernels = {
+      inline_name(),
+      [](float* data, const float* g, int n) noexcept { gain(data, g, n); },
+      [](float* data, float g, int n) noexcept { gain(data, g, n); },
+      [](const float* src, const float* g, float* dst, int n) noexcept { multiply(src, g, dst, n); },
+      [](const float* src, float* dst, int n) noexcept { add(src, dst, n); },
+      [](const float* src, float g, float* dst, int n) noexcept { mix(src, g, dst, n); },
+      [](const float* src, const float* g, const float* pan, float* left, float* right, int n) noexcept {
+        mix_pan(src, g, pan, left, right, n);
+      },
+      [](const float* a, const float* ga, const float* b, const float* gb, float* dst, int n) noexcept {
+        multiply_sum(a, ga, b, gb, dst, n);
+      },
+      [](const float* a,
+         const float* ga,
+         const float* pa,
+         const float* b,
+         const float* gb,
+         const float* pb,
+         float* left,
+         float* right,
+         int n) noexcept { mix_pan_sum(a, ga, pa, b, gb, pb, left, right, n); },
+      [](const float* const* srcs,
+         int sources,
+         const float* from,
+         const float* to,
+         float* const* dsts,
+         int buses,
+         int n) noexcept { mix_matrix(srcs, sources, from, to, dsts, buses, n); },
+      [](const float* data, int n) noexcept { return peak(data, n); },
+      [](const float* data, int n) noexcept { return rms(data, n); },
+    };
+
+#if OTTO_AUDIO_X86
+    // Compiled for AVX2 without it being enabled for the whole build, and only called when the
+    // cpu supports it. The scalar tails match the inline kernels, and there is no FMA, so the
+    // results are the same.
+#define OTTO_AVX2 __attribute__((target("avx2")))
+
+    OTTO_AVX2 void gain_avx2(float* data, const float* g, int n) noexcept
+    {
+      int i = 0;
+      for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), _mm256_loadu_ps(g + i)));
+      }
+      for (; i < n; i++) data[i] *= g[i];
+    }
+
+    OTTO_AVX2 void scale_avx2(float* data, float g, int n) noexcept
+    {
+      int i = 0;
+      for (__m256 vg = _mm256_set1_ps(g); i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), vg));
+      }
+      for (; i < n; i++) data[i] *= g;
+    }
+
+    OTTO_AVX2 void multiply_avx2(const float* src, const float* g, float* dst, int n) noexcept
+    {
+      int i = 0;
+      for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(g + i)));
+      }
+      for (; i < n; i++) dst[i] = src[i] * g[i];
+    }
+
+    OTTO_AVX2 void add_avx2(const float* src, float* dst, int n) noexcept
+    {
+      int i = 0;
+      for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+      }
+      for (; i < n; i++) dst[i] += src[i];
+    }
+
+    OTTO_AVX2 void mix_avx2(const float* src, float g, float* dst, int n) noexcept
+    {
+      int i = 0;
+      for (__m256 vg = _mm256_set1_ps(g); i + 8 <= n; i += 8) {
+        __m256 s = _mm256_mul_ps(_mm256_loadu_ps(src + i), vg);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), s));
+      }
+      for (; i < n; i++) dst[i] += src[i] * g;
+    }
+
+    OTTO_AVX2 void mix_pan_avx2(const float* src,
+                                const float* g,
+                                const float* pan,
+                                float* left,
+                                float* right,
+                                int n) noexcept
+    {
+      int i = 0;
+      for (__m256 one = _mm256_set1_ps(1.f); i + 8 <= n; i += 8) {
+        __m256 s = _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(g + i));
+        __m256 p = _mm256_loadu_ps(pan + i);
+        _mm256_storeu_ps(right + i, _mm256_mul_ps(s, _mm256_add_ps(one, p)));
+        _mm256_storeu_ps(left + i, _mm256_mul_ps(s, _mm256_sub_ps(one, p)));
+      }
+      for (; i < n; i++) {
+        float s = src[i] * g[i];
+        right[i] = s * (1 + pan[i]);
+        left[i] = s * (1 - pan[i]);
+      }
+    }
+
+    OTTO_AVX2 void multiply_sum_avx2(const float* a,
+                                     const float* ga,
+                                     const float* b,
+                                     const float* gb,
+                                     float* dst,
+                                     int n) noexcept
+    {
+      int i = 0;
+      for (; i + 8 <= n; i += 8) {
+        __m256 sa = _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(ga + i));
+        __m256 sb = _mm256_mul_ps(_mm256_loadu_ps(b + i), _mm256_loadu_ps(gb + i));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(sa, sb));
+      }
+      for (; i < n; i++) dst[i] = a[i] * ga[i] + b[i] * gb[i];
+    }
+
+    OTTO_AVX2 void mix_pan_sum_avx2(const float* a,
+                                    const float* ga,
+                                    const float* pa,
+                                    const float* b,
+                                    const float* gb,
+                                    const float* pb,
+                                    float* left,
+                                    float* right,
+                                    int n) noexcept
+    {
+      int i = 0;
+      for (__m256 one = _mm256_set1_ps(1.f); i + 8 <= n; i += 8) {
+        __m256 sa = _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(ga + i));
+        __m256 sb = _mm256_mul_ps(_mm256_loadu_ps(b + i), _mm256_loadu_ps(gb + i));
+        __m256 va = _mm256_loadu_ps(pa + i);
+        __m256 vb = _mm256_loadu_ps(pb + i);
+        _mm256_storeu_ps(right + i, _mm256_add_ps(_mm256_mul_ps(sa, _mm256_add_ps(one, va)),
+                                                  _mm256_mul_ps(sb, _mm256_add_ps(one, vb))));
+        _mm256_storeu_ps(left + i, _mm256_add_ps(_mm256_mul_ps(sa, _mm256_sub_ps(one, va)),
+                                                 _mm256_mul_ps(sb, _mm256_sub_ps(one, vb))));
+      }
+      for (; i < n; i++) {
+        float sa = a[i] * ga[i];
+        float sb = b[i] * gb[i];
+        right[i] = sa * (1 + pa[i]) + sb * (1 + pb[i]);
+        left[i] = sa * (1 - pa[i]) + sb * (1 - pb[i]);
+      }
+    }
+
+    OTTO_AVX2 void mix_matrix_avx2(const float* const* srcs,
+                                   int sources,
+                                   const float* from,
+                                   const float* to,
+                                   float* const* dsts,
+                                   int buses,
+                                   int n) noexcept
+    {
+      if (n <= 0) return;
+      const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+      for (int b = 0; b < buses; b++) {
+        float* dst = dsts[b];
+        const float* active[max_matrix_sources];
+        float start[max_matrix_sources];
+        float step[max_matrix_sources];
+        int count = 0;
+        for (int s = 0; s < sources; s++) {
+          float g0 = from[s * buses + b];
+          float g1 = to[s * buses + b];
+          if (srcs[s] == nullptr || (g0 == 0 && g1 == 0)) continue;
+          active[count] = srcs[s];
+          start[count] = g0;
+          step[count] = (g1 - g0) / n;
+          count++;
+        }
+        if (count == 0) {
+          std::fill_n(dst, n, 0.f);
+          continue;
+        }
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+          __m256 index = _mm256_add_ps(_mm256_set1_ps(float(i)), lanes);
+          __m256 acc = _mm256_setzero_ps();
+          for (int k = 0; k < count; k++) {
+            __m256 g = _mm256_add_ps(_mm256_set1_ps(start[k]), _mm256_mul_ps(_mm256_set1_ps(step[k]), index));
+            __m256 x = _mm256_mul_ps(_mm256_loadu_ps(active[k] + i), g);
+            acc = k == 0 ? x : _mm256_add_ps(acc, x);
+          }
+          _mm256_storeu_ps(dst + i, acc);
+        }
+        for (; i < n; i++) {
+          float acc = active[0][i] * (start[0] + step[0] * float(i));
+          for (int k = 1; k < count; k++) acc += active[k][i] * (start[k] + step[k] * float(i));
+          dst[i] = acc;
+        }
+      }
+    }
+
+    OTTO_AVX2 float peak_avx2(const float* data, int n) noexcept
+    {
+      float res = 0;
+      int i = 0;
+      __m256 vmax = _mm256_setzero_ps();
+      // Clears the sign bit
+      const __m256 sign = _mm256_set1_ps(-0.f);
+      for (; i + 8 <= n; i += 8) vmax = _mm256_max_ps(vmax, _mm256_andnot_ps(sign, _mm256_loadu_ps(data + i)));
+      float lanes[8];
+      _mm256_storeu_ps(lanes, vmax);
+      for (float l : lanes) res = std::max(res, l);
+      for (; i < n; i++) res = std::max(res, std::abs(data[i]));
+      return res;
+    }
+
+    OTTO_AVX2 float rms_avx2(const float* data, int n) noexcept
+    {
+      if (n <= 0) return 0;
+      float res = 0;
+      int i = 0;
+      __m256 vsum = _mm256_setzero_ps();
+      for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(data + i);
+        vsum = _mm256_add_ps(vsum, _mm256_mul_ps(v, v));
+      }
+      float lanes[8];
+      _mm256_storeu_ps(lanes, vsum);
+      for (float l : lanes) res += l;
+      for (; i < n; i++) res += data[i] * data[i];
+      return std::sqrt(res / n);
+    }
+
+#undef OTTO_AVX2
+
+    constexpr KernelTable avx2_kernels = {
+      "avx2",       gain_avx2,         scale_avx2,       multiply_avx2,   add_avx2,  mix_avx2,
+      mix_pan_avx2, multiply_sum_avx2, mix_pan_sum_avx2, mix_matrix_avx2, peak_avx2, rms_avx2,
+    };
+#endif
+
+    std::vector<const KernelTable*> find_supported()
+    {
+      std::vector<const KernelTable*> res = {&inline_kernels};
+#if OTTO_AUDIO_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")) res.push_back(&avx2_kernels);
+#endif
+      return res;
+    }
+
+    /// Select the table, before `main`
+    const KernelTable* select_kernels()
+    {
+      auto& supported = supported_kernels();
+      if (const char* name = std::getenv("OTTO_KERNELS")) {
+        for (auto* table : supported) {
+          if (std::strcmp(table->name, name) == 0) return table;
+        }
+      }
+      return supported.back();
+    }
+
+  } // namespace
+
+  namespace detail {
+    // Constant initialized, so the kernels can be called during static initialization too
+    const KernelTable* current_kernels = &inline_kernels;
+  } // namespace detail
+
+  namespace {
+    [[maybe_unused]] const bool kernels_selected = (detail::current_kernels = select_kernels(), true);
+  }
+
+  const std::vector<const KernelTable*>& supported_kernels() noexcept
+  {
+    static const std::vector<const KernelTable*> supported = find_supported();
+    return supported;
+  }
+
+} // namespace otto::util::audio
@@ -2,6 +2,18 @@
 
 // namespace otto::util::audio
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
 #include "util/dyn-array.hpp"
 #include "util/iterator.hpp"
 
@@ -36,6 +48,587 @@ namespace otto::util::audio {
     }
   }
 
+  // Buffer kernels //
+  //
+  // Loops over raw pointers, vectorised with NEON or SSE where available, with a scalar
+  // fallback. GCC does not vectorise loops over `util::zip`, so mixing code should use these.
+  // The pointers need no particular alignment, but buffers from `AudioBufferPool` are aligned
+  // to a cache line and padded to whole vectors, so kernels over whole pool buffers can be
+  // given `padded_size(n)` frames to skip the scalar tail. Unless stated otherwise, `src` and `dst` may
+  // be the same buffer, but must not overlap otherwise.
+
+  namespace detail {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    constexpr bool has_simd = true;
+    using vec = float32x4_t;
+    inline vec load(const float* p) noexcept
+    {
+      return vld1q_f32(p);
+    }
+    inline void store(float* p, vec v) noexcept
+    {
+      vst1q_f32(p, v);
+    }
+    inline vec splat(float f) noexcept
+    {
+      return vdupq_n_f32(f);
+    }
+    inline vec add(vec a, vec b) noexcept
+    {
+      return vaddq_f32(a, b);
+    }
+    inline vec sub(vec a, vec b) noexcept
+    {
+      return vsubq_f32(a, b);
+    }
+    inline vec mul(vec a, vec b) noexcept
+    {
+      return vmulq_f32(a, b);
+    }
+    inline vec max_abs(vec a, vec b) noexcept
+    {
+      return vmaxq_f32(a, vabsq_f32(b));
+    }
+#elif defined(__SSE__)
+    constexpr bool has_simd = true;
+    using vec = __m128;
+    inline vec load(const float* p) noexcept
+    {
+      return _mm_loadu_ps(p);
+    }
+    inline void store(float* p, vec v) noexcept
+    {
+      _mm_storeu_ps(p, v);
+    }
+    inline vec splat(float f) noexcept
+    {
+      return _mm_set1_ps(f);
+    }
+    inline vec add(vec a, vec b) noexcept
+    {
+      return _mm_add_ps(a, b);
+    }
+    inline vec sub(vec a, vec b) noexcept
+    {
+      return _mm_sub_ps(a, b);
+    }
+    inline vec mul(vec a, vec b) noexcept
+    {
+      return _mm_mul_ps(a, b);
+    }
+    inline vec max_abs(vec a, vec b) noexcept
+    {
+      // Clear the sign bit
+      return _mm_max_ps(a, _mm_andnot_ps(_mm_set1_ps(-0.f), b));
+    }
+#else
+    constexpr bool has_simd = false;
+    // Never used, but keeps the kernels compiling
+    using vec = float;
+    inline vec load(const float* p) noexcept
+    {
+      return *p;
+    }
+    inline void store(float* p, vec v) noexcept
+    {
+      *p = v;
+    }
+    inline vec splat(float f) noexcept
+    {
+      return f;
+    }
+    inline vec add(vec a, vec b) noexcept
+    {
+      return a + b;
+    }
+    inline vec sub(vec a, vec b) noexcept
+    {
+      return a - b;
+    }
+    inline vec mul(vec a, vec b) noexcept
+    {
+      return a * b;
+    }
+    inline vec max_abs(vec a, vec b) noexcept
+    {
+      return std::max(a, std::abs(b));
+    }
+#endif
+    /// The number of floats in a `vec`
+    constexpr int width = 4;
+
+    /// The number of frames of `n` handled by the vector loop
+    inline int vector_frames(int n) noexcept
+    {
+      return has_simd ? n - n % width : 0;
+    }
+  } // namespace detail
+
+  /// The number of floats processed at once by the buffer kernels
+  constexpr int vector_width = detail::width;
+
+  /// `n` rounded up to a whole number of vectors
+  constexpr std::size_t padded_size(std::size_t n) noexcept
+  {
+    return (n + vector_width - 1) / vector_width * vector_width;
+  }
+
+  /// Set `n` samples of `dst` to zero
+  inline void clear(float* dst, int n) noexcept
+  {
+    std::fill_n(dst, n, 0.f);
+  }
+
+  /// Copy `n` samples from `src` to `dst`
+  inline void copy(const float* src, float* dst, int n) noexcept
+  {
+    std::copy_n(src, n, dst);
+  }
+
+  /// Multiply `n` samples of `data` by `g`
+  inline void gain(float* data, float g, int n) noexcept
+  {
+    using namespace detail;
+    int i = 0;
+    for (vec vg = splat(g); i < vector_frames(n); i += width) store(data + i, mul(load(data + i), vg));
+    for (; i < n; i++) data[i] *= g;
+  }
+
+  /// Multiply `n` samples of `data` by the gains in `g`, like a smoothed volume
+  inline void gain(float* data, const float* g, int n) noexcept
+  {
+    using namespace detail;
+    int i = 0;
+    for (; i < vector_frames(n); i += width) store(data + i, mul(load(data + i), load(g + i)));
+    for (; i < n; i++) data[i] *= g[i];
+  }
+
+  /// Set `dst` to `src` times the gains in `g`
+  inline void multiply(const float* src, const float* g, float* dst, int n) noexcept
+  {
+    using namespace detail;
+    int i = 0;
+    for (; i < vector_frames(n); i += width) store(dst + i, mul(load(src + i), load(g + i)));
+    for (; i < n; i++) dst[i] = src[i] * g[i];
+  }
+
+  /// Add `src` to `dst`
+  inline void add(const float* src, float* dst, int n) noexcept
+  {
+    using namespace detail;
+    int i = 0;
+    for (; i < vector_frames(n); i += width) store(dst + i, add(load(dst + i), load(src + i)));
+    for (; i < n; i++) dst[i] += src[i];
+  }
+
+  /// Add `src` times `g` to `dst`
+  inline void mix(const float* src, float g, float* dst, int n) noexcept
+  {
+    using namespace detail;
+    int i = 0;
+    for (vec vg = splat(g); i < vector_frames(n); i += width) {
+      store(dst + i, add(load(dst + i), mul(load(src + i), vg)));
+    }
+    for (; i < n; i++) dst[i] += src[i] * g;
+  }
+
+  /// Set `dst` to the sum of the `count` buffers in `srcs`
+  ///
+  /// Sums in place if `dst` is the first of `srcs`.
+  inline void sum(const float* const* srcs, int count, float* dst, int n) noexcept
+  {
+    if (count == 0) return clear(dst, n);
+    if (srcs[0] != dst) copy(srcs[0], dst, n);
+    for (int b = 1; b < count; b++) add(srcs[b], dst, n);
+  }
+
+  /// Pan `src` to `left` and `right`, with the gains in `g` and the pans in `pan`
+  ///
+  /// A pan of -1 is hard left, and 1 hard right. The channels are `src * g * (1 - pan)` and
+  /// `src * g * (1 + pan)`. `src` may be `left` or `right`.
+  inline void mix_pan(const float* src, const float* g, const float* pan, float* left, float* right, int n) noexcept
+  {
+    using namespace detail;
+    int i = 0;
+    for (vec one = splat(1.f); i < vector_frames(n); i += width) {
+      vec s = mul(load(src + i), load(g + i));
+      vec p = load(pan + i);
+      store(right + i, mul(s, add(one, p)));
+      store(left + i, mul(s, sub(one, p)));
+    }
+    for (; i < n; i++) {
+      float s = src[i] * g[i];
+      right[i] = s * (1 + pan[i]);
+      left[i] = s * (1 - pan[i]);
+    }
+  }
+
+  /// Set `dst` to `a` times the gains in `ga`, plus `b` times the gains in `gb`
+  ///
+  /// Mixes two sources into a bus in one pass. `dst` may be `a` or `b`.
+  inline void multiply_sum(const float* a, const float* ga, const float* b, const float* gb, float* dst, int n) noexcept
+  {
+    using namespace detail;
+    int i = 0;
+    for (; i < vector_frames(n); i += width) {
+      store(dst + i, add(mul(load(a + i), load(ga + i)), mul(load(b + i), load(gb + i))));
+    }
+    for (; i < n; i++) dst[i] = a[i] * ga[i] + b[i] * gb[i];
+  }
+
+  /// Pan `a` and `b` like @ref mix_pan, and set `left` and `right` to their sums
+  ///
+  /// `a` may be `left` or `right`.
+  inline void mix_pan_sum(const float* a,
+                          const float* ga,
+                          const float* pa,
+                          const float* b,
+                          const float* gb,
+                          const float* pb,
+                          float* left,
+                          float* right,
+                          int n) noexcept
+  {
+    using namespace detail;
+    int i = 0;
+    for (vec one = splat(1.f); i < vector_frames(n); i += width) {
+      vec sa = mul(load(a + i), load(ga + i));
+      vec sb = mul(load(b + i), load(gb + i));
+      vec va = load(pa + i);
+      vec vb = load(pb + i);
+      store(right + i, add(mul(sa, add(one, va)), mul(sb, add(one, vb))));
+      store(left + i, add(mul(sa, sub(one, va)), mul(sb, sub(one, vb))));
+    }
+    for (; i < n; i++) {
+      float sa = a[i] * ga[i];
+      float sb = b[i] * gb[i];
+      right[i] = sa * (1 + pa[i]) + sb * (1 + pb[i]);
+      left[i] = sa * (1 - pa[i]) + sb * (1 - pb[i]);
+    }
+  }
+
+  /// The most sources @ref mix_matrix mixes
+  constexpr int max_matrix_sources = 16;
+
+  /// Mix `sources` buffers into `buses` buffers through a matrix of gains, ramped over the block
+  ///
+  /// Bus `b` is set to the sum of `srcs[s]` times a gain that goes linearly from
+  /// `from[s * buses + b]` on the first frame to `to[s * buses + b]` on the frame after the
+  /// last, so the next block can start from `to`. Sources that are `nullptr`, like silent ones,
+  /// and gains that stay at 0, are skipped, so a bus nothing is sent to is only cleared. Each bus
+  /// is written once, so the cost grows with the gains in use, not with the number of buses
+  /// times the number of sources. The buses must not be any of the sources.
+  ///
+  /// \requires `sources <= max_matrix_sources`
+  inline void mix_matrix(const float* const* srcs,
+                         int sources,
+                         const float* from,
+                         const float* to,
+                         float* const* dsts,
+                         int buses,
+                         int n) noexcept
+  {
+    using namespace detail;
+    if (n <= 0) return;
+    for (int b = 0; b < buses; b++) {
+      float* dst = dsts[b];
+      const float* active[max_matrix_sources];
+      float start[max_matrix_sources];
+      float step[max_matrix_sources];
+      int count = 0;
+      for (int s = 0; s < sources; s++) {
+        float g0 = from[s * buses + b];
+        float g1 = to[s * buses + b];
+        if (srcs[s] == nullptr || (g0 == 0 && g1 == 0)) continue;
+        active[count] = srcs[s];
+        start[count] = g0;
+        step[count] = (g1 - g0) / n;
+        count++;
+      }
+      if (count == 0) {
+        clear(dst, n);
+        continue;
+      }
+      int i = 0;
+      if constexpr (has_simd) {
+        alignas(16) static constexpr float lane_index[width] = {0, 1, 2, 3};
+        const vec lanes = load(lane_index);
+        for (; i < vector_frames(n); i += width) {
+          vec index = add(splat(float(i)), lanes);
+          vec acc = mul(load(active[0] + i), add(splat(start[0]), mul(splat(step[0]), index)));
+          for (int k = 1; k < count; k++) {
+            acc = add(acc, mul(load(active[k] + i), add(splat(start[k]), mul(splat(step[k]), index))));
+          }
+          store(dst + i, acc);
+        }
+      }
+      for (; i < n; i++) {
+        float acc = active[0][i] * (start[0] + step[0] * float(i));
+        for (int k = 1; k < count; k++) acc += active[k][i] * (start[k] + step[k] * float(i));
+        dst[i] = acc;
+      }
+    }
+  }
+
+  /// The largest absolute value of `n` samples of `data`
+  inline float peak(const float* data, int n) noexcept
+  {
+    using namespace detail;
+    float res = 0;
+    int i = 0;
+    if constexpr (has_simd) {
+      vec vmax = splat(0.f);
+      for (; i < vector_frames(n); i += width) vmax = max_abs(vmax, load(data + i));
+      float lanes[width];
+      store(lanes, vmax);
+      for (float l : lanes) res = std::max(res, l);
+    }
+    for (; i < n; i++) res = std::max(res, std::abs(data[i]));
+    return res;
+  }
+
+  /// The root mean square of `n` samples of `data`
+  inline float rms(const float* data, int n) noexcept
+  {
+    using namespace detail;
+    if (n <= 0) return 0;
+    float res = 0;
+    int i = 0;
+    if constexpr (has_simd) {
+      vec vsum = splat(0.f);
+      for (; i < vector_frames(n); i += width) {
+        vec v = load(data + i);
+        vsum = add(vsum, mul(v, v));
+      }
+      float lanes[width];
+      store(lanes, vsum);
+      for (float l : lanes) res += l;
+    }
+    for (; i < n; i++) res += data[i] * data[i];
+    return std::sqrt(res / n);
+  }
+
+  /// The buffer kernels compiled for one instruction set
+  ///
+  /// The inline kernels above use the SIMD instructions the build targets, which on x86 is
+  /// SSE2 unless the board sets a newer `-march`. This table is chosen at startup for the cpu
+  /// the program runs on instead, so a portable desktop build still uses AVX2 where
+  /// available. The element-wise kernels give the same results in every table, only `rms`
+  /// sums in a different order.
+  ///
+  /// Hot mixing code calls them through @ref kernels:
+  ///
+  /// ```cpp
+  /// util::audio::kernels().gain(buf.data(), volume.data(), nframes);
+  /// ```
+  struct KernelTable {
+    /// The instruction set, like `"sse2"`, `"avx2"` or `"neon"`
+    const char* name;
+    void (*gain)(float* data, const float* g, int n) noexcept;
+    void (*scale)(float* data, float g, int n) noexcept;
+    void (*multiply)(const float* src, const float* g, float* dst, int n) noexcept;
+    void (*add)(const float* src, float* dst, int n) noexcept;
+    void (*mix)(const float* src, float g, float* dst, int n) noexcept;
+    void (*mix_pan)(const float* src, const float* g, const float* pan, float* left, float* right, int n) noexcept;
+    void (*multiply_sum)(const float* a, const float* ga, const float* b, const float* gb, float* dst, int n) noexcept;
+    void (*mix_pan_sum)(const float* a,
+                        const float* ga,
+                        const float* pa,
+                        const float* b,
+                        const float* gb,
+                        const float* pb,
+                        float* left,
+                        float* right,
+                        int n) noexcept;
+    void (*mix_matrix)(const float* const* srcs,
+                       int sources,
+                       const float* from,
+                       const float* to,
+                       float* const* dsts,
+                       int buses,
+                       int n) noexcept;
+    float (*peak)(const float* data, int n) noexcept;
+    float (*rms)(const float* data, int n) noexcept;
+  };
+
+  /// The tables the cpu supports, from the inline kernels to the best
+  ///
+  /// Only x86 has more than one, selected with `__builtin_cpu_supports`.
+  const std::vector<const KernelTable*>& supported_kernels() noexcept;
+
+  namespace detail {
+    extern const KernelTable* current_kernels;
+  }
+
+  /// The best supported @ref KernelTable, or the one named by the `OTTO_KERNELS` environment
+  /// variable if it is supported
+  inline const KernelTable& kernels() noexcept
+  {
+    return *detail::current_kernels;
+  }
+
+  /// Interleave the channels `left` and `right` into `out`, which holds `2 * nframes` samples
+  ///
+  /// Vectorised with NEON or SSE where available.
+  inline void interleave(const float* left, const float* right, float* out, int nframes) noexcept
+  {
+    int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 4 <= nframes; i += 4) {
+      vst2q_f32(out + 2 * i, float32x4x2_t{{vld1q_f32(left + i), vld1q_f32(right + i)}});
+    }
+#elif defined(__SSE__)
+    for (; i + 4 <= nframes; i += 4) {
+      __m128 l = _mm_loadu_ps(left + i);
+      __m128 r = _mm_loadu_ps(right + i);
+      _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+      _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+#endif
+    for (; i < nframes; i++) {
+      out[2 * i] = left[i];
+      out[2 * i + 1] = right[i];
+    }
+  }
+
+  /// Split the interleaved stereo `in`, which holds `2 * nframes` samples, into `left` and
+  /// `right`
+  ///
+  /// Vectorised with NEON or SSE where available.
+  inline void deinterleave(const float* in, float* left, float* right, int nframes) noexcept
+  {
+    int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 4 <= nframes; i += 4) {
+      float32x4x2_t v = vld2q_f32(in + 2 * i);
+      vst1q_f32(left + i, v.val[0]);
+      vst1q_f32(right + i, v.val[1]);
+    }
+#elif defined(__SSE__)
+    for (; i + 4 <= nframes; i += 4) {
+      __m128 a = _mm_loadu_ps(in + 2 * i);
+      __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+      _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+    for (; i < nframes; i++) {
+      left[i] = in[2 * i];
+      right[i] = in[2 * i + 1];
+    }
+  }
+
+  /// Whether `x` is a denormal, i.e. too small to be stored with full precision
+  ///
+  /// Checks the bits, so it also works while denormals are flushed to zero.
+  inline bool is_denormal(float x) noexcept
+  {
+    std::uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return (bits & 0x7F800000) == 0 && (bits & 0x007FFFFF) != 0;
+  }
+
+  /// The number of denormals in `data`
+  inline int count_denormals(const float* data, int n) noexcept
+  {
+    int res = 0;
+    for (int i = 0; i < n; i++) res += is_denormal(data[i]);
+    return res;
+  }
+
+  /// Whether `data` has no NaN or infinity
+  ///
+  /// Compares the bits, so it holds with `-ffast-math` as well, and vectorizes.
+  inline bool all_finite(const float* data, int n) noexcept
+  {
+    std::uint32_t bad = 0;
+    for (int i = 0; i < n; i++) {
+      std::uint32_t bits;
+      std::memcpy(&bits, &data[i], sizeof(bits));
+      bad |= (bits & 0x7F800000) == 0x7F800000;
+    }
+    return bad == 0;
+  }
+
+  /// Flushes denormals to zero on the calling thread, for the lifetime of the object
+  ///
+  /// Filters, reverb tails and envelopes decay into denormals, which take many times longer
+  /// to compute with, so an idle patch can cost more than a playing one. Sets the flush to
+  /// zero and denormals are zero flags of SSE on x86, and the flush to zero flag of the
+  /// floating point unit on ARM. NEON always flushes on 32 bit ARM. The previous flags are
+  /// restored on destruction.
+  ///
+  /// Construct one at the start of every audio callback, and every thread processing audio.
+  /// With `OTTO_DEBUG_DENORMALS` it does nothing, so the routing graph can count the
+  /// denormals each engine produces.
+  struct FlushDenormals {
+    FlushDenormals() noexcept
+    {
+#if !OTTO_DEBUG_DENORMALS
+      _saved = get_flags();
+      set_flags(_saved | flush_flags);
+#endif
+    }
+
+    ~FlushDenormals() noexcept
+    {
+#if !OTTO_DEBUG_DENORMALS
+      set_flags(_saved);
+#endif
+    }
+
+    FlushDenormals(const FlushDenormals&) = delete;
+    FlushDenormals& operator=(const FlushDenormals&) = delete;
+
+  private:
+#if defined(__SSE__)
+    // FTZ and DAZ in MXCSR
+    static constexpr std::uintptr_t flush_flags = 0x8040;
+    static std::uintptr_t get_flags() noexcept
+    {
+      return _mm_getcsr();
+    }
+    static void set_flags(std::uintptr_t flags) noexcept
+    {
+      _mm_setcsr(flags);
+    }
+#elif defined(__aarch64__)
+    // FZ in FPCR
+    static constexpr std::uintptr_t flush_flags = 1 << 24;
+    static std::uintptr_t get_flags() noexcept
+    {
+      std::uintptr_t flags;
+      asm volatile("mrs %0, fpcr" : "=r"(flags));
+      return flags;
+    }
+    static void set_flags(std::uintptr_t flags) noexcept
+    {
+      asm volatile("msr fpcr, %0" : : "r"(flags));
+    }
+#elif defined(__arm__) && defined(__ARM_FP)
+    // FZ in FPSCR
+    static constexpr std::uintptr_t flush_flags = 1 << 24;
+    static std::uintptr_t get_flags() noexcept
+    {
+      std::uintptr_t flags;
+      asm volatile("vmrs %0, fpscr" : "=r"(flags));
+      return flags;
+    }
+    static void set_flags(std::uintptr_t flags) noexcept
+    {
+      asm volatile("vmsr fpscr, %0" : : "r"(flags));
+    }
+#else
+    static constexpr std::uintptr_t flush_flags = 0;
+    static std::uintptr_t get_flags() noexcept
+    {
+      return 0;
+    }
+    static void set_flags(std::uintptr_t) noexcept {}
+#endif
+    [[maybe_unused]] std::uintptr_t _saved = 0;
+  };
+
   /*
    * A simple average, used to get a 1-dimensional graph of audio
    */
@@ -71,8 +664,10 @@ namespace otto::util::audio {
   };
 
   /// Envelope follower
+  ///
+  /// Jumps up to peaks, and falls back by `k` of the distance each call.
   struct EnvelopeFollower {
-    const float k = 0.001;
+    float k = 0.001;
     float value = 0;
 
     float operator()(float x)
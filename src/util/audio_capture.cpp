@@ -0,0 +1,163 @@
+#include "audio_capture.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <ctime>
+
+#include <AudioFile.h>
+#include <fmt/format.h>
+
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::util {
+
+  namespace {
+    /// How often the background thread drains the ring. Well within the time it takes to fill.
+    constexpr auto drain_interval = std::chrono::milliseconds(20);
+
+    /// The silence written for missing channels
+    constexpr std::array<float, 256> zeros = {};
+
+    /// The local time, for the names of files
+    std::string timestamp()
+    {
+      char time[32];
+      std::time_t now = std::time(nullptr);
+      std::strftime(time, sizeof(time), "%Y%m%d-%H%M%S", std::localtime(&now));
+      return time;
+    }
+  } // namespace
+
+  AudioCapture::AudioCapture(std::string name, fs::path dir, int channels, int samplerate, float seconds, Mode mode)
+    : _name(std::move(name)), _dir(std::move(dir)), _channels(channels), _samplerate(samplerate), _mode(mode)
+  {
+    if (mode == Mode::record) {
+      _recording = std::make_unique<WavWriter>(_dir / fmt::format("{}-{}.wav", _name, timestamp()), channels,
+                                               samplerate, seconds);
+    } else {
+      _history.resize(channels, std::vector<float>(std::max(1, int(seconds * samplerate))));
+    }
+    _thread = util::start_thread(util::ThreadClass::io, [this] { run(); });
+  }
+
+  AudioCapture::~AudioCapture()
+  {
+    _quit = true;
+    _thread.join();
+  }
+
+  void AudioCapture::write(gsl::span<const float* const> channels, int nframes) noexcept
+  {
+    if (_ring->write_available() < 1 + std::size_t(_channels) * nframes) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    float header = nframes;
+    _ring->write(&header, 1);
+    for (int ch = 0; ch < _channels; ch++) {
+      const float* data = ch < int(channels.size()) ? channels[ch] : nullptr;
+      if (data != nullptr) {
+        _ring->write(data, nframes);
+        continue;
+      }
+      for (int left = nframes; left > 0; left -= zeros.size()) {
+        _ring->write(zeros.data(), std::min<std::size_t>(left, zeros.size()));
+      }
+    }
+  }
+
+  void AudioCapture::request_dump() noexcept
+  {
+    _dump_requested = true;
+  }
+
+  fs::path AudioCapture::dump()
+  {
+    std::unique_lock lock(_mutex);
+    int dumps = _dumps;
+    _dump_requested = true;
+    _cv.wait(lock, [&] { return _dumps != dumps; });
+    return _last_dump;
+  }
+
+  void AudioCapture::run()
+  {
+    while (!_quit) {
+      std::this_thread::sleep_for(drain_interval);
+      drain();
+      if (_dump_requested.exchange(false)) {
+        // Include what was written before the request
+        drain();
+        fs::path path;
+        if (_mode == Mode::rolling) {
+          path = _dir / fmt::format("{}-{}.wav", _name, timestamp());
+          if (!write_history(path)) path.clear();
+        }
+        std::unique_lock lock(_mutex);
+        _last_dump = path;
+        _dumps++;
+        _cv.notify_all();
+      }
+    }
+    drain();
+    if (_mode == Mode::stream && _history_frames > 0) {
+      write_history(_dir / fmt::format("{}-{}.wav", _name, _chunk++));
+    }
+  }
+
+  void AudioCapture::drain()
+  {
+    const std::size_t size = _history.empty() ? 0 : _history[0].size();
+    std::vector<float> block;
+    std::vector<const float*> channels(_channels);
+    float header;
+    // The producer writes whole buffers, and checks for space first, so once the frame count
+    // of a buffer is in the ring, its channels are about to be too
+    while (_ring->pop(header)) {
+      const std::size_t nframes = header;
+      block.resize(_channels * nframes);
+      for (std::size_t read = 0; read < block.size();) {
+        read += _ring->read(block.data() + read, block.size() - read);
+      }
+      if (_recording) {
+        for (int ch = 0; ch < _channels; ch++) channels[ch] = block.data() + ch * nframes;
+        _recording->write(channels, nframes);
+        continue;
+      }
+      for (std::size_t i = 0; i < nframes; i++) {
+        for (int ch = 0; ch < _channels; ch++) _history[ch][_history_pos] = block[ch * nframes + i];
+        _history_pos = (_history_pos + 1) % size;
+        _history_frames = std::min(_history_frames + 1, size);
+        if (_mode == Mode::stream && _history_pos == 0) {
+          write_history(_dir / fmt::format("{}-{}.wav", _name, _chunk++));
+          _history_frames = 0;
+        }
+      }
+    }
+  }
+
+  bool AudioCapture::write_history(const fs::path& path)
+  {
+    const std::size_t size = _history[0].size();
+    AudioFile<float> file;
+    file.setAudioBufferSize(_channels, _history_frames);
+    file.setSampleRate(_samplerate);
+    file.setBitDepth(24);
+    // Oldest first
+    std::size_t start = (_history_pos + size - _history_frames) % size;
+    for (int ch = 0; ch < _channels; ch++) {
+      for (std::size_t i = 0; i < _history_frames; i++) file.samples[ch][i] = _history[ch][(start + i) % size];
+    }
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (!file.save(path.string())) {
+      LOGE("Capture: could not write {}", path.c_str());
+      return false;
+    }
+    LOGI("Capture: wrote {} seconds to {}", float(_history_frames) / _samplerate, path.c_str());
+    return true;
+  }
+
+} // namespace otto::util
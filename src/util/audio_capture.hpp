@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gsl/span>
+
+#include "util/filesystem.hpp"
+#include "util/spsc_ring.hpp"
+#include "util/wav_writer.hpp"
+
+namespace otto::util {
+
+  /// Records the audio of one point of the engine chain, for debugging glitches
+  ///
+  /// The audio thread hands over each buffer with @ref write, which copies it into a lock-free
+  /// ring and returns. A background thread drains the ring every few milliseconds into the
+  /// history, which holds the last `seconds` of audio. In the `rolling` mode, the history is
+  /// written to a wav file in `dir` on request. In the `stream` mode, it is written each time
+  /// it fills up, as consecutive chunks `<name>-<n>.wav`. In the `record` mode, everything is
+  /// written to one file in `dir` by a @ref WavWriter, which buffers `seconds` of audio for
+  /// stalls of the disk, so whole sets can be recorded, from as many points as needed.
+  ///
+  /// If the background thread falls behind by more than @ref ring_size samples, whole buffers
+  /// are dropped, and counted in @ref dropped.
+  struct AudioCapture {
+    enum struct Mode {
+      /// Keep the last seconds, and write them on @ref request_dump
+      rolling,
+      /// Write everything, in chunks of the length of the history
+      stream,
+      /// Write everything to one file, for recordings of hours
+      record,
+    };
+
+    /// The samples that may wait for the background thread, about 0.3 seconds of stereo audio
+    static constexpr std::size_t ring_size = 1 << 15;
+
+    /// \param name The start of the file names
+    /// \param channels The number of channels handed to @ref write
+    AudioCapture(std::string name, fs::path dir, int channels, int samplerate, float seconds, Mode mode = Mode::rolling);
+
+    /// Writes the rest of the stream in the `stream` and `record` modes, and stops the thread
+    ~AudioCapture();
+
+    AudioCapture(const AudioCapture&) = delete;
+    AudioCapture& operator=(const AudioCapture&) = delete;
+
+    /// Hand over one buffer, with one pointer per channel. A null pointer is a silent channel.
+    ///
+    /// Only to be called from one thread at a time, usually the audio thread. Copies the
+    /// channels into the ring, and never blocks.
+    void write(gsl::span<const float* const> channels, int nframes) noexcept;
+
+    /// Write the history to a new file in `dir`, in the background
+    ///
+    /// May be called from any thread, and never blocks. Only in the `rolling` mode.
+    void request_dump() noexcept;
+
+    /// Write the history to a new file in `dir`, and wait for it
+    ///
+    /// \returns the path of the file, or an empty path if it could not be written
+    fs::path dump();
+
+    /// The number of buffers dropped because the ring was full
+    int dropped() const noexcept
+    {
+      return _dropped.load(std::memory_order_relaxed);
+    }
+
+    const std::string& name() const noexcept
+    {
+      return _name;
+    }
+
+  private:
+    void run();
+    /// Move the buffers in the ring into the history. On the background thread.
+    void drain();
+    /// Write the history, oldest first, to `path`. On the background thread.
+    bool write_history(const fs::path& path);
+
+    std::string _name;
+    fs::path _dir;
+    int _channels;
+    int _samplerate;
+    Mode _mode;
+
+    /// Each buffer is its frame count, followed by the channels one after the other
+    std::unique_ptr<SPSCRing<float, ring_size>> _ring = std::make_unique<SPSCRing<float, ring_size>>();
+    std::atomic_int _dropped = 0;
+
+    /// One circular buffer per channel. Only used by the background thread.
+    std::vector<std::vector<float>> _history;
+    std::size_t _history_pos = 0;
+    std::size_t _history_frames = 0;
+    int _chunk = 0;
+    /// Only in the `record` mode. Written to by the background thread.
+    std::unique_ptr<WavWriter> _recording;
+
+    std::atomic_bool _dump_requested = false;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    /// Guarded by `_mutex`. Increased after each dump.
+    int _dumps = 0;
+    /// Guarded by `_mutex`
+    fs::path _last_dump;
+    std::atomic_bool _quit = false;
+    std::thread _thread;
+  };
+
+} // namespace otto::util
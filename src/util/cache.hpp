@@ -1,6 +1,8 @@
 #pragma once
 
 #include <functional>
+#include <list>
+#include <unordered_map>
 #include "util/type_traits.hpp"
 
 namespace otto::util {
@@ -112,4 +114,71 @@ namespace otto::util {
 
   };
 
+  /// A bounded map, which evicts the least recently used entry when it is full
+  ///
+  /// Not thread safe.
+  ///
+  /// \requires `Key` shall be hashable
+  template<typename Key, typename Value>
+  struct lru_cache {
+    lru_cache(std::size_t capacity) : _capacity(capacity) {}
+
+    /// Look up `key`, and mark it as the most recently used
+    ///
+    /// \returns `nullptr` if `key` is not cached
+    Value* find(const Key& key)
+    {
+      auto found = _index.find(key);
+      if (found == _index.end()) return nullptr;
+      _entries.splice(_entries.begin(), _entries, found->second);
+      return &found->second->second;
+    }
+
+    /// Insert or replace the value of `key`, evicting the least recently used entry if full
+    Value& insert(const Key& key, Value value)
+    {
+      if (auto* found = find(key)) return *found = std::move(value);
+      if (_entries.size() >= _capacity && !_entries.empty()) {
+        _index.erase(_entries.back().first);
+        _entries.pop_back();
+      }
+      _entries.emplace_front(key, std::move(value));
+      _index.emplace(key, _entries.begin());
+      return _entries.front().second;
+    }
+
+    /// Remove `key`, if it is cached
+    void erase(const Key& key)
+    {
+      auto found = _index.find(key);
+      if (found == _index.end()) return;
+      _entries.erase(found->second);
+      _index.erase(found);
+    }
+
+    void clear()
+    {
+      _index.clear();
+      _entries.clear();
+    }
+
+    std::size_t size() const noexcept
+    {
+      return _entries.size();
+    }
+
+    std::size_t capacity() const noexcept
+    {
+      return _capacity;
+    }
+
+  private:
+    using entry_list = std::list<std::pair<Key, Value>>;
+
+    std::size_t _capacity;
+    /// Most recently used first
+    entry_list _entries;
+    std::unordered_map<Key, typename entry_list::iterator> _index;
+  };
+
 }
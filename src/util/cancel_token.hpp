@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace otto::util {
+
+  /// Tells an asynchronous operation whether its result is still wanted
+  ///
+  /// Checked by the operation between its steps. A default constructed token is never
+  /// cancelled. Copies share the same state, and may be checked from any thread.
+  struct CancelToken {
+    CancelToken() = default;
+
+    bool cancelled() const noexcept
+    {
+      return _cancelled && _cancelled->load(std::memory_order_acquire);
+    }
+
+  private:
+    friend struct CancelSource;
+    std::shared_ptr<std::atomic_bool> _cancelled;
+  };
+
+  /// Hands out the tokens of a series of operations, of which only the last should complete
+  ///
+  /// Like scrolling through presets, where each new selection replaces the last one, whichever
+  /// step it has reached.
+  struct CancelSource {
+    CancelSource() = default;
+    CancelSource(const CancelSource&) = delete;
+    CancelSource& operator=(const CancelSource&) = delete;
+
+    /// Cancels the last operation
+    ~CancelSource() noexcept
+    {
+      cancel();
+    }
+
+    /// Cancel the last operation, and return the token of the next one
+    CancelToken restart()
+    {
+      cancel();
+      _current._cancelled = std::make_shared<std::atomic_bool>(false);
+      return _current;
+    }
+
+    /// Cancel the last operation
+    void cancel() noexcept
+    {
+      if (_current._cancelled) _current._cancelled->store(true, std::memory_order_release);
+    }
+
+  private:
+    CancelToken _current;
+  };
+
+} // namespace otto::util
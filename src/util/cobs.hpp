@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <gsl/span>
+
+namespace otto::util::cobs {
+
+  /// Consistent Overhead Byte Stuffing
+  ///
+  /// Encodes a frame of any bytes without zeroes, so a zero can delimit frames in a byte
+  /// stream. The overhead is one byte, plus one for every 254 bytes of the frame, and the
+  /// receiver can find the start of the next frame after a corrupt or partial one.
+
+  /// Append `frame` to `out`, encoded and followed by the zero delimiter
+  inline void encode(gsl::span<const std::uint8_t> frame, std::vector<std::uint8_t>& out)
+  {
+    out.reserve(out.size() + frame.size() + frame.size() / 254 + 2);
+    std::size_t code_idx = out.size();
+    out.push_back(0);
+    std::uint8_t code = 1;
+    for (std::uint8_t byte : frame) {
+      if (byte != 0) {
+        out.push_back(byte);
+        code++;
+      }
+      if (byte == 0 || code == 0xFF) {
+        out[code_idx] = code;
+        code_idx = out.size();
+        out.push_back(0);
+        code = 1;
+      }
+    }
+    out[code_idx] = code;
+    out.push_back(0);
+  }
+
+  /// Decodes frames from a stream of bytes, that may arrive in any chunks
+  struct Decoder {
+    /// The longest frame that is decoded. Longer ones are dropped.
+    static constexpr std::size_t max_frame_size = 256;
+
+    /// Decode `bytes`, and call `on_frame` with each complete frame
+    ///
+    /// The frame passed to `on_frame` is only valid during the call.
+    template<typename OnFrame>
+    void feed(gsl::span<const std::uint8_t> bytes, OnFrame&& on_frame)
+    {
+      for (std::uint8_t byte : bytes) {
+        if (byte == 0) {
+          // Frames that end in the middle of a block are corrupt
+          if (_remaining == 0 && !_overflow && !_frame.empty()) on_frame(gsl::span<const std::uint8_t>(_frame));
+          reset();
+          continue;
+        }
+        if (_overflow) continue;
+        if (_remaining == 0) {
+          // The start of a block. Every block but the last, and those of 254 bytes, ended in a zero.
+          if (_pending_zero) push(0);
+          _remaining = byte - 1;
+          _pending_zero = byte != 0xFF;
+        } else {
+          push(byte);
+          _remaining--;
+        }
+      }
+    }
+
+  private:
+    void push(std::uint8_t byte)
+    {
+      if (_frame.size() >= max_frame_size) {
+        _overflow = true;
+        return;
+      }
+      _frame.push_back(byte);
+    }
+
+    void reset() noexcept
+    {
+      _frame.clear();
+      _remaining = 0;
+      _pending_zero = false;
+      _overflow = false;
+    }
+
+    std::vector<std::uint8_t> _frame;
+    /// Bytes left in the current block
+    int _remaining = 0;
+    /// Whether the current block is followed by a zero, if another block follows
+    bool _pending_zero = false;
+    bool _overflow = false;
+  };
+
+} // namespace otto::util::cobs
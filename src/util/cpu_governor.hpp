@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+
+namespace otto::util {
+
+  /// Picks a quality level from the load of the audio callbacks
+  ///
+  /// Level 0 is full quality, and each higher level is cheaper. The governor steps down a level
+  /// as soon as a callback misses its deadline, or when the worst load of a window of
+  /// callbacks is above @ref Settings::degrade_load. It steps back up only after
+  /// @ref Settings::recover_windows windows in a row stayed below
+  /// @ref Settings::recover_load, so it does not oscillate between two levels.
+  ///
+  /// @ref add is called from the audio thread. @ref level may be read from any thread.
+  struct CpuGovernor {
+    struct Settings {
+      /// Step down when the worst load of a window is above this
+      float degrade_load = 0.8f;
+      /// A window counts towards stepping up when its worst load is below this
+      float recover_load = 0.5f;
+      /// The number of callbacks in a window
+      int window = 64;
+      /// The number of quiet windows in a row before stepping up a level
+      int recover_windows = 16;
+      /// The cheapest level
+      int max_level = 3;
+    };
+
+    CpuGovernor() noexcept = default;
+    CpuGovernor(Settings settings) noexcept : settings(settings) {}
+
+    /// Add the load of one callback, as a fraction of its deadline
+    ///
+    /// \returns whether the level changed
+    bool add(float load) noexcept
+    {
+      _window_peak = std::max(_window_peak, load);
+      if (load > 1.f) return end_window(true);
+      if (++_window_count < settings.window) return false;
+      return end_window(_window_peak > settings.degrade_load);
+    }
+
+    /// The current level, from 0 to @ref Settings::max_level
+    int level() const noexcept
+    {
+      return _level.load(std::memory_order_relaxed);
+    }
+
+    /// Not to be changed while @ref add may be called
+    Settings settings;
+
+  private:
+    bool end_window(bool overloaded) noexcept
+    {
+      const int old = level();
+      int next = old;
+      if (overloaded) {
+        _quiet_windows = 0;
+        next = std::min(old + 1, settings.max_level);
+      } else if (_window_peak < settings.recover_load) {
+        if (++_quiet_windows >= settings.recover_windows) {
+          _quiet_windows = 0;
+          next = std::max(old - 1, 0);
+        }
+      } else {
+        _quiet_windows = 0;
+      }
+      _window_count = 0;
+      _window_peak = 0;
+      _level.store(next, std::memory_order_relaxed);
+      return next != old;
+    }
+
+    std::atomic_int _level = 0;
+    int _window_count = 0;
+    float _window_peak = 0;
+    int _quiet_windows = 0;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace otto::util {
+
+  /// Lock-free accumulator of the time spent in a piece of code, like the process call of an
+  /// engine
+  ///
+  /// One thread adds measurements, while another thread periodically takes the statistics of
+  /// the window since its last call. Adding never locks or allocates, so it is safe on the
+  /// audio thread.
+  ///
+  /// ```cpp
+  /// {
+  ///   auto timer = meter.measure();
+  ///   engine.process(data);
+  /// }
+  /// // On the UI thread
+  /// auto stats = meter.take();
+  /// ```
+  struct CpuMeter {
+    using clock = std::chrono::steady_clock;
+
+    /// The statistics of one window, in nanoseconds per measurement
+    struct Stats {
+      int count = 0;
+      double min = 0;
+      double avg = 0;
+      double max = 0;
+      /// The longest measurement since the meter was created
+      double worst = 0;
+    };
+
+    /// Measures the lifetime of the object
+    struct Scope {
+      Scope(CpuMeter& meter) noexcept : _meter(meter), _start(clock::now()) {}
+      Scope(const Scope&) = delete;
+      ~Scope() noexcept
+      {
+        _meter.add(clock::now() - _start);
+      }
+
+    private:
+      CpuMeter& _meter;
+      clock::time_point _start;
+    };
+
+    /// Start a measurement, which ends when the returned object is destroyed
+    [[nodiscard]] Scope measure() noexcept
+    {
+      return {*this};
+    }
+
+    /// Add a measurement
+    void add(std::chrono::nanoseconds duration) noexcept
+    {
+      std::int64_t ns = duration.count();
+      _count.fetch_add(1, std::memory_order_relaxed);
+      _sum.fetch_add(ns, std::memory_order_relaxed);
+      store_min(_min, ns);
+      store_max(_max, ns);
+      store_max(_worst, ns);
+    }
+
+    /// Get the statistics since the last call, and start a new window
+    Stats take() noexcept
+    {
+      Stats res;
+      res.count = _count.exchange(0, std::memory_order_relaxed);
+      auto sum = _sum.exchange(0, std::memory_order_relaxed);
+      auto min = _min.exchange(empty_min, std::memory_order_relaxed);
+      auto max = _max.exchange(0, std::memory_order_relaxed);
+      res.worst = _worst.load(std::memory_order_relaxed);
+      if (res.count == 0) return res;
+      res.min = min == empty_min ? 0 : min;
+      res.avg = double(sum) / res.count;
+      res.max = max;
+      return res;
+    }
+
+  private:
+    static constexpr std::int64_t empty_min = std::numeric_limits<std::int64_t>::max();
+
+    static void store_min(std::atomic<std::int64_t>& a, std::int64_t val) noexcept
+    {
+      auto cur = a.load(std::memory_order_relaxed);
+      while (val < cur && !a.compare_exchange_weak(cur, val, std::memory_order_relaxed))
+        ;
+    }
+
+    static void store_max(std::atomic<std::int64_t>& a, std::int64_t val) noexcept
+    {
+      auto cur = a.load(std::memory_order_relaxed);
+      while (val > cur && !a.compare_exchange_weak(cur, val, std::memory_order_relaxed))
+        ;
+    }
+
+    std::atomic_int _count = 0;
+    std::atomic<std::int64_t> _sum = 0;
+    std::atomic<std::int64_t> _min = empty_min;
+    std::atomic<std::int64_t> _max = 0;
+    std::atomic<std::int64_t> _worst = 0;
+  };
+
+  /// The statistics of a named @ref CpuMeter, like a node in the audio graph
+  struct CpuUsage {
+    std::string name;
+    CpuMeter::Stats stats;
+    /// Denormals in the output since the last call. Only counted with `OTTO_DEBUG_DENORMALS`.
+    int denormals = 0;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,129 @@
+#include "directory_watcher.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace otto::util {
+
+  namespace fs = filesystem;
+
+#ifdef __linux__
+
+  DirectoryWatcher::DirectoryWatcher(fs::path dir, Handler handler)
+    : _dir(std::move(dir)), _handler(std::move(handler))
+  {
+    if (!fs::is_directory(_dir)) {
+      LOGW("Not watching {}, which is not a directory", _dir.string());
+      return;
+    }
+    _inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    _stop_fd = ::eventfd(0, EFD_CLOEXEC);
+    if (_inotify < 0 || _stop_fd < 0) {
+      LOGE("Could not watch {}: {}", _dir.string(), std::strerror(errno));
+      if (_inotify >= 0) ::close(_inotify);
+      if (_stop_fd >= 0) ::close(_stop_fd);
+      _inotify = _stop_fd = -1;
+      return;
+    }
+    add_watches(_dir);
+    _thread = start_thread(ThreadClass::background, [this] { run(); });
+  }
+
+  DirectoryWatcher::~DirectoryWatcher() noexcept
+  {
+    if (!watching()) return;
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto res = ::write(_stop_fd, &one, sizeof(one));
+    if (_thread.joinable()) _thread.join();
+    ::close(_inotify);
+    ::close(_stop_fd);
+  }
+
+  void DirectoryWatcher::add_watches(const fs::path& dir)
+  {
+    constexpr std::uint32_t mask =
+      IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+    int wd = ::inotify_add_watch(_inotify, dir.c_str(), mask);
+    if (wd < 0) {
+      LOGW("Could not watch {}: {}", dir.string(), std::strerror(errno));
+      return;
+    }
+    _watches[wd] = dir;
+    for (auto&& de : fs::directory_iterator(dir)) {
+      if (de.is_directory()) add_watches(de.path());
+    }
+  }
+
+  void DirectoryWatcher::run()
+  {
+    loguru::set_thread_name("dir_watcher");
+    // Large enough for several events with names of the longest length
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    std::array<pollfd, 2> fds = {{{_inotify, POLLIN, 0}, {_stop_fd, POLLIN, 0}}};
+    while (true) {
+      if (::poll(fds.data(), fds.size(), -1) < 0) {
+        if (errno == EINTR) continue;
+        LOGE("Stopped watching {}: {}", _dir.string(), std::strerror(errno));
+        return;
+      }
+      if (fds[1].revents != 0) return;
+      ssize_t len;
+      while ((len = ::read(_inotify, buffer, sizeof(buffer))) > 0) {
+        for (char* ptr = buffer; ptr < buffer + len;) {
+          auto& event = *reinterpret_cast<inotify_event*>(ptr);
+          ptr += sizeof(inotify_event) + event.len;
+          if (event.mask & IN_IGNORED) {
+            _watches.erase(event.wd);
+            continue;
+          }
+          auto dir = _watches.find(event.wd);
+          if (dir == _watches.end() || event.len == 0) continue;
+          auto path = dir->second / event.name;
+          if (event.mask & IN_ISDIR) {
+            if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+              try {
+                add_watches(path);
+                // Files may have been added before the watch was
+                for (auto&& de : fs::recursive_directory_iterator(path)) {
+                  if (!de.is_directory()) _handler(de.path(), Change::modified);
+                }
+              } catch (fs::filesystem_error& e) {
+                // Removed again already
+                LOGW("Could not watch {}: {}", path.string(), e.what());
+              }
+            }
+            continue;
+          }
+          if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) _handler(path, Change::modified);
+          if (event.mask & (IN_DELETE | IN_MOVED_FROM)) _handler(path, Change::removed);
+        }
+      }
+    }
+  }
+
+#else
+
+  DirectoryWatcher::DirectoryWatcher(fs::path dir, Handler handler)
+    : _dir(std::move(dir)), _handler(std::move(handler))
+  {}
+
+  DirectoryWatcher::~DirectoryWatcher() noexcept {}
+
+  void DirectoryWatcher::add_watches(const fs::path&) {}
+
+  void DirectoryWatcher::run() {}
+
+#endif
+
+} // namespace otto::util
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "util/filesystem.hpp"
+
+namespace otto::util {
+
+  /// Reports changes of the files in a directory tree, on a thread of its own
+  ///
+  /// Uses inotify on Linux, with a watch on each directory, including those created later. A
+  /// file is reported as changed once it is closed after writing, or moved into the tree, so a
+  /// file being copied is reported once it is complete. Elsewhere, nothing is reported.
+  struct DirectoryWatcher {
+    enum struct Change {
+      /// Created, written, or moved into the tree
+      modified,
+      /// Deleted, or moved out of the tree
+      removed,
+    };
+
+    /// Called on the watcher thread for each changed file, never for directories
+    ///
+    /// Files in a removed directory are reported one by one, as far as inotify reports them.
+    using Handler = std::function<void(const filesystem::path& file, Change change)>;
+
+    /// Start watching `dir` and its subdirectories. Does nothing if `dir` does not exist.
+    DirectoryWatcher(filesystem::path dir, Handler handler);
+    /// Stop the watcher thread
+    ~DirectoryWatcher() noexcept;
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    /// Whether changes are being watched
+    bool watching() const noexcept
+    {
+      return _inotify >= 0;
+    }
+
+  private:
+    /// Watch `dir` and, recursively, the directories in it
+    void add_watches(const filesystem::path& dir);
+    void run();
+
+    filesystem::path _dir;
+    Handler _handler;
+    int _inotify = -1;
+    /// Written to wake the thread up to stop
+    int _stop_fd = -1;
+    /// The directory of each watch descriptor. Only used on the watcher thread after the start.
+    std::unordered_map<int, filesystem::path> _watches;
+    std::thread _thread;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,49 @@
+#include "biquad_bank.hpp"
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  namespace {
+    /// The shared part of the designs
+    struct Design {
+      Design(float freq, float res) noexcept
+      {
+        double w = 2 * M_PI * freq / gam::sampleRate();
+        cos = std::cos(w);
+        alpha = std::sin(w) / (2 * res);
+        a0 = 1 / (1 + alpha);
+      }
+
+      BiquadCoefficients with(double b0, double b1, double b2) const noexcept
+      {
+        return {float(b0 * a0), float(b1 * a0), float(b2 * a0), float(-2 * cos * a0),
+                float((1 - alpha) * a0)};
+      }
+
+      double cos;
+      double alpha;
+      /// The reciprocal of `a0`
+      double a0;
+    };
+  } // namespace
+
+  BiquadCoefficients BiquadCoefficients::low_pass(float freq, float res) noexcept
+  {
+    Design d = {freq, res};
+    return d.with((1 - d.cos) / 2, 1 - d.cos, (1 - d.cos) / 2);
+  }
+
+  BiquadCoefficients BiquadCoefficients::high_pass(float freq, float res) noexcept
+  {
+    Design d = {freq, res};
+    return d.with((1 + d.cos) / 2, -(1 + d.cos), (1 + d.cos) / 2);
+  }
+
+  BiquadCoefficients BiquadCoefficients::resonant(float freq, float res) noexcept
+  {
+    Design d = {freq, res};
+    return d.with(d.alpha, 0, -d.alpha);
+  }
+
+} // namespace otto::dsp
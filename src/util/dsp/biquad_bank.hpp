@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+namespace otto::dsp {
+
+  /// The coefficients of a biquad, normalized so `a0 = 1`
+  ///
+  /// The designs are those of `gam::Biquad`, at the samplerate of gamma.
+  struct BiquadCoefficients {
+    float b0 = 1;
+    float b1 = 0;
+    float b2 = 0;
+    float a1 = 0;
+    float a2 = 0;
+
+    static BiquadCoefficients low_pass(float freq, float res = M_SQRT1_2) noexcept;
+    static BiquadCoefficients high_pass(float freq, float res = M_SQRT1_2) noexcept;
+    /// A band pass with a peak gain of one, like `gam::RESONANT`
+    static BiquadCoefficients resonant(float freq, float res) noexcept;
+  };
+
+  /// `N` independent biquads, processed together
+  ///
+  /// Each channel has its own coefficients and state, stored as one array per value, so one
+  /// frame of all channels is filtered in a single vectorized pass. Use it for the filters of
+  /// all voices of an engine, or for parallel filters of the same signal.
+  ///
+  /// The filters are in transposed direct form II.
+  template<int N>
+  struct BiquadBank {
+    static constexpr int channels = N;
+    using Frame = std::array<float, N>;
+
+    BiquadBank() noexcept
+    {
+      for (int c = 0; c < N; c++) coefficients(c, {});
+      zero();
+    }
+
+    /// Set the coefficients of `channel`. Keeps its state.
+    void coefficients(int channel, const BiquadCoefficients& coefs) noexcept
+    {
+      _b0[channel] = coefs.b0;
+      _b1[channel] = coefs.b1;
+      _b2[channel] = coefs.b2;
+      _a1[channel] = coefs.a1;
+      _a2[channel] = coefs.a2;
+    }
+
+    /// Clear the state of all channels
+    void zero() noexcept
+    {
+      _z1.fill(0);
+      _z2.fill(0);
+    }
+
+    /// Clear the state of `channel`
+    void zero(int channel) noexcept
+    {
+      _z1[channel] = 0;
+      _z2[channel] = 0;
+    }
+
+    /// Filter one frame of all channels in place
+    void operator()(Frame& frame) noexcept
+    {
+      for (int c = 0; c < N; c++) {
+        float in = frame[c];
+        float out = _b0[c] * in + _z1[c];
+        _z1[c] = _b1[c] * in - _a1[c] * out + _z2[c];
+        _z2[c] = _b2[c] * in - _a2[c] * out;
+        frame[c] = out;
+      }
+    }
+
+  private:
+    Frame _b0, _b1, _b2, _a1, _a2;
+    Frame _z1, _z2;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <gsl/span>
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  /// The number of audio frames of one control period
+  constexpr int control_period = 16;
+
+  /// A Gamma domain at the audio samplerate divided by `Period`
+  ///
+  /// Gamma objects placed in it, with `obj.domain(control_domain())`, are meant to be ticked
+  /// once every `Period` frames, and keep their rates in Hz and times in seconds. The domain
+  /// follows the samplerate of the master domain.
+  template<int Period = control_period>
+  struct ControlDomain : gam::Domain, gam::DomainObserver {
+    ControlDomain()
+    {
+      onDomainChange(1);
+    }
+
+    void onDomainChange(double) override
+    {
+      gam::Domain::spu(gam::DomainObserver::spu() / Period);
+    }
+  };
+
+  /// The control domain shared by all modulators with the same period
+  template<int Period = control_period>
+  ControlDomain<Period>& control_domain()
+  {
+    static ControlDomain<Period> domain;
+    return domain;
+  }
+
+  /// Evaluates a slow modulator every `Period` frames, and interpolates linearly between its
+  /// values
+  ///
+  /// For LFOs and envelopes read by audio rate code. Place the Gamma objects of the modulator
+  /// in @ref control_domain, so they run at the right rate.
+  ///
+  /// ```cpp
+  /// gam::LFO<> lfo;
+  /// dsp::ControlRate<> lfo_kr;
+  /// lfo.domain(dsp::control_domain());
+  /// // Every frame
+  /// float value = lfo_kr([&] { return lfo.tri(); });
+  /// ```
+  ///
+  /// The output ramps towards the latest value of the modulator, so it lags by one period.
+  template<int Period = control_period>
+  struct ControlRate {
+    /// The next value, calling `tick` to evaluate the modulator at the start of each period
+    template<typename F>
+    float operator()(F&& tick) noexcept
+    {
+      if (_left == 0) {
+        _left = Period;
+        _step = (tick() - _value) / Period;
+      }
+      _left--;
+      _value += _step;
+      return _value;
+    }
+
+    /// Fill `output` with the next values
+    template<typename F>
+    void process(gsl::span<float> output, F&& tick) noexcept
+    {
+      for (auto& frm : output) frm = (*this)(tick);
+    }
+
+    /// Jump to `value`, and evaluate the modulator on the next call
+    void reset(float value) noexcept
+    {
+      _value = value;
+      _step = 0;
+      _left = 0;
+    }
+
+    /// The value returned last
+    float value() const noexcept
+    {
+      return _value;
+    }
+
+  private:
+    float _value = 0;
+    float _step = 0;
+    /// The frames left of the current period
+    int _left = 0;
+  };
+
+  /// Counts the control periods passing in blocks of any length
+  ///
+  /// For modulators that are ticked once per block, like the ones driving a whole block of a
+  /// voice or a wheel bank, without interpolation.
+  template<int Period = control_period>
+  struct ControlClock {
+    /// Move `nframes` frames ahead
+    ///
+    /// \returns the number of control periods that were completed
+    int advance(int nframes) noexcept
+    {
+      _pos += nframes;
+      int periods = _pos / Period;
+      _pos %= Period;
+      return periods;
+    }
+
+  private:
+    int _pos = 0;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,189 @@
+#include "convolver.hpp"
+
+#include <algorithm>
+
+#include "util/audio.hpp"
+#include "util/exception.hpp"
+
+namespace otto::dsp {
+
+  namespace {
+    /// `sum += a * b`, for `n` complex numbers in split arrays
+    void multiply_add(const float* ar,
+                      const float* ai,
+                      const float* br,
+                      const float* bi,
+                      float* sr,
+                      float* si,
+                      int n) noexcept
+    {
+      using namespace util::audio::detail;
+      int k = 0;
+      for (; k < vector_frames(n); k += width) {
+        vec xr = load(ar + k);
+        vec xi = load(ai + k);
+        vec yr = load(br + k);
+        vec yi = load(bi + k);
+        store(sr + k, add(load(sr + k), sub(mul(xr, yr), mul(xi, yi))));
+        store(si + k, add(load(si + k), add(mul(xr, yi), mul(xi, yr))));
+      }
+      for (; k < n; k++) {
+        sr[k] += ar[k] * br[k] - ai[k] * bi[k];
+        si[k] += ar[k] * bi[k] + ai[k] * br[k];
+      }
+    }
+  } // namespace
+
+  // Convolver::Stage //
+
+  Convolver::Stage::Stage(gsl::span<const float> segment, int offset, int block)
+    : block(block),
+      offset(offset),
+      partitions((segment.size() + block - 1) / block),
+      fft(2 * block),
+      filter_re(partitions * fft.bins()),
+      filter_im(partitions * fft.bins()),
+      spectra_re(partitions * fft.bins()),
+      spectra_im(partitions * fft.bins()),
+      sum_re(fft.bins()),
+      sum_im(fft.bins()),
+      input(2 * block),
+      time(2 * block)
+  {
+    const int bins = fft.bins();
+    const float scale = 1.f / fft.size();
+    for (int p = 0; p < partitions; p++) {
+      // The partition, followed by as many zeros
+      std::fill(time.begin(), time.end(), 0.f);
+      int n = std::min<int>(block, segment.size() - p * block);
+      for (int i = 0; i < n; i++) time[i] = segment[p * block + i] * scale;
+      fft.forward(time, {filter_re.data() + p * bins, bins}, {filter_im.data() + p * bins, bins});
+    }
+  }
+
+  void Convolver::Stage::reset() noexcept
+  {
+    std::fill(spectra_re.begin(), spectra_re.end(), 0.f);
+    std::fill(spectra_im.begin(), spectra_im.end(), 0.f);
+    std::fill(sum_re.begin(), sum_re.end(), 0.f);
+    std::fill(sum_im.begin(), sum_im.end(), 0.f);
+    std::fill(input.begin(), input.end(), 0.f);
+    filled = 0;
+    next = 1;
+  }
+
+  void Convolver::Stage::push(gsl::span<const float> frames, std::vector<float>& output, unsigned end) noexcept
+  {
+    const int bins = fft.bins();
+    std::copy(frames.begin(), frames.end(), input.begin() + block + filled);
+    filled += frames.size();
+
+    // The share of this push of the products of the older partitions. Partition `p` is
+    // multiplied with the input `p` blocks before the one being collected.
+    int pushes = block / frames.size();
+    int done = filled / frames.size();
+    int target = 1 + (partitions - 1) * done / pushes;
+    for (; next < target; next++) {
+      int slot = (newest - (next - 1) + partitions) % partitions;
+      multiply_add(spectra_re.data() + slot * bins, spectra_im.data() + slot * bins,
+                   filter_re.data() + next * bins, filter_im.data() + next * bins, sum_re.data(),
+                   sum_im.data(), bins);
+    }
+    if (filled < block) return;
+
+    newest = (newest + 1) % partitions;
+    float* xr = spectra_re.data() + newest * bins;
+    float* xi = spectra_im.data() + newest * bins;
+    fft.forward(input, {xr, bins}, {xi, bins});
+    multiply_add(xr, xi, filter_re.data(), filter_im.data(), sum_re.data(), sum_im.data(), bins);
+    fft.inverse(sum_re, sum_im, time);
+
+    // The second half of the circular convolution is the linear one of the new block
+    const unsigned mask = output.size() - 1;
+    unsigned start = end - block + offset;
+    for (int i = 0; i < block; i++) output[(start + i) & mask] += time[block + i];
+
+    std::fill(sum_re.begin(), sum_re.end(), 0.f);
+    std::fill(sum_im.begin(), sum_im.end(), 0.f);
+    next = 1;
+    std::copy(input.begin() + block, input.end(), input.begin());
+    filled = 0;
+  }
+
+  // Convolver //
+
+  Convolver::Convolver(gsl::span<const float> impulse, int block)
+    : _block(block), _length(impulse.size()), _input(block), _output(block)
+  {
+    if (block < 4 || (block & (block - 1)) != 0)
+      throw util::exception("Convolver: Block size {} is not a power of two", block);
+
+    // A stage with partitions of size `b` starting at `offset` has its output ready `b` frames
+    // after its input, but is played `offset + block` frames after it. `stage_partitions`
+    // partitions of each size make `offset >= b - block` hold for the next stage.
+    int offset = 0;
+    int b = block;
+    while (offset < _length) {
+      int left = _length - offset;
+      int size = b < max_block_factor * block ? std::min(left, stage_partitions * b) : left;
+      _stages.emplace_back(impulse.subspan(offset, size), offset, b);
+      offset += _stages.back().partitions * b;
+      if (b < max_block_factor * block) b *= 4;
+    }
+
+    std::size_t ring = 1;
+    while (ring < std::size_t(offset + block)) ring *= 2;
+    _ring.resize(ring);
+  }
+
+  std::vector<int> Convolver::stage_blocks() const
+  {
+    std::vector<int> res;
+    for (auto& stage : _stages) res.push_back(stage.block);
+    return res;
+  }
+
+  void Convolver::reset() noexcept
+  {
+    for (auto& stage : _stages) stage.reset();
+    std::fill(_input.begin(), _input.end(), 0.f);
+    std::fill(_output.begin(), _output.end(), 0.f);
+    std::fill(_ring.begin(), _ring.end(), 0.f);
+    _pos = 0;
+  }
+
+  void Convolver::process_block() noexcept
+  {
+    unsigned end = _time + _block;
+    for (auto& stage : _stages) stage.push(_input, _ring, end);
+    const unsigned mask = _ring.size() - 1;
+    for (int i = 0; i < _block; i++) {
+      auto& frm = _ring[(_time + i) & mask];
+      _output[i] = frm;
+      frm = 0;
+    }
+    _time = end;
+  }
+
+  void Convolver::process(gsl::span<const float> input, gsl::span<float> output) noexcept
+  {
+    const float* in = input.data();
+    float* out = output.data();
+    int nframes = input.size();
+    while (nframes > 0) {
+      int n = std::min(nframes, _block - _pos);
+      // Copy the input first, so the output may overwrite it
+      std::copy_n(in, n, _input.data() + _pos);
+      std::copy_n(_output.data() + _pos, n, out);
+      _pos += n;
+      in += n;
+      out += n;
+      nframes -= n;
+      if (_pos == _block) {
+        process_block();
+        _pos = 0;
+      }
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+
+#include <gsl/span>
+
+#include "util/dsp/fft.hpp"
+
+namespace otto::dsp {
+
+  /// Convolves a signal with a long impulse response, like the recording of a room
+  ///
+  /// The impulse response is split into partitions, which are convolved with the input by
+  /// uniformly partitioned overlap-save FFT convolution: each block of input is transformed
+  /// once, and its spectrum is kept in a delay line, where it is multiplied by the spectrum of
+  /// each partition in turn. The cost of a block is then one forward and one inverse transform,
+  /// and a complex multiply-add per bin and partition.
+  ///
+  /// Long impulse responses would need many small partitions, so the partitions grow along the
+  /// impulse response: the head is split into partitions of the block size, which sets the
+  /// latency, and each later stage into partitions 4 times as large as the one before, up to
+  /// @ref max_block_factor times the block size. A stage starts late enough in the impulse
+  /// response that its output is only needed a block after it was computed. The multiply-adds
+  /// of all but the newest input block of a stage are spread over the blocks of the head in
+  /// between, so the cost of each block of the head is about the same. Only the transforms of
+  /// the larger stages land on a single block.
+  ///
+  /// Everything is allocated in the constructor, which transforms the impulse response, so it
+  /// should be constructed off the audio thread, like in the loader of an asset.
+  struct Convolver {
+    static constexpr int default_block = 128;
+    /// The largest partitions, as a multiple of the block size
+    static constexpr int max_block_factor = 16;
+    /// The number of partitions of each stage but the last
+    static constexpr int stage_partitions = 4;
+
+    /// \param impulse The impulse response
+    /// \param block The size of the partitions of the head, and the latency, a power of two
+    Convolver(gsl::span<const float> impulse, int block = default_block);
+
+    /// Convolve `input` into `output`, which may be the same buffer
+    ///
+    /// The output is late by @ref latency frames.
+    void process(gsl::span<const float> input, gsl::span<float> output) noexcept;
+
+    /// Clear the input and the output, so the tail of the last input is not played
+    void reset() noexcept;
+
+    /// The delay of the output, in frames
+    int latency() const noexcept
+    {
+      return _block;
+    }
+
+    /// The length of the impulse response, in frames
+    int length() const noexcept
+    {
+      return _length;
+    }
+
+    /// The block size of each stage, from the head to the tail
+    std::vector<int> stage_blocks() const;
+
+  private:
+    /// The partitions of the impulse response that have the same size
+    struct Stage {
+      /// \param segment The part of the impulse response of this stage
+      /// \param offset The position of the segment in the impulse response
+      Stage(gsl::span<const float> segment, int offset, int block);
+
+      /// Add a block of the head to the input, `input.size()` frames
+      ///
+      /// When a whole block of the stage is collected, its output is added to the ring
+      /// `output`, `offset` frames after the block. `end` is the time of the frame after
+      /// `input`.
+      void push(gsl::span<const float> input, std::vector<float>& output, unsigned end) noexcept;
+
+      void reset() noexcept;
+
+      int block;
+      int offset;
+      int partitions;
+      FFT fft;
+      /// The spectra of the partitions, one after the other, scaled by the size of the
+      /// transform
+      std::vector<float> filter_re;
+      std::vector<float> filter_im;
+      /// The spectra of the last `partitions` input blocks, in a ring
+      std::vector<float> spectra_re;
+      std::vector<float> spectra_im;
+      /// The partition of `spectra` with the newest spectrum
+      int newest = 0;
+      /// The sum of the products of the next output block
+      std::vector<float> sum_re;
+      std::vector<float> sum_im;
+      /// The next partition to add to `sum`
+      int next = 1;
+      /// The last block of input, followed by the frames of the current one
+      std::vector<float> input;
+      int filled = 0;
+      /// The output of the inverse transform
+      std::vector<float> time;
+    };
+
+    /// Convolve the block of the head in `_input`, and read the output of it into `_output`
+    void process_block() noexcept;
+
+    int _block;
+    int _length;
+    std::vector<Stage> _stages;
+    /// The input of the current block
+    std::vector<float> _input;
+    /// The output of the last block
+    std::vector<float> _output;
+    /// The position in `_input` and `_output`
+    int _pos = 0;
+    /// The sum of the outputs of the stages, indexed by output time, in a ring the size of a
+    /// power of two
+    std::vector<float> _ring;
+    /// The output time of the first frame of the current block
+    unsigned _time = 0;
+  };
+
+} // namespace otto::dsp
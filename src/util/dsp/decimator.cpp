@@ -0,0 +1,100 @@
+#include "decimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace otto::dsp {
+
+  namespace {
+    /// The modified Bessel function of the first kind, of order 0
+    double bessel_i0(double x)
+    {
+      double sum = 1;
+      double term = 1;
+      for (int k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+      }
+      return sum;
+    }
+
+    /// The coefficients of the halfband filter at the odd offsets 1, 3, 5... from the middle
+    const std::array<float, HalfbandDecimator::half_taps> halfband_coefficients = [] {
+      constexpr double beta = 7;
+      constexpr int middle = HalfbandDecimator::taps / 2;
+      std::array<double, HalfbandDecimator::half_taps> res;
+      double sum = 0;
+      for (int j = 0; j < HalfbandDecimator::half_taps; j++) {
+        int n = 2 * j + 1;
+        double sinc = (j % 2 == 0 ? 1 : -1) / (M_PI * n);
+        double ratio = double(n) / middle;
+        double window = bessel_i0(beta * std::sqrt(1 - ratio * ratio)) / bessel_i0(beta);
+        res[j] = sinc * window;
+        sum += res[j];
+      }
+      // Unity gain at DC: 0.5 + 2 * sum = 1
+      std::array<float, HalfbandDecimator::half_taps> coefficients;
+      for (int j = 0; j < HalfbandDecimator::half_taps; j++) {
+        coefficients[j] = float(res[j] * 0.25 / sum);
+      }
+      return coefficients;
+    }();
+  } // namespace
+
+  void HalfbandDecimator::process(gsl::span<const float> input, gsl::span<float> output) noexcept
+  {
+    constexpr int middle = taps / 2;
+    for (int i = 0; i < output.size(); i++) {
+      for (int k = 0; k < 2; k++) {
+        _history[_pos] = _history[_pos + taps] = input[2 * i + k];
+        _pos = _pos + 1 == taps ? 0 : _pos + 1;
+      }
+      // From the oldest to the newest frame. The filter is symmetric, so the order of the
+      // coefficients does not matter.
+      const float* x = _history.data() + _pos;
+      float res = 0.5f * x[middle];
+      for (int j = 0; j < half_taps; j++) {
+        res += halfband_coefficients[j] * (x[middle - 1 - 2 * j] + x[middle + 1 + 2 * j]);
+      }
+      output[i] = res;
+    }
+  }
+
+  void HalfbandDecimator::reset() noexcept
+  {
+    _history.fill(0);
+    _pos = 0;
+  }
+
+  void Decimator::factor(int factor) noexcept
+  {
+    factor = factor >= 4 ? 4 : factor >= 2 ? 2 : 1;
+    if (factor == _factor) return;
+    _factor = factor;
+    reset();
+  }
+
+  void Decimator::process(gsl::span<const float> input, gsl::span<float> output) noexcept
+  {
+    switch (_factor) {
+    case 1: std::copy(input.begin(), input.end(), output.begin()); break;
+    case 2: _stages[0].process(input, output); break;
+    default: {
+      // Through the scratch buffer, a chunk at a time
+      const int chunk = _scratch.size() / 2;
+      for (int start = 0; start < output.size(); start += chunk) {
+        int n = std::min<int>(chunk, output.size() - start);
+        gsl::span<float> mid = {_scratch.data(), 2 * n};
+        _stages[0].process({input.data() + 4 * start, 4 * n}, mid);
+        _stages[1].process(mid, {output.data() + start, n});
+      }
+    }
+    }
+  }
+
+  void Decimator::reset() noexcept
+  {
+    for (auto& stage : _stages) stage.reset();
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+
+#include <gsl/span>
+
+namespace otto::dsp {
+
+  /// Halves the samplerate of a signal, with a halfband lowpass filter
+  ///
+  /// The filter is a linear phase FIR of @ref taps taps, from a Kaiser windowed sinc, with
+  /// about 70 dB of attenuation above a quarter of the input rate, and a passband up to about
+  /// 0.2 of it. In a halfband filter every other coefficient is zero, except the one in the
+  /// middle, which is 0.5. It is computed in its polyphase form: only the kept output frames
+  /// are computed, the odd input frames only go through the middle tap, and the symmetric
+  /// coefficients are applied to pairs of frames, so a frame of output costs
+  /// @ref half_taps multiplies.
+  struct HalfbandDecimator {
+    /// The nonzero coefficients on each side of the middle
+    static constexpr int half_taps = 12;
+    static constexpr int taps = 4 * half_taps - 1;
+
+    /// Filter and decimate `input` into `output`
+    ///
+    /// \requires `input.size() == 2 * output.size()`
+    void process(gsl::span<const float> input, gsl::span<float> output) noexcept;
+
+    /// Clear the history
+    void reset() noexcept;
+
+  private:
+    /// The last `taps` input frames, stored twice, from `_pos`, so they can be read without
+    /// wrapping
+    std::array<float, 2 * taps> _history = {};
+    int _pos = 0;
+  };
+
+  /// Decimates a signal by a factor of 1, 2 or 4, with a cascade of @ref HalfbandDecimator
+  ///
+  /// For engines that render at a multiple of the samplerate to avoid aliasing, like FM with
+  /// feedback.
+  struct Decimator {
+    static constexpr int max_factor = 4;
+
+    /// Change the factor, to 1, 2 or 4. Clears the history if it changed.
+    void factor(int factor) noexcept;
+    int factor() const noexcept
+    {
+      return _factor;
+    }
+
+    /// Filter and decimate `input` into `output`
+    ///
+    /// \requires `input.size() == factor() * output.size()`
+    void process(gsl::span<const float> input, gsl::span<float> output) noexcept;
+
+    void reset() noexcept;
+
+  private:
+    int _factor = 1;
+    std::array<HalfbandDecimator, 2> _stages;
+    /// The output of the first of two stages
+    std::array<float, 128> _scratch;
+  };
+
+} // namespace otto::dsp
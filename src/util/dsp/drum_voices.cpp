@@ -0,0 +1,85 @@
+#include "drum_voices.hpp"
+
+#include <algorithm>
+
+namespace otto::dsp {
+
+  // SampleArena //
+
+  int SampleArena::add(gsl::span<const float> samples, float samplerate)
+  {
+    Region region = {static_cast<int>(_samples.size()), static_cast<int>(samples.size()),
+                     samplerate};
+    _samples.insert(_samples.end(), samples.begin(), samples.end());
+    _regions.push_back(region);
+    return _regions.size() - 1;
+  }
+
+  void SampleArena::reserve(std::size_t samples)
+  {
+    _samples.reserve(_samples.size() + samples);
+  }
+
+  // DrumVoices //
+
+  void DrumVoices::trigger(const SampleArena& arena, int region, int channel, float gain) noexcept
+  {
+    auto& reg = arena.region(region);
+    if (reg.length == 0) return;
+    auto free = std::find_if(_voices.begin(), _voices.end(), [](auto& v) { return v.channel < 0; });
+    if (free == _voices.end()) {
+      free = std::min_element(_voices.begin(), _voices.end(),
+                              [](auto& a, auto& b) { return a.started < b.started; });
+      stop(*free);
+    }
+    *free = {arena.data(reg), reg.length, reg.samplerate, 0, gain, channel, _triggers++};
+    _channel_voices[channel]++;
+  }
+
+  void DrumVoices::stop(Voice& voice) noexcept
+  {
+    if (voice.channel < 0) return;
+    _channel_voices[voice.channel]--;
+    voice.channel = -1;
+  }
+
+  void DrumVoices::stop_all() noexcept
+  {
+    for (auto& voice : _voices) stop(voice);
+  }
+
+  int DrumVoices::playing() const noexcept
+  {
+    return std::count_if(_voices.begin(), _voices.end(), [](auto& v) { return v.channel >= 0; });
+  }
+
+  void DrumVoices::process(gsl::span<float> out, float samplerate) noexcept
+  {
+    for (auto& voice : _voices) {
+      if (voice.channel < 0) continue;
+      const double increment = voice.samplerate / samplerate;
+      const int last = voice.length - 1;
+      int f = 0;
+      if (increment == 1) {
+        // At the samplerate of the sample, the position stays on whole frames
+        int index = voice.position;
+        int n = std::min<int>(out.size(), voice.length - index);
+        for (; f < n; f++) out[f] += voice.gain * voice.samples[index + f];
+        voice.position += n;
+        if (f < out.size()) stop(voice);
+        continue;
+      }
+      for (; f < out.size(); f++) {
+        int index = voice.position;
+        if (index >= last) break;
+        float frac = voice.position - index;
+        float a = voice.samples[index];
+        float b = voice.samples[index + 1];
+        out[f] += voice.gain * (a + (b - a) * frac);
+        voice.position += increment;
+      }
+      if (f < out.size()) stop(voice);
+    }
+  }
+
+} // namespace otto::dsp
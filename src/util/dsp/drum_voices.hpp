@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <gsl/span>
+
+#include "util/memory_tags.hpp"
+
+namespace otto::dsp {
+
+  /// Samples stored back to back in one allocation
+  ///
+  /// Filled on a loader thread, then only read, so all the samples of all the kits stay in one
+  /// block of memory, and nothing is allocated or loaded when a drum is switched. The samples
+  /// are accounted to the memory tag `Drum samples`.
+  struct SampleArena {
+    /// A sample in the arena
+    struct Region {
+      int offset = 0;
+      int length = 0;
+      /// The samplerate of the sample
+      float samplerate = 44100;
+    };
+
+    /// Add a sample
+    ///
+    /// \returns The index of its region
+    int add(gsl::span<const float> samples, float samplerate);
+
+    /// Reserve room for `samples` more samples, so adding them does not reallocate
+    void reserve(std::size_t samples);
+
+    const Region& region(int index) const noexcept
+    {
+      return _regions[index];
+    }
+
+    int region_count() const noexcept
+    {
+      return _regions.size();
+    }
+
+    const float* data(const Region& region) const noexcept
+    {
+      return _samples.data() + region.offset;
+    }
+
+  private:
+    util::TaggedVector<float> _samples{util::memory_tag("Drum samples")};
+    std::vector<Region> _regions;
+  };
+
+  /// A small pool of sample voices shared by all the channels of a drum machine
+  ///
+  /// A trigger takes a free voice, or the oldest one if all are playing, so the cost of
+  /// rendering is bounded by @ref voice_count however many channels are busy. Only playing
+  /// voices are rendered, so silent channels cost nothing.
+  struct DrumVoices {
+    static constexpr int voice_count = 8;
+    static constexpr int max_channels = 16;
+
+    /// Start playing `region` of `arena` on `channel`
+    ///
+    /// The arena has to outlive the voice, or @ref stop_all has to be called before it goes.
+    void trigger(const SampleArena& arena, int region, int channel, float gain) noexcept;
+
+    /// Stop all voices
+    void stop_all() noexcept;
+
+    /// Add the playing voices to `out`, at `samplerate`
+    void process(gsl::span<float> out, float samplerate) noexcept;
+
+    /// Whether a voice is playing on `channel`
+    bool playing(int channel) const noexcept
+    {
+      return _channel_voices[channel] > 0;
+    }
+
+    /// The number of playing voices
+    int playing() const noexcept;
+
+  private:
+    struct Voice {
+      const float* samples = nullptr;
+      int length = 0;
+      float samplerate = 0;
+      double position = 0;
+      float gain = 0;
+      int channel = -1;
+      long started = 0;
+    };
+
+    void stop(Voice& voice) noexcept;
+
+    std::array<Voice, voice_count> _voices;
+    std::array<int, max_channels> _channel_voices = {};
+    long _triggers = 0;
+  };
+
+} // namespace otto::dsp
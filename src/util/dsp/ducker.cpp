@@ -0,0 +1,72 @@
+#include "ducker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+#include "util/math.hpp"
+
+namespace otto::dsp {
+
+  void Ducker::threshold(float db) noexcept
+  {
+    _threshold = db;
+  }
+
+  void Ducker::ratio(float ratio) noexcept
+  {
+    _slope = 1 - 1 / std::max(ratio, 1.f);
+  }
+
+  void Ducker::release(float seconds) noexcept
+  {
+    if (seconds == _release_time) return;
+    _release_time = seconds;
+    _samplerate = 0;
+  }
+
+  void Ducker::depth(float db) noexcept
+  {
+    _depth = std::max(db, 0.f);
+  }
+
+  float Ducker::gain_for(float level) const noexcept
+  {
+    if (level <= 0) return 1;
+    float over = util::math::fast::gain_to_db(level) - _threshold;
+    if (over <= 0) return 1;
+    return util::math::fast::db_to_gain(-std::min(over * _slope, _depth));
+  }
+
+  void Ducker::process(gsl::span<const float> key, gsl::span<float> signal) noexcept
+  {
+    process(key, signal, {});
+  }
+
+  void Ducker::process(gsl::span<const float> key, gsl::span<float> left, gsl::span<float> right) noexcept
+  {
+    if (_samplerate != gam::sampleRate()) {
+      _samplerate = gam::sampleRate();
+      _envelope.k = 1 - std::exp(-sub_block / std::max(_release_time * _samplerate, 1.0));
+    }
+
+    auto& kernels = util::audio::kernels();
+    const int nframes = std::min(key.size(), left.size());
+    float min_gain = 1;
+    std::array<float, sub_block> ramp;
+    for (int i = 0; i < nframes; i += sub_block) {
+      const int n = std::min(sub_block, nframes - i);
+      float target = gain_for(_envelope(kernels.peak(key.data() + i, n)));
+      float step = (target - _gain) / n;
+      for (int j = 0; j < n; j++) ramp[j] = _gain + step * (j + 1);
+      _gain = target;
+      kernels.gain(left.data() + i, ramp.data(), n);
+      if (!right.empty()) kernels.gain(right.data() + i, ramp.data(), n);
+      min_gain = std::min(min_gain, target);
+    }
+    _gain_reduction.store(-20 * std::log10(min_gain), std::memory_order_relaxed);
+  }
+
+} // namespace otto::dsp
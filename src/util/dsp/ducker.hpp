@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+
+#include <gsl/span>
+
+#include "util/audio.hpp"
+#include "util/dsp/control_rate.hpp"
+
+namespace otto::dsp {
+
+  /// Lowers a signal while a key signal is loud, like a compressor with a sidechain
+  ///
+  /// The detector runs once per sub-block of @ref sub_block frames: the peak of the key in
+  /// the sub-block feeds an @ref util::audio::EnvelopeFollower, and the gain is computed from
+  /// its level and ramped to linearly over the sub-block. The follower jumps up to peaks, so
+  /// the gain is down within one sub-block of the key.
+  struct Ducker {
+    static constexpr int sub_block = control_period;
+
+    /// Set the level of the key where ducking starts, in dB
+    void threshold(float db) noexcept;
+    /// Set the ratio of the level of the key above the threshold to the reduction
+    void ratio(float ratio) noexcept;
+    /// Set the time the gain takes to recover, in seconds
+    void release(float seconds) noexcept;
+    /// Set the largest reduction, in dB
+    void depth(float db) noexcept;
+
+    /// Duck `signal` in place by the level of `key`, at the samplerate of gamma
+    void process(gsl::span<const float> key, gsl::span<float> signal) noexcept;
+    /// Duck `left` and `right` in place by the same gain, so the image stays put
+    void process(gsl::span<const float> key, gsl::span<float> left, gsl::span<float> right) noexcept;
+
+    /// The largest gain reduction in the last block, in dB
+    ///
+    /// Lock free, to be read by the UI.
+    float gain_reduction() const noexcept
+    {
+      return _gain_reduction.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /// The gain for the level of the key
+    float gain_for(float level) const noexcept;
+
+    float _threshold = -24;
+    float _slope = 0.75;
+    float _release_time = 0.2;
+    float _depth = 12;
+
+    double _samplerate = 0;
+    util::audio::EnvelopeFollower _envelope;
+    float _gain = 1;
+
+    std::atomic<float> _gain_reduction = 0;
+  };
+
+} // namespace otto::dsp
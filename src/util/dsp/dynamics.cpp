@@ -0,0 +1,137 @@
+#include "dynamics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+#include "util/math.hpp"
+
+namespace otto::dsp {
+
+  namespace {
+    /// The width of the soft knee of the compressor, in dB
+    constexpr float knee = 6;
+
+    /// The coefficient of a one-pole smoother with the time constant `frames`
+    float one_pole(double frames) noexcept
+    {
+      return 1 - std::exp(-1 / std::max(frames, 1.0));
+    }
+
+    /// Pass `x` below the ceiling, and bend it smoothly towards full scale above
+    float soft_clip(float x, float ceiling) noexcept
+    {
+      float mag = std::abs(x);
+      if (mag <= ceiling) return x;
+      float headroom = 1 - ceiling;
+      return std::copysign(ceiling + headroom * std::tanh((mag - ceiling) / headroom), x);
+    }
+  } // namespace
+
+  Dynamics::Dynamics() : _curve(curve_size)
+  {
+    update();
+  }
+
+  void Dynamics::threshold(float db) noexcept
+  {
+    _threshold = db;
+    _dirty = true;
+  }
+
+  void Dynamics::ratio(float ratio) noexcept
+  {
+    _ratio = std::max(ratio, 1.f);
+    _dirty = true;
+  }
+
+  void Dynamics::times(float attack, float release) noexcept
+  {
+    _attack_time = attack;
+    _release_time = release;
+    _dirty = true;
+  }
+
+  float Dynamics::compressor_gain(float power) const noexcept
+  {
+    if (power <= 0) return 1;
+    float over = util::math::fast::gain_to_db(power) / 2 - _threshold;
+    float slope = 1 / _ratio - 1;
+    float gain_db = 0;
+    if (2 * over >= knee) {
+      gain_db = slope * over;
+    } else if (2 * over > -knee) {
+      gain_db = slope * (over + knee / 2) * (over + knee / 2) / (2 * knee);
+    }
+    return util::math::fast::db_to_gain(gain_db);
+  }
+
+  void Dynamics::update() noexcept
+  {
+    _samplerate = gam::sampleRate();
+    _attack = one_pole(_attack_time * _samplerate);
+    _release = one_pole(_release_time * _samplerate);
+    // Close enough to the target after the lookahead that the soft clipper covers the rest
+    _limiter_attack = one_pole(lookahead / 5.0);
+    _limiter_release = one_pole(0.05 * _samplerate);
+    for (int i = 0; i < curve_size; i++) {
+      _curve[i] = compressor_gain(max_power * i / (curve_size - 1));
+    }
+  }
+
+  void Dynamics::process(gsl::span<float> left, gsl::span<float> right) noexcept
+  {
+    if (_dirty.exchange(false) || _samplerate != gam::sampleRate()) update();
+
+    constexpr float curve_scale = (curve_size - 1) / max_power;
+    float min_gain = 1;
+    for (int f = 0; f < left.size(); f++, _frame++) {
+      float l = left[f];
+      float r = right[f];
+
+      // Compressor
+      float power = 0.5f * (l * l + r * r);
+      _power += (power > _power ? _attack : _release) * (power - _power);
+      float pos = _power * curve_scale;
+      float comp;
+      if (pos < curve_size - 1) {
+        int index = pos;
+        float frac = pos - index;
+        comp = _curve[index] + (_curve[index + 1] - _curve[index]) * frac;
+      } else {
+        comp = compressor_gain(_power);
+      }
+      l *= comp;
+      r *= comp;
+
+      // Limiter. The gain has to be down for this frame when it leaves the delay, so the target
+      // is the smallest gain needed by any frame in the delay.
+      float peak = std::max(std::abs(l), std::abs(r));
+      float needed = peak > ceiling ? ceiling / peak : 1.f;
+      constexpr int capacity = lookahead + 1;
+      while (_queue_size > 0 && _queue[(_queue_front + _queue_size - 1) % capacity].second >= needed) {
+        _queue_size--;
+      }
+      _queue[(_queue_front + _queue_size) % capacity] = {_frame, needed};
+      _queue_size++;
+      if (_queue[_queue_front].first < _frame - lookahead) {
+        _queue_front = (_queue_front + 1) % capacity;
+        _queue_size--;
+      }
+      float target = _queue[_queue_front].second;
+      _limiter_gain += (target < _limiter_gain ? _limiter_attack : _limiter_release) *
+                       (target - _limiter_gain);
+
+      auto delayed = _delay[_pos];
+      _delay[_pos] = {l, r};
+      _pos = (_pos + 1) % lookahead;
+
+      left[f] = soft_clip(delayed[0] * _limiter_gain, ceiling);
+      right[f] = soft_clip(delayed[1] * _limiter_gain, ceiling);
+      min_gain = std::min(min_gain, comp * _limiter_gain);
+    }
+    _gain_reduction.store(-20 * std::log10(min_gain), std::memory_order_relaxed);
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include <gsl/span>
+
+namespace otto::dsp {
+
+  /// A stereo-linked master dynamics stage
+  ///
+  /// Three stages, all driven by both channels together, so the stereo image doesn't move:
+  ///
+  ///  - An RMS compressor, with a soft knee. The curve is precomputed as a table indexed by the
+  ///    mean square level, so the detector needs no logarithms or roots per frame.
+  ///  - A peak limiter, looking @ref lookahead frames ahead to pull the gain down before a peak
+  ///    arrives. This delays the output by @ref lookahead frames.
+  ///  - A soft clipper, catching what the limiter lets through.
+  struct Dynamics {
+    /// The latency of the limiter, in frames
+    static constexpr int lookahead = 64;
+
+    Dynamics();
+
+    /// Set the compressor threshold, in dB
+    void threshold(float db) noexcept;
+    /// Set the compressor ratio
+    void ratio(float ratio) noexcept;
+    /// Set the attack and release times of the compressor, in seconds
+    void times(float attack, float release) noexcept;
+
+    /// Process a block of both channels in place, at the samplerate of gamma
+    void process(gsl::span<float> left, gsl::span<float> right) noexcept;
+
+    /// The largest gain reduction in the last block, in dB
+    ///
+    /// Lock free, to be read by the UI.
+    float gain_reduction() const noexcept
+    {
+      return _gain_reduction.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /// Recompute the gain curve, and the coefficients when the samplerate changed
+    void update() noexcept;
+
+    /// The compressor gain at the mean square level `power`
+    float compressor_gain(float power) const noexcept;
+
+    /// The number of entries in the gain curve, covering mean square levels up to `max_power`
+    static constexpr int curve_size = 4096;
+    static constexpr float max_power = 16;
+
+    /// The level the limiter keeps the peaks under, before the soft clipper
+    static constexpr float ceiling = 0.95;
+
+    /// The parameters, set from the UI thread
+    std::atomic<float> _threshold = -6;
+    std::atomic<float> _ratio = 4;
+    std::atomic<float> _attack_time = 0.0008;
+    std::atomic<float> _release_time = 0.5;
+    /// Set when a parameter changed, to update the curve on the audio thread
+    std::atomic<bool> _dirty = true;
+
+    double _samplerate = 0;
+    std::vector<float> _curve;
+    float _attack;
+    float _release;
+    float _limiter_attack;
+    float _limiter_release;
+    float _power = 0;
+
+    /// The compressed signal, waiting for the limiter
+    std::array<std::array<float, 2>, lookahead> _delay = {};
+    int _pos = 0;
+    /// The gain needed for each frame in the delay, as a monotonic queue of `{frame, gain}`, so
+    /// the smallest gain in the window is at the front
+    std::array<std::pair<long, float>, lookahead + 1> _queue;
+    int _queue_front = 0;
+    int _queue_size = 0;
+    long _frame = 0;
+    float _limiter_gain = 1;
+
+    std::atomic<float> _gain_reduction = 0;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,103 @@
+#include "envelope.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  void Envelope::attack(float seconds) noexcept
+  {
+    _attack = seconds;
+  }
+
+  void Envelope::decay(float seconds) noexcept
+  {
+    _decay = seconds;
+  }
+
+  void Envelope::sustain(float level) noexcept
+  {
+    _sustain = level;
+    if (_stage == Stage::sustain) _value = level;
+  }
+
+  void Envelope::release(float seconds) noexcept
+  {
+    _release = seconds;
+  }
+
+  void Envelope::trigger() noexcept
+  {
+    start(Stage::attack, 1.f, _attack);
+  }
+
+  void Envelope::release() noexcept
+  {
+    if (_stage == Stage::release || _stage == Stage::done) return;
+    start(Stage::release, 0.f, _release);
+  }
+
+  void Envelope::finish() noexcept
+  {
+    _stage = Stage::done;
+    _value = 0.f;
+  }
+
+  void Envelope::start(Stage stage, float end, float seconds) noexcept
+  {
+    _stage = stage;
+    _end = end;
+    _left = std::max(1, int(std::lround(seconds * gam::sampleRate())));
+    // Aim past `end`, so the ramp gets there after exactly `_left` frames:
+    // goal + (value - goal) * ratio = end
+    _goal = (end - curve_ratio * _value) / (1.f - curve_ratio);
+    _offset = _value - _goal;
+    _coefficient = std::pow(curve_ratio, 1.f / _left);
+  }
+
+  void Envelope::next() noexcept
+  {
+    _value = _end;
+    switch (_stage) {
+    case Stage::attack: start(Stage::decay, _sustain, _decay); break;
+    case Stage::decay:
+      _stage = Stage::sustain;
+      _value = _sustain;
+      break;
+    case Stage::release: finish(); break;
+    default: break;
+    }
+  }
+
+  void Envelope::process(gsl::span<float> output) noexcept
+  {
+    float* out = output.data();
+    int nframes = output.size();
+    while (nframes > 0) {
+      if (_stage == Stage::sustain || _stage == Stage::done) {
+        std::fill(out, out + nframes, _value);
+        return;
+      }
+      int n = std::min(nframes, _left);
+      float offset = _offset;
+      for (int i = 0; i < n; i++) {
+        offset *= _coefficient;
+        out[i] = _goal + offset;
+      }
+      _offset = offset;
+      _left -= n;
+      out += n;
+      nframes -= n;
+      if (_left == 0) {
+        next();
+        // The last frame of a segment is its exact end value
+        out[-1] = _value;
+      } else {
+        _value = out[-1];
+      }
+    }
+  }
+
+} // namespace otto::dsp
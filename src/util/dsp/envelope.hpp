@@ -0,0 +1,93 @@
+#pragma once
+
+#include <gsl/span>
+
+namespace otto::dsp {
+
+  /// An ADSR envelope whose segments are computed a block at a time
+  ///
+  /// Each segment is a closed form exponential ramp, `goal + offset * c^n`, aimed past its end
+  /// value so that it reaches it in exactly the length of the segment. A frame of a segment is
+  /// then one multiply and one add, and @ref process only branches at the segment boundaries,
+  /// so the inner loops vectorize. The shape of the ramps is that of `gam::ADSR` with its
+  /// default curvature of -4: fast at the start, and slow towards the end.
+  ///
+  /// Times are in seconds, at the samplerate of gamma when the segment starts.
+  struct Envelope {
+    enum struct Stage { attack, decay, sustain, release, done };
+
+    /// The shape of a segment, as the part of the distance to its goal left at its end. `e^-4`.
+    static constexpr float curve_ratio = 0.0183156389f;
+
+    void attack(float seconds) noexcept;
+    void decay(float seconds) noexcept;
+    /// The sustain level, from 0 to 1
+    void sustain(float level) noexcept;
+    void release(float seconds) noexcept;
+
+    /// Start the attack, from the current value
+    void trigger() noexcept;
+    /// Start the release, from the current value, unless it is done
+    void release() noexcept;
+    /// Jump to the end, at 0
+    void finish() noexcept;
+
+    /// The values of the next `output.size()` frames
+    void process(gsl::span<float> output) noexcept;
+
+    /// The value of the next frame
+    float operator()() noexcept
+    {
+      float res;
+      process({&res, 1});
+      return res;
+    }
+
+    /// The value of the last frame
+    float value() const noexcept
+    {
+      return _value;
+    }
+
+    Stage stage() const noexcept
+    {
+      return _stage;
+    }
+
+    /// Whether the release has started, or the envelope is done
+    bool released() const noexcept
+    {
+      return _stage >= Stage::release;
+    }
+
+    bool done() const noexcept
+    {
+      return _stage == Stage::done;
+    }
+
+  private:
+    /// Start `stage`, ramping from the current value to `end` over `seconds`
+    void start(Stage stage, float end, float seconds) noexcept;
+    /// Start the stage after the current one
+    void next() noexcept;
+
+    float _attack = 0.01f;
+    float _decay = 0.1f;
+    float _sustain = 1.f;
+    float _release = 0.2f;
+
+    Stage _stage = Stage::done;
+    float _value = 0.f;
+    /// The value the ramp approaches
+    float _goal = 0.f;
+    /// The distance of the value from `_goal`
+    float _offset = 0.f;
+    /// The factor of `_offset` per frame
+    float _coefficient = 1.f;
+    /// The frames left of the segment
+    int _left = 0;
+    /// The value at the end of the segment
+    float _end = 0.f;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,112 @@
+#include "fdn_reverb.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  namespace {
+    /// The lengths of the lines at 44.1kHz. Mutually prime, so their echoes don't line up.
+    constexpr std::array<int, FDNReverb::lines> base_delays = {1031, 1153, 1327, 1523,
+                                                               1637, 1871, 2053, 2311};
+
+    /// Multiply by the normalized Hadamard matrix, in place
+    template<typename Frame>
+    void hadamard(Frame& x) noexcept
+    {
+      for (int h = 1; h < int(x.size()); h *= 2) {
+        for (int i = 0; i < int(x.size()); i += 2 * h) {
+          for (int j = i; j < i + h; j++) {
+            float a = x[j];
+            float b = x[j + h];
+            x[j] = a + b;
+            x[j + h] = a - b;
+          }
+        }
+      }
+      const float scale = 1 / std::sqrt(float(x.size()));
+      for (auto& v : x) v *= scale;
+    }
+  } // namespace
+
+  FDNReverb::FDNReverb(util::Arena* arena) : _buffers(lines * buffer_size, 0.f, arena)
+  {
+    update();
+  }
+
+  void FDNReverb::decay(float seconds) noexcept
+  {
+    _decay = std::max(seconds, 0.01f);
+    _samplerate = 0;
+  }
+
+  void FDNReverb::damping(float amount) noexcept
+  {
+    _damping = std::clamp(amount, 0.f, 0.99f);
+  }
+
+  void FDNReverb::zero() noexcept
+  {
+    std::fill(_buffers.begin(), _buffers.end(), 0.f);
+    _lowpass = {};
+  }
+
+  void FDNReverb::update() noexcept
+  {
+    _samplerate = gam::sampleRate();
+    for (int l = 0; l < lines; l++) {
+      _delay[l] = std::clamp<int>(base_delays[l] * _samplerate / 44100, max_chunk, buffer_size - 1);
+      // Lose 60dB over the decay time
+      _gain[l] = std::pow(0.001, _delay[l] / (_samplerate * _decay));
+    }
+  }
+
+  void FDNReverb::process(gsl::span<const float> input, gsl::span<float> output) noexcept
+  {
+    if (_samplerate != gam::sampleRate()) update();
+    // The sum of the lines, scaled to about the level of the input at medium decay times
+    const float output_gain = 2.f / lines;
+    const float lowpass = 1 - _damping;
+
+    std::array<Frame, max_chunk> taps;
+    for (int done = 0; done < input.size();) {
+      // The lines are at least `max_chunk` long, so the chunk doesn't read what it writes
+      int chunk = std::min<int>(input.size() - done, max_chunk);
+
+      for (int l = 0; l < lines; l++) {
+        const float* buffer = _buffers.data() + l * buffer_size;
+        int read = _write - _delay[l];
+        for (int f = 0; f < chunk; f++) taps[f][l] = buffer[(read + f) & mask];
+      }
+
+      for (int f = 0; f < chunk; f++) {
+        Frame& x = taps[f];
+        float in = input[done + f];
+        float out = 0;
+        for (int l = 0; l < lines; l++) out += x[l];
+        output[done + f] = out * output_gain;
+        if (_frozen) {
+          hadamard(x);
+          continue;
+        }
+
+        for (int l = 0; l < lines; l++) {
+          _lowpass[l] += lowpass * (x[l] - _lowpass[l]);
+          x[l] = _lowpass[l] * _gain[l];
+        }
+        hadamard(x);
+        for (int l = 0; l < lines; l++) x[l] += in;
+      }
+
+      for (int l = 0; l < lines; l++) {
+        float* buffer = _buffers.data() + l * buffer_size;
+        for (int f = 0; f < chunk; f++) buffer[(_write + f) & mask] = taps[f][l];
+      }
+      _write = (_write + chunk) & mask;
+      done += chunk;
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <gsl/span>
+
+#include "util/arena.hpp"
+
+namespace otto::dsp {
+
+  /// A feedback delay network reverb
+  ///
+  /// Eight delay lines, mixed by a Hadamard matrix in the feedback path, each with a one-pole
+  /// low pass for damping. The lines are stored in power-of-two buffers, so positions wrap with
+  /// a mask, and the network is processed in chunks no longer than the shortest line. In each
+  /// chunk, the lines are read in one pass, and the mixing and damping of a frame run across the
+  /// eight lines at once.
+  struct FDNReverb {
+    static constexpr int lines = 8;
+    /// The length of each buffer, enough for the longest line at 192kHz
+    static constexpr int buffer_size = 1 << 14;
+    /// The number of bytes allocated by the constructor, for sizing an arena
+    static constexpr std::size_t memory_size = lines * buffer_size * sizeof(float);
+
+    /// Allocates the delay lines, from `arena` if given
+    FDNReverb(util::Arena* arena = nullptr);
+
+    /// Set the time for the reverb to decay by 60dB, in seconds
+    void decay(float seconds) noexcept;
+
+    /// Set the damping of high frequencies, from 0 for none to 1 for all
+    void damping(float amount) noexcept;
+
+    /// Clear the delay lines
+    void zero() noexcept;
+
+    /// Hold the current tail, by ignoring the input and skipping the damping and decay
+    ///
+    /// The Hadamard matrix keeps the energy of the lines, so the tail sounds until unfrozen.
+    void freeze(bool frozen) noexcept
+    {
+      _frozen = frozen;
+    }
+
+    bool frozen() const noexcept
+    {
+      return _frozen;
+    }
+
+    /// Process `input` into `output`, at the samplerate of gamma. They may be the same buffer.
+    void process(gsl::span<const float> input, gsl::span<float> output) noexcept;
+
+  private:
+    using Frame = std::array<float, lines>;
+
+    /// Update the delay lengths and gains, when the samplerate has changed
+    void update() noexcept;
+
+    static constexpr int mask = buffer_size - 1;
+    /// The longest chunk to process at once
+    static constexpr int max_chunk = 64;
+
+    util::ArenaVector<float> _buffers;
+    std::array<int, lines> _delay;
+    int _write = 0;
+
+    Frame _gain;
+    Frame _lowpass = {};
+    float _damping = 0;
+    float _decay = 1;
+    double _samplerate = 0;
+    bool _frozen = false;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,131 @@
+#include "fft.hpp"
+
+#include <cmath>
+
+#include "util/audio.hpp"
+#include "util/exception.hpp"
+
+namespace otto::dsp {
+
+  FFT::FFT(int size) : _size(size), _half(size / 2)
+  {
+    if (size < 4 || (size & (size - 1)) != 0)
+      throw util::exception("FFT: Size {} is not a power of two of at least 4", size);
+
+    int bits = 0;
+    while ((1 << bits) < _half) bits++;
+    _bitrev.resize(_half);
+    for (int i = 0; i < _half; i++) {
+      int r = 0;
+      for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+      _bitrev[i] = r;
+    }
+
+    _twiddle_re.reserve(_half);
+    _twiddle_im.reserve(_half);
+    for (int half = 1; half < _half; half *= 2) {
+      for (int k = 0; k < half; k++) {
+        double phase = -M_PI * k / half;
+        _twiddle_re.push_back(std::cos(phase));
+        _twiddle_im.push_back(std::sin(phase));
+      }
+    }
+
+    _rotate_re.resize(_half + 1);
+    _rotate_im.resize(_half + 1);
+    for (int k = 0; k <= _half; k++) {
+      double phase = -2 * M_PI * k / size;
+      _rotate_re[k] = std::cos(phase);
+      _rotate_im[k] = std::sin(phase);
+    }
+
+    _re.resize(_half);
+    _im.resize(_half);
+  }
+
+  void FFT::transform(float* re, float* im) noexcept
+  {
+    using namespace util::audio::detail;
+    for (int half = 1; half < _half; half *= 2) {
+      const float* wr = _twiddle_re.data() + half - 1;
+      const float* wi = _twiddle_im.data() + half - 1;
+      for (int start = 0; start < _half; start += 2 * half) {
+        float* ar = re + start;
+        float* ai = im + start;
+        float* br = ar + half;
+        float* bi = ai + half;
+        int k = 0;
+        for (; k < vector_frames(half); k += width) {
+          vec xr = load(br + k);
+          vec xi = load(bi + k);
+          vec twr = load(wr + k);
+          vec twi = load(wi + k);
+          vec tr = sub(mul(xr, twr), mul(xi, twi));
+          vec ti = add(mul(xr, twi), mul(xi, twr));
+          vec ur = load(ar + k);
+          vec ui = load(ai + k);
+          store(br + k, sub(ur, tr));
+          store(bi + k, sub(ui, ti));
+          store(ar + k, add(ur, tr));
+          store(ai + k, add(ui, ti));
+        }
+        for (; k < half; k++) {
+          float tr = br[k] * wr[k] - bi[k] * wi[k];
+          float ti = br[k] * wi[k] + bi[k] * wr[k];
+          br[k] = ar[k] - tr;
+          bi[k] = ai[k] - ti;
+          ar[k] += tr;
+          ai[k] += ti;
+        }
+      }
+    }
+  }
+
+  void FFT::forward(gsl::span<const float> input, gsl::span<float> re, gsl::span<float> im) noexcept
+  {
+    for (int n = 0; n < _half; n++) {
+      _re[_bitrev[n]] = input[2 * n];
+      _im[_bitrev[n]] = input[2 * n + 1];
+    }
+    transform(_re.data(), _im.data());
+
+    // Untangle the spectra of the even and odd frames, E and O, from Z = E + iO, and combine
+    // them into X = E + W^k O
+    for (int k = 0; k <= _half; k++) {
+      int a = k % _half;
+      int b = (_half - k) % _half;
+      float er = 0.5f * (_re[a] + _re[b]);
+      float ei = 0.5f * (_im[a] - _im[b]);
+      float or_ = 0.5f * (_im[a] + _im[b]);
+      float oi = -0.5f * (_re[a] - _re[b]);
+      re[k] = er + _rotate_re[k] * or_ - _rotate_im[k] * oi;
+      im[k] = ei + _rotate_re[k] * oi + _rotate_im[k] * or_;
+    }
+  }
+
+  void FFT::inverse(gsl::span<const float> re, gsl::span<const float> im, gsl::span<float> output) noexcept
+  {
+    // Tangle X back into Z = E + iO, with E = X[k] + X*[N/2 - k] and
+    // O = (X[k] - X*[N/2 - k]) W^-k, each twice their size in the forward transform
+    for (int k = 0; k < _half; k++) {
+      float xr = re[k];
+      float xi = k == 0 ? 0.f : im[k];
+      float cr = re[_half - k];
+      float ci = k == 0 ? 0.f : -im[_half - k];
+      float er = xr + cr;
+      float ei = xi + ci;
+      float dr = xr - cr;
+      float di = xi - ci;
+      float or_ = dr * _rotate_re[k] + di * _rotate_im[k];
+      float oi = di * _rotate_re[k] - dr * _rotate_im[k];
+      _re[_bitrev[k]] = er - oi;
+      _im[_bitrev[k]] = ei + or_;
+    }
+    transform(_im.data(), _re.data());
+    for (int n = 0; n < _half; n++) {
+      output[2 * n] = _re[n];
+      output[2 * n + 1] = _im[n];
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+#include <gsl/span>
+
+namespace otto::dsp {
+
+  /// The fast fourier transform of real signals, of a power of two length
+  ///
+  /// A transform of `size()` frames is computed as a complex transform of half the size, of the
+  /// even frames as the real parts and the odd frames as the imaginary parts, which is then
+  /// untangled into the @ref bins of the real signal. The complex transform is an iterative
+  /// radix-2 one on split real and imaginary arrays, so the butterflies of all but the first
+  /// two stages run four at a time with the vector kernels of `util/audio.hpp`, which are NEON
+  /// on the Pi.
+  ///
+  /// The twiddle factors are computed in the constructor, which allocates. The transforms
+  /// themselves do not, and may be called from the audio thread.
+  struct FFT {
+    /// \param size The number of real frames, a power of two of at least 4
+    FFT(int size);
+
+    int size() const noexcept
+    {
+      return _size;
+    }
+
+    /// The number of complex bins of the transform of a real signal, from DC to nyquist
+    int bins() const noexcept
+    {
+      return _size / 2 + 1;
+    }
+
+    /// The spectrum of the real signal `input`, of @ref size frames, into the @ref bins real
+    /// and imaginary parts `re` and `im`
+    void forward(gsl::span<const float> input, gsl::span<float> re, gsl::span<float> im) noexcept;
+
+    /// The real signal of the spectrum in `re` and `im`, of @ref bins bins, into `output`, of
+    /// @ref size frames
+    ///
+    /// Not normalized, so `inverse(forward(x)) == size() * x`. The imaginary parts of the DC
+    /// and nyquist bins are ignored.
+    void inverse(gsl::span<const float> re, gsl::span<const float> im, gsl::span<float> output) noexcept;
+
+  private:
+    /// The forward complex transform of `_re` and `_im`, in place. Swapping the arrays makes it
+    /// the inverse transform.
+    void transform(float* re, float* im) noexcept;
+
+    int _size;
+    /// The size of the complex transform
+    int _half;
+    /// The bit reversed index of each index of the complex transform
+    std::vector<int> _bitrev;
+    /// The twiddle factors of each stage of the complex transform, `e^(-2 pi i k / len)` for
+    /// `k < len / 2`, starting at `len / 2 - 1`
+    std::vector<float> _twiddle_re;
+    std::vector<float> _twiddle_im;
+    /// `e^(-2 pi i k / size)`, for untangling the spectrum of the real signal
+    std::vector<float> _rotate_re;
+    std::vector<float> _rotate_im;
+    /// The complex signal
+    std::vector<float> _re;
+    std::vector<float> _im;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,36 @@
+#include "glide.hpp"
+
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  void Glide::target(float freq) noexcept
+  {
+    _target = freq;
+    _left = int(std::lround(_time * gam::sampleRate()));
+    if (_left == 0 || freq == _value) {
+      jump(freq);
+      return;
+    }
+    _step = std::log2(freq / _value) / _left;
+    _ratio = std::exp2(_step);
+  }
+
+  void Glide::jump(float freq) noexcept
+  {
+    _value = _target = freq;
+    _left = 0;
+  }
+
+  float Glide::advance(int nframes) noexcept
+  {
+    float res = _value;
+    if (_left == 0) return res;
+    _left = nframes < _left ? _left - nframes : 0;
+    _value = _left == 0 ? double(_target) : _target * std::exp2(-_step * _left);
+    return res;
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,69 @@
+#pragma once
+
+namespace otto::dsp {
+
+  /// Portamento: a frequency gliding to its target at a steady rate in octaves
+  ///
+  /// A glide is a closed form exponential ramp, `target * 2^(-step * n)` with `n` frames left,
+  /// so @ref advance moves a whole block on in one step, and the per frame call operator is one
+  /// multiply. Once the target is reached, the value is constant, and costs a branch.
+  ///
+  /// Every glide takes the same time, whatever its interval, in seconds at the samplerate of
+  /// gamma when it starts. The value is kept in double precision, as the per frame ratio is
+  /// multiplied up to a second's worth of frames.
+  struct Glide {
+    /// The time of a glide, in seconds. 0 jumps to each target.
+    void time(float seconds) noexcept
+    {
+      _time = seconds;
+    }
+
+    /// Glide to `freq` from the current value
+    void target(float freq) noexcept;
+
+    /// Jump to `freq`
+    void jump(float freq) noexcept;
+
+    /// The value of the next frame
+    float value() const noexcept
+    {
+      return _value;
+    }
+
+    float target() const noexcept
+    {
+      return _target;
+    }
+
+    bool gliding() const noexcept
+    {
+      return _left > 0;
+    }
+
+    /// The value of the next frame, moving on by one
+    float operator()() noexcept
+    {
+      float res = _value;
+      if (_left > 0) {
+        _value *= _ratio;
+        if (--_left == 0) _value = _target;
+      }
+      return res;
+    }
+
+    /// The value of the next frame, moving on by `nframes`
+    float advance(int nframes) noexcept;
+
+  private:
+    float _time = 0;
+    double _value = 440;
+    float _target = 440.f;
+    /// The octaves per frame of the glide
+    double _step = 0;
+    /// The factor of the value per frame, `2^step`
+    double _ratio = 1;
+    /// The frames left of the glide
+    int _left = 0;
+  };
+
+} // namespace otto::dsp
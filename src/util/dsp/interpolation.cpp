@@ -0,0 +1,32 @@
+#include "interpolation.hpp"
+
+#include <cmath>
+
+namespace otto::dsp::detail {
+
+  namespace {
+    double sinc(double x)
+    {
+      return x == 0 ? 1 : std::sin(M_PI * x) / (M_PI * x);
+    }
+  } // namespace
+
+  const std::array<std::array<float, 4>, sinc_phases + 1> sinc_kernel = [] {
+    std::array<std::array<float, 4>, sinc_phases + 1> res;
+    for (int p = 0; p <= sinc_phases; p++) {
+      double frac = double(p) / sinc_phases;
+      std::array<double, 4> w;
+      double sum = 0;
+      for (int k = 0; k < 4; k++) {
+        // The distance from the position to sample `k - 1`
+        double x = frac - (k - 1);
+        w[k] = sinc(x) * sinc(x / 2);
+        sum += w[k];
+      }
+      // Unity gain at DC
+      for (int k = 0; k < 4; k++) res[p][k] = w[k] / sum;
+    }
+    return res;
+  }();
+
+} // namespace otto::dsp::detail
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <type_traits>
+
+/// The interpolation of the players at full quality. Boards with slow cpus set it to `linear` in
+/// their `config.cmake`.
+#ifndef OTTO_INTERPOLATION
+#define OTTO_INTERPOLATION cubic
+#endif
+
+namespace otto::dsp {
+
+  /// How a player reads a signal between its samples, from the cheapest to the most expensive
+  ///
+  /// Players take the mode at runtime, so it can follow the quality tier picked by the cpu
+  /// governor, and dispatch on it once per block with @ref dispatch_interpolation, so the loop
+  /// over the frames is compiled for each mode.
+  enum struct Interpolation {
+    /// The sample before the position
+    none,
+    /// A line between the two closest samples
+    linear,
+    /// A cubic Hermite spline through the four closest samples
+    cubic,
+    /// A sinc of the four closest samples, with a Lanczos window. Lets through less of the
+    /// images than the spline when pitching up, but rolls off the highs a little more.
+    sinc,
+  };
+
+  constexpr Interpolation default_interpolation = Interpolation::OTTO_INTERPOLATION;
+
+  namespace detail {
+    /// The number of fractions the sinc is tabulated at
+    constexpr int sinc_phases = 256;
+    /// The weights of the four samples around a position, at `sinc_phases + 1` fractions from
+    /// 0 to 1. Each sums to 1.
+    extern const std::array<std::array<float, 4>, sinc_phases + 1> sinc_kernel;
+  } // namespace detail
+
+  /// The value at `frac` of the way from `data[0]` to `data[1]`
+  ///
+  /// Reads from `data[-1]` to `data[2]`, depending on `I`.
+  template<Interpolation I>
+  inline float interpolate(const float* data, float frac) noexcept
+  {
+    if constexpr (I == Interpolation::none) {
+      return data[0];
+    } else if constexpr (I == Interpolation::linear) {
+      return data[0] + (data[1] - data[0]) * frac;
+    } else if constexpr (I == Interpolation::cubic) {
+      float c1 = 0.5f * (data[1] - data[-1]);
+      float c2 = data[-1] - 2.5f * data[0] + 2.f * data[1] - 0.5f * data[2];
+      float c3 = 0.5f * (data[2] - data[-1]) + 1.5f * (data[0] - data[1]);
+      return data[0] + ((c3 * frac + c2) * frac + c1) * frac;
+    } else {
+      auto& w = detail::sinc_kernel[int(frac * detail::sinc_phases + 0.5f)];
+      return w[0] * data[-1] + w[1] * data[0] + w[2] * data[1] + w[3] * data[2];
+    }
+  }
+
+  /// Call `f` with `std::integral_constant<Interpolation, I>` for `I == mode`
+  ///
+  /// ```cpp
+  /// dispatch_interpolation(mode, [&](auto ipl) {
+  ///   for (auto& frm : buffer) frm = interpolate<ipl>(data + index, frac);
+  /// });
+  /// ```
+  template<typename F>
+  decltype(auto) dispatch_interpolation(Interpolation mode, F&& f)
+  {
+    using I = Interpolation;
+    switch (mode) {
+    case I::none: return f(std::integral_constant<I, I::none>());
+    case I::linear: return f(std::integral_constant<I, I::linear>());
+    case I::cubic: return f(std::integral_constant<I, I::cubic>());
+    case I::sinc: break;
+    }
+    return f(std::integral_constant<I, I::sinc>());
+  }
+
+} // namespace otto::dsp
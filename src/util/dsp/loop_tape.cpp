@@ -0,0 +1,258 @@
+#include "loop_tape.hpp"
+
+#include <algorithm>
+
+namespace otto::dsp {
+
+  LoopTape::LoopTape(int capacity, bool huge_pages, util::Arena* arena)
+    : _capacity(capacity),
+      _memory(std::size_t(capacity) * 2 * _layers.size() * sizeof(float), huge_pages),
+      _stretch(arena)
+  {
+    int bins = (capacity + summary_bin - 1) / summary_bin;
+    for (std::size_t i = 0; i < _layers.size(); i++) {
+      _layers[i].left = static_cast<float*>(_memory.data()) + 2 * i * capacity;
+      _layers[i].right = _layers[i].left + capacity;
+      _layers[i].summary = std::make_unique<AtomicPeak[]>(bins);
+    }
+  }
+
+  void LoopTape::record() noexcept
+  {
+    _commands.push(Command::record);
+  }
+
+  void LoopTape::play() noexcept
+  {
+    _commands.push(Command::play);
+  }
+
+  void LoopTape::undo() noexcept
+  {
+    _commands.push(Command::undo);
+  }
+
+  void LoopTape::clear() noexcept
+  {
+    _commands.push(Command::clear);
+  }
+
+  LoopTape::Peak LoopTape::summary(int bin) const noexcept
+  {
+    auto& peak = _layers[_published.layer.load(std::memory_order_relaxed)].summary[bin];
+    return {peak.min.load(std::memory_order_relaxed), peak.max.load(std::memory_order_relaxed)};
+  }
+
+  void LoopTape::apply(Command cmd) noexcept
+  {
+    switch (cmd) {
+    case Command::record:
+      switch (_state) {
+      case State::empty:
+        _state = State::recording;
+        _pos = 0;
+        _length = 0;
+        _pass_start = 0;
+        _has_previous = false;
+        break;
+      case State::recording:
+        close_loop();
+        if (_length > 0) _state = State::playing;
+        break;
+      case State::playing: [[fallthrough]];
+      case State::stopped:
+        // Continue a pass that is still being copied, as the frames from here to the end of
+        // it hold nothing but the playing layer yet
+        if (!_pass) start_pass();
+        _pass_pos = _pos;
+        _state = State::overdubbing;
+        break;
+      case State::overdubbing:
+        end_overdub();
+        _state = State::playing;
+        break;
+      }
+      break;
+    case Command::play:
+      switch (_state) {
+      case State::empty: break;
+      case State::recording:
+        close_loop();
+        if (_length > 0) _state = State::stopped;
+        break;
+      case State::stopped: _state = State::playing; break;
+      case State::playing: _state = State::stopped; break;
+      case State::overdubbing:
+        end_overdub();
+        _state = State::stopped;
+        break;
+      }
+      break;
+    case Command::undo:
+      if (_pass) {
+        cancel_pass();
+        if (_state == State::overdubbing) _state = State::playing;
+      } else if (_has_previous) {
+        std::swap(_playing, _previous);
+      }
+      break;
+    case Command::clear:
+      cancel_pass();
+      _state = State::empty;
+      _length = 0;
+      _pos = 0;
+      _has_previous = false;
+      break;
+    }
+  }
+
+  void LoopTape::close_loop() noexcept
+  {
+    _length = _pos;
+    _pos = 0;
+    if (_length == 0) _state = State::empty;
+  }
+
+  void LoopTape::start_pass() noexcept
+  {
+    _pass = true;
+    _pass_start = _pos;
+    _pass_pos = _pos;
+  }
+
+  void LoopTape::complete_pass() noexcept
+  {
+    // The layer before the previous one is dropped, and its memory used for the next overdub
+    int dropped = _previous;
+    _previous = _playing;
+    _playing = _overdub;
+    _overdub = dropped;
+    _has_previous = true;
+    _pass = false;
+  }
+
+  void LoopTape::end_overdub() noexcept
+  {
+    // A pass that has just started holds nothing new, and would only take the place of the
+    // layer to undo to
+    if (_pass_pos == _pass_start) cancel_pass();
+  }
+
+  void LoopTape::cancel_pass() noexcept
+  {
+    _pass = false;
+  }
+
+  void LoopTape::write(Layer& layer, int pos, float left, float right) noexcept
+  {
+    layer.left[pos] = left;
+    layer.right[pos] = right;
+    auto& peak = layer.summary[pos / summary_bin];
+    float lo = std::min(left, right);
+    float hi = std::max(left, right);
+    // A bin is restarted where the pass starts, and at its first frame, unless the pass
+    // started inside it, and the frames before that are the end of the pass
+    bool restart = pos == _pass_start ||
+                   (pos % summary_bin == 0 && pos / summary_bin != _pass_start / summary_bin);
+    if (!restart) {
+      lo = std::min(lo, peak.min.load(std::memory_order_relaxed));
+      hi = std::max(hi, peak.max.load(std::memory_order_relaxed));
+    }
+    peak.min.store(lo, std::memory_order_relaxed);
+    peak.max.store(hi, std::memory_order_relaxed);
+  }
+
+  void LoopTape::process(gsl::span<const float> in_left,
+                         gsl::span<const float> in_right,
+                         gsl::span<float> out_left,
+                         gsl::span<float> out_right) noexcept
+  {
+    _commands.consume([this](Command cmd) {
+      apply(cmd);
+      return true;
+    });
+
+    const int nframes = in_left.size();
+    bool stretch = _state == State::playing && _speed != 1;
+    if (stretch) {
+      play_stretched(out_left, out_right);
+    } else {
+      _stretching = false;
+    }
+    for (int f = 0; f < nframes && !stretch; f++) {
+      switch (_state) {
+      case State::empty: [[fallthrough]];
+      case State::stopped:
+        out_left[f] = 0;
+        out_right[f] = 0;
+        break;
+      case State::recording:
+        write(_layers[_playing], _pos, in_left[f], in_right[f]);
+        out_left[f] = 0;
+        out_right[f] = 0;
+        _pos++;
+        if (_pos == _capacity) {
+          close_loop();
+          _state = State::playing;
+        }
+        break;
+      case State::playing: [[fallthrough]];
+      case State::overdubbing: {
+        auto& playing = _layers[_playing];
+        float l = playing.left[_pos];
+        float r = playing.right[_pos];
+        out_left[f] = l;
+        out_right[f] = r;
+        if (_state == State::overdubbing) {
+          write(_layers[_overdub], _pos, l + in_left[f], r + in_right[f]);
+        }
+        _pos = _pos + 1 == _length ? 0 : _pos + 1;
+        if (_state == State::overdubbing) {
+          _pass_pos = _pos;
+          if (_pos == _pass_start) {
+            complete_pass();
+            start_pass();
+          }
+        }
+        break;
+      }
+      }
+    }
+
+    // Copy the rest of a pass the overdub ended part way through
+    if (_pass && _state != State::overdubbing) {
+      auto& playing = _layers[_playing];
+      auto& overdub = _layers[_overdub];
+      for (int i = 0; i < finish_rate * nframes; i++) {
+        write(overdub, _pass_pos, playing.left[_pass_pos], playing.right[_pass_pos]);
+        _pass_pos = _pass_pos + 1 == _length ? 0 : _pass_pos + 1;
+        if (_pass_pos == _pass_start) {
+          complete_pass();
+          break;
+        }
+      }
+    }
+
+    publish();
+  }
+
+  void LoopTape::play_stretched(gsl::span<float> out_left, gsl::span<float> out_right) noexcept
+  {
+    // Starts where the tape is, and the tape continues from where the stretcher is
+    if (!_stretching) _stretch.reset(_pos);
+    _stretching = true;
+    auto& playing = _layers[_playing];
+    _stretch.process({playing.left, _length}, {playing.right, _length}, _speed, out_left, out_right);
+    _pos = std::min(static_cast<int>(_stretch.position()), _length - 1);
+  }
+
+  void LoopTape::publish() noexcept
+  {
+    _published.state.store(_state, std::memory_order_relaxed);
+    _published.length.store(_state == State::recording ? _pos : _length, std::memory_order_relaxed);
+    _published.position.store(_pos, std::memory_order_relaxed);
+    _published.layer.store(_playing, std::memory_order_relaxed);
+    _published.can_undo.store(_pass || _has_previous, std::memory_order_relaxed);
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include <gsl/span>
+
+#include "util/arena.hpp"
+#include "util/audio.hpp"
+#include "util/dsp/time_stretch.hpp"
+#include "util/mpsc_queue.hpp"
+#include "util/page_memory.hpp"
+
+namespace otto::dsp {
+
+  /// The tape of a stereo loop station, with overdub and one level of undo
+  ///
+  /// The tape holds three layers: the one playing, the one before it, kept for undo, and the
+  /// one an overdub is written to. An overdub pass writes the playing layer plus the input to
+  /// the overdub layer, frame by frame, as the loop plays. When the pass has gone round the
+  /// whole loop, the layers are swapped, so recording, overdubbing and undo never copy a
+  /// layer at once. When an overdub ends part way, the rest of the pass is copied a few times
+  /// faster than the loop plays, so it is done before the loop comes round to it.
+  ///
+  /// While playing, the loop can play at another speed, time stretched to keep its pitch, so it
+  /// follows the tempo. Overdubs are always at the speed the loop was recorded, so the input
+  /// lines up with the frames of the tape.
+  ///
+  /// The controls are safe to call from any thread, and are queued for the audio thread.
+  /// The state, the position and the waveform summary are published lock free for the UI.
+  struct LoopTape {
+    enum struct State {
+      /// Nothing recorded
+      empty,
+      /// Recording the first layer, which sets the length of the loop
+      recording,
+      playing,
+      overdubbing,
+      /// Paused where it was
+      stopped,
+    };
+
+    /// The minimum and maximum of a bin of frames, over both channels
+    struct Peak {
+      float min = 0;
+      float max = 0;
+    };
+
+    /// The number of frames summarised by each @ref Peak
+    static constexpr int summary_bin = 512;
+
+    /// \param capacity The longest loop, in frames
+    /// \param huge_pages Whether to try to map the tape from huge pages
+    /// \param arena Allocate the buffers of the time stretcher from this arena, if given
+    LoopTape(int capacity, bool huge_pages = true, util::Arena* arena = nullptr);
+
+    /// Start recording when empty, close the loop when recording, and otherwise start or end
+    /// an overdub
+    void record() noexcept;
+    /// Stop, or start playing. Closes the loop when recording.
+    void play() noexcept;
+    /// Cancel the overdub in progress, or swap the playing layer with the one before it.
+    /// Undoing twice is a redo.
+    void undo() noexcept;
+    /// Erase the loop
+    void clear() noexcept;
+
+    /// Play at `speed` times the speed the loop was recorded, from the next block
+    ///
+    /// Only to be called from the audio thread. Speeds other than one are time stretched.
+    void speed(float speed) noexcept
+    {
+      _speed = speed;
+    }
+
+    /// The quality of the time stretching, from the audio thread
+    void stretch_quality(TimeStretch::Quality quality) noexcept
+    {
+      _stretch.quality(quality);
+    }
+
+    /// Record and play a block, at the frame rate of the input
+    ///
+    /// `out_left` and `out_right` are set to the loop only, not the input.
+    void process(gsl::span<const float> in_left,
+                 gsl::span<const float> in_right,
+                 gsl::span<float> out_left,
+                 gsl::span<float> out_right) noexcept;
+
+    int capacity() const noexcept
+    {
+      return _capacity;
+    }
+
+    State state() const noexcept
+    {
+      return _published.state.load(std::memory_order_relaxed);
+    }
+
+    /// The frames of the loop. While recording, the frames recorded so far.
+    util::audio::Section<int> loop() const noexcept
+    {
+      return {0, _published.length.load(std::memory_order_relaxed)};
+    }
+
+    /// The frame being played or recorded
+    int position() const noexcept
+    {
+      return _published.position.load(std::memory_order_relaxed);
+    }
+
+    /// Whether there is a layer to undo to
+    bool can_undo() const noexcept
+    {
+      return _published.can_undo.load(std::memory_order_relaxed);
+    }
+
+    /// The number of summary bins covering the loop
+    int summary_size() const noexcept
+    {
+      return (loop().size() + summary_bin - 1) / summary_bin;
+    }
+
+    /// The peaks of bin `bin` of the playing layer
+    ///
+    /// Kept up to date as the layer is written, so the UI never reads the tape itself.
+    Peak summary(int bin) const noexcept;
+
+  private:
+    enum struct Command { record, play, undo, clear };
+
+    struct AtomicPeak {
+      std::atomic<float> min = 0;
+      std::atomic<float> max = 0;
+    };
+
+    struct Layer {
+      float* left;
+      float* right;
+      std::unique_ptr<AtomicPeak[]> summary;
+    };
+
+    /// The number of frames of the rest of a pass copied for each frame played
+    static constexpr int finish_rate = 8;
+
+    void apply(Command cmd) noexcept;
+    void close_loop() noexcept;
+    void start_pass() noexcept;
+    void complete_pass() noexcept;
+    void end_overdub() noexcept;
+    void cancel_pass() noexcept;
+    /// Write a frame to a layer, and extend its summary
+    void write(Layer& layer, int pos, float left, float right) noexcept;
+    /// Play a block of the playing layer through the time stretcher
+    void play_stretched(gsl::span<float> out_left, gsl::span<float> out_right) noexcept;
+    void publish() noexcept;
+
+    int _capacity;
+    util::PageMemory _memory;
+    std::array<Layer, 3> _layers;
+
+    util::MPSCQueue<Command, 16> _commands;
+
+    // Only used by the audio thread
+    State _state = State::empty;
+    int _length = 0;
+    int _pos = 0;
+    int _playing = 0;
+    int _previous = 1;
+    int _overdub = 2;
+    bool _has_previous = false;
+    /// Whether a pass is writing the overdub layer
+    bool _pass = false;
+    int _pass_start = 0;
+    /// The next frame of the pass to copy, once the overdub has ended
+    int _pass_pos = 0;
+    float _speed = 1;
+    TimeStretch _stretch;
+    /// Whether the last block was played by @ref _stretch
+    bool _stretching = false;
+
+    struct {
+      std::atomic<State> state = State::empty;
+      std::atomic<int> length = 0;
+      std::atomic<int> position = 0;
+      std::atomic<int> layer = 0;
+      std::atomic<bool> can_undo = false;
+    } _published;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,110 @@
+#include "modulated_delay.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  namespace {
+    constexpr int sine_size = 1024;
+
+    /// One cycle of a sine, with a guard sample
+    const std::array<float, sine_size + 1>& sine()
+    {
+      static const std::array<float, sine_size + 1> table = [] {
+        std::array<float, sine_size + 1> res;
+        for (int i = 0; i <= sine_size; i++) res[i] = std::sin(2 * M_PI * i / sine_size);
+        return res;
+      }();
+      return table;
+    }
+  } // namespace
+
+  float table_sine(float phase) noexcept
+  {
+    auto& table = sine();
+    float pos = (phase - std::floor(phase)) * sine_size;
+    int index = pos;
+    float frac = pos - index;
+    return table[index] + (table[index + 1] - table[index]) * frac;
+  }
+
+  ModulatedDelay::ModulatedDelay() : _buffer(buffer_size, 0.f) {}
+
+  void ModulatedDelay::taps(int taps) noexcept
+  {
+    _taps = std::clamp(taps, 1, max_taps);
+  }
+
+  void ModulatedDelay::delay(float seconds) noexcept
+  {
+    _delay = seconds;
+  }
+
+  void ModulatedDelay::freq(float hz) noexcept
+  {
+    _freq = hz;
+  }
+
+  void ModulatedDelay::feedback(float fbk) noexcept
+  {
+    _feedback = fbk;
+  }
+
+  void ModulatedDelay::process(gsl::span<const float> input,
+                               gsl::span<const float> depth,
+                               gsl::span<float> left,
+                               gsl::span<float> right) noexcept
+  {
+    const float samplerate = gam::sampleRate();
+    const double increment = _freq / samplerate;
+    const int taps = _taps;
+    const float feedback = _feedback;
+    const bool held = _held;
+    // The taps alternate sides. A single tap plays on both.
+    const int left_taps = (taps + 1) / 2;
+    const int right_taps = taps / 2;
+    const float left_gain = 1.f / left_taps;
+    const float right_gain = right_taps > 0 ? 1.f / right_taps : 0.f;
+    constexpr float max_delay = buffer_size - max_chunk - 2;
+
+    for (int done = 0; done < input.size();) {
+      int chunk = std::min<int>(max_chunk, input.size() - done);
+
+      for (int t = 0; t < taps; t++) {
+        double offset = _phase + 0.5 * t / taps;
+        auto& delays = _delays[t];
+        for (int f = 0; f < chunk; f++) {
+          float lfo = table_sine(offset + f * increment);
+          delays[f] = std::clamp((_delay + depth[done + f] * lfo) * samplerate, 1.f, max_delay);
+        }
+      }
+
+      if (feedback == 0 && !held) {
+        for (int f = 0; f < chunk; f++) _buffer[(_write + f) & mask] = input[done + f];
+      }
+      for (int f = 0; f < chunk; f++) {
+        float l = 0;
+        float r = 0;
+        for (int t = 0; t < taps; t++) {
+          float tap = read(_write + f, _delays[t][f]);
+          (t % 2 == 0 ? l : r) += tap;
+        }
+        l *= left_gain;
+        r = right_taps > 0 ? r * right_gain : l;
+        float in = input[done + f];
+        if (feedback != 0 && !held) _buffer[(_write + f) & mask] = in + feedback * 0.5f * (l + r);
+        left[done + f] = in + l;
+        right[done + f] = in + r;
+      }
+
+      _write = (_write + chunk) & mask;
+      _phase += chunk * increment;
+      _phase -= std::floor(_phase);
+      done += chunk;
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <gsl/span>
+
+namespace otto::dsp {
+
+  /// `sin(2 pi phase)`, from a table shared by all LFOs
+  ///
+  /// Only the fractional part of `phase` is used.
+  float table_sine(float phase) noexcept;
+
+  /// A delay line read by several taps, each modulated by its own phase of a shared LFO
+  ///
+  /// With two taps, it is a stereo chorus. With more, an ensemble, and with short delays, a
+  /// flanger. The taps alternate between the left and right outputs, and their LFO phases are
+  /// spread over half a cycle, so two taps are in quadrature.
+  ///
+  /// The modulated delays of all taps are computed from the sine table for a whole chunk, before
+  /// the delay line is read. Without feedback, the chunk of input is then written at once, and
+  /// each tap reads its frames in one pass.
+  struct ModulatedDelay {
+    static constexpr int max_taps = 8;
+
+    /// Allocates the delay line
+    ModulatedDelay();
+
+    /// Set the number of taps, from 1 to `max_taps`
+    void taps(int taps) noexcept;
+    int taps() const noexcept
+    {
+      return _taps;
+    }
+
+    /// Set the delay around which the taps are modulated, in seconds
+    void delay(float seconds) noexcept;
+    /// Set the LFO frequency in Hz
+    void freq(float hz) noexcept;
+    /// Set the amount of the wet signal fed back into the line, from 0 to below 1
+    void feedback(float fbk) noexcept;
+
+    /// Stop writing to the line, so the taps keep playing its last `buffer_size` frames in a
+    /// loop, while the dry signal passes through
+    void hold(bool held) noexcept
+    {
+      _held = held;
+    }
+
+    bool held() const noexcept
+    {
+      return _held;
+    }
+
+    /// The phase of the LFO, from 0 to 1
+    double phase() const noexcept
+    {
+      return _phase;
+    }
+
+    /// Process `input` into `left` and `right`, at the samplerate of gamma
+    ///
+    /// The outputs are the dry signal plus the taps of each side. `depth` is the modulation
+    /// depth of each frame, in seconds.
+    void process(gsl::span<const float> input,
+                 gsl::span<const float> depth,
+                 gsl::span<float> left,
+                 gsl::span<float> right) noexcept;
+
+    /// The length of the line, in frames
+    static constexpr int buffer_size = 1 << 13;
+
+  private:
+    static constexpr int mask = buffer_size - 1;
+    static constexpr int max_chunk = 64;
+
+    /// Read the line `delay` frames before `frame`, with linear interpolation
+    float read(int frame, float delay) const noexcept
+    {
+      float pos = frame - delay;
+      int index = pos;
+      if (pos < index) index--;
+      float frac = pos - index;
+      float a = _buffer[index & mask];
+      float b = _buffer[(index + 1) & mask];
+      return a + (b - a) * frac;
+    }
+
+    std::vector<float> _buffer;
+    int _write = 0;
+    int _taps = 2;
+    float _delay = 0.0021;
+    float _freq = 1;
+    float _feedback = 0;
+    double _phase = 0;
+    bool _held = false;
+    /// The delay of each tap for each frame of the chunk, in frames
+    std::array<std::array<float, max_chunk>, max_taps> _delays;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,45 @@
+#include "output_guard.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  namespace {
+    /// `x` bounded to `OutputGuard::max_input`, or 0 if it is not finite, counted in `scrubbed`
+    float scrub(float x, int& scrubbed) noexcept
+    {
+      const bool finite = std::isfinite(x);
+      scrubbed += !finite;
+      return finite ? std::clamp(x, -OutputGuard::max_input, OutputGuard::max_input) : 0.f;
+    }
+  } // namespace
+
+  void OutputGuard::process(gsl::span<float> left, gsl::span<float> right) noexcept
+  {
+    if (_samplerate != gam::sampleRate()) {
+      _samplerate = gam::sampleRate();
+      _pole = std::exp(-2 * M_PI * dc_cutoff / _samplerate);
+    }
+
+    int scrubbed = 0;
+    float in_l = _last_in[0], in_r = _last_in[1];
+    float out_l = _last_out[0], out_r = _last_out[1];
+    for (int f = 0; f < left.size(); f++) {
+      float l = scrub(left[f], scrubbed);
+      float r = scrub(right[f], scrubbed);
+      out_l = l - in_l + _pole * out_l;
+      out_r = r - in_r + _pole * out_r;
+      in_l = l;
+      in_r = r;
+      left[f] = std::clamp(out_l, -1.f, 1.f);
+      right[f] = std::clamp(out_r, -1.f, 1.f);
+    }
+    _last_in = {in_l, in_r};
+    _last_out = {out_l, out_r};
+    if (scrubbed > 0) _scrubbed.fetch_add(scrubbed, std::memory_order_relaxed);
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include <gsl/span>
+
+namespace otto::dsp {
+
+  /// The last stage before the DAC, which guarantees a playable signal whatever the engines do
+  ///
+  /// One pass over both channels, in place, which for each sample
+  ///
+  ///  - replaces NaNs and infinities with silence, and bounds the rest to @ref max_input,
+  ///  - removes DC with a one-pole highpass at @ref dc_cutoff,
+  ///  - clips to full scale.
+  ///
+  /// The master dynamics shape the level before this, so on a healthy signal the clipper never
+  /// acts. It is for the feedback paths that run away, where a burst of full scale is better
+  /// than a PA fed with NaNs. The DC blocker is recursive, so each channel is a serial chain,
+  /// and the pass is branch free instead, with both channels in the same loop.
+  struct OutputGuard {
+    /// The cutoff of the DC blocker, in Hz
+    static constexpr float dc_cutoff = 5;
+    /// The largest input, so the DC blocker stays finite
+    static constexpr float max_input = 16;
+
+    /// Process a block of both channels in place, at the samplerate of gamma
+    void process(gsl::span<float> left, gsl::span<float> right) noexcept;
+
+    /// The number of NaNs and infinities replaced since the last call, and reset it
+    ///
+    /// Lock free, to be read by any thread.
+    std::size_t take_scrubbed() noexcept
+    {
+      return _scrubbed.exchange(0, std::memory_order_relaxed);
+    }
+
+  private:
+    double _samplerate = 0;
+    /// The pole of the DC blocker
+    float _pole = 1;
+    /// The last input and output of the DC blocker, of each channel
+    std::array<float, 2> _last_in = {};
+    std::array<float, 2> _last_out = {};
+    std::atomic<std::size_t> _scrubbed = 0;
+  };
+
+} // namespace otto::dsp
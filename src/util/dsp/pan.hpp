@@ -36,6 +36,16 @@ struct PanSM {
     w2 *= vol2;
   }
 
+  /// The weights of the two inputs
+  float weight1() const
+  {
+    return w1;
+  }
+  float weight2() const
+  {
+    return w2;
+  }
+
   void volume1(float v) {
     vol1 = v;
   }
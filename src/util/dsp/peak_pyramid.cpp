@@ -0,0 +1,71 @@
+#include "peak_pyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace otto::dsp {
+
+  PeakPyramid::Peak& PeakPyramid::Peak::operator+=(const Peak& rhs) noexcept
+  {
+    if (rhs.count == 0) return *this;
+    if (count == 0) return *this = rhs;
+    min = std::min(min, rhs.min);
+    max = std::max(max, rhs.max);
+    abs_sum += rhs.abs_sum;
+    count += rhs.count;
+    return *this;
+  }
+
+  void PeakPyramid::append(gsl::span<const float> samples)
+  {
+    if (samples.empty()) return;
+    if (_levels.empty()) _levels.emplace_back();
+    auto& base = _levels[0];
+    int first = _size / base_block;
+    for (float s : samples) {
+      int block = _size / base_block;
+      if (block == base.size()) base.emplace_back();
+      base[block] += {s, s, std::abs(s), 1};
+      _size++;
+    }
+    update_parents(first, base.size());
+  }
+
+  void PeakPyramid::update_parents(int first, int last)
+  {
+    for (std::size_t level = 1; _levels[level - 1].size() > 1; level++) {
+      if (_levels.size() == level) _levels.emplace_back();
+      auto& children = _levels[level - 1];
+      auto& parents = _levels[level];
+      parents.resize((children.size() + 1) / 2);
+      first = first / 2;
+      last = (last - 1) / 2 + 1;
+      for (int i = first; i < last; i++) {
+        parents[i] = children[2 * i];
+        if (2 * i + 1 < children.size()) parents[i] += children[2 * i + 1];
+      }
+    }
+  }
+
+  void PeakPyramid::clear() noexcept
+  {
+    for (auto& level : _levels) level.clear();
+    _size = 0;
+  }
+
+  PeakPyramid::Peak PeakPyramid::peak(int first, int last) const noexcept
+  {
+    first = std::max(first, 0);
+    last = std::min(last, _size);
+    Peak res;
+    if (first >= last) return res;
+    int i = first / base_block;
+    int j = (last + base_block - 1) / base_block;
+    for (int level = 0; i < j; level++, i /= 2, j /= 2) {
+      if (i % 2 == 1) res += _levels[level][i++];
+      if (j % 2 == 1) res += _levels[level][--j];
+    }
+    return res;
+  }
+
+} // namespace otto::dsp
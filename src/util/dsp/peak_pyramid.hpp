@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include <gsl/span>
+
+namespace otto::dsp {
+
+  /// Peaks of a growing signal over every power of two block size
+  ///
+  /// Level `k` holds the peaks of each block of `base_block << k` samples. Appending samples
+  /// updates the blocks they fall in, and their parents, so keeping the pyramid up to date
+  /// as audio is recorded costs about one update per base block. Any range is then summed
+  /// from at most two blocks of each level, so a waveform display costs `O(log n)` per pixel,
+  /// at any zoom.
+  ///
+  /// Ranges are rounded out to whole base blocks. Below that, read the samples themselves.
+  struct PeakPyramid {
+    /// The number of samples in each block of the lowest level
+    static constexpr int base_block = 16;
+
+    /// The peaks of a range of samples
+    struct Peak {
+      float min = 0;
+      float max = 0;
+      /// The sum of the absolute values
+      float abs_sum = 0;
+      /// The number of samples
+      int count = 0;
+
+      float average_abs() const noexcept
+      {
+        return count > 0 ? abs_sum / count : 0.f;
+      }
+
+      /// Include the samples of `rhs`
+      Peak& operator+=(const Peak& rhs) noexcept;
+    };
+
+    /// Add samples to the end
+    void append(gsl::span<const float> samples);
+
+    /// Remove all samples, keeping the memory
+    void clear() noexcept;
+
+    /// The number of samples appended
+    int size() const noexcept
+    {
+      return _size;
+    }
+
+    /// The peaks of the samples in `[first, last)`, rounded out to base blocks, and clamped to
+    /// the samples appended
+    Peak peak(int first, int last) const noexcept;
+
+  private:
+    /// Recompute the blocks of levels above the lowest covering blocks `[first, last)` of
+    /// the lowest level
+    void update_parents(int first, int last);
+
+    std::vector<std::vector<Peak>> _levels;
+    int _size = 0;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,68 @@
+#include "pitch_shift.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/dsp/window.hpp"
+
+namespace otto::dsp {
+
+  GrainPitchShift::GrainPitchShift(int grain, util::Arena* arena)
+    : _window(window_size + 1, 0.f, arena), _buffer(buffer_size(grain), 0.f, arena), _grain(grain)
+  {
+    // A symmetric window of `window_size + 1` samples is periodic over the first `window_size`
+    std::vector<double> window(window_size + 1);
+    util::dsp::Window::compute(window, util::dsp::Window::hann, false);
+    std::copy(window.begin(), window.end(), _window.begin());
+
+    _mask = _buffer.size() - 1;
+    ratio(2);
+  }
+
+  void GrainPitchShift::ratio(float ratio) noexcept
+  {
+    _increment = (ratio - 1.0) / _grain;
+  }
+
+  void GrainPitchShift::process(gsl::span<const float> input, gsl::span<float> output) noexcept
+  {
+    // The buffer holds a grain of history, plus up to a grain of new input
+    if (input.size() > _grain) {
+      for (int i = 0; i < input.size(); i += _grain) {
+        int n = std::min<int>(_grain, input.size() - i);
+        process(input.subspan(i, n), output.subspan(i, n));
+      }
+      return;
+    }
+
+    // Write the block first, so the grains can read up to the current frame
+    for (int f = 0; f < input.size(); f++) _buffer[(_write + f) & _mask] = input[f];
+
+    for (int f = 0; f < input.size(); f++) {
+      float sum = 0;
+      for (double offset : {0.0, 0.5}) {
+        double phase = _phase + offset;
+        phase -= std::floor(phase);
+
+        // The delay sweeps from a grain to nothing as the phase goes from 0 to 1
+        double pos = _write + f - _grain * (1 - phase);
+        int index = std::floor(pos);
+        float frac = pos - index;
+        float a = _buffer[index & _mask];
+        float b = _buffer[(index + 1) & _mask];
+
+        float wpos = phase * window_size;
+        int windex = wpos;
+        float wfrac = wpos - windex;
+        float gain = _window[windex] + (_window[windex + 1] - _window[windex]) * wfrac;
+
+        sum += (a + (b - a) * frac) * gain;
+      }
+      output[f] = sum;
+      _phase += _increment;
+      _phase -= std::floor(_phase);
+    }
+    _write = (_write + input.size()) & _mask;
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include <gsl/span>
+
+#include "util/arena.hpp"
+
+namespace otto::dsp {
+
+  /// An overlap-add pitch shifter
+  ///
+  /// Two grains read the input back from a delay line, at `ratio` times its speed. Each grain
+  /// restarts once its delay has swept the grain length, and is faded in and out by a Hann
+  /// window. The grains are half a grain apart, so their windows sum to one.
+  ///
+  /// The window is computed once, and the delay line is a power-of-two buffer, so a frame costs
+  /// two interpolated reads and two table lookups.
+  struct GrainPitchShift {
+    static constexpr int default_grain = 4096;
+
+    /// \param grain The length of the grains in samples
+    /// \param arena Allocate the window and delay line from this arena, if given
+    GrainPitchShift(int grain = default_grain, util::Arena* arena = nullptr);
+
+    /// The number of bytes allocated by the constructor with grains of `grain` samples, for
+    /// sizing an arena
+    static constexpr std::size_t memory_size(int grain) noexcept
+    {
+      return (window_size + 1 + buffer_size(grain)) * sizeof(float);
+    }
+
+    /// Set the ratio of the output frequency to the input frequency. 2 is an octave up.
+    void ratio(float ratio) noexcept;
+
+    /// Shift `input` into `output`. They may be the same buffer.
+    void process(gsl::span<const float> input, gsl::span<float> output) noexcept;
+
+    /// Shift a single sample
+    float operator()(float in) noexcept
+    {
+      float out;
+      process({&in, 1}, {&out, 1});
+      return out;
+    }
+
+  private:
+    /// The number of samples in the window table, not counting the guard sample
+    static constexpr int window_size = 1024;
+
+    /// The size of the delay line, the smallest power of two that holds two grains
+    static constexpr int buffer_size(int grain) noexcept
+    {
+      int size = 1;
+      while (size < 2 * grain + 2) size *= 2;
+      return size;
+    }
+
+    util::ArenaVector<float> _window;
+    util::ArenaVector<float> _buffer;
+    int _mask;
+    int _write = 0;
+    int _grain;
+    /// The position in the grain period, from 0 to 1
+    double _phase = 0;
+    double _increment = 0;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,93 @@
+#include "resampler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "util/exception.hpp"
+
+namespace otto::dsp {
+
+  namespace {
+    /// The modified Bessel function of the first kind, of order 0
+    double bessel_i0(double x)
+    {
+      double sum = 1;
+      double term = 1;
+      for (int k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+      }
+      return sum;
+    }
+
+    constexpr int table_size = Resampler::zero_crossings * Resampler::phases;
+
+    /// One side of the windowed sinc, from 0 to `zero_crossings`, followed by a zero so the
+    /// interpolation does not need to check the end
+    const std::array<float, table_size + 2>& kernel()
+    {
+      static const auto table = [] {
+        constexpr double beta = 8;
+        std::array<float, table_size + 2> res = {};
+        for (int k = 0; k <= table_size; k++) {
+          double x = double(k) / Resampler::phases;
+          double sinc = k == 0 ? 1 : std::sin(M_PI * x) / (M_PI * x);
+          double ratio = x / Resampler::zero_crossings;
+          double window = bessel_i0(beta * std::sqrt(std::max(0., 1 - ratio * ratio))) / bessel_i0(beta);
+          res[k] = float(sinc * window);
+        }
+        return res;
+      }();
+      return table;
+    }
+  } // namespace
+
+  Resampler::Resampler(int from, int to) : _ratio(double(from) / to), _scale(cutoff * std::min(1., 1. / _ratio))
+  {
+    if (from <= 0 || to <= 0) throw util::exception("Resampler: Invalid samplerates {} and {}", from, to);
+  }
+
+  int Resampler::radius() const noexcept
+  {
+    return std::ceil(zero_crossings / _scale);
+  }
+
+  long Resampler::output_frames(long frames) const noexcept
+  {
+    return std::ceil(frames / _ratio);
+  }
+
+  void Resampler::process(gsl::span<const float> input, double position, gsl::span<float> output) const noexcept
+  {
+    auto& table = kernel();
+    const long size = input.size();
+    const double reach = zero_crossings / _scale;
+    // The kernel is indexed in steps of `1 / phases` zero crossings
+    const double step = _scale * phases;
+    for (std::size_t i = 0; i < output.size(); i++) {
+      const double pos = position + i * _ratio;
+      const long first = std::max<long>(std::ceil(pos - reach), 0);
+      const long last = std::min<long>(std::floor(pos + reach), size - 1);
+      double sum = 0;
+      for (long j = first; j <= last; j++) {
+        double x = std::abs(pos - j) * step;
+        int index = x;
+        if (index >= table_size) continue;
+        float frac = x - index;
+        sum += input[j] * (table[index] + (table[index + 1] - table[index]) * frac);
+      }
+      output[i] = sum * _scale;
+    }
+  }
+
+  std::vector<float> Resampler::resample(gsl::span<const float> input, int from, int to)
+  {
+    if (from == to) return {input.begin(), input.end()};
+    Resampler resampler(from, to);
+    std::vector<float> res(resampler.output_frames(input.size()));
+    resampler.process(input, 0, res);
+    return res;
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include <gsl/span>
+
+namespace otto::dsp {
+
+  /// Changes the samplerate of a signal, with a Kaiser windowed sinc
+  ///
+  /// Meant for assets, which are resampled once to the samplerate of the device when they are
+  /// loaded, so they play back without interpolation at their original pitch. The filter spans
+  /// @ref zero_crossings zero crossings on each side, with about 80 dB of stopband attenuation.
+  /// Its cutoff is at @ref cutoff of the lower of the two nyquist frequencies, so when going
+  /// down in samplerate, the filter is stretched to remove what would alias.
+  ///
+  /// The kernel is tabulated at @ref phases points per zero crossing, and interpolated linearly,
+  /// so any ratio of samplerates can be used.
+  struct Resampler {
+    static constexpr int zero_crossings = 32;
+    static constexpr int phases = 512;
+    /// The cutoff, relative to the lower nyquist frequency. The response is flat to about 0.85,
+    /// and the stopband starts at about 1.
+    static constexpr double cutoff = 0.92;
+
+    /// Convert from `from` Hz to `to` Hz
+    Resampler(int from, int to);
+
+    /// The input frames per output frame
+    double ratio() const noexcept
+    {
+      return _ratio;
+    }
+
+    /// The number of input frames on each side of a position that its output depends on
+    int radius() const noexcept;
+
+    /// The number of output frames of an input of `frames` frames
+    long output_frames(long frames) const noexcept;
+
+    /// Compute `output.size()` frames, the first at `position` frames into `input`, and each
+    /// following one @ref ratio frames later. Frames outside of `input` read as silence.
+    void process(gsl::span<const float> input, double position, gsl::span<float> output) const noexcept;
+
+    /// Resample a whole signal from `from` Hz to `to` Hz. A copy if the rates are the same.
+    static std::vector<float> resample(gsl::span<const float> input, int from, int to);
+
+  private:
+    double _ratio;
+    /// The cutoff relative to the nyquist frequency of the input
+    double _scale;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,95 @@
+#include "rotary_speaker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/modulated_delay.hpp"
+
+namespace otto::dsp {
+
+  RotarySpeaker::RotarySpeaker() : _buffers(2 * buffer_size, 0.f)
+  {
+    _rotors[horn] = {0.8f, 6.7f, 0.6f, 0.00045f, 0.6f};
+    _rotors[drum] = {0.67f, 5.8f, 3.f, 0.00025f, 0.3f};
+    for (auto& rotor : _rotors) rotor.speed = rotor.slow;
+  }
+
+  void RotarySpeaker::depth(float depth) noexcept
+  {
+    _depth = std::clamp(depth, 0.f, 1.f);
+  }
+
+  void RotarySpeaker::balance(float balance) noexcept
+  {
+    balance = std::clamp(balance, 0.f, 1.f);
+    _rotors[horn].gain = std::min(1.f, 2 * balance);
+    _rotors[drum].gain = std::min(1.f, 2 * (1 - balance));
+  }
+
+  void RotarySpeaker::process(gsl::span<const float> input,
+                              gsl::span<float> left,
+                              gsl::span<float> right) noexcept
+  {
+    if (_samplerate != gam::sampleRate()) {
+      _samplerate = gam::sampleRate();
+      // A second order Linkwitz-Riley crossover. With the horn inverted, the bands sum to an
+      // allpass, so the speaker is flat when the rotors stand still.
+      _crossover.coefficients(horn, BiquadCoefficients::high_pass(crossover, 0.5f));
+      _crossover.coefficients(drum, BiquadCoefficients::low_pass(crossover, 0.5f));
+    }
+    const float samplerate = _samplerate;
+
+    for (int done = 0; done < input.size();) {
+      int chunk = std::min<int>(max_chunk, input.size() - done);
+
+      for (int r = 0; r < 2; r++) {
+        auto& rotor = _rotors[r];
+        float target = _fast ? rotor.fast : rotor.slow;
+        rotor.speed += (target - rotor.speed) * (1 - std::exp(-chunk / (rotor.inertia * samplerate)));
+        const double increment = rotor.speed / samplerate;
+        const float swing = rotor.doppler * samplerate * _depth;
+        const float tremolo = rotor.tremolo * _depth;
+        for (int m = 0; m < 2; m++) {
+          // The rotor is nearest to, and faces, a microphone at the peak of the cosine
+          double offset = rotor.phase + 0.25 + 0.25 * m;
+          auto& delays = _delays[r][m];
+          auto& gains = _gains[r][m];
+          for (int f = 0; f < chunk; f++) {
+            float cos = table_sine(offset + f * increment);
+            delays[f] = 1 + swing * (1 - cos);
+            gains[f] = rotor.gain * (1 + tremolo * cos) / (1 + tremolo);
+          }
+        }
+        rotor.phase += chunk * increment;
+        rotor.phase -= std::floor(rotor.phase);
+      }
+
+      for (int f = 0; f < chunk; f++) {
+        BiquadBank<2>::Frame bands;
+        bands.fill(input[done + f]);
+        _crossover(bands);
+        int pos = (_write + f) & mask;
+        _buffers[horn * buffer_size + pos] = -bands[horn];
+        _buffers[drum * buffer_size + pos] = bands[drum];
+      }
+
+      for (int f = 0; f < chunk; f++) {
+        int frame = _write + f;
+        float l = 0;
+        float r = 0;
+        for (int rotor = 0; rotor < 2; rotor++) {
+          l += read(rotor, frame, _delays[rotor][0][f]) * _gains[rotor][0][f];
+          r += read(rotor, frame, _delays[rotor][1][f]) * _gains[rotor][1][f];
+        }
+        left[done + f] = l;
+        right[done + f] = r;
+      }
+
+      _write = (_write + chunk) & mask;
+      done += chunk;
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <gsl/span>
+
+#include "util/dsp/biquad_bank.hpp"
+
+namespace otto::dsp {
+
+  /// A rotating speaker cabinet, like a Leslie
+  ///
+  /// The input is split at @ref crossover into a drum for the lows and a horn for the highs.
+  /// Each rotor is a delay line read by two microphones a quarter turn apart, for the left and
+  /// right outputs. The delay to a microphone swings with the distance of the rotor, for the
+  /// Doppler shift, and its gain with the direction the rotor faces, for the amplitude
+  /// modulation. The rotors speed up and slow down with inertia, the heavy drum slower than
+  /// the horn.
+  ///
+  /// Like @ref ModulatedDelay, the delays and gains of a chunk are computed from the sine
+  /// table first, and the chunk of input is written to the lines before the taps read it.
+  struct RotarySpeaker {
+    /// The frequency the horn and drum are split at, in Hz
+    static constexpr float crossover = 800;
+
+    /// Allocates the delay lines
+    RotarySpeaker();
+
+    /// Spin the rotors at their fast (tremolo) or slow (chorale) speed
+    void fast(bool fast) noexcept
+    {
+      _fast = fast;
+    }
+
+    /// Set the amount of Doppler shift and amplitude modulation, from 0 to 1
+    void depth(float depth) noexcept;
+
+    /// Set the level of the horn relative to the drum, from 0 for only the drum to 1 for only
+    /// the horn
+    void balance(float balance) noexcept;
+
+    /// The phase of the horn, from 0 to 1
+    double horn_phase() const noexcept
+    {
+      return _rotors[horn].phase;
+    }
+
+    /// The phase of the drum, from 0 to 1
+    double drum_phase() const noexcept
+    {
+      return _rotors[drum].phase;
+    }
+
+    /// The current speed of the horn, in Hz
+    float horn_speed() const noexcept
+    {
+      return _rotors[horn].speed;
+    }
+
+    /// Process `input` into `left` and `right`, at the samplerate of gamma
+    void process(gsl::span<const float> input, gsl::span<float> left, gsl::span<float> right) noexcept;
+
+  private:
+    static constexpr int horn = 0;
+    static constexpr int drum = 1;
+    static constexpr int buffer_size = 1 << 10;
+    static constexpr int mask = buffer_size - 1;
+    static constexpr int max_chunk = 64;
+
+    /// Read the line of `rotor`, `delay` frames before `frame`, with linear interpolation
+    float read(int rotor, int frame, float delay) const noexcept
+    {
+      const float* buffer = _buffers.data() + rotor * buffer_size;
+      float pos = frame - delay;
+      int index = pos;
+      if (pos < index) index--;
+      float frac = pos - index;
+      float a = buffer[index & mask];
+      float b = buffer[(index + 1) & mask];
+      return a + (b - a) * frac;
+    }
+
+    struct Rotor {
+      float slow;
+      float fast;
+      /// The time constant of speeding up and slowing down, in seconds
+      float inertia;
+      /// The swing of the delay, in seconds
+      float doppler;
+      /// The depth of the amplitude modulation
+      float tremolo;
+      float speed = 0;
+      double phase = 0;
+      float gain = 1;
+    };
+
+    std::vector<float> _buffers;
+    int _write = 0;
+    BiquadBank<2> _crossover;
+    double _samplerate = 0;
+    bool _fast = false;
+    float _depth = 1;
+    std::array<Rotor, 2> _rotors;
+    /// The delay in frames and the gain of each rotor and microphone, for each frame of the
+    /// chunk
+    std::array<std::array<std::array<float, max_chunk>, 2>, 2> _delays;
+    std::array<std::array<std::array<float, max_chunk>, 2>, 2> _gains;
+  };
+
+} // namespace otto::dsp
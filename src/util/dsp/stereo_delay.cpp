@@ -0,0 +1,117 @@
+#include "stereo_delay.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace otto::dsp {
+
+  StereoDelay::StereoDelay(util::Arena* arena) : _buffers(2 * stride, 0.f, arena) {}
+
+  void StereoDelay::delay(float frames) noexcept
+  {
+    // One frame is kept for the interpolation
+    _target = std::clamp<float>(frames, max_chunk, buffer_size - 2);
+    if (_empty) {
+      _heads = {_target, _target};
+      _fade = -1;
+    }
+  }
+
+  void StereoDelay::feedback(float fbk) noexcept
+  {
+    _feedback = std::clamp(fbk, 0.f, 0.99f);
+  }
+
+  void StereoDelay::damping(float amount) noexcept
+  {
+    _damping = std::clamp(amount, 0.f, 0.99f);
+  }
+
+  void StereoDelay::zero() noexcept
+  {
+    std::fill(_buffers.begin(), _buffers.end(), 0.f);
+    _lowpass = {};
+    _heads = {_target, _target};
+    _fade = -1;
+    _empty = true;
+  }
+
+  void StereoDelay::read(int ch, float delay, float* out, int n) const noexcept
+  {
+    int whole = static_cast<int>(delay);
+    float frac = delay - whole;
+    // The frame before the delayed position, and the copy past the end keeps the next `n`
+    // contiguous
+    const float* a = _buffers.data() + ch * stride + ((_write - whole - 1) & mask);
+    for (int i = 0; i < n; i++) out[i] = a[i + 1] + (a[i] - a[i + 1]) * frac;
+  }
+
+  void StereoDelay::write(int ch, const float* in, int n) noexcept
+  {
+    float* line = _buffers.data() + ch * stride;
+    int first = std::min(n, buffer_size - _write);
+    std::copy_n(in, first, line + _write);
+    std::copy_n(in + first, n - first, line);
+    // Keep the copy of the first frames past the end
+    for (int i = 0; i < n; i++) {
+      int pos = (_write + i) & mask;
+      if (pos <= max_chunk) line[buffer_size + pos] = in[i];
+    }
+  }
+
+  void StereoDelay::process(gsl::span<const float> input, gsl::span<float> left, gsl::span<float> right) noexcept
+  {
+    const int nframes = input.size();
+    if (nframes > 0) _empty = false;
+    std::array<float*, 2> outs = {left.data(), right.data()};
+    for (int offset = 0; offset < nframes;) {
+      if (_fade < 0 && _heads[_active] != _target) {
+        _heads[1 - _active] = _target;
+        _fade = 0;
+      }
+      int n = std::min(max_chunk, nframes - offset);
+      // Chunks end with the crossfade, so each is either fading or not
+      if (_fade >= 0) n = std::min(n, crossfade_frames - _fade);
+
+      for (int ch = 0; ch < 2; ch++) {
+        float* out = outs[ch] + offset;
+        read(ch, _heads[_active], out, n);
+        if (_fade >= 0) {
+          Chunk next;
+          read(ch, _heads[1 - _active], next.data(), n);
+          const float step = 1.f / crossfade_frames;
+          const float start = _fade * step;
+          for (int i = 0; i < n; i++) out[i] += (next[i] - out[i]) * (start + i * step);
+        }
+      }
+      if (_fade >= 0) {
+        _fade += n;
+        if (_fade >= crossfade_frames) {
+          _active = 1 - _active;
+          _fade = -1;
+        }
+      }
+
+      // The feedback is damped by a one-pole low pass, which runs frame by frame
+      Chunk in_left;
+      Chunk in_right;
+      const float* dry = input.data() + offset;
+      const float* wet_left = outs[0] + offset;
+      const float* wet_right = outs[1] + offset;
+      const float pole = _damping;
+      for (int i = 0; i < n; i++) {
+        _lowpass[0] = wet_left[i] + (_lowpass[0] - wet_left[i]) * pole;
+        _lowpass[1] = wet_right[i] + (_lowpass[1] - wet_right[i]) * pole;
+        float fb_left = _lowpass[_ping_pong ? 1 : 0] * _feedback;
+        float fb_right = _lowpass[_ping_pong ? 0 : 1] * _feedback;
+        in_left[i] = dry[i] + fb_left;
+        in_right[i] = (_ping_pong ? 0.f : dry[i]) + fb_right;
+      }
+      write(0, in_left.data(), n);
+      write(1, in_right.data(), n);
+      _write = (_write + n) & mask;
+      offset += n;
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+
+#include <gsl/span>
+
+#include "util/arena.hpp"
+
+namespace otto::dsp {
+
+  /// A stereo feedback delay, plain or ping-pong, whose time changes without clicks
+  ///
+  /// The two lines are allocated once at their maximum length, and never resized. Changing the
+  /// delay starts a second read head at the new time, and crossfades to it over
+  /// `crossfade_frames`, so the lines keep their contents, and a change of tempo neither clicks
+  /// nor pitches the echoes like a moving head would. A change during a crossfade waits for it
+  /// to end. While the lines are empty, like before the first buffer, the heads jump instead.
+  ///
+  /// The lines are processed in chunks no longer than the shortest delay, so a chunk is read
+  /// before it is written. Each line has a copy of its first frames past its end, so the frames
+  /// of a head in a chunk are contiguous, and the fractional read is one pass the compiler
+  /// vectorizes, without wrapping the positions of each frame.
+  struct StereoDelay {
+    /// The length of each line, about 3 seconds at 44.1kHz
+    static constexpr int buffer_size = 1 << 17;
+    /// The longest chunk to process at once, and the shortest delay
+    static constexpr int max_chunk = 64;
+    /// The length of the crossfade between two read heads
+    static constexpr int crossfade_frames = 1024;
+    /// The number of bytes allocated by the constructor, for sizing an arena
+    static constexpr std::size_t memory_size = 2 * (buffer_size + max_chunk + 1) * sizeof(float);
+
+    /// Allocates the lines, from `arena` if given
+    StereoDelay(util::Arena* arena = nullptr);
+
+    /// Set the delay in frames, clamped to the length of the lines
+    void delay(float frames) noexcept;
+    /// The delay set last, which the heads are at or fading to
+    float delay() const noexcept
+    {
+      return _target;
+    }
+
+    /// Whether the heads are crossfading to a new delay
+    bool fading() const noexcept
+    {
+      return _fade >= 0;
+    }
+
+    /// Set the amount of the output fed back into the lines, from 0 to below 1
+    void feedback(float fbk) noexcept;
+    /// Set the damping of high frequencies in the feedback, from 0 for none to 1 for all
+    void damping(float amount) noexcept;
+
+    /// Feed the input into the left line only, and each line back into the other, so the
+    /// echoes bounce between the sides
+    void ping_pong(bool enabled) noexcept
+    {
+      _ping_pong = enabled;
+    }
+
+    /// Clear the lines
+    void zero() noexcept;
+
+    /// Process `input` into the wet signal in `left` and `right`
+    void process(gsl::span<const float> input, gsl::span<float> left, gsl::span<float> right) noexcept;
+
+  private:
+    using Chunk = std::array<float, max_chunk>;
+
+    /// Read `n` frames of channel `ch` at `delay` frames behind the write position into `out`
+    void read(int ch, float delay, float* out, int n) const noexcept;
+    /// Write `n` frames to channel `ch`, and to its copy past the end
+    void write(int ch, const float* in, int n) noexcept;
+
+    static constexpr int mask = buffer_size - 1;
+    static constexpr int stride = buffer_size + max_chunk + 1;
+
+    util::ArenaVector<float> _buffers;
+    int _write = 0;
+
+    /// The delays of the two heads
+    std::array<float, 2> _heads = {max_chunk, max_chunk};
+    /// The head that is heard, or faded from
+    int _active = 0;
+    /// The frames into the crossfade, or -1 when not fading
+    int _fade = -1;
+    float _target = max_chunk;
+
+    float _feedback = 0;
+    float _damping = 0;
+    std::array<float, 2> _lowpass = {};
+    bool _ping_pong = false;
+    /// Whether nothing has been written since the lines were cleared
+    bool _empty = true;
+  };
+
+} // namespace otto::dsp
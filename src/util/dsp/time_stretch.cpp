@@ -0,0 +1,121 @@
+#include "time_stretch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "util/dsp/window.hpp"
+
+namespace otto::dsp {
+
+  namespace {
+    /// `index` wrapped into a loop of `length` frames
+    int wrap(long index, int length) noexcept
+    {
+      long res = index % length;
+      return res < 0 ? res + length : res;
+    }
+  } // namespace
+
+  TimeStretch::TimeStretch(util::Arena* arena)
+    : _window(grain + 1, 0.f, arena), _out_left(grain, 0.f, arena), _out_right(grain, 0.f, arena)
+  {
+    // A symmetric window of `grain + 1` samples is periodic over the first `grain`, so the
+    // windows of grains half a grain apart sum to one
+    std::vector<double> window(grain + 1);
+    util::dsp::Window::compute(window, util::dsp::Window::hann, false);
+    std::copy(window.begin(), window.end(), _window.begin());
+  }
+
+  void TimeStretch::reset(double position) noexcept
+  {
+    std::fill(_out_left.begin(), _out_left.end(), 0.f);
+    std::fill(_out_right.begin(), _out_right.end(), 0.f);
+    _read = position;
+    // As if a grain ended at `position`, so the first grain is not moved
+    _last = std::lround(position) - hop;
+    _played = hop;
+    _position = position;
+  }
+
+  int TimeStretch::search(gsl::span<const float> left, gsl::span<const float> right, int nominal) const noexcept
+  {
+    const int length = left.size();
+    // The frames that followed the last grain in the loop, which the next one overlaps
+    const int natural = wrap(_last + hop, length);
+    if (natural == nominal) return 0;
+
+    const int step = _quality == Quality::full ? 1 : 4;
+    const int stride = _quality == Quality::full ? 2 : 4;
+    int best = 0;
+    float best_score = -INFINITY;
+    for (int offset = -tolerance; offset <= tolerance; offset += step) {
+      int a = natural;
+      int b = wrap(nominal + offset, length);
+      float score = 0;
+      for (int i = 0; i < hop; i += stride) {
+        score += left[a] * left[b] + right[a] * right[b];
+        a += stride;
+        b += stride;
+        if (a >= length) a -= length;
+        if (b >= length) b -= length;
+      }
+      if (score > best_score) {
+        best_score = score;
+        best = offset;
+      }
+    }
+    return best;
+  }
+
+  void TimeStretch::next_grain(gsl::span<const float> left, gsl::span<const float> right, float speed) noexcept
+  {
+    const int length = left.size();
+    std::copy(_out_left.begin() + hop, _out_left.end(), _out_left.begin());
+    std::copy(_out_right.begin() + hop, _out_right.end(), _out_right.begin());
+    std::fill(_out_left.begin() + hop, _out_left.end(), 0.f);
+    std::fill(_out_right.begin() + hop, _out_right.end(), 0.f);
+
+    int nominal = wrap(std::lround(_read), length);
+    int offset = _quality == Quality::overlap_add ? 0 : search(left, right, nominal);
+    int start = wrap(nominal + offset, length);
+    for (int i = 0, src = start; i < grain; i++) {
+      _out_left[i] += _window[i] * left[src];
+      _out_right[i] += _window[i] * right[src];
+      if (++src == length) src = 0;
+    }
+
+    _last = start;
+    // At the speed it was recorded, the grains follow on from where the last one was read, so
+    // they line up without a search
+    _read = speed == 1 ? start + hop : _read + hop * speed;
+    _read -= std::floor(_read / length) * length;
+    _played = 0;
+  }
+
+  void TimeStretch::process(gsl::span<const float> left,
+                            gsl::span<const float> right,
+                            float speed,
+                            gsl::span<float> out_left,
+                            gsl::span<float> out_right) noexcept
+  {
+    const int length = left.size();
+    if (length == 0) {
+      std::fill(out_left.begin(), out_left.end(), 0.f);
+      std::fill(out_right.begin(), out_right.end(), 0.f);
+      return;
+    }
+    speed = std::clamp(speed, 0.5f, 2.f);
+    for (int f = 0; f < out_left.size();) {
+      if (_played == hop) next_grain(left, right, speed);
+      int n = std::min<int>(hop - _played, out_left.size() - f);
+      std::copy_n(_out_left.begin() + _played, n, out_left.begin() + f);
+      std::copy_n(_out_right.begin() + _played, n, out_right.begin() + f);
+      _played += n;
+      f += n;
+    }
+    _position = _last + _played * speed;
+    _position -= std::floor(_position / length) * length;
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <gsl/span>
+
+#include "util/arena.hpp"
+
+namespace otto::dsp {
+
+  /// A WSOLA time stretcher, playing a stereo loop at another speed without changing its pitch
+  ///
+  /// The output is built from grains of the loop, overlapped by half and faded by a Hann window,
+  /// so their windows sum to one. The grains are half a grain apart in the output, and `speed`
+  /// times that apart in the loop. Each grain is moved by up to @ref tolerance frames to where
+  /// it best continues the grain before it, found by cross-correlating with the frames that
+  /// followed that grain in the loop, so the waveforms line up where they overlap.
+  ///
+  /// The search is the cost, and the quality sets how much of it is done. At a speed of one,
+  /// the grains line up by themselves, and the output is the loop.
+  struct TimeStretch {
+    enum struct Quality {
+      /// Search every offset, correlating every other frame
+      full,
+      /// Search every fourth offset, correlating every fourth frame, an eighth of the cost
+      coarse,
+      /// No search, plain overlap-add, which smears transients and phases
+      overlap_add,
+    };
+
+    /// The length of the grains, in frames
+    static constexpr int grain = 1024;
+    /// The distance between grains in the output
+    static constexpr int hop = grain / 2;
+    /// The furthest a grain is moved to line up with the one before it
+    static constexpr int tolerance = 256;
+
+    /// The number of bytes allocated by the constructor, for sizing an arena
+    static constexpr std::size_t memory_size = (grain + 1 + 2 * grain) * sizeof(float);
+
+    /// \param arena Allocate the window and the output buffers from this arena, if given
+    TimeStretch(util::Arena* arena = nullptr);
+
+    void quality(Quality quality) noexcept
+    {
+      _quality = quality;
+    }
+
+    /// Start playing from frame `position` of the loop, fading in over half a grain
+    void reset(double position) noexcept;
+
+    /// The frame of the loop being played, delayed by half a grain from the one read
+    double position() const noexcept
+    {
+      return _position;
+    }
+
+    /// Play a block of the loop in `left` and `right`, at `speed` times the speed it was recorded
+    ///
+    /// `speed` is kept between 0.5 and 2, where the tolerance finds a match for low notes.
+    void process(gsl::span<const float> left,
+                 gsl::span<const float> right,
+                 float speed,
+                 gsl::span<float> out_left,
+                 gsl::span<float> out_right) noexcept;
+
+  private:
+    /// Add the next grain to the output, and move on by a hop
+    void next_grain(gsl::span<const float> left, gsl::span<const float> right, float speed) noexcept;
+    /// The offset from `nominal` where a grain best continues the one at `_last`
+    int search(gsl::span<const float> left, gsl::span<const float> right, int nominal) const noexcept;
+
+    util::ArenaVector<float> _window;
+    /// The output of the grains, of which the first hop is complete
+    util::ArenaVector<float> _out_left;
+    util::ArenaVector<float> _out_right;
+    Quality _quality = Quality::full;
+    /// The frame of the loop the next grain is read from, before the search
+    double _read = 0;
+    /// The frame of the loop the last grain was read from
+    int _last = 0;
+    /// The frames of the complete hop already played
+    int _played = hop;
+    double _position = 0;
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,69 @@
+#include "tonewheel.hpp"
+
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  TonewheelBank::TonewheelBank() noexcept
+  {
+    // Spread the starting phases, so the wheels of a chord don't start in phase
+    for (int w = 0; w < wheels; w++) {
+      double phase = 2 * M_PI * std::fmod(w * 0.618034, 1.0);
+      _re[w] = std::cos(phase);
+      _im[w] = std::sin(phase);
+    }
+  }
+
+  float TonewheelBank::wheel_frequency(int wheel) noexcept
+  {
+    return base_frequency * std::exp2(wheel / 12.f);
+  }
+
+  int TonewheelBank::wheel_for(float frequency) noexcept
+  {
+    return std::lround(12 * std::log2(frequency / base_frequency));
+  }
+
+  int TonewheelBank::fold(int wheel) noexcept
+  {
+    while (wheel < 0) wheel += 12;
+    while (wheel >= wheels) wheel -= 12;
+    return wheel;
+  }
+
+  void TonewheelBank::reserve(int nframes)
+  {
+    if (_out.size() < std::size_t(nframes * wheels)) _out.resize(nframes * wheels);
+  }
+
+  void TonewheelBank::render(int nframes, float detune) noexcept
+  {
+    reserve(nframes);
+    double step = 2 * M_PI * detune / gam::sampleRate();
+    for (int w = 0; w < wheels; w++) {
+      _cos[w] = std::cos(step * wheel_frequency(w));
+      _sin[w] = std::sin(step * wheel_frequency(w));
+    }
+
+    float* out = _out.data();
+    for (int f = 0; f < nframes; f++, out += wheels) {
+      for (int w = 0; w < wheels; w++) {
+        float re = _re[w] * _cos[w] - _im[w] * _sin[w];
+        float im = _re[w] * _sin[w] + _im[w] * _cos[w];
+        _re[w] = re;
+        _im[w] = im;
+        out[w] = im;
+      }
+    }
+
+    // The rounding errors of the rotations add up, so put the wheels back on the unit circle
+    for (int w = 0; w < wheels; w++) {
+      float gain = 1 / std::sqrt(_re[w] * _re[w] + _im[w] * _im[w]);
+      _re[w] *= gain;
+      _im[w] *= gain;
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "util/memory_tags.hpp"
+
+namespace otto::dsp {
+
+  /// A bank of tonewheels, shared by all keys of an organ
+  ///
+  /// Like the wheels of a tonewheel organ, the bank has one sine per semitone, which keep
+  /// turning whether a key is held or not. All wheels are rendered once per block, and a key
+  /// plays by mixing a few of them, so the cost of a voice does not depend on its frequency or
+  /// on the number of drawbars.
+  ///
+  /// The wheels are quadrature oscillators, stored as one array per component. The frames are
+  /// rendered in the outer loop and the wheels in the inner one, so the inner loop vectorizes.
+  struct TonewheelBank {
+    /// The number of wheels, one per semitone
+    static constexpr int wheels = 91;
+    /// The frequency of the lowest wheel, C1
+    static constexpr float base_frequency = 32.7032f;
+
+    TonewheelBank() noexcept;
+
+    /// The frequency of `wheel` in Hz, when not detuned
+    static float wheel_frequency(int wheel) noexcept;
+
+    /// The nearest wheel to `frequency`. May be outside the bank, see @ref fold.
+    static int wheel_for(float frequency) noexcept;
+
+    /// Move `wheel` into the bank by whole octaves, like the foldback of an organ
+    static int fold(int wheel) noexcept;
+
+    /// Allocate space for blocks of up to `nframes`
+    void reserve(int nframes);
+
+    /// Render the next `nframes` of all wheels, at the samplerate of gamma
+    ///
+    /// All wheels are detuned by the factor `detune`, which is applied once per block.
+    /// Allocates if `nframes` is larger than the reserved size.
+    void render(int nframes, float detune = 1) noexcept;
+
+    /// The values of all wheels at `frame` of the last block, @ref wheels long
+    const float* frame(int frame) const noexcept
+    {
+      return _out.data() + frame * wheels;
+    }
+
+  private:
+    /// The state of the wheels, as `re + i im`. The output is `im`.
+    std::array<float, wheels> _re;
+    std::array<float, wheels> _im;
+    /// The rotation of each wheel per frame
+    std::array<float, wheels> _cos;
+    std::array<float, wheels> _sin;
+    /// The wheels of the last block, accounted to the memory tag `Tonewheels`
+    util::TaggedVector<float> _out{util::memory_tag("Tonewheels")};
+  };
+
+} // namespace otto::dsp
@@ -0,0 +1,147 @@
+#include "wavetable.hpp"
+
+#include <algorithm>
+#include <complex>
+
+#include <Gamma/Domain.h>
+
+namespace otto::dsp {
+
+  namespace {
+
+    using Spectrum = std::vector<std::complex<double>>;
+
+    /// The sines of one cycle, to look up `sin(2 pi n / size)` for any `n`
+    const std::vector<double>& sine_table()
+    {
+      static const std::vector<double> table = [] {
+        std::vector<double> res(MipMappedWavetable::size);
+        for (int i = 0; i < MipMappedWavetable::size; i++) {
+          res[i] = std::sin(2 * M_PI * i / MipMappedWavetable::size);
+        }
+        return res;
+      }();
+      return table;
+    }
+
+    /// Sum the harmonics of `spectrum` into the levels
+    ///
+    /// `spectrum[h]` is the complex amplitude of harmonic `h`, so the waveform is
+    /// `sum(real(spectrum[h] * e^(2 pi i h x)))`. The levels are built from the top down, each
+    /// one adding the harmonics of the octave above the previous one.
+    std::vector<float> synthesize(const Spectrum& spectrum)
+    {
+      constexpr int size = MipMappedWavetable::size;
+      constexpr int mask = size - 1;
+      auto& sines = sine_table();
+      std::vector<float> res(MipMappedWavetable::levels * MipMappedWavetable::stride);
+      std::vector<double> sum(size, spectrum.empty() ? 0 : spectrum[0].real());
+      int done = 0;
+      for (int level = MipMappedWavetable::levels - 1; level >= 0; level--) {
+        // The harmonic at the nyquist frequency of the table can't be represented with a phase
+        int top = std::min<int>({size >> (level + 1), size / 2 - 1, int(spectrum.size()) - 1});
+        for (int h = done + 1; h <= top; h++) {
+          auto a = spectrum[h];
+          if (a == 0.0) continue;
+          for (int i = 0; i < size; i++) {
+            int n = (h * i) & mask;
+            // real(a * (cos + i sin))
+            sum[i] += a.real() * sines[(n + size / 4) & mask] - a.imag() * sines[n];
+          }
+        }
+        done = std::max(done, top);
+        float* out = res.data() + level * MipMappedWavetable::stride + 1;
+        std::copy(sum.begin(), sum.end(), out);
+        out[-1] = out[size - 1];
+        std::copy(out, out + 3, out + size);
+      }
+      return res;
+    }
+
+  } // namespace
+
+  MipMappedWavetable::MipMappedWavetable(std::shared_ptr<const std::vector<float>> data)
+    : _data(std::move(data))
+  {}
+
+  std::vector<float> MipMappedWavetable::build(gsl::span<const float> cycle)
+  {
+    if (cycle.empty()) return synthesize({});
+    // Resample to the table size, so the spectrum can be computed with the sine table
+    std::vector<double> resampled(size);
+    for (int i = 0; i < size; i++) {
+      double pos = double(i) * cycle.size() / size;
+      int index = pos;
+      double frac = pos - index;
+      double next = cycle[(index + 1) % cycle.size()];
+      resampled[i] = cycle[index] + (next - cycle[index]) * frac;
+    }
+
+    constexpr int mask = size - 1;
+    auto& sines = sine_table();
+    Spectrum spectrum(size / 2);
+    for (int h = 0; h < size / 2; h++) {
+      std::complex<double> sum = 0;
+      for (int i = 0; i < size; i++) {
+        int n = (h * i) & mask;
+        sum += resampled[i] * std::complex<double>(sines[(n + size / 4) & mask], -sines[n]);
+      }
+      // Both the positive and negative frequency, except for the DC offset
+      spectrum[h] = sum * (h == 0 ? 1.0 : 2.0) / double(size);
+    }
+    return synthesize(spectrum);
+  }
+
+  std::vector<float> MipMappedWavetable::build_harmonics(std::initializer_list<Harmonic> harmonics)
+  {
+    int top = 0;
+    for (auto& h : harmonics) top = std::max(top, h.number);
+    Spectrum spectrum(top + 1);
+    for (auto& h : harmonics) {
+      // amplitude * sin(2 pi (h x + phase)) = real(-i amplitude e^(2 pi i phase) e^(2 pi i h x))
+      spectrum[h.number] += std::polar<double>(h.amplitude, 2 * M_PI * h.phase - M_PI / 2);
+    }
+    return synthesize(spectrum);
+  }
+
+  int MipMappedWavetable::level_for(float increment) noexcept
+  {
+    int exp;
+    std::frexp(std::abs(increment) * size, &exp);
+    return std::clamp(exp, 0, levels - 1);
+  }
+
+  void WavetableOsc::freq(float hz) noexcept
+  {
+    increment(hz / gam::sampleRate());
+  }
+
+  MorphWavetable MorphWavetable::build(const MipMappedWavetable& from, const MipMappedWavetable& to, int frames)
+  {
+    frames = std::max(frames, 2);
+    auto data = std::make_shared<std::vector<float>>(std::size_t(levels) * stride * frames);
+    for (int level = 0; level < levels; level++) {
+      // Both levels are readable from -1, so the padding is copied along
+      const float* a = from.empty() ? nullptr : from.level(level) - 1;
+      const float* b = to.empty() ? nullptr : to.level(level) - 1;
+      float* out = data->data() + std::size_t(level) * stride * frames;
+      for (int i = 0; i < stride; i++) {
+        float x = a ? a[i] : 0.f;
+        float y = b ? b[i] : 0.f;
+        for (int k = 0; k < frames; k++) {
+          out[i * frames + k] = x + (y - x) * k / float(frames - 1);
+        }
+      }
+    }
+    MorphWavetable res;
+    res._data = std::move(data);
+    res._frames = frames;
+    return res;
+  }
+
+  void MorphWavetableOsc::freq(float hz) noexcept
+  {
+    increment(hz / gam::sampleRate());
+  }
+
+} // namespace otto::dsp
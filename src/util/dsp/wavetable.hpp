@@ -0,0 +1,336 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include <gsl/span>
+
+#include "util/dsp/interpolation.hpp"
+
+namespace otto::dsp {
+
+  /// A band-limited wavetable, with one table per octave
+  ///
+  /// Level `k` holds the harmonics up to `size >> (k + 1)`, so it plays without aliasing at up
+  /// to `2^k / size` cycles per sample. @ref level_for picks the richest level that does not
+  /// alias at a given frequency.
+  ///
+  /// The levels are immutable and shared, so tables can be built once, and played by any number
+  /// of voices.
+  struct MipMappedWavetable {
+    /// The number of samples in a cycle, in each level
+    static constexpr int size = 2048;
+    /// One level per octave, down to a single sine
+    static constexpr int levels = 11;
+    /// The distance between levels in the data. Each level is preceded by a copy of its last
+    /// sample, and followed by copies of its first three, so the four point interpolations do
+    /// not need to wrap around, even at a phase that rounds up to a whole cycle.
+    static constexpr int stride = size + 4;
+
+    struct Harmonic {
+      /// The number of cycles of the harmonic per cycle of the table
+      int number;
+      float amplitude;
+      /// The phase of the harmonic, in cycles
+      float phase = 0;
+    };
+
+    /// An empty table, which plays silence
+    MipMappedWavetable() = default;
+
+    /// Use levels built by @ref build or @ref build_harmonics
+    MipMappedWavetable(std::shared_ptr<const std::vector<float>> data);
+
+    /// Build the levels of a table from one cycle of a waveform, of any length
+    static std::vector<float> build(gsl::span<const float> cycle);
+
+    /// Build the levels of a table from a sum of sines
+    static std::vector<float> build_harmonics(std::initializer_list<Harmonic> harmonics);
+
+    /// The level to play at `increment` cycles per sample
+    static int level_for(float increment) noexcept;
+
+    /// The `size` samples of level `index`, readable from `-1` to `size + 2`. `nullptr` if the
+    /// table is empty.
+    const float* level(int index) const noexcept
+    {
+      return _data ? _data->data() + index * stride + 1 : nullptr;
+    }
+
+    bool empty() const noexcept
+    {
+      return _data == nullptr;
+    }
+
+  private:
+    std::shared_ptr<const std::vector<float>> _data;
+  };
+
+  /// An oscillator playing a @ref MipMappedWavetable
+  ///
+  /// Interpolates linearly by default. The mode can be changed at any time, to follow the
+  /// quality tier of the engine.
+  struct WavetableOsc {
+    /// Set the table. It has to outlive its use in the oscillator.
+    void table(const MipMappedWavetable& table) noexcept
+    {
+      _table = &table;
+      _data = table.level(_level);
+    }
+
+    /// Set the frequency in Hz, at the samplerate of gamma
+    void freq(float hz) noexcept;
+
+    /// Set the frequency in cycles per sample
+    void increment(float increment) noexcept
+    {
+      _increment = increment;
+      int lvl = MipMappedWavetable::level_for(increment);
+      if (lvl == _level) return;
+      _level = lvl;
+      if (_table != nullptr) _data = _table->level(_level);
+    }
+
+    /// Set the phase, in cycles
+    void phase(double phase) noexcept
+    {
+      _phase = phase - std::floor(phase);
+    }
+
+    void interpolation(Interpolation mode) noexcept
+    {
+      _interpolation = mode;
+    }
+
+    Interpolation interpolation() const noexcept
+    {
+      return _interpolation;
+    }
+
+    /// The next sample, with the interpolation `I`
+    template<Interpolation I>
+    float next() noexcept
+    {
+      if (_data == nullptr) return 0;
+      float pos = _phase * MipMappedWavetable::size;
+      int index = pos;
+      float res = interpolate<I>(_data + index, pos - index);
+      _phase += _increment;
+      _phase -= std::floor(_phase);
+      return res;
+    }
+
+    /// The next sample, with the current interpolation
+    float operator()() noexcept
+    {
+      return dispatch_interpolation(_interpolation, [this](auto ipl) { return next<ipl>(); });
+    }
+
+    /// Fill `out` with the next samples, choosing the interpolation once
+    void process(gsl::span<float> out) noexcept
+    {
+      dispatch_interpolation(_interpolation, [&](auto ipl) {
+        for (auto& frm : out) frm = next<ipl>();
+      });
+    }
+
+  private:
+    const MipMappedWavetable* _table = nullptr;
+    /// The current level of `_table`
+    const float* _data = nullptr;
+    int _level = 0;
+    double _phase = 0;
+    float _increment = 0;
+    Interpolation _interpolation = Interpolation::linear;
+  };
+
+  /// The frames of a morph between two @ref MipMappedWavetable, interleaved sample by sample
+  ///
+  /// Frame `k` of `frames` is the crossfade `k / (frames - 1)` of the way from the first table
+  /// to the second. The frames of each sample are next to each other, so an oscillator reads the
+  /// two frames around its morph position from the same cache lines, with one phase. Between two
+  /// frames, a position is played as their crossfade, which is exact for the frames of a linear
+  /// crossfade, so two frames, the tables themselves, are enough to morph between two tables.
+  ///
+  /// Built on the loader thread, when either table loads, and immutable like the tables.
+  struct MorphWavetable {
+    static constexpr int size = MipMappedWavetable::size;
+    static constexpr int levels = MipMappedWavetable::levels;
+    /// The distance between levels in samples, each of them `frames` long. Padded like the
+    /// levels of @ref MipMappedWavetable.
+    static constexpr int stride = MipMappedWavetable::stride;
+
+    /// An empty table, which plays silence
+    MorphWavetable() = default;
+
+    /// Build `frames` frames from `from` to `to`. An empty table is taken as silence.
+    static MorphWavetable build(const MipMappedWavetable& from, const MipMappedWavetable& to, int frames = 2);
+
+    /// The number of frames of each sample. At least two, unless the table is empty.
+    int frames() const noexcept
+    {
+      return _frames;
+    }
+
+    /// The `size` samples of level `index`, `frames()` floats each, readable from sample `-1`
+    /// to `size + 2`. `nullptr` if the table is empty.
+    const float* level(int index) const noexcept
+    {
+      return _data ? _data->data() + (index * stride + 1) * _frames : nullptr;
+    }
+
+    bool empty() const noexcept
+    {
+      return _data == nullptr;
+    }
+
+  private:
+    std::shared_ptr<const std::vector<float>> _data;
+    int _frames = 0;
+  };
+
+  /// An oscillator morphing through the frames of a @ref MorphWavetable
+  ///
+  /// Like a pair of @ref WavetableOsc crossfaded at every sample, but with one phase, one
+  /// level and one interpolation: the two frames around the morph position are crossfaded
+  /// first, and the result is interpolated. The morph is meant to be modulated at control rate,
+  /// see @ref morph.
+  struct MorphWavetableOsc {
+    /// Set the table. It has to outlive its use in the oscillator.
+    void table(const MorphWavetable& table) noexcept
+    {
+      _table = &table;
+      _data = table.level(_level);
+      _frames = table.frames();
+      morph(_position, _gain_target);
+    }
+
+    /// Set the frequency in Hz, at the samplerate of gamma
+    void freq(float hz) noexcept;
+
+    /// Set the frequency in cycles per sample
+    void increment(float increment) noexcept
+    {
+      _increment = increment;
+      int lvl = MipMappedWavetable::level_for(increment);
+      if (lvl == _level) return;
+      _level = lvl;
+      if (_table != nullptr) _data = _table->level(_level);
+    }
+
+    /// Set the phase, in cycles
+    void phase(double phase) noexcept
+    {
+      _phase = phase - std::floor(phase);
+    }
+
+    void interpolation(Interpolation mode) noexcept
+    {
+      _interpolation = mode;
+    }
+
+    Interpolation interpolation() const noexcept
+    {
+      return _interpolation;
+    }
+
+    /// Morph to `position`, from 0 at the first frame to 1 at the last, and scale by `gain`
+    ///
+    /// Both are ramped to over the next `ramp` samples, like a control rate modulator. A
+    /// position outside of `[0, 1]` extrapolates the two frames at that end.
+    void morph(float position, float gain = 1, int ramp = 0) noexcept
+    {
+      _position = position;
+      _gain_target = gain;
+      float target = _position * std::max(_frames - 1, 1);
+      if (ramp <= 0) {
+        _frame_pos = target;
+        _gain = gain;
+        _ramp_left = 0;
+        update_frame();
+        return;
+      }
+      _frame_step = (target - _frame_pos) / ramp;
+      _gain_step = (gain - _gain) / ramp;
+      _ramp_left = ramp;
+    }
+
+    /// The next sample, with the interpolation `I`
+    template<Interpolation I>
+    float next() noexcept
+    {
+      if (_data == nullptr) return 0;
+      if (_ramp_left > 0) {
+        _ramp_left--;
+        _frame_pos += _frame_step;
+        _gain += _gain_step;
+        update_frame();
+      }
+      float pos = _phase * MipMappedWavetable::size;
+      int index = pos;
+      // The crossfade of the two frames at the samples the interpolation reads
+      const float* frame = _data + index * _frames + _frame;
+      auto at = [&](int i) {
+        const float* s = frame + i * _frames;
+        return s[0] + (s[1] - s[0]) * _frame_frac;
+      };
+      std::array<float, 4> mixed;
+      if constexpr (I == Interpolation::cubic || I == Interpolation::sinc) mixed[0] = at(-1);
+      mixed[1] = at(0);
+      if constexpr (I != Interpolation::none) mixed[2] = at(1);
+      if constexpr (I == Interpolation::cubic || I == Interpolation::sinc) mixed[3] = at(2);
+      float res = _gain * interpolate<I>(mixed.data() + 1, pos - index);
+      _phase += _increment;
+      _phase -= std::floor(_phase);
+      return res;
+    }
+
+    /// The next sample, with the current interpolation
+    float operator()() noexcept
+    {
+      return dispatch_interpolation(_interpolation, [this](auto ipl) { return next<ipl>(); });
+    }
+
+    /// Fill `out` with the next samples, choosing the interpolation once
+    void process(gsl::span<float> out) noexcept
+    {
+      dispatch_interpolation(_interpolation, [&](auto ipl) {
+        for (auto& frm : out) frm = next<ipl>();
+      });
+    }
+
+  private:
+    void update_frame() noexcept
+    {
+      _frame = std::clamp(int(_frame_pos), 0, std::max(_frames - 2, 0));
+      _frame_frac = _frame_pos - _frame;
+    }
+
+    const MorphWavetable* _table = nullptr;
+    /// The current level of `_table`
+    const float* _data = nullptr;
+    int _frames = 0;
+    int _level = 0;
+    double _phase = 0;
+    float _increment = 0;
+    Interpolation _interpolation = Interpolation::linear;
+
+    /// The target of the morph, from 0 to 1
+    float _position = 0;
+    float _gain_target = 1;
+    /// The current morph position in frames, and its step while ramping
+    float _frame_pos = 0;
+    float _frame_step = 0;
+    /// The frame before `_frame_pos`, and the fraction of the way to the next one
+    int _frame = 0;
+    float _frame_frac = 0;
+    float _gain = 1;
+    float _gain_step = 0;
+    int _ramp_left = 0;
+  };
+
+} // namespace otto::dsp
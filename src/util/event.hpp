@@ -1,31 +1,179 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
 #include <vector>
-#include <functional>
+
+#include "util/inline_function.hpp"
+#include "util/mpsc_queue.hpp"
 
 namespace otto::util {
 
+  /// A handle to a handler subscribed to an @ref Event, for unsubscribing it
+  struct Subscription {
+    int id = -1;
+
+    explicit operator bool() const noexcept
+    {
+      return id >= 0;
+    }
+  };
+
+  namespace detail {
+    /// A call to the handlers of an event, queued by @ref Event::fire_deferred
+    struct DeferredCall {
+      static constexpr std::size_t max_args_size = 32;
+
+      void (*call)(void* event, const void* args) = nullptr;
+      void* event = nullptr;
+      alignas(std::max_align_t) std::byte args[max_args_size];
+    };
+
+    inline MPSCQueue<DeferredCall, 256>& deferred_calls() noexcept
+    {
+      static MPSCQueue<DeferredCall, 256> queue;
+      return queue;
+    }
+
+    inline std::atomic_int deferred_dropped = 0;
+  } // namespace detail
+
+  /// Run the handlers of the events fired with @ref Event::fire_deferred since the last call
+  ///
+  /// Called by the UI thread once per frame, so deferred handlers run there.
+  ///
+  /// \returns the number of events fired
+  inline int dispatch_deferred_events()
+  {
+    int count = 0;
+    detail::DeferredCall call;
+    while (detail::deferred_calls().pop(call)) {
+      call.call(call.event, call.args);
+      count++;
+    }
+    return count;
+  }
+
+  /// The number of deferred events dropped because the queue was full, since startup
+  inline int dropped_deferred_events() noexcept
+  {
+    return detail::deferred_dropped.load(std::memory_order_relaxed);
+  }
+
   /// An event registry and dispatcher
+  ///
+  /// Handlers run in order of their priority, highest first, and in the order they were
+  /// subscribed within a priority. Handlers may subscribe and unsubscribe handlers of the event
+  /// that is calling them. Those changes take effect from the next time it fires.
+  ///
+  /// `fire` runs the handlers on the calling thread. From the audio thread, use
+  /// `fire_deferred`, which never locks or allocates, and runs them on the UI thread instead.
   template<typename... Args>
   struct Event {
-    using handler_type = std::function<void(Args...)>;
+    using handler_type = InlineFunction<void(Args...)>;
 
     Event() = default;
+    Event(const Event&) = delete;
+    Event& operator=(const Event&) = delete;
+
+    Subscription subscribe(handler_type handler, int priority = 0)
+    {
+      Subscription sub{_next_id++};
+      Entry entry{sub.id, priority, std::move(handler)};
+      if (_firing > 0) {
+        _pending.push_back(std::move(entry));
+      } else {
+        insert(std::move(entry));
+      }
+      return sub;
+    }
 
-    int subscribe(handler_type handler)
+    /// Remove a handler. Does nothing if it was already removed.
+    void unsubscribe(Subscription sub)
     {
-      handlers.emplace_back(std::move(handler));
-      return handlers.size() - 1;
+      auto matches = [&](const Entry& e) { return e.id == sub.id; };
+      if (_firing > 0) {
+        // Leave the entry in place, so the loop in `fire` stays valid
+        auto found = std::find_if(_handlers.begin(), _handlers.end(), matches);
+        if (found != _handlers.end()) found->handler = nullptr;
+      } else {
+        _handlers.erase(std::remove_if(_handlers.begin(), _handlers.end(), matches), _handlers.end());
+      }
+      _pending.erase(std::remove_if(_pending.begin(), _pending.end(), matches), _pending.end());
     }
 
     void fire(Args... args)
     {
-      for (auto& handler : handlers) {
-        handler(args...);
+      _firing++;
+      // Handlers subscribed from here go to `_pending`, so `_handlers` is not resized
+      for (auto& entry : _handlers) {
+        if (entry.handler) entry.handler(args...);
       }
+      if (--_firing == 0) apply_pending();
+    }
+
+    /// Queue a call to the handlers with `args`, to be run by @ref dispatch_deferred_events
+    ///
+    /// Safe to call from the audio thread. Never locks or allocates. The arguments must be
+    /// trivially copyable, and the event must outlive the dispatch. If the queue is full, the
+    /// call is dropped, and counted in @ref dropped_deferred_events.
+    void fire_deferred(const Args&... args) noexcept
+    {
+      using Tuple = std::tuple<Args...>;
+      static_assert((std::is_trivially_copyable_v<Args> && ...),
+                    "Deferred events require trivially copyable arguments");
+      static_assert(sizeof(Tuple) <= detail::DeferredCall::max_args_size,
+                    "The arguments are too large for a deferred event");
+      detail::DeferredCall call;
+      call.event = this;
+      call.call = [](void* event, const void* args) {
+        std::apply([event](const auto&... a) { static_cast<Event*>(event)->fire(a...); },
+                   *std::launder(static_cast<const Tuple*>(args)));
+      };
+      new (call.args) Tuple(args...);
+      if (!detail::deferred_calls().push(call)) {
+        detail::deferred_dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    /// The number of subscribed handlers
+    std::size_t size() const noexcept
+    {
+      return std::count_if(_handlers.begin(), _handlers.end(), [](const Entry& e) { return bool(e.handler); }) +
+             _pending.size();
     }
 
   private:
-    std::vector<handler_type> handlers;
+    struct Entry {
+      int id;
+      int priority;
+      handler_type handler;
+    };
+
+    /// Insert after all entries with a higher or equal priority
+    void insert(Entry&& entry)
+    {
+      auto pos = std::find_if(_handlers.begin(), _handlers.end(),
+                              [&](const Entry& e) { return e.priority < entry.priority; });
+      _handlers.insert(pos, std::move(entry));
+    }
+
+    void apply_pending()
+    {
+      _handlers.erase(std::remove_if(_handlers.begin(), _handlers.end(), [](const Entry& e) { return !e.handler; }),
+                      _handlers.end());
+      for (auto& entry : _pending) insert(std::move(entry));
+      _pending.clear();
+    }
+
+    std::vector<Entry> _handlers;
+    /// Subscribed while firing
+    std::vector<Entry> _pending;
+    int _firing = 0;
+    int _next_id = 0;
   };
 } // namespace otto::util
@@ -169,12 +169,13 @@ namespace otto::filesystem {
         return {};
       }
 #if __APPLE__
-      return file_time_type() + std::chrono::duration_cast<file_time_type::duration>(
-                                  std::chrono::nanoseconds(st.st_mtimespec.tv_nsec));
+      auto& mtime = st.st_mtimespec;
 #else
-      return file_time_type() + std::chrono::duration_cast<file_time_type::duration>(
-                                  std::chrono::nanoseconds(st.st_mtim.tv_nsec));
+      auto& mtime = st.st_mtim;
 #endif
+      return file_time_type() + std::chrono::duration_cast<file_time_type::duration>(
+                                  std::chrono::seconds(mtime.tv_sec) +
+                                  std::chrono::nanoseconds(mtime.tv_nsec));
     }
 
     struct stat stat(path p, std::error_code& ec)
@@ -1467,20 +1468,47 @@ namespace otto::filesystem {
     bool create_directory(const path& p, const path& attributes);
     bool create_directory(const path& p, const path& attributes,
     std::error_code& ec) noexcept;
+  */
 
-    void create_directory_symlink(const path& to, const path& new_symlink);
-    void create_directory_symlink(const path& to, const path& new_symlink,
-    std::error_code& ec) noexcept;
+  void create_directory_symlink(const path& to, const path& new_symlink)
+  {
+    std::error_code ec;
+    create_directory_symlink(to, new_symlink, ec);
+    if (ec != std::error_code()) {
+      throw filesystem_error("In filesystem::create_directory_symlink", to, new_symlink, ec);
+    }
+  }
 
+  void create_directory_symlink(const path& to, const path& new_symlink, std::error_code& ec) noexcept
+  {
+    // On posix, links to directories are like any other
+    create_symlink(to, new_symlink, ec);
+  }
+
+  /*
     void create_hard_link(const path& to, const path& new_hard_link);
     void create_hard_link(const path& to, const path& new_hard_link,
     std::error_code& ec) noexcept;
-
-    void create_symlink(const path& to, const path& new_symlink);
-    void create_symlink(const path& to, const path& new_symlink,
-    std::error_code& ec) noexcept;
   */
 
+  void create_symlink(const path& to, const path& new_symlink)
+  {
+    std::error_code ec;
+    create_symlink(to, new_symlink, ec);
+    if (ec != std::error_code()) {
+      throw filesystem_error("In filesystem::create_symlink", to, new_symlink, ec);
+    }
+  }
+
+  void create_symlink(const path& to, const path& new_symlink, std::error_code& ec) noexcept
+  {
+    if (::symlink(to.c_str(), new_symlink.c_str())) {
+      ec = {errno, std::system_category()};
+    } else {
+      ec.clear();
+    }
+  }
+
   path current_path()
   {
     std::error_code ec;
@@ -1812,18 +1840,33 @@ namespace otto::filesystem {
 
   uintmax_t remove_all(const path& p, std::error_code& ec) noexcept
   {
+    // The contents of a directory go before it. Symlinks are removed themselves, and never
+    // followed, so a link out of the tree leaves its target alone.
+    struct stat st;
+    if (::lstat(p.c_str(), &st) != 0) {
+      if (errno == ENOENT) {
+        ec.clear();
+        return 0;
+      }
+      ec = {errno, std::system_category()};
+      return -1;
+    }
     uintmax_t n = 0;
-    if (is_directory(p, ec)) {
+    const bool directory = S_ISDIR(st.st_mode);
+    if (directory) {
+      directory_iterator iter(p, ec);
       if (ec) return -1;
-      for (auto&& de : recursive_directory_iterator(p)) {
-        remove(de, ec);
+      for (; iter != directory_iterator(); ++iter) {
+        n += remove_all(iter->path(), ec);
         if (ec) return -1;
-        n++;
       }
-      n += static_cast<uintmax_t>(remove(p, ec));
     }
-    if (ec) return -1;
-    return n;
+    if ((directory ? ::rmdir(p.c_str()) : ::unlink(p.c_str())) != 0) {
+      ec = {errno, std::system_category()};
+      return -1;
+    }
+    ec.clear();
+    return n + 1;
   }
 
 
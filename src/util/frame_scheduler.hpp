@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "util/histogram.hpp"
+
+namespace otto::util {
+
+  /// Paces a loop, like the UI loop, to a frame rate
+  ///
+  /// The frames are due on a grid of absolute deadlines on a steady clock, so the rate does not
+  /// drift with the time spent in each frame, and a slow frame never leads to a negative
+  /// sleep. When a frame is late by more than a period, the frames it missed are skipped
+  /// instead of being rushed through, so the loop does not compete with the audio thread in a
+  /// burst.
+  ///
+  /// ```cpp
+  /// FrameScheduler scheduler;
+  /// while (running) {
+  ///   draw();
+  ///   scheduler.wait(std::chrono::duration<double>(1 / fps));
+  /// }
+  /// ```
+  struct FrameScheduler {
+    using clock = std::chrono::steady_clock;
+    using duration = std::chrono::duration<double>;
+
+    /// The frame times recorded, in seconds
+    using Histogram = util::Histogram<100>;
+
+    /// Sleep until the next frame is due, `period` after the last one
+    ///
+    /// \returns the number of frames skipped
+    int wait(duration period)
+    {
+      int skipped = _skipped;
+      auto deadline = advance(clock::now(), period);
+      std::this_thread::sleep_until(deadline);
+      return _skipped - skipped;
+    }
+
+    /// Move on to the next frame at time `now`, without sleeping
+    ///
+    /// Records the time since the last frame was due as the time of that frame.
+    ///
+    /// \returns the time the next frame is due
+    clock::time_point advance(clock::time_point now, duration period) noexcept
+    {
+      auto step = std::chrono::duration_cast<clock::duration>(period);
+      if (!_started) {
+        _started = true;
+        _deadline = now + step;
+        return _deadline;
+      }
+      _frame_times.add(duration(now - _deadline).count());
+      _deadline += step;
+      if (now >= _deadline && step.count() > 0) {
+        // Skip to the first deadline after now
+        long missed = (now - _deadline) / step + 1;
+        _deadline += missed * step;
+        _skipped += missed;
+      }
+      return _deadline;
+    }
+
+    /// Start over on a new grid, e.g. after the loop has been paused
+    void reset() noexcept
+    {
+      _started = false;
+    }
+
+    /// The histogram of the frame times, from 0 to 50 ms
+    const Histogram& frame_times() const noexcept
+    {
+      return _frame_times;
+    }
+
+    /// The total number of frames skipped
+    int skipped() const noexcept
+    {
+      return _skipped;
+    }
+
+  private:
+    bool _started = false;
+    clock::time_point _deadline;
+    int _skipped = 0;
+    Histogram _frame_times = {0, 0.05};
+  };
+
+} // namespace otto::util
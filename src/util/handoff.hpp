@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace otto::util {
+
+  /// Hands objects from a producer thread over to the audio thread
+  ///
+  /// The producer calls @ref publish with new objects, and the audio thread picks up the latest
+  /// one with @ref acquire at the start of each buffer. Neither side ever locks, and the audio
+  /// thread never allocates or deletes: the objects it replaces are put on a lock-free list,
+  /// which the producer deletes on its next call, or in @ref collect.
+  ///
+  /// There may be only one producer thread and one consumer thread.
+  template<typename T>
+  struct Handoff {
+    Handoff() = default;
+    Handoff(const Handoff&) = delete;
+    Handoff& operator=(const Handoff&) = delete;
+
+    ~Handoff() noexcept
+    {
+      delete _current;
+      delete _pending.exchange(nullptr);
+      collect();
+    }
+
+    /// Publish a new object, to be picked up by the next call to @ref acquire
+    ///
+    /// An object published earlier, but not yet acquired, is deleted. Only to be called from
+    /// the producer thread.
+    void publish(std::unique_ptr<T> value)
+    {
+      collect();
+      delete _pending.exchange(new Node{std::move(value)}, std::memory_order_acq_rel);
+    }
+
+    /// Pick up the latest published object, and get the current one
+    ///
+    /// Only to be called from the consumer thread.
+    ///
+    /// \returns `nullptr` if nothing has been published yet
+    T* acquire() noexcept
+    {
+      if (auto* node = _pending.exchange(nullptr, std::memory_order_acq_rel)) {
+        if (auto* old = std::exchange(_current, node)) retire(old);
+      }
+      return get();
+    }
+
+    /// The current object, as of the last call to @ref acquire
+    ///
+    /// Only to be called from the consumer thread.
+    T* get() const noexcept
+    {
+      return _current ? _current->value.get() : nullptr;
+    }
+
+    /// Delete the objects replaced by the consumer. Only to be called from the producer thread.
+    void collect() noexcept
+    {
+      auto* node = _retired.exchange(nullptr, std::memory_order_acquire);
+      while (node != nullptr) {
+        delete std::exchange(node, node->next_retired);
+      }
+    }
+
+  private:
+    struct Node {
+      std::unique_ptr<T> value;
+      Node* next_retired = nullptr;
+    };
+
+    void retire(Node* node) noexcept
+    {
+      node->next_retired = _retired.load(std::memory_order_relaxed);
+      while (!_retired.compare_exchange_weak(node->next_retired, node, std::memory_order_release,
+                                             std::memory_order_relaxed))
+        ;
+    }
+
+    /// Owned by the consumer
+    Node* _current = nullptr;
+    std::atomic<Node*> _pending = nullptr;
+    std::atomic<Node*> _retired = nullptr;
+  };
+
+} // namespace otto::util
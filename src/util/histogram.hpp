@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace otto::util {
+
+  /// A lock-free histogram with `N` linear buckets over `[min, max)`
+  ///
+  /// Values below `min` or above `max` are counted in the first or last bucket. Any thread may
+  /// @ref add, and reading never blocks the writers, so it is safe to feed from the audio
+  /// thread and display from the UI thread.
+  template<std::size_t N>
+  struct Histogram {
+    static_assert(N > 0);
+
+    static constexpr std::size_t bucket_count = N;
+
+    Histogram(double min, double max) noexcept : _min(min), _max(max) {}
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void add(double value) noexcept
+    {
+      _buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// The bucket index of `value`
+    std::size_t bucket_of(double value) const noexcept
+    {
+      double pos = (value - _min) / (_max - _min) * N;
+      return std::clamp<double>(pos, 0, N - 1);
+    }
+
+    /// The lower bound of bucket `index`
+    double lower_bound(std::size_t index) const noexcept
+    {
+      return _min + (_max - _min) * index / N;
+    }
+
+    /// A snapshot of the counts of all buckets
+    std::array<int, N> counts() const noexcept
+    {
+      std::array<int, N> res;
+      for (std::size_t i = 0; i < N; i++) res[i] = _buckets[i].load(std::memory_order_relaxed);
+      return res;
+    }
+
+    /// The total number of values added
+    int total() const noexcept
+    {
+      int res = 0;
+      for (auto& b : _buckets) res += b.load(std::memory_order_relaxed);
+      return res;
+    }
+
+    /// The upper bound of the bucket containing the `q` quantile, with `q` in `[0, 1]`
+    ///
+    /// \returns `min` if the histogram is empty
+    double quantile(double q) const noexcept
+    {
+      auto c = counts();
+      int total = 0;
+      for (int n : c) total += n;
+      if (total == 0) return _min;
+      double target = q * total;
+      int sum = 0;
+      for (std::size_t i = 0; i < N; i++) {
+        sum += c[i];
+        if (sum >= target && sum > 0) return lower_bound(i + 1);
+      }
+      return _max;
+    }
+
+    void clear() noexcept
+    {
+      for (auto& b : _buckets) b.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    double _min;
+    double _max;
+    std::array<std::atomic_int, N> _buckets = {};
+  };
+
+} // namespace otto::util
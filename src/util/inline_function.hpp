@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace otto::util {
+
+  template<typename Signature, std::size_t Size = 4 * sizeof(void*)>
+  struct InlineFunction;
+
+  /// A `std::function` that stores small callables inline
+  ///
+  /// Callables of up to `Size` bytes, like lambdas capturing `this` and a few values, are
+  /// stored in the object itself, so constructing, copying and calling one never touches the
+  /// heap. Larger callables are allocated on the heap, like with `std::function`.
+  ///
+  /// Calling an empty function throws `std::bad_function_call`.
+  template<typename R, typename... Args, std::size_t Size>
+  struct InlineFunction<R(Args...), Size> {
+    /// Whether a callable of type `F` is stored inline
+    template<typename F>
+    static constexpr bool is_inline = sizeof(F) <= Size && alignof(F) <= alignof(std::max_align_t) &&
+                                      std::is_nothrow_move_constructible_v<F>;
+
+    InlineFunction() noexcept = default;
+    InlineFunction(std::nullptr_t) noexcept {}
+
+    template<typename F,
+             typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InlineFunction> &&
+                                         std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+    InlineFunction(F&& f)
+    {
+      using Fn = std::decay_t<F>;
+      if constexpr (is_inline<Fn>) {
+        new (&_storage) Fn(std::forward<F>(f));
+      } else {
+        new (&_storage) Fn*(new Fn(std::forward<F>(f)));
+      }
+      _ops = &ops_for<Fn>;
+    }
+
+    InlineFunction(const InlineFunction& rhs) : _ops(rhs._ops)
+    {
+      if (_ops) _ops->copy(&rhs._storage, &_storage);
+    }
+
+    InlineFunction(InlineFunction&& rhs) noexcept : _ops(rhs._ops)
+    {
+      if (_ops) _ops->move(&rhs._storage, &_storage);
+      rhs._ops = nullptr;
+    }
+
+    InlineFunction& operator=(const InlineFunction& rhs)
+    {
+      if (this != &rhs) *this = InlineFunction(rhs);
+      return *this;
+    }
+
+    InlineFunction& operator=(InlineFunction&& rhs) noexcept
+    {
+      if (this == &rhs) return *this;
+      reset();
+      _ops = rhs._ops;
+      if (_ops) _ops->move(&rhs._storage, &_storage);
+      rhs._ops = nullptr;
+      return *this;
+    }
+
+    ~InlineFunction() noexcept
+    {
+      reset();
+    }
+
+    R operator()(Args... args) const
+    {
+      if (!_ops) throw std::bad_function_call();
+      return _ops->invoke(&_storage, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept
+    {
+      return _ops != nullptr;
+    }
+
+  private:
+    /// The operations on the stored callable. The moved-from storage is destroyed by `move`.
+    struct Ops {
+      R (*invoke)(void*, Args&&...);
+      void (*copy)(const void* src, void* dst);
+      void (*move)(void* src, void* dst) noexcept;
+      void (*destroy)(void*) noexcept;
+    };
+
+    template<typename Fn>
+    static Fn& get(void* storage) noexcept
+    {
+      if constexpr (is_inline<Fn>) {
+        return *std::launder(static_cast<Fn*>(storage));
+      } else {
+        return **std::launder(static_cast<Fn**>(storage));
+      }
+    }
+
+    template<typename Fn>
+    static inline const Ops ops_for = {
+      [](void* s, Args&&... args) -> R { return std::invoke(get<Fn>(s), std::forward<Args>(args)...); },
+      [](const void* src, void* dst) {
+        auto& f = get<Fn>(const_cast<void*>(src));
+        if constexpr (is_inline<Fn>) {
+          new (dst) Fn(f);
+        } else {
+          new (dst) Fn*(new Fn(f));
+        }
+      },
+      [](void* src, void* dst) noexcept {
+        if constexpr (is_inline<Fn>) {
+          new (dst) Fn(std::move(get<Fn>(src)));
+          get<Fn>(src).~Fn();
+        } else {
+          new (dst) Fn*(*static_cast<Fn**>(src));
+        }
+      },
+      [](void* s) noexcept {
+        if constexpr (is_inline<Fn>) {
+          get<Fn>(s).~Fn();
+        } else {
+          delete &get<Fn>(s);
+        }
+      },
+    };
+
+    void reset() noexcept
+    {
+      if (_ops) _ops->destroy(&_storage);
+      _ops = nullptr;
+    }
+
+    const Ops* _ops = nullptr;
+    mutable std::aligned_storage_t<Size, alignof(std::max_align_t)> _storage;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,141 @@
+#include "json_reader.hpp"
+
+namespace otto::util {
+
+  bool JsonReader::null()
+  {
+    if (!_buffer_stack.empty()) return value(nullptr);
+    // Left as it is, like `util::deserialize` does
+    advance();
+    return true;
+  }
+
+  bool JsonReader::boolean(bool val)
+  {
+    return value(val);
+  }
+
+  bool JsonReader::number_integer(number_integer_t val)
+  {
+    return value(val);
+  }
+
+  bool JsonReader::number_unsigned(number_unsigned_t val)
+  {
+    return value(val);
+  }
+
+  bool JsonReader::number_float(number_float_t val, const string_t&)
+  {
+    return value(val);
+  }
+
+  bool JsonReader::string(string_t& val)
+  {
+    return value(std::move(val));
+  }
+
+  bool JsonReader::start_object(std::size_t)
+  {
+    return start(false);
+  }
+
+  bool JsonReader::key(string_t& val)
+  {
+    if (!_buffer_stack.empty()) {
+      _buffer_key = std::move(val);
+      return true;
+    }
+    auto& top = _stack.back().target;
+    _next = top.has_members() ? top.member(val) : JsonTarget();
+    return true;
+  }
+
+  bool JsonReader::end_object()
+  {
+    return end();
+  }
+
+  bool JsonReader::start_array(std::size_t)
+  {
+    return start(true);
+  }
+
+  bool JsonReader::end_array()
+  {
+    return end();
+  }
+
+  bool JsonReader::parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex)
+  {
+    _error = ex.what();
+    return false;
+  }
+
+  bool JsonReader::value(nlohmann::json&& value)
+  {
+    if (!_buffer_stack.empty()) {
+      auto& parent = *_buffer_stack.back();
+      if (parent.is_array()) {
+        parent.push_back(std::move(value));
+      } else {
+        parent[_buffer_key] = std::move(value);
+      }
+      return true;
+    }
+    _next.read(std::move(value));
+    advance();
+    return true;
+  }
+
+  bool JsonReader::start(bool is_array)
+  {
+    auto container = is_array ? nlohmann::json::array() : nlohmann::json::object();
+    if (!_buffer_stack.empty()) {
+      // Nothing is added to a parent until its child is done, so the pointer stays valid
+      auto& parent = *_buffer_stack.back();
+      auto& child = parent.is_array() ? (parent.push_back(std::move(container)), parent.back())
+                                      : (parent[_buffer_key] = std::move(container));
+      _buffer_stack.push_back(&child);
+      return true;
+    }
+    if (_next.skips() || (is_array ? _next.has_elements() : _next.has_members())) {
+      _stack.push_back({_next, is_array});
+      _next = is_array && _next.has_elements() ? _next.element(0) : JsonTarget();
+      return true;
+    }
+    // Read as a whole
+    _buffer = std::move(container);
+    _buffer_stack.push_back(&_buffer);
+    return true;
+  }
+
+  bool JsonReader::end()
+  {
+    if (!_buffer_stack.empty()) {
+      _buffer_stack.pop_back();
+      if (_buffer_stack.empty()) {
+        _next.read(std::move(_buffer));
+        _buffer = nullptr;
+        advance();
+      }
+      return true;
+    }
+    _stack.pop_back();
+    advance();
+    return true;
+  }
+
+  void JsonReader::advance()
+  {
+    if (_stack.empty() || !_stack.back().is_array) {
+      // The next key decides the next target
+      _next = {};
+      return;
+    }
+    auto& top = _stack.back();
+    top.index++;
+    _next = top.target.has_elements() ? top.target.element(top.index) : JsonTarget();
+  }
+
+} // namespace otto::util
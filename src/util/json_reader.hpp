@@ -0,0 +1,212 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <json.hpp>
+
+#include "util/reflection.hpp"
+#include "util/serialize.hpp"
+
+namespace otto::util {
+
+  /// A reference to an object that json is read into, while it is parsed
+  ///
+  /// Objects of classes registered for reflection, whose members can all be referenced, are read
+  /// member by member, and `std::array`s element by element, so only the values of other types
+  /// are ever held as json. Those are read as a whole with `util::deserialize`, like properties,
+  /// whose members are accessed through a getter and a setter.
+  ///
+  /// Unlike `util::deserialize`, members missing from the json are left as they are, and
+  /// unknown members, and elements past the end of an array, are skipped. Like it, null values
+  /// are skipped too.
+  struct JsonTarget {
+    /// How values are read into an object of some type
+    struct Ops {
+      /// Read a whole value
+      void (*read)(void* obj, nlohmann::json&& value);
+      /// The target of the member `key` of an object, or a target that skips it. `nullptr` if
+      /// the object is read as a whole.
+      JsonTarget (*member)(void* obj, std::string_view key);
+      /// The target of element `index` of an array, or a target that skips it. `nullptr` if
+      /// the array is read as a whole.
+      JsonTarget (*element)(void* obj, std::size_t index);
+    };
+
+    /// A target that skips the value
+    JsonTarget() = default;
+
+    JsonTarget(void* obj, const Ops& ops) noexcept : _obj(obj), _ops(&ops) {}
+
+    /// Read into `obj`, which must outlive the target
+    template<typename T>
+    static JsonTarget of(T& obj) noexcept;
+
+    /// Whether values are skipped
+    bool skips() const noexcept
+    {
+      return _ops == nullptr;
+    }
+
+    /// Whether objects are read member by member
+    bool has_members() const noexcept
+    {
+      return _ops && _ops->member;
+    }
+
+    /// Whether arrays are read element by element
+    bool has_elements() const noexcept
+    {
+      return _ops && _ops->element;
+    }
+
+    /// Read a whole value
+    void read(nlohmann::json&& value) const
+    {
+      if (_ops) _ops->read(_obj, std::move(value));
+    }
+
+    /// \requires `has_members()`
+    JsonTarget member(std::string_view key) const
+    {
+      return _ops->member(_obj, key);
+    }
+
+    /// \requires `has_elements()`
+    JsonTarget element(std::size_t index) const
+    {
+      return _ops->element(_obj, index);
+    }
+
+  private:
+    void* _obj = nullptr;
+    const Ops* _ops = nullptr;
+  };
+
+  /// Reads json into a @ref JsonTarget as it is parsed, for `nlohmann::json::sax_parse`
+  ///
+  /// Builds no tree of the whole document, only of the values read as a whole, so reading a
+  /// large file takes neither a second pass nor the memory of all of it at once.
+  struct JsonReader final : nlohmann::json_sax<nlohmann::json> {
+    explicit JsonReader(JsonTarget root) : _next(root) {}
+
+    bool null() override;
+    bool boolean(bool val) override;
+    bool number_integer(number_integer_t val) override;
+    bool number_unsigned(number_unsigned_t val) override;
+    bool number_float(number_float_t val, const string_t& s) override;
+    bool string(string_t& val) override;
+    bool start_object(std::size_t elements) override;
+    bool key(string_t& val) override;
+    bool end_object() override;
+    bool start_array(std::size_t elements) override;
+    bool end_array() override;
+    bool parse_error(std::size_t position,
+                     const std::string& last_token,
+                     const nlohmann::detail::exception& ex) override;
+
+    /// The message of the parse error, if there was one
+    const std::string& error() const noexcept
+    {
+      return _error;
+    }
+
+  private:
+    struct Frame {
+      JsonTarget target;
+      bool is_array;
+      std::size_t index = 0;
+    };
+
+    /// Read a scalar into the current target, or add it to the buffered value
+    bool value(nlohmann::json&& value);
+    /// Enter an object or array
+    bool start(bool is_array);
+    /// Leave an object or array
+    bool end();
+    /// Move on to the next element, when in an array
+    void advance();
+
+    std::vector<Frame> _stack;
+    /// The target of the next value
+    JsonTarget _next;
+    /// The value being buffered for a target that reads it as a whole
+    nlohmann::json _buffer;
+    std::vector<nlohmann::json*> _buffer_stack;
+    std::string _buffer_key;
+    std::string _error;
+  };
+
+  namespace detail {
+    template<typename T>
+    struct is_std_array : std::false_type {};
+
+    template<typename T, std::size_t N>
+    struct is_std_array<std::array<T, N>> : std::true_type {};
+
+    template<typename Members>
+    struct all_referenced;
+
+    template<typename... Members>
+    struct all_referenced<std::tuple<Members...>>
+      : std::bool_constant<(Members::can_get_ref() && ...)> {};
+
+    template<typename T>
+    struct JsonTargetOps {
+      static void read(void* obj, nlohmann::json&& value)
+      {
+        auto& o = *static_cast<T*>(obj);
+        if constexpr (std::is_same_v<T, nlohmann::json>) {
+          o = std::move(value);
+        } else {
+          deserialize(o, value);
+        }
+      }
+
+      static JsonTarget member(void* obj, std::string_view key)
+      {
+        JsonTarget res;
+        reflect::for_all_members<T>([&](auto& member) {
+          if constexpr (std::decay_t<decltype(member)>::can_get_ref()) {
+            if (std::string_view(member.get_name()) == key) {
+              res = JsonTarget::of(member.get_ref(*static_cast<T*>(obj)));
+            }
+          }
+        });
+        return res;
+      }
+
+      static JsonTarget element(void* obj, std::size_t index)
+      {
+        if constexpr (is_std_array<T>::value) {
+          auto& arr = *static_cast<T*>(obj);
+          if (index < arr.size()) return JsonTarget::of(arr[index]);
+        }
+        return {};
+      }
+
+      static constexpr bool by_member = [] {
+        if constexpr (reflect::is_registered<T>()) {
+          return all_referenced<std::decay_t<decltype(reflect::get_members<T>())>>::value;
+        } else {
+          return false;
+        }
+      }();
+
+      static inline const JsonTarget::Ops ops = {&read, by_member ? &member : nullptr,
+                                                 is_std_array<T>::value ? &element : nullptr};
+    };
+  } // namespace detail
+
+  template<typename T>
+  JsonTarget JsonTarget::of(T& obj) noexcept
+  {
+    return {&obj, detail::JsonTargetOps<T>::ops};
+  }
+
+} // namespace otto::util
@@ -1,15 +1,29 @@
 #include "jsonfile.hpp"
 
 #include <fstream>
-#include <iomanip>
+#include <vector>
 #include <json.hpp>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace otto::util {
 
   using json = nlohmann::json;
 
-  JsonFile::JsonFile(const fs::path& p)
-    : _path (p)
+  static bool sax_parse(JsonReader& reader,
+                        const std::vector<std::uint8_t>& bytes,
+                        JsonFile::Format format)
+  {
+    return json::sax_parse(nlohmann::detail::input_adapter(bytes.begin(), bytes.end()), &reader,
+                           format == JsonFile::Format::msgpack ? json::input_format_t::msgpack
+                                                               : json::input_format_t::json);
+  }
+
+  JsonFile::JsonFile(const fs::path& p, Format format)
+    : _path (p), _format(format)
   {}
 
   void JsonFile::write(JsonFile::OpenOptions options)
@@ -17,42 +31,119 @@ namespace otto::util {
     if (auto ec = validate(); ec != ErrorCode::none) {
       throw exception(ec, "Error while writing preset file '{}'", _path.c_str());
     }
+    write_encoded(encode(_data, _format), options);
+  }
+
+  std::vector<std::uint8_t> JsonFile::encode(const nlohmann::json& data, Format format)
+  {
+    if (format == Format::msgpack) return json::to_msgpack(data);
+    auto text = data.dump(2) + "\n";
+    return {text.begin(), text.end()};
+  }
+
+  void JsonFile::write_encoded(const std::vector<std::uint8_t>& bytes, OpenOptions options) const
+  {
+    fs::path dir_p = _path;
+    dir_p.remove_filename();
     if (!fs::exists(_path) && (options & OpenOptions::create) != OpenOptions::none) {
-      fs::path dir_p = _path;
-      dir_p.remove_filename();
       fs::create_directories(dir_p);
     }
+    // Write a temporary file next to the real one, and rename it over the real one when it is
+    // safely on disk, so a crash or power cut leaves either the old or the new file
+    fs::path tmp_p = _path;
+    tmp_p += ".tmp";
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(tmp_p.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::system_error(errno, std::system_category());
+    for (std::size_t done = 0; done < bytes.size();) {
+      auto res = ::write(fd, bytes.data() + done, bytes.size() - done);
+      if (res < 0 && errno == EINTR) continue;
+      if (res < 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::system_category());
+      }
+      done += res;
+    }
+    if (::fsync(fd) != 0 || ::close(fd) != 0) {
+      throw std::system_error(errno, std::system_category());
+    }
+    fs::rename(tmp_p, _path);
+    // Make the rename itself durable
+    if (int dir_fd = ::open(dir_p.empty() ? "." : dir_p.c_str(), O_RDONLY); dir_fd >= 0) {
+      ::fsync(dir_fd);
+      ::close(dir_fd);
+    }
+#else
     errno = 0;
-    std::ofstream stream(_path, std::ios::trunc);
-    stream << std::setw(2) << _data << std::endl;
+    std::ofstream stream(tmp_p, std::ios::trunc | std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
     stream.close();
     if (errno) {
       throw std::system_error(errno, std::system_category());
     }
+    fs::rename(tmp_p, _path);
+#endif
   }
 
-  void JsonFile::read(JsonFile::OpenOptions options)
+  std::vector<std::uint8_t> JsonFile::read_bytes(OpenOptions options)
   {
     std::ifstream stream;
-    stream.open(_path);
+    stream.open(_path, std::ios::binary | std::ios::ate);
     if (!stream) {
       if ((options & OpenOptions::create) != OpenOptions::none) {
         stream.close();
         write(options);
-        stream.open(_path);
+        stream.open(_path, std::ios::binary | std::ios::ate);
       }
     }
     if (!stream) {
       throw std::system_error(errno, std::system_category());
     }
-    _data.clear();
-    stream >> _data;
-    stream.close();
+    std::vector<std::uint8_t> bytes(stream.tellg());
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    return bytes;
+  }
+
+  void JsonFile::read(JsonFile::OpenOptions options)
+  {
+    auto bytes = read_bytes(options);
+    try {
+      if (_format == Format::msgpack) {
+        _data = json::from_msgpack(bytes.begin(), bytes.end());
+      } else {
+        _data = json::parse(bytes.begin(), bytes.end());
+      }
+    } catch (json::exception& e) {
+      throw exception(ErrorCode::invalid_json, "Error while reading file '{}': {}", _path.c_str(),
+                      e.what());
+    }
     if (auto ec = validate(); ec != ErrorCode::none) {
       throw exception(ec, "Error while reading preset file '{}'", _path.c_str());
     }
   }
 
+  void JsonFile::read_into(JsonTarget target, OpenOptions options)
+  {
+    auto bytes = read_bytes(options);
+    JsonReader reader(target);
+    if (!sax_parse(reader, bytes, _format)) {
+      throw exception(ErrorCode::invalid_json, "Error while reading file '{}': {}", _path.c_str(),
+                      reader.error());
+    }
+  }
+
+  void JsonFile::decode_into(JsonTarget target,
+                             const std::vector<std::uint8_t>& bytes,
+                             Format format)
+  {
+    JsonReader reader(target);
+    if (!sax_parse(reader, bytes, format)) {
+      throw exception(ErrorCode::invalid_json, "Error while decoding: {}", reader.error());
+    }
+  }
+
 #pragma GCC diagnostic push 
 #pragma GCC diagnostic ignored "-Wreturn-type"
   std::string to_string(JsonFile::ErrorCode ec)
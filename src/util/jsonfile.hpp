@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <json.hpp>
 
 #include "filesystem.hpp"
 #include "util/exception.hpp"
+#include "util/json_reader.hpp"
 #include "util/macros.hpp"
 
 namespace otto::util {
@@ -26,33 +29,71 @@ namespace otto::util {
       create = 0b1  /// create file if it doesnt exist
     };
 
+    /// The encoding of the file
+    enum struct Format {
+      /// Indented json, to be read and edited by people
+      json,
+      /// MessagePack, the binary equivalent of json. Smaller, and faster to read and write.
+      msgpack,
+    };
+
     /// Constructor
     ///
     /// \postconditions `path() == p`
     /// \remarks remember to `read()` after construction
-    explicit JsonFile(const fs::path& p);
+    explicit JsonFile(const fs::path& p, Format format = Format::json);
 
     /// Virtual destructor
     virtual ~JsonFile() = default;
 
     /// Write the data to file
     ///
-    /// \effects serialize `data()`, and write it to `path()`. No filestreams
-    /// are left open.
+    /// \effects serialize `data()`, and write it to `path()` with @ref write_encoded. No
+    /// filestreams are left open.
     /// 
     /// \throws `exception` on parse failure, `fs::filesystem_error` or
     /// `std::system_error` on IO failure
     virtual void write(OpenOptions = OpenOptions::none);
 
+    /// Serialize `data` as it would be written to a file with `format`
+    static std::vector<std::uint8_t> encode(const nlohmann::json& data, Format format);
+
+    /// Write `bytes`, as returned by @ref encode, to `path()`
+    ///
+    /// The bytes are written to a temporary file, which is synced to disk and then renamed
+    /// over `path()`, so the file is never left half written. Does not touch `data()`, so it
+    /// may run on another thread while `data()` is changed.
+    ///
+    /// \throws `fs::filesystem_error` or `std::system_error` on IO failure
+    void write_encoded(const std::vector<std::uint8_t>& bytes,
+                       OpenOptions = OpenOptions::none) const;
+
     /// Read the data from file
     ///
-    /// \effects deserialize the data in `path()` and store it in `data()`. No
-    /// filestreams are left open.
+    /// \effects deserialize the data in `path()` and store it in `data()`. The file is read
+    /// with a single read call, and decoded from memory. No filestreams are left open.
     /// 
     /// \throws `exception` on parse failure, `fs::filesystem_error` or
     /// `std::system_error` on IO failure
     virtual void read(OpenOptions = OpenOptions::none);
 
+    /// Read the data from file straight into `target`, as it is parsed
+    ///
+    /// Takes about half the time of @ref read followed by `util::deserialize`, and never holds
+    /// all of the data as json. `data()` is not touched, and not validated, so @ref read is
+    /// still the way to look at the data as a whole.
+    ///
+    /// \throws same as @ref read, and what `target` throws for values that do not match it
+    void read_into(JsonTarget target, OpenOptions = OpenOptions::none);
+
+    /// Parse `bytes`, encoded in `format`, straight into `target`
+    ///
+    /// \throws `exception` on parse failure, and what `target` throws for values that do not
+    /// match it
+    static void decode_into(JsonTarget target,
+                            const std::vector<std::uint8_t>& bytes,
+                            Format format);
+
     /// Access the stored data
     nlohmann::json& data() noexcept { return _data; }
 
@@ -62,8 +103,13 @@ namespace otto::util {
     /// Access the path to the file
     const fs::path& path() const noexcept { return _path; }
 
+    Format format() const noexcept { return _format; }
+
   protected:
 
+    /// Read the whole file, creating it first if it is missing and `options` say so
+    std::vector<std::uint8_t> read_bytes(OpenOptions options);
+
     /// Validate the json data
     ///
     /// This should be implemented by classes that inherit from this one. It is
@@ -72,6 +118,7 @@ namespace otto::util {
 
     nlohmann::json _data = {};
     const fs::path _path;
+    const Format _format;
   };
 
   /// String representation of `JsonFile::ErrorCode`.
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <initializer_list>
+#include <utility>
 
 namespace otto::util {
 
@@ -10,6 +12,8 @@ namespace otto::util {
     using iterator = typename std::array<T, Capacity>::iterator;
     using const_iterator = typename std::array<T, Capacity>::const_iterator;
 
+    constexpr local_vector() noexcept = default;
+
     constexpr local_vector(std::initializer_list<value_type> il) : _data(il), _size(il.size()) {}
 
     // Queries
@@ -24,6 +28,11 @@ namespace otto::util {
       return _size;
     }
 
+    constexpr bool empty() const noexcept
+    {
+      return _size == 0;
+    }
+
     constexpr auto begin()
     {
       return _data.begin();
@@ -64,13 +73,45 @@ namespace otto::util {
       return _data[_size - 1];
     }
 
-    constexpr const value_type& operator[](std::size_t idx)
+    constexpr value_type& operator[](std::size_t idx)
     {
       return _data[idx];
     }
 
+    constexpr const value_type& operator[](std::size_t idx) const
+    {
+      return _data[idx];
+    }
+
+    // Modifiers
+
+    /// \requires `size() < capacity()`
+    constexpr void push_back(const value_type& v)
+    {
+      _data[_size++] = v;
+    }
+
+    /// \requires `size() < capacity()`
+    template<typename... Args>
+    constexpr value_type& emplace_back(Args&&... args)
+    {
+      return _data[_size++] = value_type(std::forward<Args>(args)...);
+    }
+
+    /// \requires `!empty()`
+    constexpr void pop_back()
+    {
+      _size--;
+    }
+
+    /// Remove all elements. The elements are not destroyed.
+    constexpr void clear() noexcept
+    {
+      _size = 0;
+    }
+
   private:
     std::array<value_type, capacity()> _data;
-    std::size_t _size;
+    std::size_t _size = 0;
   };
 } // namespace otto::util
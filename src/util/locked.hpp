@@ -86,6 +86,9 @@ namespace otto::util {
   /// The inner buffer can always be accessed lock-free,
   /// the outer is locked on swap.
   ///
+  /// Not for the audio thread, which must not lock. Use `TripleBuffer` to publish state from
+  /// the audio thread.
+  ///
   /// \tparam T needs .clear(), which is called on swap
   template<typename T, typename AfterSwap = clear_outer>
   struct double_buffered {
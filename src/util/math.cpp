@@ -0,0 +1,315 @@
+#include "math.hpp"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace otto::util::math::fast {
+
+  namespace {
+    // The operations the functions need, on four floats at once. There is no FMA, so the
+    // results match the scalar functions but for the rounding of the reductions.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    constexpr bool has_simd = true;
+    using vec = float32x4_t;
+    using ivec = int32x4_t;
+    using mask = uint32x4_t;
+    vec load(const float* p) noexcept
+    {
+      return vld1q_f32(p);
+    }
+    void store(float* p, vec v) noexcept
+    {
+      vst1q_f32(p, v);
+    }
+    vec splat(float f) noexcept
+    {
+      return vdupq_n_f32(f);
+    }
+    vec add(vec a, vec b) noexcept
+    {
+      return vaddq_f32(a, b);
+    }
+    vec sub(vec a, vec b) noexcept
+    {
+      return vsubq_f32(a, b);
+    }
+    vec mul(vec a, vec b) noexcept
+    {
+      return vmulq_f32(a, b);
+    }
+    vec div(vec a, vec b) noexcept
+    {
+      // 32 bit ARM has no division, so refine the estimate of the reciprocal twice
+      vec r = vrecpeq_f32(b);
+      r = vmulq_f32(vrecpsq_f32(b, r), r);
+      r = vmulq_f32(vrecpsq_f32(b, r), r);
+      return vmulq_f32(a, r);
+    }
+    vec clamp(vec x, float lo, float hi) noexcept
+    {
+      return vminq_f32(vmaxq_f32(x, vdupq_n_f32(lo)), vdupq_n_f32(hi));
+    }
+    vec abs(vec x) noexcept
+    {
+      return vabsq_f32(x);
+    }
+    mask greater(vec a, vec b) noexcept
+    {
+      return vcgtq_f32(a, b);
+    }
+    vec select(mask m, vec a, vec b) noexcept
+    {
+      return vbslq_f32(m, a, b);
+    }
+    vec copysign(vec mag, vec sign) noexcept
+    {
+      auto sign_bit = vdupq_n_u32(0x80000000);
+      return vbslq_f32(sign_bit, sign, mag);
+    }
+    /// Towards zero
+    ivec to_int(vec x) noexcept
+    {
+      return vcvtq_s32_f32(x);
+    }
+    vec to_float(ivec i) noexcept
+    {
+      return vcvtq_f32_s32(i);
+    }
+    ivec bits(vec x) noexcept
+    {
+      return vreinterpretq_s32_f32(x);
+    }
+    vec from_bits(ivec i) noexcept
+    {
+      return vreinterpretq_f32_s32(i);
+    }
+    ivec iadd(ivec a, std::int32_t b) noexcept
+    {
+      return vaddq_s32(a, vdupq_n_s32(b));
+    }
+    ivec isub(ivec a, ivec b) noexcept
+    {
+      return vsubq_s32(a, b);
+    }
+    ivec shift_left_23(ivec i) noexcept
+    {
+      return vshlq_n_s32(i, 23);
+    }
+    ivec shift_right_23(ivec i) noexcept
+    {
+      return vshrq_n_s32(i, 23);
+    }
+#elif defined(__SSE2__)
+    constexpr bool has_simd = true;
+    using vec = __m128;
+    using ivec = __m128i;
+    using mask = __m128;
+    vec load(const float* p) noexcept
+    {
+      return _mm_loadu_ps(p);
+    }
+    void store(float* p, vec v) noexcept
+    {
+      _mm_storeu_ps(p, v);
+    }
+    vec splat(float f) noexcept
+    {
+      return _mm_set1_ps(f);
+    }
+    vec add(vec a, vec b) noexcept
+    {
+      return _mm_add_ps(a, b);
+    }
+    vec sub(vec a, vec b) noexcept
+    {
+      return _mm_sub_ps(a, b);
+    }
+    vec mul(vec a, vec b) noexcept
+    {
+      return _mm_mul_ps(a, b);
+    }
+    vec div(vec a, vec b) noexcept
+    {
+      return _mm_div_ps(a, b);
+    }
+    vec clamp(vec x, float lo, float hi) noexcept
+    {
+      return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+    }
+    vec abs(vec x) noexcept
+    {
+      return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+    }
+    mask greater(vec a, vec b) noexcept
+    {
+      return _mm_cmpgt_ps(a, b);
+    }
+    vec select(mask m, vec a, vec b) noexcept
+    {
+      return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    }
+    vec copysign(vec mag, vec sign) noexcept
+    {
+      auto sign_bit = _mm_set1_ps(-0.f);
+      return _mm_or_ps(_mm_and_ps(sign_bit, sign), _mm_andnot_ps(sign_bit, mag));
+    }
+    /// Towards zero
+    ivec to_int(vec x) noexcept
+    {
+      return _mm_cvttps_epi32(x);
+    }
+    vec to_float(ivec i) noexcept
+    {
+      return _mm_cvtepi32_ps(i);
+    }
+    ivec bits(vec x) noexcept
+    {
+      return _mm_castps_si128(x);
+    }
+    vec from_bits(ivec i) noexcept
+    {
+      return _mm_castsi128_ps(i);
+    }
+    ivec iadd(ivec a, std::int32_t b) noexcept
+    {
+      return _mm_add_epi32(a, _mm_set1_epi32(b));
+    }
+    ivec isub(ivec a, ivec b) noexcept
+    {
+      return _mm_sub_epi32(a, b);
+    }
+    ivec shift_left_23(ivec i) noexcept
+    {
+      return _mm_slli_epi32(i, 23);
+    }
+    ivec shift_right_23(ivec i) noexcept
+    {
+      return _mm_srai_epi32(i, 23);
+    }
+#else
+    constexpr bool has_simd = false;
+    // Never used, but keeps the functions compiling
+    using vec = float;
+    vec load(const float* p) noexcept
+    {
+      return *p;
+    }
+    void store(float* p, vec v) noexcept
+    {
+      *p = v;
+    }
+#endif
+
+    /// Apply `vf` to the vectors of `src`, and `sf` to the rest
+    template<typename VF, typename SF>
+    void apply(const float* src, float* dst, int n, VF&& vf, SF&& sf) noexcept
+    {
+      int i = 0;
+      if constexpr (has_simd) {
+        for (; i + 4 <= n; i += 4) store(dst + i, vf(load(src + i)));
+      }
+      for (; i < n; i++) dst[i] = sf(src[i]);
+    }
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__SSE2__)
+    template<std::size_t N>
+    vec horner(const std::array<float, N>& poly, vec x) noexcept
+    {
+      vec p = splat(poly[0]);
+      for (std::size_t i = 1; i < N; i++) p = add(mul(p, x), splat(poly[i]));
+      return p;
+    }
+
+    vec floor(vec x) noexcept
+    {
+      vec i = to_float(to_int(x));
+      return sub(i, select(greater(i, x), splat(1), splat(0)));
+    }
+
+    vec vexp2(vec x) noexcept
+    {
+      x = clamp(x, -126.f, 126.f);
+      vec i = floor(x);
+      vec scale = from_bits(shift_left_23(iadd(to_int(i), 127)));
+      return mul(horner(detail::exp2_poly, sub(x, i)), scale);
+    }
+
+    vec vlog2(vec x) noexcept
+    {
+      ivec b = bits(x);
+      ivec e = shift_right_23(iadd(b, -detail::sqrt_half_bits));
+      vec t = sub(from_bits(isub(b, shift_left_23(e))), splat(1));
+      return add(to_float(e), mul(horner(detail::log2_poly, t), t));
+    }
+
+    vec vtanh(vec x) noexcept
+    {
+      return sub(splat(1), div(splat(2), add(vexp2(mul(splat(2.88539008f), x)), splat(1))));
+    }
+
+    vec vsin(vec x) noexcept
+    {
+      vec k = floor(add(mul(x, splat(0.159154943f)), splat(0.5f)));
+      x = sub(sub(x, mul(k, splat(6.28125f))), mul(k, splat(0.00193530718f)));
+      x = select(greater(abs(x), splat(1.57079633f)), sub(copysign(splat(3.14159265f), x), x), x);
+      return mul(horner(detail::sin_poly, mul(x, x)), x);
+    }
+#else
+    vec vexp2(vec x) noexcept
+    {
+      return fast::exp2(x);
+    }
+    vec vlog2(vec x) noexcept
+    {
+      return fast::log2(x);
+    }
+    vec vtanh(vec x) noexcept
+    {
+      return fast::tanh(x);
+    }
+    vec vsin(vec x) noexcept
+    {
+      return fast::sin(x);
+    }
+    vec mul(vec a, vec b) noexcept
+    {
+      return a * b;
+    }
+    vec splat(float f) noexcept
+    {
+      return f;
+    }
+#endif
+  } // namespace
+
+  void exp2(const float* src, float* dst, int n) noexcept
+  {
+    apply(src, dst, n, vexp2, [](float x) { return fast::exp2(x); });
+  }
+
+  void log2(const float* src, float* dst, int n) noexcept
+  {
+    apply(src, dst, n, vlog2, [](float x) { return fast::log2(x); });
+  }
+
+  void tanh(const float* src, float* dst, int n) noexcept
+  {
+    apply(src, dst, n, vtanh, [](float x) { return fast::tanh(x); });
+  }
+
+  void sin(const float* src, float* dst, int n) noexcept
+  {
+    apply(src, dst, n, vsin, [](float x) { return fast::sin(x); });
+  }
+
+  void db_to_gain(const float* src, float* dst, int n) noexcept
+  {
+    apply(
+      src, dst, n, [](vec x) { return vexp2(mul(splat(0.166096404f), x)); },
+      [](float x) { return fast::db_to_gain(x); });
+  }
+
+} // namespace otto::util::math::fast
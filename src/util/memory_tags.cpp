@@ -0,0 +1,59 @@
+#include "memory_tags.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+#include <fmt/format.h>
+
+namespace otto::util {
+
+  namespace {
+    struct Registry {
+      std::mutex mutex;
+      /// A deque, so the tags never move
+      std::deque<MemoryTag> tags;
+    };
+
+    Registry& registry()
+    {
+      // Never destroyed, so tags may be accounted to by static objects during exit
+      static auto* res = new Registry;
+      return *res;
+    }
+  } // namespace
+
+  MemoryTag& memory_tag(std::string_view name)
+  {
+    auto& reg = registry();
+    std::unique_lock lock(reg.mutex);
+    for (auto& tag : reg.tags) {
+      if (tag.name == name) return tag;
+    }
+    return reg.tags.emplace_back(std::string(name));
+  }
+
+  std::vector<MemoryTagStats> memory_tags()
+  {
+    auto& reg = registry();
+    std::vector<MemoryTagStats> res;
+    {
+      std::unique_lock lock(reg.mutex);
+      for (auto& tag : reg.tags) {
+        if (tag.peak() > 0) res.push_back({tag.name, tag.live(), tag.peak()});
+      }
+    }
+    std::stable_sort(res.begin(), res.end(), [](auto& a, auto& b) { return a.live > b.live; });
+    return res;
+  }
+
+  std::string memory_report()
+  {
+    std::string res = fmt::format("{:<24} {:>10} {:>10}\n", "Memory tag", "Live kB", "Peak kB");
+    for (auto& tag : memory_tags()) {
+      res += fmt::format("{:<24} {:>10.1f} {:>10.1f}\n", tag.name, tag.live / 1e3, tag.peak / 1e3);
+    }
+    return res;
+  }
+
+} // namespace otto::util
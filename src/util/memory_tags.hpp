@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace otto::util {
+
+  /// The memory held by one subsystem, like an engine, a cache or a service
+  ///
+  /// Counts the live bytes, and the most that were live at once. The counters are relaxed
+  /// atomics, so any thread may account, including the audio thread. Only memory that is
+  /// explicitly accounted is counted, through @ref TaggedAllocator, a tagged `Arena`, or by
+  /// calling @ref add and @ref remove, so the sum of the tags is less than the heap usage.
+  struct MemoryTag {
+    explicit MemoryTag(std::string name) : name(std::move(name)) {}
+
+    MemoryTag(const MemoryTag&) = delete;
+    MemoryTag& operator=(const MemoryTag&) = delete;
+
+    void add(std::size_t bytes) noexcept
+    {
+      auto live = _live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+      auto peak = _peak.load(std::memory_order_relaxed);
+      while (live > peak && !_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+      }
+    }
+
+    void remove(std::size_t bytes) noexcept
+    {
+      _live.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    std::size_t live() const noexcept
+    {
+      return _live.load(std::memory_order_relaxed);
+    }
+
+    std::size_t peak() const noexcept
+    {
+      return _peak.load(std::memory_order_relaxed);
+    }
+
+    const std::string name;
+
+  private:
+    std::atomic<std::size_t> _live = 0;
+    std::atomic<std::size_t> _peak = 0;
+  };
+
+  /// The tag named `name`, registered on first use
+  ///
+  /// Tags are never removed, so the reference stays valid for the rest of the program. Takes a
+  /// lock, so look the tag up once, not on the audio thread.
+  MemoryTag& memory_tag(std::string_view name);
+
+  struct MemoryTagStats {
+    std::string name;
+    std::size_t live;
+    std::size_t peak;
+  };
+
+  /// The tags that ever held memory, with the most live bytes first
+  std::vector<MemoryTagStats> memory_tags();
+
+  /// A table of @ref memory_tags, one tag per line, for the log
+  std::string memory_report();
+
+  /// A standard allocator that accounts its allocations to a @ref MemoryTag
+  template<typename T>
+  struct TaggedAllocator {
+    using value_type = T;
+
+    TaggedAllocator(MemoryTag& tag) noexcept : tag(&tag) {}
+
+    template<typename U>
+    TaggedAllocator(const TaggedAllocator<U>& rhs) noexcept : tag(rhs.tag)
+    {}
+
+    T* allocate(std::size_t n)
+    {
+      T* res = std::allocator<T>().allocate(n);
+      tag->add(n * sizeof(T));
+      return res;
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+      std::allocator<T>().deallocate(p, n);
+      tag->remove(n * sizeof(T));
+    }
+
+    MemoryTag* tag;
+  };
+
+  template<typename T, typename U>
+  bool operator==(const TaggedAllocator<T>& lhs, const TaggedAllocator<U>& rhs) noexcept
+  {
+    return lhs.tag == rhs.tag;
+  }
+
+  template<typename T, typename U>
+  bool operator!=(const TaggedAllocator<T>& lhs, const TaggedAllocator<U>& rhs) noexcept
+  {
+    return lhs.tag != rhs.tag;
+  }
+
+  /// A vector whose storage is accounted to a @ref MemoryTag
+  template<typename T>
+  using TaggedVector = std::vector<T, TaggedAllocator<T>>;
+
+} // namespace otto::util
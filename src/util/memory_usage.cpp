@@ -0,0 +1,45 @@
+#include "memory_usage.hpp"
+
+#include <cstdio>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace otto::util {
+
+  std::size_t heap_usage() noexcept
+  {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    // The fields of the older `mallinfo` are ints, which overflow above 2 GB
+    auto info = mallinfo();
+    return std::size_t(unsigned(info.uordblks)) + std::size_t(unsigned(info.hblkhd));
+#else
+    return 0;
+#endif
+  }
+
+  std::size_t resident_memory() noexcept
+  {
+#ifdef __linux__
+    std::FILE* file = std::fopen("/proc/self/statm", "r");
+    if (file == nullptr) return 0;
+    // The sizes are in pages: total program size, then resident
+    unsigned long size = 0, resident = 0;
+    int read = std::fscanf(file, "%lu %lu", &size, &resident);
+    std::fclose(file);
+    if (read != 2) return 0;
+    return std::size_t(resident) * std::size_t(::sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+  }
+
+} // namespace otto::util
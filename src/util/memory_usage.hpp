@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+namespace otto::util {
+
+  /// The number of bytes currently allocated on the heap by this process
+  ///
+  /// Includes large blocks allocated with `mmap`. Only implemented for glibc, elsewhere it
+  /// always returns 0. Not cheap enough for the audio thread.
+  std::size_t heap_usage() noexcept;
+
+  /// The number of bytes of this process resident in physical memory
+  ///
+  /// Read from `/proc/self/statm`, so it includes the code, stacks and mapped files, and
+  /// excludes what is swapped out. Only implemented for Linux, elsewhere it always returns 0.
+  /// Not cheap enough for the audio thread.
+  std::size_t resident_memory() noexcept;
+
+} // namespace otto::util
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace otto::util {
+
+  /// A bounded, lock-free multi-producer single-consumer queue
+  ///
+  /// Any number of threads may @ref push concurrently, while one thread, usually the audio
+  /// thread, calls @ref pop or @ref consume. No operation locks or allocates, and the consumer
+  /// never waits for a producer: a slot still being written simply ends the current
+  /// consume, and is picked up next time.
+  ///
+  /// Each slot carries a sequence number telling whether it is free for the producer of a given
+  /// position, or holds the value for the consumer of that position, as described by Dmitry
+  /// Vyukov for his bounded MPMC queue.
+  ///
+  /// \tparam T A trivially copyable value type
+  /// \tparam Capacity The maximum number of queued values. Must be a power of two.
+  template<typename T, std::size_t Capacity>
+  struct MPSCQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "MPSCQueue requires a trivially copyable type");
+
+    static constexpr std::size_t capacity = Capacity;
+
+    MPSCQueue() noexcept
+    {
+      for (std::size_t i = 0; i < capacity; i++) {
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    /// Add a value. Safe to call from any thread.
+    ///
+    /// \returns `false` if the queue is full, and the value was dropped
+    bool push(const T& value) noexcept
+    {
+      auto pos = _tail.load(std::memory_order_relaxed);
+      while (true) {
+        auto& slot = _slots[pos & mask];
+        auto seq = slot.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+        if (diff == 0) {
+          // The slot is free for this position. Claim it, or retry with the new tail.
+          if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            slot.value = value;
+            slot.sequence.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        } else if (diff < 0) {
+          // The slot still holds the value from one lap ago
+          return false;
+        } else {
+          pos = _tail.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    /// Take the oldest value. Only to be called from the consumer thread.
+    ///
+    /// \returns `false` if there was no value ready
+    bool pop(T& out) noexcept
+    {
+      auto& slot = _slots[_head & mask];
+      if (slot.sequence.load(std::memory_order_acquire) != _head + 1) return false;
+      out = slot.value;
+      slot.sequence.store(_head + capacity, std::memory_order_release);
+      _head++;
+      return true;
+    }
+
+    /// Pop values in order, passing each to `f`, while `f` returns `true`.
+    ///
+    /// Only to be called from the consumer thread. The value `f` returns `false` for stays in
+    /// the queue.
+    ///
+    /// \returns the number of values consumed
+    template<typename F>
+    std::size_t consume(F&& f) noexcept
+    {
+      std::size_t count = 0;
+      while (true) {
+        auto& slot = _slots[_head & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != _head + 1) break;
+        if (!f(static_cast<const T&>(slot.value))) break;
+        slot.sequence.store(_head + capacity, std::memory_order_release);
+        _head++;
+        count++;
+      }
+      return count;
+    }
+
+    /// Check if the queue is empty. Only meaningful on the consumer thread.
+    bool empty() const noexcept
+    {
+      return _slots[_head & mask].sequence.load(std::memory_order_acquire) != _head + 1;
+    }
+
+  private:
+    static constexpr std::size_t mask = capacity - 1;
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct Slot {
+      std::atomic<std::size_t> sequence;
+      T value;
+    };
+
+    std::array<Slot, capacity> _slots;
+    /// The next position to push to, shared by all producers
+    alignas(cache_line_size) std::atomic<std::size_t> _tail = 0;
+    /// The next position to pop from, only touched by the consumer
+    alignas(cache_line_size) std::size_t _head = 0;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,85 @@
+#include "page_memory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace otto::util {
+
+  namespace {
+    constexpr std::size_t round_up(std::size_t n, std::size_t multiple) noexcept
+    {
+      return (n + multiple - 1) / multiple * multiple;
+    }
+
+#ifndef __linux__
+    /// The alignment of the fallback allocation, where pages are not mapped
+    constexpr std::size_t page_alignment = 4096;
+#endif
+  } // namespace
+
+  PageMemory::PageMemory(std::size_t bytes, bool huge_pages)
+    : _bytes(std::max<std::size_t>(bytes, 1))
+  {
+#ifdef __linux__
+    constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (huge_pages) {
+      std::size_t size = round_up(_bytes, huge_page_size);
+      void* mem =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+      if (mem != MAP_FAILED) {
+        _data = mem;
+        _bytes = size;
+        _pages = Pages::huge;
+        _mapped = true;
+        return;
+      }
+      // Transparent huge pages are only used for whole, aligned huge pages, so map one more and
+      // trim the ends
+      mem = mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if (mem != MAP_FAILED) {
+        auto start = reinterpret_cast<std::uintptr_t>(mem);
+        auto aligned = round_up(start, huge_page_size);
+        if (aligned > start) munmap(mem, aligned - start);
+        if (auto tail = start + size + huge_page_size - (aligned + size); tail > 0) {
+          munmap(reinterpret_cast<void*>(aligned + size), tail);
+        }
+        _data = reinterpret_cast<void*>(aligned);
+        _bytes = size;
+        _mapped = true;
+        // Advise before touching, so the first faults already get huge pages. Fails if the kernel
+        // has no transparent huge pages, which leaves normal pages.
+        if (madvise(_data, _bytes, MADV_HUGEPAGE) == 0) _pages = Pages::transparent_huge;
+        std::memset(_data, 0, _bytes);
+        return;
+      }
+    }
+    _bytes = round_up(_bytes, sysconf(_SC_PAGESIZE));
+    void* mem = mmap(nullptr, _bytes, PROT_READ | PROT_WRITE, flags | MAP_POPULATE, -1, 0);
+    if (mem == MAP_FAILED) throw std::bad_alloc();
+    _data = mem;
+    _mapped = true;
+#else
+    (void) huge_pages;
+    _bytes = round_up(_bytes, page_alignment);
+    _data = ::operator new(_bytes, std::align_val_t(page_alignment));
+    std::memset(_data, 0, _bytes);
+#endif
+  }
+
+  PageMemory::~PageMemory() noexcept
+  {
+#ifdef __linux__
+    if (_mapped) munmap(_data, _bytes);
+#else
+    ::operator delete(_data, std::align_val_t(page_alignment));
+#endif
+  }
+
+} // namespace otto::util
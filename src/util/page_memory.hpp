@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+namespace otto::util {
+
+  /// A block of whole pages, allocated and touched up front
+  ///
+  /// On linux, the memory is mapped on its own pages, so it shares no page with the heap, and
+  /// is faulted in at construction, so the audio thread never takes a page fault on it. With
+  /// `huge_pages`, it is mapped from the explicit huge pages of the kernel if it has them to
+  /// spare, and otherwise advised to use transparent huge pages. A buffer on 2MB pages is
+  /// covered by a few TLB entries instead of hundreds. Elsewhere, it is allocated and zeroed.
+  ///
+  /// The memory is zeroed.
+  struct PageMemory {
+    /// The size of a huge page on the platforms we run on
+    static constexpr std::size_t huge_page_size = 2 << 20;
+
+    enum struct Pages {
+      /// Pages of the default size
+      normal,
+      /// Advised to use transparent huge pages, which the kernel may or may not grant
+      transparent_huge,
+      /// Mapped from the explicit huge pages of the kernel
+      huge,
+    };
+
+    /// \param bytes The size of the block. With huge pages, it is rounded up to a whole huge page
+    /// \throws `std::bad_alloc` if the memory could not be allocated
+    PageMemory(std::size_t bytes, bool huge_pages = false);
+    ~PageMemory() noexcept;
+
+    PageMemory(const PageMemory&) = delete;
+    PageMemory& operator=(const PageMemory&) = delete;
+
+    void* data() const noexcept
+    {
+      return _data;
+    }
+
+    /// The size of the block, including any rounding up
+    std::size_t size() const noexcept
+    {
+      return _bytes;
+    }
+
+    /// The pages the block was mapped from
+    Pages pages() const noexcept
+    {
+      return _pages;
+    }
+
+  private:
+    void* _data = nullptr;
+    std::size_t _bytes = 0;
+    Pages _pages = Pages::normal;
+    bool _mapped = false;
+  };
+
+} // namespace otto::util
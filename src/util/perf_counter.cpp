@@ -0,0 +1,71 @@
+#include "perf_counter.hpp"
+
+#ifdef __linux__
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace otto::util {
+
+#ifdef __linux__
+  namespace {
+    perf_event_attr attributes(PerfCounter::Event event) noexcept
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      switch (event) {
+        case PerfCounter::Event::dtlb_load_misses:
+          attr.type = PERF_TYPE_HW_CACHE;
+          attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+          break;
+        case PerfCounter::Event::dtlb_store_misses:
+          attr.type = PERF_TYPE_HW_CACHE;
+          attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+          break;
+        case PerfCounter::Event::cache_misses:
+          attr.type = PERF_TYPE_HARDWARE;
+          attr.config = PERF_COUNT_HW_CACHE_MISSES;
+          break;
+      }
+      return attr;
+    }
+  } // namespace
+
+  PerfCounter::PerfCounter(Event event) noexcept
+  {
+    auto attr = attributes(event);
+    // This thread, on any cpu
+    _fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  PerfCounter::~PerfCounter() noexcept
+  {
+    if (_fd >= 0) close(_fd);
+  }
+
+  std::uint64_t PerfCounter::read() const noexcept
+  {
+    std::uint64_t res = 0;
+    if (_fd < 0 || ::read(_fd, &res, sizeof(res)) != sizeof(res)) return 0;
+    return res;
+  }
+#else
+  PerfCounter::PerfCounter(Event) noexcept {}
+
+  PerfCounter::~PerfCounter() noexcept = default;
+
+  std::uint64_t PerfCounter::read() const noexcept
+  {
+    return 0;
+  }
+#endif
+
+} // namespace otto::util
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+namespace otto::util {
+
+  /// A hardware event counter of the calling thread, from `perf_event_open`
+  ///
+  /// For benchmarks, to see what a change does to the TLB and the caches, not only to the time.
+  /// Counting may not be available: on other platforms than Linux, in containers and virtual
+  /// machines without a PMU, or when `perf_event_paranoid` forbids it. Then @ref available is
+  /// false and @ref read returns 0, so a benchmark can still run and just leave the count out.
+  struct PerfCounter {
+    enum struct Event {
+      /// Misses in the data TLB, on loads
+      dtlb_load_misses,
+      /// Misses in the data TLB, on stores
+      dtlb_store_misses,
+      /// Misses in the last level cache
+      cache_misses,
+    };
+
+    explicit PerfCounter(Event event) noexcept;
+    ~PerfCounter() noexcept;
+
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    bool available() const noexcept
+    {
+      return _fd >= 0;
+    }
+
+    /// The count since the counter was constructed
+    std::uint64_t read() const noexcept;
+
+  private:
+    int _fd = -1;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace otto::util {
+
+  /// Shares a value the audio thread reads and other threads replace, read-copy-update style
+  ///
+  /// A published version is never changed. Writers build a new one, usually a copy of the latest
+  /// with a change, see @ref update, and @ref publish it, which swaps a pointer. The reader gets
+  /// the latest version with @ref read, which never waits and copies nothing. A version replaced
+  /// by a writer is retired, and deleted by @ref collect once the reader has passed an epoch, by
+  /// calling @ref read again, after which it can no longer hold the old version. Writers collect
+  /// on each publish, and any other thread but the reader may call @ref collect as well.
+  ///
+  /// There may be only one reader thread, usually the audio thread, and any number of writers.
+  /// A pointer from @ref read is valid until the next call to @ref read, so read once per buffer
+  /// and keep the pointer for the rest of it.
+  template<typename T>
+  struct Rcu {
+    explicit Rcu(T value = {}) : _current(new T(std::move(value))) {}
+
+    Rcu(const Rcu&) = delete;
+    Rcu& operator=(const Rcu&) = delete;
+
+    ~Rcu() noexcept
+    {
+      delete _current.load();
+      for (auto& r : _retired) delete r.value;
+    }
+
+    /// The latest version. Only to be called from the reader thread.
+    ///
+    /// Ends the use of the pointer returned by the previous call.
+    const T* read() noexcept
+    {
+      // The epochs are sequentially consistent with the swap in publish: if the reader sees the
+      // epoch a version was retired at, it also sees the version that replaced it
+      _reader_epoch.store(_epoch.load());
+      return _current.load();
+    }
+
+    /// Replace the value with `value`. May allocate, so not from the reader thread.
+    void publish(T value)
+    {
+      std::unique_lock lock(_write_mutex);
+      publish_locked(std::make_unique<T>(std::move(value)));
+    }
+
+    /// Publish a copy of the latest version, changed by `f(T&)`
+    ///
+    /// Writers are serialized, so concurrent updates are not lost.
+    template<typename F>
+    void update(F&& f)
+    {
+      std::unique_lock lock(_write_mutex);
+      auto next = std::make_unique<T>(*_current.load());
+      std::forward<F>(f)(*next);
+      publish_locked(std::move(next));
+    }
+
+    /// A copy of the latest version, for writers
+    T latest() const
+    {
+      std::unique_lock lock(_write_mutex);
+      return *_current.load();
+    }
+
+    /// Delete the retired versions the reader can no longer hold
+    void collect() noexcept
+    {
+      std::unique_lock lock(_write_mutex);
+      collect_locked();
+    }
+
+    /// The number of versions waiting for the reader to pass their epoch
+    std::size_t retired_count() const noexcept
+    {
+      std::unique_lock lock(_write_mutex);
+      return _retired.size();
+    }
+
+  private:
+    struct Retired {
+      const T* value;
+      std::uint64_t epoch;
+    };
+
+    void publish_locked(std::unique_ptr<T> next)
+    {
+      _retired.reserve(_retired.size() + 1);
+      const T* old = _current.exchange(next.release());
+      _retired.push_back({old, _epoch.fetch_add(1) + 1});
+      collect_locked();
+    }
+
+    void collect_locked() noexcept
+    {
+      auto reader = _reader_epoch.load();
+      auto last = std::remove_if(_retired.begin(), _retired.end(), [&](Retired& r) {
+        if (r.epoch > reader) return false;
+        delete r.value;
+        return true;
+      });
+      _retired.erase(last, _retired.end());
+    }
+
+    std::atomic<const T*> _current;
+    std::atomic<std::uint64_t> _epoch = 0;
+    /// The epoch the reader saw on its last read
+    std::atomic<std::uint64_t> _reader_epoch = 0;
+
+    mutable std::mutex _write_mutex;
+    std::vector<Retired> _retired;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,120 @@
+#include "realtime.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace otto::util {
+
+  bool lock_memory() noexcept
+  {
+#ifdef __GLIBC__
+    // Never trim the heap, and serve large blocks from the heap instead of separate mappings,
+    // which are unmapped when freed
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+#endif
+#ifdef __linux__
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#else
+    return false;
+#endif
+  }
+
+  void prefault_stack() noexcept
+  {
+    // Volatile, so the writes are not optimized away. One write per page is enough.
+    [[maybe_unused]] volatile char stack[prefault_stack_size];
+    for (std::size_t i = 0; i < prefault_stack_size; i += 1024) stack[i] = 0;
+  }
+
+  std::thread::native_handle_type current_thread() noexcept
+  {
+    return pthread_self();
+  }
+
+  bool pin_thread(std::thread::native_handle_type handle, gsl::span<const int> cores) noexcept
+  {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int core : cores) CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(handle, sizeof(cpus), &cpus) == 0;
+#else
+    return false;
+#endif
+  }
+
+  bool unpin_thread(std::thread::native_handle_type handle) noexcept
+  {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int core = 0; core < CPU_SETSIZE; core++) CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(handle, sizeof(cpus), &cpus) == 0;
+#else
+    return false;
+#endif
+  }
+
+  bool set_fifo_priority(std::thread::native_handle_type handle, int priority) noexcept
+  {
+#ifdef __linux__
+    sched_param param = {};
+    param.sched_priority = std::min(priority, sched_get_priority_max(SCHED_FIFO));
+    return pthread_setschedparam(handle, SCHED_FIFO, &param) == 0;
+#else
+    return false;
+#endif
+  }
+
+  bool set_normal_priority(std::thread::native_handle_type handle) noexcept
+  {
+#ifdef __linux__
+    sched_param param = {};
+    return pthread_setschedparam(handle, SCHED_OTHER, &param) == 0;
+#else
+    return false;
+#endif
+  }
+
+  bool set_idle_priority(std::thread::native_handle_type handle) noexcept
+  {
+#ifdef __linux__
+    sched_param param = {};
+    return pthread_setschedparam(handle, SCHED_IDLE, &param) == 0;
+#else
+    return false;
+#endif
+  }
+
+  int current_core() noexcept
+  {
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+  }
+
+  PageFaults thread_page_faults() noexcept
+  {
+#ifdef __linux__
+    rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) != 0) return {};
+    return {usage.ru_minflt, usage.ru_majflt};
+#else
+    return {};
+#endif
+  }
+
+} // namespace otto::util
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <thread>
+
+#include <gsl/span>
+
+namespace otto::util {
+
+  /// Lock all current and future memory of the process into RAM
+  ///
+  /// Uses `mlockall`, which also faults in every page that is mapped now, so the memory of
+  /// the engines and the buffer pool is resident before the first callback. Also keeps
+  /// `malloc` from handing freed memory back to the kernel, where it would fault again when
+  /// reused. Call it once at startup, after the engines are constructed. Locking needs
+  /// `CAP_IPC_LOCK` or a large enough `RLIMIT_MEMLOCK`.
+  ///
+  /// \returns false if the memory could not be locked, or on other platforms than Linux
+  bool lock_memory() noexcept;
+
+  /// The amount of stack touched by @ref prefault_stack
+  constexpr std::size_t prefault_stack_size = 128 * 1024;
+
+  /// Touch @ref prefault_stack_size bytes of stack below the calling function
+  ///
+  /// So the stack of a real-time thread does not grow, and fault, during its first callbacks.
+  void prefault_stack() noexcept;
+
+  /// The native handle of the calling thread, for @ref pin_thread and @ref set_fifo_priority
+  std::thread::native_handle_type current_thread() noexcept;
+
+  /// Allow the thread `handle` to run only on the cores `cores`
+  ///
+  /// \returns false if it could not be pinned, or on other platforms than Linux
+  bool pin_thread(std::thread::native_handle_type handle, gsl::span<const int> cores) noexcept;
+
+  /// Allow the thread `handle` to run only on `core`
+  inline bool pin_thread(std::thread::native_handle_type handle, int core) noexcept
+  {
+    return pin_thread(handle, gsl::span<const int>(&core, 1));
+  }
+
+  /// Allow the thread `handle` to run on every core again
+  ///
+  /// \returns false on failure, or on other platforms than Linux
+  bool unpin_thread(std::thread::native_handle_type handle) noexcept;
+
+  /// Give the thread `handle` the `SCHED_FIFO` priority `priority`, capped at the maximum
+  ///
+  /// \returns false if not permitted, or on other platforms than Linux
+  bool set_fifo_priority(std::thread::native_handle_type handle, int priority) noexcept;
+
+  /// Give the thread `handle` the default `SCHED_OTHER` policy
+  ///
+  /// \returns false on failure, or on other platforms than Linux
+  bool set_normal_priority(std::thread::native_handle_type handle) noexcept;
+
+  /// Give the thread `handle` the `SCHED_IDLE` policy, so it only runs when nothing else wants
+  /// the cpu
+  ///
+  /// \returns false on failure, or on other platforms than Linux
+  bool set_idle_priority(std::thread::native_handle_type handle) noexcept;
+
+  /// The core the calling thread runs on, or -1 if unknown
+  int current_core() noexcept;
+
+  /// The page faults of the calling thread since it started
+  struct PageFaults {
+    /// Faults served without disk io, like the first touch of a page
+    long minor = 0;
+    /// Faults that had to wait for the disk
+    long major = 0;
+
+    long total() const noexcept
+    {
+      return minor + major;
+    }
+  };
+
+  /// The page faults of the calling thread
+  ///
+  /// One system call, cheap enough to call once per audio callback.
+  PageFaults thread_page_faults() noexcept;
+
+} // namespace otto::util
@@ -8,7 +8,9 @@ namespace otto::util {
 
   // A simple array wrapper that provides an iterator that wraps across to the
   // end
-  // `N` should be a power of two for performance
+  // `N` should be a power of two for performance, in which case indices are masked
+  //
+  // Not thread safe. See `SPSCRing` for passing data between threads.
   template<typename T, std::size_t N>
   struct wrapping_array {
     static constexpr std::size_t size = N;
@@ -16,7 +18,11 @@ namespace otto::util {
     /// Get the buffer position corresponding to `position`
     static constexpr std::size_t wrap(std::size_t index)
     {
-      return index % size;
+      if constexpr ((size & (size - 1)) == 0) {
+        return index & (size - 1);
+      } else {
+        return index % size;
+      }
     }
 
     /// Specification for iterator
@@ -110,7 +116,7 @@ namespace otto::util {
     /// Get the buffer position corresponding to `position`
     static constexpr std::size_t wrap(std::size_t index)
     {
-      return index % capacity;
+      return Super::wrap(index);
     }
 
     void push(T v)
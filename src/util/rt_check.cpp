@@ -0,0 +1,178 @@
+#include "rt_check.hpp"
+
+#include <atomic>
+#include <cstddef>
+
+#if OTTO_RT_CHECKS && defined(__GLIBC__)
+#include <cstring>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// The implementations the interposed functions forward to
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+  using MutexLock = int (*)(pthread_mutex_t*);
+
+  /// The `pthread_mutex_lock` of libc. It has no `__libc_` alias.
+  MutexLock real_mutex_lock() noexcept
+  {
+    static MutexLock lock = reinterpret_cast<MutexLock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    return lock;
+  }
+
+  // Resolve it at startup, not on the audio thread
+  [[maybe_unused]] const MutexLock resolve_mutex_lock = real_mutex_lock();
+} // namespace
+#endif
+
+namespace otto::util {
+
+#if OTTO_RT_CHECKS
+
+  namespace {
+
+    enum struct Kind { allocation, deallocation, lock };
+
+    std::atomic_long allocations = 0;
+    std::atomic_long deallocations = 0;
+    std::atomic_long locks = 0;
+#ifdef NDEBUG
+    std::atomic_int traces_left = 0;
+#else
+    std::atomic_int traces_left = 16;
+#endif
+
+    // Initial exec, so reading them never allocates, even from the interposed malloc
+    __attribute__((tls_model("initial-exec"))) thread_local int realtime_depth = 0;
+    __attribute__((tls_model("initial-exec"))) thread_local int allow_depth = 0;
+    /// Set while reporting, so the allocations of `backtrace` are not reported
+    __attribute__((tls_model("initial-exec"))) thread_local bool reporting = false;
+
+    bool checking() noexcept
+    {
+      return realtime_depth > 0 && allow_depth == 0 && !reporting;
+    }
+
+    void report(Kind kind) noexcept
+    {
+      switch (kind) {
+      case Kind::allocation: allocations.fetch_add(1, std::memory_order_relaxed); break;
+      case Kind::deallocation: deallocations.fetch_add(1, std::memory_order_relaxed); break;
+      case Kind::lock: locks.fetch_add(1, std::memory_order_relaxed); break;
+      }
+#ifdef __GLIBC__
+      if (traces_left.fetch_sub(1, std::memory_order_relaxed) <= 0) return;
+      reporting = true;
+      const char* what = kind == Kind::allocation     ? "Heap allocation on the audio thread:\n"
+                         : kind == Kind::deallocation ? "Heap deallocation on the audio thread:\n"
+                                                      : "Mutex lock on the audio thread:\n";
+      // write and backtrace_symbols_fd do not allocate
+      [[maybe_unused]] auto written = ::write(STDERR_FILENO, what, std::strlen(what));
+      void* frames[32];
+      int count = backtrace(frames, 32);
+      backtrace_symbols_fd(frames, count, STDERR_FILENO);
+      reporting = false;
+#endif
+    }
+
+#ifdef __GLIBC__
+    /// `backtrace` loads libgcc on its first call, which should not happen on the audio thread
+    [[maybe_unused]] const int preload_backtrace = [] {
+      void* frame;
+      return backtrace(&frame, 1);
+    }();
+#endif
+
+  } // namespace
+
+  RealtimeScope::RealtimeScope() noexcept
+  {
+    realtime_depth++;
+  }
+
+  RealtimeScope::~RealtimeScope() noexcept
+  {
+    realtime_depth--;
+  }
+
+  AllowBlocking::AllowBlocking() noexcept
+  {
+    allow_depth++;
+  }
+
+  AllowBlocking::~AllowBlocking() noexcept
+  {
+    allow_depth--;
+  }
+
+  RealtimeViolations realtime_violations() noexcept
+  {
+    return {allocations.load(std::memory_order_relaxed), deallocations.load(std::memory_order_relaxed),
+            locks.load(std::memory_order_relaxed)};
+  }
+
+  void print_realtime_violations(int count) noexcept
+  {
+    traces_left.store(count, std::memory_order_relaxed);
+  }
+
+#else
+
+  RealtimeViolations realtime_violations() noexcept
+  {
+    return {};
+  }
+
+  void print_realtime_violations(int) noexcept {}
+
+#endif
+
+} // namespace otto::util
+
+#if OTTO_RT_CHECKS && defined(__GLIBC__)
+
+using otto::util::Kind;
+
+extern "C" {
+
+void* malloc(std::size_t size)
+{
+  if (otto::util::checking()) otto::util::report(Kind::allocation);
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size)
+{
+  if (otto::util::checking()) otto::util::report(Kind::allocation);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, std::size_t size)
+{
+  if (otto::util::checking()) otto::util::report(Kind::allocation);
+  return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+  if (ptr != nullptr && otto::util::checking()) otto::util::report(Kind::deallocation);
+  __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+  if (otto::util::checking()) otto::util::report(Kind::lock);
+  return real_mutex_lock()(mutex);
+}
+}
+
+#endif
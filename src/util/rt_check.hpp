@@ -0,0 +1,72 @@
+#pragma once
+
+namespace otto::util {
+
+  /// Whether built with `OTTO_RT_CHECKS`, so @ref RealtimeScope detects violations
+  constexpr bool realtime_checks_enabled = OTTO_RT_CHECKS;
+
+  /// Marks the calling thread as real-time while it exists
+  ///
+  /// With `OTTO_RT_CHECKS`, `malloc`, `calloc`, `realloc`, `free` (so also `new` and `delete`),
+  /// and `pthread_mutex_lock` (so also `std::mutex`) are interposed, and calls made while a
+  /// scope exists on the calling thread are counted in @ref realtime_violations. In debug
+  /// builds, the stack traces of the first violations are printed too. Without it, this does
+  /// nothing.
+  ///
+  /// The audio drivers open one for each callback. Tests open one around `process` to check
+  /// that it does not allocate or lock.
+  ///
+  /// ```cpp
+  /// auto before = util::realtime_violations();
+  /// {
+  ///   util::RealtimeScope realtime;
+  ///   engine.process(data);
+  /// }
+  /// REQUIRE(util::realtime_violations().total() == before.total());
+  /// ```
+  struct RealtimeScope {
+#if OTTO_RT_CHECKS
+    RealtimeScope() noexcept;
+    ~RealtimeScope() noexcept;
+#else
+    RealtimeScope() noexcept {}
+#endif
+    RealtimeScope(const RealtimeScope&) = delete;
+    RealtimeScope& operator=(const RealtimeScope&) = delete;
+  };
+
+  /// Allows allocating and locking within a @ref RealtimeScope while it exists
+  ///
+  /// For code that only runs on the audio thread in exceptional cases, like logging an error.
+  struct AllowBlocking {
+#if OTTO_RT_CHECKS
+    AllowBlocking() noexcept;
+    ~AllowBlocking() noexcept;
+#else
+    AllowBlocking() noexcept {}
+#endif
+    AllowBlocking(const AllowBlocking&) = delete;
+    AllowBlocking& operator=(const AllowBlocking&) = delete;
+  };
+
+  /// The calls detected within a @ref RealtimeScope
+  struct RealtimeViolations {
+    long allocations = 0;
+    long deallocations = 0;
+    long locks = 0;
+
+    long total() const noexcept
+    {
+      return allocations + deallocations + locks;
+    }
+  };
+
+  /// The violations of all threads since startup. Always zero without `OTTO_RT_CHECKS`.
+  RealtimeViolations realtime_violations() noexcept;
+
+  /// Print the stack traces of the next `count` violations to stderr
+  ///
+  /// The default is 16 in debug builds, and 0 in release builds, which only count them.
+  void print_realtime_violations(int count) noexcept;
+
+} // namespace otto::util
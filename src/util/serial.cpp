@@ -109,6 +109,38 @@ namespace otto::util {
     return read({&dst, 1}).map([&] { return dst; });
   }
 
+  void Serial::set_nonblocking(bool nonblocking)
+  {
+    int flags = fcntl(fd_, F_GETFL, 0);
+    flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if (flags == -1 || fcntl(fd_, F_SETFL, flags) == -1) {
+      throw util::exception("Error setting the flags of serial port {}. ERR {}: {}", path_, errno,
+                            strerror(errno));
+    }
+  }
+
+  expected<std::size_t> Serial::read_some(BytesView dest) noexcept
+  {
+    auto res = ::read(fd_, dest.data(), dest.size());
+    if (res < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+      return tl::make_unexpected(exception(ErrorCode::error, "Error reading from serial port {}. ERR {}: {}",
+                                           path_, errno, strerror(errno)));
+    }
+    return std::size_t(res);
+  }
+
+  expected<std::size_t> Serial::write_some(ConstBytesView data) noexcept
+  {
+    auto res = ::write(fd_, data.data(), data.size());
+    if (res < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+      return tl::make_unexpected(exception(ErrorCode::error, "Error writing to serial port {}. ERR {}: {}",
+                                           path_, errno, strerror(errno)));
+    }
+    return std::size_t(res);
+  }
+
   expected<std::vector<std::uint8_t>> Serial::read_line(std::uint8_t delim) noexcept
   {
     std::vector<std::uint8_t> res;
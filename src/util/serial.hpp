@@ -32,6 +32,22 @@ namespace otto::util {
     tl::expected<std::vector<std::uint8_t>, exception> read_line(
       std::uint8_t delim = '\n') noexcept;
 
+    /// Make @ref read_some and @ref write_some return instead of waiting
+    ///
+    /// For ports that are polled with `epoll`, using @ref file_descriptor.
+    void set_nonblocking(bool nonblocking);
+
+    /// Read what is available, up to the size of `dest`
+    ///
+    /// \returns the number of bytes read, which is 0 if a nonblocking port has nothing to read
+    tl::expected<std::size_t, exception> read_some(BytesView dest) noexcept;
+
+    /// Write as much of `data` as the port takes
+    ///
+    /// \returns the number of bytes written, which is less than the size of `data` if a
+    /// nonblocking port is full
+    tl::expected<std::size_t, exception> write_some(ConstBytesView data) noexcept;
+
     const std::string& path() noexcept
     {
       return path_;
@@ -1,7 +1,9 @@
 #pragma once
 
-#include <functional>
-#include <forward_list>
+#include <algorithm>
+#include <vector>
+
+#include "util/inline_function.hpp"
 
 namespace otto::util {
 
@@ -9,6 +11,11 @@ namespace otto::util {
   ///
   /// Handlers can be connected, and stored in Connections to be automatically disconnected
   /// on destruction
+  ///
+  /// The handlers are @ref InlineFunction "InlineFunctions", stored contiguously in connection
+  /// order, so connecting a small lambda does not allocate once the slot storage has grown, and
+  /// emitting walks a single array. Handlers must not connect or disconnect handlers of the
+  /// signal that is calling them.
   template<typename... Args>
   struct Signal;
 
@@ -20,10 +27,10 @@ namespace otto::util {
     using Connection = otto::util::Connection<Args...>;
     using Signal = otto::util::Signal<Args...>;
     using Function = typename Signal::Function;
-    using FuncIterator = typename Signal::FuncIterator;
 
     Signal* signal;
-    FuncIterator func_iter;
+    /// The id of the slot in `signal`
+    int id;
 
     void call_now(Args...);
   };
@@ -32,11 +39,10 @@ namespace otto::util {
   struct Signal {
     using Connection = otto::util::Connection<Args...>;
     using SlotRef = otto::util::SlotRef<Args...>;
-    using Function = std::function<void(Args...)>;
-    using FuncIterator = typename std::forward_list<Function>::iterator;
+    using Function = InlineFunction<void(Args...)>;
 
-    SlotRef connect(const Function& func);
-    SlotRef connect(Function&& func);
+    template<typename F>
+    SlotRef connect(F&& func);
 
     template<typename T>
     SlotRef connect_member(T* inst, void (T::*func)(Args...));
@@ -49,8 +55,24 @@ namespace otto::util {
 
     void emit(Args... a);
 
+    /// The number of connected handlers
+    std::size_t size() const noexcept
+    {
+      return _slots.size();
+    }
+
   private:
-    std::forward_list<Function> _slots;
+    friend SlotRef;
+
+    struct Slot {
+      int id;
+      Function func;
+    };
+
+    Function* find(int id);
+
+    std::vector<Slot> _slots;
+    int _next_id = 0;
   };
 
   template<typename... Args>
@@ -58,7 +80,6 @@ namespace otto::util {
     using Signal = otto::util::Signal<Args...>;
     using SlotRef = otto::util::SlotRef<Args...>;
     using Function = typename Signal::Function;
-    using FuncIterator = typename Signal::FuncIterator;
 
     Connection(SlotRef) noexcept;
 
@@ -80,54 +101,63 @@ namespace otto::util {
   template<typename... Args>
   void SlotRef<Args...>::call_now(Args... args)
   {
-    (*func_iter)(std::forward<Args>(args)...);
+    if (auto* func = signal->find(id)) (*func)(std::forward<Args>(args)...);
   }
 
 
   // -- Signal IMPLEMENTATIONS -- //
 
   template<typename... Args>
-  auto Signal<Args...>::connect(const Function& func) -> SlotRef
+  template<typename F>
+  auto Signal<Args...>::connect(F&& func) -> SlotRef
   {
-    _slots.emplace_front(func);
-    return {this, _slots.begin()};
-  }
-
-  template<typename... Args>
-  auto Signal<Args...>::connect(Function&& func) -> SlotRef
-  {
-    _slots.emplace_front(std::move(func));
-    return {this, _slots.begin()};
+    int id = _next_id++;
+    _slots.push_back({id, Function(std::forward<F>(func))});
+    return {this, id};
   }
 
   template<typename... Args>
   template<typename T>
   auto Signal<Args...>::connect_member(T* inst, void (T::*func)(Args...)) -> SlotRef
   {
-    return connect([inst, func](Args... args) { inst->*func(std::forward<Args>(args)...); });
+    return connect([inst, func](Args... args) { (inst->*func)(std::forward<Args>(args)...); });
   }
 
   template<typename... Args>
   template<typename T>
   auto Signal<Args...>::connect_member(const T* inst, void (T::*func)(Args...) const) -> SlotRef
   {
-    return connect([inst, func](Args... args) { inst->*func(std::forward<Args>(args)...); });
+    return connect([inst, func](Args... args) { (inst->*func)(std::forward<Args>(args)...); });
   }
 
   template<typename... Args>
   void Signal<Args...>::disconnect(SlotRef sr)
   {
-    _slots.erase(sr.func_iter);
+    auto found = std::find_if(_slots.begin(), _slots.end(), [&](const Slot& s) { return s.id == sr.id; });
+    if (found != _slots.end()) _slots.erase(found);
+  }
+
+  template<typename... Args>
+  void Signal<Args...>::disconnect_all()
+  {
+    _slots.clear();
   }
 
   template<typename... Args>
   void Signal<Args...>::emit(Args... args)
   {
-    for (auto&& slot : _slots) {
-      slot(args...);
+    for (auto& slot : _slots) {
+      slot.func(args...);
     }
   }
 
+  template<typename... Args>
+  auto Signal<Args...>::find(int id) -> Function*
+  {
+    auto found = std::find_if(_slots.begin(), _slots.end(), [&](const Slot& s) { return s.id == id; });
+    return found != _slots.end() ? &found->func : nullptr;
+  }
+
   // -- Connection IMPLEMENTATIONS -- //
 
   template<typename... Args>
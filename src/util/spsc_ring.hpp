@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include <gsl/span>
+
+namespace otto::util {
+
+  /// A bounded, wait-free single-producer single-consumer ring buffer
+  ///
+  /// One thread writes, and one other thread reads, either one value at a time with @ref push
+  /// and @ref pop, or in batches with @ref write and @ref read, which copy as much as fits in
+  /// at most two contiguous runs. No operation locks, allocates or loops on the other thread.
+  /// Meant for streams between the audio thread and the rest, like audio capture to disk,
+  /// scope views and event queues. Use @ref MPSCQueue when there is more than one producer.
+  ///
+  /// The positions only ever increase, and are masked into the buffer. Each is written by one
+  /// side only, with release semantics, and read by the other with acquire semantics. Each side
+  /// keeps a cached copy of the other's position, and only reloads it when the cache says there
+  /// is too little space or data, so the two sides rarely touch each other's cache lines.
+  ///
+  /// \tparam T A trivially copyable value type
+  /// \tparam Capacity The maximum number of values in the ring. Must be a power of two.
+  template<typename T, std::size_t Capacity>
+  struct SPSCRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "SPSCRing requires a trivially copyable type");
+
+    static constexpr std::size_t capacity = Capacity;
+
+    SPSCRing() = default;
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    // Producer //
+
+    /// Add a value. Only to be called from the producer thread.
+    ///
+    /// \returns `false` if the ring is full, and the value was dropped
+    bool push(const T& value) noexcept
+    {
+      if (space(1) == 0) return false;
+      _buffer[_producer.pos & mask] = value;
+      _producer.pos++;
+      _write_pos.store(_producer.pos, std::memory_order_release);
+      return true;
+    }
+
+    /// Add as many of `n` values from `data` as fit. Only to be called from the producer thread.
+    ///
+    /// \returns the number of values written
+    std::size_t write(const T* data, std::size_t n) noexcept
+    {
+      n = std::min(n, space(n));
+      if (n == 0) return 0;
+      auto start = _producer.pos & mask;
+      auto first = std::min(n, capacity - start);
+      std::copy(data, data + first, _buffer.data() + start);
+      std::copy(data + first, data + n, _buffer.data());
+      _producer.pos += n;
+      _write_pos.store(_producer.pos, std::memory_order_release);
+      return n;
+    }
+
+    /// Add as many values from `data` as fit. Only to be called from the producer thread.
+    ///
+    /// \returns the number of values written
+    std::size_t write(gsl::span<const T> data) noexcept
+    {
+      return write(data.data(), data.size());
+    }
+
+    /// The number of values that can be written without overflowing
+    ///
+    /// Only to be called from the producer thread. The actual space may be larger, if the
+    /// consumer reads in the meantime.
+    std::size_t write_available() noexcept
+    {
+      return space(capacity);
+    }
+
+    // Consumer //
+
+    /// Take the oldest value. Only to be called from the consumer thread.
+    ///
+    /// \returns `false` if the ring was empty
+    bool pop(T& out) noexcept
+    {
+      if (readable(1) == 0) return false;
+      out = _buffer[_consumer.pos & mask];
+      _consumer.pos++;
+      _read_pos.store(_consumer.pos, std::memory_order_release);
+      return true;
+    }
+
+    /// Take up to `n` of the oldest values into `data`. Only to be called from the consumer
+    /// thread.
+    ///
+    /// \returns the number of values read
+    std::size_t read(T* data, std::size_t n) noexcept
+    {
+      n = std::min(n, readable(n));
+      if (n == 0) return 0;
+      auto start = _consumer.pos & mask;
+      auto first = std::min(n, capacity - start);
+      std::copy(_buffer.data() + start, _buffer.data() + start + first, data);
+      std::copy(_buffer.data(), _buffer.data() + (n - first), data + first);
+      _consumer.pos += n;
+      _read_pos.store(_consumer.pos, std::memory_order_release);
+      return n;
+    }
+
+    /// Take as many of the oldest values as fit into `data`. Only to be called from the
+    /// consumer thread.
+    ///
+    /// \returns the number of values read
+    std::size_t read(gsl::span<T> data) noexcept
+    {
+      return read(data.data(), data.size());
+    }
+
+    /// The number of values that can be read
+    ///
+    /// Only to be called from the consumer thread. There may be more, if the producer
+    /// writes in the meantime.
+    std::size_t read_available() noexcept
+    {
+      return readable(capacity);
+    }
+
+    /// Whether there is nothing to read. Only to be called from the consumer thread.
+    bool empty() noexcept
+    {
+      return readable(1) == 0;
+    }
+
+  private:
+    /// The free space for the producer, reloading the consumer position if the cached one
+    /// leaves less than `wanted`
+    std::size_t space(std::size_t wanted) noexcept
+    {
+      auto free = capacity - (_producer.pos - _producer.cached_other);
+      if (free < wanted) {
+        _producer.cached_other = _read_pos.load(std::memory_order_acquire);
+        free = capacity - (_producer.pos - _producer.cached_other);
+      }
+      return free;
+    }
+
+    /// The number of values for the consumer, reloading the producer position if the cached
+    /// one gives less than `wanted`
+    std::size_t readable(std::size_t wanted) noexcept
+    {
+      auto count = _consumer.cached_other - _consumer.pos;
+      if (count < wanted) {
+        _consumer.cached_other = _write_pos.load(std::memory_order_acquire);
+        count = _consumer.cached_other - _consumer.pos;
+      }
+      return count;
+    }
+
+    static constexpr std::size_t mask = capacity - 1;
+    static constexpr std::size_t cache_line_size = 64;
+
+    /// The state only touched by one side
+    struct alignas(cache_line_size) Local {
+      /// The position of this side
+      std::size_t pos = 0;
+      /// The last loaded position of the other side
+      std::size_t cached_other = 0;
+    };
+
+    std::array<T, capacity> _buffer = {};
+    /// The position of the producer, read by the consumer
+    alignas(cache_line_size) std::atomic<std::size_t> _write_pos = 0;
+    /// The position of the consumer, read by the producer
+    alignas(cache_line_size) std::atomic<std::size_t> _read_pos = 0;
+    Local _producer;
+    Local _consumer;
+  };
+
+} // namespace otto::util
@@ -22,6 +22,7 @@ namespace otto::util {
     constexpr string_ref& operator=(const string_ref& rhs)
     {
       data_ = rhs.data_;
+      length_ = rhs.length_;
       return *this;
     }
 
@@ -0,0 +1,146 @@
+#include "task_graph.hpp"
+
+#include <algorithm>
+
+#include "services/log_manager.hpp"
+#include "util/realtime.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::util {
+
+  /// The number of times a worker checks for a new run before going to sleep
+  constexpr int spin_count = 20000;
+
+  // TaskGraph //
+
+  TaskGraph::TaskId TaskGraph::add(Task task, std::initializer_list<TaskId> dependencies)
+  {
+    return add(std::move(task), std::vector<TaskId>(dependencies));
+  }
+
+  TaskGraph::TaskId TaskGraph::add(Task task, std::vector<TaskId> dependencies)
+  {
+    _nodes.push_back(std::make_unique<Node>(std::move(task), std::move(dependencies)));
+    return _nodes.size() - 1;
+  }
+
+  void TaskGraph::run() noexcept
+  {
+    for (auto& node : _nodes) node->task();
+  }
+
+  void TaskGraph::work(unsigned gen) noexcept
+  {
+    bool unclaimed = true;
+    while (unclaimed) {
+      unclaimed = false;
+      for (auto& node : _nodes) {
+        // Every run claims every node, so a node is unclaimed if it was last claimed by the
+        // previous run. This also keeps threads still working on an older run from claiming it.
+        auto claimed = gen - 1;
+        if (node->claimed.load(std::memory_order_relaxed) != claimed) continue;
+        unclaimed = true;
+        bool ready = std::all_of(node->dependencies.begin(), node->dependencies.end(), [&](TaskId dep) {
+          return _nodes[dep]->done.load(std::memory_order_acquire) == gen;
+        });
+        if (!ready) continue;
+        if (!node->claimed.compare_exchange_strong(claimed, gen, std::memory_order_relaxed)) continue;
+        node->task();
+        node->done.store(gen, std::memory_order_release);
+      }
+      // A newer run has started, which the current thread will join from the start
+      if (_generation.load(std::memory_order_relaxed) != gen) return;
+    }
+  }
+
+  // WorkerPool //
+
+  WorkerPool::WorkerPool(int worker_count, int first_core)
+  {
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    _workers.reserve(worker_count);
+    for (int i = 0; i < worker_count; i++) {
+      int core = (first_core + i) % cores;
+      _workers.push_back(start_thread(ThreadClass::audio_worker, [this, i, core] {
+        // Each on a core of its own, unless the board chose the cores of the workers
+        if (thread_policy(ThreadClass::audio_worker).cores.empty() && !pin_thread(current_thread(), core)) {
+          LOGW("Could not pin worker thread to core {}", core);
+        }
+        worker_main(i);
+      }));
+    }
+  }
+
+  WorkerPool::~WorkerPool() noexcept
+  {
+    {
+      std::unique_lock lock{_mutex};
+      _should_run = false;
+    }
+    _wake.notify_all();
+    for (auto& thread : _workers) thread.join();
+  }
+
+  void WorkerPool::run(TaskGraph& graph) noexcept
+  {
+    if (_workers.empty()) {
+      graph.run();
+      return;
+    }
+
+    _graph.store(&graph);
+    auto gen = graph._generation.fetch_add(1) + 1;
+    _generation.fetch_add(1);
+    if (_sleepers.load() > 0) {
+      std::unique_lock lock{_mutex};
+      _wake.notify_all();
+    }
+
+    graph.work(gen);
+
+    // Wait for the tasks still running on workers
+    for (auto& node : graph._nodes) {
+      while (node->done.load(std::memory_order_acquire) != gen) std::this_thread::yield();
+    }
+
+    // Wait for workers still looking for tasks, so the graph can be destroyed after returning.
+    // Workers that wake up after this will find no graph.
+    _graph.store(nullptr);
+    while (_active.load() > 0) std::this_thread::yield();
+  }
+
+  bool WorkerPool::try_run(TaskGraph& graph) noexcept
+  {
+    if (_busy.test_and_set(std::memory_order_acquire)) return false;
+    run(graph);
+    _busy.clear(std::memory_order_release);
+    return true;
+  }
+
+  void WorkerPool::worker_main(int index) noexcept
+  {
+    loguru::set_thread_name(fmt::format("worker_{}", index).c_str());
+    unsigned seen = 0;
+    while (true) {
+      unsigned gen = seen;
+      for (int i = 0; i < spin_count && gen == seen; i++) {
+        if (!_should_run) return;
+        gen = _generation.load();
+      }
+      if (gen == seen) {
+        std::unique_lock lock{_mutex};
+        _sleepers++;
+        _wake.wait(lock, [&] { return !_should_run || (gen = _generation.load()) != seen; });
+        _sleepers--;
+        if (!_should_run) return;
+      }
+      seen = gen;
+      _active++;
+      if (auto* graph = _graph.load(); graph != nullptr) {
+        graph->work(graph->_generation.load(std::memory_order_acquire));
+      }
+      _active--;
+    }
+  }
+
+} // namespace otto::util
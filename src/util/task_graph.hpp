@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace otto::util {
+
+  struct WorkerPool;
+
+  /// A static graph of tasks with dependencies.
+  ///
+  /// Tasks are added once, with the tasks they depend on. Each run executes every task exactly
+  /// once, never before its dependencies have finished. Run the graph serially with @ref run,
+  /// or in parallel with @ref WorkerPool::run.
+  ///
+  /// ```cpp
+  /// TaskGraph graph;
+  /// auto a = graph.add([] { ... });
+  /// auto b = graph.add([] { ... }, {a});
+  /// auto c = graph.add([] { ... }, {a});
+  /// graph.add([] { ... }, {b, c}); // b and c may run in parallel
+  /// workers.run(graph);
+  /// ```
+  struct TaskGraph {
+    using TaskId = int;
+    using Task = std::function<void()>;
+
+    TaskGraph() = default;
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    /// Add a task
+    ///
+    /// Not to be called while the graph is running.
+    ///
+    /// \param dependencies Tasks that have to finish before this one starts.
+    /// \returns the id of the new task
+    /// \requires All dependencies have been added before.
+    TaskId add(Task task, std::initializer_list<TaskId> dependencies = {});
+
+    /// Add a task
+    ///
+    /// \see add(Task, std::initializer_list<TaskId>)
+    TaskId add(Task task, std::vector<TaskId> dependencies);
+
+    /// Execute all tasks serially on the calling thread, in the order they were added
+    void run() noexcept;
+
+    /// The number of tasks
+    int size() const noexcept
+    {
+      return _nodes.size();
+    }
+
+  private:
+    friend struct WorkerPool;
+
+    struct Node {
+      Node(Task task, std::vector<TaskId> dependencies)
+        : task(std::move(task)), dependencies(std::move(dependencies))
+      {}
+
+      Task task;
+      std::vector<TaskId> dependencies;
+      /// The generation this node was last claimed by a thread in
+      std::atomic_uint claimed = 0;
+      /// The generation this node was last finished in
+      std::atomic_uint done = 0;
+    };
+
+    /// Claim and run tasks of generation `gen` until none are left to claim
+    void work(unsigned gen) noexcept;
+
+    std::vector<std::unique_ptr<Node>> _nodes;
+    /// Incremented for each parallel run
+    std::atomic_uint _generation = 0;
+  };
+
+  /// A small pool of real-time worker threads executing @ref TaskGraph "TaskGraphs"
+  ///
+  /// The calling thread takes part in each run, so a pool with no workers runs graphs serially.
+  ///
+  /// `run` does not allocate or lock, except for briefly locking a mutex to wake up workers
+  /// that have gone to sleep. Workers spin for a while after each run before sleeping, so
+  /// with short periods between runs, like audio buffers, they are usually still awake.
+  ///
+  /// Worker threads are pinned to a core each, and run with the policy of
+  /// `ThreadClass::audio_worker`.
+  struct WorkerPool {
+    /// \param worker_count The number of threads to start in addition to the calling thread.
+    /// \param first_core The core the first worker is pinned to. The others follow it, wrapping
+    ///                   around to core 0.
+    WorkerPool(int worker_count = 0, int first_core = 1);
+
+    ~WorkerPool() noexcept;
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// Execute all tasks in `graph`, and return when they are done
+    ///
+    /// Only to be called from one thread at a time.
+    void run(TaskGraph& graph) noexcept;
+
+    /// Execute all tasks in `graph` like @ref run, unless another thread is running a graph
+    ///
+    /// For pools shared by several threads, which can fall back to running the graph serially.
+    ///
+    /// \returns `false` without running any task if the pool was busy.
+    bool try_run(TaskGraph& graph) noexcept;
+
+    /// The number of worker threads, not including the calling thread
+    int worker_count() const noexcept
+    {
+      return _workers.size();
+    }
+
+  private:
+    void worker_main(int index) noexcept;
+
+    std::vector<std::thread> _workers;
+
+    /// The graph of the current run, or `nullptr` between runs
+    std::atomic<TaskGraph*> _graph = nullptr;
+    /// Incremented for each run, to wake up workers
+    std::atomic_uint _generation = 0;
+    /// The number of workers looking at `_graph`
+    std::atomic_int _active = 0;
+    std::atomic_bool _should_run = true;
+    /// Set during @ref try_run
+    std::atomic_flag _busy = ATOMIC_FLAG_INIT;
+    std::atomic_int _sleepers = 0;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+  };
+
+} // namespace otto::util
@@ -9,9 +9,7 @@
 #include <chrono>
 #include <ctime>
 
-#include <condition_variable>
-#include <functional>
-#include <thread>
+#include "util/thread_policy.hpp"
 
 namespace otto::chrono {
 
@@ -38,9 +36,15 @@ namespace otto::chrono {
 
 namespace otto::util {
 
+  /// A thread that runs `func(should_run)`, until it is joined
+  ///
+  /// `should_run()` returns false once @ref join has been called.
   struct thread {
     template<typename Func>
-    thread(Func&& func) : std_thread(std::forward<Func>(func), [this] { return should_run(); })
+    thread(ThreadClass cls, Func&& func)
+      : std_thread(start_thread(cls, [this, func = std::forward<Func>(func)]() mutable {
+          func([this] { return should_run(); });
+        }))
     {}
 
     ~thread()
@@ -51,7 +55,7 @@ namespace otto::util {
     void join()
     {
       _should_run = false;
-      std_thread.join();
+      if (std_thread.joinable()) std_thread.join();
     }
 
   private:
@@ -64,10 +68,16 @@ namespace otto::util {
     std::thread std_thread;
   };
 
+  /// A thread that runs `func(should_run)`, where `should_run()` waits for @ref trigger
+  ///
+  /// A trigger while the thread is busy is not lost: the next `should_run()` returns right
+  /// away. Several triggers before then count as one.
   struct triggered_thread {
     template<typename Func>
-    triggered_thread(Func&& func)
-      : std_thread(std::forward<Func>(func), [this] { return should_run(); })
+    triggered_thread(ThreadClass cls, Func&& func)
+      : std_thread(start_thread(cls, [this, func = std::forward<Func>(func)]() mutable {
+          func([this] { return should_run(); });
+        }))
     {}
 
     ~triggered_thread()
@@ -77,34 +87,48 @@ namespace otto::util {
 
     void trigger()
     {
+      {
+        std::unique_lock lock{_mutex};
+        _triggered = true;
+      }
       _trigger.notify_all();
     }
 
     void join()
     {
-      _should_run = false;
+      {
+        std::unique_lock lock{_mutex};
+        _should_run = false;
+      }
       _trigger.notify_all();
-      std_thread.join();
+      if (std_thread.joinable()) std_thread.join();
     }
 
   private:
     bool should_run() noexcept
     {
       std::unique_lock lock{_mutex};
-      if (!_should_run) return false;
-      _trigger.wait(lock);
+      _trigger.wait(lock, [this] { return _triggered || !_should_run; });
+      _triggered = false;
       return _should_run;
     }
-    std::atomic_bool _should_run = true;
+
     std::mutex _mutex;
     std::condition_variable _trigger;
+    /// Guarded by `_mutex`
+    bool _should_run = true;
+    /// Guarded by `_mutex`
+    bool _triggered = false;
     std::thread std_thread;
   };
 
+  /// A @ref triggered_thread that can also sleep until it is triggered, or a timeout
   struct sleeper_thread {
     template<typename Func>
-    sleeper_thread(Func&& func)
-      : std_thread(std::forward<Func>(func), [this] { return should_run(); })
+    sleeper_thread(ThreadClass cls, Func&& func)
+      : std_thread(start_thread(cls, [this, func = std::forward<Func>(func)]() mutable {
+          func([this] { return should_run(); });
+        }))
     {}
 
     ~sleeper_thread()
@@ -114,50 +138,71 @@ namespace otto::util {
 
     void trigger()
     {
+      {
+        std::unique_lock lock{_mutex};
+        _triggered = true;
+      }
       _trigger.notify_all();
     }
 
     void join()
     {
-      _should_run = false;
+      {
+        std::unique_lock lock{_mutex};
+        _should_run = false;
+      }
       _trigger.notify_all();
-      std_thread.join();
+      if (std_thread.joinable()) std_thread.join();
     }
 
     bool should_run() noexcept
     {
       std::unique_lock lock{_mutex};
-      if (!_should_run) return false;
-      _trigger.wait(lock);
+      _trigger.wait(lock, [this] { return _triggered || !_should_run; });
+      _triggered = false;
       return _should_run;
     }
 
-    auto sleep_for(chrono::duration dur)
+    /// Sleep for `dur`, or until triggered or joined
+    ///
+    /// \returns true if it was triggered or joined
+    bool sleep_for(chrono::duration dur)
     {
-      auto lock = std::unique_lock(_mutex);
-      return _trigger.wait_for(lock, dur);
+      std::unique_lock lock{_mutex};
+      bool woken = _trigger.wait_for(lock, dur, [this] { return _triggered || !_should_run; });
+      _triggered = false;
+      return woken;
     }
 
-    auto sleep_until(chrono::time_point time)
+    /// Sleep until `time`, or until triggered or joined
+    ///
+    /// \returns true if it was triggered or joined
+    bool sleep_until(chrono::time_point time)
     {
-      auto lock = std::unique_lock(_mutex);
-      return _trigger.wait_until(lock, time);
+      std::unique_lock lock{_mutex};
+      bool woken = _trigger.wait_until(lock, time, [this] { return _triggered || !_should_run; });
+      _triggered = false;
+      return woken;
     }
 
-    auto wake_up() noexcept
+    void wake_up() noexcept
     {
-      _trigger.notify_all();
+      trigger();
     }
 
-    auto running() noexcept -> bool
+    bool running() noexcept
     {
+      std::unique_lock lock{_mutex};
       return _should_run;
     }
 
   private:
-    std::atomic_bool _should_run = true;
     std::mutex _mutex;
     std::condition_variable _trigger;
+    /// Guarded by `_mutex`
+    bool _should_run = true;
+    /// Guarded by `_mutex`
+    bool _triggered = false;
     std::thread std_thread;
   };
 
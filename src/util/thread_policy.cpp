@@ -0,0 +1,90 @@
+#include "thread_policy.hpp"
+
+#include <array>
+#include <mutex>
+
+#include "services/log_manager.hpp"
+#include "util/realtime.hpp"
+
+namespace otto::util {
+
+  namespace {
+    using Scheduling = ThreadPolicy::Scheduling;
+
+    constexpr std::size_t class_count = static_cast<std::size_t>(ThreadClass::background) + 1;
+
+    std::mutex policies_mutex;
+    /// Guarded by `policies_mutex`
+    std::array<ThreadPolicy, class_count> policies = {
+      /* audio */ ThreadPolicy{Scheduling::unchanged, 0, {0}},
+      /* audio_worker */ ThreadPolicy{Scheduling::fifo, 70},
+      /* midi */ ThreadPolicy{Scheduling::fifo, 60},
+      /* io */ ThreadPolicy{},
+      /* ui */ ThreadPolicy{},
+      /* background */ ThreadPolicy{Scheduling::idle},
+    };
+  } // namespace
+
+  const char* to_string(ThreadClass cls) noexcept
+  {
+    switch (cls) {
+    case ThreadClass::audio: return "audio";
+    case ThreadClass::audio_worker: return "audio worker";
+    case ThreadClass::midi: return "midi";
+    case ThreadClass::io: return "io";
+    case ThreadClass::ui: return "ui";
+    case ThreadClass::background: return "background";
+    }
+    return "unknown";
+  }
+
+  ThreadPolicy thread_policy(ThreadClass cls)
+  {
+    std::unique_lock lock{policies_mutex};
+    return policies[static_cast<std::size_t>(cls)];
+  }
+
+  void set_thread_policy(ThreadClass cls, ThreadPolicy policy)
+  {
+    std::unique_lock lock{policies_mutex};
+    policies[static_cast<std::size_t>(cls)] = std::move(policy);
+  }
+
+  bool enter_thread_class(ThreadClass cls) noexcept
+  {
+    // Copied, so the audio thread does not allocate
+    std::array<int, 64> core_buf;
+    std::size_t core_count = 0;
+    ThreadPolicy::Scheduling scheduling;
+    int priority;
+    {
+      std::unique_lock lock{policies_mutex};
+      auto& policy = policies[static_cast<std::size_t>(cls)];
+      scheduling = policy.scheduling;
+      priority = policy.priority;
+      for (int core : policy.cores) {
+        if (core_count < core_buf.size()) core_buf[core_count++] = core;
+      }
+    }
+
+    auto handle = current_thread();
+    bool ok = true;
+    switch (scheduling) {
+    case Scheduling::unchanged: break;
+    case Scheduling::normal: ok = set_normal_priority(handle); break;
+    case Scheduling::fifo: ok = set_fifo_priority(handle, priority); break;
+    case Scheduling::idle: ok = set_idle_priority(handle); break;
+    }
+    // Not the cores of the thread that started this one
+    if (core_count == 0) return unpin_thread(handle) && ok;
+    return pin_thread(handle, gsl::span<const int>(core_buf.data(), int(core_count))) && ok;
+  }
+
+  namespace detail {
+    void warn_thread_class(ThreadClass cls) noexcept
+    {
+      LOGW("Could not apply the scheduling of the {} threads", to_string(cls));
+    }
+  } // namespace detail
+
+} // namespace otto::util
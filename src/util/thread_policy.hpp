@@ -0,0 +1,84 @@
+#pragma once
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace otto::util {
+
+  /// The kinds of threads, which each run with the scheduling of their @ref ThreadPolicy
+  enum struct ThreadClass {
+    /// The audio callback. Its thread is started by the driver, and enters the class itself.
+    audio,
+    /// The workers that process the routing graph along with the audio thread
+    audio_worker,
+    /// Threads that send or receive midi at the time of the audio
+    midi,
+    /// Threads that wait for devices, files or the network, like streaming samples from disk
+    io,
+    /// The UI loop, and the threads that read its input
+    ui,
+    /// Work nobody waits for, like loading presets and assets, and statistics
+    background,
+  };
+
+  /// The name of `cls`, for logging
+  const char* to_string(ThreadClass cls) noexcept;
+
+  /// How the threads of a @ref ThreadClass are scheduled
+  struct ThreadPolicy {
+    enum struct Scheduling {
+      /// Left as it is, like for the audio thread, which the driver gives its priority
+      unchanged,
+      /// The default time sharing of the OS
+      normal,
+      /// `SCHED_FIFO` at @ref priority, above every thread that is not real-time
+      fifo,
+      /// `SCHED_IDLE`, only running when nothing else wants the cpu
+      idle,
+    };
+
+    Scheduling scheduling = Scheduling::normal;
+    /// The `SCHED_FIFO` priority, capped at the maximum
+    int priority = 0;
+    /// The cores the threads may run on, or all cores if empty
+    std::vector<int> cores = {};
+  };
+
+  /// The policy of the threads of `cls`
+  ///
+  /// By default, the audio thread runs on core 0, with the scheduling the driver gives it. The
+  /// audio workers run with `SCHED_FIFO` 70, below the usual priority of audio threads, and
+  /// midi with 60. Background threads run with `SCHED_IDLE`, and the others normally.
+  ThreadPolicy thread_policy(ThreadClass cls);
+
+  /// Set the policy of the threads of `cls`
+  ///
+  /// Boards call this at startup, before the services start their threads, to fit the policies
+  /// to their cpu. Threads that have already entered the class keep the old policy.
+  void set_thread_policy(ThreadClass cls, ThreadPolicy policy);
+
+  /// Apply the policy of `cls` to the calling thread
+  ///
+  /// Every thread of OTTO enters its class first thing, usually through @ref start_thread.
+  /// \returns false if the scheduling or the cores could not be set, like when real-time
+  /// priorities are not permitted, or on other platforms than Linux
+  bool enter_thread_class(ThreadClass cls) noexcept;
+
+  namespace detail {
+    void warn_thread_class(ThreadClass cls) noexcept;
+  }
+
+  /// Start a thread of class `cls`, which runs `f` after @ref enter_thread_class
+  ///
+  /// Logs a warning if the policy could not be applied.
+  template<typename F>
+  std::thread start_thread(ThreadClass cls, F&& f)
+  {
+    return std::thread([cls, f = std::forward<F>(f)]() mutable {
+      if (!enter_thread_class(cls)) detail::warn_thread_class(cls);
+      f();
+    });
+  }
+
+} // namespace otto::util
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cmath>
+
+namespace otto::util {
+
+  /// Estimates the period of a jittery stream of events, like midi clock ticks
+  ///
+  /// A second order delay-locked loop as described by Fons Adriaensen in "Using a DLL to filter
+  /// time". The loop predicts the time of the next event, and corrects its period estimate by
+  /// a fraction of the error each time an event arrives, so it follows tempo changes while
+  /// filtering out the jitter of each single event.
+  ///
+  /// ```cpp
+  /// TimeFilter filter;
+  /// for (auto t : arrival_times) filter.tick(t);
+  /// if (filter.locked()) bpm = 60 / (filter.period() * 24);
+  /// ```
+  struct TimeFilter {
+    /// \param bandwidth The bandwidth of the loop, relative to the event rate. Lower values
+    ///   filter more jitter, but follow changes more slowly.
+    TimeFilter(double bandwidth = 0.01) noexcept
+    {
+      constexpr double pi = 3.14159265358979323846;
+      double omega = 2 * pi * bandwidth;
+      _b = std::sqrt(2.0) * omega;
+      _c = omega * omega;
+    }
+
+    /// Register an event
+    ///
+    /// \param time The arrival time of the event, in seconds
+    void tick(double time) noexcept
+    {
+      switch (_count) {
+      case 0: _last = time; break;
+      case 1:
+        // Start from the first measured period
+        _period = time - _last;
+        _next = time + _period;
+        break;
+      default: {
+        double error = time - _next;
+        _next += _b * error + _period;
+        _period += _c * error;
+      } break;
+      }
+      if (_count < lock_count) _count++;
+    }
+
+    /// Forget all events, e.g. when the stream restarts
+    void reset() noexcept
+    {
+      _count = 0;
+    }
+
+    /// Has the filter seen enough events to give a useful estimate?
+    bool locked() const noexcept
+    {
+      return _count == lock_count;
+    }
+
+    /// The filtered period between events, in seconds
+    double period() const noexcept
+    {
+      return _period;
+    }
+
+    /// The number of events needed before the estimate is considered stable
+    static constexpr int lock_count = 8;
+
+  private:
+    double _b;
+    double _c;
+    int _count = 0;
+    double _last = 0;
+    double _next = 0;
+    double _period = 0;
+  };
+
+} // namespace otto::util
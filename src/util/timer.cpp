@@ -0,0 +1,125 @@
+#include "timer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "services/log_manager.hpp"
+
+namespace otto::util::timer {
+
+  namespace {
+
+    struct Entry {
+      Record record;
+      int tid;
+    };
+
+    struct Trace {
+      std::mutex mutex;
+      /// Never removed, since the threads keep pointers to them
+      std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+      std::vector<Entry> entries;
+      std::size_t dropped = 0;
+
+      /// \requires `mutex` is locked
+      void collect_locked()
+      {
+        for (auto& buffer : buffers) {
+          Record record;
+          while (buffer->records.pop(record)) {
+            if (entries.size() < max_records) {
+              entries.push_back({record, buffer->tid});
+            } else {
+              dropped++;
+            }
+          }
+          dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+        }
+      }
+    };
+
+    Trace& trace()
+    {
+      static Trace trace;
+      return trace;
+    }
+
+  } // namespace
+
+  ThreadBuffer& register_thread()
+  {
+    auto& t = trace();
+    std::unique_lock lock(t.mutex);
+    t.buffers.push_back(std::make_unique<ThreadBuffer>());
+    t.buffers.back()->tid = t.buffers.size() - 1;
+    return *t.buffers.back();
+  }
+
+  void collect()
+  {
+    auto& t = trace();
+    std::unique_lock lock(t.mutex);
+    t.collect_locked();
+  }
+
+  std::size_t size()
+  {
+    auto& t = trace();
+    std::unique_lock lock(t.mutex);
+    return t.entries.size();
+  }
+
+  std::size_t dropped()
+  {
+    auto& t = trace();
+    std::unique_lock lock(t.mutex);
+    return t.dropped;
+  }
+
+  void dump(const filesystem::path& path)
+  {
+    auto& t = trace();
+    std::unique_lock lock(t.mutex);
+    t.collect_locked();
+    std::ofstream file(path.c_str());
+    if (!file) {
+      LOGE("Could not write the trace to {}", path.string());
+      return;
+    }
+    std::int64_t start = t.entries.empty() ? 0 : t.entries.front().record.begin_ns;
+    for (auto& e : t.entries) start = std::min(start, e.record.begin_ns);
+    // Timestamps are in microseconds
+    auto us = [start](std::int64_t ns) { return (ns - start) / 1000.0; };
+
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    for (auto& [record, tid] : t.entries) {
+      file << (first ? "\n" : ",\n");
+      first = false;
+      if (record.end_ns < 0) {
+        file << fmt::format(R"({{"name":"{}","ph":"i","s":"t","ts":{:.3f},"pid":1,"tid":{}}})", record.name,
+                            us(record.begin_ns), tid);
+      } else {
+        file << fmt::format(R"({{"name":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":1,"tid":{}}})", record.name,
+                            us(record.begin_ns), (record.end_ns - record.begin_ns) / 1000.0, tid);
+      }
+    }
+    file << "\n]}\n";
+    LOGI("Wrote {} trace events to {}, {} were dropped", t.entries.size(), path.string(), t.dropped);
+  }
+
+  void clear()
+  {
+    auto& t = trace();
+    std::unique_lock lock(t.mutex);
+    t.collect_locked();
+    t.entries.clear();
+    t.dropped = 0;
+  }
+
+} // namespace otto::util::timer
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "util/filesystem.hpp"
+#include "util/spsc_ring.hpp"
+
+/// Trace the time until the end of the enclosing scope, under `name`
+///
+/// Does nothing unless built with `OTTO_ENABLE_TIMERS`. `name` must be a string literal.
+///
+/// ```cpp
+/// void process() {
+///   TIME_SCOPE("Synth::process");
+///   ...
+/// }
+/// ```
+#define TIME_SCOPE(name) OTTO_TIMER_IMPL_SCOPE(name, __COUNTER__)
+
+/// Trace an instant, like an xrun, under `name`
+///
+/// Does nothing unless built with `OTTO_ENABLE_TIMERS`. `name` must be a string literal.
+#define TIME_EVENT(name) OTTO_TIMER_IMPL_EVENT(name)
+
+#if OTTO_ENABLE_TIMERS
+#define OTTO_TIMER_IMPL_CAT2(a, b) a##b
+#define OTTO_TIMER_IMPL_CAT(a, b) OTTO_TIMER_IMPL_CAT2(a, b)
+#define OTTO_TIMER_IMPL_SCOPE(name, id)                                                            \
+  ::otto::util::timer::ScopeTimer OTTO_TIMER_IMPL_CAT(otto_scope_timer_, id)(name)
+#define OTTO_TIMER_IMPL_EVENT(name) ::otto::util::timer::record_instant(name)
+#else
+#define OTTO_TIMER_IMPL_SCOPE(name, id) ((void) 0)
+#define OTTO_TIMER_IMPL_EVENT(name) ((void) 0)
+#endif
+
+/// Scoped tracing of hot paths, dumped as a Chrome trace
+///
+/// Each thread records the begin and end of its scopes into its own lock-free ring buffer,
+/// so tracing the audio thread does not lock or allocate, except once on its first record.
+/// The UI thread moves the records into the trace every frame, with @ref collect, and the
+/// trace is written to `data/trace.json` on exit. Open it in `chrome://tracing` or
+/// https://ui.perfetto.dev.
+///
+/// Records are dropped when a thread fills its buffer between two collects, and once the
+/// trace holds @ref max_records.
+namespace otto::util::timer {
+
+  /// One traced scope or instant
+  struct Record {
+    /// A string literal
+    const char* name;
+    /// Nanoseconds of `std::chrono::steady_clock`
+    std::int64_t begin_ns;
+    /// `-1` for instants
+    std::int64_t end_ns;
+  };
+
+  /// The records of one thread, until they are collected
+  struct ThreadBuffer {
+    static constexpr std::size_t capacity = 4096;
+
+    /// The order the thread first recorded in
+    int tid;
+    SPSCRing<Record, capacity> records;
+    std::atomic_int dropped = 0;
+  };
+
+  /// The number of records kept in the trace
+  constexpr std::size_t max_records = 1 << 20;
+
+  /// Register a buffer for the calling thread. Locks and allocates.
+  ThreadBuffer& register_thread();
+
+  namespace detail {
+    inline thread_local ThreadBuffer* thread_buffer = nullptr;
+  }
+
+  inline std::int64_t now_ns() noexcept
+  {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  inline void record(const char* name, std::int64_t begin_ns, std::int64_t end_ns) noexcept
+  {
+    auto* buffer = detail::thread_buffer;
+    if (buffer == nullptr) buffer = detail::thread_buffer = &register_thread();
+    if (!buffer->records.push(Record{name, begin_ns, end_ns})) {
+      buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  inline void record_instant(const char* name) noexcept
+  {
+    record(name, now_ns(), -1);
+  }
+
+  /// Records the time from its construction to its destruction. Used by @ref TIME_SCOPE.
+  struct ScopeTimer {
+    ScopeTimer(const char* name) noexcept : name(name), begin_ns(now_ns()) {}
+
+    ScopeTimer(const ScopeTimer&) = delete;
+    ScopeTimer& operator=(const ScopeTimer&) = delete;
+
+    ~ScopeTimer() noexcept
+    {
+      record(name, begin_ns, now_ns());
+    }
+
+  private:
+    const char* name;
+    std::int64_t begin_ns;
+  };
+
+  /// Move the records of all threads into the trace
+  ///
+  /// Called by the @ref services::UIManager once per frame when built with
+  /// `OTTO_ENABLE_TIMERS`.
+  void collect();
+
+  /// The number of records in the trace
+  std::size_t size();
+
+  /// The number of records dropped, since startup
+  std::size_t dropped();
+
+  /// Collect, and write the trace in the Chrome trace event format
+  void dump(const filesystem::path& path);
+
+  /// Remove all records from the trace
+  void clear();
+
+} // namespace otto::util::timer
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace otto::util {
+
+  /// Hands snapshots of a value from one thread to another, without locks or allocations
+  ///
+  /// The producer (usually the audio thread) calls @ref publish with a new snapshot, and the
+  /// consumer (usually the UI thread) reads the latest one with @ref read. Each side has a buffer
+  /// of its own, and the third is swapped between them, so neither ever waits for the other.
+  /// Snapshots that are published faster than they are read are dropped.
+  ///
+  /// There may be only one producer thread and one consumer thread.
+  ///
+  /// \requires `T` shall be `DefaultConstructible` and `CopyAssignable`
+  template<typename T>
+  struct TripleBuffer {
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /// Publish a new snapshot. Only to be called from the producer thread.
+    void publish(const T& value) noexcept
+    {
+      _buffers[_write] = value;
+      _write = _middle.exchange(_write | fresh_bit, std::memory_order_acq_rel) & index_mask;
+    }
+
+    /// The latest published snapshot, or a default constructed `T` before the first
+    ///
+    /// The reference is valid until the next call. Only to be called from the consumer thread.
+    const T& read() noexcept
+    {
+      if (_middle.load(std::memory_order_relaxed) & fresh_bit) {
+        _read = _middle.exchange(_read, std::memory_order_acq_rel) & index_mask;
+      }
+      return _buffers[_read];
+    }
+
+    /// Whether a snapshot has been published since the last @ref read
+    bool has_new() const noexcept
+    {
+      return _middle.load(std::memory_order_relaxed) & fresh_bit;
+    }
+
+  private:
+    static constexpr std::uint8_t index_mask = 0b011;
+    /// Set on the middle index when it holds a snapshot that has not been read
+    static constexpr std::uint8_t fresh_bit = 0b100;
+
+    std::array<T, 3> _buffers = {};
+    /// Owned by the producer
+    std::uint8_t _write = 0;
+    std::atomic<std::uint8_t> _middle = 1;
+    /// Owned by the consumer
+    std::uint8_t _read = 2;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,66 @@
+#include "wait_counter.hpp"
+
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <algorithm>
+#include <thread>
+#endif
+
+namespace otto::util {
+
+#ifdef __linux__
+  static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+                  std::atomic<std::uint32_t>::is_always_lock_free,
+                "The futex needs the counter to be a plain 32 bit integer");
+
+  static long futex(const std::atomic<std::uint32_t>& word,
+                    int op,
+                    std::uint32_t val,
+                    const timespec* timeout) noexcept
+  {
+    auto* addr = const_cast<std::uint32_t*>(reinterpret_cast<const std::uint32_t*>(&word));
+    return syscall(SYS_futex, addr, op, val, timeout, nullptr, 0);
+  }
+#endif
+
+  void WaitCounter::increment() noexcept
+  {
+    _value.fetch_add(1, std::memory_order_seq_cst);
+    // Either this sees the waiter, or the waiter sees the new value
+#ifdef __linux__
+    if (_waiters.load(std::memory_order_seq_cst) > 0) {
+      futex(_value, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+    }
+#endif
+  }
+
+  bool WaitCounter::wait_past(std::uint32_t value, std::chrono::nanoseconds timeout) const noexcept
+  {
+    const auto deadline = clock::now() + timeout;
+    _waiters.fetch_add(1, std::memory_order_seq_cst);
+    bool passed = true;
+    for (std::uint32_t current; std::int32_t((current = _value.load()) - value) <= 0;) {
+      auto left = deadline - clock::now();
+      if (left <= clock::duration::zero()) {
+        passed = false;
+        break;
+      }
+#ifdef __linux__
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+      timespec ts = {time_t(ns / 1'000'000'000), long(ns % 1'000'000'000)};
+      // Returns right away if the counter is no longer `current`
+      futex(_value, FUTEX_WAIT_PRIVATE, current, &ts);
+#else
+      std::this_thread::sleep_for(std::min<clock::duration>(left, std::chrono::milliseconds(1)));
+#endif
+    }
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+    return passed;
+  }
+
+} // namespace otto::util
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace otto::util {
+
+  /// A counter that other threads can sleep on until it passes a value
+  ///
+  /// One thread, usually the audio thread, calls @ref increment, which never blocks or locks.
+  /// On Linux, it wakes the waiting threads with a futex, and only makes the system call when
+  /// a thread is waiting. Elsewhere, waiting threads poll the counter every millisecond.
+  ///
+  /// ```cpp
+  /// // On the UI thread
+  /// auto seen = counter.value();
+  /// if (!counter.wait_past(seen, std::chrono::milliseconds(100))) LOGW("Timed out");
+  /// ```
+  struct WaitCounter {
+    using clock = std::chrono::steady_clock;
+
+    WaitCounter() noexcept = default;
+    WaitCounter(const WaitCounter&) = delete;
+    WaitCounter& operator=(const WaitCounter&) = delete;
+
+    /// Increment the counter, and wake up all waiting threads
+    void increment() noexcept;
+
+    std::uint32_t value() const noexcept
+    {
+      return _value.load(std::memory_order_acquire);
+    }
+
+    /// Sleep until the counter has passed `value`, or `timeout` has elapsed
+    ///
+    /// The counter wraps around, so it must not be more than 2^31 behind `value`.
+    ///
+    /// \returns `false` on timeout
+    bool wait_past(std::uint32_t value, std::chrono::nanoseconds timeout) const noexcept;
+
+  private:
+    std::atomic<std::uint32_t> _value = 0;
+    mutable std::atomic_int _waiters = 0;
+  };
+
+} // namespace otto::util
@@ -0,0 +1,180 @@
+#include "wav_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "services/log_manager.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::util {
+
+  namespace {
+    /// How often the writer thread looks for full blocks. A block holds seconds of audio.
+    constexpr auto write_interval = std::chrono::milliseconds(50);
+
+    void put(std::byte* dst, const char* fourcc) noexcept
+    {
+      std::memcpy(dst, fourcc, 4);
+    }
+
+    /// Little endian, whatever the platform
+    template<int Bytes>
+    void put(std::byte* dst, std::uint32_t value) noexcept
+    {
+      for (int b = 0; b < Bytes; b++) dst[b] = std::byte((value >> (8 * b)) & 0xFF);
+    }
+  } // namespace
+
+  WavWriter::WavWriter(const fs::path& path, int channels, int samplerate, float seconds)
+    : _path(path),
+      _channels(channels),
+      _samplerate(samplerate),
+      _block_count(std::clamp<int>(std::ceil(seconds * samplerate * channels * 3 / block_size), 2, max_blocks)),
+      _memory(header_size + _block_count * block_size)
+  {
+    for (int i = 0; i < _block_count; i++) _free.push(i);
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    constexpr int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    // Fails on file systems without direct io, like tmpfs
+    _fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    _direct = _fd >= 0;
+#endif
+    if (_fd < 0) _fd = ::open(path.c_str(), flags, 0644);
+    if (_fd < 0) {
+      LOGE("Recording: could not create {}: {}", path.c_str(), std::strerror(errno));
+      return;
+    }
+    write_header(0);
+    _thread = util::start_thread(util::ThreadClass::io, [this] { run(); });
+  }
+
+  WavWriter::~WavWriter()
+  {
+    _quit = true;
+    if (_thread.joinable()) _thread.join();
+    if (!is_open()) return;
+#ifdef O_DIRECT
+    // The rest is shorter than a block, so not aligned for direct io
+    if (_direct) ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) & ~O_DIRECT);
+#endif
+    if (_current >= 0 && _fill > 0) {
+      // Chunks of an odd size are followed by a pad byte
+      block(_current)[_fill] = std::byte(0);
+      if (write_at(block(_current), _fill + _fill % 2, header_size + _written)) _written += _fill;
+    }
+    write_header(_written);
+    ::close(_fd);
+    LOGI("Recording: wrote {} seconds to {}, dropped {} frames",
+         float(_written) / (_channels * 3 * _samplerate), _path.c_str(), dropped_frames());
+  }
+
+  void WavWriter::write(gsl::span<const float* const> channels, std::size_t nframes) noexcept
+  {
+    const std::size_t bytes = nframes * _channels * 3;
+    const std::size_t space = _free.read_available() * block_size + (_current >= 0 ? block_size - _fill : 0);
+    if (!is_open() || bytes > space) {
+      _dropped_frames.fetch_add(nframes, std::memory_order_relaxed);
+      return;
+    }
+    for (std::size_t i = 0; i < nframes; i++) {
+      for (int ch = 0; ch < _channels; ch++) {
+        const float* data = ch < int(channels.size()) ? channels[ch] : nullptr;
+        float sample = data == nullptr ? 0.f : std::clamp(data[i], -1.f, 1.f);
+        auto value = std::uint32_t(std::int32_t(std::lround(sample * 8388607.f)));
+        // Samples may straddle two blocks
+        for (int b = 0; b < 3; b++) {
+          if (_current < 0) {
+            _free.pop(_current);
+            _fill = 0;
+          }
+          block(_current)[_fill++] = std::byte((value >> (8 * b)) & 0xFF);
+          if (_fill == block_size) {
+            _full.push(_current);
+            _current = -1;
+          }
+        }
+      }
+    }
+  }
+
+  void WavWriter::run()
+  {
+    while (!_quit) {
+      std::this_thread::sleep_for(write_interval);
+      write_blocks();
+    }
+    write_blocks();
+  }
+
+  void WavWriter::write_blocks() noexcept
+  {
+    int index;
+    while (_full.pop(index)) {
+      if (write_at(block(index), block_size, header_size + _written)) {
+        _written += block_size;
+        write_header(_written);
+      }
+      _free.push(index);
+    }
+  }
+
+  void WavWriter::write_header(std::uint64_t data_bytes) noexcept
+  {
+    auto* h = static_cast<std::byte*>(_memory.data());
+    const std::uint32_t frame_bytes = _channels * 3;
+    // A wav file is limited to 4GB, which is over 7 hours of 24 bit stereo at 48kHz
+    const auto data_size = std::uint32_t(std::min<std::uint64_t>(data_bytes, UINT32_MAX - header_size));
+    put(h, "RIFF");
+    put<4>(h + 4, header_size - 8 + data_size + data_size % 2);
+    put(h + 8, "WAVE");
+    put(h + 12, "fmt ");
+    put<4>(h + 16, 16);
+    put<2>(h + 20, 1);
+    put<2>(h + 22, _channels);
+    put<4>(h + 24, _samplerate);
+    put<4>(h + 28, _samplerate * frame_bytes);
+    put<2>(h + 32, frame_bytes);
+    put<2>(h + 34, 24);
+    // Pads the header, so the data starts at `header_size`
+    put(h + 36, "JUNK");
+    put<4>(h + 40, header_size - 8 - 44);
+    put(h + header_size - 8, "data");
+    put<4>(h + header_size - 4, data_size);
+    write_at(h, header_size, 0);
+  }
+
+  bool WavWriter::write_at(const void* data, std::size_t bytes, std::uint64_t offset) noexcept
+  {
+    auto* src = static_cast<const std::byte*>(data);
+    while (bytes > 0) {
+      auto n = ::pwrite(_fd, src, bytes, offset);
+      if (n < 0 && errno == EINTR) continue;
+#ifdef O_DIRECT
+      if (n < 0 && errno == EINVAL && _direct) {
+        // The file system opened the file for direct io, but does not support it after all
+        _direct = false;
+        ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) & ~O_DIRECT);
+        continue;
+      }
+#endif
+      if (n <= 0) {
+        if (!_failed) LOGE("Recording: could not write to {}: {}", _path.c_str(), std::strerror(errno));
+        _failed = true;
+        return false;
+      }
+      src += n;
+      bytes -= n;
+      offset += n;
+    }
+    return true;
+  }
+
+} // namespace otto::util
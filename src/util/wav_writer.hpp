@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include <gsl/span>
+
+#include "util/filesystem.hpp"
+#include "util/page_memory.hpp"
+#include "util/spsc_ring.hpp"
+
+namespace otto::util {
+
+  /// Streams audio to one 24 bit wav file on a thread of its own, for recordings of hours
+  ///
+  /// @ref write packs the frames into blocks of @ref block_size bytes in memory, and hands the
+  /// full ones to the writer thread through a lock-free ring. The writer thread writes each
+  /// block whole, with `O_DIRECT` where the file system allows it, so a long recording neither
+  /// fills the page cache nor is written in small pieces. The header is padded to
+  /// @ref header_size bytes with a `JUNK` chunk, so the blocks stay aligned in the file. It is
+  /// rewritten after each block, so a recording cut short by a crash or a power loss is
+  /// readable up to its last block.
+  ///
+  /// `write` never waits for the disk. The blocks hold the given seconds of audio, and if a
+  /// stall of the disk outlasts them, whole buffers are dropped, and counted in
+  /// @ref dropped_frames.
+  struct WavWriter {
+    static constexpr std::size_t block_size = 1 << 20;
+    /// The size of the header, a multiple of the logical block size of any disk
+    static constexpr std::size_t header_size = 4096;
+    /// The most blocks to buffer, 256MB
+    static constexpr std::size_t max_blocks = 256;
+
+    /// Creates the file, and its parent directory. Errors are logged, and the frames dropped.
+    ///
+    /// \param seconds The audio to buffer, for stalls of the disk
+    WavWriter(const fs::path& path, int channels, int samplerate, float seconds);
+
+    /// Writes the rest of the frames, and closes the file
+    ~WavWriter();
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    /// Add a buffer, with one pointer per channel. A null pointer is a silent channel.
+    ///
+    /// Only to be called from one thread at a time. Never blocks.
+    void write(gsl::span<const float* const> channels, std::size_t nframes) noexcept;
+
+    /// Whether the file could be created
+    bool is_open() const noexcept
+    {
+      return _fd >= 0;
+    }
+
+    /// The number of frames dropped because all blocks were waiting for the disk
+    std::size_t dropped_frames() const noexcept
+    {
+      return _dropped_frames.load(std::memory_order_relaxed);
+    }
+
+  private:
+    void run();
+    /// Write the full blocks handed over. On the writer thread.
+    void write_blocks() noexcept;
+    /// Write the header for `data_bytes` of audio
+    void write_header(std::uint64_t data_bytes) noexcept;
+    /// Write all of `bytes` at `offset`, and log an error if that fails
+    bool write_at(const void* data, std::size_t bytes, std::uint64_t offset) noexcept;
+
+    std::byte* block(int index) const noexcept
+    {
+      return static_cast<std::byte*>(_memory.data()) + header_size + index * block_size;
+    }
+
+    fs::path _path;
+    int _fd = -1;
+    bool _direct = false;
+    int _channels;
+    int _samplerate;
+    int _block_count;
+    /// The header, followed by the blocks, all aligned to pages
+    PageMemory _memory;
+
+    /// The blocks ready to be written, in order
+    SPSCRing<int, max_blocks> _full;
+    /// The blocks written, to be filled again
+    SPSCRing<int, max_blocks> _free;
+    /// The block being filled, or -1. Only used by the thread calling @ref write.
+    int _current = -1;
+    std::size_t _fill = 0;
+
+    /// The bytes of audio written to the file. Only used by the writer thread, until it has
+    /// stopped.
+    std::uint64_t _written = 0;
+    std::atomic<std::size_t> _dropped_frames = 0;
+    /// Set once a write failed, to log only the first error
+    bool _failed = false;
+    std::atomic_bool _quit = false;
+    std::thread _thread;
+  };
+
+} // namespace otto::util
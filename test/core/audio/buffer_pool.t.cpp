@@ -0,0 +1,144 @@
+#include "testing.t.hpp"
+
+#include <thread>
+
+#include "core/audio/processor.hpp"
+
+namespace otto::core::audio {
+
+  TEST_CASE ("AudioBufferPool", "[audio]") {
+    AudioBufferPool pool{16, 2};
+
+    SECTION ("Buffers are returned to the pool when the last handle is released") {
+      float* first;
+      {
+        auto a = pool.allocate();
+        first = a.data();
+        auto b = a;
+        REQUIRE(a.reference_count() == 2);
+      }
+      auto c = pool.allocate();
+      REQUIRE(c.data() == first);
+      REQUIRE(pool.high_water_mark() == 1);
+      REQUIRE(pool.overflow_count() == 0);
+    }
+
+    SECTION ("Assignment releases the previous buffer") {
+      auto a = pool.allocate();
+      auto b = pool.allocate();
+      b = a;
+      auto c = pool.allocate();
+      REQUIRE(pool.overflow_count() == 0);
+      REQUIRE(c.data() != a.data());
+    }
+
+    SECTION ("The silence mark is kept by copies, and new buffers are unmarked") {
+      auto a = pool.allocate_clear();
+      REQUIRE_FALSE(a.is_silent());
+      a.mark_silent();
+      auto b = a;
+      auto c = std::move(b);
+      REQUIRE(c.is_silent());
+      REQUIRE(c.slice(4).is_silent());
+      c = pool.allocate();
+      REQUIRE_FALSE(c.is_silent());
+    }
+
+    SECTION ("Views and slices do not own the buffer") {
+      auto a = pool.allocate();
+      auto view = a.view();
+      auto copy = view;
+      auto slice = a.slice(4, 8);
+      REQUIRE(a.reference_count() == 1);
+      REQUIRE_FALSE(copy.owning());
+      REQUIRE_FALSE(slice.owning());
+      REQUIRE(copy.data() == a.data());
+      REQUIRE(slice.data() == a.data() + 4);
+      REQUIRE(slice.size() == 8);
+      view.release();
+      REQUIRE(a.reference_count() == 1);
+      a.release();
+      auto b = pool.allocate();
+      auto c = pool.allocate();
+      REQUIRE(pool.overflow_count() == 0);
+    }
+
+    SECTION ("Overflow hands out the emergency buffer") {
+      auto a = pool.allocate();
+      auto b = pool.allocate();
+      auto c = pool.allocate();
+      REQUIRE(pool.overflow_count() == 1);
+      REQUIRE(pool.high_water_mark() == 2);
+      REQUIRE(c.data() != a.data());
+      REQUIRE(c.data() != b.data());
+      c.release();
+      // The emergency buffer is not put on the free list
+      a.release();
+      auto d = pool.allocate();
+      REQUIRE(pool.overflow_count() == 1);
+    }
+
+    SECTION ("Buffers are aligned to cache lines and padded") {
+      AudioBufferPool odd{67, 3};
+      REQUIRE(odd.stride() == 80);
+      auto a = odd.allocate();
+      auto b = odd.allocate();
+      REQUIRE(a.size() == 67);
+      REQUIRE(a.padded_size() == 68);
+      REQUIRE(reinterpret_cast<std::uintptr_t>(a.data()) % cache_line_size == 0);
+      REQUIRE(reinterpret_cast<std::uintptr_t>(b.data()) % cache_line_size == 0);
+      REQUIRE(a.assume_aligned() == a.data());
+      // The padding is zeroed
+      for (std::size_t i = a.size(); i < odd.stride(); i++) REQUIRE(a.data()[i] == 0.f);
+    }
+
+    SECTION ("Reference counts are atomic") {
+      static_assert(alignof(AudioBufferRefCount) == cache_line_size);
+      auto a = pool.allocate();
+      auto work = [&a] {
+        for (int i = 0; i < 10000; i++) {
+          auto copy = a;
+        }
+      };
+      std::thread t1(work);
+      std::thread t2(work);
+      t1.join();
+      t2.join();
+      REQUIRE(a.reference_count() == 1);
+    }
+
+    SECTION ("EngineBuffers hand out the same memory without the pool while it is free") {
+      AudioContext context{&pool};
+      EngineBuffers<2> buffers;
+      float* first;
+      {
+        auto [left, right] = buffers.acquire(context, 16);
+        first = left.data();
+        REQUIRE(left.size() == 16);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(right.data()) % cache_line_size == 0);
+        REQUIRE(pool.high_water_mark() == 0);
+        // Still held, so the pool steps in
+        auto [again] = buffers.acquire<1>(context, 16);
+        REQUIRE(again.data() != first);
+        REQUIRE(pool.high_water_mark() == 1);
+      }
+      auto [left] = buffers.acquire<1>(context, 8);
+      REQUIRE(left.data() == first);
+      EngineBuffers<1> other;
+      auto [longer] = other.acquire(context, max_buffer_size + 1);
+      REQUIRE(longer.data() != other.data(0));
+      REQUIRE(pool.overflow_count() == 0);
+    }
+
+#if OTTO_DEBUG_BUFFERS
+    SECTION ("Leaked buffers are detected and reclaimed") {
+      auto a = pool.allocate();
+      REQUIRE(pool.check_leaks() == 1);
+      auto b = pool.allocate();
+      auto c = pool.allocate();
+      REQUIRE(pool.overflow_count() == 0);
+    }
+#endif
+  }
+
+} // namespace otto::core::audio
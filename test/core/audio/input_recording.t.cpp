@@ -0,0 +1,58 @@
+#include "testing.t.hpp"
+
+#include <fstream>
+#include <sstream>
+
+#include "core/audio/input_recording.hpp"
+
+namespace otto::core::audio {
+
+  TEST_CASE ("InputRecording", "[midi]") {
+    auto path = test::dir / "recording.ottorec";
+    InputRecording rec;
+    rec.samplerate = 44100;
+    rec.buffer_size = 512;
+    rec.parts = {"Synth", "Master"};
+    rec.midi.push_back({0, midi::NoteOnEvent(60, 1, 0, 300)});
+    rec.midi.push_back({3, midi::PitchBendEvent(9000)});
+    rec.properties.push_back({2, 1, 0xDEADBEEF, 0.123456789});
+
+    SECTION ("A recording reads back the same") {
+      rec.save(path);
+      auto res = InputRecording::load(path);
+      REQUIRE(res.samplerate == 44100);
+      REQUIRE(res.buffer_size == 512);
+      REQUIRE(res.parts == rec.parts);
+      REQUIRE(res.midi.size() == 2);
+      REQUIRE(res.midi[0].buffer == 0);
+      REQUIRE(res.midi[0].event.status == rec.midi[0].event.status);
+      REQUIRE(res.midi[0].event.data[0] == 60);
+      REQUIRE(res.midi[0].event.time == 300);
+      REQUIRE(res.midi[1].buffer == 3);
+      REQUIRE(res.midi[1].event.data[1] == rec.midi[1].event.data[1]);
+      REQUIRE(res.properties.size() == 1);
+      REQUIRE(res.properties[0].buffer == 2);
+      REQUIRE(res.properties[0].part == 1);
+      REQUIRE(res.properties[0].hash == 0xDEADBEEF);
+      REQUIRE(res.properties[0].value == 0.123456789);
+      REQUIRE(res.length() == 4);
+    }
+
+    SECTION ("A recording cut short is read up to its last whole record") {
+      std::ostringstream out;
+      rec.save(path);
+      out << std::ifstream(path.c_str(), std::ios::binary).rdbuf();
+      auto data = out.str();
+      std::ofstream(path.c_str(), std::ios::binary) << data.substr(0, data.size() - 3);
+      auto res = InputRecording::load(path);
+      REQUIRE(res.midi.size() == 2);
+      REQUIRE(res.properties.empty());
+    }
+
+    SECTION ("Other files are rejected") {
+      std::ofstream(path.c_str()) << "MThd";
+      REQUIRE_THROWS_AS(InputRecording::load(path), InputRecording::exception);
+    }
+  }
+
+} // namespace otto::core::audio
@@ -0,0 +1,40 @@
+#include "testing.t.hpp"
+
+#include "core/audio/midi.hpp"
+
+namespace otto::core::midi {
+
+  TEST_CASE ("note_freq", "[midi]") {
+    REQUIRE(note_freq(69) == Approx(440));
+    REQUIRE(note_freq(57) == Approx(220));
+    REQUIRE(note_freq(60) == Approx(261.6256).epsilon(1e-5));
+
+    SECTION ("Fractional notes are within a cent of equal temperament") {
+      for (float note : {0.5f, 30.25f, 60.5f, 126.75f}) {
+        auto exact = 440 * std::exp2((note - 69) / 12);
+        REQUIRE(std::abs(1200 * std::log2(note_freq(note) / exact)) < 1);
+      }
+      REQUIRE(note_freq(200.f) == note_freq(127));
+    }
+
+    SECTION ("Custom tunings") {
+      std::array<float, 128> freqs;
+      for (int i = 0; i < 128; i++) freqs[i] = 100 + i;
+      set_tuning(freqs);
+      REQUIRE(note_freq(10) == 110);
+      REQUIRE(note_freq(10.5f) == Approx(110.5));
+      generateFreqTable(440);
+      REQUIRE(note_freq(69) == Approx(440));
+    }
+  }
+
+  TEST_CASE ("pitch_bend_ratio", "[midi]") {
+    REQUIRE(pitch_bend_ratio(8192) == 1);
+    REQUIRE(pitch_bend_ratio(0) == Approx(0.5));
+    REQUIRE(pitch_bend_ratio(16383) == Approx(2).epsilon(1e-3));
+    for (int value = 0; value < 16384; value += 37) {
+      REQUIRE(pitch_bend_ratio(value) == Approx(std::pow(2.f, value / 8192.f - 1.f)).epsilon(1e-5));
+    }
+  }
+
+} // namespace otto::core::midi
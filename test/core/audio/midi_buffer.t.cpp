@@ -0,0 +1,131 @@
+#include "testing.t.hpp"
+
+#include "core/audio/midi.hpp"
+
+namespace otto::core::midi {
+
+  TEST_CASE ("MidiBuffer", "[midi]") {
+    MidiBuffer buffer;
+    MidiBufferRef ref = buffer;
+
+    SECTION ("References share the buffer") {
+      MidiBufferRef copy = ref;
+      copy.push_back(NoteOnEvent(60));
+      REQUIRE(buffer.size() == 1);
+      REQUIRE(ref.size() == 1);
+      ref.clear();
+      REQUIRE(copy.empty());
+    }
+
+    SECTION ("Events are dropped and counted when full") {
+      for (std::size_t i = 0; i < MidiBuffer::capacity; i++) {
+        REQUIRE(ref.push_back(NoteOnEvent(60)));
+      }
+      REQUIRE_FALSE(ref.push_back(NoteOffEvent(60)));
+      REQUIRE_FALSE(ref.push_back(NoteOffEvent(60)));
+      REQUIRE(buffer.size() == MidiBuffer::capacity);
+      REQUIRE(buffer.overflow_count() == 2);
+      buffer.clear();
+      REQUIRE(buffer.overflow_count() == 0);
+    }
+
+    SECTION ("An empty reference drops events") {
+      MidiBufferRef empty;
+      REQUIRE(empty.empty());
+      REQUIRE_FALSE(empty.push_back(NoteOnEvent(60)));
+      REQUIRE(empty.begin() == empty.end());
+    }
+  }
+
+  TEST_CASE ("copy_channel", "[midi]") {
+    MidiBuffer src;
+    src.push_back(NoteOnEvent(60, 1, 0));
+    src.push_back(NoteOnEvent(62, 1, 3));
+    src.push_back(NoteOffEvent(60, 1, 0));
+    MidiBuffer dst;
+
+    SECTION ("Only the events on the channel are added") {
+      copy_channel(src, dst, 3);
+      REQUIRE(dst.size() == 1);
+      REQUIRE(dst[0].note_on().key == 62);
+      copy_channel(src, dst, 0);
+      REQUIRE(dst.size() == 3);
+    }
+
+    SECTION ("A negative channel adds all events") {
+      copy_channel(src, dst, -1);
+      REQUIRE(dst.size() == 3);
+    }
+  }
+
+  TEST_CASE ("copy_matching", "[midi]") {
+    MidiBuffer src;
+    src.push_back(NoteOnEvent(60));
+    src.push_back(ControlChangeEvent(1, 64));
+    src.push_back(PitchBendEvent(0));
+    src.push_back(NoteOffEvent(60));
+    MidiBuffer dst;
+
+    SECTION ("Only the events of the kinds in the mask are added, in order") {
+      copy_matching(src, dst, EventMask::notes | EventMask::pitch_bend);
+      REQUIRE(dst.size() == 3);
+      REQUIRE(dst[0].type() == MidiEvent::Type::NoteOn);
+      REQUIRE(dst[1].type() == MidiEvent::Type::PitchBend);
+      REQUIRE(dst[2].type() == MidiEvent::Type::NoteOff);
+    }
+
+    SECTION ("Events without a struct of their own are other events") {
+      AnyMidiEvent program_change;
+      program_change.status = 0xC0;
+      REQUIRE(mask_of(program_change) == EventMask::other);
+      copy_matching(src, dst, EventMask::other);
+      REQUIRE(dst.empty());
+    }
+  }
+
+  TEST_CASE ("AnyMidiEvent", "[midi]") {
+    SECTION ("Typed events survive packing") {
+      AnyMidiEvent on = NoteOnEvent(64, 100 / 127.f, 3, 17);
+      REQUIRE(on.type() == MidiEvent::Type::NoteOn);
+      REQUIRE(on.channel() == 3);
+      REQUIRE(on.time == 17);
+      REQUIRE(on.note_on().key == 64);
+      REQUIRE(on.note_on().velocity == 100);
+
+      ControlChangeEvent cc_evt = {0x40, 127};
+      AnyMidiEvent cc = cc_evt;
+      REQUIRE(cc.control_change().controler == 0x40);
+      REQUIRE(cc.control_change().value == 127);
+
+      PitchBendEvent pb_evt = {12345};
+      AnyMidiEvent pb = pb_evt;
+      REQUIRE(pb.pitch_bend().value == 12345);
+    }
+
+    SECTION ("util::match dispatches on the status byte") {
+      int matched = -1;
+      auto match = [&](AnyMidiEvent evt) {
+        util::match(evt, [&](NoteOnEvent& e) { matched = e.key; },
+                    [&](NoteOffEvent& e) { matched = 1000 + e.key; }, [&](auto&&) { matched = 0; });
+      };
+      match(NoteOnEvent(60));
+      REQUIRE(matched == 60);
+      match(NoteOffEvent(61));
+      REQUIRE(matched == 1061);
+      match(ControlChangeEvent(1, 2));
+      REQUIRE(matched == 0);
+    }
+
+    SECTION ("Raw bytes round trip") {
+      std::array<unsigned char, 3> bytes = {0x92, 60, 0};
+      // NoteOn with velocity 0 is a NoteOff
+      auto evt = from_bytes(bytes, 5);
+      REQUIRE(evt.type() == MidiEvent::Type::NoteOff);
+      REQUIRE(evt.channel() == 2);
+      REQUIRE(evt.time == 5);
+      REQUIRE(evt.byte_size() == 3);
+      REQUIRE(evt.to_bytes() == std::array<unsigned char, 3>{0x82, 60, 0});
+    }
+  }
+
+} // namespace otto::core::midi
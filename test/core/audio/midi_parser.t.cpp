@@ -0,0 +1,105 @@
+#include "testing.t.hpp"
+
+#include <vector>
+
+#include "core/audio/midi_parser.hpp"
+
+namespace otto::core::midi {
+
+  using Kind = MidiParser::Kind;
+  using Bytes = std::vector<unsigned char>;
+
+  /// The messages parsed from `bytes`, with the data of each sysex chunk
+  static std::vector<MidiParser::Message> parse(MidiParser& parser, Bytes bytes, std::vector<Bytes>* sysex = nullptr)
+  {
+    std::vector<MidiParser::Message> res;
+    parser.parse(bytes, [&](const MidiParser::Message& msg) {
+      res.push_back(msg);
+      if (sysex && (msg.kind == Kind::sysex_chunk || msg.kind == Kind::sysex_end)) {
+        sysex->emplace_back(parser.sysex().begin(), parser.sysex().end());
+      }
+    });
+    return res;
+  }
+
+  TEST_CASE ("MidiParser", "[midi]") {
+    MidiParser parser;
+
+    SECTION ("Channel messages") {
+      auto res = parse(parser, {0x91, 60, 100, 0xB0, 1, 64});
+      REQUIRE(res.size() == 2);
+      REQUIRE(res[0].kind == Kind::channel);
+      REQUIRE(res[0].event.type() == MidiEvent::Type::NoteOn);
+      REQUIRE(res[0].event.channel() == 1);
+      REQUIRE(res[0].event.note_on().key == 60);
+      REQUIRE(res[1].event.control_change().value == 64);
+    }
+
+    SECTION ("Two byte messages do not wait for a third byte") {
+      auto res = parse(parser, {0xC0, 5, 0xD2, 90});
+      REQUIRE(res.size() == 2);
+      REQUIRE(res[0].event.status == 0xC0);
+      REQUIRE(res[0].event.data[0] == 5);
+      REQUIRE(res[0].event.byte_size() == 2);
+      REQUIRE(res[1].event.status == 0xD2);
+      REQUIRE(res[1].event.data[0] == 90);
+    }
+
+    SECTION ("Running status, and note on with velocity 0 as note off") {
+      auto res = parse(parser, {0x90, 60, 100, 62, 100, 60, 0});
+      REQUIRE(res.size() == 3);
+      REQUIRE(res[1].event.note_on().key == 62);
+      REQUIRE(res[2].event.type() == MidiEvent::Type::NoteOff);
+      REQUIRE(res[2].event.note_off().key == 60);
+    }
+
+    SECTION ("Realtime bytes in the middle of a message") {
+      auto res = parse(parser, {0x90, 0xF8, 60, 0xFA, 100});
+      REQUIRE(res.size() == 3);
+      REQUIRE(res[0].kind == Kind::realtime);
+      REQUIRE(res[0].status == 0xF8);
+      REQUIRE(res[1].status == 0xFA);
+      REQUIRE(res[2].kind == Kind::channel);
+      REQUIRE(res[2].event.note_on().velocity == 100);
+    }
+
+    SECTION ("System exclusive messages are handed out in chunks") {
+      Bytes bytes = {0xF0};
+      for (std::size_t i = 0; i < MidiParser::sysex_capacity + 10; i++) bytes.push_back(i & 0x7F);
+      bytes.push_back(0xF7);
+      bytes.insert(bytes.end(), {0x80, 60, 0});
+      std::vector<Bytes> sysex;
+      auto res = parse(parser, bytes, &sysex);
+      REQUIRE(res.size() == 3);
+      REQUIRE(res[0].kind == Kind::sysex_chunk);
+      REQUIRE(res[1].kind == Kind::sysex_end);
+      REQUIRE(sysex[0].size() == MidiParser::sysex_capacity);
+      REQUIRE(sysex[1].size() == 10);
+      REQUIRE(sysex[1][0] == (MidiParser::sysex_capacity & 0x7F));
+      REQUIRE(res[2].event.type() == MidiEvent::Type::NoteOff);
+    }
+
+    SECTION ("A status byte ends a system exclusive message") {
+      auto res = parse(parser, {0xF0, 1, 2, 0x90, 60, 100});
+      REQUIRE(res.size() == 2);
+      REQUIRE(res[0].kind == Kind::sysex_end);
+      REQUIRE(res[1].event.note_on().key == 60);
+    }
+
+    SECTION ("System common messages cancel running status") {
+      auto res = parse(parser, {0x90, 60, 100, 0xF2, 0, 1, 62, 100});
+      REQUIRE(res.size() == 2);
+      REQUIRE(res[1].kind == Kind::system);
+      REQUIRE(res[1].event.data[1] == 1);
+      REQUIRE(parser.dropped_bytes() == 2);
+    }
+
+    SECTION ("Stray data bytes and an interrupted message are dropped") {
+      auto res = parse(parser, {60, 100, 0x90, 60, 0xB0, 1, 2});
+      REQUIRE(res.size() == 1);
+      REQUIRE(res[0].event.control_change().controler == 1);
+      REQUIRE(parser.dropped_bytes() == 3);
+    }
+  }
+
+} // namespace otto::core::midi
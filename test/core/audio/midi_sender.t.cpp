@@ -0,0 +1,54 @@
+#include "testing.t.hpp"
+
+#include <mutex>
+#include <vector>
+
+#include "core/audio/midi_sender.hpp"
+
+namespace otto::core::midi {
+
+  TEST_CASE ("MidiSender", "[midi]") {
+    using clock = MidiSender::clock;
+    struct Sent {
+      unsigned char status;
+      clock::time_point time;
+    };
+    std::mutex mutex;
+    std::vector<Sent> sent;
+    auto send = [&](const unsigned char* bytes, std::size_t size) {
+      std::lock_guard lock(mutex);
+      sent.push_back({bytes[0], clock::now()});
+    };
+
+    SECTION ("Messages are sent when due, in the order they are due") {
+      auto t0 = clock::now();
+      {
+        MidiSender sender(send);
+        unsigned char note_on[] = {0x90, 60, 100};
+        unsigned char note_off[] = {0x80, 60, 0};
+        unsigned char tick = 0xF8;
+        sender.push(note_off, 3, t0 + std::chrono::milliseconds(40));
+        sender.push(note_on, 3, t0 + std::chrono::milliseconds(20));
+        sender.push(&tick, 1, t0 + std::chrono::milliseconds(20));
+        std::this_thread::sleep_for(std::chrono::milliseconds(80));
+        REQUIRE(sender.dropped() == 0);
+      }
+      REQUIRE(sent.size() == 3);
+      REQUIRE(sent[0].status == 0x90);
+      REQUIRE(sent[1].status == 0xF8);
+      REQUIRE(sent[2].status == 0x80);
+      REQUIRE(sent[0].time >= t0 + std::chrono::milliseconds(20));
+      REQUIRE(sent[2].time >= t0 + std::chrono::milliseconds(40));
+    }
+
+    SECTION ("The messages left are sent on destruction") {
+      {
+        MidiSender sender(send);
+        unsigned char note_on[] = {0x90, 60, 100};
+        sender.push(note_on, 3, clock::now() + std::chrono::seconds(10));
+      }
+      REQUIRE(sent.size() == 1);
+    }
+  }
+
+} // namespace otto::core::midi
@@ -0,0 +1,132 @@
+#include "testing.t.hpp"
+
+#include <sstream>
+
+#include "core/audio/midi_sequence.hpp"
+
+namespace otto::core::midi {
+
+  using Bytes = std::vector<unsigned char>;
+
+  /// A midi file with the given track chunks, and 96 ticks per quarter note
+  static Bytes midi_file(std::vector<Bytes> tracks, int format = 1)
+  {
+    Bytes res = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, (unsigned char) format, 0,
+                 (unsigned char) tracks.size(), 0, 96};
+    for (auto& track : tracks) {
+      auto size = track.size();
+      Bytes header = {'M', 'T', 'r', 'k', 0, 0, (unsigned char) (size >> 8), (unsigned char) size};
+      res.insert(res.end(), header.begin(), header.end());
+      res.insert(res.end(), track.begin(), track.end());
+    }
+    return res;
+  }
+
+  TEST_CASE ("MidiSequence::from_midi_file", "[midi]") {
+    SECTION ("Ticks are converted with the default tempo of 120 bpm") {
+      auto seq = MidiSequence::from_midi_file(midi_file({{
+        0x00, 0x90, 60, 100,       // note on at 0
+        0x60, 0x80, 60, 0,         // note off at one quarter
+        0x00, 0xFF, 0x2F, 0x00,    // end of track
+      }}));
+      REQUIRE(seq.events.size() == 2);
+      REQUIRE(seq.events[0].time == Approx(0));
+      REQUIRE(seq.events[0].event.type() == MidiEvent::Type::NoteOn);
+      REQUIRE(seq.events[0].event.note_on().key == 60);
+      REQUIRE(seq.events[1].time == Approx(0.5));
+      REQUIRE(seq.events[1].event.type() == MidiEvent::Type::NoteOff);
+    }
+
+    SECTION ("Running status and note on with velocity 0") {
+      auto seq = MidiSequence::from_midi_file(midi_file({{
+        0x00, 0x91, 60, 100, //
+        0x30, 64, 100,       // running status, note on
+        0x30, 60, 0,         // running status, note off
+      }}));
+      REQUIRE(seq.events.size() == 3);
+      REQUIRE(seq.events[1].event.note_on().key == 64);
+      REQUIRE(seq.events[1].event.channel() == 1);
+      REQUIRE(seq.events[1].time == Approx(0.25));
+      REQUIRE(seq.events[2].event.type() == MidiEvent::Type::NoteOff);
+    }
+
+    SECTION ("Tempo changes apply from their tick, across tracks") {
+      auto seq = MidiSequence::from_midi_file(midi_file({
+        // 120 bpm for one quarter, then 60 bpm
+        {0x60, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40},
+        {0x00, 0x90, 60, 100, 0x81, 0x40, 0x80, 60, 0},
+      }));
+      REQUIRE(seq.events.size() == 2);
+      // 192 ticks: one quarter at 120 bpm, one at 60
+      REQUIRE(seq.events[1].time == Approx(1.5));
+    }
+
+    SECTION ("Unsupported events are skipped") {
+      auto seq = MidiSequence::from_midi_file(midi_file({{
+        0x00, 0xC0, 5,                   // program change
+        0x00, 0xF0, 0x02, 0x01, 0xF7,    // sysex
+        0x00, 0xB0, 1, 64,               // control change
+      }}));
+      REQUIRE(seq.events.size() == 1);
+      REQUIRE(seq.events[0].event.control_change().controler == 1);
+      REQUIRE(seq.events[0].event.control_change().value == 64);
+    }
+
+    SECTION ("Invalid files throw") {
+      auto check = [](Bytes data) {
+        try {
+          MidiSequence::from_midi_file(data);
+          FAIL("No exception thrown");
+        } catch (MidiSequence::exception& e) {
+          REQUIRE(e.data() == MidiSequence::ErrorCode::invalid_midi_file);
+        }
+      };
+      check({'R', 'I', 'F', 'F'});
+      check(midi_file({{0x00, 0x90, 60}}));
+      check(midi_file({{0x00, 60, 100}}));
+      check(midi_file({}, 2));
+    }
+  }
+
+  TEST_CASE ("MidiSequence::from_script", "[midi]") {
+    SECTION ("Events are parsed and sorted by time") {
+      std::istringstream script(
+        "# A comment\n"
+        "0.5 note_off C3\n"
+        "\n"
+        "0   note_on  60 100   # middle C\n"
+        "0.25 cc 1 64 2\n"
+        "1 pitch_bend 16383\n");
+      auto seq = MidiSequence::from_script(script);
+      REQUIRE(seq.events.size() == 4);
+      REQUIRE(seq.length() == Approx(1));
+
+      REQUIRE(seq.events[0].time == 0);
+      REQUIRE(seq.events[0].event.note_on().key == 60);
+      REQUIRE(seq.events[0].event.note_on().velocity == 100);
+
+      REQUIRE(seq.events[1].event.control_change().value == 64);
+      REQUIRE(seq.events[1].event.channel() == 2);
+
+      REQUIRE(seq.events[2].event.type() == MidiEvent::Type::NoteOff);
+      REQUIRE(seq.events[2].event.note_off().key == note_number("C3"));
+
+      REQUIRE(seq.events[3].event.pitch_bend().value == 16383);
+    }
+
+    SECTION ("Invalid lines throw") {
+      for (auto line : {"note_on 60 100", "0 note_on 60", "0 note_on X9 100", "0 bend 10",
+                        "0 cc 1 200", "0 note_off 60 0 extra"}) {
+        CAPTURE(line);
+        std::istringstream script(line);
+        try {
+          MidiSequence::from_script(script);
+          FAIL("No exception thrown");
+        } catch (MidiSequence::exception& e) {
+          REQUIRE(e.data() == MidiSequence::ErrorCode::invalid_script);
+        }
+      }
+    }
+  }
+
+} // namespace otto::core::midi
@@ -0,0 +1,171 @@
+#include "testing.t.hpp"
+
+#include <cstdint>
+#include <fstream>
+
+#include <utime.h>
+
+#include "core/audio/sample_cache.hpp"
+
+namespace otto::core::audio {
+
+  static fs::path make_file(const std::string& name)
+  {
+    auto path = test::dir / name;
+    std::ofstream(path.c_str()) << name;
+    return path;
+  }
+
+  /// Set the modification time of `path` to `seconds` after the epoch
+  static void set_mtime(const fs::path& path, long seconds)
+  {
+    struct utimbuf times = {seconds, seconds};
+    REQUIRE(::utime(path.c_str(), &times) == 0);
+  }
+
+  TEST_CASE ("SampleCache", "[audio]") {
+    SampleCache cache;
+    auto a = make_file("a.wav");
+    auto b = make_file("b.wav");
+    int decodes = 0;
+    auto decoder = [&](std::size_t size) {
+      return [&decodes, size] {
+        decodes++;
+        return SampleCache::Samples(size, 1.f);
+      };
+    };
+
+    SECTION ("Files are decoded once, and shared") {
+      auto first = cache.get(a, "wavetable", decoder(10));
+      auto second = cache.get(a, "wavetable", decoder(10));
+      REQUIRE(first == second);
+      REQUIRE(decodes == 1);
+      REQUIRE(cache.hits() == 1);
+      REQUIRE(cache.misses() == 1);
+      REQUIRE(cache.size() == 10 * sizeof(float));
+    }
+
+    SECTION ("Kinds of the same file are cached separately") {
+      auto wavetable = cache.get(a, "wavetable", decoder(10));
+      auto head = cache.get(a, "head", decoder(5));
+      REQUIRE(wavetable != head);
+      REQUIRE(head->size() == 5);
+      REQUIRE(decodes == 2);
+      REQUIRE(cache.count() == 2);
+    }
+
+    SECTION ("Modified files are decoded again") {
+      set_mtime(a, 1000);
+      auto first = cache.get(a, "wavetable", decoder(10));
+      set_mtime(a, 2000);
+      auto second = cache.get(a, "wavetable", decoder(20));
+      REQUIRE(decodes == 2);
+      REQUIRE(second->size() == 20);
+      REQUIRE(cache.count() == 1);
+      REQUIRE(cache.size() == 20 * sizeof(float));
+      // The old samples stay valid for their users
+      REQUIRE(first->size() == 10);
+    }
+
+    SECTION ("Nothing is cached when decoding fails") {
+      auto failing = []() -> SampleCache::Samples { throw std::runtime_error("Invalid"); };
+      REQUIRE_THROWS(cache.get(a, "wavetable", failing));
+      REQUIRE(cache.count() == 0);
+      cache.get(a, "wavetable", decoder(10));
+      REQUIRE(decodes == 1);
+    }
+
+    SECTION ("The least recently used entries are evicted") {
+      auto c = make_file("c.wav");
+      cache.set_budget(25 * sizeof(float));
+      cache.get(a, "wavetable", decoder(10));
+      cache.get(b, "wavetable", decoder(10));
+      // Use a, so b is the least recently used
+      cache.get(a, "wavetable", decoder(10));
+      cache.get(c, "wavetable", decoder(10));
+      REQUIRE(cache.count() == 2);
+      REQUIRE(cache.size() == 20 * sizeof(float));
+      REQUIRE(decodes == 3);
+      cache.get(a, "wavetable", decoder(10));
+      REQUIRE(decodes == 3);
+      cache.get(b, "wavetable", decoder(10));
+      REQUIRE(decodes == 4);
+    }
+
+    SECTION ("Entries in use are not evicted") {
+      auto in_use = cache.get(a, "wavetable", decoder(10));
+      cache.get(b, "wavetable", decoder(10));
+      cache.set_budget(0);
+      REQUIRE(cache.count() == 1);
+      cache.get(a, "wavetable", decoder(10));
+      REQUIRE(decodes == 2);
+      in_use.reset();
+      cache.set_budget(0);
+      REQUIRE(cache.count() == 0);
+    }
+
+    SECTION ("Persisted samples are read at the next run instead of decoded") {
+      auto dir = test::dir / "sample_cache";
+      fs::remove_all(dir);
+      set_mtime(a, 1000);
+      auto decode_ramp = [&] {
+        decodes++;
+        return SampleCache::Samples{0.f, 0.5f, 1.f};
+      };
+      {
+        SampleCache last_run;
+        last_run.persist_to(dir);
+        last_run.get(a, "wavetable", decode_ramp);
+        last_run.get(b, "wavetable", decoder(10));
+        last_run.save();
+      }
+      REQUIRE(decodes == 2);
+
+      cache.persist_to(dir);
+      auto samples = cache.get(a, "wavetable", decode_ramp);
+      REQUIRE(decodes == 2);
+      REQUIRE(*samples == SampleCache::Samples{0.f, 0.5f, 1.f});
+      REQUIRE(cache.hits() == 1);
+      // Another kind, and a modified file, are decoded
+      cache.get(a, "head", decoder(5));
+      set_mtime(b, 2000);
+      cache.get(b, "wavetable", decoder(10));
+      REQUIRE(decodes == 4);
+
+      // Only what this run used is kept
+      cache.set_budget(0);
+      cache.get(a, "wavetable", decoder(3));
+      cache.save();
+      int files = 0;
+      for (auto& file : fs::directory_iterator(dir)) files += file.is_regular_file();
+      REQUIRE(files == 1);
+    }
+
+    SECTION ("Persisted files that do not match their size are decoded again") {
+      auto dir = test::dir / "sample_cache_corrupt";
+      fs::remove_all(dir);
+      set_mtime(a, 1000);
+      {
+        SampleCache last_run;
+        last_run.persist_to(dir);
+        last_run.get(a, "wavetable", decoder(3));
+        last_run.save();
+      }
+      fs::path persisted;
+      for (auto& file : fs::directory_iterator(dir)) persisted = file.path();
+      REQUIRE(fs::file_size(persisted) > 0);
+
+      // The count of samples, after the magic, version and mtime, claims far more than the file
+      {
+        std::fstream file(persisted.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        std::uint64_t count = 1ull << 60;
+        file.seekp(16);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+      }
+      cache.persist_to(dir);
+      REQUIRE(cache.get(a, "wavetable", decoder(3))->size() == 3);
+      REQUIRE(decodes == 2);
+    }
+  }
+
+} // namespace otto::core::audio
@@ -0,0 +1,160 @@
+#include "testing.t.hpp"
+
+#include <thread>
+
+#include <AudioFile.h>
+
+#include "core/audio/sample_stream.hpp"
+
+namespace otto::core::audio {
+
+  /// The value written to `frame` of the test file
+  static float value_of(long frame)
+  {
+    return ((frame * 7) % 2000 - 1000) / 32768.f;
+  }
+
+  /// The value read back from `frame`, within the precision of 16 bit samples
+  static auto read_back(long frame)
+  {
+    return Approx(value_of(frame)).margin(2 / 32768.f);
+  }
+
+  static fs::path write_test_file(fs::path path, long frames, int channels = 1)
+  {
+    AudioFile<float> file;
+    file.setSampleRate(44100);
+    file.setBitDepth(16);
+    file.samples.assign(channels, std::vector<float>(frames));
+    for (long i = 0; i < frames; i++) {
+      for (auto& channel : file.samples) channel[i] = value_of(i);
+    }
+    REQUIRE(file.save(path.string()));
+    return path;
+  }
+
+  static void wait_until_loaded(SampleStream& stream, long frame)
+  {
+    for (int i = 0; i < 1000 && !stream.is_loaded(frame); i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(stream.is_loaded(frame));
+  }
+
+  TEST_CASE ("SampleStream", "[audio]") {
+    const long frames = (SampleStream::head_blocks + 3 * SampleStream::cache_blocks) *
+                          SampleStream::block_size +
+                        123;
+    auto path = write_test_file(test::dir / "stream.wav", frames, 2);
+
+    SampleStream stream(path);
+    REQUIRE(stream.frames() == frames);
+    REQUIRE(stream.samplerate() == 44100);
+
+    SECTION ("The head is readable right away") {
+      long head = SampleStream::head_blocks * SampleStream::block_size;
+      for (long i = 0; i < head; i += 97) {
+        CAPTURE(i);
+        REQUIRE(stream.read(i) == read_back(i));
+      }
+      REQUIRE(stream.underrun_count() == 0);
+    }
+
+    SECTION ("Frames outside the cache read as silence, and count as underruns") {
+      long far = frames - 10;
+      REQUIRE(stream.read(far) == 0);
+      REQUIRE(stream.underrun_count() == 1);
+    }
+
+    SECTION ("Frames out of bounds read as silence") {
+      REQUIRE(stream.read(-1) == 0);
+      REQUIRE(stream.read(frames) == 0);
+      REQUIRE(stream.underrun_count() == 0);
+    }
+
+    SECTION ("Prefetched frames are loaded in the background") {
+      long far = frames / 2;
+      stream.prefetch(far);
+      wait_until_loaded(stream, far);
+      for (long i = far; i < far + 4 * SampleStream::block_size; i += 31) {
+        CAPTURE(i);
+        REQUIRE(stream.read(i) == read_back(i));
+      }
+      REQUIRE(stream.underrun_count() == 0);
+    }
+
+    SECTION ("The last, partial block is loaded") {
+      stream.prefetch(frames - 1);
+      wait_until_loaded(stream, frames - 1);
+      for (long i = frames - SampleStream::block_size; i < frames; i++) {
+        CAPTURE(i);
+        REQUIRE(stream.read(i) == read_back(i));
+      }
+    }
+
+    SECTION ("Playing backwards loads the frames before the position") {
+      long far = frames - 2 * SampleStream::block_size;
+      stream.prefetch(far, false);
+      wait_until_loaded(stream, far);
+      for (long i = far; i > far - 8 * SampleStream::block_size; i -= 31) {
+        CAPTURE(i);
+        REQUIRE(stream.read(i) == read_back(i));
+      }
+      REQUIRE(stream.underrun_count() == 0);
+    }
+  }
+
+  TEST_CASE ("SampleStream of a short file", "[audio]") {
+    auto path = write_test_file(test::dir / "short.wav", 1000);
+    SampleStream stream(path);
+    REQUIRE(stream.frames() == 1000);
+    REQUIRE(stream.is_loaded(999));
+    REQUIRE(stream.read(999) == read_back(999));
+  }
+
+  TEST_CASE ("SampleStreams of the same file share the head through a cache", "[audio]") {
+    auto path = write_test_file(test::dir / "cached.wav", 1000);
+    SampleCache cache;
+    SampleStream first(path, &cache);
+    SampleStream second(path, &cache);
+    REQUIRE(cache.misses() == 1);
+    REQUIRE(cache.hits() == 1);
+    REQUIRE(second.read(999) == read_back(999));
+  }
+
+  TEST_CASE ("SampleStream resampled to another samplerate", "[audio]") {
+    const long frames = (SampleStream::head_blocks + 4) * SampleStream::block_size;
+    auto path = write_test_file(test::dir / "resampled.wav", frames);
+    AudioFile<float> file;
+    REQUIRE(file.load(path.string()));
+    auto expected = dsp::Resampler::resample(file.samples[0], 44100, 48000);
+
+    SampleStream stream(path, nullptr, 48000);
+    REQUIRE(stream.samplerate() == 48000);
+    REQUIRE(stream.file_samplerate() == 44100);
+    REQUIRE(stream.frames() == long(expected.size()));
+
+    // Across the end of the head, and the blocks loaded in the background
+    long far = stream.frames() - 2 * SampleStream::block_size;
+    stream.prefetch(far);
+    wait_until_loaded(stream, far);
+    for (long i = 0; i < stream.frames(); i += 13) {
+      CAPTURE(i);
+      REQUIRE(stream.read(i) == Approx(expected[i]).margin(1e-5));
+    }
+    REQUIRE(stream.underrun_count() == 0);
+  }
+
+  TEST_CASE ("SampleStream errors", "[audio]") {
+    SECTION ("Missing files") {
+      REQUIRE_THROWS_AS(SampleStream(test::dir / "does-not-exist.wav"), SampleStream::exception);
+    }
+
+    SECTION ("Files that are not wav files") {
+      auto path = test::dir / "not-a-wav.wav";
+      std::ofstream(path.c_str()) << "This is not a wav file";
+      REQUIRE_THROWS_AS(SampleStream(path), SampleStream::exception);
+    }
+  }
+
+} // namespace otto::core::audio
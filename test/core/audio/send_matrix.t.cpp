@@ -0,0 +1,53 @@
+#include "testing.t.hpp"
+
+#include <vector>
+
+#include "core/audio/send_matrix.hpp"
+
+namespace otto::core::audio {
+
+  TEST_CASE ("SendMatrix", "[audio]") {
+    const int n = 64;
+    std::vector<float> a(n, 1.f), b(n, 2.f);
+    std::vector<float> bus0(n), bus1(n), bus2(n);
+    SendMatrix<2, 3> matrix;
+    std::array<float*, 3> dsts = {bus0.data(), bus1.data(), bus2.data()};
+
+    SECTION ("The gains ramp from the previous buffer") {
+      matrix.set(0, {1.f, 0.f, 0.f});
+      matrix.process({a.data(), b.data()}, dsts, n);
+      REQUIRE(bus0[0] == 0.f);
+      REQUIRE(bus0[n / 2] == Approx(0.5f));
+      REQUIRE(bus0[n - 1] == Approx(1.f).margin(1.f / n));
+      matrix.process({a.data(), b.data()}, dsts, n);
+      for (float f : bus0) REQUIRE(f == 1.f);
+    }
+
+    SECTION ("Buses nothing is sent to are silent") {
+      matrix.set(0, {1.f, 0.f, 0.f});
+      matrix.set(1, {0.f, 0.5f, 0.f});
+      matrix.process({a.data(), b.data()}, dsts, n);
+      bus2.assign(n, 42.f);
+      auto silent = matrix.process({a.data(), b.data()}, dsts, n);
+      REQUIRE(silent == std::array{false, false, true});
+      for (int i = 0; i < n; i++) {
+        REQUIRE(bus0[i] == 1.f);
+        REQUIRE(bus1[i] == 1.f);
+        REQUIRE(bus2[i] == 0.f);
+      }
+      silent = matrix.process({a.data(), nullptr}, dsts, n);
+      REQUIRE(silent == std::array{false, true, true});
+    }
+
+    SECTION ("A gain fading out is still mixed") {
+      matrix.set(1, {0.f, 1.f, 0.f});
+      matrix.process({a.data(), b.data()}, dsts, n);
+      matrix.set(1, {0.f, 0.f, 0.f});
+      auto silent = matrix.process({a.data(), b.data()}, dsts, n);
+      REQUIRE(!silent[1]);
+      REQUIRE(bus1[0] == 2.f);
+      REQUIRE(matrix.process({a.data(), b.data()}, dsts, n)[1]);
+    }
+  }
+
+} // namespace otto::core::audio
@@ -0,0 +1,57 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "core/audio/spectrum_analyser.hpp"
+
+namespace otto::core::audio {
+
+  /// The band that contains `freq`
+  static int band_of(float freq)
+  {
+    using SA = SpectrumAnalyser;
+    return std::floor(std::log(freq / SA::min_freq) / std::log(SA::max_freq / SA::min_freq) * SA::bands);
+  }
+
+  TEST_CASE ("SpectrumAnalyser", "[audio]") {
+    constexpr int samplerate = 48000;
+    SpectrumAnalyser analyser(samplerate);
+
+    // Long enough to fill the window of the decimated spectrum
+    auto play_sine = [&](float freq, float amplitude) {
+      std::vector<float> buffer(256);
+      int frame = 0;
+      for (int b = 0; b < 40; b++) {
+        for (auto& frm : buffer) frm = amplitude * std::sin(2 * M_PI * freq * (frame++) / samplerate);
+        analyser.write(buffer, buffer);
+        // Like the worker, which drains the ring while the audio plays
+        analyser.update();
+      }
+    };
+
+    SECTION ("Nothing is taken while the analyser is not active") {
+      play_sine(1000, 0.5);
+      for (float level : analyser.read()) REQUIRE(level == SpectrumAnalyser::floor_db);
+    }
+
+    SECTION ("A sine shows up in its band, at its level") {
+      analyser.active(true);
+      play_sine(1000, 0.5);
+      auto& levels = analyser.read();
+      REQUIRE(levels[band_of(1000)] == Approx(-6).margin(1));
+      REQUIRE(levels[band_of(100)] < -60);
+      REQUIRE(levels[band_of(10000)] < -60);
+    }
+
+    SECTION ("Low frequencies are resolved by the decimated spectrum") {
+      analyser.active(true);
+      play_sine(50, 0.5);
+      auto& levels = analyser.read();
+      REQUIRE(levels[band_of(50)] == Approx(-6).margin(1));
+      REQUIRE(levels[band_of(100)] < -40);
+      REQUIRE(levels[band_of(25)] < -40);
+    }
+  }
+
+} // namespace otto::core::audio
@@ -0,0 +1,71 @@
+#include "testing.t.hpp"
+
+#include <vector>
+
+#include "core/audio/processor.hpp"
+
+namespace otto::core::audio {
+
+  TEST_CASE ("split_by_midi", "[audio]") {
+    AudioBufferPool pool{16, 2};
+    midi::MidiBuffer midi;
+    auto buf = pool.allocate_clear();
+    ProcessData<1> data = {buf, midi, 16};
+
+    // Each slice is filled with the number of events handled before it
+    std::vector<std::pair<int, int>> slices;
+    int handled = 0;
+    auto run = [&] {
+      split_by_midi(data, [&](midi::AnyMidiEvent&) { handled++; },
+                    [&](ProcessData<1> slice) {
+                      slices.emplace_back(slice.audio.data() - buf.data(), slice.nframes);
+                      for (auto& frm : slice.audio) frm = handled;
+                    });
+    };
+
+    SECTION ("Without events the buffer is processed in one slice") {
+      run();
+      REQUIRE(slices == std::vector<std::pair<int, int>>{{0, 16}});
+    }
+
+    SECTION ("The buffer is split at the sorted event times") {
+      midi.push_back(midi::NoteOnEvent(60, 1, 0, 10));
+      midi.push_back(midi::NoteOffEvent(60, 1, 0, 4));
+      midi.push_back(midi::NoteOnEvent(62, 1, 0, 4));
+      midi.push_back(midi::NoteOnEvent(64, 1, 0, 100));
+      run();
+      REQUIRE(slices == std::vector<std::pair<int, int>>{{0, 4}, {4, 6}, {10, 5}, {15, 1}});
+      REQUIRE(buf[3] == 0);
+      REQUIRE(buf[4] == 2);
+      REQUIRE(buf[10] == 3);
+      REQUIRE(buf[15] == 4);
+      // Equal times keep their order
+      REQUIRE(midi[0].time == 4);
+      REQUIRE(midi[0].type() == midi::MidiEvent::Type::NoteOff);
+    }
+
+    SECTION ("Events at frame 0 are handled before the first slice") {
+      midi.push_back(midi::NoteOnEvent(60));
+      run();
+      REQUIRE(slices == std::vector<std::pair<int, int>>{{0, 16}});
+      REQUIRE(buf[0] == 1);
+    }
+  }
+
+  TEST_CASE ("ProcessData carries its AudioContext", "[audio]") {
+    AudioBufferPool pool{16, 4};
+    AudioContext context{&pool, 44100, -1};
+    midi::MidiBuffer midi;
+    ProcessData<1> data = {pool.allocate_clear(), midi, 16, &context};
+
+    REQUIRE(data.slice(4).context == &context);
+    REQUIRE(data.midi_only().context == &context);
+    REQUIRE(data.audio_only().context == &context);
+    REQUIRE(data.redirect(pool.allocate_multi<2>()).context == &context);
+    REQUIRE(data.midi_only().redirect(pool.allocate()).context == &context);
+    split_by_midi(data, [](midi::AnyMidiEvent&) {},
+                  [&](ProcessData<1> slice) { REQUIRE(slice.context == &context); });
+    REQUIRE(&data.context->pool() == &pool);
+  }
+
+} // namespace otto::core::audio
@@ -0,0 +1,60 @@
+#include "testing.t.hpp"
+
+#include <sstream>
+
+#include "core/audio/tuning.hpp"
+
+namespace otto::core::midi {
+
+  TEST_CASE ("Scala tunings", "[midi]") {
+    std::istringstream twelve_tet(
+      "! 12tet.scl\n"
+      "!\n"
+      "12 tone equal temperament\n"
+      " 12\n"
+      "!\n"
+      " 100.0\n 200.\n 300.0\n 400.0\n 500.0\n 600.0\n"
+      " 700.0\n 800.0\n 900.0\n 1000.0\n 1100.0\n 2/1\n");
+    auto scale = Scale::from_scl(twelve_tet);
+    REQUIRE(scale.description == "12 tone equal temperament");
+    REQUIRE(scale.ratios.size() == 12);
+
+    SECTION ("The default mapping gives equal temperament") {
+      auto table = make_freq_table(scale);
+      for (int key = 0; key < 128; key++) {
+        REQUIRE(table[key] == Approx(detail::equal_temperament()[key]));
+      }
+    }
+
+    SECTION ("Ratios, and degrees beyond the period") {
+      std::istringstream just("Just fifths\n2\n3/2\n2\n");
+      auto fifths = Scale::from_scl(just);
+      REQUIRE(fifths.ratio(1) == Approx(1.5));
+      REQUIRE(fifths.ratio(3) == Approx(3));
+      REQUIRE(fifths.ratio(-1) == Approx(0.75));
+    }
+
+    SECTION ("Keyboard mappings") {
+      // A white key only mapping, with C4 at 256 Hz
+      std::istringstream kbm(
+        "! white.kbm\n"
+        "12\n0\n127\n60\n60\n256.0\n12\n"
+        "0\nx\n2\nx\n4\n5\nx\n7\nx\n9\nx\n11\n");
+      auto mapping = KeyboardMapping::from_kbm(kbm);
+      REQUIRE(mapping.map[1] == -1);
+      auto table = make_freq_table(scale, mapping);
+      REQUIRE(table[60] == Approx(256));
+      REQUIRE(table[72] == Approx(512));
+      // Unmapped keys get the frequency of the key below them
+      REQUIRE(table[61] == table[60]);
+    }
+
+    SECTION ("Invalid files throw") {
+      std::istringstream bad("Bad\n2\n3/0\n2\n");
+      REQUIRE_THROWS_AS(Scale::from_scl(bad), Scale::exception);
+      std::istringstream short_scale("Short\n3\n3/2\n");
+      REQUIRE_THROWS_AS(Scale::from_scl(short_scale), Scale::exception);
+    }
+  }
+
+} // namespace otto::core::midi
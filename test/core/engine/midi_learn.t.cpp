@@ -0,0 +1,109 @@
+#include "testing.t.hpp"
+
+#include "core/engine/midi_learn.hpp"
+
+namespace otto::core::engine {
+
+  BETTER_ENUM(MidiLearnTestShape, int, sine = 0, saw = 4, square = 9);
+
+  struct MidiLearnTestEngine : MiscEngine<MidiLearnTestEngine> {
+    static constexpr util::string_ref name = "MidiLearnTest";
+
+    struct Props {
+      Property<float> cutoff = {0, limits(0, 2)};
+      Property<int> steps = {0, limits(0, 16)};
+      Property<MidiLearnTestShape> shape = MidiLearnTestShape::sine;
+
+      DECL_REFLECTION(Props, cutoff, steps, shape);
+    } props;
+
+    MidiLearnTestEngine() : MiscEngine<MidiLearnTestEngine>(nullptr) {}
+  };
+
+  TEST_CASE ("MidiLearn", "[engine]") {
+    MidiLearnTestEngine engine;
+    std::array<IEngine*, 1> engines = {&engine};
+    MidiLearn learn{{"Test"}};
+    midi::MidiBuffer midi;
+
+    auto cc = [&](int controller, int value, int channel = 0) {
+      midi::ControlChangeEvent evt{controller, value};
+      evt.channel = channel;
+      midi.push_back(evt);
+    };
+    auto run = [&](int buffers = 1) {
+      for (int i = 0; i < buffers; i++) {
+        learn.process(midi, engines, 64, 44100);
+        midi.clear();
+      }
+    };
+
+    SECTION ("Unmapped controllers do nothing") {
+      cc(7, 127);
+      run();
+      REQUIRE(engine.props.cutoff == 0);
+    }
+
+    SECTION ("Integer properties are set right away, in their limits") {
+      learn.map(0, 7, 0, "props/steps");
+      cc(7, 127);
+      run();
+      REQUIRE(engine.props.steps == 16);
+    }
+
+    SECTION ("Enums are set to one of their values") {
+      learn.map(0, 7, 0, "props/shape");
+      cc(7, 127);
+      run();
+      REQUIRE(engine.props.shape == +MidiLearnTestShape::square);
+      cc(7, 64);
+      run();
+      REQUIRE(engine.props.shape == +MidiLearnTestShape::saw);
+      cc(7, 20);
+      run();
+      REQUIRE(engine.props.shape == +MidiLearnTestShape::sine);
+    }
+
+    SECTION ("Float properties glide to the value") {
+      learn.map(2, 7, 0, "props/cutoff");
+      cc(7, 127, 2);
+      run();
+      REQUIRE(engine.props.cutoff > 0);
+      REQUIRE(engine.props.cutoff < 2);
+      run(100);
+      REQUIRE(engine.props.cutoff == Approx(2));
+    }
+
+    SECTION ("The next controller is learned") {
+      learn.learn(0, "props/steps");
+      REQUIRE(learn.learning());
+      REQUIRE_FALSE(learn.update());
+      cc(20, 0, 3);
+      run();
+      REQUIRE(learn.update());
+      REQUIRE_FALSE(learn.learning());
+      REQUIRE(learn.mapping(3, 20).path == "props/steps");
+      cc(20, 64, 3);
+      run();
+      REQUIRE(engine.props.steps == 8);
+    }
+
+    SECTION ("Mappings are stored as json") {
+      learn.map(1, 10, 0, "props/steps");
+      auto json = learn.to_json();
+      MidiLearn other{{"Test"}};
+      other.from_json(json);
+      REQUIRE(other.mapping(1, 10).part == 0);
+      REQUIRE(other.mapping(1, 10).path == "props/steps");
+      REQUIRE(other.to_json() == json);
+    }
+
+    SECTION ("A property follows one controller") {
+      learn.map(0, 1, 0, "props/steps");
+      learn.map(0, 2, 0, "props/steps");
+      REQUIRE(learn.mapping(0, 1).part == -1);
+      REQUIRE(learn.mapping(0, 2).part == 0);
+    }
+  }
+
+} // namespace otto::core::engine
@@ -0,0 +1,82 @@
+#include "testing.t.hpp"
+
+#include "core/engine/mod_matrix.hpp"
+
+namespace otto::core::engine {
+
+  struct ModMatrixTestEngine : MiscEngine<ModMatrixTestEngine> {
+    static constexpr util::string_ref name = "ModMatrixTest";
+
+    struct Props {
+      Property<float> cutoff = {1, limits(0, 2)};
+      Property<float> resonance = {0.5, limits(0, 1)};
+      Property<int> steps = {0, limits(0, 16)};
+
+      DECL_REFLECTION(Props, cutoff, resonance, steps);
+    } props;
+
+    ModMatrixTestEngine() : MiscEngine<ModMatrixTestEngine>(nullptr) {}
+  };
+
+  TEST_CASE ("ModMatrix", "[engine]") {
+    ModMatrixTestEngine engine;
+    ModMatrix matrix{engine, {"lfo", "env"}};
+
+    SECTION ("A route moves its property around its centre, in its range") {
+      matrix.route(0, "props/cutoff", 0.25);
+      matrix.source(0, 1);
+      matrix.apply();
+      REQUIRE(engine.props.cutoff == Approx(1.5));
+      matrix.source(0, -1);
+      matrix.apply();
+      REQUIRE(engine.props.cutoff == Approx(0.5));
+    }
+
+    SECTION ("Routes to the same property add up, and stay in its limits") {
+      matrix.route(0, "props/resonance", 0.5);
+      matrix.route(1, "props/resonance", 0.5);
+      matrix.source(0, 0.5);
+      matrix.source(1, 0.5);
+      matrix.apply();
+      REQUIRE(engine.props.resonance == Approx(1));
+    }
+
+    SECTION ("The centre follows changes made by others") {
+      matrix.route(0, "props/cutoff", 0.25);
+      matrix.source(0, 1);
+      matrix.apply();
+      engine.props.cutoff = 0.2;
+      matrix.apply();
+      REQUIRE(engine.props.cutoff == Approx(0.7));
+    }
+
+    SECTION ("A removed route leaves its property at the centre") {
+      matrix.route(0, "props/cutoff", 0.25);
+      matrix.source(0, 1);
+      matrix.apply();
+      matrix.route(0, "props/cutoff", 0);
+      matrix.apply();
+      REQUIRE(engine.props.cutoff == Approx(1));
+    }
+
+    SECTION ("Only float properties are modulated") {
+      matrix.route(0, "props/steps", 1);
+      matrix.route(0, "props/missing", 1);
+      matrix.source(0, 1);
+      matrix.apply();
+      REQUIRE(engine.props.steps == 0);
+    }
+
+    SECTION ("Routes are stored by the names of their sources") {
+      matrix.route(1, "props/cutoff", 0.5);
+      auto j = matrix.to_json();
+      ModMatrix other{engine, {"lfo", "env"}};
+      other.from_json(j);
+      REQUIRE(other.routes().size() == 1);
+      REQUIRE(other.routes()[0].source == 1);
+      REQUIRE(other.routes()[0].path == "props/cutoff");
+      REQUIRE(other.routes()[0].depth == 0.5);
+    }
+  }
+
+} // namespace otto::core::engine
@@ -0,0 +1,80 @@
+#include "testing.t.hpp"
+
+#include "core/engine/parameter_queue.hpp"
+
+namespace otto::core::engine {
+
+  BETTER_ENUM(ParameterQueueTestShape, int, sine = 0, saw = 4, square = 9);
+
+  struct ParameterQueueTestEngine : MiscEngine<ParameterQueueTestEngine> {
+    static constexpr util::string_ref name = "ParameterQueueTest";
+
+    struct Props {
+      Property<float> cutoff = {0, limits(0, 2)};
+      Property<int> steps = {0, limits(0, 16)};
+      Property<ParameterQueueTestShape> shape = ParameterQueueTestShape::sine;
+
+      DECL_REFLECTION(Props, cutoff, steps, shape);
+    } props;
+
+    ParameterQueueTestEngine() : MiscEngine<ParameterQueueTestEngine>(nullptr) {}
+  };
+
+  TEST_CASE ("ParameterQueue", "[engine]") {
+    ParameterQueueTestEngine first;
+    ParameterQueueTestEngine second;
+    std::array<IEngine*, 2> engines = {&first, &second};
+    ParameterQueue queue{{"First", "Second"}};
+    auto cutoff = props::hash_path("props/cutoff");
+    auto steps = props::hash_path("props/steps");
+
+    REQUIRE(queue.find_part("Second") == 1);
+    REQUIRE(queue.find_part("Third") == -1);
+
+    SECTION ("Changes take effect in the next buffer") {
+      std::array<ParameterQueue::Change, 2> changes = {{{0, cutoff, 1.5}, {1, steps, 4}}};
+      REQUIRE(queue.push(changes));
+      REQUIRE(first.props.cutoff == 0);
+      queue.process(engines);
+      REQUIRE(first.props.cutoff == 1.5);
+      REQUIRE(second.props.steps == 4);
+    }
+
+    SECTION ("Each property is set once per buffer, to the last value") {
+      int changes_seen = 0;
+      first.props.cutoff.on_change().connect([&](float) { changes_seen++; });
+      std::vector<ParameterQueue::Change> burst;
+      for (int i = 0; i < 50; i++) burst.push_back({0, cutoff, i / 50.0});
+      REQUIRE(queue.push(burst));
+      std::array<ParameterQueue::Change, 1> later = {{{0, cutoff, 0.25}}};
+      REQUIRE(queue.push(later));
+      queue.process(engines);
+      REQUIRE(changes_seen == 1);
+      REQUIRE(first.props.cutoff == 0.25);
+    }
+
+    SECTION ("Values are clamped, and unknown properties and parts are ignored") {
+      std::array<ParameterQueue::Change, 3> changes = {
+        {{0, steps, 100}, {1, props::hash_path("props/nothing"), 1}, {5, cutoff, 1}}};
+      REQUIRE(queue.push(changes));
+      queue.process(engines);
+      REQUIRE(first.props.steps == 16);
+    }
+
+    SECTION ("Enums are set to their nearest value") {
+      std::array<ParameterQueue::Change, 1> changes = {{{0, props::hash_path("props/shape"), 7}}};
+      REQUIRE(queue.push(changes));
+      queue.process(engines);
+      REQUIRE(first.props.shape == +ParameterQueueTestShape::square);
+    }
+
+    SECTION ("Batches that do not fit are dropped whole") {
+      std::vector<ParameterQueue::Change> changes;
+      for (std::uint32_t i = 0; i < ParameterQueue::capacity; i++) changes.push_back({0, i, 1});
+      REQUIRE(queue.push(changes));
+      REQUIRE_FALSE(queue.push(changes));
+      REQUIRE(queue.dropped_count() == 1);
+    }
+  }
+
+} // namespace otto::core::engine
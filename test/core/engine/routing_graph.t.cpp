@@ -0,0 +1,316 @@
+#include "testing.t.hpp"
+
+#include <limits>
+#include <thread>
+
+#include "core/engine/routing_graph.hpp"
+
+namespace otto::core::engine {
+
+  using NodeData = RoutingGraph::NodeData;
+
+  /// A node with one input and two outputs, both the input scaled by `gain`
+  static RoutingGraph::Processor splitter(float gain)
+  {
+    return [gain](NodeData& data) {
+      auto& in = *data.inputs[0];
+      for (int i = 0; i < data.nframes; i++) in[i] *= gain;
+      data.outputs[0] = in;
+      data.outputs[1] = in;
+    };
+  }
+
+  TEST_CASE ("RoutingGraph", "[engine]") {
+    constexpr int nframes = 16;
+    audio::AudioBufferPool pool{nframes, 16};
+    util::WorkerPool workers{1};
+    RoutingGraph graph{pool};
+
+    auto process = [&](float in_value) {
+      auto in = pool.allocate();
+      std::fill(in.begin(), in.end(), in_value);
+      midi::MidiBuffer midi;
+      return graph.process({std::move(in), midi, nframes}, workers);
+    };
+
+    SECTION ("Output is silent before the first compile") {
+      auto out = process(1);
+      REQUIRE(out.audio[0][0] == 0);
+      REQUIRE(out.audio[1][0] == 0);
+    }
+
+    SECTION ("Inputs are the sum of their edges") {
+      auto gain = graph.add_node("Gain", 1, 1, [](NodeData& data) {
+        auto& in = *data.inputs[0];
+        for (int i = 0; i < data.nframes; i++) in[i] *= 2;
+        data.outputs[0] = in;
+      });
+      graph.connect(graph.input(), 0, gain, 0);
+      graph.connect(gain, 0, graph.output(), 0);
+      graph.connect(gain, 0, graph.output(), 1);
+      graph.connect(graph.input(), 0, graph.output(), 1);
+      graph.compile();
+
+      for (int i = 0; i < 10; i++) {
+        auto out = process(1);
+        REQUIRE(out.audio[0][nframes - 1] == 2);
+        REQUIRE(out.audio[1][nframes - 1] == 3);
+      }
+      REQUIRE(pool.overflow_count() == 0);
+
+      SECTION ("Recompiling picks up changes") {
+        REQUIRE(graph.disconnect(graph.input(), 0, graph.output(), 1));
+        REQUIRE_FALSE(graph.disconnect(graph.input(), 0, graph.output(), 1));
+        graph.compile();
+        auto out = process(1);
+        REQUIRE(out.audio[0][0] == 2);
+        REQUIRE(out.audio[1][0] == 2);
+      }
+    }
+
+    SECTION ("Buffers are returned to the pool") {
+      auto split = graph.add_node("Split", 1, 2, splitter(0.5));
+      graph.connect(graph.input(), 0, split, 0);
+      graph.connect(split, 0, graph.output(), 0);
+      graph.connect(split, 1, graph.output(), 1);
+      graph.compile();
+      for (int i = 0; i < 100; i++) {
+        auto out = process(1);
+        REQUIRE(out.audio[0][0] == 0.5);
+      }
+      REQUIRE(pool.overflow_count() == 0);
+      REQUIRE(pool.high_water_mark() <= 3);
+    }
+
+    SECTION ("Engines are handed views, and the node holds the input they process in place") {
+      int input_references = 0;
+      auto fx = graph.add_effect("Effect", [&](audio::ProcessData<1> data) {
+        input_references = data.audio.reference_count();
+        for (auto& frm : data.audio) frm *= 2;
+        auto right = data.context->pool().allocate();
+        std::fill(right.begin(), right.end(), 3.f);
+        return data.redirect(std::array{data.audio, std::move(right)});
+      });
+      graph.connect(graph.input(), 0, fx, 0);
+      graph.connect(fx, 0, graph.output(), 0);
+      graph.connect(fx, 1, graph.output(), 1);
+      graph.compile();
+      audio::AudioContext context{&pool};
+      for (int i = 0; i < 10; i++) {
+        auto in = pool.allocate();
+        std::fill(in.begin(), in.end(), 1.f);
+        midi::MidiBuffer midi;
+        auto out = graph.process({std::move(in), midi, nframes, &context}, workers);
+        REQUIRE(input_references == 0);
+        REQUIRE(out.audio[0].owning());
+        REQUIRE(out.audio[0][nframes - 1] == 2);
+        REQUIRE(out.audio[1][nframes - 1] == 3);
+      }
+      REQUIRE(pool.overflow_count() == 0);
+      REQUIRE(pool.high_water_mark() <= 3);
+    }
+
+    SECTION ("Nodes are handed the midi they read, sorted by time") {
+      std::vector<midi::MidiEvent::Type> all, notes;
+      bool effect_midi = true;
+      graph.add_node("All", 0, 0, [&](NodeData& data) {
+        for (auto& evt : *data.midi) all.push_back(evt.type());
+      });
+      graph.add_node(
+        "Notes", 0, 0,
+        [&](NodeData& data) {
+          for (auto& evt : *data.midi) notes.push_back(evt.type());
+          REQUIRE(data.midi->begin()->time == 0);
+        },
+        midi::EventMask::notes);
+      graph.add_node("Deaf", 0, 0, [&](NodeData& data) { REQUIRE(data.midi->empty()); }, midi::EventMask::none);
+      auto fx = graph.add_effect("Effect", [&](audio::ProcessData<1> data) {
+        effect_midi = !data.midi.empty();
+        return data.redirect(std::array{data.audio, data.audio});
+      });
+      graph.connect(graph.input(), 0, fx, 0);
+      graph.compile();
+      midi::MidiBuffer midi;
+      midi::ControlChangeEvent cc = {1, 64};
+      cc.time = 4;
+      midi.push_back(cc);
+      midi.push_back(midi::NoteOffEvent(60, 1, 0, 8));
+      midi.push_back(midi::NoteOnEvent(60, 1, 0, 0));
+      graph.process({pool.allocate_clear(), midi, nframes}, workers);
+      using Type = midi::MidiEvent::Type;
+      REQUIRE(all == std::vector{Type::NoteOn, Type::ControlChange, Type::NoteOff});
+      REQUIRE(notes == std::vector{Type::NoteOn, Type::NoteOff});
+      REQUIRE_FALSE(effect_midi);
+    }
+
+    SECTION ("Dependencies order nodes without audio") {
+      std::vector<int> order;
+      auto a = graph.add_node("A", 0, 0, [&](NodeData&) { order.push_back(0); });
+      auto b = graph.add_node("B", 0, 0, [&](NodeData&) { order.push_back(1); });
+      graph.add_dependency(b, a);
+      graph.compile();
+      process(0);
+      REQUIRE(order == std::vector<int>{1, 0});
+    }
+
+    SECTION ("Processing time is measured per node") {
+      auto slow = graph.add_node("Slow", 0, 0, [](NodeData&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      });
+      graph.compile();
+      for (int i = 0; i < 3; i++) process(0);
+      auto stats = graph.take_cpu_stats(slow);
+      REQUIRE(stats.count == 3);
+      REQUIRE(stats.min >= 1e6);
+      REQUIRE(graph.take_cpu_stats(slow).count == 0);
+      REQUIRE(graph.take_cpu_stats(graph.output()).count == 3);
+    }
+
+    SECTION ("A node that outputs NaN is muted, then bypassed until its fault is cleared") {
+      bool explode = true;
+      auto split = graph.add_node("Split", 1, 2, [&](NodeData& data) {
+        splitter(2)(data);
+        if (explode) (*data.outputs[0])[3] = std::numeric_limits<float>::quiet_NaN();
+      });
+      graph.connect(graph.input(), 0, split, 0);
+      graph.connect(split, 0, graph.output(), 0);
+      graph.connect(split, 1, graph.output(), 1);
+      graph.compile();
+
+      auto out = process(1);
+      REQUIRE(graph.fault_of(split) == RoutingGraph::Fault::non_finite);
+      REQUIRE(out.audio[0][3] == 0);
+      REQUIRE(out.audio[1][0] == 0);
+
+      // The second output has no input of its channel
+      explode = false;
+      out = process(1);
+      REQUIRE(out.audio[0][0] == 1);
+      REQUIRE(out.audio[1][0] == 0);
+
+      graph.clear_fault(split);
+      out = process(1);
+      REQUIRE(out.audio[0][0] == 2);
+      REQUIRE(pool.overflow_count() == 0);
+    }
+
+    SECTION ("A faulted node passes each input to the output of its channel") {
+      auto split = graph.add_node("Split", 1, 2, [&](NodeData& data) {
+        data.outputs[0] = *data.inputs[0];
+        auto& right = data.outputs[1].emplace(pool.allocate());
+        std::fill(right.begin(), right.end(), 3.f);
+      });
+      auto swap = graph.add_node("Swap", 2, 2, [](NodeData& data) {
+        for (int ch = 0; ch < 2; ch++) {
+          auto& in = *data.inputs[ch];
+          for (int i = 0; i < data.nframes; i++) in[i] = std::numeric_limits<float>::infinity();
+        }
+        data.outputs[0] = *data.inputs[1];
+        data.outputs[1] = *data.inputs[0];
+      });
+      graph.connect(graph.input(), 0, split, 0);
+      graph.connect(split, 0, swap, 0);
+      graph.connect(split, 1, swap, 1);
+      graph.connect(swap, 0, graph.output(), 0);
+      graph.connect(swap, 1, graph.output(), 1);
+      graph.compile();
+
+      process(1);
+      REQUIRE(graph.fault_of(swap) == RoutingGraph::Fault::non_finite);
+      for (int i = 0; i < 3; i++) {
+        auto out = process(1);
+        REQUIRE(out.audio[0][nframes - 1] == 1);
+        REQUIRE(out.audio[1][nframes - 1] == 3);
+      }
+      REQUIRE(pool.overflow_count() == 0);
+    }
+
+    SECTION ("A node that overruns is faulted") {
+      auto slow = graph.add_node("Slow", 0, 0, [](NodeData&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      });
+      graph.compile();
+      process(0);
+      REQUIRE(graph.fault_of(slow) == RoutingGraph::Fault::none);
+      graph.overrun_limit = std::chrono::milliseconds(1);
+      process(0);
+      REQUIRE(graph.fault_of(slow) == RoutingGraph::Fault::overrun);
+      REQUIRE(graph.running_time(slow).count() == 0);
+    }
+
+    SECTION ("A node set to sleep is skipped while its input and tail are silent") {
+      int calls = 0;
+      float tail = 0;
+      auto echo = graph.add_node("Echo", 1, 2, [&](NodeData& data) {
+        calls++;
+        auto& in = *data.inputs[0];
+        // Rings on for a few buffers after its input stops
+        tail = in[0] != 0 ? 1 : tail * 0.01f;
+        for (int i = 0; i < data.nframes; i++) in[i] += tail;
+        data.outputs[0] = in;
+        data.outputs[1] = in;
+      });
+      bool keep_awake = false;
+      graph.sleep_when_silent(echo, 2 * nframes, [&] { return keep_awake; });
+      graph.connect(graph.input(), 0, echo, 0);
+      graph.connect(echo, 0, graph.output(), 0);
+      graph.connect(echo, 1, graph.output(), 1);
+      graph.compile();
+
+      process(1);
+      // The tail is below the threshold from the third buffer after the input, and the node
+      // sleeps after two silent ones
+      for (int i = 0; i < 4; i++) process(0);
+      REQUIRE(calls == 5);
+      REQUIRE_FALSE(graph.asleep(echo));
+      auto out = process(0);
+      REQUIRE(graph.asleep(echo));
+      REQUIRE(calls == 5);
+      REQUIRE(out.audio[0][0] == 0);
+
+      keep_awake = true;
+      process(0);
+      REQUIRE(calls == 6);
+      keep_awake = false;
+
+      out = process(0.5);
+      REQUIRE(calls == 7);
+      REQUIRE_FALSE(graph.asleep(echo));
+      REQUIRE(out.audio[0][0] == 1.5);
+      REQUIRE(pool.overflow_count() == 0);
+    }
+
+    SECTION ("Inputs summed from silent or empty outputs are marked silent") {
+      bool mark = true;
+      auto source = graph.add_node("Source", 0, 2, [&](NodeData& data) {
+        auto& out = data.outputs[0].emplace(pool.allocate_clear());
+        out.mark_silent(mark);
+        if (!mark) out[0] = 1;
+      });
+      std::vector<bool> marks;
+      auto sink = graph.add_node("Sink", 1, 0, [&](NodeData& data) { marks.push_back(data.inputs[0]->is_silent()); });
+      graph.connect(source, 0, sink, 0);
+      graph.connect(source, 1, sink, 0);
+      graph.compile();
+      process(0);
+      mark = false;
+      process(0);
+      REQUIRE(marks == std::vector{true, false});
+    }
+
+    SECTION ("Cycles are rejected") {
+      auto a = graph.add_node("A", 1, 1, [](NodeData&) {});
+      auto b = graph.add_node("B", 1, 1, [](NodeData&) {});
+      graph.connect(a, 0, b, 0);
+      graph.connect(b, 0, a, 0);
+      REQUIRE_THROWS_AS(graph.compile(), RoutingGraph::exception);
+    }
+
+    SECTION ("Invalid connections are rejected") {
+      REQUIRE_THROWS_AS(graph.connect(graph.input(), 1, graph.output(), 0), RoutingGraph::exception);
+      REQUIRE_THROWS_AS(graph.connect(graph.input(), 0, graph.output(), 2), RoutingGraph::exception);
+      REQUIRE_THROWS_AS(graph.connect(graph.input(), 0, 42, 0), RoutingGraph::exception);
+    }
+  }
+
+} // namespace otto::core::engine
@@ -0,0 +1,105 @@
+#include "testing.t.hpp"
+
+#include "core/engine/engine.hpp"
+#include "core/engine/undo_history.hpp"
+
+namespace otto::core::engine {
+
+  struct UndoHistoryTestEngine : MiscEngine<UndoHistoryTestEngine> {
+    static constexpr util::string_ref name = "UndoHistoryTest";
+
+    struct Props {
+      Property<float> cutoff = {0, limits(0, 2)};
+      Property<int> steps = {0, limits(0, 16)};
+
+      DECL_REFLECTION(Props, cutoff, steps);
+    } props;
+
+    UndoHistoryTestEngine() : MiscEngine<UndoHistoryTestEngine>(nullptr) {}
+  };
+
+  struct UndoHistoryOtherEngine : MiscEngine<UndoHistoryOtherEngine> {
+    static constexpr util::string_ref name = "UndoHistoryOther";
+
+    struct Props {
+      Property<float> cutoff = {0, limits(0, 2)};
+
+      DECL_REFLECTION(Props, cutoff);
+    } props;
+
+    UndoHistoryOtherEngine() : MiscEngine<UndoHistoryOtherEngine>(nullptr) {}
+  };
+
+  TEST_CASE ("UndoHistory", "[engine]") {
+    UndoHistoryTestEngine first;
+    UndoHistoryTestEngine second;
+    std::array<IEngine*, 2> engines = {&first, &second};
+    UndoHistory history{{"First", "Second"}, [&](int part) { return engines[part]; }};
+    history.start();
+
+    SECTION ("Edits are undone and redone") {
+      first.props.cutoff = 1;
+      second.props.steps = 4;
+      REQUIRE(history.undo_count() == 2);
+
+      REQUIRE(history.undo());
+      REQUIRE(second.props.steps == 0);
+      REQUIRE(history.undo());
+      REQUIRE(first.props.cutoff == 0);
+      REQUIRE_FALSE(history.undo());
+
+      REQUIRE(history.redo());
+      REQUIRE(first.props.cutoff == 1);
+      REQUIRE(history.redo_count() == 1);
+    }
+
+    SECTION ("Steps of the same property are merged") {
+      for (int i = 1; i <= 10; i++) first.props.steps = i;
+      first.props.cutoff = 1;
+      first.props.steps = 12;
+      REQUIRE(history.undo_count() == 3);
+      history.undo();
+      history.undo();
+      REQUIRE(first.props.steps == 10);
+      history.undo();
+      REQUIRE(first.props.steps == 0);
+    }
+
+    SECTION ("Undoing is not an edit, and a new edit drops the undone ones") {
+      first.props.cutoff = 1;
+      first.props.steps = 2;
+      history.undo();
+      REQUIRE(history.undo_count() == 1);
+      REQUIRE(history.redo_count() == 1);
+      second.props.cutoff = 0.5;
+      REQUIRE(history.redo_count() == 0);
+      REQUIRE_FALSE(history.redo());
+    }
+
+    SECTION ("Changes in a bulk update are not recorded") {
+      {
+        props::BulkUpdate bulk;
+        first.props.cutoff = 1;
+      }
+      REQUIRE(history.undo_count() == 0);
+    }
+
+    SECTION ("Edits of an engine that was switched away from are skipped") {
+      first.props.cutoff = 1;
+      UndoHistoryOtherEngine replacement;
+      engines[0] = &replacement;
+      REQUIRE(history.undo());
+      REQUIRE(first.props.cutoff == 1);
+      REQUIRE(replacement.props.cutoff == 0);
+    }
+
+    SECTION ("The oldest edits are dropped") {
+      for (std::size_t i = 0; i < UndoHistory::capacity + 10; i++) {
+        history.record({0, props::hash_path("props/steps"), "UndoHistoryTest", 0, double(i),
+                        UndoHistory::clock::time_point(i * UndoHistory::merge_window)});
+      }
+      REQUIRE(history.undo_count() == UndoHistory::capacity);
+    }
+  }
+
+} // namespace otto::core::engine
@@ -0,0 +1,79 @@
+#include "testing.t.hpp"
+
+#include "core/props/morph.hpp"
+#include "core/props/props.hpp"
+
+namespace otto::core::props {
+
+  struct MorphTestProps {
+    Property<float> level = 0.2;
+    Property<int> steps = 4;
+    Property<bool> on = false;
+    Property<std::string> name = std::string("init");
+
+    struct Envelope {
+      Property<float> attack = 0.1;
+      Property<float> release = 0.2;
+
+      DECL_REFLECTION(Envelope, attack, release);
+    } envelope;
+
+    DECL_REFLECTION(MorphTestProps, level, steps, on, name, envelope);
+  };
+
+  TEST_CASE ("Property morphs", "[props]") {
+    MorphTestProps props;
+    auto from = util::serialize(props);
+    props.level = 0.6;
+    props.steps = 8;
+    props.on = true;
+    props.name = std::string("lead");
+    props.envelope.release = 1;
+    auto to = util::serialize(props);
+
+    MorphTestProps other;
+    auto morph = Morph::between(other, from, to);
+
+    SECTION ("Strings, and properties that are the same in both, are left out") {
+      REQUIRE(morph.size() == 4);
+      // Making the morph does not change the properties
+      REQUIRE(other.steps == 4);
+    }
+
+    SECTION ("The ends of the morph are the two states") {
+      morph.apply(1);
+      REQUIRE(other.level == Approx(0.6));
+      REQUIRE(other.steps == 8);
+      REQUIRE(other.on == true);
+      REQUIRE(other.envelope.release == Approx(1));
+      REQUIRE(other.name.get() == "init");
+      morph.apply(0);
+      REQUIRE(other.level == Approx(0.2));
+      REQUIRE(other.steps == 4);
+      REQUIRE(other.on == false);
+    }
+
+    SECTION ("Floats are interpolated, and the rest switch at the midpoint") {
+      morph.apply(0.25);
+      REQUIRE(other.level == Approx(0.3));
+      REQUIRE(other.envelope.release == Approx(0.4));
+      REQUIRE(other.steps == 4);
+      morph.apply(0.5);
+      REQUIRE(other.level == Approx(0.4));
+      REQUIRE(other.steps == 8);
+      REQUIRE(other.on == true);
+    }
+
+    SECTION ("Properties are only set when their value changes") {
+      int changes = 0;
+      other.steps.on_change().connect([&](int) { changes++; });
+      morph.apply(0.1);
+      morph.apply(0.2);
+      REQUIRE(changes == 0);
+      morph.apply(0.7);
+      morph.apply(0.8);
+      REQUIRE(changes == 1);
+    }
+  }
+
+} // namespace otto::core::props
@@ -0,0 +1,131 @@
+#include "testing.t.hpp"
+
+#include <thread>
+
+#include "core/props/property_table.hpp"
+#include "core/props/props.hpp"
+
+namespace otto::core::props {
+
+  struct TableTestProps {
+    Property<float> level = {0.5, limits(0, 2), step_size(0.25)};
+    Property<int> steps = 4;
+    Property<bool> on = false;
+    Property<std::string> name = std::string("init");
+
+    struct Envelope {
+      Property<float> attack = 0.1;
+      Property<float> release = 0.2;
+
+      DECL_REFLECTION(Envelope, attack, release);
+    } envelope;
+
+    DECL_REFLECTION(TableTestProps, level, steps, on, name, envelope);
+  };
+
+  TEST_CASE ("Property tables", "[props]") {
+    TableTestProps props;
+    auto& table = PropertyTable<TableTestProps>::of(props);
+
+    SECTION ("The table has the numeric properties, in order") {
+      REQUIRE(table.size() == 5);
+      REQUIRE(table[0].path == "level");
+      REQUIRE(table[0].kind == PropertyKind::floating);
+      REQUIRE(table[1].kind == PropertyKind::integer);
+      REQUIRE(table[2].kind == PropertyKind::boolean);
+      REQUIRE(table[4].path == "envelope/release");
+    }
+
+    SECTION ("Limits are recorded") {
+      REQUIRE(table[0].min == 0);
+      REQUIRE(table[0].max == 2);
+    }
+
+    SECTION ("Step sizes are recorded") {
+      REQUIRE(table[0].step == 0.25);
+      REQUIRE(table[1].step == 1);
+    }
+
+    SECTION ("Properties can be found by path and hash") {
+      REQUIRE(table.find("envelope/attack") == 3);
+      REQUIRE(table.find(hash_path("steps")) == 1);
+      REQUIRE(table.find("envelope") == -1);
+      REQUIRE(table.find("name") == -1);
+    }
+
+    SECTION ("Properties of any object of the type are accessed by index") {
+      TableTestProps other;
+      table.set(other, 3, 0.7);
+      table.set(other, 1, 6.6);
+      table.set(other, 2, 1);
+      REQUIRE(other.envelope.attack == Approx(0.7));
+      REQUIRE(other.steps == 7);
+      REQUIRE(other.on == true);
+      REQUIRE(table.get(other, 3) == Approx(0.7));
+      REQUIRE(props.envelope.attack == Approx(0.1));
+    }
+
+    SECTION ("Binary round trip") {
+      props.level = 1.5;
+      props.steps = 9;
+      props.envelope.release = 3;
+      auto bytes = table.to_binary(props);
+      TableTestProps other;
+      table.from_binary(other, bytes);
+      REQUIRE(other.level == Approx(1.5));
+      REQUIRE(other.steps == 9);
+      REQUIRE(other.envelope.release == Approx(3));
+      bytes.pop_back();
+      REQUIRE_THROWS(table.from_binary(other, bytes));
+    }
+
+    SECTION ("Properties are read while another thread sets them") {
+      std::thread audio([&] {
+        for (int i = 0; i < 10000; i++) table.set(props, 0, (i % 3) * 0.5);
+      });
+      for (int i = 0; i < 10000; i++) {
+        double value = table.get(props, 0);
+        if (value != 0 && value != 0.5 && value != 1) FAIL("Torn value " << value);
+      }
+      audio.join();
+    }
+
+    SECTION ("The nearest value is in the limits, and rounded for integers") {
+      REQUIRE(table[0].nearest(3) == 2);
+      REQUIRE(table[0].nearest(0.3) == Approx(0.3));
+      REQUIRE(table[1].nearest(6.6) == 7);
+      REQUIRE(table[1].values.empty());
+    }
+  }
+
+  BETTER_ENUM(TableTestShape, int, sine = 0, saw = 4, square = 9);
+
+  struct EnumTableTestProps {
+    Property<TableTestShape> shape = TableTestShape::sine;
+    Property<TableTestShape> limited = {TableTestShape::sine, limits(TableTestShape::sine, TableTestShape::saw)};
+
+    DECL_REFLECTION(EnumTableTestProps, shape, limited);
+  };
+
+  TEST_CASE ("Property tables of enums", "[props]") {
+    EnumTableTestProps props;
+    auto& table = PropertyTable<EnumTableTestProps>::of(props);
+
+    SECTION ("The values of enums in their limits are recorded") {
+      REQUIRE(table[0].kind == PropertyKind::enumeration);
+      REQUIRE(table[0].values == std::vector<double>{0, 4, 9});
+      REQUIRE(table[1].values == std::vector<double>{0, 4});
+    }
+
+    SECTION ("The nearest value is one of the values") {
+      REQUIRE(table[0].nearest(1) == 0);
+      REQUIRE(table[0].nearest(3) == 4);
+      REQUIRE(table[0].nearest(7) == 9);
+      REQUIRE(table[0].nearest(100) == 9);
+      REQUIRE(table[1].nearest(7) == 4);
+      table.set(props, 0, table[0].nearest(6));
+      REQUIRE(props.shape == +TableTestShape::saw);
+    }
+  }
+
+} // namespace otto::core::props
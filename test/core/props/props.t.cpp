@@ -1,6 +1,9 @@
 #include "testing.t.hpp"
 
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <thread>
 
 #include "core/props/mixins/all.hpp"
 #include "core/props/props.hpp"
@@ -124,4 +127,168 @@ namespace otto::core::props {
     prop.set(-3);
     REQUIRE(prop == 2);
   }
+
+  TEST_CASE ("audio_thread", "[props]") {
+    Property<float, audio_thread> prop = 0;
+    int calls = 0;
+    float last_new = 0;
+    float last_old = 0;
+    prop.on_change().connect([&](float new_val, float old_val) {
+      calls++;
+      last_new = new_val;
+      last_old = old_val;
+    });
+
+    prop.set(1);
+    prop.set(2);
+    // The value is stored immediately, but the signal is deferred
+    REQUIRE(prop == 2.f);
+    REQUIRE(calls == 0);
+
+    AudioThreadQueue::get().process_changes();
+    // Changes are coalesced
+    REQUIRE(calls == 1);
+    REQUIRE(last_new == 2.f);
+    REQUIRE(last_old == 0.f);
+
+    AudioThreadQueue::get().process_changes();
+    REQUIRE(calls == 1);
+
+    SECTION ("Destroyed properties are removed from the queue") {
+      {
+        Property<float, audio_thread> tmp = 0;
+        tmp.set(1);
+      }
+      AudioThreadQueue::get().process_changes();
+    }
+  }
+
+  TEST_CASE ("audio_thread properties set from the audio thread", "[props]") {
+    Property<int, audio_thread> prop = 0;
+    int last = -1;
+    prop.on_change().connect([&](int new_val) { last = new_val; });
+
+    // Like a morph or midi learn, while the UI thread sets the same property
+    std::thread audio([&] {
+      for (int i = 1; i <= 10000; i++) {
+        prop.set(-i);
+        AudioThreadQueue::get().process_changes();
+      }
+    });
+    for (int i = 1; i <= 10000; i++) prop.set(i);
+    audio.join();
+
+    AudioThreadQueue::get().process_changes();
+    REQUIRE((prop == 10000 || prop == -10000));
+    REQUIRE(last == prop.get());
+  }
+
+  TEST_CASE ("audio_thread properties destroyed while their change is applied", "[props]") {
+    std::atomic_bool done = false;
+    std::thread audio([&] {
+      while (!done) AudioThreadQueue::get().process_changes();
+    });
+    for (int i = 1; i <= 20; i++) {
+      std::atomic_bool applying = false;
+      int seen = 0;
+      auto prop = std::make_unique<Property<int, audio_thread>>(0);
+      prop->on_change().connect([&p = *prop, &applying, &seen] {
+        applying = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        // A use after free, unless the destructor waits for this
+        seen = p.load_value();
+      });
+      prop->set(i);
+      while (!applying) std::this_thread::yield();
+      prop.reset();
+      REQUIRE(seen == i);
+    }
+    done = true;
+    audio.join();
+  }
+
+  TEST_CASE ("atomic", "[props]") {
+    Property<float, atomic> prop = {0.5, limits(0, 1)};
+    // The initial value is stored on construction
+    REQUIRE(prop.load() == 0.5f);
+
+    float seen = -1;
+    prop.on_change().connect([&](float) { seen = prop.load(); });
+    prop.set(2);
+    // The value after the hooks is stored, before the signal
+    REQUIRE(prop.load() == 1.f);
+    REQUIRE(seen == 1.f);
+
+    Property<int, no_defaults, atomic> plain = 3;
+    auto copy = plain;
+    REQUIRE(copy.load() == 3);
+
+    // Smoothed properties read their target through it
+    static_assert(Property<float, smoothed>::is<atomic>);
+  }
+
+  TEST_CASE ("smoothed", "[props]") {
+    Property<float, smoothed> prop = {0, smoothed::init(4)};
+
+    auto block = prop.smoothed_block(8);
+    REQUIRE(block.size() == 8);
+    REQUIRE(util::all_of(block, [](float f) { return f == 0.f; }));
+    REQUIRE_FALSE(prop.is_ramping());
+
+    prop = 1;
+    block = prop.smoothed_block(2);
+    REQUIRE(block[0] == Approx(0.25f));
+    REQUIRE(block[1] == Approx(0.5f));
+    REQUIRE(prop.is_ramping());
+
+    block = prop.smoothed_block(4);
+    REQUIRE(block[0] == Approx(0.75f));
+    REQUIRE(block[1] == 1.f);
+    REQUIRE(block[3] == 1.f);
+    REQUIRE_FALSE(prop.is_ramping());
+    REQUIRE(prop.smoothed_value() == 1.f);
+  }
+
+  TEST_CASE ("BulkUpdate", "[props]") {
+    Property<float> a = 0;
+    Property<float> b = 0;
+    std::vector<std::pair<float, float>> changes;
+    a.on_change().connect([&](float n, float o) { changes.emplace_back(n, o); });
+    int computed = 0;
+    auto compute = [&] { coalesce(&computed, [&] { computed++; }); };
+    a.on_change().connect(compute);
+    b.on_change().connect(compute);
+
+    SECTION ("Signals are held back, and emitted once with the first old value") {
+      {
+        BulkUpdate bulk;
+        a = 1;
+        a = 2;
+        b = 1;
+        REQUIRE(changes.empty());
+        REQUIRE(computed == 0);
+      }
+      REQUIRE(changes == std::vector<std::pair<float, float>>{{2, 0}});
+      REQUIRE(computed == 1);
+    }
+
+    SECTION ("Nested bulk updates end with the outermost") {
+      {
+        BulkUpdate outer;
+        {
+          BulkUpdate inner;
+          a = 1;
+        }
+        REQUIRE(changes.empty());
+      }
+      REQUIRE(changes.size() == 1);
+    }
+
+    SECTION ("Without a bulk update, signals are emitted right away") {
+      a = 1;
+      b = 1;
+      REQUIRE(changes.size() == 1);
+      REQUIRE(computed == 2);
+    }
+  }
 } // namespace otto::core::props
@@ -0,0 +1,117 @@
+#include "testing.t.hpp"
+
+#include "core/props/props.hpp"
+#include "core/props/snapshot.hpp"
+
+namespace otto::core::props {
+
+  struct SnapshotTestProps {
+    Property<float> level = 0.5;
+    Property<int> steps = 4;
+    Property<bool> on = false;
+    Property<std::string> name = std::string("init");
+
+    struct Envelope {
+      Property<float> attack = 0.1;
+      Property<float> release = 0.2;
+
+      DECL_REFLECTION(Envelope, attack, release);
+    } envelope;
+
+    DECL_REFLECTION(SnapshotTestProps, level, steps, on, name, envelope);
+  };
+
+  TEST_CASE ("Property snapshots", "[props]") {
+    SnapshotTestProps props;
+    props.level = 0.8;
+    props.steps = 7;
+    props.on = true;
+    props.name = std::string("lead");
+    props.envelope.release = 1;
+    auto json = util::serialize(props);
+
+    SnapshotTestProps other;
+    auto snapshot = Snapshot::capture(other, json);
+    REQUIRE(snapshot.size() == 6);
+    // Capturing does not change the properties
+    REQUIRE(other.level == 0.5);
+
+    snapshot.apply();
+    REQUIRE(other.level == 0.8f);
+    REQUIRE(other.steps == 7);
+    REQUIRE(other.on == true);
+    REQUIRE(other.name.get() == "lead");
+    REQUIRE(other.envelope.release == 1.f);
+
+    SECTION ("Applying again restores the values") {
+      other.level = 0.1;
+      other.envelope.attack = 3;
+      snapshot.apply();
+      REQUIRE(other.level == 0.8f);
+      REQUIRE(other.envelope.attack == 0.1f);
+    }
+
+    SECTION ("Members missing from the json are left out") {
+      json.erase("envelope");
+      auto partial = Snapshot::capture(other, json);
+      REQUIRE(partial.size() == 4);
+    }
+
+    SECTION ("Signals are emitted when applying") {
+      SnapshotTestProps third;
+      auto snap = Snapshot::capture(third, json);
+      float seen = 0;
+      third.level.on_change().connect([&](float f) { seen = f; });
+      snap.apply();
+      REQUIRE(seen == 0.8f);
+    }
+  }
+
+  struct TakenTestProps {
+    SnapshotTestProps main;
+    std::array<SnapshotTestProps::Envelope, 2> envelopes;
+    std::vector<int> steps = {1, 2};
+
+    DECL_REFLECTION(TakenTestProps, main, envelopes, steps);
+  };
+
+  TEST_CASE ("Snapshots taken of objects", "[props]") {
+    TakenTestProps props;
+    props.main.level = 0.8;
+    props.main.name = std::string("lead");
+    props.envelopes[1].attack = 0.7;
+    props.steps = {3};
+    auto snapshot = Snapshot::take(props);
+    REQUIRE(snapshot.size() == 11);
+
+    SECTION ("Restoring to another object sets its properties") {
+      TakenTestProps other;
+      snapshot.restore(other);
+      REQUIRE(other.main.level == 0.8f);
+      REQUIRE(other.main.name.get() == "lead");
+      REQUIRE(other.envelopes[1].attack == 0.7f);
+      REQUIRE(other.steps == std::vector{3});
+    }
+
+    SECTION ("Only changed properties are set") {
+      TakenTestProps other;
+      int changes = 0;
+      other.main.level.on_change().connect([&] { changes++; });
+      other.main.steps.on_change().connect([&] { changes++; });
+      snapshot.restore(other);
+      REQUIRE(changes == 1);
+    }
+
+    SECTION ("Serializes like util::serialize") {
+      auto json = util::serialize(props);
+      props.main.level = 0.1;
+      REQUIRE(snapshot.to_json<TakenTestProps>() == json);
+    }
+
+    SECTION ("Can't be restored to another type") {
+      SnapshotTestProps other;
+      REQUIRE_THROWS(snapshot.restore(other));
+    }
+  }
+
+} // namespace otto::core::props
@@ -0,0 +1,34 @@
+#include "testing.t.hpp"
+
+#include "core/ui/draw_stats.hpp"
+#include "core/ui/soft_renderer.hpp"
+
+namespace otto::core::ui::vg {
+
+  TEST_CASE ("draw_stats", "[ui]") {
+    SoftRenderer renderer(40, 30);
+    auto* nvg = renderer.context();
+    DrawStats before = draw_stats(nvg);
+    REQUIRE(before.draw_calls() == 0);
+
+    nvgBeginFrame(nvg, 40, 30, 1);
+    nvgBeginPath(nvg);
+    nvgRect(nvg, 0, 0, 10, 10);
+    nvgFillColor(nvg, nvgRGB(255, 255, 255));
+    nvgFill(nvg);
+    nvgStrokeWidth(nvg, 2);
+    nvgStroke(nvg);
+    nvgEndFrame(nvg);
+
+    DrawStats drawn = draw_stats(nvg) - before;
+    REQUIRE(drawn.fills == 1);
+    REQUIRE(drawn.strokes == 1);
+    REQUIRE(drawn.triangles == 0);
+    REQUIRE(drawn.vertices > 0);
+
+    SECTION ("The drawing still reaches the backend") {
+      REQUIRE(renderer.pixels()[5 * 40 + 5] == 0xFFFF);
+    }
+  }
+
+} // namespace otto::core::ui::vg
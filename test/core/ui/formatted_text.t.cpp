@@ -0,0 +1,23 @@
+#include "testing.t.hpp"
+
+#include "core/ui/vector_graphics.hpp"
+
+namespace otto::core::ui::vg {
+
+  TEST_CASE ("FormattedText", "[ui]") {
+    FormattedText<int, float> text = {"{} / {:.1f}"};
+
+    REQUIRE(text(1, 2.f) == "1 / 2.0");
+
+    SECTION ("The text is kept while the values are unchanged") {
+      auto* data = text(1, 2.f).data();
+      REQUIRE(text(1, 2.f).data() == data);
+    }
+
+    SECTION ("The text is formatted again when a value changes") {
+      REQUIRE(text(3, 2.f) == "3 / 2.0");
+      REQUIRE(text(3, 0.5f) == "3 / 0.5");
+    }
+  }
+
+} // namespace otto::core::ui::vg
@@ -0,0 +1,43 @@
+#include "testing.t.hpp"
+
+#include "core/ui/screen.hpp"
+
+namespace otto::core::ui {
+
+  struct LazyTestScreen : Screen {
+    LazyTestScreen(int& constructed, int* value) : value(value)
+    {
+      constructed++;
+    }
+
+    void draw(vg::Canvas&) override {}
+
+    int* value;
+  };
+
+  TEST_CASE ("LazyScreen", "[ui]") {
+    int constructed = 0;
+    int value = 0;
+    LazyScreen screen = lazy_screen<LazyTestScreen>(constructed, &value);
+
+    REQUIRE(constructed == 0);
+    REQUIRE_FALSE(screen.constructed());
+
+    SECTION ("The screen is constructed once, when it is first used") {
+      auto& first = screen.get();
+      REQUIRE(constructed == 1);
+      REQUIRE(&screen.get() == &first);
+      REQUIRE(constructed == 1);
+      REQUIRE(static_cast<LazyTestScreen&>(first).value == &value);
+    }
+
+    SECTION ("A reset screen is constructed again") {
+      screen.get();
+      screen.reset();
+      REQUIRE_FALSE(screen.constructed());
+      screen.get();
+      REQUIRE(constructed == 2);
+    }
+  }
+
+} // namespace otto::core::ui
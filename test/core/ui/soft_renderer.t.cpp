@@ -0,0 +1,44 @@
+#include "testing.t.hpp"
+
+#include "core/ui/soft_renderer.hpp"
+#include "core/ui/vector_graphics.hpp"
+
+namespace otto::core::ui::vg {
+
+  TEST_CASE ("SoftRenderer", "[ui]") {
+    SoftRenderer renderer(40, 30);
+    renderer.clear(Colours::Black);
+    auto pixel = [&](int x, int y) { return renderer.pixels()[y * renderer.width() + x]; };
+    auto* nvg = renderer.context();
+
+    SECTION ("Fills are blended by their coverage") {
+      nvgBeginFrame(nvg, 40, 30, 1);
+      nvgBeginPath(nvg);
+      nvgRect(nvg, 10.5, 5, 10, 10);
+      nvgFillColor(nvg, nvgRGB(255, 255, 255));
+      nvgFill(nvg);
+      nvgEndFrame(nvg);
+
+      REQUIRE(pixel(15, 10) == 0xFFFF);
+      REQUIRE(pixel(5, 10) == 0x0000);
+      REQUIRE(pixel(25, 10) == 0x0000);
+      // Half covered
+      REQUIRE((pixel(10, 10) >> 11) == 16);
+      REQUIRE((pixel(20, 10) >> 11) == 16);
+    }
+
+    SECTION ("Paths outside the frame are clipped") {
+      nvgBeginFrame(nvg, 40, 30, 1);
+      nvgBeginPath(nvg);
+      nvgRect(nvg, -20, -20, 30, 80);
+      nvgFillColor(nvg, nvgRGB(255, 0, 0));
+      nvgFill(nvg);
+      nvgEndFrame(nvg);
+
+      REQUIRE(pixel(0, 0) == 0xF800);
+      REQUIRE(pixel(9, 29) == 0xF800);
+      REQUIRE(pixel(10, 29) == 0x0000);
+    }
+  }
+
+} // namespace otto::core::ui::vg
@@ -0,0 +1,142 @@
+#include "testing.t.hpp"
+
+#include "core/voices/voice_allocator.hpp"
+
+namespace otto::core::voices {
+
+  TEST_CASE ("VoiceAllocator", "[voices]") {
+    VoiceAllocator alloc;
+    for (int i = 0; i < 3; i++) alloc.free_voice(i);
+
+    SECTION ("Notes take the free voices in order") {
+      REQUIRE(alloc.note_on(60).voice == 0);
+      REQUIRE(alloc.note_on(62).voice == 1);
+      REQUIRE(alloc.note_on(64).voice == 2);
+      REQUIRE(alloc.voice(62) == 1);
+      REQUIRE(alloc.held(64));
+    }
+
+    SECTION ("A released voice is the last to be reused") {
+      alloc.note_on(60);
+      auto released = alloc.note_off(60);
+      REQUIRE(released.voice == 0);
+      REQUIRE(released.next_key == -1);
+      REQUIRE_FALSE(alloc.held(60));
+      REQUIRE(alloc.note_on(61).voice == 1);
+      REQUIRE(alloc.note_on(62).voice == 2);
+      REQUIRE(alloc.note_on(63).voice == 0);
+    }
+
+    SECTION ("The oldest sounding note is stolen, and gets a voice back when one is freed") {
+      alloc.note_on(60);
+      alloc.note_on(62);
+      alloc.note_on(64);
+      auto stolen = alloc.note_on(65);
+      REQUIRE(stolen.voice == 0);
+      REQUIRE(stolen.stolen_key == 60);
+      REQUIRE(alloc.held(60));
+      REQUIRE(alloc.voice(60) == -1);
+
+      auto stolen2 = alloc.note_on(67);
+      REQUIRE(stolen2.stolen_key == 62);
+
+      // The newest waiting note gets the voice
+      auto released = alloc.note_off(64);
+      REQUIRE(released.voice == 2);
+      REQUIRE(released.next_key == 62);
+      REQUIRE(alloc.voice(62) == 2);
+
+      // A waiting note has no voice to release
+      auto waiting = alloc.note_off(60);
+      REQUIRE(waiting.voice == -1);
+      REQUIRE_FALSE(alloc.held(60));
+
+      // The re-voiced note is now the newest sounding note
+      REQUIRE(alloc.note_on(69).stolen_key == 65);
+    }
+
+    SECTION ("A given sounding key is stolen instead of the oldest") {
+      alloc.note_on(60);
+      alloc.note_on(62);
+      alloc.note_on(64);
+      auto stolen = alloc.note_on(65, 62);
+      REQUIRE(stolen.voice == 1);
+      REQUIRE(stolen.stolen_key == 62);
+      // A key without a voice falls back to the oldest
+      REQUIRE(alloc.note_on(67, 62).stolen_key == 60);
+    }
+
+    SECTION ("A note can take back the free voice it last played on") {
+      alloc.note_on(60);
+      alloc.note_on(62);
+      alloc.note_off(62);
+      alloc.note_off(60);
+      // Free voices are now 2, 1, 0
+      REQUIRE(alloc.note_on(62, -1, true).voice == 1);
+      REQUIRE(alloc.note_on(64, -1, true).voice == 2);
+      REQUIRE(alloc.note_on(65, -1, true).voice == 0);
+    }
+
+    SECTION ("A disabled voice is not used until it is freed") {
+      alloc.disable_voice(0);
+      REQUIRE(alloc.note_on(60).voice == 1);
+      REQUIRE(alloc.note_on(62).voice == 2);
+      REQUIRE(alloc.disable_voice(2) == 62);
+      REQUIRE(alloc.voice(62) == -1);
+      // 62 is waiting, and gets the next freed voice
+      auto released = alloc.note_off(60);
+      REQUIRE(released.next_key == 62);
+      REQUIRE(alloc.voice(62) == 1);
+      alloc.free_voice(0);
+      REQUIRE(alloc.note_on(64).voice == 0);
+    }
+
+    SECTION ("Releasing an unheld key does nothing") {
+      auto released = alloc.note_off(70);
+      REQUIRE(released.voice == -1);
+      REQUIRE(alloc.note_on(70).voice == 0);
+    }
+
+    SECTION ("Sustained notes are listed until released") {
+      alloc.note_on(60);
+      alloc.note_on(62);
+      alloc.note_on(64);
+      alloc.note_on(65);
+      alloc.sustain(60);
+      alloc.sustain(64);
+      alloc.sustain(70);
+      auto sustained = alloc.sustained();
+      REQUIRE(sustained.size() == 2);
+      REQUIRE(std::count(sustained.begin(), sustained.end(), 60) == 1);
+      REQUIRE(std::count(sustained.begin(), sustained.end(), 64) == 1);
+      alloc.note_off(64);
+      REQUIRE(alloc.sustained().size() == 1);
+    }
+
+    SECTION ("Clearing frees nothing") {
+      alloc.note_on(60);
+      alloc.clear();
+      REQUIRE_FALSE(alloc.held(60));
+      REQUIRE(alloc.note_on(60).voice == -1);
+      REQUIRE(alloc.held(60));
+    }
+
+    SECTION ("A note flood keeps every voice in use exactly once") {
+      for (int i = 0; i < 1000; i++) {
+        int key = (i * 37) % 128;
+        if (alloc.held(key)) {
+          alloc.note_off(key);
+        } else {
+          alloc.note_on(key);
+        }
+        std::array<int, 3> users = {};
+        for (int k = 0; k < 128; k++) {
+          if (alloc.voice(k) >= 0) users[alloc.voice(k)]++;
+        }
+        CAPTURE(i);
+        for (int u : users) REQUIRE(u <= 1);
+      }
+    }
+  }
+
+} // namespace otto::core::voices
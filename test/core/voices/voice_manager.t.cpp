@@ -0,0 +1,239 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+#include <string_view>
+
+#include <Gamma/Domain.h>
+
+#include "core/props/property_table.hpp"
+#include "core/voices/voice_manager.inl"
+
+#include "services/application.hpp"
+#include "services/asset_loader.hpp"
+#include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
+#include "services/controller.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "services/preset_manager.hpp"
+#include "services/state_manager.hpp"
+#include "services/ui_manager.hpp"
+
+namespace otto::core::voices {
+
+  namespace {
+    constexpr int samplerate = 48000;
+    constexpr int nframes = 256;
+
+    struct TestProps {};
+
+    struct TestPre : PreBase<TestPre, TestProps> {
+      using PreBase::PreBase;
+    };
+
+    /// A voice whose raw signal is 1, so the output is the sum of the envelopes and gains
+    struct TestVoice : VoiceBase<TestVoice, TestPre> {
+      using VoiceBase::VoiceBase;
+
+      float operator()() noexcept
+      {
+        return 1.f;
+      }
+    };
+
+    struct TestPost : PostBase<TestPost, TestVoice> {
+      using PostBase::PostBase;
+    };
+
+    using TestVoiceManager = VoiceManager<TestPost>;
+
+    /// Set the property at `path` of `vm`, like `"voice_settings/play_mode"`
+    void set(TestVoiceManager& vm, std::string_view path, double value)
+    {
+      auto& table = props::PropertyTable<TestVoiceManager>::of(vm);
+      int index = table.find(path);
+      REQUIRE(index >= 0);
+      table.set(vm, index, value);
+    }
+
+    /// A midi event without a struct of its own, like channel pressure
+    midi::AnyMidiEvent raw_event(int status, int data0, int data1 = 0)
+    {
+      midi::AnyMidiEvent res;
+      res.status = status;
+      res.data = {midi::MidiEvent::byte(data0), midi::MidiEvent::byte(data1)};
+      return res;
+    }
+  } // namespace
+
+  TEST_CASE ("VoiceManager", "[voices]") {
+    gam::sampleRate(samplerate);
+    // The voice manager loads tunings on the asset loader
+    using namespace services;
+    auto app = std::make_unique<Application>(
+      test::none<LogManager>(), test::none<StateManager>(), test::none<PresetManager>(),
+      test::none<AudioManager>(), test::none<ClockManager>(), std::make_unique<AssetLoader>,
+      test::none<UIManager>(), test::none<Controller>(), test::none<EngineManager>());
+    audio::AudioBufferPool pool{nframes, 16};
+    audio::AudioContext context{&pool, samplerate};
+    TestProps props;
+    TestVoiceManager vm{props};
+    auto voices = vm.voices();
+
+    /// Process `seconds` of audio without events, and return the last frame
+    auto render = [&](float seconds) {
+      float last = 0;
+      for (int i = 0; i < int(seconds * samplerate / nframes) + 1; i++) {
+        midi::MidiBuffer midi;
+        auto out = vm.process({pool.allocate_clear(), midi, nframes, &context});
+        last = out.audio[nframes - 1];
+      }
+      return last;
+    };
+    // The voice manager reads the context of the last buffer in the event handlers
+    render(0);
+
+    SECTION ("In unison mode, a note plays a detuned group of voices at constant power") {
+      set(vm, "voice_settings/play_mode", TestVoiceManager::PlayMode::unison);
+      const int group = vm.unison_voices();
+      const int groups = vm.voice_count() / group;
+      REQUIRE(group > 1);
+
+      auto& voice = vm.handle_midi_on(midi::NoteOnEvent(60));
+      REQUIRE(&voice == &voices[0]);
+      float out = render(0.2);
+      REQUIRE(vm.sounding_voices() == group);
+      // Each voice at full sustain, scaled by 1/sqrt(group)
+      REQUIRE(out == Approx(std::sqrt(float(group))));
+
+      // Spread evenly over [-detune, detune] half semitones, 0.2 by default
+      for (int i = 0; i < group; i++) {
+        CAPTURE(i);
+        float place = 2.f * i / (group - 1) - 1.f;
+        REQUIRE(voices[i].frequency() == Approx(midi::note_freq(60) * std::pow(2.f, place * 0.2f / 24)));
+      }
+      REQUIRE(voices[0].frequency() < midi::note_freq(60));
+      REQUIRE(voices[group - 1].frequency() > midi::note_freq(60));
+
+      SECTION ("Notes take the next group, and steal the oldest group when all play") {
+        for (int n = 1; n < groups; n++) {
+          REQUIRE(&vm.handle_midi_on(midi::NoteOnEvent(60 + n)) == &voices[n * group]);
+        }
+        render(0.01);
+        REQUIRE(vm.sounding_voices() == groups * group);
+
+        REQUIRE(&vm.handle_midi_on(midi::NoteOnEvent(72)) == &voices[0]);
+        render(0.2);
+        REQUIRE(vm.sounding_voices() == groups * group);
+        REQUIRE(vm.sounding_voices() <= vm.voice_count());
+        for (int i = 0; i < group; i++) {
+          CAPTURE(i);
+          float place = 2.f * i / (group - 1) - 1.f;
+          REQUIRE(voices[i].frequency() == Approx(midi::note_freq(72) * std::pow(2.f, place * 0.2f / 24)));
+        }
+      }
+
+      SECTION ("The whole group is released") {
+        vm.handle_midi_off(midi::NoteOffEvent(60));
+        for (int i = 0; i < group; i++) REQUIRE_FALSE(voices[i].is_triggered());
+        render(0.3);
+        REQUIRE(vm.sounding_voices() == 0);
+      }
+
+      SECTION ("Polyphonic aftertouch reaches every voice of the group") {
+        REQUIRE(vm.handle_expression(raw_event(0xA0, 60, 127)));
+        render(0);
+        for (int i = 0; i < group; i++) REQUIRE(voices[i].aftertouch() == Approx(1));
+      }
+    }
+
+    SECTION ("With MPE, the bend and pressure of a channel go to the notes on it") {
+      set(vm, "voice_settings/mpe", 1);
+      auto& first = vm.handle_midi_on(midi::NoteOnEvent(60, 1, 1));
+      auto& second = vm.handle_midi_on(midi::NoteOnEvent(64, 1, 2));
+      REQUIRE(&first != &second);
+
+      midi::PitchBendEvent bend(8192 + 2048);
+      bend.channel = 1;
+      REQUIRE(vm.handle_expression(bend));
+      REQUIRE(vm.handle_expression(raw_event(0xD2, 64)));
+      REQUIRE(vm.handle_expression(raw_event(0xB2, 74, 127)));
+      render(0);
+
+      const float ratio = std::pow(midi::pitch_bend_ratio(8192 + 2048), float(TestVoiceManager::mpe_bend_octaves));
+      REQUIRE(first.frequency() == Approx(midi::note_freq(60) * ratio));
+      REQUIRE(second.frequency() == Approx(midi::note_freq(64)));
+      REQUIRE(first.aftertouch() == 0);
+      REQUIRE(second.aftertouch() == Approx(64 / 127.f));
+      REQUIRE(first.timbre() == Approx(0.5));
+      REQUIRE(second.timbre() == Approx(1));
+
+      SECTION ("The master channel bends all notes") {
+        midi::PitchBendEvent master(8192 + 4096);
+        REQUIRE_FALSE(vm.handle_expression(master));
+        vm.handle_pitch_bend(master);
+        render(0);
+        const float master_ratio = midi::pitch_bend_ratio(8192 + 4096);
+        REQUIRE(first.frequency() == Approx(midi::note_freq(60) * ratio * master_ratio));
+        REQUIRE(second.frequency() == Approx(midi::note_freq(64) * master_ratio));
+      }
+
+      SECTION ("A note starts with the last expression of its channel") {
+        REQUIRE(vm.handle_expression(raw_event(0xD3, 127)));
+        auto& third = vm.handle_midi_on(midi::NoteOnEvent(67, 1, 3));
+        auto& fourth = vm.handle_midi_on(midi::NoteOnEvent(69, 1, 4));
+        render(0);
+        REQUIRE(third.aftertouch() == Approx(1));
+        REQUIRE(fourth.aftertouch() == 0);
+        REQUIRE(second.aftertouch() == Approx(64 / 127.f));
+      }
+    }
+
+    SECTION ("Without MPE, all notes share the pressure, and the pitch bend is global") {
+      auto& first = vm.handle_midi_on(midi::NoteOnEvent(60, 1, 1));
+      auto& second = vm.handle_midi_on(midi::NoteOnEvent(64, 1, 2));
+      REQUIRE(vm.handle_expression(raw_event(0xD2, 127)));
+      midi::PitchBendEvent bend(8192 + 2048);
+      bend.channel = 1;
+      REQUIRE_FALSE(vm.handle_expression(bend));
+      render(0);
+      REQUIRE(first.aftertouch() == Approx(1));
+      REQUIRE(second.aftertouch() == Approx(1));
+      REQUIRE(first.frequency() == Approx(midi::note_freq(60)));
+    }
+
+    SECTION ("Released voices are retired below the silence floor") {
+      REQUIRE(vm.silence_floor() == Approx(TestVoiceManager::default_silence_floor));
+      vm.handle_midi_on(midi::NoteOnEvent(60));
+      render(0.2);
+
+      SECTION ("The default floor keeps the release until it is about done") {
+        vm.handle_midi_off(midi::NoteOffEvent(60));
+        // The release takes 0.2 seconds
+        render(0.15);
+        REQUIRE(vm.sounding_voices() == 1);
+        render(0.1);
+        REQUIRE(vm.sounding_voices() == 0);
+      }
+
+      SECTION ("A higher floor retires the voice early") {
+        vm.silence_floor(-20);
+        REQUIRE(vm.silence_floor() == Approx(-20));
+        vm.handle_midi_off(midi::NoteOffEvent(60));
+        // The release is at -20 dB after about half its time
+        render(0.15);
+        REQUIRE(vm.sounding_voices() == 0);
+      }
+    }
+
+    SECTION ("Held notes are not retired, however quiet") {
+      vm.silence_floor(-20);
+      set(vm, "envelope/sustain", 0.05);
+      vm.handle_midi_on(midi::NoteOnEvent(60));
+      float out = render(0.3);
+      REQUIRE(vm.sounding_voices() == 1);
+      REQUIRE(out == Approx(0.05));
+    }
+  }
+
+} // namespace otto::core::voices
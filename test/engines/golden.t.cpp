@@ -0,0 +1,531 @@
+#include "testing.t.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+
+#include <AudioFile.h>
+#include <Gamma/Domain.h>
+#include <json.hpp>
+
+#include "core/engine/engine_dispatcher.inl"
+
+#include "services/asset_loader.hpp"
+#include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
+#include "services/controller.hpp"
+#include "services/engine_dispatchers.hpp"
+#include "services/preset_manager.hpp"
+#include "services/state_manager.hpp"
+#include "services/ui_manager.hpp"
+
+/// Golden-output and performance regression tests of the engines
+///
+/// Every synth and effect of the dispatchers of the `DefaultEngineManager` renders a fixed
+/// input, through `EngineDispatcher::process` like on the device: the synths a sequence of
+/// notes, pitch bends and mod wheel, the effects bursts of a test tone. The renders are
+/// compared to the references in `test/data/golden/<engine>.wav`, and a missing one fails the
+/// test. The references are only written by running the tests with `OTTO_UPDATE_GOLDEN=1`: for
+/// a new engine, or after a change that is meant to change the sound, once you have listened to
+/// the new renders. The test is hidden as `[.golden]` until the references are checked in, so
+/// run it with `./test "[.golden]"`.
+///
+/// The engines load the wavetables, samples and impulse responses from the `data` directory of
+/// the repository, and presets are not loaded, so the renders use the default properties.
+///
+/// The hidden `[.perf]` test times each engine, and fails when one is slower than in the
+/// baseline by more than `OTTO_PERF_THRESHOLD` (default `0.25`, so 25%). The baseline is
+/// machine specific, so it is not checked in: it is written to `OTTO_PERF_BASELINE` (default
+/// `engine_perf.json` in the working directory) by the first run, and compared to after that.
+/// ```sh
+/// git stash && ./test "[.perf]" && git stash pop && ./test "[.perf]"
+/// ```
+///
+/// The hidden `[.wcet]` test looks for the properties that make each engine slowest, which
+/// the averages of `[.perf]` hide. It sweeps every limited property of each engine through
+/// its range, one at a time from the defaults, then sets all those that made the engine
+/// slower at once, under a few loads: held and retriggered notes for the synths, a tone and
+/// full scale noise for the effects. Each configuration is timed per callback, for
+/// `OTTO_WCET_BUFFERS` buffers (default 1000), and ranked by the 99.9th percentile of the
+/// callback time. The ranking is printed, and written to `OTTO_WCET_REPORT` (default
+/// `engine_wcet.json` in the working directory). Sweeping all engines takes minutes, so
+/// `OTTO_WCET_ENGINE` limits it to the engine of that name.
+namespace otto::services {
+
+  namespace midi = core::midi;
+  namespace audio = core::audio;
+  namespace props = core::props;
+
+  namespace {
+
+    constexpr int samplerate = 48000;
+    constexpr int buffer_size = 256;
+    /// The length of the golden renders, about 1.5 seconds
+    constexpr int golden_buffers = 280;
+    /// The RMS of the difference to the reference, around -60 dBFS
+    constexpr float tolerance = 1e-3f;
+
+    const fs::path golden_dir = fs::path(OTTO_TEST_DATA_DIR) / "golden";
+
+    struct TestAudioManager final : AudioManager {
+      TestAudioManager()
+      {
+        _samplerate = samplerate;
+        _buffer_size = buffer_size;
+        buffer_pool().set_buffer_size(buffer_size);
+        buffer_pool().set_capacity(32);
+        gam::sampleRate(samplerate);
+      }
+    };
+
+    struct TestUIManager final : UIManager {
+      void main_ui_loop() override {}
+    };
+
+    /// Runs an application without devices, in its own data directory
+    struct EngineFixture {
+      EngineFixture() : cwd(fs::current_path())
+      {
+        auto root = test::dir / "engines";
+        fs::create_directories(root / "data");
+        for (auto subdir : {"wavetables", "samples", "impulses"}) {
+          auto link = root / "data" / subdir;
+          if (!fs::exists(link)) fs::create_directory_symlink(fs::path(OTTO_SOURCE_DIR) / "data" / subdir, link);
+        }
+        fs::current_path(root);
+        app = std::make_unique<Application>(test::none<LogManager>(),
+                                            StateManager::create_default,
+                                            std::make_unique<PresetManager>,
+                                            std::make_unique<TestAudioManager>,
+                                            ClockManager::create_default,
+                                            std::make_unique<AssetLoader>,
+                                            std::make_unique<TestUIManager>,
+                                            Controller::make_dummy,
+                                            test::none<EngineManager>());
+      }
+
+      ~EngineFixture()
+      {
+        app.reset();
+        fs::current_path(cwd);
+      }
+
+      fs::path cwd;
+      std::unique_ptr<Application> app;
+    };
+
+    /// The events of buffer number `buffer` sent to the synths
+    void midi_events(int buffer, midi::MidiBuffer& midi)
+    {
+      constexpr std::array<int, 3> chord = {48, 55, 64};
+      constexpr std::array<int, 5> melody = {60, 62, 64, 67, 69};
+      if (buffer == 0) {
+        for (int note : chord) midi.push_back(midi::NoteOnEvent(note, 0.8f));
+      } else if (buffer == 60) {
+        for (int note : chord) midi.push_back(midi::NoteOffEvent(note));
+      }
+      // A melody with notes starting within the buffers
+      if (buffer >= 64 && buffer < 224 && buffer % 16 == 0) {
+        int step = (buffer - 64) / 16;
+        if (step > 0) midi.push_back(midi::NoteOffEvent(melody[(step - 1) % melody.size()], 1, 0, 17));
+        midi.push_back(midi::NoteOnEvent(melody[step % melody.size()], 0.5f + 0.05f * step, 0, 17 * step));
+      } else if (buffer == 224) {
+        midi.push_back(midi::NoteOffEvent(melody[9 % melody.size()]));
+      }
+      // Bend up a whole tone and back
+      if (buffer >= 96 && buffer < 160 && buffer % 4 == 0) {
+        int value = 8192 + (buffer < 128 ? buffer - 96 : 160 - buffer) * 43;
+        midi.push_back(midi::PitchBendEvent(value));
+      }
+      // Sweep the mod wheel
+      if (buffer % 8 == 0) midi.push_back(midi::ControlChangeEvent(1, (buffer / 2) % 128));
+    }
+
+    /// The input of the effects: bursts of a 440 Hz sine with silence between them for the tails
+    void test_signal(int buffer, audio::AudioBufferHandle& in)
+    {
+      if ((buffer / 32) % 2 == 1) return;
+      int frame = buffer * buffer_size;
+      for (auto& frm : in) {
+        frm = 0.5f * std::sin(2 * M_PI * 440 * (frame++) / samplerate);
+      }
+    }
+
+    struct Render {
+      /// Like `AudioFile<float>::samples`
+      std::vector<std::vector<float>> channels;
+      std::chrono::nanoseconds time{0};
+
+      double ns_per_sample() const noexcept
+      {
+        return double(time.count()) / (channels.empty() ? 1 : channels[0].size());
+      }
+    };
+
+    /// Render `buffers` buffers with the current engine of `dispatcher`
+    template<typename Dispatcher>
+    Render render(Dispatcher& dispatcher, int buffers)
+    {
+      using clock = std::chrono::steady_clock;
+      constexpr bool is_synth = Dispatcher::engine_type == core::engine::EngineType::synth;
+      auto& pool = AudioManager::current().buffer_pool();
+      auto context = AudioManager::current().make_context();
+      midi::MidiBuffer midi;
+      Render res;
+      res.channels.resize(is_synth ? 1 : 2);
+      for (auto& ch : res.channels) ch.reserve(buffers * buffer_size);
+
+      for (int b = 0; b < buffers; b++) {
+        midi.clear();
+        auto in = pool.allocate_clear();
+        if (is_synth) {
+          midi_events(b, midi);
+        } else {
+          test_signal(b, in);
+        }
+        auto t0 = clock::now();
+        auto out = dispatcher.process(audio::ProcessData<1>(in, midi, buffer_size, &context));
+        res.time += clock::now() - t0;
+        if constexpr (is_synth) {
+          res.channels[0].insert(res.channels[0].end(), out.audio.begin(), out.audio.end());
+        } else {
+          for (int ch = 0; ch < 2; ch++) {
+            res.channels[ch].insert(res.channels[ch].end(), out.audio[ch].begin(), out.audio[ch].end());
+          }
+        }
+      }
+      return res;
+    }
+
+    /// Select each engine of `dispatcher` in turn, and call `f` with its name
+    template<typename Dispatcher, typename F>
+    void for_each_engine(Dispatcher& dispatcher, F&& f)
+    {
+      for (auto name : dispatcher.make_name_list()) {
+        dispatcher.select(name);
+        // Render with the wavetables and samples loaded
+        AssetLoader::current().flush();
+        f(std::string(name.c_str()));
+      }
+    }
+
+    void write_reference(const fs::path& path, Render& render)
+    {
+      fs::create_directories(path.parent_path());
+      AudioFile<float> file;
+      file.setAudioBuffer(render.channels);
+      file.setSampleRate(samplerate);
+      file.setBitDepth(24);
+      REQUIRE(file.save(path.string()));
+    }
+
+    void check_golden(const std::string& name, Render render)
+    {
+      INFO("Engine " << name);
+      auto path = golden_dir / (name + ".wav");
+      auto* update = std::getenv("OTTO_UPDATE_GOLDEN");
+      if (update != nullptr && std::string(update) == "1") {
+        write_reference(path, render);
+        WARN("Updated the reference render " << path.string());
+        return;
+      }
+      if (!fs::exists(path)) {
+        FAIL("Missing the reference render " << path.string() << ", see OTTO_UPDATE_GOLDEN");
+      }
+
+      AudioFile<float> reference;
+      REQUIRE(reference.load(path.string()));
+      REQUIRE(reference.samples.size() == render.channels.size());
+      for (std::size_t ch = 0; ch < render.channels.size(); ch++) {
+        auto& expected = reference.samples[ch];
+        auto& actual = render.channels[ch];
+        REQUIRE(expected.size() == actual.size());
+        double sum = 0;
+        for (std::size_t i = 0; i < actual.size(); i++) {
+          // The file clips
+          double diff = std::clamp(actual[i], -1.f, 1.f) - expected[i];
+          sum += diff * diff;
+        }
+        float error = std::sqrt(sum / actual.size());
+        INFO("Channel " << ch << ", RMS error " << error);
+        CHECK(error <= tolerance);
+      }
+    }
+
+    /// A load for the worst case explorer
+    struct Load {
+      const char* name;
+      /// Fill the input of buffer number `buffer`, the midi for synths or the audio for effects
+      void (*fill)(int buffer, midi::MidiBuffer& midi, audio::AudioBufferHandle& in);
+    };
+
+    const std::array<Load, 2> synth_loads = {{
+      {"held chord",
+       [](int buffer, midi::MidiBuffer& midi, audio::AudioBufferHandle&) {
+         // More notes than the engines have voices, so all of them play
+         if (buffer == 0) {
+           for (int i = 0; i < 12; i++) midi.push_back(midi::NoteOnEvent(36 + 5 * i, 0.8f));
+         }
+       }},
+      {"retriggers",
+       [](int buffer, midi::MidiBuffer& midi, audio::AudioBufferHandle&) {
+         // Four notes moving twice per buffer, so voices are stolen and envelopes restart
+         for (int half = 0; half < 2; half++) {
+           int step = 2 * buffer + half;
+           int time = half * buffer_size / 2;
+           for (int i = 0; i < 4; i++) {
+             if (step > 0) midi.push_back(midi::NoteOffEvent(48 + 7 * i + (step - 1) % 3, 1, 0, time));
+             midi.push_back(midi::NoteOnEvent(48 + 7 * i + step % 3, 1, 0, time));
+           }
+         }
+       }},
+    }};
+
+    const std::array<Load, 2> effect_loads = {{
+      {"tone",
+       [](int buffer, midi::MidiBuffer&, audio::AudioBufferHandle& in) {
+         int frame = buffer * buffer_size;
+         for (auto& frm : in) frm = 0.5f * std::sin(2 * M_PI * 440 * (frame++) / samplerate);
+       }},
+      {"noise",
+       [](int, midi::MidiBuffer&, audio::AudioBufferHandle& in) {
+         static std::uint32_t state = 1;
+         for (auto& frm : in) {
+           state = state * 1664525u + 1013904223u;
+           frm = float(state) / float(std::numeric_limits<std::uint32_t>::max()) * 2 - 1;
+         }
+       }},
+    }};
+
+    /// The cost of a configuration, in nanoseconds per callback
+    struct Cost {
+      double p999 = 0;
+      double max = 0;
+    };
+
+    /// Process `buffers` buffers of `load` with the current engine of `dispatcher`, and time
+    /// each callback
+    ///
+    /// Each configuration starts from silence: the notes are released, and the tails of the
+    /// last one fade for a few buffers before the timing starts.
+    template<typename Dispatcher>
+    Cost measure_cost(Dispatcher& dispatcher, const Load& load, int buffers)
+    {
+      using clock = std::chrono::steady_clock;
+      constexpr int settle_buffers = 32;
+      auto& pool = AudioManager::current().buffer_pool();
+      auto context = AudioManager::current().make_context();
+      midi::MidiBuffer midi;
+      std::vector<double> times;
+      times.reserve(buffers);
+
+      for (int b = -settle_buffers; b < buffers; b++) {
+        midi.clear();
+        auto in = pool.allocate_clear();
+        if (b == -settle_buffers) {
+          for (int note = 0; note < 128; note++) midi.push_back(midi::NoteOffEvent(note));
+        } else if (b >= 0) {
+          load.fill(b, midi, in);
+        }
+        auto t0 = clock::now();
+        dispatcher.process(audio::ProcessData<1>(in, midi, buffer_size, &context));
+        if (b >= 0) times.push_back(std::chrono::duration<double, std::nano>(clock::now() - t0).count());
+      }
+      std::sort(times.begin(), times.end());
+      return {times[std::min(times.size() - 1, std::size_t(times.size() * 0.999))], times.back()};
+    }
+
+    /// The values to sweep property `info` through
+    ///
+    /// Each step when there are few, or nine values evenly spread over the limits. Properties
+    /// without limits are not swept, as they would go through the whole range of their type.
+    std::vector<double> sweep_values(const props::PropertyInfo& info)
+    {
+      constexpr double max_range = 1e5;
+      constexpr int max_steps = 8;
+      if (info.max <= info.min || info.max - info.min > max_range) return {};
+      double range = info.max - info.min;
+      int steps = info.step > 0 ? std::lround(range / info.step) : max_steps + 1;
+      std::vector<double> res;
+      if (steps <= max_steps) {
+        for (int i = 0; i <= steps; i++) res.push_back(info.min + i * info.step);
+      } else {
+        for (int i = 0; i <= max_steps; i++) res.push_back(info.min + range * i / max_steps);
+      }
+      return res;
+    }
+
+    /// A set of property values and a load, and what it cost
+    struct Configuration {
+      std::string load;
+      /// The properties changed from the defaults, like `props/feedback=1`
+      std::string changes;
+      Cost cost;
+    };
+
+    /// Sweep the properties of the current engine of `dispatcher`, and return the configurations
+    /// from the most to the least expensive
+    template<typename Dispatcher>
+    std::vector<Configuration> explore(Dispatcher& dispatcher, gsl::span<const Load> loads, int buffers)
+    {
+      /// How much slower a value must be than the defaults to be part of the combination
+      constexpr double noise = 0.05;
+      auto& engine = dispatcher.current();
+      std::vector<double> defaults(engine.property_count());
+      for (int i = 0; i < int(defaults.size()); i++) defaults[i] = engine.get_property(i);
+      auto restore_defaults = [&] {
+        for (int i = 0; i < int(defaults.size()); i++) {
+          if (engine.get_property(i) != defaults[i]) engine.set_property(i, defaults[i]);
+        }
+      };
+      std::vector<Configuration> res;
+
+      for (auto& load : loads) {
+        auto measure = [&](std::string changes) {
+          auto cost = measure_cost(dispatcher, load, buffers);
+          res.push_back({load.name, std::move(changes), cost});
+          return cost.p999;
+        };
+        double base = measure("defaults");
+        // The most expensive value of each property, if it costs more than the defaults
+        std::vector<std::pair<int, double>> worst;
+        for (int i = 0; i < engine.property_count(); i++) {
+          auto& info = engine.property_info(i);
+          double worst_value = 0;
+          double worst_cost = base * (1 + noise);
+          for (double value : sweep_values(info)) {
+            restore_defaults();
+            engine.set_property(i, value);
+            double cost = measure(fmt::format("{}={}", info.path, value));
+            if (cost > worst_cost) {
+              worst_cost = cost;
+              worst_value = value;
+            }
+          }
+          if (worst_cost > base * (1 + noise)) worst.emplace_back(i, worst_value);
+        }
+        // The costs of properties often add up, like the length and the shimmer of a reverb
+        if (worst.size() > 1) {
+          restore_defaults();
+          std::string changes;
+          for (auto [i, value] : worst) {
+            engine.set_property(i, value);
+            changes += fmt::format("{}{}={}", changes.empty() ? "" : " ", engine.property_info(i).path, value);
+          }
+          measure(std::move(changes));
+        }
+        restore_defaults();
+      }
+
+      std::stable_sort(res.begin(), res.end(), [](auto& a, auto& b) { return a.cost.p999 > b.cost.p999; });
+      return res;
+    }
+
+  } // namespace
+
+  TEST_CASE ("The registry of a dispatcher lists its engines", "[engines]") {
+    static_assert(SynthDispatcher::registry.size() == 4);
+    static_assert(SynthDispatcher::registry[3].name == "OTTO.FM");
+    static_assert(SynthDispatcher::registry[3].name_hash == core::engine::engine_name_hash("OTTO.FM"));
+    static_assert(SynthDispatcher::registry[3].object_size == sizeof(engines::OTTOFMSynth));
+
+    EngineFixture fixture;
+    EffectsDispatcher effect{true};
+    auto& registry = EffectsDispatcher::registry;
+    for (int i = 0; i < int(registry.size()); i++) {
+      INFO("Engine " << registry[i].name.c_str());
+      for (int j = 0; j < i; j++) REQUIRE(registry[i].name_hash != registry[j].name_hash);
+      effect.select(registry[i].name);
+      REQUIRE(effect.current_idx() == i);
+      REQUIRE(registry[i].make()->name() == registry[i].name);
+    }
+    REQUIRE_THROWS(effect.select("OTTO.FM"));
+  }
+
+  TEST_CASE ("Engines match their reference renders", "[.golden] [engines]") {
+    EngineFixture fixture;
+    SynthDispatcher synth{false};
+    for_each_engine(synth, [&](const std::string& name) { check_golden(name, render(synth, golden_buffers)); });
+    EffectsDispatcher effect{true};
+    for_each_engine(effect, [&](const std::string& name) { check_golden(name, render(effect, golden_buffers)); });
+  }
+
+  TEST_CASE ("Engine performance against the baseline", "[.perf] [engines]") {
+    EngineFixture fixture;
+    auto* env_path = std::getenv("OTTO_PERF_BASELINE");
+    fs::path path = env_path ? fs::path(env_path) : fixture.cwd / "engine_perf.json";
+    auto* env_threshold = std::getenv("OTTO_PERF_THRESHOLD");
+    double threshold = env_threshold ? std::stod(env_threshold) : 0.25;
+
+    nlohmann::json baseline = nlohmann::json::object();
+    if (fs::exists(path)) std::ifstream(path.c_str()) >> baseline;
+    bool changed = false;
+
+    auto check = [&](auto& dispatcher) {
+      for_each_engine(dispatcher, [&](const std::string& name) {
+        // The fastest of a few renders, since the slower ones also measure the rest of the system
+        double ns = std::numeric_limits<double>::max();
+        for (int i = 0; i < 5; i++) ns = std::min(ns, render(dispatcher, golden_buffers).ns_per_sample());
+        INFO("Engine " << name << ": " << ns << " ns per sample");
+        if (baseline.find(name) == baseline.end()) {
+          baseline[name] = ns;
+          changed = true;
+          WARN("Added " << name << " to the baseline at " << ns << " ns per sample");
+          return;
+        }
+        double base = baseline[name];
+        INFO("Baseline " << base << " ns per sample, threshold " << threshold * 100 << "%");
+        CHECK(ns <= base * (1 + threshold));
+      });
+    };
+    SynthDispatcher synth{false};
+    check(synth);
+    EffectsDispatcher effect{true};
+    check(effect);
+
+    if (changed) std::ofstream(path.c_str()) << baseline.dump(2) << std::endl;
+  }
+
+  TEST_CASE ("Worst case callback times of the engines", "[.wcet] [engines]") {
+    EngineFixture fixture;
+    auto* env_buffers = std::getenv("OTTO_WCET_BUFFERS");
+    int buffers = env_buffers ? std::stoi(env_buffers) : 1000;
+    auto* env_path = std::getenv("OTTO_WCET_REPORT");
+    fs::path path = env_path ? fs::path(env_path) : fixture.cwd / "engine_wcet.json";
+    auto* only = std::getenv("OTTO_WCET_ENGINE");
+    /// The number of configurations printed per engine
+    constexpr int printed = 10;
+    constexpr double deadline_ns = 1e9 * buffer_size / samplerate;
+
+    nlohmann::json report = nlohmann::json::object();
+    auto run = [&](auto& dispatcher, gsl::span<const Load> loads) {
+      for_each_engine(dispatcher, [&](const std::string& name) {
+        if (only != nullptr && name != only) return;
+        auto configs = explore(dispatcher, loads, buffers);
+        fmt::print("{}, by the 99.9th percentile of the callback time, of a deadline of {:.0f} us:\n", name,
+                   deadline_ns / 1e3);
+        auto& entries = report[name] = nlohmann::json::array();
+        for (int i = 0; i < int(configs.size()); i++) {
+          auto& c = configs[i];
+          entries.push_back(
+            {{"load", c.load}, {"changes", c.changes}, {"p99_9_ns", c.cost.p999}, {"max_ns", c.cost.max}});
+          if (i >= printed) continue;
+          fmt::print("  {:>8.1f} us {:>5.1f}% (max {:>8.1f} us)  {:<10}  {}\n", c.cost.p999 / 1e3,
+                     100 * c.cost.p999 / deadline_ns, c.cost.max / 1e3, c.load, c.changes);
+        }
+        CHECK(!configs.empty());
+      });
+    };
+    SynthDispatcher synth{false};
+    run(synth, synth_loads);
+    EffectsDispatcher effect{true};
+    run(effect, effect_loads);
+
+    std::ofstream(path.c_str()) << report.dump(2) << std::endl;
+    WARN("Wrote the worst case report to " << path.string());
+  }
+
+} // namespace otto::services
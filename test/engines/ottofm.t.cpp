@@ -0,0 +1,95 @@
+#include "testing.t.hpp"
+
+#include <array>
+
+#include "engines/synths/OTTOFM/ottofm.hpp"
+
+namespace otto::engines {
+
+  using OperatorBank = OTTOFMSynth::OperatorBank;
+
+  /// The per-sample dispatch used before the algorithms were compiled to kernels, for frame
+  /// `frame` of the current envelope chunk
+  static float switched_sample(OperatorBank& ops, int alg, int frame)
+  {
+    ops.update_amps(frame);
+    float res = 0.f;
+    switch (alg) {
+    case 0: res = ops(0, ops(1, ops(2, ops(3, 0)))); break;
+    case 1: res = ops(0, ops(1, ops(2, 0) + ops(3, 0))); break;
+    case 2: res = ops(0, ops(1, ops(2, 0)) + ops(3, 0)); break;
+    case 3: {
+      float aux = ops(3, 0);
+      res = ops(0, ops(1, aux) + ops(2, aux));
+    } break;
+    case 4: {
+      float aux = ops(2, ops(3, 0));
+      res = ops(0, aux) + ops(1, aux);
+    } break;
+    case 5: res = ops(0, 0) + ops(1, ops(2, ops(3, 0))); break;
+    case 6: res = ops(0, ops(1, 0) + ops(2, 0) + ops(3, 0)); break;
+    case 7: res = ops(0, ops(1, 0)) + ops(2, ops(3, 0)); break;
+    case 8: {
+      float aux = ops(3, 0);
+      res = ops(0, aux) + ops(1, aux) + ops(2, aux);
+    } break;
+    case 9: res = ops(0, 0) + ops(1, 0) + ops(2, ops(3, 0)); break;
+    case 10: res = ops(0, 0) + ops(1, 0) + ops(2, 0) + ops(3, 0); break;
+    default: break;
+    }
+    ops.advance_phases();
+    return res;
+  }
+
+  /// Render `output` with the switched dispatch, a chunk of envelopes at a time like the kernels
+  static void switched_block(OperatorBank& ops, int alg, gsl::span<float> output)
+  {
+    constexpr int chunk = OperatorBank::chunk_size;
+    for (int start = 0; start < output.size(); start += chunk) {
+      int n = std::min<int>(chunk, output.size() - start);
+      ops.update_envelopes(n);
+      for (int i = 0; i < n; i++) output[start + i] = switched_sample(ops, alg, i);
+    }
+  }
+
+  static OperatorBank make_bank()
+  {
+    OperatorBank ops;
+    ops.modulator = {false, true, true, true};
+    const float two_over_sr = 2.f / 44100;
+    ops.ratio_inc = {two_over_sr, 2 * two_over_sr, 0.5f * two_over_sr, 4 * two_over_sr};
+    ops.set_frequencies(440);
+    for (auto& env : ops.env) env.trigger();
+    return ops;
+  }
+
+  TEST_CASE ("OTTO.FM algorithm kernels", "[engines] [ottofm]") {
+    std::array<float, 256> expected;
+    std::array<float, 256> actual;
+    for (int alg = 0; alg < 11; alg++) {
+      auto ops1 = make_bank();
+      auto ops2 = make_bank();
+      switched_block(ops1, alg, expected);
+      OTTOFMSynth::algorithm_kernels[0][alg](ops2, actual);
+      CAPTURE(alg);
+      REQUIRE_THAT(std::vector<float>(actual.begin(), actual.end()),
+                   Catch::Matchers::Equals(std::vector<float>(expected.begin(), expected.end())));
+    }
+  }
+
+  TEST_CASE ("OTTO.FM algorithm benchmark", "[.benchmark] [engines] [ottofm]") {
+    std::array<float, 256> buffer;
+    OBENCH_SECTION ("OTTO.FM algorithms, 256 samples") {
+      for (int alg = 0; alg < 11; alg++) {
+        auto ops = make_bank();
+        OBENCH (fmt::format("Algorithm {:2} switch", alg), 1000) {
+          switched_block(ops, alg, buffer);
+        }
+        OBENCH (fmt::format("Algorithm {:2} kernel", alg), 1000) {
+          OTTOFMSynth::algorithm_kernels[0][alg](ops, buffer);
+        }
+      }
+    }
+  }
+
+} // namespace otto::engines
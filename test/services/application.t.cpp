@@ -0,0 +1,88 @@
+#include "testing.t.hpp"
+
+#include <optional>
+#include <thread>
+
+#include "core/props/mixins/all.hpp"
+#include "core/props/props.hpp"
+#include "services/application.hpp"
+#include "services/asset_loader.hpp"
+#include "services/audio_manager.hpp"
+#include "services/clock_manager.hpp"
+#include "services/controller.hpp"
+#include "services/engine_manager.hpp"
+#include "services/log_manager.hpp"
+#include "services/preset_manager.hpp"
+#include "services/state_manager.hpp"
+#include "services/ui_manager.hpp"
+
+namespace otto::services {
+
+  /// An application without any services, recording which application was current while its
+  /// services were constructed
+  static std::unique_ptr<Application> make_app(Application** current_in_construction)
+  {
+    return std::make_unique<Application>(
+      [current_in_construction] {
+        *current_in_construction = &Application::current();
+        return std::unique_ptr<LogManager>();
+      },
+      test::none<StateManager>(), test::none<PresetManager>(), test::none<AudioManager>(),
+      test::none<ClockManager>(), test::none<AssetLoader>(), test::none<UIManager>(),
+      test::none<Controller>(), test::none<EngineManager>());
+  }
+
+  TEST_CASE ("Several applications in one process", "[services]") {
+    Application* seen_first = nullptr;
+    Application* seen_second = nullptr;
+    auto first = make_app(&seen_first);
+    auto second = make_app(&seen_second);
+
+    SECTION ("Services find the application they are constructed by") {
+      REQUIRE(seen_first == first.get());
+      REQUIRE(seen_second == second.get());
+    }
+
+    SECTION ("The first application stays current") {
+      REQUIRE(&Application::current() == first.get());
+      Application* on_other_thread = nullptr;
+      std::thread([&] { on_other_thread = &Application::current(); }).join();
+      REQUIRE(on_other_thread == first.get());
+    }
+
+    SECTION ("A scope enters an application on its thread") {
+      Application* on_other_thread = nullptr;
+      {
+        Application::Scope scope{*second};
+        REQUIRE(&Application::current() == second.get());
+        {
+          Application::Scope inner{*first};
+          REQUIRE(&Application::current() == first.get());
+        }
+        REQUIRE(&Application::current() == second.get());
+        std::thread([&] { on_other_thread = &Application::current(); }).join();
+      }
+      REQUIRE(on_other_thread == first.get());
+      REQUIRE(&Application::current() == first.get());
+    }
+
+    SECTION ("Properties use the audio thread queue of their application") {
+      using namespace core::props;
+      REQUIRE(&AudioThreadQueue::get() == first->audio_thread_queue.get());
+      std::optional<Property<int, audio_thread>> prop;
+      {
+        Application::Scope scope{*second};
+        REQUIRE(&AudioThreadQueue::get() == second->audio_thread_queue.get());
+        prop.emplace(0);
+      }
+      int calls = 0;
+      prop->on_change().connect([&] { calls++; });
+      prop->set(1);
+      first->audio_thread_queue->process_changes();
+      REQUIRE(calls == 0);
+      second->audio_thread_queue->process_changes();
+      REQUIRE(calls == 1);
+    }
+  }
+
+} // namespace otto::services
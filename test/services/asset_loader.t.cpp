@@ -0,0 +1,118 @@
+#include "testing.t.hpp"
+
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "services/asset_loader.hpp"
+
+namespace otto::services {
+
+  TEST_CASE ("AssetLoader", "[services]") {
+    AssetLoader loader;
+    std::vector<int> loaded;
+    auto done = [&](std::unique_ptr<int> i) { loaded.push_back(*i); };
+    int key1 = 0;
+    int key2 = 0;
+
+    SECTION ("Completion handlers are called from process_completions") {
+      auto loader_thread = std::this_thread::get_id();
+      loader.load(&key1,
+                  [&] {
+                    loader_thread = std::this_thread::get_id();
+                    return std::make_unique<int>(1);
+                  },
+                  done);
+      loader.flush();
+      REQUIRE(loaded == std::vector{1});
+      REQUIRE(loader_thread != std::this_thread::get_id());
+    }
+
+    SECTION ("Nothing is completed before process_completions") {
+      loader.load(&key1, [] { return std::make_unique<int>(1); }, done);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      REQUIRE(loaded.empty());
+      loader.process_completions();
+      REQUIRE(loaded == std::vector{1});
+    }
+
+    SECTION ("A new request replaces the waiting request with the same key") {
+      // Keep the loader busy until all requests are made
+      std::promise<void> unblock;
+      auto blocked = unblock.get_future().share();
+      loader.load(&key2,
+                  [blocked] {
+                    blocked.wait();
+                    return std::make_unique<int>(0);
+                  },
+                  done);
+      loader.load(&key1, [] { return std::make_unique<int>(1); }, done);
+      loader.load(&key1, [] { return std::make_unique<int>(2); }, done);
+      unblock.set_value();
+      loader.flush();
+      REQUIRE(loaded == std::vector{0, 2});
+    }
+
+    SECTION ("Failed loads are not completed") {
+      loader.load(&key1,
+                  []() -> std::unique_ptr<int> {
+                    throw AssetLoader::exception(AssetLoader::ErrorCode::load_failed, "Failed");
+                  },
+                  done);
+      loader.load(&key2, [] { return std::make_unique<int>(2); }, done);
+      loader.flush();
+      REQUIRE(loaded == std::vector{2});
+    }
+
+    SECTION ("Cancelled requests are not completed") {
+      loader.load(&key1, [] { return std::make_unique<int>(1); }, done);
+      loader.load(&key2, [] { return std::make_unique<int>(2); }, done);
+      loader.cancel(&key1);
+      loader.flush();
+      REQUIRE(loaded == std::vector{2});
+    }
+
+    SECTION ("Requests with a cancelled token are not completed") {
+      util::CancelSource source;
+      loader.load(&key1, [] { return std::make_unique<int>(1); }, done, source.restart());
+      loader.load(&key2, [] { return std::make_unique<int>(2); }, done, source.restart());
+      loader.flush();
+      REQUIRE(loaded == std::vector{2});
+
+      // Cancelled while loading
+      loader.load(&key1,
+                  [&] {
+                    source.cancel();
+                    return std::make_unique<int>(3);
+                  },
+                  done, source.restart());
+      loader.flush();
+      REQUIRE(loaded == std::vector{2});
+    }
+
+    SECTION ("Waiting steps are called once they are ready") {
+      bool ready = false;
+      util::CancelSource source;
+      loader.when(&key1, [&] { return ready; }, [&] { loaded.push_back(1); });
+      loader.when(&key2, [&] { return ready; }, [&] { loaded.push_back(2); }, source.restart());
+      loader.process_completions();
+      REQUIRE(loaded.empty());
+      source.cancel();
+      ready = true;
+      REQUIRE(loader.process_completions());
+      REQUIRE(loaded == std::vector{1});
+      REQUIRE_FALSE(loader.process_completions());
+    }
+
+    SECTION ("Completion handlers may request more assets") {
+      loader.load(&key1, [] { return std::make_unique<int>(1); },
+                  [&](std::unique_ptr<int> i) {
+                    done(std::move(i));
+                    loader.load(&key2, [] { return std::make_unique<int>(2); }, done);
+                  });
+      loader.flush();
+      REQUIRE(loaded == std::vector{1, 2});
+    }
+  }
+
+} // namespace otto::services
@@ -0,0 +1,37 @@
+#include "testing.t.hpp"
+
+#include "services/audio_watchdog.hpp"
+
+namespace otto::services {
+
+  TEST_CASE ("AudioWatchdog::Detector", "[services]") {
+    using namespace std::chrono_literals;
+    AudioWatchdog::Detector detector;
+    auto t0 = AudioWatchdog::clock::now();
+    auto check = [&](unsigned buffer, bool running, std::chrono::milliseconds at) {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(detector.check(buffer, running, t0 + at));
+    };
+
+    SECTION ("A buffer number that keeps moving is no stall") {
+      for (unsigned i = 0; i < 100; i++) REQUIRE(check(i, true, i * 100ms) == 0ms);
+    }
+
+    SECTION ("A stall is reported once, after the limit") {
+      REQUIRE(check(1, true, 0ms) == 0ms);
+      REQUIRE(check(1, true, 400ms) == 0ms);
+      REQUIRE(check(1, true, 600ms) == 600ms);
+      REQUIRE(check(1, true, 700ms) == 0ms);
+      SECTION ("And again after the next buffer") {
+        REQUIRE(check(2, true, 800ms) == 0ms);
+        REQUIRE(check(2, true, 1400ms) == 600ms);
+      }
+    }
+
+    SECTION ("Audio that is not running is no stall") {
+      REQUIRE(check(1, false, 0ms) == 0ms);
+      REQUIRE(check(1, false, 1000ms) == 0ms);
+      REQUIRE(check(1, true, 1200ms) == 0ms);
+    }
+  }
+
+} // namespace otto::services
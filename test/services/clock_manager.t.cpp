@@ -0,0 +1,64 @@
+#include "testing.t.hpp"
+
+#include <vector>
+
+#include "services/clock_manager.hpp"
+
+namespace otto::services {
+
+  TEST_CASE ("DefaultClockManager", "[clock]") {
+    auto clock = ClockManager::create_default();
+    // 120 bpm at 48000 Hz is 1000 frames per tick
+    constexpr int samplerate = 48000;
+    REQUIRE(clock->bpm() == 120);
+    REQUIRE(clock->running());
+
+    SECTION ("Ticks are reported once, at the frame they fall on") {
+      std::vector<long> counts;
+      std::vector<int> frames;
+      for (int buffer = 0; buffer < 100; buffer++) {
+        clock->process(256, samplerate);
+        for (auto& tick : clock->ticks()) {
+          counts.push_back(tick.count);
+          frames.push_back(buffer * 256 + tick.frame);
+        }
+      }
+      REQUIRE(counts.size() == 26);
+      for (int i = 0; i < int(counts.size()); i++) {
+        REQUIRE(counts[i] == i);
+        REQUIRE(frames[i] == i * 1000);
+      }
+      REQUIRE(float(clock->current_time()) == Approx(99 * 256 / 24000.f));
+    }
+
+    SECTION ("frame_of finds positions inside the current buffer") {
+      clock->process(256, samplerate);
+      clock->process(256, samplerate);
+      REQUIRE(clock->position() == Approx(0.256));
+      REQUIRE(clock->frame_of(0.5005) == 244);
+      REQUIRE_FALSE(clock->frame_of(0.1));
+      REQUIRE_FALSE(clock->frame_of(0.6));
+    }
+  }
+
+  TEST_CASE ("MidiClockInput", "[clock]") {
+    auto clock = ClockManager::create_default();
+    auto input = MidiClockInput::create(*clock);
+    REQUIRE(input);
+    REQUIRE_FALSE(MidiClockInput::create(*clock));
+
+    REQUIRE(input->receive(0xFC, 0));
+    REQUIRE_FALSE(clock->running());
+    REQUIRE(input->receive(0xFA, 0));
+    REQUIRE(clock->running());
+    REQUIRE(clock->active_source() == ClockManager::Source::midi);
+    REQUIRE_FALSE(input->receive(0x90, 0));
+
+    // 90 bpm
+    double period = 60.0 / (90 * 24);
+    for (int i = 0; i < 200; i++) input->receive(0xF8, i * period);
+    REQUIRE(input->bpm() == Approx(90));
+    REQUIRE(clock->bpm() == Approx(90));
+  }
+
+} // namespace otto::services
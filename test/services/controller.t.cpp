@@ -0,0 +1,65 @@
+#include "testing.t.hpp"
+
+#include "services/controller.hpp"
+
+namespace otto::services {
+
+  using namespace std::chrono_literals;
+
+  TEST_CASE ("Controller encoder events", "[controller]") {
+    SECTION ("Slow turns are not accelerated") {
+      REQUIRE(Controller::accelerated_steps(1, 20ms) == 1);
+      REQUIRE(Controller::accelerated_steps(-2, 100ms) == -2);
+      REQUIRE(Controller::accelerated_steps(0, 1ms) == 0);
+    }
+
+    SECTION ("Fast turns are accelerated by their rate, up to the maximum") {
+      // 100 detents per second
+      REQUIRE(Controller::accelerated_steps(2, 20ms) == 4);
+      REQUIRE(Controller::accelerated_steps(-2, 20ms) == -4);
+      REQUIRE(Controller::accelerated_steps(10, 1ms) == 10 * Controller::max_acceleration);
+    }
+
+    SECTION ("The events of each encoder are merged into the first") {
+      Controller::EventBag bag = {
+        EncoderEvent{Encoder::blue, 1}, EncoderEvent{Encoder::red, -1}, EncoderEvent{Encoder::blue, 1},
+        EncoderEvent{Encoder::blue, -2}, KeyPressEvent{Key::shift},    EncoderEvent{Encoder::blue, 1},
+      };
+      // Slow enough not to accelerate
+      Controller::coalesce_encoder_events(bag, 1s);
+      REQUIRE(bag.size() == 4);
+      auto& blue = util::get<EncoderEvent>(bag[0]);
+      REQUIRE(blue.encoder == +Encoder::blue);
+      REQUIRE(blue.steps == 0);
+      REQUIRE(util::get<EncoderEvent>(bag[1]).steps == -1);
+
+      SECTION ("but not across key events") {
+        REQUIRE(util::get<KeyPressEvent>(bag[2]).key == +Key::shift);
+        REQUIRE(util::get<EncoderEvent>(bag[3]).steps == 1);
+      }
+    }
+  }
+
+  TEST_CASE ("LEDBuffer", "[controller]") {
+    LEDBuffer leds;
+
+    SECTION ("Only changes are marked") {
+      REQUIRE(leds.set(LED{Key::fx1}, LEDColor::Blue));
+      REQUIRE_FALSE(leds.set(LED{Key::fx1}, LEDColor::Blue));
+      REQUIRE(leds.get(Key::fx1) == LEDColor::Blue);
+      REQUIRE(leds.get(Key::fx2) == LEDColor::Black);
+      auto changed = leds.take_changed();
+      REQUIRE(changed == std::uint64_t(1) << Key(Key::fx1)._to_index());
+      REQUIRE(leds.take_changed() == 0);
+    }
+
+    SECTION ("Clearing marks the LEDs that were lit") {
+      leds.set(LED{Key::S3}, LEDColor::Red);
+      leds.take_changed();
+      leds.clear();
+      REQUIRE(leds.get(Key::S3) == LEDColor::Black);
+      REQUIRE(leds.take_changed() == std::uint64_t(1) << Key(Key::S3)._to_index());
+    }
+  }
+
+} // namespace otto::services
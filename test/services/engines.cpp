@@ -1,10 +0,0 @@
-#include "../testing.t.hpp"
-
-#include "services/engine_manager.hpp"
-#include "services/audio_manager.hpp"
-
-using namespace otto;
-
-TEST_CASE("Engines service", "[services]") {
-
-}
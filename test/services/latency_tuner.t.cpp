@@ -0,0 +1,40 @@
+#include "testing.t.hpp"
+
+#include "services/latency_tuner.hpp"
+
+namespace otto::services {
+
+  TEST_CASE ("LatencyTuner", "[services]") {
+    using Trial = LatencyTuner::Trial;
+    LatencyTuner::Settings settings;
+    settings.max_load = 0.75f;
+    settings.margin_steps = 1;
+
+    SECTION ("A size is stable without xruns, misses or lowered quality, and with headroom") {
+      REQUIRE(LatencyTuner::stable({256, 0, 0, 0.5f, 0}, settings));
+      REQUIRE_FALSE(LatencyTuner::stable({256, 1, 0, 0.5f, 0}, settings));
+      REQUIRE_FALSE(LatencyTuner::stable({256, 0, 1, 0.5f, 0}, settings));
+      REQUIRE_FALSE(LatencyTuner::stable({256, 0, 0, 0.8f, 0}, settings));
+      REQUIRE_FALSE(LatencyTuner::stable({256, 0, 0, 0.5f, 1}, settings));
+    }
+
+    SECTION ("The smallest stable size is raised by the margin") {
+      std::vector<Trial> trials = {{1024, 0, 0, 0.2f}, {512, 0, 0, 0.3f}, {256, 0, 0, 0.5f}, {128, 2, 1, 0.9f}};
+      REQUIRE(LatencyTuner::pick(trials, settings) == 512);
+      settings.margin_steps = 0;
+      REQUIRE(LatencyTuner::pick(trials, settings) == 256);
+    }
+
+    SECTION ("The margin stops at the largest size") {
+      settings.margin_steps = 3;
+      std::vector<Trial> trials = {{1024, 0, 0, 0.2f}, {512, 0, 0, 0.3f}, {256, 3, 0, 0.5f}};
+      REQUIRE(LatencyTuner::pick(trials, settings) == 1024);
+    }
+
+    SECTION ("If no size is stable, the largest is kept") {
+      std::vector<Trial> trials = {{1024, 4, 0, 0.2f}};
+      REQUIRE(LatencyTuner::pick(trials, settings) == 1024);
+    }
+  }
+
+} // namespace otto::services
@@ -0,0 +1,44 @@
+#include "testing.t.hpp"
+
+#include <cstring>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "services/metrics_server.hpp"
+
+namespace otto::services {
+
+  namespace {
+    /// Connect to the Unix socket at `path`, and read until it is closed
+    std::string scrape(const fs::path& path)
+    {
+      sockaddr_un addr = {};
+      addr.sun_family = AF_UNIX;
+      std::strcpy(addr.sun_path, path.c_str());
+      int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+      std::string res;
+      char buf[256];
+      for (ssize_t n; (n = ::read(fd, buf, sizeof(buf))) > 0;) res.append(buf, n);
+      ::close(fd);
+      return res;
+    }
+  } // namespace
+
+  TEST_CASE ("MetricsServer", "[services]") {
+    // Unix socket paths are limited to about 100 characters
+    auto path = fs::temp_directory_path() / "otto-metrics-test.sock";
+    int scrapes = 0;
+    {
+      MetricsServer server(path, [&] { return fmt::format("otto_scrapes_total {}\n", ++scrapes); });
+      REQUIRE(fs::exists(path));
+      REQUIRE(scrape(path) == "otto_scrapes_total 1\n");
+      REQUIRE(scrape(path) == "otto_scrapes_total 2\n");
+    }
+    REQUIRE(!fs::exists(path));
+  }
+
+} // namespace otto::services
@@ -0,0 +1,146 @@
+#include "testing.t.hpp"
+
+#include <chrono>
+#include <deque>
+
+#include "services/network_clock.hpp"
+
+namespace otto::services {
+
+  using Message = SyncSession::Message;
+  using Timeline = ClockManager::Timeline;
+
+  constexpr std::int64_t ms = 1'000'000;
+
+  /// Peers on a simulated network, with their own clocks, and a delay on the way
+  struct Network {
+    struct Peer {
+      SyncSession session;
+      /// The local clock minus the time of the network
+      std::int64_t clock;
+      bool online = true;
+    };
+
+    struct Packet {
+      std::int64_t arrival;
+      Message msg;
+    };
+
+    std::vector<Peer> peers;
+    std::deque<Packet> packets;
+    std::int64_t delay = 2 * ms;
+    std::int64_t time = 0;
+
+    SyncSession::Send sender(Peer& peer)
+    {
+      return [this, &peer](const Message& msg) {
+        if (peer.online) packets.push_back({time + delay, msg});
+      };
+    }
+
+    /// Run the network for `duration`, in steps of a millisecond
+    void run(std::int64_t duration)
+    {
+      for (auto end = time + duration; time < end; time += ms) {
+        while (!packets.empty() && packets.front().arrival <= time) {
+          auto msg = packets.front().msg;
+          packets.pop_front();
+          for (auto& p : peers) {
+            if (p.online) p.session.receive(msg, time + p.clock, sender(p));
+          }
+        }
+        for (auto& p : peers) {
+          if (p.online) p.session.poll(time + p.clock, sender(p));
+        }
+      }
+    }
+
+    /// The beat of `peer` now
+    double beat_of(Peer& peer)
+    {
+      return peer.session.timeline().beat_at(time + peer.clock);
+    }
+  };
+
+  TEST_CASE ("SyncSession", "[clock]") {
+    Network net;
+    net.peers.reserve(3);
+    net.peers.push_back({SyncSession(7, {120, 0, 0}), 0});
+    net.peers.push_back({SyncSession(3, {90, 50, 5000 * ms}), 5000 * ms});
+    net.peers.push_back({SyncSession(12, {100, 0, -3000 * ms}), -3000 * ms});
+    auto& leader = net.peers[1];
+    net.run(2000 * ms);
+
+    SECTION ("The peer with the lowest id leads, and the others follow it on their own clocks") {
+      for (auto& p : net.peers) REQUIRE(p.session.leader() == 3);
+      REQUIRE(leader.session.is_leader());
+      REQUIRE(leader.session.peer_count() == 2);
+      for (auto& p : net.peers) {
+        REQUIRE(p.session.timeline().bpm == 90);
+        REQUIRE(net.beat_of(p) == Approx(net.beat_of(leader)).margin(0.001));
+      }
+      REQUIRE(*net.peers[0].session.clock_offset() == 5000 * ms);
+    }
+
+    SECTION ("Any peer can change the tempo, and the beat carries on") {
+      double before = net.beat_of(leader);
+      net.peers[2].session.change(140, true, net.time + net.peers[2].clock, net.sender(net.peers[2]));
+      net.run(100 * ms);
+      for (auto& p : net.peers) {
+        REQUIRE(p.session.timeline().bpm == 140);
+        REQUIRE(net.beat_of(p) == Approx(net.beat_of(leader)).margin(0.001));
+      }
+      // At 90 bpm until the request reached the leader, 2 ms later, and at 140 from there
+      REQUIRE(net.beat_of(leader) == Approx(before + 0.002 * 1.5 + 0.098 * 140 / 60).margin(0.0001));
+    }
+
+    SECTION ("When the leader leaves, the next one carries on from the session") {
+      leader.online = false;
+      net.run(3000 * ms);
+      auto& next = net.peers[0];
+      REQUIRE(next.session.is_leader());
+      REQUIRE(net.peers[2].session.leader() == 7);
+      REQUIRE(next.session.timeline().bpm == 90);
+      REQUIRE(net.beat_of(next) == Approx(net.beat_of(leader)).margin(0.001));
+      REQUIRE(net.beat_of(net.peers[2]) == Approx(net.beat_of(leader)).margin(0.001));
+    }
+  }
+
+  TEST_CASE ("SyncSession::Message", "[clock]") {
+    Message msg{Message::Kind::pong, 1ull << 40, 3, {133.5, -2.25, -7, false}, 123456789, -1};
+    auto bytes = msg.encode();
+    auto decoded = Message::decode(bytes);
+    REQUIRE(decoded);
+    REQUIRE(decoded->kind == Message::Kind::pong);
+    REQUIRE(decoded->from == msg.from);
+    REQUIRE(decoded->to == 3);
+    REQUIRE(decoded->timeline.bpm == 133.5);
+    REQUIRE(decoded->timeline.beat == -2.25);
+    REQUIRE(decoded->timeline.time_ns == -7);
+    REQUIRE_FALSE(decoded->timeline.running);
+    REQUIRE(decoded->sent_ns == 123456789);
+    REQUIRE(decoded->reply_ns == -1);
+
+    REQUIRE_FALSE(Message::decode(gsl::span<const std::uint8_t>(bytes).subspan(0, 40)));
+    bytes[0] = 'X';
+    REQUIRE_FALSE(Message::decode(bytes));
+  }
+
+  TEST_CASE ("The clock follows the timeline of its sync client", "[clock]") {
+    auto clock = ClockManager::create_default();
+    auto client = clock->request_client(ClockManager::Source::sync);
+    REQUIRE(client);
+    client->start();
+    auto now = std::chrono::nanoseconds(std::chrono::steady_clock::now().time_since_epoch()).count();
+    client->set_timeline({90, 10, now});
+
+    clock->process(256, 48000);
+    REQUIRE(clock->bpm() == 90);
+    // More than a beat off, so it jumps
+    REQUIRE(clock->position() / ClockManager::ticks_per_beat == Approx(10).margin(0.01));
+    // And counts the ticks from there
+    while (clock->ticks().empty()) clock->process(256, 48000);
+    REQUIRE(clock->ticks()[0].count == 241);
+  }
+
+} // namespace otto::services
@@ -0,0 +1,103 @@
+#include "testing.t.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "core/props/property_table.hpp"
+#include "services/osc_server.hpp"
+
+namespace otto::services {
+
+  /// Builds OSC packets
+  struct OscWriter {
+    std::vector<std::uint8_t> bytes;
+
+    OscWriter& string(const std::string& str)
+    {
+      bytes.insert(bytes.end(), str.begin(), str.end());
+      bytes.resize(bytes.size() + 4 - str.size() % 4, 0);
+      return *this;
+    }
+
+    OscWriter& u32(std::uint32_t value)
+    {
+      for (int i = 3; i >= 0; i--) bytes.push_back(value >> (8 * i));
+      return *this;
+    }
+
+    OscWriter& f32(float value)
+    {
+      std::uint32_t bits;
+      std::memcpy(&bits, &value, 4);
+      return u32(bits);
+    }
+
+    OscWriter& message(const std::string& address, float value)
+    {
+      return string(address).string(",f").f32(value);
+    }
+
+    OscWriter& element(const OscWriter& content)
+    {
+      u32(content.bytes.size());
+      bytes.insert(bytes.end(), content.bytes.begin(), content.bytes.end());
+      return *this;
+    }
+  };
+
+  static std::vector<OscServer::Message> parse(const OscWriter& packet, bool expect_valid = true)
+  {
+    std::vector<OscServer::Message> res;
+    REQUIRE(OscServer::parse(packet.bytes, [&](const OscServer::Message& msg) { res.push_back(msg); }) ==
+            expect_valid);
+    return res;
+  }
+
+  TEST_CASE ("OscServer::parse", "[services]") {
+    SECTION ("Messages with numeric arguments") {
+      // The addresses point into the packet
+      auto packet = OscWriter().message("/Synth/envelope/attack", 0.5f);
+      auto msgs = parse(packet);
+      REQUIRE(msgs.size() == 1);
+      REQUIRE(msgs[0].address == "/Synth/envelope/attack");
+      REQUIRE(msgs[0].value == 0.5);
+
+      REQUIRE(parse(OscWriter().string("/a").string(",i").u32(-3))[0].value == -3);
+      REQUIRE(parse(OscWriter().string("/a").string(",T"))[0].value == 1);
+      REQUIRE(parse(OscWriter().string("/a").string(",s").string("text")).empty());
+    }
+
+    SECTION ("Bundles, also nested, are handled in order") {
+      OscWriter inner;
+      inner.string("#bundle").u32(0).u32(1).element(OscWriter().message("/b", 2));
+      OscWriter bundle;
+      bundle.string("#bundle").u32(0).u32(1).element(OscWriter().message("/a", 1)).element(inner);
+      auto msgs = parse(bundle);
+      REQUIRE(msgs.size() == 2);
+      REQUIRE(msgs[0].address == "/a");
+      REQUIRE(msgs[1].address == "/b");
+      REQUIRE(msgs[1].value == 2);
+    }
+
+    SECTION ("Malformed packets") {
+      parse(OscWriter().string("no-slash").string(",f").f32(1), false);
+      parse(OscWriter().string("/a").string(",f"), false);
+      OscWriter bundle;
+      bundle.string("#bundle").u32(0).u32(1).u32(400);
+      parse(bundle, false);
+    }
+  }
+
+  TEST_CASE ("OscServer::change_of", "[services]") {
+    core::engine::ParameterQueue queue{{"Synth", "Effect1"}};
+    auto change = OscServer::change_of(queue, {"/Effect1/filter/cutoff", 3});
+    REQUIRE(change);
+    REQUIRE(change->part == 1);
+    REQUIRE(change->hash == core::props::hash_path("props/filter/cutoff"));
+    REQUIRE(change->value == 3);
+    REQUIRE_FALSE(OscServer::change_of(queue, {"/Drums/level", 1}));
+    REQUIRE_FALSE(OscServer::change_of(queue, {"/Synth", 1}));
+  }
+
+} // namespace otto::services
@@ -0,0 +1,31 @@
+#include "testing.t.hpp"
+
+#include "services/log_manager.hpp"
+
+namespace otto::services::rt_log {
+
+  TEST_CASE ("Real-time logging", "[rt_log]") {
+    Record record;
+    while (pop(record)) {}
+
+    SECTION ("Records are formatted with their arguments") {
+      push({loguru::Verbosity_INFO, __FILE__, __LINE__, "{} {:.2f} {} {}", {Arg(-3), Arg(1.5f), Arg("voices"), Arg(true)}});
+      REQUIRE(pop(record));
+      REQUIRE(record.format_message() == "-3 1.50 voices true");
+      REQUIRE_FALSE(pop(record));
+    }
+
+    SECTION ("Records are dropped and counted when the queue is full") {
+      for (std::size_t i = 0; i < queue_size; i++) {
+        REQUIRE(push({loguru::Verbosity_INFO, __FILE__, __LINE__, "{}", {Arg(i)}}));
+      }
+      int dropped = dropped_count();
+      REQUIRE_FALSE(push({loguru::Verbosity_INFO, __FILE__, __LINE__, "dropped", {}}));
+      REQUIRE(dropped_count() == dropped + 1);
+      REQUIRE(pop(record));
+      REQUIRE(record.format_message() == "0");
+      while (pop(record)) {}
+    }
+  }
+
+} // namespace otto::services::rt_log
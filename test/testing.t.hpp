@@ -6,6 +6,7 @@
 #include <fstream>
 #include <random.hpp>
 
+#include "services/application.hpp"
 #include "services/log_manager.hpp"
 #include "util/algorithm.hpp"
 #include "util/filesystem.hpp"
@@ -24,6 +25,14 @@ namespace otto::test {
     fstream.close();
   }
 
+  /// A factory that makes no service, for an @ref services::Application with only the
+  /// services a test needs
+  template<typename Service>
+  typename services::ServiceStorage<Service>::Factory none()
+  {
+    return [] { return std::unique_ptr<Service>(); };
+  }
+
   struct measure {
     using TimeT = std::chrono::nanoseconds;
 
@@ -0,0 +1,54 @@
+#include "testing.t.hpp"
+
+#include <cstdint>
+
+#include "util/arena.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("Arena", "[util]") {
+    Arena arena{1024};
+
+    SECTION ("Allocations are contiguous and aligned") {
+      ArenaVector<float> a(10, 0.f, &arena);
+      ArenaVector<double> b(4, 0.0, &arena);
+      REQUIRE(arena.owns(a.data()));
+      REQUIRE(arena.owns(b.data()));
+      REQUIRE(reinterpret_cast<std::uintptr_t>(b.data()) % alignof(double) == 0);
+      REQUIRE(reinterpret_cast<char*>(b.data()) - reinterpret_cast<char*>(a.data()) < 64);
+      REQUIRE(arena.used() <= 10 * sizeof(float) + 4 * sizeof(double) + alignof(double));
+    }
+
+    SECTION ("Allocations that do not fit fall back to the heap") {
+      ArenaVector<float> a(200, 0.f, &arena);
+      ArenaVector<float> b(200, 0.f, &arena);
+      REQUIRE(arena.owns(a.data()));
+      REQUIRE_FALSE(arena.owns(b.data()));
+      REQUIRE(arena.overflow_bytes() == 200 * sizeof(float));
+    }
+
+    SECTION ("A default allocator uses the heap") {
+      ArenaVector<float> a(10, 0.f);
+      REQUIRE_FALSE(arena.owns(a.data()));
+    }
+  }
+
+  TEST_CASE ("BlockPool", "[util]") {
+    Arena arena{1024};
+    BlockPool pool{24, 4, &arena};
+    REQUIRE(pool.block_size() % alignof(std::max_align_t) == 0);
+
+    void* blocks[4];
+    for (auto& b : blocks) {
+      b = pool.allocate();
+      REQUIRE(b != nullptr);
+      REQUIRE(arena.owns(b));
+    }
+    REQUIRE(pool.allocate() == nullptr);
+    REQUIRE(pool.in_use() == 4);
+
+    pool.deallocate(blocks[2]);
+    REQUIRE(pool.allocate() == blocks[2]);
+  }
+
+} // namespace otto::util
@@ -0,0 +1,36 @@
+#include "testing.t.hpp"
+
+#include "util/async_file_writer.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("AsyncFileWriter", "[util]") {
+    fs::create_directories(test::dir);
+    auto path = test::dir / "async.bin";
+
+    SECTION ("The last write to a path wins") {
+      AsyncFileWriter writer;
+      for (int i = 0; i < 10; i++) writer.write(path, {{"i", i}}, JsonFile::Format::msgpack);
+      writer.flush();
+      JsonFile file(path, JsonFile::Format::msgpack);
+      file.read();
+      REQUIRE(file.data()["i"] == 9);
+    }
+
+    SECTION ("The destructor writes everything queued") {
+      auto other = test::dir / "async.json";
+      {
+        AsyncFileWriter writer;
+        writer.write(path, {{"a", 1}}, JsonFile::Format::msgpack);
+        writer.write(other, {{"b", 2}}, JsonFile::Format::json);
+      }
+      JsonFile a(path, JsonFile::Format::msgpack);
+      a.read();
+      REQUIRE(a.data()["a"] == 1);
+      JsonFile b(other);
+      b.read();
+      REQUIRE(b.data()["b"] == 2);
+    }
+  }
+
+} // namespace otto::util
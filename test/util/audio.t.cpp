@@ -0,0 +1,217 @@
+#include "testing.t.hpp"
+
+#include <limits>
+#include <vector>
+
+#include "util/audio.hpp"
+
+namespace otto::util::audio {
+
+  TEST_CASE ("interleave", "[util]") {
+    // Not a multiple of the vector width, to cover the scalar tail
+    const int nframes = 67;
+    std::vector<float> left(nframes);
+    std::vector<float> right(nframes);
+    for (int i = 0; i < nframes; i++) {
+      left[i] = i;
+      right[i] = -i;
+    }
+    std::vector<float> out(2 * nframes + 1, 42.f);
+    interleave(left.data(), right.data(), out.data(), nframes);
+    for (int i = 0; i < nframes; i++) {
+      REQUIRE(out[2 * i] == left[i]);
+      REQUIRE(out[2 * i + 1] == right[i]);
+    }
+    REQUIRE(out.back() == 42.f);
+  }
+
+  TEST_CASE ("Buffer kernels", "[util]") {
+    // Not a multiple of the vector width, to cover the scalar tail
+    const int n = 67;
+    std::vector<float> a(n), b(n), g(n), pan(n);
+    for (int i = 0; i < n; i++) {
+      a[i] = i - 30;
+      b[i] = 2 * i;
+      g[i] = 0.5f * (i % 4);
+      pan[i] = (i % 3) - 1;
+    }
+
+    SECTION ("gain") {
+      auto out = a;
+      gain(out.data(), g.data(), n);
+      for (int i = 0; i < n; i++) REQUIRE(out[i] == a[i] * g[i]);
+      gain(out.data(), 0.f, n);
+      for (float f : out) REQUIRE(f == 0.f);
+    }
+
+    SECTION ("multiply and mix") {
+      std::vector<float> out(n);
+      multiply(a.data(), g.data(), out.data(), n);
+      for (int i = 0; i < n; i++) REQUIRE(out[i] == a[i] * g[i]);
+      out = b;
+      mix(a.data(), 0.5f, out.data(), n);
+      for (int i = 0; i < n; i++) REQUIRE(out[i] == b[i] + a[i] * 0.5f);
+    }
+
+    SECTION ("sum") {
+      std::vector<float> out(n, 42.f);
+      const float* srcs[] = {a.data(), b.data(), a.data()};
+      sum(srcs, 3, out.data(), n);
+      for (int i = 0; i < n; i++) REQUIRE(out[i] == a[i] + b[i] + a[i]);
+      sum(srcs, 0, out.data(), n);
+      for (float f : out) REQUIRE(f == 0.f);
+    }
+
+    SECTION ("mix_pan in place") {
+      auto left = a;
+      std::vector<float> right(n);
+      mix_pan(left.data(), g.data(), pan.data(), left.data(), right.data(), n);
+      for (int i = 0; i < n; i++) {
+        REQUIRE(left[i] == a[i] * g[i] * (1 - pan[i]));
+        REQUIRE(right[i] == a[i] * g[i] * (1 + pan[i]));
+      }
+    }
+
+    SECTION ("multiply_sum") {
+      std::vector<float> out(n);
+      multiply_sum(a.data(), g.data(), b.data(), pan.data(), out.data(), n);
+      for (int i = 0; i < n; i++) REQUIRE(out[i] == a[i] * g[i] + b[i] * pan[i]);
+    }
+
+    SECTION ("mix_pan_sum in place") {
+      auto left = a;
+      std::vector<float> right(n);
+      mix_pan_sum(left.data(), g.data(), pan.data(), b.data(), g.data(), g.data(), left.data(), right.data(), n);
+      for (int i = 0; i < n; i++) {
+        REQUIRE(left[i] == a[i] * g[i] * (1 - pan[i]) + b[i] * g[i] * (1 - g[i]));
+        REQUIRE(right[i] == a[i] * g[i] * (1 + pan[i]) + b[i] * g[i] * (1 + g[i]));
+      }
+    }
+
+    SECTION ("mix_matrix") {
+      // Two buses from three sources, one of them silent
+      std::vector<float> bus0(n, 42.f), bus1(n, 42.f);
+      const float* srcs[] = {a.data(), nullptr, b.data()};
+      float* dsts[] = {bus0.data(), bus1.data()};
+      const float from[] = {1.f, 0.f, 0.5f, 0.5f, 0.f, 0.f};
+      const float to[] = {0.f, 0.f, 0.5f, 0.5f, 0.f, 0.f};
+      mix_matrix(srcs, 3, from, to, dsts, 2, n);
+      for (int i = 0; i < n; i++) {
+        float ga = 1.f + (0.f - 1.f) / n * float(i);
+        REQUIRE(bus0[i] == Approx(a[i] * ga));
+        REQUIRE(bus1[i] == 0.f);
+      }
+      // A constant gain is exact
+      const float flat[] = {0.f, 0.5f, 0.f, 0.f, 0.f, 2.f};
+      mix_matrix(srcs, 3, flat, flat, dsts, 2, n);
+      for (int i = 0; i < n; i++) {
+        REQUIRE(bus0[i] == 0.f);
+        REQUIRE(bus1[i] == a[i] * 0.5f + b[i] * 2.f);
+      }
+    }
+
+    SECTION ("peak and rms") {
+      REQUIRE(peak(a.data(), n) == 36.f);
+      std::vector<float> ones(n, -1.f);
+      REQUIRE(rms(ones.data(), n) == Approx(1.f));
+      REQUIRE(peak(a.data(), 0) == 0.f);
+      REQUIRE(rms(a.data(), 0) == 0.f);
+    }
+
+    SECTION ("deinterleave reverses interleave") {
+      std::vector<float> interleaved(2 * n);
+      interleave(a.data(), b.data(), interleaved.data(), n);
+      std::vector<float> left(n), right(n);
+      deinterleave(interleaved.data(), left.data(), right.data(), n);
+      REQUIRE(left == a);
+      REQUIRE(right == b);
+    }
+  }
+
+  TEST_CASE ("Kernel tables match the inline kernels", "[util]") {
+    // Not a multiple of either vector width, to cover the scalar tails
+    const int n = 67;
+    std::vector<float> a(n), g(n), pan(n);
+    for (int i = 0; i < n; i++) {
+      a[i] = 0.37f * (i - 30);
+      g[i] = 0.25f * (i % 5);
+      pan[i] = 0.5f * ((i % 5) - 2);
+    }
+    REQUIRE(!supported_kernels().empty());
+    REQUIRE(util::find(supported_kernels(), &kernels()) != supported_kernels().end());
+
+    for (auto* table : supported_kernels()) {
+      INFO("Kernels " << table->name);
+      auto expected = a;
+      auto actual = a;
+      gain(expected.data(), g.data(), n);
+      table->gain(actual.data(), g.data(), n);
+      REQUIRE(actual == expected);
+      gain(expected.data(), 0.3f, n);
+      table->scale(actual.data(), 0.3f, n);
+      REQUIRE(actual == expected);
+      multiply(a.data(), g.data(), expected.data(), n);
+      table->multiply(a.data(), g.data(), actual.data(), n);
+      REQUIRE(actual == expected);
+      add(a.data(), expected.data(), n);
+      table->add(a.data(), actual.data(), n);
+      REQUIRE(actual == expected);
+      mix(a.data(), 0.7f, expected.data(), n);
+      table->mix(a.data(), 0.7f, actual.data(), n);
+      REQUIRE(actual == expected);
+
+      std::vector<float> expected_right(n), actual_right(n);
+      mix_pan(a.data(), g.data(), pan.data(), expected.data(), expected_right.data(), n);
+      table->mix_pan(a.data(), g.data(), pan.data(), actual.data(), actual_right.data(), n);
+      REQUIRE(actual == expected);
+      REQUIRE(actual_right == expected_right);
+
+      multiply_sum(a.data(), g.data(), expected_right.data(), pan.data(), expected.data(), n);
+      table->multiply_sum(a.data(), g.data(), actual_right.data(), pan.data(), actual.data(), n);
+      REQUIRE(actual == expected);
+      mix_pan_sum(a.data(), g.data(), pan.data(), a.data(), pan.data(), g.data(), expected.data(),
+                  expected_right.data(), n);
+      table->mix_pan_sum(a.data(), g.data(), pan.data(), a.data(), pan.data(), g.data(), actual.data(),
+                         actual_right.data(), n);
+      REQUIRE(actual == expected);
+      REQUIRE(actual_right == expected_right);
+
+      const float* srcs[] = {a.data(), g.data(), pan.data()};
+      float* expected_buses[] = {expected.data(), expected_right.data()};
+      float* actual_buses[] = {actual.data(), actual_right.data()};
+      const float from[] = {0.2f, 1.f, 0.f, 0.f, 0.7f, -0.3f};
+      const float to[] = {0.9f, 1.f, 0.f, 0.f, 0.1f, 0.4f};
+      mix_matrix(srcs, 3, from, to, expected_buses, 2, n);
+      table->mix_matrix(srcs, 3, from, to, actual_buses, 2, n);
+      REQUIRE(actual == expected);
+      REQUIRE(actual_right == expected_right);
+
+      REQUIRE(table->peak(a.data(), n) == peak(a.data(), n));
+      REQUIRE(table->rms(a.data(), n) == Approx(rms(a.data(), n)));
+      REQUIRE(table->rms(a.data(), 0) == 0.f);
+    }
+  }
+
+  TEST_CASE ("count_denormals", "[util]") {
+    float smallest = std::numeric_limits<float>::min();
+    std::vector<float> data = {0.f, -0.f, 1.f, smallest, smallest / 2, -smallest / 4};
+    REQUIRE_FALSE(is_denormal(0.f));
+    REQUIRE_FALSE(is_denormal(smallest));
+    REQUIRE(is_denormal(smallest / 2));
+    REQUIRE(count_denormals(data.data(), data.size()) == 2);
+  }
+
+#if !OTTO_DEBUG_DENORMALS && (defined(__SSE__) || defined(__aarch64__))
+  TEST_CASE ("FlushDenormals", "[util]") {
+    // Volatile, so the divisions are done at runtime
+    volatile float smallest = std::numeric_limits<float>::min();
+    REQUIRE(is_denormal(smallest / 2));
+    {
+      FlushDenormals flush;
+      REQUIRE(smallest / 2 == 0.f);
+    }
+    REQUIRE(is_denormal(smallest / 2));
+  }
+#endif
+
+} // namespace otto::util::audio
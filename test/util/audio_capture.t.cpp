@@ -0,0 +1,71 @@
+#include "testing.t.hpp"
+
+#include <array>
+
+#include <AudioFile.h>
+
+#include "util/audio_capture.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("AudioCapture", "[util]") {
+    auto dir = test::dir / "captures";
+    constexpr int samplerate = 1000;
+    constexpr int nframes = 100;
+    // The left channel counts the frames, scaled to stay below 1. The right one is silent.
+    auto write_buffers = [](AudioCapture& capture, int from, int to) {
+      std::array<float, nframes> left;
+      for (int b = from; b < to; b++) {
+        for (int i = 0; i < nframes; i++) left[i] = (b * nframes + i) / 2000.f;
+        std::array<const float*, 2> channels = {left.data(), nullptr};
+        capture.write(channels, nframes);
+      }
+    };
+
+    SECTION ("A dump holds the last seconds, oldest first") {
+      AudioCapture capture("Rolling", dir, 2, samplerate, 0.5f);
+      write_buffers(capture, 0, 12);
+      auto path = capture.dump();
+      REQUIRE(!path.empty());
+      AudioFile<float> file;
+      REQUIRE(file.load(path.string()));
+      REQUIRE(file.getNumChannels() == 2);
+      REQUIRE(file.getNumSamplesPerChannel() == 500);
+      REQUIRE(file.samples[0][0] == Approx(700 / 2000.f).margin(1e-4));
+      REQUIRE(file.samples[0][499] == Approx(1199 / 2000.f).margin(1e-4));
+      REQUIRE(file.samples[1][250] == 0);
+      REQUIRE(capture.dropped() == 0);
+    }
+
+    SECTION ("A stream is written in chunks") {
+      {
+        AudioCapture capture("Stream", dir, 2, samplerate, 0.5f, AudioCapture::Mode::stream);
+        write_buffers(capture, 0, 12);
+      }
+      AudioFile<float> first, last;
+      REQUIRE(first.load((dir / "Stream-0.wav").string()));
+      REQUIRE(first.getNumSamplesPerChannel() == 500);
+      REQUIRE(first.samples[0][0] == Approx(0).margin(1e-4));
+      REQUIRE(last.load((dir / "Stream-2.wav").string()));
+      REQUIRE(last.getNumSamplesPerChannel() == 200);
+      REQUIRE(last.samples[0][0] == Approx(1000 / 2000.f).margin(1e-4));
+    }
+
+    SECTION ("A recording is written to one file") {
+      auto recordings = dir / "recordings";
+      fs::remove_all(recordings);
+      {
+        AudioCapture capture("Record", recordings, 2, samplerate, 1, AudioCapture::Mode::record);
+        write_buffers(capture, 0, 12);
+      }
+      auto files = fs::directory_iterator(recordings);
+      REQUIRE(files != fs::directory_iterator());
+      AudioFile<float> file;
+      REQUIRE(file.load(files->path().string()));
+      REQUIRE(file.getNumSamplesPerChannel() == 1200);
+      REQUIRE(file.samples[0][1199] == Approx(1199 / 2000.f).margin(1e-4));
+      fs::remove_all(recordings);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,45 @@
+#include "testing.t.hpp"
+
+#include <string>
+
+#include "util/cache.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("lru_cache", "[util]") {
+    lru_cache<std::string, int> cache{2};
+
+    SECTION ("Missing keys are not found") {
+      REQUIRE(cache.find("a") == nullptr);
+    }
+
+    SECTION ("Inserted values can be found") {
+      cache.insert("a", 1);
+      REQUIRE(cache.find("a") != nullptr);
+      REQUIRE(*cache.find("a") == 1);
+      cache.insert("a", 2);
+      REQUIRE(*cache.find("a") == 2);
+      REQUIRE(cache.size() == 1);
+    }
+
+    SECTION ("The least recently used entry is evicted") {
+      cache.insert("a", 1);
+      cache.insert("b", 2);
+      cache.find("a");
+      cache.insert("c", 3);
+      REQUIRE(cache.size() == 2);
+      REQUIRE(cache.find("b") == nullptr);
+      REQUIRE(*cache.find("a") == 1);
+      REQUIRE(*cache.find("c") == 3);
+    }
+
+    SECTION ("Erased entries are gone") {
+      cache.insert("a", 1);
+      cache.erase("a");
+      cache.erase("b");
+      REQUIRE(cache.find("a") == nullptr);
+      REQUIRE(cache.size() == 0);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,63 @@
+#include "testing.t.hpp"
+
+#include "util/cobs.hpp"
+
+namespace otto::util {
+
+  using Bytes = std::vector<std::uint8_t>;
+
+  Bytes encoded(const Bytes& frame)
+  {
+    Bytes out;
+    cobs::encode(frame, out);
+    return out;
+  }
+
+  std::vector<Bytes> decoded(const Bytes& stream, std::size_t chunk = 1)
+  {
+    std::vector<Bytes> res;
+    cobs::Decoder decoder;
+    for (std::size_t i = 0; i < stream.size(); i += chunk) {
+      auto n = std::min(chunk, stream.size() - i);
+      decoder.feed(gsl::span<const std::uint8_t>(stream.data() + i, n),
+                   [&](auto frame) { res.emplace_back(frame.begin(), frame.end()); });
+    }
+    return res;
+  }
+
+  TEST_CASE ("cobs", "[util]") {
+    SECTION ("Zeroes are replaced by the distance to the next one") {
+      REQUIRE(encoded({0x11, 0x22, 0x00, 0x33}) == Bytes{0x03, 0x11, 0x22, 0x02, 0x33, 0x00});
+      REQUIRE(encoded({0x00}) == Bytes{0x01, 0x01, 0x00});
+      REQUIRE(encoded({0x11, 0x00}) == Bytes{0x02, 0x11, 0x01, 0x00});
+    }
+
+    SECTION ("Runs of 254 bytes without zeroes get a block of their own") {
+      Bytes frame(254, 0x42);
+      auto out = encoded(frame);
+      REQUIRE(out.size() == 257);
+      REQUIRE(out.front() == 0xFF);
+      REQUIRE(out[255] == 0x01);
+      REQUIRE(decoded(out) == std::vector<Bytes>{frame});
+    }
+
+    SECTION ("Frames are decoded from a stream in any chunks") {
+      Bytes a = {0xEC, 0x40, 0x00, 0xFF, 0x00};
+      Bytes b = {0x20, 0x00};
+      Bytes stream = encoded(a);
+      auto eb = encoded(b);
+      stream.insert(stream.end(), eb.begin(), eb.end());
+      for (std::size_t chunk : {1, 3, 64}) {
+        REQUIRE(decoded(stream, chunk) == std::vector<Bytes>{a, b});
+      }
+    }
+
+    SECTION ("A partial frame is dropped at the next delimiter") {
+      Bytes stream = {0x05, 0x11, 0x00};
+      auto eb = encoded({0x20, 0x01});
+      stream.insert(stream.end(), eb.begin(), eb.end());
+      REQUIRE(decoded(stream) == std::vector<Bytes>{{0x20, 0x01}});
+    }
+  }
+
+} // namespace otto::util
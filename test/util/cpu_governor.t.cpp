@@ -0,0 +1,60 @@
+#include "testing.t.hpp"
+
+#include "util/cpu_governor.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("CpuGovernor", "[util]") {
+    CpuGovernor::Settings settings;
+    settings.window = 4;
+    settings.recover_windows = 2;
+    settings.max_level = 2;
+    CpuGovernor gov{settings};
+
+    auto add_window = [&](float load) {
+      bool changed = false;
+      for (int i = 0; i < settings.window; i++) changed |= gov.add(load);
+      return changed;
+    };
+
+    SECTION ("A moderate load keeps full quality") {
+      for (int i = 0; i < 10; i++) REQUIRE_FALSE(add_window(0.6));
+      REQUIRE(gov.level() == 0);
+    }
+
+    SECTION ("A window above the degrade load steps down a level") {
+      gov.add(0.1);
+      gov.add(0.9);
+      gov.add(0.1);
+      REQUIRE(gov.level() == 0);
+      REQUIRE(gov.add(0.1));
+      REQUIRE(gov.level() == 1);
+    }
+
+    SECTION ("A missed deadline steps down at once") {
+      REQUIRE(gov.add(1.2));
+      REQUIRE(gov.level() == 1);
+    }
+
+    SECTION ("The level stops at the cheapest level") {
+      for (int i = 0; i < 5; i++) gov.add(1.5);
+      REQUIRE(gov.level() == 2);
+    }
+
+    SECTION ("The level steps up only after enough quiet windows in a row") {
+      gov.add(1.5);
+      gov.add(1.5);
+      REQUIRE(gov.level() == 2);
+      REQUIRE_FALSE(add_window(0.2));
+      // A window between the thresholds restarts the count
+      REQUIRE_FALSE(add_window(0.6));
+      REQUIRE_FALSE(add_window(0.2));
+      REQUIRE(add_window(0.2));
+      REQUIRE(gov.level() == 1);
+      add_window(0.2);
+      add_window(0.2);
+      REQUIRE(gov.level() == 0);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,61 @@
+#include "testing.t.hpp"
+
+#include <thread>
+
+#include "util/cpu_meter.hpp"
+
+namespace otto::util {
+
+  using namespace std::chrono_literals;
+
+  TEST_CASE ("CpuMeter", "[util]") {
+    CpuMeter meter;
+
+    SECTION ("An empty window is all zeros") {
+      auto stats = meter.take();
+      REQUIRE(stats.count == 0);
+      REQUIRE(stats.min == 0);
+      REQUIRE(stats.max == 0);
+    }
+
+    SECTION ("Windows accumulate min, average and max") {
+      meter.add(10ns);
+      meter.add(30ns);
+      meter.add(20ns);
+      auto stats = meter.take();
+      REQUIRE(stats.count == 3);
+      REQUIRE(stats.min == 10);
+      REQUIRE(stats.avg == Approx(20));
+      REQUIRE(stats.max == 30);
+
+      meter.add(5ns);
+      stats = meter.take();
+      REQUIRE(stats.count == 1);
+      REQUIRE(stats.min == 5);
+      REQUIRE(stats.max == 5);
+      REQUIRE(stats.worst == 30);
+    }
+
+    SECTION ("Scopes measure their lifetime") {
+      {
+        auto timer = meter.measure();
+        std::this_thread::sleep_for(1ms);
+      }
+      REQUIRE(meter.take().min >= 1e6);
+    }
+
+    SECTION ("Measurements from another thread are all counted") {
+      std::atomic_bool done = false;
+      int taken = 0;
+      std::thread writer([&] {
+        for (int i = 0; i < 10000; i++) meter.add(1ns);
+        done = true;
+      });
+      while (!done) taken += meter.take().count;
+      writer.join();
+      taken += meter.take().count;
+      REQUIRE(taken == 10000);
+    }
+  }
+
+} // namespace otto::util
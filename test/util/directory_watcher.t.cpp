@@ -0,0 +1,67 @@
+#include "testing.t.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "util/directory_watcher.hpp"
+
+namespace otto::util {
+
+#ifdef __linux__
+  TEST_CASE ("DirectoryWatcher", "[util]") {
+    auto root = test::dir / "watched";
+    // Left over from a failed run
+    fs::remove_all(root);
+    fs::create_directories(root / "sub");
+
+    using Change = DirectoryWatcher::Change;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::pair<std::string, Change>> changes;
+    DirectoryWatcher watcher{root, [&](const fs::path& file, Change change) {
+                               std::unique_lock lock(mutex);
+                               changes.emplace_back(file.filename().string(), change);
+                               changed.notify_all();
+                             }};
+    REQUIRE(watcher.watching());
+
+    // Waits for a change, since the watcher thread reports them after the fact
+    auto wait_for = [&](std::size_t count) {
+      std::unique_lock lock(mutex);
+      return changed.wait_for(lock, std::chrono::seconds(2), [&] { return changes.size() >= count; });
+    };
+
+    SECTION ("Files written in subdirectories are reported once closed") {
+      std::ofstream(root / "sub" / "a.json") << "{}";
+      REQUIRE(wait_for(1));
+      REQUIRE(changes[0] == std::pair{std::string("a.json"), Change::modified});
+
+      fs::remove(root / "sub" / "a.json");
+      REQUIRE(wait_for(2));
+      REQUIRE(changes[1] == std::pair{std::string("a.json"), Change::removed});
+    }
+
+    SECTION ("Files in new directories are reported") {
+      fs::create_directories(root / "new");
+      std::ofstream(root / "new" / "b.json") << "{}";
+      REQUIRE(wait_for(1));
+      REQUIRE(changes.back().first == "b.json");
+      fs::remove(root / "new" / "b.json");
+      fs::remove(root / "new");
+    }
+
+    SECTION ("Files moved in are reported") {
+      std::ofstream(test::dir / "c.json") << "{}";
+      std::rename((test::dir / "c.json").c_str(), (root / "c.json").c_str());
+      REQUIRE(wait_for(1));
+      REQUIRE(changes[0] == std::pair{std::string("c.json"), Change::modified});
+      fs::remove(root / "c.json");
+    }
+
+    fs::remove_all(root);
+  }
+#endif
+
+} // namespace otto::util
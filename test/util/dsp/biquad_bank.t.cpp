@@ -0,0 +1,70 @@
+#include "testing.t.hpp"
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/biquad_bank.hpp"
+
+namespace otto::dsp {
+
+  /// The peak output of each channel for a sine of `freq` on all channels, after it settles
+  template<int N>
+  static std::array<float, N> gain_at(BiquadBank<N>& bank, float freq)
+  {
+    std::array<float, N> peak = {};
+    for (int i = 0; i < 44100; i++) {
+      typename BiquadBank<N>::Frame frame;
+      frame.fill(std::sin(2 * M_PI * freq * i / 44100));
+      bank(frame);
+      if (i < 22050) continue;
+      for (int c = 0; c < N; c++) peak[c] = std::max(peak[c], std::abs(frame[c]));
+    }
+    return peak;
+  }
+
+  TEST_CASE ("BiquadBank", "[dsp]") {
+    gam::sampleRate(44100);
+    using Coefs = BiquadCoefficients;
+
+    SECTION ("Channels pass their signal through by default") {
+      BiquadBank<3> bank;
+      BiquadBank<3>::Frame frame = {1, 2, 3};
+      bank(frame);
+      REQUIRE(frame == BiquadBank<3>::Frame{1, 2, 3});
+    }
+
+    SECTION ("Each channel uses its own coefficients") {
+      BiquadBank<3> bank;
+      bank.coefficients(0, Coefs::low_pass(1000));
+      bank.coefficients(1, Coefs::high_pass(1000));
+      bank.coefficients(2, Coefs::resonant(1000, 10));
+      auto low = gain_at(bank, 100);
+      REQUIRE(low[0] == Approx(1).margin(0.02));
+      REQUIRE(low[1] < 0.02);
+      REQUIRE(low[2] < 0.02);
+      bank.zero();
+      auto high = gain_at(bank, 10000);
+      REQUIRE(high[0] < 0.02);
+      REQUIRE(high[1] == Approx(1).margin(0.02));
+      REQUIRE(high[2] < 0.02);
+      bank.zero();
+      auto center = gain_at(bank, 1000);
+      REQUIRE(center[0] == Approx(M_SQRT1_2).margin(0.01));
+      REQUIRE(center[1] == Approx(M_SQRT1_2).margin(0.01));
+      REQUIRE(center[2] == Approx(1).margin(0.01));
+    }
+
+    SECTION ("zero clears the state of a single channel") {
+      BiquadBank<2> bank;
+      bank.coefficients(0, Coefs::low_pass(100));
+      bank.coefficients(1, Coefs::low_pass(100));
+      BiquadBank<2>::Frame frame = {1, 1};
+      bank(frame);
+      bank.zero(1);
+      frame = {0, 0};
+      bank(frame);
+      REQUIRE(frame[0] != 0);
+      REQUIRE(frame[1] == 0);
+    }
+  }
+
+} // namespace otto::dsp
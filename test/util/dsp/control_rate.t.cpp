@@ -0,0 +1,42 @@
+#include "testing.t.hpp"
+
+#include "util/dsp/control_rate.hpp"
+
+namespace otto::dsp {
+
+  TEST_CASE ("ControlRate", "[dsp]") {
+    ControlRate<4> kr;
+    int ticks = 0;
+    float target = 0;
+    auto tick = [&] {
+      ticks++;
+      return target;
+    };
+
+    SECTION ("The modulator is evaluated once per period, and ramped to linearly") {
+      kr.reset(0);
+      target = 4;
+      std::array<float, 8> out;
+      kr.process(out, tick);
+      REQUIRE(ticks == 2);
+      REQUIRE(out[0] == Approx(1));
+      REQUIRE(out[3] == Approx(4));
+      REQUIRE(out[7] == Approx(4));
+    }
+
+    SECTION ("reset jumps to a value") {
+      target = 2;
+      kr.reset(2);
+      REQUIRE(kr(tick) == Approx(2));
+      REQUIRE(kr.value() == Approx(2));
+    }
+  }
+
+  TEST_CASE ("ControlClock", "[dsp]") {
+    ControlClock<16> clock;
+    REQUIRE(clock.advance(10) == 0);
+    REQUIRE(clock.advance(10) == 1);
+    REQUIRE(clock.advance(44) == 3);
+  }
+
+} // namespace otto::dsp
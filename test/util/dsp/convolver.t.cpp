@@ -0,0 +1,77 @@
+#include "testing.t.hpp"
+
+#include <random>
+#include <vector>
+
+#include "util/dsp/convolver.hpp"
+
+namespace otto::dsp {
+
+  /// The convolution of `input` and `impulse`, of the length of `input`
+  static std::vector<float> direct_convolution(const std::vector<float>& input,
+                                               const std::vector<float>& impulse)
+  {
+    std::vector<float> res(input.size());
+    for (std::size_t n = 0; n < input.size(); n++) {
+      double sum = 0;
+      for (std::size_t k = 0; k < impulse.size() && k <= n; k++) sum += impulse[k] * input[n - k];
+      res[n] = sum;
+    }
+    return res;
+  }
+
+  TEST_CASE ("Convolver", "[dsp]") {
+    std::mt19937 rng{1234};
+    std::uniform_real_distribution<float> dist(-1, 1);
+    auto noise = [&](int n) {
+      std::vector<float> res(n);
+      for (auto& frm : res) frm = dist(rng);
+      return res;
+    };
+
+    SECTION ("The partitions grow along the impulse response, up to the largest") {
+      std::vector<float> impulse(20000);
+      Convolver conv(impulse, 16);
+      REQUIRE(conv.stage_blocks() == std::vector<int>{16, 64, 256});
+      REQUIRE(conv.latency() == 16);
+      REQUIRE(conv.length() == 20000);
+    }
+
+    SECTION ("A short impulse response only has a head") {
+      std::vector<float> impulse(40);
+      Convolver conv(impulse, 16);
+      REQUIRE(conv.stage_blocks() == std::vector<int>{16});
+    }
+
+    SECTION ("The output is the convolution of the input, late by the latency") {
+      // Long enough for all three stages, and not a whole number of partitions
+      auto impulse = noise(5000);
+      auto input = noise(8000);
+      Convolver conv(impulse, 16);
+      auto expected = direct_convolution(input, impulse);
+
+      // In place, in buffers that do not line up with the blocks
+      std::vector<float> output = input;
+      for (std::size_t i = 0; i < output.size(); i += 37) {
+        auto n = std::min<std::size_t>(37, output.size() - i);
+        conv.process({output.data() + i, n}, {output.data() + i, n});
+      }
+      for (std::size_t n = 0; n < output.size(); n++) {
+        float ref = n < 16 ? 0.f : expected[n - 16];
+        REQUIRE(output[n] == Approx(ref).margin(1e-3));
+      }
+    }
+
+    SECTION ("Reset drops the tail") {
+      std::vector<float> impulse(1000, 0.5f);
+      Convolver conv(impulse, 16);
+      std::vector<float> buffer(64, 1.f);
+      conv.process(buffer, buffer);
+      conv.reset();
+      std::vector<float> silence(512, 0.f);
+      conv.process(silence, silence);
+      for (float frm : silence) REQUIRE(frm == 0);
+    }
+  }
+
+} // namespace otto::dsp
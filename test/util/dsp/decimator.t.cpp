@@ -0,0 +1,59 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "util/dsp/decimator.hpp"
+
+namespace otto::dsp {
+
+  /// The gain of `dec` for a sine at `freq`, as a part of the input rate, from the RMS of the
+  /// last 200 output frames
+  static float gain_of(Decimator& dec, double freq)
+  {
+    const int frames = 512;
+    std::vector<float> in(frames * dec.factor());
+    std::vector<float> out(frames);
+    for (int i = 0; i < int(in.size()); i++) in[i] = std::sin(2 * M_PI * freq * i);
+    dec.process(in, out);
+    double sum = 0;
+    for (int i = frames - 200; i < frames; i++) sum += out[i] * out[i];
+    return std::sqrt(2 * sum / 200);
+  }
+
+  TEST_CASE ("Decimator", "[dsp]") {
+    Decimator dec;
+
+    SECTION ("A factor of 1 copies") {
+      std::vector<float> in = {1, 2, 3};
+      std::vector<float> out(3);
+      dec.process(in, out);
+      REQUIRE(out == in);
+    }
+
+    SECTION ("DC passes with unity gain") {
+      for (int factor : {2, 4}) {
+        dec.factor(factor);
+        std::vector<float> in(256 * factor, 1.f);
+        std::vector<float> out(256);
+        dec.process(in, out);
+        REQUIRE(out.back() == Approx(1).epsilon(0.001));
+      }
+    }
+
+    SECTION ("2x: the passband passes, and what would alias is attenuated") {
+      dec.factor(2);
+      REQUIRE(gain_of(dec, 0.1) == Approx(1).epsilon(0.01));
+      dec.reset();
+      REQUIRE(gain_of(dec, 0.35) < 0.001);
+    }
+
+    SECTION ("4x") {
+      dec.factor(4);
+      REQUIRE(gain_of(dec, 0.05) == Approx(1).epsilon(0.01));
+      dec.reset();
+      REQUIRE(gain_of(dec, 0.2) < 0.001);
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,62 @@
+#include "testing.t.hpp"
+
+#include "util/dsp/drum_voices.hpp"
+
+namespace otto::dsp {
+
+  TEST_CASE ("DrumVoices", "[dsp]") {
+    SampleArena arena;
+    std::vector<float> ramp(100);
+    for (int i = 0; i < 100; i++) ramp[i] = i;
+    std::vector<float> ones(1000, 1.f);
+    int ramp_region = arena.add(ramp, 44100);
+    int ones_region = arena.add(ones, 44100);
+
+    DrumVoices voices;
+    std::vector<float> out(256);
+
+    SECTION ("The arena keeps the samples back to back") {
+      REQUIRE(arena.region_count() == 2);
+      REQUIRE(arena.region(ones_region).offset == 100);
+      REQUIRE(arena.data(arena.region(ramp_region))[42] == 42);
+      REQUIRE(arena.data(arena.region(ones_region))[0] == 1);
+    }
+
+    SECTION ("A triggered sample plays to its end, and frees its voice") {
+      voices.trigger(arena, ramp_region, 3, 0.5);
+      REQUIRE(voices.playing(3));
+      voices.process(out, 44100);
+      for (int i = 0; i < 99; i++) {
+        CAPTURE(i);
+        REQUIRE(out[i] == 0.5f * i);
+      }
+      REQUIRE(out[150] == 0);
+      REQUIRE_FALSE(voices.playing(3));
+      REQUIRE(voices.playing() == 0);
+    }
+
+    SECTION ("Samples are resampled to the output rate") {
+      voices.trigger(arena, ramp_region, 0, 1);
+      voices.process(out, 88200);
+      REQUIRE(out[10] == Approx(5));
+    }
+
+    SECTION ("Voices mix") {
+      voices.trigger(arena, ones_region, 0, 1);
+      voices.trigger(arena, ones_region, 1, 1);
+      voices.process(out, 44100);
+      REQUIRE(out[10] == 2);
+    }
+
+    SECTION ("The oldest voice is stolen when all are playing") {
+      voices.trigger(arena, ones_region, 0, 1);
+      for (int i = 1; i < DrumVoices::voice_count; i++) voices.trigger(arena, ones_region, 1, 1);
+      REQUIRE(voices.playing() == DrumVoices::voice_count);
+      voices.trigger(arena, ones_region, 2, 1);
+      REQUIRE(voices.playing() == DrumVoices::voice_count);
+      REQUIRE_FALSE(voices.playing(0));
+      REQUIRE(voices.playing(2));
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,70 @@
+#include "testing.t.hpp"
+
+#include <vector>
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/ducker.hpp"
+
+namespace otto::dsp {
+
+  TEST_CASE ("Ducker", "[dsp]") {
+    gam::sampleRate(44100);
+    Ducker ducker;
+    ducker.threshold(-20);
+    ducker.ratio(2);
+    ducker.depth(24);
+    ducker.release(0.1);
+
+    const int n = 250;
+    std::vector<float> silence(n, 0.f);
+    std::vector<float> loud(n, 1.f);
+
+    SECTION ("A quiet key passes the signal") {
+      std::vector<float> signal(n, 0.5f);
+      ducker.process(silence, signal);
+      for (float f : signal) REQUIRE(f == 0.5f);
+      REQUIRE(ducker.gain_reduction() == Approx(0).margin(1e-6));
+    }
+
+    SECTION ("A loud key lowers the signal by the ratio, within one sub-block") {
+      std::vector<float> signal(n, 1.f);
+      ducker.process(loud, signal);
+      // 0 dB is 20 dB over the threshold, reduced by half of it
+      float expected = std::pow(10.f, -10.f / 20);
+      for (int i = Ducker::sub_block; i < n; i++) REQUIRE(signal[i] == Approx(expected));
+      // Ramped to over the first sub-block
+      for (int i = 1; i < Ducker::sub_block; i++) REQUIRE(signal[i] < signal[i - 1]);
+      REQUIRE(ducker.gain_reduction() == Approx(10));
+    }
+
+    SECTION ("The reduction is limited to the depth") {
+      ducker.depth(6);
+      std::vector<float> signal(n, 1.f);
+      ducker.process(loud, signal);
+      REQUIRE(signal.back() == Approx(std::pow(10.f, -6.f / 20)));
+    }
+
+    SECTION ("Both sides are ducked by the same gain") {
+      std::vector<float> left(n, 1.f);
+      std::vector<float> right(n, -0.5f);
+      ducker.process(loud, left, right);
+      for (int i = 0; i < n; i++) REQUIRE(right[i] == Approx(-0.5f * left[i]));
+      REQUIRE(left.back() == Approx(std::pow(10.f, -10.f / 20)));
+    }
+
+    SECTION ("The gain recovers after the key stops") {
+      std::vector<float> signal(n, 1.f);
+      ducker.process(loud, signal);
+      float ducked = signal.back();
+      // Half a second is five release times
+      for (int i = 0; i < 44100 / 2; i += n) {
+        signal.assign(n, 1.f);
+        ducker.process(silence, signal);
+      }
+      REQUIRE(signal.back() > ducked);
+      REQUIRE(signal.back() == Approx(1).margin(0.01));
+    }
+  }
+
+} // namespace otto::dsp
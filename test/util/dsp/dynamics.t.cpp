@@ -0,0 +1,88 @@
+#include "testing.t.hpp"
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/dynamics.hpp"
+
+namespace otto::dsp {
+
+  struct Stereo {
+    std::vector<float> left;
+    std::vector<float> right;
+  };
+
+  /// A sine of `amplitude` on the left, and the matching cosine on the right, so the mean
+  /// square level of the pair is constant
+  static Stereo quadrature(float amplitude, int length)
+  {
+    Stereo res = {std::vector<float>(length), std::vector<float>(length)};
+    for (int i = 0; i < length; i++) {
+      res.left[i] = amplitude * std::sin(2 * M_PI * 0.01 * i);
+      res.right[i] = amplitude * std::cos(2 * M_PI * 0.01 * i);
+    }
+    return res;
+  }
+
+  /// Process `in` in blocks of 256
+  static Stereo process(Dynamics& dyn, Stereo in)
+  {
+    for (int i = 0; i < in.left.size(); i += 256) {
+      int n = std::min<int>(256, in.left.size() - i);
+      dyn.process({in.left.data() + i, n}, {in.right.data() + i, n});
+    }
+    return in;
+  }
+
+  TEST_CASE ("Dynamics", "[dsp]") {
+    gam::sampleRate(44100);
+    Dynamics dyn;
+
+    SECTION ("Quiet signals are only delayed") {
+      auto in = quadrature(0.1, 4096);
+      auto out = process(dyn, in);
+      for (int i = Dynamics::lookahead; i < 4096; i++) {
+        CAPTURE(i);
+        REQUIRE(out.left[i] == Approx(in.left[i - Dynamics::lookahead]));
+        REQUIRE(out.right[i] == Approx(in.right[i - Dynamics::lookahead]));
+      }
+      REQUIRE(dyn.gain_reduction() == Approx(0).margin(1e-4));
+    }
+
+    SECTION ("Levels above the knee are compressed by the ratio") {
+      // The mean square level of a pair at full scale is -3dB, 3dB above the threshold, where
+      // a ratio of 4 reduces it by 2.25dB
+      process(dyn, quadrature(1, 44100));
+      REQUIRE(dyn.gain_reduction() == Approx(2.25).margin(0.05));
+    }
+
+    SECTION ("The output stays under full scale") {
+      auto out = process(dyn, quadrature(8, 44100));
+      for (int i = 0; i < 44100; i++) {
+        CAPTURE(i);
+        REQUIRE(std::abs(out.left[i]) <= 1.f);
+        REQUIRE(std::abs(out.right[i]) <= 1.f);
+      }
+    }
+
+    SECTION ("Peaks are limited before they arrive") {
+      Stereo in = {std::vector<float>(1024, 0.f), std::vector<float>(1024, 0.f)};
+      in.left[500] = 4;
+      auto out = process(dyn, in);
+      REQUIRE(out.left[500 + Dynamics::lookahead] <= 1.f);
+      REQUIRE(out.left[500 + Dynamics::lookahead] > 0.9f);
+      REQUIRE(dyn.gain_reduction() > 10);
+    }
+
+    SECTION ("The channels are linked") {
+      Stereo in = quadrature(4, 8192);
+      std::fill(in.right.begin(), in.right.end(), 0.1f);
+      auto out = process(dyn, in);
+      float gain = out.right[8000] / in.right[8000];
+      REQUIRE(gain < 0.5);
+      // The left channel is within the ceiling, so has the same gain
+      float left = out.left[8000] / in.left[8000 - Dynamics::lookahead];
+      REQUIRE(left == Approx(gain).epsilon(0.02));
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,74 @@
+#include "testing.t.hpp"
+
+#include <vector>
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/envelope.hpp"
+
+namespace otto::dsp {
+
+  TEST_CASE ("Envelope", "[dsp]") {
+    gam::sampleRate(1000);
+    Envelope env;
+    env.attack(0.01);
+    env.decay(0.02);
+    env.sustain(0.5);
+    env.release(0.04);
+
+    auto render = [&](int nframes) {
+      std::vector<float> res(nframes);
+      env.process(res);
+      return res;
+    };
+
+    SECTION ("An envelope starts out done, at 0") {
+      REQUIRE(env.done());
+      REQUIRE(render(4)[3] == 0);
+    }
+
+    SECTION ("The segments end on exactly the right frame, across blocks") {
+      env.trigger();
+      auto a = render(7);
+      auto b = render(3);
+      REQUIRE(a[6] < 1);
+      REQUIRE(b[2] == 1);
+      REQUIRE(env.stage() == Envelope::Stage::decay);
+      auto c = render(20);
+      REQUIRE(c[18] > 0.5);
+      REQUIRE(c[19] == 0.5);
+      REQUIRE(env.stage() == Envelope::Stage::sustain);
+      REQUIRE(render(100)[99] == 0.5);
+    }
+
+    SECTION ("The ramps rise and fall monotonically, fastest at the start") {
+      env.trigger();
+      auto a = render(10);
+      for (int i = 1; i < 10; i++) REQUIRE(a[i] > a[i - 1]);
+      REQUIRE(a[1] - a[0] > a[9] - a[8]);
+    }
+
+    SECTION ("The release starts from the current value, and ends done") {
+      env.trigger();
+      float at = render(5)[4];
+      env.release();
+      REQUIRE(env.released());
+      auto r = render(40);
+      REQUIRE(r[0] < at);
+      REQUIRE(r[39] == 0);
+      REQUIRE(env.done());
+    }
+
+    SECTION ("A retrigger starts the attack from the current value") {
+      env.trigger();
+      render(30);
+      env.release();
+      render(10);
+      float at = env.value();
+      env.trigger();
+      REQUIRE(env() > at);
+      REQUIRE(render(9)[8] == 1);
+    }
+  }
+
+} // namespace otto::dsp
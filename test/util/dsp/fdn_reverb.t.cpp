@@ -0,0 +1,106 @@
+#include "testing.t.hpp"
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/fdn_reverb.hpp"
+
+namespace otto::dsp {
+
+  /// The impulse response of `reverb`, processed in blocks of `block`
+  static std::vector<float> impulse_response(FDNReverb& reverb, int length, int block = 256)
+  {
+    std::vector<float> res(length, 0.f);
+    res[0] = 1;
+    for (int i = 0; i < length; i += block) {
+      int n = std::min(block, length - i);
+      reverb.process({res.data() + i, n}, {res.data() + i, n});
+    }
+    return res;
+  }
+
+  /// The energy of `samples` in `[from, to)`
+  static double energy(const std::vector<float>& samples, int from, int to)
+  {
+    double res = 0;
+    for (int i = from; i < to; i++) res += samples[i] * samples[i];
+    return res;
+  }
+
+  TEST_CASE ("FDNReverb", "[dsp]") {
+    gam::sampleRate(44100);
+    FDNReverb reverb;
+    reverb.decay(1);
+    reverb.damping(0);
+
+    SECTION ("The first echo comes after the shortest line") {
+      auto ir = impulse_response(reverb, 2000);
+      for (int i = 0; i < 1031; i++) {
+        CAPTURE(i);
+        REQUIRE(ir[i] == 0);
+      }
+      REQUIRE(ir[1031] != 0);
+    }
+
+    SECTION ("The response decays by 60dB over the decay time") {
+      auto ir = impulse_response(reverb, 3 * 44100);
+      double start = energy(ir, 4410, 8820);
+      double later = energy(ir, 4410 + 44100, 8820 + 44100);
+      REQUIRE(10 * std::log10(start / later) == Approx(60).margin(3));
+    }
+
+    SECTION ("The output does not depend on the block size") {
+      FDNReverb other;
+      other.decay(1);
+      other.damping(0);
+      auto a = impulse_response(reverb, 10000, 256);
+      auto b = impulse_response(other, 10000, 7);
+      REQUIRE(a == b);
+    }
+
+    SECTION ("Damping removes high frequencies") {
+      FDNReverb damped;
+      damped.decay(1);
+      damped.damping(0.5);
+      auto bright = impulse_response(reverb, 44100);
+      auto dark = impulse_response(damped, 44100);
+      // The difference between neighbouring samples grows with frequency
+      auto roughness = [](const std::vector<float>& ir) {
+        double res = 0;
+        for (int i = 10000; i < 20000; i++) res += std::abs(ir[i] - ir[i - 1]);
+        return res;
+      };
+      REQUIRE(roughness(dark) < 0.5 * roughness(bright));
+    }
+
+    SECTION ("zero clears the tail") {
+      impulse_response(reverb, 5000);
+      reverb.zero();
+      std::vector<float> silence(5000, 0.f);
+      reverb.process(silence, silence);
+      REQUIRE(energy(silence, 0, 5000) == 0);
+    }
+
+    SECTION ("A frozen tail neither decays nor takes input") {
+      reverb.damping(0.5);
+      impulse_response(reverb, 5000);
+      reverb.freeze(true);
+      std::vector<float> in(3 * 44100, 1.f);
+      std::vector<float> out(in.size());
+      reverb.process(in, out);
+      double start = energy(out, 0, 44100);
+      double later = energy(out, 2 * 44100, 3 * 44100);
+      REQUIRE(start > 0);
+      REQUIRE(later == Approx(start).epsilon(0.05));
+
+      FDNReverb held;
+      held.decay(1);
+      held.damping(0.5);
+      impulse_response(held, 5000);
+      held.freeze(true);
+      std::vector<float> silent_out(in.size());
+      held.process(std::vector<float>(in.size(), 0.f), silent_out);
+      REQUIRE(out == silent_out);
+    }
+  }
+
+} // namespace otto::dsp
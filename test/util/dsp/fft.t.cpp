@@ -0,0 +1,60 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "util/dsp/fft.hpp"
+
+namespace otto::dsp {
+
+  /// Check the transforms of `size` frames of noise
+  static void check_transforms(int size)
+  {
+    std::mt19937 rng{1234};
+    std::uniform_real_distribution<float> dist(-1, 1);
+    FFT fft(size);
+    REQUIRE(fft.bins() == size / 2 + 1);
+    std::vector<float> signal(size);
+    for (auto& frm : signal) frm = dist(rng);
+    std::vector<float> re(fft.bins());
+    std::vector<float> im(fft.bins());
+    fft.forward(signal, re, im);
+
+    // The spectrum is that of the discrete fourier transform
+    for (int k = 0; k < fft.bins(); k++) {
+      double dre = 0;
+      double dim = 0;
+      for (int n = 0; n < size; n++) {
+        dre += signal[n] * std::cos(2 * M_PI * k * n / size);
+        dim -= signal[n] * std::sin(2 * M_PI * k * n / size);
+      }
+      REQUIRE(re[k] == Approx(dre).margin(1e-4));
+      REQUIRE(im[k] == Approx(dim).margin(1e-4));
+    }
+
+    // The inverse transform gives back the signal, times the size
+    std::vector<float> back(size);
+    fft.inverse(re, im, back);
+    for (int n = 0; n < size; n++) {
+      REQUIRE(back[n] / size == Approx(signal[n]).margin(1e-5));
+    }
+  }
+
+  TEST_CASE ("FFT", "[dsp]") {
+    SECTION ("The smallest size") {
+      check_transforms(4);
+    }
+
+    SECTION ("Sizes where the butterflies are vectorised") {
+      check_transforms(16);
+      check_transforms(256);
+    }
+
+    SECTION ("Sizes that are not powers of two are rejected") {
+      REQUIRE_THROWS(FFT(12));
+      REQUIRE_THROWS(FFT(2));
+    }
+  }
+
+} // namespace otto::dsp
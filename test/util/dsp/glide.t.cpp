@@ -0,0 +1,73 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/glide.hpp"
+
+namespace otto::dsp {
+
+  TEST_CASE ("Glide", "[dsp]") {
+    gam::sampleRate(1000);
+    Glide glide;
+    glide.jump(100);
+
+    SECTION ("Without a time, the target is reached at once") {
+      glide.target(200);
+      REQUIRE(!glide.gliding());
+      REQUIRE(glide() == 200);
+    }
+
+    SECTION ("A glide reaches its target on exactly the right frame") {
+      glide.time(0.01);
+      glide.target(400);
+      for (int i = 0; i < 9; i++) glide();
+      REQUIRE(glide.gliding());
+      REQUIRE(glide() < 400);
+      REQUIRE(!glide.gliding());
+      REQUIRE(glide() == 400);
+    }
+
+    SECTION ("The glide is steady in octaves") {
+      glide.time(0.01);
+      glide.target(400);
+      REQUIRE(glide() == 100);
+      // Two octaves in 10 frames, a fifth of an octave per frame
+      REQUIRE(glide() == Approx(100 * std::exp2(0.2f)));
+      for (int i = 0; i < 3; i++) glide();
+      REQUIRE(glide() == Approx(200));
+    }
+
+    SECTION ("Advancing by a block matches advancing frame by frame") {
+      Glide frames;
+      frames.jump(100);
+      glide.time(0.5);
+      frames.time(0.5);
+      glide.target(50);
+      frames.target(50);
+      for (int block = 0; block < 20; block++) {
+        float first = frames();
+        for (int i = 1; i < 32; i++) frames();
+        REQUIRE(glide.advance(32) == Approx(first).epsilon(1e-6));
+      }
+      REQUIRE(glide.value() == Approx(frames.value()).epsilon(1e-6));
+      glide.advance(1000);
+      REQUIRE(!glide.gliding());
+      REQUIRE(glide.value() == 50);
+    }
+
+    SECTION ("A new target glides on from where the glide is") {
+      glide.time(0.01);
+      glide.target(400);
+      glide.advance(5);
+      float at = glide.value();
+      glide.target(100);
+      REQUIRE(glide() == at);
+      REQUIRE(glide() < at);
+      glide.advance(100);
+      REQUIRE(glide.value() == 100);
+    }
+  }
+
+} // namespace otto::dsp
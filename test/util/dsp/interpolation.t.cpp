@@ -0,0 +1,58 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "util/dsp/interpolation.hpp"
+
+namespace otto::dsp {
+
+  using I = Interpolation;
+
+  /// The largest error of `I` reading a sine of `period` samples between its samples
+  template<Interpolation Mode>
+  static float error_of(double period)
+  {
+    std::vector<float> sine(64);
+    for (int i = 0; i < 64; i++) sine[i] = std::sin(2 * M_PI * i / period);
+    float res = 0;
+    for (int i = 1; i < 60; i++) {
+      for (float frac : {0.1f, 0.25f, 0.5f, 0.8f}) {
+        float expected = std::sin(2 * M_PI * (i + frac) / period);
+        res = std::max(res, std::abs(interpolate<Mode>(sine.data() + i, frac) - expected));
+      }
+    }
+    return res;
+  }
+
+  TEST_CASE ("Interpolation", "[dsp]") {
+    std::vector<float> data = {3, 5, 7, 4};
+    const float* at = data.data() + 1;
+
+    SECTION ("All modes are exact on the samples") {
+      REQUIRE(interpolate<I::none>(at, 0) == 5);
+      REQUIRE(interpolate<I::linear>(at, 0) == 5);
+      REQUIRE(interpolate<I::cubic>(at, 0) == 5);
+      REQUIRE(interpolate<I::sinc>(at, 0) == Approx(5));
+      REQUIRE(interpolate<I::sinc>(at, 1) == Approx(7));
+    }
+
+    SECTION ("none holds the sample before the position, linear draws a line") {
+      REQUIRE(interpolate<I::none>(at, 0.75) == 5);
+      REQUIRE(interpolate<I::linear>(at, 0.25) == 5.5);
+    }
+
+    SECTION ("The four point modes follow a sine better than a line") {
+      float linear = error_of<I::linear>(16);
+      REQUIRE(error_of<I::cubic>(16) < linear / 2);
+      REQUIRE(error_of<I::sinc>(16) < linear);
+    }
+
+    SECTION ("dispatch_interpolation calls the function for the mode") {
+      for (auto mode : {I::none, I::linear, I::cubic, I::sinc}) {
+        REQUIRE(dispatch_interpolation(mode, [](auto ipl) { return ipl(); }) == mode);
+      }
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,164 @@
+#include "testing.t.hpp"
+
+#include "util/dsp/loop_tape.hpp"
+
+namespace otto::dsp {
+
+  using State = LoopTape::State;
+
+  /// Run `tape` for `length` frames of a constant input, and return the left output
+  static std::vector<float> run(LoopTape& tape, int length, float input = 0)
+  {
+    std::vector<float> in(length, input);
+    std::vector<float> left(length);
+    std::vector<float> right(length);
+    for (int i = 0; i < length; i += 64) {
+      int n = std::min(64, length - i);
+      tape.process({in.data() + i, n}, {in.data() + i, n}, {left.data() + i, n},
+                   {right.data() + i, n});
+    }
+    return left;
+  }
+
+  /// Record a loop of `length` frames counting up from 1
+  static void record_ramp(LoopTape& tape, int length)
+  {
+    tape.record();
+    std::vector<float> in(length);
+    std::vector<float> out(length);
+    for (int i = 0; i < length; i++) in[i] = i + 1;
+    for (int i = 0; i < length; i += 64) {
+      int n = std::min(64, length - i);
+      tape.process({in.data() + i, n}, {in.data() + i, n}, {out.data() + i, n}, {out.data() + i, n});
+    }
+    tape.record();
+  }
+
+  TEST_CASE ("LoopTape", "[dsp]") {
+    LoopTape tape{8192, false};
+
+    SECTION ("The recorded loop plays back from the start") {
+      record_ramp(tape, 1000);
+      auto out = run(tape, 2000);
+      REQUIRE(tape.state() == State::playing);
+      REQUIRE(tape.loop().size() == 1000);
+      for (int i = 0; i < 2000; i++) {
+        CAPTURE(i);
+        REQUIRE(out[i] == i % 1000 + 1);
+      }
+    }
+
+    SECTION ("Recording stops at the capacity") {
+      tape.record();
+      run(tape, 10000, 1);
+      REQUIRE(tape.state() == State::playing);
+      REQUIRE(tape.loop().size() == tape.capacity());
+    }
+
+    SECTION ("An overdub is added over a whole pass, and can be undone") {
+      record_ramp(tape, 1000);
+      run(tape, 200);
+      tape.record();
+      run(tape, 1000, 0.5);
+      tape.record();
+      auto out = run(tape, 1000);
+      for (int i = 0; i < 1000; i++) {
+        CAPTURE(i);
+        REQUIRE(out[i] == (i + 200) % 1000 + 1.5f);
+      }
+      REQUIRE(tape.can_undo());
+
+      tape.undo();
+      out = run(tape, 1000);
+      for (int i = 0; i < 1000; i++) {
+        CAPTURE(i);
+        REQUIRE(out[i] == (i + 200) % 1000 + 1);
+      }
+
+      // Undoing again is a redo
+      tape.undo();
+      out = run(tape, 1000);
+      REQUIRE(out[0] == 201.5f);
+    }
+
+    SECTION ("An overdub ended part way keeps what was recorded") {
+      record_ramp(tape, 4096);
+      tape.record();
+      run(tape, 1024, 0.5);
+      tape.record();
+      // The rest of the pass is copied before the loop comes round
+      auto out = run(tape, 4096);
+      REQUIRE(tape.can_undo());
+      for (int i = 0; i < 4096; i++) {
+        CAPTURE(i);
+        float expected = (i + 1024) % 4096 + 1;
+        if ((i + 1024) % 4096 < 1024) expected += 0.5f;
+        REQUIRE(out[i] == expected);
+      }
+    }
+
+    SECTION ("Undo cancels an overdub in progress") {
+      record_ramp(tape, 1000);
+      tape.record();
+      run(tape, 500, 0.5);
+      tape.undo();
+      run(tape, 500);
+      REQUIRE(tape.state() == State::playing);
+      REQUIRE_FALSE(tape.can_undo());
+      auto out = run(tape, 1000);
+      REQUIRE(out[0] == 1);
+    }
+
+    SECTION ("Stopping pauses the loop") {
+      record_ramp(tape, 1000);
+      run(tape, 100);
+      tape.play();
+      REQUIRE(run(tape, 500)[0] == 0);
+      tape.play();
+      REQUIRE(run(tape, 1)[0] == 101);
+    }
+
+    SECTION ("The summary follows the playing layer") {
+      record_ramp(tape, 2048);
+      REQUIRE(tape.summary_size() == 2048 / LoopTape::summary_bin);
+      for (int bin = 0; bin < tape.summary_size(); bin++) {
+        CAPTURE(bin);
+        REQUIRE(tape.summary(bin).min == bin * LoopTape::summary_bin + 1);
+        REQUIRE(tape.summary(bin).max == (bin + 1) * LoopTape::summary_bin);
+      }
+
+      // An overdub starting inside a bin covers the whole bin when the pass is done
+      run(tape, 100);
+      tape.record();
+      run(tape, 2048, 1000);
+      REQUIRE(tape.summary(0).min == 1001);
+      REQUIRE(tape.summary(0).max == LoopTape::summary_bin + 1000);
+    }
+
+    SECTION ("At another speed, the position follows the speed, and the loop goes on from there") {
+      record_ramp(tape, 8000);
+      tape.speed(2);
+      run(tape, 2048);
+      REQUIRE(tape.state() == State::playing);
+      REQUIRE(tape.position() == Approx(4096).margin(TimeStretch::tolerance + TimeStretch::hop));
+
+      tape.speed(1);
+      int pos = tape.position();
+      auto out = run(tape, 100);
+      for (int i = 0; i < 100; i++) {
+        CAPTURE(i);
+        REQUIRE(out[i] == (pos + i) % 8000 + 1);
+      }
+    }
+
+    SECTION ("Clear erases the loop") {
+      record_ramp(tape, 1000);
+      tape.clear();
+      auto out = run(tape, 100);
+      REQUIRE(tape.state() == State::empty);
+      REQUIRE(tape.loop().size() == 0);
+      REQUIRE(out[0] == 0);
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,117 @@
+#include "testing.t.hpp"
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/modulated_delay.hpp"
+
+namespace otto::dsp {
+
+  struct Stereo {
+    std::vector<float> left;
+    std::vector<float> right;
+  };
+
+  /// Process `in` in blocks of `block`, with a constant `depth`
+  static Stereo process(ModulatedDelay& delay, const std::vector<float>& in, float depth, int block)
+  {
+    Stereo res = {std::vector<float>(in.size()), std::vector<float>(in.size())};
+    std::vector<float> depths(in.size(), depth);
+    for (int i = 0; i < in.size(); i += block) {
+      int n = std::min<int>(block, in.size() - i);
+      delay.process({in.data() + i, n}, {depths.data() + i, n}, {res.left.data() + i, n},
+                    {res.right.data() + i, n});
+    }
+    return res;
+  }
+
+  static std::vector<float> noise(int length)
+  {
+    std::vector<float> res(length);
+    unsigned state = 1;
+    for (auto& x : res) {
+      state = state * 1664525 + 1013904223;
+      x = (state >> 8) / float(1 << 24) - 0.5f;
+    }
+    return res;
+  }
+
+  TEST_CASE ("ModulatedDelay", "[dsp]") {
+    gam::sampleRate(44100);
+
+    SECTION ("table_sine matches std::sin") {
+      for (float phase = -1; phase < 2; phase += 0.001) {
+        CAPTURE(phase);
+        REQUIRE(table_sine(phase) == Approx(std::sin(2 * M_PI * phase)).margin(1e-4));
+      }
+    }
+
+    SECTION ("Without modulation, each side is the dry signal plus a fixed delay") {
+      ModulatedDelay delay;
+      delay.delay(100 / 44100.f);
+      auto in = noise(2048);
+      auto out = process(delay, in, 0, 256);
+      for (int i = 0; i < 2048; i++) {
+        CAPTURE(i);
+        float delayed = i >= 100 ? in[i - 100] : 0.f;
+        REQUIRE(out.left[i] == Approx(in[i] + delayed).margin(1e-5));
+        REQUIRE(out.right[i] == Approx(in[i] + delayed).margin(1e-5));
+      }
+    }
+
+    SECTION ("The output doesn't depend on the block size") {
+      auto in = noise(4096);
+      for (float feedback : {0.f, 0.5f}) {
+        CAPTURE(feedback);
+        ModulatedDelay a;
+        ModulatedDelay b;
+        for (auto* d : {&a, &b}) {
+          d->taps(4);
+          d->freq(3);
+          d->feedback(feedback);
+        }
+        auto out_a = process(a, in, 0.002, 256);
+        auto out_b = process(b, in, 0.002, 37);
+        for (int i = 0; i < 4096; i++) {
+          CAPTURE(i);
+          REQUIRE(out_a.left[i] == Approx(out_b.left[i]).margin(1e-5));
+          REQUIRE(out_a.right[i] == Approx(out_b.right[i]).margin(1e-5));
+        }
+      }
+    }
+
+    SECTION ("The sides are modulated differently") {
+      ModulatedDelay delay;
+      auto in = noise(4096);
+      auto out = process(delay, in, 0.002, 256);
+      float diff = 0;
+      for (int i = 0; i < 4096; i++) diff += std::abs(out.left[i] - out.right[i]);
+      REQUIRE(diff > 10);
+    }
+
+    SECTION ("Feedback stays bounded") {
+      ModulatedDelay delay;
+      delay.feedback(0.9);
+      auto out = process(delay, noise(44100), 0.002, 256);
+      for (int i = 0; i < 44100; i++) {
+        CAPTURE(i);
+        REQUIRE(std::abs(out.left[i]) < 10);
+      }
+    }
+
+    SECTION ("A held line loops its contents, and passes the dry signal") {
+      ModulatedDelay delay;
+      delay.delay(100 / 44100.f);
+      auto in = noise(ModulatedDelay::buffer_size);
+      process(delay, in, 0, 256);
+      delay.hold(true);
+      auto dry = noise(2 * ModulatedDelay::buffer_size);
+      auto out = process(delay, dry, 0, 256);
+      for (int i = 0; i < 2 * ModulatedDelay::buffer_size; i++) {
+        CAPTURE(i);
+        float looped = in[(i - 100 + ModulatedDelay::buffer_size) % ModulatedDelay::buffer_size];
+        REQUIRE(out.left[i] == Approx(dry[i] + looped).margin(1e-5));
+      }
+    }
+  }
+
+} // namespace otto::dsp
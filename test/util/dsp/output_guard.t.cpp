@@ -0,0 +1,72 @@
+#include "testing.t.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/output_guard.hpp"
+
+namespace otto::dsp {
+
+  TEST_CASE ("OutputGuard", "[dsp]") {
+    gam::sampleRate(48000);
+    OutputGuard guard;
+    std::vector<float> left(48000);
+    std::vector<float> right(48000);
+    auto process = [&] {
+      for (int i = 0; i < int(left.size()); i += 256) {
+        int n = std::min<int>(256, left.size() - i);
+        guard.process({left.data() + i, n}, {right.data() + i, n});
+      }
+    };
+
+    SECTION ("A signal in range passes, but for its DC") {
+      for (int i = 0; i < int(left.size()); i++) {
+        left[i] = 0.5f * std::sin(2 * M_PI * 1000 * i / 48000.f);
+        right[i] = left[i] + 0.25f;
+      }
+      auto in = left;
+      process();
+      for (int i = 47000; i < 48000; i++) {
+        CAPTURE(i);
+        REQUIRE(left[i] == Approx(in[i]).margin(0.01));
+        REQUIRE(right[i] == Approx(in[i]).margin(0.01));
+      }
+      REQUIRE(guard.take_scrubbed() == 0);
+    }
+
+    SECTION ("NaNs and infinities are replaced with silence, and counted") {
+      left[100] = std::numeric_limits<float>::quiet_NaN();
+      right[200] = std::numeric_limits<float>::infinity();
+      right[300] = -std::numeric_limits<float>::infinity();
+      process();
+      for (int i = 0; i < int(left.size()); i++) {
+        CAPTURE(i);
+        REQUIRE(left[i] == 0.f);
+        REQUIRE(right[i] == 0.f);
+      }
+      REQUIRE(guard.take_scrubbed() == 3);
+      REQUIRE(guard.take_scrubbed() == 0);
+    }
+
+    SECTION ("The output never exceeds full scale") {
+      for (int i = 0; i < int(left.size()); i++) {
+        left[i] = 1e30f * std::sin(2 * M_PI * 100 * i / 48000.f);
+        right[i] = -4;
+      }
+      process();
+      for (int i = 0; i < int(left.size()); i++) {
+        CAPTURE(i);
+        REQUIRE(std::isfinite(left[i]));
+        REQUIRE(std::abs(left[i]) <= 1.f);
+        REQUIRE(std::abs(right[i]) <= 1.f);
+      }
+      REQUIRE(left[12] == 1.f);
+      REQUIRE(right[47999] == Approx(0).margin(1e-3));
+    }
+  }
+
+} // namespace otto::dsp
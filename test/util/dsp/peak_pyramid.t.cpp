@@ -0,0 +1,67 @@
+#include "testing.t.hpp"
+
+#include "util/dsp/peak_pyramid.hpp"
+
+namespace otto::dsp {
+
+  /// The peaks of `[first, last)` of `samples`, rounded out like the pyramid does
+  static PeakPyramid::Peak brute_force(const std::vector<float>& samples, int first, int last)
+  {
+    constexpr int b = PeakPyramid::base_block;
+    first = first / b * b;
+    last = std::min<int>((last + b - 1) / b * b, samples.size());
+    PeakPyramid::Peak res;
+    for (int i = first; i < last; i++) res += {samples[i], samples[i], std::abs(samples[i]), 1};
+    return res;
+  }
+
+  TEST_CASE ("PeakPyramid", "[dsp]") {
+    std::vector<float> samples(10007);
+    for (int i = 0; i < samples.size(); i++) samples[i] = std::sin(i * 0.37) * std::sin(i * 0.0011);
+
+    PeakPyramid pyramid;
+
+    SECTION ("Any range matches the samples") {
+      // Appended in uneven chunks
+      for (int i = 0; i < samples.size(); i += 333) {
+        pyramid.append({samples.data() + i, std::min<int>(333, samples.size() - i)});
+      }
+      REQUIRE(pyramid.size() == samples.size());
+      for (int first = 0; first < samples.size(); first += 97) {
+        for (int last = first + 1; last <= samples.size() + 50; last += 451) {
+          auto expected = brute_force(samples, first, last);
+          auto peak = pyramid.peak(first, last);
+          CAPTURE(first);
+          CAPTURE(last);
+          REQUIRE(peak.count == expected.count);
+          REQUIRE(peak.min == expected.min);
+          REQUIRE(peak.max == expected.max);
+          REQUIRE(peak.abs_sum == Approx(expected.abs_sum).epsilon(1e-4));
+        }
+      }
+    }
+
+    SECTION ("Appending sample by sample keeps the pyramid up to date") {
+      for (int i = 0; i < 1000; i++) {
+        pyramid.append({samples.data() + i, 1});
+        auto peak = pyramid.peak(0, i + 1);
+        auto expected = brute_force({samples.begin(), samples.begin() + i + 1}, 0, i + 1);
+        CAPTURE(i);
+        REQUIRE(peak.max == expected.max);
+        REQUIRE(peak.count == i + 1);
+      }
+    }
+
+    SECTION ("Clearing starts over") {
+      pyramid.append({samples.data(), 5000});
+      pyramid.clear();
+      REQUIRE(pyramid.size() == 0);
+      REQUIRE(pyramid.peak(0, 100).count == 0);
+      pyramid.append({samples.data() + 100, 100});
+      auto expected = brute_force(std::vector<float>(samples.begin() + 100, samples.begin() + 200), 0, 100);
+      REQUIRE(pyramid.peak(0, 100).max == expected.max);
+      REQUIRE(pyramid.peak(0, 100).count == 100);
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,75 @@
+#include "testing.t.hpp"
+
+#include "util/dsp/pitch_shift.hpp"
+
+namespace otto::dsp {
+
+  static std::vector<float> sine(float cycles_per_sample, int length)
+  {
+    std::vector<float> res(length);
+    for (int i = 0; i < length; i++) res[i] = std::sin(2 * M_PI * cycles_per_sample * i);
+    return res;
+  }
+
+  /// Process `input` in blocks of `block`
+  static std::vector<float> shift(GrainPitchShift& shifter, std::vector<float> input, int block = 256)
+  {
+    for (int i = 0; i < input.size(); i += block) {
+      int n = std::min<int>(block, input.size() - i);
+      shifter.process({input.data() + i, n}, {input.data() + i, n});
+    }
+    return input;
+  }
+
+  /// The power of `samples` at `cycles_per_sample`, from `from`
+  ///
+  /// Summed over segments of 800 samples, as the phase jumps between grains.
+  static double power_at(const std::vector<float>& samples, double cycles_per_sample, int from)
+  {
+    double res = 0;
+    for (int start = from; start + 800 <= samples.size(); start += 800) {
+      double re = 0, im = 0;
+      for (int i = start; i < start + 800; i++) {
+        re += samples[i] * std::cos(2 * M_PI * cycles_per_sample * i);
+        im += samples[i] * std::sin(2 * M_PI * cycles_per_sample * i);
+      }
+      res += re * re + im * im;
+    }
+    return res;
+  }
+
+  TEST_CASE ("GrainPitchShift", "[dsp]") {
+    GrainPitchShift shifter = {1024};
+
+    SECTION ("A ratio of one delays the input by half a grain") {
+      shifter.ratio(1);
+      auto in = sine(0.01, 4000);
+      auto out = shift(shifter, in);
+      for (int i = 512; i < 4000; i++) {
+        CAPTURE(i);
+        REQUIRE(out[i] == Approx(in[i - 512]).margin(1e-5));
+      }
+    }
+
+    SECTION ("The windows of the grains sum to one") {
+      std::vector<float> in(10000, 1.f);
+      auto out = shift(shifter, in);
+      for (int i = 1024; i < 10000; i++) {
+        CAPTURE(i);
+        REQUIRE(out[i] == Approx(1).margin(1e-3));
+      }
+    }
+
+    SECTION ("An octave up doubles the frequency") {
+      auto out = shift(shifter, sine(0.005, 44100));
+      REQUIRE(power_at(out, 0.01, 1024) > 10 * power_at(out, 0.005, 1024));
+    }
+
+    SECTION ("The output does not depend on the block size") {
+      GrainPitchShift other = {1024};
+      auto in = sine(0.003, 10000);
+      REQUIRE(shift(shifter, in, 256) == shift(other, in, 3000));
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,67 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "util/dsp/resampler.hpp"
+
+namespace otto::dsp {
+
+  /// A sine at `freq` Hz, `frames` long, at `samplerate`
+  static std::vector<float> sine(double freq, int samplerate, int frames)
+  {
+    std::vector<float> res(frames);
+    for (int i = 0; i < frames; i++) res[i] = std::sin(2 * M_PI * freq * i / samplerate);
+    return res;
+  }
+
+  /// The amplitude of `signal`, from the RMS of its middle, away from the edges
+  static float amplitude_of(const std::vector<float>& signal)
+  {
+    double sum = 0;
+    int first = signal.size() / 4;
+    int last = signal.size() * 3 / 4;
+    for (int i = first; i < last; i++) sum += signal[i] * signal[i];
+    return std::sqrt(2 * sum / (last - first));
+  }
+
+  TEST_CASE ("Resampler", "[dsp]") {
+    SECTION ("The same rate copies") {
+      std::vector<float> in = {1, 2, 3};
+      REQUIRE(Resampler::resample(in, 48000, 48000) == in);
+    }
+
+    SECTION ("The length follows the ratio") {
+      REQUIRE(Resampler::resample(std::vector<float>(44100), 44100, 48000).size() == 48000);
+      REQUIRE(Resampler::resample(std::vector<float>(96000), 96000, 48000).size() == 48000);
+    }
+
+    SECTION ("Upsampling keeps the frequency and amplitude of a sine") {
+      auto in = sine(1000, 44100, 4410);
+      auto out = Resampler::resample(in, 44100, 48000);
+      auto expected = sine(1000, 48000, out.size());
+      REQUIRE(amplitude_of(out) == Approx(1).epsilon(0.01));
+      for (int i = out.size() / 4; i < int(out.size() * 3 / 4); i++) {
+        REQUIRE(out[i] == Approx(expected[i]).margin(0.001));
+      }
+    }
+
+    SECTION ("Downsampling keeps the passband, and removes what would alias") {
+      REQUIRE(amplitude_of(Resampler::resample(sine(15000, 96000, 9600), 96000, 48000)) ==
+              Approx(1).epsilon(0.01));
+      // 30 kHz would alias to 18 kHz
+      REQUIRE(amplitude_of(Resampler::resample(sine(30000, 96000, 9600), 96000, 48000)) < 0.001);
+    }
+
+    SECTION ("Any part of a signal can be computed on its own") {
+      auto in = sine(440, 44100, 8000);
+      Resampler resampler(44100, 48000);
+      auto whole = Resampler::resample(in, 44100, 48000);
+      std::vector<float> part(100);
+      long first = 3000;
+      resampler.process(in, first * resampler.ratio(), part);
+      for (int i = 0; i < 100; i++) REQUIRE(part[i] == Approx(whole[first + i]).margin(1e-6));
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,80 @@
+#include "testing.t.hpp"
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/rotary_speaker.hpp"
+
+namespace otto::dsp {
+
+  struct RotaryOutput {
+    std::vector<float> left;
+    std::vector<float> right;
+  };
+
+  /// Process `in` in blocks of `block`
+  static RotaryOutput process(RotarySpeaker& speaker, const std::vector<float>& in, int block)
+  {
+    RotaryOutput res = {std::vector<float>(in.size()), std::vector<float>(in.size())};
+    for (int i = 0; i < in.size(); i += block) {
+      int n = std::min<int>(block, in.size() - i);
+      speaker.process({in.data() + i, n}, {res.left.data() + i, n}, {res.right.data() + i, n});
+    }
+    return res;
+  }
+
+  static std::vector<float> sine(int length, float freq)
+  {
+    std::vector<float> res(length);
+    for (int i = 0; i < length; i++) res[i] = std::sin(2 * M_PI * freq * i / 44100);
+    return res;
+  }
+
+  TEST_CASE ("RotarySpeaker", "[dsp]") {
+    gam::sampleRate(44100);
+
+    SECTION ("The output does not depend on the block size") {
+      auto in = sine(4410, 2000);
+      RotarySpeaker a;
+      RotarySpeaker b;
+      auto whole = process(a, in, 256);
+      auto small = process(b, in, 17);
+      for (int i = 0; i < in.size(); i++) {
+        REQUIRE(whole.left[i] == Approx(small.left[i]).margin(1e-4));
+        REQUIRE(whole.right[i] == Approx(small.right[i]).margin(1e-4));
+      }
+    }
+
+    SECTION ("The microphones hear the rotors differently") {
+      auto in = sine(44100, 2000);
+      RotarySpeaker speaker;
+      auto out = process(speaker, in, 256);
+      float diff = 0;
+      for (int i = 0; i < in.size(); i++) diff = std::max(diff, std::abs(out.left[i] - out.right[i]));
+      REQUIRE(diff > 0.1f);
+    }
+
+    SECTION ("Standing still with no depth, the speaker is flat") {
+      auto in = sine(8820, 300);
+      RotarySpeaker speaker;
+      speaker.depth(0);
+      auto out = process(speaker, in, 256);
+      float peak = 0;
+      for (int i = 4410; i < in.size(); i++) peak = std::max(peak, std::abs(out.left[i]));
+      REQUIRE(peak == Approx(1).margin(0.01));
+    }
+
+    SECTION ("The rotors speed up with inertia, the horn faster than the drum") {
+      std::vector<float> in(4410, 0.f);
+      RotarySpeaker speaker;
+      float slow = speaker.horn_speed();
+      speaker.fast(true);
+      process(speaker, in, 256);
+      float after = speaker.horn_speed();
+      REQUIRE(after > slow);
+      process(speaker, std::vector<float>(44100 * 3, 0.f), 256);
+      REQUIRE(speaker.horn_speed() > after);
+      REQUIRE(speaker.horn_speed() == Approx(6.7).margin(0.1));
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,121 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+
+#include "util/dsp/stereo_delay.hpp"
+
+namespace otto::dsp {
+
+  namespace {
+    struct Stereo {
+      std::vector<float> left;
+      std::vector<float> right;
+    };
+
+    /// Process `in` in blocks of `block`
+    Stereo process(StereoDelay& delay, const std::vector<float>& in, int block)
+    {
+      Stereo res = {std::vector<float>(in.size()), std::vector<float>(in.size())};
+      for (int i = 0; i < int(in.size()); i += block) {
+        int n = std::min<int>(block, in.size() - i);
+        delay.process({in.data() + i, n}, {res.left.data() + i, n}, {res.right.data() + i, n});
+      }
+      return res;
+    }
+
+    std::vector<float> impulse(int length)
+    {
+      std::vector<float> res(length);
+      res[0] = 1;
+      return res;
+    }
+  } // namespace
+
+  TEST_CASE ("StereoDelay", "[dsp]") {
+    SECTION ("The lines are allocated from the arena") {
+      util::Arena arena{StereoDelay::memory_size};
+      StereoDelay delay(&arena);
+      REQUIRE(arena.used() == StereoDelay::memory_size);
+      REQUIRE(arena.overflow_bytes() == 0);
+    }
+
+    SECTION ("Both sides echo the input") {
+      StereoDelay delay;
+      delay.delay(100);
+      delay.feedback(0.5);
+      auto out = process(delay, impulse(400), 256);
+      for (int i = 0; i < 400; i++) {
+        CAPTURE(i);
+        float expected = i == 100 ? 1.f : i == 200 ? 0.5f : i == 300 ? 0.25f : 0.f;
+        REQUIRE(out.left[i] == Approx(expected).margin(1e-6));
+        REQUIRE(out.right[i] == Approx(expected).margin(1e-6));
+      }
+    }
+
+    SECTION ("Ping-pong echoes alternate between the sides") {
+      StereoDelay delay;
+      delay.delay(100);
+      delay.feedback(0.5);
+      delay.ping_pong(true);
+      auto out = process(delay, impulse(400), 256);
+      REQUIRE(out.left[100] == Approx(1));
+      REQUIRE(out.right[100] == Approx(0).margin(1e-6));
+      REQUIRE(out.left[200] == Approx(0).margin(1e-6));
+      REQUIRE(out.right[200] == Approx(0.5));
+      REQUIRE(out.left[300] == Approx(0.25));
+      REQUIRE(out.right[300] == Approx(0).margin(1e-6));
+    }
+
+    SECTION ("A fractional delay interpolates between two frames") {
+      StereoDelay delay;
+      delay.delay(100.25);
+      auto out = process(delay, impulse(200), 64);
+      REQUIRE(out.left[100] == Approx(0.75));
+      REQUIRE(out.left[101] == Approx(0.25));
+    }
+
+    SECTION ("The output doesn't depend on the block size") {
+      std::vector<float> in(4096);
+      for (int i = 0; i < 4096; i++) in[i] = std::sin(i * 0.05f);
+      StereoDelay a;
+      StereoDelay b;
+      for (auto* d : {&a, &b}) {
+        d->delay(300.5);
+        d->feedback(0.7);
+        d->damping(0.3);
+        d->ping_pong(true);
+      }
+      auto out_a = process(a, in, 256);
+      auto out_b = process(b, in, 37);
+      REQUIRE(out_a.left == out_b.left);
+      REQUIRE(out_a.right == out_b.right);
+    }
+
+    SECTION ("Changing the delay crossfades, without a gap") {
+      StereoDelay delay;
+      delay.delay(100);
+      std::vector<float> ones(1000, 1.f);
+      process(delay, ones, 256);
+      delay.delay(500);
+      auto out = process(delay, std::vector<float>(StereoDelay::crossfade_frames / 2, 1.f), 256);
+      REQUIRE(delay.fading());
+      for (float f : out.left) REQUIRE(f == Approx(1));
+      process(delay, ones, 256);
+      REQUIRE(!delay.fading());
+      REQUIRE(delay.delay() == 500);
+    }
+
+    SECTION ("Reads wrap around the end of the lines") {
+      StereoDelay delay;
+      delay.delay(1000.5);
+      std::vector<float> in(StereoDelay::buffer_size + 3000);
+      for (int i = 0; i < int(in.size()); i++) in[i] = std::sin(i * 0.01f);
+      auto out = process(delay, in, 100);
+      for (int i = StereoDelay::buffer_size - 200; i < int(in.size()); i++) {
+        CAPTURE(i);
+        REQUIRE(out.left[i] == Approx(0.5f * (in[i - 1000] + in[i - 1001])).margin(1e-5));
+      }
+    }
+  }
+
+} // namespace otto::dsp
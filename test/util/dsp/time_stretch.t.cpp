@@ -0,0 +1,106 @@
+#include "testing.t.hpp"
+
+#include "util/dsp/time_stretch.hpp"
+
+namespace otto::dsp {
+
+  using Quality = TimeStretch::Quality;
+
+  static std::vector<float> sine(float cycles_per_sample, int length)
+  {
+    std::vector<float> res(length);
+    for (int i = 0; i < length; i++) res[i] = std::sin(2 * M_PI * cycles_per_sample * i);
+    return res;
+  }
+
+  /// Play `length` frames of the mono loop `loop` in blocks of `block`, and return the left output
+  static std::vector<float> play(TimeStretch& stretch,
+                                 const std::vector<float>& loop,
+                                 float speed,
+                                 int length,
+                                 int block = 256)
+  {
+    std::vector<float> left(length);
+    std::vector<float> right(length);
+    for (int i = 0; i < length; i += block) {
+      int n = std::min(block, length - i);
+      stretch.process(loop, loop, speed, {left.data() + i, n}, {right.data() + i, n});
+    }
+    return left;
+  }
+
+  /// The power of `samples` at `cycles_per_sample`, from `from`, summed over segments of 800
+  static double power_at(const std::vector<float>& samples, double cycles_per_sample, int from)
+  {
+    double res = 0;
+    for (int start = from; start + 800 <= samples.size(); start += 800) {
+      double re = 0, im = 0;
+      for (int i = start; i < start + 800; i++) {
+        re += samples[i] * std::cos(2 * M_PI * cycles_per_sample * i);
+        im += samples[i] * std::sin(2 * M_PI * cycles_per_sample * i);
+      }
+      res += re * re + im * im;
+    }
+    return res;
+  }
+
+  TEST_CASE ("TimeStretch", "[dsp]") {
+    TimeStretch stretch;
+    auto loop = sine(0.01, 48000);
+
+    SECTION ("At a speed of one, the loop plays as it is after half a grain") {
+      stretch.reset(1000);
+      auto out = play(stretch, loop, 1, 10000);
+      for (int i = TimeStretch::hop; i < 10000; i++) {
+        CAPTURE(i);
+        REQUIRE(out[i] == Approx(loop[1000 + i]).margin(1e-5));
+      }
+    }
+
+    SECTION ("The windows of the grains sum to one at any speed and quality") {
+      std::vector<float> ones(10000, 1.f);
+      for (auto quality : {Quality::full, Quality::coarse, Quality::overlap_add}) {
+        stretch.quality(quality);
+        stretch.reset(0);
+        auto out = play(stretch, ones, 1.5, 10000);
+        for (int i = TimeStretch::hop; i < 10000; i++) {
+          CAPTURE(i);
+          REQUIRE(out[i] == Approx(1).margin(1e-3));
+        }
+      }
+    }
+
+    SECTION ("The position moves at the speed, and wraps around the loop") {
+      stretch.reset(0);
+      play(stretch, loop, 2, 30000);
+      REQUIRE(stretch.position() == Approx(60000 - 48000).margin(TimeStretch::tolerance + TimeStretch::hop));
+    }
+
+    SECTION ("The pitch is kept at other speeds") {
+      for (float speed : {0.75f, 1.5f}) {
+        CAPTURE(speed);
+        stretch.reset(0);
+        auto out = play(stretch, loop, speed, 20000);
+        double at_pitch = power_at(out, 0.01, 2000);
+        REQUIRE(at_pitch > 20 * power_at(out, 0.01 * speed, 2000));
+        REQUIRE(at_pitch > 20 * power_at(out, 0.01 / speed, 2000));
+      }
+    }
+
+    SECTION ("Searching lines the grains up better than overlap-add") {
+      // Where the grains are out of phase, overlap-add partly cancels the sine
+      auto power = [&](Quality quality) {
+        stretch.quality(quality);
+        stretch.reset(0);
+        auto out = play(stretch, loop, 1.3, 20000);
+        return power_at(out, 0.01, 2000);
+      };
+      double full = power(Quality::full);
+      double coarse = power(Quality::coarse);
+      double ola = power(Quality::overlap_add);
+      REQUIRE(full > ola);
+      REQUIRE(coarse > ola);
+    }
+  }
+
+} // namespace otto::dsp
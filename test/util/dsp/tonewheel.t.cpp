@@ -0,0 +1,78 @@
+#include "testing.t.hpp"
+
+#include <Gamma/Domain.h>
+
+#include "util/dsp/tonewheel.hpp"
+
+namespace otto::dsp {
+
+  using Bank = TonewheelBank;
+
+  /// Render one second in blocks of 64, and count the upwards zero crossings of `wheel`
+  static int count_cycles(Bank& bank, int wheel, float detune = 1)
+  {
+    int cycles = 0;
+    float last = bank.frame(0)[wheel];
+    for (int block = 0; block < 44100 / 64; block++) {
+      bank.render(64, detune);
+      for (int f = 0; f < 64; f++) {
+        float value = bank.frame(f)[wheel];
+        if (last < 0 && value >= 0) cycles++;
+        last = value;
+      }
+    }
+    return cycles;
+  }
+
+  TEST_CASE ("TonewheelBank", "[dsp]") {
+    gam::sampleRate(44100);
+    Bank bank;
+    bank.reserve(64);
+
+    SECTION ("Wheels are a semitone apart") {
+      REQUIRE(Bank::wheel_frequency(0) == Approx(32.7032));
+      REQUIRE(Bank::wheel_frequency(12) == Approx(2 * 32.7032));
+      REQUIRE(Bank::wheel_frequency(57) == Approx(880).epsilon(1e-4));
+      for (int w = 0; w < Bank::wheels; w++) {
+        CAPTURE(w);
+        REQUIRE(Bank::wheel_for(Bank::wheel_frequency(w)) == w);
+        REQUIRE(Bank::wheel_for(Bank::wheel_frequency(w) * 1.02) == w);
+      }
+    }
+
+    SECTION ("Wheels outside the bank are folded back by octaves") {
+      REQUIRE(Bank::fold(5) == 5);
+      REQUIRE(Bank::fold(-1) == 11);
+      REQUIRE(Bank::fold(-13) == 11);
+      REQUIRE(Bank::fold(Bank::wheels) == Bank::wheels - 12);
+      REQUIRE(Bank::fold(Bank::wheels + 12) == Bank::wheels - 12);
+    }
+
+    SECTION ("Wheels play sines at their frequency") {
+      for (int w : {0, 33, 57, 90}) {
+        CAPTURE(w);
+        REQUIRE(count_cycles(bank, w) == Approx(Bank::wheel_frequency(w)).margin(2));
+      }
+    }
+
+    SECTION ("Detuning applies to all wheels") {
+      REQUIRE(count_cycles(bank, 33, 1.5) == Approx(Bank::wheel_frequency(33) * 1.5).margin(2));
+    }
+
+    SECTION ("The amplitude stays at one") {
+      for (int block = 0; block < 10000; block++) bank.render(64);
+      float peak = 0;
+      for (int block = 0; block < 10; block++) {
+        bank.render(64);
+        for (int f = 0; f < 64; f++) peak = std::max(peak, std::abs(bank.frame(f)[20]));
+      }
+      REQUIRE(peak == Approx(1).margin(1e-3));
+    }
+
+    SECTION ("Blocks larger than the reserved size are rendered") {
+      bank.render(512);
+      REQUIRE(std::abs(bank.frame(511)[10]) <= 1.001f);
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,226 @@
+#include "testing.t.hpp"
+
+#include <cmath>
+
+#include "util/dsp/wavetable.hpp"
+
+namespace otto::dsp {
+
+  using Table = MipMappedWavetable;
+
+  static float sine(int i, double cycles = 1)
+  {
+    return std::sin(2 * M_PI * cycles * i / Table::size);
+  }
+
+  TEST_CASE ("MipMappedWavetable", "[dsp]") {
+    SECTION ("A sine is the same in all levels") {
+      Table table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{1, 1}}))};
+      for (int level = 0; level < Table::levels; level++) {
+        for (int i = 0; i <= Table::size; i += 7) {
+          CAPTURE(level);
+          CAPTURE(i);
+          REQUIRE(table.level(level)[i] == Approx(sine(i)).margin(1e-5));
+        }
+      }
+    }
+
+    SECTION ("The levels are padded with the samples around their ends") {
+      Table table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{1, 1}, {3, 0.5}}))};
+      for (int level = 0; level < Table::levels; level++) {
+        auto* data = table.level(level);
+        REQUIRE(data[-1] == data[Table::size - 1]);
+        for (int i = 0; i < 3; i++) REQUIRE(data[Table::size + i] == data[i]);
+      }
+    }
+
+    SECTION ("Harmonics are removed from the levels where they would alias") {
+      Table table = {
+        std::make_shared<std::vector<float>>(Table::build_harmonics({{1, 1}, {600, 0.5, 0.25}}))};
+      for (int i = 0; i < Table::size; i += 7) {
+        CAPTURE(i);
+        // cos(x) = sin(x + pi/2)
+        float full = sine(i) + 0.5 * std::cos(2 * M_PI * 600 * i / Table::size);
+        REQUIRE(table.level(0)[i] == Approx(full).margin(1e-4));
+        REQUIRE(table.level(1)[i] == Approx(sine(i)).margin(1e-4));
+      }
+    }
+
+    SECTION ("Cycles of any length are resampled") {
+      std::vector<float> cycle(600);
+      for (int i = 0; i < 600; i++) cycle[i] = std::sin(2 * M_PI * i / 600);
+      Table table = {std::make_shared<std::vector<float>>(Table::build(cycle))};
+      for (int i = 0; i < Table::size; i += 7) {
+        CAPTURE(i);
+        REQUIRE(table.level(0)[i] == Approx(sine(i)).margin(1e-3));
+      }
+    }
+
+    SECTION ("The top level of a saw is its fundamental") {
+      std::vector<float> saw(Table::size);
+      for (int i = 0; i < Table::size; i++) saw[i] = 2.f * i / Table::size - 1;
+      Table table = {std::make_shared<std::vector<float>>(Table::build(saw))};
+      auto* top = table.level(Table::levels - 1);
+      for (int i = 0; i < Table::size; i += 7) {
+        CAPTURE(i);
+        // The fundamental of a rising saw is -2/pi sin(x), plus the small offset of the sampled saw
+        REQUIRE(top[i] == Approx(-2 / M_PI * sine(i)).margin(3e-3));
+      }
+    }
+
+    SECTION ("level_for picks the richest level that does not alias") {
+      REQUIRE(Table::level_for(0) == 0);
+      REQUIRE(Table::level_for(0.9 / Table::size) == 0);
+      REQUIRE(Table::level_for(-0.9 / Table::size) == 0);
+      REQUIRE(Table::level_for(0.5) == Table::levels - 1);
+      for (float inc : {0.001f, 0.01f, 0.1f, 0.3f}) {
+        CAPTURE(inc);
+        int level = Table::level_for(inc);
+        int top_harmonic = Table::size >> (level + 1);
+        REQUIRE(top_harmonic * inc <= 0.5);
+        REQUIRE(2 * top_harmonic * inc > 0.5);
+      }
+    }
+  }
+
+  TEST_CASE ("WavetableOsc", "[dsp]") {
+    WavetableOsc osc;
+
+    SECTION ("Plays silence without a table") {
+      osc.increment(0.01);
+      REQUIRE(osc() == 0);
+    }
+
+    SECTION ("Plays a table at the given increment") {
+      Table table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{1, 1}}))};
+      osc.table(table);
+      float inc = 0.01;
+      osc.increment(inc);
+      for (int i = 0; i < 1000; i++) {
+        CAPTURE(i);
+        REQUIRE(osc() == Approx(std::sin(2 * M_PI * inc * i)).margin(1e-4));
+      }
+    }
+
+    SECTION ("Plays a table with any interpolation, wrapping around the cycle") {
+      Table table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{1, 1}}))};
+      osc.table(table);
+      float inc = 0.0123;
+      osc.increment(inc);
+      for (auto mode : {Interpolation::linear, Interpolation::cubic, Interpolation::sinc}) {
+        CAPTURE(int(mode));
+        osc.interpolation(mode);
+        osc.phase(0);
+        std::vector<float> out(1000);
+        osc.process(out);
+        for (int i = 0; i < 1000; i++) {
+          CAPTURE(i);
+          REQUIRE(out[i] == Approx(std::sin(2 * M_PI * inc * i)).margin(2e-4));
+        }
+      }
+    }
+
+    SECTION ("Without interpolation, the sample before the position is played") {
+      Table table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{1, 1}}))};
+      osc.table(table);
+      osc.interpolation(Interpolation::none);
+      osc.increment(1.5 / Table::size);
+      osc();
+      REQUIRE(osc() == Approx(sine(1)).margin(1e-5));
+    }
+
+    SECTION ("An empty table plays silence") {
+      Table table;
+      osc.table(table);
+      osc.increment(0.01);
+      REQUIRE(osc() == 0);
+    }
+  }
+
+  TEST_CASE ("MorphWavetable", "[dsp]") {
+    Table sine_table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{1, 1}}))};
+    Table third_table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{3, 0.5}}))};
+
+    SECTION ("The frames are the steps of a crossfade, padded like the tables") {
+      auto morph = MorphWavetable::build(sine_table, third_table, 5);
+      REQUIRE(morph.frames() == 5);
+      for (int level = 0; level < Table::levels; level++) {
+        auto* data = morph.level(level);
+        for (int i = -1; i < Table::size + 3; i += 5) {
+          CAPTURE(level);
+          CAPTURE(i);
+          for (int k = 0; k < 5; k++) {
+            float expected = sine_table.level(level)[i] * (1 - k / 4.f) + third_table.level(level)[i] * k / 4.f;
+            REQUIRE(data[i * 5 + k] == Approx(expected).margin(1e-6));
+          }
+        }
+      }
+    }
+
+    SECTION ("An empty table is silence") {
+      auto morph = MorphWavetable::build(sine_table, Table());
+      REQUIRE(morph.frames() == 2);
+      for (int i = 0; i < Table::size; i += 7) {
+        REQUIRE(morph.level(0)[i * 2] == sine_table.level(0)[i]);
+        REQUIRE(morph.level(0)[i * 2 + 1] == 0);
+      }
+    }
+  }
+
+  TEST_CASE ("MorphWavetableOsc", "[dsp]") {
+    Table sine_table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{1, 1}}))};
+    Table third_table = {std::make_shared<std::vector<float>>(Table::build_harmonics({{3, 0.5}}))};
+    MorphWavetableOsc osc;
+    float inc = 0.0123;
+    osc.increment(inc);
+
+    SECTION ("Plays silence without a table") {
+      REQUIRE(osc() == 0);
+    }
+
+    SECTION ("Plays the crossfade of two oscillators at the morph position") {
+      for (int frames : {2, 3, 8}) {
+        auto morph = MorphWavetable::build(sine_table, third_table, frames);
+        osc.table(morph);
+        for (auto mode : {Interpolation::none, Interpolation::linear, Interpolation::cubic, Interpolation::sinc}) {
+          for (float position : {0.f, 0.3f, 0.5f, 1.f, -0.5f, 1.5f}) {
+            CAPTURE(frames);
+            CAPTURE(int(mode));
+            CAPTURE(position);
+            std::array<WavetableOsc, 2> ref;
+            ref[0].table(sine_table);
+            ref[1].table(third_table);
+            for (auto& r : ref) {
+              r.increment(inc);
+              r.interpolation(mode);
+            }
+            osc.interpolation(mode);
+            osc.phase(0);
+            osc.morph(position, 0.5f);
+            for (int i = 0; i < 500; i++) {
+              float expected = 0.5f * ((1 - position) * ref[0]() + position * ref[1]());
+              REQUIRE(osc() == Approx(expected).margin(1e-5));
+            }
+          }
+        }
+      }
+    }
+
+    SECTION ("The morph is ramped to") {
+      auto morph = MorphWavetable::build(sine_table, third_table, 4);
+      osc.table(morph);
+      osc.interpolation(Interpolation::linear);
+      osc.morph(1, 1, 16);
+      WavetableOsc ref;
+      ref.table(third_table);
+      ref.increment(inc);
+      std::vector<float> out(100);
+      osc.process(out);
+      for (int i = 16; i < 100; i++) {
+        ref.phase(inc * i);
+        REQUIRE(out[i] == Approx(ref()).margin(1e-5));
+      }
+    }
+  }
+
+} // namespace otto::dsp
@@ -0,0 +1,54 @@
+#include "testing.t.hpp"
+
+#include <vector>
+
+#include "util/event.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("Event", "[util]") {
+    Event<int> event;
+    std::vector<int> calls;
+
+    SECTION ("Handlers run by priority, then in the order they were subscribed") {
+      event.subscribe([&](int x) { calls.push_back(x); });
+      event.subscribe([&](int x) { calls.push_back(10 * x); });
+      event.subscribe([&](int x) { calls.push_back(100 * x); }, 1);
+      event.fire(1);
+      REQUIRE(calls == std::vector<int>{100, 1, 10});
+    }
+
+    SECTION ("Handlers can be unsubscribed") {
+      auto a = event.subscribe([&](int x) { calls.push_back(x); });
+      event.subscribe([&](int x) { calls.push_back(10 * x); });
+      event.unsubscribe(a);
+      event.unsubscribe(a);
+      event.fire(1);
+      REQUIRE(calls == std::vector<int>{10});
+      REQUIRE(event.size() == 1);
+    }
+
+    SECTION ("Changes made by handlers take effect from the next fire") {
+      Subscription self;
+      self = event.subscribe([&](int x) {
+        calls.push_back(x);
+        event.unsubscribe(self);
+        event.subscribe([&](int x) { calls.push_back(10 * x); });
+      });
+      event.fire(1);
+      REQUIRE(calls == std::vector<int>{1});
+      event.fire(2);
+      REQUIRE(calls == std::vector<int>{1, 20});
+    }
+
+    SECTION ("Deferred fires run when dispatched") {
+      event.subscribe([&](int x) { calls.push_back(x); });
+      event.fire_deferred(1);
+      event.fire_deferred(2);
+      REQUIRE(calls.empty());
+      REQUIRE(dispatch_deferred_events() == 2);
+      REQUIRE(calls == std::vector<int>{1, 2});
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,42 @@
+#include "testing.t.hpp"
+
+#include "util/filesystem.hpp"
+
+namespace otto::filesystem {
+
+  TEST_CASE ("filesystem::remove_all", "[util]") {
+    auto root = test::dir / "remove_all";
+    auto outside = test::dir / "remove_all_target";
+    fs::create_directories(root / "a" / "b");
+    fs::create_directories(outside);
+    std::ofstream(root / "f") << "f";
+    std::ofstream(root / "a" / "f") << "f";
+    std::ofstream(root / "a" / "b" / "f") << "f";
+    std::ofstream(outside / "kept") << "kept";
+
+    SECTION ("Nested directories are removed with their contents") {
+      std::error_code ec;
+      REQUIRE(fs::remove_all(root, ec) == 6);
+      REQUIRE_FALSE(ec);
+      REQUIRE_FALSE(fs::exists(root));
+    }
+
+    SECTION ("Symlinks are removed, but not followed") {
+      fs::create_directory_symlink(outside, root / "a" / "link");
+      fs::create_symlink(outside / "kept", root / "file_link");
+      fs::remove_all(root);
+      REQUIRE_FALSE(fs::exists(root));
+      REQUIRE(fs::exists(outside / "kept"));
+    }
+
+    SECTION ("A path that does not exist removes nothing") {
+      std::error_code ec;
+      REQUIRE(fs::remove_all(root / "missing", ec) == 0);
+      REQUIRE_FALSE(ec);
+    }
+
+    fs::remove_all(root);
+    fs::remove_all(outside);
+  }
+
+} // namespace otto::filesystem
@@ -0,0 +1,61 @@
+#include "testing.t.hpp"
+
+#include "util/frame_scheduler.hpp"
+
+namespace otto::util {
+
+  using namespace std::chrono_literals;
+
+  TEST_CASE ("FrameScheduler", "[util]") {
+    FrameScheduler scheduler;
+    auto t0 = FrameScheduler::clock::now();
+    auto period = FrameScheduler::duration(10ms);
+
+    auto deadline = scheduler.advance(t0, period);
+    REQUIRE(deadline == t0 + 10ms);
+
+    SECTION ("Deadlines do not drift with the time spent in a frame") {
+      deadline = scheduler.advance(t0 + 13ms, period);
+      REQUIRE(deadline == t0 + 20ms);
+      deadline = scheduler.advance(t0 + 22ms, period);
+      REQUIRE(deadline == t0 + 30ms);
+      REQUIRE(scheduler.skipped() == 0);
+      REQUIRE(scheduler.frame_times().total() == 2);
+    }
+
+    SECTION ("Late frames are skipped") {
+      deadline = scheduler.advance(t0 + 35ms, period);
+      REQUIRE(deadline == t0 + 40ms);
+      REQUIRE(scheduler.skipped() == 2);
+      deadline = scheduler.advance(t0 + 41ms, period);
+      REQUIRE(deadline == t0 + 50ms);
+      REQUIRE(scheduler.skipped() == 2);
+    }
+
+    SECTION ("Records the frame times") {
+      for (int i = 1; i <= 100; i++) {
+        scheduler.advance(t0 + i * 10ms + (i % 10 == 0 ? 8ms : 2ms), period);
+      }
+      auto& times = scheduler.frame_times();
+      REQUIRE(times.total() == 100);
+      REQUIRE(times.quantile(0.5) == Approx(0.0025));
+      REQUIRE(times.quantile(0.99) == Approx(0.0085));
+    }
+
+    SECTION ("reset starts a new grid") {
+      scheduler.reset();
+      deadline = scheduler.advance(t0 + 100ms, period);
+      REQUIRE(deadline == t0 + 110ms);
+      REQUIRE(scheduler.skipped() == 0);
+    }
+
+    SECTION ("wait sleeps until the deadline") {
+      scheduler.reset();
+      auto start = FrameScheduler::clock::now();
+      scheduler.wait(period);
+      scheduler.wait(period);
+      REQUIRE(FrameScheduler::clock::now() - start >= 10ms);
+    }
+  }
+
+} // namespace otto::util
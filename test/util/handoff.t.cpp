@@ -0,0 +1,82 @@
+#include "testing.t.hpp"
+
+#include <thread>
+
+#include "util/handoff.hpp"
+
+namespace otto::util {
+
+  /// Counts the live instances
+  struct Counted {
+    Counted(int value) : value(value)
+    {
+      count++;
+    }
+    ~Counted()
+    {
+      count--;
+    }
+    int value;
+    static inline std::atomic_int count = 0;
+  };
+
+  TEST_CASE ("Handoff", "[util]") {
+    SECTION ("Nothing is acquired before publishing") {
+      Handoff<Counted> handoff;
+      REQUIRE(handoff.acquire() == nullptr);
+    }
+
+    SECTION ("The latest published value is acquired") {
+      {
+        Handoff<Counted> handoff;
+        handoff.publish(std::make_unique<Counted>(1));
+        handoff.publish(std::make_unique<Counted>(2));
+        // The first one was never acquired, so it is deleted right away
+        REQUIRE(Counted::count == 1);
+        REQUIRE(handoff.acquire()->value == 2);
+        REQUIRE(handoff.get()->value == 2);
+        REQUIRE(handoff.acquire()->value == 2);
+      }
+      REQUIRE(Counted::count == 0);
+    }
+
+    SECTION ("Replaced values are deleted by the producer") {
+      {
+        Handoff<Counted> handoff;
+        handoff.publish(std::make_unique<Counted>(1));
+        handoff.acquire();
+        handoff.publish(std::make_unique<Counted>(2));
+        handoff.acquire();
+        REQUIRE(Counted::count == 2);
+        handoff.collect();
+        REQUIRE(Counted::count == 1);
+        REQUIRE(handoff.get()->value == 2);
+      }
+      REQUIRE(Counted::count == 0);
+    }
+
+    SECTION ("Values increase monotonically across threads") {
+      {
+        Handoff<Counted> handoff;
+        std::atomic_bool done = false;
+        std::atomic_int last = 0;
+        bool monotonic = true;
+        std::thread consumer([&] {
+          while (!done) {
+            if (auto* c = handoff.acquire()) {
+              monotonic = monotonic && c->value >= last;
+              last = c->value;
+            }
+          }
+        });
+        for (int i = 1; i <= 10000; i++) handoff.publish(std::make_unique<Counted>(i));
+        while (last != 10000) std::this_thread::yield();
+        done = true;
+        consumer.join();
+        REQUIRE(monotonic);
+      }
+      REQUIRE(Counted::count == 0);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,45 @@
+#include "testing.t.hpp"
+
+#include "util/histogram.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("Histogram", "[util]") {
+    Histogram<10> hist{0, 1};
+
+    SECTION ("Values are counted in linear buckets") {
+      hist.add(0.05);
+      hist.add(0.55);
+      hist.add(0.59);
+      auto counts = hist.counts();
+      REQUIRE(counts[0] == 1);
+      REQUIRE(counts[5] == 2);
+      REQUIRE(hist.total() == 3);
+    }
+
+    SECTION ("Values out of range go in the outermost buckets") {
+      hist.add(-3);
+      hist.add(1);
+      hist.add(42);
+      REQUIRE(hist.counts()[0] == 1);
+      REQUIRE(hist.counts()[9] == 2);
+    }
+
+    SECTION ("Quantiles are the upper bound of their bucket") {
+      REQUIRE(hist.quantile(0.5) == 0);
+      for (int i = 0; i < 98; i++) hist.add(0.15);
+      hist.add(0.65);
+      hist.add(0.95);
+      REQUIRE(hist.quantile(0.5) == Approx(0.2));
+      REQUIRE(hist.quantile(0.99) == Approx(0.7));
+      REQUIRE(hist.quantile(1) == Approx(1));
+    }
+
+    SECTION ("clear") {
+      hist.add(0.5);
+      hist.clear();
+      REQUIRE(hist.total() == 0);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,102 @@
+#include "testing.t.hpp"
+
+#include "core/props/props.hpp"
+#include "util/jsonfile.hpp"
+
+namespace otto::util {
+
+  namespace {
+    struct Channel {
+      core::props::Property<int> length = 16;
+      core::props::Property<float> level = 0.5;
+      std::vector<int> notes;
+
+      DECL_REFLECTION(Channel, length, level, notes);
+    };
+
+    struct State {
+      core::props::Property<bool> active = false;
+      std::string name;
+      std::array<Channel, 2> channels;
+
+      DECL_REFLECTION(State, active, name, channels);
+    };
+  } // namespace
+
+  TEST_CASE ("JsonReader", "[util]") {
+    State state;
+    state.channels[1].length = 3;
+    state.channels[1].notes = {40, 43};
+
+    auto json = nlohmann::json{
+      {"active", true},
+      {"name", "OTTO"},
+      {"channels", {{{"length", 8}, {"level", 0.25}, {"notes", {1, 2}}}, {{"length", 3}, {"level", 1}, {"notes", {40, 43}}}}},
+    };
+
+    for (auto format : {JsonFile::Format::json, JsonFile::Format::msgpack}) {
+      CAPTURE(int(format));
+      State read;
+      JsonFile::decode_into(JsonTarget::of(read), JsonFile::encode(json, format), format);
+      REQUIRE(read.active.get() == true);
+      REQUIRE(read.name == "OTTO");
+      REQUIRE(read.channels[0].length.get() == 8);
+      REQUIRE(read.channels[0].level.get() == 0.25f);
+      REQUIRE(read.channels[0].notes == std::vector{1, 2});
+      REQUIRE(read.channels[1].notes == std::vector{40, 43});
+    }
+
+    SECTION ("Reads the same as util::deserialize") {
+      State read;
+      auto serialized = util::serialize(state);
+      JsonFile::decode_into(JsonTarget::of(read), JsonFile::encode(serialized, JsonFile::Format::json),
+                            JsonFile::Format::json);
+      REQUIRE(util::serialize(read) == serialized);
+    }
+
+    SECTION ("Skips unknown members and extra elements, and leaves missing members") {
+      State read;
+      read.name = "kept";
+      auto j = nlohmann::json{
+        {"unknown", {{"deeply", {1, {{"nested", true}}}}}},
+        {"channels", {{{"length", 4}}, nullptr, {{"length", 5}}}},
+        {"active", true},
+      };
+      JsonFile::decode_into(JsonTarget::of(read), JsonFile::encode(j, JsonFile::Format::json),
+                            JsonFile::Format::json);
+      REQUIRE(read.name == "kept");
+      REQUIRE(read.active.get() == true);
+      REQUIRE(read.channels[0].length.get() == 4);
+      REQUIRE(read.channels[1].length.get() == 16);
+    }
+
+    SECTION ("Reads a json value as a whole") {
+      nlohmann::json read;
+      JsonFile::decode_into(JsonTarget::of(read), JsonFile::encode(json, JsonFile::Format::msgpack),
+                            JsonFile::Format::msgpack);
+      REQUIRE(read == json);
+    }
+
+    SECTION ("Reading files") {
+      fs::create_directories(test::dir);
+      JsonFile file(test::dir / "state.bin", JsonFile::Format::msgpack);
+      file.data() = json;
+      file.write();
+
+      JsonFile reader(test::dir / "state.bin", JsonFile::Format::msgpack);
+      State read;
+      reader.read_into(JsonTarget::of(read));
+      REQUIRE(read.name == "OTTO");
+      REQUIRE(reader.data().is_null());
+    }
+
+    SECTION ("Invalid data throws") {
+      std::string text = R"({ "name": "OTTO", "channels": [)";
+      State read;
+      REQUIRE_THROWS_AS(JsonFile::decode_into(JsonTarget::of(read), {text.begin(), text.end()},
+                                              JsonFile::Format::json),
+                        JsonFile::exception);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,53 @@
+#include "testing.t.hpp"
+
+#include "util/jsonfile.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("JsonFile", "[util]") {
+    fs::create_directories(test::dir);
+    nlohmann::json data = {{"name", "OTTO.FM"}, {"voices", 6}, {"props", {{"level", 0.5}}}};
+
+    for (auto format : {JsonFile::Format::json, JsonFile::Format::msgpack}) {
+      CAPTURE(int(format));
+      auto path = test::dir / (format == JsonFile::Format::json ? "file.json" : "file.bin");
+      {
+        JsonFile file(path, format);
+        file.data() = data;
+        file.write();
+      }
+      JsonFile file(path, format);
+      file.read();
+      REQUIRE(file.data() == data);
+    }
+
+    SECTION ("MessagePack is smaller than json") {
+      JsonFile json(test::dir / "file.json");
+      JsonFile msgpack(test::dir / "file.bin", JsonFile::Format::msgpack);
+      json.data() = msgpack.data() = data;
+      json.write();
+      msgpack.write();
+      REQUIRE(fs::file_size(msgpack.path()) < fs::file_size(json.path()));
+    }
+
+    SECTION ("Writing replaces the file, and leaves no temporary file") {
+      JsonFile file(test::dir / "file.bin", JsonFile::Format::msgpack);
+      file.data() = {{"a", 1}};
+      file.write();
+      file.write_encoded(JsonFile::encode({{"a", 2}}, JsonFile::Format::msgpack));
+      file.read();
+      REQUIRE(file.data()["a"] == 2);
+      REQUIRE_FALSE(fs::exists(test::dir / "file.bin.tmp"));
+    }
+
+    SECTION ("Reading invalid data throws") {
+      {
+        std::ofstream stream((test::dir / "invalid.json").c_str());
+        stream << "{ \"a\": ";
+      }
+      JsonFile file(test::dir / "invalid.json");
+      REQUIRE_THROWS_AS(file.read(), JsonFile::exception);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,106 @@
+#include "testing.t.hpp"
+
+#include <vector>
+
+#include "util/math.hpp"
+
+namespace otto::util::math {
+
+  /// The largest error of `approx` from `exact`, over `steps` points from `from` to `to`
+  ///
+  /// Relative to the exact value when `relative`, which is computed in double precision from
+  /// the same float input.
+  template<typename Approx, typename Exact>
+  static double max_error(Approx&& approx, Exact&& exact, double from, double to, bool relative, int steps = 1000000)
+  {
+    double res = 0;
+    for (int i = 0; i <= steps; i++) {
+      float x = from + (to - from) * i / steps;
+      double e = exact(double(x));
+      double err = std::abs(approx(x) - e);
+      res = std::max(res, relative ? err / std::abs(e) : err);
+    }
+    return res;
+  }
+
+  TEST_CASE ("fast math", "[util]") {
+    SECTION ("exp2") {
+      auto f = [](float x) { return fast::exp2(x); };
+      auto exact = [](double x) { return std::exp2(x); };
+      REQUIRE(max_error(f, exact, -126, 126, true) < 3e-7);
+      REQUIRE(fast::exp2(1000) == Approx(std::exp2(126.f)));
+      REQUIRE(fast::exp2(-1000) == Approx(std::exp2(-126.f)));
+      REQUIRE(fast::exp2(0) == Approx(1).epsilon(1e-7));
+    }
+
+    SECTION ("log2") {
+      auto f = [](float x) { return fast::log2(x); };
+      auto exact = [](double x) { return std::log2(x); };
+      REQUIRE(max_error(f, exact, 0.5, 2, false) < 4e-7);
+      REQUIRE(max_error(f, exact, 2, 1e6, true) < 4e-7);
+      REQUIRE(max_error(f, exact, 1e-30, 0.5, true) < 4e-7);
+    }
+
+    SECTION ("pow") {
+      for (float y : {-3.f, -0.5f, 0.3f, 2.f, 3.f}) {
+        CAPTURE(y);
+        auto f = [&](float x) { return fast::pow(x, y); };
+        auto exact = [&](double x) { return std::pow(x, double(y)); };
+        REQUIRE(max_error(f, exact, 0.01, 100, true, 100000) < 4e-6);
+      }
+    }
+
+    SECTION ("tanh") {
+      auto f = [](float x) { return fast::tanh(x); };
+      auto exact = [](double x) { return std::tanh(x); };
+      REQUIRE(max_error(f, exact, -20, 20, false) < 3e-7);
+      REQUIRE(fast::tanh(1000) == 1);
+      REQUIRE(fast::tanh(-1000) == -1);
+    }
+
+    SECTION ("sin and cos") {
+      auto s = [](float x) { return fast::sin(x); };
+      auto c = [](float x) { return fast::cos(x); };
+      REQUIRE(max_error(s, [](double x) { return std::sin(x); }, -100, 100, false, 4000000) < 5e-7);
+      REQUIRE(max_error(c, [](double x) { return std::cos(x); }, -100, 100, false, 4000000) < 5e-7);
+    }
+
+    SECTION ("Decibels") {
+      auto to_gain = [](float x) { return fast::db_to_gain(x); };
+      REQUIRE(max_error(to_gain, [](double db) { return std::pow(10, db / 20); }, -120, 24, true) < 1e-6);
+      auto to_db = [](float x) { return fast::gain_to_db(x); };
+      REQUIRE(max_error(to_db, [](double g) { return 20 * std::log10(g); }, 0.5, 2, false) < 3e-6);
+    }
+
+    SECTION ("The buffer versions agree with the scalar ones") {
+      // Not a multiple of the vector width, to cover the scalar tail
+      const int n = 1003;
+      std::vector<float> in(n);
+      std::vector<float> positive(n);
+      for (int i = 0; i < n; i++) {
+        in[i] = (i - 500) * 0.0731f;
+        positive[i] = std::exp2((i - 500) * 0.05f);
+      }
+      std::vector<float> out(n);
+
+      auto check = [&](auto&& batch, auto&& scalar, const std::vector<float>& src, float tolerance) {
+        batch(src.data(), out.data(), n);
+        for (int i = 0; i < n; i++) {
+          CAPTURE(src[i]);
+          REQUIRE(out[i] == Approx(scalar(src[i])).margin(tolerance).epsilon(1e-6));
+        }
+      };
+      check([](auto... a) { fast::exp2(a...); }, [](float x) { return fast::exp2(x); }, in, 0);
+      check([](auto... a) { fast::log2(a...); }, [](float x) { return fast::log2(x); }, positive, 1e-7);
+      check([](auto... a) { fast::tanh(a...); }, [](float x) { return fast::tanh(x); }, in, 1e-7);
+      check([](auto... a) { fast::sin(a...); }, [](float x) { return fast::sin(x); }, in, 1e-7);
+      check([](auto... a) { fast::db_to_gain(a...); }, [](float x) { return fast::db_to_gain(x); }, in, 0);
+
+      // In place
+      auto copy = in;
+      fast::sin(copy.data(), copy.data(), n);
+      for (int i = 0; i < n; i++) REQUIRE(copy[i] == Approx(fast::sin(in[i])).margin(1e-7));
+    }
+  }
+
+} // namespace otto::util::math
@@ -0,0 +1,67 @@
+#include "testing.t.hpp"
+
+#include "util/arena.hpp"
+#include "util/memory_tags.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("MemoryTag", "[util]") {
+    SECTION ("Tags are registered once by name") {
+      auto& tag = memory_tag("Test tag");
+      REQUIRE(&memory_tag("Test tag") == &tag);
+      REQUIRE(&memory_tag("Other test tag") != &tag);
+    }
+
+    SECTION ("The peak is the most bytes live at once") {
+      auto& tag = memory_tag("Test peak");
+      tag.add(100);
+      tag.add(50);
+      tag.remove(100);
+      tag.add(20);
+      REQUIRE(tag.live() == 70);
+      REQUIRE(tag.peak() == 150);
+      tag.remove(70);
+    }
+
+    SECTION ("Tagged vectors account their storage") {
+      auto& tag = memory_tag("Test vector");
+      {
+        TaggedVector<float> v{tag};
+        v.reserve(1000);
+        REQUIRE(tag.live() == 1000 * sizeof(float));
+        // The copy uses the same tag
+        auto copy = v;
+        copy.resize(10);
+        REQUIRE(tag.live() >= 1010 * sizeof(float));
+      }
+      REQUIRE(tag.live() == 0);
+    }
+
+    SECTION ("A tagged arena accounts its block and its overflow") {
+      auto& tag = memory_tag("Test arena");
+      std::size_t block = 0;
+      {
+        Arena arena(1024, &tag);
+        // The block is whole pages
+        block = tag.live();
+        REQUIRE(block >= 1024);
+        void* p = arena.allocate(4096);
+        REQUIRE(tag.live() == block + 4096);
+        arena.deallocate(p, 4096);
+      }
+      REQUIRE(tag.live() == 0);
+      REQUIRE(tag.peak() == block + 4096);
+    }
+
+    SECTION ("The tags are listed by live bytes") {
+      memory_tag("Test small").add(1);
+      memory_tag("Test large").add(1 << 30);
+      auto tags = memory_tags();
+      REQUIRE(tags.front().name == "Test large");
+      REQUIRE_THAT(memory_report(), Catch::Matchers::Contains("Test small"));
+      memory_tag("Test small").remove(1);
+      memory_tag("Test large").remove(1 << 30);
+    }
+  }
+
+} // namespace otto::util
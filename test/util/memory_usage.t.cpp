@@ -0,0 +1,32 @@
+#include "testing.t.hpp"
+
+#include <memory>
+
+#include "util/memory_usage.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("heap_usage", "[util]") {
+    auto before = heap_usage();
+    if (before == 0) return; // Not implemented on this platform
+    constexpr std::size_t size = 1 << 20;
+    auto block = std::make_unique<char[]>(size);
+    block[size - 1] = 1;
+    CAPTURE(before);
+    REQUIRE(heap_usage() >= before + size);
+    block.reset();
+    REQUIRE(heap_usage() < before + size);
+  }
+
+  TEST_CASE ("resident_memory", "[util]") {
+    auto before = resident_memory();
+    if (before == 0) return; // Not implemented on this platform
+    // Pages only become resident when they are written
+    constexpr std::size_t size = 8 << 20;
+    auto block = std::make_unique<char[]>(size);
+    for (std::size_t i = 0; i < size; i += 4096) block[i] = 1;
+    CAPTURE(before);
+    REQUIRE(resident_memory() >= before + size / 2);
+  }
+
+} // namespace otto::util
@@ -0,0 +1,68 @@
+#include "testing.t.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "util/mpsc_queue.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("MPSCQueue", "[util]") {
+    SECTION ("Values are popped in order") {
+      MPSCQueue<int, 8> queue;
+      REQUIRE(queue.empty());
+      for (int i = 0; i < 8; i++) REQUIRE(queue.push(i));
+      REQUIRE_FALSE(queue.push(8));
+      int value = -1;
+      for (int i = 0; i < 8; i++) {
+        REQUIRE(queue.pop(value));
+        REQUIRE(value == i);
+      }
+      REQUIRE_FALSE(queue.pop(value));
+      REQUIRE(queue.empty());
+    }
+
+    SECTION ("consume stops where the callback returns false") {
+      MPSCQueue<int, 8> queue;
+      for (int i = 0; i < 5; i++) queue.push(i);
+      std::vector<int> seen;
+      auto n = queue.consume([&](int v) {
+        if (v == 3) return false;
+        seen.push_back(v);
+        return true;
+      });
+      REQUIRE(n == 3);
+      REQUIRE(seen == std::vector<int>{0, 1, 2});
+      int value = -1;
+      REQUIRE(queue.pop(value));
+      REQUIRE(value == 3);
+    }
+
+    SECTION ("Values from concurrent producers all arrive in per-producer order") {
+      constexpr int producers = 4;
+      constexpr int count = 20000;
+      MPSCQueue<int, 64> queue;
+      std::vector<std::thread> threads;
+      for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p] {
+          for (int i = 0; i < count; i++) {
+            while (!queue.push(p * count + i)) std::this_thread::yield();
+          }
+        });
+      }
+      std::vector<int> next(producers, 0);
+      int received = 0;
+      while (received < producers * count) {
+        int value;
+        if (!queue.pop(value)) continue;
+        int p = value / count;
+        REQUIRE(value % count == next[p]);
+        next[p]++;
+        received++;
+      }
+      for (auto& t : threads) t.join();
+      REQUIRE(queue.empty());
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,82 @@
+#include "testing.t.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "util/arena.hpp"
+#include "util/page_memory.hpp"
+#include "util/perf_counter.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("PageMemory", "[util]") {
+    SECTION ("The memory is whole zeroed pages") {
+      PageMemory mem{1000};
+      REQUIRE(mem.size() >= 1000);
+      REQUIRE(reinterpret_cast<std::uintptr_t>(mem.data()) % 4096 == 0);
+      auto* bytes = static_cast<unsigned char*>(mem.data());
+      REQUIRE(std::all_of(bytes, bytes + mem.size(), [](auto b) { return b == 0; }));
+    }
+
+    SECTION ("Huge pages fall back to normal pages") {
+      PageMemory mem{3 << 20, true};
+      // Whatever the kernel has to spare, the memory is usable
+      REQUIRE(mem.size() >= (3 << 20));
+      static_cast<char*>(mem.data())[mem.size() - 1] = 1;
+      if (mem.pages() != PageMemory::Pages::normal) {
+        REQUIRE(mem.size() % PageMemory::huge_page_size == 0);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(mem.data()) % PageMemory::huge_page_size == 0);
+      }
+    }
+
+    SECTION ("An arena does not share a page with the heap") {
+      Arena arena{100};
+      void* p = arena.allocate(100);
+      REQUIRE(arena.owns(p));
+      REQUIRE(reinterpret_cast<std::uintptr_t>(p) % 4096 == 0);
+    }
+  }
+
+  TEST_CASE ("PageMemory benchmark", "[.benchmark] [util]") {
+    // A delay line read at scattered taps, like the FDN reverb reads its lines
+    constexpr std::size_t floats = 8 << 20;
+    constexpr std::size_t stride = 4096 / sizeof(float) + 17;
+
+    auto walk = [&](PageMemory& mem) {
+      auto* data = static_cast<float*>(mem.data());
+      float sum = 0;
+      for (std::size_t i = 0, j = 0; i < floats / 16; i++, j = (j + stride) % floats) {
+        sum += data[j];
+      }
+      return sum;
+    };
+
+    PageMemory normal{floats * sizeof(float), false};
+    PageMemory huge{floats * sizeof(float), true};
+    std::pair<const char*, PageMemory*> runs[] = {{"normal pages", &normal}, {"huge pages", &huge}};
+
+    std::vector<std::string> misses;
+    OBENCH_SECTION ("Scattered reads, normal vs huge pages") {
+      for (auto [name, mem] : runs) {
+        PerfCounter tlb_misses{PerfCounter::Event::dtlb_load_misses};
+        float sum = 0;
+        OBENCH (name, 20) {
+          sum += walk(*mem);
+        }
+        REQUIRE(sum == 0);
+        if (tlb_misses.available()) {
+          misses.push_back(fmt::format("{}: {} dTLB load misses", name, tlb_misses.read()));
+        } else {
+          misses.push_back(fmt::format("{}: dTLB misses can not be counted here", name));
+        }
+      }
+    }
+    // After the section, which prints the times when it ends
+    for (auto& line : misses) WARN(line);
+    WARN("The huge pages were " << (huge.pages() == PageMemory::Pages::huge     ? "explicit"
+                                    : huge.pages() == PageMemory::Pages::normal ? "not granted"
+                                                                                : "transparent"));
+  }
+
+} // namespace otto::util
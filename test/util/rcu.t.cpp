@@ -0,0 +1,94 @@
+#include "testing.t.hpp"
+
+#include <array>
+#include <thread>
+
+#include "util/rcu.hpp"
+
+namespace otto::util {
+
+  /// A value the reader can check is whole, as a torn or deleted one would not be
+  struct Version {
+    Version(int value = 0) : value(value)
+    {
+      check.fill(-value);
+      count++;
+    }
+    Version(const Version& rhs) : value(rhs.value), check(rhs.check)
+    {
+      count++;
+    }
+    ~Version()
+    {
+      check.fill(1);
+      count--;
+    }
+
+    bool whole() const noexcept
+    {
+      return util::all_of(check, [&](int c) { return c == -value; });
+    }
+
+    int value;
+    std::array<int, 16> check;
+    static inline std::atomic_int count = 0;
+  };
+
+  TEST_CASE ("Rcu", "[util]") {
+    SECTION ("The reader gets the latest version") {
+      Rcu<Version> rcu{1};
+      REQUIRE(rcu.read()->value == 1);
+      rcu.publish(2);
+      rcu.update([](Version& v) { v = Version(v.value + 1); });
+      REQUIRE(rcu.read()->value == 3);
+      REQUIRE(rcu.latest().value == 3);
+    }
+
+    SECTION ("Old versions are kept until the reader reads again") {
+      {
+        Rcu<Version> rcu{1};
+        auto* first = rcu.read();
+        rcu.publish(2);
+        rcu.publish(3);
+        // The reader may still hold the first version, so neither is deleted
+        REQUIRE(rcu.retired_count() == 2);
+        REQUIRE(first->whole());
+        REQUIRE(rcu.read()->value == 3);
+        rcu.collect();
+        REQUIRE(rcu.retired_count() == 0);
+        REQUIRE(Version::count == 1);
+      }
+      REQUIRE(Version::count == 0);
+    }
+
+    SECTION ("The reader never sees a deleted version") {
+      {
+        Rcu<Version> rcu{0};
+        std::atomic_bool done = false;
+        std::atomic_int last = 0;
+        bool whole = true;
+        bool monotonic = true;
+        std::thread reader([&] {
+          while (!done) {
+            auto* v = rcu.read();
+            whole = whole && v->whole();
+            monotonic = monotonic && v->value >= last;
+            last = v->value;
+          }
+        });
+        std::thread collector([&] {
+          while (!done) rcu.collect();
+        });
+        for (int i = 1; i <= 10000; i++) rcu.update([&](Version& v) { v = Version(i); });
+        while (last != 10000) std::this_thread::yield();
+        done = true;
+        reader.join();
+        collector.join();
+        REQUIRE(whole);
+        REQUIRE(monotonic);
+      }
+      REQUIRE(Version::count == 0);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,31 @@
+#include "testing.t.hpp"
+
+#include <cstring>
+#include <memory>
+
+#include "util/realtime.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("thread_page_faults", "[util]") {
+    auto before = thread_page_faults();
+    if (before.total() == 0) return; // Not implemented on this platform
+    // Large enough to be mapped on its own, and faulted in by the first write
+    constexpr std::size_t size = 16 << 20;
+    auto block = std::unique_ptr<char[]>(new char[size]);
+    std::memset(block.get(), 1, size);
+    REQUIRE(thread_page_faults().total() > before.total());
+  }
+
+  TEST_CASE ("pin_thread", "[util]") {
+    if (current_core() < 0) return; // Not implemented on this platform
+    auto handle = current_thread();
+    REQUIRE(pin_thread(handle, 0));
+    REQUIRE(current_core() == 0);
+    // Allow all cores again
+    std::vector<int> cores;
+    for (int i = 0; i < int(std::thread::hardware_concurrency()); i++) cores.push_back(i);
+    REQUIRE(pin_thread(handle, cores));
+  }
+
+} // namespace otto::util
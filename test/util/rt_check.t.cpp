@@ -0,0 +1,47 @@
+#include "testing.t.hpp"
+
+#include <mutex>
+
+#include "util/rt_check.hpp"
+
+namespace otto::util {
+
+  /// Keeps the compiler from eliding the allocations
+  static int* volatile sink = nullptr;
+
+  static void allocate_and_lock()
+  {
+    sink = new int(1);
+    delete sink;
+    std::mutex mutex;
+    std::lock_guard lock(mutex);
+  }
+
+  TEST_CASE ("RealtimeScope", "[util]") {
+    if (!realtime_checks_enabled) return;
+    print_realtime_violations(0);
+    auto before = realtime_violations();
+
+    SECTION ("Allocations and locks are counted within a scope") {
+      {
+        RealtimeScope realtime;
+        allocate_and_lock();
+      }
+      auto after = realtime_violations();
+      REQUIRE(after.allocations == before.allocations + 1);
+      REQUIRE(after.deallocations == before.deallocations + 1);
+      REQUIRE(after.locks == before.locks + 1);
+    }
+
+    SECTION ("But not outside one, or where they are allowed") {
+      allocate_and_lock();
+      {
+        RealtimeScope realtime;
+        AllowBlocking allow;
+        allocate_and_lock();
+      }
+      REQUIRE(realtime_violations().total() == before.total());
+    }
+  }
+
+} // namespace otto::util
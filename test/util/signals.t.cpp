@@ -0,0 +1,87 @@
+#include "testing.t.hpp"
+
+#include <array>
+#include <memory>
+
+#include "util/signals.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("InlineFunction", "[util]") {
+    SECTION ("Small callables are stored inline, and copied with their state") {
+      auto shared = std::make_shared<int>(3);
+      auto lambda = [shared](int x) { return x * *shared; };
+      static_assert(InlineFunction<int(int)>::is_inline<decltype(lambda)>);
+      InlineFunction<int(int)> f = lambda;
+      auto g = f;
+      REQUIRE(shared.use_count() == 4);
+      REQUIRE(g(2) == 6);
+      InlineFunction<int(int)> h = std::move(g);
+      REQUIRE_FALSE(g);
+      REQUIRE(h(3) == 9);
+    }
+
+    SECTION ("Large callables are stored on the heap") {
+      std::array<int, 64> big = {};
+      big[0] = 5;
+      auto lambda = [big](int x) { return big[0] + x; };
+      static_assert(!InlineFunction<int(int)>::is_inline<decltype(lambda)>);
+      InlineFunction<int(int)> f = lambda;
+      auto g = f;
+      f = nullptr;
+      REQUIRE(g(1) == 6);
+    }
+
+    SECTION ("Calling an empty function throws") {
+      InlineFunction<void()> f;
+      REQUIRE_THROWS_AS(f(), std::bad_function_call);
+    }
+  }
+
+  TEST_CASE ("Signal", "[util]") {
+    Signal<int> signal;
+    std::vector<int> calls;
+
+    SECTION ("Handlers are called in the order they were connected") {
+      signal.connect([&](int x) { calls.push_back(x); });
+      signal.connect([&](int x) { calls.push_back(10 * x); });
+      signal.emit(1);
+      REQUIRE(calls == std::vector<int>{1, 10});
+    }
+
+    SECTION ("Handlers can be disconnected, and called directly") {
+      auto a = signal.connect([&](int x) { calls.push_back(x); });
+      auto b = signal.connect([&](int x) { calls.push_back(10 * x); });
+      signal.disconnect(a);
+      signal.emit(1);
+      b.call_now(2);
+      // Calling a disconnected slot does nothing
+      a.call_now(3);
+      REQUIRE(calls == std::vector<int>{10, 20});
+    }
+
+    SECTION ("Connections disconnect on destruction") {
+      {
+        Connection<int> c = signal.connect([&](int x) { calls.push_back(x); });
+        REQUIRE(signal.size() == 1);
+      }
+      REQUIRE(signal.size() == 0);
+      signal.emit(1);
+      REQUIRE(calls.empty());
+    }
+
+    SECTION ("Member functions can be connected") {
+      struct Counter {
+        int total = 0;
+        void add(int x)
+        {
+          total += x;
+        }
+      } counter;
+      signal.connect_member(&counter, &Counter::add);
+      signal.emit(4);
+      REQUIRE(counter.total == 4);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,68 @@
+#include "testing.t.hpp"
+
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "util/spsc_ring.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("SPSCRing", "[util]") {
+    SECTION ("Values are popped in order") {
+      SPSCRing<int, 8> ring;
+      REQUIRE(ring.empty());
+      for (int i = 0; i < 8; i++) REQUIRE(ring.push(i));
+      REQUIRE_FALSE(ring.push(8));
+      int value = -1;
+      for (int i = 0; i < 8; i++) {
+        REQUIRE(ring.pop(value));
+        REQUIRE(value == i);
+      }
+      REQUIRE_FALSE(ring.pop(value));
+      REQUIRE(ring.empty());
+    }
+
+    SECTION ("Batches wrap around the end, and are cut to what fits") {
+      SPSCRing<int, 8> ring;
+      std::vector<int> in(6);
+      std::iota(in.begin(), in.end(), 0);
+      std::vector<int> out(6, -1);
+      REQUIRE(ring.write(in) == 6);
+      REQUIRE(ring.read(gsl::span<int>(out.data(), 4)) == 4);
+      // Starts at position 6, wraps after 2 values, and only 6 fit
+      std::iota(in.begin(), in.end(), 6);
+      REQUIRE(ring.write(in) == 6);
+      REQUIRE(ring.write_available() == 0);
+      REQUIRE(ring.read_available() == 8);
+      std::vector<int> all(10, -1);
+      REQUIRE(ring.read(all) == 8);
+      REQUIRE(all == std::vector<int>{4, 5, 6, 7, 8, 9, 10, 11, -1, -1});
+      REQUIRE(ring.empty());
+    }
+
+    SECTION ("Values are passed between threads in order") {
+      SPSCRing<int, 64> ring;
+      constexpr int count = 100000;
+      std::thread producer([&] {
+        int buf[7];
+        for (int i = 0; i < count;) {
+          int n = std::min(7, count - i);
+          std::iota(buf, buf + n, i);
+          i += ring.write(buf, n);
+        }
+      });
+      int expected = 0;
+      bool in_order = true;
+      int buf[5];
+      while (expected < count) {
+        auto n = ring.read(buf, 5);
+        for (std::size_t i = 0; i < n; i++) in_order &= buf[i] == expected++;
+      }
+      producer.join();
+      REQUIRE(in_order);
+      REQUIRE(ring.empty());
+    }
+  }
+
+} // namespace otto::util
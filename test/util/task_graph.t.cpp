@@ -0,0 +1,75 @@
+#include "testing.t.hpp"
+
+#include <array>
+#include <atomic>
+
+#include "util/task_graph.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("TaskGraph", "[util]") {
+    for (int workers : {0, 1, 3}) {
+      CAPTURE(workers);
+      WorkerPool pool{workers};
+      TaskGraph graph;
+      std::array<int, 5> order;
+      std::atomic_int counter = 0;
+      auto step = [&](int i) { return [&, i] { order[i] = counter++; }; };
+      auto a = graph.add(step(0));
+      auto b = graph.add(step(1), {a});
+      auto c = graph.add(step(2), {a});
+      auto d = graph.add(step(3), {b});
+      graph.add(step(4), {c, d});
+
+      for (int run = 0; run < 1000; run++) {
+        counter = 0;
+        pool.run(graph);
+        REQUIRE(counter == 5);
+        REQUIRE(order[0] < order[1]);
+        REQUIRE(order[0] < order[2]);
+        REQUIRE(order[1] < order[3]);
+        REQUIRE(order[2] < order[4]);
+        REQUIRE(order[3] < order[4]);
+      }
+    }
+  }
+
+  TEST_CASE ("WorkerPool switching graphs", "[util]") {
+    WorkerPool pool{2};
+    std::atomic_int counter = 0;
+    for (int i = 0; i < 200; i++) {
+      auto graph = std::make_unique<TaskGraph>();
+      auto a = graph->add([&] { counter++; });
+      graph->add([&] { counter++; }, {a});
+      graph->add([&] { counter++; }, {a});
+      pool.run(*graph);
+      pool.run(*graph);
+    }
+    REQUIRE(counter == 200 * 6);
+  }
+
+  TEST_CASE ("WorkerPool::try_run", "[util]") {
+    WorkerPool pool{1};
+    TaskGraph inner;
+    int inner_runs = 0;
+    inner.add([&] { inner_runs++; });
+
+    SECTION ("Runs the graph when the pool is free") {
+      REQUIRE(pool.try_run(inner));
+      REQUIRE(pool.try_run(inner));
+      REQUIRE(inner_runs == 2);
+    }
+
+    SECTION ("Does nothing while the pool is running another graph") {
+      TaskGraph outer;
+      bool nested = true;
+      outer.add([&] { nested = pool.try_run(inner); });
+      REQUIRE(pool.try_run(outer));
+      REQUIRE_FALSE(nested);
+      REQUIRE(inner_runs == 0);
+      REQUIRE(pool.try_run(inner));
+      REQUIRE(inner_runs == 1);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,28 @@
+#include "testing.t.hpp"
+
+#include "util/thread.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("triggered_thread", "[util]") {
+    std::atomic_int runs = 0;
+
+    SECTION ("A trigger before the thread waits is not lost") {
+      triggered_thread thread(ThreadClass::io, [&](auto should_run) {
+        while (should_run()) runs++;
+      });
+      thread.trigger();
+      while (runs == 0) std::this_thread::yield();
+      REQUIRE(runs == 1);
+    }
+
+    SECTION ("The thread stops when joined, without a trigger") {
+      triggered_thread thread(ThreadClass::io, [&](auto should_run) {
+        while (should_run()) runs++;
+      });
+      thread.join();
+      REQUIRE(runs == 0);
+    }
+  }
+
+} // namespace otto::util
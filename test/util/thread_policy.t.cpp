@@ -0,0 +1,33 @@
+#include "testing.t.hpp"
+
+#include "util/realtime.hpp"
+#include "util/thread_policy.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("start_thread", "[util]") {
+    if (current_core() < 0) return; // Not implemented on this platform
+    auto before = thread_policy(ThreadClass::background);
+
+    SECTION ("The thread runs on the cores of its class") {
+      set_thread_policy(ThreadClass::background, {ThreadPolicy::Scheduling::normal, 0, {0}});
+      int core = -1;
+      start_thread(ThreadClass::background, [&] { core = current_core(); }).join();
+      REQUIRE(core == 0);
+    }
+
+    SECTION ("The thread does not inherit the cores of the thread that started it") {
+      if (std::thread::hardware_concurrency() < 2) return;
+      set_thread_policy(ThreadClass::background, {ThreadPolicy::Scheduling::normal, 0, {1}});
+      REQUIRE(enter_thread_class(ThreadClass::background));
+      set_thread_policy(ThreadClass::background, {ThreadPolicy::Scheduling::normal, 0, {0}});
+      int core = -1;
+      start_thread(ThreadClass::background, [&] { core = current_core(); }).join();
+      REQUIRE(core == 0);
+      REQUIRE(unpin_thread(current_thread()));
+    }
+
+    set_thread_policy(ThreadClass::background, before);
+  }
+
+} // namespace otto::util
@@ -0,0 +1,34 @@
+#include "testing.t.hpp"
+
+#include <random>
+
+#include "util/time_filter.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("TimeFilter", "[util]") {
+    TimeFilter filter;
+    std::mt19937 rng{1234};
+    // 1 ms of jitter on midi clock at 120 bpm
+    std::uniform_real_distribution<double> jitter{-0.001, 0.001};
+    double period = 60.0 / (120 * 24);
+
+    REQUIRE_FALSE(filter.locked());
+    for (int i = 0; i < 2000; i++) filter.tick(i * period + jitter(rng));
+    REQUIRE(filter.locked());
+    REQUIRE(filter.period() == Approx(period).epsilon(0.002));
+
+    SECTION ("Follows tempo changes") {
+      double start = 2000 * period;
+      period = 60.0 / (100 * 24);
+      for (int i = 0; i < 4000; i++) filter.tick(start + i * period + jitter(rng));
+      REQUIRE(filter.period() == Approx(period).epsilon(0.002));
+    }
+
+    SECTION ("reset starts over") {
+      filter.reset();
+      REQUIRE_FALSE(filter.locked());
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,39 @@
+#include "testing.t.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include "util/timer.hpp"
+
+namespace otto::util::timer {
+
+  TEST_CASE ("Tracing timers", "[util]") {
+    clear();
+
+    SECTION ("Scopes and instants are recorded per thread, and collected") {
+      {
+        ScopeTimer timer{"outer"};
+        record_instant("event");
+      }
+      std::thread([] { ScopeTimer timer{"other thread"}; }).join();
+      REQUIRE(size() == 0);
+      collect();
+      REQUIRE(size() == 3);
+    }
+
+    SECTION ("The trace is written as Chrome trace events") {
+      { ScopeTimer timer{"scope"}; }
+      record_instant("instant");
+      auto path = filesystem::temp_directory_path() / "otto_trace_test.json";
+      dump(path);
+      std::ifstream file(path.c_str());
+      std::string json{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+      REQUIRE(json.find(R"("name":"scope","ph":"X")") != std::string::npos);
+      REQUIRE(json.find(R"("name":"instant","ph":"i")") != std::string::npos);
+      filesystem::remove(path);
+    }
+  }
+
+} // namespace otto::util::timer
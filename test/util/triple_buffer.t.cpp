@@ -0,0 +1,55 @@
+#include "testing.t.hpp"
+
+#include <thread>
+
+#include "util/triple_buffer.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("TripleBuffer", "[util]") {
+    SECTION ("A default value is read before publishing") {
+      TripleBuffer<int> buffer;
+      REQUIRE_FALSE(buffer.has_new());
+      REQUIRE(buffer.read() == 0);
+    }
+
+    SECTION ("The latest published value is read") {
+      TripleBuffer<int> buffer;
+      buffer.publish(1);
+      buffer.publish(2);
+      REQUIRE(buffer.has_new());
+      REQUIRE(buffer.read() == 2);
+      REQUIRE_FALSE(buffer.has_new());
+      REQUIRE(buffer.read() == 2);
+      buffer.publish(3);
+      REQUIRE(buffer.read() == 3);
+    }
+
+    SECTION ("Snapshots are read whole, and in order, across threads") {
+      struct Snapshot {
+        int a = 0;
+        int b = 0;
+      };
+      TripleBuffer<Snapshot> buffer;
+      std::atomic_bool done = false;
+      std::atomic_int last = 0;
+      bool consistent = true;
+      bool monotonic = true;
+      std::thread consumer([&] {
+        while (!done) {
+          auto& s = buffer.read();
+          consistent = consistent && s.a == -s.b;
+          monotonic = monotonic && s.a >= last;
+          last = s.a;
+        }
+      });
+      for (int i = 1; i <= 10000; i++) buffer.publish({i, -i});
+      while (last != 10000) std::this_thread::yield();
+      done = true;
+      consumer.join();
+      REQUIRE(consistent);
+      REQUIRE(monotonic);
+    }
+  }
+
+} // namespace otto::util
@@ -0,0 +1,42 @@
+#include "testing.t.hpp"
+
+#include <thread>
+
+#include "util/wait_counter.hpp"
+
+namespace otto::util {
+
+  using namespace std::chrono_literals;
+
+  TEST_CASE ("WaitCounter", "[util]") {
+    WaitCounter counter;
+
+    SECTION ("Waiting returns right away if the counter has passed the value") {
+      counter.increment();
+      REQUIRE(counter.value() == 1);
+      REQUIRE(counter.wait_past(0, 0ms));
+    }
+
+    SECTION ("Waiting times out if the counter does not pass the value") {
+      counter.increment();
+      auto t0 = WaitCounter::clock::now();
+      REQUIRE_FALSE(counter.wait_past(1, 20ms));
+      REQUIRE(WaitCounter::clock::now() - t0 >= 20ms);
+    }
+
+    SECTION ("Waiting threads are woken by increment") {
+      std::thread thread([&] {
+        std::this_thread::sleep_for(10ms);
+        counter.increment();
+      });
+      REQUIRE(counter.wait_past(0, 10s));
+      REQUIRE(counter.value() == 1);
+      thread.join();
+    }
+
+    SECTION ("The counter may wrap around") {
+      REQUIRE(counter.wait_past(std::uint32_t(-1), 0ms));
+    }
+  }
+
+} // namespace otto::util
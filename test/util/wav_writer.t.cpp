@@ -0,0 +1,64 @@
+#include "testing.t.hpp"
+
+#include <array>
+
+#include <AudioFile.h>
+
+#include "util/wav_writer.hpp"
+
+namespace otto::util {
+
+  TEST_CASE ("WavWriter", "[util]") {
+    auto dir = test::dir / "recordings";
+    constexpr int samplerate = 1000;
+    constexpr int nframes = 1000;
+    // The left channel counts the frames, wrapped to stay below 1. The right one is silent.
+    auto value = [](int frame) { return (frame % 4000) / 4000.f; };
+    auto write_buffers = [&](WavWriter& writer, int count) {
+      std::array<float, nframes> left;
+      for (int b = 0; b < count; b++) {
+        for (int i = 0; i < nframes; i++) left[i] = value(b * nframes + i);
+        std::array<const float*, 2> channels = {left.data(), nullptr};
+        writer.write(channels, nframes);
+      }
+    };
+
+    SECTION ("A short recording is written when the writer is destroyed") {
+      auto path = dir / "short.wav";
+      {
+        WavWriter writer(path, 2, samplerate, 1);
+        REQUIRE(writer.is_open());
+        write_buffers(writer, 3);
+      }
+      REQUIRE(fs::file_size(path) == WavWriter::header_size + 3 * nframes * 6);
+      AudioFile<float> file;
+      REQUIRE(file.load(path.string()));
+      REQUIRE(file.getNumChannels() == 2);
+      REQUIRE(file.getBitDepth() == 24);
+      REQUIRE(file.getNumSamplesPerChannel() == 3 * nframes);
+      REQUIRE(file.samples[0][1234] == Approx(value(1234)).margin(1e-6));
+      REQUIRE(file.samples[1][1234] == 0);
+    }
+
+    SECTION ("Samples straddling blocks are written whole") {
+      auto path = dir / "long.wav";
+      // Over a block of stereo frames, of 6 bytes each
+      constexpr int buffers = WavWriter::block_size / 6 / nframes + 1;
+      {
+        WavWriter writer(path, 2, samplerate, 1000);
+        write_buffers(writer, buffers);
+        REQUIRE(writer.dropped_frames() == 0);
+      }
+      AudioFile<float> file;
+      REQUIRE(file.load(path.string()));
+      REQUIRE(file.getNumSamplesPerChannel() == buffers * nframes);
+      // The left sample of this frame starts 2 bytes before the end of the first block
+      int frame = WavWriter::block_size / 6;
+      for (int i = frame - 1; i <= frame + 1; i++) {
+        REQUIRE(file.samples[0][i] == Approx(value(i)).margin(1e-6));
+        REQUIRE(file.samples[1][i] == 0);
+      }
+    }
+  }
+
+} // namespace otto::util